@@ -0,0 +1,174 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_BENCH_HPP
+#define WXLIB_BENCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wxlib::bench {
+
+/*!
+  What one run of a benchmark body processed, e.g. the lines read or the objects packed. The
+  time of a run is reported per item, and bytes, when not zero, give the throughput.
+*/
+struct Work
+{
+  std::size_t items{};
+  std::size_t bytes{};
+};
+
+/*!
+  The body of a benchmark, which does its work a_iterations times and returns what it
+  processed in total. Data the body reads should be set up once, outside of it.
+*/
+using Body = std::function<Work(std::size_t a_iterations)>;
+
+struct Benchmark
+{
+  std::string suite;
+  std::string name;
+  Body body;
+};
+
+/*!
+  Robust statistics of the nanoseconds per item of the measured repetitions. The median and
+  the median absolute deviation are not skewed by a repetition a context switch slowed down,
+  which the mean and the standard deviation are.
+*/
+struct Stats
+{
+  double min{};
+  double median{};
+  double mean{};
+  double stddev{};
+  double mad{};
+  double p90{};
+};
+
+/*!
+  Allocations made through the global operator new, or through the default std::pmr resource,
+  over one run of a benchmark, see counts_allocations.
+*/
+struct Allocations
+{
+  std::size_t count{};
+  std::size_t bytes{};
+  std::size_t pmr_count{};
+  std::size_t pmr_bytes{};
+};
+
+/*!
+  Hardware events of one run of a benchmark, see count_events. An event the platform, the
+  PMU or perf_event_paranoid does not provide is left empty.
+*/
+struct Counters
+{
+  std::optional<std::uint64_t> cycles{};
+  std::optional<std::uint64_t> instructions{};
+  std::optional<std::uint64_t> llc_misses{};
+  std::optional<std::uint64_t> dtlb_misses{};
+  std::optional<std::uint64_t> branch_misses{};
+  std::optional<std::uint64_t> page_faults{};
+};
+
+struct Result
+{
+  std::string suite;
+  std::string name;
+  std::size_t iterations{};
+  Work work{};
+  std::vector<double> samples{};
+  Stats stats{};
+  Allocations allocations{};
+  Counters counters{};
+};
+
+struct Options
+{
+  std::string filter{};
+  std::size_t warmup{1};
+  std::size_t repetitions{10};
+  double min_time{0.05};
+  std::string json{};
+  bool counters{true};
+};
+
+std::vector<Benchmark> &registry();
+
+/*!
+  Whether wxlib_bench replaces the global operator new to count allocations, when built with
+  WXLIB_BENCH_COUNT_ALLOCATIONS, see bench_alloc.cpp. Allocations are only counted while
+  tracked, in a run of each benchmark of its own, after the timed ones.
+*/
+bool counts_allocations() noexcept;
+
+void track_allocations(bool a_on) noexcept;
+
+/*!
+  Number of allocations, and their bytes, made by the global operator new since the last call
+  to reset_allocations, while tracked.
+*/
+std::size_t allocation_count() noexcept;
+
+std::size_t allocated_bytes() noexcept;
+
+void reset_allocations() noexcept;
+
+/*!
+  Whether perf_event_open counts at least one of the Counters events here, on Linux only, see
+  bench_counters.cpp.
+*/
+bool counts_events() noexcept;
+
+/*!
+  Runs a_body(a_iterations) once, counting its hardware events in user space.
+*/
+Counters count_events(Body const &a_body, std::size_t a_iterations);
+
+/*!
+  Registers a benchmark at static initialization, e.g.
+  @code
+    [[maybe_unused]] const auto registered = wxlib::bench::add("mio", "fast_find", [](std::size_t a_iterations) {
+      ...
+      return wxlib::bench::Work{a_iterations, a_iterations * text.size()};
+    });
+  @endcode
+*/
+inline bool add(std::string a_suite, std::string a_name, Body a_body)
+{
+  registry().push_back({std::move(a_suite), std::move(a_name), std::move(a_body)});
+  return true;
+}
+
+/*!
+  Keeps the compiler from discarding a value which is otherwise unused, so that the work
+  computing it is not optimized away.
+*/
+template<typename T>
+inline void do_not_optimize(T const &a_value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(a_value) : "memory");
+#else
+  static volatile auto const *sink = &a_value;
+  sink = &a_value;
+#endif
+}
+
+Stats compute_stats(std::vector<double> a_samples);
+
+std::vector<Result> run(Options const &a_options);
+
+void write_json(std::string const &a_path, std::vector<Result> const &a_results);
+
+}// namespace wxlib::bench
+
+#endif// WXLIB_BENCH_HPP
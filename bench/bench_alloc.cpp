@@ -0,0 +1,137 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Replaces the global operator new and delete of wxlib_bench, counting the allocations made
+// by a benchmark while they are tracked, so that allocations hidden in packing, unpacking or
+// parsing show up per item in the report. Untracked, an allocation only costs a relaxed load
+// more than malloc.
+
+#include <bench/bench.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+#ifdef WXLIB_BENCH_COUNT_ALLOCATIONS
+std::atomic<bool> tracking{false};
+std::atomic<std::size_t> count{0};
+std::atomic<std::size_t> bytes{0};
+
+void *allocate(std::size_t a_size, std::size_t a_alignment) noexcept
+{
+  if (tracking.load(std::memory_order_relaxed)) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(a_size, std::memory_order_relaxed);
+  }
+
+  a_size = a_size ? a_size : 1;
+  if (a_alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return std::malloc(a_size);
+#ifdef _WIN32
+  return _aligned_malloc(a_size, a_alignment);
+#else
+  return std::aligned_alloc(a_alignment, (a_size + a_alignment - 1) / a_alignment * a_alignment);
+#endif
+}
+
+void *allocate_or_throw(std::size_t a_size, std::size_t a_alignment)
+{
+  auto *p = allocate(a_size, a_alignment);
+  if (!p) throw std::bad_alloc{};
+  return p;
+}
+
+void deallocate(void *a_p, [[maybe_unused]] std::size_t a_alignment) noexcept
+{
+#ifdef _WIN32
+  if (a_alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return _aligned_free(a_p);
+#endif
+  std::free(a_p);
+}
+#endif
+
+}// namespace
+
+namespace wxlib::bench {
+
+#ifdef WXLIB_BENCH_COUNT_ALLOCATIONS
+bool counts_allocations() noexcept
+{
+  return true;
+}
+
+void track_allocations(bool a_on) noexcept
+{
+  tracking.store(a_on, std::memory_order_relaxed);
+}
+
+std::size_t allocation_count() noexcept
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+std::size_t allocated_bytes() noexcept
+{
+  return bytes.load(std::memory_order_relaxed);
+}
+
+void reset_allocations() noexcept
+{
+  count.store(0, std::memory_order_relaxed);
+  bytes.store(0, std::memory_order_relaxed);
+}
+#else
+bool counts_allocations() noexcept
+{
+  return false;
+}
+
+void track_allocations(bool) noexcept
+{
+}
+
+std::size_t allocation_count() noexcept
+{
+  return 0;
+}
+
+std::size_t allocated_bytes() noexcept
+{
+  return 0;
+}
+
+void reset_allocations() noexcept
+{
+}
+#endif
+
+}// namespace wxlib::bench
+
+#ifdef WXLIB_BENCH_COUNT_ALLOCATIONS
+// clang-format off
+void *operator new(std::size_t a_size) { return allocate_or_throw(a_size, 0); }
+void *operator new[](std::size_t a_size) { return allocate_or_throw(a_size, 0); }
+void *operator new(std::size_t a_size, std::align_val_t a_alignment) { return allocate_or_throw(a_size, static_cast<std::size_t>(a_alignment)); }
+void *operator new[](std::size_t a_size, std::align_val_t a_alignment) { return allocate_or_throw(a_size, static_cast<std::size_t>(a_alignment)); }
+void *operator new(std::size_t a_size, const std::nothrow_t &) noexcept { return allocate(a_size, 0); }
+void *operator new[](std::size_t a_size, const std::nothrow_t &) noexcept { return allocate(a_size, 0); }
+void *operator new(std::size_t a_size, std::align_val_t a_alignment, const std::nothrow_t &) noexcept { return allocate(a_size, static_cast<std::size_t>(a_alignment)); }
+void *operator new[](std::size_t a_size, std::align_val_t a_alignment, const std::nothrow_t &) noexcept { return allocate(a_size, static_cast<std::size_t>(a_alignment)); }
+
+void operator delete(void *a_p) noexcept { deallocate(a_p, 0); }
+void operator delete[](void *a_p) noexcept { deallocate(a_p, 0); }
+void operator delete(void *a_p, std::size_t) noexcept { deallocate(a_p, 0); }
+void operator delete[](void *a_p, std::size_t) noexcept { deallocate(a_p, 0); }
+void operator delete(void *a_p, std::align_val_t a_alignment) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+void operator delete[](void *a_p, std::align_val_t a_alignment) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+void operator delete(void *a_p, std::size_t, std::align_val_t a_alignment) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+void operator delete[](void *a_p, std::size_t, std::align_val_t a_alignment) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+void operator delete(void *a_p, const std::nothrow_t &) noexcept { deallocate(a_p, 0); }
+void operator delete[](void *a_p, const std::nothrow_t &) noexcept { deallocate(a_p, 0); }
+void operator delete(void *a_p, std::align_val_t a_alignment, const std::nothrow_t &) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+void operator delete[](void *a_p, std::align_val_t a_alignment, const std::nothrow_t &) noexcept { deallocate(a_p, static_cast<std::size_t>(a_alignment)); }
+// clang-format on
+#endif
@@ -0,0 +1,155 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Hardware performance counters of a benchmark run through perf_event_open, on Linux. Each
+// event is opened on its own rather than as a group, so that an event the PMU or a VM does
+// not provide leaves the others working, and is scaled by its enabled over running time when
+// the kernel multiplexes it. Only user space is counted, which perf_event_paranoid 2, the
+// default of most distributions, permits. Elsewhere, or when no event can be opened, the
+// counters are reported as unavailable and the console and JSON reports leave them out.
+
+#include <bench/bench.hpp>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#endif
+
+namespace wxlib::bench {
+
+#ifdef __linux__
+namespace {
+
+struct EventSpec
+{
+  std::uint32_t type;
+  std::uint64_t config;
+  std::optional<std::uint64_t> Counters::*field;
+};
+
+constexpr auto cache_miss = [](std::uint64_t a_cache) {
+  return a_cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+};
+
+const auto event_specs = std::array<EventSpec, 6>{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, &Counters::cycles},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, &Counters::instructions},
+    {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL), &Counters::llc_misses},
+    {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB), &Counters::dtlb_misses},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, &Counters::branch_misses},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, &Counters::page_faults},
+}};
+
+// Counts the calling thread, and the threads it creates while counting, which inherit the
+// events; the workers of an executor started before are not counted.
+int open_event(EventSpec const &a_spec)
+{
+  auto attr = perf_event_attr{};
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = a_spec.type;
+  attr.config = a_spec.config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+class EventFiles
+{
+public:
+  EventFiles()
+  {
+    for (std::size_t i = 0; i < event_specs.size(); ++i) fds_[i] = open_event(event_specs[i]);
+  }
+
+  EventFiles(EventFiles const &) = delete;
+  EventFiles &operator=(EventFiles const &) = delete;
+
+  ~EventFiles()
+  {
+    for (auto fd : fds_)
+      if (fd >= 0) close(fd);
+  }
+
+  [[nodiscard]] bool any() const noexcept
+  {
+    for (auto fd : fds_)
+      if (fd >= 0) return true;
+    return false;
+  }
+
+  void start() const noexcept
+  {
+    for (auto fd : fds_) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  void stop() const noexcept
+  {
+    for (auto fd : fds_)
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  [[nodiscard]] Counters read() const noexcept
+  {
+    auto counters = Counters{};
+    for (std::size_t i = 0; i < event_specs.size(); ++i) {
+      // value, time enabled, time running
+      std::uint64_t values[3]{};
+      if (fds_[i] < 0 || ::read(fds_[i], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) continue;
+      if (values[2] == 0) continue;
+      auto const scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+      counters.*event_specs[i].field = static_cast<std::uint64_t>(std::llround(static_cast<double>(values[0]) * scale));
+    }
+    return counters;
+  }
+
+private:
+  std::array<int, event_specs.size()> fds_{};
+};
+
+}// namespace
+
+bool counts_events() noexcept
+{
+  static auto const available = EventFiles{}.any();
+  return available;
+}
+
+Counters count_events(Body const &a_body, std::size_t a_iterations)
+{
+  if (!counts_events()) return {};
+
+  auto const files = EventFiles{};
+  files.start();
+  [[maybe_unused]] auto const work = a_body(a_iterations);
+  files.stop();
+  return files.read();
+}
+#else
+bool counts_events() noexcept
+{
+  return false;
+}
+
+Counters count_events(Body const &, std::size_t)
+{
+  return {};
+}
+#endif
+
+}// namespace wxlib::bench
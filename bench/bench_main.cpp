@@ -0,0 +1,321 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// The wxlib_bench driver. Each benchmark is calibrated to the number of iterations that runs
+// for at least --min-time seconds, run --warmup times untimed, then --repetitions times,
+// and reported as the statistics of its nanoseconds per item. Build it optimized, e.g.
+//
+//   cmake -DCMAKE_BUILD_TYPE=Release . && cmake --build . --target wxlib_bench
+//   ./bench/wxlib_bench --filter msgpack --repetitions 20 --json msgpack.json
+//
+// The JSON report holds every sample, so that two releases can be compared on the same
+// hardware with any statistics, not only the ones printed. Built with allocation counting,
+// the default, each benchmark is run once more with its allocations counted, those through
+// the default std::pmr resource apart, and reported per item. On Linux, each benchmark is
+// also run once with its hardware counters counted, see bench_counters.cpp, reporting IPC,
+// and bytes per cycle to tell memory-bound kernels from compute-bound ones.
+
+#include <bench/bench.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/memory_resource.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+namespace wxlib::bench {
+
+namespace {
+
+double seconds_of(Body const &a_body, std::size_t a_iterations, Work &a_work)
+{
+  auto const start = std::chrono::steady_clock::now();
+  a_work = a_body(a_iterations);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Grows the iterations ten-fold until a run is at least a tenth of a_min_time, then scales
+// them to a_min_time, so that a short body is not dominated by the clock reads. The first
+// run is not timed, as it also builds the inputs the body sets up lazily.
+std::size_t calibrate(Body const &a_body, double a_min_time)
+{
+  auto work = a_body(1);
+  auto iterations = std::size_t{1};
+  auto elapsed = seconds_of(a_body, iterations, work);
+  while (elapsed < a_min_time / 10 && iterations < (std::size_t{1} << 40)) {
+    iterations *= 10;
+    elapsed = seconds_of(a_body, iterations, work);
+  }
+  if (elapsed < a_min_time)
+    iterations = static_cast<std::size_t>(std::ceil(iterations * a_min_time / std::max(elapsed, 1e-9)));
+  return std::max<std::size_t>(iterations, 1);
+}
+
+double percentile(std::vector<double> const &a_sorted, double a_fraction)
+{
+  auto const rank = a_fraction * static_cast<double>(a_sorted.size() - 1);
+  auto const lower = static_cast<std::size_t>(std::floor(rank));
+  auto const upper = std::min(lower + 1, a_sorted.size() - 1);
+  return a_sorted[lower] + (a_sorted[upper] - a_sorted[lower]) * (rank - static_cast<double>(lower));
+}
+
+// Runs the body once more, counting its allocations through the global operator new, and
+// through a counting resource set as the default std::pmr resource, which also go through
+// operator new, upstream.
+Allocations count_allocations(Body const &a_body, std::size_t a_iterations)
+{
+  if (!counts_allocations()) return {};
+
+  auto counter = mio::counting_memory_resource{std::pmr::new_delete_resource()};
+  auto *previous = std::pmr::set_default_resource(&counter);
+  reset_allocations();
+  track_allocations(true);
+  [[maybe_unused]] auto const work = a_body(a_iterations);
+  track_allocations(false);
+  std::pmr::set_default_resource(previous);
+  return {allocation_count(), allocated_bytes(), counter.allocations(), counter.allocated_bytes()};
+}
+
+double per_item(std::size_t a_count, Work const &a_work)
+{
+  return static_cast<double>(a_count) / static_cast<double>(std::max<std::size_t>(a_work.items, 1));
+}
+
+// Ratio of two counters, or nothing when either one was not counted.
+std::optional<double> ratio(std::optional<std::uint64_t> a_numerator, std::optional<std::uint64_t> a_denominator)
+{
+  if (!a_numerator || !a_denominator || *a_denominator == 0) return std::nullopt;
+  return static_cast<double>(*a_numerator) / static_cast<double>(*a_denominator);
+}
+
+std::optional<double> bytes_per_cycle(Result const &a_result)
+{
+  if (a_result.work.bytes == 0) return std::nullopt;
+  return ratio(a_result.work.bytes, a_result.counters.cycles);
+}
+
+std::string escaped(std::string_view a_text)
+{
+  auto result = std::string{};
+  for (auto c : a_text) {
+    if (c == '"' || c == '\\') result += '\\';
+    result += c;
+  }
+  return result;
+}
+
+std::string_view simd_name()
+{
+  switch (mio::simd_level()) {
+  case mio::SimdLevel::Avx512: return "avx512";
+  case mio::SimdLevel::Avx2: return "avx2";
+  case mio::SimdLevel::Neon: return "neon";
+  default: return "none";
+  }
+}
+
+std::string_view compiler_name()
+{
+#if defined(__clang__)
+  return "clang " __clang_version__;
+#elif defined(__GNUC__)
+  return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  return "msvc";
+#else
+  return "unknown";
+#endif
+}
+
+}// namespace
+
+std::vector<Benchmark> &registry()
+{
+  static auto benchmarks = std::vector<Benchmark>{};
+  return benchmarks;
+}
+
+Stats compute_stats(std::vector<double> a_samples)
+{
+  auto stats = Stats{};
+  if (a_samples.empty()) return stats;
+
+  std::sort(a_samples.begin(), a_samples.end());
+  auto const n = static_cast<double>(a_samples.size());
+  stats.min = a_samples.front();
+  stats.median = percentile(a_samples, 0.5);
+  stats.p90 = percentile(a_samples, 0.9);
+  stats.mean = std::accumulate(a_samples.begin(), a_samples.end(), 0.0) / n;
+
+  auto squares = 0.0;
+  for (auto sample : a_samples) squares += (sample - stats.mean) * (sample - stats.mean);
+  stats.stddev = a_samples.size() > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+
+  for (auto &sample : a_samples) sample = std::abs(sample - stats.median);
+  std::sort(a_samples.begin(), a_samples.end());
+  stats.mad = percentile(a_samples, 0.5);
+  return stats;
+}
+
+std::vector<Result> run(Options const &a_options)
+{
+  auto results = std::vector<Result>{};
+  for (auto const &benchmark : registry()) {
+    auto const full_name = benchmark.suite + "/" + benchmark.name;
+    if (!a_options.filter.empty() && full_name.find(a_options.filter) == std::string::npos) continue;
+
+    auto result = Result{benchmark.suite, benchmark.name, calibrate(benchmark.body, a_options.min_time)};
+    for (std::size_t i = 0; i < a_options.warmup; ++i) seconds_of(benchmark.body, result.iterations, result.work);
+
+    for (std::size_t i = 0; i < a_options.repetitions; ++i) {
+      auto const elapsed = seconds_of(benchmark.body, result.iterations, result.work);
+      result.samples.push_back(elapsed * 1e9 / static_cast<double>(std::max<std::size_t>(result.work.items, 1)));
+    }
+
+    result.stats = compute_stats(result.samples);
+    result.allocations = count_allocations(benchmark.body, result.iterations);
+    if (a_options.counters) result.counters = count_events(benchmark.body, result.iterations);
+    auto const per_second = result.stats.median > 0 ? 1e9 / result.stats.median : 0.0;
+    std::printf("%-44s %12.2f ns %9.2f ns %7.2f%% %14.0f items/s", full_name.c_str(), result.stats.median,
+                result.stats.min, result.stats.median > 0 ? 100 * result.stats.mad / result.stats.median : 0.0,
+                per_second);
+    if (result.work.bytes > 0 && result.work.items > 0)
+      std::printf(" %10.1f MB/s", per_second * static_cast<double>(result.work.bytes) / result.work.items / 1e6);
+    if (counts_allocations())
+      std::printf(" %10.2f allocs %10.1f B", per_item(result.allocations.count, result.work),
+                  per_item(result.allocations.bytes, result.work));
+    if (auto const ipc = ratio(result.counters.instructions, result.counters.cycles)) std::printf(" %6.2f IPC", *ipc);
+    if (auto const rate = bytes_per_cycle(result)) std::printf(" %8.2f B/cycle", *rate);
+    std::printf("\n");
+    std::fflush(stdout);
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+void write_json(std::string const &a_path, std::vector<Result> const &a_results)
+{
+  auto out = std::ofstream{a_path};
+  if (!out) throw std::runtime_error("cannot write " + a_path);
+
+  auto const now = std::time(nullptr);
+  char date[32]{};
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+  out << "{\n  \"context\": {\n"
+      << "    \"date\": \"" << date << "\",\n"
+      << "    \"compiler\": \"" << escaped(compiler_name()) << "\",\n"
+      << "    \"build_type\": \"" << WXLIB_BENCH_BUILD_TYPE << "\",\n"
+      << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+      << "    \"simd_level\": \"" << simd_name() << "\",\n"
+      << "    \"counts_allocations\": " << (counts_allocations() ? "true" : "false") << ",\n"
+      << "    \"counts_events\": " << (counts_events() ? "true" : "false") << "\n  },\n  \"benchmarks\": [";
+
+  auto const *separator = "\n";
+  for (auto const &result : a_results) {
+    auto const &stats = result.stats;
+    out << separator << "    {\"suite\": \"" << escaped(result.suite) << "\", \"name\": \"" << escaped(result.name)
+        << "\", \"iterations\": " << result.iterations << ", \"items\": " << result.work.items
+        << ", \"bytes\": " << result.work.bytes << ",\n     \"ns_per_item\": {\"min\": " << stats.min
+        << ", \"median\": " << stats.median << ", \"mean\": " << stats.mean << ", \"stddev\": " << stats.stddev
+        << ", \"mad\": " << stats.mad << ", \"p90\": " << stats.p90 << "},\n";
+    if (counts_allocations()) {
+      auto const &allocations = result.allocations;
+      out << "     \"allocations_per_item\": {\"count\": " << per_item(allocations.count, result.work)
+          << ", \"bytes\": " << per_item(allocations.bytes, result.work)
+          << ", \"pmr_count\": " << per_item(allocations.pmr_count, result.work)
+          << ", \"pmr_bytes\": " << per_item(allocations.pmr_bytes, result.work) << "},\n";
+    }
+    auto const &counters = result.counters;
+    if (counters.cycles || counters.instructions || counters.page_faults) {
+      auto const *field_separator = "";
+      out << "     \"counters_per_item\": {";
+      auto const field = [&](std::string_view a_name, std::optional<std::uint64_t> a_value) {
+        if (!a_value) return;
+        out << field_separator << '"' << a_name << "\": " << per_item(*a_value, result.work);
+        field_separator = ", ";
+      };
+      field("cycles", counters.cycles);
+      field("instructions", counters.instructions);
+      field("llc_misses", counters.llc_misses);
+      field("dtlb_misses", counters.dtlb_misses);
+      field("branch_misses", counters.branch_misses);
+      field("page_faults", counters.page_faults);
+      out << "},\n";
+      if (auto const ipc = ratio(counters.instructions, counters.cycles)) out << "     \"ipc\": " << *ipc << ",\n";
+      if (auto const rate = bytes_per_cycle(result)) out << "     \"bytes_per_cycle\": " << *rate << ",\n";
+    }
+    out << "     \"samples\": [";
+    for (std::size_t i = 0; i < result.samples.size(); ++i) out << (i ? ", " : "") << result.samples[i];
+    out << "]}";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}// namespace wxlib::bench
+
+namespace {
+
+void print_usage()
+{
+  std::cout << "usage: wxlib_bench [--filter <text>] [--warmup <n>] [--repetitions <n>] [--min-time <seconds>]"
+               " [--json <path>] [--no-counters] [--list]\n";
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  using namespace wxlib::bench;
+
+  auto options = Options{};
+  auto list = false;
+  for (int i = 1; i < argc; ++i) {
+    auto const arg = std::string_view{argv[i]};
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        print_usage();
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--filter") options.filter = value();
+    else if (arg == "--warmup") options.warmup = std::stoul(value());
+    else if (arg == "--repetitions") options.repetitions = std::max<std::size_t>(std::stoul(value()), 1);
+    else if (arg == "--min-time") options.min_time = std::stod(value());
+    else if (arg == "--json") options.json = value();
+    else if (arg == "--no-counters") options.counters = false;
+    else if (arg == "--list") list = true;
+    else {
+      print_usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (list) {
+    for (auto const &benchmark : registry()) std::cout << benchmark.suite << "/" << benchmark.name << "\n";
+    return 0;
+  }
+
+  std::printf("%-44s %15s %12s %8s %20s", "benchmark", "median", "min", "mad", "throughput");
+  if (counts_allocations()) std::printf(" %29s", "per item");
+  std::printf("\n");
+  auto const results = run(options);
+  if (!options.json.empty()) write_json(options.json, results);
+  return 0;
+}
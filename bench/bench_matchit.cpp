@@ -0,0 +1,189 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// matchit suite: the literal, string and interval dispatches of match against the switch,
+// string comparisons and if-chains they replace, on the same random inputs.
+
+#include <bench/bench.hpp>
+#include <matchit/matchit.hpp>
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using namespace matchit;
+using wxlib::bench::Work;
+
+constexpr std::size_t input_count = 1 << 16;
+
+template<typename T, typename MakeT>
+std::vector<T> make_inputs(MakeT &&a_make)
+{
+  auto rng = std::mt19937{42};
+  auto inputs = std::vector<T>(input_count);
+  for (auto &input : inputs) input = a_make(rng);
+  return inputs;
+}
+
+template<typename T, typename F>
+Work dispatch_all(std::size_t a_iterations, std::vector<T> const &a_inputs, F &&a_dispatch)
+{
+  auto sum = int64_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) sum += a_dispatch(a_inputs[i % a_inputs.size()]);
+  wxlib::bench::do_not_optimize(sum);
+  return {a_iterations};
+}
+
+std::vector<int32_t> const &codes()
+{
+  static auto const result = make_inputs<int32_t>([](auto &a_rng) {
+    return std::uniform_int_distribution<int32_t>{0, 8}(a_rng);
+  });
+  return result;
+}
+
+int32_t switch_literal(int32_t a_code)
+{
+  switch (a_code) {
+  case 0: return 30;
+  case 1: return 4;
+  case 2: return 25;
+  case 3: return 2;
+  case 4: return 10;
+  case 5: return 15;
+  case 6: return 7;
+  case 7: return 0;
+  default: return -1;
+  }
+}
+
+int32_t matchit_lit(int32_t a_code)
+{
+  return match(a_code)(
+      pattern | lit<0> = expr(30),
+      pattern | lit<1> = expr(4),
+      pattern | lit<2> = expr(25),
+      pattern | lit<3> = expr(2),
+      pattern | lit<4> = expr(10),
+      pattern | lit<5> = expr(15),
+      pattern | lit<6> = expr(7),
+      pattern | lit<7> = expr(0),
+      pattern | _      = expr(-1)
+  );
+}
+
+int32_t matchit_value(int32_t a_code)
+{
+  return match(a_code)(
+      pattern | 0 = expr(30),
+      pattern | 1 = expr(4),
+      pattern | 2 = expr(25),
+      pattern | 3 = expr(2),
+      pattern | 4 = expr(10),
+      pattern | 5 = expr(15),
+      pattern | 6 = expr(7),
+      pattern | 7 = expr(0),
+      pattern | _ = expr(-1)
+  );
+}
+
+constexpr auto route_names = std::array<std::string_view, 8>{
+    "tram", "subway", "rail", "bus", "ferry", "cable_tram", "gondola", "monorail_express"};
+
+std::vector<std::string_view> const &names()
+{
+  static auto const result = make_inputs<std::string_view>([](auto &a_rng) {
+    return route_names[std::uniform_int_distribution<std::size_t>{0, route_names.size() - 1}(a_rng)];
+  });
+  return result;
+}
+
+int32_t compare_route_type(std::string_view a_name)
+{
+  if (a_name == "tram") return 0;
+  if (a_name == "subway") return 1;
+  if (a_name == "rail") return 2;
+  if (a_name == "bus") return 3;
+  if (a_name == "ferry") return 4;
+  if (a_name == "cable_tram") return 5;
+  return -1;
+}
+
+int32_t matchit_route_type(std::string_view a_name)
+{
+  return match(a_name)(
+      pattern | lit_str<"tram">       = expr(0),
+      pattern | lit_str<"subway">     = expr(1),
+      pattern | lit_str<"rail">       = expr(2),
+      pattern | lit_str<"bus">        = expr(3),
+      pattern | lit_str<"ferry">      = expr(4),
+      pattern | lit_str<"cable_tram"> = expr(5),
+      pattern | _                     = expr(-1)
+  );
+}
+
+std::vector<double> const &speeds()
+{
+  static auto const result = make_inputs<double>([](auto &a_rng) {
+    return std::uniform_real_distribution<double>{0.0, 130.0}(a_rng);
+  });
+  return result;
+}
+
+int32_t if_chain_speed_bin(double a_speed)
+{
+  if (a_speed < 10) return 0;
+  if (a_speed < 30) return 1;
+  if (a_speed < 50) return 2;
+  if (a_speed < 80) return 3;
+  if (a_speed < 110) return 4;
+  return 5;
+}
+
+int32_t matchit_speed_bin(double a_speed)
+{
+  return match(a_speed)(
+      pattern | (_ < 10.0)  = expr(0),
+      pattern | (_ < 30.0)  = expr(1),
+      pattern | (_ < 50.0)  = expr(2),
+      pattern | (_ < 80.0)  = expr(3),
+      pattern | (_ < 110.0) = expr(4),
+      pattern | _           = expr(5)
+  );
+}
+
+[[maybe_unused]] auto const literal_switch = wxlib::bench::add("matchit", "literal/switch", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, codes(), switch_literal);
+});
+
+[[maybe_unused]] auto const literal_lit = wxlib::bench::add("matchit", "literal/lit", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, codes(), matchit_lit);
+});
+
+[[maybe_unused]] auto const literal_value = wxlib::bench::add("matchit", "literal/value", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, codes(), matchit_value);
+});
+
+[[maybe_unused]] auto const string_compare = wxlib::bench::add("matchit", "string/compare_chain", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, names(), compare_route_type);
+});
+
+[[maybe_unused]] auto const string_lit_str = wxlib::bench::add("matchit", "string/lit_str", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, names(), matchit_route_type);
+});
+
+[[maybe_unused]] auto const interval_if_chain = wxlib::bench::add("matchit", "interval/if_chain", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, speeds(), if_chain_speed_bin);
+});
+
+[[maybe_unused]] auto const interval_relation = wxlib::bench::add("matchit", "interval/relation", [](std::size_t a_iterations) {
+  return dispatch_all(a_iterations, speeds(), matchit_speed_bin);
+});
+
+}// namespace
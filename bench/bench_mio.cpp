@@ -0,0 +1,334 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// mio suite: the fast_find kernels against std::find and memchr on the same text, StringReader
+// reading it line by line and asynchronously, and CsvDoc parsing link records and checking
+// their header, shortest path trees on a grid network, and nearest link queries.
+
+#include <bench/bench.hpp>
+#include <mio/csvdoc.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/shortestpath.hpp>
+#include <mio/spatialindex.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using wxlib::bench::Work;
+
+// 16 MiB of lines of 20 to 140 printable chars, so that the newline scans see a mix of
+// short and long distances, as in a traffic log.
+std::string const &text()
+{
+  static auto const result = [] {
+    auto rng = std::mt19937{42};
+    auto length = std::uniform_int_distribution<int>{20, 140};
+    auto printable = std::uniform_int_distribution<int>{' ', '~'};
+    auto lines = std::string{};
+    lines.reserve(16 << 20);
+    while (lines.size() < (16 << 20)) {
+      for (auto n = length(rng); n > 0; --n) lines += static_cast<char>(printable(rng));
+      lines += '\n';
+    }
+    return lines;
+  }();
+  return result;
+}
+
+template<typename FindT>
+Work count_newlines(std::size_t a_iterations, FindT &&a_find)
+{
+  auto const &lines = text();
+  auto count = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    const char *b = lines.data();
+    const char *e = b + lines.size();
+    while ((b = a_find(b, e)) != e) {
+      ++count;
+      ++b;
+    }
+  }
+  wxlib::bench::do_not_optimize(count);
+  return {count, a_iterations * lines.size()};
+}
+
+[[maybe_unused]] auto const std_find = wxlib::bench::add("mio", "find/std::find", [](std::size_t a_iterations) {
+  return count_newlines(a_iterations, [](const char *b, const char *e) { return std::find(b, e, '\n'); });
+});
+
+[[maybe_unused]] auto const memchr_find = wxlib::bench::add("mio", "find/memchr", [](std::size_t a_iterations) {
+  return count_newlines(a_iterations, [](const char *b, const char *e) {
+    auto const *found = static_cast<const char *>(std::memchr(b, '\n', static_cast<std::size_t>(e - b)));
+    return found ? found : e;
+  });
+});
+
+[[maybe_unused]] auto const oct_find = wxlib::bench::add("mio", "find/oct_find", [](std::size_t a_iterations) {
+  return count_newlines(a_iterations, [](const char *b, const char *e) { return mio::oct_find<'\n'>(b, e); });
+});
+
+#if defined(__x86_64__) || defined(_M_X64)
+[[maybe_unused]] auto const avx2_find = mio::simd_level() >= mio::SimdLevel::Avx2
+    && wxlib::bench::add("mio", "find/avx2_find", [](std::size_t a_iterations) {
+         return count_newlines(a_iterations, [](const char *b, const char *e) { return mio::avx2_find<'\n'>(b, e); });
+       });
+
+[[maybe_unused]] auto const avx512_find = mio::simd_level() == mio::SimdLevel::Avx512
+    && wxlib::bench::add("mio", "find/avx512_find", [](std::size_t a_iterations) {
+         return count_newlines(a_iterations, [](const char *b, const char *e) { return mio::avx512_find<'\n'>(b, e); });
+       });
+#endif
+
+[[maybe_unused]] auto const fast_find = wxlib::bench::add("mio", "find/fast_find", [](std::size_t a_iterations) {
+  return count_newlines(a_iterations, [](const char *b, const char *e) { return mio::fast_find<'\n'>(b, e); });
+});
+
+// The readers read the text from memory, so that the numbers do not depend on the page cache.
+[[maybe_unused]] auto const sync_getline = wxlib::bench::add("mio", "StringReader/getline", [](std::size_t a_iterations) {
+  auto const &lines = text();
+  auto count = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto reader = mio::StringReader<>{std::span<const char>{lines}};
+    while (!reader.eof()) {
+      auto line = reader.getline();
+      wxlib::bench::do_not_optimize(line);
+      ++count;
+    }
+  }
+  return Work{count, a_iterations * lines.size()};
+});
+
+[[maybe_unused]] auto const async_getline = wxlib::bench::add("mio", "StringReaderAsync/async_getline", [](std::size_t a_iterations) {
+  auto const &lines = text();
+  auto count = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto reader = mio::StringReaderAsync{std::span<const char>{lines}};
+    count += reader.async_getline([](int, const std::string_view a_line) {
+      wxlib::bench::do_not_optimize(a_line);
+      return 0;
+    }, mio::available_concurrency());
+  }
+  return Work{count, a_iterations * lines.size()};
+});
+
+using namespace mio::csv;
+
+using LinkDoc = CsvDoc<
+    Field<NAME("link_id"), int64_t>,
+    Field<NAME("from_node"), int64_t>,
+    Field<NAME("to_node"), int64_t>,
+    Field<NAME("length"), double>,
+    Field<NAME("lanes"), int32_t>,
+    QuotedField<NAME("name")>>;
+
+std::vector<std::string> const &link_lines()
+{
+  static auto const result = [] {
+    auto rng = std::mt19937{7};
+    auto node = std::uniform_int_distribution<int64_t>{1, 1'000'000};
+    auto length = std::uniform_real_distribution<double>{10.0, 5000.0};
+    auto lanes = std::uniform_int_distribution<int>{1, 6};
+    auto lines = std::vector<std::string>(1 << 14);
+    for (std::size_t i = 0; i < lines.size(); ++i)
+      lines[i] = std::to_string(i) + "," + std::to_string(node(rng)) + "," + std::to_string(node(rng)) + ","
+          + std::to_string(length(rng)) + "," + std::to_string(lanes(rng)) + ",\"Main St, " + std::to_string(i) + "\"";
+    return lines;
+  }();
+  return result;
+}
+
+[[maybe_unused]] auto const make_record = wxlib::bench::add("mio", "CsvDoc/make_record", [](std::size_t a_iterations) {
+  auto const &lines = link_lines();
+  auto doc = LinkDoc{};
+  auto record = LinkDoc::Record{};
+  auto bytes = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto const &line = lines[i % lines.size()];
+    doc.make_record(record, line);
+    wxlib::bench::do_not_optimize(record);
+    bytes += line.size();
+  }
+  return Work{a_iterations, bytes};
+});
+
+[[maybe_unused]] auto const verify_header = wxlib::bench::add("mio", "CsvDoc/VerifyHeader", [](std::size_t a_iterations) {
+  constexpr auto header = std::string_view{"link_id,from_node,to_node,length,lanes,name"};
+  auto doc = LinkDoc{};
+  auto verified = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto result = doc.VerifyHeader(header);
+    verified += std::get<0>(result);
+    wxlib::bench::do_not_optimize(result);
+  }
+  wxlib::bench::do_not_optimize(verified);
+  return Work{a_iterations, a_iterations * header.size()};
+});
+
+// The lines as one block, and its columns allocated from the default std::pmr resource, so
+// that their allocations are counted apart.
+[[maybe_unused]] auto const make_columns = wxlib::bench::add("mio", "CsvDoc/make_columns_pmr", [](std::size_t a_iterations) {
+  static auto const block = [] {
+    auto result = std::string{};
+    for (auto const &line : link_lines()) result.append(line).push_back('\n');
+    return result;
+  }();
+  auto doc = LinkDoc{};
+  auto records = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto columns = LinkDoc::make_pmr_columns(std::pmr::get_default_resource());
+    records += doc.make_columns(block, columns);
+    wxlib::bench::do_not_optimize(columns);
+  }
+  return Work{records, a_iterations * block.size()};
+});
+
+// A grid of 300 x 300 nodes, with links both ways between neighbours, of random weights.
+struct Grid
+{
+  std::vector<uint64_t> offsets{0};
+  std::vector<uint32_t> heads{};
+  std::vector<double> weights{};
+};
+
+Grid const &grid()
+{
+  static auto const result = [] {
+    constexpr uint32_t side = 300;
+    auto rng = std::mt19937{3};
+    auto weight = std::uniform_real_distribution<double>{1.0, 10.0};
+    auto g = Grid{};
+    for (uint32_t r = 0; r < side; ++r) {
+      for (uint32_t c = 0; c < side; ++c) {
+        auto const add = [&](uint32_t a_node) {
+          g.heads.push_back(a_node);
+          g.weights.push_back(weight(rng));
+        };
+        if (c > 0) add(r * side + c - 1);
+        if (c + 1 < side) add(r * side + c + 1);
+        if (r > 0) add((r - 1) * side + c);
+        if (r + 1 < side) add((r + 1) * side + c);
+        g.offsets.push_back(g.heads.size());
+      }
+    }
+    return g;
+  }();
+  return result;
+}
+
+[[maybe_unused]] auto const shortest_path_tree = wxlib::bench::add("mio", "ShortestPaths/tree", [](std::size_t a_iterations) {
+  auto const &g = grid();
+  auto const paths = mio::ShortestPaths{g.offsets, g.heads, g.weights};
+  auto tree = mio::ShortestPathTree{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    paths.tree(static_cast<uint32_t>(i * 7919 % paths.node_count()), tree);
+    wxlib::bench::do_not_optimize(tree.costs().back());
+  }
+  return Work{a_iterations, 0};
+});
+
+[[maybe_unused]] auto const shortest_path_trees = wxlib::bench::add("mio", "ShortestPaths/trees", [](std::size_t a_iterations) {
+  auto const &g = grid();
+  auto const paths = mio::ShortestPaths{g.offsets, g.heads, g.weights};
+  auto origins = std::vector<uint32_t>(a_iterations);
+  for (std::size_t i = 0; i < a_iterations; ++i) origins[i] = static_cast<uint32_t>(i * 7919 % paths.node_count());
+  auto total = std::atomic<double>{0.0};
+  paths.trees(origins, [&](std::size_t, std::size_t, mio::ShortestPathTree const &a_tree) {
+    total.fetch_add(a_tree.costs().back(), std::memory_order_relaxed);
+  }, mio::available_concurrency());
+  wxlib::bench::do_not_optimize(total.load());
+  return Work{a_iterations, 0};
+});
+
+[[maybe_unused]] auto const delta_stepping = wxlib::bench::add("mio", "ShortestPaths/delta_stepping", [](std::size_t a_iterations) {
+  auto const &g = grid();
+  auto const paths = mio::ShortestPaths{g.offsets, g.heads, g.weights};
+  auto tree = mio::ShortestPathTree{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    paths.delta_stepping(static_cast<uint32_t>(i * 7919 % paths.node_count()), tree, 0.0, mio::available_concurrency());
+    wxlib::bench::do_not_optimize(tree.costs().back());
+  }
+  return Work{a_iterations, 0};
+});
+
+// 100,000 polylines of 2 to 6 points on a 50 km square, as the link geometries of a region.
+struct Polylines
+{
+  std::vector<uint64_t> offsets{0};
+  std::vector<double> xs{};
+  std::vector<double> ys{};
+};
+
+Polylines const &polylines()
+{
+  static auto const result = [] {
+    auto rng = std::mt19937{5};
+    auto position = std::uniform_real_distribution<double>{0.0, 50000.0};
+    auto step = std::uniform_real_distribution<double>{-60.0, 60.0};
+    auto points = std::uniform_int_distribution<int>{2, 6};
+    auto p = Polylines{};
+    for (int l = 0; l < 100'000; ++l) {
+      auto x = position(rng), y = position(rng);
+      for (auto n = points(rng); n > 0; --n, x += step(rng), y += step(rng)) {
+        p.xs.push_back(x);
+        p.ys.push_back(y);
+      }
+      p.offsets.push_back(p.xs.size());
+    }
+    return p;
+  }();
+  return result;
+}
+
+template<typename IndexT>
+Work nearest_links(std::size_t a_iterations, IndexT const &a_index)
+{
+  auto rng = std::mt19937{9};
+  auto position = std::uniform_real_distribution<double>{0.0, 50000.0};
+  auto found = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) found += static_cast<bool>(a_index.nearest(position(rng), position(rng), 500.0));
+  wxlib::bench::do_not_optimize(found);
+  return Work{a_iterations, 0};
+}
+
+[[maybe_unused]] auto const rtree_nearest = wxlib::bench::add("mio", "PackedRTree/nearest", [](std::size_t a_iterations) {
+  static auto const tree = [] {
+    auto result = std::make_unique<mio::PackedRTree>();
+    result->build(polylines().offsets, polylines().xs, polylines().ys);
+    return result;
+  }();
+  return nearest_links(a_iterations, *tree);
+});
+
+[[maybe_unused]] auto const grid_nearest = wxlib::bench::add("mio", "SpatialGrid/nearest", [](std::size_t a_iterations) {
+  static auto const grid = [] {
+    auto result = mio::SpatialGrid{};
+    result.build(polylines().offsets, polylines().xs, polylines().ys);
+    return result;
+  }();
+  return nearest_links(a_iterations, grid);
+});
+
+[[maybe_unused]] auto const rtree_build = wxlib::bench::add("mio", "PackedRTree/build", [](std::size_t a_iterations) {
+  auto const &p = polylines();
+  auto tree = mio::PackedRTree{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    tree.build(p.offsets, p.xs, p.ys, mio::available_concurrency());
+    wxlib::bench::do_not_optimize(tree.node_count());
+  }
+  return Work{a_iterations * tree.segment_count(), 0};
+});
+
+}// namespace
@@ -0,0 +1,146 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// msgpack suite: packing and unpacking a link state with a fixed layout, a vehicle trajectory
+// whose size varies with its number of points, and a transit route of nested stop objects.
+
+#include <bench/bench.hpp>
+#include <msgpack/msgpack.hpp>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using wxlib::bench::Work;
+
+struct LinkState
+{
+  int32_t link_id{};
+  int32_t queue_length{};
+  double density{};
+  double flow{};
+  bool blocked{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(link_id, queue_length, density, flow, blocked);
+  }
+};
+
+struct Trajectory
+{
+  int64_t vehicle_id{};
+  std::string route{};
+  std::vector<double> times{};
+  std::vector<double> offsets{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(vehicle_id, route, times, offsets);
+  }
+};
+
+struct Stop
+{
+  int32_t stop_id{};
+  double arrival{};
+  std::string name{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(stop_id, arrival, name);
+  }
+};
+
+struct Route
+{
+  int32_t route_id{};
+  std::vector<Stop> stops{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(route_id, stops);
+  }
+};
+
+LinkState make_link_state()
+{
+  return {4711, 12, 35.5, 1800.0, false};
+}
+
+Trajectory make_trajectory()
+{
+  auto rng = std::mt19937{42};
+  auto step = std::uniform_real_distribution<double>{0.5, 2.0};
+  auto trajectory = Trajectory{90210, "route 66 eastbound"};
+  for (auto t = 0.0, x = 0.0; trajectory.times.size() < 256; t += 1.0, x += step(rng)) {
+    trajectory.times.push_back(t);
+    trajectory.offsets.push_back(x);
+  }
+  return trajectory;
+}
+
+Route make_route()
+{
+  auto route = Route{42};
+  for (int32_t i = 0; i < 32; ++i) route.stops.push_back({i, 60.0 * i, "Stop " + std::to_string(i)});
+  return route;
+}
+
+template<typename T>
+Work pack_many(std::size_t a_iterations, T a_object)
+{
+  auto bytes = std::size_t{};
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto data = msgpack::pack(a_object);
+    bytes += data.size();
+    wxlib::bench::do_not_optimize(data);
+  }
+  return {a_iterations, bytes};
+}
+
+template<typename T>
+Work unpack_many(std::size_t a_iterations, T a_object)
+{
+  auto const data = msgpack::pack(a_object);
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    auto object = msgpack::unpack<T>(data);
+    wxlib::bench::do_not_optimize(object);
+  }
+  return {a_iterations, a_iterations * data.size()};
+}
+
+[[maybe_unused]] auto const pack_link_state = wxlib::bench::add("msgpack", "pack/LinkState", [](std::size_t a_iterations) {
+  return pack_many(a_iterations, make_link_state());
+});
+
+[[maybe_unused]] auto const unpack_link_state = wxlib::bench::add("msgpack", "unpack/LinkState", [](std::size_t a_iterations) {
+  return unpack_many(a_iterations, make_link_state());
+});
+
+[[maybe_unused]] auto const pack_trajectory = wxlib::bench::add("msgpack", "pack/Trajectory", [](std::size_t a_iterations) {
+  return pack_many(a_iterations, make_trajectory());
+});
+
+[[maybe_unused]] auto const unpack_trajectory = wxlib::bench::add("msgpack", "unpack/Trajectory", [](std::size_t a_iterations) {
+  return unpack_many(a_iterations, make_trajectory());
+});
+
+[[maybe_unused]] auto const pack_route = wxlib::bench::add("msgpack", "pack/Route", [](std::size_t a_iterations) {
+  return pack_many(a_iterations, make_route());
+});
+
+[[maybe_unused]] auto const unpack_route = wxlib::bench::add("msgpack", "unpack/Route", [](std::size_t a_iterations) {
+  return unpack_many(a_iterations, make_route());
+});
+
+}// namespace
@@ -0,0 +1,62 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// semimap suite: semi::static_map lookups with C++ literal keys, which resolve at compile
+// time, against run-time keys of the same map, and against a std::unordered_map.
+
+#include <bench/bench.hpp>
+#include <semimap/semimap.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#define ID(x) \
+    []() constexpr { return x; }
+
+namespace {
+
+using wxlib::bench::Work;
+
+struct Tag
+{
+};
+
+using Counters = semi::static_map<std::string, uint64_t, Tag>;
+
+constexpr auto keys = std::array<std::string_view, 4>{"links_read", "nodes_read", "zones_read", "trips_read"};
+
+[[maybe_unused]] auto const literal_keys = wxlib::bench::add("semimap", "static_map/literal_key", [](std::size_t a_iterations) {
+  for (std::size_t i = 0; i < a_iterations; ++i) {
+    Counters::get(ID("links_read")) += i;
+    Counters::get(ID("nodes_read")) += 1;
+    Counters::get(ID("zones_read")) += 2;
+    Counters::get(ID("trips_read")) += 3;
+  }
+  wxlib::bench::do_not_optimize(Counters::get(ID("links_read")));
+  return Work{4 * a_iterations};
+});
+
+[[maybe_unused]] auto const runtime_keys = wxlib::bench::add("semimap", "static_map/runtime_key", [](std::size_t a_iterations) {
+  for (std::size_t i = 0; i < a_iterations; ++i)
+    for (auto key : keys) Counters::get(key) += i;
+  wxlib::bench::do_not_optimize(Counters::get(keys[0]));
+  return Work{keys.size() * a_iterations};
+});
+
+[[maybe_unused]] auto const unordered_map = wxlib::bench::add("semimap", "std::unordered_map", [](std::size_t a_iterations) {
+  auto counters = std::unordered_map<std::string, uint64_t>{};
+  for (auto key : keys) counters.emplace(key, 0);
+  auto names = std::array<std::string, keys.size()>{};
+  for (std::size_t k = 0; k < keys.size(); ++k) names[k] = keys[k];
+  for (std::size_t i = 0; i < a_iterations; ++i)
+    for (auto const &name : names) counters[name] += i;
+  wxlib::bench::do_not_optimize(counters);
+  return Work{keys.size() * a_iterations};
+});
+
+}// namespace
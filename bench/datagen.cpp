@@ -0,0 +1,123 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// wxlib_datagen writes a synthetic GMNS-style data set, see wxlib::datagen::Dataset, for the
+// benchmarks to read at scale: node.csv and link.csv with quoted WKT geometries, trajectory.csv
+// with a row per point, and the same trajectories as msgpack and zpp_bits message corpora, e.g.
+//
+//   ./bench/wxlib_datagen --out /data/bench --nodes-per-side 10000 --agents 20000000
+//
+// writes 100 million nodes, 400 million links and 1.28 billion trajectory points, some 100 GB.
+// The files only depend on the options, not on the number of threads writing them.
+
+#include <bench/datagen.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using namespace wxlib::datagen;
+
+struct Options
+{
+  Dataset set{};
+  std::filesystem::path out{"."};
+  std::string formats{"csv,msgpack,zpp"};
+  uint64_t block_rows{1 << 15};
+};
+
+void print_usage()
+{
+  std::cout << "usage: wxlib_datagen [--out <dir>] [--nodes-per-side <n>] [--agents <n>] [--points-per-agent <n>]"
+               " [--seed <n>] [--formats csv,msgpack,zpp] [--block-rows <n>]\n";
+}
+
+template<typename BufferT, typename FillT>
+bool generate(const std::filesystem::path &a_file, uint64_t a_rows, uint64_t a_block_rows, const FillT &a_fill)
+{
+  const auto start = std::chrono::steady_clock::now();
+  auto error = std::error_code{};
+  const auto size = write_blocks<BufferT>(a_file.string(), a_rows, a_block_rows, a_fill, error);
+  const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (error) {
+    std::fprintf(stderr, "%s: %s\n", a_file.string().c_str(), error.message().c_str());
+    return false;
+  }
+
+  std::printf("%-32s %14llu rows %10.2f GB %8.2f s %8.2f GB/s\n", a_file.filename().string().c_str(),
+              static_cast<unsigned long long>(a_rows), static_cast<double>(size) / 1e9, seconds,
+              static_cast<double>(size) / 1e9 / std::max(seconds, 1e-9));
+  std::fflush(stdout);
+  return true;
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  auto options = Options{};
+  for (int i = 1; i < argc; ++i) {
+    auto const arg = std::string_view{argv[i]};
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        print_usage();
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--out") options.out = value();
+    else if (arg == "--nodes-per-side") options.set.nodes_per_side = std::max<uint64_t>(std::stoull(value()), 1);
+    else if (arg == "--agents") options.set.agents = std::stoull(value());
+    else if (arg == "--points-per-agent") options.set.points_per_agent = std::max<uint64_t>(std::stoull(value()), 1);
+    else if (arg == "--seed") options.set.seed = std::stoull(value());
+    else if (arg == "--formats") options.formats = value();
+    else if (arg == "--block-rows") options.block_rows = std::stoull(value());
+    else {
+      print_usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  auto created = std::error_code{};
+  std::filesystem::create_directories(options.out, created);
+  if (created) {
+    std::fprintf(stderr, "%s: %s\n", options.out.string().c_str(), created.message().c_str());
+    return 1;
+  }
+
+  const auto &set = options.set;
+  const auto wants = [&](std::string_view a_format) { return options.formats.find(a_format) != std::string::npos; };
+  auto ok = true;
+
+  if (wants("csv")) {
+    ok = ok && generate<SegmentBuffer<NodeWriter>>(options.out / "node.csv", set.node_count(), options.block_rows,
+        [&](uint64_t a_first, uint64_t a_last, auto &a_out, std::error_code &) { append_nodes(set, a_first, a_last, a_out); });
+    ok = ok && generate<SegmentBuffer<LinkWriter>>(options.out / "link.csv", set.link_count(), options.block_rows,
+        [&](uint64_t a_first, uint64_t a_last, auto &a_out, std::error_code &) { append_links(set, a_first, a_last, a_out); });
+    ok = ok && generate<SegmentBuffer<TrajectoryWriter>>(options.out / "trajectory.csv", set.point_count(), options.block_rows,
+        [&](uint64_t a_first, uint64_t a_last, auto &a_out, std::error_code &) { append_points(set, a_first, a_last, a_out); });
+  }
+
+  // A message holds all points of an agent, so blocks of messages are smaller by as much.
+  const auto agent_block = std::max<uint64_t>(options.block_rows / set.points_per_agent, 1);
+  if (wants("msgpack")) {
+    ok = ok && generate<std::vector<uint8_t>>(options.out / "trajectory.mpk", set.agents, agent_block,
+        [&](uint64_t a_first, uint64_t a_last, auto &a_out, std::error_code &a_ec) { append_msgpack(set, a_first, a_last, a_out, a_ec); });
+  }
+  if (wants("zpp")) {
+    ok = ok && generate<std::vector<uint8_t>>(options.out / "trajectory.zpp", set.agents, agent_block,
+        [&](uint64_t a_first, uint64_t a_last, auto &a_out, std::error_code &a_ec) { append_zpp_bits(set, a_first, a_last, a_out, a_ec); });
+  }
+
+  return ok ? 0 : 1;
+}
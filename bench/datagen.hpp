@@ -0,0 +1,360 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_BENCH_DATAGEN_HPP
+#define WXLIB_BENCH_DATAGEN_HPP
+
+#include <mio/csvwriter.hpp>
+#include <mio/executor.hpp>
+#include <mio/mio.hpp>
+#include <msgpack/framedreader.hpp>
+#include <zpp_bits/zpp_bits.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace wxlib::datagen {
+
+using namespace mio::csv;
+
+/*!
+  A synthetic network of GMNS-style nodes on a square grid of side nodes_per_side, each with
+  four directed links to its neighbours, the one across an edge of the grid turned back to the
+  opposite neighbour, and of agents driving points_per_agent links each. Every row is a
+  function of the seed and its index only, so the files are the same whatever the number of
+  threads writing them.
+*/
+struct Dataset
+{
+  uint64_t nodes_per_side{1000};
+  uint64_t agents{100'000};
+  uint64_t points_per_agent{64};
+  uint64_t seed{42};
+  double spacing{250.0};
+
+  [[nodiscard]] uint64_t node_count() const noexcept
+  {
+    return nodes_per_side * nodes_per_side;
+  }
+
+  [[nodiscard]] uint64_t link_count() const noexcept
+  {
+    return 4 * node_count();
+  }
+
+  [[nodiscard]] uint64_t point_count() const noexcept
+  {
+    return agents * points_per_agent;
+  }
+};
+
+using NodeWriter = CsvWriter<
+    Field<NAME("node_id"), int64_t>,
+    Field<NAME("zone_id"), int64_t>,
+    Field<NAME("x_coord"), double>,
+    Field<NAME("y_coord"), double>,
+    Field<NAME("node_type")>,
+    QuotedField<NAME("WKT")>>;
+
+using LinkWriter = CsvWriter<
+    Field<NAME("link_id"), int64_t>,
+    Field<NAME("from_node_id"), int64_t>,
+    Field<NAME("to_node_id"), int64_t>,
+    Field<NAME("directed"), bool>,
+    Field<NAME("length"), double>,
+    Field<NAME("lanes"), int32_t>,
+    Field<NAME("free_speed"), double>,
+    Field<NAME("capacity"), double>,
+    QuotedField<NAME("WKT")>>;
+
+using TrajectoryWriter = CsvWriter<
+    Field<NAME("agent_id"), int64_t>,
+    Field<NAME("seq"), int32_t>,
+    Field<NAME("link_id"), int64_t>,
+    Field<NAME("time"), double>,
+    Field<NAME("speed"), double>>;
+
+/*!
+  A waypoint of the trajectory messages, the same fields as a row of the trajectory csv.
+*/
+struct Waypoint
+{
+  int64_t link_id;
+  double time;
+  double speed;
+};
+
+/*!
+  The message of the msgpack and zpp_bits corpora, one per agent.
+*/
+struct Trajectory
+{
+  int64_t agent_id;
+  std::string vehicle_class;
+  std::vector<Waypoint> waypoints;
+};
+
+/*!
+  Counter based random numbers, splitmix64 of the seed and a row and a stream index, so that
+  a row is generated without the rows before it.
+*/
+inline uint64_t random_of(uint64_t a_seed, uint64_t a_row, uint64_t a_stream = 0) noexcept
+{
+  auto z = a_seed + 0x9E3779B97F4A7C15ULL * (a_row * 8 + a_stream + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*!
+  Uniform in [0, 1), from the top 53 bits of random_of.
+*/
+inline double uniform_of(uint64_t a_seed, uint64_t a_row, uint64_t a_stream = 0) noexcept
+{
+  return static_cast<double>(random_of(a_seed, a_row, a_stream) >> 11) * 0x1.0p-53;
+}
+
+inline void append_number(std::string &a_out, double a_value)
+{
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), a_value, std::chars_format::fixed, 2);
+  a_out.append(buf, ptr);
+}
+
+struct Point
+{
+  double x;
+  double y;
+};
+
+/*!
+  The coordinates of a node, on its grid position jittered by up to a fifth of the spacing.
+*/
+inline Point node_point(const Dataset &a_set, uint64_t a_node) noexcept
+{
+  const auto column = a_node % a_set.nodes_per_side;
+  const auto row = a_node / a_set.nodes_per_side;
+  const auto jitter = a_set.spacing / 5;
+  return {std::round((static_cast<double>(column) * a_set.spacing + (uniform_of(a_set.seed, a_node, 0) - 0.5) * jitter) * 100) / 100,
+          std::round((static_cast<double>(row) * a_set.spacing + (uniform_of(a_set.seed, a_node, 1) - 0.5) * jitter) * 100) / 100};
+}
+
+/*!
+  The head node of a link, the east, west, north or south neighbour of its tail node, or the
+  opposite one at an edge of the grid.
+*/
+inline uint64_t to_node(const Dataset &a_set, uint64_t a_link) noexcept
+{
+  const auto n = a_set.nodes_per_side;
+  const auto from = a_link / 4;
+  if (n == 1) return from;
+
+  const auto column = from % n;
+  const auto row = from / n;
+  const auto east = column + 1 < n ? column + 1 : column - 1;
+  const auto west = column > 0 ? column - 1 : column + 1;
+  const auto north = row + 1 < n ? row + 1 : row - 1;
+  const auto south = row > 0 ? row - 1 : row + 1;
+  switch (a_link % 4) {
+  case 0: return row * n + east;
+  case 1: return row * n + west;
+  case 2: return north * n + column;
+  default: return south * n + column;
+  }
+}
+
+inline void append_nodes(const Dataset &a_set, uint64_t a_first, uint64_t a_last, NodeWriter::Segment &a_out)
+{
+  if (a_first == 0) a_out.write_header();
+  auto wkt = std::string{};
+  for (auto node = a_first; node < a_last; ++node) {
+    const auto [x, y] = node_point(a_set, node);
+    wkt.assign("POINT (");
+    append_number(wkt, x);
+    wkt.push_back(' ');
+    append_number(wkt, y);
+    wkt.push_back(')');
+
+    const auto zone = static_cast<int64_t>(node % a_set.nodes_per_side / 10 + node / a_set.nodes_per_side / 10 * 1000 + 1);
+    const auto is_centroid = random_of(a_set.seed, node, 2) % 50 == 0;
+    a_out.write_row(static_cast<int64_t>(node + 1), zone, x, y, is_centroid ? "centroid" : "intersection", wkt);
+  }
+}
+
+inline void append_links(const Dataset &a_set, uint64_t a_first, uint64_t a_last, LinkWriter::Segment &a_out)
+{
+  if (a_first == 0) a_out.write_header();
+  auto wkt = std::string{};
+  for (auto link = a_first; link < a_last; ++link) {
+    const auto from = link / 4;
+    const auto to = to_node(a_set, link);
+    const auto a = node_point(a_set, from);
+    const auto b = node_point(a_set, to);
+    wkt.assign("LINESTRING (");
+    append_number(wkt, a.x);
+    wkt.push_back(' ');
+    append_number(wkt, a.y);
+    wkt.append(", ");
+    append_number(wkt, b.x);
+    wkt.push_back(' ');
+    append_number(wkt, b.y);
+    wkt.push_back(')');
+
+    const auto lanes = static_cast<int32_t>(1 + random_of(a_set.seed, link, 3) % 4);
+    const auto free_speed = lanes > 2 ? 100.0 : 50.0;
+    const auto length = std::round(std::hypot(b.x - a.x, b.y - a.y) * 100) / 100;
+    a_out.write_row(static_cast<int64_t>(link + 1), static_cast<int64_t>(from + 1), static_cast<int64_t>(to + 1), true,
+                    length, lanes, free_speed, lanes * 1800.0, wkt);
+  }
+}
+
+/*!
+  The waypoint of a point of an agent: the agent starts on a random node and takes the east or
+  the north link of one node after the other along its row or column, back from the start of
+  it past the edge, at a speed between 8 and 28 m/s.
+*/
+inline Waypoint waypoint_of(const Dataset &a_set, uint64_t a_agent, uint64_t a_seq) noexcept
+{
+  const auto start = random_of(a_set.seed, a_agent, 4) % a_set.node_count();
+  const auto heading = random_of(a_set.seed, a_agent, 5) % 2 == 0 ? 0u : 2u;
+  const auto departure = std::floor(uniform_of(a_set.seed, a_agent, 6) * 86'400);
+
+  const auto n = a_set.nodes_per_side;
+  const auto node = heading == 0 ? start / n * n + (start % n + a_seq) % n : (start / n + a_seq) % n * n + start % n;
+  const auto row = a_agent * a_set.points_per_agent + a_seq;
+  const auto speed = std::round((8.0 + uniform_of(a_set.seed, row, 7) * 20.0) * 100) / 100;
+  return {static_cast<int64_t>(node * 4 + heading + 1), departure + static_cast<double>(a_seq) * a_set.spacing / 14.0, speed};
+}
+
+inline void append_points(const Dataset &a_set, uint64_t a_first, uint64_t a_last, TrajectoryWriter::Segment &a_out)
+{
+  if (a_first == 0) a_out.write_header();
+  for (auto row = a_first; row < a_last; ++row) {
+    const auto agent = row / a_set.points_per_agent;
+    const auto seq = row % a_set.points_per_agent;
+    const auto point = waypoint_of(a_set, agent, seq);
+    a_out.write_row(static_cast<int64_t>(agent + 1), static_cast<int32_t>(seq), point.link_id,
+                    std::round(point.time * 100) / 100, point.speed);
+  }
+}
+
+inline Trajectory trajectory_of(const Dataset &a_set, uint64_t a_agent)
+{
+  auto trajectory = Trajectory{static_cast<int64_t>(a_agent + 1),
+                               random_of(a_set.seed, a_agent, 2) % 10 == 0 ? "heavy-goods-vehicle" : "passenger-car", {}};
+  trajectory.waypoints.reserve(a_set.points_per_agent);
+  for (uint64_t seq = 0; seq < a_set.points_per_agent; ++seq) trajectory.waypoints.push_back(waypoint_of(a_set, a_agent, seq));
+  return trajectory;
+}
+
+/*!
+  Appends the trajectories of agents [a_first, a_last) as a Framing::LengthPrefixed log, which
+  msgpack::FramedReader reads back in parallel.
+*/
+inline void append_msgpack(const Dataset &a_set, uint64_t a_first, uint64_t a_last, std::vector<uint8_t> &a_out, std::error_code &a_ec)
+{
+  for (auto agent = a_first; agent < a_last && !a_ec; ++agent) msgpack::append_framed(a_out, trajectory_of(a_set, agent), a_ec);
+}
+
+/*!
+  Appends the trajectories of agents [a_first, a_last) back to back with zpp::bits::out.
+*/
+inline void append_zpp_bits(const Dataset &a_set, uint64_t a_first, uint64_t a_last, std::vector<uint8_t> &a_out, std::error_code &a_ec)
+{
+  auto out = zpp::bits::out{a_out, zpp::bits::append{}};
+  for (auto agent = a_first; agent < a_last && !a_ec; ++agent)
+    if (auto result = out(trajectory_of(a_set, agent)); zpp::bits::failure(result))
+      a_ec = std::make_error_code(result);
+}
+
+/*!
+  Writes rows [0, a_rows) to a file through mio::mmap_sink, on mio::Executor::shared(). The rows
+  are formatted in blocks of a_block_rows by a_fill(first, last, buffer, error), a few blocks per
+  worker at a time; then the file is extended by the size of these blocks, and the workers copy
+  them into a mapping of the new region in parallel. Memory use is bounded by the blocks of one
+  such round, whatever the size of the file.
+  @return The size of the file written.
+*/
+template<typename BufferT, typename FillT>
+uint64_t write_blocks(const std::string &a_file, uint64_t a_rows, uint64_t a_block_rows, const FillT &a_fill, std::error_code &a_ec)
+{
+  {
+    std::ofstream create(a_file, std::ios::binary | std::ios::trunc);
+    if (!create) {
+      a_ec = std::make_error_code(std::errc::io_error);
+      return 0;
+    }
+  }
+
+  auto &executor = mio::Executor::shared();
+  const auto block_rows = std::max<uint64_t>(a_block_rows, 1);
+  const auto block_count = (a_rows + block_rows - 1) / block_rows;
+  const auto round_blocks = 2 * (executor.size() + 1);
+
+  auto buffers = std::vector<BufferT>(round_blocks);
+  auto errors = std::vector<std::error_code>(round_blocks);
+  auto offsets = std::vector<uint64_t>(round_blocks + 1);
+  auto size = uint64_t{0};
+
+  for (uint64_t first_block = 0; first_block < block_count && !a_ec; first_block += round_blocks) {
+    const auto blocks = std::min<uint64_t>(round_blocks, block_count - first_block);
+    executor.parallel_for(0, blocks, [&](size_t a_begin, size_t a_end) {
+      for (auto k = a_begin; k < a_end; ++k) {
+        const auto first = (first_block + k) * block_rows;
+        buffers[k].clear();
+        a_fill(first, std::min(first + block_rows, a_rows), buffers[k], errors[k]);
+      }
+    }, 1);
+
+    for (uint64_t k = 0; k < blocks; ++k) {
+      if (errors[k] && !a_ec) a_ec = errors[k];
+      offsets[k + 1] = offsets[k] + buffers[k].size();
+    }
+    if (a_ec || offsets[blocks] == 0) continue;
+
+    std::filesystem::resize_file(a_file, size + offsets[blocks], a_ec);
+    if (a_ec) break;
+
+    auto sink = mio::mmap_sink{};
+    sink.map(a_file, size, offsets[blocks], a_ec);
+    if (a_ec) break;
+
+    executor.parallel_for(0, blocks, [&](size_t a_begin, size_t a_end) {
+      for (auto k = a_begin; k < a_end; ++k)
+        std::memcpy(sink.data() + offsets[k], buffers[k].data(), buffers[k].size());
+    }, 1);
+    size += offsets[blocks];
+  }
+
+  return size;
+}
+
+/*!
+  Adapts a CsvWriter::Segment to write_blocks, which only needs its text.
+*/
+template<typename WriterT>
+struct SegmentBuffer : WriterT::Segment
+{
+  [[nodiscard]] const char *data() const noexcept
+  {
+    return WriterT::Segment::data.data();
+  }
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return WriterT::Segment::data.size();
+  }
+};
+
+}// namespace wxlib::datagen
+
+#endif// WXLIB_BENCH_DATAGEN_HPP
@@ -0,0 +1,281 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// wxlib_scaling sweeps StringReaderAsync::async_getline over thread counts, partition policies,
+// file sizes and callback costs, to show where make_partitions stops scaling and what the
+// chunked work queue buys on given hardware, e.g.
+//
+//   ./bench/wxlib_scaling --sizes 16M,1G,64G --costs 0,16,256 --csv scaling.csv
+//
+// The equal policy is async_getline(callback, threads), which cuts the file into one partition
+// per thread; chunked:<size> is async_getline(callback, threads, size), the workers claiming
+// chunks of that size from a shared queue. The callback hashes each line, then rehashes it
+// --costs rounds, from trivial to heavy.
+//
+// The generated files vary their line lengths over the file, from 10 to 250 chars, so that
+// equal partitions hold uneven numbers of lines and cost uneven callback time, as logs of a
+// simulation whose traffic peaks do. A file larger than RAM is read from disk once the page
+// cache is exhausted, which is the point of sizes up to 10x RAM; --file reads existing files
+// instead, e.g. those wxlib_datagen writes.
+//
+// Each point is the median of --repetitions reads, reported as MB/s, its speedup over the
+// fewest threads of the same policy, the skew of the workers' busy times (busiest over mean, see
+// ReaderStats::skew), and the tail, the time between the first and the last worker finishing,
+// as a fraction of the read. --csv writes the same table, to plot throughput and tail by
+// policy against threads.
+
+#include <bench/bench.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Policy
+{
+  std::string name;
+  std::size_t chunk_size{0};// 0 for the equal partitions
+};
+
+struct Options
+{
+  std::vector<std::uint64_t> sizes{std::uint64_t{16} << 20, std::uint64_t{512} << 20};
+  std::vector<std::string> files{};
+  std::vector<std::size_t> threads{};
+  std::vector<std::uint64_t> costs{0, 16, 256};
+  std::vector<Policy> policies{{"equal", 0}, {"chunked:1M", std::size_t{1} << 20}, {"chunked:8M", mio::StringReaderAsync::default_chunk_size}};
+  std::size_t repetitions{3};
+  std::filesystem::path dir{std::filesystem::temp_directory_path()};
+  std::string csv{};
+  bool keep{false};
+};
+
+struct Point
+{
+  double seconds{};
+  double skew{};
+  double tail{};
+  std::size_t lines{};
+};
+
+void print_usage()
+{
+  std::cout << "usage: wxlib_scaling [--sizes 16M,512M,...] [--file <path>]... [--threads 1,2,4,...]"
+               " [--costs 0,16,256] [--chunk-sizes 1M,8M] [--repetitions <n>] [--dir <dir>] [--csv <path>] [--keep]\n";
+}
+
+// A size with an optional K, M or G suffix, in powers of 1024.
+std::uint64_t size_of(std::string_view a_text)
+{
+  auto value = std::stoull(std::string{a_text});
+  switch (a_text.empty() ? '\0' : a_text.back()) {
+  case 'G': case 'g': return value << 30;
+  case 'M': case 'm': return value << 20;
+  case 'K': case 'k': return value << 10;
+  default: return value;
+  }
+}
+
+std::vector<std::uint64_t> sizes_of(std::string_view a_list)
+{
+  auto result = std::vector<std::uint64_t>{};
+  while (!a_list.empty()) {
+    auto const comma = std::min(a_list.find(','), a_list.size());
+    if (comma > 0) result.push_back(size_of(a_list.substr(0, comma)));
+    a_list.remove_prefix(std::min(comma + 1, a_list.size()));
+  }
+  return result;
+}
+
+std::string label_of(std::uint64_t a_size)
+{
+  if (a_size >= (std::uint64_t{1} << 30) && a_size % (std::uint64_t{1} << 30) == 0) return std::to_string(a_size >> 30) + "G";
+  if (a_size >= (std::uint64_t{1} << 20) && a_size % (std::uint64_t{1} << 20) == 0) return std::to_string(a_size >> 20) + "M";
+  return std::to_string(a_size);
+}
+
+// Writes a_size bytes of printable lines, block by block, the mean line length of each 1 MiB
+// block following a slow wave over the file. An existing file of that size is reused.
+bool write_text(std::filesystem::path const &a_file, std::uint64_t a_size)
+{
+  auto error = std::error_code{};
+  if (std::filesystem::file_size(a_file, error) == a_size && !error) return true;
+
+  auto out = std::ofstream{a_file, std::ios::binary | std::ios::trunc};
+  auto block = std::string{};
+  constexpr auto block_size = std::size_t{1} << 20;
+  for (std::uint64_t written = 0, i = 0; out && written < a_size; ++i) {
+    auto rng = std::mt19937_64{i};
+    auto const mean = 130.0 + 120.0 * std::sin(static_cast<double>(i) * 2.0 * 3.141592653589793 / 256.0);
+    auto length = std::uniform_int_distribution<int>{static_cast<int>(mean * 0.5) + 5, static_cast<int>(mean * 1.5) + 5};
+    auto printable = std::uniform_int_distribution<int>{' ', '~'};
+    block.clear();
+    while (block.size() < block_size) {
+      for (auto n = length(rng); n > 0; --n) block += static_cast<char>(printable(rng));
+      block += '\n';
+    }
+    auto const n = static_cast<std::size_t>(std::min<std::uint64_t>(block.size(), a_size - written));
+    if (n < block.size() && n > 0) block[n - 1] = '\n';
+    out.write(block.data(), static_cast<std::streamsize>(n));
+    written += n;
+  }
+  return static_cast<bool>(out);
+}
+
+std::uint64_t hash_of(std::string_view a_line, std::uint64_t a_rounds) noexcept
+{
+  auto h = std::uint64_t{14695981039346656037ull};
+  for (auto c : a_line) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  for (std::uint64_t r = 0; r < a_rounds; ++r) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+Point read_once(mio::StringReaderAsync &a_reader, std::size_t a_threads, Policy const &a_policy, std::uint64_t a_cost)
+{
+  auto const callback = [a_cost](int, const std::string_view a_line) {
+    wxlib::bench::do_not_optimize(hash_of(a_line, a_cost));
+    return 0;
+  };
+
+  auto point = Point{};
+  auto const start = std::chrono::steady_clock::now();
+  point.lines = a_policy.chunk_size == 0 ? a_reader.async_getline(callback, a_threads)
+                                         : a_reader.async_getline(callback, a_threads, a_policy.chunk_size);
+  point.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  auto const &stats = a_reader.stats();
+  point.skew = stats.skew();
+  if (!stats.workers.empty()) {
+    auto first = stats.workers.front().end, last = first;
+    for (auto const &worker : stats.workers) {
+      first = std::min(first, worker.end);
+      last = std::max(last, worker.end);
+    }
+    point.tail = std::chrono::duration<double>(last - first).count() / std::max(point.seconds, 1e-9);
+  }
+  return point;
+}
+
+Point median_of(std::vector<Point> a_points)
+{
+  std::sort(a_points.begin(), a_points.end(), [](Point const &a, Point const &b) { return a.seconds < b.seconds; });
+  return a_points[a_points.size() / 2];
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  auto options = Options{};
+  auto generated = std::vector<std::filesystem::path>{};
+  for (int i = 1; i < argc; ++i) {
+    auto const arg = std::string_view{argv[i]};
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        print_usage();
+        std::exit(1);
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--sizes") options.sizes = sizes_of(value());
+    else if (arg == "--file") options.files.push_back(value());
+    else if (arg == "--threads") {
+      options.threads.clear();
+      for (auto n : sizes_of(value())) options.threads.push_back(std::max<std::size_t>(n, 1));
+    } else if (arg == "--costs") options.costs = sizes_of(value());
+    else if (arg == "--chunk-sizes") {
+      options.policies.resize(1);
+      for (auto size : sizes_of(value())) options.policies.push_back({"chunked:" + label_of(size), std::max<std::size_t>(size, 1)});
+    } else if (arg == "--repetitions") options.repetitions = std::max<std::size_t>(std::stoul(value()), 1);
+    else if (arg == "--dir") options.dir = value();
+    else if (arg == "--csv") options.csv = value();
+    else if (arg == "--keep") options.keep = true;
+    else {
+      print_usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (options.threads.empty()) {
+    auto const cores = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    for (std::size_t n = 1; n < cores; n *= 2) options.threads.push_back(n);
+    options.threads.push_back(cores);
+  }
+
+  auto files = options.files;
+  if (files.empty()) {
+    for (auto size : options.sizes) {
+      auto const file = options.dir / ("wxlib_scaling_" + label_of(size) + ".txt");
+      std::fprintf(stderr, "writing %s\n", file.string().c_str());
+      if (!write_text(file, size)) {
+        std::fprintf(stderr, "cannot write %s\n", file.string().c_str());
+        return 1;
+      }
+      files.push_back(file.string());
+      generated.push_back(file);
+    }
+  }
+
+  auto csv = std::ofstream{};
+  if (!options.csv.empty()) {
+    csv.open(options.csv);
+    if (!csv) {
+      std::fprintf(stderr, "cannot write %s\n", options.csv.c_str());
+      return 1;
+    }
+    csv << "file,bytes,cost,policy,threads,seconds,mb_per_s,speedup,skew,tail\n";
+  }
+
+  std::printf("%-28s %6s %-12s %7s %12s %8s %7s %7s\n", "file", "cost", "policy", "threads", "MB/s", "speedup", "skew", "tail");
+  for (auto const &file : files) {
+    auto reader = mio::StringReaderAsync{file};
+    auto const bytes = std::filesystem::file_size(file);
+    auto const name = std::filesystem::path{file}.filename().string();
+
+    // Faults the file in once, so that the first point does not pay for it alone.
+    read_once(reader, options.threads.back(), options.policies.front(), 0);
+
+    for (auto cost : options.costs) {
+      for (auto const &policy : options.policies) {
+        auto baseline = 0.0;
+        for (auto threads : options.threads) {
+          auto points = std::vector<Point>{};
+          for (std::size_t r = 0; r < options.repetitions; ++r) points.push_back(read_once(reader, threads, policy, cost));
+          auto const point = median_of(std::move(points));
+          auto const mb_per_s = static_cast<double>(bytes) / 1e6 / std::max(point.seconds, 1e-9);
+          if (baseline == 0.0) baseline = mb_per_s;
+
+          std::printf("%-28s %6llu %-12s %7zu %12.1f %8.2f %7.2f %6.1f%%\n", name.c_str(), static_cast<unsigned long long>(cost),
+                      policy.name.c_str(), threads, mb_per_s, mb_per_s / baseline, point.skew, 100 * point.tail);
+          std::fflush(stdout);
+          if (csv)
+            csv << name << ',' << bytes << ',' << cost << ',' << policy.name << ',' << threads << ',' << point.seconds << ','
+                << mb_per_s << ',' << mb_per_s / baseline << ',' << point.skew << ',' << point.tail << '\n';
+        }
+      }
+    }
+  }
+
+  if (!options.keep)
+    for (auto const &file : generated) std::filesystem::remove(file);
+  return 0;
+}
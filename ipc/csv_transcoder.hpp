@@ -0,0 +1,293 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_CSV_TRANSCODER_HPP
+#define WXLIB_IPC_CSV_TRANSCODER_HPP
+
+#include <mio/csvreader.hpp>
+#include <msgpack/msgpack.hpp>
+#include <zpp_bits/zpp_bits.h>
+
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+namespace ipc {
+
+/**
+   Encodes each csv record as a msgpack array of the values of its fields, in the order of the
+   schema, for BasicCsvTranscoder. msgpack::Unpacker packs objects inline, so a record unpacks
+   as the values following the array header, of one byte up to 15 fields, and three above.
+ */
+class MsgpackRecordEncoder
+{
+public:
+  explicit MsgpackRecordEncoder(std::vector<uint8_t> &a_buffer) : buffer_(&a_buffer), packer_(Sink{a_buffer})
+  {
+  }
+
+  void begin_record(const size_t a_size)
+  {
+    if (a_size < 16) {
+      buffer_->push_back(static_cast<uint8_t>(0x90 | a_size));
+    } else {
+      buffer_->push_back(msgpack::FormatConstants::array16);
+      buffer_->push_back(static_cast<uint8_t>(a_size >> 8));
+      buffer_->push_back(static_cast<uint8_t>(a_size));
+    }
+  }
+
+  template<typename V>
+  void field(const V &a_value)
+  {
+    packer_.process(a_value);
+  }
+
+  [[nodiscard]] std::error_code error() const
+  {
+    return packer_.ec;
+  }
+
+private:
+  using Sink = msgpack::ContainerSink<std::vector<uint8_t>>;
+
+  std::vector<uint8_t> *buffer_;
+  msgpack::BasicPacker<Sink> packer_;
+};
+
+/**
+   Encodes each csv record as the zpp::bits serialization of the values of its fields, one after
+   the other, for BasicCsvTranscoder; a record deserializes as an aggregate, or a std::tuple, of
+   the field types in the order of the schema, std::string for the text fields.
+ */
+class ZppBitsRecordEncoder
+{
+public:
+  explicit ZppBitsRecordEncoder(std::vector<uint8_t> &a_buffer) : out_(a_buffer, zpp::bits::append{})
+  {
+  }
+
+  void begin_record(size_t)
+  {
+  }
+
+  template<typename V>
+  void field(const V &a_value)
+  {
+    if (error_) return;
+    if (const auto result = out_(a_value); zpp::bits::failure(result)) error_ = std::make_error_code(result);
+  }
+
+  [[nodiscard]] std::error_code error() const
+  {
+    return error_;
+  }
+
+private:
+  zpp::bits::out<std::vector<uint8_t>, zpp::bits::append> out_;
+  std::error_code error_{};
+};
+
+/**
+   How the encoded blocks of a csv file are handed to the sink of a BasicCsvTranscoder.
+ */
+enum class CsvDelivery
+{
+  /** By the worker that encoded the block, as soon as it is done, in any order; the offset of a block frames it in the file. */
+  Framed,
+  /** In the order of the file, one block at a time, whichever worker encoded it. */
+  Ordered
+};
+
+/**
+   Transcodes a csv file to msgpack arrays or zpp::bits records on the parallel reader of
+   mio::csv::BasicCsvReader, with no Record in between: each worker slices the fields of its
+   blocks of lines, see CsvDoc::make_fields, and encodes their values straight from the text
+   into a buffer of its own. Text fields, std::string_view, std::string or Unquoted, are encoded
+   from the view of the line, and the others from the value parse_field converts them to.
+   Skipped fields are not encoded.
+
+   The encoded records of each block of lines are handed to the sink, either framed, by the
+   worker, or ordered, see CsvDelivery, invoked as a_sink(int worker_id, size_t offset,
+   std::span<const uint8_t> bytes, size_t records), the offset being the one of the block in
+   the body of the file, see BasicCsvReader::body. The bytes are only valid for the duration of
+   the call.
+
+   @code
+     ipc::CsvTranscoder<ipc::MsgpackRecordEncoder, Field<NAME("id"), int64_t>, Field<NAME("name"), std::string>> transcoder("links.csv");
+
+     std::error_code error;
+     auto n = transcoder.transcode([&](int, size_t, std::span<const uint8_t> a_bytes, size_t) {
+         return channel.send(a_bytes) ? 0 : -1;
+     }, ipc::CsvDelivery::Ordered, error);
+   @endcode
+ */
+template<typename Encoder, typename Dialect, typename ...Ts>
+class BasicCsvTranscoder
+{
+public:
+  using Reader = mio::csv::BasicCsvReader<Dialect, Ts...>;
+  using Doc = typename Reader::Doc;
+
+  /**
+     Number of values of an encoded record, i.e. of fields other than Skipped.
+   */
+  static constexpr size_t record_size = (size_t{0} + ... + !std::is_same_v<typename Ts::value_type, mio::csv::Skipped>);
+  static_assert(record_size <= std::numeric_limits<uint16_t>::max());
+
+  static constexpr size_t default_chunk_size = Reader::default_chunk_size;
+
+  /**
+     Constructs a transcoder for a csv file. If the file does not exist, std::system_error will
+     be thrown with error code describing the nature of the error.
+   */
+  explicit BasicCsvTranscoder(const std::string &a_file) : reader_{a_file}
+  {
+  }
+
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return reader_.is_mapped();
+  }
+
+  /**
+     The reader of the file, e.g. to set header_on_first_line, map_columns_by_name, or verify
+     the header.
+   */
+  Reader &reader() noexcept
+  {
+    return reader_;
+  }
+
+  /**
+     Encodes all records in parallel, and hands the records of each block of lines to the sink.
+     If a non-zero status code is returned, or a value fails to encode, the workers stop, and
+     none of the records of that block are counted.
+
+     Nothing is encoded if the header line does not match the schema, see
+     BasicCsvReader::verify_header.
+     @param a_sink The sink for the encoded records of each block.
+     @param a_delivery Whether the blocks are framed, or ordered.
+     @param a_error Set to the error of the first value that failed to encode, if any.
+     @param a_num_threads Number of worker threads, 0 treated as 1.
+     @param a_chunk_size Approximate size in bytes of the blocks of lines claimed by the workers.
+     @return Total number of records handed to the sink.
+   */
+  template<typename F>
+  size_t transcode(const F &a_sink, const CsvDelivery a_delivery, std::error_code &a_error,
+                   size_t a_num_threads = mio::available_concurrency(), size_t a_chunk_size = default_chunk_size)
+  {
+    a_error.clear();
+    const auto num_threads = std::max(a_num_threads, size_t{1});
+    const auto body = reader_.body();
+
+    auto buffers = std::vector<std::vector<uint8_t>>(num_threads);
+    auto scratch = std::vector<std::string>(num_threads);
+
+    std::mutex mutex;
+    auto pending = std::map<const char *, Block>{};
+    auto next = body.data();
+
+    return reader_.read_fields([&](int a_id, Doc &a_doc, std::string_view a_block, size_t &a_count) {
+      auto &buffer = buffers[a_id];
+      buffer.clear();
+
+      Encoder encoder{buffer};
+      const auto records = a_doc.make_fields(a_block, [&](const typename Doc::Fields &a_fields) {
+        encoder.begin_record(record_size);
+        encode_fields(encoder, a_doc, scratch[a_id], a_fields, std::make_index_sequence<sizeof...(Ts)>{});
+        return encoder.error() ? 1 : 0;
+      });
+
+      if (const auto error = encoder.error()) {
+        const std::lock_guard lock(mutex);
+        if (!a_error) a_error = error;
+        return 1;
+      }
+
+      const auto offset = static_cast<size_t>(a_block.data() - body.data());
+      if (a_delivery == CsvDelivery::Framed) {
+        const auto status = a_sink(a_id, offset, std::span<const uint8_t>{buffer}, records);
+        if (status == 0) a_count += records;
+        return status;
+      }
+
+      // Blocks follow one another in the body, so the next one to deliver starts where the
+      // last delivered one ends; the others wait, holding their bytes.
+      const std::lock_guard lock(mutex);
+      pending.emplace(a_block.data(), Block{std::next(a_block.data(), static_cast<std::ptrdiff_t>(a_block.size())), std::move(buffer), records});
+      for (auto it = pending.find(next); it != pending.end(); it = pending.find(next)) {
+        auto &block = it->second;
+        const auto status = a_sink(a_id, static_cast<size_t>(it->first - body.data()), std::span<const uint8_t>{block.bytes}, block.records);
+        if (status != 0) return status;
+
+        a_count += block.records;
+        next = block.end;
+        pending.erase(it);
+      }
+      return 0;
+    }, num_threads, a_chunk_size);
+  }
+
+  /**
+     Number of fields that failed to convert to their value type in the last transcode, see
+     BasicCsvReader::invalid_field_count. Those are encoded value initialized.
+   */
+  [[nodiscard]] size_t invalid_field_count() const noexcept
+  {
+    return reader_.invalid_field_count();
+  }
+
+private:
+  struct Block
+  {
+    const char *end;
+    std::vector<uint8_t> bytes;
+    size_t records;
+  };
+
+  template<size_t ...I>
+  static void encode_fields(Encoder &a_encoder, Doc &a_doc, std::string &a_scratch, const typename Doc::Fields &a_fields, std::index_sequence<I...>)
+  {
+    (encode_field<typename std::tuple_element_t<I, std::tuple<Ts...>>::value_type>(a_encoder, a_doc, a_scratch, a_fields[I]), ...);
+  }
+
+  template<typename V>
+  static void encode_field(Encoder &a_encoder, Doc &a_doc, std::string &a_scratch, const std::string_view a_text)
+  {
+    using mio::csv::parse_field;
+
+    if constexpr (std::is_same_v<V, mio::csv::Skipped>) {
+      return;
+    } else if constexpr (std::is_same_v<V, std::string_view> || requires { requires std::is_same_v<V, std::basic_string<char, typename V::traits_type, typename V::allocator_type>>; }) {
+      a_encoder.field(a_text);
+    } else if constexpr (std::is_same_v<V, mio::csv::Unquoted>) {
+      auto value = mio::csv::Unquoted{};
+      parse_field(a_text, value);
+      if (value.escaped) a_scratch.resize(value.text.size());
+      a_encoder.field(value.escaped ? value.unescape(std::span<char>{a_scratch}) : value.text);
+    } else {
+      auto value = V{};
+      a_doc.invalid_field_count += !parse_field(a_text, value);
+      a_encoder.field(value);
+    }
+  }
+
+  Reader reader_;
+};
+
+/**
+   Transcodes a comma separated file, see BasicCsvTranscoder.
+ */
+template<typename Encoder, typename ...Ts>
+using CsvTranscoder = BasicCsvTranscoder<Encoder, mio::csv::CommaDialect, Ts...>;
+
+}
+#endif
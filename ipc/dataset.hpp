@@ -0,0 +1,492 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_DATASET_HPP
+#define WXLIB_IPC_DATASET_HPP
+
+#include <ipc/ipc.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+
+namespace ipc {
+
+#pragma region - Offset pointers
+
+/**
+   A position independent pointer, storing the distance from itself to the object pointed to,
+   so that it stays valid wherever the segment holding both is mapped, in every process.
+
+   Copying an OffsetPtr recomputes the distance from the new location, so it may be copied out
+   of a segment, like a plain pointer, as long as the object pointed to stays mapped.
+ */
+template<typename T>
+class OffsetPtr
+{
+public:
+  using element_type = T;
+
+  OffsetPtr() noexcept = default;
+
+  OffsetPtr(std::nullptr_t) noexcept
+  {
+  }
+
+  OffsetPtr(T *a_pointer) noexcept
+  {
+    set(a_pointer);
+  }
+
+  OffsetPtr(const OffsetPtr &a_other) noexcept
+  {
+    set(a_other.get());
+  }
+
+  OffsetPtr &operator=(const OffsetPtr &a_other) noexcept
+  {
+    set(a_other.get());
+    return *this;
+  }
+
+  OffsetPtr &operator=(T *a_pointer) noexcept
+  {
+    set(a_pointer);
+    return *this;
+  }
+
+  [[nodiscard]] T *get() const noexcept
+  {
+    if (offset_ == null_offset) return nullptr;
+    return reinterpret_cast<T *>(reinterpret_cast<std::intptr_t>(this) + offset_);
+  }
+
+  T &operator*() const noexcept
+  {
+    return *get();
+  }
+
+  T *operator->() const noexcept
+  {
+    return get();
+  }
+
+  T &operator[](const size_t a_index) const noexcept
+  {
+    return get()[a_index];
+  }
+
+  explicit operator bool() const noexcept
+  {
+    return offset_ != null_offset;
+  }
+
+  friend bool operator==(const OffsetPtr &a_lhs, const OffsetPtr &a_rhs) noexcept
+  {
+    return a_lhs.get() == a_rhs.get();
+  }
+
+private:
+  // A distance of 1 can never point to a T from within the pointer itself, unlike 0.
+  static constexpr std::ptrdiff_t null_offset = 1;
+
+  void set(T *a_pointer) noexcept
+  {
+    offset_ = a_pointer == nullptr
+                  ? null_offset
+                  : reinterpret_cast<std::intptr_t>(a_pointer) - reinterpret_cast<std::intptr_t>(this);
+  }
+
+  std::ptrdiff_t offset_{null_offset};
+};
+
+/**
+   A position independent array, an OffsetPtr to its first element and its size.
+ */
+template<typename T>
+class OffsetArray
+{
+public:
+  using value_type = T;
+  using iterator = T *;
+
+  OffsetArray() noexcept = default;
+
+  OffsetArray(const std::span<T> a_elements) noexcept
+      : data_{a_elements.data()}, size_{a_elements.size()}
+  {
+  }
+
+  OffsetArray &operator=(const std::span<T> a_elements) noexcept
+  {
+    data_ = a_elements.data();
+    size_ = a_elements.size();
+    return *this;
+  }
+
+  [[nodiscard]] T *data() const noexcept
+  {
+    return data_.get();
+  }
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return static_cast<size_t>(size_);
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  [[nodiscard]] iterator begin() const noexcept
+  {
+    return data();
+  }
+
+  [[nodiscard]] iterator end() const noexcept
+  {
+    return data() + size();
+  }
+
+  T &operator[](const size_t a_index) const noexcept
+  {
+    return data()[a_index];
+  }
+
+  operator std::span<T>() const noexcept
+  {
+    return {data(), size()};
+  }
+
+private:
+  OffsetPtr<T> data_;
+  uint64_t size_{0};
+};
+
+/**
+   A position independent string, see DatasetBuilder::make_string().
+ */
+class OffsetString
+{
+public:
+  OffsetString() noexcept = default;
+
+  OffsetString(const std::string_view a_string) noexcept
+      : data_{a_string.data()}, size_{a_string.size()}
+  {
+  }
+
+  OffsetString &operator=(const std::string_view a_string) noexcept
+  {
+    data_ = a_string.data();
+    size_ = a_string.size();
+    return *this;
+  }
+
+  [[nodiscard]] std::string_view view() const noexcept
+  {
+    return {data_.get(), static_cast<size_t>(size_)};
+  }
+
+  operator std::string_view() const noexcept
+  {
+    return view();
+  }
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return static_cast<size_t>(size_);
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  friend bool operator==(const OffsetString &a_lhs, const std::string_view a_rhs) noexcept
+  {
+    return a_lhs.view() == a_rhs;
+  }
+
+private:
+  OffsetPtr<const char> data_;
+  uint64_t size_{0};
+};
+
+#pragma endregion
+
+#pragma region - Dataset
+
+namespace detail {
+
+/**
+   Leads the segment of a dataset. The builder fills it in when publishing, and publishes
+   `state` last.
+ */
+struct alignas(cache_line) DatasetHeader
+{
+  static constexpr uint32_t magic_number = 0x44505857; // "WXPD"
+  static constexpr uint32_t published = 1;
+
+  std::atomic<uint32_t> state{0};
+  uint32_t magic{magic_number};
+  uint32_t schema{0};
+  uint32_t root_size{0};
+  uint64_t root_offset{0};
+  uint64_t size{0};
+};
+
+}
+
+/**
+   Builds a dataset once in place in a new named shared memory segment, for any number of
+   processes on the host to attach to read-only, see Dataset, without parsing or copying it.
+
+   Objects are constructed in the segment by a bump allocator; they must refer to each other
+   through OffsetPtr, OffsetArray and OffsetString, never through plain pointers or standard
+   containers, which are only valid in the process building them. The root object is handed to
+   publish() last, which makes the dataset visible.
+
+   The capacity is reserved up front. On POSIX the pages beyond those used are never touched, so
+   they cost no memory; a Windows segment is charged against the commit limit whole, and only
+   lives as long as a process maps it, e.g. the builder.
+
+   @code
+     struct Network {
+       ipc::OffsetArray<Link> links;
+       ipc::OffsetArray<ipc::OffsetString> names;
+     };
+
+     ipc::DatasetBuilder builder("wxlib_network", size_t{4} << 30);
+     auto *network = builder.construct<Network>();
+     network->links = builder.make_array(std::span<const Link>{links});
+     ...
+     builder.publish(network);
+   @endcode
+ */
+class DatasetBuilder
+{
+public:
+  /**
+     Creates the named segment of the dataset. If it fails, e.g. if the segment exists already,
+     std::system_error will be thrown with error code describing the nature of the error.
+
+     \param   a_name  The name of the dataset segment.
+     \param   a_capacity  Size in bytes reserved for the dataset.
+     \param   a_schema  A version of the layout of the dataset, checked by Dataset.
+   */
+  DatasetBuilder(const std::string &a_name, const size_t a_capacity, const uint32_t a_schema = 0)
+      : segment_{a_name, sizeof(detail::DatasetHeader) + a_capacity, OpenMode::Create}, schema_{a_schema}
+  {
+    header_ = new (segment_.data()) detail::DatasetHeader{};
+  }
+
+  DatasetBuilder(const DatasetBuilder &) = delete;
+  DatasetBuilder &operator=(const DatasetBuilder &) = delete;
+
+  /**
+     Removes the named dataset, see SharedMemory::remove().
+   */
+  static bool remove(const std::string &a_name) noexcept
+  {
+    return SharedMemory::remove(a_name);
+  }
+
+  /**
+     Allocates uninitialized, suitably aligned storage in the segment.
+
+     \returns The storage, std::bad_alloc is thrown if the capacity is exhausted.
+   */
+  [[nodiscard]] void *allocate(const size_t a_size, const size_t a_alignment = alignof(std::max_align_t))
+  {
+    const auto offset = detail::align_up(used_, a_alignment);
+    if (offset > segment_.size() || a_size > segment_.size() - offset) throw std::bad_alloc();
+
+    used_ = offset + a_size;
+    return segment_.data() + offset;
+  }
+
+  /**
+     Constructs an object in the segment.
+   */
+  template<typename T, typename... ArgsT>
+  T *construct(ArgsT &&...a_args)
+  {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<ArgsT>(a_args)...);
+  }
+
+  /**
+     Constructs an array of value initialized elements in the segment.
+   */
+  template<typename T>
+  std::span<T> make_array(const size_t a_count)
+  {
+    auto *data = static_cast<T *>(allocate(sizeof(T) * a_count, alignof(T)));
+    std::uninitialized_value_construct_n(data, a_count);
+    return {data, a_count};
+  }
+
+  /**
+     Copies an array of trivially copyable elements into the segment.
+   */
+  template<typename T>
+  requires std::is_trivially_copyable_v<T>
+  std::span<T> make_array(const std::span<const T> a_elements)
+  {
+    auto *data = static_cast<T *>(allocate(a_elements.size_bytes(), alignof(T)));
+    if (!a_elements.empty()) std::memcpy(data, a_elements.data(), a_elements.size_bytes());
+    return {data, a_elements.size()};
+  }
+
+  /**
+     Copies a string into the segment.
+   */
+  std::string_view make_string(const std::string_view a_string)
+  {
+    auto *data = static_cast<char *>(allocate(a_string.size(), 1));
+    if (!a_string.empty()) std::memcpy(data, a_string.data(), a_string.size());
+    return {data, a_string.size()};
+  }
+
+  /**
+     Publishes the dataset with its root object, constructed in the segment, to the processes
+     attaching to it. Nothing may be modified once published.
+   */
+  template<typename RootT>
+  void publish(const RootT *a_root) noexcept
+  {
+    header_->schema = schema_;
+    header_->root_size = static_cast<uint32_t>(sizeof(RootT));
+    header_->root_offset = static_cast<uint64_t>(reinterpret_cast<const char *>(a_root) - segment_.data());
+    header_->size = used_;
+    header_->state.store(detail::DatasetHeader::published, std::memory_order_release);
+  }
+
+  [[nodiscard]] const std::string &name() const noexcept
+  {
+    return segment_.name();
+  }
+
+  /**
+     Size in bytes of the segment used so far, including the header.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return used_;
+  }
+
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return segment_.size();
+  }
+
+private:
+  SharedMemory segment_;
+  detail::DatasetHeader *header_{nullptr};
+  size_t used_{sizeof(detail::DatasetHeader)};
+  uint32_t schema_;
+};
+
+/**
+   A dataset published by a DatasetBuilder, mapped read-only. Copies share the mapping, in the
+   manner of mio::basic_shared_mmap, so threads may each hold one.
+
+   @code
+     ipc::Dataset<Network> network("wxlib_network", std::chrono::seconds{60});
+     for (const auto &link: network->links) ...
+   @endcode
+ */
+template<typename RootT>
+class Dataset
+{
+public:
+  /**
+     Attaches to the named dataset. If it fails, std::system_error will be thrown with error code
+     describing the nature of the error: `errc::no_such_file_or_directory` if there is no such
+     dataset, `errc::timed_out` if not published within the timeout, and
+     `errc::wrong_protocol_type` if the root type or schema do not match.
+
+     \param   a_name  The name of the dataset segment.
+     \param   a_timeout  How long to wait for the builder to publish the dataset.
+     \param   a_schema  The version of the layout of the dataset, see DatasetBuilder.
+   */
+  explicit Dataset(const std::string &a_name, const std::chrono::nanoseconds a_timeout = {}, const uint32_t a_schema = 0)
+      : segment_{std::make_shared<SharedMemorySource>(a_name, 0, OpenMode::Open)}
+  {
+    if (segment_->size() < sizeof(detail::DatasetHeader))
+      throw std::system_error(std::make_error_code(std::errc::wrong_protocol_type));
+
+    std::error_code error;
+    if (!wait_until_published(a_timeout, a_schema, error)) throw std::system_error(error);
+
+    root_ = std::launder(reinterpret_cast<const RootT *>(segment_->data() + header().root_offset));
+  }
+
+  [[nodiscard]] const RootT &root() const noexcept
+  {
+    return *root_;
+  }
+
+  const RootT &operator*() const noexcept
+  {
+    return *root_;
+  }
+
+  const RootT *operator->() const noexcept
+  {
+    return root_;
+  }
+
+  /**
+     Size in bytes of the dataset, including the header.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return static_cast<size_t>(header().size);
+  }
+
+  [[nodiscard]] const std::string &name() const noexcept
+  {
+    return segment_->name();
+  }
+
+private:
+  [[nodiscard]] const detail::DatasetHeader &header() const noexcept
+  {
+    return *std::launder(reinterpret_cast<const detail::DatasetHeader *>(segment_->data()));
+  }
+
+  bool wait_until_published(const std::chrono::nanoseconds a_timeout, const uint32_t a_schema, std::error_code &error) const noexcept
+  {
+    const auto deadline = std::chrono::steady_clock::now() + a_timeout;
+    const auto &h = header();
+
+    while (h.state.load(std::memory_order_acquire) != detail::DatasetHeader::published) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        error = std::make_error_code(std::errc::timed_out);
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    if (h.magic != detail::DatasetHeader::magic_number || h.schema != a_schema || h.root_size != sizeof(RootT)
+        || h.size > segment_->size() || h.root_offset + sizeof(RootT) > h.size || h.root_offset % alignof(RootT) != 0) {
+      error = std::make_error_code(std::errc::wrong_protocol_type);
+      return false;
+    }
+
+    return true;
+  }
+
+  std::shared_ptr<const SharedMemorySource> segment_;
+  const RootT *root_{nullptr};
+};
+
+#pragma endregion
+
+}
+#endif
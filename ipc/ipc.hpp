@@ -0,0 +1,1132 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_HPP
+#define WXLIB_IPC_HPP
+
+#include <mio/mio.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__) && __has_include(<linux/futex.h>)
+#define WXLIB_IPC_HAS_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ipc {
+
+/**
+   How a named segment or channel is opened.
+ */
+enum class OpenMode
+{
+  Create,      //!< Creates it, failing with `errc::file_exists` if it exists already.
+  Open,        //!< Opens an existing one, failing with `errc::no_such_file_or_directory` if none.
+  OpenOrCreate //!< Opens it if it exists, else creates it.
+};
+
+/**
+   Timeout of the blocking calls waiting forever.
+ */
+inline constexpr auto infinite = std::chrono::nanoseconds::max();
+
+namespace detail {
+
+inline constexpr size_t cache_line = 64;
+
+inline std::string segment_name(const std::string &a_name)
+{
+#ifdef _WIN32
+  return "Local\\" + a_name;
+#else
+  return "/" + a_name;
+#endif
+}
+
+inline void cpu_relax() noexcept
+{
+#if defined(_MSC_VER)
+  YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+   A wake-up event in shared memory. A waiter registers itself in `waiters` before sleeping on
+   `sequence`, and a notifier only bumps `sequence` and wakes when there are waiters, so that a
+   notification costs a fence and a load on the fast path.
+ */
+struct Event
+{
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<uint32_t> waiters{0};
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory channels need lock free atomics");
+
+inline void notify(Event &a_event) noexcept
+{
+  // Pairs with the registration of the waiter, so that either the waiter sees the new state, or
+  // the notifier sees the waiter.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (a_event.waiters.load(std::memory_order_relaxed) == 0) return;
+
+  a_event.sequence.fetch_add(1, std::memory_order_release);
+#ifdef WXLIB_IPC_HAS_FUTEX
+  // Not FUTEX_PRIVATE_FLAG, the word is shared by processes.
+  ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&a_event.sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+/**
+   Waits until the predicate holds or the timeout expires, spinning briefly first, then sleeping
+   on a futex on Linux, or polling with short sleeps elsewhere (WaitOnAddress and the like only
+   work within a process).
+
+   \returns Whether the predicate holds.
+ */
+template<typename PredicateT>
+bool wait_for(Event &a_event, PredicateT &&a_ready, const std::chrono::nanoseconds a_timeout) noexcept
+{
+  constexpr int spin_count = 256;
+  for (int i = 0; i < spin_count; ++i) {
+    if (a_ready()) return true;
+    cpu_relax();
+  }
+
+  using clock = std::chrono::steady_clock;
+  const bool forever = a_timeout == infinite;
+  const auto deadline = forever ? clock::time_point::max() : clock::now() + a_timeout;
+#ifndef WXLIB_IPC_HAS_FUTEX
+  auto backoff = std::chrono::microseconds{20};
+#endif
+
+  for (;;) {
+    a_event.waiters.fetch_add(1, std::memory_order_seq_cst);
+    const auto sequence = a_event.sequence.load(std::memory_order_acquire);
+    if (a_ready()) {
+      a_event.waiters.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    const auto remaining = forever ? std::chrono::nanoseconds{std::chrono::seconds{1}}
+                                   : std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - clock::now());
+    if (remaining <= std::chrono::nanoseconds::zero()) {
+      a_event.waiters.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+
+#ifdef WXLIB_IPC_HAS_FUTEX
+    const auto nanoseconds = std::min(remaining.count(), std::chrono::nanoseconds{std::chrono::seconds{1}}.count());
+    auto timeout = timespec{};
+    timeout.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+    timeout.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&a_event.sequence), FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+#else
+    (void) sequence;
+    std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(remaining, backoff));
+    backoff = std::min(backoff * 2, std::chrono::microseconds{1000});
+#endif
+    a_event.waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+}
+
+#pragma region - SharedMemory
+
+/**
+   A named shared memory segment, that other processes on the host map by name. POSIX shared
+   memory (shm_open) mapped through mio::basic_mmap, or a named pagefile backed file mapping on
+   Windows. A new segment is zero filled.
+
+   The segment outlives the processes mapping it until removed, see `remove()`, on POSIX; on
+   Windows it goes away with the last mapping.
+
+   A read-only segment, see SharedMemorySource, only opens an existing segment.
+
+   @code
+     ipc::SharedMemory segment("wxlib_assignment", 1 << 20);
+     std::memcpy(segment.data(), "hello", 5);
+   @endcode
+ */
+template<mio::access_mode AccessMode>
+class BasicSharedMemory
+{
+public:
+  using pointer = std::conditional_t<AccessMode == mio::access_mode::write, char *, const char *>;
+
+  BasicSharedMemory() = default;
+
+  /**
+     Opens or creates the named segment. If it fails, std::system_error will be thrown with
+     error code describing the nature of the error.
+
+     \param   a_name  The name of the segment, without slashes.
+     \param   a_size  Size in bytes of a new segment. An existing segment is mapped whole.
+     \param   a_mode  Whether to create, open, or either.
+   */
+  BasicSharedMemory(const std::string &a_name, const size_t a_size,
+                    const OpenMode a_mode = AccessMode == mio::access_mode::write ? OpenMode::OpenOrCreate : OpenMode::Open)
+  {
+    std::error_code error;
+    open(a_name, a_size, a_mode, error);
+    if (error) throw std::system_error(error);
+  }
+
+  BasicSharedMemory(const BasicSharedMemory &) = delete;
+  BasicSharedMemory &operator=(const BasicSharedMemory &) = delete;
+
+  BasicSharedMemory(BasicSharedMemory &&a_other) noexcept
+  {
+    swap(a_other);
+  }
+
+  BasicSharedMemory &operator=(BasicSharedMemory &&a_other) noexcept
+  {
+    if (this != &a_other) {
+      close();
+      swap(a_other);
+    }
+    return *this;
+  }
+
+  ~BasicSharedMemory()
+  {
+    close();
+  }
+
+  /**
+     Opens or creates the named segment, see the constructor.
+   */
+  void open(const std::string &a_name, const size_t a_size, const OpenMode a_mode, std::error_code &error) noexcept
+  {
+    error.clear();
+    close();
+
+    constexpr bool writable = AccessMode == mio::access_mode::write;
+    if (a_name.empty() || a_name.find_first_of("/\\") != std::string::npos || (a_size == 0 && a_mode != OpenMode::Open)
+        || (!writable && a_mode != OpenMode::Open)) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+
+    const auto path = detail::segment_name(a_name);
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+    if (a_mode == OpenMode::Open) {
+      mapping = ::OpenFileMappingA(writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, FALSE, path.c_str());
+    } else {
+      const auto size = static_cast<uint64_t>(a_size);
+      mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), path.c_str());
+      created_ = mapping != nullptr && ::GetLastError() != ERROR_ALREADY_EXISTS;
+    }
+
+    if (mapping == nullptr) {
+      error = mio::detail::last_error();
+      return;
+    }
+
+    if (!created_ && a_mode == OpenMode::Create) {
+      ::CloseHandle(mapping);
+      error = std::make_error_code(std::errc::file_exists);
+      return;
+    }
+
+    data_ = static_cast<pointer>(::MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+      error = mio::detail::last_error();
+      ::CloseHandle(mapping);
+      created_ = false;
+      return;
+    }
+
+    auto info = MEMORY_BASIC_INFORMATION{};
+    ::VirtualQuery(data_, &info, sizeof(info));
+    size_ = created_ ? a_size : info.RegionSize;
+    mapping_ = mapping;
+#else
+    int fd = -1;
+    if (a_mode != OpenMode::Open) {
+      fd = ::shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+      if (fd >= 0) {
+        created_ = true;
+      } else if (errno != EEXIST || a_mode == OpenMode::Create) {
+        error = mio::detail::last_error();
+        return;
+      }
+    }
+
+    if (fd < 0) {
+      fd = ::shm_open(path.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+      if (fd < 0) {
+        error = mio::detail::last_error();
+        return;
+      }
+    }
+
+    if (created_) {
+      if (::ftruncate(fd, static_cast<off_t>(a_size)) != 0) {
+        error = mio::detail::last_error();
+        ::close(fd);
+        ::shm_unlink(path.c_str());
+        created_ = false;
+        return;
+      }
+    } else if (!wait_for_size(fd, error)) {
+      ::close(fd);
+      return;
+    }
+
+    mmap_.map(fd, 0, created_ ? a_size : size_t{mio::map_entire_file}, error);
+    // The mapping stays valid once the descriptor is closed.
+    ::close(fd);
+
+    if (error) {
+      if (created_) ::shm_unlink(path.c_str());
+      created_ = false;
+      return;
+    }
+
+    data_ = mmap_.data();
+    size_ = mmap_.size();
+#endif
+    name_ = a_name;
+  }
+
+  /**
+     Unmaps the segment, without removing it.
+   */
+  void close() noexcept
+  {
+#ifdef _WIN32
+    if (data_ != nullptr) ::UnmapViewOfFile(const_cast<char *>(data_));
+    if (mapping_ != nullptr) ::CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    mmap_.unmap();
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    created_ = false;
+    name_.clear();
+  }
+
+  /**
+     Removes the named segment, so it can no longer be opened. Processes mapping it keep their
+     mappings. A no-op on Windows, where a segment goes away with its last mapping.
+
+     \returns Whether the segment existed and was removed.
+   */
+  static bool remove(const std::string &a_name) noexcept
+  {
+#ifdef _WIN32
+    (void) a_name;
+    return true;
+#else
+    return ::shm_unlink(detail::segment_name(a_name).c_str()) == 0;
+#endif
+  }
+
+  [[nodiscard]] bool is_open() const noexcept
+  {
+    return data_ != nullptr;
+  }
+
+  /**
+     Checks whether this instance created the segment, rather than opened an existing one.
+   */
+  [[nodiscard]] bool created() const noexcept
+  {
+    return created_;
+  }
+
+  [[nodiscard]] pointer data() const noexcept
+  {
+    return data_;
+  }
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  [[nodiscard]] const std::string &name() const noexcept
+  {
+    return name_;
+  }
+
+  void swap(BasicSharedMemory &a_other) noexcept
+  {
+    using std::swap;
+#ifdef _WIN32
+    swap(mapping_, a_other.mapping_);
+#else
+    swap(mmap_, a_other.mmap_);
+#endif
+    swap(data_, a_other.data_);
+    swap(size_, a_other.size_);
+    swap(created_, a_other.created_);
+    swap(name_, a_other.name_);
+  }
+
+private:
+#ifndef _WIN32
+  /**
+     Waits for the creator of the segment to size it, between its shm_open and ftruncate.
+   */
+  static bool wait_for_size(const int a_fd, std::error_code &error) noexcept
+  {
+    for (int i = 0; i < 1000; ++i) {
+      struct stat info{};
+      if (::fstat(a_fd, &info) != 0) {
+        error = mio::detail::last_error();
+        return false;
+      }
+      if (info.st_size > 0) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    error = std::make_error_code(std::errc::timed_out);
+    return false;
+  }
+
+  mio::basic_mmap<AccessMode, char> mmap_;
+#else
+  HANDLE mapping_{nullptr};
+#endif
+  pointer data_{nullptr};
+  size_t size_{0};
+  bool created_{false};
+  std::string name_;
+};
+
+/**
+   A named shared memory segment mapped for reading and writing.
+ */
+using SharedMemory = BasicSharedMemory<mio::access_mode::write>;
+
+/**
+   An existing named shared memory segment mapped read-only.
+ */
+using SharedMemorySource = BasicSharedMemory<mio::access_mode::read>;
+
+#pragma endregion
+
+#pragma region - Rings
+
+/**
+   Sizes of a channel, applied when it is created. A channel opened by name takes the sizes of
+   the existing one.
+ */
+struct ChannelOptions
+{
+  size_t capacity{size_t{1} << 20};  //!< Bytes of messages the channel buffers, rounded up to a power of two.
+  size_t max_message_size{4096};     //!< Size in bytes of the largest message.
+};
+
+namespace detail {
+
+/**
+   Leads the segment of a channel. The creator fills it in, then publishes `state`, which the
+   other processes wait for before using the channel.
+ */
+struct alignas(cache_line) ChannelHeader
+{
+  static constexpr uint32_t magic_number = 0x43505857; // "WXPC"
+  static constexpr uint32_t ready = 1;
+
+  std::atomic<uint32_t> state{0};
+  uint32_t magic{magic_number};
+  uint32_t kind{0};
+  uint32_t reserved{0};
+  uint64_t capacity{0};
+  uint64_t slot_size{0};
+  alignas(cache_line) Event readable;
+  alignas(cache_line) Event writable;
+};
+
+constexpr size_t align_up(const size_t a_value, const size_t a_alignment) noexcept
+{
+  return (a_value + a_alignment - 1) & ~(a_alignment - 1);
+}
+
+}
+
+/**
+   A single producer single consumer ring of variable length messages. Each message is stored
+   contiguously, as an 8 byte length followed by the bytes padded to 8; a message not fitting
+   before the end of the ring is preceded by a padding record, and stored from the start.
+ */
+class SpscRing
+{
+public:
+  static constexpr uint32_t kind = 1;
+
+  struct Control
+  {
+    alignas(detail::cache_line) std::atomic<uint64_t> head{0}; // Read position, owned by the consumer.
+    alignas(detail::cache_line) std::atomic<uint64_t> tail{0}; // Write position, owned by the producer.
+  };
+
+  /**
+     Fills in the sizes of a new ring in the header.
+   */
+  static void configure(detail::ChannelHeader &a_header, const ChannelOptions &a_options) noexcept
+  {
+    const auto record = record_header + detail::align_up(a_options.max_message_size, record_header);
+    a_header.capacity = std::bit_ceil(std::max({a_options.capacity, 2 * record, detail::cache_line}));
+    a_header.slot_size = 0;
+  }
+
+  /**
+     Size in bytes of the ring, given the header.
+   */
+  static size_t ring_size(const detail::ChannelHeader &a_header) noexcept
+  {
+    return sizeof(Control) + a_header.capacity;
+  }
+
+  void attach(const detail::ChannelHeader &a_header, char *a_ring, const bool a_create) noexcept
+  {
+    control_ = a_create ? new (a_ring) Control{} : std::launder(reinterpret_cast<Control *>(a_ring));
+    data_ = a_ring + sizeof(Control);
+    capacity_ = a_header.capacity;
+    tail_ = control_->tail.load(std::memory_order_relaxed);
+  }
+
+  /**
+     Largest message of the ring, such that a message and the padding before it always fit.
+   */
+  [[nodiscard]] size_t max_message_size() const noexcept
+  {
+    return capacity_ / 2 - record_header;
+  }
+
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+  [[nodiscard]] bool readable() const noexcept
+  {
+    return control_->head.load(std::memory_order_relaxed) != control_->tail.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] bool writable(const size_t a_size) const noexcept
+  {
+    return tail_ + footprint(tail_, a_size) - control_->head.load(std::memory_order_acquire) <= capacity_;
+  }
+
+  bool try_push(const void *a_data, const size_t a_size) noexcept
+  {
+    auto *payload = try_prepare(a_size);
+    if (payload == nullptr) return false;
+
+    if (a_size > 0) std::memcpy(payload, a_data, a_size);
+    commit(a_size);
+    publish();
+    return true;
+  }
+
+  /**
+     Reserves room for a message of up to `a_max_size` bytes, to be written in place and then
+     committed, see commit().
+
+     \returns The payload of the message, or nullptr if there is no room for it.
+   */
+  [[nodiscard]] uint8_t *try_prepare(const size_t a_max_size) noexcept
+  {
+    if (a_max_size > max_message_size()) return nullptr;
+
+    auto tail = tail_;
+    const auto total = footprint(tail, a_max_size);
+    if (tail + total - head_cache_ > capacity_) {
+      head_cache_ = control_->head.load(std::memory_order_acquire);
+      if (tail + total - head_cache_ > capacity_) return nullptr;
+    }
+
+    const auto contiguous = capacity_ - (tail & (capacity_ - 1));
+    if (contiguous < record_size(a_max_size)) {
+      write_header(tail, padding);
+      tail_ = tail += contiguous;
+    }
+
+    return reinterpret_cast<uint8_t *>(data_ + (tail & (capacity_ - 1)) + record_header);
+  }
+
+  /**
+     Appends the message written in place after try_prepare(), of `a_size` bytes, no more than
+     prepared. The message becomes visible to the consumer with the next publish().
+   */
+  void commit(const size_t a_size) noexcept
+  {
+    write_header(tail_, static_cast<uint64_t>(a_size));
+    tail_ += record_size(a_size);
+  }
+
+  /**
+     Makes the committed messages visible to the consumer.
+
+     \returns Whether there were any to publish.
+   */
+  bool publish() noexcept
+  {
+    if (control_->tail.load(std::memory_order_relaxed) == tail_) return false;
+    control_->tail.store(tail_, std::memory_order_release);
+    return true;
+  }
+
+  template<typename CallbackT>
+  bool try_pop(CallbackT &&a_callback)
+  {
+    auto head = control_->head.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = control_->tail.load(std::memory_order_acquire);
+      if (head == tail_cache_) return false;
+    }
+
+    auto size = read_header(head);
+    if (size == padding) {
+      head += capacity_ - (head & (capacity_ - 1));
+      size = read_header(head);
+    }
+
+    const auto *payload = reinterpret_cast<const uint8_t *>(data_ + (head & (capacity_ - 1)) + record_header);
+    a_callback(std::span<const uint8_t>{payload, static_cast<size_t>(size)});
+    control_->head.store(head + record_size(static_cast<size_t>(size)), std::memory_order_release);
+    return true;
+  }
+
+private:
+  static constexpr size_t record_header = sizeof(uint64_t);
+  static constexpr uint64_t padding = ~uint64_t{0};
+
+  static size_t record_size(const size_t a_size) noexcept
+  {
+    return record_header + detail::align_up(a_size, record_header);
+  }
+
+  /**
+     Bytes a message takes from `a_tail` on, including the padding up to the end of the ring.
+   */
+  [[nodiscard]] size_t footprint(const uint64_t a_tail, const size_t a_size) const noexcept
+  {
+    const auto contiguous = capacity_ - (a_tail & (capacity_ - 1));
+    const auto record = record_size(a_size);
+    return contiguous < record ? contiguous + record : record;
+  }
+
+  void write_header(const uint64_t a_position, const uint64_t a_value) noexcept
+  {
+    std::memcpy(data_ + (a_position & (capacity_ - 1)), &a_value, record_header);
+  }
+
+  [[nodiscard]] uint64_t read_header(const uint64_t a_position) const noexcept
+  {
+    auto value = uint64_t{0};
+    std::memcpy(&value, data_ + (a_position & (capacity_ - 1)), record_header);
+    return value;
+  }
+
+  Control *control_{nullptr};
+  char *data_{nullptr};
+  size_t capacity_{0};
+  uint64_t tail_{0};       // The producer's write position, ahead of `tail` by the unpublished messages.
+  uint64_t head_cache_{0}; // The producer's last view of head.
+  uint64_t tail_cache_{0}; // The consumer's last view of tail.
+};
+
+/**
+   A bounded multiple producer multiple consumer queue of fixed size slots (D. Vyukov's), each
+   slot holding a message of up to `max_message_size` bytes. A slot is claimed by a CAS of the
+   enqueue or dequeue position, and handed over through its sequence number.
+ */
+class MpmcRing
+{
+public:
+  static constexpr uint32_t kind = 2;
+
+  struct Control
+  {
+    alignas(detail::cache_line) std::atomic<uint64_t> enqueue{0};
+    alignas(detail::cache_line) std::atomic<uint64_t> dequeue{0};
+  };
+
+  struct Cell
+  {
+    std::atomic<uint64_t> sequence;
+    uint64_t size;
+  };
+
+  static void configure(detail::ChannelHeader &a_header, const ChannelOptions &a_options) noexcept
+  {
+    a_header.slot_size = detail::align_up(sizeof(Cell) + std::max<size_t>(a_options.max_message_size, 1), detail::cache_line);
+    a_header.capacity = std::bit_ceil(std::max<size_t>(a_options.capacity / a_header.slot_size, 2));
+  }
+
+  static size_t ring_size(const detail::ChannelHeader &a_header) noexcept
+  {
+    return sizeof(Control) + a_header.capacity * a_header.slot_size;
+  }
+
+  void attach(const detail::ChannelHeader &a_header, char *a_ring, const bool a_create) noexcept
+  {
+    cells_ = a_ring + sizeof(Control);
+    capacity_ = a_header.capacity;
+    slot_size_ = a_header.slot_size;
+
+    if (a_create) {
+      control_ = new (a_ring) Control{};
+      for (size_t i = 0; i < capacity_; ++i) new (cells_ + i * slot_size_) Cell{{i}, 0};
+    } else {
+      control_ = std::launder(reinterpret_cast<Control *>(a_ring));
+    }
+  }
+
+  [[nodiscard]] size_t max_message_size() const noexcept
+  {
+    return slot_size_ - sizeof(Cell);
+  }
+
+  /**
+     Number of slots of the ring.
+   */
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+  [[nodiscard]] bool readable() const noexcept
+  {
+    const auto position = control_->dequeue.load(std::memory_order_relaxed);
+    return cell(position).sequence.load(std::memory_order_acquire) == position + 1;
+  }
+
+  [[nodiscard]] bool writable(size_t) const noexcept
+  {
+    const auto position = control_->enqueue.load(std::memory_order_relaxed);
+    return cell(position).sequence.load(std::memory_order_acquire) == position;
+  }
+
+  bool try_push(const void *a_data, const size_t a_size) noexcept
+  {
+    if (a_size > max_message_size()) return false;
+
+    auto position = control_->enqueue.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &slot = cell(position);
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<int64_t>(sequence - position);
+
+      if (diff == 0) {
+        if (control_->enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          slot.size = a_size;
+          if (a_size > 0) std::memcpy(payload(slot), a_data, a_size);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // Full
+      } else {
+        position = control_->enqueue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template<typename CallbackT>
+  bool try_pop(CallbackT &&a_callback)
+  {
+    auto position = control_->dequeue.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &slot = cell(position);
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<int64_t>(sequence - (position + 1));
+
+      if (diff == 0) {
+        if (control_->dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          a_callback(std::span<const uint8_t>{payload(slot), static_cast<size_t>(slot.size)});
+          slot.sequence.store(position + capacity_, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // Empty
+      } else {
+        position = control_->dequeue.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  [[nodiscard]] Cell &cell(const uint64_t a_position) const noexcept
+  {
+    return *std::launder(reinterpret_cast<Cell *>(cells_ + (a_position & (capacity_ - 1)) * slot_size_));
+  }
+
+  static uint8_t *payload(Cell &a_cell) noexcept
+  {
+    return reinterpret_cast<uint8_t *>(&a_cell) + sizeof(Cell);
+  }
+
+  Control *control_{nullptr};
+  char *cells_{nullptr};
+  size_t capacity_{0};
+  size_t slot_size_{0};
+};
+
+#pragma endregion
+
+#pragma region - Channel
+
+/**
+   Encodes objects to, and decodes them from, the payload of a message, see MsgpackCodec in
+   ipc/msgpack_codec.hpp and ZppBitsCodec in ipc/zpp_bits_codec.hpp.
+ */
+template<typename CodecT, typename T>
+concept PayloadCodec = requires(const T &a_value, T &a_result, std::vector<uint8_t> &a_buffer,
+                                std::span<const uint8_t> a_payload, std::error_code &a_error) {
+  { CodecT::encode(a_value, a_buffer, a_error) } -> std::same_as<void>;
+  { CodecT::decode(a_payload, a_result, a_error) } -> std::same_as<void>;
+};
+
+/**
+   A message channel between processes on the host, through a named shared memory segment
+   laid out as a ChannelHeader followed by the ring. Sending and receiving are lock free, and
+   the blocking calls spin briefly before sleeping, see `detail::wait_for`.
+
+   A process dying while sending or receiving may leave the channel stuck, as with any lock free
+   queue in shared memory.
+
+   @code
+     // Producer process
+     ipc::SpscChannel channel("wxlib_paths", {.capacity = 16 << 20});
+     channel.send(path.data(), path.size());
+
+     // Consumer process
+     ipc::SpscChannel channel("wxlib_paths");
+     channel.receive([](std::span<const uint8_t> a_message) { ... });
+   @endcode
+ */
+template<typename RingT>
+class BasicChannel
+{
+public:
+  /**
+     Opens or creates the named channel. If it fails, std::system_error will be thrown with error
+     code describing the nature of the error, e.g. `errc::wrong_protocol_type` if the segment is
+     not a channel of this kind.
+
+     \param   a_name  The name of the channel segment.
+     \param   a_options  Sizes of the channel if created.
+     \param   a_mode  Whether to create, open, or either.
+   */
+  explicit BasicChannel(const std::string &a_name, const ChannelOptions &a_options = {},
+                        const OpenMode a_mode = OpenMode::OpenOrCreate)
+  {
+    auto header = detail::ChannelHeader{};
+    RingT::configure(header, a_options);
+
+    segment_ = SharedMemory(a_name, sizeof(detail::ChannelHeader) + RingT::ring_size(header), a_mode);
+    char *base = segment_.data();
+
+    if (segment_.created()) {
+      header_ = new (base) detail::ChannelHeader{};
+      header_->kind = RingT::kind;
+      header_->capacity = header.capacity;
+      header_->slot_size = header.slot_size;
+      ring_.attach(*header_, base + sizeof(detail::ChannelHeader), true);
+      header_->state.store(detail::ChannelHeader::ready, std::memory_order_release);
+      return;
+    }
+
+    header_ = std::launder(reinterpret_cast<detail::ChannelHeader *>(base));
+    std::error_code error;
+    if (!wait_until_ready(error)) throw std::system_error(error);
+    ring_.attach(*header_, base + sizeof(detail::ChannelHeader), false);
+  }
+
+  BasicChannel(const BasicChannel &) = delete;
+  BasicChannel &operator=(const BasicChannel &) = delete;
+
+  /**
+     Removes the named channel, see SharedMemory::remove().
+   */
+  static bool remove(const std::string &a_name) noexcept
+  {
+    return SharedMemory::remove(a_name);
+  }
+
+  [[nodiscard]] const std::string &name() const noexcept
+  {
+    return segment_.name();
+  }
+
+  /**
+     Checks whether this instance created the channel.
+   */
+  [[nodiscard]] bool created() const noexcept
+  {
+    return segment_.created();
+  }
+
+  /**
+     Size in bytes of the largest message, larger ones are never sent.
+   */
+  [[nodiscard]] size_t max_message_size() const noexcept
+  {
+    return ring_.max_message_size();
+  }
+
+  /**
+     Sends a message if there is room for it.
+
+     \returns Whether the message was sent.
+   */
+  bool try_send(const void *a_data, const size_t a_size) noexcept
+  {
+    if (!ring_.try_push(a_data, a_size)) return false;
+    detail::notify(header_->readable);
+    return true;
+  }
+
+  bool try_send(const std::span<const uint8_t> a_message) noexcept
+  {
+    return try_send(a_message.data(), a_message.size());
+  }
+
+  /**
+     Sends a message, waiting up to the timeout for room for it.
+
+     \returns Whether the message was sent, false if timed out or larger than max_message_size().
+   */
+  bool send(const void *a_data, const size_t a_size, const std::chrono::nanoseconds a_timeout = infinite) noexcept
+  {
+    if (a_size > max_message_size()) return false;
+
+    for (;;) {
+      if (try_send(a_data, a_size)) return true;
+      if (!detail::wait_for(header_->writable, [&] { return ring_.writable(a_size); }, a_timeout))
+        return try_send(a_data, a_size);
+    }
+  }
+
+  bool send(const std::span<const uint8_t> a_message, const std::chrono::nanoseconds a_timeout = infinite) noexcept
+  {
+    return send(a_message.data(), a_message.size(), a_timeout);
+  }
+
+  /**
+     Writes a message in place in the ring if there is room for one of `a_max_size` bytes, i.e.,
+     without copying, by `a_writer(std::span<uint8_t>)` returning the size of the message, or
+     more than `a_max_size` to drop it. The message reaches the consumer with the next flush() or
+     send, so that a batch of messages rings the doorbell of the consumer once.
+
+     \returns Whether the message was written.
+   */
+  template<typename WriterT>
+  requires std::is_invocable_r_v<size_t, WriterT, std::span<uint8_t>> && requires(RingT &a_ring) { a_ring.try_prepare(size_t{}); }
+  bool try_write(const size_t a_max_size, WriterT &&a_writer)
+  {
+    auto *payload = ring_.try_prepare(a_max_size);
+    return payload != nullptr && commit(payload, a_max_size, a_writer);
+  }
+
+  /**
+     Writes a message in place, waiting up to the timeout for room for it, see try_write(). The
+     pending messages are flushed before waiting.
+
+     \returns Whether the message was written, false if timed out, dropped by the writer, or if
+              `a_max_size` is larger than max_message_size().
+   */
+  template<typename WriterT>
+  requires std::is_invocable_r_v<size_t, WriterT, std::span<uint8_t>> && requires(RingT &a_ring) { a_ring.try_prepare(size_t{}); }
+  bool write(const size_t a_max_size, WriterT &&a_writer, const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    if (a_max_size > max_message_size()) return false;
+
+    for (;;) {
+      if (auto *payload = ring_.try_prepare(a_max_size)) return commit(payload, a_max_size, a_writer);
+
+      flush();
+      if (!detail::wait_for(header_->writable, [&] { return ring_.writable(a_max_size); }, a_timeout)) {
+        auto *payload = ring_.try_prepare(a_max_size);
+        return payload != nullptr && commit(payload, a_max_size, a_writer);
+      }
+    }
+  }
+
+  /**
+     Hands the messages written by try_write() or write() over to the consumer, waking it once.
+   */
+  void flush() noexcept
+    requires requires(RingT &a_ring) { a_ring.publish(); }
+  {
+    if (ring_.publish()) detail::notify(header_->readable);
+  }
+
+  /**
+     Receives a message if any, handing it to the callback in place in shared memory, i.e.,
+     without copying. The message is only valid for the duration of the call.
+
+     \returns Whether a message was received.
+   */
+  template<typename CallbackT>
+  requires std::invocable<CallbackT, std::span<const uint8_t>>
+  bool try_receive(CallbackT &&a_callback)
+  {
+    if (!ring_.try_pop(std::forward<CallbackT>(a_callback))) return false;
+    detail::notify(header_->writable);
+    return true;
+  }
+
+  /**
+     Receives a message if any, copying it into the buffer.
+   */
+  bool try_receive(std::vector<uint8_t> &a_buffer)
+  {
+    return try_receive([&](const std::span<const uint8_t> a_message) { a_buffer.assign(a_message.begin(), a_message.end()); });
+  }
+
+  /**
+     Receives a message, waiting up to the timeout for one, see try_receive().
+
+     \returns Whether a message was received, false if timed out.
+   */
+  template<typename CallbackT>
+  requires std::invocable<CallbackT, std::span<const uint8_t>>
+  bool receive(CallbackT &&a_callback, const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    for (;;) {
+      if (try_receive(a_callback)) return true;
+      if (!detail::wait_for(header_->readable, [&] { return ring_.readable(); }, a_timeout))
+        return try_receive(a_callback);
+    }
+  }
+
+  bool receive(std::vector<uint8_t> &a_buffer, const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    return receive([&](const std::span<const uint8_t> a_message) { a_buffer.assign(a_message.begin(), a_message.end()); }, a_timeout);
+  }
+
+  /**
+     Encodes the object with the codec and sends it, waiting up to the timeout for room for it.
+
+     \param   a_error  Set if the object fails to encode, or is larger than max_message_size()
+              (`errc::message_size`).
+     \returns Whether the object was sent.
+   */
+  template<typename CodecT, typename T>
+  requires PayloadCodec<CodecT, T>
+  bool send_object(const T &a_value, std::error_code &a_error, const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    thread_local std::vector<uint8_t> buffer;
+    a_error.clear();
+    buffer.clear();
+
+    CodecT::encode(a_value, buffer, a_error);
+    if (a_error) return false;
+
+    if (buffer.size() > max_message_size()) {
+      a_error = std::make_error_code(std::errc::message_size);
+      return false;
+    }
+
+    return send(buffer.data(), buffer.size(), a_timeout);
+  }
+
+  /**
+     Receives a message, waiting up to the timeout for one, and decodes it with the codec in
+     place in shared memory.
+
+     \param   a_error  Set if the message fails to decode.
+     \returns Whether a message was received, even if failing to decode.
+   */
+  template<typename CodecT, typename T>
+  requires PayloadCodec<CodecT, T>
+  bool receive_object(T &a_value, std::error_code &a_error, const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    a_error.clear();
+    return receive([&](const std::span<const uint8_t> a_message) { CodecT::decode(a_message, a_value, a_error); }, a_timeout);
+  }
+
+private:
+  template<typename WriterT>
+  bool commit(uint8_t *a_payload, const size_t a_max_size, WriterT &a_writer)
+  {
+    const size_t size = a_writer(std::span<uint8_t>{a_payload, a_max_size});
+    if (size > a_max_size) return false;
+    ring_.commit(size);
+    return true;
+  }
+
+  bool wait_until_ready(std::error_code &error) const noexcept
+  {
+    // The creator may not have filled in the header yet.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+    while (header_->state.load(std::memory_order_acquire) != detail::ChannelHeader::ready) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        error = std::make_error_code(std::errc::timed_out);
+        return false;
+      }
+      std::this_thread::yield();
+    }
+
+    if (header_->magic != detail::ChannelHeader::magic_number || header_->kind != RingT::kind
+        || segment_.size() < sizeof(detail::ChannelHeader) + RingT::ring_size(*header_)) {
+      error = std::make_error_code(std::errc::wrong_protocol_type);
+      return false;
+    }
+
+    return true;
+  }
+
+  SharedMemory segment_;
+  detail::ChannelHeader *header_{nullptr};
+  RingT ring_;
+};
+
+/**
+   A channel from one producer to one consumer, of variable length messages, using all of its
+   capacity.
+ */
+using SpscChannel = BasicChannel<SpscRing>;
+
+/**
+   A channel from any number of producers to any number of consumers, of messages up to
+   `ChannelOptions::max_message_size` bytes, each taking a fixed size slot.
+ */
+using MpmcChannel = BasicChannel<MpmcRing>;
+
+#pragma endregion
+
+}
+#endif
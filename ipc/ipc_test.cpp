@@ -0,0 +1,613 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <ipc/ipc.hpp>
+#include <ipc/csv_transcoder.hpp>
+#include <ipc/dataset.hpp>
+#include <ipc/msgpack_codec.hpp>
+#include <ipc/zpp_bits_codec.hpp>
+#include <ipc/zpp_bits_rpc.hpp>
+
+namespace {
+
+std::string unique_name(const std::string &a_prefix)
+{
+#ifdef _WIN32
+  return a_prefix + "_" + std::to_string(::GetCurrentProcessId());
+#else
+  return a_prefix + "_" + std::to_string(::getpid());
+#endif
+}
+
+std::vector<uint8_t> make_message(const uint32_t a_index)
+{
+  std::vector<uint8_t> message(a_index % 97 + sizeof(a_index));
+  std::memcpy(message.data(), &a_index, sizeof(a_index));
+  for (size_t i = sizeof(a_index); i < message.size(); ++i) message[i] = static_cast<uint8_t>(a_index + i);
+  return message;
+}
+
+struct Vehicle
+{
+  uint32_t id{0};
+  std::string route;
+  double speed{0.0};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(id, route, speed);
+  }
+};
+
+struct Link
+{
+  uint32_t from;
+  uint32_t to;
+  double length;
+};
+
+struct Node
+{
+  ipc::OffsetString name;
+  ipc::OffsetArray<uint32_t> out_links;
+};
+
+struct Network
+{
+  ipc::OffsetArray<Link> links;
+  ipc::OffsetArray<Node> nodes;
+  ipc::OffsetPtr<const Node> depot;
+};
+
+bool check_network(const Network &a_network)
+{
+  if (a_network.links.size() != 1000 || a_network.nodes.size() != 100) return false;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    const auto &link = a_network.links[i];
+    if (link.from != i % 100 || link.to != (i + 1) % 100 || link.length != i * 0.5) return false;
+  }
+  for (uint32_t n = 0; n < 100; ++n) {
+    const auto &node = a_network.nodes[n];
+    if (node.name != "node " + std::to_string(n) || node.out_links.size() != 10) return false;
+    for (const auto link: node.out_links)
+      if (a_network.links[link].from != n) return false;
+  }
+  return a_network.depot.get() == &a_network.nodes[42];
+}
+
+double travel_time(const uint32_t a_link, const double a_volume)
+{
+  return a_link + a_volume / 100.0;
+}
+
+std::string link_name(const uint32_t a_link)
+{
+  return "link " + std::to_string(a_link);
+}
+
+struct Counter
+{
+  void add(const int a_value)
+  {
+    total += a_value;
+  }
+
+  int total{0};
+};
+
+using namespace zpp::bits::literals;
+
+using TrafficRpc = zpp::bits::rpc<zpp::bits::bind<travel_time, "travel_time"_sha256_int>,
+                                  zpp::bits::bind<link_name, "link_name"_sha256_int>>;
+
+using CounterRpc = zpp::bits::rpc<zpp::bits::bind<&Counter::add, "add"_sha256_int>>;
+
+}
+
+TEST_CASE("ipc")
+{
+  SUBCASE("shared memory") {
+    const auto name = unique_name("wxlib_ipc_segment");
+    ipc::SharedMemory::remove(name);
+
+    ipc::SharedMemory creator(name, 10000, ipc::OpenMode::Create);
+    CHECK(creator.is_open());
+    CHECK(creator.created());
+    CHECK(creator.size() == 10000);
+    CHECK(creator.data()[9999] == 0);
+    std::memcpy(creator.data(), "hello", 5);
+
+    ipc::SharedMemory opener(name, 0, ipc::OpenMode::Open);
+    CHECK_FALSE(opener.created());
+    CHECK(opener.size() == 10000);
+    CHECK(std::memcmp(opener.data(), "hello", 5) == 0);
+
+    ipc::SharedMemory either(name, 10000);
+    CHECK_FALSE(either.created());
+
+    std::error_code error;
+    ipc::SharedMemory duplicate;
+    duplicate.open(name, 10000, ipc::OpenMode::Create, error);
+    CHECK(error == std::errc::file_exists);
+    CHECK_FALSE(duplicate.is_open());
+
+    auto moved = std::move(opener);
+    CHECK(moved.is_open());
+    CHECK_FALSE(opener.is_open());
+
+    CHECK(ipc::SharedMemory::remove(name));
+    CHECK_THROWS_AS(ipc::SharedMemory(name, 0, ipc::OpenMode::Open), std::system_error);
+  }
+
+  SUBCASE("spsc channel") {
+    const auto name = unique_name("wxlib_ipc_spsc");
+    ipc::SpscChannel::remove(name);
+
+    ipc::SpscChannel producer(name, {.capacity = 4096, .max_message_size = 256});
+    ipc::SpscChannel consumer(name);
+    CHECK(producer.created());
+    CHECK_FALSE(consumer.created());
+    CHECK(producer.max_message_size() == 4096 / 2 - 8);
+
+    std::vector<uint8_t> received;
+    CHECK_FALSE(consumer.try_receive(received));
+    CHECK_FALSE(producer.try_send(std::vector<uint8_t>(producer.max_message_size() + 1)));
+    CHECK(producer.try_send(nullptr, 0));
+    CHECK(consumer.try_receive(received));
+    CHECK(received.empty());
+
+    // Fills the ring, then drains it, wrapping around several times.
+    for (uint32_t round = 0; round < 10; ++round) {
+      uint32_t sent = 0;
+      while (producer.try_send(make_message(round * 1000 + sent))) sent++;
+      CHECK(sent > 10);
+
+      for (uint32_t i = 0; i < sent; ++i) {
+        REQUIRE(consumer.try_receive(received));
+        CHECK(received == make_message(round * 1000 + i));
+      }
+      CHECK_FALSE(consumer.try_receive(received));
+    }
+
+    // A producer and a consumer thread, with the consumer mostly blocked.
+    constexpr uint32_t message_count = 200000;
+    std::thread thread([&] {
+      for (uint32_t i = 0; i < message_count; ++i) producer.send(make_message(i));
+    });
+
+    auto mismatches = 0;
+    for (uint32_t i = 0; i < message_count; ++i) {
+      consumer.receive([&](const std::span<const uint8_t> a_message) {
+        const auto expected = make_message(i);
+        if (!std::equal(a_message.begin(), a_message.end(), expected.begin(), expected.end())) mismatches++;
+      });
+    }
+    thread.join();
+    CHECK(mismatches == 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    CHECK_FALSE(consumer.receive(received, std::chrono::milliseconds{20}));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{20});
+
+    CHECK_THROWS_AS(ipc::MpmcChannel{name}, std::system_error);
+    ipc::SpscChannel::remove(name);
+  }
+
+  SUBCASE("spsc in place writes") {
+    const auto name = unique_name("wxlib_ipc_spsc_in_place");
+    ipc::SpscChannel::remove(name);
+
+    ipc::SpscChannel producer(name, {.capacity = 4096, .max_message_size = 256});
+    ipc::SpscChannel consumer(name);
+
+    // Messages written in place reach the consumer only once flushed.
+    std::vector<uint8_t> received;
+    for (uint32_t i = 0; i < 5; ++i) {
+      CHECK(producer.try_write(256, [&](const std::span<uint8_t> a_payload) {
+        const auto message = make_message(i);
+        std::copy(message.begin(), message.end(), a_payload.begin());
+        return message.size();
+      }));
+    }
+    CHECK_FALSE(producer.try_write(256, [](std::span<uint8_t> a_payload) { return a_payload.size() + 1; }));
+    CHECK_FALSE(consumer.try_receive(received));
+
+    producer.flush();
+    for (uint32_t i = 0; i < 5; ++i) {
+      REQUIRE(consumer.try_receive(received));
+      CHECK(received == make_message(i));
+    }
+    CHECK_FALSE(consumer.try_receive(received));
+
+    // Fills the ring without flushing, wrapping around, then drains it.
+    for (uint32_t round = 0; round < 10; ++round) {
+      uint32_t written = 0;
+      while (producer.try_write(128, [&](const std::span<uint8_t> a_payload) {
+        const auto message = make_message(round * 1000 + written);
+        std::copy_n(message.begin(), std::min(message.size(), a_payload.size()), a_payload.begin());
+        return std::min(message.size(), a_payload.size());
+      })) {
+        written++;
+      }
+      CHECK(written > 10);
+      producer.flush();
+
+      for (uint32_t i = 0; i < written; ++i) {
+        REQUIRE(consumer.try_receive(received));
+        auto expected = make_message(round * 1000 + i);
+        expected.resize(std::min<size_t>(expected.size(), 128));
+        CHECK(received == expected);
+      }
+      CHECK_FALSE(consumer.try_receive(received));
+    }
+
+    CHECK_FALSE(producer.write(producer.max_message_size() + 1, [](std::span<uint8_t>) { return size_t{0}; }));
+    ipc::SpscChannel::remove(name);
+  }
+
+  SUBCASE("mpmc channel") {
+    const auto name = unique_name("wxlib_ipc_mpmc");
+    ipc::MpmcChannel::remove(name);
+
+    ipc::MpmcChannel channel(name, {.capacity = 64 * 128, .max_message_size = 100});
+    CHECK(channel.max_message_size() >= 100);
+    CHECK_FALSE(channel.try_send(std::vector<uint8_t>(channel.max_message_size() + 1)));
+
+    uint32_t sent = 0;
+    while (channel.try_send(make_message(sent))) sent++;
+    CHECK(sent == 64);
+
+    std::vector<uint8_t> received;
+    for (uint32_t i = 0; i < sent; ++i) {
+      REQUIRE(channel.try_receive(received));
+      CHECK(received == make_message(i));
+    }
+    CHECK_FALSE(channel.try_receive(received));
+
+    // Producers and consumers sharing one channel object, as threads of a process would.
+    constexpr uint32_t producer_count = 4;
+    constexpr uint32_t consumer_count = 4;
+    constexpr uint32_t message_count = 50000;
+
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint32_t> received_count{0};
+    std::vector<std::thread> threads;
+
+    for (uint32_t p = 0; p < producer_count; ++p) {
+      threads.emplace_back([&, p] {
+        for (uint32_t i = p; i < message_count * producer_count; i += producer_count) channel.send(&i, sizeof(i));
+      });
+    }
+
+    for (uint32_t c = 0; c < consumer_count; ++c) {
+      threads.emplace_back([&] {
+        while (received_count.load() < message_count * producer_count) {
+          channel.receive([&](const std::span<const uint8_t> a_message) {
+            uint32_t value;
+            std::memcpy(&value, a_message.data(), sizeof(value));
+            sum += value;
+            received_count++;
+          }, std::chrono::milliseconds{10});
+        }
+      });
+    }
+
+    for (auto &thread: threads) thread.join();
+
+    const uint64_t n = message_count * producer_count;
+    CHECK(received_count == n);
+    CHECK(sum == n * (n - 1) / 2);
+    ipc::MpmcChannel::remove(name);
+  }
+
+#ifndef _WIN32
+  SUBCASE("across processes") {
+    const auto request_name = unique_name("wxlib_ipc_request");
+    const auto reply_name = unique_name("wxlib_ipc_reply");
+    ipc::SpscChannel::remove(request_name);
+    ipc::SpscChannel::remove(reply_name);
+
+    ipc::SpscChannel requests(request_name);
+    ipc::SpscChannel replies(reply_name);
+
+    const auto pid = ::fork();
+    REQUIRE(pid >= 0);
+
+    if (pid == 0) {
+      // Echoes the requests, reversed, until an empty one.
+      ipc::SpscChannel child_requests(request_name, {}, ipc::OpenMode::Open);
+      ipc::SpscChannel child_replies(reply_name, {}, ipc::OpenMode::Open);
+      std::vector<uint8_t> message;
+      for (;;) {
+        if (!child_requests.receive(message, std::chrono::seconds{10})) ::_exit(1);
+        if (message.empty()) ::_exit(0);
+        std::reverse(message.begin(), message.end());
+        child_replies.send(message);
+      }
+    }
+
+    std::vector<uint8_t> reply;
+    auto mismatches = 0;
+    for (uint32_t i = 0; i < 10000; ++i) {
+      auto message = make_message(i);
+      requests.send(message);
+      REQUIRE(replies.receive(reply, std::chrono::seconds{10}));
+      std::reverse(message.begin(), message.end());
+      if (reply != message) mismatches++;
+    }
+    requests.send(nullptr, 0);
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    CHECK(mismatches == 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+
+    ipc::SpscChannel::remove(request_name);
+    ipc::SpscChannel::remove(reply_name);
+  }
+#endif
+
+  SUBCASE("dataset") {
+    const auto name = unique_name("wxlib_ipc_dataset");
+    ipc::DatasetBuilder::remove(name);
+
+    CHECK_THROWS_AS(ipc::Dataset<Network>{name}, std::system_error);
+
+    ipc::DatasetBuilder builder(name, 1 << 20, 7);
+    CHECK_THROWS_AS(ipc::Dataset<Network>{name}, std::system_error); // Not published yet
+
+    std::vector<Link> links;
+    for (uint32_t i = 0; i < 1000; ++i) links.push_back({i % 100, (i + 1) % 100, i * 0.5});
+
+    auto *network = builder.construct<Network>();
+    network->links = builder.make_array(std::span<const Link>{links});
+    network->nodes = builder.make_array<Node>(100);
+    for (uint32_t n = 0; n < 100; ++n) {
+      auto &node = network->nodes[n];
+      node.name = builder.make_string("node " + std::to_string(n));
+      node.out_links = builder.make_array<uint32_t>(10);
+      for (uint32_t k = 0; k < 10; ++k) node.out_links[k] = n + k * 100;
+    }
+    network->depot = &network->nodes[42];
+    CHECK_THROWS_AS(static_cast<void>(builder.allocate(1 << 20)), std::bad_alloc);
+    builder.publish(network);
+
+    // Attached read-only at another address than the builder's mapping.
+    const ipc::Dataset<Network> dataset(name, {}, 7);
+    CHECK(static_cast<const void *>(&dataset.root()) != static_cast<const void *>(network));
+    CHECK(dataset.size() == builder.size());
+    CHECK(check_network(*dataset));
+
+    const auto copy = dataset;
+    CHECK(&copy.root() == &dataset.root());
+    CHECK_THROWS_AS(ipc::Dataset<Network>(name, {}, 8), std::system_error);
+    CHECK_THROWS_AS(ipc::Dataset<Link>{name}, std::system_error);
+
+#ifndef _WIN32
+    const auto pid = ::fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+      const ipc::Dataset<Network> attached(name, std::chrono::seconds{10}, 7);
+      ::_exit(check_network(attached.root()) ? 0 : 1);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+#endif
+
+    ipc::DatasetBuilder::remove(name);
+  }
+
+  SUBCASE("payload codecs") {
+    const auto name = unique_name("wxlib_ipc_codec");
+    ipc::SpscChannel::remove(name);
+    ipc::SpscChannel channel(name, {.capacity = 4096, .max_message_size = 1024});
+
+    std::error_code error;
+    const auto vehicle = Vehicle{42, "I-95 North", 28.5};
+
+    CHECK(channel.send_object<ipc::MsgpackCodec>(vehicle, error));
+    CHECK_FALSE(error);
+    auto unpacked = Vehicle{};
+    CHECK(channel.receive_object<ipc::MsgpackCodec>(unpacked, error));
+    CHECK_FALSE(error);
+    CHECK(unpacked.id == 42);
+    CHECK(unpacked.route == "I-95 North");
+    CHECK(unpacked.speed == 28.5);
+
+    CHECK(channel.send_object<ipc::ZppBitsCodec>(vehicle, error));
+    CHECK_FALSE(error);
+    auto deserialized = Vehicle{};
+    CHECK(channel.receive_object<ipc::ZppBitsCodec>(deserialized, error));
+    CHECK_FALSE(error);
+    CHECK(deserialized.id == 42);
+    CHECK(deserialized.route == "I-95 North");
+    CHECK(deserialized.speed == 28.5);
+
+    const auto oversized = Vehicle{1, std::string(4096, 'x'), 0.0};
+    CHECK_FALSE(channel.send_object<ipc::ZppBitsCodec>(oversized, error));
+    CHECK(error == std::errc::message_size);
+
+    ipc::SpscChannel::remove(name);
+  }
+
+  SUBCASE("csv transcoder") {
+    using namespace mio::csv;
+
+    const auto record_count = uint32_t{5000};
+    std::string buffer = "id,route,skip,speed\n";
+    for (uint32_t i = 0; i < record_count; ++i)
+      buffer.append(std::to_string(i)).append(",\"r,").append(std::to_string(i % 7)).append("\",x,").append(std::to_string(i % 50)).append(".5\n");
+
+    const auto path = unique_name("test-csv-transcoder");
+    std::ofstream file(path, std::ios::binary);
+    file << buffer;
+    file.close();
+
+    using Schema = std::tuple<uint32_t, std::string, double>;
+
+    auto check_records = [&](auto &&a_decode) {
+      auto mismatches = 0;
+      for (uint32_t i = 0; i < record_count; ++i) {
+        auto record = Schema{};
+        if (!a_decode(record)) return false;
+        if (record != Schema{i, "r," + std::to_string(i % 7), i % 50 + 0.5}) mismatches++;
+      }
+      return mismatches == 0;
+    };
+
+    SUBCASE("ordered msgpack arrays") {
+      ipc::CsvTranscoder<ipc::MsgpackRecordEncoder, Field<NAME("id"), uint32_t>, Field<NAME("route"), Unquoted>,
+                         Field<NAME("skip"), Skipped>, Field<NAME("speed"), double>> transcoder(path);
+      REQUIRE(transcoder.is_mapped());
+
+      std::error_code error;
+      auto bytes = std::vector<uint8_t>{};
+      auto offset = size_t{0};
+      auto in_order = true;
+      const auto n = transcoder.transcode([&](int, const size_t a_offset, std::span<const uint8_t> a_bytes, size_t) {
+        in_order = in_order && a_offset >= offset;
+        offset = a_offset;
+        bytes.insert(bytes.end(), a_bytes.begin(), a_bytes.end());
+        return 0;
+      }, ipc::CsvDelivery::Ordered, error, 4, 1024);
+
+      CHECK_FALSE(error);
+      CHECK(n == record_count);
+      CHECK(in_order);
+      CHECK(transcoder.invalid_field_count() == 0);
+
+      auto unpacker = msgpack::Unpacker(bytes.data(), bytes.size());
+      CHECK(check_records([&](Schema &a_record) {
+        const auto *header = bytes.data() + bytes.size() - unpacker.remaining();
+        if (*header != (0x90 | 3)) return false;
+        unpacker.reset(header + 1, unpacker.remaining() - 1);
+        auto &[id, route, speed] = a_record;
+        unpacker.process(id, route, speed);
+        return !unpacker.ec;
+      }));
+    }
+
+    SUBCASE("framed zpp_bits records") {
+      ipc::CsvTranscoder<ipc::ZppBitsRecordEncoder, Field<NAME("id"), uint32_t>, Field<NAME("route"), Unquoted>,
+                         Field<NAME("skip"), Skipped>, Field<NAME("speed"), double>> transcoder(path);
+      REQUIRE(transcoder.is_mapped());
+
+      std::error_code error;
+      std::mutex mutex;
+      auto blocks = std::map<size_t, std::vector<uint8_t>>{};
+      const auto n = transcoder.transcode([&](int, const size_t a_offset, std::span<const uint8_t> a_bytes, size_t) {
+        const std::lock_guard lock(mutex);
+        blocks.emplace(a_offset, std::vector<uint8_t>(a_bytes.begin(), a_bytes.end()));
+        return 0;
+      }, ipc::CsvDelivery::Framed, error, 4, 1024);
+
+      CHECK_FALSE(error);
+      CHECK(n == record_count);
+      CHECK(blocks.size() > 1);
+
+      auto bytes = std::vector<uint8_t>{};
+      for (const auto &[offset, block]: blocks) bytes.insert(bytes.end(), block.begin(), block.end());
+      auto in = zpp::bits::in{bytes};
+      CHECK(check_records([&](Schema &a_record) {
+        return zpp::bits::success(in(a_record));
+      }));
+    }
+
+    SUBCASE("sink stops the workers") {
+      ipc::CsvTranscoder<ipc::MsgpackRecordEncoder, Field<NAME("id"), uint32_t>, Field<NAME("route"), std::string_view>,
+                         Field<NAME("skip"), Skipped>, Field<NAME("speed"), double>> transcoder(path);
+      std::error_code error;
+      auto calls = std::atomic<int>{0};
+      const auto n = transcoder.transcode([&](int, size_t, std::span<const uint8_t>, size_t) {
+        return ++calls == 1 ? 0 : -1;
+      }, ipc::CsvDelivery::Ordered, error, 2, 1024);
+      CHECK_FALSE(error);
+      CHECK(n < record_count);
+    }
+
+    std::remove(path.c_str());
+  }
+
+  SUBCASE("zpp_bits rpc") {
+    const auto name = unique_name("wxlib_ipc_rpc");
+    ipc::RpcClient<TrafficRpc>::remove(name);
+
+    ipc::RpcServer<TrafficRpc> server(name, {.capacity = 1 << 16, .max_message_size = 256});
+    ipc::RpcClient<TrafficRpc> client(name);
+
+    std::atomic<bool> running{true};
+    std::thread thread([&] {
+      while (running) server.serve(std::chrono::milliseconds{10});
+    });
+
+    CHECK(client.call<"travel_time"_sha256_int>(7u, 250.0).or_throw() == 9.5);
+    CHECK(client.call<"link_name"_sha256_int>(12u).or_throw() == "link 12");
+
+    // A batch of calls wakes the server once, and their results come back in order.
+    for (uint32_t i = 0; i < 100; ++i) REQUIRE(zpp::bits::success(client.post<"travel_time"_sha256_int>(i, 100.0 * i)));
+    client.flush();
+    auto mismatches = 0;
+    for (uint32_t i = 0; i < 100; ++i) {
+      if (client.receive<"travel_time"_sha256_int>().or_throw() != 2.0 * i) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    // Receiving with no call pending times out.
+    CHECK(client.post<"link_name"_sha256_int>(1u) == std::errc{});
+    client.flush();
+    CHECK(client.receive<"link_name"_sha256_int>().or_throw() == "link 1");
+    CHECK(client.receive<"link_name"_sha256_int>(std::chrono::milliseconds{20}).error() == std::errc::timed_out);
+
+    // Many calls back to back, from one client.
+    for (uint32_t i = 0; i < 10000; ++i) {
+      if (client.call<"travel_time"_sha256_int>(i, 0.0).or_throw() != i) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    running = false;
+    thread.join();
+    ipc::RpcClient<TrafficRpc>::remove(name);
+
+    // Member functions are called on the context of the server, and void results still return.
+    const auto counter_name = unique_name("wxlib_ipc_rpc_counter");
+    ipc::RpcClient<CounterRpc>::remove(counter_name);
+    Counter counter;
+    ipc::RpcServer<CounterRpc, Counter> counter_server(counter_name, counter);
+    ipc::RpcClient<CounterRpc> counter_client(counter_name);
+
+    CHECK(zpp::bits::success(counter_client.post<"add"_sha256_int>(3)));
+    CHECK(zpp::bits::success(counter_client.post<"add"_sha256_int>(4)));
+    counter_client.flush();
+    CHECK(counter_server.serve(std::chrono::milliseconds{0}) == 2);
+    CHECK(zpp::bits::success(counter_client.receive<"add"_sha256_int>()));
+    CHECK(zpp::bits::success(counter_client.receive<"add"_sha256_int>()));
+    CHECK(counter.total == 7);
+    CHECK(counter_server.serve(std::chrono::milliseconds{0}) == 0);
+
+    ipc::RpcClient<CounterRpc>::remove(counter_name);
+  }
+}
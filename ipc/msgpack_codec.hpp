@@ -0,0 +1,41 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_MSGPACK_CODEC_HPP
+#define WXLIB_IPC_MSGPACK_CODEC_HPP
+
+#include <ipc/ipc.hpp>
+#include <msgpack/msgpack.hpp>
+
+namespace ipc {
+
+/**
+   Payload codec of msgpack::Serializable objects, for BasicChannel::send_object() and
+   BasicChannel::receive_object().
+
+   @code
+     channel.send_object<ipc::MsgpackCodec>(vehicle, error);
+   @endcode
+ */
+struct MsgpackCodec
+{
+  template<typename T>
+  requires msgpack::Serializable<T>
+  static void encode(const T &a_value, std::vector<uint8_t> &a_buffer, std::error_code &a_error)
+  {
+    // Packing does not modify the object, only Packable::pack() is not const.
+    a_buffer = msgpack::pack(const_cast<T &>(a_value), a_error);
+  }
+
+  template<typename T>
+  requires msgpack::Serializable<T>
+  static void decode(const std::span<const uint8_t> a_payload, T &a_result, std::error_code &a_error)
+  {
+    a_result = msgpack::unpack<T>(a_payload.data(), a_payload.size(), a_error);
+  }
+};
+
+}
+#endif
@@ -0,0 +1,40 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_ZPP_BITS_CODEC_HPP
+#define WXLIB_IPC_ZPP_BITS_CODEC_HPP
+
+#include <ipc/ipc.hpp>
+#include <zpp_bits/zpp_bits.h>
+
+namespace ipc {
+
+/**
+   Payload codec of objects serializable by zpp::bits, e.g. aggregates, for
+   BasicChannel::send_object() and BasicChannel::receive_object().
+
+   @code
+     channel.send_object<ipc::ZppBitsCodec>(vehicle, error);
+   @endcode
+ */
+struct ZppBitsCodec
+{
+  template<typename T>
+  static void encode(const T &a_value, std::vector<uint8_t> &a_buffer, std::error_code &a_error)
+  {
+    zpp::bits::out out{a_buffer};
+    if (const auto result = out(a_value); zpp::bits::failure(result)) a_error = std::make_error_code(result);
+  }
+
+  template<typename T>
+  static void decode(const std::span<const uint8_t> a_payload, T &a_result, std::error_code &a_error)
+  {
+    zpp::bits::in in{a_payload};
+    if (const auto result = in(a_result); zpp::bits::failure(result)) a_error = std::make_error_code(result);
+  }
+};
+
+}
+#endif
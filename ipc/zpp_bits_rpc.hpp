@@ -0,0 +1,273 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_IPC_ZPP_BITS_RPC_HPP
+#define WXLIB_IPC_ZPP_BITS_RPC_HPP
+
+#include <ipc/ipc.hpp>
+#include <zpp_bits/zpp_bits.h>
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <variant>
+
+namespace ipc {
+
+namespace detail {
+
+using RpcIn = zpp::bits::in<std::span<const uint8_t>>;
+using RpcOut = zpp::bits::out<std::span<uint8_t>>;
+
+inline std::string request_channel_name(const std::string &a_name)
+{
+  return a_name + "_requests";
+}
+
+inline std::string response_channel_name(const std::string &a_name)
+{
+  return a_name + "_responses";
+}
+
+}
+
+/**
+   The client end of a zpp::bits rpc over shared memory, a pair of SpscChannel, `<name>_requests`
+   and `<name>_responses`, instead of a socket. A call is serialized by `rpc::client` in place in
+   a slot of the request ring, and its result deserialized in place from the response ring, so
+   neither end copies a byte, nor makes a system call while the other end is busy.
+
+   Calls posted with post() are batched until flush(), which wakes the server once for all of
+   them; their results come back in order, each taken by receive(). call() posts, flushes and
+   receives one call. The calls posted and not yet received must fit in the response ring, or
+   the server waits on the client for room for their results while the client waits on the
+   server.
+
+   @code
+     using rpc = zpp::bits::rpc<zpp::bits::bind<route_cost, "route_cost"_sha256_int>>;
+
+     ipc::RpcClient<rpc> client("wxlib_router");
+     for (const auto &od: pairs) client.post<"route_cost"_sha256_int>(od.origin, od.destination).or_throw();
+     client.flush();
+     for (auto &cost: costs) cost = client.receive<"route_cost"_sha256_int>().or_throw();
+   @endcode
+ */
+template<typename RpcT>
+class RpcClient
+{
+public:
+  /**
+     Opens or creates the channels of the rpc. If it fails, std::system_error will be thrown,
+     see BasicChannel.
+
+     \param   a_name  The name of the rpc, prefix of its channels.
+     \param   a_options  Sizes of each channel if created, `max_message_size` bounding a call or a
+              result.
+   */
+  explicit RpcClient(const std::string &a_name, const ChannelOptions &a_options = {})
+      : requests_(detail::request_channel_name(a_name), a_options),
+        responses_(detail::response_channel_name(a_name), a_options),
+        max_message_size_(std::min(a_options.max_message_size, requests_.max_message_size()))
+  {
+  }
+
+  /**
+     Removes the channels of the rpc, see SharedMemory::remove().
+   */
+  static bool remove(const std::string &a_name) noexcept
+  {
+    const bool requests = SpscChannel::remove(detail::request_channel_name(a_name));
+    const bool responses = SpscChannel::remove(detail::response_channel_name(a_name));
+    return requests && responses;
+  }
+
+  /**
+     Serializes a call in place in the request ring, without waking the server, see flush().
+
+     \returns `errc::resource_unavailable_try_again` if the request ring is full, in which case
+              the pending calls are flushed, or the error serializing the call, e.g.
+              `errc::result_out_of_range` if larger than the maximum message size.
+   */
+  template<auto Id, auto MaxSize = -1>
+  zpp::bits::errc post(auto &&...a_arguments)
+  {
+    auto result = zpp::bits::errc{};
+    if (!requests_.try_write(max_message_size_, writer<Id, MaxSize>(result, a_arguments...))) {
+      if (zpp::bits::failure(result)) return result;
+      flush();
+      return std::errc::resource_unavailable_try_again;
+    }
+    return result;
+  }
+
+  /**
+     Wakes the server for the calls posted since the last flush.
+   */
+  void flush() noexcept
+  {
+    requests_.flush();
+  }
+
+  /**
+     Receives the result of the earliest posted call not yet received, waiting up to the timeout
+     for it, and deserializes it in place. The call must be of `Id`.
+
+     \returns The result, a `zpp::bits::value_or_errc`, or a `zpp::bits::errc` if the function
+              returns void; `errc::timed_out` if timed out, or the error of the server calling
+              the function, e.g. `errc::not_supported` for an unknown id.
+   */
+  template<auto Id, auto MaxSize = -1>
+  auto receive(const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    using response_type = decltype(std::declval<client_type &>().template response<Id, MaxSize>());
+    using result_type = std::conditional_t<std::is_void_v<response_type>, zpp::bits::errc, response_type>;
+
+    std::optional<result_type> result;
+    responses_.receive(
+        [&](std::span<const uint8_t> a_message) {
+          detail::RpcIn in{a_message};
+          auto status = std::errc{};
+          if (const auto read = in(status); zpp::bits::failure(read)) {
+            result.emplace(read);
+          } else if (status != std::errc{}) {
+            result.emplace(zpp::bits::errc{status});
+          } else if constexpr (std::is_void_v<response_type>) {
+            result.emplace();
+          } else {
+            auto empty = std::span<uint8_t>{};
+            detail::RpcOut out{empty};
+            result.emplace(client_type{in, out}.template response<Id, MaxSize>());
+          }
+        },
+        a_timeout);
+    return result ? std::move(*result) : result_type{zpp::bits::errc{std::errc::timed_out}};
+  }
+
+  /**
+     Calls the function, waiting for room for the call, then for its result, see receive().
+   */
+  template<auto Id, auto MaxSize = -1>
+  auto call(auto &&...a_arguments)
+  {
+    using result_type = decltype(receive<Id, MaxSize>());
+
+    auto serialized = zpp::bits::errc{};
+    if (!requests_.write(max_message_size_, writer<Id, MaxSize>(serialized, a_arguments...)))
+      return result_type{zpp::bits::failure(serialized) ? serialized : zpp::bits::errc{std::errc::message_size}};
+
+    flush();
+    return receive<Id, MaxSize>();
+  }
+
+private:
+  using client_type = typename RpcT::template client<detail::RpcIn &, detail::RpcOut &>;
+
+  /**
+     A writer of the call for BasicChannel::try_write(), dropping it on failure.
+   */
+  template<auto Id, auto MaxSize>
+  auto writer(zpp::bits::errc &a_result, auto &...a_arguments)
+  {
+    return [&, max = max_message_size_](std::span<uint8_t> a_payload) -> size_t {
+      auto empty = std::span<const uint8_t>{};
+      detail::RpcOut out{a_payload};
+      detail::RpcIn in{empty};
+      a_result = client_type{in, out}.template request<Id, MaxSize>(a_arguments...);
+      return zpp::bits::failure(a_result) ? max + 1 : out.position();
+    };
+  }
+
+  SpscChannel requests_;
+  SpscChannel responses_;
+  size_t max_message_size_;
+};
+
+/**
+   The server end of a zpp::bits rpc over shared memory, see RpcClient. serve() deserializes
+   each call in place from the request ring, calls the bound function through `rpc::server`, and
+   serializes its result in place into the response ring, prefixed by the `std::errc` of the
+   call, waking the client once per batch.
+
+   Member function bindings are called on the context, as with `rpc::server`.
+
+   @code
+     ipc::RpcServer<rpc> server("wxlib_router");
+     while (running) server.serve(std::chrono::milliseconds{100});
+   @endcode
+ */
+template<typename RpcT, typename ContextT = std::monostate>
+class RpcServer
+{
+public:
+  /**
+     Opens or creates the channels of the rpc, see RpcClient::RpcClient().
+   */
+  explicit RpcServer(const std::string &a_name, const ChannelOptions &a_options = {})
+    requires std::same_as<ContextT, std::monostate>
+      : RpcServer(a_name, monostate_, a_options)
+  {
+  }
+
+  /**
+     Opens or creates the channels of the rpc, calling member function bindings on the context,
+     which must outlive the server.
+   */
+  RpcServer(const std::string &a_name, ContextT &a_context, const ChannelOptions &a_options = {})
+      : requests_(detail::request_channel_name(a_name), a_options),
+        responses_(detail::response_channel_name(a_name), a_options),
+        max_message_size_(std::min(a_options.max_message_size, responses_.max_message_size())),
+        context_(a_context)
+  {
+  }
+
+  /**
+     Serves the calls posted, waiting up to the timeout for the first one, then until the request
+     ring is empty, and flushes their results.
+
+     \returns Number of calls served, 0 if timed out.
+   */
+  size_t serve(const std::chrono::nanoseconds a_timeout = infinite)
+  {
+    size_t served = 0;
+    const auto serve_one = [&](std::span<const uint8_t> a_message) {
+      // Waits for the client to take results, it cannot be waiting for room for calls here.
+      responses_.write(max_message_size_, [&](std::span<uint8_t> a_payload) -> size_t {
+        detail::RpcIn in{a_message};
+        detail::RpcOut out{a_payload};
+        if (const auto result = out(std::errc{}); zpp::bits::failure(result)) return a_payload.size() + 1;
+
+        if (const auto result = server(in, out).serve(); zpp::bits::failure(result)) {
+          out.reset();
+          (void)out(result.code); // Fits where the status did.
+        }
+        return out.position();
+      });
+      ++served;
+    };
+
+    if (!requests_.receive(serve_one, a_timeout)) return 0;
+    while (requests_.try_receive(serve_one)) {
+    }
+
+    responses_.flush();
+    return served;
+  }
+
+private:
+  auto server(detail::RpcIn &a_in, detail::RpcOut &a_out)
+  {
+    return typename RpcT::template server<detail::RpcIn &, detail::RpcOut &, ContextT &>{a_in, a_out, context_};
+  }
+
+  inline static std::monostate monostate_;
+
+  SpscChannel requests_;
+  SpscChannel responses_;
+  size_t max_message_size_;
+  ContextT &context_;
+};
+
+}
+#endif
@@ -14,18 +14,42 @@
 #include <algorithm>
 #include <any>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
 #include <stdexcept>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <variant>
 
 namespace matchit {
 
 namespace impl {
 
+// throws std::logic_error, or aborts if built without exceptions or with
+// WXLIB_MATCHIT_NO_EXCEPTIONS defined
+[[noreturn]] inline void raise_logic_error(char const *a_what)
+{
+#if defined(WXLIB_MATCHIT_NO_EXCEPTIONS) || !defined(__cpp_exceptions)
+  static_cast<void>(a_what);
+  std::abort();
+#else
+  throw std::logic_error{a_what};
+#endif
+}
+
+// tuple-like values are accessed with unqualified get, so that a user get found by ADL is used
+using std::get;
+
 template<typename T, bool ByRef>
 struct ValueType
 {
@@ -38,7 +62,7 @@ struct ValueType<T, true>
   using type = T &&;
 };
 
-template<typename T, typename... Ts>
+template<bool IsExhaustiveV = false, typename T, typename... Ts>
 constexpr auto match_patterns(T &&a_value, Ts const &...a_patterns);
 
 template<typename T, bool ByRef>
@@ -57,6 +81,14 @@ public:
     return match_patterns(std::forward<ValueT &&>(m_value), a_patterns...);
   }
 
+  // the arms, asserted to cover every value, which is checked at compile time, see
+  // ExhaustiveCoverage; no arm matching then is undefined behavior instead of an error
+  template<typename... Ts>
+  constexpr auto exhaustive(Ts const &...a_patterns)
+  {
+    return match_patterns<true>(std::forward<ValueT &&>(m_value), a_patterns...);
+  }
+
 private:
   ValueT m_value;
 };
@@ -289,6 +321,36 @@ BIN_OP_FOR_UNARY(^)
 
 #undef BIN_OP_FOR_UNARY
 
+// A comparison of the value with a bound, as _ < 16 or _ >= x, which keeps the bound visible
+// so that a match whose arms are all such comparisons can test them at once, see
+// IntervalDispatch.
+template<typename CompareT, typename U>
+struct Relation
+{
+  U const &bound;
+
+  template<typename ArgT>
+  constexpr bool operator()(ArgT const &a_value) const
+  {
+    return CompareT{}(a_value, bound);
+  }
+};
+
+#define REL_OP_FOR_WILDCARD(op, compare)\
+    template <typename U>\
+    requires std::is_arithmetic_v<U> || std::is_enum_v<U>\
+    constexpr auto operator op(Wildcard const &, U const &u)\
+    {\
+        return meet(Relation<compare, U>{u});\
+    }
+
+REL_OP_FOR_WILDCARD(<, std::less<>)
+REL_OP_FOR_WILDCARD(<=, std::less_equal<>)
+REL_OP_FOR_WILDCARD(>, std::greater<>)
+REL_OP_FOR_WILDCARD(>=, std::greater_equal<>)
+
+#undef REL_OP_FOR_WILDCARD
+
 template<typename BeginIterT, typename EndIterT = BeginIterT>
 struct Subrange
 {
@@ -435,7 +497,7 @@ namespace detail {
 template<std::size_t StartI, typename T, std::size_t... I>
 constexpr decltype(auto) subtuple_impl(T &&a_tuple, std::index_sequence<I...>)
 {
-  return std::forward_as_tuple(std::get<StartI + I>(std::forward<T>(a_tuple))...);
+  return std::forward_as_tuple(get<StartI + I>(std::forward<T>(a_tuple))...);
 }
 
 } // namespace detail
@@ -563,6 +625,18 @@ public:
     return m_memholder[m_size - 1];
   }
 
+  // the entry of type EntryT stored for the key, nullptr if none
+  template<typename EntryT>
+  constexpr auto find(void const *a_key) -> EntryT *
+  {
+    for (size_t i = 0; i < m_size; ++i) {
+      auto *const entry = std::get_if<EntryT>(&m_memholder[i]);
+      if (entry != nullptr && entry->key == a_key) return entry;
+    }
+
+    return nullptr;
+  }
+
 private:
   std::array<ElemT, sizeof...(Ts)> m_memholder;
   size_t m_size = 0;
@@ -745,6 +819,120 @@ public:
   }
 };
 
+// A literal known at compile time. A match on an integral or enum value whose arms are all
+// literals, but for an optional trailing wildcard, finds its arm through a table built at
+// compile time instead of testing the arms one after another.
+template<auto V>
+struct Literal
+{
+  using ValueT = decltype(V);
+  constexpr static ValueT value = V;
+};
+
+template<auto V>
+constexpr Literal<V> lit{};
+
+// A string known at compile time, the value of a lit_str<"..."> pattern. A match on a string
+// whose arms are all such literals, but for an optional trailing wildcard, finds its arm by a
+// perfect hash of the literals built at compile time and a single comparison.
+template<size_t N>
+struct LiteralString
+{
+  char chars[N] = {};
+
+  constexpr LiteralString(char const (&a_chars)[N]) // NOLINT(google-explicit-constructor)
+  {
+    std::copy_n(a_chars, N, chars);
+  }
+
+  constexpr std::string_view view() const
+  {
+    return {chars, N - 1};
+  }
+
+  friend constexpr bool operator==(LiteralString const &a_literal, std::string_view a_value)
+  {
+    return a_literal.view() == a_value;
+  }
+};
+
+template<LiteralString S>
+constexpr Literal<S> lit_str{};
+
+template<auto V>
+class PatternTraits<Literal<V>>
+{
+  using PatternT = Literal<V>;
+
+public:
+  template<typename>
+  using AppResultTuple = std::tuple<>;
+
+  constexpr static auto num_id_v = 0;
+
+  template<typename Tv, typename Tc>
+  constexpr static bool match_pattern_impl(Tv &&value, PatternT const &, int32_t, Tc &)
+  {
+    return V == std::forward<Tv>(value);
+  }
+
+  constexpr static void process_id_impl(PatternT const &, int32_t /*depth*/, IdProcess)
+  {
+  }
+};
+
+template<typename T, typename = void>
+struct LiteralKey
+{
+  using type = T;
+};
+
+template<typename T>
+struct LiteralKey<T, std::enable_if_t<std::is_enum_v<T>>>
+{
+  using type = std::underlying_type_t<T>;
+};
+
+template<typename T>
+struct IsLiteral : public std::false_type
+{
+};
+
+template<auto V>
+struct IsLiteral<Literal<V>> : public std::true_type
+{
+};
+
+template<typename T>
+struct IsLiteralString : public std::false_type
+{
+};
+
+template<size_t N>
+struct IsLiteralString<LiteralString<N>> : public std::true_type
+{
+};
+
+// whether a pattern is a literal that can be a case of a switch on a value of type KeyT
+template<typename KeyT, typename P>
+constexpr bool is_literal_case()
+{
+  if constexpr (IsLiteral<P>::value) {
+    using ValueT = typename P::ValueT;
+
+    if constexpr (std::is_same_v<ValueT, KeyT>) {
+      return true;
+    } else if constexpr (std::is_integral_v<KeyT> && std::is_integral_v<ValueT>
+        && !std::is_same_v<KeyT, bool> && !std::is_same_v<ValueT, bool>) {
+      // a literal out of the range of the scrutinee never matches, leave it to the arm chain
+      auto const key = static_cast<KeyT>(P::value);
+      return static_cast<ValueT>(key) == P::value && (key < KeyT{}) == (P::value < ValueT{});
+    }
+  }
+
+  return false;
+}
+
 template<typename... Ts>
 class Or
 {
@@ -860,6 +1048,48 @@ constexpr auto app(UnaryT &&unary, PatternT const &a_pattern)
   return App<UnaryT, PatternT>{std::forward<UnaryT>(unary), a_pattern};
 }
 
+// A projection for app whose result is computed at most once per match for each value it is
+// applied to, and then shared by all the arms of the match using the same projection. Results
+// are cached in the Context of the match, keyed by the type of the projection and the address of
+// the value, so values without one, temporaries, are projected each time.
+template<typename F>
+struct Memo
+{
+  F unary;
+
+  template<typename Tv>
+  constexpr decltype(auto) operator()(Tv &&value) const
+  {
+    return invoke_(unary, std::forward<Tv>(value));
+  }
+};
+
+template<typename F>
+constexpr auto memo(F &&unary)
+{
+  static_assert(std::is_class_v<std::remove_cvref_t<F>>,
+                "memo keys its results by the type of the projection, wrap the function in a lambda");
+  return Memo<std::decay_t<F>>{std::forward<F>(unary)};
+}
+
+template<typename T>
+struct IsMemo : public std::false_type
+{
+};
+
+template<typename F>
+struct IsMemo<Memo<F>> : public std::true_type
+{
+};
+
+// the result of a Memo<F> for the value at key
+template<typename F, typename R>
+struct MemoEntry
+{
+  void const *key;
+  R value;
+};
+
 constexpr auto y = 1;
 static_assert(std::holds_alternative<int32_t const *>(std::variant<std::monostate, const int32_t *>{&y}));
 
@@ -870,13 +1100,26 @@ public:
   template<typename Tv>
   using AppResult = std::invoke_result_t<UnaryT, Tv>;
 
+  constexpr static bool is_memo = IsMemo<std::remove_cvref_t<UnaryT>>::value;
+
+  // a result is kept in the context only if an id may bind to it, else the temporary is
+  // matched directly and lives until the end of the match of the pattern
+  constexpr static bool is_bound = PatternTraits<PatternT>::num_id_v > 0;
+
+  template<typename Tv>
+  using MemoEntryT = MemoEntry<std::remove_cvref_t<UnaryT>, std::decay_t<AppResult<Tv>>>;
+
   // We store value for scalar types in id, and they can not be moved. So to
   // support constexpr.
   template<typename Tv>
   using AppResultCurTuple = std::conditional_t<
-      std::is_lvalue_reference_v<AppResult<Tv>> || std::is_scalar_v<AppResult<Tv>>,
-      std::tuple<>,
-      std::tuple<std::decay_t<AppResult<Tv>>>
+      is_memo,
+      std::tuple<MemoEntryT<Tv>>,
+      std::conditional_t<
+          !is_bound || std::is_lvalue_reference_v<AppResult<Tv>> || std::is_scalar_v<AppResult<Tv>>,
+          std::tuple<>,
+          std::tuple<std::decay_t<AppResult<Tv>>>
+      >
   >;
 
   template<typename Tv>
@@ -892,7 +1135,20 @@ public:
                                            int32_t depth,
                                            Tc &context)
   {
-    if constexpr (std::is_same_v<AppResultCurTuple<Tv>, std::tuple<>>) {
+    if constexpr (is_memo) {
+      using EntryT = MemoEntryT<Tv>;
+
+      void const *const key = std::is_lvalue_reference_v<Tv> ? std::addressof(value) : nullptr;
+      auto *entry = key != nullptr ? context.template find<EntryT>(key) : nullptr;
+
+      if (entry == nullptr) {
+        context.emplace_back(EntryT{key, invoke_(app_pat.unary(), value)});
+        entry = &get<EntryT>(context.back());
+      }
+
+      // later arms reuse the result, so it is never moved from
+      return match_pattern(std::as_const(entry->value), app_pat.pattern(), depth + 1, context);
+    } else if constexpr (std::is_same_v<AppResultCurTuple<Tv>, std::tuple<>>) {
       return match_pattern(std::forward<AppResult<Tv>>(invoke_(app_pat.unary(), value)),
                            app_pat.pattern(),
                            depth + 1,
@@ -1036,15 +1292,8 @@ struct StorePointer : std::false_type
 {
 };
 
-template<typename T>
-using ValueVariant = std::conditional_t<
-    std::is_abstract_v<T>,
-    std::variant<std::monostate, T const *>,
-    std::variant<std::monostate, T, T const *>
->;
-
 template<typename T, typename Tv> //
-requires requires { std::declval<ValueVariant<T> &>() = &std::declval<Tv>(); }
+requires requires { std::declval<T const *&>() = &std::declval<Tv>(); }
 struct StorePointer<T, Tv> : std::conjunction<std::is_lvalue_reference<Tv>, std::negation<std::is_scalar<Tv>>>
 {
 };
@@ -1086,48 +1335,109 @@ struct IdTraits
   }
 };
 
+// the value of a bound Id, empty for abstract types which are only bound by pointer
+template<typename T>
+struct IdStorage
+{
+  std::optional<T> value;
+};
+
+template<typename T>
+requires std::is_abstract_v<T>
+struct IdStorage<T>
+{
+};
+
 template<typename T>
 class Id
 {
 private:
+  // The binding is a tag and a pointer, to the bound value or to the copy of it kept inline, so
+  // that loading it is a single indirection.
   class Block
   {
   public:
-    ValueVariant<T> m_variant;
-    int32_t m_depth;
+    enum class Binding : uint8_t
+    {
+      kNone,
+      kInline,
+      kPointer
+    };
+
+    IdStorage<T> m_storage;
+    T const *m_pointer = nullptr;
+    Binding m_binding = Binding::kNone;
+    int32_t m_depth = 0;
+
+    constexpr Block() = default;
+
+    constexpr Block(Block const &a_other)
+        : m_storage{a_other.m_storage}, m_pointer{a_other.m_pointer}, m_binding{a_other.m_binding},
+          m_depth{a_other.m_depth}
+    {
+      if (m_binding == Binding::kInline) m_pointer = inline_pointer();
+    }
+
+    constexpr Block &operator=(Block const &a_other)
+    {
+      if (this != &a_other) {
+        m_storage = a_other.m_storage;
+        m_binding = a_other.m_binding;
+        m_pointer = m_binding == Binding::kInline ? inline_pointer() : a_other.m_pointer;
+        m_depth = a_other.m_depth;
+      }
+
+      return *this;
+    }
+
+    constexpr T const *inline_pointer() const
+    {
+      if constexpr (std::is_abstract_v<T>) {
+        return nullptr;
+      } else {
+        return std::addressof(*m_storage.value);
+      }
+    }
+
+    constexpr bool has_value() const
+    {
+      return m_binding != Binding::kNone;
+    }
 
-    constexpr auto &variant()
-    { return m_variant; }
-    constexpr auto has_value() const
+    constexpr T const &value() const
     {
-      return std::visit(overload([](T const &) { return true; },
-                                 [](T const *) { return true; },
-                                 [](std::monostate const &) { return false; }),
-                        m_variant);
+      if (m_binding == Binding::kNone) raise_logic_error("invalid state!");
+      return *m_pointer;
     }
 
-    constexpr decltype(auto) value() const
+    constexpr T &mutable_value()
+    {
+      if (m_binding == Binding::kNone) raise_logic_error("Invalid state!");
+      if (m_binding == Binding::kPointer) raise_logic_error("Cannot get mutable_value for pointer type!");
+      return *m_storage.value;
+    }
+
+    template<typename Tv>
+    constexpr void bind_value(Tv &&a_value, std::false_type /* StorePointer */)
     {
-      return std::visit(
-          overload([](T const &v) -> T const & { return v; },
-                   [](T const *p) -> T const & { return *p; },
-                   [](std::monostate const &) -> T const & { throw std::logic_error("invalid state!"); }),
-          m_variant);
+      m_storage.value.emplace(std::forward<Tv>(a_value));
+      m_pointer = std::addressof(*m_storage.value);
+      m_binding = Binding::kInline;
     }
 
-    constexpr decltype(auto) mutable_value()
+    template<typename Tv>
+    constexpr void bind_value(Tv &&a_value, std::true_type /* StorePointer */)
     {
-      return std::visit(
-          overload([](T &v) -> T & { return v; },
-                   [](T const *) -> T & { throw std::logic_error("Cannot get mutable_value for pointer type!"); },
-                   [](std::monostate &) -> T & { throw std::logic_error("Invalid state!"); }),
-          m_variant);
+      m_pointer = std::addressof(a_value);
+      m_binding = Binding::kPointer;
     }
 
     constexpr void reset(int32_t depth)
     {
       if (m_depth - depth >= 0) {
-        m_variant = {};
+        if constexpr (!std::is_abstract_v<T>) m_storage.value.reset();
+        m_pointer = nullptr;
+        m_binding = Binding::kNone;
         m_depth = depth;
       }
     }
@@ -1141,24 +1451,9 @@ private:
     }
   };
 
-  struct IdUtil
-  {
-    template<typename Tv>
-    constexpr static auto bind_value(ValueVariant<T> &v, Tv &&value, std::false_type /* StorePointer */)
-    {
-      // for constexpr
-      v = ValueVariant<T>{std::forward<Tv>(value)};
-    }
-
-    template<typename Tv>
-    constexpr static auto bind_value(ValueVariant<T> &v, Tv &&value, std::true_type /* StorePointer */)
-    {
-      v = ValueVariant<T>{&value};
-    }
-  };
-
-  using BlockVariant = std::variant<Block, Block *>;
-  BlockVariant m_block = Block{};
+  // the block of the Id, or of the Id it was copied from
+  Block m_own_block{};
+  Block *m_shared_block = nullptr;
 
   constexpr T const &internal_value() const
   {
@@ -1168,9 +1463,8 @@ private:
 public:
   constexpr Id() = default;
 
-  constexpr Id(Id const &id)
+  constexpr Id(Id const &id) : m_shared_block{&id.block()}
   {
-    m_block = BlockVariant{&id.block()};
   }
 
   // non-const to inform users not to mark id as const.
@@ -1188,10 +1482,8 @@ public:
 
   constexpr Block &block() const
   {
-    return std::visit(
-        overload([](Block &v) -> Block & { return v; }, [](Block *p) -> Block & { return *p; }),
-        // constexpr does not allow mutable, we use const_cast instead. Never declare id as const.
-        const_cast<BlockVariant &>(m_block));
+    // constexpr does not allow mutable, we use const_cast instead. Never declare id as const.
+    return m_shared_block ? *m_shared_block : const_cast<Block &>(m_own_block);
   }
 
   template<typename Tv>
@@ -1201,7 +1493,7 @@ public:
       return IdTraits<T>::equal(internal_value(), v);
     }
 
-    IdUtil::bind_value(block().variant(), std::forward<Tv>(v), StorePointer<T, Tv>{});
+    block().bind_value(std::forward<Tv>(v), StorePointer<T, Tv>{});
     return true;
   }
 
@@ -1427,7 +1719,7 @@ constexpr decltype(auto) match_pattern_multiple_impl(ValueTupleT &&a_value_tuple
   };
 
   static_cast<void>(func);
-  return (func(std::get<I + ValueStartI>(std::forward<ValueTupleT>(a_value_tuple)),
+  return (func(get<I + ValueStartI>(std::forward<ValueTupleT>(a_value_tuple)),
                std::get<I + PatternStartI>(a_pattern_tuple)) && ...);
 }
 
@@ -1451,6 +1743,72 @@ constexpr decltype(auto) match_pattern_multiple(ValueTupleT &&a_value_tuple,
                                                                  std::make_index_sequence<N>{});
 }
 
+// The literals among the sub-patterns [StartI, StartI + N) of a ds pattern over contiguous
+// elements of an integral or enum type, such as the magic bytes of a header. If there are two or
+// more they are compared at once, by memcmp if the sub-patterns are all literals, or else by a
+// masked compare of the whole run which compilers vectorize. The other sub-patterns are matched
+// one by one after.
+template<typename ElemT, typename PatternTupleT, std::size_t StartI, std::size_t N>
+struct LiteralRun
+{
+  template<std::size_t I>
+  constexpr static bool is_literal()
+  {
+    return is_literal_case<ElemT, std::tuple_element_t<StartI + I, PatternTupleT>>();
+  }
+
+  constexpr static auto literals = []<std::size_t... I>(std::index_sequence<I...>) {
+    return std::array<bool, N>{is_literal<I>()...};
+  }(std::make_index_sequence<N>{});
+
+  constexpr static std::size_t num_literals = static_cast<std::size_t>(std::count(literals.begin(), literals.end(), true));
+
+  constexpr static bool value = (std::is_integral_v<ElemT> || std::is_enum_v<ElemT>) && !std::is_same_v<ElemT, bool>
+      && num_literals >= 2;
+
+  template<std::size_t I>
+  constexpr static ElemT element()
+  {
+    if constexpr (is_literal<I>()) {
+      return static_cast<ElemT>(std::tuple_element_t<StartI + I, PatternTupleT>::value);
+    } else {
+      return ElemT{};
+    }
+  }
+
+  constexpr static auto expected = []<std::size_t... I>(std::index_sequence<I...>) {
+    return std::array<ElemT, N>{element<I>()...};
+  }(std::make_index_sequence<N>{});
+
+  // the positions of the other sub-patterns
+  using Others = decltype([]<std::size_t... K>(std::index_sequence<K...>) {
+    constexpr auto others = [] {
+      std::array<std::size_t, N - num_literals> result{};
+      for (std::size_t i = 0, k = 0; i != N; ++i)
+        if (!literals[i]) result[k++] = i;
+      return result;
+    }();
+    return std::index_sequence<others[K]...>{};
+  }(std::make_index_sequence<N - num_literals>{}));
+
+  static bool match(ElemT const *a_elements)
+  {
+    if constexpr (num_literals == N) {
+      return std::memcmp(a_elements, expected.data(), sizeof(expected)) == 0;
+    } else {
+      using UIntT = std::make_unsigned_t<typename LiteralKey<ElemT>::type>;
+      UIntT difference = 0;
+
+      for (std::size_t i = 0; i < N; ++i) {
+        UIntT const mask = literals[i] ? static_cast<UIntT>(~UIntT{0}) : UIntT{0};
+        difference |= static_cast<UIntT>((static_cast<UIntT>(a_elements[i]) ^ static_cast<UIntT>(expected[i])) & mask);
+      }
+
+      return difference == 0;
+    }
+  }
+};
+
 template<
     std::size_t PatternStartI,
     std::size_t... I,
@@ -1488,6 +1846,23 @@ constexpr decltype(auto) match_pattern_range(ValueRangeBeginT &&a_value_range_be
                                              int32_t depth,
                                              Tc &context)
 {
+  using IterT = std::remove_cvref_t<ValueRangeBeginT>;
+
+  if constexpr (std::contiguous_iterator<IterT>) {
+    using RunT = LiteralRun<std::iter_value_t<IterT>, std::remove_cvref_t<PatternTupleT>, PatternStartI, N>;
+
+    if constexpr (RunT::value) {
+      if (!std::is_constant_evaluated()) {
+        return RunT::match(std::to_address(a_value_range_begin))
+            && match_pattern_range_impl<PatternStartI>(a_value_range_begin,
+                                                       a_pattern_tuple,
+                                                       depth,
+                                                       context,
+                                                       typename RunT::Others{});
+      }
+    }
+  }
+
   return match_pattern_range_impl<PatternStartI>(a_value_range_begin,
                                                  a_pattern_tuple,
                                                  depth,
@@ -1501,7 +1876,7 @@ class IndexedTypes;
 template<typename T, std::size_t StartI, std::size_t... I>
 struct IndexedTypes<StartI, std::index_sequence<I...>, T>
 {
-  using type = std::tuple<std::decay_t<decltype(std::get<StartI + I>(std::declval<T>()))>...>;
+  using type = std::tuple<std::decay_t<decltype(get<StartI + I>(std::declval<T>()))>...>;
 };
 
 template<std::size_t StartI, std::size_t EndI, typename T>
@@ -1679,13 +2054,37 @@ public:
 
   constexpr static auto num_id_v = (PatternTraits<Ts>::num_id_v + ... + 0);
 
+  // the elements [ValueStartI, ValueStartI + N) of a tuple-like value against the sub-patterns
+  // from PatternStartI, a std::array with literals among them through its data like a range
+  template<std::size_t ValueStartI, std::size_t PatternStartI, std::size_t N, typename T, typename Tc>
+  constexpr static bool match_elements(T &&a_value_tuple, Ds<Ts...> const &ds_pat, int32_t depth, Tc &context)
+  {
+    if constexpr (is_array_v<T>) {
+      using RunT = LiteralRun<typename std::remove_cvref_t<T>::value_type, typename Ds<Ts...>::Type, PatternStartI, N>;
+
+      if constexpr (RunT::value) {
+        return match_pattern_range<PatternStartI, N>(a_value_tuple.data() + ValueStartI,
+                                                     ds_pat.patterns(),
+                                                     depth,
+                                                     context);
+      }
+    }
+
+    return match_pattern_multiple<ValueStartI, PatternStartI, N>(std::forward<T>(a_value_tuple),
+                                                                 ds_pat.patterns(),
+                                                                 depth,
+                                                                 context);
+  }
+
   template<typename T, typename Tc>
   constexpr static auto match_pattern_impl(T &&a_value_tuple,
                                            Ds<Ts...> const &ds_pat,
                                            int32_t depth,
                                            Tc &context) -> std::enable_if_t<is_tuplelike_v<T>, bool>
   {
-    if constexpr (num_ooo_or_binder == 0) {
+    if constexpr (num_ooo_or_binder == 0 && is_array_v<T>) {
+      return match_elements<0, 0, sizeof...(Ts)>(std::forward<T>(a_value_tuple), ds_pat, depth, context);
+    } else if constexpr (num_ooo_or_binder == 0) {
       return std::apply(
           [&a_value_tuple, depth, &context](auto const &...a_patterns) {
             return apply_(
@@ -1704,10 +2103,7 @@ public:
       constexpr auto is_binder = is_ooo_binder_v<std::tuple_element_t<idx_ooo, std::tuple<Ts...>>>;
       constexpr auto is_array = is_array_v<T>;
 
-      auto result = match_pattern_multiple<0, 0, idx_ooo>(std::forward<T>(a_value_tuple),
-                                                          ds_pat.patterns(),
-                                                          depth,
-                                                          context);
+      auto result = match_elements<0, 0, idx_ooo>(std::forward<T>(a_value_tuple), ds_pat, depth, context);
 
       constexpr auto val_len = std::tuple_size_v<std::decay_t<T>>;
       constexpr auto pat_len = sizeof...(Ts);
@@ -1730,9 +2126,8 @@ public:
         static_assert(!is_binder);
       }
 
-      return result && match_pattern_multiple<val_len - pat_len + idx_ooo + 1, idx_ooo + 1, pat_len - idx_ooo - 1>(
-          std::forward<T>(a_value_tuple),
-          ds_pat.patterns(), depth, context);
+      return result && match_elements<val_len - pat_len + idx_ooo + 1, idx_ooo + 1, pat_len - idx_ooo - 1>(
+          std::forward<T>(a_value_tuple), ds_pat, depth, context);
     }
   }
 
@@ -1883,6 +2278,10 @@ static_assert(std::is_same_v<
 
 static_assert(std::is_same_v<
     PatternTraits<App<decltype(x), Wildcard>>::template AppResultTuple<std::array<int32_t, 3>>,
+    std::tuple<>>);
+
+static_assert(std::is_same_v<
+    PatternTraits<App<decltype(x), Id<std::array<int32_t, 3>>>>::template AppResultTuple<std::array<int32_t, 3>>,
     std::tuple<std::array<int32_t, 3>>>);
 
 static_assert(std::is_same_v<
@@ -1895,71 +2294,1131 @@ static_assert(PatternTraits<And<Id<int32_t>, Id<float>>>::num_id_v == 2);
 static_assert(PatternTraits<Or<Id<int32_t>, Id<float>>>::num_id_v == 2);
 static_assert(PatternTraits<Or<Wildcard, float>>::num_id_v == 0);
 
-template<typename Tv, typename... Ts>
-constexpr auto match_patterns(Tv &&value, Ts const &...a_patterns)
+// Whether the arms of a match on an integral or enum value are all literals but for an
+// optional trailing wildcard, whose arm then is found through a LiteralTable.
+template<typename Tv, typename... Ps>
+struct LiteralDispatch
 {
-  using ReturnT = typename PatternPairsReturnType<Ts...>::ReturnT;
+  using KeyT = std::remove_cvref_t<Tv>;
+  using PatternTuple = std::tuple<Ps...>;
 
-  using TupleT = decltype(std::tuple_cat(
-      std::declval<typename PatternTraits<typename Ts::PatternT>::
-      template AppResultTuple<Tv>>()...));
+  constexpr static size_t num_arms = sizeof...(Ps);
+  constexpr static bool has_default = num_arms > 0
+      && std::is_same_v<std::tuple_element_t<num_arms, std::tuple<void, Ps...>>, Wildcard>;
+  constexpr static size_t num_literals = num_arms - (has_default ? 1 : 0);
 
-  // expression, has return value.
-  if constexpr (!std::is_same_v<ReturnT, void>) {
-    constexpr auto const func =
-        [](auto const &a_pattern, auto &&value, ReturnT &result) constexpr -> bool {
-          auto context = typename ContextTrait<TupleT>::ContextT{};
+  constexpr static bool value = []<size_t... I>(std::index_sequence<I...>) {
+    if constexpr (!std::is_integral_v<KeyT> && !std::is_enum_v<KeyT>) {
+      return false;
+    } else {
+      return num_literals > 0 && (is_literal_case<KeyT, std::tuple_element_t<I, PatternTuple>>() && ...);
+    }
+  }(std::make_index_sequence<num_literals>{});
+};
 
-          if (a_pattern.match_value(std::forward<Tv>(value), context)) {
-            result = a_pattern.execute();
-            process_id(a_pattern, 0, IdProcess::kCancel);
-            return true;
-          }
+// The arm of each literal of a LiteralDispatch, in a dense table if the literals span a small
+// range or else in sorted order to be binary searched; the first of the arms with the same
+// literal wins, as in the arm chain.
+template<typename DispatchT>
+struct LiteralTable
+{
+  using KeyT = typename DispatchT::KeyT;
+  using IntT = typename LiteralKey<KeyT>::type;
 
-          return false;
-        };
+  constexpr static size_t num_literals = DispatchT::num_literals;
 
-    ReturnT result{};
+  struct Case
+  {
+    IntT key;
+    size_t arm;
+  };
 
-    bool const matched = (func(a_patterns, value, result) || ...);
-    if (!matched) {
-      throw std::logic_error{"Error: no patterns got matched!"};
-    }
+  template<size_t I>
+  constexpr static IntT key_of()
+  {
+    return static_cast<IntT>(static_cast<KeyT>(std::tuple_element_t<I, typename DispatchT::PatternTuple>::value));
+  }
 
-    static_cast<void>(matched);
-    return result;
-  } else {
-    // statement, no return value, mismatching all patterns is not an error.
-    auto const func = [](auto const &a_pattern, auto &&value) -> bool {
-      auto context = typename ContextTrait<TupleT>::ContextT{};
+  constexpr static auto sorted_cases = []<size_t... I>(std::index_sequence<I...>) {
+    std::array<Case, num_literals> cases{Case{key_of<I>(), I}...};
+    std::sort(cases.begin(), cases.end(), [](Case const &a, Case const &b) {
+      return a.key < b.key || (a.key == b.key && a.arm < b.arm);
+    });
+    return cases;
+  }(std::make_index_sequence<num_literals>{});
 
-      if (a_pattern.match_value(std::forward<Tv>(value), context)) {
-        a_pattern.execute();
-        process_id(a_pattern, 0, IdProcess::kCancel);
-        return true;
-      }
+  constexpr static uint64_t range =
+      static_cast<uint64_t>(sorted_cases.back().key) - static_cast<uint64_t>(sorted_cases.front().key);
+  constexpr static size_t dense_size = range < std::max<uint64_t>(64, num_literals * 4) ? range + 1 : 0;
 
-      return false;
-    };
+  // the arm of each value from the lowest literal, num_literals for none
+  constexpr static auto dense = [] {
+    std::array<size_t, dense_size> table{};
 
-    bool const matched = (func(a_patterns, value) || ...);
-    static_cast<void>(matched);
-  }
-}
+    if constexpr (dense_size > 0) {
+      table.fill(num_literals);
 
-template<typename T>
-constexpr auto cast = [](auto &&input) { return static_cast<T>(input); };
+      for (size_t i = num_literals; i-- != 0;)
+        table[static_cast<uint64_t>(sorted_cases[i].key) - static_cast<uint64_t>(sorted_cases[0].key)] =
+            sorted_cases[i].arm;
+    }
 
-constexpr auto deref = [](auto &&x) -> decltype(*x) & { return *x; };
-constexpr auto some = [](auto const pat) { return and_(app(cast<bool>, true), app(deref, pat)); };
-constexpr auto none = app(cast<bool>, false);
+    return table;
+  }();
 
-template<typename T, typename VariantT, typename = std::void_t<>>
-struct ViaGetIf : std::false_type
-{
-};
+  // index of the arm matching the value, num_literals, the default arm if any, for none
+  constexpr static size_t arm_of(KeyT a_value)
+  {
+    auto const key = static_cast<IntT>(a_value);
 
-template<typename T, typename VariantT>
+    if constexpr (dense_size > 0) {
+      auto const offset = static_cast<uint64_t>(key) - static_cast<uint64_t>(sorted_cases[0].key);
+      return offset < dense_size ? dense[offset] : num_literals;
+    } else {
+      auto const it = std::lower_bound(sorted_cases.begin(), sorted_cases.end(), key,
+                                       [](Case const &c, IntT k) { return c.key < k; });
+      return it != sorted_cases.end() && it->key == key ? it->arm : num_literals;
+    }
+  }
+
+  // index of the arm of a value known to be one of the literals, with no bounds check
+  constexpr static size_t arm_of_literal(KeyT a_value)
+  {
+    auto const key = static_cast<IntT>(a_value);
+
+    if constexpr (dense_size > 0) {
+      return dense[static_cast<uint64_t>(key) - static_cast<uint64_t>(sorted_cases[0].key)];
+    } else {
+      return std::lower_bound(sorted_cases.begin(), sorted_cases.end(), key,
+                              [](Case const &c, IntT k) { return c.key < k; })->arm;
+    }
+  }
+
+  // whether each of the given values is one of the literals
+  template<typename ValuesT>
+  constexpr static bool covers(ValuesT const &a_values)
+  {
+    for (auto const value : a_values) {
+      auto const key = static_cast<IntT>(value);
+      if (!std::binary_search(sorted_cases.begin(), sorted_cases.end(), Case{key, 0},
+                              [](Case const &a, Case const &b) { return a.key < b.key; }))
+        return false;
+    }
+    return true;
+  }
+};
+
+// Whether the arms of a match on a string, anything converting to a std::string_view, are all
+// lit_str<"..."> but for an optional trailing wildcard, whose arm then is found through a
+// StringTable.
+template<typename Tv, typename... Ps>
+struct StringDispatch
+{
+  using KeyT = std::remove_cvref_t<Tv>;
+  using PatternTuple = std::tuple<Ps...>;
+
+  constexpr static size_t num_arms = sizeof...(Ps);
+  constexpr static bool has_default = num_arms > 0
+      && std::is_same_v<std::tuple_element_t<num_arms, std::tuple<void, Ps...>>, Wildcard>;
+  constexpr static size_t num_literals = num_arms - (has_default ? 1 : 0);
+
+  template<typename P>
+  constexpr static bool is_string_case()
+  {
+    if constexpr (IsLiteral<P>::value) {
+      return IsLiteralString<std::remove_cv_t<typename P::ValueT>>::value;
+    } else {
+      return false;
+    }
+  }
+
+  constexpr static bool value = []<size_t... I>(std::index_sequence<I...>) {
+    if constexpr (!std::is_convertible_v<KeyT const &, std::string_view> || std::is_integral_v<KeyT>) {
+      return false;
+    } else {
+      return num_literals > 0 && (is_string_case<std::tuple_element_t<I, PatternTuple>>() && ...);
+    }
+  }(std::make_index_sequence<num_literals>{});
+};
+
+// The arm of each literal of a StringDispatch, in a minimal perfect hash built at compile time
+// in the manner of CHD: one pass over the string gives a hash whose low bits pick a bucket, and
+// the seed found for the bucket a slot of its own for each of its literals; the value then is
+// compared only to the literal of that slot. The first of the arms with the same literal wins,
+// as in the arm chain. If no seed is found, is_perfect is false and the match keeps the chain.
+template<typename DispatchT>
+struct StringTable
+{
+  constexpr static size_t num_literals = DispatchT::num_literals;
+  constexpr static size_t num_buckets = (num_literals + 1) / 2;
+  constexpr static uint32_t max_seed = 1u << 16;
+
+  template<size_t I>
+  constexpr static std::string_view key_of()
+  {
+    return std::tuple_element_t<I, typename DispatchT::PatternTuple>::value.view();
+  }
+
+  constexpr static uint64_t hash(std::string_view a_value)
+  {
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (auto const c : a_value) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+  }
+
+  constexpr static size_t slot_of(uint64_t a_hash, uint32_t a_seed)
+  {
+    auto mixed = (a_hash >> 32 | a_hash << 32) + (a_seed + 1ull) * 0x9e3779b97f4a7c15ull;
+    mixed ^= mixed >> 31;
+    mixed *= 0xbf58476d1ce4e5b9ull;
+    return static_cast<size_t>((mixed ^ (mixed >> 29)) % num_literals);
+  }
+
+  struct Table
+  {
+    bool is_perfect = true;
+    std::array<uint32_t, num_buckets> seeds{};
+    std::array<std::string_view, num_literals> keys{};
+    // num_literals for the slots of no literal
+    std::array<size_t, num_literals> arms{};
+  };
+
+  constexpr static Table table = []<size_t... I>(std::index_sequence<I...>) {
+    Table result;
+    std::array<std::string_view, num_literals> const keys{key_of<I>()...};
+    std::array<uint64_t, num_literals> hashes{};
+    std::array<bool, num_literals> is_repeated{};
+    std::array<size_t, num_buckets> bucket_size{};
+
+    for (size_t i = 0; i < num_literals; ++i) {
+      hashes[i] = hash(keys[i]);
+      for (size_t j = 0; j < i && !is_repeated[i]; ++j) is_repeated[i] = keys[i] == keys[j];
+      if (!is_repeated[i]) ++bucket_size[hashes[i] % num_buckets];
+    }
+
+    std::array<size_t, num_buckets> order{};
+    for (size_t b = 0; b < num_buckets; ++b) order[b] = b;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bucket_size[a] > bucket_size[b]; });
+
+    std::array<bool, num_literals> is_taken{};
+    std::array<size_t, num_literals> placed_slots{};
+
+    for (auto const bucket : order) {
+      if (bucket_size[bucket] == 0) break;
+
+      bool is_placed = false;
+      for (uint32_t seed = 0; seed < max_seed && !is_placed; ++seed) {
+        size_t placed = 0;
+        is_placed = true;
+
+        for (size_t i = 0; i < num_literals && is_placed; ++i) {
+          if (is_repeated[i] || hashes[i] % num_buckets != bucket) continue;
+
+          auto const slot = slot_of(hashes[i], seed);
+          if (is_taken[slot]) {
+            is_placed = false;
+          } else {
+            is_taken[slot] = true;
+            placed_slots[placed++] = slot;
+          }
+        }
+
+        if (is_placed) {
+          result.seeds[bucket] = seed;
+        } else {
+          for (size_t i = 0; i < placed; ++i) is_taken[placed_slots[i]] = false;
+        }
+      }
+
+      if (!is_placed) {
+        result.is_perfect = false;
+        return result;
+      }
+    }
+
+    result.arms.fill(num_literals);
+    for (size_t i = 0; i < num_literals; ++i) {
+      if (is_repeated[i]) continue;
+      auto const slot = slot_of(hashes[i], result.seeds[hashes[i] % num_buckets]);
+      result.keys[slot] = keys[i];
+      result.arms[slot] = i;
+    }
+
+    return result;
+  }(std::make_index_sequence<num_literals>{});
+
+  constexpr static bool is_perfect = table.is_perfect;
+
+  // index of the arm matching the value, num_literals, the default arm if any, for none
+  constexpr static size_t arm_of(std::string_view a_value)
+  {
+    auto const hash_value = hash(a_value);
+    auto const slot = slot_of(hash_value, table.seeds[hash_value % num_buckets]);
+    return table.keys[slot] == a_value ? table.arms[slot] : num_literals;
+  }
+};
+
+// Whether the arms of a match on an arithmetic value are all comparisons with a bound, as
+// _ < limits<uint16_t>::max(), but for an optional trailing wildcard, of less than 64 arms.
+// Then all the comparisons are made, without a branch, and the lowest bit of the mask of those
+// true is the arm taken; for bounds in increasing order this is the interval of the value.
+template<typename Tv, typename... Ps>
+struct IntervalDispatch
+{
+  using KeyT = std::remove_cvref_t<Tv>;
+  using PatternTuple = std::tuple<Ps...>;
+
+  template<typename P>
+  struct IsRelation : public std::false_type
+  {
+  };
+
+  template<typename CompareT, typename U>
+  struct IsRelation<Meet<Relation<CompareT, U>>> : public std::true_type
+  {
+  };
+
+  constexpr static size_t num_arms = sizeof...(Ps);
+  constexpr static bool has_default = num_arms > 0
+      && std::is_same_v<std::tuple_element_t<num_arms, std::tuple<void, Ps...>>, Wildcard>;
+  constexpr static size_t num_bounds = num_arms - (has_default ? 1 : 0);
+
+  constexpr static bool value = []<size_t... I>(std::index_sequence<I...>) {
+    if constexpr ((!std::is_arithmetic_v<KeyT> && !std::is_enum_v<KeyT>) || std::is_same_v<KeyT, bool>) {
+      return false;
+    } else {
+      return num_bounds > 0 && num_bounds < 64 && (IsRelation<std::tuple_element_t<I, PatternTuple>>::value && ...);
+    }
+  }(std::make_index_sequence<num_bounds>{});
+};
+
+template<typename DispatchT, typename ReturnT, bool IsExhaustiveV, typename Tv, typename... Ts>
+constexpr auto match_interval_patterns(Tv const &a_value, Ts const &...a_patterns)
+{
+  auto const pairs = std::forward_as_tuple(a_patterns...);
+  auto context = typename ContextTrait<std::tuple<>>::ContextT{};
+
+  auto const mask = [&]<size_t... I>(std::index_sequence<I...>) {
+    return ((uint64_t{std::get<I>(pairs).match_value(a_value, context)} << I) | ... | (uint64_t{1} << DispatchT::num_bounds));
+  }(std::make_index_sequence<DispatchT::num_bounds>{});
+
+  return execute_arm<ReturnT, IsExhaustiveV>(static_cast<size_t>(std::countr_zero(mask)), a_patterns...);
+}
+
+// whether a StringDispatch has its StringTable
+template<typename DispatchT>
+constexpr bool has_string_table()
+{
+  if constexpr (DispatchT::value) {
+    return StringTable<DispatchT>::is_perfect;
+  } else {
+    return false;
+  }
+}
+
+// runs the handler of the arm, by a chain of comparisons against constant indices which
+// compilers lower to a jump table like that of a switch, without a bounds check if exhaustive
+template<typename ReturnT, bool IsExhaustiveV = false, typename... Ts>
+constexpr auto execute_arm(size_t arm, Ts const &...a_patterns)
+{
+  auto const pairs = std::forward_as_tuple(a_patterns...);
+
+  if constexpr (!std::is_same_v<ReturnT, void>) {
+    ReturnT result{};
+
+    bool const matched = [&]<size_t... I>(std::index_sequence<I...>) {
+      return ((arm == I && (result = std::get<I>(pairs).execute(), true)) || ...);
+    }(std::make_index_sequence<sizeof...(Ts)>{});
+
+    if (!matched) {
+      if constexpr (IsExhaustiveV) {
+        std::unreachable();
+      } else {
+        raise_logic_error("Error: no patterns got matched!");
+      }
+    }
+
+    return result;
+  } else {
+    bool const matched = [&]<size_t... I>(std::index_sequence<I...>) {
+      return ((arm == I && (std::get<I>(pairs).execute(), true)) || ...);
+    }(std::make_index_sequence<sizeof...(Ts)>{});
+
+    if constexpr (IsExhaustiveV) {
+      if (!matched) std::unreachable();
+    }
+  }
+}
+
+template<typename DispatchT, typename ReturnT, bool IsExhaustiveV = false, typename... Ts>
+constexpr auto match_literal_patterns(typename DispatchT::KeyT a_value, Ts const &...a_patterns)
+{
+  if constexpr (IsExhaustiveV) {
+    return execute_arm<ReturnT, true>(LiteralTable<DispatchT>::arm_of_literal(a_value), a_patterns...);
+  } else {
+    return execute_arm<ReturnT>(LiteralTable<DispatchT>::arm_of(a_value), a_patterns...);
+  }
+}
+
+template<typename T>
+struct AsPointer;
+
+// the alternative T of an as<T> pattern, possibly guarded by when
+template<typename P>
+struct AsAlternative
+{
+  constexpr static bool value = false;
+};
+
+template<typename T, typename P>
+struct AsAlternative<App<AsPointer<T> const &, P>>
+{
+  constexpr static bool value = true;
+  using type = T;
+};
+
+template<typename T, typename P>
+struct AsAlternative<App<AsPointer<T>, P>> : public AsAlternative<App<AsPointer<T> const &, P>>
+{
+};
+
+template<typename T, typename P>
+struct AsAlternative<PostCheck<T, P>> : public AsAlternative<T>
+{
+};
+
+template<typename T>
+struct IsStdVariant : public std::false_type
+{
+};
+
+template<typename... Ts>
+struct IsStdVariant<std::variant<Ts...>> : public std::true_type
+{
+};
+
+// the index of T among the alternatives of a variant if it is there exactly once, else npos
+template<typename T, typename VariantT>
+struct AlternativeIndex;
+
+template<typename T, typename... Ts>
+struct AlternativeIndex<T, std::variant<Ts...>>
+{
+  constexpr static size_t value = [] {
+    constexpr bool is_same[] = {std::is_same_v<T, Ts>...};
+    size_t index = std::variant_npos;
+
+    for (size_t i = 0; i < sizeof...(Ts); ++i) {
+      if (!is_same[i]) continue;
+      if (index != std::variant_npos) return std::variant_npos;
+      index = i;
+    }
+
+    return index;
+  }();
+};
+
+// Whether the arms of a match on a std::variant are all as<T> patterns of its alternatives,
+// but for an optional trailing wildcard. Then only the arms of the alternative held are tried,
+// after a single jump on the index of the variant like that of std::visit.
+template<typename Tv, typename... Ps>
+struct VariantDispatch
+{
+  using VariantT = std::remove_cvref_t<Tv>;
+
+  constexpr static size_t num_arms = sizeof...(Ps);
+  constexpr static bool has_default = num_arms > 0
+      && std::is_same_v<std::tuple_element_t<num_arms, std::tuple<void, Ps...>>, Wildcard>;
+
+  // the alternative of each arm, npos for the default one
+  template<typename P>
+  constexpr static size_t alternative_of()
+  {
+    if constexpr (AsAlternative<P>::value) {
+      return AlternativeIndex<typename AsAlternative<P>::type, VariantT>::value;
+    } else {
+      return std::variant_npos;
+    }
+  }
+
+  constexpr static std::array<size_t, num_arms> alternatives{alternative_of<Ps>()...};
+
+  constexpr static bool value = [] {
+    if constexpr (!IsStdVariant<VariantT>::value) {
+      return false;
+    } else {
+      auto const num_alternative_arms = num_arms - (has_default ? 1 : 0);
+
+      for (size_t i = 0; i < num_alternative_arms; ++i)
+        if (alternatives[i] == std::variant_npos) return false;
+
+      return num_alternative_arms > 0;
+    }
+  }();
+
+  // whether the arm I can match a variant holding the alternative K, npos if valueless
+  template<size_t I, size_t K>
+  constexpr static bool selects()
+  {
+    return alternatives[I] == K || (has_default && I == num_arms - 1);
+  }
+};
+
+// Customization point for a closed class hierarchy, specialized for its base class B as
+//
+//   template<>
+//   struct matchit::impl::ClosedHierarchy<Shape>
+//   {
+//     constexpr static auto kind(Shape const &a_shape) { return a_shape.kind; }
+//
+//     template<typename T>
+//     constexpr static auto kind_of = T::kind;
+//   };
+//
+// so that as<T> for a class T derived from B tests the tag of the object and static_casts,
+// without RTTI, and a match whose arms are all as<T> jumps on the tag to their arms.
+template<typename B>
+struct ClosedHierarchy
+{
+};
+
+template<typename T, typename B>
+concept ClosedHierarchyOf = std::is_base_of_v<B, T> && !std::is_same_v<B, T> && requires(B const &b) {
+  { ClosedHierarchy<B>::kind(b) == ClosedHierarchy<B>::template kind_of<T> } -> std::convertible_to<bool>;
+};
+
+// Whether the arms of a match on the base class of a ClosedHierarchy are all as<T> patterns of
+// its classes, but for an optional trailing wildcard. Then the arms of the tag of the object
+// are found by a comparison against each distinct tag, which compilers lower to a switch.
+template<typename Tv, typename... Ps>
+struct HierarchyDispatch
+{
+  using BaseT = std::remove_cvref_t<Tv>;
+
+  constexpr static size_t num_arms = sizeof...(Ps);
+  constexpr static bool has_default = num_arms > 0
+      && std::is_same_v<std::tuple_element_t<num_arms, std::tuple<void, Ps...>>, Wildcard>;
+
+  template<typename P>
+  constexpr static bool is_tagged()
+  {
+    if constexpr (AsAlternative<P>::value) {
+      return ClosedHierarchyOf<typename AsAlternative<P>::type, BaseT>;
+    } else {
+      return false;
+    }
+  }
+
+  constexpr static bool value = []<size_t... I>(std::index_sequence<I...>) {
+    return sizeof...(I) > 0 && (is_tagged<std::tuple_element_t<I, std::tuple<Ps...>>>() && ...);
+  }(std::make_index_sequence<num_arms - (has_default ? 1 : 0)>{});
+
+  template<size_t I>
+  constexpr static auto tag()
+  {
+    using T = typename AsAlternative<std::tuple_element_t<I, std::tuple<Ps...>>>::type;
+    return ClosedHierarchy<BaseT>::template kind_of<T>;
+  }
+
+  // whether no arm before I has the tag of I, for the arms but the default one
+  template<size_t I>
+  constexpr static bool is_first_of_tag()
+  {
+    return [&]<size_t... J>(std::index_sequence<J...>) {
+      return ((tag<J>() != tag<I>()) && ...);
+    }(std::make_index_sequence<I>{});
+  }
+
+  // whether the arm J can match an object with the tag of the arm I
+  template<size_t J, size_t I>
+  constexpr static bool selects()
+  {
+    if constexpr (has_default && J == num_arms - 1) {
+      return true;
+    } else {
+      return tag<J>() == tag<I>();
+    }
+  }
+};
+
+// the sub-patterns of a ds pattern without ooo
+template<typename P>
+struct DsCells
+{
+  constexpr static bool value = false;
+};
+
+template<typename... Ts>
+struct DsCells<Ds<Ts...>>
+{
+  constexpr static bool value = num_ooo_or_binder_v<Ts...> == 0;
+  constexpr static size_t size = sizeof...(Ts);
+  using type = typename Ds<Ts...>::Type;
+};
+
+// Whether the arms of a match on a tuple-like value are all ds patterns of its size, or
+// wildcards, with literals among their sub-patterns. Then each element with literals in its
+// column is compared once against the distinct literals of the column, which compilers lower to
+// a switch, giving the arms it leaves possible as a bit mask. The masks of the columns together
+// give the arms that can match. If the arms hold nothing but literals and wildcards, the first
+// of them is the one matching, else they are tried in order.
+template<typename Tv, typename... Ps>
+struct DsDispatch
+{
+  using ValueT = std::remove_cvref_t<Tv>;
+  using PatternTuple = std::tuple<Ps...>;
+
+  constexpr static size_t num_arms = sizeof...(Ps);
+
+  constexpr static size_t arity = [] {
+    size_t size = 0;
+    static_cast<void>(([&] {
+      if constexpr (DsCells<Ps>::value) size = DsCells<Ps>::size;
+      return DsCells<Ps>::value;
+    }() || ...));
+    return size;
+  }();
+
+  template<size_t C>
+  using KeyT = std::remove_cvref_t<decltype(get<C>(std::declval<ValueT const &>()))>;
+
+  enum class Cell : uint8_t
+  {
+    kWildcard,
+    kLiteral,
+    kOther
+  };
+
+  template<size_t I, size_t C>
+  using CellT = std::tuple_element_t<C, typename DsCells<std::tuple_element_t<I, PatternTuple>>::type>;
+
+  template<size_t I, size_t C>
+  constexpr static Cell cell()
+  {
+    if constexpr (std::is_same_v<std::tuple_element_t<I, PatternTuple>, Wildcard>) {
+      return Cell::kWildcard;
+    } else if constexpr (std::is_same_v<CellT<I, C>, Wildcard>) {
+      return Cell::kWildcard;
+    } else if constexpr (is_literal_case<KeyT<C>, CellT<I, C>>()) {
+      return Cell::kLiteral;
+    } else {
+      return Cell::kOther;
+    }
+  }
+
+  // the literal of a cell, as the bits of its integer
+  template<size_t I, size_t C>
+  constexpr static uint64_t key()
+  {
+    if constexpr (cell<I, C>() == Cell::kLiteral) {
+      using IntT = typename LiteralKey<KeyT<C>>::type;
+      return static_cast<uint64_t>(static_cast<IntT>(static_cast<KeyT<C>>(CellT<I, C>::value)));
+    } else {
+      return 0;
+    }
+  }
+
+  template<size_t I>
+  constexpr static bool is_arm()
+  {
+    using P = std::tuple_element_t<I, PatternTuple>;
+
+    if constexpr (std::is_same_v<P, Wildcard>) {
+      return true;
+    } else if constexpr (DsCells<P>::value) {
+      return DsCells<P>::size == arity;
+    } else {
+      return false;
+    }
+  }
+
+  constexpr static bool is_eligible = [] {
+    if constexpr (arity == 0 || num_arms < 2 || num_arms > 64 || !is_tuplelike_v<ValueT>) {
+      return false;
+    } else if constexpr (std::tuple_size_v<ValueT> != arity) {
+      return false;
+    } else {
+      return []<size_t... I>(std::index_sequence<I...>) {
+        return (is_arm<I>() && ...);
+      }(std::make_index_sequence<num_arms>{});
+    }
+  }();
+
+  struct Table
+  {
+    std::array<std::array<Cell, arity>, num_arms> cells;
+    std::array<std::array<uint64_t, arity>, num_arms> keys;
+  };
+
+  template<size_t I, size_t... C>
+  constexpr static void fill_row(Table &a_table, std::index_sequence<C...>)
+  {
+    ((a_table.cells[I][C] = cell<I, C>(), a_table.keys[I][C] = key<I, C>()), ...);
+  }
+
+  constexpr static Table table = [] {
+    Table result{};
+
+    if constexpr (is_eligible) {
+      [&]<size_t... I>(std::index_sequence<I...>) {
+        (fill_row<I>(result, std::make_index_sequence<arity>{}), ...);
+      }(std::make_index_sequence<num_arms>{});
+    }
+
+    return result;
+  }();
+
+  constexpr static bool has_literal(size_t c)
+  {
+    for (size_t i = 0; i < num_arms; ++i)
+      if (table.cells[i][c] == Cell::kLiteral) return true;
+    return false;
+  }
+
+  constexpr static bool value = [] {
+    if constexpr (!is_eligible) {
+      return false;
+    } else {
+      for (size_t c = 0; c < arity; ++c)
+        if (has_literal(c)) return true;
+      return false;
+    }
+  }();
+
+  constexpr static bool is_static = [] {
+    for (size_t i = 0; i < num_arms; ++i)
+      for (size_t c = 0; c < arity; ++c)
+        if (table.cells[i][c] == Cell::kOther) return false;
+    return true;
+  }();
+
+  // the arms possible for an element of the column c matching none of its literals
+  constexpr static uint64_t other_mask(size_t c)
+  {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < num_arms; ++i)
+      if (table.cells[i][c] != Cell::kLiteral) mask |= uint64_t{1} << i;
+    return mask;
+  }
+
+  // the arms possible for an element of the column c equal to the literal of the arm i
+  constexpr static uint64_t literal_mask(size_t i, size_t c)
+  {
+    uint64_t mask = other_mask(c);
+    for (size_t j = 0; j < num_arms; ++j)
+      if (table.cells[j][c] == Cell::kLiteral && table.keys[j][c] == table.keys[i][c]) mask |= uint64_t{1} << j;
+    return mask;
+  }
+
+  constexpr static bool is_first_literal(size_t i, size_t c)
+  {
+    if (table.cells[i][c] != Cell::kLiteral) return false;
+    for (size_t j = 0; j < i; ++j)
+      if (table.cells[j][c] == Cell::kLiteral && table.keys[j][c] == table.keys[i][c]) return false;
+    return true;
+  }
+
+  template<size_t C>
+  constexpr static uint64_t column_mask(KeyT<C> const &a_key)
+  {
+    uint64_t mask = other_mask(C);
+
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      static_cast<void>(([&] {
+        if constexpr (is_first_literal(I, C)) {
+          if (a_key == static_cast<KeyT<C>>(CellT<I, C>::value)) {
+            mask = literal_mask(I, C);
+            return true;
+          }
+        }
+        return false;
+      }() || ...));
+    }(std::make_index_sequence<num_arms>{});
+
+    return mask;
+  }
+
+  // the arms that can match the value, as a bit mask
+  constexpr static uint64_t candidates(ValueT const &a_value)
+  {
+    return [&]<size_t... C>(std::index_sequence<C...>) {
+      return ([&] {
+        if constexpr (has_literal(C)) {
+          return column_mask<C>(get<C>(a_value));
+        } else {
+          return ~uint64_t{0};
+        }
+      }() & ...);
+    }(std::make_index_sequence<arity>{});
+  }
+
+  // the arm matching the value, num_arms for none, if is_static
+  constexpr static size_t arm_of(ValueT const &a_value)
+  {
+    auto const mask = candidates(a_value);
+    return mask == 0 ? num_arms : static_cast<size_t>(std::countr_zero(mask));
+  }
+};
+
+// tries the arms in order until one matches, or only those that can match if a VariantDispatch,
+// a HierarchyDispatch or a DsDispatch
+template<typename Tv, typename F, typename... Ts>
+constexpr bool try_patterns(Tv const &value, F const &try_pattern, Ts const &...a_patterns)
+{
+  using DispatchT = VariantDispatch<Tv, typename Ts::PatternT...>;
+  using HierarchyDispatchT = HierarchyDispatch<Tv, typename Ts::PatternT...>;
+  using DsDispatchT = DsDispatch<Tv, typename Ts::PatternT...>;
+
+  if constexpr (HierarchyDispatchT::value) {
+    auto const pairs = std::forward_as_tuple(a_patterns...);
+    constexpr auto num_tagged = sizeof...(Ts) - (HierarchyDispatchT::has_default ? 1 : 0);
+
+    auto const try_tag = [&]<size_t I>(std::integral_constant<size_t, I>) {
+      return [&]<size_t... J>(std::index_sequence<J...>) {
+        return ([&] {
+          if constexpr (HierarchyDispatchT::template selects<J, I>()) {
+            return try_pattern(std::get<J>(pairs));
+          } else {
+            return false;
+          }
+        }() || ...);
+      }(std::make_index_sequence<sizeof...(Ts)>{});
+    };
+
+    auto const kind = ClosedHierarchy<typename HierarchyDispatchT::BaseT>::kind(value);
+    bool matched = false;
+
+    bool const is_tagged = [&]<size_t... I>(std::index_sequence<I...>) {
+      return ([&] {
+        if constexpr (HierarchyDispatchT::template is_first_of_tag<I>()) {
+          if (kind == HierarchyDispatchT::template tag<I>()) {
+            matched = try_tag(std::integral_constant<size_t, I>{});
+            return true;
+          }
+        }
+        return false;
+      }() || ...);
+    }(std::make_index_sequence<num_tagged>{});
+
+    if constexpr (HierarchyDispatchT::has_default) {
+      if (!is_tagged) matched = try_pattern(std::get<sizeof...(Ts) - 1>(pairs));
+    }
+
+    return matched;
+  } else if constexpr (DispatchT::value) {
+    auto const pairs = std::forward_as_tuple(a_patterns...);
+
+    auto const try_alternative = [&]<size_t K>(std::integral_constant<size_t, K>) {
+      return [&]<size_t... I>(std::index_sequence<I...>) {
+        return ([&] {
+          if constexpr (DispatchT::template selects<I, K>()) {
+            return try_pattern(std::get<I>(pairs));
+          } else {
+            return false;
+          }
+        }() || ...);
+      }(std::make_index_sequence<sizeof...(Ts)>{});
+    };
+
+    auto const index = value.index();
+
+    return [&]<size_t... K>(std::index_sequence<K...>) {
+      return ((index == K && try_alternative(std::integral_constant<size_t, K>{})) || ...);
+    }(std::make_index_sequence<std::variant_size_v<typename DispatchT::VariantT>>{})
+        || (index == std::variant_npos && try_alternative(std::integral_constant<size_t, std::variant_npos>{}));
+  } else if constexpr (DsDispatchT::value) {
+    auto const pairs = std::forward_as_tuple(a_patterns...);
+    auto const candidates = DsDispatchT::candidates(value);
+
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return (((candidates >> I & 1) != 0 && try_pattern(std::get<I>(pairs))) || ...);
+    }(std::make_index_sequence<sizeof...(Ts)>{});
+  } else {
+    return (try_pattern(a_patterns) || ...);
+  }
+}
+
+// whether a pattern matches any value, as _ or an id
+template<typename P>
+struct IsIrrefutable : public std::false_type
+{
+};
+
+template<>
+struct IsIrrefutable<Wildcard> : public std::true_type
+{
+};
+
+template<typename T>
+struct IsIrrefutable<Id<T>> : public std::true_type
+{
+};
+
+template<typename UnaryT, typename P>
+struct IsIrrefutable<App<UnaryT, P>> : public IsIrrefutable<P>
+{
+};
+
+// whether an as<T> arm matches any object of T, as as<T>(_) or as<T>(id) not guarded by when
+template<typename P>
+struct IsTotalAs : public std::false_type
+{
+};
+
+template<typename T, typename C, typename D, typename P>
+struct IsTotalAs<App<AsPointer<T> const &, And<App<C, bool>, App<D, P>>>> : public IsIrrefutable<P>
+{
+};
+
+// the members of an enum with a codec found by argument dependent lookup, as those given one
+// by meta_enum_codec
+template<typename T>
+concept EnumWithCodec = std::is_enum_v<T> && requires(T const &a_value) {
+  { enum_codec_of(a_value).size() } -> std::convertible_to<size_t>;
+  { *enum_codec_of(a_value).from_index(size_t{}) } -> std::convertible_to<T>;
+};
+
+template<typename T>
+constexpr auto enum_members()
+{
+  using CodecT = decltype(enum_codec_of(T{}));
+  std::array<T, CodecT::size()> members{};
+  for (size_t i = 0; i < members.size(); ++i) members[i] = *CodecT::from_index(i);
+  return members;
+}
+
+// Whether the arms of an exhaustive match cover every value: those ending with a wildcard, lit<V>
+// arms for each member of an enum with a codec, see EnumWithCodec, or for a std::variant, an
+// as<T>(_) or as<T>(id) arm for each alternative, see VariantDispatch.
+template<typename Tv, typename... Ps>
+struct ExhaustiveCoverage
+{
+  using KeyT = std::remove_cvref_t<Tv>;
+  using LiteralDispatchT = LiteralDispatch<Tv, Ps...>;
+  using VariantDispatchT = VariantDispatch<Tv, Ps...>;
+
+  constexpr static bool has_default = std::is_same_v<std::tuple_element_t<sizeof...(Ps), std::tuple<void, Ps...>>, Wildcard>;
+
+  constexpr static bool covers_members = [] {
+    if constexpr (LiteralDispatchT::value && EnumWithCodec<KeyT>) {
+      return LiteralTable<LiteralDispatchT>::covers(enum_members<KeyT>());
+    } else {
+      return false;
+    }
+  }();
+
+  constexpr static bool covers_alternatives = [] {
+    if constexpr (VariantDispatchT::value) {
+      constexpr std::array<bool, sizeof...(Ps)> is_total{IsTotalAs<Ps>::value...};
+
+      for (size_t k = 0; k < std::variant_size_v<KeyT>; ++k) {
+        bool is_covered = false;
+        for (size_t i = 0; i < sizeof...(Ps); ++i) is_covered |= VariantDispatchT::alternatives[i] == k && is_total[i];
+        if (!is_covered) return false;
+      }
+      return true;
+    } else {
+      return false;
+    }
+  }();
+
+  constexpr static bool value = has_default || covers_members || covers_alternatives;
+};
+
+template<bool IsExhaustiveV, typename Tv, typename... Ts>
+constexpr auto match_patterns(Tv &&value, Ts const &...a_patterns)
+{
+  using ReturnT = typename PatternPairsReturnType<Ts...>::ReturnT;
+
+  static_assert(!IsExhaustiveV || ExhaustiveCoverage<Tv, typename Ts::PatternT...>::value,
+                "the arms of an exhaustive match cover every value: they end with a wildcard, or are lit<V> for each "
+                "member of a meta_enum_codec enum, or as<T>(_) for each alternative of a std::variant");
+
+  using TupleT = decltype(std::tuple_cat(
+      std::declval<typename PatternTraits<typename Ts::PatternT>::
+      template AppResultTuple<Tv>>()...));
+
+  using LiteralDispatchT = LiteralDispatch<Tv, typename Ts::PatternT...>;
+
+  using StringDispatchT = StringDispatch<Tv, typename Ts::PatternT...>;
+
+  using IntervalDispatchT = IntervalDispatch<Tv, typename Ts::PatternT...>;
+
+  using DsDispatchT = DsDispatch<Tv, typename Ts::PatternT...>;
+
+  if constexpr (LiteralDispatchT::value) {
+    return match_literal_patterns<LiteralDispatchT, ReturnT,
+                                  IsExhaustiveV && !LiteralDispatchT::has_default>(value, a_patterns...);
+  } else if constexpr (has_string_table<StringDispatchT>()) {
+    return execute_arm<ReturnT, IsExhaustiveV>(StringTable<StringDispatchT>::arm_of(value), a_patterns...);
+  } else if constexpr (IntervalDispatchT::value) {
+    return match_interval_patterns<IntervalDispatchT, ReturnT, IsExhaustiveV>(value, a_patterns...);
+  } else if constexpr (DsDispatchT::value && DsDispatchT::is_static) {
+    return execute_arm<ReturnT, IsExhaustiveV>(DsDispatchT::arm_of(value), a_patterns...);
+  } else if constexpr (!std::is_same_v<ReturnT, void>) {
+    // expression, has return value.
+    // one context for all the arms, which has room for the results of all of them, so that memo
+    // results are shared
+    auto context = typename ContextTrait<TupleT>::ContextT{};
+
+    constexpr auto const func =
+        [](auto const &a_pattern, auto &&value, auto &context, ReturnT &result) constexpr -> bool {
+          if (a_pattern.match_value(std::forward<Tv>(value), context)) {
+            result = a_pattern.execute();
+            process_id(a_pattern, 0, IdProcess::kCancel);
+            return true;
+          }
+
+          return false;
+        };
+
+    ReturnT result{};
+
+    bool const matched = try_patterns(
+        value, [&](auto const &a_pattern) { return func(a_pattern, value, context, result); }, a_patterns...);
+    if (!matched) {
+      if constexpr (IsExhaustiveV) {
+        std::unreachable();
+      } else {
+        raise_logic_error("Error: no patterns got matched!");
+      }
+    }
+
+    static_cast<void>(matched);
+    return result;
+  } else {
+    // statement, no return value, mismatching all patterns is not an error.
+    auto context = typename ContextTrait<TupleT>::ContextT{};
+
+    auto const func = [](auto const &a_pattern, auto &&value, auto &context) -> bool {
+      if (a_pattern.match_value(std::forward<Tv>(value), context)) {
+        a_pattern.execute();
+        process_id(a_pattern, 0, IdProcess::kCancel);
+        return true;
+      }
+
+      return false;
+    };
+
+    bool const matched = try_patterns(
+        value, [&](auto const &a_pattern) { return func(a_pattern, value, context); }, a_patterns...);
+    if constexpr (IsExhaustiveV) {
+      if (!matched) std::unreachable();
+    }
+    static_cast<void>(matched);
+  }
+}
+
+// Whether an arm can be part of a select chain: its pattern is a predicate such as _ < 16, a
+// literal, a plain value or a wildcard, none binding ids, and its handler an expr(...), which
+// can then be evaluated once for all the elements of a match_each.
+template<typename T>
+struct IsSelectArm : public std::false_type
+{
+};
+
+template<typename T, typename F>
+struct IsSelectArm<PatternPair<T, Nullary<F>>>
+{
+  constexpr static bool value = IsUnaryOrWildcard<T>::value || IsLiteral<T>::value
+      || std::is_arithmetic_v<T> || std::is_enum_v<T>;
+};
+
+// the results of a match over the elements a_first to a_last of a_in, into those of a_out
+template<typename InT, typename OutT, typename... Ts>
+constexpr void match_range(InT a_in, OutT a_out, size_t a_first, size_t a_last, Ts const &...a_patterns)
+{
+  using ReturnT = typename PatternPairsReturnType<Ts...>::ReturnT;
+
+  if constexpr ((IsSelectArm<Ts>::value && ...)) {
+    // every arm is tested and the result selected, from the last arm to the first so that the
+    // first arm matching wins, which leaves a loop without branches compilers vectorize
+    constexpr size_t num_arms = sizeof...(Ts);
+    constexpr bool has_default = std::is_same_v<typename std::tuple_element_t<num_arms - 1, std::tuple<Ts...>>::PatternT, Wildcard>;
+    constexpr size_t num_tested = num_arms - (has_default ? 1 : 0);
+
+    auto const pairs = std::forward_as_tuple(a_patterns...);
+    std::array<ReturnT, num_arms> const results{static_cast<ReturnT>(a_patterns.execute())...};
+    auto context = typename ContextTrait<std::tuple<>>::ContextT{};
+    bool is_all_matched = true;
+
+    for (auto i = a_first; i < a_last; ++i) {
+      auto const &value = a_in[i];
+      ReturnT result = has_default ? results[num_arms - 1] : ReturnT{};
+      bool is_matched = has_default;
+
+      [&]<size_t... I>(std::index_sequence<I...>) {
+        static_cast<void>(([&] {
+          constexpr size_t arm = num_tested - 1 - I;
+          bool const is_arm = std::get<arm>(pairs).match_value(value, context);
+          result = is_arm ? results[arm] : result;
+          is_matched |= is_arm;
+        }(), ...));
+      }(std::make_index_sequence<num_tested>{});
+
+      a_out[i] = result;
+      is_all_matched &= is_matched;
+    }
+
+    if (!is_all_matched) {
+      raise_logic_error("Error: no patterns got matched!");
+    }
+  } else {
+    for (auto i = a_first; i < a_last; ++i) a_out[i] = match_patterns(a_in[i], a_patterns...);
+  }
+}
+
+template<typename T>
+concept ParallelForExecutor = requires(T &a_executor) {
+  a_executor.parallel_for(size_t{}, size_t{}, [](size_t, size_t) {});
+};
+
+// the result of a match expression for each element of a_in, written to the same index of
+// a_out, up to the size of the shorter. The arms are those of match(element)(...), and are
+// lowered to a select chain when they are all predicates or values with expr(...) handlers,
+// see IsSelectArm. Throws, as match does, if an element matches none of them.
+template<std::ranges::random_access_range InT, std::ranges::random_access_range OutT, typename... Ts>
+requires std::ranges::sized_range<InT> && std::ranges::sized_range<OutT>
+constexpr void match_each(InT const &a_in, OutT &&a_out, Ts const &...a_patterns)
+{
+  auto const size = std::min<size_t>(std::ranges::size(a_in), std::ranges::size(a_out));
+  match_range(std::ranges::begin(a_in), std::ranges::begin(a_out), 0, size, a_patterns...);
+}
+
+// match_each split over the workers of an executor such as mio::Executor::shared(), by its
+// parallel_for
+template<ParallelForExecutor ExecutorT, std::ranges::random_access_range InT, std::ranges::random_access_range OutT, typename... Ts>
+requires std::ranges::sized_range<InT> && std::ranges::sized_range<OutT>
+void match_each(ExecutorT &a_executor, InT const &a_in, OutT &&a_out, Ts const &...a_patterns)
+{
+  auto const size = std::min<size_t>(std::ranges::size(a_in), std::ranges::size(a_out));
+  auto const in = std::ranges::begin(a_in);
+  auto const out = std::ranges::begin(a_out);
+  a_executor.parallel_for(0, size, [&](size_t a_first, size_t a_last) {
+    match_range(in, out, a_first, a_last, a_patterns...);
+  });
+}
+
+template<typename T>
+constexpr auto cast = [](auto &&input) { return static_cast<T>(input); };
+
+constexpr auto deref = [](auto &&x) -> decltype(*x) & { return *x; };
+constexpr auto some = [](auto const pat) { return and_(app(cast<bool>, true), app(deref, pat)); };
+constexpr auto none = app(cast<bool>, false);
+
+template<typename T, typename VariantT, typename = std::void_t<>>
+struct ViaGetIf : std::false_type
+{
+};
+
+template<typename T, typename VariantT>
 struct ViaGetIf<T, VariantT, std::void_t<decltype(std::get_if<T>(std::declval<VariantT const *>()))>> : std::true_type
 {
 };
@@ -1995,11 +3454,20 @@ struct AsPointer
   }
 
   template<typename B>
-  requires (!via_get_if_v<T, B> && std::is_base_of_v<B, T>)
+  requires (!via_get_if_v<T, B> && std::is_base_of_v<B, T> && !ClosedHierarchyOf<T, B>)
   constexpr auto operator()(B const &b) const -> decltype(dynamic_cast<T const *>(std::addressof(b)))
   {
     return dynamic_cast<T const *>(std::addressof(b));
   }
+
+  // a tag test instead of the dynamic_cast, see ClosedHierarchy
+  template<typename B>
+  requires (!via_get_if_v<T, B> && ClosedHierarchyOf<T, B>)
+  constexpr auto operator()(B const &b) const -> T const *
+  {
+    using TraitsT = ClosedHierarchy<B>;
+    return TraitsT::kind(b) == TraitsT::template kind_of<T> ? static_cast<T const *>(std::addressof(b)) : nullptr;
+  }
 };
 
 template<typename T>
@@ -2032,10 +3500,12 @@ constexpr auto as_ds_via = [](auto ...members) {
 } // namespace impl
 
 using impl::match;
+using impl::match_each;
 using impl::expr;
 using impl::_;
 using impl::and_;
 using impl::app;
+using impl::memo;
 using impl::ds;
 using impl::Id;
 using impl::meet;
@@ -2046,6 +3516,8 @@ using impl::pattern;
 using impl::Subrange;
 using impl::SubrangeT;
 using impl::when;
+using impl::lit;
+using impl::lit_str;
 using impl::as;
 using impl::as_ds_via;
 using impl::ds_via;
@@ -0,0 +1,400 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Runtime benchmark of matchit against the hand-written dispatch it replaces: switch and
+// if-chains on literals, std::visit on variants, dynamic_cast and tag switches on class
+// hierarchies, and structured bindings for ds. Build it optimized, e.g.
+//
+//   cmake -DCMAKE_BUILD_TYPE=Release . && cmake --build . --target matchit_benchmark
+//
+// Each case reports nanoseconds per match and checks both sides agree.
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest/doctest.h>
+#include <matchit/matchit.hpp>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+using namespace matchit;
+
+namespace {
+
+constexpr int count = 1 << 20;
+
+template<typename F>
+double time_per_match(F &&a_work)
+{
+  auto const start = std::chrono::steady_clock::now();
+  a_work();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+std::vector<int32_t> make_codes(int32_t a_bound)
+{
+  auto rng = std::mt19937{42};
+  auto distribution = std::uniform_int_distribution<int32_t>{0, a_bound - 1};
+  auto codes = std::vector<int32_t>(count);
+  for (auto &code : codes) code = distribution(rng);
+  return codes;
+}
+
+int32_t switch_literal(int32_t a_code)
+{
+  switch (a_code) {
+  case 0: return 30;
+  case 1: return 4;
+  case 2: return 25;
+  case 3: return 2;
+  case 4: return 10;
+  case 5: return 15;
+  case 6: return 7;
+  case 7: return 0;
+  default: return -1;
+  }
+}
+
+int32_t if_chain_literal(int32_t a_code)
+{
+  if (a_code == 0) return 30;
+  if (a_code == 1) return 4;
+  if (a_code == 2) return 25;
+  if (a_code == 3) return 2;
+  if (a_code == 4) return 10;
+  if (a_code == 5) return 15;
+  if (a_code == 6) return 7;
+  if (a_code == 7) return 0;
+  return -1;
+}
+
+int32_t matchit_lit(int32_t a_code)
+{
+  return match(a_code)(
+      pattern | lit<0> = expr(30),
+      pattern | lit<1> = expr(4),
+      pattern | lit<2> = expr(25),
+      pattern | lit<3> = expr(2),
+      pattern | lit<4> = expr(10),
+      pattern | lit<5> = expr(15),
+      pattern | lit<6> = expr(7),
+      pattern | lit<7> = expr(0),
+      pattern | _      = expr(-1)
+  );
+}
+
+int32_t matchit_value(int32_t a_code)
+{
+  return match(a_code)(
+      pattern | 0 = expr(30),
+      pattern | 1 = expr(4),
+      pattern | 2 = expr(25),
+      pattern | 3 = expr(2),
+      pattern | 4 = expr(10),
+      pattern | 5 = expr(15),
+      pattern | 6 = expr(7),
+      pattern | 7 = expr(0),
+      pattern | _ = expr(-1)
+  );
+}
+
+struct LinkEntered
+{
+  int32_t link;
+};
+
+struct LinkExited
+{
+  int32_t link;
+  int32_t travel_time;
+};
+
+struct Stopped
+{
+  int32_t duration;
+};
+
+using Event = std::variant<LinkEntered, LinkExited, Stopped>;
+
+template<typename... Fs>
+struct Overloaded : Fs ...
+{
+  using Fs::operator()...;
+};
+
+int32_t visit_event(Event const &a_event)
+{
+  return std::visit(Overloaded{
+      [](LinkEntered const &a_entered) { return a_entered.link; },
+      [](LinkExited const &a_exited) { return a_exited.travel_time; },
+      [](Stopped const &a_stopped) { return -a_stopped.duration; }
+  }, a_event);
+}
+
+int32_t if_chain_event(Event const &a_event)
+{
+  if (auto const *entered = std::get_if<LinkEntered>(&a_event)) return entered->link;
+  if (auto const *exited = std::get_if<LinkExited>(&a_event)) return exited->travel_time;
+  return -std::get<Stopped>(a_event).duration;
+}
+
+int32_t matchit_event(Event const &a_event)
+{
+  Id<int32_t> value;
+  return match(a_event)(
+      pattern | as<LinkEntered>(app(&LinkEntered::link, value))       = [&] { return *value; },
+      pattern | as<LinkExited>(app(&LinkExited::travel_time, value))  = [&] { return *value; },
+      pattern | as<Stopped>(app(&Stopped::duration, value))           = [&] { return -*value; }
+  );
+}
+
+// an open hierarchy, matched with dynamic_cast
+struct Vehicle
+{
+  virtual ~Vehicle() = default;
+  virtual int32_t capacity() const = 0;
+};
+
+struct Car : Vehicle
+{
+  int32_t capacity() const override { return 4; }
+};
+
+struct Bus : Vehicle
+{
+  int32_t capacity() const override { return 60; }
+};
+
+struct Truck : Vehicle
+{
+  int32_t capacity() const override { return 2; }
+};
+
+int32_t if_chain_vehicle(Vehicle const &a_vehicle)
+{
+  if (dynamic_cast<Car const *>(&a_vehicle)) return 4;
+  if (dynamic_cast<Bus const *>(&a_vehicle)) return 60;
+  if (dynamic_cast<Truck const *>(&a_vehicle)) return 2;
+  return 0;
+}
+
+int32_t matchit_vehicle(Vehicle const &a_vehicle)
+{
+  return match(a_vehicle)(
+      pattern | as<Car>(_)   = expr(4),
+      pattern | as<Bus>(_)   = expr(60),
+      pattern | as<Truck>(_) = expr(2),
+      pattern | _            = expr(0)
+  );
+}
+
+// a closed hierarchy, tagged by its base
+enum class SignalKind : uint8_t
+{
+  kFixed,
+  kActuated,
+  kAdaptive
+};
+
+struct Signal
+{
+  SignalKind kind;
+};
+
+struct FixedSignal : Signal
+{
+  constexpr static auto tag = SignalKind::kFixed;
+  int32_t cycle;
+};
+
+struct ActuatedSignal : Signal
+{
+  constexpr static auto tag = SignalKind::kActuated;
+  int32_t max_green;
+};
+
+struct AdaptiveSignal : Signal
+{
+  constexpr static auto tag = SignalKind::kAdaptive;
+  int32_t horizon;
+};
+
+}
+
+template<>
+struct matchit::impl::ClosedHierarchy<Signal>
+{
+  constexpr static auto kind(Signal const &a_signal)
+  {
+    return a_signal.kind;
+  }
+
+  template<typename T>
+  constexpr static auto kind_of = T::tag;
+};
+
+namespace {
+
+int32_t switch_signal(Signal const &a_signal)
+{
+  switch (a_signal.kind) {
+  case SignalKind::kFixed: return static_cast<FixedSignal const &>(a_signal).cycle;
+  case SignalKind::kActuated: return static_cast<ActuatedSignal const &>(a_signal).max_green;
+  case SignalKind::kAdaptive: return static_cast<AdaptiveSignal const &>(a_signal).horizon;
+  }
+  return 0;
+}
+
+int32_t matchit_signal(Signal const &a_signal)
+{
+  Id<int32_t> value;
+  return match(a_signal)(
+      pattern | as<FixedSignal>(app(&FixedSignal::cycle, value))           = [&] { return *value; },
+      pattern | as<ActuatedSignal>(app(&ActuatedSignal::max_green, value)) = [&] { return *value; },
+      pattern | as<AdaptiveSignal>(app(&AdaptiveSignal::horizon, value))   = [&] { return *value; },
+      pattern | _                                                          = expr(0)
+  );
+}
+
+using Movement = std::tuple<int32_t, int32_t>;
+
+int32_t structured_binding_movement(Movement const &a_movement)
+{
+  auto const &[from, to] = a_movement;
+  if (from == 0) return to;
+  if (to == 0) return -from;
+  return from + to;
+}
+
+int32_t matchit_movement(Movement const &a_movement)
+{
+  Id<int32_t> from, to;
+  return match(a_movement)(
+      pattern | ds(0, to)    = [&] { return *to; },
+      pattern | ds(from, 0)  = [&] { return -*from; },
+      pattern | ds(from, to) = [&] { return *from + *to; }
+  );
+}
+
+template<typename T, typename F>
+int64_t sum_over(std::vector<T> const &a_values, F &&a_match)
+{
+  auto sum = int64_t{0};
+  for (auto const &value : a_values) sum += a_match(value);
+  return sum;
+}
+
+template<typename T, typename F>
+int64_t sum_over_pointers(std::vector<std::unique_ptr<T>> const &a_values, F &&a_match)
+{
+  auto sum = int64_t{0};
+  for (auto const &value : a_values) sum += a_match(*value);
+  return sum;
+}
+
+}
+
+TEST_CASE("benchmark: literal dispatch")
+{
+  auto const codes = make_codes(9);
+
+  auto switch_sum = int64_t{}, if_chain_sum = int64_t{}, lit_sum = int64_t{}, value_sum = int64_t{};
+  auto const switch_ns = time_per_match([&] { switch_sum = sum_over(codes, switch_literal); });
+  auto const if_chain_ns = time_per_match([&] { if_chain_sum = sum_over(codes, if_chain_literal); });
+  auto const lit_ns = time_per_match([&] { lit_sum = sum_over(codes, matchit_lit); });
+  auto const value_ns = time_per_match([&] { value_sum = sum_over(codes, matchit_value); });
+
+  MESSAGE("switch " << switch_ns << " ns, if-chain " << if_chain_ns << " ns, matchit lit<V> " << lit_ns
+                    << " ns, matchit values " << value_ns << " ns per match");
+  CHECK_EQ(if_chain_sum, switch_sum);
+  CHECK_EQ(lit_sum, switch_sum);
+  CHECK_EQ(value_sum, switch_sum);
+}
+
+TEST_CASE("benchmark: variant dispatch")
+{
+  auto events = std::vector<Event>{};
+  events.reserve(count);
+  for (auto const code : make_codes(3)) {
+    switch (code) {
+    case 0: events.emplace_back(LinkEntered{code + 1}); break;
+    case 1: events.emplace_back(LinkExited{code, 30}); break;
+    default: events.emplace_back(Stopped{5}); break;
+    }
+  }
+
+  auto visit_sum = int64_t{}, if_chain_sum = int64_t{}, matchit_sum = int64_t{};
+  auto const visit_ns = time_per_match([&] { visit_sum = sum_over(events, visit_event); });
+  auto const if_chain_ns = time_per_match([&] { if_chain_sum = sum_over(events, if_chain_event); });
+  auto const matchit_ns = time_per_match([&] { matchit_sum = sum_over(events, matchit_event); });
+
+  MESSAGE("std::visit " << visit_ns << " ns, get_if chain " << if_chain_ns << " ns, matchit as<T> " << matchit_ns
+                        << " ns per match");
+  CHECK_EQ(if_chain_sum, visit_sum);
+  CHECK_EQ(matchit_sum, visit_sum);
+}
+
+TEST_CASE("benchmark: polymorphic dispatch")
+{
+  auto const codes = make_codes(3);
+
+  SUBCASE("test open hierarchy") {
+    auto vehicles = std::vector<std::unique_ptr<Vehicle>>{};
+    vehicles.reserve(count);
+    for (auto const code : codes) {
+      if (code == 0) vehicles.push_back(std::make_unique<Car>());
+      else if (code == 1) vehicles.push_back(std::make_unique<Bus>());
+      else vehicles.push_back(std::make_unique<Truck>());
+    }
+
+    auto virtual_sum = int64_t{}, if_chain_sum = int64_t{}, matchit_sum = int64_t{};
+    auto const virtual_ns = time_per_match([&] {
+      virtual_sum = sum_over_pointers(vehicles, [](Vehicle const &a_vehicle) { return a_vehicle.capacity(); });
+    });
+    auto const if_chain_ns = time_per_match([&] { if_chain_sum = sum_over_pointers(vehicles, if_chain_vehicle); });
+    auto const matchit_ns = time_per_match([&] { matchit_sum = sum_over_pointers(vehicles, matchit_vehicle); });
+
+    MESSAGE("virtual call " << virtual_ns << " ns, dynamic_cast chain " << if_chain_ns << " ns, matchit as<T> "
+                            << matchit_ns << " ns per match");
+    CHECK_EQ(if_chain_sum, virtual_sum);
+    CHECK_EQ(matchit_sum, virtual_sum);
+  }
+
+  SUBCASE("test closed hierarchy") {
+    auto signals = std::vector<std::unique_ptr<Signal>>{};
+    signals.reserve(count);
+    for (auto const code : codes) {
+      if (code == 0) signals.push_back(std::make_unique<FixedSignal>(FixedSignal{{FixedSignal::tag}, 90}));
+      else if (code == 1) signals.push_back(std::make_unique<ActuatedSignal>(ActuatedSignal{{ActuatedSignal::tag}, 45}));
+      else signals.push_back(std::make_unique<AdaptiveSignal>(AdaptiveSignal{{AdaptiveSignal::tag}, 300}));
+    }
+
+    auto switch_sum = int64_t{}, matchit_sum = int64_t{};
+    auto const switch_ns = time_per_match([&] { switch_sum = sum_over_pointers(signals, switch_signal); });
+    auto const matchit_ns = time_per_match([&] { matchit_sum = sum_over_pointers(signals, matchit_signal); });
+
+    MESSAGE("tag switch " << switch_ns << " ns, matchit as<T> " << matchit_ns << " ns per match");
+    CHECK_EQ(matchit_sum, switch_sum);
+  }
+}
+
+TEST_CASE("benchmark: destructuring")
+{
+  auto const codes = make_codes(4);
+  auto movements = std::vector<Movement>{};
+  movements.reserve(count);
+  for (size_t i = 0; i < codes.size(); ++i) movements.emplace_back(codes[i], codes[codes.size() - 1 - i]);
+
+  auto binding_sum = int64_t{}, matchit_sum = int64_t{};
+  auto const binding_ns = time_per_match([&] { binding_sum = sum_over(movements, structured_binding_movement); });
+  auto const matchit_ns = time_per_match([&] { matchit_sum = sum_over(movements, matchit_movement); });
+
+  MESSAGE("structured bindings " << binding_ns << " ns, matchit ds " << matchit_ns << " ns per match");
+  CHECK_EQ(matchit_sum, binding_sum);
+}
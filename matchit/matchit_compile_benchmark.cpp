@@ -0,0 +1,167 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Compile-time and object-size benchmark of matchit: a translation unit with 16 distinct
+// instantiations each of literal, variant, polymorphic and ds matches. The same unit built
+// with WXLIB_MATCHIT_COMPILE_BASELINE defined spells them with switch, std::visit,
+// dynamic_cast and structured bindings instead. The build prints the compile time of both
+// objects, and the matchit_compile_report target prints their sizes, e.g.
+//
+//   cmake --build . --target matchit_compile_report  (after touching this file)
+
+#ifndef WXLIB_MATCHIT_COMPILE_BASELINE
+#include <matchit/matchit.hpp>
+#endif
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <variant>
+
+namespace {
+
+template<int32_t N>
+struct Entered
+{
+  int32_t link;
+};
+
+template<int32_t N>
+struct Exited
+{
+  int32_t travel_time;
+};
+
+template<int32_t N>
+using Event = std::variant<Entered<N>, Exited<N>>;
+
+template<int32_t N>
+struct Shape
+{
+  virtual ~Shape() = default;
+};
+
+template<int32_t N>
+struct Circle : Shape<N>
+{
+};
+
+template<int32_t N>
+struct Square : Shape<N>
+{
+};
+
+#ifdef WXLIB_MATCHIT_COMPILE_BASELINE
+
+template<int32_t N>
+int32_t literal_case(int32_t a_code)
+{
+  switch (a_code) {
+  case N: return 1;
+  case N + 1: return 2;
+  case N + 2: return 3;
+  case N + 3: return 4;
+  default: return 0;
+  }
+}
+
+template<int32_t N>
+int32_t variant_case(Event<N> const &a_event)
+{
+  struct Visitor
+  {
+    int32_t operator()(Entered<N> const &a_entered) const { return a_entered.link; }
+    int32_t operator()(Exited<N> const &a_exited) const { return a_exited.travel_time + N; }
+  };
+  return std::visit(Visitor{}, a_event);
+}
+
+template<int32_t N>
+int32_t polymorphic_case(Shape<N> const &a_shape)
+{
+  if (dynamic_cast<Circle<N> const *>(&a_shape)) return 1;
+  if (dynamic_cast<Square<N> const *>(&a_shape)) return 2;
+  return 0;
+}
+
+template<int32_t N>
+int32_t ds_case(std::tuple<int32_t, int32_t> const &a_movement)
+{
+  auto const &[from, to] = a_movement;
+  if (from == N) return to;
+  if (to == N) return from;
+  return from + to;
+}
+
+#else
+
+using namespace matchit;
+
+template<int32_t N>
+int32_t literal_case(int32_t a_code)
+{
+  return match(a_code)(
+      pattern | lit<N>     = expr(1),
+      pattern | lit<N + 1> = expr(2),
+      pattern | lit<N + 2> = expr(3),
+      pattern | lit<N + 3> = expr(4),
+      pattern | _          = expr(0)
+  );
+}
+
+template<int32_t N>
+int32_t variant_case(Event<N> const &a_event)
+{
+  Id<int32_t> value;
+  return match(a_event)(
+      pattern | as<Entered<N>>(app(&Entered<N>::link, value))       = [&] { return *value; },
+      pattern | as<Exited<N>>(app(&Exited<N>::travel_time, value))  = [&] { return *value + N; }
+  );
+}
+
+template<int32_t N>
+int32_t polymorphic_case(Shape<N> const &a_shape)
+{
+  return match(a_shape)(
+      pattern | as<Circle<N>>(_) = expr(1),
+      pattern | as<Square<N>>(_) = expr(2),
+      pattern | _                = expr(0)
+  );
+}
+
+template<int32_t N>
+int32_t ds_case(std::tuple<int32_t, int32_t> const &a_movement)
+{
+  Id<int32_t> from, to;
+  return match(a_movement)(
+      pattern | ds(N, to)    = [&] { return *to; },
+      pattern | ds(from, N)  = [&] { return *from; },
+      pattern | ds(from, to) = [&] { return *from + *to; }
+  );
+}
+
+#endif
+
+template<int32_t N>
+int32_t run_cases(int32_t a_code)
+{
+  auto const circle = Circle<N>{};
+  return literal_case<N>(a_code) + variant_case<N>(Event<N>{Exited<N>{a_code}}) + polymorphic_case<N>(circle)
+         + ds_case<N>(std::make_tuple(a_code, N));
+}
+
+template<int32_t... N>
+int32_t run_all_cases(int32_t a_code, std::integer_sequence<int32_t, N...>)
+{
+  return (run_cases<N * 4>(a_code) + ...);
+}
+
+}
+
+// the entry point keeps the instantiations alive in the object
+int32_t matchit_compile_benchmark(int32_t a_code)
+{
+  return run_all_cases(a_code, std::make_integer_sequence<int32_t, 16>{});
+}
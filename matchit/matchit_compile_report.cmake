@@ -0,0 +1,10 @@
+# Prints the object sizes of the compile-time benchmark, see matchit_compile_benchmark.cpp.
+# Run by the matchit_compile_report target with MATCHIT_OBJECT and BASELINE_OBJECT set.
+
+file(SIZE "${MATCHIT_OBJECT}" matchit_size)
+file(SIZE "${BASELINE_OBJECT}" baseline_size)
+math(EXPR ratio_percent "${matchit_size} * 100 / ${baseline_size}")
+
+message(STATUS "matchit object: ${matchit_size} bytes")
+message(STATUS "hand-written object: ${baseline_size} bytes")
+message(STATUS "matchit is ${ratio_percent}% of hand-written")
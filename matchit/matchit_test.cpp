@@ -13,6 +13,18 @@
 #include <doctest/doctest.h>
 #include "matchit_test_utility.hpp"
 #include <matchit/matchit.hpp>
+#include <meta_enum/meta_enum.hpp>
+#include <mio/executor.hpp>
+
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 using namespace matchit;
 
@@ -32,6 +44,69 @@ TEST_CASE("scenario: pattern app")
     auto const x = std::unique_ptr<Base>{new Derived};
     CHECK(matched(x, some(as<Derived>(_))));
   }
+
+  SUBCASE("test app results are kept only for ids") {
+    constexpr auto name = [](int32_t a_id) { return std::to_string(a_id); };
+
+    static_assert(std::is_same_v<
+        impl::PatternTraits<impl::App<decltype(name) const &, decltype(_ != "")>>::template AppResultTuple<int32_t>,
+        std::tuple<>>);
+
+    static_assert(std::is_same_v<
+        impl::PatternTraits<impl::App<decltype(name) const &, Id<std::string>>>::template AppResultTuple<int32_t>,
+        std::tuple<std::string>>);
+
+    Id<std::string> s;
+    auto const result = match(42)(
+        pattern | app(name, "41") = expr(std::string("no")),
+        pattern | app(name, s)    = [&] { return "yes " + *s; }
+    );
+
+    CHECK(result == "yes 42");
+  }
+
+  SUBCASE("test memo projects once per match") {
+    int32_t calls = 0;
+    auto const length = memo([&](std::string const &a_name) {
+      ++calls;
+      return a_name.size();
+    });
+
+    auto const name = std::string("link-42");
+    Id<size_t> n;
+
+    auto const result = match(name)(
+        pattern | app(length, size_t{0})          = expr(0),
+        pattern | app(length, _ < size_t{4})      = expr(1),
+        pattern | app(length, and_(n, size_t{7})) = [&] { return static_cast<int32_t>(*n); },
+        pattern | _                               = expr(-1)
+    );
+
+    CHECK_EQ(result, 7);
+    CHECK_EQ(calls, 1);
+
+    match(name)(pattern | app(length, _) = [] {});
+    CHECK_EQ(calls, 2);
+  }
+
+  SUBCASE("test memo keys on the value") {
+    int32_t calls = 0;
+    auto const twice = memo([&](int32_t a_value) {
+      ++calls;
+      return std::to_string(a_value * 2);
+    });
+
+    auto const pair = std::make_tuple(3, 3);
+    Id<std::string> a, b;
+
+    auto const result = match(pair)(
+        pattern | ds(app(twice, "4"), _) = expr(std::string("four")),
+        pattern | ds(app(twice, a), app(twice, b)) = [&] { return *a + *b; }
+    );
+
+    CHECK(result == "66");
+    CHECK_EQ(calls, 2);
+  }
 }
 
 TEST_CASE("scenario: pattern id")
@@ -422,6 +497,712 @@ TEST_CASE("scenario: no return")
   }
 }
 
+TEST_CASE("scenario: id binding")
+{
+  SUBCASE("test lvalues are bound by address") {
+    std::string const name = "link-42";
+    Id<std::string> s;
+
+    auto const *bound = match(name)(
+        pattern | s = [&] { return &*s; }
+    );
+
+    CHECK(bound == &name);
+  }
+
+  SUBCASE("test rvalues are bound inline and can be moved out") {
+    Id<std::string> s;
+
+    auto moved = match(std::string("link-42"))(
+        pattern | s = [&] { return s.move(); }
+    );
+
+    CHECK(moved == "link-42");
+  }
+
+  SUBCASE("test a copied id shares the binding") {
+    Id<int32_t> x;
+    auto y = x;
+
+    auto result = match(std::make_tuple(1, 2))(
+        pattern | ds(x, _) = [&] { return *y; }
+    );
+
+    CHECK(result == 1);
+  }
+
+  SUBCASE("test moving out of a pointer binding throws") {
+    int32_t const value = 7;
+    Id<int32_t> x;
+
+    CHECK_THROWS(match(value)(
+        pattern | x = [&] { return x.move(); }
+    ));
+  }
+}
+
+enum class SignalPhase : uint8_t
+{
+  Red,
+  Amber,
+  Green,
+  FlashingAmber = 200
+};
+
+constexpr auto phase_duration(SignalPhase a_phase)
+{
+  return match(a_phase)(
+      pattern | lit<SignalPhase::Red>           = expr(30),
+      pattern | lit<SignalPhase::Amber>         = expr(4),
+      pattern | lit<SignalPhase::Green>         = expr(25),
+      pattern | lit<SignalPhase::FlashingAmber> = expr(0),
+      pattern | _                               = expr(-1)
+  );
+}
+
+static_assert(phase_duration(SignalPhase::Amber) == 4);
+static_assert(phase_duration(SignalPhase::FlashingAmber) == 0);
+
+TEST_CASE("scenario: literal dispatch")
+{
+  using namespace impl;
+
+  SUBCASE("test literal arms are recognized at compile time") {
+    static_assert(LiteralDispatch<int32_t &, Literal<1>, Literal<2>, Wildcard>::value);
+    static_assert(LiteralDispatch<uint8_t const &, Literal<1>, Literal<255>>::value);
+    static_assert(LiteralDispatch<SignalPhase, Literal<SignalPhase::Red>, Wildcard>::value);
+    static_assert(!LiteralDispatch<uint8_t &, Literal<1>, Literal<256>>::value);
+    static_assert(!LiteralDispatch<int32_t &, Literal<1>, Wildcard, Literal<2>>::value);
+    static_assert(!LiteralDispatch<int32_t &, Literal<1>, int32_t>::value);
+    static_assert(!LiteralDispatch<int32_t &, Wildcard>::value);
+    static_assert(!LiteralDispatch<double &, Literal<1>>::value);
+
+    using DenseT = LiteralTable<LiteralDispatch<int32_t, Literal<-1>, Literal<5>, Literal<-1>>>;
+    static_assert(DenseT::dense_size == 7 && DenseT::arm_of(-1) == 0 && DenseT::arm_of(5) == 1);
+    static_assert(DenseT::arm_of(0) == 3 && DenseT::arm_of(6) == 3 && DenseT::arm_of(-2) == 3);
+
+    using SparseT = LiteralTable<LiteralDispatch<int64_t, Literal<1000000>, Literal<-7>, Literal<42>>>;
+    static_assert(SparseT::dense_size == 0 && SparseT::arm_of(-7) == 1 && SparseT::arm_of(1000000) == 0);
+    static_assert(SparseT::arm_of(43) == 3);
+  }
+
+  SUBCASE("test dense literals") {
+    auto const duration = [](int32_t a_phase) {
+      return match(a_phase)(
+          pattern | lit<0> = expr(30),
+          pattern | lit<1> = expr(4),
+          pattern | lit<2> = expr(25),
+          pattern | lit<1> = expr(-2),
+          pattern | _      = expr(-1)
+      );
+    };
+
+    CHECK_EQ(duration(0), 30);
+    CHECK_EQ(duration(1), 4);
+    CHECK_EQ(duration(2), 25);
+    CHECK_EQ(duration(3), -1);
+    CHECK_EQ(duration(-5), -1);
+    CHECK_EQ(phase_duration(SignalPhase::Green), 25);
+    CHECK_EQ(phase_duration(static_cast<SignalPhase>(7)), -1);
+  }
+
+  SUBCASE("test sparse literals") {
+    std::string output;
+    auto const name = [&](int64_t a_code) {
+      match(a_code)(
+          pattern | lit<-100000> = [&] { output = "low"; },
+          pattern | lit<3>       = [&] { output = "three"; },
+          pattern | lit<100000>  = [&] { output = "high"; }
+      );
+    };
+
+    name(3);
+    CHECK(output == "three");
+    name(-100000);
+    CHECK(output == "low");
+    name(100000);
+    CHECK(output == "high");
+    name(4);
+    CHECK(output == "high");
+  }
+
+  SUBCASE("test no literal match throws exception") {
+    CHECK_THROWS(match(4)(pattern | lit<1> = expr(true)));
+    CHECK(match(1)(pattern | lit<1> = expr(true)));
+  }
+}
+
+constexpr auto route_type(std::string_view a_name)
+{
+  return match(a_name)(
+      pattern | lit_str<"tram">       = expr(0),
+      pattern | lit_str<"subway">     = expr(1),
+      pattern | lit_str<"rail">       = expr(2),
+      pattern | lit_str<"bus">        = expr(3),
+      pattern | lit_str<"ferry">      = expr(4),
+      pattern | lit_str<"cable_tram"> = expr(5),
+      pattern | lit_str<"bus">        = expr(-2),
+      pattern | _                     = expr(-1)
+  );
+}
+
+static_assert(route_type("ferry") == 4);
+static_assert(route_type("bus") == 3);
+static_assert(route_type("") == -1);
+
+TEST_CASE("scenario: string dispatch")
+{
+  using namespace impl;
+
+  SUBCASE("test string literal arms are recognized at compile time") {
+    static_assert(StringDispatch<std::string_view, Literal<LiteralString{"a"}>, Wildcard>::value);
+    static_assert(StringDispatch<std::string const &, Literal<LiteralString{"a"}>>::value);
+    static_assert(StringDispatch<char const *const &, Literal<LiteralString{"a"}>>::value);
+    static_assert(!StringDispatch<std::string_view, Literal<LiteralString{"a"}>, char const *>::value);
+    static_assert(!StringDispatch<std::string_view, Wildcard, Literal<LiteralString{"a"}>>::value);
+    static_assert(!StringDispatch<int32_t, Literal<1>>::value);
+    static_assert(has_string_table<StringDispatch<std::string_view, Literal<LiteralString{"a"}>, Wildcard>>());
+    static_assert(!has_string_table<StringDispatch<int32_t, int32_t>>());
+
+    using TableT = StringTable<StringDispatch<std::string_view, Literal<LiteralString{"x"}>,
+                                             Literal<LiteralString{""}>, Literal<LiteralString{"x"}>>>;
+    static_assert(TableT::is_perfect && TableT::arm_of("x") == 0 && TableT::arm_of("") == 1);
+    static_assert(TableT::arm_of("y") == 3 && TableT::arm_of("xx") == 3);
+  }
+
+  SUBCASE("test many string literals") {
+    std::string output;
+    auto const classify = [&](std::string const &a_event) {
+      match(a_event)(
+          pattern | lit_str<"depart">   = [&] { output = "d"; },
+          pattern | lit_str<"arrive">   = [&] { output = "a"; },
+          pattern | lit_str<"enter">    = [&] { output = "e"; },
+          pattern | lit_str<"exit">     = [&] { output = "x"; },
+          pattern | lit_str<"wait">     = [&] { output = "w"; },
+          pattern | lit_str<"board">    = [&] { output = "b"; },
+          pattern | lit_str<"alight">   = [&] { output = "l"; },
+          pattern | lit_str<"reroute">  = [&] { output = "r"; },
+          pattern | lit_str<"stuck">    = [&] { output = "s"; },
+          pattern | lit_str<"teleport"> = [&] { output = "t"; }
+      );
+    };
+
+    for (auto const *event : {"depart", "arrive", "enter", "exit", "wait", "board", "alight", "reroute", "stuck", "teleport"}) {
+      classify(event);
+      CHECK(output == std::string(1, event == std::string_view{"alight"} ? 'l' : event == std::string_view{"exit"} ? 'x' : event[0]));
+    }
+
+    output.clear();
+    classify("departed");
+    CHECK(output.empty());
+    CHECK_EQ(route_type("cable_tram"), 5);
+    CHECK_EQ(route_type("Bus"), -1);
+  }
+
+  SUBCASE("test no string literal match throws exception") {
+    CHECK_THROWS(match(std::string_view{"car"})(pattern | lit_str<"bus"> = expr(true)));
+    constexpr auto s = "bar";
+    CHECK(match(s)(pattern | lit_str<"foo"> = expr(false), pattern | lit_str<"bar"> = expr(true)));
+  }
+}
+
+// the size of the length of a msgpack str of the given size
+constexpr auto str_length_size(size_t a_size)
+{
+  return match(a_size)(
+      pattern | (_ < 32)                          = expr(0),
+      pattern | (_ <= std::numeric_limits<uint8_t>::max())  = expr(1),
+      pattern | (_ <= std::numeric_limits<uint16_t>::max()) = expr(2),
+      pattern | (_ <= std::numeric_limits<uint32_t>::max()) = expr(4),
+      pattern | _                                 = expr(-1)
+  );
+}
+
+static_assert(str_length_size(31) == 0 && str_length_size(32) == 1 && str_length_size(255) == 1);
+static_assert(str_length_size(256) == 2 && str_length_size(65536) == 4 && str_length_size(size_t{1} << 32) == -1);
+
+TEST_CASE("scenario: interval dispatch")
+{
+  using namespace impl;
+
+  SUBCASE("test comparison arms are recognized at compile time") {
+    using LessT = decltype(_ < 3);
+    using AtLeastT = decltype(_ >= 3.5);
+    static_assert(IntervalDispatch<int32_t &, LessT, LessT, Wildcard>::value);
+    static_assert(IntervalDispatch<double const &, AtLeastT, LessT>::value);
+    static_assert(!IntervalDispatch<int32_t &, LessT, Wildcard, LessT>::value);
+    static_assert(!IntervalDispatch<int32_t &, LessT, decltype(_ == 3)>::value);
+    static_assert(!IntervalDispatch<int32_t &, LessT, int32_t>::value);
+    static_assert(!IntervalDispatch<bool, LessT>::value);
+    static_assert(!IntervalDispatch<std::string, LessT>::value);
+  }
+
+  SUBCASE("test the first arm true wins") {
+    auto const bin = [](int32_t a_value) {
+      return match(a_value)(
+          pattern | (_ < 10)  = expr(0),
+          pattern | (_ > 100) = expr(1),
+          pattern | (_ < 5)   = expr(2),
+          pattern | (_ >= 50) = expr(3),
+          pattern | _         = expr(4)
+      );
+    };
+
+    CHECK_EQ(bin(3), 0);
+    CHECK_EQ(bin(101), 1);
+    CHECK_EQ(bin(50), 3);
+    CHECK_EQ(bin(49), 4);
+    CHECK_EQ(str_length_size(1000), 2);
+  }
+
+  SUBCASE("test only the handler of the arm taken runs") {
+    int32_t calls = 0;
+    auto const count = [&](size_t a_size) {
+      match(a_size)(
+          pattern | (_ < 8)  = [&] { calls += 1; },
+          pattern | (_ < 16) = [&] { calls += 10; }
+      );
+    };
+
+    count(3);
+    count(12);
+    count(20);
+    CHECK_EQ(calls, 11);
+    CHECK_THROWS(match(20)(pattern | (_ < 16) = expr(true)));
+  }
+}
+
+// the level of service of a speed, in km/h
+constexpr auto los_classes(std::array<double, 6> const &a_speeds)
+{
+  std::array<char, 6> classes{};
+  match_each(a_speeds, classes,
+      pattern | (_ >= 80) = expr('A'),
+      pattern | (_ >= 60) = expr('B'),
+      pattern | (_ >= 40) = expr('C'),
+      pattern | (_ >= 20) = expr('D'),
+      pattern | _         = expr('F')
+  );
+  return classes;
+}
+
+static_assert(los_classes({90, 80, 79.5, 45, 20, 3}) == std::array<char, 6>{'A', 'A', 'B', 'C', 'D', 'F'});
+
+TEST_CASE("scenario: match each")
+{
+  using namespace impl;
+
+  SUBCASE("test predicate arms are lowered to a select chain") {
+    static_assert(IsSelectArm<decltype(pattern | (_ < 16) = expr(1))>::value);
+    static_assert(IsSelectArm<decltype(pattern | lit<3> = expr(1))>::value);
+    static_assert(IsSelectArm<decltype(pattern | 3 = expr(1))>::value);
+    static_assert(IsSelectArm<decltype(pattern | _ = expr(1))>::value);
+    static_assert(!IsSelectArm<decltype(pattern | _ = [] { return 1; })>::value);
+    static_assert(!IsSelectArm<decltype(pattern | or_(1, 2) = expr(1))>::value);
+
+    std::vector<int32_t> samples(1000);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = static_cast<int32_t>(i % 37) - 18;
+
+    std::vector<int32_t> clipped(samples.size());
+    match_each(samples, clipped,
+        pattern | (_ < -10) = expr(-10),
+        pattern | (_ > 10)  = expr(10),
+        pattern | 0         = expr(100),
+        pattern | (_ < 0)   = expr(-1),
+        pattern | _         = expr(1));
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+      auto const s = samples[i];
+      CHECK_EQ(clipped[i], s < -10 ? -10 : s > 10 ? 10 : s == 0 ? 100 : s < 0 ? -1 : 1);
+    }
+  }
+
+  SUBCASE("test other arms are matched one element at a time") {
+    std::vector<int32_t> const samples{-3, 0, 1, 2, 5};
+    std::array<int32_t, 5> levels{};
+    int32_t calls = 0;
+    match_each(samples, levels,
+        pattern | (_ < 0)      = expr(0),
+        pattern | or_(1, 2)    = expr(12),
+        pattern | _            = [&] { return ++calls; });
+    CHECK(levels == std::array<int32_t, 5>{0, 1, 12, 12, 2});
+  }
+
+  SUBCASE("test an element matching no arm throws exception") {
+    std::vector<int32_t> const samples{1, 2, 3};
+    std::vector<int32_t> out(3);
+    CHECK_THROWS(match_each(samples, out, pattern | (_ < 3) = expr(0)));
+
+    // only as many elements as the output holds are matched
+    out.resize(2);
+    match_each(samples, out, pattern | (_ < 3) = expr(7));
+    CHECK(out == std::vector<int32_t>{7, 7});
+  }
+
+  SUBCASE("test match each on the shared executor") {
+    std::vector<double> speeds(100000);
+    for (size_t i = 0; i < speeds.size(); ++i) speeds[i] = static_cast<double>(i % 100);
+
+    std::vector<char> classes(speeds.size());
+    match_each(mio::Executor::shared(), speeds, classes,
+        pattern | (_ >= 80) = expr('A'),
+        pattern | (_ >= 40) = expr('C'),
+        pattern | _         = expr('F'));
+
+    CHECK(std::count(classes.begin(), classes.end(), 'A') == 20000);
+    CHECK(std::count(classes.begin(), classes.end(), 'C') == 40000);
+    CHECK(std::count(classes.begin(), classes.end(), 'F') == 40000);
+
+    std::vector<int32_t> codes{1, 2, 3, 4};
+    std::vector<int32_t> out(codes.size());
+    CHECK_THROWS(match_each(mio::Executor::shared(), codes, out, pattern | (_ < 4) = expr(0)));
+  }
+}
+
+struct LinkEntered
+{
+  int32_t link;
+};
+
+struct LinkExited
+{
+  int32_t link;
+};
+
+struct Stopped
+{
+};
+
+using Event = std::variant<LinkEntered, LinkExited, Stopped, int32_t>;
+
+TEST_CASE("scenario: variant dispatch")
+{
+  using namespace impl;
+
+  SUBCASE("test as arms over a variant are recognized at compile time") {
+    using EnteredT = decltype(as<LinkEntered>(_));
+    using ExitedT = decltype(as<LinkExited>(_));
+    using IntT = decltype(as<int32_t>(1));
+
+    static_assert(VariantDispatch<Event const &, EnteredT, ExitedT, Wildcard>::value);
+    static_assert(VariantDispatch<Event &, IntT, EnteredT, IntT>::value);
+    static_assert(VariantDispatch<Event, PostCheck<EnteredT, decltype(expr(true))>>::value);
+    static_assert(VariantDispatch<Event, EnteredT, ExitedT, Wildcard>::alternatives[1] == 1);
+    static_assert(!VariantDispatch<Event, EnteredT, Wildcard, ExitedT>::value);
+    static_assert(!VariantDispatch<Event, EnteredT, decltype(as<double>(_))>::value);
+    static_assert(!VariantDispatch<std::variant<int32_t, int32_t>, IntT>::value);
+    static_assert(!VariantDispatch<Event, Wildcard>::value);
+    static_assert(!VariantDispatch<LinkEntered, EnteredT>::value);
+  }
+
+  SUBCASE("test arms of the alternative held are tried in order") {
+    auto const describe = [](Event const &a_event) {
+      Id<int32_t> link;
+      return match(a_event)(
+          pattern | as<int32_t>(0)                      = expr(std::string("zero")),
+          pattern | as<LinkEntered>(app(&LinkEntered::link, link)) | when(link > 9)
+                                                        = [&] { return "far " + std::to_string(*link); },
+          pattern | as<LinkExited>(_)                   = expr(std::string("exited")),
+          pattern | as<LinkEntered>(app(&LinkEntered::link, link))
+                                                        = [&] { return "entered " + std::to_string(*link); },
+          pattern | as<int32_t>(_)                      = expr(std::string("code")),
+          pattern | _                                   = expr(std::string("other"))
+      );
+    };
+
+    CHECK(describe(LinkEntered{3}) == "entered 3");
+    CHECK(describe(LinkEntered{12}) == "far 12");
+    CHECK(describe(LinkExited{3}) == "exited");
+    CHECK(describe(0) == "zero");
+    CHECK(describe(5) == "code");
+    CHECK(describe(Stopped{}) == "other");
+  }
+
+  SUBCASE("test no alternative match") {
+    auto const is_entered = [](Event const &a_event) {
+      return match(a_event)(
+          pattern | as<LinkEntered>(_) = expr(true),
+          pattern | as<int32_t>(_)     = expr(false)
+      );
+    };
+
+    CHECK(is_entered(LinkEntered{1}));
+    CHECK_FALSE(is_entered(7));
+    CHECK_THROWS(is_entered(Stopped{}));
+
+    int32_t count = 0;
+    match(Event{Stopped{}})(
+        pattern | as<LinkEntered>(_) = [&] { ++count; }
+    );
+    CHECK_EQ(count, 0);
+  }
+}
+
+meta_enum_class(TurnKind, uint8_t, Left = 1, Through = 2, Right = 4, UTurn = 128);
+meta_enum_codec(TurnKind);
+
+constexpr auto turn_penalty(TurnKind a_turn)
+{
+  return match(a_turn).exhaustive(
+      pattern | lit<TurnKind::Through> = expr(0),
+      pattern | lit<TurnKind::Right>   = expr(2),
+      pattern | lit<TurnKind::Left>    = expr(5),
+      pattern | lit<TurnKind::UTurn>   = expr(30)
+  );
+}
+
+static_assert(turn_penalty(TurnKind::Left) == 5 && turn_penalty(TurnKind::UTurn) == 30);
+
+TEST_CASE("scenario: exhaustive match")
+{
+  using namespace impl;
+
+  SUBCASE("test coverage is checked at compile time") {
+    using ThroughT = Literal<TurnKind::Through>;
+    using RightT = Literal<TurnKind::Right>;
+    using LeftT = Literal<TurnKind::Left>;
+    using UTurnT = Literal<TurnKind::UTurn>;
+    static_assert(ExhaustiveCoverage<TurnKind, LeftT, ThroughT, RightT, UTurnT>::value);
+    static_assert(ExhaustiveCoverage<TurnKind, LeftT, LeftT, ThroughT, RightT, UTurnT>::value);
+    static_assert(!ExhaustiveCoverage<TurnKind, LeftT, ThroughT, RightT>::value);
+    static_assert(ExhaustiveCoverage<TurnKind &, LeftT, Wildcard>::value);
+    static_assert(!ExhaustiveCoverage<SignalPhase, Literal<SignalPhase::Red>, Literal<SignalPhase::Amber>,
+                                      Literal<SignalPhase::Green>, Literal<SignalPhase::FlashingAmber>>::value);
+
+    using EnteredT = decltype(as<LinkEntered>(_));
+    using ExitedT = decltype(as<LinkExited>(_));
+    using StoppedT = decltype(as<Stopped>(_));
+    using CodeT = decltype(as<int32_t>(_));
+    using LinkT = decltype(as<LinkEntered>(app(&LinkEntered::link, std::declval<Id<int32_t> &>())));
+    static_assert(ExhaustiveCoverage<Event const &, EnteredT, ExitedT, StoppedT, CodeT>::value);
+    static_assert(ExhaustiveCoverage<Event, LinkT, ExitedT, StoppedT, CodeT>::value);
+    static_assert(!ExhaustiveCoverage<Event, EnteredT, ExitedT, StoppedT, decltype(as<int32_t>(0))>::value);
+    static_assert(!ExhaustiveCoverage<Event, EnteredT, ExitedT, StoppedT>::value);
+    static_assert(!ExhaustiveCoverage<Event, PostCheck<EnteredT, decltype(expr(true))>, ExitedT, StoppedT, CodeT>::value);
+    static_assert(!ExhaustiveCoverage<int32_t, Literal<1>>::value);
+  }
+
+  SUBCASE("test exhaustive matches over a variant") {
+    auto const describe = [](Event const &a_event) {
+      return match(a_event).exhaustive(
+          pattern | as<int32_t>(0)      = expr(std::string("zero")),
+          pattern | as<LinkEntered>(_)  = expr(std::string("entered")),
+          pattern | as<LinkExited>(_)   = expr(std::string("exited")),
+          pattern | as<Stopped>(_)      = expr(std::string("stopped")),
+          pattern | as<int32_t>(_)      = expr(std::string("code"))
+      );
+    };
+
+    CHECK(describe(LinkEntered{3}) == "entered");
+    CHECK(describe(LinkExited{3}) == "exited");
+    CHECK(describe(Stopped{}) == "stopped");
+    CHECK(describe(0) == "zero");
+    CHECK(describe(5) == "code");
+
+    int32_t count = 0;
+    match(Event{LinkExited{}}).exhaustive(
+        pattern | as<LinkEntered>(_) = [&] { count += 1; },
+        pattern | as<LinkExited>(_)  = [&] { count += 10; },
+        pattern | _                  = [&] { count += 100; }
+    );
+    CHECK_EQ(count, 10);
+    CHECK_EQ(turn_penalty(TurnKind::Through), 0);
+  }
+}
+
+enum class NodeKind : uint8_t
+{
+  kConstant,
+  kNegate,
+  kAdd
+};
+
+// a closed hierarchy without virtual functions, tagged by its base
+struct Node
+{
+  NodeKind kind;
+
+  constexpr bool operator==(Node const &) const = default;
+};
+
+struct Constant : Node
+{
+  constexpr static auto tag = NodeKind::kConstant;
+  int32_t value;
+
+  constexpr bool operator==(Constant const &) const = default;
+};
+
+struct Negate : Node
+{
+  constexpr static auto tag = NodeKind::kNegate;
+  Node const *operand;
+
+  constexpr bool operator==(Negate const &) const = default;
+};
+
+struct Add : Node
+{
+  constexpr static auto tag = NodeKind::kAdd;
+  Node const *lhs;
+  Node const *rhs;
+
+  constexpr bool operator==(Add const &) const = default;
+};
+
+template<>
+struct matchit::impl::ClosedHierarchy<Node>
+{
+  constexpr static auto kind(Node const &a_node)
+  {
+    return a_node.kind;
+  }
+
+  template<typename T>
+  constexpr static auto kind_of = T::tag;
+};
+
+constexpr int32_t eval_node(Node const &a_node)
+{
+  Id<Constant> constant;
+  Id<Negate> negate;
+  Id<Add> add;
+
+  return match(a_node)(
+      pattern | as<Constant>(constant) = [&] { return (*constant).value; },
+      pattern | as<Negate>(negate)     = [&] { return -eval_node(*(*negate).operand); },
+      pattern | as<Add>(add)           = [&] { return eval_node(*(*add).lhs) + eval_node(*(*add).rhs); }
+  );
+}
+
+constexpr Constant kFive{{NodeKind::kConstant}, 5};
+constexpr Constant kThree{{NodeKind::kConstant}, 3};
+constexpr Negate kMinusThree{{NodeKind::kNegate}, &kThree};
+constexpr Add kTwo{{NodeKind::kAdd}, &kFive, &kMinusThree};
+
+static_assert(eval_node(kTwo) == 2);
+
+TEST_CASE("scenario: hierarchy dispatch")
+{
+  using namespace impl;
+
+  SUBCASE("test as arms over a closed hierarchy are recognized at compile time") {
+    using ConstantT = decltype(as<Constant>(_));
+    using AddT = decltype(as<Add>(_));
+
+    static_assert(ClosedHierarchyOf<Constant, Node>);
+    static_assert(!ClosedHierarchyOf<Node, Node>);
+    static_assert(!ClosedHierarchyOf<Derived, Base>);
+    static_assert(HierarchyDispatch<Node const &, ConstantT, AddT, ConstantT, Wildcard>::value);
+    static_assert(HierarchyDispatch<Node const &, ConstantT, AddT, ConstantT>::template is_first_of_tag<1>());
+    static_assert(!HierarchyDispatch<Node const &, ConstantT, AddT, ConstantT>::template is_first_of_tag<2>());
+    static_assert(!HierarchyDispatch<Node const &, ConstantT, Wildcard, AddT>::value);
+    static_assert(!HierarchyDispatch<Base const &, decltype(as<Derived>(_))>::value);
+  }
+
+  SUBCASE("test as tests the tag") {
+    Node const &node = kMinusThree;
+    CHECK(as_pointer<Negate>(node) == &kMinusThree);
+    CHECK(as_pointer<Add>(node) == nullptr);
+  }
+
+  SUBCASE("test arms of the tag are tried in order") {
+    auto const describe = [](Node const &a_node) {
+      Id<int32_t> value;
+      return match(a_node)(
+          pattern | as<Constant>(app(&Constant::value, 0))     = expr(std::string("zero")),
+          pattern | as<Add>(_)                                 = expr(std::string("add")),
+          pattern | as<Constant>(app(&Constant::value, value)) = [&] { return std::to_string(*value); },
+          pattern | _                                          = expr(std::string("other"))
+      );
+    };
+
+    Constant const zero{{NodeKind::kConstant}, 0};
+    CHECK(describe(zero) == "zero");
+    CHECK(describe(kFive) == "5");
+    CHECK(describe(kTwo) == "add");
+    CHECK(describe(kMinusThree) == "other");
+    CHECK_EQ(eval_node(kTwo), 2);
+  }
+}
+
+constexpr auto turn_penalty(SignalPhase a_phase, int32_t a_from, int32_t a_to)
+{
+  return match(a_phase, a_from, a_to)(
+      pattern | ds(lit<SignalPhase::Red>, _, _)             = expr(100),
+      pattern | ds(lit<SignalPhase::Green>, lit<1>, lit<2>) = expr(0),
+      pattern | ds(lit<SignalPhase::Green>, lit<1>, _)      = expr(5),
+      pattern | ds(_, lit<2>, lit<1>)                       = expr(10),
+      pattern | ds(lit<SignalPhase::Amber>, _, lit<3>)      = expr(20),
+      pattern | _                                           = expr(-1)
+  );
+}
+
+static_assert(impl::DsDispatch<std::tuple<SignalPhase, int32_t, int32_t>,
+                               impl::Ds<impl::Literal<SignalPhase::Red>, impl::Wildcard, impl::Wildcard>,
+                               impl::Wildcard>::is_static);
+static_assert(!impl::DsDispatch<std::tuple<int32_t, int32_t>,
+                                impl::Ds<impl::Literal<0>, impl::Id<int32_t>>,
+                                impl::Wildcard>::is_static);
+static_assert(impl::DsDispatch<std::tuple<int32_t, int32_t>,
+                               impl::Ds<impl::Literal<0>, impl::Id<int32_t>>,
+                               impl::Wildcard>::value);
+static_assert(turn_penalty(SignalPhase::Red, 1, 2) == 100);
+static_assert(turn_penalty(SignalPhase::Green, 1, 2) == 0);
+static_assert(turn_penalty(SignalPhase::Green, 1, 3) == 5);
+static_assert(turn_penalty(SignalPhase::Green, 2, 1) == 10);
+static_assert(turn_penalty(SignalPhase::Amber, 2, 1) == 10);
+static_assert(turn_penalty(SignalPhase::Amber, 4, 3) == 20);
+static_assert(turn_penalty(SignalPhase::FlashingAmber, 4, 3) == -1);
+
+TEST_CASE("scenario: ds dispatch")
+{
+  SUBCASE("test literal and wildcard arms") {
+    for (int32_t from = 0; from < 5; ++from) {
+      for (int32_t to = 0; to < 5; ++to) {
+        auto const expected = from == 1 && to == 2 ? 0 : from == 1 ? 5 : from == 2 && to == 1 ? 10 : -1;
+        CHECK_EQ(turn_penalty(SignalPhase::Green, from, to), expected);
+      }
+    }
+  }
+
+  SUBCASE("test arms binding ids") {
+    auto const describe = [](std::tuple<int32_t, int32_t> const &a_movement) {
+      Id<int32_t> x, y;
+      return match(a_movement)(
+          pattern | ds(lit<0>, lit<0>) = expr(std::string("stay")),
+          pattern | ds(lit<0>, y)      = [&] { return "enter " + std::to_string(*y); },
+          pattern | ds(x, lit<0>)      = [&] { return "leave " + std::to_string(*x); },
+          pattern | ds(x, x)           = expr(std::string("loop")),
+          pattern | ds(x, _ > 10)      = [&] { return "far from " + std::to_string(*x); },
+          pattern | _                  = expr(std::string("move"))
+      );
+    };
+
+    CHECK(describe({0, 0}) == "stay");
+    CHECK(describe({0, 7}) == "enter 7");
+    CHECK(describe({7, 0}) == "leave 7");
+    CHECK(describe({7, 7}) == "loop");
+    CHECK(describe({7, 12}) == "far from 7");
+    CHECK(describe({7, 8}) == "move");
+  }
+
+  SUBCASE("test match statement") {
+    int32_t count = 0;
+    auto const step = [&](std::array<int32_t, 2> const &a_cell) {
+      match(a_cell)(
+          pattern | ds(lit<1>, _) = [&] { count += 1; },
+          pattern | ds(_, lit<1>) = [&] { count += 10; }
+      );
+    };
+
+    step({1, 1});
+    step({0, 1});
+    step({0, 0});
+    CHECK_EQ(count, 11);
+  }
+}
+
 TEST_CASE("scenario: expression")
 {
   SUBCASE("test nullary") {
@@ -450,6 +1231,57 @@ TEST_CASE("scenario: expression")
   }
 }
 
+constexpr auto packet_kind(std::array<uint8_t, 6> const &a_header)
+{
+  return match(a_header)(
+      pattern | ds(lit<0xca>, lit<0xfe>, lit<0xba>, lit<0xbe>, _, _) = expr(1),
+      pattern | ds(lit<0x7f>, lit<'E'>, lit<'L'>, lit<'F'>, ooo)     = expr(2),
+      pattern | _                                                    = expr(0)
+  );
+}
+
+static_assert(packet_kind({0xca, 0xfe, 0xba, 0xbe, 0, 0}) == 1);
+static_assert(packet_kind({0x7f, 'E', 'L', 'F', 2, 1}) == 2);
+static_assert(packet_kind({0x7f, 'E', 'L', 'G', 2, 1}) == 0);
+
+TEST_CASE("scenario: slice literals")
+{
+  SUBCASE("test literal prefixes of a byte array") {
+    CHECK_EQ(packet_kind({0xca, 0xfe, 0xba, 0xbe, 9, 9}), 1);
+    CHECK_EQ(packet_kind({0x7f, 'E', 'L', 'F', 2, 1}), 2);
+    CHECK_EQ(packet_kind({0xca, 0xfe, 0xba, 0xbf, 9, 9}), 0);
+    CHECK_EQ(packet_kind({0x7e, 'E', 'L', 'F', 2, 1}), 0);
+  }
+
+  SUBCASE("test literal prefix and suffix of a string") {
+    auto const classify = [](std::string_view a_line) {
+      return match(a_line)(
+          pattern | ds(lit<'G'>, lit<'E'>, lit<'T'>, lit<' '>, ooo, lit<'\r'>, lit<'\n'>) = expr(std::string("get")),
+          pattern | ds(lit<'P'>, lit<'U'>, lit<'T'>, lit<' '>, ooo)                       = expr(std::string("put")),
+          pattern | _                                                                     = expr(std::string("other"))
+      );
+    };
+
+    CHECK(classify("GET /links HTTP/1.1\r\n") == "get");
+    CHECK(classify("GET /links HTTP/1.1\n") == "other");
+    CHECK(classify("PUT /links/42") == "put");
+    CHECK(classify("PUT") == "other");
+    CHECK(classify("") == "other");
+  }
+
+  SUBCASE("test literals mixed with ids") {
+    auto const frame = std::vector<uint8_t>{0x55, 7, 0xaa, 3, 0x0d};
+    Id<uint8_t> kind, length;
+
+    auto const result = match(std::span<uint8_t const>{frame})(
+        pattern | ds(lit<0x55>, kind, lit<0xaa>, length, lit<0x0d>) = [&] { return *kind * 100 + *length; },
+        pattern | _                                                 = expr(-1)
+    );
+
+    CHECK_EQ(result, 703);
+  }
+}
+
 TEST_CASE("scenario: ds")
 {
   using namespace impl;
@@ -41,17 +41,20 @@ bool operator==(Rectangle const &lhs, Rectangle const &rhs)
   return lhs.width == rhs.width && lhs.height == rhs.height;
 }
 
-namespace std {
+#include "../../matchit/matchit.hpp"
 
-template<typename T>
-auto get_if(Shape const *shape)
+// as<T> tests the tag and static_casts, instead of a dynamic_cast
+template<>
+struct matchit::impl::ClosedHierarchy<Shape>
 {
-  return static_cast<T const *>(shape->kind == T::kind ? shape : nullptr);
-}
-
-}
+  constexpr static auto kind(Shape const &shape)
+  {
+    return shape.kind;
+  }
 
-#include "../../matchit/matchit.hpp"
+  template<typename T>
+  constexpr static auto kind_of = T::kind;
+};
 
 double get_area(const Shape &shape)
 {
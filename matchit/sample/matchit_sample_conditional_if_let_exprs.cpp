@@ -1,4 +1,4 @@
-#include "../include/matchit/matchit.hpp"
+#include "../../matchit/matchit.hpp"
 #include <optional>
 
 template<typename V, typename E>
@@ -55,7 +55,7 @@ constexpr auto dsByMember(DummyStruct const &v)
 {
   using namespace matchit;
   // compose patterns for destructuring struct DummyStruct.
-  constexpr auto dsA = dsVia(&DummyStruct::size, &DummyStruct::name);
+  constexpr auto dsA = ds_via(&DummyStruct::size, &DummyStruct::name);
   Id<char const *> i;
   return match(v)(
       // clang-format off
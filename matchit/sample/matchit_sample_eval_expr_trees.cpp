@@ -40,9 +40,9 @@ bool operator==(Expr const &l, Expr const &r)
          static_cast<std::variant<int, Neg, Add, Mul> const &>(r);
 }
 
-const auto asNegDs = asDsVia<Neg>(&Neg::expr);
-const auto asAddDs = asDsVia<Add>(&Add::lhs, &Add::rhs);
-const auto asMulDs = asDsVia<Mul>(&Mul::lhs, &Mul::rhs);
+const auto asNegDs = as_ds_via<Neg>(&Neg::expr);
+const auto asAddDs = as_ds_via<Add>(&Add::lhs, &Add::rhs);
+const auto asMulDs = as_ds_via<Mul>(&Mul::lhs, &Mul::rhs);
 
 int eval(const Expr &ex)
 {
@@ -31,7 +31,7 @@ bool matchGraph()
 
   using namespace matchit;
   // FIXME, moving dsN into someDsN will cause segfault.
-  constexpr auto dsN = dsVia(&StrNode::value, &StrNode::parents);
+  constexpr auto dsN = ds_via(&StrNode::value, &StrNode::parents);
   constexpr auto someDsN = [dsN](auto... pats)
   {
     return some(dsN(pats...));
@@ -21,7 +21,7 @@ struct Person
   uint8_t age;
 };
 
-auto const name_age = dsVia(&Person::name, &Person::age);
+auto const name_age = ds_via(&Person::name, &Person::age);
 
 void sample2()
 {
@@ -31,7 +31,7 @@ void sample2()
 
   constexpr auto color = RGBA{0.4f, 0.1f, 0.9f, 0.5f};
 
-  constexpr auto dsRGBA = dsVia(&RGBA::r, &RGBA::g, &RGBA::b, &RGBA::a);
+  constexpr auto dsRGBA = ds_via(&RGBA::r, &RGBA::g, &RGBA::b, &RGBA::a);
 
   Id<float> red, green, blue;
   match(color)(pattern | dsRGBA(red, green, blue, _) = [&]
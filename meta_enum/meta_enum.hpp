@@ -11,10 +11,27 @@
 #ifndef WXLIB_META_ENUM_HPP
 #define WXLIB_META_ENUM_HPP
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <concepts>
+#include <cstdint>
 #include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define META_ENUM_HAS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define META_ENUM_HAS_NEON 1
+#include <arm_neon.h>
+#endif
 
 template<typename EnumT>/* */
 requires std::is_enum_v<EnumT>
@@ -42,51 +59,36 @@ constexpr bool IsNested(size_t a_brackets, bool a_quote)
   return a_brackets != 0 || a_quote;
 }
 
-constexpr size_t NextEnumCommaOrEndPos(size_t a_start, std::string_view a_enum_str)
+// tracks the nesting of the character c of an enum declaration, given its neighbours
+constexpr void FeedCounters(char c, char a_last_char, char a_next_char, size_t &a_brackets, bool &a_quote)
 {
-  size_t brackets = 0; //()[]{}
-  bool quote = false;  //""
-  char last_char = '\0';
-  char next_char = '\0';
-
-  auto feed_counters = [&](char c) constexpr {
-    if (quote) {
-      if (last_char != '\\' && c == '"') //ignore " if they are backslashes
-        quote = false;
-      return;
-    }
+  if (a_quote) {
+    if (a_last_char != '\\' && c == '"') //ignore " if they are backslashes
+      a_quote = false;
+    return;
+  }
 
-    switch (c) {
-      case '"':
-        if (last_char != '\\') //ignore " if they are backslashes
-          quote = true;
-        break;
-      case '(':
-      case '<':
-        if (last_char == '<' || next_char == '<')
-          break;
-        [[fallthrough]];
-      case '{':++brackets;
+  switch (c) {
+    case '"':
+      if (a_last_char != '\\') //ignore " if they are backslashes
+        a_quote = true;
+      break;
+    case '(':
+    case '<':
+      if (a_last_char == '<' || a_next_char == '<')
         break;
-      case ')':
-      case '>':
-        if (last_char == '>' || next_char == '>')
-          break;
-        [[fallthrough]];
-      case '}':--brackets;
+      [[fallthrough]];
+    case '{':++a_brackets;
+      break;
+    case ')':
+    case '>':
+      if (a_last_char == '>' || a_next_char == '>')
         break;
-      default:break;
-    }
-  };
-
-  size_t current = a_start;
-  for (; current < a_enum_str.size() && (IsNested(brackets, quote) || (a_enum_str[current] != ',')); ++current) {
-    feed_counters(a_enum_str[current]);
-    last_char = a_enum_str[current];
-    next_char = current + 2 < a_enum_str.size() ? a_enum_str[current + 2] : '\0';
+      [[fallthrough]];
+    case '}':--a_brackets;
+      break;
+    default:break;
   }
-
-  return current;
 }
 
 constexpr bool IsAllowedIdChar(char c)
@@ -96,48 +98,59 @@ constexpr bool IsAllowedIdChar(char c)
 
 constexpr std::string_view ParseEnumMemberName(std::string_view a_member_str)
 {
+  const char *chars = a_member_str.data();
+  const size_t length = a_member_str.size();
+
   size_t name_start = 0;
-  while (!IsAllowedIdChar(a_member_str[name_start])) {
+  while (!IsAllowedIdChar(chars[name_start])) {
     ++name_start;
   }
 
-  size_t name_size = 0;
-  while ((name_start + name_size) < a_member_str.size() && IsAllowedIdChar(a_member_str[name_start + name_size])) {
-    ++name_size;
+  size_t name_end = name_start;
+  while (name_end < length && IsAllowedIdChar(chars[name_end])) {
+    ++name_end;
   }
 
-  return {&a_member_str[name_start], name_size};
+  return {chars + name_start, name_end - name_start};
 }
 
+// splits the declaration at the commas outside of brackets and quotes, in a single pass
 template<typename EnumT, typename EnumeratorT, size_t size>
 constexpr MetaEnum<EnumT, EnumeratorT, size> ParseMetaEnum(std::string_view in, const std::array<EnumT, size> &a_values)
 {
   MetaEnum<EnumT, EnumeratorT, size> result;
   result.string = in;
 
-  std::array<std::string_view, size> member_str;
-  size_t amount_filled = 0;
-  size_t startpos = 0;
-
-  while (amount_filled < size) {
-    const size_t endpos = NextEnumCommaOrEndPos(startpos + 1, in);
-    size_t strlen = endpos - startpos;
-
-    if (startpos != 0) {
-      ++startpos;
-      --strlen;
+  size_t brackets = 0; //()[]{}
+  bool quote = false;  //""
+  size_t member_start = 0;
+  size_t index = 0;
+
+  // plain pointer indexing, function calls dominate the cost of constant evaluation
+  const char *chars = in.data();
+  const size_t length = in.size();
+
+  for (size_t current = 0; index < size; ++current) {
+    if (current == length || (!IsNested(brackets, quote) && chars[current] == ',')) {
+      auto &member = result.members[index];
+      member.string = std::string_view(chars + member_start, current - member_start);
+      member.name = ParseEnumMemberName(member.string);
+      member.value = a_values[index];
+      member.index = index;
+
+      ++index;
+      member_start = current + 1;
+      continue;
     }
 
-    member_str[amount_filled] = {&in[startpos], strlen};
-    ++amount_filled;
-    startpos = endpos;
-  }
+    const char c = chars[current];
+    if (!quote && c != '"' && c != '(' && c != ')' && c != '<' && c != '>' && c != '{' && c != '}') continue;
 
-  for (size_t i = 0; i < member_str.size(); ++i) {
-    result.members[i].name = ParseEnumMemberName(member_str[i]);
-    result.members[i].string = member_str[i];
-    result.members[i].value = a_values[i];
-    result.members[i].index = i;
+    // the first character of a member has no neighbours
+    const bool is_first = current == member_start;
+    const char last_char = is_first ? '\0' : chars[current - 1];
+    const char next_char = !is_first && current + 1 < length ? chars[current + 1] : '\0';
+    FeedCounters(c, last_char, next_char, brackets, quote);
   }
 
   return result;
@@ -171,112 +184,762 @@ constexpr std::array<EnumT, size> ResolveEnumValuesArray(const std::initializer_
   std::array<EnumT, size> result{};
 
   EnumeratorT next_value = 0;
+  const IntWrapper<EnumeratorT> *wrappers = in.begin();
   for (size_t i = 0; i < size; ++i) {
-    auto it = in.begin();
-    auto wrapper = (std::advance(it, i), *it);
-    EnumeratorT new_value = wrapper.empty ? next_value : wrapper.value;
+    EnumeratorT new_value = wrappers[i].empty ? next_value : wrappers[i].value;
     next_value = new_value + 1;
     result[i] = static_cast<EnumT>(new_value);
   }
 
   return result;
 }
+
+// index of a member by value and by name, built at compile time: values spanning a small range
+// index a dense table directly, others are binary searched in sorted order, names are hashed
+// into an open-addressing table twice the member count
+template<typename EnumT, typename EnumeratorT, size_t size, size_t dense_size>
+struct MetaEnumLookup
+{
+  static constexpr size_t npos = size;
+  static constexpr size_t name_capacity = std::bit_ceil(size * 2);
+
+  EnumeratorT min_value = 0;
+  std::array<size_t, dense_size> dense = {};
+  std::array<EnumeratorT, dense_size == 0 ? size : 0> sorted_values = {};
+  std::array<size_t, dense_size == 0 ? size : 0> sorted_indices = {};
+  std::array<size_t, name_capacity> name_slots = {};
+  std::array<std::string_view, size> names = {};
+
+  // the index of the first member with the value, or npos
+  constexpr size_t IndexOfValue(EnumT a_value) const
+  {
+    const auto value = static_cast<EnumeratorT>(a_value);
+
+    if constexpr (dense_size > 0) {
+      const auto offset = static_cast<uint64_t>(value) - static_cast<uint64_t>(min_value);
+      return offset < dense_size ? dense[offset] : npos;
+    } else {
+      size_t first = 0;
+      size_t count = size;
+
+      while (count > 0) {
+        const size_t half = count / 2;
+        if (sorted_values[first + half] < value) {
+          first += half + 1;
+          count -= half + 1;
+        } else {
+          count = half;
+        }
+      }
+
+      return first < size && sorted_values[first] == value ? sorted_indices[first] : npos;
+    }
+  }
+
+  // the index of the member with the name, or npos
+  constexpr size_t IndexOfName(std::string_view a_name) const
+  {
+    for (size_t slot = NameHash(a_name) & (name_capacity - 1);; slot = (slot + 1) & (name_capacity - 1)) {
+      const size_t index = name_slots[slot];
+      if (index == npos || names[index] == a_name) return index;
+    }
+  }
+
+  static constexpr size_t NameHash(std::string_view a_name)
+  {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const char *chars = a_name.data();
+
+    for (size_t i = 0; i < a_name.size(); ++i) {
+      hash ^= static_cast<unsigned char>(chars[i]);
+      hash *= 0x100000001b3ull;
+    }
+
+    return static_cast<size_t>(hash ^ (hash >> 29));
+  }
+};
+
+// the size of the dense value table, or 0 if the values are too spread for one
+template<typename EnumT, typename EnumeratorT, size_t size>
+constexpr size_t DenseSize(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  if constexpr (size == 0) {
+    return 0;
+  } else {
+    auto min_value = static_cast<EnumeratorT>(a_meta.members[0].value);
+    auto max_value = min_value;
+
+    for (const auto &member : a_meta.members) {
+      min_value = std::min(min_value, static_cast<EnumeratorT>(member.value));
+      max_value = std::max(max_value, static_cast<EnumeratorT>(member.value));
+    }
+
+    const uint64_t range = static_cast<uint64_t>(max_value) - static_cast<uint64_t>(min_value);
+    const uint64_t limit = std::max<uint64_t>(64, size * 4);
+    return range < limit ? static_cast<size_t>(range) + 1 : 0;
+  }
+}
+
+template<typename EnumT, typename EnumeratorT, size_t size, size_t dense_size>
+constexpr MetaEnumLookup<EnumT, EnumeratorT, size, dense_size> BuildLookup(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  using LookupT = MetaEnumLookup<EnumT, EnumeratorT, size, dense_size>;
+  constexpr auto npos = LookupT::npos;
+  constexpr auto name_mask = LookupT::name_capacity - 1;
+
+  LookupT result;
+  const MetaEnumMember<EnumT> *members = a_meta.members.data();
+
+  size_t *name_slots = result.name_slots.data();
+  for (size_t slot = 0; slot < LookupT::name_capacity; ++slot) name_slots[slot] = npos;
+
+  for (size_t i = 0; i < size; ++i) {
+    result.names[i] = members[i].name;
+
+    size_t slot = LookupT::NameHash(members[i].name) & name_mask;
+    while (name_slots[slot] != npos) slot = (slot + 1) & name_mask;
+    name_slots[slot] = i;
+  }
+
+  if constexpr (dense_size > 0) {
+    auto min_value = static_cast<EnumeratorT>(members[0].value);
+    for (size_t i = 1; i < size; ++i) min_value = std::min(min_value, static_cast<EnumeratorT>(members[i].value));
+    result.min_value = min_value;
+
+    size_t *dense = result.dense.data();
+    for (size_t offset = 0; offset < dense_size; ++offset) dense[offset] = npos;
+
+    // backwards, so that the first of the members sharing a value is found
+    for (size_t i = size; i-- > 0;)
+      dense[static_cast<uint64_t>(members[i].value) - static_cast<uint64_t>(min_value)] = i;
+  } else {
+    // sorted by value, and by index among equal values so that the first member is found
+    EnumeratorT *values = result.sorted_values.data();
+    size_t *indices = result.sorted_indices.data();
+
+    for (size_t i = 0; i < size; ++i) {
+      values[i] = static_cast<EnumeratorT>(members[i].value);
+      indices[i] = i;
+    }
+
+    for (size_t i = 1; i < size; ++i) {
+      for (size_t j = i; j > 0 && values[j] < values[j - 1]; --j) {
+        std::swap(values[j], values[j - 1]);
+        std::swap(indices[j], indices[j - 1]);
+      }
+    }
+  }
+
+  return result;
+}
+
+template<typename EnumT, typename MetaT, typename LookupT>
+constexpr std::string_view ValueToString(const MetaT &a_meta, const LookupT &a_lookup, EnumT a_value)
+{
+  const size_t index = a_lookup.IndexOfValue(a_value);
+  if (index < a_meta.members.size()) return a_meta.members[index].name;
+  return std::string_view("__INVALID_ENUM_VAL__");
 }
 
-#define meta_enum(Type, EnumeratorT, ...)\
-  enum Type: EnumeratorT { __VA_ARGS__};\
+template<typename EnumT, typename MetaT, typename LookupT>
+constexpr std::optional<MetaEnumMember<EnumT>> MemberFromName(const MetaT &a_meta, const LookupT &a_lookup, std::string_view a_name)
+{
+  const size_t index = a_lookup.IndexOfName(a_name);
+  if (index < a_meta.members.size()) return a_meta.members[index];
+  return std::nullopt;
+}
+
+template<typename EnumT, typename MetaT, typename LookupT>
+constexpr std::optional<MetaEnumMember<EnumT>> MemberFromValue(const MetaT &a_meta, const LookupT &a_lookup, EnumT a_value)
+{
+  const size_t index = a_lookup.IndexOfValue(a_value);
+  if (index < a_meta.members.size()) return a_meta.members[index];
+  return std::nullopt;
+}
+
+template<typename EnumT, typename MetaT>
+constexpr std::optional<MetaEnumMember<EnumT>> MemberFromIndex(const MetaT &a_meta, size_t a_index)
+{
+  std::optional<MetaEnumMember<EnumT>> result;
+  if (a_index < a_meta.members.size()) result = a_meta.members[a_index];
+  return result;
+}
+
+// the names of the set bits joined by '|', in the order of the bits; a bit without a member is
+// given by its value, and no bits by the name of a zero member if there is one
+template<typename EnumT, typename MetaT, typename LookupT>
+std::string FlagsToString(const MetaT &a_meta, const LookupT &a_lookup, EnumT a_flags)
+{
+  using BitsT = std::make_unsigned_t<std::underlying_type_t<EnumT>>;
+  auto bits = static_cast<BitsT>(a_flags);
+
+  std::string result;
+  if (bits == 0) {
+    const size_t index = a_lookup.IndexOfValue(a_flags);
+    if (index < a_meta.members.size()) result = a_meta.members[index].name;
+    return result;
+  }
+
+  for (; bits != 0; bits &= bits - 1) {
+    const auto bit = static_cast<BitsT>(BitsT{1} << std::countr_zero(bits));
+    const size_t index = a_lookup.IndexOfValue(static_cast<EnumT>(bit));
+
+    if (!result.empty()) result.push_back('|');
+    if (index < a_meta.members.size())
+      result.append(a_meta.members[index].name);
+    else
+      result.append(std::to_string(bit));
+  }
+
+  return result;
+}
+
+// the union of the members named in a text like "bus|car|hov", spaces around names allowed,
+// or nullopt if a name is not a member; an empty text has no bits set
+template<typename EnumT, typename MetaT, typename LookupT>
+constexpr std::optional<EnumT> FlagsFromString(const MetaT &a_meta, const LookupT &a_lookup, std::string_view a_text)
+{
+  using BitsT = std::make_unsigned_t<std::underlying_type_t<EnumT>>;
+  BitsT bits = 0;
+
+  auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+  while (!a_text.empty() && is_space(a_text.front())) a_text.remove_prefix(1);
+  while (!a_text.empty() && is_space(a_text.back())) a_text.remove_suffix(1);
+  if (a_text.empty()) return EnumT{};
+
+  while (true) {
+    const size_t separator = a_text.find('|');
+    auto name = a_text.substr(0, separator);
+    while (!name.empty() && is_space(name.front())) name.remove_prefix(1);
+    while (!name.empty() && is_space(name.back())) name.remove_suffix(1);
+
+    const size_t index = a_lookup.IndexOfName(name);
+    if (index >= a_meta.members.size()) return std::nullopt;
+    bits |= static_cast<BitsT>(a_meta.members[index].value);
+
+    if (separator == std::string_view::npos) break;
+    a_text.remove_prefix(separator + 1);
+  }
+
+  return static_cast<EnumT>(bits);
+}
+}
+
+// one value per member of an enum, stored in place and indexed through the value lookup table,
+// see Type##_containers; members sharing a value share the slot of the first of them
+template<const auto &Meta, const auto &Lookup, typename ValueT>
+struct MetaEnumArray
+{
+  using enum_t = decltype(std::remove_cvref_t<decltype(Meta.members)>::value_type::value);
+  using value_type = ValueT;
+
+  std::array<ValueT, Meta.members.size()> values = {};
+
+  static constexpr size_t size() { return Meta.members.size(); }
+  static constexpr bool contains(enum_t a_key) { return Lookup.IndexOfValue(a_key) < size(); }
+  static constexpr enum_t key(size_t a_index) { return Meta.members[a_index].value; }
+
+  // the value of a member, which a_key must be
+  constexpr ValueT &operator[](enum_t a_key) { return values[Lookup.IndexOfValue(a_key)]; }
+  constexpr const ValueT &operator[](enum_t a_key) const { return values[Lookup.IndexOfValue(a_key)]; }
+
+  constexpr ValueT &at(enum_t a_key) { return values[CheckedIndex(a_key)]; }
+  constexpr const ValueT &at(enum_t a_key) const { return values[CheckedIndex(a_key)]; }
+
+  constexpr auto begin() { return values.begin(); }
+  constexpr auto begin() const { return values.begin(); }
+  constexpr auto end() { return values.end(); }
+  constexpr auto end() const { return values.end(); }
+
+  constexpr void fill(const ValueT &a_value) { values.fill(a_value); }
+
+  // calls a_func(key, value) for each member, in declaration order
+  template<typename FuncT>
+  constexpr void for_each(FuncT &&a_func)
+  {
+    for (size_t i = 0; i < size(); ++i) a_func(key(i), values[i]);
+  }
+
+  template<typename FuncT>
+  constexpr void for_each(FuncT &&a_func) const
+  {
+    for (size_t i = 0; i < size(); ++i) a_func(key(i), values[i]);
+  }
+
+  constexpr bool operator==(const MetaEnumArray &) const = default;
+
+private:
+  static constexpr size_t CheckedIndex(enum_t a_key)
+  {
+    const size_t index = Lookup.IndexOfValue(a_key);
+    if (index >= size()) throw std::out_of_range("MetaEnumArray: not a member of the enum");
+    return index;
+  }
+};
+
+// a map from the members of an enum to optional values, stored in place like MetaEnumArray:
+// no hashing and no allocation, see Type##_containers
+template<const auto &Meta, const auto &Lookup, typename ValueT>
+class MetaEnumMap
+{
+public:
+  using enum_t = typename MetaEnumArray<Meta, Lookup, ValueT>::enum_t;
+  using value_type = ValueT;
+
+  static constexpr size_t capacity() { return Meta.members.size(); }
+  constexpr size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+
+  constexpr bool contains(enum_t a_key) const { return find(a_key) != nullptr; }
+
+  // the value of the key, or nullptr if it has none or is not a member of the enum
+  constexpr ValueT *find(enum_t a_key)
+  {
+    const size_t index = Lookup.IndexOfValue(a_key);
+    return index < capacity() && slots_[index] ? &*slots_[index] : nullptr;
+  }
+
+  constexpr const ValueT *find(enum_t a_key) const
+  {
+    const size_t index = Lookup.IndexOfValue(a_key);
+    return index < capacity() && slots_[index] ? &*slots_[index] : nullptr;
+  }
+
+  // the value of the key, which must be a member, inserting a default one if it has none
+  constexpr ValueT &operator[](enum_t a_key) { return *try_emplace(a_key).first; }
+
+  constexpr ValueT &at(enum_t a_key)
+  {
+    if (ValueT *value = find(a_key)) return *value;
+    throw std::out_of_range("MetaEnumMap: no value for the key");
+  }
+
+  constexpr const ValueT &at(enum_t a_key) const
+  {
+    if (const ValueT *value = find(a_key)) return *value;
+    throw std::out_of_range("MetaEnumMap: no value for the key");
+  }
+
+  // constructs the value of a key without one, which must be a member
+  template<typename... ArgTs>
+  constexpr std::pair<ValueT *, bool> try_emplace(enum_t a_key, ArgTs &&...a_args)
+  {
+    auto &slot = slots_[Lookup.IndexOfValue(a_key)];
+    if (slot) return {&*slot, false};
+
+    slot.emplace(std::forward<ArgTs>(a_args)...);
+    ++size_;
+    return {&*slot, true};
+  }
+
+  template<typename ArgT>
+  constexpr std::pair<ValueT *, bool> insert_or_assign(enum_t a_key, ArgT &&a_value)
+  {
+    auto result = try_emplace(a_key, std::forward<ArgT>(a_value));
+    if (!result.second) *result.first = std::forward<ArgT>(a_value);
+    return result;
+  }
+
+  constexpr size_t erase(enum_t a_key)
+  {
+    const size_t index = Lookup.IndexOfValue(a_key);
+    if (index >= capacity() || !slots_[index]) return 0;
+
+    slots_[index].reset();
+    --size_;
+    return 1;
+  }
+
+  constexpr void clear()
+  {
+    for (auto &slot : slots_) slot.reset();
+    size_ = 0;
+  }
+
+  // calls a_func(key, value) for each key with a value, in declaration order
+  template<typename FuncT>
+  constexpr void for_each(FuncT &&a_func)
+  {
+    for (size_t i = 0; i < capacity(); ++i)
+      if (slots_[i]) a_func(Meta.members[i].value, *slots_[i]);
+  }
+
+  template<typename FuncT>
+  constexpr void for_each(FuncT &&a_func) const
+  {
+    for (size_t i = 0; i < capacity(); ++i)
+      if (slots_[i]) a_func(Meta.members[i].value, *slots_[i]);
+  }
+
+  constexpr bool operator==(const MetaEnumMap &) const = default;
+
+private:
+  std::array<std::optional<ValueT>, Meta.members.size()> slots_ = {};
+  size_t size_ = 0;
+};
+
+// the containers indexed by the members of one enum, given by Type##_containers
+template<const auto &Meta, const auto &Lookup>
+struct MetaEnumContainers
+{
+  template<typename ValueT>
+  using array = MetaEnumArray<Meta, Lookup, ValueT>;
+
+  template<typename ValueT>
+  using map = MetaEnumMap<Meta, Lookup, ValueT>;
+};
+
+namespace meta_enum_internal {
+
+// the names of the members in one contiguous blob, and the offset of each name in it, the name
+// of member i spanning offsets[i] to offsets[i + 1]
+template<typename EnumT, typename EnumeratorT, size_t size>
+constexpr std::array<uint32_t, size + 1> NameOffsets(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  std::array<uint32_t, size + 1> result{};
+  for (size_t i = 0; i < size; ++i) result[i + 1] = result[i] + static_cast<uint32_t>(a_meta.members[i].name.size());
+  return result;
+}
+
+template<size_t blob_size, typename EnumT, typename EnumeratorT, size_t size>
+constexpr std::array<char, blob_size> NameBlob(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  std::array<char, blob_size> result{};
+  size_t offset = 0;
+  for (const auto &member : a_meta.members)
+    for (const char c : member.name) result[offset++] = c;
+  return result;
+}
+
+// a name of at most 16 characters, zero padded to one aligned vector
+struct alignas(16) ShortName
+{
+  std::array<char, 16> chars = {};
+};
+
+// the names of at most 16 characters grouped by length, those of length n being names[first[n]]
+// to names[first[n + 1]], of the members indices[first[n]] to indices[first[n + 1]]
+template<size_t short_size>
+struct ShortNames
+{
+  std::array<size_t, 18> first = {};
+  std::array<ShortName, short_size> names = {};
+  std::array<size_t, short_size> indices = {};
+};
+
+template<typename EnumT, typename EnumeratorT, size_t size>
+constexpr size_t ShortNameCount(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  size_t count = 0;
+  for (const auto &member : a_meta.members) count += member.name.size() <= 16;
+  return count;
+}
+
+template<size_t short_size, typename EnumT, typename EnumeratorT, size_t size>
+constexpr ShortNames<short_size> GroupShortNames(const MetaEnum<EnumT, EnumeratorT, size> &a_meta)
+{
+  ShortNames<short_size> result;
+  for (const auto &member : a_meta.members)
+    if (member.name.size() <= 16) ++result.first[member.name.size() + 1];
+  for (size_t length = 1; length < result.first.size(); ++length) result.first[length] += result.first[length - 1];
+
+  auto next = result.first;
+  for (size_t i = 0; i < size; ++i) {
+    const auto name = a_meta.members[i].name;
+    if (name.size() > 16) continue;
+    const size_t slot = next[name.size()]++;
+    for (size_t c = 0; c < name.size(); ++c) result.names[slot].chars[c] = name[c];
+    result.indices[slot] = i;
+  }
+  return result;
+}
+
+// whether two zero padded names are equal, in one 16 byte compare
+inline bool IsSameShortName(const ShortName &a_left, const ShortName &a_right)
+{
+#if defined(META_ENUM_HAS_SSE2)
+  const auto left = _mm_load_si128(reinterpret_cast<const __m128i *>(a_left.chars.data()));
+  const auto right = _mm_load_si128(reinterpret_cast<const __m128i *>(a_right.chars.data()));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(left, right)) == 0xffff;
+#elif defined(META_ENUM_HAS_NEON)
+  const auto left = vld1q_u8(reinterpret_cast<const uint8_t *>(a_left.chars.data()));
+  const auto right = vld1q_u8(reinterpret_cast<const uint8_t *>(a_right.chars.data()));
+  return vminvq_u8(vceqq_u8(left, right)) == 0xff;
+#else
+  return a_left.chars == a_right.chars;
+#endif
+}
+}
+
+// conversions of the members of an enum to and from their dense indices, in declaration order,
+// and their names, given by Type##_codec: binary formats write the index, in index_type, which
+// is 1 byte for enums of less than 256 members, and text formats copy the name from one blob.
+// The index of a value which is not a member is size(), which from_index() rejects
+template<const auto &Meta, const auto &Lookup>
+struct MetaEnumCodec
+{
+  using enum_t = decltype(std::remove_cvref_t<decltype(Meta.members)>::value_type::value);
+  using index_type = std::conditional_t<(Meta.members.size() < 0x100), uint8_t,
+                                        std::conditional_t<(Meta.members.size() < 0x10000), uint16_t, uint32_t>>;
+
+  static constexpr auto offsets = meta_enum_internal::NameOffsets(Meta);
+  static constexpr auto blob = meta_enum_internal::NameBlob<offsets.back()>(Meta);
+  static constexpr auto short_names = meta_enum_internal::GroupShortNames<meta_enum_internal::ShortNameCount(Meta)>(Meta);
+
+  static constexpr size_t size() { return Meta.members.size(); }
+
+  static constexpr size_t index_of(enum_t a_value) { return Lookup.IndexOfValue(a_value); }
+  static constexpr size_t index_of_name(std::string_view a_name) { return Lookup.IndexOfName(a_name); }
+
+  static constexpr std::optional<enum_t> from_index(size_t a_index)
+  {
+    if (a_index < size()) return Meta.members[a_index].value;
+    return std::nullopt;
+  }
+
+  static constexpr std::string_view name(size_t a_index)
+  {
+    return {blob.data() + offsets[a_index], offsets[a_index + 1] - offsets[a_index]};
+  }
+
+  // the member of the name, or false and a value initialized one
+  static constexpr bool parse(std::string_view a_name, enum_t &a_value)
+  {
+    const size_t index = index_of_name(a_name);
+    a_value = index < size() ? Meta.members[index].value : enum_t{};
+    return index < size();
+  }
+
+  // the members of a column of names, as Type##_parse_batch: a name of at most 16 characters is
+  // padded to one vector and compared only to the names of its length, 16 bytes at a time, and
+  // longer ones are hashed. Values which are not names are value initialized, and flagged by bit
+  // i % 64 of a_unknown[i / 64] if given, which takes at least one word per 64 names and whose
+  // bits of names are otherwise cleared. Returns the count of such values
+  static size_t parse_batch(std::span<const std::string_view> a_names, std::span<enum_t> a_values,
+                            std::span<uint64_t> a_unknown = {})
+  {
+    const size_t count = std::min(a_names.size(), a_values.size());
+    const bool is_masked = a_unknown.size() * 64 >= count;
+    if (is_masked) std::fill_n(a_unknown.begin(), (count + 63) / 64, uint64_t{0});
+
+    size_t unknown_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const std::string_view name = a_names[i];
+      size_t index = size();
+
+      if (name.size() <= 16) {
+        meta_enum_internal::ShortName padded;
+        std::copy_n(name.data(), name.size(), padded.chars.data());
+        for (size_t slot = short_names.first[name.size()]; slot < short_names.first[name.size() + 1]; ++slot) {
+          if (meta_enum_internal::IsSameShortName(padded, short_names.names[slot])) {
+            index = short_names.indices[slot];
+            break;
+          }
+        }
+      } else {
+        index = index_of_name(name);
+      }
+
+      if (index < size()) {
+        a_values[i] = Meta.members[index].value;
+      } else {
+        a_values[i] = enum_t{};
+        ++unknown_count;
+        if (is_masked) a_unknown[i / 64] |= uint64_t{1} << (i % 64);
+      }
+    }
+    return unknown_count;
+  }
+
+  // appends the name of the value, or the number of one which is not a member
+  static void format(std::string &a_out, enum_t a_value)
+  {
+    const size_t index = index_of(a_value);
+    if (index < size())
+      a_out.append(blob.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    else
+      a_out.append(std::to_string(static_cast<std::underlying_type_t<enum_t>>(a_value)));
+  }
+};
+
+// the member count, without parsing the declaration
+#define meta_enum_internal_size(Type, EnumeratorT, ...)\
   constexpr static auto Type##_internal_size = []() constexpr {\
     using IntWrapperType = meta_enum_internal::IntWrapper<EnumeratorT>;\
     IntWrapperType __VA_ARGS__;\
     return std::initializer_list<IntWrapperType>{__VA_ARGS__}.size();\
-  };\
-  constexpr static auto Type##_meta = meta_enum_internal::ParseMetaEnum<\
+  }
+
+// the parsed declaration and its lookup tables, named Name and Type##_internal_lookup
+#define meta_enum_internal_meta(Name, Type, EnumeratorT, ...)\
+  constexpr static auto Name = meta_enum_internal::ParseMetaEnum<\
     Type, EnumeratorT, Type##_internal_size()>(#__VA_ARGS__, []() {\
     using IntWrapperType = meta_enum_internal::IntWrapper<EnumeratorT>;\
     IntWrapperType __VA_ARGS__;\
     return meta_enum_internal::ResolveEnumValuesArray<\
         Type, EnumeratorT, Type##_internal_size()>({__VA_ARGS__});\
   }());\
+  constexpr static auto Type##_internal_lookup = meta_enum_internal::BuildLookup<\
+    Type, EnumeratorT, Type##_internal_size(), meta_enum_internal::DenseSize(Name)>(Name)
+
+// definitions shared by meta_enum and meta_enum_class
+#define meta_enum_internal_definitions(Type, EnumeratorT, ...)\
+  meta_enum_internal_size(Type, EnumeratorT, __VA_ARGS__);\
+  meta_enum_internal_meta(Type##_meta, Type, EnumeratorT, __VA_ARGS__);\
   constexpr static auto Type##_value_to_string = [](Type e) {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.value == e)\
-        return member.name;\
-    }\
-    return std::string_view("__INVALID_ENUM_VAL__");\
-  \
+    return meta_enum_internal::ValueToString(Type##_meta, Type##_internal_lookup, e);\
   };\
-  constexpr static auto Type##_meta_from_name = \
-    [](std::string_view s)->std::optional<MetaEnumMember<Type>> {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.name == s)\
-        return member;\
-    }\
-    return std::nullopt;\
-  \
+  constexpr static auto Type##_meta_from_name = [](std::string_view s) {\
+    return meta_enum_internal::MemberFromName<Type>(Type##_meta, Type##_internal_lookup, s);\
   };\
-  constexpr static auto Type##_meta_from_value = \
-    [](Type v)->std::optional<MetaEnumMember<Type>> {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.value == v)\
-        return member;\
-    }\
-    return std::nullopt;\
-  \
+  constexpr static auto Type##_meta_from_value = [](Type v) {\
+    return meta_enum_internal::MemberFromValue(Type##_meta, Type##_internal_lookup, v);\
   };\
   constexpr static auto Type##_meta_from_index = [](size_t i) {\
-    std::optional<MetaEnumMember<Type>> result;\
-    if(i < Type##_meta.members.size())\
-      result = Type##_meta.members[i];\
-    return result;\
-  \
+    return meta_enum_internal::MemberFromIndex<Type>(Type##_meta, i);\
+  };\
+  using Type##_containers = MetaEnumContainers<Type##_meta, Type##_internal_lookup>;\
+  using Type##_codec = MetaEnumCodec<Type##_meta, Type##_internal_lookup>;\
+  [[maybe_unused]] constexpr static auto Type##_parse_batch = [](std::span<const std::string_view> a_names,\
+      std::span<Type> a_values, std::span<uint64_t> a_unknown = {}) {\
+    return Type##_codec::parse_batch(a_names, a_values, a_unknown);\
   }
 
-#define meta_enum_class(Type, EnumeratorT, ...)\
-  enum class Type: EnumeratorT { __VA_ARGS__};\
-  constexpr static auto Type##_internal_size = []() constexpr {\
-    using IntWrapperType = meta_enum_internal::IntWrapper<EnumeratorT>;\
-    IntWrapperType __VA_ARGS__;\
-    return std::initializer_list<IntWrapperType>{__VA_ARGS__}.size();\
+// declarations shared by meta_enum_extern and meta_enum_class_extern
+#define meta_enum_internal_declarations(Type, EnumeratorT, ...)\
+  meta_enum_internal_size(Type, EnumeratorT, __VA_ARGS__);\
+  extern const MetaEnum<Type, EnumeratorT, Type##_internal_size()> Type##_meta;\
+  std::string_view Type##_value_to_string(Type e);\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_name(std::string_view s);\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_value(Type v);\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_index(size_t i)
+
+// bitmask operators and conversions of a flag set, see meta_enum_flags
+#define meta_enum_internal_flags(Type)\
+  [[maybe_unused]] constexpr Type operator|(Type a_lhs, Type a_rhs) noexcept {\
+    using BitsT = std::underlying_type_t<Type>;\
+    return static_cast<Type>(static_cast<BitsT>(a_lhs) | static_cast<BitsT>(a_rhs));\
+  }\
+  [[maybe_unused]] constexpr Type operator&(Type a_lhs, Type a_rhs) noexcept {\
+    using BitsT = std::underlying_type_t<Type>;\
+    return static_cast<Type>(static_cast<BitsT>(a_lhs) & static_cast<BitsT>(a_rhs));\
+  }\
+  [[maybe_unused]] constexpr Type operator^(Type a_lhs, Type a_rhs) noexcept {\
+    using BitsT = std::underlying_type_t<Type>;\
+    return static_cast<Type>(static_cast<BitsT>(a_lhs) ^ static_cast<BitsT>(a_rhs));\
+  }\
+  [[maybe_unused]] constexpr Type operator~(Type a_flags) noexcept {\
+    using BitsT = std::underlying_type_t<Type>;\
+    return static_cast<Type>(static_cast<BitsT>(~static_cast<BitsT>(a_flags)));\
+  }\
+  [[maybe_unused]] constexpr Type &operator|=(Type &a_lhs, Type a_rhs) noexcept { return a_lhs = a_lhs | a_rhs; }\
+  [[maybe_unused]] constexpr Type &operator&=(Type &a_lhs, Type a_rhs) noexcept { return a_lhs = a_lhs & a_rhs; }\
+  [[maybe_unused]] constexpr Type &operator^=(Type &a_lhs, Type a_rhs) noexcept { return a_lhs = a_lhs ^ a_rhs; }\
+  constexpr static auto Type##_all_flags = []() constexpr {\
+    Type result{};\
+    for (const auto &member : Type##_meta.members) result |= member.value;\
+    return result;\
+  }();\
+  constexpr static auto Type##_has_flags = [](Type a_flags, Type a_mask) constexpr {\
+    return (a_flags & a_mask) == a_mask;\
   };\
-  constexpr static auto Type##_meta = meta_enum_internal::ParseMetaEnum<\
-    Type, EnumeratorT, Type##_internal_size()>(#__VA_ARGS__, []() {\
-    using IntWrapperType = meta_enum_internal::IntWrapper<EnumeratorT>;\
-    IntWrapperType __VA_ARGS__;\
-    return meta_enum_internal::ResolveEnumValuesArray<\
-        Type, EnumeratorT, Type##_internal_size()>({__VA_ARGS__});\
-  }());\
-  constexpr static auto Type##_value_to_string = [](Type e) {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.value == e)\
-        return member.name;\
-    }\
-    return std::string_view("__INVALID_ENUM_VAL__");\
-  \
+  constexpr static auto Type##_flags_to_string = [](Type a_flags) {\
+    return meta_enum_internal::FlagsToString(Type##_meta, Type##_internal_lookup, a_flags);\
   };\
-  constexpr static auto Type##_meta_from_name = \
-    [](std::string_view s)->std::optional<MetaEnumMember<Type>> {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.name == s)\
-        return member;\
-    }\
-    return std::nullopt;\
-  \
+  constexpr static auto Type##_flags_from_string = [](std::string_view a_text) {\
+    return meta_enum_internal::FlagsFromString<Type>(Type##_meta, Type##_internal_lookup, a_text);\
   };\
-  constexpr static auto Type##_meta_from_value = \
-    [](Type v)->std::optional<MetaEnumMember<Type>> {\
-    for(const auto& member: Type##_meta.members) {\
-      if(member.value == v)\
-        return member;\
+  /* conversions of a mio::csv::CsvField and CsvWriter, found by argument dependent lookup */\
+  [[maybe_unused]] inline bool parse_field(std::string_view a_text, Type &a_value) {\
+    while (!a_text.empty() && a_text.front() == ' ') a_text.remove_prefix(1);\
+    while (!a_text.empty() && a_text.back() == ' ') a_text.remove_suffix(1);\
+    if (a_text.size() >= 2 && a_text.front() == '"' && a_text.back() == '"') a_text = a_text.substr(1, a_text.size() - 2);\
+    const auto flags = Type##_flags_from_string(a_text);\
+    a_value = flags.value_or(Type{});\
+    return flags.has_value();\
+  }\
+  [[maybe_unused]] inline void format_field(std::string &a_out, const Type &a_value) {\
+    a_out.append(Type##_flags_to_string(a_value));\
+  }\
+  static_assert(true)
+
+// the conversions of the enum found by argument dependent lookup, at namespace scope only as it
+// defines functions: parse_field and format_field of a mio::csv::CsvField and CsvWriter, by
+// name, enum_codec_of, which msgpack packs the members by, as their index, and serialize, which
+// zpp_bits does, as their index_type; the payloads then no longer depend on the values
+#define meta_enum_codec(Type)\
+  [[maybe_unused]] constexpr Type##_codec enum_codec_of(Type) noexcept { return {}; }\
+  [[maybe_unused]] inline bool parse_field(std::string_view a_text, Type &a_value) {\
+    while (!a_text.empty() && a_text.front() == ' ') a_text.remove_prefix(1);\
+    while (!a_text.empty() && a_text.back() == ' ') a_text.remove_suffix(1);\
+    if (a_text.size() >= 2 && a_text.front() == '"' && a_text.back() == '"') a_text = a_text.substr(1, a_text.size() - 2);\
+    return Type##_codec::parse(a_text, a_value);\
+  }\
+  [[maybe_unused]] inline void format_field(std::string &a_out, const Type &a_value) {\
+    Type##_codec::format(a_out, a_value);\
+  }\
+  template<typename ArchiveT, typename SelfT>\
+  requires std::is_same_v<std::remove_const_t<SelfT>, Type>\
+  constexpr auto serialize(ArchiveT &a_archive, SelfT &a_value) {\
+    using index_type = typename Type##_codec::index_type;\
+    if constexpr (requires { requires ArchiveT::kind() == decltype(ArchiveT::kind())::out; }) {\
+      return a_archive(static_cast<index_type>(Type##_codec::index_of(a_value)));\
+    } else {\
+      index_type index{};\
+      auto result = a_archive(index);\
+      if (failure(result)) return result;\
+      const auto value = Type##_codec::from_index(index);\
+      if (!value) return decltype(result){std::errc::invalid_argument};\
+      a_value = *value;\
+      return result;\
     }\
-    return std::nullopt;\
-  \
-  };\
-  constexpr static auto Type##_meta_from_index = [](size_t i) {\
-    std::optional<MetaEnumMember<Type>> result;\
-    if(i < Type##_meta.members.size())\
-      result = Type##_meta.members[i];\
-    return result;\
-  \
-  }
+  }\
+  static_assert(true)
+
+#define meta_enum(Type, EnumeratorT, ...)\
+  enum Type: EnumeratorT { __VA_ARGS__};\
+  meta_enum_internal_definitions(Type, EnumeratorT, __VA_ARGS__)
+
+#define meta_enum_class(Type, EnumeratorT, ...)\
+  enum class Type: EnumeratorT { __VA_ARGS__};\
+  meta_enum_internal_definitions(Type, EnumeratorT, __VA_ARGS__)
+
+// an enum class of bit flags, at namespace scope only as it defines operators: on top of the
+// functions of meta_enum_class, the bitmask operators, Type##_all_flags, Type##_has_flags,
+// Type##_flags_to_string and Type##_flags_from_string, and parse_field and format_field for csv
+#define meta_enum_flags(Type, EnumeratorT, ...)\
+  meta_enum_class(Type, EnumeratorT, __VA_ARGS__);\
+  meta_enum_internal_flags(Type)
+
+// like meta_enum and meta_enum_class, for a header of a namespace-scope enum whose metadata is
+// parsed in one translation unit only, the one with meta_enum_instantiate; the members then are
+// best given by a macro, so that the two lists cannot diverge
+#define meta_enum_extern(Type, EnumeratorT, ...)\
+  enum Type: EnumeratorT { __VA_ARGS__};\
+  meta_enum_internal_declarations(Type, EnumeratorT, __VA_ARGS__)
+
+#define meta_enum_class_extern(Type, EnumeratorT, ...)\
+  enum class Type: EnumeratorT { __VA_ARGS__};\
+  meta_enum_internal_declarations(Type, EnumeratorT, __VA_ARGS__)
+
+#define meta_enum_instantiate(Type, EnumeratorT, ...)\
+  meta_enum_internal_meta(Type##_internal_meta, Type, EnumeratorT, __VA_ARGS__);\
+  const MetaEnum<Type, EnumeratorT, Type##_internal_size()> Type##_meta = Type##_internal_meta;\
+  std::string_view Type##_value_to_string(Type e) {\
+    return meta_enum_internal::ValueToString(Type##_internal_meta, Type##_internal_lookup, e);\
+  }\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_name(std::string_view s) {\
+    return meta_enum_internal::MemberFromName<Type>(Type##_internal_meta, Type##_internal_lookup, s);\
+  }\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_value(Type v) {\
+    return meta_enum_internal::MemberFromValue(Type##_internal_meta, Type##_internal_lookup, v);\
+  }\
+  std::optional<MetaEnumMember<Type>> Type##_meta_from_index(size_t i) {\
+    return meta_enum_internal::MemberFromIndex<Type>(Type##_internal_meta, i);\
+  }\
+  static_assert(true)
+
+#undef META_ENUM_HAS_SSE2
+#undef META_ENUM_HAS_NEON
 
 #endif
@@ -0,0 +1,109 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Compile-time benchmark of meta_enum: a translation unit holding nothing but enums of the
+// size of our signal-phase tables. Time the build of this target to track the cost of the
+// constexpr parsing, e.g.
+//
+//   cmake --build . --target meta_enum_compile_benchmark  (after touching this file)
+
+#include <meta_enum/meta_enum.hpp>
+
+meta_enum_class(
+    SignalPhase,
+    int,
+    Phase000, Phase001, Phase002, Phase003, Phase004, Phase005, Phase006, Phase007, Phase008, Phase009,
+    Phase010, Phase011, Phase012, Phase013, Phase014, Phase015, Phase016, Phase017, Phase018, Phase019,
+    Phase020, Phase021, Phase022, Phase023, Phase024, Phase025, Phase026, Phase027, Phase028, Phase029,
+    Phase030, Phase031, Phase032, Phase033, Phase034, Phase035, Phase036, Phase037, Phase038, Phase039,
+    Phase040, Phase041, Phase042, Phase043, Phase044, Phase045, Phase046, Phase047, Phase048, Phase049,
+    Phase050, Phase051, Phase052, Phase053, Phase054, Phase055, Phase056, Phase057, Phase058, Phase059,
+    Phase060, Phase061, Phase062, Phase063, Phase064, Phase065, Phase066, Phase067, Phase068, Phase069,
+    Phase070, Phase071, Phase072, Phase073, Phase074, Phase075, Phase076, Phase077, Phase078, Phase079,
+    Phase080, Phase081, Phase082, Phase083, Phase084, Phase085, Phase086, Phase087, Phase088, Phase089,
+    Phase090, Phase091, Phase092, Phase093, Phase094, Phase095, Phase096, Phase097, Phase098, Phase099,
+    Phase100, Phase101, Phase102, Phase103, Phase104, Phase105, Phase106, Phase107, Phase108, Phase109,
+    Phase110, Phase111, Phase112, Phase113, Phase114, Phase115, Phase116, Phase117, Phase118, Phase119,
+    Phase120, Phase121, Phase122, Phase123, Phase124, Phase125, Phase126, Phase127, Phase128, Phase129,
+    Phase130, Phase131, Phase132, Phase133, Phase134, Phase135, Phase136, Phase137, Phase138, Phase139,
+    Phase140, Phase141, Phase142, Phase143, Phase144, Phase145, Phase146, Phase147, Phase148, Phase149,
+    Phase150, Phase151, Phase152, Phase153, Phase154, Phase155, Phase156, Phase157, Phase158, Phase159,
+    Phase160, Phase161, Phase162, Phase163, Phase164, Phase165, Phase166, Phase167, Phase168, Phase169,
+    Phase170, Phase171, Phase172, Phase173, Phase174, Phase175, Phase176, Phase177, Phase178, Phase179,
+    Phase180, Phase181, Phase182, Phase183, Phase184, Phase185, Phase186, Phase187, Phase188, Phase189,
+    Phase190, Phase191, Phase192, Phase193, Phase194, Phase195, Phase196, Phase197, Phase198, Phase199,
+    Phase200, Phase201, Phase202, Phase203, Phase204, Phase205, Phase206, Phase207, Phase208, Phase209,
+    Phase210, Phase211, Phase212, Phase213, Phase214, Phase215, Phase216, Phase217, Phase218, Phase219,
+    Phase220, Phase221, Phase222, Phase223, Phase224, Phase225, Phase226, Phase227, Phase228, Phase229,
+    Phase230, Phase231, Phase232, Phase233, Phase234, Phase235, Phase236, Phase237, Phase238, Phase239,
+    Phase240, Phase241, Phase242, Phase243, Phase244, Phase245, Phase246, Phase247, Phase248, Phase249,
+    Phase250, Phase251, Phase252, Phase253, Phase254, Phase255, Phase256, Phase257, Phase258, Phase259,
+    Phase260, Phase261, Phase262, Phase263, Phase264, Phase265, Phase266, Phase267, Phase268, Phase269,
+    Phase270, Phase271, Phase272, Phase273, Phase274, Phase275, Phase276, Phase277, Phase278, Phase279,
+    Phase280, Phase281, Phase282, Phase283, Phase284, Phase285, Phase286, Phase287, Phase288, Phase289,
+    Phase290, Phase291, Phase292, Phase293, Phase294, Phase295, Phase296, Phase297, Phase298, Phase299,
+    Phase300, Phase301, Phase302, Phase303, Phase304, Phase305, Phase306, Phase307, Phase308, Phase309,
+    Phase310, Phase311, Phase312, Phase313, Phase314, Phase315, Phase316, Phase317, Phase318, Phase319,
+    Phase320, Phase321, Phase322, Phase323, Phase324, Phase325, Phase326, Phase327, Phase328, Phase329,
+    Phase330, Phase331, Phase332, Phase333, Phase334, Phase335, Phase336, Phase337, Phase338, Phase339,
+    Phase340, Phase341, Phase342, Phase343, Phase344, Phase345, Phase346, Phase347, Phase348, Phase349,
+    Phase350, Phase351, Phase352, Phase353, Phase354, Phase355, Phase356, Phase357, Phase358, Phase359,
+    Phase360, Phase361, Phase362, Phase363, Phase364, Phase365, Phase366, Phase367, Phase368, Phase369,
+    Phase370, Phase371, Phase372, Phase373, Phase374, Phase375, Phase376, Phase377, Phase378, Phase379,
+    Phase380, Phase381, Phase382, Phase383, Phase384, Phase385, Phase386, Phase387, Phase388, Phase389,
+    Phase390, Phase391, Phase392, Phase393, Phase394, Phase395, Phase396, Phase397, Phase398, Phase399);
+
+static_assert(SignalPhase_meta.members.size() == 400);
+static_assert(SignalPhase_meta.members[399].name == "Phase399");
+static_assert(SignalPhase_value_to_string(SignalPhase::Phase123) == "Phase123");
+static_assert(SignalPhase_meta_from_name("Phase321")->index == 321);
+
+meta_enum(
+    SparsePhase,
+    int,
+    SparseFirst = -1000,
+    SparsePhase000, SparsePhase001, SparsePhase002, SparsePhase003, SparsePhase004, SparsePhase005, SparsePhase006, SparsePhase007, SparsePhase008, SparsePhase009,
+    SparsePhase010, SparsePhase011, SparsePhase012, SparsePhase013, SparsePhase014, SparsePhase015, SparsePhase016, SparsePhase017, SparsePhase018, SparsePhase019,
+    SparsePhase020, SparsePhase021, SparsePhase022, SparsePhase023, SparsePhase024, SparsePhase025, SparsePhase026, SparsePhase027, SparsePhase028, SparsePhase029,
+    SparsePhase030, SparsePhase031, SparsePhase032, SparsePhase033, SparsePhase034, SparsePhase035, SparsePhase036, SparsePhase037, SparsePhase038, SparsePhase039,
+    SparsePhase040, SparsePhase041, SparsePhase042, SparsePhase043, SparsePhase044, SparsePhase045, SparsePhase046, SparsePhase047, SparsePhase048, SparsePhase049,
+    SparsePhase050, SparsePhase051, SparsePhase052, SparsePhase053, SparsePhase054, SparsePhase055, SparsePhase056, SparsePhase057, SparsePhase058, SparsePhase059,
+    SparsePhase060, SparsePhase061, SparsePhase062, SparsePhase063, SparsePhase064, SparsePhase065, SparsePhase066, SparsePhase067, SparsePhase068, SparsePhase069,
+    SparsePhase070, SparsePhase071, SparsePhase072, SparsePhase073, SparsePhase074, SparsePhase075, SparsePhase076, SparsePhase077, SparsePhase078, SparsePhase079,
+    SparsePhase080, SparsePhase081, SparsePhase082, SparsePhase083, SparsePhase084, SparsePhase085, SparsePhase086, SparsePhase087, SparsePhase088, SparsePhase089,
+    SparsePhase090, SparsePhase091, SparsePhase092, SparsePhase093, SparsePhase094, SparsePhase095, SparsePhase096, SparsePhase097, SparsePhase098, SparsePhase099,
+    SparsePhase100, SparsePhase101, SparsePhase102, SparsePhase103, SparsePhase104, SparsePhase105, SparsePhase106, SparsePhase107, SparsePhase108, SparsePhase109,
+    SparsePhase110, SparsePhase111, SparsePhase112, SparsePhase113, SparsePhase114, SparsePhase115, SparsePhase116, SparsePhase117, SparsePhase118, SparsePhase119,
+    SparsePhase120, SparsePhase121, SparsePhase122, SparsePhase123, SparsePhase124, SparsePhase125, SparsePhase126, SparsePhase127, SparsePhase128, SparsePhase129,
+    SparsePhase130, SparsePhase131, SparsePhase132, SparsePhase133, SparsePhase134, SparsePhase135, SparsePhase136, SparsePhase137, SparsePhase138, SparsePhase139,
+    SparsePhase140, SparsePhase141, SparsePhase142, SparsePhase143, SparsePhase144, SparsePhase145, SparsePhase146, SparsePhase147, SparsePhase148, SparsePhase149,
+    SparsePhase150, SparsePhase151, SparsePhase152, SparsePhase153, SparsePhase154, SparsePhase155, SparsePhase156, SparsePhase157, SparsePhase158, SparsePhase159,
+    SparsePhase160, SparsePhase161, SparsePhase162, SparsePhase163, SparsePhase164, SparsePhase165, SparsePhase166, SparsePhase167, SparsePhase168, SparsePhase169,
+    SparsePhase170, SparsePhase171, SparsePhase172, SparsePhase173, SparsePhase174, SparsePhase175, SparsePhase176, SparsePhase177, SparsePhase178, SparsePhase179,
+    SparsePhase180, SparsePhase181, SparsePhase182, SparsePhase183, SparsePhase184, SparsePhase185, SparsePhase186, SparsePhase187, SparsePhase188, SparsePhase189,
+    SparsePhase190, SparsePhase191, SparsePhase192, SparsePhase193, SparsePhase194, SparsePhase195, SparsePhase196, SparsePhase197, SparsePhase198, SparsePhase199,
+    SparsePhase200, SparsePhase201, SparsePhase202, SparsePhase203, SparsePhase204, SparsePhase205, SparsePhase206, SparsePhase207, SparsePhase208, SparsePhase209,
+    SparsePhase210, SparsePhase211, SparsePhase212, SparsePhase213, SparsePhase214, SparsePhase215, SparsePhase216, SparsePhase217, SparsePhase218, SparsePhase219,
+    SparsePhase220, SparsePhase221, SparsePhase222, SparsePhase223, SparsePhase224, SparsePhase225, SparsePhase226, SparsePhase227, SparsePhase228, SparsePhase229,
+    SparsePhase230, SparsePhase231, SparsePhase232, SparsePhase233, SparsePhase234, SparsePhase235, SparsePhase236, SparsePhase237, SparsePhase238, SparsePhase239,
+    SparsePhase240, SparsePhase241, SparsePhase242, SparsePhase243, SparsePhase244, SparsePhase245, SparsePhase246, SparsePhase247, SparsePhase248, SparsePhase249,
+    SparsePhase250, SparsePhase251, SparsePhase252, SparsePhase253, SparsePhase254, SparsePhase255, SparsePhase256, SparsePhase257, SparsePhase258, SparsePhase259,
+    SparsePhase260, SparsePhase261, SparsePhase262, SparsePhase263, SparsePhase264, SparsePhase265, SparsePhase266, SparsePhase267, SparsePhase268, SparsePhase269,
+    SparsePhase270, SparsePhase271, SparsePhase272, SparsePhase273, SparsePhase274, SparsePhase275, SparsePhase276, SparsePhase277, SparsePhase278, SparsePhase279,
+    SparsePhase280, SparsePhase281, SparsePhase282, SparsePhase283, SparsePhase284, SparsePhase285, SparsePhase286, SparsePhase287, SparsePhase288, SparsePhase289,
+    SparsePhase290, SparsePhase291, SparsePhase292, SparsePhase293, SparsePhase294, SparsePhase295, SparsePhase296, SparsePhase297, SparsePhase298, SparsePhase299,
+    SparsePhase300, SparsePhase301, SparsePhase302, SparsePhase303, SparsePhase304, SparsePhase305, SparsePhase306, SparsePhase307, SparsePhase308, SparsePhase309,
+    SparsePhase310, SparsePhase311, SparsePhase312, SparsePhase313, SparsePhase314, SparsePhase315, SparsePhase316, SparsePhase317, SparsePhase318, SparsePhase319,
+    SparsePhase320, SparsePhase321, SparsePhase322, SparsePhase323, SparsePhase324, SparsePhase325, SparsePhase326, SparsePhase327, SparsePhase328, SparsePhase329,
+    SparsePhase330, SparsePhase331, SparsePhase332, SparsePhase333, SparsePhase334, SparsePhase335, SparsePhase336, SparsePhase337, SparsePhase338, SparsePhase339,
+    SparsePhase340, SparsePhase341, SparsePhase342, SparsePhase343, SparsePhase344, SparsePhase345, SparsePhase346, SparsePhase347, SparsePhase348, SparsePhase349,
+    SparsePhase350, SparsePhase351, SparsePhase352, SparsePhase353, SparsePhase354, SparsePhase355, SparsePhase356, SparsePhase357, SparsePhase358, SparsePhase359,
+    SparsePhase360, SparsePhase361, SparsePhase362, SparsePhase363, SparsePhase364, SparsePhase365, SparsePhase366, SparsePhase367, SparsePhase368, SparsePhase369,
+    SparsePhase370, SparsePhase371, SparsePhase372, SparsePhase373, SparsePhase374, SparsePhase375, SparsePhase376, SparsePhase377, SparsePhase378, SparsePhase379,
+    SparsePhase380, SparsePhase381, SparsePhase382, SparsePhase383, SparsePhase384, SparsePhase385, SparsePhase386, SparsePhase387, SparsePhase388, SparsePhase389,
+    SparsePhase390, SparsePhase391, SparsePhase392, SparsePhase393, SparsePhase394, SparsePhase395, SparsePhase396, SparsePhase397, SparsePhase398, SparsePhase399);
+
+static_assert(SparsePhase_meta.members.size() == 401);
+static_assert(SparsePhase_meta_from_value(SparsePhase399)->index == 400);
@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <meta_enum/meta_enum.hpp>
+#include <zpp_bits/zpp_bits.h>
 
 // helpers
 constexpr int sum(int a, int b, int c)
@@ -84,6 +85,112 @@ static_assert(Complex_meta.members[1].index == 1);
 static_assert(Complex_meta.members[2].index == 2);
 static_assert(Complex_meta.members[3].index == 3);
 
+// Lookups by value and by name go through tables built at compile time, a dense one
+// for values spanning a small range and a sorted one for sparse values
+meta_enum_class(
+    Sparse,
+    int,
+    Low = -1000000,
+    Zero = 0,
+    Alias = 0,
+    High = 1000000);
+
+static_assert(Complex_value_to_string(Fourth) == "Fourth");
+static_assert(Complex_value_to_string(static_cast<Complex>(2)) == "__INVALID_ENUM_VAL__");
+static_assert(Complex_meta_from_name("Third")->value == Third);
+static_assert(!Complex_meta_from_name("Fifth").has_value());
+static_assert(!Complex_meta_from_name("").has_value());
+
+static_assert(Global_value_to_string(GlobalD) == "GlobalD");
+static_assert(Global_meta_from_value(GlobalC)->index == 2);
+static_assert(!Global_meta_from_value(static_cast<Global>(99)).has_value());
+
+static_assert(Sparse_value_to_string(Sparse::High) == "High");
+static_assert(Sparse_value_to_string(Sparse::Low) == "Low");
+static_assert(Sparse_value_to_string(Sparse::Alias) == "Zero");
+static_assert(Sparse_meta_from_name("Alias")->index == 2);
+static_assert(!Sparse_meta_from_value(static_cast<Sparse>(1)).has_value());
+
+static_assert(GlobalClass_meta_from_value(GlobalClass::GlobalClassC)->name == "GlobalClassC");
+static_assert(!GlobalClass_meta_from_value(static_cast<GlobalClass>(255)).has_value());
+static_assert(Nester::NestedClass_meta_from_name("NestedClassB")->value == Nester::NestedClass::NestedClassB);
+
+// Flag sets get bitmask operators and conversions from and to "bus|car|hov"
+meta_enum_flags(
+    LaneModes,
+    uint16_t,
+    NoModes = 0,
+    Bus = 1 << 0,
+    Car = 1 << 1,
+    Hov = 1 << 2,
+    Truck = 1 << 3,
+    Bike = 1 << 15);
+
+static_assert((LaneModes::Bus | LaneModes::Hov) == static_cast<LaneModes>(5));
+static_assert(((LaneModes::Bus | LaneModes::Car) & LaneModes::Car) == LaneModes::Car);
+static_assert((~LaneModes::Bus & LaneModes_all_flags) == (LaneModes::Car | LaneModes::Hov | LaneModes::Truck | LaneModes::Bike));
+static_assert(LaneModes_has_flags(LaneModes_all_flags, LaneModes::Bike | LaneModes::Bus));
+static_assert(!LaneModes_has_flags(LaneModes::Bus, LaneModes::Bus | LaneModes::Car));
+static_assert(LaneModes_flags_from_string("bus|car").has_value() == false);
+static_assert(*LaneModes_flags_from_string("Bus|Car| Hov ") == (LaneModes::Bus | LaneModes::Car | LaneModes::Hov));
+static_assert(*LaneModes_flags_from_string("") == LaneModes::NoModes);
+static_assert(!LaneModes_flags_from_string("Bus||Car").has_value());
+
+// Containers indexed by the members of an enum, holding one slot per member in place
+using SparseCounts = Sparse_containers::array<int>;
+using NestedClassNames = Nester::NestedClass_containers::map<std::string_view>;
+
+static_assert(SparseCounts::size() == 4 && sizeof(SparseCounts) == 4 * sizeof(int));
+static_assert(SparseCounts::contains(Sparse::High) && !SparseCounts::contains(static_cast<Sparse>(1)));
+static_assert(SparseCounts::key(3) == Sparse::High);
+static_assert([] {
+  SparseCounts counts;
+  counts[Sparse::Low] += 2;
+  counts[Sparse::Alias] += 1;
+  counts.at(Sparse::Zero) += 1;
+  int total = 0;
+  counts.for_each([&](Sparse, int a_count) { total += a_count; });
+  return counts[Sparse::Zero] == 2 && counts.values[2] == 0 && total == 4;
+}());
+static_assert([] {
+  NestedClassNames names;
+  names[Nester::NestedClass::NestedClassA] = "a";
+  names.try_emplace(Nester::NestedClass::NestedClassA, "b");
+  const bool is_inserted = names.insert_or_assign(Nester::NestedClass::NestedClassB, "b").second;
+  const size_t erased = names.erase(Nester::NestedClass::NestedClassB) + names.erase(static_cast<Nester::NestedClass>(7));
+  return is_inserted && erased == 1 && names.size() == 1
+      && *names.find(Nester::NestedClass::NestedClassA) == "a"
+      && !names.contains(Nester::NestedClass::NestedClassB);
+}());
+
+// Codecs convert members to and from their dense index, which binary formats write instead of
+// the value, and their name, kept in one blob. meta_enum_codec also gives an enum declared at
+// namespace scope the hooks of mio csv fields, msgpack and zpp_bits
+meta_enum_codec(Sparse);
+
+static_assert(std::is_same_v<Sparse_codec::index_type, uint8_t>);
+static_assert(Sparse_codec::offsets == std::array<uint32_t, 5>{0, 3, 7, 12, 16});
+static_assert(Sparse_codec::name(3) == "High" && Sparse_codec::name(2) == "Alias");
+static_assert(Sparse_codec::index_of(Sparse::High) == 3 && Sparse_codec::index_of(Sparse::Alias) == 1);
+static_assert(Sparse_codec::index_of(static_cast<Sparse>(1)) == Sparse_codec::size());
+static_assert(*Sparse_codec::from_index(0) == Sparse::Low && !Sparse_codec::from_index(4));
+static_assert(Sparse_codec::index_of_name("Zero") == 1 && Complex_codec::name(1) == "Second");
+
+// The metadata of an enum declared in a header with meta_enum_extern, or meta_enum_class_extern,
+// is parsed once, in the translation unit with meta_enum_instantiate. Giving the members by a
+// macro keeps the two lists the same.
+#define LANE_TYPE_MEMBERS General, Bus = 4, Hov, Bike = 8
+
+meta_enum_class_extern(LaneType, uint8_t, LANE_TYPE_MEMBERS);
+
+meta_enum_instantiate(LaneType, uint8_t, LANE_TYPE_MEMBERS);
+
+// Containers indexed by the members of an enum, e.g. speeds by vehicle class.
+meta_enum_class(VehicleClass, uint8_t, Car, Bus, Truck = 8);
+
+// Whole columns of names, e.g. of a csv file, are parsed by <name>_parse_batch.
+meta_enum_class(TravelMode, uint8_t, Walk, Bike, Bus = 4, Rail, HighOccupancyVehicle);
+
 int main()
 {
   // enum meta-objects are accessible with the _meta object. metaobject
@@ -164,4 +271,77 @@ int main()
             << 2
             << " found_name='" << GlobalClass_meta_from_index(2)->name
             << "'\n";
+
+  std::cout << "extern meta_enum: LaneType has "
+            << LaneType_meta.members.size()
+            << " members, Hov='"
+            << LaneType_value_to_string(LaneType::Hov)
+            << "'\n";
+
+  const bool is_extern_consistent = LaneType_meta.members[1].string == " Bus = 4"
+      && LaneType_meta_from_name("Hov")->value == LaneType::Hov
+      && LaneType_meta_from_value(LaneType::Bike)->index == 3
+      && !LaneType_meta_from_value(static_cast<LaneType>(6)).has_value()
+      && LaneType_meta_from_index(0)->name == "General";
+
+  // flag sets are written as the names of their bits, in the order of the bits
+  auto modes = LaneModes::Bike | LaneModes::Bus;
+  modes |= LaneModes::Hov;
+  std::cout << "flags_to_string: "
+            << LaneModes_flags_to_string(modes)
+            << "\n";
+
+  LaneModes parsed{};
+  const bool is_flags_consistent = LaneModes_flags_to_string(modes) == "Bus|Hov|Bike"
+      && LaneModes_flags_to_string(LaneModes::NoModes) == "NoModes"
+      && LaneModes_flags_to_string(static_cast<LaneModes>(0x21)) == "Bus|32"
+      && parse_field("\"Car|Truck\"", parsed) && parsed == (LaneModes::Car | LaneModes::Truck)
+      && !parse_field("Car|Plane", parsed) && parsed == LaneModes::NoModes;
+
+  // codec enums are written by zpp_bits as one byte, whatever their values
+  std::string formatted;
+  format_field(formatted, Sparse::Low);
+  Sparse parsed_sparse{};
+  std::vector<std::byte> bytes;
+  auto out = zpp::bits::out{bytes};
+  auto in = zpp::bits::in{bytes};
+  std::vector<Sparse> sparse_values;
+  const bool is_codec_consistent = formatted == "Low"
+      && parse_field(" \"High\"", parsed_sparse) && parsed_sparse == Sparse::High
+      && !parse_field("Middle", parsed_sparse)
+      && zpp::bits::success(out(std::vector{Sparse::High, Sparse::Low}))
+      && bytes.size() == 4 + 2 && bytes[4] == std::byte{3}
+      && zpp::bits::success(in(sparse_values))
+      && sparse_values == std::vector{Sparse::High, Sparse::Low};
+
+  // whole columns of names are parsed at once, unknown names flagged in a bit mask
+  std::vector<std::string_view> mode_names;
+  for (int i = 0; i < 100; ++i) mode_names.push_back(i % 10 == 7 ? "Ferry" : i % 3 == 0 ? "HighOccupancyVehicle" : i % 2 ? "Bus" : "Rail");
+  mode_names[64] = "";
+  std::vector<TravelMode> modes_column(mode_names.size());
+  std::array<uint64_t, 2> unknown_modes{~uint64_t{0}, ~uint64_t{0}};
+  const size_t unknown_count = TravelMode_parse_batch(mode_names, modes_column, unknown_modes);
+
+  const bool is_batch_consistent = unknown_count == 11
+      && unknown_modes[0] == 0x0200802008020080 && unknown_modes[1] == 0x200802009
+      && modes_column[0] == TravelMode::HighOccupancyVehicle && modes_column[1] == TravelMode::Bus
+      && modes_column[2] == TravelMode::Rail && modes_column[7] == TravelMode::Walk
+      && Sparse_parse_batch(std::array<std::string_view, 2>{"Zero", "Alias"}, std::span{&parsed_sparse, 1}) == 0
+      && parsed_sparse == Sparse::Zero;
+
+  // containers check their keys at run time too
+  VehicleClass_containers::map<double> speeds;
+  speeds[VehicleClass::Truck] = 22.5;
+
+  bool is_out_of_range = false;
+  try {
+    speeds.at(VehicleClass::Bus);
+  } catch (const std::out_of_range &) {
+    is_out_of_range = true;
+  }
+
+  const bool is_containers_consistent = is_out_of_range
+      && speeds.size() == 1 && speeds.at(VehicleClass::Truck) == 22.5;
+
+  return is_extern_consistent && is_flags_consistent && is_codec_consistent && is_batch_consistent && is_containers_consistent ? 0 : 1;
 }
@@ -0,0 +1,191 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_BATCH_READER_HPP
+#define WXLIB_MIO_BATCH_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/executor.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+namespace mio {
+
+/**
+   A batch of consecutive whole lines, see BatchReader::next_batch.
+ */
+struct LineBatch
+{
+  std::string_view block; // The lines, each with its `\n`, but maybe the last line of the content.
+  size_t offset{0};       // Offset of the block in the content.
+  size_t index{0};        // Number of the batch, from 0.
+
+  /**
+     A lazy view of the lines of the batch, see LineView.
+   */
+  [[nodiscard]] LineView lines() const noexcept
+  {
+    return LineView{block};
+  }
+};
+
+/**
+   Reads the content of a file, or of text in memory, as batches of whole lines from a coroutine,
+   e.g. `while (auto batch = co_await reader.next_batch())`, so that coroutine based services read
+   without blocking a thread.
+
+   Awaiting next_batch() suspends the coroutine and resumes it on a worker of an Executor, once the
+   pages of the batch are read in; the worker also asks the kernel to read the next batch ahead.
+   The coroutine then processes the batch on that worker, and a pool shared with other work, e.g.
+   networking, is never blocked on the disk by the reading.
+
+   The reader works with any coroutine type. It neither copies nor owns the content, which must
+   outlive it, and the batches are valid as long as the content.
+
+   @code
+     mio::StringReaderAsync file{"links.csv"};
+     mio::BatchReader reader{file};
+
+     while (auto batch = co_await reader.next_batch()) {
+       for (const auto line: batch->lines()) {
+         // ... do something about the line.
+       }
+     }
+   @endcode
+ */
+class BatchReader
+{
+public:
+  /**
+     Default size of a batch, 1 MiB, extended to the next `\n`.
+   */
+  static constexpr size_t default_batch_size = size_t{1} << 20;
+
+  class BatchAwaiter;
+
+  /**
+     \param a_content The text to read, e.g. StringReader::content().
+     \param a_batch_size Approximate size of a batch in bytes, 0 treated as 1.
+     \param a_executor The executor resuming the coroutines awaiting a batch.
+   */
+  explicit BatchReader(const std::string_view a_content, const size_t a_batch_size = default_batch_size, Executor &a_executor = Executor::shared()) noexcept
+      : content_{a_content}, batch_size_{std::max(a_batch_size, size_t{1})}, executor_{a_executor}
+  {
+  }
+
+  /**
+     Reads the whole content of a reader, independent of its reading position.
+   */
+  template<LoadingMode L>
+  explicit BatchReader(const StringReader<L> &a_reader, const size_t a_batch_size = default_batch_size, Executor &a_executor = Executor::shared()) noexcept
+      : BatchReader(a_reader.content(), a_batch_size, a_executor)
+  {
+  }
+
+  BatchReader(const BatchReader &) = delete;
+  BatchReader &operator=(const BatchReader &) = delete;
+
+  /**
+     Returns an awaitable of the next batch, std::nullopt once all the lines are read, not
+     suspending the coroutine then.
+
+     Precondition - the batch awaited before, if any, must be ready, i.e. the batches are awaited
+     one at a time.
+   */
+  [[nodiscard]] BatchAwaiter next_batch() noexcept;
+
+  /**
+     Whether all the lines are read.
+   */
+  [[nodiscard]] bool eof() const noexcept
+  {
+    return offset_ == content_.size();
+  }
+
+  /**
+     Number of batches read so far.
+   */
+  [[nodiscard]] size_t batch_count() const noexcept
+  {
+    return index_;
+  }
+
+private:
+  LineBatch cut() noexcept
+  {
+    const auto first = offset_;
+    const auto nominal = std::min(first + batch_size_, content_.size());
+    const char *end = content_.data() + content_.size();
+    const char *eol = fast_find<'\n'>(content_.data() + nominal, end);
+    offset_ = eol == end ? content_.size() : static_cast<size_t>(std::next(eol) - content_.data());
+
+    // Faults the pages of the batch in here, so that processing it does not block on the disk, ...
+    const auto block = content_.substr(first, offset_ - first);
+    auto sum = uint8_t{0};
+    for (size_t i = 0; i < block.size(); i += page_size()) sum += static_cast<uint8_t>(block[i]);
+    touched_ = sum;
+
+    // ... and asks the kernel to read the next one ahead.
+    std::error_code error;
+    if (!eof()) detail::prefetch(content_.data() + offset_, std::min(batch_size_, content_.size() - offset_), error);
+
+    return {block, first, index_++};
+  }
+
+  std::string_view content_;
+  size_t batch_size_;
+  Executor &executor_;
+  size_t offset_{0};
+  size_t index_{0};
+  volatile uint8_t touched_{0};
+};
+
+/**
+   The awaitable of BatchReader::next_batch.
+ */
+class BatchReader::BatchAwaiter
+{
+public:
+  explicit BatchAwaiter(BatchReader &a_reader) noexcept : reader_{a_reader}
+  {
+  }
+
+  [[nodiscard]] bool await_ready() const noexcept
+  {
+    return reader_.eof();
+  }
+
+  void await_suspend(const std::coroutine_handle<> a_handle)
+  {
+    reader_.executor_.post([this, a_handle] {
+      batch_ = reader_.cut();
+      a_handle.resume();
+    });
+  }
+
+  [[nodiscard]] std::optional<LineBatch> await_resume() noexcept
+  {
+    return batch_;
+  }
+
+private:
+  BatchReader &reader_;
+  std::optional<LineBatch> batch_;
+};
+
+inline BatchReader::BatchAwaiter BatchReader::next_batch() noexcept
+{
+  return BatchAwaiter{*this};
+}
+
+}
+#endif
@@ -0,0 +1,128 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_BLOOM_FILTER_HPP
+#define WXLIB_MIO_BLOOM_FILTER_HPP
+
+#include <mio/fastfind.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace mio {
+
+/**
+   A block of a split block Bloom filter: 256 bits as eight 32-bit lanes, one bit of each lane
+   set per key, so that a key is inserted or probed within one cache line, by a single AVX2 or
+   two NEON compares.
+ */
+struct alignas(32) BloomBlock
+{
+  std::array<uint32_t, 8> lanes{};
+};
+
+static_assert(sizeof(BloomBlock) == 32);
+
+/**
+   Number of bits of a filter per key inserted, for a false positive rate of about 0.5%.
+ */
+inline constexpr size_t bloom_bits_per_key = 16;
+
+/**
+   Number of blocks of a filter of a_count keys, at least one.
+ */
+[[nodiscard]] constexpr size_t bloom_block_count(const size_t a_count) noexcept
+{
+  return a_count == 0 ? 1 : (a_count * bloom_bits_per_key + 255) / 256;
+}
+
+namespace detail {
+
+inline constexpr std::array<uint32_t, 8> bloom_salts = {0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+                                                        0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u};
+
+/**
+   The block of a hash, by the high 32 bits of the hash, scaled to the number of blocks.
+ */
+[[nodiscard]] inline size_t bloom_block(const uint64_t a_hash, const size_t a_blocks) noexcept
+{
+  return static_cast<size_t>(((a_hash >> 32) * a_blocks) >> 32);
+}
+
+/**
+   The bits of a hash in its block, one per lane, by the low 32 bits of the hash.
+ */
+[[nodiscard]] inline BloomBlock bloom_mask(const uint64_t a_hash) noexcept
+{
+  auto mask = BloomBlock{};
+  for (size_t i = 0; i < mask.lanes.size(); i++)
+    mask.lanes[i] = uint32_t{1} << ((static_cast<uint32_t>(a_hash) * bloom_salts[i]) >> 27);
+  return mask;
+}
+
+inline bool scalar_bloom_contains(const BloomBlock &a_block, const uint64_t a_hash) noexcept
+{
+  const auto mask = bloom_mask(a_hash);
+  auto missing = uint32_t{0};
+  for (size_t i = 0; i < mask.lanes.size(); i++) missing |= mask.lanes[i] & ~a_block.lanes[i];
+  return missing == 0;
+}
+
+#ifdef WXLIB_MIO_X86
+WXLIB_MIO_TARGET("avx2") inline bool avx2_bloom_contains(const BloomBlock &a_block, const uint64_t a_hash) noexcept
+{
+  const auto salts = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bloom_salts.data()));
+  const auto shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(a_hash))), salts), 27);
+  const auto mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+  return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(a_block.lanes.data())), mask) != 0;
+}
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+inline bool neon_bloom_contains(const BloomBlock &a_block, const uint64_t a_hash) noexcept
+{
+  const auto key = vdupq_n_u32(static_cast<uint32_t>(a_hash));
+  const auto one = vdupq_n_u32(1);
+  auto lanes = [&](const size_t a_half) {
+    const auto shifts = vshrq_n_u32(vmulq_u32(key, vld1q_u32(bloom_salts.data() + 4 * a_half)), 27);
+    const auto mask = vshlq_u32(one, vreinterpretq_s32_u32(shifts));
+    return vbicq_u32(mask, vld1q_u32(a_block.lanes.data() + 4 * a_half));
+  };
+  return vmaxvq_u32(vorrq_u32(lanes(0), lanes(1))) == 0;
+}
+#endif
+
+}
+
+/**
+   Inserts a hashed key into a filter of one or more blocks.
+ */
+inline void bloom_insert(const std::span<BloomBlock> a_blocks, const uint64_t a_hash) noexcept
+{
+  auto &block = a_blocks[detail::bloom_block(a_hash, a_blocks.size())];
+  const auto mask = detail::bloom_mask(a_hash);
+  for (size_t i = 0; i < mask.lanes.size(); i++) block.lanes[i] |= mask.lanes[i];
+}
+
+/**
+   Probes a filter for a hashed key, with AVX2 or NEON if the CPU supports it, see simd_level().
+
+   \returns False if the key was certainly not inserted.
+ */
+[[nodiscard]] inline bool bloom_contains(const std::span<const BloomBlock> a_blocks, const uint64_t a_hash) noexcept
+{
+  const auto &block = a_blocks[detail::bloom_block(a_hash, a_blocks.size())];
+#if defined(WXLIB_MIO_X86)
+  const auto level = simd_level();
+  if (level == SimdLevel::Avx2 || level == SimdLevel::Avx512) return detail::avx2_bloom_contains(block, a_hash);
+#elif defined(WXLIB_MIO_ARM64)
+  if (simd_level() == SimdLevel::Neon) return detail::neon_bloom_contains(block, a_hash);
+#endif
+  return detail::scalar_bloom_contains(block, a_hash);
+}
+
+}
+#endif
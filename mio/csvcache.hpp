@@ -0,0 +1,846 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_CSV_CACHE_HPP
+#define WXLIB_MIO_CSV_CACHE_HPP
+
+#include <mio/mio.hpp>
+#include <mio/bloomfilter.hpp>
+#include <mio/csvdoc.hpp>
+#include <mio/extent.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/replacefile.hpp>
+#include <mio/stringreader.hpp>
+#include <mio/utf8.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * A column of strings of a CsvCache: the bytes of all the strings in one blob, and the offsets
+ * of each string in the blob.
+ */
+class CsvCacheStrings
+{
+public:
+    CsvCacheStrings() = default;
+
+    CsvCacheStrings(std::span<const uint64_t> a_offsets, const char *a_blob) noexcept : offsets_{a_offsets}, blob_{a_blob}
+    {
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return offsets_.empty() ? 0 : offsets_.size() - 1;
+    }
+
+    [[nodiscard]] std::string_view operator[](size_t i) const noexcept
+    {
+        return {blob_ + offsets_[i], static_cast<size_t>(offsets_[i + 1] - offsets_[i])};
+    }
+
+private:
+    std::span<const uint64_t> offsets_;
+    const char *blob_{nullptr};
+};
+
+/*!
+ * A binary columnar cache of a csv file, so that later runs map the parsed columns instead of
+ * parsing the csv again. open() builds the cache from the csv on first load, parsing its records
+ * by a CsvDoc of the same schema, and maps it on every load after, with no parsing at all.
+ *
+ * Each field is stored as a column: the fields of a fixed size value type, e.g. int64_t or
+ * double, as an array of the values, read back as a std::span; the std::string_view fields as an
+ * array of offsets into a blob of their bytes, read back as CsvCacheStrings. Skipped fields are
+ * not stored. The columns are aligned to 64 bytes in the file.
+ *
+ * The header of the cache records the size, the last write time and a hash of the first and last
+ * 64 KiB of the csv, and a hash of the schema, i.e. the names and value types of the fields; the
+ * cache is rebuilt if any of them has changed. The cache uses the native byte order, and is not
+ * meant to be shared across platforms.
+ *
+ * The csv is cut into content defined chunks of whole records, of about 64 KiB, whose
+ * fingerprints are stored with the cache. When the csv has changed, e.g. a few links edited in a
+ * large link file, the records of the chunks whose fingerprint is unchanged are copied from the
+ * previous cache, and only the other chunks are parsed, see reparsed(). An edit changes the
+ * chunks around it only, since the cuts are found by a rolling hash of the bytes before them.
+ *
+ * Each chunk also records the min and max of each numeric field, and a blocked Bloom filter of
+ * each field of key_fields, so that scan() reads only the chunks which may hold the records
+ * queried, e.g. of a link id in a set, or a time between t0 and t1.
+ *
+ * @code
+ *   mio::csv::CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> links;
+ *   std::error_code error;
+ *   links.open("links.csv", error);
+ *
+ *   auto speed = links.column<2>(); // std::span<const double>
+ *   auto name = links.column<1>();  // CsvCacheStrings
+ *
+ *   links.scan([&](size_t first, size_t count) { ... }, links.between<2>(20.0, 30.0));
+ * @endcode
+ */
+template<typename ...Ts>
+class CsvCache
+{
+public:
+    using Doc = CsvDoc<Ts...>;
+    using Columns = typename Doc::Columns;
+
+    template<size_t I>
+    using value_type = std::tuple_element_t<I, std::tuple<typename Ts::value_type...>>;
+
+    static constexpr size_t field_count = sizeof...(Ts);
+
+    CsvCache() = default;
+    CsvCache(const CsvCache &) = delete;
+    CsvCache &operator=(const CsvCache &) = delete;
+
+    /*!
+     * Same as open(a_csv, default_cache(a_csv), error).
+     */
+    bool open(const std::string &a_csv, std::error_code &error)
+    {
+        return open(a_csv, default_cache(a_csv), error);
+    }
+
+    /*!
+     * Maps the cache of a csv file, after building it from the csv if it is missing or stale.
+     * @param a_csv The csv file.
+     * @param a_cache The cache file, e.g. CsvCache::default_cache(a_csv).
+     * @param error Set to describe the error if the csv cannot be read, its header line does not
+     * match the schema, key_fields names a field which is neither fixed size nor a string, or
+     * the cache cannot be written.
+     * @return true if the columns are mapped.
+     */
+    bool open(const std::string &a_csv, const std::string &a_cache, std::error_code &error)
+    {
+        rebuilt_ = false;
+        reparsed_ = 0;
+        if (!key_mask(key_mask_)) {
+            close();
+            error = std::make_error_code(std::errc::invalid_argument);
+            return false;
+        }
+
+        if (load(a_csv, a_cache, error)) return true;
+        if (!build(a_csv, a_cache, error)) return false;
+
+        rebuilt_ = true;
+        return load(a_csv, a_cache, error);
+    }
+
+    /*!
+     * Returns the conventional cache file name for a csv file, i.e. the file name with `.wxc`
+     * appended.
+     */
+    [[nodiscard]] static std::string default_cache(const std::string &a_csv)
+    {
+        return a_csv + ".wxc";
+    }
+
+    /*!
+     * Checks whether the last open() had to build the cache from the csv.
+     */
+    [[nodiscard]] bool rebuilt() const noexcept
+    {
+        return rebuilt_;
+    }
+
+    /*!
+     * Number of bytes of the csv parsed by the last open(): 0 if the cache was mapped as is, the
+     * size of the changed chunks if it was rebuilt from a previous cache of the same schema, or
+     * the size of the csv otherwise.
+     */
+    [[nodiscard]] size_t reparsed() const noexcept
+    {
+        return reparsed_;
+    }
+
+    /*!
+     * Number of records.
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return record_count_;
+    }
+
+    /*!
+     * The column of the I-th field of the schema, a std::span<const V> of a fixed size value type
+     * V, or CsvCacheStrings of a std::string_view field, valid as long as the cache is open.
+     */
+    template<size_t I>
+    [[nodiscard]] auto column() const noexcept
+    {
+        return column_of<I>(mmap_, entries_);
+    }
+
+    /*!
+     * Number of chunks, see scan().
+     */
+    [[nodiscard]] size_t chunk_count() const noexcept
+    {
+        return chunks_of(mmap_, entries_).size();
+    }
+
+    /*!
+     * {first record, number of records} of a chunk.
+     */
+    [[nodiscard]] std::pair<size_t, size_t> chunk_records(const size_t a_chunk) const noexcept
+    {
+        const auto &chunk = chunks_of(mmap_, entries_)[a_chunk];
+        return {static_cast<size_t>(chunk.first_record), static_cast<size_t>(chunk.record_count)};
+    }
+
+    /*!
+     * {min, max} of the I-th field, numeric, over the records of a chunk; {max, lowest} if the
+     * chunk has no records, or only NaNs.
+     */
+    template<size_t I>
+    [[nodiscard]] std::pair<value_type<I>, value_type<I>> zone(const size_t a_chunk) const noexcept
+    {
+        static_assert(zoned<value_type<I>>, "Zone maps are kept for numeric fields only.");
+        const auto *zones = reinterpret_cast<const value_type<I> *>(mmap_.data() + entries_[zone_entry(I)].offset);
+        return {zones[2 * a_chunk], zones[2 * a_chunk + 1]};
+    }
+
+    /*!
+     * Checks whether a chunk may hold a value of the I-th field between a_low and a_high,
+     * inclusive, by its zone map; always true for fields which are not numeric.
+     */
+    template<size_t I>
+    [[nodiscard]] bool may_overlap(const size_t a_chunk, const value_type<I> &a_low, const value_type<I> &a_high) const noexcept
+    {
+        if constexpr (zoned<value_type<I>>) {
+            const auto [low, high] = zone<I>(a_chunk);
+            return !(a_high < low) && !(high < a_low);
+        } else {
+            return true;
+        }
+    }
+
+    /*!
+     * Checks whether a chunk may hold the value of the I-th field, by its zone map and its Bloom
+     * filter, if the field was one of key_fields when the cache was built. The values are
+     * compared bytewise, e.g. the strings of quoted fields with their quotes.
+     */
+    template<size_t I>
+    [[nodiscard]] bool may_contain(const size_t a_chunk, const value_type<I> &a_value) const noexcept
+    {
+        return may_contain_hash<I>(a_chunk, a_value, key_hash(a_value));
+    }
+
+    /*!
+     * A predicate of scan(), true for the chunks which may hold a value of the I-th field between
+     * a_low and a_high, inclusive.
+     */
+    template<size_t I>
+    [[nodiscard]] auto between(const value_type<I> a_low, const value_type<I> a_high) const
+    {
+        return [this, a_low, a_high](const size_t a_chunk) { return may_overlap<I>(a_chunk, a_low, a_high); };
+    }
+
+    /*!
+     * A predicate of scan(), true for the chunks which may hold any of the values of the I-th
+     * field, each hashed once. The values, e.g. string views, must outlive the predicate.
+     */
+    template<size_t I>
+    [[nodiscard]] auto any_of(const std::span<const value_type<I>> a_values) const
+    {
+        auto hashes = std::vector<uint64_t>{};
+        hashes.reserve(a_values.size());
+        for (const auto &value: a_values) hashes.push_back(key_hash(value));
+
+        return [this, a_values, hashes = std::move(hashes)](const size_t a_chunk) {
+            for (size_t i = 0; i < a_values.size(); i++)
+                if (may_contain_hash<I>(a_chunk, a_values[i], hashes[i])) return true;
+            return false;
+        };
+    }
+
+    /*!
+     * Calls f(first record, number of records) for each chunk, in order, which all the predicates
+     * may match, e.g. between() and any_of(), skipping the others. The records of the chunks
+     * called still have to be checked.
+     * @return The number of chunks called.
+     */
+    template<typename F, typename ...Ps>
+    size_t scan(F &&f, const Ps &...a_predicates) const
+    {
+        const auto chunks = chunks_of(mmap_, entries_);
+        auto scanned = size_t{0};
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (!(a_predicates(i) && ...)) continue;
+            f(static_cast<size_t>(chunks[i].first_record), static_cast<size_t>(chunks[i].record_count));
+            scanned++;
+        }
+        return scanned;
+    }
+
+    /*!
+     * Unmaps the cache.
+     */
+    void close() noexcept
+    {
+        mmap_.unmap();
+        record_count_ = 0;
+        entries_ = {};
+    }
+
+    bool header_on_first_line{true};
+
+    /*!
+     * Indices of the fields, fixed size or strings, of which a Bloom filter is kept per chunk,
+     * e.g. the link ids. The cache is rebuilt if they have changed.
+     */
+    std::vector<size_t> key_fields{};
+
+private:
+    struct CacheHeader
+    {
+        char magic[8] = {'W', 'X', 'C', 'S', 'V', 'C', '0', '3'};
+        uint64_t source_size = 0;
+        int64_t source_time = 0;
+        uint64_t source_hash = 0;
+        uint64_t schema_hash = 0;
+        uint64_t record_count = 0;
+        uint64_t field_count = 0;
+        uint64_t key_mask = 0;
+    };
+
+    static_assert(sizeof(CacheHeader) % 64 == 0);
+
+    // A chunk of whole records of the csv, after the header line, its fingerprint, and its
+    // blocks in the Bloom filters of the key fields.
+    struct ChunkEntry
+    {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t first_record = 0;
+        uint64_t record_count = 0;
+        uint64_t hash = 0;
+        uint64_t first_block = 0;
+        uint64_t block_count = 0;
+    };
+
+    // {offset, size} of the values, or of the string offsets and the blob, of each field, then
+    // of the chunk entries, then of the zone maps, i.e. {min, max} per chunk, of each field, then
+    // of the Bloom filters of each field; empty for the fields without.
+    using Entries = ExtentTable<4 * field_count + 1>;
+
+    static constexpr size_t zone_entry(const size_t a_field) noexcept
+    {
+        return 2 * field_count + 1 + a_field;
+    }
+
+    static constexpr size_t bloom_entry(const size_t a_field) noexcept
+    {
+        return 3 * field_count + 1 + a_field;
+    }
+
+    static constexpr size_t alignment = 64;
+    static constexpr size_t hashed_size = size_t{64} << 10;
+
+    // A chunk is cut at the first `\n` after min_chunk_size bytes where the rolling hash of the
+    // last 64 bytes has its chunk_mask bits clear, or after max_chunk_size bytes. The high bits
+    // are tested, since the low ones depend on the last few bytes only.
+    static constexpr size_t min_chunk_size = size_t{32} << 10;
+    static constexpr size_t max_chunk_size = size_t{256} << 10;
+    static constexpr uint64_t chunk_mask = ~uint64_t{0} << 49;
+
+    template<typename V>
+    static constexpr bool fixed_size = !std::is_same_v<V, std::string_view> && !std::is_same_v<V, Skipped>;
+
+    template<typename V>
+    static constexpr bool zoned = std::is_arithmetic_v<V>;
+
+    template<typename V>
+    static constexpr bool keyed = fixed_size<V> || std::is_same_v<V, std::string_view>;
+
+    static_assert(((!fixed_size<typename Ts::value_type> || std::is_trivially_copyable_v<typename Ts::value_type>) && ...),
+                  "Cached values must be trivially copyable.");
+    static_assert((!std::is_same_v<typename Ts::value_type, Unquoted> && ...), "Unquoted fields are views, and are not cached.");
+
+    template<size_t I>
+    static auto column_of(const mmap_source &a_mmap, const Entries &a_entries) noexcept
+    {
+        using V = value_type<I>;
+        static_assert(!std::is_same_v<V, Skipped>, "Skipped fields are not cached.");
+
+        const auto [offset, size] = a_entries[2 * I];
+        const auto *data = std::next(a_mmap.data(), static_cast<std::ptrdiff_t>(offset));
+        if constexpr (std::is_same_v<V, std::string_view>) {
+            const auto blob = a_entries[2 * I + 1].offset;
+            return CsvCacheStrings{{reinterpret_cast<const uint64_t *>(data), size / sizeof(uint64_t)}, a_mmap.data() + blob};
+        } else {
+            return std::span<const V>{reinterpret_cast<const V *>(data), size / sizeof(V)};
+        }
+    }
+
+    static std::span<const ChunkEntry> chunks_of(const mmap_source &a_mmap, const Entries &a_entries) noexcept
+    {
+        const auto [offset, size] = a_entries[2 * field_count];
+        return {reinterpret_cast<const ChunkEntry *>(a_mmap.data() + offset), size / sizeof(ChunkEntry)};
+    }
+
+    static std::span<const BloomBlock> blooms_of(const mmap_source &a_mmap, const Entries &a_entries, const size_t a_field) noexcept
+    {
+        const auto [offset, size] = a_entries[bloom_entry(a_field)];
+        return {reinterpret_cast<const BloomBlock *>(a_mmap.data() + offset), size / sizeof(BloomBlock)};
+    }
+
+    /*!
+     * Mask of key_fields, false if any is not a field of a fixed size value type or of strings.
+     */
+    bool key_mask(uint64_t &a_mask) const noexcept
+    {
+        static constexpr std::array<bool, field_count> keyable = {keyed<typename Ts::value_type>...};
+        a_mask = 0;
+        for (const auto field: key_fields) {
+            if (field >= field_count || field >= 64 || !keyable[field]) return false;
+            a_mask |= uint64_t{1} << field;
+        }
+        return true;
+    }
+
+    template<typename V>
+    static uint64_t key_hash(const V &a_value) noexcept
+    {
+        if constexpr (std::is_same_v<V, std::string_view>)
+            return xxh64(a_value);
+        else
+            return xxh64({reinterpret_cast<const char *>(&a_value), sizeof(a_value)});
+    }
+
+    template<size_t I>
+    [[nodiscard]] bool may_contain_hash(const size_t a_chunk, const value_type<I> &a_value, const uint64_t a_hash) const noexcept
+    {
+        if (!may_overlap<I>(a_chunk, a_value, a_value)) return false;
+        if constexpr (keyed<value_type<I>>) {
+            if (((key_mask_ >> I) & 1) != 0) {
+                const auto &chunk = chunks_of(mmap_, entries_)[a_chunk];
+                return bloom_contains(blooms_of(mmap_, entries_, I).subspan(chunk.first_block, chunk.block_count), a_hash);
+            }
+        }
+        return true;
+    }
+
+    /*!
+     * XXH64 of the bytes, with a seed of 0: four independent lanes of 8 bytes each, so that
+     * the multiplications of a 32 byte stripe run in parallel.
+     */
+    static uint64_t xxh64(std::string_view a_bytes) noexcept
+    {
+        constexpr uint64_t p1 = 0x9E3779B185EBCA87ull, p2 = 0xC2B2AE3D27D4EB4Full, p3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t p4 = 0x85EBCA77C2B2AE63ull, p5 = 0x27D4EB2F165667C5ull;
+        auto round = [](const uint64_t a_acc, const uint64_t a_lane) { return std::rotl(a_acc + a_lane * p2, 31) * p1; };
+        auto load = []<typename U>(std::type_identity<U>, const char *a_p) {
+            U value;
+            std::memcpy(&value, a_p, sizeof(value));
+            return value;
+        };
+
+        const char *p = a_bytes.data();
+        const char *e = std::next(p, static_cast<std::ptrdiff_t>(a_bytes.size()));
+        auto hash = p5;
+        if (a_bytes.size() >= 32) {
+            auto v = std::array<uint64_t, 4>{p1 + p2, p2, 0, 0 - p1};
+            for (; e - p >= 32; p += 32)
+                for (size_t i = 0; i < v.size(); i++) v[i] = round(v[i], load(std::type_identity<uint64_t>{}, p + 8 * i));
+
+            hash = std::rotl(v[0], 1) + std::rotl(v[1], 7) + std::rotl(v[2], 12) + std::rotl(v[3], 18);
+            for (const auto lane: v) hash = (hash ^ round(0, lane)) * p1 + p4;
+        }
+
+        hash += a_bytes.size();
+        for (; e - p >= 8; p += 8) hash = std::rotl(hash ^ round(0, load(std::type_identity<uint64_t>{}, p)), 27) * p1 + p4;
+        if (e - p >= 4) {
+            hash = std::rotl(hash ^ (load(std::type_identity<uint32_t>{}, p) * p1), 23) * p2 + p3;
+            p += 4;
+        }
+        for (; p != e; ++p) hash = std::rotl(hash ^ (static_cast<unsigned char>(*p) * p5), 11) * p1;
+
+        hash ^= hash >> 33;
+        hash *= p2;
+        hash ^= hash >> 29;
+        hash *= p3;
+        return hash ^ (hash >> 32);
+    }
+
+    /*!
+     * Cuts a_body into content defined chunks of whole records, see min_chunk_size, by a gear
+     * hash, i.e. shifted by one bit per byte, so that it depends on the last 64 bytes only. With
+     * quoted fields, a cut inside quotes is moved to the next `\n` outside.
+     * @return {offset, size} of each chunk.
+     */
+    static std::vector<std::pair<size_t, size_t>> cut_chunks(std::string_view a_body)
+    {
+        static constexpr auto gear = [] {
+            auto table = std::array<uint64_t, 256>{};
+            auto state = uint64_t{0x243F6A8885A308D3ull};
+            for (auto &g: table) {
+                auto z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                g = z ^ (z >> 31);
+            }
+            return table;
+        }();
+        static constexpr bool quoted = (Ts::Quoted::value || ...);
+
+        auto result = std::vector<std::pair<size_t, size_t>>{};
+        const char *begin = a_body.data();
+        const char *end = std::next(begin, static_cast<std::ptrdiff_t>(a_body.size()));
+        for (const char *b = begin; b != end;) {
+            const char *e = end;
+            if (static_cast<size_t>(end - b) > min_chunk_size) {
+                const char *limit = std::next(b, static_cast<std::ptrdiff_t>(std::min(static_cast<size_t>(end - b), max_chunk_size)));
+                const char *p = std::next(b, static_cast<std::ptrdiff_t>(min_chunk_size - 64));
+                auto hash = uint64_t{0};
+                for (const char *warm = std::next(p, 64); p != warm; ++p) hash = (hash << 1) + gear[static_cast<unsigned char>(*p)];
+                for (; p != limit && (hash & chunk_mask) != 0; ++p) hash = (hash << 1) + gear[static_cast<unsigned char>(*p)];
+
+                auto cut = [end](const char *a_from) {
+                    const char *eol = fast_find<'\n'>(a_from, end);
+                    return eol == end ? end : std::next(eol);
+                };
+                e = cut(p);
+                if constexpr (quoted) {
+                    auto quotes = size_t{0};
+                    fast_find_each<'"'>(b, e, [&quotes](const char *) { quotes++; });
+                    while (quotes % 2 != 0 && e != end) {
+                        const char *next = cut(e);
+                        fast_find_each<'"'>(e, next, [&quotes](const char *) { quotes++; });
+                        e = next;
+                    }
+                }
+            }
+            result.emplace_back(static_cast<size_t>(b - begin), static_cast<size_t>(e - b));
+            b = e;
+        }
+        return result;
+    }
+
+    /*!
+     * Appends the a_count records from a_first of the cache mapped by a_mmap to the columns.
+     * The strings are views of the mapping, which must outlive the columns.
+     */
+    static void copy_records(const mmap_source &a_mmap, const Entries &a_entries, const size_t a_first, const size_t a_count, Columns &a_columns)
+    {
+        [&]<size_t ...I>(std::index_sequence<I...>) {
+            auto copy_column = [&]<size_t J>(std::integral_constant<size_t, J>) {
+                using V = value_type<J>;
+                auto &column = std::get<J>(a_columns);
+                if constexpr (std::is_same_v<V, std::string_view>) {
+                    const auto strings = column_of<J>(a_mmap, a_entries);
+                    for (auto i = a_first; i < a_first + a_count; i++) column.push_back(strings[i]);
+                } else if constexpr (fixed_size<V>) {
+                    const auto values = column_of<J>(a_mmap, a_entries).subspan(a_first, a_count);
+                    column.insert(column.end(), values.begin(), values.end());
+                } else {
+                    column.resize(column.size() + a_count);
+                }
+            };
+            (copy_column(std::integral_constant<size_t, I>{}), ...);
+        }(std::make_index_sequence<field_count>{});
+    }
+
+    static uint64_t fnv1a(std::string_view a_bytes, uint64_t a_hash = 0xCBF29CE484222325ull) noexcept
+    {
+        for (const auto c: a_bytes) a_hash = (a_hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        return a_hash;
+    }
+
+    static uint64_t schema_hash() noexcept
+    {
+        auto hash = fnv1a({});
+        auto add = [&hash]<typename T>(std::type_identity<T>) {
+            using V = typename T::value_type;
+            const char kind = std::is_same_v<V, std::string_view> ? 's'
+                            : std::is_same_v<V, Skipped> ? 'x'
+                            : std::is_floating_point_v<V> ? 'f'
+                            : std::is_signed_v<V> ? 'i'
+                            : 'u';
+            const std::array<char, 2> type{kind, static_cast<char>(sizeof(V))};
+            hash = fnv1a({T::field_name, std::strlen(T::field_name) + 1}, hash);
+            hash = fnv1a({type.data(), type.size()}, hash);
+        };
+        (add(std::type_identity<Ts>{}), ...);
+        return hash;
+    }
+
+    static bool stamp(CacheHeader &a_header, const std::string &a_csv, std::string_view a_content, std::error_code &error)
+    {
+        a_header.source_size = std::filesystem::file_size(a_csv, error);
+        if (error) return false;
+        a_header.source_time = std::filesystem::last_write_time(a_csv, error).time_since_epoch().count();
+        if (error) return false;
+
+        const auto head = a_content.substr(0, hashed_size);
+        const auto tail = a_content.substr(a_content.size() - std::min(a_content.size(), hashed_size));
+        a_header.source_hash = fnv1a(tail, fnv1a(head));
+        a_header.schema_hash = schema_hash();
+        a_header.field_count = field_count;
+        return true;
+    }
+
+    bool load(const std::string &a_csv, const std::string &a_cache, std::error_code &error)
+    {
+        close();
+        error.clear();
+        if (!std::filesystem::exists(a_cache, error)) {
+            if (!error) error = std::make_error_code(std::errc::no_such_file_or_directory);
+            return false;
+        }
+
+        // Only the pages hashed are read from the csv.
+        const auto source = make_mmap_source(a_csv, error);
+        if (error) return false;
+
+        auto expected = CacheHeader{};
+        if (!stamp(expected, a_csv, {source.data(), source.size()}, error)) return false;
+
+        mmap_.map(a_cache, error);
+        if (error) return false;
+
+        auto header = CacheHeader{};
+        auto entries = Entries{};
+        const auto valid = read_header(mmap_, header, entries) && header.source_size == expected.source_size
+                        && header.source_time == expected.source_time && header.source_hash == expected.source_hash
+                        && header.key_mask == key_mask_;
+
+        if (!valid) {
+            mmap_.unmap();
+            error = std::make_error_code(std::errc::invalid_argument);
+            return false;
+        }
+
+        record_count_ = header.record_count;
+        entries_ = entries;
+        return true;
+    }
+
+    /*!
+     * Reads the header and the entries of a cache of this schema, whatever the csv it was built
+     * from.
+     * @return false if the mapping is not such a cache.
+     */
+    static bool read_header(const mmap_source &a_mmap, CacheHeader &a_header, Entries &a_entries) noexcept
+    {
+        if (!read_extent_table({a_mmap.data(), a_mmap.size()}, a_header, a_entries, alignment)) return false;
+
+        const auto expected = CacheHeader{};
+        if (std::memcmp(a_header.magic, expected.magic, sizeof(a_header.magic)) != 0 || a_header.schema_hash != schema_hash()
+            || a_header.field_count != field_count)
+            return false;
+
+        const auto chunks = chunks_of(a_mmap, a_entries);
+        for (const auto &chunk: chunks)
+            if (chunk.first_record > a_header.record_count || chunk.record_count > a_header.record_count - chunk.first_record) return false;
+
+        // The zone maps of the numeric fields, and the filters of the key fields, cover every chunk.
+        const auto blocks = chunks.empty() ? uint64_t{0} : chunks.back().first_block + chunks.back().block_count;
+        for (const auto &chunk: chunks)
+            if (chunk.first_block > blocks || chunk.block_count > blocks - chunk.first_block || (a_header.key_mask != 0 && chunk.block_count == 0)) return false;
+
+        static constexpr std::array<size_t, field_count> zone_sizes = {(zoned<typename Ts::value_type> ? 2 * sizeof(typename Ts::value_type) : 0)...};
+        for (size_t i = 0; i < field_count; i++) {
+            const auto keyed_field = i < 64 && ((a_header.key_mask >> i) & 1) != 0;
+            if (a_entries[zone_entry(i)].size != chunks.size() * zone_sizes[i]
+                || a_entries[bloom_entry(i)].size != (keyed_field ? blocks * sizeof(BloomBlock) : 0))
+                return false;
+        }
+        return true;
+    }
+
+    bool build(const std::string &a_csv, const std::string &a_cache, std::error_code &error)
+    {
+        error.clear();
+        const auto source = make_mmap_source(a_csv, error);
+        if (error) return false;
+
+        auto header = CacheHeader{};
+        const std::string_view content{source.data(), source.size()};
+        if (!stamp(header, a_csv, content, error)) return false;
+
+        Doc doc;
+        auto body = skip_utf8_bom(content);
+        if (header_on_first_line) {
+            const auto eol = std::min(body.find('\n'), body.size());
+            auto line = body.substr(0, eol);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!std::get<0>(doc.VerifyHeader(line))) {
+                error = std::make_error_code(std::errc::invalid_argument);
+                return false;
+            }
+            body.remove_prefix(std::min(eol + 1, body.size()));
+        }
+
+        // The unchanged chunks are copied from the previous cache of this schema, if any.
+        auto previous = mmap_source{};
+        auto previous_header = CacheHeader{};
+        auto previous_entries = Entries{};
+        auto previous_chunks = std::unordered_map<uint64_t, ChunkEntry>{};
+        if (std::error_code ignored; std::filesystem::exists(a_cache, ignored)) {
+            previous.map(a_cache, ignored);
+            if (!ignored && read_header(previous, previous_header, previous_entries))
+                for (const auto &chunk: chunks_of(previous, previous_entries)) previous_chunks.emplace(chunk.hash, chunk);
+        }
+
+        auto columns = Columns{};
+        auto chunks = std::vector<ChunkEntry>{};
+        reparsed_ = 0;
+        for (const auto &[offset, size]: cut_chunks(body)) {
+            const auto text = body.substr(offset, size);
+            auto &chunk = chunks.emplace_back(ChunkEntry{offset, size, header.record_count, 0, xxh64(text)});
+
+            if (const auto found = previous_chunks.find(chunk.hash); found != previous_chunks.end() && found->second.size == size) {
+                copy_records(previous, previous_entries, found->second.first_record, found->second.record_count, columns);
+                chunk.record_count = found->second.record_count;
+            } else {
+                chunk.record_count = doc.make_columns(text, columns);
+                reparsed_ += size;
+            }
+            header.record_count += chunk.record_count;
+        }
+
+        // The key fields share the layout of their filters, by the number of records per chunk.
+        header.key_mask = key_mask_;
+        auto block_count = uint64_t{0};
+        if (key_mask_ != 0) {
+            for (auto &chunk: chunks) {
+                chunk.first_block = block_count;
+                chunk.block_count = bloom_block_count(chunk.record_count);
+                block_count += chunk.block_count;
+            }
+        }
+
+        return replace_file(a_cache, [&](std::ofstream &out) {
+            auto entries = Entries{};
+            auto position = static_cast<uint64_t>(sizeof(header) + sizeof(entries));
+
+            // Lays out the columns first, then writes the header, the entries and the columns.
+            auto layout = [&](const size_t a_entry, const uint64_t a_size) { entries[a_entry] = place_extent(position, a_size, alignment); };
+
+            auto string_offsets = std::array<std::vector<uint64_t>, field_count>{};
+            [&]<size_t ...I>(std::index_sequence<I...>) {
+                auto layout_column = [&]<size_t J>(std::integral_constant<size_t, J>) {
+                    using V = value_type<J>;
+                    const auto &column = std::get<J>(columns);
+                    if constexpr (std::is_same_v<V, std::string_view>) {
+                        auto &offsets = string_offsets[J];
+                        offsets.push_back(0);
+                        for (const auto s: column) offsets.push_back(offsets.back() + s.size());
+                        layout(2 * J, offsets.size() * sizeof(uint64_t));
+                        layout(2 * J + 1, offsets.back());
+                    } else if constexpr (fixed_size<V>) {
+                        layout(2 * J, column.size() * sizeof(V));
+                    }
+                };
+                (layout_column(std::integral_constant<size_t, I>{}), ...);
+            }(std::make_index_sequence<field_count>{});
+            layout(2 * field_count, chunks.size() * sizeof(ChunkEntry));
+            [&]<size_t ...I>(std::index_sequence<I...>) {
+                auto layout_index = [&]<size_t J>(std::integral_constant<size_t, J>) {
+                    using V = value_type<J>;
+                    if constexpr (zoned<V>) layout(zone_entry(J), chunks.size() * 2 * sizeof(V));
+                    if (((key_mask_ >> J) & 1) != 0) layout(bloom_entry(J), block_count * sizeof(BloomBlock));
+                };
+                (layout_index(std::integral_constant<size_t, I>{}), ...);
+            }(std::make_index_sequence<field_count>{});
+
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(&entries), sizeof(entries));
+            auto written = static_cast<uint64_t>(sizeof(header) + sizeof(entries));
+            auto write_at = [&](const uint64_t a_offset, const char *a_data, const uint64_t a_size) {
+                static constexpr char padding[alignment] = {};
+                out.write(padding, static_cast<std::streamsize>(a_offset - written));
+                out.write(a_data, static_cast<std::streamsize>(a_size));
+                written = a_offset + a_size;
+            };
+
+            [&]<size_t ...I>(std::index_sequence<I...>) {
+                auto write_column = [&]<size_t J>(std::integral_constant<size_t, J>) {
+                    using V = value_type<J>;
+                    const auto &column = std::get<J>(columns);
+                    if constexpr (std::is_same_v<V, std::string_view>) {
+                        const auto &offsets = string_offsets[J];
+                        write_at(entries[2 * J].offset, reinterpret_cast<const char *>(offsets.data()), entries[2 * J].size);
+                        write_at(entries[2 * J + 1].offset, nullptr, 0);
+                        for (const auto s: column) out.write(s.data(), static_cast<std::streamsize>(s.size()));
+                        written += entries[2 * J + 1].size;
+                    } else if constexpr (fixed_size<V>) {
+                        write_at(entries[2 * J].offset, reinterpret_cast<const char *>(column.data()), entries[2 * J].size);
+                    }
+                };
+                (write_column(std::integral_constant<size_t, I>{}), ...);
+            }(std::make_index_sequence<field_count>{});
+            write_at(entries[2 * field_count].offset, reinterpret_cast<const char *>(chunks.data()), entries[2 * field_count].size);
+
+            [&]<size_t ...I>(std::index_sequence<I...>) {
+                auto write_index = [&]<size_t J>(std::integral_constant<size_t, J>) {
+                    using V = value_type<J>;
+                    const auto &column = std::get<J>(columns);
+                    if constexpr (zoned<V>) {
+                        auto zones = std::vector<V>{};
+                        zones.reserve(chunks.size() * 2);
+                        for (const auto &chunk: chunks) {
+                            auto low = std::numeric_limits<V>::max();
+                            auto high = std::numeric_limits<V>::lowest();
+                            for (auto i = chunk.first_record; i < chunk.first_record + chunk.record_count; i++) {
+                                if (column[i] < low) low = column[i];
+                                if (high < column[i]) high = column[i];
+                            }
+                            zones.push_back(low);
+                            zones.push_back(high);
+                        }
+                        write_at(entries[zone_entry(J)].offset, reinterpret_cast<const char *>(zones.data()), entries[zone_entry(J)].size);
+                    }
+
+                    if constexpr (keyed<V>) {
+                        if (((key_mask_ >> J) & 1) == 0) return;
+                        auto blocks = std::vector<BloomBlock>(block_count);
+                        for (const auto &chunk: chunks) {
+                            const auto filter = std::span{blocks}.subspan(chunk.first_block, chunk.block_count);
+                            for (auto i = chunk.first_record; i < chunk.first_record + chunk.record_count; i++) bloom_insert(filter, key_hash(V{column[i]}));
+                        }
+                        write_at(entries[bloom_entry(J)].offset, reinterpret_cast<const char *>(blocks.data()), entries[bloom_entry(J)].size);
+                    }
+                };
+                (write_index(std::integral_constant<size_t, I>{}), ...);
+            }(std::make_index_sequence<field_count>{});
+
+            // The strings of the columns copied are views of the previous cache, about to be replaced.
+            columns = {};
+            previous.unmap();
+        }, error);
+    }
+
+    mmap_source mmap_;
+    size_t record_count_{0};
+    Entries entries_{};
+    uint64_t key_mask_{0};
+    size_t reparsed_{0};
+    bool rebuilt_{false};
+};
+
+}
+#endif
@@ -7,10 +7,20 @@
 #define WXLIB_MIO_CSV_DOC_HPP
 
 #include <mio/fastfind.hpp>
+#include <mio/csvscan.hpp>
+#include <mio/trace.hpp>
 
+#include <array>
 #include <bitset>
+#include <charconv>
+#include <memory_resource>
 #include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
 #include <format>
+#include <utility>
+#include <vector>
 
 namespace mio::csv {
 
@@ -61,38 +71,207 @@ struct csv_field_t
 template<typename T>
 concept CsvFieldTagType = std::is_same_v<typename T::type, csv_field_tag_t>;
 
-template<CsvFieldTagType T, bool quoted>
+/*!
+ * Converts the text of a field to a value, with no allocation for arithmetic types. Integers
+ * and floating point numbers are parsed by std::from_chars, allowing a leading `+`; booleans
+ * are `1`, `0`, `true` or `false`. For types other than strings, the surrounding spaces and
+ * one pair of enclosing double quotes are removed first. An empty text converts to a value
+ * initialized value.
+ *
+ * Overload parse_field in the namespace of a custom type to support it in a CsvField.
+ * @tparam V The value type.
+ * @param a_text
+ * @param a_value Set to the converted value, or value initialized on failure.
+ * @return true on success, false if the text is not a valid V.
+ */
+template<typename V>
+bool parse_field(std::string_view a_text, V &a_value)
+{
+    if constexpr (std::is_same_v<V, std::string_view>) {
+        a_value = a_text;
+        return true;
+    } else if constexpr (requires { requires std::is_same_v<V, std::basic_string<char, typename V::traits_type, typename V::allocator_type>>; }) {
+        // Assigned in place, keeping the allocator, e.g. the arena of a std::pmr::string.
+        a_value.assign(a_text);
+        return true;
+    } else {
+        auto trim = [&a_text](const char a_c) {
+            while (!a_text.empty() && a_text.front() == a_c) a_text.remove_prefix(1);
+            while (!a_text.empty() && a_text.back() == a_c) a_text.remove_suffix(1);
+        };
+
+        trim(' ');
+        if (a_text.size() >= 2 && a_text.front() == '"' && a_text.back() == '"') a_text = a_text.substr(1, a_text.size() - 2);
+        trim(' ');
+
+        a_value = V{};
+        if (a_text.empty()) return true;
+
+        if constexpr (std::is_same_v<V, bool>) {
+            a_value = a_text == "1" || a_text == "true";
+            return a_value || a_text == "0" || a_text == "false";
+        } else if constexpr (std::is_arithmetic_v<V>) {
+            if (a_text.front() == '+' && a_text.size() > 1 && a_text[1] != '-') a_text.remove_prefix(1);
+
+            const char *e = std::next(a_text.data(), static_cast<std::ptrdiff_t>(a_text.size()));
+            auto [ptr, ec] = std::from_chars(a_text.data(), e, a_value);
+            if (ec == std::errc{} && ptr == e) return true;
+
+            a_value = V{};
+            return false;
+        } else {
+            static_assert(sizeof(V) == 0, "No parse_field overload for the CsvField value type.");
+        }
+    }
+}
+
+/*!
+ * Value type of a Skip field, of which nothing is kept.
+ */
+struct Skipped
+{
+    bool operator==(const Skipped &) const = default;
+};
+
+/*!
+ * A skipped field is not converted, only stepped over.
+ */
+inline bool parse_field(std::string_view, Skipped &)
+{
+    return true;
+}
+
+/*!
+ * Value type of a quoted field without its enclosing double quotes, e.g.
+ * UnquotedField<NAME("name")>. The text is a view of the line, with no allocation; only a field
+ * with escaped `""` inside is to be unescaped, into an arena or a writable buffer, which the
+ * common fields with no escape are not.
+ * @code
+ *   const auto &name = get<1>(rec).data;
+ *   std::string_view text = name.escaped ? name.unescape(&arena) : name.text;
+ * @endcode
+ */
+struct Unquoted
+{
+    // The text between the enclosing quotes, with its escaped `""` if any.
+    std::string_view text{};
+    // Whether the text has escaped `""`, which unescape undoes.
+    bool escaped{false};
+
+    /*!
+     * @return The unescaped text, allocated from a_arena if escaped, e.g. from a
+     * mio::arena_memory_resource, or the text itself otherwise.
+     */
+    [[nodiscard]] std::string_view unescape(std::pmr::memory_resource *a_arena) const
+    {
+        if (!escaped) return text;
+        return unescape({static_cast<char *>(a_arena->allocate(text.size(), 1)), text.size()});
+    }
+
+    /*!
+     * Same as unescape(a_arena), into a_buffer of text.size() bytes at least, which may be the
+     * text itself if writable, e.g. read from a mio::mmap_private.
+     */
+    std::string_view unescape(std::span<char> a_buffer) const noexcept
+    {
+        if (!escaped) return text;
+
+        auto out = a_buffer.data();
+        for (auto p = text.data(), e = std::next(p, static_cast<std::ptrdiff_t>(text.size())); p != e; ++p) {
+            *out++ = *p;
+            if (*p == '"' && std::next(p) != e && p[1] == '"') ++p;
+        }
+        return {a_buffer.data(), static_cast<size_t>(out - a_buffer.data())};
+    }
+
+    /*!
+     * @return The unescaped text as a std::string.
+     */
+    [[nodiscard]] std::string str() const
+    {
+        auto result = std::string(text.size(), '\0');
+        result.resize(unescape(std::span<char>{result}).size());
+        return result;
+    }
+
+    bool operator==(const Unquoted &) const = default;
+};
+
+/*!
+ * Removes one pair of enclosing double quotes, and finds whether the text in between has
+ * escaped quotes. An unquoted field is taken as is.
+ */
+inline bool parse_field(std::string_view a_text, Unquoted &a_value)
+{
+    const auto quoted = a_text.size() >= 2 && a_text.front() == '"' && a_text.back() == '"';
+    a_value.text = quoted ? a_text.substr(1, a_text.size() - 2) : a_text;
+
+    const char *e = std::next(a_value.text.data(), static_cast<std::ptrdiff_t>(a_value.text.size()));
+    a_value.escaped = quoted && fast_find<'"'>(a_value.text.data(), e) != e;
+    return true;
+}
+
+/*!
+ * A csv field of the schema, holding the value of the field for one record.
+ * @tparam T The field tag, see NAME.
+ * @tparam quoted Whether the field may have commas enclosed in double quotes.
+ * @tparam V The value type, converted from the text of the field by parse_field. The
+ * default std::string_view is a view of the text, including the quotes if any.
+ */
+template<CsvFieldTagType T, bool quoted, typename V = std::string_view>
 struct CsvField
 {
     using type = csv_field_t;
     using Quoted = std::integral_constant<bool, quoted>;
+    using value_type = V;
     static constexpr const char *field_name = T::field_name.data();
-    std::string_view data{nullptr, 0};
+    V data{};
 };
 
 /*!
  * Example: QuotedCsvField<NAME("WKT")>
  */
-template<typename T>
-using QuotedCsvField = CsvField<T, true>;
+template<typename T, typename V = std::string_view>
+using QuotedCsvField = CsvField<T, true, V>;
 
 /*!
  * Example: QuotedField<NAME("WKT")>
  */
+template<typename T, typename V = std::string_view>
+using QuotedField = QuotedCsvField<T, V>;
+
+/*!
+ * A quoted field whose value is its text without the enclosing quotes, see Unquoted.
+ * Example: UnquotedField<NAME("name")>
+ */
 template<typename T>
-using QuotedField = QuotedCsvField<T>;
+using UnquotedField = QuotedCsvField<T, Unquoted>;
+
+/*!
+ * Example: PlainCsvField<NAME("node_id")>, PlainCsvField<NAME("node_id"), int64_t>
+ */
+template<typename T, typename V = std::string_view>
+using PlainCsvField = CsvField<T, false, V>;
 
 /*!
- * Example: PlainCsvField<NAME("node_id")>
+ * Example: Field<NAME("speed")>, Field<NAME("speed"), double>
+ */
+template<typename T, typename V = std::string_view>
+using Field = PlainCsvField<T, V>;
+
+/*!
+ * Marks a field of the schema as not needed, e.g. Skip<NAME("geometry")>. A skipped field is
+ * stepped over but not converted, and the skipped fields after the last needed one are not
+ * scanned at all by CsvDoc::make_record.
  */
 template<typename T>
-using PlainCsvField = CsvField<T, false>;
+using Skip = PlainCsvField<T, Skipped>;
 
 /*!
- * Example: Field<NAME("WKT")>
+ * Same as Skip, for a field that may have commas enclosed in double quotes, e.g. a WKT.
  */
 template<typename T>
-using Field = PlainCsvField<T>;
+using QuotedSkip = QuotedCsvField<T, Skipped>;
 
 template<typename T>
 concept CsvFieldType = std::is_same_v<typename T::type, csv_field_t>;
@@ -120,18 +299,31 @@ concept UniqueCsvFields = requires
     unique_csv_fields<Ts...>{};
 };
 
-template<typename ...Ts> requires UniqueCsvFields<Ts...>
-struct CsvDoc
+/*!
+ * A csv document of a dialect, see CsvDialect, whose delimiter, quote and escape chars the
+ * scanning kernels are specialized for, so that tab, pipe or semicolon delimited files are
+ * read at the same speed as comma delimited ones, with no transcoding. A `\r` before `\n` is
+ * excluded from the last field by make_records, make_columns and records, whatever the
+ * dialect. parse_field still removes the enclosing double quotes only.
+ * @code
+ *   mio::csv::BasicCsvDoc<mio::csv::TabDialect, Field<NAME("id"), int64_t>, Field<NAME("speed"), double>> doc;
+ * @endcode
+ */
+template<typename Dialect, typename ...Ts> requires UniqueCsvFields<Ts...>
+struct BasicCsvDoc
 {
     using Record = CsvRecord<Ts...>;
     constexpr static auto field_count = std::tuple_size_v<Record>;
+    constexpr static auto delimiter = Dialect::delimiter;
+    constexpr static auto quote = Dialect::quote;
+    constexpr static auto escape = Dialect::escape;
 
-    CsvDoc() = default;
-    CsvDoc(const CsvDoc &) = delete;
-    CsvDoc(CsvDoc &&) = delete;
-    ~CsvDoc() = default;
-    CsvDoc &operator=(CsvDoc &) = delete;
-    CsvDoc &operator=(CsvDoc &&) = delete;
+    BasicCsvDoc() = default;
+    BasicCsvDoc(const BasicCsvDoc &) = delete;
+    BasicCsvDoc(BasicCsvDoc &&) = delete;
+    ~BasicCsvDoc() = default;
+    BasicCsvDoc &operator=(BasicCsvDoc &) = delete;
+    BasicCsvDoc &operator=(BasicCsvDoc &&) = delete;
 
     /*!
      * Verify the header line of the csv document.
@@ -146,7 +338,7 @@ struct CsvDoc
 
         auto f = [&a_header](Ts const &... args) {
             // field names detected from the header.
-            ranges::split_view detected_names{a_header, string_view{","}};
+            ranges::split_view detected_names{a_header, string_view{&delimiter, 1}};
             auto it{detected_names.begin()};
             // compare the detected names to schema, and set the flag bit if different.
             bitset<sizeof...(args)> flags;
@@ -159,12 +351,90 @@ struct CsvDoc
             return make_tuple(ok, msg);
         };
 
-        auto detected_field_count{std::count(a_header.begin(), a_header.end(), ',') + 1};
+        auto detected_field_count{std::count(a_header.begin(), a_header.end(), delimiter) + 1};
         return (detected_field_count == field_count) ?
                apply(f, Record{}) :
                make_tuple(false, format("Invalid column counts: expected {}, detected {} ", field_count, detected_field_count));
     }
 
+    /*!
+     * Column of the file bound to no field of the schema.
+     */
+    static constexpr size_t unmapped = static_cast<size_t>(-1);
+
+    /*!
+     * Index of the schema field bound to each column of a file, in file order, or unmapped for
+     * the columns not needed. An empty map binds the columns in schema order.
+     */
+    using ColumnMap = std::vector<size_t>;
+
+    /*!
+     * Maps the columns of a file to the fields of the schema by name, from the header line, so
+     * that files with the columns reordered or extra columns need no rewriting. Once mapped,
+     * make_record, make_records and make_columns parse the fields in file order, scatter them
+     * into the schema slots, and step over unknown columns (quote aware) with no conversion;
+     * the columns after the last needed one are not scanned by make_record. Skip fields may
+     * be missing from the file. project and LazyRecord keep the schema order.
+     *
+     * Names are compared after trimming spaces, one pair of enclosing double quotes, `\r` and a
+     * UTF-8 BOM. If a name is repeated, its first column is used.
+     * @param a_header The first line of the csv document used as the header line.
+     * @return {true, "success"}, or {false, err_message} listing the fields missing from the
+     * header, which are then left value initialized.
+     */
+    auto MapHeader(std::string_view a_header)
+    {
+        static constexpr std::array<std::string_view, field_count> names{Ts::field_name...};
+        static constexpr std::array<bool, field_count> skipped{std::is_same_v<typename Ts::value_type, Skipped>...};
+
+        column_map_.clear();
+        auto found = std::bitset<field_count>{};
+        if (a_header.starts_with("\xEF\xBB\xBF")) a_header.remove_prefix(3);
+
+        for (const auto name: a_header | std::views::split(delimiter)) {
+            auto text = std::string_view{name.begin(), name.end()};
+            auto trim = [&text](std::string_view a_chars) {
+                while (!text.empty() && a_chars.find(text.front()) != std::string_view::npos) text.remove_prefix(1);
+                while (!text.empty() && a_chars.find(text.back()) != std::string_view::npos) text.remove_suffix(1);
+            };
+            trim(" \r");
+            if (text.size() >= 2 && text.front() == quote && text.back() == quote) text = text.substr(1, text.size() - 2);
+            trim(" ");
+
+            const auto it = std::ranges::find(names, text);
+            const auto slot = static_cast<size_t>(it - names.begin());
+            const bool bound = it != names.end() && !skipped[slot] && !found[slot];
+            if (bound) found.set(slot);
+            column_map_.push_back(bound ? slot : unmapped);
+        }
+
+        while (!column_map_.empty() && column_map_.back() == unmapped) column_map_.pop_back();
+        if (column_map_.empty()) column_map_.push_back(unmapped);
+
+        std::string missing;
+        for (size_t i = 0; i < field_count; i++)
+            if (!found[i] && !skipped[i]) missing.append(missing.empty() ? "" : ", ").append(names[i]);
+
+        const bool ok = missing.empty();
+        return std::make_tuple(ok, ok ? std::string{"success"} : std::format("Missing columns: {}", missing));
+    }
+
+    /*!
+     * The column map built by MapHeader, to be shared with the other documents reading the same file.
+     */
+    [[nodiscard]] const ColumnMap &column_map() const noexcept
+    {
+        return column_map_;
+    }
+
+    /*!
+     * Sets the column map, as built by MapHeader of another document, or clears it if empty.
+     */
+    void set_column_map(ColumnMap a_map)
+    {
+        column_map_ = std::move(a_map);
+    }
+
     /*!
      * Makes a record using a comma separated string line.
      * Precondition - a_line must not be empty.
@@ -193,29 +463,574 @@ struct CsvDoc
         make_record_impl(a_rec, b, e);
     }
 
+    /*!
+     * Same as make_record, except that each field is unescaped, i.e. its enclosing quotes are
+     * removed and its escaped quotes undone, and NUL-terminated, in place in the line, so that
+     * the std::string_view values can be handed to C APIs, e.g. strtod, with no copy. The line
+     * is modified; read it from a mio::mmap_private to leave the file unchanged.
+     * @code
+     *   mio::mmap_private map(path);
+     *   doc.make_record_in_place(rec, std::span<char>{map.data(), line.size()});
+     * @endcode
+     * Precondition - a_line must not be empty, and the byte after it, e.g. its `\n`, must be
+     * writable, since it may be overwritten by the NUL of the last field.
+     * @param a_rec Reference to an existing record.
+     * @param a_line Comma separated data line excluding `\n', possibly with comma enclosed in double quotes.
+     */
+    void make_record_in_place(Record &a_rec, std::span<char> a_line)
+    {
+        static constexpr std::array<bool, field_count> quoted{Ts::Quoted::value...};
+
+        char *b = a_line.data();
+        char *e = std::next(b, static_cast<std::ptrdiff_t>(a_line.size()));
+        const auto count = column_map_.empty() ? needed_field_count : column_map_.size();
+        for (size_t i = 0; i < count; i++) {
+            const auto slot = slot_of(i);
+            const char *end = slot == unmapped || quoted[slot] ? find_field_end<true>(b, e) : find_field_end<false>(b, e);
+            char *find_pos = std::next(b, end - b);
+            const auto last = find_pos == e;
+            if (slot != unmapped) parse_slot(slot, a_rec, unescape_in_place(b, find_pos));
+            if (last) return;
+            b = std::next(find_pos);
+        }
+    }
+
+    /*!
+     * Removes the enclosing quotes of the field [a_begin, a_end), and undoes its escaped quotes,
+     * moving the text to a_begin, then writes a NUL after it, at a_end at most.
+     * @return The unescaped text, followed by a NUL.
+     */
+    static std::string_view unescape_in_place(char *a_begin, char *a_end) noexcept
+    {
+        char *out = a_end;
+        if (a_begin != a_end && *a_begin == quote) {
+            out = a_begin;
+            for (const char *p = a_begin; p != a_end; ++p) {
+                if constexpr (Dialect::has_escape) {
+                    if (*p == escape && std::next(p) != a_end && (p[1] == quote || p[1] == escape)) {
+                        *out++ = *++p;
+                        continue;
+                    }
+                } else {
+                    // An escaped `""` inside the quotes, the second one closes the quoted section.
+                    if (*p == quote && p != a_begin && std::next(p) != a_end && p[1] == quote) {
+                        *out++ = *++p;
+                        continue;
+                    }
+                }
+                if (*p != quote) *out++ = *p;
+            }
+        }
+        *out = '\0';
+        return {a_begin, out};
+    }
+
+    /*!
+     * Makes a projection of a record using a comma separated string line, with only the fields
+     * of the given indexes, in the given order. The line is scanned up to the last of those
+     * fields only, and the other fields are not converted.
+     * @code
+     *   auto [speed, id] = doc.project<2, 0>(line);
+     * @endcode
+     * Precondition - a_line must not be empty.
+     * @tparam I Indexes of the fields in the schema.
+     * @param a_line Comma separated data line excluding `\n', possibly with comma enclosed in double quotes.
+     * @return A std::tuple of the projected fields.
+     */
+    template<size_t ...I>
+    requires (sizeof...(I) > 0 && ((I < field_count) && ...))
+    auto project(std::string_view a_line)
+    {
+        std::tuple<std::tuple_element_t<I, Record>...> result{};
+        constexpr std::array<size_t, sizeof...(I)> indexes{I...};
+
+        const char *b = a_line.data();
+        const char *e = std::next(b, a_line.size());
+        scan_fields<std::ranges::max(indexes) + 1>(b, e, [&]<size_t J>(std::integral_constant<size_t, J>, std::string_view a_text) {
+            [&]<size_t ...K>(std::index_sequence<K...>) {
+                ((indexes[K] == J ? parse_field_counted(a_text, std::get<K>(result).data) : void()), ...);
+            }(std::index_sequence_for<decltype(I)...>{});
+        });
+        return result;
+    }
+
+    /*!
+     * A record that keeps only the view of its line, and finds the boundaries of its fields on
+     * first access, as far as the field accessed, so that a narrow query over a wide schema
+     * scans only the head of each line, and converts only the fields it reads. The line must
+     * outlive the record. Not thread safe, even when const.
+     * @code
+     *   auto rec = doc.make_lazy_record(line);
+     *   if (rec.get<3>() > 60.0) ids.push_back(rec.get<0>());
+     * @endcode
+     */
+    class LazyRecord
+    {
+    public:
+        LazyRecord() = default;
+
+        explicit LazyRecord(std::string_view a_line) noexcept: line_{a_line}
+        {
+        }
+
+        [[nodiscard]] std::string_view line() const noexcept
+        {
+            return line_;
+        }
+
+        /*!
+         * Text of a field, including the quotes if any, or empty if the line has fewer fields.
+         */
+        template<size_t I>
+        requires (I < field_count)
+        [[nodiscard]] std::string_view text() const
+        {
+            scan_to(I);
+            if (I >= found_) return {};
+            const auto start = I == 0 ? size_t{0} : size_t{ends_[I - 1]} + 1;
+            return line_.substr(start, ends_[I] - start);
+        }
+
+        /*!
+         * Value of a field, converted by parse_field, value initialized on failure.
+         */
+        template<size_t I>
+        requires (I < field_count)
+        [[nodiscard]] auto get() const
+        {
+            typename std::tuple_element_t<I, Record>::value_type value;
+            parse_field(text<I>(), value);
+            return value;
+        }
+
+        /*!
+         * Converts a field by parse_field.
+         * @return false if the text of the field is not a valid value.
+         */
+        template<size_t I>
+        requires (I < field_count)
+        bool get(typename std::tuple_element_t<I, Record>::value_type &a_value) const
+        {
+            return parse_field(text<I>(), a_value);
+        }
+
+    private:
+        static constexpr std::array<bool, field_count> quoted{Ts::Quoted::value...};
+
+        void scan_to(size_t a_index) const
+        {
+            const char *b = line_.data();
+            const char *e = std::next(b, line_.size());
+            while (found_ <= a_index && (found_ == 0 || ends_[found_ - 1] != line_.size())) {
+                const char *start = found_ == 0 ? b : std::next(b, ends_[found_ - 1] + 1);
+                const char *end = quoted[found_] ? find_field_end<true>(start, e) : find_field_end<false>(start, e);
+                ends_[found_++] = static_cast<uint32_t>(end - b);
+            }
+        }
+
+        std::string_view line_;
+        mutable std::array<uint32_t, field_count> ends_{};
+        mutable size_t found_{0};
+    };
+
+    /*!
+     * Makes a lazy record using a comma separated string line, see LazyRecord.
+     * @param a_line Comma separated data line excluding `\n', possibly with comma enclosed in double quotes.
+     */
+    static LazyRecord make_lazy_record(std::string_view a_line) noexcept
+    {
+        return LazyRecord{a_line};
+    }
+
+    /*!
+     * Returns a lazy view of the records of the lines of a reader, made one by one with
+     * make_record as the view is iterated, so that it composes with std::views::filter,
+     * std::views::take and the like, and a query stopping early reads no further. Empty lines
+     * are skipped, and a `\r` before `\n` is excluded from the last field.
+     *
+     * The view refers to this document and to the reader, which must both outlive it.
+     * @param a_reader A reader providing lines(), e.g. StringReader.
+     * @param a_skip_header Whether the first line is a header line, not a record.
+     * @return A forward range of CsvDoc::Record.
+     */
+    template<typename Reader>
+    requires requires(const Reader &a_reader) { { a_reader.lines() } -> std::ranges::forward_range; }
+    auto records(const Reader &a_reader, bool a_skip_header = true)
+    {
+        return record_lines(a_reader, a_skip_header)
+            | std::views::transform([this](std::string_view a_line) { return make_record(a_line); });
+    }
+
+    /*!
+     * Same as records, with LazyRecord instead of CsvDoc::Record, so that the fields not read
+     * by the consumer are neither converted, nor, past the last one read, scanned.
+     * @return A forward range of CsvDoc::LazyRecord.
+     */
+    template<typename Reader>
+    requires requires(const Reader &a_reader) { { a_reader.lines() } -> std::ranges::forward_range; }
+    static auto lazy_records(const Reader &a_reader, bool a_skip_header = true)
+    {
+        return record_lines(a_reader, a_skip_header) | std::views::transform(make_lazy_record);
+    }
+
+    /*!
+     * Makes records in bulk from a block of lines, one record per line. The block is scanned
+     * 64 bytes at a time for the delimiters and line ends outside of double quotes, see
+     * scan_structurals, and the fields of many records are then sliced out of the flat array
+     * of offsets, with no further searching.
+     *
+     * Unlike make_record, quotes are honoured in every field, so quoted fields may contain
+     * `\n`. Empty lines are skipped. A line with fewer fields than the schema leaves the
+     * remaining fields empty, extra fields are ignored, and a `\r` before `\n` is excluded
+     * from the last field.
+     * @param a_block Csv lines, the last of which may not be terminated by `\n`.
+     * @param a_on_record Callback invoked as a_on_record(const Record &) for each record.
+     * If a non-zero status code is returned, stops immediately.
+     * @return Number of records made, not counting the one the callback stopped at.
+     */
+    template<typename F>
+    size_t make_records(std::string_view a_block, F &&a_on_record)
+    {
+        WXLIB_TRACE_SPAN("csv.make_records");
+        Record rec{};
+        return for_each_line(a_block, [&](const Fields &a_fields) {
+            assign_fields(rec, a_fields, std::make_index_sequence<field_count>{});
+            return a_on_record(std::as_const(rec));
+        });
+    }
+
+    /*!
+     * Text of the fields of a record, in the order of the schema, with no conversion.
+     */
+    using Fields = std::array<std::string_view, field_count>;
+
+    /*!
+     * Slices the fields of the records of a block of lines the same way as make_records, but
+     * hands their text to a_on_fields(const Fields &) with no conversion, e.g. to encode them
+     * straight to another format. The views are of a_block, and only valid for the duration of
+     * the call. Skipped fields are sliced too, and unmapped ones are empty.
+     * @param a_block Csv lines, the last of which may not be terminated by `\n`.
+     * @param a_on_fields Callback invoked for each record. If a non-zero status code is
+     * returned, stops immediately.
+     * @return Number of records handled, not counting the one the callback stopped at.
+     */
+    template<typename F>
+    size_t make_fields(std::string_view a_block, F &&a_on_fields)
+    {
+        WXLIB_TRACE_SPAN("csv.make_fields");
+        return for_each_line(a_block, std::forward<F>(a_on_fields));
+    }
+
+    /*!
+     * Columnar storage of records, one contiguous column per field, in the order of the schema.
+     * A filter or an aggregate over a single field touches only the memory of its column.
+     * @code
+     *   auto &speed = std::get<2>(columns);
+     * @endcode
+     */
+    using Columns = std::tuple<std::vector<typename Ts::value_type>...>;
+
+    /*!
+     * Columns allocated from a memory resource, e.g. a mio::arena_memory_resource, and so are the
+     * std::pmr::string fields, so that a whole batch of records is freed at once.
+     * @code
+     *   auto columns = Doc::make_pmr_columns(&arena);
+     *   doc.make_columns(block, columns);
+     * @endcode
+     */
+    using PmrColumns = std::tuple<std::pmr::vector<typename Ts::value_type>...>;
+
+    static PmrColumns make_pmr_columns(std::pmr::memory_resource *a_resource)
+    {
+        return PmrColumns{std::pmr::vector<typename Ts::value_type>(a_resource)...};
+    }
+
+    /*!
+     * Makes records in bulk from a block of lines, same as make_records, and appends their
+     * fields to the columns. std::string_view fields are views of a_block, which must then
+     * outlive the columns.
+     * @param a_block Csv lines, the last of which may not be terminated by `\n`.
+     * @param a_columns Columns to which the fields of each record are appended.
+     * @return Number of records appended.
+     */
+    template<typename ColumnsT>
+    requires std::is_same_v<ColumnsT, Columns> || std::is_same_v<ColumnsT, PmrColumns>
+    size_t make_columns(std::string_view a_block, ColumnsT &a_columns)
+    {
+        WXLIB_TRACE_SPAN("csv.make_columns");
+        return for_each_line(a_block, [&](const Fields &a_fields) {
+            append_fields(a_columns, a_fields, std::make_index_sequence<field_count>{});
+            return 0;
+        });
+    }
+
     bool header_on_first_line{true};
 
+    /*!
+     * Number of fields that failed to convert to their value type, see parse_field. Those
+     * fields are value initialized.
+     */
+    size_t invalid_field_count{0};
+
+    /*!
+     * Whether make_records and make_columns validate the blocks as UTF-8, in the same pass as
+     * the structural chars are found, see scan_structurals. make_record does not.
+     */
+    bool validate_utf8{false};
+
+    /*!
+     * Positions, in the blocks given to make_records and make_columns, of the invalid UTF-8
+     * sequences, if validate_utf8. The records are made all the same, with the invalid bytes.
+     */
+    std::vector<const char *> utf8_errors;
+
 private:
-    template<size_t I = 0>
-    void make_record_impl(Record &a_rec, const char *a_begin, const char *a_end)
+    // Lines are scanned a window at a time, which keeps the offsets in cache and in 32 bits.
+    static constexpr size_t scan_window_size = 1 << 20;
+
+    /*!
+     * Scans whole lines from a_begin, about scan_window_size bytes, for the structural chars.
+     * A window always starts at the beginning of a line, hence outside of quotes.
+     * @return The end of the window, just past its last `\n`, or a_end.
+     */
+    const char *scan_window(const char *a_begin, const char *a_end)
     {
-        if constexpr (I == field_count) {
-            return;
-        } else {
-            const char *find_pos = nullptr;
-            if constexpr (std::remove_cvref_t<decltype(get<I>(a_rec))>::Quoted::value) {
-                find_pos = fast_find<'"'>(a_begin, a_end); // opening quote
-                find_pos = fast_find<'"'>(std::next(find_pos), a_end); // closing quote
-                find_pos = fast_find<','>(find_pos, a_end); // comma
+        for (auto size = scan_window_size;; size *= 2) {
+            const char *e = static_cast<size_t>(a_end - a_begin) > size ? std::next(a_begin, static_cast<std::ptrdiff_t>(size)) : a_end;
+            offsets_.clear();
+            utf8_offsets_.clear();
+            if (validate_utf8)
+                scan_structurals<Dialect>(a_begin, e, offsets_, utf8_offsets_);
+            else
+                scan_structurals<Dialect>(a_begin, e, offsets_);
+            if (e == a_end) return keep_utf8_errors(a_begin, e);
+
+            // Drop the partial line at the end, to be scanned again with the next window.
+            auto it = std::find_if(offsets_.rbegin(), offsets_.rend(), [a_begin](uint32_t o) { return a_begin[o] == '\n'; });
+            if (it != offsets_.rend()) {
+                offsets_.erase(it.base(), offsets_.end());
+                return keep_utf8_errors(a_begin, std::next(a_begin, static_cast<std::ptrdiff_t>(offsets_.back()) + 1));
+            }
+        }
+    }
+
+    /*!
+     * Keeps the UTF-8 errors of a window found before its end, those after it being scanned again.
+     * @return a_window_end
+     */
+    const char *keep_utf8_errors(const char *a_begin, const char *a_window_end)
+    {
+        for (auto o: utf8_offsets_)
+            if (std::next(a_begin, o) < a_window_end) utf8_errors.push_back(std::next(a_begin, o));
+        return a_window_end;
+    }
+
+    /*!
+     * Slices the fields of every line in the block out of the structural offsets, and calls
+     * a_on_fields(const Fields &) for each line, see make_records.
+     * @return Number of lines handled, not counting the one the callback stopped at.
+     */
+    template<typename F>
+    size_t for_each_line(std::string_view a_block, F &&a_on_fields)
+    {
+        auto count = size_t{0};
+        const char *end = std::next(a_block.data(), static_cast<std::ptrdiff_t>(a_block.size()));
+        Fields fields{};
+
+        for (const char *b = a_block.data(); b != end;) {
+            const char *window_end = scan_window(b, end);
+            const auto window_size = static_cast<uint32_t>(window_end - b);
+
+            // The last line may not be terminated by `\n`.
+            if (offsets_.empty() || offsets_.back() + 1 != window_size || b[offsets_.back()] != '\n')
+                offsets_.push_back(window_size);
+
+            auto i = size_t{0};
+            auto start = uint32_t{0};
+            for (auto o: offsets_) {
+                const bool eol = o == window_size || b[o] == '\n';
+                auto stop = o;
+                if (eol && stop > start && b[stop - 1] == '\r') stop--;
+
+                const bool blank = i == 0 && stop == start;
+                if (const auto slot = slot_of(i); slot != unmapped) fields[slot] = {std::next(b, start), stop - start};
+                i++;
+                start = o + 1;
+
+                if (!eol) continue;
+                if (!blank) {
+                    if (column_map_.empty()) for (; i < field_count; i++) fields[i] = {};
+                    if (a_on_fields(std::as_const(fields)) != 0) return count;
+                    count++;
+                }
+                if (!column_map_.empty()) fields = {};
+                i = 0;
+            }
+
+            b = window_end;
+        }
+
+        return count;
+    }
+
+    template<typename V>
+    void parse_field_counted(std::string_view a_text, V &a_value)
+    {
+        invalid_field_count += !parse_field(a_text, a_value);
+    }
+
+    template<size_t ...I>
+    void assign_fields(Record &a_rec, const Fields &a_fields, std::index_sequence<I...>)
+    {
+        (parse_field_counted(a_fields[I], std::get<I>(a_rec).data), ...);
+    }
+
+    template<typename ColumnsT, size_t ...I>
+    void append_fields(ColumnsT &a_columns, const Fields &a_fields, std::index_sequence<I...>)
+    {
+        auto append = [this](std::string_view a_text, auto &a_column) {
+            using Column = std::remove_cvref_t<decltype(a_column)>;
+            if constexpr (std::uses_allocator_v<typename Column::value_type, typename Column::allocator_type>) {
+                // Constructed in place, with the allocator of the column, e.g. of std::pmr ones.
+                parse_field_counted(a_text, a_column.emplace_back());
             } else {
-                find_pos = fast_find<','>(a_begin, a_end);
+                typename Column::value_type value;
+                parse_field_counted(a_text, value);
+                a_column.push_back(std::move(value));
+            }
+        };
+
+        (append(a_fields[I], std::get<I>(a_columns)), ...);
+    }
+
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> utf8_offsets_;
+
+    // One past the last field that is not skipped, the fields after it are never scanned.
+    static constexpr size_t needed_field_count = [] {
+        auto count = size_t{0}, i = size_t{0};
+        ((i++, count = std::is_same_v<typename Ts::value_type, Skipped> ? count : i), ...);
+        return count;
+    }();
+
+    template<typename Reader>
+    static auto record_lines(const Reader &a_reader, bool a_skip_header)
+    {
+        return a_reader.lines()
+            | std::views::drop(a_skip_header ? 1 : 0)
+            | std::views::filter([](std::string_view a_line) { return !a_line.empty() && a_line != "\r"; })
+            | std::views::transform([](std::string_view a_line) {
+                  if (a_line.back() == '\r') a_line.remove_suffix(1);
+                  return a_line;
+              });
+    }
+
+    /*!
+     * @return The end of the field starting at a_begin, i.e. the position of its delimiter, or a_end.
+     */
+    template<bool quoted>
+    static const char *find_field_end(const char *a_begin, const char *a_end)
+    {
+        if constexpr (quoted && Dialect::has_escape) {
+            // The escape char escapes the quote and itself only, anywhere in the field.
+            auto in_quotes = false;
+            for (auto found = fast_find_any<quote, delimiter, escape>(a_begin, a_end); found.pos != a_end;
+                 found = fast_find_any<quote, delimiter, escape>(std::next(found.pos), a_end)) {
+                if (found.match == escape) {
+                    if (std::next(found.pos) == a_end) break;
+                    if (found.pos[1] == quote || found.pos[1] == escape) found.pos++;
+                } else if (found.match == quote) {
+                    in_quotes = !in_quotes;
+                } else if (!in_quotes) {
+                    return found.pos;
+                }
             }
+            return a_end;
+        } else if constexpr (quoted) {
+            // A single pass for the first quote or delimiter; delimiters enclosed in quotes are
+            // skipped, and an escaped `""` simply closes and reopens the quoted section.
+            auto found = fast_find_any<quote, delimiter>(a_begin, a_end);
+            while (found.match == quote) {
+                found.pos = fast_find<quote>(std::next(found.pos), a_end); // closing quote
+                if (found.pos == a_end) break;
+                found = fast_find_any<quote, delimiter>(std::next(found.pos), a_end);
+            }
+            return found.pos;
+        } else {
+            return fast_find<delimiter>(a_begin, a_end);
+        }
+    }
 
-            std::get<I>(a_rec).data = {a_begin, find_pos};
-            return find_pos != a_end ? a_begin = std::next(find_pos), make_record_impl<I + 1>(a_rec, a_begin, a_end) : void();
+    /*!
+     * Calls a_on_field(std::integral_constant<size_t, I>, std::string_view) for each of the
+     * first Count fields of a line, stopping early if the line has fewer.
+     */
+    template<size_t Count, size_t I = 0, typename F>
+    static void scan_fields(const char *a_begin, const char *a_end, F &&a_on_field)
+    {
+        if constexpr (I == Count) {
+            return;
+        } else {
+            const char *find_pos = find_field_end<std::tuple_element_t<I, Record>::Quoted::value>(a_begin, a_end);
+            a_on_field(std::integral_constant<size_t, I>{}, std::string_view{a_begin, find_pos});
+            return find_pos != a_end ? scan_fields<Count, I + 1>(std::next(find_pos), a_end, a_on_field) : void();
         }
     }
+
+    size_t slot_of(size_t a_column) const noexcept
+    {
+        if (column_map_.empty()) return a_column < field_count ? a_column : unmapped;
+        return a_column < column_map_.size() ? column_map_[a_column] : unmapped;
+    }
+
+    void make_record_impl(Record &a_rec, const char *a_begin, const char *a_end)
+    {
+        if (!column_map_.empty()) return make_mapped_record_impl(a_rec, a_begin, a_end);
+
+        scan_fields<needed_field_count>(a_begin, a_end, [&]<size_t I>(std::integral_constant<size_t, I>, std::string_view a_text) {
+            parse_field_counted(a_text, std::get<I>(a_rec).data);
+        });
+    }
+
+    /*!
+     * Same as make_record_impl, scanning the columns in file order, see MapHeader.
+     */
+    void make_mapped_record_impl(Record &a_rec, const char *a_begin, const char *a_end)
+    {
+        static constexpr std::array<bool, field_count> quoted{Ts::Quoted::value...};
+
+        for (const auto slot: column_map_) {
+            // Unknown columns may have quotes, and are stepped over as quoted fields.
+            const char *find_pos = slot == unmapped || quoted[slot] ? find_field_end<true>(a_begin, a_end) : find_field_end<false>(a_begin, a_end);
+            if (slot != unmapped) parse_slot(slot, a_rec, {a_begin, find_pos});
+            if (find_pos == a_end) return;
+            a_begin = std::next(find_pos);
+        }
+    }
+
+    /*!
+     * Converts a_text to the field of the schema at index a_slot, known at run time only.
+     */
+    void parse_slot(size_t a_slot, Record &a_rec, std::string_view a_text)
+    {
+        using Parse = void (*)(BasicCsvDoc &, Record &, std::string_view);
+        static constexpr auto parsers = []<size_t ...I>(std::index_sequence<I...>) {
+            return std::array<Parse, field_count>{[](BasicCsvDoc &a_doc, Record &a_rec, std::string_view a_text) {
+                a_doc.parse_field_counted(a_text, std::get<I>(a_rec).data);
+            }...};
+        }(std::make_index_sequence<field_count>{});
+
+        parsers[a_slot](*this, a_rec, a_text);
+    }
+
+    ColumnMap column_map_;
 };
 
+/*!
+ * A comma separated document, see BasicCsvDoc.
+ */
+template<typename ...Ts>
+using CsvDoc = BasicCsvDoc<CommaDialect, Ts...>;
+
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,316 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_CSV_READER_HPP
+#define WXLIB_MIO_CSV_READER_HPP
+
+#include <mio/csvdoc.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * Reads a csv file in parallel. The file is memory mapped, its header line verified once, and
+ * its records parsed in bulk (see CsvDoc::make_records) on a pool of worker threads pulling
+ * blocks of lines from a shared queue (see StringReader::async_getblock). Each worker has its
+ * own CsvDoc, and hands the records to the sink in the context of its thread, either in
+ * batches of records, or in columnar blocks. The blocks are never cut inside double quotes,
+ * so quoted fields may contain `\n`. The dialect, see CsvDialect, sets the delimiter, quote and
+ * escape chars, CsvReader being the comma separated one.
+ *
+ * @code
+ *   mio::csv::CsvReader<Field<NAME("id"), int64_t>, Field<NAME("speed"), double>> reader("links.csv");
+ *
+ *   auto n = reader.read([](int a_worker_id, auto a_records) {
+ *       for (const auto &rec : a_records) {
+ *           // ... do something about the record, e.g. get<1>(rec).data.
+ *       }
+ *       return 0; // 0 for success, non-zero for errors. Must not throw exception.
+ *   });
+ * @endcode
+ */
+template<typename Dialect, typename ...Ts>
+class BasicCsvReader
+{
+public:
+    using Doc = BasicCsvDoc<Dialect, Ts...>;
+    using Record = typename Doc::Record;
+    using Columns = typename Doc::Columns;
+
+    /*!
+     * Maximum number of records handed to the sink at a time.
+     */
+    static constexpr size_t batch_size = StringReaderAsync::batch_size;
+
+    /*!
+     * Default size of the blocks of lines the workers claim at a time.
+     */
+    static constexpr size_t default_chunk_size = StringReaderAsync::default_chunk_size;
+
+    /*!
+     * Constructs a reader for a csv file. If the file does not exist, std::system_error will be
+     * thrown with error code describing the nature of the error.
+     * @param a_file The csv file to read. It must exist.
+     */
+    explicit BasicCsvReader(const std::string &a_file) : reader_{a_file}
+    {
+    }
+
+    BasicCsvReader(const BasicCsvReader &) = delete;
+    BasicCsvReader(BasicCsvReader &&) = delete;
+    BasicCsvReader &operator=(BasicCsvReader &) = delete;
+    BasicCsvReader &operator=(BasicCsvReader &&) = delete;
+    ~BasicCsvReader() = default;
+
+    /*!
+     * Checks whether the file has been successfully mapped.
+     */
+    [[nodiscard]] bool is_mapped() const noexcept
+    {
+        return reader_.is_mapped();
+    }
+
+    /*!
+     * Verifies the header line against the schema, see CsvDoc::VerifyHeader, or maps its columns
+     * to the schema by name if map_columns_by_name, see CsvDoc::MapHeader. Always succeeds if
+     * header_on_first_line is false.
+     * @return {true, message} for success, {false, err_message} for error.
+     */
+    auto verify_header()
+    {
+        if (!header_on_first_line) return std::make_tuple(true, std::string{"success"});
+        Doc doc;
+        return map_columns_by_name ? doc.MapHeader(header()) : doc.VerifyHeader(header());
+    }
+
+    /*!
+     * Reads all records in parallel, and hands them to the sink in batches of up to batch_size
+     * records, invoked as a_sink(int worker_id, std::span<const Record> records). The records of a
+     * batch are only valid for the duration of the call. If a non-zero status code is returned,
+     * the worker stops, and none of the records of that batch are counted.
+     *
+     * Nothing is read if the header line does not match the schema, see verify_header.
+     * Precondition - CsvReader::is_mapped() must be true.
+     * @param a_sink The sink for each batch of records.
+     * @param a_num_threads Number of worker threads, 0 treated as 1.
+     * @param a_chunk_size Approximate size in bytes of the blocks of lines claimed by the workers.
+     * @return Total number of records read.
+     */
+    template<typename F>
+    size_t read(const F &a_sink, size_t a_num_threads = available_concurrency(), size_t a_chunk_size = default_chunk_size)
+    {
+        auto batches = std::vector<std::vector<Record>>(std::max(a_num_threads, size_t{1}));
+
+        return read_blocks(a_num_threads, a_chunk_size, [&](int a_id, Doc &a_doc, std::string_view a_block, size_t &a_count) {
+            auto &batch = batches[a_id];
+            auto status = 0;
+            auto flush = [&]() {
+                status = a_sink(a_id, std::span<const Record>{batch});
+                if (status == 0) a_count += batch.size();
+                batch.clear();
+                return status;
+            };
+
+            a_doc.make_records(a_block, [&](const Record &a_rec) {
+                batch.push_back(a_rec);
+                return batch.size() == batch_size ? flush() : 0;
+            });
+
+            return (status == 0 && !batch.empty()) ? flush() : status;
+        });
+    }
+
+    /*!
+     * Reads all records in parallel, and hands them to the sink one columnar block at a time,
+     * invoked as a_sink(int worker_id, Columns &columns), see CsvDoc::Columns. Each block holds
+     * the records of a block of lines claimed by the worker. The sink may move the columns out;
+     * they are cleared after the call. If a non-zero status code is returned, the worker stops,
+     * and none of the records of that block are counted.
+     *
+     * Nothing is read if the header line does not match the schema, see verify_header.
+     * Precondition - CsvReader::is_mapped() must be true.
+     * @param a_sink The sink for each columnar block.
+     * @param a_num_threads Number of worker threads, 0 treated as 1.
+     * @param a_chunk_size Approximate size in bytes of the blocks of lines claimed by the workers.
+     * @return Total number of records read.
+     */
+    template<typename F>
+    size_t read_columns(const F &a_sink, size_t a_num_threads = available_concurrency(), size_t a_chunk_size = default_chunk_size)
+    {
+        auto columns = std::vector<Columns>(std::max(a_num_threads, size_t{1}));
+
+        return read_blocks(a_num_threads, a_chunk_size, [&](int a_id, Doc &a_doc, std::string_view a_block, size_t &a_count) {
+            auto &cols = columns[a_id];
+            const auto n = a_doc.make_columns(a_block, cols);
+            const auto status = a_sink(a_id, cols);
+            if (status == 0) a_count += n;
+
+            std::apply([](auto &...a_column) { (a_column.clear(), ...); }, cols);
+            return status;
+        });
+    }
+
+    /*!
+     * Reads all records in parallel, and hands the blocks of lines claimed by the workers to the
+     * sink as they are, invoked as a_sink(int worker_id, Doc &doc, std::string_view block,
+     * size_t &count), the doc being the one of the worker with the column map of the read, e.g.
+     * to slice the fields with Doc::make_fields and encode them with no Record in between. The
+     * blocks follow one another in body(), with no gap, the header line being cut from the first
+     * one. The sink adds the records it handled to count. If a non-zero status code is returned,
+     * the workers stop.
+     *
+     * Nothing is read if the header line does not match the schema, see verify_header.
+     * Precondition - CsvReader::is_mapped() must be true.
+     * @param a_sink The sink for each block of lines.
+     * @param a_num_threads Number of worker threads, 0 treated as 1.
+     * @param a_chunk_size Approximate size in bytes of the blocks of lines claimed by the workers.
+     * @return Total number of records counted by the sink.
+     */
+    template<typename F>
+    size_t read_fields(const F &a_sink, size_t a_num_threads = available_concurrency(), size_t a_chunk_size = default_chunk_size)
+    {
+        return read_blocks(a_num_threads, a_chunk_size, a_sink);
+    }
+
+    /*!
+     * The records of the file, i.e. its content after the header line, or after a byte order
+     * mark if header_on_first_line is false.
+     */
+    [[nodiscard]] std::string_view body() const noexcept
+    {
+        const auto content = reader_.content();
+        return header_on_first_line ? content.substr(std::min(header_size(), content.size())) : skip_utf8_bom(content);
+    }
+
+    /*!
+     * Number of fields that failed to convert to their value type in the last read, see
+     * CsvDoc::invalid_field_count.
+     */
+    [[nodiscard]] size_t invalid_field_count() const noexcept
+    {
+        return invalid_field_count_;
+    }
+
+    /*!
+     * File offsets of the invalid UTF-8 sequences found by the last read, in ascending order, if
+     * validate_utf8.
+     */
+    [[nodiscard]] const std::vector<size_t> &utf8_errors() const noexcept
+    {
+        return utf8_errors_;
+    }
+
+    /*!
+     * Statistics of the last read, the callback time being the time spent parsing and in the
+     * sink, see StringReader::stats; empty unless built with WXLIB_MIO_WITH_STATS defined.
+     */
+    [[nodiscard]] const ReaderStats &stats() const noexcept
+    {
+        return reader_.stats();
+    }
+
+    bool header_on_first_line{true};
+
+    /*!
+     * Whether the columns are matched to the schema by the names of the header line, in any
+     * order and with extra columns, instead of by position. The column map is built once per
+     * read, and shared by the workers.
+     */
+    bool map_columns_by_name{false};
+
+    /*!
+     * Whether the file is validated as UTF-8 while its records are parsed, in the same pass as
+     * the structural chars are found, see CsvDoc::validate_utf8 and utf8_errors. A leading byte
+     * order mark is always skipped.
+     */
+    bool validate_utf8{false};
+
+private:
+    /*!
+     * The header line, excluding a byte order mark, `\n`, and a trailing `\r`.
+     */
+    std::string_view header() const noexcept
+    {
+        auto line = skip_utf8_bom(reader_.content().substr(0, header_size() - 1));
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return line;
+    }
+
+    /*!
+     * Size of the header line, including `\n`.
+     */
+    size_t header_size() const noexcept
+    {
+        const auto content = reader_.content();
+        const char *end = std::next(content.data(), static_cast<std::ptrdiff_t>(content.size()));
+        return static_cast<size_t>(fast_find<'\n'>(content.data(), end) - content.data()) + 1;
+    }
+
+    /*!
+     * Runs a_on_block(worker_id, doc, block, count) for every block of lines on the workers,
+     * with the header line cut from the first block.
+     * @return Total number of records counted by the workers.
+     */
+    template<typename F>
+    size_t read_blocks(size_t a_num_threads, size_t a_chunk_size, const F &a_on_block)
+    {
+        invalid_field_count_ = 0;
+        utf8_errors_.clear();
+        auto column_map = typename Doc::ColumnMap{};
+        if (header_on_first_line && map_columns_by_name) {
+            Doc doc;
+            if (!std::get<0>(doc.MapHeader(header()))) return 0;
+            column_map = doc.column_map();
+        } else if (!std::get<0>(verify_header())) {
+            return 0;
+        }
+
+        const auto num_threads = std::max(a_num_threads, size_t{1});
+        const auto content = reader_.content();
+        const auto body = content.size() - this->body().size();
+
+        auto docs = std::vector<std::unique_ptr<Doc>>{};
+        for (size_t i = 0; i < num_threads; i++) {
+            docs.push_back(std::make_unique<Doc>());
+            docs.back()->set_column_map(column_map);
+            docs.back()->validate_utf8 = validate_utf8;
+        }
+        auto counts = std::vector<size_t>(num_threads, 0);
+
+        reader_.async_getblock<Dialect::quote, Dialect::escape>([&](int a_id, std::string_view a_block) {
+            if (a_block.data() == content.data()) a_block.remove_prefix(std::min(body, a_block.size()));
+            return a_on_block(a_id, *docs[a_id], a_block, counts[a_id]);
+        }, num_threads, a_chunk_size, true);
+
+        for (const auto &doc: docs) {
+            invalid_field_count_ += doc->invalid_field_count;
+            for (const auto *pos: doc->utf8_errors) utf8_errors_.push_back(static_cast<size_t>(pos - content.data()));
+        }
+        std::sort(utf8_errors_.begin(), utf8_errors_.end());
+        return std::accumulate(counts.begin(), counts.end(), size_t{0});
+    }
+
+    StringReaderAsync reader_;
+    size_t invalid_field_count_{0};
+    std::vector<size_t> utf8_errors_;
+};
+
+/*!
+ * Reads a comma separated file, see BasicCsvReader.
+ */
+template<typename ...Ts>
+using CsvReader = BasicCsvReader<CommaDialect, Ts...>;
+
+}
+#endif
@@ -0,0 +1,393 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_CSV_SCAN_HPP
+#define WXLIB_MIO_CSV_SCAN_HPP
+
+#include <mio/fastfind.hpp>
+#include <mio/utf8.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * A csv dialect, the chars the scanning kernels are specialized for at compile time.
+ * @tparam Delimiter The field delimiter.
+ * @tparam Quote The char enclosing the fields that may have delimiters or `\n`.
+ * @tparam Escape The char escaping a quote, or itself, within a field, e.g. `\\`. The
+ * default, same as the quote, stands for the doubled quotes of RFC 4180, `""`, which need no
+ * special handling, since they close and reopen the quoted section.
+ */
+template<char Delimiter = ',', char Quote = '"', char Escape = Quote>
+struct CsvDialect
+{
+    static constexpr char delimiter = Delimiter;
+    static constexpr char quote = Quote;
+    static constexpr char escape = Escape;
+    static constexpr bool has_escape = Escape != Quote;
+};
+
+using CommaDialect = CsvDialect<>;
+using TabDialect = CsvDialect<'\t'>;
+using PipeDialect = CsvDialect<'|'>;
+using SemicolonDialect = CsvDialect<';'>;
+
+/*!
+ * Bitmaps of a 64 byte block, bit i standing for byte i.
+ */
+struct CsvBlockMasks
+{
+    uint64_t quote;      // the quote
+    uint64_t structural; // the delimiter, or `\n`
+    uint64_t escape;     // the escape, if distinct from the quote
+};
+
+/*!
+ * What a block carries over to the next one.
+ */
+struct CsvScanCarry
+{
+    uint64_t quoted{0};  // all ones if the block ends inside quotes
+    uint64_t escaped{0}; // 1 if the first byte of the next block is escaped
+};
+
+/*!
+ * Computes the prefix XOR of the bits, i.e., bit i of the result is the XOR of bits [0, i].
+ * Applied to the quote bitmap, it sets the bits of the bytes enclosed in quotes, including
+ * the opening quote.
+ */
+inline uint64_t prefix_xor(uint64_t a_bits) noexcept
+{
+    a_bits ^= a_bits << 1;
+    a_bits ^= a_bits << 2;
+    a_bits ^= a_bits << 4;
+    a_bits ^= a_bits << 8;
+    a_bits ^= a_bits << 16;
+    a_bits ^= a_bits << 32;
+    return a_bits;
+}
+
+/*!
+ * Clears the quotes escaped by an odd run of escape chars, in the manner of simdjson: the bits
+ * following the runs starting on odd bits are flipped by a subtraction, which tells the bytes
+ * escaped by each run, carried over to the next block.
+ * @param a_quote The quotes of the block.
+ * @param a_escape The escape chars of the block.
+ * @param a_escaped Whether the first byte of the block is escaped; set for the next block.
+ * @return The unescaped quotes.
+ */
+inline uint64_t unescaped_quotes(uint64_t a_quote, uint64_t a_escape, uint64_t &a_escaped) noexcept
+{
+    constexpr uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAULL;
+    const auto escape = a_escape & ~a_escaped;
+    const auto codes = (((escape << 1) | odd_bits) - escape) ^ odd_bits;
+    const auto escaped = codes ^ (a_escape | a_escaped);
+    a_escaped = (codes & a_escape) >> 63;
+    return a_quote & ~escaped;
+}
+
+/*!
+ * Computes the byte masks of a block one byte at a time.
+ */
+template<typename Dialect>
+inline CsvBlockMasks scalar_block_masks(const char *a_block) noexcept
+{
+    auto masks = CsvBlockMasks{0, 0, 0};
+    for (int i = 0; i < 64; i++) {
+        masks.quote |= static_cast<uint64_t>(a_block[i] == Dialect::quote) << i;
+        masks.structural |= static_cast<uint64_t>(a_block[i] == Dialect::delimiter || a_block[i] == '\n') << i;
+        if constexpr (Dialect::has_escape) masks.escape |= static_cast<uint64_t>(a_block[i] == Dialect::escape) << i;
+    }
+    return masks;
+}
+
+/*!
+ * Appends the offsets of the set bits, each relative to the block at a_base.
+ */
+inline void emit_offsets(uint64_t a_bits, uint32_t a_base, std::vector<uint32_t> &a_offsets)
+{
+    auto at = a_offsets.size();
+    a_offsets.resize(at + static_cast<size_t>(std::popcount(a_bits)));
+
+    for (auto *out = a_offsets.data() + at; a_bits; a_bits &= a_bits - 1)
+        *out++ = a_base + static_cast<uint32_t>(std::countr_zero(a_bits));
+}
+
+/*!
+ * Scans the remaining full blocks, then the partial block at the end padded with spaces, with
+ * no SIMD instructions.
+ * @return a_end
+ */
+template<typename Dialect>
+const char *scalar_scan_blocks(const char *a_begin, const char *a_from, const char *a_end, std::vector<uint32_t> &a_offsets, CsvScanCarry &a_carry)
+{
+    auto scan = [&](const char *a_block, const char *a_pos) {
+        auto masks = scalar_block_masks<Dialect>(a_block);
+        if constexpr (Dialect::has_escape) masks.quote = unescaped_quotes(masks.quote, masks.escape, a_carry.escaped);
+        auto quoted = prefix_xor(masks.quote) ^ a_carry.quoted;
+        a_carry.quoted = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+        emit_offsets(masks.structural & ~quoted, static_cast<uint32_t>(a_pos - a_begin), a_offsets);
+    };
+
+    const char *p = a_from;
+    for (; a_end - p >= 64; p += 64) scan(p, p);
+
+    if (p != a_end) {
+        char tail[64];
+        std::memset(tail, ' ', sizeof(tail));
+        std::memcpy(tail, p, static_cast<size_t>(a_end - p));
+        scan(tail, p);
+    }
+
+    return a_end;
+}
+
+#ifdef WXLIB_MIO_X86
+
+/*!
+ * Returns true if the CPU supports carry-less multiplication.
+ */
+inline bool has_clmul() noexcept
+{
+#if defined(__GNUC__)
+    static const bool clmul = (__builtin_cpu_init(), __builtin_cpu_supports("pclmul"));
+    return clmul;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * Same as prefix_xor, computed in one carry-less multiplication by all ones.
+ */
+WXLIB_MIO_TARGET("pclmul") inline uint64_t clmul_prefix_xor(uint64_t a_bits) noexcept
+{
+    auto x = _mm_set_epi64x(0, static_cast<int64_t>(a_bits));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(x, _mm_set1_epi8(-1), 0)));
+}
+
+WXLIB_MIO_TARGET("avx2") inline uint64_t avx2_eq_mask(__m256i a_lo, __m256i a_hi, char a_c) noexcept
+{
+    auto c = _mm256_set1_epi8(a_c);
+    auto lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_lo, c)));
+    auto hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_hi, c)));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+/*!
+ * Scans the full blocks from a_from, using AVX2 and carry-less multiplication.
+ * @tparam utf8 Whether the blocks are validated as UTF-8 as well, see avx2_utf8_check.
+ * @param a_utf8_blocks If utf8, the offsets of the invalid blocks are appended to it.
+ * @return The start of the partial block left at the end.
+ */
+template<typename Dialect, bool utf8 = false>
+WXLIB_MIO_TARGET("avx2,pclmul") const char *avx2_scan_blocks(const char *a_begin, const char *a_from, const char *a_end, std::vector<uint32_t> &a_offsets, CsvScanCarry &a_carry,
+                                                             std::vector<uint32_t> *a_utf8_blocks = nullptr)
+{
+    const char *p = a_from;
+    [[maybe_unused]] auto utf8_state = avx2_utf8_init();
+
+    for (; a_end - p >= 64; p += 64) {
+        auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+        if constexpr (utf8)
+            if (avx2_utf8_check(lo, hi, utf8_state)) a_utf8_blocks->push_back(static_cast<uint32_t>(p - a_begin));
+
+        auto quote = avx2_eq_mask(lo, hi, Dialect::quote);
+        if constexpr (Dialect::has_escape) quote = unescaped_quotes(quote, avx2_eq_mask(lo, hi, Dialect::escape), a_carry.escaped);
+        auto quoted = clmul_prefix_xor(quote) ^ a_carry.quoted;
+        a_carry.quoted = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+
+        auto structural = avx2_eq_mask(lo, hi, Dialect::delimiter) | avx2_eq_mask(lo, hi, '\n');
+        emit_offsets(structural & ~quoted, static_cast<uint32_t>(p - a_begin), a_offsets);
+    }
+
+    return p;
+}
+
+/*!
+ * Scans the full blocks from a_from, using AVX-512BW and carry-less multiplication.
+ * @tparam utf8 Whether the blocks are validated as UTF-8 as well, two halves at a time.
+ * @param a_utf8_blocks If utf8, the offsets of the invalid blocks are appended to it.
+ * @return The start of the partial block left at the end.
+ */
+template<typename Dialect, bool utf8 = false>
+WXLIB_MIO_TARGET("avx512f,avx512bw,pclmul") const char *avx512_scan_blocks(const char *a_begin, const char *a_from, const char *a_end, std::vector<uint32_t> &a_offsets, CsvScanCarry &a_carry,
+                                                                           std::vector<uint32_t> *a_utf8_blocks = nullptr)
+{
+    [[maybe_unused]] auto utf8_state = avx2_utf8_init();
+    const char *p = a_from;
+    const auto quote = _mm512_set1_epi8(Dialect::quote);
+    const auto delimiter = _mm512_set1_epi8(Dialect::delimiter);
+    const auto newline = _mm512_set1_epi8('\n');
+    const auto escape = _mm512_set1_epi8(Dialect::escape);
+
+    for (; a_end - p >= 64; p += 64) {
+        auto x = _mm512_loadu_si512(p);
+        if constexpr (utf8)
+            if (avx2_utf8_check(_mm512_castsi512_si256(x), _mm512_extracti64x4_epi64(x, 1), utf8_state)) a_utf8_blocks->push_back(static_cast<uint32_t>(p - a_begin));
+
+        auto quote_bits = static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(x, quote));
+        if constexpr (Dialect::has_escape) quote_bits = unescaped_quotes(quote_bits, _mm512_cmpeq_epi8_mask(x, escape), a_carry.escaped);
+        auto quoted = clmul_prefix_xor(quote_bits) ^ a_carry.quoted;
+        a_carry.quoted = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+
+        auto structural = static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(x, delimiter) | _mm512_cmpeq_epi8_mask(x, newline));
+        emit_offsets(structural & ~quoted, static_cast<uint32_t>(p - a_begin), a_offsets);
+    }
+
+    return p;
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/*!
+ * Packs the comparison results of 64 bytes into a bitmap.
+ */
+inline uint64_t neon_movemask(uint8x16_t a_0, uint8x16_t a_1, uint8x16_t a_2, uint8x16_t a_3) noexcept
+{
+    const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    auto s0 = vpaddq_u8(vandq_u8(a_0, bits), vandq_u8(a_1, bits));
+    auto s1 = vpaddq_u8(vandq_u8(a_2, bits), vandq_u8(a_3, bits));
+    s0 = vpaddq_u8(s0, s1);
+    s0 = vpaddq_u8(s0, s0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+/*!
+ * Scans the full blocks from a_from, using NEON.
+ * @return The start of the partial block left at the end.
+ */
+template<typename Dialect>
+const char *neon_scan_blocks(const char *a_begin, const char *a_from, const char *a_end, std::vector<uint32_t> &a_offsets, CsvScanCarry &a_carry)
+{
+    const char *p = a_from;
+    const auto quote = vdupq_n_u8(static_cast<uint8_t>(Dialect::quote));
+    const auto delimiter = vdupq_n_u8(static_cast<uint8_t>(Dialect::delimiter));
+    const auto newline = vdupq_n_u8('\n');
+    const auto escape = vdupq_n_u8(static_cast<uint8_t>(Dialect::escape));
+
+    for (; a_end - p >= 64; p += 64) {
+        const auto *u = reinterpret_cast<const uint8_t *>(p);
+        uint8x16_t x[4] = {vld1q_u8(u), vld1q_u8(u + 16), vld1q_u8(u + 32), vld1q_u8(u + 48)};
+
+        auto quote_bits = neon_movemask(vceqq_u8(x[0], quote), vceqq_u8(x[1], quote), vceqq_u8(x[2], quote), vceqq_u8(x[3], quote));
+        if constexpr (Dialect::has_escape)
+            quote_bits = unescaped_quotes(quote_bits, neon_movemask(vceqq_u8(x[0], escape), vceqq_u8(x[1], escape), vceqq_u8(x[2], escape), vceqq_u8(x[3], escape)), a_carry.escaped);
+        auto quoted = prefix_xor(quote_bits) ^ a_carry.quoted;
+        a_carry.quoted = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+
+        auto structural = neon_movemask(
+            vorrq_u8(vceqq_u8(x[0], delimiter), vceqq_u8(x[0], newline)),
+            vorrq_u8(vceqq_u8(x[1], delimiter), vceqq_u8(x[1], newline)),
+            vorrq_u8(vceqq_u8(x[2], delimiter), vceqq_u8(x[2], newline)),
+            vorrq_u8(vceqq_u8(x[3], delimiter), vceqq_u8(x[3], newline)));
+        emit_offsets(structural & ~quoted, static_cast<uint32_t>(p - a_begin), a_offsets);
+    }
+
+    return p;
+}
+
+#endif
+
+/*!
+ * Finds the structural chars of a block of csv lines, and validates it as UTF-8 if utf8, see
+ * scan_structurals.
+ */
+template<typename Dialect, bool utf8>
+bool scan_structurals_impl(const char *a_begin, const char *a_end, std::vector<uint32_t> &a_offsets, bool a_in_quotes, [[maybe_unused]] std::vector<uint32_t> *a_utf8_errors)
+{
+    auto carry = CsvScanCarry{a_in_quotes ? ~uint64_t{0} : uint64_t{0}, 0};
+    const char *p = a_begin;
+    [[maybe_unused]] auto utf8_blocks = std::vector<uint32_t>{};
+
+    // Every 64 bytes have at most 64 structural chars; most csv have a lot fewer.
+    a_offsets.reserve(a_offsets.size() + static_cast<size_t>(a_end - a_begin) / 8);
+
+#if defined(WXLIB_MIO_X86)
+    if (has_clmul()) {
+        switch (simd_level()) {
+            case SimdLevel::Avx512: p = avx512_scan_blocks<Dialect, utf8>(a_begin, p, a_end, a_offsets, carry, &utf8_blocks); break;
+            case SimdLevel::Avx2: p = avx2_scan_blocks<Dialect, utf8>(a_begin, p, a_end, a_offsets, carry, &utf8_blocks); break;
+            default: break;
+        }
+    }
+    [[maybe_unused]] const char *validated = p;
+#elif defined(WXLIB_MIO_ARM64)
+    p = neon_scan_blocks<Dialect>(a_begin, p, a_end, a_offsets, carry);
+    [[maybe_unused]] const char *validated = a_begin;
+#else
+    [[maybe_unused]] const char *validated = a_begin;
+#endif
+
+    scalar_scan_blocks<Dialect>(a_begin, p, a_end, a_offsets, carry);
+
+    if constexpr (utf8) {
+        // The exact offsets, of the invalid blocks, then of the bytes not validated at all.
+        auto on_error = [&](const char *a_pos) {
+            const auto offset = static_cast<uint32_t>(a_pos - a_begin);
+            if (a_utf8_errors->empty() || a_utf8_errors->back() < offset) a_utf8_errors->push_back(offset);
+        };
+
+        for (auto o: utf8_blocks) {
+            const char *block = std::next(a_begin, o);
+            scalar_utf8_errors(utf8_sequence_start(a_begin, block), std::next(block, 64), a_end, on_error);
+        }
+        scalar_utf8_errors(utf8_sequence_start(a_begin, validated), a_end, a_end, on_error);
+    }
+
+    return carry.quoted != 0;
+}
+
+/*!
+ * Finds the structural chars of a block of csv lines, that is, every delimiter and `\n`
+ * outside of double quotes, in the manner of simdcsv. Each 64 byte block is turned into
+ * bitmaps of quotes and structural chars; the prefix XOR of the quote bitmap masks out the
+ * bytes enclosed in quotes, and the offsets of the remaining structural bits are appended to
+ * a flat array. Escaped quotes `""` need no special handling, since they close and reopen the
+ * quoted region; with a distinct escape char, the escaped quotes are masked out first, see
+ * unescaped_quotes.
+ *
+ * The char at each offset tells whether it ends a field or a line.
+ * @tparam Dialect The delimiter, quote, and escape chars, see CsvDialect.
+ * @param a_begin
+ * @param a_end Precondition - a_end - a_begin must be less than 4 GiB.
+ * @param a_offsets Offsets relative to a_begin are appended to it.
+ * @param a_in_quotes Whether a_begin is inside quotes.
+ * @return Whether a_end is inside quotes.
+ */
+template<typename Dialect = CommaDialect>
+bool scan_structurals(const char *a_begin, const char *a_end, std::vector<uint32_t> &a_offsets, bool a_in_quotes = false)
+{
+    return scan_structurals_impl<Dialect, false>(a_begin, a_end, a_offsets, a_in_quotes, nullptr);
+}
+
+/*!
+ * Same as scan_structurals, validating the block as UTF-8 in the same pass, with the AVX2 or
+ * AVX-512 kernels; the blocks found invalid are then validated again one byte at a time for
+ * the exact offsets of the invalid sequences. Without those kernels, the block is validated
+ * one byte at a time.
+ * @param a_utf8_errors Offsets of the invalid UTF-8 sequences, relative to a_begin, are
+ * appended to it in ascending order, see scalar_utf8_errors.
+ * @return Whether a_end is inside quotes.
+ */
+template<typename Dialect = CommaDialect>
+bool scan_structurals(const char *a_begin, const char *a_end, std::vector<uint32_t> &a_offsets, std::vector<uint32_t> &a_utf8_errors, bool a_in_quotes = false)
+{
+    return scan_structurals_impl<Dialect, true>(a_begin, a_end, a_offsets, a_in_quotes, &a_utf8_errors);
+}
+
+}
+#endif
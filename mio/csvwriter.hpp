@@ -0,0 +1,360 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_CSV_WRITER_HPP
+#define WXLIB_MIO_CSV_WRITER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/csvdoc.hpp>
+
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+
+namespace mio::csv {
+
+/*!
+ * Appends the text of a value to a_out, the inverse of parse_field. Integers and floating point
+ * numbers are formatted by std::to_chars, the latter in the shortest form that round trips;
+ * booleans are `1` or `0`; strings are appended verbatim.
+ *
+ * Overload format_field in the namespace of a custom type to support it in a CsvWriter.
+ * @tparam V The value type.
+ * @param a_out
+ * @param a_value
+ */
+template<typename V>
+void format_field(std::string &a_out, const V &a_value)
+{
+    if constexpr (std::is_convertible_v<const V &, std::string_view>) {
+        a_out.append(std::string_view{a_value});
+    } else if constexpr (std::is_same_v<V, bool>) {
+        a_out.push_back(a_value ? '1' : '0');
+    } else if constexpr (std::is_arithmetic_v<V>) {
+        char buf[64];
+        auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), a_value);
+        a_out.append(buf, ptr);
+    } else {
+        static_assert(sizeof(V) == 0, "No format_field overload for the CsvField value type.");
+    }
+}
+
+/*!
+ * Writes csv files with the schema of CsvDoc<Ts...>, into a memory mapped file that grows in
+ * large extents, so that the output never goes through iostreams.
+ *
+ * Records are formatted into a staging buffer, which is copied into the mapping once it holds
+ * staging_size bytes. When the mapping is full, the file is extended by another extent, or by
+ * half its size once larger, and the mapping grown in place; on Linux, the extent is also
+ * allocated with posix_fallocate, so that running out of disk space is reported as an error
+ * instead of a SIGBUS. Closing the writer truncates the file to the bytes written.
+ *
+ * For parallel output, each thread formats its records into its own Segment, and the segments
+ * are stitched, in the order of append, into the file.
+ *
+ * Errors are reported by close(). After the first error, writing has no effect.
+ *
+ * @code
+ *   using Writer = mio::csv::CsvWriter<Field<NAME("link_id"), int64_t>, Field<NAME("volume"), double>>;
+ *
+ *   Writer writer("volumes.csv");
+ *   writer.write_header();
+ *   writer.write_row(1, 1250.5);
+ *
+ *   Writer::Segment segment; // e.g. one per thread
+ *   segment.write_row(2, 980.0);
+ *   writer.append(segment);
+ *
+ *   std::error_code error;
+ *   writer.close(error);
+ * @endcode
+ */
+template<typename ...Ts> requires UniqueCsvFields<Ts...>
+class CsvWriter
+{
+public:
+    using Record = CsvRecord<Ts...>;
+    constexpr static auto field_count = std::tuple_size_v<Record>;
+
+    /*!
+     * Default size by which the file grows.
+     */
+    static constexpr size_t default_extent = size_t{64} << 20;
+
+    /*!
+     * Size of the staging buffer copied into the mapping at a time.
+     */
+    static constexpr size_t staging_size = size_t{1} << 20;
+
+    /*!
+     * Formatted csv lines, to be appended to a CsvWriter. Segments are independent of each other
+     * and of the writer, so different threads can fill different segments in parallel.
+     */
+    struct Segment
+    {
+        /*!
+         * Appends the header line with the field names.
+         */
+        void write_header()
+        {
+            auto i = size_t{0};
+            ((data.append(i++ ? "," : "").append(Ts::field_name)), ...);
+            data.push_back('\n');
+        }
+
+        /*!
+         * Appends a record as a csv line.
+         */
+        void write(const Record &a_rec)
+        {
+            std::apply([this](const Ts &...a_fields) { write_row(a_fields.data...); }, a_rec);
+        }
+
+        /*!
+         * Appends a record as a csv line, with the quoted fields as read by CsvDoc, see
+         * write_raw_row.
+         */
+        void write_raw(const Record &a_rec)
+        {
+            std::apply([this](const Ts &...a_fields) { write_raw_row(a_fields.data...); }, a_rec);
+        }
+
+        /*!
+         * Appends a csv line with the values of the fields, in the order of the schema. For
+         * quoted fields, string values are always enclosed in double quotes, with the quotes
+         * inside doubled.
+         */
+        void write_row(const typename Ts::value_type &...a_values)
+        {
+            auto i = size_t{0};
+            ((i++ ? data.push_back(',') : void(), write_value<Ts, false>(a_values)), ...);
+            data.push_back('\n');
+        }
+
+        /*!
+         * Appends a csv line like write_row, except that string values of quoted fields already
+         * enclosed in double quotes, e.g. as read by CsvDoc, are appended verbatim. The caller
+         * guarantees such values are well formed csv fields.
+         */
+        void write_raw_row(const typename Ts::value_type &...a_values)
+        {
+            auto i = size_t{0};
+            ((i++ ? data.push_back(',') : void(), write_value<Ts, true>(a_values)), ...);
+            data.push_back('\n');
+        }
+
+        void clear() noexcept
+        {
+            data.clear();
+        }
+
+        std::string data;
+
+    private:
+        template<typename T, bool raw>
+        void write_value(const typename T::value_type &a_value)
+        {
+            using V = typename T::value_type;
+            if constexpr (T::Quoted::value && std::is_convertible_v<const V &, std::string_view>) {
+                const auto text = std::string_view{a_value};
+                if (raw && text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+                    data.append(text);
+                } else {
+                    data.push_back('"');
+                    for (auto c: text) {
+                        if (c == '"') data.push_back('"');
+                        data.push_back(c);
+                    }
+                    data.push_back('"');
+                }
+            } else {
+                format_field(data, a_value);
+            }
+        }
+    };
+
+    /*!
+     * Creates the csv file, or truncates it if it exists. If the file cannot be created or
+     * mapped, std::system_error will be thrown with error code describing the nature of the error.
+     * @param a_file The csv file to write.
+     * @param a_extent Size in bytes by which the file grows when the mapping is full.
+     */
+    explicit CsvWriter(const std::string &a_file, size_t a_extent = default_extent)
+        : file_{a_file}, extent_{std::max(a_extent, page_size())}
+    {
+        {
+            std::ofstream create(file_, std::ios::binary | std::ios::trunc);
+            if (!create) throw std::system_error(std::make_error_code(std::errc::io_error));
+        }
+
+        grow(0);
+        if (error_) throw std::system_error(error_);
+        staging_.data.reserve(staging_size);
+    }
+
+    CsvWriter(const CsvWriter &) = delete;
+    CsvWriter(CsvWriter &&) = delete;
+    CsvWriter &operator=(CsvWriter &) = delete;
+    CsvWriter &operator=(CsvWriter &&) = delete;
+
+    ~CsvWriter()
+    {
+        std::error_code ignored;
+        close(ignored);
+    }
+
+    /*!
+     * Checks whether the writer is open, i.e., not yet closed, and no error has occurred.
+     */
+    [[nodiscard]] bool is_open() const noexcept
+    {
+        return mmap_.is_mapped() && !error_;
+    }
+
+    /*!
+     * Writes the header line with the field names.
+     */
+    void write_header()
+    {
+        staging_.write_header();
+        flush_if_full();
+    }
+
+    /*!
+     * Writes a record as a csv line.
+     */
+    void write(const Record &a_rec)
+    {
+        staging_.write(a_rec);
+        flush_if_full();
+    }
+
+    /*!
+     * Writes a csv line with the values of the fields, see Segment::write_row.
+     */
+    void write_row(const typename Ts::value_type &...a_values)
+    {
+        staging_.write_row(a_values...);
+        flush_if_full();
+    }
+
+    /*!
+     * Writes a record as a csv line, with the quoted fields as read by CsvDoc, see
+     * Segment::write_raw_row.
+     */
+    void write_raw(const Record &a_rec)
+    {
+        staging_.write_raw(a_rec);
+        flush_if_full();
+    }
+
+    /*!
+     * Writes a csv line with quoted fields already enclosed in quotes appended verbatim, see
+     * Segment::write_raw_row.
+     */
+    void write_raw_row(const typename Ts::value_type &...a_values)
+    {
+        staging_.write_raw_row(a_values...);
+        flush_if_full();
+    }
+
+    /*!
+     * Writes the lines of a segment, after all the lines written before.
+     */
+    void append(const Segment &a_segment)
+    {
+        flush();
+        copy(a_segment.data);
+    }
+
+    /*!
+     * Number of bytes written so far.
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return size_ + staging_.data.size();
+    }
+
+    /*!
+     * Writes the pending lines, unmaps the file, and truncates it to the bytes written. Does
+     * nothing if the writer is already closed.
+     * @param error Set to the first error that occurred while writing or closing, if any.
+     */
+    void close(std::error_code &error)
+    {
+        if (mmap_.is_mapped()) {
+            flush();
+            mmap_.unmap();
+
+            std::error_code truncated;
+            std::filesystem::resize_file(file_, size_, truncated);
+            if (!error_) error_ = truncated;
+        }
+
+        error = error_;
+    }
+
+private:
+    void flush_if_full()
+    {
+        if (staging_.data.size() >= staging_size) flush();
+    }
+
+    void flush()
+    {
+        copy(staging_.data);
+        staging_.clear();
+    }
+
+    void copy(std::string_view a_text)
+    {
+        if (error_ || a_text.empty()) return;
+        if (size_ + a_text.size() > mmap_.size()) grow(size_ + a_text.size());
+        if (error_) return;
+
+        std::memcpy(mmap_.data() + size_, a_text.data(), a_text.size());
+        size_ += a_text.size();
+    }
+
+    /*!
+     * Extends the file by at least one extent, or half its size once larger, to no less than
+     * a_min_size bytes, and grows the mapping in place, see basic_mmap::grow().
+     */
+    void grow(size_t a_min_size)
+    {
+        const auto capacity = mmap_.size();
+        const auto new_capacity = std::max(capacity + std::max(extent_, capacity / 2), a_min_size);
+
+        if (mmap_.is_mapped()) {
+            mmap_.grow(new_capacity, error_);
+        } else {
+            std::filesystem::resize_file(file_, new_capacity, error_);
+            if (error_) return;
+
+            mmap_.map(file_, 0, new_capacity, error_);
+        }
+
+#if defined(__linux__)
+        // Only running out of space is an error; not all file systems support allocation.
+        if (!error_ && ::posix_fallocate(mmap_.file_handle(), static_cast<off_t>(capacity), static_cast<off_t>(new_capacity - capacity)) == ENOSPC)
+            error_ = std::make_error_code(std::errc::no_space_on_device);
+#endif
+    }
+
+    std::string file_;
+    size_t extent_;
+    size_t size_{0};
+    mmap_sink mmap_;
+    Segment staging_;
+    std::error_code error_;
+};
+
+}
+#endif
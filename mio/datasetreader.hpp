@@ -0,0 +1,389 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_DATASET_READER_HPP
+#define WXLIB_MIO_DATASET_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   A newline-aligned chunk of one of the files of a dataset, as handed to the
+   DatasetReader callback.
+ */
+struct DatasetChunk
+{
+  /**
+     Index of the file in DatasetReader::files().
+   */
+  size_t file_id;
+
+  /**
+     Index of the chunk in its file, chunks being numbered from the start of the file.
+   */
+  size_t chunk_id;
+
+  /**
+     Byte offset of the chunk from the start of its file.
+   */
+  size_t offset;
+
+  /**
+     The lines of the chunk, each terminated by `\n` except possibly the last line of the
+     file. Only valid for the duration of the call.
+   */
+  std::string_view text;
+};
+
+/**
+   Callable invoked with the worker ID and a whole chunk of consecutive lines at a time.
+ */
+template<typename F>
+concept DatasetChunkHandler = std::is_invocable_r_v<int, F &, int, const DatasetChunk &>;
+
+/**
+   Callable invoked with the worker ID, the chunk, and a batch of its lines at a time,
+   excluding the terminating `\n`.
+ */
+template<typename F>
+concept DatasetBatchHandler = std::is_invocable_r_v<int, F &, int, const DatasetChunk &, std::span<const std::string_view>>;
+
+/**
+   Reads the lines of many files, e.g. a directory of daily partitions, with a single pool
+   of worker threads. The files are cut into newline-aligned chunks, which the workers claim
+   from one queue spanning all the files, so the pool stays busy across file boundaries
+   instead of draining at the end of each file, as reading the files one StringReaderAsync
+   at a time would.
+
+   The files are mapped in order, at most `a_max_mapped_files` at a time: a file is mapped
+   when the workers run out of chunks of the files already mapped, and unmapped as soon as
+   its last chunk is processed. Each file is mapped with access_hint::sequential.
+
+   A file that cannot be mapped is skipped, and the first such error is kept, see error().
+   Empty files are skipped without error.
+
+   @code
+     auto reader = mio::DatasetReader::glob("trips", "2022-*.csv");
+     auto on_lines = [](int a_worker_id, const mio::DatasetChunk &a_chunk, std::span<const std::string_view> a_lines) {
+       // ... a_chunk.file_id tells which of reader.files() the lines come from.
+       return 0; // 0 for success, non-zero to stop reading. Must not throw exception.
+     };
+     auto total_lines = reader.read(on_lines, mio::available_concurrency());
+   @endcode
+ */
+class DatasetReader
+{
+public:
+  /**
+     Default maximum number of files mapped at a time.
+   */
+  static constexpr size_t default_max_mapped_files = 4;
+
+  /**
+     Default chunk size, 8 MiB.
+   */
+  static constexpr size_t default_chunk_size = StringReaderAsync::default_chunk_size;
+
+  /**
+     Maximum number of lines handed to a batch callback at a time.
+   */
+  static constexpr size_t batch_size = StringReaderAsync::batch_size;
+
+  /*!
+    @param a_files The files of the dataset, read in this order.
+   */
+  explicit DatasetReader(std::vector<std::string> a_files) : files_{std::move(a_files)}
+  {
+  }
+
+  /*!
+    Collects the regular files of a directory whose names match a glob pattern, in which
+    `*` matches any sequence of characters, and `?` any single character. The files are
+    sorted by name, so that date-stamped partitions are read in chronological order.
+    @param a_directory The directory, which is not recursed into.
+    @param a_pattern The pattern the file names must match, e.g. "*.csv".
+    @return A reader of the matching files, with no file if the directory cannot be listed.
+   */
+  static DatasetReader glob(const std::filesystem::path &a_directory, const std::string_view a_pattern)
+  {
+    auto files = std::vector<std::string>{};
+    auto error = std::error_code{};
+
+    for (auto it = std::filesystem::directory_iterator{a_directory, error}; !error && it != std::filesystem::directory_iterator{}; it.increment(error)) {
+      if (it->is_regular_file(error) && glob_match(a_pattern, it->path().filename().string()))
+        files.push_back(it->path().string());
+    }
+
+    std::sort(files.begin(), files.end());
+    return DatasetReader{std::move(files)};
+  }
+
+  /*!
+    The files of the dataset. A file ID is an index into this list.
+   */
+  [[nodiscard]] const std::vector<std::string> &files() const noexcept
+  {
+    return files_;
+  }
+
+  /*!
+    The first error mapping a file during the last call to read(), if any.
+   */
+  [[nodiscard]] std::error_code error() const noexcept
+  {
+    return error_;
+  }
+
+  /*!
+    Reads all the files with a pool of worker threads, and fires the callback in the
+    context of the worker thread, either once per chunk (DatasetChunkHandler), or once
+    per batch of up to DatasetReader::batch_size lines of a chunk (DatasetBatchHandler).
+
+    Chunks are handed out in file order, but processed concurrently, so a callback may see
+    chunks of several files at once. When a non-zero status code is returned, all the workers
+    stop claiming chunks.
+
+    @param a_callback A callback for processing each chunk, or each batch of lines.
+    @param a_num_threads Number of worker threads, 0 treated as 1.
+    @param a_max_mapped_files Maximum number of files mapped at a time, 0 treated as 1.
+    @param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+    @return Total number of chunks processed for a chunk handler, of lines for a batch handler.
+   */
+  template<typename CallbackT>
+  requires DatasetChunkHandler<CallbackT> || DatasetBatchHandler<CallbackT>
+  size_t read(const CallbackT &a_callback,
+              const size_t a_num_threads,
+              const size_t a_max_mapped_files = default_max_mapped_files,
+              const size_t a_chunk_size = default_chunk_size)
+  {
+    auto queue = Queue{files_, std::max(a_max_mapped_files, size_t{1}), std::max(a_chunk_size, size_t{1})};
+
+    auto counts = std::vector<size_t>(std::max(a_num_threads, size_t{1}));
+    Executor::shared().run_workers(counts.size(), [&](const size_t a_id) {
+      const auto i = static_cast<int>(a_id);
+      for (auto claim = queue.claim(); claim.file; claim = queue.claim()) {
+        const auto ok = process(i, claim, a_callback, counts[a_id]);
+        queue.release(claim.file);
+        if (!ok) {
+          queue.stop();
+          break;
+        }
+      }
+    });
+
+    const auto total = std::accumulate(counts.begin(), counts.end(), size_t{0});
+
+    error_ = queue.error;
+    return total;
+  }
+
+private:
+  using Partition = std::pair<const char *, const char *>;
+
+  /**
+     A mapped file, with its chunks and the number of them not processed yet.
+   */
+  struct MappedFile
+  {
+    size_t id;
+    mmap_source mmap;
+    std::vector<Partition> chunks;
+    size_t next{0};
+    size_t pending{0};
+  };
+
+  /**
+     A chunk claimed by a worker, `file` being null when no chunk is left.
+   */
+  struct Claim
+  {
+    MappedFile *file{nullptr};
+    size_t chunk_id{0};
+  };
+
+  /**
+     The chunk queue shared by the workers, mapping files as needed.
+   */
+  struct Queue
+  {
+    const std::vector<std::string> &files;
+    size_t max_mapped;
+    size_t chunk_size;
+    std::mutex mutex{};
+    std::condition_variable changed{};
+    std::list<MappedFile> mapped{};
+    size_t next_file{0};
+    size_t mapping{0};
+    bool stopped{false};
+    std::error_code error{};
+
+    Claim claim()
+    {
+      auto lock = std::unique_lock{mutex};
+      while (!stopped) {
+        for (auto &f: mapped) {
+          if (f.next < f.chunks.size()) return {&f, f.next++};
+        }
+
+        if (next_file < files.size() && mapped.size() + mapping < max_mapped) {
+          // Maps the next file without holding the lock, so other workers keep claiming.
+          const auto id = next_file++;
+          mapping++;
+          lock.unlock();
+          auto file = map_file(id);
+          lock.lock();
+          mapping--;
+          if (file.error) {
+            if (!error) error = file.error;
+          } else if (!file.mapped.chunks.empty()) {
+            mapped.push_back(std::move(file.mapped));
+          }
+          changed.notify_all();
+          continue;
+        }
+
+        // Nothing left to claim, nor to map, once the files being mapped are in.
+        if (next_file == files.size() && mapping == 0) break;
+        changed.wait(lock);
+      }
+      return {};
+    }
+
+    void release(MappedFile *a_file)
+    {
+      auto lock = std::scoped_lock{mutex};
+      if (--a_file->pending == 0 && a_file->next == a_file->chunks.size()) {
+        mapped.remove_if([a_file](const MappedFile &f) { return &f == a_file; });
+        changed.notify_all();
+      }
+    }
+
+    void stop()
+    {
+      auto lock = std::scoped_lock{mutex};
+      stopped = true;
+      changed.notify_all();
+    }
+
+    struct Mapping
+    {
+      MappedFile mapped;
+      std::error_code error;
+    };
+
+    Mapping map_file(const size_t a_id) const
+    {
+      auto result = Mapping{MappedFile{a_id, {}, {}}, {}};
+      if (std::filesystem::file_size(files[a_id], result.error) == 0 || result.error) return result;
+
+      result.mapped.mmap.map(files[a_id], 0, map_entire_file, access_hint::sequential, result.error);
+      if (result.error) return result;
+
+      result.mapped.chunks = make_chunks(result.mapped.mmap.data(), result.mapped.mmap.data() + result.mapped.mmap.size(), chunk_size);
+      result.mapped.pending = result.mapped.chunks.size();
+      return result;
+    }
+  };
+
+  /**
+     Cuts [a_begin, a_end) into chunks of at least `a_chunk_size` bytes, each extended to
+     just past the next `\n`, except the last one.
+   */
+  static std::vector<Partition> make_chunks(const char *a_begin, const char *a_end, const size_t a_chunk_size) noexcept
+  {
+    auto result = std::vector<Partition>{};
+    for (const char *b = a_begin, *e = nullptr; b < a_end; b = e) {
+      if (static_cast<size_t>(a_end - b) > a_chunk_size) {
+        e = fast_find<'\n'>(std::next(b, static_cast<std::ptrdiff_t>(a_chunk_size)), a_end);
+        e = (e == a_end) ? e : std::next(e);
+      } else {
+        e = a_end;
+      }
+      result.emplace_back(b, e);
+    }
+    return result;
+  }
+
+  /**
+     Fires the callback for a claimed chunk.
+     @return False if the callback returned a non-zero status code, true otherwise.
+   */
+  template<typename CallbackT>
+  static bool process(const int a_thread_id, const Claim &a_claim, const CallbackT &a_callback, size_t &a_counter) noexcept
+  {
+    const auto [b, e] = a_claim.file->chunks[a_claim.chunk_id];
+    const char *file_begin = a_claim.file->mmap.data();
+    const auto chunk = DatasetChunk{a_claim.file->id, a_claim.chunk_id, static_cast<size_t>(b - file_begin), {b, static_cast<size_t>(e - b)}};
+
+    if constexpr (DatasetChunkHandler<CallbackT>) {
+      // If a non-zero status code is returned, break immediately.
+      if (semi_branch_expect(a_callback(a_thread_id, chunk) != 0, false)) return false;
+      a_counter++;
+    } else {
+      auto batch = std::array<std::string_view, batch_size>{};
+      auto n = size_t{0};
+
+      // Every line is read, including the last line of the file if not terminated by `\n`.
+      for (const char *p = b; p < e;) {
+        const char *find_pos = fast_find<'\n'>(p, e);
+        batch[n++] = {p, static_cast<size_t>(find_pos - p)};
+        p = (find_pos == e) ? e : std::next(find_pos);
+
+        // Flush the batch when it is full, or the chunk is exhausted.
+        if (n == batch_size || p == e) {
+          if (semi_branch_expect(a_callback(a_thread_id, chunk, std::span<const std::string_view>{batch.data(), n}) != 0, false))
+            return false;
+          a_counter += std::exchange(n, 0);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /**
+     Matches a file name against a glob pattern of `*` and `?`, backtracking to the last `*`.
+   */
+  static bool glob_match(const std::string_view a_pattern, const std::string_view a_name) noexcept
+  {
+    size_t p = 0, n = 0, star = std::string_view::npos, resume = 0;
+    while (n < a_name.size()) {
+      if (p < a_pattern.size() && (a_pattern[p] == '?' || a_pattern[p] == a_name[n])) {
+        p++, n++;
+      } else if (p < a_pattern.size() && a_pattern[p] == '*') {
+        star = p++, resume = n;
+      } else if (star != std::string_view::npos) {
+        p = star + 1, n = ++resume;
+      } else {
+        return false;
+      }
+    }
+    while (p < a_pattern.size() && a_pattern[p] == '*') p++;
+    return p == a_pattern.size();
+  }
+
+  std::vector<std::string> files_;
+  std::error_code error_;
+};
+
+}
+#endif
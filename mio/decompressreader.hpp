@@ -0,0 +1,405 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_DECOMPRESS_READER_HPP
+#define WXLIB_MIO_DECOMPRESS_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/streamreader.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// The decoders need their libraries to be linked, so they are opted in, e.g. by CMake when found.
+#ifdef WXLIB_MIO_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WXLIB_MIO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace mio {
+
+/**
+   A streaming decoder, decoding as much of [in, in_end) into [out, out_end) as it can, and
+   advancing in and out past the bytes consumed and produced. Returns true once the end of the
+   compressed stream has been decoded. As the whole input is given, returning false without
+   progress means the stream is truncated.
+ */
+template<typename D>
+concept StreamDecoder = requires(D &d, const char *&in, const char *in_end, char *&out, char *out_end, std::error_code &error) {
+  { d.decode(in, in_end, out, out_end, error) } -> std::same_as<bool>;
+};
+
+/**
+   Copies the input as is, for uncompressed files.
+ */
+struct PlainDecoder
+{
+  bool decode(const char *&in, const char *in_end, char *&out, char *out_end, std::error_code &) noexcept
+  {
+    const auto n = static_cast<size_t>(std::min(in_end - in, out_end - out));
+    std::memcpy(out, in, n);
+    in += n;
+    out += n;
+    return in == in_end;
+  }
+};
+
+#ifdef WXLIB_MIO_WITH_ZLIB
+/**
+   Decodes gzip or zlib streams with zlib, including concatenated gzip members, e.g. from pigz.
+ */
+class GzipDecoder
+{
+public:
+  GzipDecoder() = default;
+  GzipDecoder(const GzipDecoder &) = delete;
+  GzipDecoder &operator=(const GzipDecoder &) = delete;
+
+  ~GzipDecoder()
+  {
+    if (initialized_) ::inflateEnd(&stream_);
+  }
+
+  bool decode(const char *&in, const char *in_end, char *&out, char *out_end, std::error_code &error) noexcept
+  {
+    // 15 + 32: the largest window, with gzip or zlib header detected.
+    if (!initialized_ && ::inflateInit2(&stream_, 15 + 32) != Z_OK) {
+      error = std::make_error_code(std::errc::not_enough_memory);
+      return false;
+    }
+    initialized_ = true;
+
+    while (out != out_end) {
+      // zlib counts in uInt; large buffers are decoded in pieces.
+      const auto avail_in = static_cast<uInt>(std::min<std::ptrdiff_t>(in_end - in, std::numeric_limits<uInt>::max()));
+      const auto avail_out = static_cast<uInt>(std::min<std::ptrdiff_t>(out_end - out, std::numeric_limits<uInt>::max()));
+      stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+      stream_.avail_in = avail_in;
+      stream_.next_out = reinterpret_cast<Bytef *>(out);
+      stream_.avail_out = avail_out;
+
+      const auto status = ::inflate(&stream_, Z_NO_FLUSH);
+      in += avail_in - stream_.avail_in;
+      out += avail_out - stream_.avail_out;
+
+      if (status == Z_STREAM_END) {
+        // Another gzip member may follow.
+        if (in == in_end) return true;
+        ::inflateReset(&stream_);
+      } else if (status == Z_BUF_ERROR) {
+        // No progress possible without more input.
+        return false;
+      } else if (status == Z_MEM_ERROR) {
+        error = std::make_error_code(std::errc::not_enough_memory);
+        return false;
+      } else if (status != Z_OK) {
+        error = std::make_error_code(std::errc::illegal_byte_sequence);
+        return false;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  z_stream stream_{};
+  bool initialized_{false};
+};
+#endif
+
+#ifdef WXLIB_MIO_WITH_ZSTD
+/**
+   Decodes zstd streams, including concatenated frames, e.g. from zstd -T0.
+ */
+class ZstdDecoder
+{
+public:
+  ZstdDecoder() : stream_{::ZSTD_createDStream()}
+  {
+  }
+
+  ZstdDecoder(const ZstdDecoder &) = delete;
+  ZstdDecoder &operator=(const ZstdDecoder &) = delete;
+
+  ~ZstdDecoder()
+  {
+    ::ZSTD_freeDStream(stream_);
+  }
+
+  bool decode(const char *&in, const char *in_end, char *&out, char *out_end, std::error_code &error) noexcept
+  {
+    if (!stream_) {
+      error = std::make_error_code(std::errc::not_enough_memory);
+      return false;
+    }
+
+    auto input = ZSTD_inBuffer{in, static_cast<size_t>(in_end - in), 0};
+    auto output = ZSTD_outBuffer{out, static_cast<size_t>(out_end - out), 0};
+    auto status = size_t{1};
+
+    // Keeps going with no input left, as output may still be pending.
+    while (output.pos < output.size) {
+      const auto consumed = input.pos;
+      const auto produced = output.pos;
+      status = ::ZSTD_decompressStream(stream_, &output, &input);
+      if (::ZSTD_isError(status)) {
+        error = std::make_error_code(std::errc::illegal_byte_sequence);
+        return false;
+      }
+      if ((status == 0 && input.pos == input.size) || (input.pos == consumed && output.pos == produced)) break;
+    }
+
+    in += input.pos;
+    out += output.pos;
+
+    // 0 once a frame is complete, and no more output is pending.
+    return status == 0 && in == in_end;
+  }
+
+private:
+  ZSTD_DStream *stream_;
+};
+#endif
+
+/**
+   Detects the format from the magic bytes of the stream, and decodes it with the matching
+   decoder: gzip and zlib (WXLIB_MIO_WITH_ZLIB), zstd (WXLIB_MIO_WITH_ZSTD), or no compression.
+   Known formats whose decoder is not compiled in, e.g. lz4, are reported as not supported.
+ */
+class AutoDecoder
+{
+public:
+  bool decode(const char *&in, const char *in_end, char *&out, char *out_end, std::error_code &error) noexcept
+  {
+    if (std::holds_alternative<std::monostate>(decoder_)) select(std::string_view{in, static_cast<size_t>(in_end - in)}, error);
+    if (error) return false;
+
+    return std::visit([&](auto &a_decoder) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(a_decoder)>, std::monostate>) return false;
+      else return a_decoder.decode(in, in_end, out, out_end, error);
+    }, decoder_);
+  }
+
+private:
+  void select(const std::string_view a_head, std::error_code &error) noexcept
+  {
+    auto starts_with = [&](std::string_view a_magic) { return a_head.starts_with(a_magic); };
+    const auto zstd = starts_with("\x28\xb5\x2f\xfd");
+    const auto gzip = starts_with("\x1f\x8b") || starts_with("\x78\x01") || starts_with("\x78\x5e") || starts_with("\x78\x9c") || starts_with("\x78\xda");
+    const auto lz4 = starts_with("\x04\x22\x4d\x18");
+
+    if (zstd) {
+#ifdef WXLIB_MIO_WITH_ZSTD
+      decoder_.emplace<ZstdDecoder>();
+      return;
+#endif
+    } else if (gzip) {
+#ifdef WXLIB_MIO_WITH_ZLIB
+      decoder_.emplace<GzipDecoder>();
+      return;
+#endif
+    } else if (!lz4) {
+      decoder_.emplace<PlainDecoder>();
+      return;
+    }
+
+    error = std::make_error_code(std::errc::not_supported);
+  }
+
+  std::variant<std::monostate,
+               PlainDecoder
+#ifdef WXLIB_MIO_WITH_ZLIB
+               , GzipDecoder
+#endif
+#ifdef WXLIB_MIO_WITH_ZSTD
+               , ZstdDecoder
+#endif
+               > decoder_;
+};
+
+/**
+   Options of a DecodedSource.
+ */
+struct DecodeOptions
+{
+  // Size in bytes of each buffer of decoded bytes.
+  size_t buffer_size{size_t{4} << 20};
+
+  // Number of buffers, i.e., how far decoding may run ahead of line splitting.
+  size_t queue_depth{4};
+};
+
+/**
+   A StreamSource decoding a memory mapped file on a thread of its own, into a ring of buffers,
+   so that decoding overlaps with line splitting and processing.
+ */
+template<typename DecoderT>
+requires StreamDecoder<DecoderT>
+class DecodedSource
+{
+public:
+  using options_type = DecodeOptions;
+
+  DecodedSource(const std::string &path, const DecodeOptions &options, std::error_code &error)
+      : buffer_size_{std::max(options.buffer_size, size_t{1})},
+        buffers_(buffer_size_ * std::max(options.queue_depth, size_t{1})),
+        sizes_(std::max(options.queue_depth, size_t{1}), 0)
+  {
+    // An empty file cannot be mapped; it is an empty stream.
+    if (std::filesystem::file_size(path, error) == 0 && !error) {
+      finished_ = true;
+      return;
+    }
+
+    if (!error) input_.map(path, 0, map_entire_file, access_hint::sequential, error);
+    if (error) return;
+    decoder_ = std::thread([this] { run(); });
+  }
+
+  DecodedSource(const DecodedSource &) = delete;
+  DecodedSource &operator=(const DecodedSource &) = delete;
+
+  ~DecodedSource()
+  {
+    {
+      auto lock = std::lock_guard{mutex_};
+      stop_ = true;
+    }
+    changed_.notify_all();
+    if (decoder_.joinable()) decoder_.join();
+  }
+
+  [[nodiscard]] size_t depth() const noexcept
+  {
+    return sizes_.size();
+  }
+
+  /**
+     Checks whether the stream ends before the chunk, waiting for the decoder to know.
+   */
+  [[nodiscard]] bool exhausted(const size_t chunk) const noexcept
+  {
+    auto lock = std::unique_lock{mutex_};
+    changed_.wait(lock, [&] { return decoded_ > chunk || finished_; });
+    return decoded_ <= chunk;
+  }
+
+  std::string_view acquire(const size_t chunk, std::error_code &error) noexcept
+  {
+    auto lock = std::unique_lock{mutex_};
+    changed_.wait(lock, [&] { return decoded_ > chunk || finished_; });
+    if (decoded_ > chunk) return {buffer_of(chunk % depth()), sizes_[chunk % depth()]};
+
+    error = error_;
+    return {};
+  }
+
+  void release(const size_t chunk, std::error_code &) noexcept
+  {
+    {
+      auto lock = std::lock_guard{mutex_};
+      released_ = std::max(released_, chunk + 1);
+    }
+    changed_.notify_all();
+  }
+
+private:
+  [[nodiscard]] const char *buffer_of(const size_t slot) const noexcept
+  {
+    return buffers_.data() + slot * buffer_size_;
+  }
+
+  /**
+     Decodes the input chunk by chunk, each into the buffer released by the chunk depth() before.
+   */
+  void run() noexcept
+  {
+    const char *in = input_.data();
+    const char *in_end = std::next(in, static_cast<std::ptrdiff_t>(input_.size()));
+    auto done = in == in_end;
+    std::error_code error;
+
+    for (size_t chunk = 0; !done && !error; chunk++) {
+      {
+        auto lock = std::unique_lock{mutex_};
+        changed_.wait(lock, [&] { return chunk < released_ + depth() || stop_; });
+        if (stop_) break;
+      }
+
+      char *begin = buffers_.data() + (chunk % depth()) * buffer_size_;
+      char *out = begin;
+      char *out_end = begin + buffer_size_;
+
+      while (!done && !error && out != out_end) {
+        const char *consumed = in;
+        const char *produced = out;
+        done = decoder_impl_.decode(in, in_end, out, out_end, error);
+
+        // No progress with the whole input given, the stream is truncated.
+        if (!done && !error && in == consumed && out == produced)
+          error = std::make_error_code(std::errc::io_error);
+      }
+
+      if (out == begin) break;
+      {
+        auto lock = std::lock_guard{mutex_};
+        sizes_[chunk % depth()] = static_cast<size_t>(out - begin);
+        decoded_ = chunk + 1;
+      }
+      changed_.notify_all();
+    }
+
+    {
+      auto lock = std::lock_guard{mutex_};
+      error_ = error;
+      finished_ = true;
+    }
+    changed_.notify_all();
+  }
+
+  size_t buffer_size_;
+  std::vector<char> buffers_;
+  std::vector<size_t> sizes_;
+  mmap_source input_;
+  DecoderT decoder_impl_;
+
+  mutable std::mutex mutex_;
+  mutable std::condition_variable changed_;
+  size_t decoded_{0};  // Number of chunks decoded.
+  size_t released_{0}; // Number of chunks released.
+  bool finished_{false};
+  bool stop_{false};
+  std::error_code error_;
+
+  std::thread decoder_;
+};
+
+/**
+   Reads a compressed file line by line, decoding it in a pipeline rather than to a temporary
+   file, see BasicStreamingStringReader and AutoDecoder.
+
+   @code
+     mio::DecompressingStringReader reader("probes.csv.gz");
+     auto n = reader.async_getline([](int a_worker_id, const std::string_view a_line) { return 0; }, 4);
+   @endcode
+ */
+using DecompressingStringReader = BasicStreamingStringReader<DecodedSource<AutoDecoder>>;
+
+}
+#endif
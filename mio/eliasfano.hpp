@@ -0,0 +1,387 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_ELIAS_FANO_HPP
+#define WXLIB_MIO_ELIAS_FANO_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   An Elias-Fano encoding of a non-decreasing sequence of n integers smaller than a universe u,
+   e.g. the offsets of the lines of a file, taking n * (2 + log2(u / n)) bits instead of 32 or
+   64 bits per integer, with O(1) access to any of them.
+
+   Each integer is split into its low log2(u / n) bits, packed back to back, and its high bits,
+   stored in unary as one set bit per integer in a bit vector of n + u / 2^low_width bits. The
+   i-th integer is read back by selecting the i-th set bit of the high bits, helped by samples
+   of the position of every select_sample-th set bit.
+
+   The encoding is held in a single array of 64-bit words, [header | low bits | high bits |
+   samples], either owned, or viewing memory such as a mapped sidecar file, see attach().
+
+   @code
+     mio::EliasFano ef;
+     ef.reset(3, 100);
+     mio::EliasFano::Writer writer(ef, 0);
+     for (auto v : {3, 42, 99}) writer.push(v);
+     writer.finish();
+     ef.finish();
+     // ef[1] == 42
+   @endcode
+ */
+class EliasFano
+{
+public:
+  /**
+     Number of set bits of the high bits between two samples.
+   */
+  static constexpr size_t select_sample = 256;
+
+  /**
+     Appends the integers of a range of consecutive indices, e.g. the lines of one block of a
+     file. Writers of different ranges may run concurrently; each owns the words of its range,
+     and merges the words shared with the neighbouring ranges atomically.
+   */
+  class Writer
+  {
+  public:
+    /**
+       Writes the integers from index a_first on.
+     */
+    Writer(EliasFano &a_ef, size_t a_first) noexcept
+      : low_{a_ef.low_words(), a_first * a_ef.low_width()},
+        high_{a_ef.high_words(), 0},
+        low_width_{a_ef.low_width()},
+        index_{a_first}
+    {
+    }
+
+    /**
+       Appends the next integer, no smaller than the previous one.
+     */
+    void push(const uint64_t a_value) noexcept
+    {
+      if (low_width_ > 0) low_.put(a_value & ((uint64_t{1} << low_width_) - 1), low_width_);
+      high_.set((a_value >> low_width_) + index_++);
+    }
+
+    /**
+       Flushes the last words written. Must be called once all the integers are pushed.
+     */
+    void finish() noexcept
+    {
+      low_.flush();
+      high_.flush();
+    }
+
+  private:
+    /**
+       Writes bits at ascending positions, flushing each word once, atomically for the first and
+       the last word, which other writers may share.
+     */
+    struct Bits
+    {
+      Bits(uint64_t *a_words, const size_t a_pos) noexcept : words{a_words}, pos{a_pos}
+      {
+      }
+
+      void put(const uint64_t a_bits, const size_t a_width) noexcept
+      {
+        move_to(pos / 64);
+        const auto offset = pos % 64;
+        acc |= a_bits << offset;
+        if (offset + a_width > 64) {
+          move_to(word + 1);
+          acc = a_bits >> (64 - offset);
+        }
+        pos += a_width;
+      }
+
+      void set(const size_t a_pos) noexcept
+      {
+        move_to(a_pos / 64);
+        acc |= uint64_t{1} << (a_pos % 64);
+      }
+
+      void move_to(const size_t a_word) noexcept
+      {
+        if (a_word == word) return;
+        if (word == none) {
+          word = a_word;
+          return;
+        }
+
+        if (first) {
+          std::atomic_ref<uint64_t>(words[word]).fetch_or(acc, std::memory_order_relaxed);
+          first = false;
+        } else {
+          words[word] = acc;
+        }
+        word = a_word;
+        acc = 0;
+      }
+
+      void flush() noexcept
+      {
+        if (word != none && acc != 0) std::atomic_ref<uint64_t>(words[word]).fetch_or(acc, std::memory_order_relaxed);
+        acc = 0;
+      }
+
+      static constexpr size_t none = ~size_t{0};
+
+      uint64_t *words;
+      size_t pos;
+      size_t word{none};
+      uint64_t acc{0};
+      bool first{true};
+    };
+
+    Bits low_;
+    Bits high_;
+    size_t low_width_;
+    size_t index_;
+  };
+
+  EliasFano() = default;
+  EliasFano(const EliasFano &) = delete;
+  EliasFano(EliasFano &&) = default;
+  EliasFano &operator=(const EliasFano &) = delete;
+  EliasFano &operator=(EliasFano &&) = default;
+  ~EliasFano() = default;
+
+  /**
+     Prepares an owned, zeroed encoding of a_count integers smaller than a_universe, to be filled
+     by writers, then completed by finish().
+   */
+  void reset(const size_t a_count, const uint64_t a_universe)
+  {
+    const auto low_width = a_count == 0 ? 0 : static_cast<size_t>(std::bit_width(std::max<uint64_t>(a_universe / a_count, 1)) - 1);
+    const auto low_words = (a_count * low_width + 63) / 64;
+    const auto high_words = (a_count + (a_universe >> low_width) + 1 + 63) / 64;
+    const auto samples = (a_count + select_sample - 1) / select_sample;
+
+    owned_.assign(header_words + low_words + high_words + samples, 0);
+    owned_[0] = a_count;
+    owned_[1] = low_width;
+    owned_[2] = low_words;
+    owned_[3] = high_words;
+    owned_[4] = samples;
+    data_ = owned_;
+  }
+
+  /**
+     Samples the positions of the set bits of the high bits, once all the integers are written.
+   */
+  void finish() noexcept
+  {
+    auto *samples = owned_.data() + header_words + owned_[2] + owned_[3];
+    const auto *high = high_words();
+    auto ones = size_t{0};
+
+    for (size_t w = 0; w < owned_[3]; w++) {
+      const auto n = static_cast<size_t>(std::popcount(high[w]));
+      // The next sample falls into this word.
+      for (auto next = (ones + select_sample - 1) / select_sample * select_sample; next < ones + n; next += select_sample)
+        samples[next / select_sample] = w * 64 + select_in_word(high[w], next - ones);
+      ones += n;
+    }
+  }
+
+  /**
+     Views an encoding previously saved from data(), e.g. a mapped sidecar file, which must
+     outlive this object.
+
+     \returns False if the words do not hold a valid encoding, in which case this is left empty.
+   */
+  bool attach(const std::span<const uint64_t> a_words) noexcept
+  {
+    owned_.clear();
+    data_ = {};
+    if (a_words.size() < header_words) return false;
+
+    const auto count = a_words[0];
+    const auto low_width = a_words[1];
+    // Each integer takes a bit of the high bits at least, which bounds the sizes computed below.
+    const auto valid = low_width < 64
+        && count <= a_words.size() * 64
+        && a_words[3] <= a_words.size()
+        && a_words[2] == (count * low_width + 63) / 64
+        && a_words[4] == (count + select_sample - 1) / select_sample
+        && a_words[3] >= (count + 63) / 64
+        && a_words.size() == header_words + a_words[2] + a_words[3] + a_words[4];
+
+    if (!valid) return false;
+
+    // The high bits must hold one set bit per integer, and the samples their positions, so
+    // that select() never scans past the high bits, however corrupt the words.
+    const auto *high = a_words.data() + header_words + a_words[2];
+    const auto *samples = high + a_words[3];
+    auto ones = size_t{0};
+    for (size_t w = 0; w < a_words[3]; w++) {
+      const auto n = static_cast<size_t>(std::popcount(high[w]));
+      // More set bits than integers would index past the samples.
+      if (ones + n > count) return false;
+      for (auto next = (ones + select_sample - 1) / select_sample * select_sample; next < ones + n; next += select_sample)
+        if (samples[next / select_sample] != w * 64 + select_in_word(high[w], next - ones)) return false;
+      ones += n;
+    }
+    if (ones != count) return false;
+
+    data_ = a_words;
+    return true;
+  }
+
+  /**
+     The words of the encoding, to be saved and attached later.
+   */
+  [[nodiscard]] std::span<const uint64_t> data() const noexcept
+  {
+    return data_;
+  }
+
+  /**
+     Returns the number of integers.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return data_.empty() ? 0 : static_cast<size_t>(data_[0]);
+  }
+
+  /**
+     Returns the i-th integer.
+
+     Precondition - i < size().
+   */
+  [[nodiscard]] uint64_t operator[](const size_t i) const noexcept
+  {
+    return ((select(i) - i) << low_width()) | low(i);
+  }
+
+  /**
+     Returns the i-th and the (i + 1)-th integers, selecting only once.
+
+     Precondition - i + 1 < size().
+   */
+  [[nodiscard]] std::pair<uint64_t, uint64_t> pair(const size_t i) const noexcept
+  {
+    const auto *high = high_words();
+    const auto pos = select(i);
+
+    // The next set bit, in this word or a following one.
+    auto w = (pos + 1) / 64;
+    auto bits = (pos + 1) % 64 == 0 ? high[w] : high[w] & (~uint64_t{0} << ((pos + 1) % 64));
+    while (bits == 0) bits = high[++w];
+    const auto next = w * 64 + static_cast<size_t>(std::countr_zero(bits));
+
+    return {((pos - i) << low_width()) | low(i), ((next - i - 1) << low_width()) | low(i + 1)};
+  }
+
+  /**
+     Returns the size of the encoding in bytes.
+   */
+  [[nodiscard]] size_t size_bytes() const noexcept
+  {
+    return data_.size_bytes();
+  }
+
+private:
+  static constexpr size_t header_words = 5;
+
+  [[nodiscard]] size_t low_width() const noexcept
+  {
+    return static_cast<size_t>(data_[1]);
+  }
+
+  [[nodiscard]] uint64_t *low_words() noexcept
+  {
+    return owned_.data() + header_words;
+  }
+
+  [[nodiscard]] uint64_t *high_words() noexcept
+  {
+    return owned_.data() + header_words + owned_[2];
+  }
+
+  [[nodiscard]] const uint64_t *high_words() const noexcept
+  {
+    return data_.data() + header_words + data_[2];
+  }
+
+  [[nodiscard]] uint64_t low(const size_t i) const noexcept
+  {
+    const auto width = low_width();
+    if (width == 0) return 0;
+
+    const auto *words = data_.data() + header_words;
+    const auto pos = i * width;
+    const auto offset = pos % 64;
+    auto bits = words[pos / 64] >> offset;
+    if (offset + width > 64) bits |= words[pos / 64 + 1] << (64 - offset);
+    return bits & ((uint64_t{1} << width) - 1);
+  }
+
+  /**
+     Position of the i-th set bit of the high bits, scanning from the nearest sample.
+   */
+  [[nodiscard]] size_t select(const size_t i) const noexcept
+  {
+    const auto *high = high_words();
+    const auto *samples = high + data_[3];
+    const auto pos = static_cast<size_t>(samples[i / select_sample]);
+
+    auto w = pos / 64;
+    auto bits = high[w] & (~uint64_t{0} << (pos % 64));
+    auto rank = i % select_sample;
+    for (auto n = static_cast<size_t>(std::popcount(bits)); rank >= n; n = static_cast<size_t>(std::popcount(bits))) {
+      rank -= n;
+      bits = high[++w];
+    }
+
+    return w * 64 + select_in_word(bits, rank);
+  }
+
+  /**
+     Position of the r-th set bit of the word, a byte at a time, then by table.
+
+     Precondition - r < popcount(a_word).
+   */
+  static size_t select_in_word(const uint64_t a_word, size_t r) noexcept
+  {
+    auto shift = size_t{0};
+    for (auto n = static_cast<size_t>(std::popcount((a_word >> shift) & 0xFF)); r >= n;
+         n = static_cast<size_t>(std::popcount((a_word >> shift) & 0xFF))) {
+      r -= n;
+      shift += 8;
+    }
+
+    return shift + select_in_byte[((a_word >> shift) & 0xFF) * 8 + r];
+  }
+
+  /**
+     Position of the r-th set bit of each byte value, at [byte * 8 + r].
+   */
+  static constexpr auto select_in_byte = [] {
+    auto table = std::array<uint8_t, 256 * 8>{};
+    for (size_t b = 0; b < 256; b++)
+      for (size_t bit = 0, r = 0; bit < 8; bit++)
+        if (b & (size_t{1} << bit)) table[b * 8 + r++] = static_cast<uint8_t>(bit);
+    return table;
+  }();
+
+  std::vector<uint64_t> owned_;
+  std::span<const uint64_t> data_;
+};
+
+}
+#endif
@@ -0,0 +1,599 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_EXECUTOR_HPP
+#define WXLIB_MIO_EXECUTOR_HPP
+
+#include <mio/mio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mio {
+
+/**
+   Determines the number of threads that can effectively run in parallel for this
+   process, i.e. std::thread::hardware_concurrency() capped by the cgroup CPU quota
+   of the container (Linux only, both cgroup v1 and v2), if any.
+
+   The value is computed once on first call and then cached. Never returns 0.
+
+   \returns A size_t.
+ */
+inline size_t available_concurrency() noexcept
+{
+  static const size_t concurrency = [] {
+    auto result = std::max(size_t{std::thread::hardware_concurrency()}, size_t{1});
+#ifdef __linux__
+    // Rounds quota/period up, so that a quota of 1.5 CPUs yields 2 threads.
+    auto apply_quota = [&result](double a_quota, double a_period) {
+      if (a_quota > 0 && a_period > 0)
+        result = std::clamp(static_cast<size_t>((a_quota + a_period - 1) / a_period), size_t{1}, result);
+    };
+
+    // cgroup v2, formatted as "<quota> <period>", or "max <period>" when unlimited.
+    if (std::ifstream cpu_max{"/sys/fs/cgroup/cpu.max"}) {
+      std::string quota;
+      double period{0};
+      if ((cpu_max >> quota >> period) && quota != "max")
+        apply_quota(std::strtod(quota.c_str(), nullptr), period);
+    } else {
+      // cgroup v1, quota is -1 when unlimited.
+      std::ifstream quota_file{"/sys/fs/cgroup/cpu/cpu.cfs_quota_us"};
+      std::ifstream period_file{"/sys/fs/cgroup/cpu/cpu.cfs_period_us"};
+      double quota{0}, period{0};
+      if ((quota_file >> quota) && (period_file >> period))
+        apply_quota(quota, period);
+    }
+#endif
+    return result;
+  }();
+
+  return concurrency;
+}
+
+/**
+   A NUMA node, with the CPUs of it the process may run on.
+ */
+struct NumaNode
+{
+  int id{0};
+  std::vector<int> cpus;
+};
+
+/**
+   Returns the NUMA nodes with CPUs the process may run on, read once from sysfs, in the order
+   of their IDs. There is a single node 0 with no CPUs listed off Linux, or if sysfs has no nodes.
+ */
+inline const std::vector<NumaNode> &numa_nodes()
+{
+  static const std::vector<NumaNode> nodes = [] {
+    auto result = std::vector<NumaNode>{};
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const auto restricted = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    // A cpulist is formatted as "0-15,32-47".
+    for (int id = 0; id < 1024; id++) {
+      std::ifstream cpulist{"/sys/devices/system/node/node" + std::to_string(id) + "/cpulist"};
+      if (!cpulist) continue;
+
+      auto node = NumaNode{id, {}};
+      std::string range;
+      while (std::getline(cpulist, range, ',')) {
+        auto first = 0, last = -1;
+        auto dash = char{0};
+        std::istringstream in{range};
+        if (!(in >> first)) continue;
+        last = (in >> dash >> last) ? last : first;
+        for (auto cpu = first; cpu <= last; cpu++)
+          if (!restricted || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) node.cpus.push_back(cpu);
+      }
+      if (!node.cpus.empty()) result.push_back(std::move(node));
+    }
+#endif
+    if (result.empty()) result.push_back(NumaNode{});
+    return result;
+  }();
+
+  return nodes;
+}
+
+/**
+   Returns the NUMA node of the CPU the calling thread runs on, 0 off Linux.
+ */
+inline int current_numa_node() noexcept
+{
+#ifdef __linux__
+  unsigned cpu = 0, node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return static_cast<int>(node);
+#endif
+  return 0;
+}
+
+/**
+   Where a parallel read places its workers, and the pages they read first, see NumaScope.
+ */
+enum class NumaPlacement
+{
+  none,      // Where the OS puts them.
+  local,     // Each worker pinned to the CPUs of a node, consecutive workers on the same node,
+             // so that the pages of a partition are read into, and processed on, the same node.
+  interleave // Pages read in interleaved over the nodes, e.g. for data every node scans later.
+};
+
+/**
+   Returns the NUMA node the worker a_worker of a_count runs on with NumaPlacement::local:
+   consecutive workers share a node, the nodes taking equal shares of them in order.
+ */
+inline int numa_node_of(const size_t a_worker, const size_t a_count) noexcept
+{
+  const auto &nodes = numa_nodes();
+  return nodes[std::min(a_worker * nodes.size() / std::max(a_count, size_t{1}), nodes.size() - 1)].id;
+}
+
+/**
+   Places the calling thread, the worker a_worker of a_count, for the lifetime of the scope, and
+   restores its CPU affinity and memory policy afterwards. Linux only, does nothing elsewhere.
+
+   - `local` pins the thread to the CPUs of numa_node_of(a_worker, a_count), so that the pages it
+     touches first, of a file read in, or of the buffers it allocates, are on that node.
+   - `interleave` sets the memory policy of the thread to interleave the pages it touches first
+     over all the nodes.
+ */
+class NumaScope
+{
+public:
+  NumaScope(const NumaPlacement a_placement, [[maybe_unused]] const size_t a_worker, [[maybe_unused]] const size_t a_count) noexcept
+      : placement_{numa_nodes().size() > 1 ? a_placement : NumaPlacement::none}
+  {
+#ifdef __linux__
+    if (placement_ == NumaPlacement::local) {
+      const auto node = numa_node_of(a_worker, a_count);
+      const auto &nodes = numa_nodes();
+      const auto it = std::find_if(nodes.begin(), nodes.end(), [node](const NumaNode &a_node) { return a_node.id == node; });
+
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (const auto cpu: it->cpus) CPU_SET(cpu, &set);
+      restore_ = ::sched_getaffinity(0, sizeof(saved_), &saved_) == 0 && ::sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+#ifdef WXLIB_MIO_HAS_MBIND
+    if (placement_ == NumaPlacement::interleave) {
+      unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {};
+      constexpr auto bits = 8 * sizeof(unsigned long);
+      for (const auto &node: numa_nodes()) mask[node.id / bits] |= 1UL << (node.id % bits);
+      restore_ = ::syscall(__NR_set_mempolicy, MPOL_INTERLEAVE, mask, bits * std::size(mask) + 1) == 0;
+    }
+#endif
+#endif
+  }
+
+  NumaScope(const NumaScope &) = delete;
+  NumaScope &operator=(const NumaScope &) = delete;
+
+  ~NumaScope()
+  {
+    if (!restore_) return;
+#ifdef __linux__
+    if (placement_ == NumaPlacement::local) ::sched_setaffinity(0, sizeof(saved_), &saved_);
+#ifdef WXLIB_MIO_HAS_MBIND
+    if (placement_ == NumaPlacement::interleave) ::syscall(__NR_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+#endif
+#endif
+  }
+
+private:
+  NumaPlacement placement_;
+  bool restore_{false};
+#ifdef __linux__
+  cpu_set_t saved_{};
+#endif
+};
+
+class TaskGroup;
+
+/**
+   A persistent pool of worker threads with work stealing, shared by the parallel reads, parses and
+   sorts of wxlib, see Executor::shared(), so that none of them pays for starting threads, and
+   running several of them at once does not oversubscribe the cores.
+
+   Each worker has a deque of tasks: the tasks a worker submits go to the back of its own deque,
+   which it runs last in first out, and an idle worker steals from the front of the deques of the
+   others. Tasks are submitted through a TaskGroup, whose wait() runs the pending tasks on the
+   waiting thread instead of blocking it, so that tasks may wait for the tasks they submit.
+
+   The pool grows on demand to the number of threads a caller asks for, see run_workers, e.g. the
+   workers of a StringReaderAsync read, which may wait for one another; it never shrinks.
+
+   @code
+     auto &executor = mio::Executor::shared();
+     executor.parallel_for(0, links.size(), [&](size_t a_first, size_t a_last) {
+       for (auto i = a_first; i < a_last; i++) update(links[i]);
+     });
+
+     mio::TaskGroup group;
+     group.run([&] { load_nodes(); });
+     group.run([&] { load_links(); });
+     group.wait();
+   @endcode
+ */
+class Executor
+{
+public:
+  /**
+     Largest number of worker threads a pool grows to.
+   */
+  static constexpr size_t max_threads = 512;
+
+  /**
+     \param a_num_threads Number of worker threads to start with, 0 for none until asked for.
+     \param a_pin_threads Whether each worker is pinned to a core, see pin_threads.
+   */
+  explicit Executor(const size_t a_num_threads = available_concurrency(), const bool a_pin_threads = false) : pinned_{a_pin_threads}
+  {
+    workers_.reserve(max_threads);
+    reserve(a_num_threads);
+  }
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  /**
+     Runs the tasks already submitted, then stops the workers.
+   */
+  ~Executor()
+  {
+    {
+      std::scoped_lock lock{sleep_mutex_};
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w: workers_) w->thread.join();
+  }
+
+  /**
+     The executor shared by the modules of wxlib, started with available_concurrency() workers on
+     first use.
+   */
+  static Executor &shared()
+  {
+    static Executor executor;
+    return executor;
+  }
+
+  /**
+     Number of worker threads.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return count_.load(std::memory_order_acquire);
+  }
+
+  /**
+     Grows the pool to at least a_num_threads worker threads, capped at max_threads.
+   */
+  void reserve(const size_t a_num_threads)
+  {
+    std::scoped_lock lock{grow_mutex_};
+    for (auto i = workers_.size(); i < std::min(a_num_threads, max_threads); i++) {
+      workers_.push_back(std::make_unique<Worker>());
+      workers_.back()->thread = std::thread([this, i] { run(i); });
+      if (pinned_) pin(i);
+      count_.store(i + 1, std::memory_order_release);
+    }
+  }
+
+  /**
+     Pins each worker to a core, the i-th worker to the i-th CPU the process may run on, modulo
+     their number, and the workers started later too. Linux only, does nothing elsewhere.
+   */
+  void pin_threads()
+  {
+    std::scoped_lock lock{grow_mutex_};
+    pinned_ = true;
+    for (size_t i = 0; i < workers_.size(); i++) pin(i);
+  }
+
+  /**
+     Runs a_task(i) for each i in [0, a_count) concurrently, a_task(0) on the calling thread, and
+     the others on workers, growing the pool to a_count - 1 workers first, so that the tasks may
+     wait for one another as threads of their own would. Returns once all of them have, rethrowing
+     the first exception thrown by a task, if any.
+   */
+  template<typename F>
+  void run_workers(size_t a_count, const F &a_task);
+
+  /**
+     Splits [a_first, a_last) into ranges of a_grain indices, or about 4 per worker if a_grain is
+     0, and runs a_body(first, last) for each range on the workers and the calling thread. Returns
+     once all the ranges are done, rethrowing the first exception thrown, if any.
+   */
+  template<typename F>
+  void parallel_for(size_t a_first, size_t a_last, const F &a_body, size_t a_grain = 0);
+
+  /**
+     Submits a task run on a worker with no group to wait for it, e.g. to resume a coroutine. The
+     task must not throw.
+   */
+  template<typename F>
+  void post(F &&a_task)
+  {
+    if (size() == 0) reserve(1);
+    push(Task{std::forward<F>(a_task)});
+  }
+
+  /**
+     Runs one pending task on the calling thread, if any, taken from the back of the deque of the
+     calling worker, or stolen from the front of the others.
+
+     \returns True if a task was run.
+   */
+  bool run_pending()
+  {
+    const auto self = current_ == this ? current_index_ : size();
+    auto task = Task{};
+    if (!pop(self, task)) return false;
+    task();
+    return true;
+  }
+
+private:
+  friend class TaskGroup;
+
+  using Task = std::function<void()>;
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void push(Task &&a_task)
+  {
+    const auto count = size();
+    const auto index = current_ == this ? current_index_ : next_.fetch_add(1, std::memory_order_relaxed) % count;
+    {
+      std::scoped_lock lock{workers_[index]->mutex};
+      workers_[index]->tasks.push_back(std::move(a_task));
+    }
+
+    queued_.fetch_add(1, std::memory_order_release);
+    {
+      // Orders the wake up after a worker about to sleep has checked queued_.
+      std::scoped_lock lock{sleep_mutex_};
+    }
+    wake_.notify_one();
+  }
+
+  bool pop(const size_t a_self, Task &a_task)
+  {
+    const auto count = size();
+    if (a_self < count) {
+      auto &own = *workers_[a_self];
+      std::scoped_lock lock{own.mutex};
+      if (!own.tasks.empty()) {
+        a_task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    for (size_t k = 1; k <= count; k++) {
+      auto &victim = *workers_[(a_self + k) % count];
+      std::scoped_lock lock{victim.mutex};
+      if (!victim.tasks.empty()) {
+        a_task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(const size_t a_index)
+  {
+    current_ = this;
+    current_index_ = a_index;
+
+    for (auto task = Task{};;) {
+      if (pop(a_index, task)) {
+        task();
+        task = nullptr;
+        continue;
+      }
+
+      std::unique_lock lock{sleep_mutex_};
+      wake_.wait(lock, [this] { return stopping_ || queued_.load(std::memory_order_acquire) > 0; });
+      if (stopping_ && queued_.load(std::memory_order_acquire) == 0) return;
+    }
+  }
+
+  void pin([[maybe_unused]] const size_t a_index)
+  {
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) return;
+
+    // The (a_index % allowed)-th CPU allowed.
+    auto n = static_cast<int>(a_index % static_cast<size_t>(CPU_COUNT(&allowed)));
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (!CPU_ISSET(cpu, &allowed) || n-- != 0) continue;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      ::pthread_setaffinity_np(workers_[a_index]->thread.native_handle(), sizeof(set), &set);
+      return;
+    }
+#endif
+  }
+
+  static inline thread_local Executor *current_{nullptr};
+  static inline thread_local size_t current_index_{0};
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> count_{0};
+  std::atomic<size_t> next_{0};
+  std::atomic<size_t> queued_{0};
+  std::mutex grow_mutex_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  bool pinned_{false};
+};
+
+/**
+   A group of tasks run by an Executor, waited for together.
+
+   @code
+     mio::TaskGroup group;
+     for (auto &zone: zones) group.run([&zone] { zone.assign(); });
+     group.wait();
+   @endcode
+ */
+class TaskGroup
+{
+public:
+  explicit TaskGroup(Executor &a_executor = Executor::shared()) noexcept : executor_{a_executor}
+  {
+  }
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /**
+     Waits for the tasks, ignoring their exceptions.
+   */
+  ~TaskGroup()
+  {
+    wait_impl();
+  }
+
+  /**
+     Submits a task, run later on a worker, or on a thread waiting for the tasks.
+   */
+  template<typename F>
+  void run(F &&a_task)
+  {
+    if (executor_.size() == 0) executor_.reserve(1);
+    {
+      std::scoped_lock lock{mutex_};
+      pending_++;
+    }
+
+    executor_.push([this, task = std::forward<F>(a_task)]() mutable {
+      try {
+        task();
+      } catch (...) {
+        std::scoped_lock lock{mutex_};
+        if (!error_) error_ = std::current_exception();
+      }
+
+      std::scoped_lock lock{mutex_};
+      if (--pending_ == 0) done_.notify_all();
+    });
+  }
+
+  /**
+     Waits for all the tasks submitted, running pending tasks in the meantime, and rethrows the
+     first exception thrown by a task, if any.
+   */
+  void wait()
+  {
+    wait_impl();
+
+    std::scoped_lock lock{mutex_};
+    if (auto error = std::exchange(error_, nullptr)) std::rethrow_exception(error);
+  }
+
+private:
+  void wait_impl()
+  {
+    for (;;) {
+      {
+        std::scoped_lock lock{mutex_};
+        if (pending_ == 0) return;
+      }
+      if (executor_.run_pending()) continue;
+
+      // The tasks left are running; checks again for tasks they submit every now and then.
+      std::unique_lock lock{mutex_};
+      done_.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending_ == 0; });
+    }
+  }
+
+  Executor &executor_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+  size_t pending_{0};
+  std::exception_ptr error_;
+};
+
+template<typename F>
+void Executor::run_workers(const size_t a_count, const F &a_task)
+{
+  if (a_count == 0) return;
+  reserve(a_count - 1);
+
+  TaskGroup group{*this};
+  for (size_t i = 1; i < a_count; i++) group.run([&a_task, i] { a_task(i); });
+
+  // The first task runs on the calling thread, and the exception it throws is rethrown last.
+  auto error = std::exception_ptr{};
+  try {
+    a_task(size_t{0});
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  group.wait();
+  if (error) std::rethrow_exception(error);
+}
+
+template<typename F>
+void Executor::parallel_for(const size_t a_first, const size_t a_last, const F &a_body, const size_t a_grain)
+{
+  if (a_first >= a_last) return;
+
+  const auto count = a_last - a_first;
+  const auto grain = a_grain != 0 ? a_grain : std::max(count / (4 * std::max(size(), size_t{1})), size_t{1});
+  if (count <= grain) return a_body(a_first, a_last);
+
+  TaskGroup group{*this};
+  for (auto b = a_first; b < a_last; b += grain) {
+    const auto e = std::min(b + grain, a_last);
+    group.run([&a_body, b, e] { a_body(b, e); });
+  }
+  group.wait();
+}
+
+}
+#endif
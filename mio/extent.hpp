@@ -0,0 +1,68 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_EXTENT_HPP
+#define WXLIB_MIO_EXTENT_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+namespace mio {
+
+/**
+   The place of an array in a binary cache file, e.g. a column of a CsvCache: its offset from
+   the start of the file, and its size in bytes.
+ */
+struct Extent
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+   The extents of the arrays of a cache file, written as is right after its header.
+ */
+template<size_t N>
+using ExtentTable = std::array<Extent, N>;
+
+static_assert(std::is_trivially_copyable_v<ExtentTable<1>> && sizeof(Extent) == 2 * sizeof(uint64_t));
+
+/**
+   Places an array of a_size bytes at the first multiple of a_alignment from a_position on, then
+   moves a_position past it.
+ */
+[[nodiscard]] inline Extent place_extent(uint64_t &a_position, const uint64_t a_size, const uint64_t a_alignment) noexcept
+{
+  a_position = (a_position + a_alignment - 1) / a_alignment * a_alignment;
+  const auto extent = Extent{a_position, a_size};
+  a_position += a_size;
+  return extent;
+}
+
+/**
+   Reads the header of a cache file and the table of extents following it, e.g. from its
+   mapping, checking that every extent is aligned and lies within the file. The header itself is
+   left to the caller to check.
+
+   \returns False if the data is too short to hold them, or an extent is not valid.
+ */
+template<typename HeaderT, size_t N>
+requires std::is_trivially_copyable_v<HeaderT>
+bool read_extent_table(const std::span<const char> a_data, HeaderT &a_header, ExtentTable<N> &a_extents, const uint64_t a_alignment) noexcept
+{
+  if (a_data.size() < sizeof(a_header) + sizeof(a_extents)) return false;
+  std::memcpy(&a_header, a_data.data(), sizeof(a_header));
+  std::memcpy(a_extents.data(), a_data.data() + sizeof(a_header), sizeof(a_extents));
+
+  for (const auto &[offset, size] : a_extents)
+    if (offset % a_alignment != 0 || offset > a_data.size() || size > a_data.size() - offset) return false;
+  return true;
+}
+
+}
+#endif
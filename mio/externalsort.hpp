@@ -0,0 +1,352 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_EXTERNAL_SORT_HPP
+#define WXLIB_MIO_EXTERNAL_SORT_HPP
+
+#include <mio/mio.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace mio {
+
+/*!
+ * A sort key of N 64 bit words, compared lexicographically, e.g. {vehicle_id, timestamp}.
+ */
+template<size_t N>
+using SortKey = std::array<uint64_t, N>;
+
+/*!
+ * A line to sort: its key, and the offset of the line in the file.
+ */
+template<size_t N>
+struct SortRecord
+{
+    SortKey<N> key;
+    uint64_t offset;
+};
+
+/*!
+ * Options of external_sort.
+ */
+struct ExternalSortOptions
+{
+    size_t memory_budget{size_t{1} << 30}; // Bytes for the records of a run, and their sort scratch.
+    size_t num_threads{0};                 // 0 for mio::available_concurrency().
+    std::string temp_directory{};          // Where the runs are spilled, empty for the directory of the output.
+    bool header{false};                    // Whether the first line is a header, kept first.
+};
+
+namespace detail {
+
+template<typename T>
+struct sort_key_traits;
+
+template<std::unsigned_integral T>
+struct sort_key_traits<T>
+{
+    static constexpr size_t size = 1;
+
+    static SortKey<1> make(const T a_key) noexcept
+    {
+        return {uint64_t{a_key}};
+    }
+};
+
+template<size_t N>
+struct sort_key_traits<SortKey<N>>
+{
+    static constexpr size_t size = N;
+
+    static SortKey<N> make(const SortKey<N> &a_key) noexcept
+    {
+        return a_key;
+    }
+};
+
+template<typename KeyExtractorT>
+using sort_key_traits_of = sort_key_traits<std::remove_cvref_t<std::invoke_result_t<const KeyExtractorT &, std::string_view>>>;
+
+}
+
+/*!
+ * Sorts the records by key with a parallel LSD radix sort, one byte per pass, the least
+ * significant first. The records of equal keys keep their order. Each pass counts the digits of
+ * each of the a_num_threads slices of the records in parallel, and scatters them in parallel to
+ * the offsets the counts give; the passes over a byte all keys share are skipped.
+ * @param a_records The records to sort, sorted on return.
+ * @param a_scratch Resized to the records, as the target of every other pass.
+ * @param a_num_threads Number of threads, 0 treated as 1.
+ */
+template<size_t N>
+void parallel_radix_sort(std::vector<SortRecord<N>> &a_records, std::vector<SortRecord<N>> &a_scratch, size_t a_num_threads)
+{
+    using Histogram = std::array<size_t, 256>;
+    constexpr size_t min_slice = size_t{1} << 14;
+
+    const auto size = a_records.size();
+    const auto threads = std::clamp(size / min_slice, size_t{1}, std::max(a_num_threads, size_t{1}));
+    const auto slice = (size + threads - 1) / threads;
+    a_scratch.resize(size);
+
+    auto digit = [](const SortRecord<N> &a_record, const size_t a_pass) {
+        return static_cast<uint8_t>(a_record.key[N - 1 - a_pass / 8] >> (a_pass % 8 * 8));
+    };
+
+    auto in_parallel = [threads](const auto &a_task) { Executor::shared().run_workers(threads, a_task); };
+
+    auto *from = &a_records;
+    auto *to = &a_scratch;
+    auto counts = std::vector<Histogram>(threads);
+
+    for (size_t pass = 0; pass < N * 8; pass++) {
+        in_parallel([&](const size_t t) {
+            counts[t].fill(0);
+            const auto end = std::min(size, (t + 1) * slice);
+            for (auto i = t * slice; i < end; i++) counts[t][digit((*from)[i], pass)]++;
+        });
+
+        // Skips the pass if every record has the same digit.
+        auto total = Histogram{};
+        for (const auto &c: counts)
+            for (size_t d = 0; d < 256; d++) total[d] += c[d];
+        if (std::ranges::find(total, size) != total.end()) continue;
+
+        // The records of digit d from slice t go after those of smaller digits, and of d from the slices before t.
+        for (size_t d = 0, offset = 0; d < 256; d++) {
+            for (auto &c: counts) {
+                const auto n = c[d];
+                c[d] = offset;
+                offset += n;
+            }
+        }
+
+        in_parallel([&](const size_t t) {
+            auto &offsets = counts[t];
+            const auto end = std::min(size, (t + 1) * slice);
+            for (auto i = t * slice; i < end; i++) (*to)[offsets[digit((*from)[i], pass)]++] = (*from)[i];
+        });
+
+        std::swap(from, to);
+    }
+
+    if (from != &a_records) a_records.swap(a_scratch);
+}
+
+/*!
+ * Sorts the lines of a file by key, e.g. an event csv by (vehicle_id, timestamp), into another
+ * file, in one pass over the input to form the runs, and one to merge them.
+ *
+ * The input is mapped, and cut into windows, each of which holds about as many lines as the
+ * memory budget allows records for, estimated by the size of the first lines. The keys of the
+ * lines of a window are extracted in parallel on partitions by a StringReaderAsync, as fixed size
+ * records of a key and the offset of the line, which are sorted by parallel_radix_sort, and
+ * spilled to a run file. The runs are then merged k-way into the output, mapped and sized to the
+ * input upfront, copying each line as its record comes out. If the input fits in one run, the
+ * lines are copied right after the sort, with no run file. The sort is stable.
+ *
+ * Lines are terminated by `\n` in the output, including the last.
+ *
+ * @code
+ *   auto key_of = [](std::string_view a_line) {
+ *     mio::SortKey<2> key{};
+ *     auto comma = a_line.find(',');
+ *     std::from_chars(a_line.data(), a_line.data() + comma, key[0]);
+ *     std::from_chars(a_line.data() + comma + 1, a_line.data() + a_line.size(), key[1]);
+ *     return key;
+ *   };
+ *
+ *   std::error_code error;
+ *   mio::external_sort("events.csv", "events-sorted.csv", key_of, error, {.header = true});
+ * @endcode
+ *
+ * @param a_input The file to sort.
+ * @param a_output The sorted file, created or truncated.
+ * @param a_key_of Returns the key of a line, excluding the terminating `\n`, as an unsigned
+ * integer, or a SortKey. Called concurrently by the worker threads.
+ * @param error Set to describe the error if the input cannot be read, or the runs or the output
+ * cannot be written.
+ * @param a_options The memory budget, threads, and where the runs are spilled.
+ * @return Number of lines sorted, excluding the header; 0 on error.
+ */
+template<typename KeyExtractorT>
+requires std::is_invocable_v<const KeyExtractorT &, std::string_view>
+size_t external_sort(const std::string &a_input,
+                     const std::string &a_output,
+                     const KeyExtractorT &a_key_of,
+                     std::error_code &error,
+                     const ExternalSortOptions &a_options = {})
+{
+    using Traits = detail::sort_key_traits_of<KeyExtractorT>;
+    using Record = SortRecord<Traits::size>;
+    static_assert(std::is_trivially_copyable_v<Record>);
+
+    error.clear();
+    const auto source = make_mmap_source(a_input, error);
+    if (error) return 0;
+
+    const std::string_view content{source.data(), source.size()};
+    const char *begin = content.data();
+    const char *end = begin + content.size();
+    const auto threads = a_options.num_threads == 0 ? available_concurrency() : a_options.num_threads;
+
+    // The header, if any, is taken out of the sort.
+    const char *body = begin;
+    if (a_options.header && !content.empty()) {
+        body = fast_find<'\n'>(begin, end);
+        body = body == end ? end : std::next(body);
+    }
+
+    // Sizes the windows by the average size of the first lines, to about the records of a run.
+    const auto capacity = std::max(a_options.memory_budget / (2 * sizeof(Record)), size_t{1024});
+    const auto sample = std::string_view{body, std::min(static_cast<size_t>(end - body), size_t{1} << 20)};
+    const auto sample_lines = std::max<size_t>(std::ranges::count(sample, '\n'), 1);
+    const auto window_size = std::max(capacity * sample.size() / sample_lines, size_t{1});
+
+    const auto temp_directory = a_options.temp_directory.empty()
+        ? std::filesystem::absolute(a_output).parent_path()
+        : std::filesystem::path{a_options.temp_directory};
+    const auto temp_stem = std::filesystem::path{a_output}.filename().string();
+
+    auto runs = std::vector<std::filesystem::path>{};
+    auto remove_runs = [&runs] {
+        std::error_code ignored;
+        for (const auto &run: runs) std::filesystem::remove(run, ignored);
+    };
+
+    auto records = std::vector<Record>{};
+    auto scratch = std::vector<Record>{};
+    auto line_count = size_t{0};
+
+    for (const char *window = body; window != end;) {
+        const char *window_end = static_cast<size_t>(end - window) <= window_size ? end : fast_find<'\n'>(window + window_size - 1, end);
+        window_end = window_end == end ? end : std::next(window_end);
+
+        auto extracted = std::vector<std::vector<Record>>(threads);
+        StringReaderAsync reader{std::span<const char>{window, window_end}};
+        reader.async_getline([&](const int a_id, const std::string_view a_line) {
+            extracted[a_id].push_back({Traits::make(a_key_of(a_line)), static_cast<uint64_t>(a_line.data() - begin)});
+            return 0;
+        }, threads);
+
+        records.clear();
+        for (auto &part: extracted) {
+            records.insert(records.end(), part.begin(), part.end());
+            std::vector<Record>{}.swap(part);
+        }
+
+        // The async reads only fire for the lines terminated by `\n`.
+        if (window_end == end && end[-1] != '\n') {
+            const char *last = find_end<'\n'>(window, static_cast<size_t>(end - window));
+            records.push_back({Traits::make(a_key_of(std::string_view{last, end})), static_cast<uint64_t>(last - begin)});
+        }
+
+        parallel_radix_sort(records, scratch, threads);
+        line_count += records.size();
+        window = window_end;
+
+        if (window == end && runs.empty()) break;
+
+        // Spills the run.
+        runs.push_back(temp_directory / (temp_stem + ".run" + std::to_string(runs.size())));
+        std::ofstream run(runs.back(), std::ios::binary | std::ios::trunc);
+        run.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        if (!run) {
+            error = std::make_error_code(std::errc::io_error);
+            remove_runs();
+            return 0;
+        }
+    }
+
+    // Maps the output, with room for a `\n` after an unterminated last line.
+    {
+        std::ofstream create(a_output, std::ios::binary | std::ios::trunc);
+        if (!create) error = std::make_error_code(std::errc::io_error);
+    }
+    const auto output_size = content.size() + (!content.empty() && content.back() != '\n');
+    if (!error && output_size > 0) std::filesystem::resize_file(a_output, output_size, error);
+    if (error || output_size == 0) {
+        remove_runs();
+        return error ? 0 : line_count;
+    }
+
+    auto sink = make_mmap_sink(a_output, error);
+    if (error) {
+        remove_runs();
+        return 0;
+    }
+
+    char *out = sink.data();
+    auto copy_line = [&](const uint64_t a_offset) {
+        const char *b = begin + a_offset;
+        const char *e = fast_find<'\n'>(b, end);
+        out = std::copy(b, e, out);
+        *out++ = '\n';
+    };
+
+    if (body != begin) copy_line(0);
+
+    if (runs.empty()) {
+        for (const auto &record: records) copy_line(record.offset);
+    } else {
+        std::vector<Record>{}.swap(records);
+        std::vector<Record>{}.swap(scratch);
+
+        auto sources = std::vector<mmap_source>{};
+        for (const auto &run: runs) {
+            sources.push_back(make_mmap_source(run.string(), error));
+            if (error) {
+                sink.unmap();
+                remove_runs();
+                return 0;
+            }
+        }
+
+        // The heads of the runs, the ties taken from the earlier run to keep the sort stable.
+        using Head = std::pair<SortKey<Traits::size>, std::pair<size_t, size_t>>;
+        auto heads = std::priority_queue<Head, std::vector<Head>, std::greater<>>{};
+        auto record_of = [&sources](const size_t a_run, const size_t a_index) {
+            Record record;
+            std::memcpy(&record, sources[a_run].data() + a_index * sizeof(Record), sizeof(Record));
+            return record;
+        };
+
+        for (size_t r = 0; r < sources.size(); r++)
+            if (sources[r].size() >= sizeof(Record)) heads.push({record_of(r, 0).key, {r, 0}});
+
+        while (!heads.empty()) {
+            const auto [run, index] = heads.top().second;
+            heads.pop();
+            copy_line(record_of(run, index).offset);
+            if ((index + 2) * sizeof(Record) <= sources[run].size()) heads.push({record_of(run, index + 1).key, {run, index + 1}});
+        }
+
+        for (auto &s: sources) s.unmap();
+    }
+
+    sink.sync(error);
+    sink.unmap();
+    remove_runs();
+    return error ? 0 : line_count;
+}
+
+}
+#endif
@@ -3,61 +3,98 @@
   Copyright (C) 2022  Wuping Xin
 */
 
+#ifndef WXLIB_MIO_FAST_FIND_HPP
+#define WXLIB_MIO_FAST_FIND_HPP
+
+#include <algorithm>
+#include <array>
 #include <bit>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WXLIB_MIO_X86 1
 #include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define WXLIB_MIO_ARM64 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#endif
 
-#ifndef WXLIB_MIO_FAST_FIND_HPP
-#define WXLIB_MIO_FAST_FIND_HPP
+// Allows a function to use instructions beyond the compile-time target, for runtime dispatch.
+// MSVC has no such restriction on intrinsics.
+#if defined(WXLIB_MIO_X86) && defined(__GNUC__)
+#define WXLIB_MIO_TARGET(x) __attribute__((target(x)))
+#else
+#define WXLIB_MIO_TARGET(x)
+#endif
 
 namespace mio {
 
 /**
- * Finds the end position of the first char counted backwards in [a_begin, a_begin + a_size).
- * @param a_begin - The first_iter of the memory search range.
- * @param a_size - The size of memory search range.
- * @return The position just passing the first `\n` counted from the back of the span.
- * @remarks The span is defined by [first, first_iter + size).
+ * SIMD instruction sets the searching kernels may use.
  */
-template<unsigned char C>
-static const char *find_end(const char *a_begin, size_t a_size) noexcept
+enum class SimdLevel : uint8_t
 {
-    using iter_diff_t = typename std::iterator_traits<const char *>::difference_type;
-    auto rb = std::reverse_iterator(std::next(a_begin, static_cast<iter_diff_t>(a_size)));
-    auto re = std::reverse_iterator(a_begin);
-
-    return std::find(rb, re, C).base();
-}
+    None, Avx2, Avx512, Neon
+};
 
 /*!
- * Finds the char using AVX2 intrinsics in 32 byte step.
- * Best for searching a region larger than 32 bytes.
- * @tparam C
- * @param a_begin
- * @param a_end
+ * Detects the best SIMD instruction set supported by both the CPU and the OS.
  * @return
  */
-template<unsigned char C>
-static const char *avx2_find(const char *a_begin, const char *a_end)
+inline SimdLevel detect_simd_level() noexcept
 {
-    const char *begin = a_begin;
+#if defined(WXLIB_MIO_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    return SimdLevel::None;
+#elif defined(WXLIB_MIO_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return SimdLevel::None;
 
-    for (auto q = _mm256_set1_epi8(C); begin + 32 < a_end; begin += 32) {
-        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(begin));
-        auto r = _mm256_cmpeq_epi8(x, q);
-        auto z = _mm256_movemask_epi8(r);
+    __cpuid(info, 1);
+    const bool os_xsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!os_xsave || !avx) return SimdLevel::None;
 
-        if (z) {
-#ifdef __GNUC__
-            const char *rr = begin + __builtin_ffs(z) - 1;
+    // XCR0 must enable XMM/YMM state for AVX2, and additionally opmask/ZMM state for AVX-512.
+    const auto xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 30)) && (info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) return SimdLevel::Avx512;
+    if ((info[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06) return SimdLevel::Avx2;
+    return SimdLevel::None;
+#elif defined(WXLIB_MIO_ARM64) && defined(__linux__) && defined(HWCAP_ASIMD)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) ? SimdLevel::Neon : SimdLevel::None;
+#elif defined(WXLIB_MIO_ARM64)
+    return SimdLevel::Neon; // Advanced SIMD is mandatory on AArch64.
 #else
-            unsigned long b;
-            auto rr = _BitScanForward(&b, z) ? (begin + b) : begin;
+    return SimdLevel::None;
 #endif
-            return rr < a_end ? rr : a_end;
-        }
-    }
+}
 
-    return oct_find<C>(begin, a_end);
+/*!
+ * Returns the SIMD instruction set used by fast_find, fast_find_any, find_end and
+ * fast_find_each. Detected once on first call, then cached.
+ * @return
+ */
+inline SimdLevel simd_level() noexcept
+{
+    static const SimdLevel level = detect_simd_level();
+    return level;
 }
 
 /*!
@@ -94,11 +131,457 @@ static const char *oct_find(const char *a_begin, const char *a_end)
     return std::find(b, a_end, C);
 }
 
+#ifdef WXLIB_MIO_X86
+
+/*!
+ * Finds the char using AVX2 intrinsics in 32 byte step.
+ * Best for searching a region larger than 32 bytes.
+ * @tparam C
+ * @param a_begin
+ * @param a_end
+ * @return
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx2") static const char *avx2_find(const char *a_begin, const char *a_end)
+{
+    const char *begin = a_begin;
+
+    for (auto q = _mm256_set1_epi8(static_cast<char>(C)); begin + 32 < a_end; begin += 32) {
+        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(begin));
+        auto r = _mm256_cmpeq_epi8(x, q);
+        auto z = static_cast<uint32_t>(_mm256_movemask_epi8(r));
+
+        if (z) {
+            const char *rr = begin + std::countr_zero(z);
+            return rr < a_end ? rr : a_end;
+        }
+    }
+
+    return oct_find<C>(begin, a_end);
+}
+
+/*!
+ * Finds the char using AVX-512BW intrinsics in 64 byte step.
+ * Best for searching a region larger than 64 bytes.
+ * @tparam C
+ * @param a_begin
+ * @param a_end
+ * @return
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx512f,avx512bw") static const char *avx512_find(const char *a_begin, const char *a_end)
+{
+    const char *begin = a_begin;
+
+    for (auto q = _mm512_set1_epi8(static_cast<char>(C)); a_end - begin >= 64; begin += 64) {
+        auto z = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(begin), q);
+        if (z) return begin + std::countr_zero(z);
+    }
+
+    return oct_find<C>(begin, a_end);
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/*!
+ * Narrows a 16 byte comparison result to a 64 bit mask, 4 bits per byte.
+ */
+inline uint64_t neon_mask(uint8x16_t a_cmp) noexcept
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(a_cmp), 4)), 0);
+}
+
+/*!
+ * Finds the char using NEON intrinsics in 16 byte step.
+ * @tparam C
+ * @param a_begin
+ * @param a_end
+ * @return
+ */
+template<unsigned char C>
+static const char *neon_find(const char *a_begin, const char *a_end)
+{
+    const char *begin = a_begin;
+
+    for (auto q = vdupq_n_u8(C); a_end - begin >= 16; begin += 16) {
+        auto z = neon_mask(vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(begin)), q));
+        if (z) return begin + (std::countr_zero(z) >> 2);
+    }
+
+    return oct_find<C>(begin, a_end);
+}
+
+#endif
+
+/**
+ * Finds the end position of the first char counted backwards in [a_begin, a_begin + a_size).
+ * @param a_begin - The first_iter of the memory search range.
+ * @param a_size - The size of memory search range.
+ * @return The position just passing the first `\n` counted from the back of the span, or
+ * a_begin if there is none.
+ * @remarks The span is defined by [first, first_iter + size).
+ */
+template<unsigned char C>
+static const char *scalar_find_end(const char *a_begin, size_t a_size) noexcept
+{
+    using iter_diff_t = typename std::iterator_traits<const char *>::difference_type;
+    auto rb = std::reverse_iterator(std::next(a_begin, static_cast<iter_diff_t>(a_size)));
+    auto re = std::reverse_iterator(a_begin);
+
+    return std::find(rb, re, C).base();
+}
+
+#ifdef WXLIB_MIO_X86
+
+/*!
+ * Same as scalar_find_end, using AVX2 intrinsics in 32 byte step.
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx2") static const char *avx2_find_end(const char *a_begin, size_t a_size) noexcept
+{
+    const char *end = std::next(a_begin, static_cast<std::ptrdiff_t>(a_size));
+
+    for (auto q = _mm256_set1_epi8(static_cast<char>(C)); end - a_begin >= 32; end -= 32) {
+        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(end - 32));
+        auto z = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, q)));
+        if (z) return end - std::countl_zero(z);
+    }
+
+    return scalar_find_end<C>(a_begin, static_cast<size_t>(end - a_begin));
+}
+
+/*!
+ * Same as scalar_find_end, using AVX-512BW intrinsics in 64 byte step.
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx512f,avx512bw") static const char *avx512_find_end(const char *a_begin, size_t a_size) noexcept
+{
+    const char *end = std::next(a_begin, static_cast<std::ptrdiff_t>(a_size));
+
+    for (auto q = _mm512_set1_epi8(static_cast<char>(C)); end - a_begin >= 64; end -= 64) {
+        auto z = static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(end - 64), q));
+        if (z) return end - std::countl_zero(z);
+    }
+
+    return scalar_find_end<C>(a_begin, static_cast<size_t>(end - a_begin));
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/*!
+ * Same as scalar_find_end, using NEON intrinsics in 16 byte step.
+ */
+template<unsigned char C>
+static const char *neon_find_end(const char *a_begin, size_t a_size) noexcept
+{
+    const char *end = std::next(a_begin, static_cast<std::ptrdiff_t>(a_size));
+
+    for (auto q = vdupq_n_u8(C); end - a_begin >= 16; end -= 16) {
+        auto z = neon_mask(vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(end - 16)), q));
+        if (z) return end - (std::countl_zero(z) >> 2);
+    }
+
+    return scalar_find_end<C>(a_begin, static_cast<size_t>(end - a_begin));
+}
+
+#endif
+
+/**
+ * Calls the handler with the position of every occurrence of the char in [a_begin, a_end),
+ * in ascending order, scanning 8 bytes at a time.
+ * @param a_on_found Handler invoked as a_on_found(const char *pos).
+ */
+template<unsigned char C, typename F>
+static void oct_find_each(const char *a_begin, const char *a_end, F &&a_on_found) noexcept
+{
+    constexpr uint64_t k = C;
+    constexpr uint64_t p = k | (k << 0x08) | (k << 0x10) | (k << 0x18) | (k << 0x20) | (k << 0x28) | (k << 0x30) | (k << 0x38);
+    const char *b = a_begin;
+
+    for (; a_end - b >= 8; b += 8) {
+        uint64_t input;
+        std::memcpy(&input, b, sizeof(input));
+        input ^= p;
+        auto z = ~(((input & 0x7F7F7F7F7F7F7F7FL) + 0x7F7F7F7F7F7F7F7FL) | input | 0x7F7F7F7F7F7F7F7FL);
+        for (; z; z &= z - 1) a_on_found(b + (std::countr_zero(z) >> 3));
+    }
+
+    for (; b != a_end; ++b)
+        if (static_cast<unsigned char>(*b) == C) a_on_found(b);
+}
+
+#ifdef WXLIB_MIO_X86
+
+/**
+ * Same as oct_find_each, visiting the set bits of a 32 byte AVX2 movemask.
+ */
+template<unsigned char C, typename F>
+WXLIB_MIO_TARGET("avx2") static void avx2_find_each(const char *a_begin, const char *a_end, F &&a_on_found) noexcept
+{
+    const char *b = a_begin;
+
+    for (auto q = _mm256_set1_epi8(static_cast<char>(C)); a_end - b >= 32; b += 32) {
+        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(b));
+        auto z = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, q)));
+        for (; z; z &= z - 1) a_on_found(b + std::countr_zero(z));
+    }
+
+    oct_find_each<C>(b, a_end, a_on_found);
+}
+
+/**
+ * Same as oct_find_each, visiting the set bits of a 64 byte AVX-512BW comparison mask.
+ */
+template<unsigned char C, typename F>
+WXLIB_MIO_TARGET("avx512f,avx512bw") static void avx512_find_each(const char *a_begin, const char *a_end, F &&a_on_found) noexcept
+{
+    const char *b = a_begin;
+
+    for (auto q = _mm512_set1_epi8(static_cast<char>(C)); a_end - b >= 64; b += 64) {
+        auto z = static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(b), q));
+        for (; z; z &= z - 1) a_on_found(b + std::countr_zero(z));
+    }
+
+    oct_find_each<C>(b, a_end, a_on_found);
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/**
+ * Same as oct_find_each, visiting the set bits of a 16 byte NEON comparison mask.
+ */
+template<unsigned char C, typename F>
+static void neon_find_each(const char *a_begin, const char *a_end, F &&a_on_found) noexcept
+{
+    const char *b = a_begin;
+
+    for (auto q = vdupq_n_u8(C); a_end - b >= 16; b += 16) {
+        auto z = neon_mask(vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(b)), q)) & 0x8888888888888888ULL;
+        for (; z; z &= z - 1) a_on_found(b + (std::countr_zero(z) >> 2));
+    }
+
+    oct_find_each<C>(b, a_end, a_on_found);
+}
+
+#endif
+
+/**
+ * Counts the occurrences of the char in [a_begin, a_end), 8 bytes at a time.
+ */
+template<unsigned char C>
+static size_t oct_count(const char *a_begin, const char *a_end) noexcept
+{
+    constexpr uint64_t k = C;
+    constexpr uint64_t p = k | (k << 0x08) | (k << 0x10) | (k << 0x18) | (k << 0x20) | (k << 0x28) | (k << 0x30) | (k << 0x38);
+    const char *b = a_begin;
+    size_t n = 0;
+
+    for (; a_end - b >= 8; b += 8) {
+        uint64_t input;
+        std::memcpy(&input, b, sizeof(input));
+        input ^= p;
+        n += std::popcount(~(((input & 0x7F7F7F7F7F7F7F7FL) + 0x7F7F7F7F7F7F7F7FL) | input | 0x7F7F7F7F7F7F7F7FL));
+    }
+
+    for (; b != a_end; ++b)
+        n += static_cast<unsigned char>(*b) == C;
+    return n;
+}
+
+#ifdef WXLIB_MIO_X86
+
+/**
+ * Same as oct_count, adding up the popcounts of 32 byte AVX2 movemasks.
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx2") static size_t avx2_count(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+    size_t n = 0;
+
+    for (auto q = _mm256_set1_epi8(static_cast<char>(C)); a_end - b >= 32; b += 32) {
+        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(b));
+        n += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, q))));
+    }
+
+    return n + oct_count<C>(b, a_end);
+}
+
+/**
+ * Same as oct_count, adding up the popcounts of 64 byte AVX-512BW comparison masks.
+ */
+template<unsigned char C>
+WXLIB_MIO_TARGET("avx512f,avx512bw") static size_t avx512_count(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+    size_t n = 0;
+
+    for (auto q = _mm512_set1_epi8(static_cast<char>(C)); a_end - b >= 64; b += 64)
+        n += std::popcount(static_cast<uint64_t>(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(b), q)));
+
+    return n + oct_count<C>(b, a_end);
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/**
+ * Same as oct_count, adding up the popcounts of 16 byte NEON comparison masks.
+ */
+template<unsigned char C>
+static size_t neon_count(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+    size_t n = 0;
+
+    for (auto q = vdupq_n_u8(C); a_end - b >= 16; b += 16)
+        n += std::popcount(neon_mask(vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(b)), q)) & 0x8888888888888888ULL);
+
+    return n + oct_count<C>(b, a_end);
+}
+
+#endif
+
+/*!
+ * Result of searching for any char of a set: the position of the first match, and the char
+ * matched there. If there is no match, `pos` is the end of the search range and `match` is 0.
+ */
+struct FindAnyResult
+{
+    const char *pos;
+    char match;
+};
+
+/*!
+ * Finds the first occurrence of any of the chars in 8 bytes step.
+ * @tparam Cs The chars to search for.
+ * @param a_begin
+ * @param a_end
+ * @return
+ */
+template<unsigned char... Cs>
+static FindAnyResult oct_find_any(const char *a_begin, const char *a_end) noexcept
+{
+    constexpr uint64_t ones = 0x0101010101010101ULL;
+    const char *b = a_begin;
+
+    for (; a_end - b >= 8; b += 8) {
+        uint64_t input;
+        std::memcpy(&input, b, sizeof(input));
+
+        // The high bit of each byte equal to any of the chars is set, with no false positives.
+        auto z = uint64_t{0};
+        ((z |= ~((((input ^ (Cs * ones)) & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | (input ^ (Cs * ones)) | 0x7F7F7F7F7F7F7F7FULL)), ...);
+        if (z) {
+            const char *pos = b + (std::countr_zero(z) >> 3);
+            return {pos, *pos};
+        }
+    }
+
+    for (; b != a_end; ++b)
+        if (((static_cast<unsigned char>(*b) == Cs) || ...)) return {b, *b};
+
+    return {a_end, 0};
+}
+
+#ifdef WXLIB_MIO_X86
+
+/*!
+ * Same as oct_find_any, using AVX2 intrinsics in 32 byte step.
+ */
+template<unsigned char... Cs>
+WXLIB_MIO_TARGET("avx2") static FindAnyResult avx2_find_any(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+
+    for (; a_end - b >= 32; b += 32) {
+        auto x = _mm256_lddqu_si256(reinterpret_cast<const __m256i *>(b));
+        auto r = _mm256_setzero_si256();
+        ((r = _mm256_or_si256(r, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(static_cast<char>(Cs))))), ...);
+
+        if (auto z = static_cast<uint32_t>(_mm256_movemask_epi8(r))) {
+            const char *pos = b + std::countr_zero(z);
+            return {pos, *pos};
+        }
+    }
+
+    return oct_find_any<Cs...>(b, a_end);
+}
+
+/*!
+ * Same as oct_find_any, using AVX-512BW intrinsics in 64 byte step.
+ */
+template<unsigned char... Cs>
+WXLIB_MIO_TARGET("avx512f,avx512bw") static FindAnyResult avx512_find_any(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+
+    for (; a_end - b >= 64; b += 64) {
+        auto x = _mm512_loadu_si512(b);
+        auto z = uint64_t{0};
+        ((z |= _mm512_cmpeq_epi8_mask(x, _mm512_set1_epi8(static_cast<char>(Cs)))), ...);
+
+        if (z) {
+            const char *pos = b + std::countr_zero(z);
+            return {pos, *pos};
+        }
+    }
+
+    return oct_find_any<Cs...>(b, a_end);
+}
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+/*!
+ * Same as oct_find_any, using NEON intrinsics in 16 byte step.
+ */
+template<unsigned char... Cs>
+static FindAnyResult neon_find_any(const char *a_begin, const char *a_end) noexcept
+{
+    const char *b = a_begin;
+
+    for (; a_end - b >= 16; b += 16) {
+        auto x = vld1q_u8(reinterpret_cast<const uint8_t *>(b));
+        auto r = vdupq_n_u8(0);
+        ((r = vorrq_u8(r, vceqq_u8(x, vdupq_n_u8(Cs)))), ...);
+
+        if (auto z = neon_mask(r)) {
+            const char *pos = b + (std::countr_zero(z) >> 2);
+            return {pos, *pos};
+        }
+    }
+
+    return oct_find_any<Cs...>(b, a_end);
+}
+
+#endif
+
+// The searching functions below dispatch to the best kernel, chosen at compile time when
+// the target guarantees AVX-512BW or NEON, otherwise at runtime by simd_level(), so that
+// one binary runs at full speed on different CPUs.
+
 template<unsigned char C>
 static const char *fast_find(const char *a_begin, const char *a_end) noexcept
 {
-#ifdef __AVX2__
-    return avx2_find<C>(a_begin, a_end);
+#if defined(__AVX512BW__)
+    return avx512_find<C>(a_begin, a_end);
+#elif defined(WXLIB_MIO_X86)
+    switch (simd_level()) {
+        case SimdLevel::Avx512: return avx512_find<C>(a_begin, a_end);
+        case SimdLevel::Avx2: return avx2_find<C>(a_begin, a_end);
+        default: return oct_find<C>(a_begin, a_end);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    return neon_find<C>(a_begin, a_end);
 #elif __GNUC__
     return oct_find<C>(a_begin, a_end);
 #else
@@ -106,6 +589,503 @@ static const char *fast_find(const char *a_begin, const char *a_end) noexcept
 #endif
 }
 
+/**
+ * Finds the end position of the first char counted backwards in [a_begin, a_begin + a_size).
+ * @param a_begin - The first_iter of the memory search range.
+ * @param a_size - The size of memory search range.
+ * @return The position just passing the first `\n` counted from the back of the span, or
+ * a_begin if there is none.
+ * @remarks The span is defined by [first, first_iter + size).
+ */
+template<unsigned char C>
+static const char *find_end(const char *a_begin, size_t a_size) noexcept
+{
+#if defined(__AVX512BW__)
+    return avx512_find_end<C>(a_begin, a_size);
+#elif defined(WXLIB_MIO_X86)
+    switch (simd_level()) {
+        case SimdLevel::Avx512: return avx512_find_end<C>(a_begin, a_size);
+        case SimdLevel::Avx2: return avx2_find_end<C>(a_begin, a_size);
+        default: return scalar_find_end<C>(a_begin, a_size);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    return neon_find_end<C>(a_begin, a_size);
+#else
+    return scalar_find_end<C>(a_begin, a_size);
+#endif
+}
+
+/*!
+ * Finds the first occurrence of any of the chars in [a_begin, a_end), in a single pass.
+ * Meant for small sets, such as the structural chars of a csv line.
+ * @tparam Cs The chars to search for.
+ * @param a_begin
+ * @param a_end
+ * @return The position of the first match and the char matched, or {a_end, 0} if none.
+ * @code
+ *   auto [pos, c] = mio::fast_find_any<',', '"'>(b, e);
+ * @endcode
+ */
+template<unsigned char... Cs> requires (sizeof...(Cs) > 0)
+static FindAnyResult fast_find_any(const char *a_begin, const char *a_end) noexcept
+{
+#if defined(__AVX512BW__)
+    return avx512_find_any<Cs...>(a_begin, a_end);
+#elif defined(WXLIB_MIO_X86)
+    switch (simd_level()) {
+        case SimdLevel::Avx512: return avx512_find_any<Cs...>(a_begin, a_end);
+        case SimdLevel::Avx2: return avx2_find_any<Cs...>(a_begin, a_end);
+        default: return oct_find_any<Cs...>(a_begin, a_end);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    return neon_find_any<Cs...>(a_begin, a_end);
+#else
+    return oct_find_any<Cs...>(a_begin, a_end);
+#endif
+}
+
+/*!
+ * Calls the handler with the position of every occurrence of the char in [a_begin, a_end),
+ * in ascending order. Scans 64 bytes (AVX-512BW), 32 bytes (AVX2), 16 bytes (NEON), or
+ * 8 bytes at a time, and visits matches by iterating the set bits of the comparison mask.
+ * @tparam C
+ * @param a_begin
+ * @param a_end
+ * @param a_on_found Handler invoked as a_on_found(const char *pos).
+ */
+template<unsigned char C, typename F>
+static void fast_find_each(const char *a_begin, const char *a_end, F &&a_on_found) noexcept
+{
+#if defined(__AVX512BW__)
+    avx512_find_each<C>(a_begin, a_end, a_on_found);
+#elif defined(WXLIB_MIO_X86)
+    switch (simd_level()) {
+        case SimdLevel::Avx512: return avx512_find_each<C>(a_begin, a_end, a_on_found);
+        case SimdLevel::Avx2: return avx2_find_each<C>(a_begin, a_end, a_on_found);
+        default: return oct_find_each<C>(a_begin, a_end, a_on_found);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    neon_find_each<C>(a_begin, a_end, a_on_found);
+#else
+    oct_find_each<C>(a_begin, a_end, a_on_found);
+#endif
+}
+
+/*!
+ * Counts the occurrences of the char in [a_begin, a_end), adding up the popcounts of the
+ * comparison masks of 64 bytes (AVX-512BW), 32 bytes (AVX2), 16 bytes (NEON), or 8 bytes at a
+ * time, e.g. to number the lines of a block without visiting them.
+ * @tparam C
+ * @param a_begin
+ * @param a_end
+ * @return Number of occurrences.
+ */
+template<unsigned char C>
+static size_t fast_count(const char *a_begin, const char *a_end) noexcept
+{
+#if defined(__AVX512BW__)
+    return avx512_count<C>(a_begin, a_end);
+#elif defined(WXLIB_MIO_X86)
+    switch (simd_level()) {
+        case SimdLevel::Avx512: return avx512_count<C>(a_begin, a_end);
+        case SimdLevel::Avx2: return avx2_count<C>(a_begin, a_end);
+        default: return oct_count<C>(a_begin, a_end);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    return neon_count<C>(a_begin, a_end);
+#else
+    return oct_count<C>(a_begin, a_end);
+#endif
+}
+
+/*!
+ * Result of searching for any of a set of patterns: the position of the first match, and the
+ * index of a pattern matching there. If there is no match, `pos` is the end of the search range
+ * and `pattern` is MultiFind::npos.
+ */
+struct MultiFindResult
+{
+    const char *pos;
+    size_t pattern;
+};
+
+/*!
+ * Searches text for any of a set of literal patterns in a single pass, e.g. to keep the lines
+ * holding any of a list of vehicle ids or event codes, instead of searching for each pattern in
+ * turn.
+ *
+ * Up to teddy_max_patterns patterns are searched with Teddy, a SIMD fingerprint prefilter: the
+ * patterns are sorted into 8 buckets, and the low and high nibbles of their first 3 bytes, or
+ * fewer for shorter patterns, looked up with a byte shuffle in 16-byte tables of bucket bits,
+ * which yields the buckets possibly matching at each of 32 (AVX2) or 16 (NEON) positions at
+ * once; the patterns of the candidate buckets are then verified. Larger sets, or CPUs with no
+ * SIMD, are searched by an Aho-Corasick automaton over the byte classes of the patterns.
+ *
+ * Empty patterns never match. Patterns should not contain `\n` for find_lines().
+ * @code
+ *   const mio::MultiFind ids{"V1024", "V2048", "E_DOOR"};
+ *   reader.async_getblock([&](int, std::string_view a_block) {
+ *       ids.find_lines(a_block.data(), a_block.data() + a_block.size(), [&](std::string_view a_line, size_t) {
+ *           // ... do something about the line.
+ *       });
+ *       return 0;
+ *   }, 8, 1 << 20);
+ * @endcode
+ */
+class MultiFind
+{
+public:
+    enum class Engine : uint8_t
+    {
+        Teddy, AhoCorasick
+    };
+
+    static constexpr size_t npos = ~size_t{0};
+
+    /*!
+     * Largest number of patterns searched with Teddy by default; more patterns fill its
+     * buckets with false positives.
+     */
+    static constexpr size_t teddy_max_patterns = 64;
+
+    /*!
+     * Prepares the search of the patterns, copied, with Teddy if there are at most
+     * teddy_max_patterns of them and the CPU supports AVX2 or NEON, see simd_level(), otherwise
+     * with Aho-Corasick.
+     * @param a_patterns
+     */
+    explicit MultiFind(const std::span<const std::string_view> a_patterns)
+        : MultiFind(a_patterns, !a_patterns.empty() && a_patterns.size() <= teddy_max_patterns && simd_level() != SimdLevel::None
+                                    ? Engine::Teddy : Engine::AhoCorasick)
+    {
+    }
+
+    MultiFind(const std::initializer_list<std::string_view> a_patterns)
+        : MultiFind(std::span<const std::string_view>{a_patterns.begin(), a_patterns.size()})
+    {
+    }
+
+    /*!
+     * Same as above, with the engine given, e.g. to compare them.
+     * @param a_patterns
+     * @param a_engine
+     */
+    MultiFind(const std::span<const std::string_view> a_patterns, const Engine a_engine)
+        : patterns_(a_patterns.begin(), a_patterns.end()), engine_{a_engine}
+    {
+        for (const auto &pattern : patterns_) {
+            if (pattern.empty()) continue;
+            min_size_ = std::min(min_size_, pattern.size());
+            max_size_ = std::max(max_size_, pattern.size());
+        }
+
+        if (engine_ == Engine::Teddy) build_teddy();
+        else build_aho_corasick();
+    }
+
+    [[nodiscard]] Engine engine() const noexcept
+    {
+        return engine_;
+    }
+
+    /*!
+     * Returns the number of patterns, empty ones included.
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return patterns_.size();
+    }
+
+    [[nodiscard]] std::string_view pattern(const size_t i) const noexcept
+    {
+        return patterns_[i];
+    }
+
+    /*!
+     * Finds the first position in [a_begin, a_end) where any of the patterns starts.
+     * @param a_begin
+     * @param a_end
+     * @return The position and a pattern matching there, or {a_end, npos} if none does.
+     */
+    [[nodiscard]] MultiFindResult find(const char *a_begin, const char *a_end) const noexcept
+    {
+        if (max_size_ == 0 || static_cast<size_t>(a_end - a_begin) < min_size_) return {a_end, npos};
+        if (engine_ == Engine::AhoCorasick) return aho_corasick_find(a_begin, a_end);
+
+#if defined(WXLIB_MIO_X86)
+        const auto level = simd_level();
+        if (level == SimdLevel::Avx2 || level == SimdLevel::Avx512) return avx2_teddy_find(a_begin, a_end);
+#elif defined(WXLIB_MIO_ARM64)
+        if (simd_level() == SimdLevel::Neon) return neon_teddy_find(a_begin, a_end);
+#endif
+        return scalar_teddy_find(a_begin, a_end);
+    }
+
+    /*!
+     * Calls the handler with each line of [a_begin, a_end) holding any of the patterns, in
+     * order, e.g. a partition or a chunk of a file, skipping to the next line once a line
+     * matches, so that the text is scanned once whatever the number of patterns.
+     * @param a_begin The start of a line.
+     * @param a_end
+     * @param a_on_line Handler invoked as a_on_line(std::string_view line, size_t pattern), the
+     * line excluding its `\n`, and a pattern matching first in it.
+     * @return Number of lines matching.
+     */
+    template<typename F>
+    size_t find_lines(const char *a_begin, const char *a_end, F &&a_on_line) const
+    {
+        auto count = size_t{0};
+        for (const char *b = a_begin; b < a_end; count++) {
+            const auto [pos, pattern] = find(b, a_end);
+            if (pattern == npos) break;
+
+            const char *line = find_end<'\n'>(b, static_cast<size_t>(pos - b));
+            const char *end = fast_find<'\n'>(pos, a_end);
+            a_on_line(std::string_view{line, static_cast<size_t>(end - line)}, pattern);
+            b = end == a_end ? a_end : end + 1;
+        }
+
+        return count;
+    }
+
+private:
+    [[nodiscard]] bool matches(const size_t a_pattern, const char *a_pos, const char *a_end) const noexcept
+    {
+        const auto &pattern = patterns_[a_pattern];
+        return !pattern.empty() && static_cast<size_t>(a_end - a_pos) >= pattern.size()
+            && std::memcmp(a_pos, pattern.data(), pattern.size()) == 0;
+    }
+
+
+    void build_teddy()
+    {
+        if (max_size_ == 0) return;
+        width_ = std::min<size_t>(min_size_, 3);
+
+        // Patterns of the same prefix share a bucket, so that they are verified together.
+        auto order = std::vector<size_t>{};
+        for (size_t i = 0; i < patterns_.size(); i++)
+            if (!patterns_[i].empty()) order.push_back(i);
+        std::ranges::stable_sort(order, {}, [this](const size_t i) { return std::string_view{patterns_[i]}.substr(0, width_); });
+
+        for (auto &table : lo_) table.fill(0xFF);
+        for (auto &table : hi_) table.fill(0xFF);
+        for (size_t j = 0; j < width_; j++) lo_[j].fill(0), hi_[j].fill(0);
+
+        for (size_t rank = 0; rank < order.size(); rank++) {
+            const auto bucket = rank * buckets_.size() / order.size();
+            const auto &pattern = patterns_[order[rank]];
+            buckets_[bucket].push_back(order[rank]);
+            for (size_t j = 0; j < width_; j++) {
+                const auto c = static_cast<unsigned char>(pattern[j]);
+                lo_[j][c & 0x0F] |= static_cast<uint8_t>(1u << bucket);
+                hi_[j][c >> 4] |= static_cast<uint8_t>(1u << bucket);
+            }
+        }
+        for (auto &bucket : buckets_) std::ranges::sort(bucket);
+    }
+
+    /*!
+     * Verifies the patterns of the candidate buckets at a position.
+     * @return The smallest index of the patterns matching, or npos.
+     */
+    [[nodiscard]] size_t teddy_verify(const char *a_pos, const char *a_end, uint32_t a_buckets) const noexcept
+    {
+        auto found = npos;
+        for (; a_buckets; a_buckets &= a_buckets - 1)
+            for (const auto i : buckets_[std::countr_zero(a_buckets)]) {
+                if (i >= found) break;
+                if (matches(i, a_pos, a_end)) found = i;
+            }
+        return found;
+    }
+
+    [[nodiscard]] MultiFindResult scalar_teddy_find(const char *a_begin, const char *a_end) const noexcept
+    {
+        for (const char *p = a_begin; static_cast<size_t>(a_end - p) >= width_; ++p) {
+            auto buckets = uint32_t{0xFF};
+            for (size_t j = 0; j < width_ && buckets; j++) {
+                const auto c = static_cast<unsigned char>(p[j]);
+                buckets &= lo_[j][c & 0x0F] & hi_[j][c >> 4];
+            }
+
+            if (buckets)
+                if (const auto i = teddy_verify(p, a_end, buckets); i != npos) return {p, i};
+        }
+
+        return {a_end, npos};
+    }
+
+#ifdef WXLIB_MIO_X86
+
+    /*!
+     * Same as scalar_teddy_find, using AVX2 intrinsics in 32 byte step, the tables of the 3
+     * prefix bytes always applied, those past the width of the patterns letting all through.
+     * AVX-512 CPUs use it too, since the 16-byte tables are shuffled per 128-bit lane anyway.
+     */
+    WXLIB_MIO_TARGET("avx2") MultiFindResult avx2_teddy_find(const char *a_begin, const char *a_end) const noexcept
+    {
+        const auto nibble = _mm256_set1_epi8(0x0F);
+        __m256i lo[3], hi[3];
+        for (size_t j = 0; j < 3; j++) {
+            lo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lo_[j].data())));
+            hi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hi_[j].data())));
+        }
+
+        const char *b = a_begin;
+        alignas(32) uint8_t buckets[32];
+        for (; a_end - b >= 32 + 2; b += 32) {
+            auto r = _mm256_set1_epi8(-1);
+            for (size_t j = 0; j < 3; j++) {
+                const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+                const auto l = _mm256_shuffle_epi8(lo[j], _mm256_and_si256(x, nibble));
+                const auto h = _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+                r = _mm256_and_si256(r, _mm256_and_si256(l, h));
+            }
+
+            auto z = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(r, _mm256_setzero_si256())));
+            if (!z) continue;
+
+            _mm256_store_si256(reinterpret_cast<__m256i *>(buckets), r);
+            for (; z; z &= z - 1) {
+                const auto k = std::countr_zero(z);
+                if (const auto i = teddy_verify(b + k, a_end, buckets[k]); i != npos) return {b + k, i};
+            }
+        }
+
+        return scalar_teddy_find(b, a_end);
+    }
+
+#endif
+
+#ifdef WXLIB_MIO_ARM64
+
+    /*!
+     * Same as scalar_teddy_find, using NEON table lookups in 16 byte step.
+     */
+    MultiFindResult neon_teddy_find(const char *a_begin, const char *a_end) const noexcept
+    {
+        const auto nibble = vdupq_n_u8(0x0F);
+        uint8x16_t lo[3], hi[3];
+        for (size_t j = 0; j < 3; j++) lo[j] = vld1q_u8(lo_[j].data()), hi[j] = vld1q_u8(hi_[j].data());
+
+        const char *b = a_begin;
+        uint8_t buckets[16];
+        for (; a_end - b >= 16 + 2; b += 16) {
+            auto r = vdupq_n_u8(0xFF);
+            for (size_t j = 0; j < 3; j++) {
+                const auto x = vld1q_u8(reinterpret_cast<const uint8_t *>(b + j));
+                r = vandq_u8(r, vandq_u8(vqtbl1q_u8(lo[j], vandq_u8(x, nibble)), vqtbl1q_u8(hi[j], vshrq_n_u8(x, 4))));
+            }
+
+            auto z = neon_mask(vtstq_u8(r, r));
+            if (!z) continue;
+
+            vst1q_u8(buckets, r);
+            for (; z; z &= ~(uint64_t{0xF} << (std::countr_zero(z) & ~3))) {
+                const auto k = std::countr_zero(z) >> 2;
+                if (const auto i = teddy_verify(b + k, a_end, buckets[k]); i != npos) return {b + k, i};
+            }
+        }
+
+        return scalar_teddy_find(b, a_end);
+    }
+
+#endif
+
+    void build_aho_corasick()
+    {
+        // The bytes of the patterns get a class each, all the other bytes class 0.
+        classes_.fill(0);
+        auto class_count = size_t{1};
+        for (const auto &pattern : patterns_)
+            for (const auto c : pattern)
+                if (auto &k = classes_[static_cast<unsigned char>(c)]; k == 0) k = static_cast<uint16_t>(class_count++);
+        class_count_ = class_count;
+
+        // The trie, 0 being the root, then the transitions completed breadth first.
+        constexpr auto none = ~uint32_t{0};
+        delta_.assign(class_count_, none);
+        out_size_.assign(1, 0);
+        out_pattern_.assign(1, npos);
+        for (size_t i = 0; i < patterns_.size(); i++) {
+            if (patterns_[i].empty()) continue;
+            auto state = uint32_t{0};
+            for (const auto c : patterns_[i]) {
+                auto &next = delta_[state * class_count_ + classes_[static_cast<unsigned char>(c)]];
+                if (next == none) {
+                    next = static_cast<uint32_t>(out_size_.size());
+                    delta_.resize(delta_.size() + class_count_, none);
+                    out_size_.push_back(0);
+                    out_pattern_.push_back(npos);
+                }
+                state = delta_[state * class_count_ + classes_[static_cast<unsigned char>(c)]];
+            }
+            if (out_pattern_[state] == npos) out_size_[state] = patterns_[i].size(), out_pattern_[state] = i;
+        }
+
+        auto fail = std::vector<uint32_t>(out_size_.size(), 0);
+        auto queue = std::vector<uint32_t>{};
+        for (size_t k = 0; k < class_count_; k++) {
+            auto &next = delta_[k];
+            if (next == none) next = 0;
+            else queue.push_back(next);
+        }
+
+        for (size_t q = 0; q < queue.size(); q++) {
+            const auto state = queue[q];
+            // A state of its own pattern outputs it, the longest; otherwise the longest suffix.
+            if (out_pattern_[state] == npos) out_size_[state] = out_size_[fail[state]], out_pattern_[state] = out_pattern_[fail[state]];
+
+            for (size_t k = 0; k < class_count_; k++) {
+                auto &next = delta_[state * class_count_ + k];
+                const auto fallback = delta_[fail[state] * class_count_ + k];
+                if (next == none) {
+                    next = fallback;
+                } else {
+                    fail[next] = fallback;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    /*!
+     * Runs the automaton, then, once a pattern is found, on until no pattern ending further
+     * may start before it.
+     */
+    [[nodiscard]] MultiFindResult aho_corasick_find(const char *a_begin, const char *a_end) const noexcept
+    {
+        auto best = MultiFindResult{a_end, npos};
+        auto state = uint32_t{0};
+        for (const char *p = a_begin; p != a_end; ++p) {
+            state = delta_[state * class_count_ + classes_[static_cast<unsigned char>(*p)]];
+            if (const auto size = out_size_[state]; size != 0 && p + 1 - size < best.pos) best = {p + 1 - size, out_pattern_[state]};
+            if (best.pattern != npos && static_cast<size_t>(p + 1 - best.pos) >= max_size_) break;
+        }
+
+        return best;
+    }
+
+    std::vector<std::string> patterns_;
+    Engine engine_;
+    size_t min_size_{~size_t{0}};
+    size_t max_size_{0};
+
+    // Teddy.
+    size_t width_{0};
+    std::array<std::array<uint8_t, 16>, 3> lo_{};
+    std::array<std::array<uint8_t, 16>, 3> hi_{};
+    std::array<std::vector<size_t>, 8> buckets_{};
+
+    // Aho-Corasick.
+    std::array<uint16_t, 256> classes_{};
+    size_t class_count_{1};
+    std::vector<uint32_t> delta_;
+    std::vector<size_t> out_size_;
+    std::vector<size_t> out_pattern_;
+};
+
 }
 
-#endif
\ No newline at end of file
+#endif
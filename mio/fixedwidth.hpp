@@ -0,0 +1,472 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_FIXED_WIDTH_HPP
+#define WXLIB_MIO_FIXED_WIDTH_HPP
+
+#include <mio/csvdoc.hpp>
+#include <mio/csvscan.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+#include <mio/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * A column of a fixed width text format, at a compile-time byte offset of the line, e.g.
+ * Column<NAME("station"), 0, 8>, Column<NAME("count"), 8, 6, int32_t>. The padding spaces on
+ * both sides of the text are trimmed, and the trimmed text converted by parse_field, same as a
+ * csv field. A line shorter than the column leaves it trimmed to the part it has, or empty.
+ * @tparam T The column tag, see NAME.
+ * @tparam Offset Offset in bytes of the column from the start of the line.
+ * @tparam Width Width in bytes of the column, padding included.
+ * @tparam V The value type, see CsvField; Skipped columns are not sliced at all.
+ */
+template<CsvFieldTagType T, size_t Offset, size_t Width, typename V = std::string_view> requires (Width > 0)
+struct Column
+{
+    using type = csv_field_t;
+    using Quoted = std::false_type;
+    using value_type = V;
+    static constexpr const char *field_name = T::field_name.data();
+    static constexpr size_t offset = Offset;
+    static constexpr size_t width = Width;
+    V data{};
+};
+
+/*!
+ * A fixed width text document, the companion of CsvDoc for files whose columns are at fixed
+ * offsets instead of delimited, e.g. legacy traffic counter exports. There is nothing to scan
+ * for within a line: the bytes of a line are compared to the padding 64 at a time with SIMD,
+ * into one bitmap of the text bytes per 64 bytes of the record, and each column is then
+ * trimmed by finding the first and last bits of its range in the bitmap, with no further
+ * reading of the line. Lines are split by `\n`, a `\r` before it being excluded, and empty
+ * lines are skipped.
+ * @code
+ *   mio::csv::FixedWidthDoc<Column<NAME("station"), 0, 8>, Column<NAME("volume"), 8, 6, int32_t>> doc;
+ *   doc.make_records(block, [](const auto &a_rec) { ... return 0; });
+ * @endcode
+ */
+template<typename ...Ts> requires UniqueCsvFields<Ts...>
+struct FixedWidthDoc
+{
+    using Record = CsvRecord<Ts...>;
+    constexpr static auto field_count = std::tuple_size_v<Record>;
+
+    /*!
+     * Width of a record, up to the end of its last column.
+     */
+    constexpr static size_t record_width = std::max({(Ts::offset + Ts::width)...});
+
+    /*!
+     * Padding char trimmed from both sides of the columns.
+     */
+    constexpr static char padding = ' ';
+
+    FixedWidthDoc() = default;
+    FixedWidthDoc(const FixedWidthDoc &) = delete;
+    FixedWidthDoc(FixedWidthDoc &&) = delete;
+    ~FixedWidthDoc() = default;
+    FixedWidthDoc &operator=(FixedWidthDoc &) = delete;
+    FixedWidthDoc &operator=(FixedWidthDoc &&) = delete;
+
+    /*!
+     * Makes a record from a line.
+     * @param a_line A line excluding `\n`.
+     * @return A FixedWidthDoc::Record instance.
+     */
+    auto make_record(std::string_view a_line)
+    {
+        Record result{};
+        make_record(result, a_line);
+        return result;
+    }
+
+    /*!
+     * Updates an existing record from a line.
+     * @param a_rec Reference to an existing record.
+     * @param a_line A line excluding `\n`.
+     */
+    void make_record(Record &a_rec, std::string_view a_line)
+    {
+        const char *end = std::next(a_line.data(), static_cast<std::ptrdiff_t>(a_line.size()));
+        assign_fields(a_rec, slice_fields(a_line, end), std::make_index_sequence<field_count>{});
+    }
+
+    /*!
+     * Trimmed text of the columns of a record, in the order of the schema, with no conversion.
+     */
+    using Fields = std::array<std::string_view, field_count>;
+
+    /*!
+     * Makes records in bulk from a block of lines, one record per line.
+     * @param a_block Lines, the last of which may not be terminated by `\n`.
+     * @param a_on_record Callback invoked as a_on_record(const Record &) for each record.
+     * If a non-zero status code is returned, stops immediately.
+     * @return Number of records made, not counting the one the callback stopped at.
+     */
+    template<typename F>
+    size_t make_records(std::string_view a_block, F &&a_on_record)
+    {
+        WXLIB_TRACE_SPAN("fixedwidth.make_records");
+        Record rec{};
+        return for_each_line(a_block, [&](const Fields &a_fields) {
+            assign_fields(rec, a_fields, std::make_index_sequence<field_count>{});
+            return a_on_record(std::as_const(rec));
+        });
+    }
+
+    /*!
+     * Slices the columns of the records of a block of lines the same way as make_records, but
+     * hands their trimmed text to a_on_fields(const Fields &) with no conversion. The views are
+     * of a_block, and Skipped columns are empty.
+     * @return Number of records handled, not counting the one the callback stopped at.
+     */
+    template<typename F>
+    size_t make_fields(std::string_view a_block, F &&a_on_fields)
+    {
+        WXLIB_TRACE_SPAN("fixedwidth.make_fields");
+        return for_each_line(a_block, std::forward<F>(a_on_fields));
+    }
+
+    /*!
+     * Columnar storage of records, one contiguous column per field, see CsvDoc::Columns.
+     */
+    using Columns = std::tuple<std::vector<typename Ts::value_type>...>;
+
+    /*!
+     * Makes records in bulk from a block of lines, same as make_records, and appends their
+     * fields to the columns. std::string_view fields are views of a_block, which must then
+     * outlive the columns.
+     * @return Number of records appended.
+     */
+    size_t make_columns(std::string_view a_block, Columns &a_columns)
+    {
+        WXLIB_TRACE_SPAN("fixedwidth.make_columns");
+        return for_each_line(a_block, [&](const Fields &a_fields) {
+            append_fields(a_columns, a_fields, std::make_index_sequence<field_count>{});
+            return 0;
+        });
+    }
+
+    /*!
+     * Number of fields that failed to convert to their value type, see parse_field. Those
+     * fields are value initialized.
+     */
+    size_t invalid_field_count{0};
+
+private:
+    static constexpr size_t mask_words = (record_width + 63) / 64;
+    using Mask = std::array<uint64_t, mask_words>;
+
+    template<typename F>
+    size_t for_each_line(std::string_view a_block, F &&a_on_fields)
+    {
+        auto count = size_t{0};
+        const char *end = std::next(a_block.data(), static_cast<std::ptrdiff_t>(a_block.size()));
+
+        for (const char *b = a_block.data(); b != end;) {
+            const char *eol = fast_find<'\n'>(b, end);
+            auto line = std::string_view{b, static_cast<size_t>(eol - b)};
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            b = eol == end ? end : std::next(eol);
+            if (line.empty()) continue;
+
+            // The rest of the block may be read past the line, its bits being cleared.
+            const auto fields = slice_fields(line, end);
+            if (a_on_fields(fields) != 0) return count;
+            count++;
+        }
+
+        return count;
+    }
+
+    /*!
+     * Trims the columns of a line out of the bitmap of its text bytes.
+     * @param a_limit End of the readable bytes from the line, at its end at least.
+     */
+    Fields slice_fields(std::string_view a_line, const char *a_limit) const noexcept
+    {
+        const auto mask = text_mask(a_line, a_limit);
+        return Fields{trim<Ts>(a_line, mask)...};
+    }
+
+    template<typename C>
+    static std::string_view trim(std::string_view a_line, const Mask &a_mask) noexcept
+    {
+        if constexpr (std::is_same_v<typename C::value_type, Skipped>) {
+            return {};
+        } else {
+            constexpr size_t begin = C::offset, end = C::offset + C::width;
+            auto bits = [&](size_t a_word) {
+                auto m = a_mask[a_word];
+                const auto base = a_word * 64;
+                if (begin > base) m &= ~uint64_t{0} << (begin - base);
+                if (end < base + 64) m &= (uint64_t{1} << (end - base)) - 1;
+                return m;
+            };
+
+            auto first = end;
+            for (auto w = begin / 64; w <= (end - 1) / 64; w++) {
+                if (const auto m = bits(w)) {
+                    first = w * 64 + static_cast<size_t>(std::countr_zero(m));
+                    break;
+                }
+            }
+            if (first == end) return a_line.substr(std::min(begin, a_line.size()), 0);
+
+            auto last = first;
+            for (auto w = (end - 1) / 64 + 1; w-- > first / 64;) {
+                if (const auto m = bits(w)) {
+                    last = w * 64 + 63 - static_cast<size_t>(std::countl_zero(m));
+                    break;
+                }
+            }
+            return a_line.substr(first, last - first + 1);
+        }
+    }
+
+    /*!
+     * Bitmap of the bytes of the line other than the padding, up to record_width. Whole words
+     * are compared with SIMD where 64 bytes are readable, the bits past the line being cleared.
+     */
+    Mask text_mask(std::string_view a_line, const char *a_limit) const noexcept
+    {
+        Mask mask{};
+        const char *b = a_line.data();
+        for (size_t w = 0; w < mask_words && w * 64 < a_line.size(); w++) {
+            const char *p = std::next(b, static_cast<std::ptrdiff_t>(w * 64));
+            const auto size = std::min(a_line.size() - w * 64, size_t{64});
+            const auto valid = size == 64 ? ~uint64_t{0} : (uint64_t{1} << size) - 1;
+
+            if (a_limit - p >= 64) {
+#if defined(WXLIB_MIO_X86)
+                if (level_ != SimdLevel::None) {
+                    mask[w] = ~avx2_padding_mask(p) & valid;
+                    continue;
+                }
+#elif defined(WXLIB_MIO_ARM64)
+                mask[w] = ~neon_padding_mask(p) & valid;
+                continue;
+#endif
+            }
+
+            auto m = uint64_t{0};
+            for (size_t i = 0; i < size; i++) m |= static_cast<uint64_t>(p[i] != padding) << i;
+            mask[w] = m;
+        }
+        return mask;
+    }
+
+#if defined(WXLIB_MIO_X86)
+    WXLIB_MIO_TARGET("avx2") static uint64_t avx2_padding_mask(const char *a_p) noexcept
+    {
+        auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_p));
+        auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_p + 32));
+        return avx2_eq_mask(lo, hi, padding);
+    }
+#elif defined(WXLIB_MIO_ARM64)
+    static uint64_t neon_padding_mask(const char *a_p) noexcept
+    {
+        const auto *u = reinterpret_cast<const uint8_t *>(a_p);
+        const auto pad = vdupq_n_u8(static_cast<uint8_t>(padding));
+        return neon_movemask(vceqq_u8(vld1q_u8(u), pad), vceqq_u8(vld1q_u8(u + 16), pad),
+                             vceqq_u8(vld1q_u8(u + 32), pad), vceqq_u8(vld1q_u8(u + 48), pad));
+    }
+#endif
+
+    template<size_t ...I>
+    void assign_fields(Record &a_rec, const Fields &a_fields, std::index_sequence<I...>)
+    {
+        ((invalid_field_count += !parse_field(a_fields[I], std::get<I>(a_rec).data)), ...);
+    }
+
+    template<size_t ...I>
+    void append_fields(Columns &a_columns, const Fields &a_fields, std::index_sequence<I...>)
+    {
+        auto append = [this](std::string_view a_text, auto &a_column) {
+            typename std::remove_cvref_t<decltype(a_column)>::value_type value;
+            invalid_field_count += !parse_field(a_text, value);
+            a_column.push_back(std::move(value));
+        };
+
+        (append(a_fields[I], std::get<I>(a_columns)), ...);
+    }
+
+    // AVX-512 machines take the AVX2 kernel, two loads per 64 bytes being plenty for a line.
+    SimdLevel level_{simd_level()};
+};
+
+/*!
+ * Reads a fixed width text file in parallel, see FixedWidthDoc, the same way as CsvReader: the
+ * file is memory mapped, and its records parsed in bulk on a pool of worker threads pulling
+ * blocks of lines from a shared queue (see StringReader::async_getblock), each with its own
+ * FixedWidthDoc, handing the records to the sink in batches or in columnar blocks.
+ * @code
+ *   mio::csv::FixedWidthReader<Column<NAME("station"), 0, 8>, Column<NAME("volume"), 8, 6, int32_t>> reader("counts.txt");
+ *
+ *   auto n = reader.read([](int a_worker_id, auto a_records) {
+ *       for (const auto &rec : a_records) {
+ *           // ... do something about the record, e.g. get<1>(rec).data.
+ *       }
+ *       return 0;
+ *   });
+ * @endcode
+ */
+template<typename ...Ts>
+class FixedWidthReader
+{
+public:
+    using Doc = FixedWidthDoc<Ts...>;
+    using Record = typename Doc::Record;
+    using Columns = typename Doc::Columns;
+
+    /*!
+     * Maximum number of records handed to the sink at a time.
+     */
+    static constexpr size_t batch_size = StringReaderAsync::batch_size;
+
+    /*!
+     * Default size of the blocks of lines the workers claim at a time.
+     */
+    static constexpr size_t default_chunk_size = StringReaderAsync::default_chunk_size;
+
+    /*!
+     * Constructs a reader for a fixed width text file. If the file does not exist,
+     * std::system_error will be thrown with error code describing the nature of the error.
+     */
+    explicit FixedWidthReader(const std::string &a_file) : reader_{a_file}
+    {
+    }
+
+    FixedWidthReader(const FixedWidthReader &) = delete;
+    FixedWidthReader(FixedWidthReader &&) = delete;
+    FixedWidthReader &operator=(FixedWidthReader &) = delete;
+    FixedWidthReader &operator=(FixedWidthReader &&) = delete;
+    ~FixedWidthReader() = default;
+
+    [[nodiscard]] bool is_mapped() const noexcept
+    {
+        return reader_.is_mapped();
+    }
+
+    /*!
+     * Reads all records in parallel, and hands them to the sink in batches of up to batch_size
+     * records, invoked as a_sink(int worker_id, std::span<const Record> records), see
+     * CsvReader::read.
+     * Precondition - FixedWidthReader::is_mapped() must be true.
+     * @return Total number of records read.
+     */
+    template<typename F>
+    size_t read(const F &a_sink, size_t a_num_threads = available_concurrency(), size_t a_chunk_size = default_chunk_size)
+    {
+        auto batches = std::vector<std::vector<Record>>(std::max(a_num_threads, size_t{1}));
+
+        return read_blocks(a_num_threads, a_chunk_size, [&](int a_id, Doc &a_doc, std::string_view a_block, size_t &a_count) {
+            auto &batch = batches[a_id];
+            auto status = 0;
+            auto flush = [&]() {
+                status = a_sink(a_id, std::span<const Record>{batch});
+                if (status == 0) a_count += batch.size();
+                batch.clear();
+                return status;
+            };
+
+            a_doc.make_records(a_block, [&](const Record &a_rec) {
+                batch.push_back(a_rec);
+                return batch.size() == batch_size ? flush() : 0;
+            });
+
+            return (status == 0 && !batch.empty()) ? flush() : status;
+        });
+    }
+
+    /*!
+     * Reads all records in parallel, and hands them to the sink one columnar block at a time,
+     * invoked as a_sink(int worker_id, Columns &columns), see CsvReader::read_columns.
+     * Precondition - FixedWidthReader::is_mapped() must be true.
+     * @return Total number of records read.
+     */
+    template<typename F>
+    size_t read_columns(const F &a_sink, size_t a_num_threads = available_concurrency(), size_t a_chunk_size = default_chunk_size)
+    {
+        auto columns = std::vector<Columns>(std::max(a_num_threads, size_t{1}));
+
+        return read_blocks(a_num_threads, a_chunk_size, [&](int a_id, Doc &a_doc, std::string_view a_block, size_t &a_count) {
+            auto &cols = columns[a_id];
+            const auto n = a_doc.make_columns(a_block, cols);
+            const auto status = a_sink(a_id, cols);
+            if (status == 0) a_count += n;
+
+            std::apply([](auto &...a_column) { (a_column.clear(), ...); }, cols);
+            return status;
+        });
+    }
+
+    /*!
+     * Number of fields that failed to convert to their value type in the last read.
+     */
+    [[nodiscard]] size_t invalid_field_count() const noexcept
+    {
+        return invalid_field_count_;
+    }
+
+    /*!
+     * Statistics of the last read, see StringReader::stats.
+     */
+    [[nodiscard]] const ReaderStats &stats() const noexcept
+    {
+        return reader_.stats();
+    }
+
+    /*!
+     * Whether the first line is a header line, skipped. Fixed width headers are free text, and
+     * are not verified.
+     */
+    bool header_on_first_line{false};
+
+private:
+    template<typename F>
+    size_t read_blocks(size_t a_num_threads, size_t a_chunk_size, const F &a_on_block)
+    {
+        invalid_field_count_ = 0;
+        const auto num_threads = std::max(a_num_threads, size_t{1});
+        const auto content = reader_.content();
+        const char *end = std::next(content.data(), static_cast<std::ptrdiff_t>(content.size()));
+        const auto body = header_on_first_line
+                          ? std::min(static_cast<size_t>(fast_find<'\n'>(content.data(), end) - content.data()) + 1, content.size())
+                          : content.size() - skip_utf8_bom(content).size();
+
+        auto docs = std::vector<std::unique_ptr<Doc>>{};
+        for (size_t i = 0; i < num_threads; i++) docs.push_back(std::make_unique<Doc>());
+        auto counts = std::vector<size_t>(num_threads, 0);
+
+        reader_.async_getblock([&](int a_id, std::string_view a_block) {
+            if (a_block.data() == content.data()) a_block.remove_prefix(std::min(body, a_block.size()));
+            return a_on_block(a_id, *docs[a_id], a_block, counts[a_id]);
+        }, num_threads, a_chunk_size);
+
+        for (const auto &doc: docs) invalid_field_count_ += doc->invalid_field_count;
+        return std::accumulate(counts.begin(), counts.end(), size_t{0});
+    }
+
+    StringReaderAsync reader_;
+    size_t invalid_field_count_{0};
+};
+
+}
+#endif
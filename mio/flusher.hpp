@@ -0,0 +1,156 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_FLUSHER_HPP
+#define WXLIB_MIO_FLUSHER_HPP
+
+#include <mio/mio.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace mio {
+
+/**
+   Flushes the completed regions of a write mapping to disk on a thread of its own, while the
+   producer goes on writing past them, so that closing a large output does not block until all
+   of it is written back, see `basic_mmap::sync_range`.
+
+   The producer tells how far the mapping is complete with `complete`; the flusher syncs the
+   bytes completed since the last sync, a chunk at a time, and `wait` blocks until all of them
+   are synced. The mapping must not be grown, remapped or unmapped while the flusher syncs it:
+   hold the lock returned by `pause` while doing so.
+
+   @code
+     mio::mmap_sink sink("volumes.bin");
+     sink.set_sync_on_destroy(false);
+     mio::mmap_flusher flusher(sink);
+     for (size_t end = 0; end < sink.size(); end += batch_size) {
+       write_batch(sink.data() + end, batch_size);
+       flusher.complete(end + batch_size);
+     }
+     if (const auto error = flusher.wait()) report(error);
+   @endcode
+ */
+class mmap_flusher
+{
+public:
+  /**
+     Default size in bytes synced at a time, 64 MiB, which bounds how long `pause` waits.
+   */
+  static constexpr size_t default_chunk_size = size_t{64} << 20;
+
+  /**
+     \param   sink  The mapping to flush, which must outlive the flusher.
+     \param   chunk_size  Size in bytes synced at a time.
+   */
+  explicit mmap_flusher(mmap_sink &sink, const size_t chunk_size = default_chunk_size)
+      : sink_{sink}, chunk_size_{std::max(chunk_size, page_size())}, thread_{[this] { run(); }}
+  {
+  }
+
+  mmap_flusher(const mmap_flusher &) = delete;
+  mmap_flusher &operator=(const mmap_flusher &) = delete;
+
+  /**
+     Stops the flusher once the chunk being synced, if any, is done, without syncing the rest,
+     see `wait`.
+   */
+  ~mmap_flusher()
+  {
+    {
+      std::scoped_lock lock{mutex_};
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  /**
+     Marks the first `end` bytes of the mapping as complete, i.e. no longer written, to be
+     synced. Ends lower than the current one are ignored.
+   */
+  void complete(const size_t end)
+  {
+    {
+      std::scoped_lock lock{mutex_};
+      if (end <= completed_) return;
+      completed_ = end;
+    }
+    wake_.notify_one();
+  }
+
+  /**
+     Blocks until the bytes completed so far are synced.
+
+     \returns The first error syncing, if any, after which nothing more is synced.
+   */
+  std::error_code wait()
+  {
+    std::unique_lock lock{mutex_};
+    synced_changed_.wait(lock, [this] { return synced_ >= completed_ || error_; });
+    return error_;
+  }
+
+  /**
+     Number of bytes from the start of the mapping synced so far.
+   */
+  [[nodiscard]] size_t synced() const
+  {
+    std::scoped_lock lock{mutex_};
+    return synced_;
+  }
+
+  /**
+     Keeps the flusher off the mapping while the lock is held, e.g. to grow it.
+   */
+  [[nodiscard]] std::unique_lock<std::mutex> pause()
+  {
+    return std::unique_lock{mapping_mutex_};
+  }
+
+private:
+  void run()
+  {
+    std::unique_lock lock{mutex_};
+    while (true) {
+      wake_.wait(lock, [this] { return stopping_ || (synced_ < completed_ && !error_); });
+      if (stopping_) return;
+
+      const size_t first = synced_;
+      const size_t last = std::min(completed_, first + chunk_size_);
+      lock.unlock();
+
+      std::error_code error;
+      {
+        std::scoped_lock mapping{mapping_mutex_};
+        sink_.sync_range(first, last - first, false, error);
+      }
+
+      lock.lock();
+      if (error) error_ = error;
+      else synced_ = last;
+      synced_changed_.notify_all();
+    }
+  }
+
+  mmap_sink &sink_;
+  size_t chunk_size_;
+  mutable std::mutex mutex_;
+  std::mutex mapping_mutex_;
+  std::condition_variable wake_;
+  std::condition_variable synced_changed_;
+  size_t completed_{0};
+  size_t synced_{0};
+  bool stopping_{false};
+  std::error_code error_;
+  std::thread thread_;
+};
+
+}
+#endif
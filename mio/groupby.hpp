@@ -0,0 +1,229 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_GROUP_BY_HPP
+#define WXLIB_MIO_GROUP_BY_HPP
+
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * A parallel hash group-by aggregation, e.g. of the volume by link ID and hour of the records of
+ * a CsvReader, reducing the values of each key to their count, sum, min, max and mean.
+ *
+ * Each worker adds to a table of its own, with no lock: an open addressing table with linear
+ * probing, laid out as a column per accumulator, so that probing only touches the keys, and
+ * merging runs over plain arrays of numbers. The tables are merged once at the end, in parallel,
+ * by radix partitioning the groups of every table by the high bits of their hash, and merging each
+ * partition across the tables as a task of the shared executor.
+ *
+ * Composite keys are packed into one integer, e.g. link_id * 24 + hour.
+ *
+ * @code
+ *   mio::csv::GroupBy<uint64_t, double> volumes;
+ *   reader.read(volumes.sink([](const auto &a_rec) {
+ *       return std::pair{get<0>(a_rec).value * 24 + get<1>(a_rec).value, get<2>(a_rec).value};
+ *   }));
+ *
+ *   for (const auto &group: volumes.merge()) {
+ *       // ... do something about group.key, group.sum, group.mean().
+ *   }
+ * @endcode
+ */
+template<std::integral KeyT = uint64_t, typename ValueT = double>
+requires std::is_arithmetic_v<ValueT>
+class GroupBy
+{
+public:
+    /*!
+     * The reductions of the values of a key.
+     */
+    struct Group
+    {
+        KeyT key;
+        size_t count;
+        ValueT sum;
+        ValueT min;
+        ValueT max;
+
+        [[nodiscard]] double mean() const noexcept
+        {
+            return static_cast<double>(sum) / static_cast<double>(count);
+        }
+    };
+
+    /*!
+     * @param a_num_threads Number of workers adding values, i.e. one past the largest worker ID;
+     * 0 treated as 1.
+     */
+    explicit GroupBy(size_t a_num_threads = available_concurrency()) : tables_(std::max(a_num_threads, size_t{1}))
+    {
+    }
+
+    /*!
+     * Adds a value to the group of a key, in the table of the worker.
+     * Precondition - a_worker_id must be less than the number of workers, and not add
+     * concurrently with another thread of the same ID.
+     */
+    void add(int a_worker_id, KeyT a_key, ValueT a_value)
+    {
+        tables_[a_worker_id].add(a_key, 1, a_value, a_value, a_value);
+    }
+
+    /*!
+     * Makes a sink for CsvReader::read, adding the key and value a_key_value returns as a pair for
+     * each record, in the table of the worker the batch is read by.
+     */
+    template<typename F>
+    auto sink(F a_key_value)
+    {
+        return [this, a_key_value = std::move(a_key_value)](int a_id, const auto &a_records) {
+            for (const auto &rec: a_records) {
+                const auto [key, value] = a_key_value(rec);
+                add(a_id, static_cast<KeyT>(key), static_cast<ValueT>(value));
+            }
+            return 0;
+        };
+    }
+
+    /*!
+     * Merges the tables of the workers, keeping them as they are, so that more values can be added
+     * and merged again.
+     * @param a_num_threads Number of threads merging the partitions, 0 treated as 1.
+     * @return The groups of all the keys added, in no particular order.
+     */
+    [[nodiscard]] std::vector<Group> merge(size_t a_num_threads) const
+    {
+        const auto partitions = std::bit_ceil(std::max(a_num_threads, size_t{1}));
+        const auto shift = 64 - std::countr_zero(partitions);
+
+        // Scatters the groups of each table by partition, ...
+        auto scattered = std::vector<std::vector<std::vector<Group>>>(tables_.size(), std::vector<std::vector<Group>>(partitions));
+        in_parallel(tables_.size(), a_num_threads, [&](const size_t t) {
+            tables_[t].for_each([&](const Group &a_group) {
+                const auto p = shift == 64 ? 0 : hash(a_group.key) >> shift;
+                scattered[t][p].push_back(a_group);
+            });
+        });
+
+        // ... and merges each partition across the tables.
+        auto merged = std::vector<std::vector<Group>>(partitions);
+        in_parallel(partitions, a_num_threads, [&](const size_t p) {
+            Table table;
+            for (const auto &groups: scattered)
+                for (const auto &g: groups[p]) table.add(g.key, g.count, g.sum, g.min, g.max);
+            table.for_each([&](const Group &a_group) { merged[p].push_back(a_group); });
+        });
+
+        auto result = std::vector<Group>{};
+        for (const auto &groups: merged) result.insert(result.end(), groups.begin(), groups.end());
+        return result;
+    }
+
+    /*!
+     * Same as merge(a_num_threads), on as many threads as workers.
+     */
+    [[nodiscard]] std::vector<Group> merge() const
+    {
+        return merge(tables_.size());
+    }
+
+    /*!
+     * Removes all the groups.
+     */
+    void clear()
+    {
+        for (auto &t: tables_) t = Table{};
+    }
+
+private:
+    static uint64_t hash(const KeyT a_key) noexcept
+    {
+        // The finalizer of splitmix64, so that the low bits index the table, and the high bits the partitions.
+        auto x = static_cast<uint64_t>(a_key);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    template<typename F>
+    static void in_parallel(const size_t a_count, const size_t a_num_threads, const F &a_task)
+    {
+        const auto threads = std::clamp(a_num_threads, size_t{1}, std::max(a_count, size_t{1}));
+        Executor::shared().run_workers(threads, [&](const size_t t) {
+            for (auto i = t; i < a_count; i += threads) a_task(i);
+        });
+    }
+
+    /*!
+     * An open addressing table of the groups, a column per accumulator; a count of 0 marks an
+     * empty slot.
+     */
+    struct Table
+    {
+        static constexpr size_t initial_capacity = 1024;
+
+        std::vector<KeyT> keys;
+        std::vector<size_t> counts;
+        std::vector<ValueT> sums;
+        std::vector<ValueT> mins;
+        std::vector<ValueT> maxs;
+        size_t size{0};
+
+        void add(const KeyT a_key, const size_t a_count, const ValueT a_sum, const ValueT a_min, const ValueT a_max)
+        {
+            if (2 * (size + 1) > keys.size()) rehash(std::max(2 * keys.size(), initial_capacity));
+
+            const auto mask = keys.size() - 1;
+            auto i = hash(a_key) & mask;
+            while (counts[i] != 0 && keys[i] != a_key) i = (i + 1) & mask;
+
+            if (counts[i] == 0) {
+                keys[i] = a_key;
+                sums[i] = a_sum;
+                mins[i] = a_min;
+                maxs[i] = a_max;
+                size++;
+            } else {
+                sums[i] += a_sum;
+                mins[i] = std::min(mins[i], a_min);
+                maxs[i] = std::max(maxs[i], a_max);
+            }
+            counts[i] += a_count;
+        }
+
+        template<typename F>
+        void for_each(const F &a_on_group) const
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+                if (counts[i] != 0) a_on_group(Group{keys[i], counts[i], sums[i], mins[i], maxs[i]});
+        }
+
+        void rehash(const size_t a_capacity)
+        {
+            Table table;
+            table.keys.resize(a_capacity);
+            table.counts.resize(a_capacity);
+            table.sums.resize(a_capacity);
+            table.mins.resize(a_capacity);
+            table.maxs.resize(a_capacity);
+            for_each([&](const Group &a_group) { table.add(a_group.key, a_group.count, a_group.sum, a_group.min, a_group.max); });
+            *this = std::move(table);
+        }
+    };
+
+    std::vector<Table> tables_;
+};
+
+}
+#endif
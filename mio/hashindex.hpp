@@ -0,0 +1,309 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_HASH_INDEX_HPP
+#define WXLIB_MIO_HASH_INDEX_HPP
+
+#include <mio/mio.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace mio {
+
+/**
+   A persistent hash index of the records of a file by ID, e.g. node_id, link_id or stop_id, to
+   the offset or the number of the record, so that lookups by ID at startup need neither a rebuild
+   nor a heap allocated map.
+
+   The index is an open addressing table with linear probing, of {key, value} slots, with at most
+   half of them used, built in parallel from a key column, e.g. of CsvDoc::Columns or CsvCache,
+   and written to a file through a mmap_sink. open() maps the file through a mmap_source, and
+   find() probes the mapping directly; the pages of the file are shared by all the processes
+   mapping it. The first of equal keys is kept.
+
+   The file uses the native byte order, and is not meant to be shared across platforms.
+
+   @code
+     auto &ids = std::get<0>(columns);
+     std::error_code error;
+     mio::HashIndex<int64_t>::build("links.hidx", std::span<const int64_t>{ids}, error);
+
+     mio::HashIndex<int64_t> links;
+     links.open("links.hidx", error);
+     if (const auto i = links.find(link_id); i != links.npos) {
+       // ... record i has the link ID.
+     }
+   @endcode
+ */
+template<std::integral KeyT = int64_t>
+class HashIndex
+{
+public:
+  /**
+     Returned by find() for a key not in the index, and not a valid value.
+   */
+  static constexpr uint64_t npos = std::numeric_limits<uint64_t>::max();
+
+  HashIndex() = default;
+  HashIndex(const HashIndex &) = delete;
+  HashIndex &operator=(const HashIndex &) = delete;
+
+  /**
+     Builds the index of a_keys[i] to i, see build(a_file, a_keys, a_values, error, a_num_threads).
+   */
+  static void build(const std::string &a_file, std::span<const KeyT> a_keys, std::error_code &error, const size_t a_num_threads = available_concurrency())
+  {
+    build_impl(a_file, a_keys, [](const size_t i) { return uint64_t{i}; }, error, a_num_threads);
+  }
+
+  /**
+     Builds the index of a_keys[i] to a_values[i], and writes it to a file, replacing it if it
+     exists.
+
+     The keys are hashed, and scattered by the range of the table their home slot is in, on
+     a_num_threads threads; then each thread inserts the keys of its ranges, in order, probing
+     within the range, and the keys probing past the end of their range are inserted last.
+
+     \param a_file The index file to write.
+     \param a_keys The keys, e.g. a column of IDs.
+     \param a_values The values, e.g. the offsets of the records; none of them npos.
+     \param error Set to describe the error if the file cannot be written, or to
+     std::errc::invalid_argument if there are not as many values as keys.
+     \param a_num_threads Number of threads, 0 treated as 1.
+   */
+  static void build(const std::string &a_file, std::span<const KeyT> a_keys, std::span<const uint64_t> a_values, std::error_code &error, const size_t a_num_threads = available_concurrency())
+  {
+    if (a_keys.size() != a_values.size()) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+
+    build_impl(a_file, a_keys, [a_values](const size_t i) { return a_values[i]; }, error, a_num_threads);
+  }
+
+  /**
+     Maps an index file written by build().
+
+     \param a_file The index file.
+     \param error Set to describe the error if the file cannot be mapped, or to
+     std::errc::invalid_argument if it is not an index of this key type.
+   */
+  void open(const std::string &a_file, std::error_code &error)
+  {
+    close();
+    mmap_.map(a_file, error);
+    if (error) return;
+
+    auto header = Header{};
+    const auto expected = Header{};
+    if (mmap_.size() >= sizeof(header)) std::memcpy(&header, mmap_.data(), sizeof(header));
+
+    const auto valid = mmap_.size() >= sizeof(header)
+        && std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+        && header.key_size == expected.key_size
+        && std::has_single_bit(header.capacity)
+        && mmap_.size() == sizeof(header) + header.capacity * sizeof(Slot);
+
+    if (!valid) {
+      mmap_.unmap();
+      error = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+
+    // The mapping is page aligned, and the header size is a multiple of the slot size.
+    slots_ = {reinterpret_cast<const Slot *>(std::next(mmap_.data(), sizeof(header))), static_cast<size_t>(header.capacity)};
+    size_ = header.size;
+  }
+
+  void close() noexcept
+  {
+    mmap_.unmap();
+    slots_ = {};
+    size_ = 0;
+  }
+
+  [[nodiscard]] bool is_open() const noexcept
+  {
+    return mmap_.is_mapped();
+  }
+
+  /**
+     Returns the value of a key, or npos if the key is not in the index.
+
+     Precondition - HashIndex::is_open() must be true.
+   */
+  [[nodiscard]] uint64_t find(const KeyT a_key) const noexcept
+  {
+    const auto key = static_cast<uint64_t>(a_key);
+    const auto mask = slots_.size() - 1;
+    for (auto i = hash(key) & mask;; i = (i + 1) & mask) {
+      const auto &slot = slots_[i];
+      if (slot.value == npos) return npos;
+      if (slot.key == key) return slot.value;
+    }
+  }
+
+  [[nodiscard]] bool contains(const KeyT a_key) const noexcept
+  {
+    return find(a_key) != npos;
+  }
+
+  /**
+     Number of distinct keys.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return size_;
+  }
+
+private:
+  struct Slot
+  {
+    uint64_t key;
+    uint64_t value;
+  };
+
+  struct Header
+  {
+    char magic[8] = {'W', 'X', 'H', 'I', 'D', 'X', '0', '1'};
+    uint64_t key_size = sizeof(KeyT);
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+  };
+
+  static_assert(sizeof(Header) % sizeof(Slot) == 0);
+
+  static uint64_t hash(uint64_t x) noexcept
+  {
+    // The finalizer of splitmix64.
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  template<typename F>
+  static void in_parallel(const size_t a_threads, const F &a_task)
+  {
+    Executor::shared().run_workers(a_threads, a_task);
+  }
+
+  template<typename ValueOf>
+  static void build_impl(const std::string &a_file, std::span<const KeyT> a_keys, const ValueOf &a_value_of, std::error_code &error, const size_t a_num_threads)
+  {
+    error.clear();
+    const auto count = a_keys.size();
+    const auto capacity = std::bit_ceil(std::max(2 * count, size_t{16}));
+    const auto capacity_bits = static_cast<size_t>(std::countr_zero(capacity));
+    const auto threads = std::clamp(count >> 14, size_t{1}, std::max(a_num_threads, size_t{1}));
+
+    // Ranges of at least 64 slots, a few per thread to even out the load.
+    const auto range_bits = static_cast<size_t>(std::countr_zero(std::bit_ceil(threads * 8)));
+    const auto ranges = size_t{1} << std::min(range_bits, capacity_bits - std::min(capacity_bits, size_t{6}));
+    const auto range_shift = capacity_bits - static_cast<size_t>(std::countr_zero(ranges));
+
+    {
+      std::ofstream create(a_file, std::ios::binary | std::ios::trunc);
+      if (!create) {
+        error = std::make_error_code(std::errc::io_error);
+        return;
+      }
+    }
+
+    auto header = Header{};
+    header.capacity = capacity;
+    std::filesystem::resize_file(a_file, sizeof(header) + capacity * sizeof(Slot), error);
+    if (error) return;
+
+    auto sink = make_mmap_sink(a_file, error);
+    if (error) return;
+    auto *slots = reinterpret_cast<Slot *>(std::next(sink.data(), sizeof(header)));
+
+    // Scatters the key numbers by the range of their home slot, in order, ...
+    const auto chunk = (count + threads - 1) / threads;
+    auto homes = std::vector<uint64_t>(count);
+    auto counts = std::vector<std::vector<size_t>>(threads, std::vector<size_t>(ranges));
+    in_parallel(threads, [&](const size_t t) {
+      for (auto i = t * chunk; i < std::min(count, (t + 1) * chunk); i++) {
+        homes[i] = hash(static_cast<uint64_t>(a_keys[i])) & (capacity - 1);
+        counts[t][homes[i] >> range_shift]++;
+      }
+    });
+
+    auto starts = std::vector<size_t>(ranges + 1);
+    for (size_t r = 0, offset = 0; r < ranges; r++) {
+      starts[r] = offset;
+      for (auto &c: counts) {
+        const auto n = c[r];
+        c[r] = offset;
+        offset += n;
+      }
+    }
+    starts[ranges] = count;
+
+    auto scattered = std::vector<size_t>(count);
+    in_parallel(threads, [&](const size_t t) {
+      for (auto i = t * chunk; i < std::min(count, (t + 1) * chunk); i++) scattered[counts[t][homes[i] >> range_shift]++] = i;
+    });
+
+    // ... inserts them range by range, ...
+    // Probes up to a_end, or around the whole table if a_end is capacity.
+    auto insert = [&](const size_t a_index, const size_t a_end) {
+      const auto key = static_cast<uint64_t>(a_keys[a_index]);
+      for (auto n = a_end - homes[a_index], s = homes[a_index]; n != 0; n--, s = (s + 1) & (capacity - 1)) {
+        if (slots[s].value == npos) {
+          slots[s] = {key, a_value_of(a_index)};
+          return 1;
+        }
+        if (slots[s].key == key) return 0;
+      }
+      return -1;
+    };
+
+    auto overflows = std::vector<std::vector<size_t>>(ranges);
+    auto sizes = std::vector<size_t>(ranges);
+    in_parallel(threads, [&](const size_t t) {
+      for (auto r = t; r < ranges; r += threads) {
+        std::fill(slots + (r << range_shift), slots + ((r + 1) << range_shift), Slot{0, npos});
+
+        const auto end = (r + 1) << range_shift;
+        for (auto k = starts[r]; k < starts[r + 1]; k++) {
+          if (const auto inserted = insert(scattered[k], end); inserted < 0)
+            overflows[r].push_back(scattered[k]);
+          else
+            sizes[r] += static_cast<size_t>(inserted);
+        }
+      }
+    });
+
+    // ... and then the ones probing past the end of their range.
+    for (const auto &overflow: overflows)
+      for (const auto i: overflow) sizes[0] += static_cast<size_t>(insert(i, homes[i] + capacity));
+
+    header.size = std::accumulate(sizes.begin(), sizes.end(), uint64_t{0});
+    std::memcpy(sink.data(), &header, sizeof(header));
+    sink.sync(error);
+  }
+
+  mmap_source mmap_;
+  std::span<const Slot> slots_;
+  size_t size_{0};
+};
+
+}
+#endif
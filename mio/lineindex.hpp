@@ -0,0 +1,501 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_LINE_INDEX_HPP
+#define WXLIB_MIO_LINE_INDEX_HPP
+
+#include <mio/mio.hpp>
+#include <mio/eliasfano.hpp>
+#include <mio/executor.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/replacefile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   An index of the line positions in a block of memory, built by a single SIMD scan
+   for `\n`. Once built, any line can be accessed in O(1) by its zero-based number,
+   and ranges of lines can be handed to different threads without scanning again.
+
+   Line i spans [begin of line i, position of its terminating `\n`). The bytes after
+   the last `\n`, if any, count as the last line. The end offset of each line is
+   stored relative to the beginning of the block, 32-bit wide for blocks smaller than
+   4 GiB, and 64-bit wide otherwise, or Elias-Fano encoded in about 2 + log2(average line
+   length) bits, see Encoding, so that the index of a file of billions of lines fits in
+   memory.
+
+   The index does not own the memory it refers to; the block must outlive the index.
+
+   An index can be saved to a sidecar file, and later loaded by memory mapping the
+   sidecar instead of scanning the block again. The sidecar records the size and the
+   last write time of the indexed file, and is rejected if either has changed. The
+   sidecar uses the native byte order, and is not meant to be shared across platforms.
+
+   @code
+     mio::LineIndex index(data, data + size);
+     for (size_t i = 0; i < index.line_count(); i++) {
+       auto line = index.line(i);
+       // ... do something about the line.
+     }
+   @endcode
+ */
+class LineIndex
+{
+public:
+  /**
+     Maximum number of lines handed to a batch callback at a time.
+   */
+  static constexpr size_t batch_size = 1024;
+
+  /**
+     Minimum size in bytes of the blocks an Elias-Fano index is built from in parallel.
+   */
+  static constexpr size_t min_block_size = size_t{1} << 20;
+
+  /**
+     How the line offsets are stored.
+   */
+  enum class Encoding : uint32_t
+  {
+    /**
+       The end offset of each line, 32 or 64 bits wide; the fastest to access.
+     */
+    Offsets = 0,
+
+    /**
+       Elias-Fano encoded end offsets, see EliasFano, about 2 + log2(average line length) bits
+       per line, e.g. 9 bits instead of 64 for lines of 100 bytes in a file of more than 4 GiB.
+       A line is accessed in O(1) by selecting its end offset in the encoding.
+     */
+    EliasFano = 1,
+  };
+
+  LineIndex() = default;
+
+  /**
+     Builds the index for [a_begin, a_end), see build().
+   */
+  LineIndex(const char *a_begin, const char *a_end, Encoding a_encoding = Encoding::Offsets, size_t a_num_threads = 1)
+  {
+    build(a_begin, a_end, a_encoding, a_num_threads);
+  }
+
+  /**
+     Rebuilds the index for [a_begin, a_end), discarding the existing one.
+
+     An Elias-Fano index is built in parallel, from blocks of at least min_block_size bytes,
+     one per thread: a first pass counts the `\n` of each block, adding up the popcounts of the
+     SIMD comparison masks, which numbers the first line of each block, and a second pass
+     encodes the positions of the set bits of the masks.
+
+     \param a_encoding How the line offsets are stored.
+     \param a_num_threads Number of threads building an Elias-Fano index, 0 treated as 1.
+   */
+  void build(const char *a_begin, const char *a_end, Encoding a_encoding = Encoding::Offsets, size_t a_num_threads = 1)
+  {
+    reset(a_begin, a_end);
+    encoding_ = a_encoding;
+    if (encoding_ == Encoding::EliasFano) {
+      build_elias_fano(a_num_threads);
+      return;
+    }
+
+    auto &owned32 = owned32_;
+    auto &owned64 = owned64_;
+
+    if (wide_)
+      fast_find_each<'\n'>(a_begin, a_end, [&](const char *a_pos) { owned64.push_back(a_pos - a_begin); });
+    else
+      fast_find_each<'\n'>(a_begin, a_end, [&](const char *a_pos) { owned32.push_back(static_cast<uint32_t>(a_pos - a_begin)); });
+
+    // The trailing bytes not terminated by `\n` make up the last line.
+    const auto n = wide_ ? owned64.size() : owned32.size();
+    if (size_ > 0 && (n == 0 || (wide_ ? owned64.back() : owned32.back()) != size_ - 1))
+      wide_ ? owned64.push_back(size_) : owned32.push_back(static_cast<uint32_t>(size_));
+
+    ends32_ = owned32;
+    ends64_ = owned64;
+    count_ = wide_ ? ends64_.size() : ends32_.size();
+  }
+
+  /**
+     Saves the index to a sidecar file, stamped with the size and last write time of the
+     indexed file. The sidecar is written to a temporary file first, then renamed, so
+     concurrent readers never observe a partially written sidecar.
+
+     \param a_sidecar The sidecar file to write.
+     \param a_file The indexed file.
+     \param error Set to describe the error if the sidecar cannot be written.
+   */
+  void save(const std::string &a_sidecar, const std::string &a_file, std::error_code &error) const
+  {
+    error.clear();
+    auto header = SidecarHeader{};
+    if (!stamp(header, a_file, error)) return;
+    header.line_count = count_;
+    header.offset_width = wide_ || encoding_ == Encoding::EliasFano ? sizeof(uint64_t) : sizeof(uint32_t);
+    header.encoding = static_cast<uint32_t>(encoding_);
+
+    replace_file(a_sidecar, [&](std::ofstream &out) {
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      if (encoding_ == Encoding::EliasFano)
+        out.write(reinterpret_cast<const char *>(ef_.data().data()), static_cast<std::streamsize>(ef_.size_bytes()));
+      else if (wide_)
+        out.write(reinterpret_cast<const char *>(ends64_.data()), static_cast<std::streamsize>(ends64_.size_bytes()));
+      else
+        out.write(reinterpret_cast<const char *>(ends32_.data()), static_cast<std::streamsize>(ends32_.size_bytes()));
+    }, error);
+  }
+
+  /**
+     Loads the index by memory mapping a sidecar file previously written by save().
+
+     \param a_sidecar The sidecar file to load.
+     \param a_file The indexed file, used to validate the sidecar.
+     \param a_begin First byte of the mapped content of `a_file`.
+     \param a_end One past the last byte of the mapped content of `a_file`.
+     \param error Set to describe the error if the sidecar is missing, corrupted or stale,
+     or has another encoding, in which case the index is left empty.
+     \param a_encoding The encoding expected of the sidecar.
+   */
+  void load(const std::string &a_sidecar, const std::string &a_file, const char *a_begin, const char *a_end, std::error_code &error,
+            Encoding a_encoding = Encoding::Offsets)
+  {
+    reset(a_begin, a_end);
+    encoding_ = a_encoding;
+    auto expected = SidecarHeader{};
+    if (!stamp(expected, a_file, error)) return;
+
+    sidecar_.map(a_sidecar, error);
+    if (error) return;
+
+    auto header = SidecarHeader{};
+    if (sidecar_.size() >= sizeof(header)) std::memcpy(&header, sidecar_.data(), sizeof(header));
+
+    const auto elias_fano = encoding_ == Encoding::EliasFano;
+    const auto width = wide_ || elias_fano ? sizeof(uint64_t) : sizeof(uint32_t);
+    auto valid = sidecar_.size() >= sizeof(header)
+        && std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+        && header.file_size == size_ && header.file_size == expected.file_size
+        && header.file_time == expected.file_time
+        && header.encoding == static_cast<uint32_t>(encoding_)
+        && header.offset_width == width
+        && header.line_count <= size_ + 1
+        && (sidecar_.size() - sizeof(header)) % width == 0
+        && (elias_fano || (sidecar_.size() - sizeof(header)) / width == header.line_count);
+
+    // The mapping is page aligned, and the header size is a multiple of 8.
+    const auto *offsets = valid ? std::next(sidecar_.data(), sizeof(header)) : nullptr;
+    if (valid && elias_fano) {
+      const auto words = std::span{reinterpret_cast<const uint64_t *>(offsets), (sidecar_.size() - sizeof(header)) / width};
+      valid = ef_.attach(words) && ef_.size() == header.line_count;
+    }
+
+    if (valid && !elias_fano)
+      valid = wide_ ? ascending(std::span{reinterpret_cast<const uint64_t *>(offsets), static_cast<size_t>(header.line_count)})
+                    : ascending(std::span{reinterpret_cast<const uint32_t *>(offsets), static_cast<size_t>(header.line_count)});
+    else if (valid)
+      valid = ascending(ef_);
+
+    if (!valid) {
+      sidecar_.unmap();
+      ef_ = {};
+      error = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+
+    if (wide_ && !elias_fano)
+      ends64_ = {reinterpret_cast<const uint64_t *>(offsets), static_cast<size_t>(header.line_count)};
+    else if (!elias_fano)
+      ends32_ = {reinterpret_cast<const uint32_t *>(offsets), static_cast<size_t>(header.line_count)};
+    count_ = header.line_count;
+  }
+
+  /**
+     Returns true if the index is backed by a memory mapped sidecar file.
+   */
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return sidecar_.is_mapped();
+  }
+
+  /**
+     Returns the number of lines indexed.
+   */
+  [[nodiscard]] size_t line_count() const noexcept
+  {
+    return count_;
+  }
+
+  /**
+     Returns how the line offsets are stored.
+   */
+  [[nodiscard]] Encoding encoding() const noexcept
+  {
+    return encoding_;
+  }
+
+  /**
+     Returns the size in bytes of the line offsets.
+   */
+  [[nodiscard]] size_t size_bytes() const noexcept
+  {
+    if (encoding_ == Encoding::EliasFano) return ef_.size_bytes();
+    return wide_ ? ends64_.size_bytes() : ends32_.size_bytes();
+  }
+
+  /**
+     Returns true if no line has been indexed.
+   */
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return count_ == 0;
+  }
+
+  /**
+     Returns the i-th line, excluding the terminating `\n`.
+
+     Precondition - i < line_count().
+   */
+  [[nodiscard]] std::string_view line(const size_t i) const noexcept
+  {
+    const auto [b, e] = bounds(i);
+    return {std::next(data_, static_cast<std::ptrdiff_t>(b)), static_cast<size_t>(e - b)};
+  }
+
+  /**
+     Returns the begin and end offsets of the bytes of the lines in [a_first, a_last), including
+     the terminating `\n` of the last one if any, e.g. to export them, see export_lines().
+
+     Precondition - a_first < a_last <= line_count().
+   */
+  [[nodiscard]] std::pair<uint64_t, uint64_t> byte_range(const size_t a_first, const size_t a_last) const noexcept
+  {
+    return {bounds(a_first).first, std::min<uint64_t>(bounds(a_last - 1).second + 1, size_)};
+  }
+
+  /**
+     Fires the callback for each line in [a_first, a_last), in the context of the calling
+     thread. The callback is either a line handler, or a batch handler receiving up to
+     LineIndex::batch_size consecutive lines at a time; see AsyncGetlineHandler. A numbered
+     handler is also given the number of the line, or of the first line of the batch; see
+     AsyncNumberedHandler.
+
+     \returns Total number of lines processed, stopping at the first non-zero status code.
+   */
+  template<typename CallbackT>
+  size_t for_each(const size_t a_first, const size_t a_last, const int a_worker_id, const CallbackT &a_callback) const noexcept
+  {
+    auto counter = size_t{0};
+
+    constexpr bool numbered_batch = std::is_invocable_r_v<int, const CallbackT &, int, size_t, std::span<const std::string_view>>;
+    constexpr bool numbered_line = std::is_invocable_r_v<int, const CallbackT &, int, size_t, std::string_view>;
+
+    if constexpr (numbered_batch || std::is_invocable_r_v<int, const CallbackT &, int, std::span<const std::string_view>>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+
+      for (auto i = a_first; i < a_last;) {
+        const auto first = i;
+        auto n = size_t{0};
+        while (n < batch_size && i < a_last) batch[n++] = line(i++);
+
+        // If a non-zero status code is returned, break immediately.
+        const auto lines = std::span<const std::string_view>{batch.data(), n};
+        auto status = 0;
+        if constexpr (numbered_batch)
+          status = a_callback(a_worker_id, first, lines);
+        else
+          status = a_callback(a_worker_id, lines);
+
+        if (status == 0)
+          counter += n;
+        else
+          break;
+      }
+    } else {
+      for (auto i = a_first; i < a_last; i++) {
+        // If a non-zero status code is returned, break immediately.
+        auto status = 0;
+        if constexpr (numbered_line)
+          status = a_callback(a_worker_id, i, line(i));
+        else
+          status = a_callback(a_worker_id, line(i));
+
+        if (status == 0)
+          counter++;
+        else
+          break;
+      }
+    }
+
+    return counter;
+  }
+
+  /**
+     Splits [a_first, a_last) into `a_num_threads` ranges with the same number of lines,
+     and fires the callback for each line in the context of the worker thread handling
+     the range.
+
+     \returns Total number of lines processed.
+   */
+  template<typename CallbackT>
+  size_t async_for_each(const size_t a_first, const size_t a_last, const size_t a_num_threads, const CallbackT &a_callback) const noexcept
+  {
+    const auto last = std::min(a_last, count_);
+    const auto first = std::min(a_first, last);
+    const auto num_threads = std::max(a_num_threads, size_t{1});
+    const auto lines_per_thread = (last - first + num_threads - 1) / num_threads;
+
+    const auto ranges = lines_per_thread == 0 ? 0 : (last - first + lines_per_thread - 1) / lines_per_thread;
+    auto counts = std::vector<size_t>(ranges);
+    Executor::shared().run_workers(ranges, [&](const size_t i) {
+      const auto b = first + i * lines_per_thread;
+      counts[i] = for_each(b, std::min(b + lines_per_thread, last), static_cast<int>(i), a_callback);
+    });
+
+    return std::accumulate(counts.begin(), counts.end(), size_t(0));
+  }
+
+private:
+  /**
+     Header of the sidecar file, followed by `line_count` offsets `offset_width` bytes each, or
+   by the words of the EliasFano encoding.
+   */
+  struct SidecarHeader
+  {
+    char magic[8] = {'W', 'X', 'L', 'I', 'D', 'X', '0', '1'};
+    uint64_t file_size = 0;
+    int64_t file_time = 0;
+    uint64_t line_count = 0;
+    uint32_t offset_width = 0;
+    uint32_t encoding = 0;
+  };
+
+  static_assert(sizeof(SidecarHeader) % sizeof(uint64_t) == 0);
+
+  static bool stamp(SidecarHeader &a_header, const std::string &a_file, std::error_code &error)
+  {
+    a_header.file_size = std::filesystem::file_size(a_file, error);
+    if (error) return false;
+    a_header.file_time = std::filesystem::last_write_time(a_file, error).time_since_epoch().count();
+    return !error;
+  }
+
+  void reset(const char *a_begin, const char *a_end) noexcept
+  {
+    data_ = a_begin;
+    size_ = static_cast<size_t>(a_end - a_begin);
+    wide_ = size_ > std::numeric_limits<uint32_t>::max();
+    count_ = 0;
+    owned32_.clear();
+    owned64_.clear();
+    ends32_ = {};
+    ends64_ = {};
+    ef_ = {};
+    encoding_ = Encoding::Offsets;
+    sidecar_.unmap();
+  }
+
+  /**
+     Encodes the positions of the `\n` of blocks of the memory in parallel, see build().
+   */
+  void build_elias_fano(const size_t a_num_threads)
+  {
+    const auto blocks = std::clamp(size_ / min_block_size, size_t{1}, std::max(a_num_threads, size_t{1}));
+    const auto block_size = (size_ + blocks - 1) / blocks;
+    const auto block = [&](const size_t a_block) {
+      const auto b = std::min(a_block * block_size, size_);
+      return std::make_pair(data_ + b, data_ + std::min(b + block_size, size_));
+    };
+
+    // The first line of each block, numbered by counting the lines of the previous ones.
+    auto firsts = std::vector<size_t>(blocks + 1, 0);
+    Executor::shared().run_workers(blocks, [&](const size_t i) {
+      const auto [b, e] = block(i);
+      firsts[i + 1] = fast_count<'\n'>(b, e);
+    });
+    std::partial_sum(firsts.begin(), firsts.end(), firsts.begin());
+
+    // The trailing bytes not terminated by `\n` make up the last line.
+    const auto newlines = firsts.back();
+    const auto trailing = size_ > 0 && data_[size_ - 1] != '\n';
+    ef_.reset(newlines + trailing, size_ + 1);
+
+    Executor::shared().run_workers(blocks, [&](const size_t i) {
+      const auto [b, e] = block(i);
+      auto writer = EliasFano::Writer{ef_, firsts[i]};
+      fast_find_each<'\n'>(b, e, [&](const char *a_pos) { writer.push(static_cast<uint64_t>(a_pos - data_)); });
+      writer.finish();
+    });
+
+    if (trailing) {
+      auto writer = EliasFano::Writer{ef_, newlines};
+      writer.push(size_);
+      writer.finish();
+    }
+
+    ef_.finish();
+    count_ = ef_.size();
+  }
+
+  /**
+     Whether the line ends of a sidecar are strictly increasing and within the file, so that
+     every line lies in [data_, data_ + size_), whatever the sidecar holds.
+   */
+  template<typename EndsT>
+  [[nodiscard]] bool ascending(const EndsT &a_ends) const noexcept
+  {
+    auto next = uint64_t{0}; // The least end of the next line.
+    for (size_t i = 0; i < a_ends.size(); i++) {
+      const auto end = static_cast<uint64_t>(a_ends[i]);
+      if (end < next || end > size_) return false;
+      next = end + 1;
+    }
+    return true;
+  }
+
+  /**
+     Begin and end offsets of the i-th line.
+   */
+  [[nodiscard]] std::pair<uint64_t, uint64_t> bounds(const size_t i) const noexcept
+  {
+    if (encoding_ == Encoding::EliasFano) {
+      if (i == 0) return {0, ef_[0]};
+      const auto [previous, end] = ef_.pair(i - 1);
+      return {previous + 1, end};
+    }
+
+    const auto end = wide_ ? ends64_[i] : ends32_[i];
+    return {i == 0 ? 0 : (wide_ ? ends64_[i - 1] : ends32_[i - 1]) + 1, end};
+  }
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t count_ = 0;
+  bool wide_ = false;
+  Encoding encoding_ = Encoding::Offsets;
+  std::span<const uint32_t> ends32_;
+  std::span<const uint64_t> ends64_;
+  std::vector<uint32_t> owned32_;
+  std::vector<uint64_t> owned64_;
+  EliasFano ef_;
+  mmap_source sidecar_;
+};
+
+}
+#endif
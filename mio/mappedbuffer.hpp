@@ -0,0 +1,219 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_MAPPED_BUFFER_HPP
+#define WXLIB_MIO_MAPPED_BUFFER_HPP
+
+#include <mio/mio.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+namespace mio {
+
+/*!
+ * A growable byte buffer backed by a memory mapped file, with the interface of a byte container,
+ * i.e., data(), size(), resize(), indexing and iterators, so that archives and sinks written for
+ * std::vector, e.g. zpp::bits::out, write straight into the file instead of a staging buffer.
+ *
+ * Growing beyond the mapping extends the file by at least one extent, or half its size once
+ * larger, and grows the mapping in place, which may move data(); on Linux, the extent is also
+ * allocated with posix_fallocate, so that running out of disk space is reported as an error
+ * instead of a SIGBUS. Shrinking only moves the logical end, so that archives fitting the buffer
+ * to their position after each write do not touch the file. Closing the buffer truncates the file
+ * to size().
+ *
+ * The file is read back zero-copy through a mmap_source, e.g. by zpp::bits::in.
+ *
+ * @code
+ *   mio::MappedBuffer buffer("checkpoint.bin");
+ *   zpp::bits::out out{buffer};
+ *   out(links).or_throw();
+ *   std::error_code error;
+ *   buffer.close(error);
+ *
+ *   auto source = mio::make_mmap_source(std::string("checkpoint.bin"), error);
+ *   zpp::bits::in in{source};
+ *   in(links).or_throw();
+ * @endcode
+ */
+class MappedBuffer
+{
+public:
+    using value_type = char;
+    using size_type = size_t;
+
+    /*!
+     * Default size by which the file grows.
+     */
+    static constexpr size_t default_extent = size_t{64} << 20;
+
+    /*!
+     * Creates the file, or truncates it if it exists, empty. If the file cannot be created or
+     * mapped, std::system_error will be thrown with error code describing the nature of the error.
+     * @param a_file The file to write.
+     * @param a_extent Size in bytes by which the file grows when the mapping is full.
+     */
+    explicit MappedBuffer(const std::string &a_file, size_t a_extent = default_extent)
+        : file_{a_file}, extent_{std::max(a_extent, page_size())}
+    {
+        {
+            std::ofstream create(file_, std::ios::binary | std::ios::trunc);
+            if (!create) throw std::system_error(std::make_error_code(std::errc::io_error));
+        }
+
+        grow(0);
+        if (error_) throw std::system_error(error_);
+    }
+
+    MappedBuffer(const MappedBuffer &) = delete;
+    MappedBuffer(MappedBuffer &&) = delete;
+    MappedBuffer &operator=(MappedBuffer &) = delete;
+    MappedBuffer &operator=(MappedBuffer &&) = delete;
+
+    ~MappedBuffer()
+    {
+        std::error_code ignored;
+        close(ignored);
+    }
+
+    /*!
+     * Checks whether the buffer is open, i.e., not yet closed, and no error has occurred.
+     */
+    [[nodiscard]] bool is_open() const noexcept
+    {
+        return mmap_.is_mapped() && !error_;
+    }
+
+    [[nodiscard]] char *data() noexcept
+    {
+        return mmap_.data();
+    }
+
+    [[nodiscard]] const char *data() const noexcept
+    {
+        return mmap_.data();
+    }
+
+    [[nodiscard]] char &operator[](size_t a_index) noexcept
+    {
+        return data()[a_index];
+    }
+
+    [[nodiscard]] const char &operator[](size_t a_index) const noexcept
+    {
+        return data()[a_index];
+    }
+
+    [[nodiscard]] char *begin() noexcept
+    {
+        return data();
+    }
+
+    [[nodiscard]] const char *begin() const noexcept
+    {
+        return data();
+    }
+
+    [[nodiscard]] char *end() noexcept
+    {
+        return data() + size_;
+    }
+
+    [[nodiscard]] const char *end() const noexcept
+    {
+        return data() + size_;
+    }
+
+    /*!
+     * Number of bytes in the buffer, the size of the file once closed.
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    /*!
+     * Number of bytes mapped, i.e., the size the buffer can grow to without remapping.
+     */
+    [[nodiscard]] size_t capacity() const noexcept
+    {
+        return mmap_.size();
+    }
+
+    /*!
+     * Sets the number of bytes in the buffer, growing the file if needed. Bytes past the previous
+     * size are zero when the file grows, and unspecified otherwise. If the file cannot be grown or
+     * mapped again, std::system_error will be thrown and the buffer is no longer open.
+     * @param a_size The new size in bytes.
+     */
+    void resize(size_t a_size)
+    {
+        if (error_) throw std::system_error(error_);
+
+        if (a_size > mmap_.size()) {
+            grow(a_size);
+            if (error_) throw std::system_error(error_);
+        }
+
+        size_ = a_size;
+    }
+
+    /*!
+     * Unmaps the file, and truncates it to the bytes in the buffer. Does nothing if the buffer is
+     * already closed.
+     * @param error Set to the first error that occurred while growing or closing, if any.
+     */
+    void close(std::error_code &error)
+    {
+        if (mmap_.is_mapped()) {
+            mmap_.unmap();
+
+            std::error_code truncated;
+            std::filesystem::resize_file(file_, size_, truncated);
+            if (!error_) error_ = truncated;
+        }
+
+        error = error_;
+    }
+
+private:
+    /*!
+     * Extends the file by at least one extent, or half its size once larger, to no less than
+     * a_min_size bytes, and grows the mapping in place, see basic_mmap::grow().
+     */
+    void grow(size_t a_min_size)
+    {
+        const auto capacity = mmap_.size();
+        const auto new_capacity = std::max(capacity + std::max(extent_, capacity / 2), a_min_size);
+
+        if (mmap_.is_mapped()) {
+            mmap_.grow(new_capacity, error_);
+        } else {
+            std::filesystem::resize_file(file_, new_capacity, error_);
+            if (error_) return;
+
+            mmap_.map(file_, 0, new_capacity, error_);
+        }
+
+#if defined(__linux__)
+        // Only running out of space is an error; not all file systems support allocation.
+        if (!error_ && ::posix_fallocate(mmap_.file_handle(), static_cast<off_t>(capacity), static_cast<off_t>(new_capacity - capacity)) == ENOSPC)
+            error_ = std::make_error_code(std::errc::no_space_on_device);
+#endif
+    }
+
+    std::string file_;
+    size_t extent_;
+    size_t size_{0};
+    mmap_sink mmap_;
+    std::error_code error_;
+};
+
+}
+#endif
@@ -0,0 +1,398 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_MEMORY_RESOURCE_HPP
+#define WXLIB_MIO_MEMORY_RESOURCE_HPP
+
+#include <mio/mio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <system_error>
+
+namespace mio {
+
+/**
+   A `std::pmr::memory_resource` giving each large allocation an anonymous mapping of its
+   own, see `basic_mmap::map_anonymous`, e.g. backed by huge pages bound to the NUMA node
+   of the socket processing it. Allocations smaller than the threshold, or aligned beyond
+   the page size, are passed on to the upstream resource.
+
+   Meant for the few big arrays built from parsed files, such as link tables and OD
+   matrices, for which huge pages cut the TLB misses of scattered lookups.
+
+   @code
+     mio::mmap_memory_resource resource(mio::access_hint::hugepage, 0); // NUMA node 0
+     std::pmr::vector<double> od_matrix(zone_count * zone_count, &resource);
+   @endcode
+ */
+class mmap_memory_resource : public std::pmr::memory_resource
+{
+public:
+  /**
+     Default size in bytes from which allocations are mapped, 1 MiB.
+   */
+  static constexpr size_t default_threshold = size_t{1} << 20;
+
+  /**
+     \param   hint  The access hints of the mappings, `hugepage` by default.
+     \param   numa_node  The NUMA node the pages are bound to, or `any_numa_node`.
+     \param   threshold  Size in bytes from which allocations are mapped.
+     \param   upstream  The resource for smaller allocations.
+   */
+  explicit mmap_memory_resource(const access_hint hint = access_hint::hugepage,
+                                const int numa_node = any_numa_node,
+                                const size_t threshold = default_threshold,
+                                std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+      : hint_{hint}, numa_node_{numa_node}, threshold_{threshold}, upstream_{upstream}
+  {
+  }
+
+  mmap_memory_resource(const mmap_memory_resource &) = delete;
+  mmap_memory_resource &operator=(const mmap_memory_resource &) = delete;
+
+  [[nodiscard]] access_hint hint() const noexcept
+  {
+    return hint_;
+  }
+
+  [[nodiscard]] int numa_node() const noexcept
+  {
+    return numa_node_;
+  }
+
+  [[nodiscard]] std::pmr::memory_resource *upstream_resource() const noexcept
+  {
+    return upstream_;
+  }
+
+protected:
+  void *do_allocate(const size_t bytes, const size_t alignment) override
+  {
+    if (!is_mapped(bytes, alignment)) return upstream_->allocate(bytes, alignment);
+
+    std::error_code error;
+    char *p = detail::map_anonymous(bytes, hint_, numa_node_, error);
+    if (error) throw std::bad_alloc();
+    return p;
+  }
+
+  void do_deallocate(void *p, const size_t bytes, const size_t alignment) override
+  {
+    if (!is_mapped(bytes, alignment)) return upstream_->deallocate(p, bytes, alignment);
+    detail::unmap_anonymous(static_cast<char *>(p), detail::anonymous_length(bytes, hint_));
+  }
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  [[nodiscard]] bool is_mapped(const size_t bytes, const size_t alignment) const noexcept
+  {
+    return bytes >= threshold_ && alignment <= page_size();
+  }
+
+  access_hint hint_;
+  int numa_node_;
+  size_t threshold_;
+  std::pmr::memory_resource *upstream_;
+};
+
+/**
+   A `std::pmr::memory_resource` handing out memory by bumping a pointer through blocks taken from
+   the upstream resource, where deallocation does nothing, and all the memory is reclaimed at once
+   by `reset`, in O(1), keeping the blocks for the next batch.
+
+   Meant for the many small objects of a batch of parsed records or messages, e.g. the strings of
+   `CsvDoc::PmrColumns`, of msgpack unpacked into `std::pmr` containers, or of `zpp::bits::in`
+   deserializing them, built in one region and dropped together. The objects must be destroyed, or
+   never used again, before `reset`. Not thread safe; each thread uses its own, e.g. see
+   `thread_arena`.
+
+   @code
+     auto &arena = mio::thread_arena();
+     for (const auto &message: messages) {
+       {
+         std::pmr::vector<std::pmr::string> names{&arena};
+         msgpack::Unpacker unpacker(message.data(), message.size());
+         unpacker(names);
+         // ... do something about the names.
+       }
+       arena.reset();
+     }
+   @endcode
+ */
+class arena_memory_resource : public std::pmr::memory_resource
+{
+public:
+  /**
+     Default size in bytes of the first block, 64 KiB. Each block taken later is twice as large
+     as the one before.
+   */
+  static constexpr size_t default_block_size = size_t{1} << 16;
+
+  /**
+     \param   block_size  Size in bytes of the first block.
+     \param   upstream  The resource of the blocks.
+   */
+  explicit arena_memory_resource(const size_t block_size = default_block_size,
+                                 std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+      : block_size_{std::max(block_size, sizeof(Block) + alignof(std::max_align_t))}, upstream_{upstream}
+  {
+  }
+
+  arena_memory_resource(const arena_memory_resource &) = delete;
+  arena_memory_resource &operator=(const arena_memory_resource &) = delete;
+
+  ~arena_memory_resource() override
+  {
+    release();
+  }
+
+  /**
+     Reclaims all the memory handed out, keeping the blocks to hand it out again.
+   */
+  void reset() noexcept
+  {
+    current_ = first_;
+    cur_ = first_ ? first_->data() : nullptr;
+    end_ = first_ ? first_->end() : nullptr;
+    used_ = 0;
+  }
+
+  /**
+     Reclaims all the memory handed out, and returns the blocks to the upstream resource.
+   */
+  void release() noexcept
+  {
+    while (first_) {
+      auto *next = first_->next;
+      upstream_->deallocate(first_, first_->size, alignof(Block));
+      first_ = next;
+    }
+    current_ = nullptr;
+    cur_ = end_ = nullptr;
+    used_ = capacity_ = 0;
+  }
+
+  /**
+     Number of bytes handed out since the last `reset`, with the padding of alignment.
+   */
+  [[nodiscard]] size_t used() const noexcept
+  {
+    return used_;
+  }
+
+  /**
+     Number of bytes of the blocks held.
+   */
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+  [[nodiscard]] std::pmr::memory_resource *upstream_resource() const noexcept
+  {
+    return upstream_;
+  }
+
+protected:
+  void *do_allocate(const size_t bytes, const size_t alignment) override
+  {
+    if (auto *p = bump(bytes, alignment)) return p;
+
+    // Moves on to the next block kept by reset if large enough, or takes a new one.
+    if (current_ && current_->next && current_->next->end() - current_->next->data() >= static_cast<std::ptrdiff_t>(bytes + alignment)) {
+      use(current_->next);
+    } else {
+      const auto size = std::max(current_ ? 2 * current_->size : block_size_, sizeof(Block) + bytes + alignment);
+      auto *block = new (upstream_->allocate(size, alignof(Block))) Block{current_ ? current_->next : nullptr, size};
+      (current_ ? current_->next : first_) = block;
+      capacity_ += size;
+      use(block);
+    }
+    return bump(bytes, alignment);
+  }
+
+  void do_deallocate(void *, size_t, size_t) override
+  {
+  }
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  struct alignas(std::max_align_t) Block
+  {
+    Block *next;
+    size_t size;
+
+    [[nodiscard]] char *data() noexcept
+    {
+      return reinterpret_cast<char *>(this + 1);
+    }
+
+    [[nodiscard]] char *end() noexcept
+    {
+      return reinterpret_cast<char *>(this) + size;
+    }
+  };
+
+  void *bump(const size_t bytes, const size_t alignment) noexcept
+  {
+    if (!cur_) return nullptr;
+    const auto address = reinterpret_cast<uintptr_t>(cur_);
+    const auto padding = (alignment - address % alignment) % alignment;
+    if (static_cast<size_t>(end_ - cur_) < padding + bytes) return nullptr;
+
+    auto *p = cur_ + padding;
+    cur_ = p + bytes;
+    used_ += padding + bytes;
+    return p;
+  }
+
+  void use(Block *a_block) noexcept
+  {
+    current_ = a_block;
+    cur_ = a_block->data();
+    end_ = a_block->end();
+  }
+
+  size_t block_size_;
+  std::pmr::memory_resource *upstream_;
+  Block *first_{nullptr};
+  Block *current_{nullptr};
+  char *cur_{nullptr};
+  char *end_{nullptr};
+  size_t used_{0};
+  size_t capacity_{0};
+};
+
+/**
+   A `std::pmr::memory_resource` passing every allocation on to the upstream resource, and
+   counting them, e.g. to measure the allocations of the `std::pmr` containers of a module, or
+   of everything on the default resource once set with `std::pmr::set_default_resource`, and
+   check that a hot path allocates nothing. The counts are atomic, so one resource may be
+   shared by several threads.
+
+   @code
+     mio::counting_memory_resource counter;
+     auto columns = Doc::make_pmr_columns(&counter);
+     doc.make_columns(block, columns);
+     auto per_record = double(counter.allocations()) / records;
+   @endcode
+ */
+class counting_memory_resource : public std::pmr::memory_resource
+{
+public:
+  explicit counting_memory_resource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+      : upstream_{upstream}
+  {
+  }
+
+  counting_memory_resource(const counting_memory_resource &) = delete;
+  counting_memory_resource &operator=(const counting_memory_resource &) = delete;
+
+  /**
+     Number of allocations since construction, or the last `reset`.
+   */
+  [[nodiscard]] size_t allocations() const noexcept
+  {
+    return allocations_.load(std::memory_order_relaxed);
+  }
+
+  /**
+     Number of bytes allocated since construction, or the last `reset`, deallocations aside.
+   */
+  [[nodiscard]] size_t allocated_bytes() const noexcept
+  {
+    return allocated_bytes_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t deallocations() const noexcept
+  {
+    return deallocations_.load(std::memory_order_relaxed);
+  }
+
+  /**
+     Number of bytes allocated and not yet deallocated, and the most there were at a time.
+   */
+  [[nodiscard]] size_t live_bytes() const noexcept
+  {
+    return live_bytes_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t peak_bytes() const noexcept
+  {
+    return peak_bytes_.load(std::memory_order_relaxed);
+  }
+
+  void reset() noexcept
+  {
+    allocations_.store(0, std::memory_order_relaxed);
+    allocated_bytes_.store(0, std::memory_order_relaxed);
+    deallocations_.store(0, std::memory_order_relaxed);
+    peak_bytes_.store(live_bytes(), std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] std::pmr::memory_resource *upstream_resource() const noexcept
+  {
+    return upstream_;
+  }
+
+protected:
+  void *do_allocate(const size_t bytes, const size_t alignment) override
+  {
+    auto *p = upstream_->allocate(bytes, alignment);
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+
+    const auto live = live_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    for (auto peak = peak_bytes(); live > peak && !peak_bytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed);) {
+    }
+    return p;
+  }
+
+  void do_deallocate(void *p, const size_t bytes, const size_t alignment) override
+  {
+    upstream_->deallocate(p, bytes, alignment);
+    deallocations_.fetch_add(1, std::memory_order_relaxed);
+    live_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+  {
+    return this == &other;
+  }
+
+private:
+  std::pmr::memory_resource *upstream_;
+  std::atomic<size_t> allocations_{0};
+  std::atomic<size_t> allocated_bytes_{0};
+  std::atomic<size_t> deallocations_{0};
+  std::atomic<size_t> live_bytes_{0};
+  std::atomic<size_t> peak_bytes_{0};
+};
+
+/**
+   The arena of the calling thread, created on first use, and never released before the thread
+   exits.
+ */
+inline arena_memory_resource &thread_arena()
+{
+  thread_local arena_memory_resource arena;
+  return arena;
+}
+
+}
+#endif
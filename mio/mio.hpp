@@ -26,6 +26,11 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/mempolicy.h>)
+#define WXLIB_MIO_HAS_MBIND
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
 #include <algorithm>
@@ -38,16 +43,24 @@
 #include <system_error>
 #include <type_traits>
 
+#include <mio/trace.hpp>
+
 namespace mio {
 
 /**
    This is used by `basic_mmap` to determine whether to create a read-only
    or a read-write memory mapping.
+
+   - `copy_on_write`: a private writable mapping of a file opened read-only
+     (MAP_PRIVATE, FILE_MAP_COPY on Windows). The pages written to are copied
+     for the process, and the file is never modified, e.g. to NUL-terminate or
+     unescape the fields of a csv in place, see `CsvDoc::make_record_in_place`.
  */
 enum class access_mode
 {
   read,
-  write
+  write,
+  copy_on_write
 };
 
 /**
@@ -100,6 +113,58 @@ enum
   map_entire_file = 0
 };
 
+/**
+   Hints about how a mapping is going to be accessed, passed to `basic_mmap::map`
+   or `basic_mmap::advise`. Hints can be combined with `|`.
+
+   - `sequential`: aggressive read-ahead, pages may be dropped soon after they are
+     read (MADV_SEQUENTIAL).
+   - `random`: no read-ahead, for sparse lookups (MADV_RANDOM).
+   - `willneed`: starts reading the whole mapping in the background (MADV_WILLNEED,
+     or PrefetchVirtualMemory on Windows).
+   - `populate`: pre-faults the whole mapping when it is created (MAP_POPULATE on
+     Linux, or PrefetchVirtualMemory on Windows).
+   - `hugepage`: backs the mapping with transparent huge pages where the file system
+     supports it (MADV_HUGEPAGE, Linux only).
+
+   Hints are advisory; those the platform does not support are ignored.
+ */
+enum class access_hint : unsigned
+{
+  normal = 0,
+  sequential = 1 << 0,
+  random = 1 << 1,
+  willneed = 1 << 2,
+  populate = 1 << 3,
+  hugepage = 1 << 4
+};
+
+constexpr access_hint operator|(const access_hint a, const access_hint b) noexcept
+{
+  return static_cast<access_hint>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+/**
+   Returns true if `hints` includes `hint`.
+ */
+constexpr bool has_hint(const access_hint hints, const access_hint hint) noexcept
+{
+  return (static_cast<unsigned>(hints) & static_cast<unsigned>(hint)) != 0;
+}
+
+/**
+   This value can serve as the `numa_node` parameter of `map_anonymous`, indicating the
+   pages are allocated by the default policy of the system, normally on the node of the
+   thread touching them first.
+ */
+constexpr int any_numa_node = -1;
+
+/**
+   Size of the huge pages anonymous mappings are rounded up to with `access_hint::hugepage`,
+   the default huge page size of x86-64 and arm64.
+ */
+constexpr size_t huge_page_size = size_t{2} << 20;
+
 #ifdef _WIN32
 using file_handle_type = HANDLE;
 #else
@@ -313,7 +378,7 @@ requires(std::is_same_v<char_type_t<StrT>, char>)
 file_handle_type open_file_helper(const StrT &path, const access_mode mode)
 {
   return ::CreateFileA(c_str(path),
-                       mode == access_mode::read ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                       mode != access_mode::write ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
                        FILE_SHARE_READ | FILE_SHARE_WRITE,
                        0,
                        OPEN_EXISTING,
@@ -326,7 +391,7 @@ requires(std::is_same_v<char_type_t<StrT>, wchar_t>)
 file_handle_type open_file_helper(const StrT &path, const access_mode mode)
 {
   return ::CreateFileW(c_str(path),
-                       mode == access_mode::read ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                       mode != access_mode::write ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
                        FILE_SHARE_READ | FILE_SHARE_WRITE,
                        0,
                        OPEN_EXISTING,
@@ -366,7 +431,7 @@ file_handle_type open_file(const StrT &path, const access_mode mode, std::error_
 #ifdef _WIN32
   const auto handle = win::open_file_helper(path, mode);
 #else // POSIX
-  const auto handle = ::open(c_str(path), mode == access_mode::read ? O_RDONLY : O_RDWR);
+  const auto handle = ::open(c_str(path), mode != access_mode::write ? O_RDONLY : O_RDWR);
 #endif
 
   if (handle == invalid_handle) {
@@ -397,6 +462,26 @@ inline uint64_t query_file_size(file_handle_type handle, std::error_code &error)
 #endif
 }
 
+/**
+   Sets the size of the file, extending it with zeros, or truncating it.
+ */
+inline void resize_file(file_handle_type handle, const uint64_t size, std::error_code &error) noexcept
+{
+  error.clear();
+
+#ifdef _WIN32
+  FILE_END_OF_FILE_INFO end_of_file;
+  end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+  if (::SetFileInformationByHandle(handle, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)) == 0) {
+    error = detail::last_error();
+  }
+#else // POSIX
+  if (::ftruncate(handle, static_cast<off_t>(size)) == -1) {
+    error = detail::last_error();
+  }
+#endif
+}
+
 struct mmap_context
 {
   char *data;
@@ -411,7 +496,8 @@ inline mmap_context memory_map(const file_handle_type file_handle,
                                const size_t offset,
                                const size_t length,
                                const access_mode mode,
-                               std::error_code &error)
+                               std::error_code &error,
+                               const access_hint hint = access_hint::normal)
 {
   mmap_context result = {
       nullptr,
@@ -436,7 +522,7 @@ inline mmap_context memory_map(const file_handle_type file_handle,
   const file_handle_type file_mapping_handle = ::CreateFileMapping(
       file_handle,
       nullptr,
-      mode == access_mode::read ? PAGE_READONLY : PAGE_READWRITE,
+      mode == access_mode::read ? PAGE_READONLY : mode == access_mode::write ? PAGE_READWRITE : PAGE_WRITECOPY,
       win::int64_high(max_file_size),
       win::int64_low(max_file_size),
       nullptr);
@@ -448,7 +534,7 @@ inline mmap_context memory_map(const file_handle_type file_handle,
 
   LPVOID mapping_start = ::MapViewOfFile(
       file_mapping_handle,
-      mode == access_mode::read ? FILE_MAP_READ : FILE_MAP_WRITE,
+      mode == access_mode::read ? FILE_MAP_READ : mode == access_mode::write ? FILE_MAP_WRITE : FILE_MAP_COPY,
       win::int64_high(static_cast<int64_t>(aligned_offset)),
       win::int64_low(static_cast<int64_t>(aligned_offset)),
       static_cast<ULONG_PTR>(length_to_map));
@@ -461,8 +547,12 @@ inline mmap_context memory_map(const file_handle_type file_handle,
   char *mapping_start = static_cast<char *>(::mmap(
         0, // Don't give hint as to where to map.
         length_to_map,
-        mode == access_mode::read ? PROT_READ : PROT_WRITE,
-        MAP_SHARED,
+        mode == access_mode::read ? PROT_READ : mode == access_mode::write ? PROT_WRITE : PROT_READ | PROT_WRITE,
+#ifdef MAP_POPULATE
+        (mode == access_mode::copy_on_write ? MAP_PRIVATE : MAP_SHARED) | (has_hint(hint, access_hint::populate) ? MAP_POPULATE : 0),
+#else
+        mode == access_mode::copy_on_write ? MAP_PRIVATE : MAP_SHARED,
+#endif
         file_handle,
         aligned_offset));
 
@@ -485,6 +575,203 @@ inline mmap_context memory_map(const file_handle_type file_handle,
   return result;
 }
 
+/**
+   Asks the kernel to read the pages of [data, data + length) in, ahead of access.
+ */
+inline void prefetch(const char *data, const size_t length, std::error_code &error) noexcept
+{
+  error.clear();
+  if (!data || length == 0) return;
+
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+  WIN32_MEMORY_RANGE_ENTRY range{const_cast<char *>(data), length};
+  if (::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0) == 0) {
+    error = detail::last_error();
+  }
+#endif
+#else // POSIX
+  // The address passed to madvise must be page aligned.
+  const auto address = reinterpret_cast<uintptr_t>(data);
+  const auto aligned = make_offset_page_aligned(address);
+  if (::madvise(reinterpret_cast<void *>(aligned), length + (address - aligned), MADV_WILLNEED) != 0) {
+    error = detail::last_error();
+  }
+#endif
+}
+
+/**
+   Applies the access hints, but `populate`, to the mapped region starting at the
+   page aligned `mapping_start`.
+ */
+inline void advise(char *mapping_start, const size_t mapped_length, const access_hint hint, std::error_code &error) noexcept
+{
+  error.clear();
+  if (!mapping_start || mapped_length == 0) return;
+
+#ifdef _WIN32
+  if (has_hint(hint, access_hint::willneed)) prefetch(mapping_start, mapped_length, error);
+#else // POSIX
+  auto apply = [&](const access_hint h, const int advice) {
+    if (!error && has_hint(hint, h) && ::madvise(mapping_start, mapped_length, advice) != 0) {
+      error = detail::last_error();
+    }
+  };
+
+  apply(access_hint::sequential, MADV_SEQUENTIAL);
+  apply(access_hint::random, MADV_RANDOM);
+  apply(access_hint::willneed, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  apply(access_hint::hugepage, MADV_HUGEPAGE);
+#endif
+#endif
+}
+
+/**
+   Returns the length an anonymous mapping of `length` bytes actually maps, rounded up to
+   the page size, or to the huge page size with `access_hint::hugepage`.
+ */
+inline size_t anonymous_length(const size_t length, const access_hint hint) noexcept
+{
+#ifdef _WIN32
+  const size_t large_page = has_hint(hint, access_hint::hugepage) ? ::GetLargePageMinimum() : 0;
+  const size_t granularity = large_page ? large_page : page_size();
+#else
+  const size_t granularity = has_hint(hint, access_hint::hugepage) ? huge_page_size : page_size();
+#endif
+  return (std::max(length, size_t{1}) + granularity - 1) / granularity * granularity;
+}
+
+/**
+   Binds the pages of the mapped region to the NUMA node, before they are first touched.
+ */
+inline void bind_numa_node(char *mapping_start, const size_t mapped_length, const int numa_node, std::error_code &error) noexcept
+{
+  error.clear();
+#ifdef WXLIB_MIO_HAS_MBIND
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {};
+  constexpr auto bits = 8 * sizeof(unsigned long);
+  if (numa_node < 0 || static_cast<size_t>(numa_node) >= bits * std::size(mask)) {
+    error = std::make_error_code(std::errc::invalid_argument);
+    return;
+  }
+
+  mask[numa_node / bits] = 1UL << (numa_node % bits);
+  if (::syscall(__NR_mbind, mapping_start, mapped_length, MPOL_BIND, mask, bits * std::size(mask) + 1, 0) != 0) {
+    error = detail::last_error();
+  }
+#else
+  // Windows binds the pages when allocating them, see map_anonymous.
+  (void) mapping_start, (void) mapped_length, (void) numa_node;
+#if !defined(_WIN32)
+  error = std::make_error_code(std::errc::function_not_supported);
+#endif
+#endif
+}
+
+/**
+   Creates an anonymous, zero filled, read-write mapping of `anonymous_length(length, hint)`
+   bytes, see `basic_mmap::map_anonymous`.
+ */
+inline char *map_anonymous(const size_t length, const access_hint hint, const int numa_node, std::error_code &error) noexcept
+{
+  error.clear();
+  const size_t mapped_length = anonymous_length(length, hint);
+
+#ifdef _WIN32
+  const DWORD type = MEM_RESERVE | MEM_COMMIT;
+  auto allocate = [&](DWORD a_type) {
+    return numa_node == any_numa_node
+             ? ::VirtualAlloc(nullptr, mapped_length, a_type, PAGE_READWRITE)
+             : ::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, mapped_length, a_type, PAGE_READWRITE, static_cast<DWORD>(numa_node));
+  };
+
+  // Large pages need SeLockMemoryPrivilege; fall back to normal pages without it.
+  void *mapping_start = nullptr;
+  if (has_hint(hint, access_hint::hugepage) && ::GetLargePageMinimum() != 0) mapping_start = allocate(type | MEM_LARGE_PAGES);
+  if (!mapping_start) mapping_start = allocate(type);
+
+  if (!mapping_start) {
+    error = detail::last_error();
+    return nullptr;
+  }
+
+  // Committed pages are only allocated when touched; page_size() is the allocation granularity.
+  if (has_hint(hint, access_hint::populate))
+    for (size_t i = 0; i < mapped_length; i += 4096) static_cast<volatile char *>(mapping_start)[i] = 0;
+  return static_cast<char *>(mapping_start);
+#else // POSIX
+  const bool bind = numa_node != any_numa_node;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+  // Pages must be bound to the node before they are touched.
+  if (has_hint(hint, access_hint::populate) && !bind) flags |= MAP_POPULATE;
+#endif
+
+  char *mapping_start = nullptr;
+#ifdef MAP_HUGETLB
+  // Huge pages reserved by the system, if any.
+  if (has_hint(hint, access_hint::hugepage)) {
+    void *p = ::mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) mapping_start = static_cast<char *>(p);
+  }
+#endif
+
+  if (!mapping_start) {
+    // Otherwise transparent huge pages, which need a huge page aligned region.
+    const size_t slack = has_hint(hint, access_hint::hugepage) ? huge_page_size : 0;
+    void *p = ::mmap(nullptr, mapped_length + slack, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED) {
+      error = detail::last_error();
+      return nullptr;
+    }
+
+    mapping_start = static_cast<char *>(p);
+    if (slack) {
+      const auto address = reinterpret_cast<uintptr_t>(p);
+      const auto aligned = (address + huge_page_size - 1) / huge_page_size * huge_page_size;
+      if (aligned != address) ::munmap(p, aligned - address);
+      if (aligned != address + slack) ::munmap(reinterpret_cast<char *>(aligned + mapped_length), address + slack - aligned);
+      mapping_start = reinterpret_cast<char *>(aligned);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (slack) ::madvise(mapping_start, mapped_length, MADV_HUGEPAGE);
+#endif
+  }
+
+  if (bind) {
+    bind_numa_node(mapping_start, mapped_length, numa_node, error);
+    if (error) {
+      ::munmap(mapping_start, mapped_length);
+      return nullptr;
+    }
+
+    // Touches every page, now that they are bound.
+    if (has_hint(hint, access_hint::populate))
+      for (size_t i = 0; i < mapped_length; i += page_size()) static_cast<volatile char *>(mapping_start)[i] = 0;
+  }
+
+  std::error_code ignored;
+  advise(mapping_start, mapped_length, hint, ignored);
+  return mapping_start;
+#endif
+}
+
+/**
+   Releases an anonymous mapping created by `map_anonymous`.
+ */
+inline void unmap_anonymous(char *mapping_start, const size_t mapped_length) noexcept
+{
+  if (!mapping_start) return;
+#ifdef _WIN32
+  (void) mapped_length;
+  ::VirtualFree(mapping_start, 0, MEM_RELEASE);
+#else
+  ::munmap(mapping_start, mapped_length);
+#endif
+}
+
 } // namespace detail
 
 #pragma region - template<access_mode AccessMode, typename ByteT> basic_map
@@ -519,6 +806,8 @@ private:
   size_type length_ = 0;
   // Length in bytes of full mapping.
   size_type mapped_length_ = 0;
+  // Offset in the file of the first requested byte.
+  size_type offset_ = 0;
   // Letting user map a file using both an existing file handle and a path
   // introduces some complexity (see `is_handle_internal_`).
   // On POSIX, we only need a file handle to create a mapping, while on
@@ -535,6 +824,10 @@ private:
   // provided path. For this reason, this flag is used to determine when to
   // close `file_handle_`.
   bool is_handle_internal_{};
+  // Anonymous mappings are backed by no file, see `map_anonymous`.
+  bool is_anonymous_{};
+  // Whether the destructor syncs a write mapping, see `set_sync_on_destroy`.
+  bool sync_on_destroy_{true};
 
 public:
 
@@ -597,14 +890,18 @@ public:
       data_{std::move(other.data_)},
       length_{std::move(other.length_)},
       mapped_length_{std::move(other.mapped_length_)},
+      offset_{std::move(other.offset_)},
       file_handle_{std::move(other.file_handle_)}
 #ifdef _WIN32
       , file_mapping_handle_{std::move(other.file_mapping_handle_)}
 #endif
       , is_handle_internal_{std::move(other.is_handle_internal_)}
+      , is_anonymous_{std::move(other.is_anonymous_)}
+      , sync_on_destroy_{other.sync_on_destroy_}
   {
+    other.is_anonymous_ = false;
     other.data_ = nullptr;
-    other.length_ = other.mapped_length_ = 0;
+    other.length_ = other.mapped_length_ = other.offset_ = 0;
     other.file_handle_ = invalid_handle;
 #ifdef _WIN32
     other.file_mapping_handle_ = invalid_handle;
@@ -626,25 +923,30 @@ public:
       data_ = std::move(other.data_);
       length_ = std::move(other.length_);
       mapped_length_ = std::move(other.mapped_length_);
+      offset_ = std::move(other.offset_);
       file_handle_ = std::move(other.file_handle_);
 #ifdef _WIN32
       file_mapping_handle_ = std::move(other.file_mapping_handle_);
 #endif
       is_handle_internal_ = std::move(other.is_handle_internal_);
+      is_anonymous_ = std::move(other.is_anonymous_);
+      sync_on_destroy_ = other.sync_on_destroy_;
       other.data_ = nullptr;
-      other.length_ = other.mapped_length_ = 0;
+      other.length_ = other.mapped_length_ = other.offset_ = 0;
       other.file_handle_ = invalid_handle;
 #ifdef _WIN32
       other.file_mapping_handle_ = invalid_handle;
 #endif
       other.is_handle_internal_ = false;
+      other.is_anonymous_ = false;
     }
     return *this;
   }
 
   /**
-     If this is a read-write mapping, the destructor invokes sync. Regardless
-     of the access mode, unmap is invoked as a final step.
+     If this is a read-write mapping, the destructor invokes sync, unless
+     disabled by `set_sync_on_destroy`. Regardless of the access mode, unmap is
+     invoked as a final step.
    */
   ~basic_mmap()
   {
@@ -704,12 +1006,13 @@ public:
 
   /**
      Returns true if a mapping was established. On UNIX, it is the same as
-     is_open().
+     is_open(), except for anonymous mappings, which have no file.
 
      \returns True if mapped, false if not.
    */
   [[nodiscard]] bool is_mapped() const noexcept
   {
+    if (is_anonymous_) return true;
 #ifdef _WIN32
     return file_mapping_handle_ != invalid_handle;
 #else // POSIX
@@ -717,6 +1020,14 @@ public:
 #endif
   }
 
+  /**
+     Returns true if this is an anonymous mapping, see `map_anonymous`.
+   */
+  [[nodiscard]] bool is_anonymous() const noexcept
+  {
+    return is_anonymous_;
+  }
+
   /**
      `size` and `length` both return the logical length, i.e. the number of
      bytes user requested to be mapped, while `mapped_length` returns the
@@ -748,12 +1059,20 @@ public:
     return mapped_length_ - length_;
   }
 
+  /**
+     Returns the offset in the file of the first requested byte, 0 for an anonymous mapping.
+   */
+  [[nodiscard]] size_type file_offset() const noexcept
+  {
+    return offset_;
+  }
+
   /**
      Returns a pointer to the first requested byte, or `nullptr` if no
      memory mapping exists.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   pointer data() noexcept
   {
     return data_;
@@ -769,7 +1088,7 @@ public:
      mapping exists, otherwise this function call is undefined behavior.
     */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   iterator begin() noexcept
   {
     return data();
@@ -790,7 +1109,7 @@ public:
      mapping exists, otherwise this function call is undefined behavior.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   iterator end() noexcept
   {
     return data() + length();
@@ -811,7 +1130,7 @@ public:
      memory mapping exists, otherwise this function call is undefined behavior.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   reverse_iterator rbegin() noexcept
   {
     return reverse_iterator(end());
@@ -832,7 +1151,7 @@ public:
      mapping exists, otherwise this function call is undefined behavior.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   reverse_iterator rend() noexcept
   {
     return reverse_iterator(begin());
@@ -886,6 +1205,17 @@ public:
    */
   template<typename StrT>
   void map(const StrT &path, const size_type offset, const size_type length, std::error_code &error)
+  {
+    map(path, offset, length, access_hint::normal, error);
+  }
+
+  /**
+     The same as `map(path, offset, length, error)`, and applies the access hints to
+     the new mapping, see `access_hint`. A hint that cannot be applied does not fail
+     the mapping.
+   */
+  template<typename StrT>
+  void map(const StrT &path, const size_type offset, const size_type length, const access_hint hint, std::error_code &error)
   {
     error.clear();
 
@@ -897,7 +1227,7 @@ public:
     const auto handle = detail::open_file(path, AccessMode, error);
     if (error) return;
 
-    map(handle, offset, length, error);
+    map(handle, offset, length, hint, error);
 
     // MUST sets this to true.
     if (!error) is_handle_internal_ = true;
@@ -917,6 +1247,16 @@ public:
    */
   void map(const handle_type handle, const size_type offset, const size_type length, std::error_code &error)
   {
+    map(handle, offset, length, access_hint::normal, error);
+  }
+
+  /**
+     Establish memory mapping using file handle, and applies the access hints to the
+     new mapping, see `access_hint`.
+   */
+  void map(const handle_type handle, const size_type offset, const size_type length, const access_hint hint, std::error_code &error)
+  {
+    WXLIB_TRACE_SPAN("mio.map");
     error.clear();
 
     if (handle == invalid_handle) {
@@ -940,7 +1280,8 @@ public:
         offset,
         static_cast<size_type>(requested_size - offset),
         AccessMode,
-        error);
+        error,
+        hint);
 
     if (!error) {
       // unmap previous mapping that may have existed. This guarantees that,
@@ -957,9 +1298,17 @@ public:
 
       length_ = static_cast<size_type>(ctx.length);
       mapped_length_ = static_cast<size_type>(ctx.mapped_length);
+      offset_ = offset;
 #ifdef _WIN32
       file_mapping_handle_ = ctx.file_mapping_handle;
 #endif
+
+      // Hints are advisory, failing to apply one does not fail the mapping.
+      std::error_code ignored;
+      advise(hint, ignored);
+#ifdef _WIN32
+      if (has_hint(hint, access_hint::populate)) prefetch(0, length_, ignored);
+#endif
     }
   }
 
@@ -971,6 +1320,147 @@ public:
     map(handle, 0, map_entire_file, error);
   }
 
+  /**
+     Establishes an anonymous mapping, backed by no file, of at least `length` zero
+     filled bytes, e.g. to hold large arrays built at runtime. The length is rounded
+     up to the page size, and `size()` tells the length actually mapped.
+
+     - `access_hint::hugepage` backs the mapping with huge pages: pages reserved by
+       the system (MAP_HUGETLB) if any, else transparent huge pages on a huge page
+       aligned region (MADV_HUGEPAGE), on Linux; large pages (MEM_LARGE_PAGES, which
+       needs SeLockMemoryPrivilege) if possible, on Windows. The length is then rounded
+       up to the huge page size.
+     - `access_hint::populate` touches all pages ahead of access.
+     - `numa_node` other than `any_numa_node` binds the pages to that NUMA node (mbind
+       on Linux, VirtualAllocExNuma on Windows), so that arrays processed by the
+       threads of a socket stay local to it.
+
+     Errors are reported via `error`; failing to get huge pages is not an error.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void map_anonymous(const size_type length, const access_hint hint, const int numa_node, std::error_code &error)
+  {
+    char *mapping_start = detail::map_anonymous(length, hint, numa_node, error);
+    if (error) return;
+
+    unmap();
+    data_ = reinterpret_cast<pointer>(mapping_start);
+    length_ = mapped_length_ = detail::anonymous_length(length, hint);
+    is_anonymous_ = true;
+  }
+
+  /**
+     Same as `map_anonymous(length, hint, any_numa_node, error)`.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void map_anonymous(const size_type length, const access_hint hint, std::error_code &error)
+  {
+    map_anonymous(length, hint, any_numa_node, error);
+  }
+
+  /**
+     Same as `map_anonymous(length, access_hint::normal, any_numa_node, error)`.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void map_anonymous(const size_type length, std::error_code &error)
+  {
+    map_anonymous(length, access_hint::normal, any_numa_node, error);
+  }
+
+  /**
+     Grows the mapping to `length` bytes from the first requested byte, extending
+     the file if it is shorter, without unmapping it first, e.g. to append to an
+     output file. On Linux, the pages already mapped are moved, not copied, by
+     mremap(MREMAP_MAYMOVE), which may still move `data()`; other POSIX systems map
+     the file again before unmapping the old region. On Windows, the section is
+     created again with the new size, which also extends the file. Anonymous
+     mappings can be grown on Linux only. Does nothing if `length` is not larger
+     than `size()`. On Windows, if the new section cannot be mapped, the object
+     is left unmapped.
+
+     The growth is exact. Callers appending a little at a time should grow
+     geometrically, e.g. as `mio::MappedBuffer` does, so that the cost of
+     remapping is amortized. Otherwise, on failure, the reason is reported via
+     `error`, and the mapping is unchanged, though the file may have been
+     extended.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void grow(const size_type length, std::error_code &error)
+  {
+    error.clear();
+
+    if (!is_mapped()) {
+      error = std::make_error_code(std::errc::bad_file_descriptor);
+      return;
+    }
+
+    if (length <= length_) return;
+
+    if (length > std::numeric_limits<size_t>::max() - 1 - mapping_offset()) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return;
+    }
+
+    const size_type new_mapped_length = mapping_offset() + length;
+
+    if (!is_anonymous_) {
+      const uint64_t file_size = detail::query_file_size(file_handle_, error);
+      if (error) return;
+
+      if (file_size < offset_ + length) {
+        detail::resize_file(file_handle_, offset_ + length, error);
+        if (error) return;
+      }
+    }
+
+#if defined(__linux__)
+    void *mapping_start = ::mremap(get_mapping_start(), mapped_length_, new_mapped_length, MREMAP_MAYMOVE);
+    if (mapping_start == MAP_FAILED) {
+      error = detail::last_error();
+      return;
+    }
+
+    data_ = static_cast<pointer>(mapping_start) + mapping_offset();
+    length_ = length;
+    mapped_length_ = new_mapped_length;
+#else
+    if (is_anonymous_) {
+      error = std::make_error_code(std::errc::operation_not_supported);
+      return;
+    }
+
+#ifdef _WIN32
+    // A view cannot change size, the section is replaced by a larger one.
+    ::UnmapViewOfFile(get_mapping_start());
+    ::CloseHandle(file_mapping_handle_);
+    file_mapping_handle_ = invalid_handle;
+#endif
+
+    const auto ctx = detail::memory_map(file_handle_, offset_, length, AccessMode, error);
+    if (error) {
+#ifdef _WIN32
+      // The old view is gone, the object is left unmapped.
+      data_ = nullptr;
+      unmap();
+#endif
+      return;
+    }
+
+#ifndef _WIN32
+    ::munmap(get_mapping_start(), mapped_length_);
+#else
+    file_mapping_handle_ = ctx.file_mapping_handle;
+#endif
+    data_ = static_cast<pointer>(ctx.data);
+    length_ = static_cast<size_type>(ctx.length);
+    mapped_length_ = static_cast<size_type>(ctx.mapped_length);
+#endif
+  }
+
   /**
      If a valid memory mapping has been created prior to this call, this call
      instructs the kernel to unmap the memory region and disassociate this
@@ -983,6 +1473,14 @@ public:
    */
   void unmap() noexcept
   {
+    if (is_anonymous_) {
+      detail::unmap_anonymous(reinterpret_cast<char *>(data_), mapped_length_);
+      data_ = nullptr;
+      length_ = mapped_length_ = 0;
+      is_anonymous_ = false;
+      return;
+    }
+
     if (!is_open()) return;
 
     // TODO do we care about errors here?
@@ -1011,13 +1509,38 @@ public:
 
     // Reset fields to their default values.
     data_ = nullptr;
-    length_ = mapped_length_ = 0;
+    length_ = mapped_length_ = offset_ = 0;
     file_handle_ = invalid_handle;
 #ifdef _WIN32
     file_mapping_handle_ = invalid_handle;
 #endif
   }
 
+  /**
+     Applies the access hints to the whole mapping, see `access_hint`, e.g. switching
+     to `access_hint::random` once a sequential scan is done. `populate` only takes
+     effect when the mapping is created, see `map`. Errors are reported via `error`.
+   */
+  void advise(const access_hint hint, std::error_code &error) noexcept
+  {
+    detail::advise(const_cast<char *>(reinterpret_cast<const char *>(get_mapping_start())), mapped_length_, hint, error);
+  }
+
+  /**
+     Asks the kernel to read in the `length` bytes at `offset` from the first
+     requested byte, ahead of access, e.g. before random lookups in a region known
+     to be needed soon. Errors are reported via `error`.
+   */
+  void prefetch(const size_type offset, const size_type length, std::error_code &error) noexcept
+  {
+    if (offset >= length_) {
+      error.clear();
+      return;
+    }
+
+    detail::prefetch(reinterpret_cast<const char *>(data_) + offset, std::min(length, length_ - offset), error);
+  }
+
   [[maybe_unused]] void swap(basic_mmap &other)
   {
     if (this != &other) {
@@ -1028,7 +1551,10 @@ public:
 #endif
       std::swap(length_, other.length_);
       std::swap(mapped_length_, other.mapped_length_);
+      std::swap(offset_, other.offset_);
       std::swap(is_handle_internal_, other.is_handle_internal_);
+      std::swap(is_anonymous_, other.is_anonymous_);
+      std::swap(sync_on_destroy_, other.sync_on_destroy_);
     }
   }
 
@@ -1039,8 +1565,12 @@ public:
   requires (A == access_mode::write)
   void sync(std::error_code &error)
   {
+    WXLIB_TRACE_SPAN("mio.sync");
     error.clear();
 
+    // Nothing to flush without a file.
+    if (is_anonymous_) return;
+
     if (!is_open()) {
       error = std::make_error_code(std::errc::bad_file_descriptor);
       return;
@@ -1063,9 +1593,63 @@ public:
 #endif
   }
 
-private:
+  /**
+     Flushes the `length` bytes at `offset` from the first requested byte to
+     disk, e.g. a region of an output file that is complete, instead of the
+     whole mapping; the range is widened to page boundaries. With `async`, the
+     writes are only started (MS_ASYNC, or FlushViewOfFile without
+     FlushFileBuffers on Windows), and the call does not wait for them. Errors
+     are reported via `error`.
+   */
   template<access_mode A = AccessMode>
   requires (A == access_mode::write)
+  void sync_range(const size_type offset, const size_type length, const bool async, std::error_code &error)
+  {
+    WXLIB_TRACE_SPAN("mio.sync_range");
+    error.clear();
+
+    // Nothing to flush without a file.
+    if (is_anonymous_) return;
+
+    if (!is_open()) {
+      error = std::make_error_code(std::errc::bad_file_descriptor);
+      return;
+    }
+
+    if (!data() || offset >= length_ || length == 0) return;
+
+    const size_type first = make_offset_page_aligned(mapping_offset() + offset);
+    const size_type last = mapping_offset() + offset + std::min(length, length_ - offset);
+    const auto start = get_mapping_start() + first;
+
+#ifdef _WIN32
+    if (::FlushViewOfFile(start, last - first) == 0 || (!async && ::FlushFileBuffers(file_handle_) == 0)) {
+#else // POSIX
+    if (::msync(start, last - first, async ? MS_ASYNC : MS_SYNC) != 0) {
+#endif
+      error = detail::last_error();
+    }
+  }
+
+  /**
+     Sets whether the destructor syncs a write mapping, see `sync`. Closing a
+     large output then does not block until all of it is on disk, e.g. when it
+     was already flushed by `sync_range`, or need not be: the pages of a file
+     mapping are written back by the system after it is unmapped anyway.
+   */
+  void set_sync_on_destroy(const bool enabled) noexcept
+  {
+    sync_on_destroy_ = enabled;
+  }
+
+  [[nodiscard]] bool sync_on_destroy() const noexcept
+  {
+    return sync_on_destroy_;
+  }
+
+private:
+  template<access_mode A = AccessMode>
+  requires (A != access_mode::read)
   pointer get_mapping_start() noexcept
   {
     // Compare the address of the first byte and size of the two mapped region
@@ -1087,13 +1671,15 @@ private:
   requires (A == access_mode::write)
   void conditional_sync()
   {
+    if (!sync_on_destroy_) return;
+
     // Invoked from destructor, so not much we can do about failures here.
     std::error_code ec;
     sync(ec);
   }
 
   template<access_mode A = AccessMode>
-  requires (A == access_mode::read)
+  requires (A != access_mode::write)
   void conditional_sync()
   {
     // no-op.
@@ -1155,6 +1741,13 @@ using basic_mmap_source = basic_mmap<access_mode::read, ByteT>;
 template<typename ByteT>
 using basic_mmap_sink = basic_mmap<access_mode::write, ByteT>;
 
+/**
+   This is the basis for all private copy-on-write mmap objects, writable
+   without modifying the file, see `access_mode::copy_on_write`.
+ */
+template<typename ByteT>
+using basic_mmap_private = basic_mmap<access_mode::copy_on_write, ByteT>;
+
 /**
    These aliases cover the most common use cases, both representing a raw
    byte stream (either with a char or an unsigned char/uint8_t).
@@ -1164,6 +1757,9 @@ using ummap_source [[maybe_unused]] = basic_mmap_source<unsigned char>;
 
 using mmap_sink = basic_mmap_sink<char>;
 using ummap_sink [[maybe_unused]] = basic_mmap_sink<unsigned char>;
+
+using mmap_private = basic_mmap_private<char>;
+using ummap_private [[maybe_unused]] = basic_mmap_private<unsigned char>;
 #pragma endregion
 
 #pragma region - factory methods for basic_mmap
@@ -1224,6 +1820,28 @@ template<typename MappingToken>
 {
   return make_mmap_sink(token, 0, map_entire_file, error);
 }
+
+/**
+   Convenience factory method.
+
+   MappingToken may be a string (`std::string`, `std::string_view`, `const
+   char*`, `std::filesystem::path`, `std::vector&lt;char&gt;`, or similar),
+   or a `mmap_private::handle_type`, opened for reading at least.
+ */
+template<typename MappingToken>
+mmap_private make_mmap_private(const MappingToken &token,
+                               mmap_private::size_type offset,
+                               mmap_private::size_type length,
+                               std::error_code &error)
+{
+  return make_mmap<mmap_private>(token, offset, length, error);
+}
+
+template<typename MappingToken>
+[[maybe_unused]] mmap_private make_mmap_private(const MappingToken &token, std::error_code &error)
+{
+  return make_mmap_private(token, 0, map_entire_file, error);
+}
 #pragma endregion
 
 #pragma region - basic_shared_mmap
@@ -1349,6 +1967,12 @@ public:
     return pimpl_ && pimpl_->is_open();
   }
 
+  /** See `basic_mmap::is_mapped`. */
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return pimpl_ && pimpl_->is_mapped();
+  }
+
   /**
      Returns true if no mapping was established, that is, conceptually the
      same as though the length that was mapped was 0. This function is
@@ -1380,12 +2004,24 @@ public:
     return pimpl_ ? pimpl_->mapped_length() : 0;
   }
 
+  /** See `basic_mmap::file_offset`. */
+  [[nodiscard]] size_type file_offset() const noexcept
+  {
+    return pimpl_ ? pimpl_->file_offset() : 0;
+  }
+
+  /** See `basic_mmap::is_anonymous`. */
+  [[nodiscard]] bool is_anonymous() const noexcept
+  {
+    return pimpl_ && pimpl_->is_anonymous();
+  }
+
   /**
      Returns a pointer to the first requested byte, or `nullptr` if no
      memory mapping exists.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   pointer data() noexcept
   {
     return pimpl_->data();
@@ -1420,7 +2056,7 @@ public:
      mapping exists, otherwise this function call is undefined behavior.
    */
   template<access_mode A = AccessMode>
-  requires (A == access_mode::write)
+  requires (A != access_mode::read)
   iterator end() noexcept
   {
     return pimpl_->end();
@@ -1524,6 +2160,50 @@ public:
     if (pimpl_) pimpl_->sync(error);
   }
 
+  /** See `basic_mmap::map_anonymous`. */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void map_anonymous(const size_type length, const access_hint hint, const int numa_node, std::error_code &error)
+  {
+    if (!pimpl_) pimpl_ = std::make_shared<mmap_type>();
+    pimpl_->map_anonymous(length, hint, numa_node, error);
+  }
+
+  /** See `basic_mmap::sync_range`. */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void sync_range(const size_type offset, const size_type length, const bool async, std::error_code &error)
+  {
+    if (pimpl_) pimpl_->sync_range(offset, length, async, error);
+  }
+
+  /** See `basic_mmap::set_sync_on_destroy`. */
+  void set_sync_on_destroy(const bool enabled) noexcept
+  {
+    if (pimpl_) pimpl_->set_sync_on_destroy(enabled);
+  }
+
+  /** See `basic_mmap::grow`. */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void grow(const size_type length, std::error_code &error)
+  {
+    if (pimpl_) pimpl_->grow(length, error);
+    else error = std::make_error_code(std::errc::bad_file_descriptor);
+  }
+
+  /** See `basic_mmap::advise`. */
+  void advise(const access_hint hint, std::error_code &error) noexcept
+  {
+    if (pimpl_) pimpl_->advise(hint, error);
+  }
+
+  /** See `basic_mmap::prefetch`. */
+  void prefetch(const size_type offset, const size_type length, std::error_code &error) noexcept
+  {
+    if (pimpl_) pimpl_->prefetch(offset, length, error);
+  }
+
   /** All operators compare the underlying `basic_mmap`'s addresses. */
   friend bool operator==(const basic_shared_mmap &a, const basic_shared_mmap &b)
   {
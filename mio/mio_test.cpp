@@ -7,13 +7,65 @@
 
 #include <doctest/doctest.h>
 
+#include <atomic>
+#include <charconv>
+#include <coroutine>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <set>
+#include <sstream>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 
 #include <mio/mio.hpp>
+#include <mio/memory_resource.hpp>
 #include <mio/stringreader.hpp>
 #include <mio/fastfind.hpp>
+#include "mio/batchreader.hpp"
+#include "mio/csvcache.hpp"
 #include "mio/csvdoc.hpp"
+#include "mio/csvreader.hpp"
+#include "mio/csvwriter.hpp"
+#include "mio/datasetreader.hpp"
+#include "mio/decompressreader.hpp"
+#include "mio/executor.hpp"
+#include "mio/externalsort.hpp"
+#include "mio/fixedwidth.hpp"
+#include "mio/flusher.hpp"
+#include "mio/groupby.hpp"
+#include "mio/hashindex.hpp"
+#include "mio/mappedbuffer.hpp"
+#include "mio/mmaparray.hpp"
+#include "mio/netexport.hpp"
+#include "mio/network.hpp"
+#include "mio/odmatrix.hpp"
+#include "mio/pipeline.hpp"
+#include "mio/probestore.hpp"
+#include "mio/queue.hpp"
+#include "mio/shortestpath.hpp"
+#include "mio/snapshot.hpp"
+#include "mio/spatialindex.hpp"
+#include "mio/streamreader.hpp"
+#include "mio/stringpool.hpp"
+#include "mio/tailreader.hpp"
+#include "mio/trace.hpp"
+#include "mio/windowreader.hpp"
+#include "mio/wkt.hpp"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+#include <meta_enum/meta_enum.hpp>
+#include <zpp_bits/zpp_bits.h>
 
 TEST_CASE("mio")
 {
@@ -153,6 +205,48 @@ TEST_CASE("mio")
     CHECK(!m.is_open());
   }
 
+  SUBCASE("test mapping with access hints") {
+    std::error_code error;
+    for (auto hint : {mio::access_hint::normal, mio::access_hint::sequential, mio::access_hint::random,
+                      mio::access_hint::willneed | mio::access_hint::populate, mio::access_hint::hugepage}) {
+      mio::mmap_source m;
+      m.map(path, 3, mio::map_entire_file, hint, error);
+      REQUIRE(!error);
+      CHECK(m.size() == buffer.size() - 3);
+      CHECK(m[0] == buffer[3]);
+    }
+
+    mio::mmap_source m(path);
+    m.advise(mio::access_hint::sequential | mio::access_hint::willneed, error);
+    CHECK(!error);
+    m.advise(mio::access_hint::random, error);
+    CHECK(!error);
+    m.prefetch(mio::page_size() + 1, 100, error);
+    CHECK(!error);
+    m.prefetch(buffer.size() + 10, 100, error);
+    CHECK(!error);
+
+    CHECK(mio::has_hint(mio::access_hint::random | mio::access_hint::willneed, mio::access_hint::willneed));
+    CHECK_FALSE(mio::has_hint(mio::access_hint::random, mio::access_hint::sequential));
+  }
+
+  SUBCASE("test copy on write mappings never modify the file") {
+    std::error_code error;
+    auto m = mio::make_mmap_private(path, error);
+    REQUIRE(!error);
+    REQUIRE(m.size() == buffer.size());
+    CHECK(m[0] == buffer[0]);
+
+    m[0] = static_cast<char>(~buffer[0]);
+    std::fill(m.begin() + 10, m.begin() + 20, '#');
+    CHECK(m[0] == static_cast<char>(~buffer[0]));
+    CHECK(m.data()[15] == '#');
+    m.unmap();
+
+    mio::mmap_source source(path);
+    CHECK(std::equal(source.begin(), source.end(), buffer.begin()));
+  }
+
   SUBCASE("test shared_mmap works as expected") {
     std::error_code error;
 
@@ -192,100 +286,4394 @@ TEST_CASE("mio")
     CHECK(!error);
 #endif
   }
+
+  SUBCASE("test snapshot manager reloads shared mappings while readers read") {
+    auto write_version = [](const uint64_t a_version) {
+      const auto name = "test-snapshot-" + std::to_string(a_version);
+      std::ofstream out(name, std::ios::binary | std::ios::trunc);
+      out << std::string(4096 + a_version, static_cast<char>('a' + a_version % 26));
+      return name;
+    };
+    auto load = [](const std::string &a_name) { return mio::shared_mmap_source{a_name, 0, mio::map_entire_file}; };
+
+    const auto versions = uint64_t{20};
+    for (uint64_t v = 1; v <= versions; v++) write_version(v);
+
+    mio::SnapshotManager<mio::shared_mmap_source> snapshots{load("test-snapshot-1")};
+    CHECK(snapshots.version() == 1);
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> torn{0};
+    std::atomic<size_t> reads{0};
+    auto readers = std::vector<std::thread>{};
+    for (int r = 0; r < 4; r++) {
+      readers.emplace_back([&] {
+        for (auto last = uint64_t{0}; !done.load() || reads.load() < 1000; reads++) {
+          const auto snapshot = snapshots.read();
+          const auto version = snapshot.version();
+          const auto expected = static_cast<char>('a' + version % 26);
+          torn += version < last || snapshot->size() != 4096 + version || snapshot->data()[0] != expected
+               || snapshot->data()[snapshot->size() - 1] != expected;
+          last = version;
+        }
+      });
+    }
+
+    for (uint64_t v = 2; v < versions; v++) snapshots.reload([&] { return load("test-snapshot-" + std::to_string(v)); });
+    snapshots.reload_async([&] { return load("test-snapshot-" + std::to_string(versions)); }).get();
+    CHECK(snapshots.version() == versions);
+
+    done = true;
+    for (auto &reader : readers) reader.join();
+    CHECK(torn == 0);
+    CHECK(snapshots.reclaim() == 0);
+    CHECK(snapshots.read()->size() == 4096 + versions);
+
+    // A version replaced is kept as long as a reader holds it, and destroyed as the last one leaves.
+    mio::SnapshotManager<std::shared_ptr<int>> counters{std::make_shared<int>(1), 3};
+    auto first = counters.read();
+    const std::weak_ptr<int> watched = *first;
+    auto second = counters.read();
+    counters.publish(std::make_shared<int>(2));
+    CHECK(**counters.read() == 2);
+    CHECK(**first == 1);
+    first.release();
+    CHECK(!watched.expired());
+    CHECK(counters.reclaim() == 1);
+    second = counters.read();
+    CHECK(watched.expired());
+    CHECK(second.version() == 2);
+
+    for (uint64_t v = 1; v <= versions; v++) std::filesystem::remove("test-snapshot-" + std::to_string(v));
+  }
+
+  SUBCASE("test anonymous mappings") {
+    std::error_code error;
+
+    mio::mmap_sink m;
+    m.map_anonymous(10000, error);
+    REQUIRE(!error);
+    CHECK(m.is_mapped());
+    CHECK(m.is_anonymous());
+    CHECK(m.size() >= 10000);
+    CHECK(m.size() % mio::page_size() == 0);
+    CHECK(std::all_of(m.begin(), m.end(), [](char c) { return c == 0; }));
+    std::fill(m.begin(), m.end(), 'x');
+    m.sync(error);
+    CHECK(!error);
+
+    auto moved = std::move(m);
+    CHECK_FALSE(m.is_mapped());
+    CHECK(moved.is_anonymous());
+    CHECK(moved[9999] == 'x');
+    moved.unmap();
+    CHECK_FALSE(moved.is_mapped());
+
+    mio::mmap_sink huge;
+    huge.map_anonymous(3 << 20, mio::access_hint::hugepage | mio::access_hint::populate, error);
+    REQUIRE(!error);
+    CHECK(huge.size() % mio::huge_page_size == 0);
+    CHECK(reinterpret_cast<uintptr_t>(huge.data()) % mio::huge_page_size == 0);
+    huge[huge.size() - 1] = 'x';
+
+#ifdef __linux__
+    // mbind may be denied in containers.
+    mio::mmap_sink local;
+    local.map_anonymous(1 << 20, mio::access_hint::populate, 0, error);
+    CHECK((!error || error == std::errc::operation_not_permitted || error == std::errc::function_not_supported));
+    if (!error) CHECK(local.is_anonymous());
+
+    local.map_anonymous(1 << 20, mio::access_hint::normal, 100000, error);
+    CHECK(error);
+#endif
+  }
+
+  SUBCASE("test write mappings grow in place") {
+    std::error_code error;
+    const auto offset = mio::page_size() + 10;
+
+    mio::mmap_sink sink(path, offset, 100);
+    sink[0] = '<';
+    sink.grow(50, error);
+    CHECK(!error);
+    CHECK(sink.size() == 100);
+
+    const auto grown = buffer.size() + 3 * mio::page_size();
+    sink.grow(grown - offset, error);
+    REQUIRE(!error);
+    CHECK(sink.size() == grown - offset);
+    CHECK(sink.mapping_offset() == 10);
+    CHECK(std::filesystem::file_size(path) == grown);
+    CHECK(sink[0] == '<');
+    CHECK(sink[buffer.size() - offset - 1] == buffer.back());
+    CHECK(sink[sink.size() - 1] == 0);
+    sink[sink.size() - 1] = '>';
+    sink.unmap();
+
+    mio::mmap_source source(path);
+    CHECK(source[offset] == '<');
+    CHECK(source[grown - 1] == '>');
+    CHECK(sink.size() == 0);
+
+    sink.grow(1, error);
+    CHECK(error == std::errc::bad_file_descriptor);
+
+#ifdef __linux__
+    sink.map_anonymous(mio::page_size(), error);
+    REQUIRE(!error);
+    sink.sync_range(0, mio::page_size(), false, error);
+    CHECK(!error);
+    REQUIRE(!error);
+    sink[0] = 'x';
+    sink.grow(4 * mio::page_size(), error);
+    REQUIRE(!error);
+    CHECK(sink[0] == 'x');
+    CHECK(sink[4 * mio::page_size() - 1] == 0);
+#endif
+  }
+
+  SUBCASE("test ranges of write mappings are flushed in the background") {
+    std::error_code error;
+
+    mio::mmap_sink sink(path);
+    sink.set_sync_on_destroy(false);
+    CHECK_FALSE(sink.sync_on_destroy());
+
+    sink.sync_range(10, 100, true, error);
+    CHECK(!error);
+    sink.sync_range(sink.size(), 100, false, error);
+    CHECK(!error);
+
+    {
+      mio::mmap_flusher flusher(sink, mio::page_size());
+      for (size_t end = 0; end < sink.size();) {
+        const auto next = std::min(end + 1000, sink.size());
+        std::fill(sink.begin() + end, sink.begin() + next, 'y');
+        flusher.complete(next);
+        end = next;
+      }
+      CHECK(!flusher.wait());
+      CHECK(flusher.synced() == sink.size());
+
+      {
+        auto paused = flusher.pause();
+        sink.grow(2 * buffer.size(), error);
+        REQUIRE(!error);
+      }
+      sink[sink.size() - 1] = 'z';
+      flusher.complete(sink.size());
+      CHECK(!flusher.wait());
+      CHECK(flusher.synced() == sink.size());
+    }
+
+    sink.unmap();
+    mio::mmap_source source(path);
+    CHECK(source.size() == 2 * buffer.size());
+    CHECK(std::all_of(source.begin(), source.begin() + buffer.size(), [](char c) { return c == 'y'; }));
+    CHECK(source[source.size() - 1] == 'z');
+
+    mio::mmap_sink unmapped;
+    unmapped.sync_range(0, 1, false, error);
+    CHECK(error == std::errc::bad_file_descriptor);
+  }
+
+  SUBCASE("test mmap_memory_resource maps large allocations") {
+    mio::mmap_memory_resource resource(mio::access_hint::hugepage);
+
+    std::pmr::vector<double> large(size_t{1} << 18, 1.0, &resource);
+    std::pmr::vector<double> small(100, 2.0, &resource);
+    CHECK(reinterpret_cast<uintptr_t>(large.data()) % mio::huge_page_size == 0);
+    large.resize(size_t{1} << 19, 3.0);
+    CHECK(std::accumulate(large.begin(), large.end(), 0.0) == (1 << 18) * 1.0 + (1 << 18) * 3.0);
+    CHECK(std::accumulate(small.begin(), small.end(), 0.0) == 200.0);
+    CHECK(resource.is_equal(resource));
+
+    mio::mmap_memory_resource other;
+    CHECK_FALSE(resource.is_equal(other));
+  }
+
+  SUBCASE("test arena_memory_resource reuses its blocks after reset") {
+    mio::arena_memory_resource arena(1024);
+    CHECK(arena.capacity() == 0);
+
+    std::vector<void *> first;
+    for (int i = 0; i < 100; i++) {
+      auto *p = arena.allocate(24, 8);
+      CHECK(reinterpret_cast<uintptr_t>(p) % 8 == 0);
+      first.push_back(p);
+    }
+    auto *aligned = arena.allocate(100, 64);
+    CHECK(reinterpret_cast<uintptr_t>(aligned) % 64 == 0);
+    auto *large = arena.allocate(10000, 16);
+    std::memset(large, 1, 10000);
+    CHECK(arena.used() >= 100 * 24 + 100 + 10000);
+
+    const auto capacity = arena.capacity();
+    arena.reset();
+    CHECK(arena.used() == 0);
+    CHECK(arena.capacity() == capacity);
+    CHECK(arena.allocate(24, 8) == first[0]);
+    for (int i = 0; i < 100; i++) CHECK(arena.allocate(24, 8) != nullptr);
+    CHECK(arena.allocate(10000, 16) != nullptr);
+    CHECK(arena.capacity() == capacity);
+
+    arena.release();
+    CHECK(arena.capacity() == 0);
+    CHECK(arena.is_equal(arena));
+    CHECK_FALSE(arena.is_equal(mio::thread_arena()));
+  }
+
+  SUBCASE("test counting_memory_resource counts the allocations it passes on") {
+    mio::counting_memory_resource counter;
+    {
+      std::pmr::vector<std::pmr::string> names{&counter};
+      names.reserve(4);
+      names.emplace_back(std::string(100, 'a'));
+      names.emplace_back("short");
+      CHECK(counter.allocations() == 2);
+      CHECK(counter.live_bytes() >= 4 * sizeof(std::pmr::string) + 100);
+    }
+    CHECK(counter.deallocations() == 2);
+    CHECK(counter.live_bytes() == 0);
+    CHECK(counter.peak_bytes() == counter.allocated_bytes());
+
+    mio::arena_memory_resource arena(1024, &counter);
+    for (int i = 0; i < 10; i++) static_cast<void>(arena.allocate(24, 8));
+    CHECK(counter.allocations() == 3);
+
+    counter.reset();
+    CHECK(counter.allocations() == 0);
+    CHECK(counter.peak_bytes() == counter.live_bytes());
+    CHECK(counter.is_equal(counter));
+    CHECK_FALSE(counter.is_equal(arena));
+  }
+
+  SUBCASE("test a batch of zpp_bits messages is deserialized into the arena") {
+    std::vector<std::byte> buffer;
+    zpp::bits::out out{buffer};
+    REQUIRE(zpp::bits::success(out(std::vector<std::string>{std::string(100, 'a'), std::string(200, 'b')})));
+
+    auto &arena = mio::thread_arena();
+    arena.reset();
+    {
+      std::pmr::vector<std::pmr::string> names{&arena};
+      auto *previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+      zpp::bits::in in{buffer};
+      const auto result = in(names);
+      std::pmr::set_default_resource(previous);
+
+      REQUIRE(zpp::bits::success(result));
+      REQUIRE(names.size() == 2);
+      CHECK(std::string_view{names[1]} == std::string(200, 'b'));
+      CHECK(names[1].get_allocator().resource() == &arena);
+      CHECK(arena.used() >= 300);
+    }
+    arena.reset();
+    CHECK(arena.used() == 0);
+  }
 }
 
-// #define TEST_STATIC_ASSERT
-TEST_CASE("csvdoc")
+TEST_CASE("stringreader")
 {
-  using namespace mio::csv;
+  // Lines of varying length, every line terminated by `\n`.
+  const auto line_count = size_t{5000};
+  std::string buffer;
+  for (size_t i = 0; i < line_count; ++i)
+    buffer.append(std::string(i % 97, 'x')).append(std::to_string(i)).push_back('\n');
 
-  SUBCASE("test QuotedCsvField can be specialized") {
-    CHECK(QuotedCsvField<NAME("node_id")>::Quoted::value == true);
+  auto path = "test-lines";
+  std::ofstream file(path);
+  file << buffer;
+  file.close();
+
+  SUBCASE("test seek_lower_bound finds the first line of a key range") {
+    auto key_of = [](const std::string_view a_line) {
+      const auto digits = a_line.substr(a_line.find_first_not_of('x'));
+      auto key = size_t{0};
+      std::from_chars(digits.data(), digits.data() + digits.size(), key);
+      return key;
+    };
+
+    mio::StringReader<> reader(path);
+    REQUIRE(reader.is_mapped());
+
+    for (const auto key: {size_t{0}, size_t{1}, size_t{97}, size_t{2500}, size_t{4998}, size_t{4999}}) {
+      const auto offset = reader.seek_lower_bound(key_of, key);
+      CHECK(buffer.substr(offset).starts_with(std::string(key % 97, 'x') + std::to_string(key) + '\n'));
+      CHECK(key_of(reader.getline()) == key);
+      if (key + 1 < line_count) CHECK(key_of(reader.getline()) == key + 1);
+    }
+
+    CHECK(reader.seek_lower_bound(key_of, line_count) == buffer.size());
+    CHECK(reader.eof());
+
+    // Ends a time range query, reading only the lines of [1000, 1010).
+    reader.seek_lower_bound(key_of, size_t{1000});
+    auto n = reader.getline([&](const std::string_view a_line) { return key_of(a_line) < 1010 ? 0 : 1; });
+    CHECK(n == 10);
   }
 
-  SUBCASE("test PlainCsvField can be specialized") {
-    CHECK(PlainCsvField<NAME("node_id")>::Quoted::value == false);
+  SUBCASE("test sample_lines draws the lines uniformly, with and without an index") {
+    auto key_of = [](const std::string_view a_line) {
+      const auto digits = a_line.substr(a_line.find_first_not_of('x'));
+      auto key = size_t{0};
+      std::from_chars(digits.data(), digits.data() + digits.size(), key);
+      return key;
+    };
+
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    auto check_uniform = [&](const std::vector<std::string_view> &a_samples) {
+      // Longer lines must not be more likely, as a plain byte offset sampling would make them.
+      auto short_count = size_t{0};
+      for (const auto line: a_samples) {
+        const auto key = key_of(line);
+        REQUIRE(key < line_count);
+        CHECK(line == std::string(key % 97, 'x') + std::to_string(key));
+        short_count += key % 97 < 49;
+      }
+      CHECK(std::abs(static_cast<double>(short_count) / a_samples.size() - 49.0 / 97) < 0.02);
+    };
+
+    std::mt19937_64 gen{42};
+    auto samples = reader.sample_lines(20000, gen);
+    CHECK(samples.size() == 20000);
+    check_uniform(samples);
+
+    reader.index_lines();
+    samples = reader.sample_lines(20000, gen);
+    CHECK(samples.size() == 20000);
+    check_uniform(samples);
+
+    CHECK(reader.sample_lines(0, gen).empty());
   }
 
-#ifdef TEST_STATIC_ASSERT
-    SUBCASE("Csv field names cannot be duplicated") {
-      CsvDocReader<
-          Field<NAME("Field1")>,
-          Field<NAME("Field1")>,
-          Field<NAME("Field3")>,
-          Field<NAME("Field4")>
-      > doc;
+  SUBCASE("test async_getline reads all lines with equal partitions") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    std::atomic<size_t> bytes{0};
+    auto n = reader.async_getline<4>([&bytes](int, const std::string_view a_line) {
+      bytes += a_line.size() + 1;
+      return 0;
+    });
+
+    CHECK(n == line_count);
+    CHECK(bytes == buffer.size());
+  }
+
+  SUBCASE("test readers can be constructed with access hints") {
+    mio::StringReaderAsync reader(path, mio::access_hint::sequential);
+    REQUIRE(reader.is_mapped());
+
+    auto n = reader.async_getline([](int, const std::string_view) { return 0; }, 4);
+    CHECK(n == line_count);
+
+    std::error_code error;
+    reader.advise(mio::access_hint::random, error);
+    CHECK(!error);
+    reader.prefetch(0, buffer.size(), error);
+    CHECK(!error);
+    CHECK(reader.index_lines().line(1234) == std::string(1234 % 97, 'x') + "1234");
+  }
+
+  SUBCASE("test readers read ahead of the scanning position") {
+    for (auto distance : {size_t{1}, size_t{100000}, buffer.size() * 2}) {
+      mio::StringReaderAsync reader(path, mio::access_hint::sequential);
+      reader.set_read_ahead(distance);
+      for (auto num_threads : {size_t{1}, size_t{3}})
+        CHECK(reader.async_getline([](int, const std::string_view) { return 0; }, num_threads) == line_count);
+      CHECK(reader.async_getline([](int, std::span<const std::string_view>) { return 0; }, size_t{3}, size_t{5000}) == line_count);
+
+      mio::StringReader sync(path);
+      sync.set_read_ahead(distance);
+      sync.seek_lower_bound([](const std::string_view) { return 0; }, 0);
+      size_t bytes = 0;
+      sync.getline([&bytes](const std::string_view a_line) { return bytes += a_line.size() + 1, 0; });
+      CHECK(bytes == buffer.size() + 1);
     }
-#endif
 
-  SUBCASE("test CsvField has static field name") {
-    auto field_name = Field<NAME("node_id")>::field_name;
-    CHECK(std::strcmp(field_name, "node_id") == 0);
+    // Reading from memory, there is nothing to read in.
+    mio::StringReaderAsync memory(std::span<const char>{buffer});
+    memory.set_read_ahead(size_t{1} << 20);
+    CHECK(memory.async_getline([](int, const std::string_view) { return 0; }, 2) == line_count);
   }
 
-  SUBCASE("test VerifyHeader returns success for valid column header") {
-    CsvDoc<
-        Field<NAME("Field1")>,
-        Field<NAME("Field2")>,
-        Field<NAME("Field3")>,
-        Field<NAME("Field4")>
-    > csv_doc;
+  SUBCASE("test readers read from memory and shared mappings") {
+    mio::StringReaderAsync memory(std::span<const char>{buffer});
+    REQUIRE(memory.is_mapped());
+    CHECK(memory.content().data() == buffer.data());
 
-    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field2,Field3,Field4"});
-    CHECK(success);
+    std::atomic<size_t> bytes{0};
+    auto n = memory.async_getline([&bytes](int, const std::string_view a_line) {
+      bytes += a_line.size() + 1;
+      return 0;
+    }, 4);
+    CHECK(n == line_count);
+    CHECK(bytes == buffer.size());
+
+    std::error_code error;
+    memory.advise(mio::access_hint::random, error);
+    CHECK(!error);
+    CHECK(memory.index_lines("unused.lidx", error).line(4321) == std::string(4321 % 97, 'x') + "4321");
+    CHECK(error == std::errc::not_supported);
+    CHECK_FALSE(std::filesystem::exists("unused.lidx"));
+
+    mio::StringReader sync(std::span<const char>{buffer});
+    size_t lines = 0;
+    while (!sync.eof()) {
+      auto line = sync.getline();
+      if (lines == 42) CHECK(line == std::string(42, 'x') + "42");
+      if (!line.empty()) ++lines;
+    }
+    CHECK(lines == line_count);
+
+    mio::shared_mmap_source source(path);
+    {
+      mio::StringReaderAsync shared(source);
+      REQUIRE(shared.is_mapped());
+      CHECK(shared.content().data() == source.data());
+      CHECK(shared.async_getline([](int, const std::string_view) { return 0; }, 2) == line_count);
+      shared.prefetch(0, 100, error);
+      CHECK(!error);
+    }
+    CHECK(source.is_mapped());
+
+    mio::StringReader empty(std::span<const char>{});
+    CHECK(empty.eof());
   }
 
-  SUBCASE("test VerifyHeader returns error for invalid column names") {
-    CsvDoc<
-        Field<NAME("Field1")>,
-        Field<NAME("Field2")>,
-        Field<NAME("Field3")>,
-        Field<NAME("Field4")>
-    > csv_doc;
+  SUBCASE("test async_getline reads all lines with chunked work queue") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
 
-    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field3,Field3,Field4"});
-    CHECK(!success);
-    CHECK(msg == "Invalid column names, code 0100");
+    for (auto chunk_size : {size_t{1}, size_t{100}, size_t{4096}, buffer.size() * 2}) {
+      std::atomic<size_t> bytes{0};
+      auto n = reader.async_getline<4>([&bytes](int, const std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      }, chunk_size);
+
+      CHECK(n == line_count);
+      CHECK(bytes == buffer.size());
+    }
   }
 
-  SUBCASE("test VerifyHeader returns error for invalid column counts") {
-    CsvDoc<
-        Field<NAME("Field1")>,
-        Field<NAME("Field2")>,
-        Field<NAME("Field3")>,
-        Field<NAME("Field4")>
-    > csv_doc;
+  SUBCASE("test async_getline reads all lines with runtime thread counts") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+    CHECK(mio::available_concurrency() >= 1);
 
-    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field2"});
-    CHECK(!success);
+    for (auto num_threads : {size_t{0}, size_t{1}, size_t{3}, size_t{16}, mio::available_concurrency()}) {
+      std::atomic<size_t> bytes{0};
+      auto on_getline = [&bytes](int, const std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      };
+
+      CHECK(reader.async_getline(on_getline, num_threads) == line_count);
+      CHECK(reader.async_getline(on_getline, num_threads, 1000) == line_count);
+      CHECK(bytes == 2 * buffer.size());
+    }
+
+    CHECK(reader.async_getline<12>([](int, const std::string_view) { return 0; }) == line_count);
   }
 
-  SUBCASE("test CsvDoc returns correct number of fields") {
-    CsvDoc<
-        Field<NAME("Field1")>,
-        Field<NAME("Field2")>,
-        Field<NAME("Field3")>,
-        Field<NAME("Field4")>
-    > csv_doc;
+  SUBCASE("test numbered async_getline gives each line its number in the file") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
 
-    CHECK(csv_doc.field_count == 4);
+    // Line i ends with the digits of i.
+    auto number_of = [](const std::string_view a_line) {
+      const auto digits = a_line.substr(a_line.find_first_not_of('x'));
+      auto number = size_t{0};
+      std::from_chars(digits.data(), digits.data() + digits.size(), number);
+      return number;
+    };
+
+    auto check_numbers = [&](const auto &a_read) {
+      auto seen = std::vector<std::atomic<size_t>>(line_count);
+      std::atomic<size_t> wrong{0};
+      auto on_line = [&](int, const size_t a_number, const std::string_view a_line) {
+        wrong += a_number >= line_count || number_of(a_line) != a_number;
+        if (a_number < line_count) seen[a_number]++;
+        return 0;
+      };
+      auto on_batch = [&](int a_id, const size_t a_first, std::span<const std::string_view> a_lines) {
+        for (size_t i = 0; i < a_lines.size(); i++) on_line(a_id, a_first + i, a_lines[i]);
+        return 0;
+      };
+
+      CHECK(a_read(on_line) == line_count);
+      CHECK(a_read(on_batch) == line_count);
+      CHECK(wrong == 0);
+      CHECK(std::all_of(seen.begin(), seen.end(), [](const auto &a_seen) { return a_seen == 2; }));
+    };
+
+    for (auto num_threads : {size_t{1}, size_t{3}, size_t{16}}) {
+      check_numbers([&](const auto &a_callback) { return reader.async_getline(a_callback, num_threads); });
+      check_numbers([&](const auto &a_callback) { return reader.async_getline(a_callback, num_threads, 1000); });
+    }
+    check_numbers([&](const auto &a_callback) { return reader.async_getline<4>(a_callback); });
+
+    // With a line index, the numbers are looked up.
+    reader.index_lines();
+    check_numbers([&](const auto &a_callback) { return reader.async_getline(a_callback, size_t{5}); });
+    check_numbers([&](const auto &a_callback) { return reader.async_getline(a_callback, size_t{5}, 1000); });
+    check_numbers([&](const auto &a_callback) { return reader.async_getline_range(a_callback, 0, line_count, 3); });
   }
 
-  SUBCASE("test make_record can convert csv line to fields") {
-    using namespace std::literals;
+  SUBCASE("test async_getline_ordered hands the batches to the sink in file order") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
 
-    CsvDoc<
-        Field<NAME("Field1")>,
-        Field<NAME("Field2")>,
-        QuotedField<NAME("Field3")>,
-        Field<NAME("Field4")>
-    > csv_doc;
+    for (auto [num_threads, chunk_size, in_flight] : {std::tuple{size_t{1}, size_t{100}, size_t{0}}, std::tuple{size_t{4}, size_t{1000}, size_t{2}},
+                                                      std::tuple{size_t{8}, size_t{64}, size_t{3}}, std::tuple{size_t{3}, size_t{1} << 20, size_t{0}}}) {
+      std::string output;
+      std::atomic<size_t> started{0};
+      std::atomic<size_t> batches{0};
+      std::atomic<size_t> overflows{0};
+      const auto bound = in_flight == 0 ? 2 * num_threads : in_flight;
 
-    auto line = "1,2,\"hello,world\",6"sv;
+      auto n = reader.async_getline_ordered<std::string>(
+          [&](int, const std::string_view a_line, std::string &a_batch) {
+            // A chunk starts with an empty batch, once a slot is free.
+            if (a_batch.empty()) overflows += ++started - batches > bound;
+            a_batch.append(a_line).push_back('\n');
+            return 0;
+          },
+          [&](std::string &a_batch) {
+            output += a_batch;
+            batches++;
+            return 0;
+          },
+          num_threads, chunk_size, in_flight);
 
-    auto rec = csv_doc.make_record(line);
-    CHECK(get<0>(rec).data.compare("1"sv) == 0);
-    CHECK(get<2>(rec).data.compare("\"hello,world\""sv) == 0);
+      CHECK(n == line_count);
+      CHECK(output == buffer);
+      CHECK(overflows == 0);
+    }
+
+    // A failing sink stops the read, after the batches before it.
+    std::vector<std::string> sunk;
+    auto n = reader.async_getline_ordered<std::vector<std::string>>(
+        [](int, const std::string_view a_line, std::vector<std::string> &a_batch) {
+          a_batch.emplace_back(a_line);
+          return 0;
+        },
+        [&sunk](std::vector<std::string> &a_batch) {
+          if (sunk.size() > 100) return 7;
+          sunk.insert(sunk.end(), a_batch.begin(), a_batch.end());
+          return 0;
+        },
+        4, 1000);
+
+    CHECK(reader.status() == 7);
+    CHECK(n == sunk.size());
+    REQUIRE(sunk.size() < line_count);
+    for (size_t i = 0; i < sunk.size(); i++) CHECK(sunk[i] == std::string(i % 97, 'x') + std::to_string(i));
+  }
+
+  SUBCASE("test async_getline_reduce merges per worker accumulators in order") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    struct Totals
+    {
+      size_t lines{0};
+      size_t bytes{0};
+      std::vector<std::string_view> lines_seen{};
+    };
+    const auto per_line = [](Totals &a_totals, const std::string_view a_line) {
+      a_totals.lines++;
+      a_totals.bytes += a_line.size() + 1;
+      a_totals.lines_seen.push_back(a_line);
+    };
+    const auto merge = [](Totals &a_into, Totals &&a_from) {
+      a_into.lines += a_from.lines;
+      a_into.bytes += a_from.bytes;
+      a_into.lines_seen.insert(a_into.lines_seen.end(), a_from.lines_seen.begin(), a_from.lines_seen.end());
+    };
+
+    // The partitions are merged in file order; the chunks of the work queue in worker order.
+    for (auto num_threads : {size_t{0}, size_t{1}, size_t{3}, size_t{16}}) {
+      const auto totals = reader.async_getline_reduce(Totals{}, per_line, merge, num_threads);
+      CHECK(totals.lines == line_count);
+      CHECK(totals.bytes == buffer.size());
+      REQUIRE(totals.lines_seen.size() == line_count);
+      CHECK(std::ranges::is_sorted(totals.lines_seen, {}, [](const std::string_view a_line) { return a_line.data(); }));
+
+      const auto chunked = reader.async_getline_reduce(Totals{}, per_line, merge, num_threads, 1000);
+      CHECK(chunked.lines == line_count);
+      CHECK(chunked.bytes == buffer.size());
+    }
+
+    // A non-zero status stops the workers.
+    const auto stopped = reader.async_getline_reduce(size_t{0}, [](size_t &a_count, const std::string_view) { return ++a_count == 10 ? 3 : 0; },
+                                                     [](size_t &a_into, size_t &&a_from) { a_into += a_from; }, 1);
+    CHECK(stopped == 10);
+    CHECK(reader.status() == 3);
+
+    // No line, no accumulator made.
+    mio::StringReaderAsync empty(std::span<const char>{});
+    CHECK(empty.async_getline_reduce(size_t{42}, [](size_t &a_count, const std::string_view) { a_count++; },
+                                     [](size_t &a_into, size_t &&a_from) { a_into += a_from; }, 4) == 42);
+  }
+
+  SUBCASE("test async_getline hands batches of lines to batch callbacks") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> max_batch{0};
+    auto on_batch = [&](int, std::span<const std::string_view> a_lines) {
+      for (auto a_line : a_lines) bytes += a_line.size() + 1;
+      for (auto m = max_batch.load(); m < a_lines.size() && !max_batch.compare_exchange_weak(m, a_lines.size());) {}
+      return 0;
+    };
+
+    CHECK(reader.async_getline<3>(on_batch) == line_count);
+    CHECK(reader.async_getline<3>(on_batch, 4096) == line_count);
+    mio::StringReaderAsync::AsyncGetlineBatchCallback std_on_batch = on_batch;
+    CHECK(reader.async_getline(std_on_batch, 5) == line_count);
+    CHECK(bytes == 3 * buffer.size());
+    CHECK(max_batch <= mio::StringReaderAsync::batch_size);
+  }
+
+  SUBCASE("test getline hands batches of lines to batch callbacks") {
+    size_t lines = 0, bytes = 0;
+    {
+      mio::StringReader reader(path);
+      lines = reader.getline([&bytes](const std::string_view a_line) { return bytes += a_line.size() + 1, 0; });
+    }
+
+    size_t batch_lines = 0, batch_bytes = 0;
+    {
+      mio::StringReader reader(path);
+      batch_lines = reader.getline([&](std::span<const std::string_view> a_lines) {
+        for (auto a_line : a_lines) batch_bytes += a_line.size() + 1;
+        return a_lines.size() <= mio::StringReader<>::batch_size ? 0 : 1;
+      });
+    }
+
+    CHECK(lines == batch_lines);
+    CHECK(bytes == batch_bytes);
+  }
+
+  SUBCASE("test line index gives random access to every line") {
+    mio::StringReader reader(path);
+    CHECK(!reader.is_indexed());
+    reader.index_lines();
+    REQUIRE(reader.is_indexed());
+    REQUIRE(reader.line_count() == line_count);
+
+    for (auto i : {size_t{0}, size_t{1}, size_t{96}, size_t{97}, line_count - 1})
+      CHECK(reader.line(i) == std::string(i % 97, 'x') + std::to_string(i));
+
+    // The index does not move the sequential reading position.
+    CHECK(reader.getline() == "0");
+  }
+
+  SUBCASE("test line index iterates line ranges in parallel") {
+    mio::StringReaderAsync reader(path);
+    reader.index_lines();
+
+    std::atomic<size_t> bytes{0};
+    auto on_getline = [&bytes](int, const std::string_view a_line) { return bytes += a_line.size() + 1, 0; };
+    CHECK(reader.async_getline_range(on_getline, 0, line_count, 7) == line_count);
+    CHECK(bytes == buffer.size());
+
+    CHECK(reader.async_getline_range(on_getline, 10, 20, 4) == 10);
+    CHECK(reader.async_getline_range(on_getline, 10, line_count * 2, 4) == line_count - 10);
+    CHECK(reader.async_getline_range(on_getline, line_count, line_count, 4) == 0);
+
+    auto on_batch = [](int, std::span<const std::string_view> a_lines) { return a_lines.empty() ? 1 : 0; };
+    CHECK(reader.async_getline_range(on_batch, 0, line_count, 3) == line_count);
+  }
+
+  SUBCASE("test line index counts the last line without trailing newline") {
+    const char text[] = "a\n\nbc";
+    mio::LineIndex index(text, text + 5);
+    REQUIRE(index.line_count() == 3);
+    CHECK(index.line(0) == "a");
+    CHECK(index.line(1).empty());
+    CHECK(index.line(2) == "bc");
+
+    mio::LineIndex terminated(text, text + 3);
+    CHECK(terminated.line_count() == 2);
+    CHECK(mio::LineIndex{}.empty());
+  }
+
+#ifdef __linux__
+  SUBCASE("test mapped ranges and indexed lines are exported to sockets and pipes") {
+    const mio::shared_mmap_source map(path, 0, mio::map_entire_file);
+    const mio::LineIndex index(map.data(), map.data() + map.size());
+    REQUIRE(index.line_count() == line_count);
+
+    // Reads what is exported on another thread, since it does not fit the pipe or socket buffers.
+    auto exported = [](const int a_in, auto &&a_export) {
+      auto received = std::async(std::launch::async, [a_in] {
+        std::string text;
+        char chunk[4096];
+        for (ssize_t n; (n = ::read(a_in, chunk, sizeof(chunk))) > 0;) text.append(chunk, static_cast<size_t>(n));
+        return text;
+      });
+      const auto result = a_export();
+      return std::pair{result, received.get()};
+    };
+
+    int sockets[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    std::error_code error;
+    const auto [sent, by_socket] = exported(sockets[1], [&] {
+      const auto result = mio::export_lines(map, index, sockets[0], 100, 200, error);
+      ::close(sockets[0]);
+      return result;
+    });
+    CHECK(!error);
+    CHECK(sent.method == mio::ExportMethod::Sendfile);
+    const auto [begin, end] = index.byte_range(100, 200);
+    CHECK(sent.bytes == end - begin);
+    CHECK(by_socket == buffer.substr(begin, end - begin));
+    CHECK(by_socket.starts_with(std::string(100 % 97, 'x') + "100\n"));
+    ::close(sockets[1]);
+
+    int pipes[2];
+    REQUIRE(::pipe(pipes) == 0);
+    const auto [spliced, by_pipe] = exported(pipes[0], [&] {
+      const auto result = mio::export_range(map, pipes[1], 0, map.size() * 2, error);
+      ::close(pipes[1]);
+      return result;
+    });
+    CHECK(!error);
+    CHECK(spliced.method == mio::ExportMethod::Splice);
+    CHECK(spliced.bytes == buffer.size());
+    CHECK(by_pipe == buffer);
+    ::close(pipes[0]);
+
+    // Anonymous mappings have no file, and are moved to pipes, or written to sockets.
+    mio::mmap_sink anonymous;
+    anonymous.map_anonymous(3 * mio::page_size(), error);
+    REQUIRE(!error);
+    for (size_t i = 0; i < anonymous.size(); i++) anonymous[i] = static_cast<char>('a' + i % 26);
+    const auto ranges = std::array{mio::ByteRange{10, 20}, mio::ByteRange{mio::page_size() - 5, 10}, mio::ByteRange{anonymous.size() - 3, 100}};
+    const auto expected = std::string(anonymous.data() + 10, 20) + std::string(anonymous.data() + mio::page_size() - 5, 10)
+        + std::string(anonymous.data() + anonymous.size() - 3, 3);
+
+    REQUIRE(::pipe(pipes) == 0);
+    const auto [moved, by_vmsplice] = exported(pipes[0], [&] {
+      const auto result = mio::export_ranges(anonymous, pipes[1], ranges, error);
+      ::close(pipes[1]);
+      return result;
+    });
+    CHECK(moved.method == mio::ExportMethod::Vmsplice);
+    CHECK(by_vmsplice == expected);
+    ::close(pipes[0]);
+
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    const auto [written, by_writev] = exported(sockets[1], [&] {
+      const auto result = mio::export_ranges(anonymous, sockets[0], ranges, error);
+      ::close(sockets[0]);
+      return result;
+    });
+    CHECK(!error);
+    CHECK(written.method == mio::ExportMethod::Writev);
+    CHECK(written.bytes == expected.size());
+    CHECK(by_writev == expected);
+    ::close(sockets[1]);
+  }
+#endif
+
+  SUBCASE("test elias-fano line index matches the offsets") {
+    // Blocks of the minimum size, built in parallel, with empty lines and no trailing `\n`.
+    std::mt19937 rng(42);
+    std::string text;
+    while (text.size() < 3 * mio::LineIndex::min_block_size + 12345) {
+      text.append(std::string(rng() % 200, 'x'));
+      text.push_back('\n');
+      if (rng() % 50 == 0) text.push_back('\n');
+    }
+    text.append("last");
+
+    const mio::LineIndex offsets(text.data(), text.data() + text.size());
+    const mio::LineIndex ef(text.data(), text.data() + text.size(), mio::LineIndex::Encoding::EliasFano, 4);
+    REQUIRE(ef.line_count() == offsets.line_count());
+    CHECK(ef.encoding() == mio::LineIndex::Encoding::EliasFano);
+    CHECK(ef.size_bytes() * 3 < offsets.size_bytes());
+
+    for (size_t i = 0; i < offsets.line_count(); i++)
+      if (ef.line(i) != offsets.line(i)) REQUIRE(ef.line(i) == offsets.line(i));
+    CHECK(ef.line(ef.line_count() - 1) == "last");
+
+    const char small[] = "a\n\nbc";
+    const mio::LineIndex tiny(small, small + 5, mio::LineIndex::Encoding::EliasFano);
+    REQUIRE(tiny.line_count() == 3);
+    CHECK(tiny.line(0) == "a");
+    CHECK(tiny.line(1).empty());
+    CHECK(tiny.line(2) == "bc");
+    CHECK(mio::LineIndex(small, small, mio::LineIndex::Encoding::EliasFano).empty());
+
+    mio::StringReaderAsync reader(path);
+    reader.index_lines(mio::LineIndex::Encoding::EliasFano);
+    REQUIRE(reader.line_count() == line_count);
+    std::atomic<size_t> bytes{0};
+    CHECK(reader.async_getline_range([&bytes](int, const std::string_view a_line) { return bytes += a_line.size() + 1, 0; }, 0, line_count, 4) == line_count);
+    CHECK(bytes == buffer.size());
+  }
+
+  SUBCASE("test elias-fano line index persists to a sidecar file") {
+    const auto sidecar = mio::StringReader<>::default_sidecar(path);
+    std::filesystem::remove(sidecar);
+    std::error_code error;
+
+    {
+      mio::StringReader reader(path);
+      reader.index_lines(sidecar, error, mio::LineIndex::Encoding::EliasFano);
+      CHECK(!error);
+    }
+
+    {
+      mio::StringReader reader(path);
+      reader.index_lines(sidecar, error, mio::LineIndex::Encoding::EliasFano);
+      CHECK(!error);
+      CHECK(reader.line_index().is_mapped());
+      REQUIRE(reader.line_count() == line_count);
+      CHECK(reader.line(0) == "0");
+      CHECK(reader.line(line_count - 1) == std::string((line_count - 1) % 97, 'x') + std::to_string(line_count - 1));
+    }
+
+    // A sidecar of another encoding is rewritten.
+    {
+      mio::StringReader reader(path);
+      reader.index_lines(sidecar, error);
+      CHECK(!error);
+      CHECK(!reader.line_index().is_mapped());
+      CHECK(reader.line_index().encoding() == mio::LineIndex::Encoding::Offsets);
+      CHECK(reader.line(1) == "x1");
+    }
+
+    std::filesystem::remove(sidecar);
   }
 
+  SUBCASE("test line index persists to a sidecar file") {
+    const auto sidecar = mio::StringReader<>::default_sidecar(path);
+    std::filesystem::remove(sidecar);
+    std::error_code error;
+
+    {
+      mio::StringReader reader(path);
+      reader.index_lines(sidecar, error);
+      CHECK(!error);
+      CHECK(!reader.line_index().is_mapped());
+      CHECK(std::filesystem::exists(sidecar));
+    }
+
+    {
+      mio::StringReaderAsync reader(path);
+      reader.index_lines(sidecar, error);
+      CHECK(!error);
+      CHECK(reader.line_index().is_mapped());
+      REQUIRE(reader.line_count() == line_count);
+      CHECK(reader.line(line_count - 1) == std::string((line_count - 1) % 97, 'x') + std::to_string(line_count - 1));
+    }
+
+    // A sidecar stamped for a different file content is rejected, and rebuilt.
+    {
+      std::ofstream other(path, std::ios::app);
+      other << "extra\n";
+    }
+
+    {
+      mio::StringReader reader(path);
+      reader.index_lines(sidecar, error);
+      CHECK(!error);
+      CHECK(!reader.line_index().is_mapped());
+      CHECK(reader.line_count() == line_count + 1);
+      CHECK(reader.line(line_count) == "extra");
+    }
+
+    std::filesystem::remove(sidecar);
+  }
+
+  SUBCASE("test line index rejects corrupt sidecars whose stamp still matches") {
+    const auto sidecar = std::string{"test-corrupt.lidx"};
+    const mio::mmap_source map(path);
+    const auto *first = map.data();
+    const auto *last = map.data() + map.size();
+
+    // Overwrites a word of the sidecar, then maybe truncates it.
+    auto corrupt = [&](const mio::LineIndex::Encoding a_encoding, const size_t a_word, const uint64_t a_value, const size_t a_size = 0) {
+      std::error_code error;
+      mio::LineIndex{first, last, a_encoding}.save(sidecar, path, error);
+      REQUIRE(!error);
+      {
+        std::fstream out(sidecar, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(static_cast<std::streamoff>(a_word * sizeof(uint64_t)));
+        out.write(reinterpret_cast<const char *>(&a_value), sizeof(a_value));
+      }
+      if (a_size != 0) std::filesystem::resize_file(sidecar, a_size);
+
+      mio::LineIndex index;
+      index.load(sidecar, path, first, last, error, a_encoding);
+      CHECK(error == std::errc::invalid_argument);
+      CHECK(index.empty());
+    };
+
+    // A line count whose size in bytes wraps around, with the header alone.
+    corrupt(mio::LineIndex::Encoding::Offsets, 3, uint64_t{1} << 62, 40);
+    // Line ends past the file, or going backwards.
+    corrupt(mio::LineIndex::Encoding::Offsets, 5, 0xFFFFFFF0FFFFFFF0);
+    corrupt(mio::LineIndex::Encoding::Offsets, 6, 0);
+    // Elias-Fano words whose high bits do not match the count.
+    corrupt(mio::LineIndex::Encoding::EliasFano, 10, 0);
+
+    // High bits with more set bits than integers, which would index past the one sample.
+    std::vector<uint64_t> words{1, 0, 0, 5, 1, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, 0};
+    mio::EliasFano ef;
+    CHECK(!ef.attach(words));
+    CHECK(ef.size() == 0);
+
+    std::filesystem::remove(sidecar);
+  }
+
+  SUBCASE("test fast_find_each finds every occurrence") {
+    std::string text(1000, 'a');
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < text.size(); i += (i % 7) + 1) text[i] = '\n', expected.push_back(i);
+
+    std::vector<size_t> found;
+    mio::fast_find_each<'\n'>(text.data(), text.data() + text.size(), [&](const char *a_pos) {
+      found.push_back(a_pos - text.data());
+    });
+    CHECK(found == expected);
+  }
+
+  SUBCASE("test dispatched kernels agree with scalar search") {
+    std::mt19937 rng(42);
+    std::string text(4099, 'a');
+    for (auto &c : text)
+      if (rng() % 37 == 0) c = '\n';
+
+    // Every sub-range, so that each kernel goes through both its vector and tail loops.
+    for (size_t b = 0; b < 130; b++) {
+      for (size_t e = b; e <= text.size(); e += 1 + (e % 61)) {
+        const char *first = text.data() + b;
+        const char *last = text.data() + e;
+
+        CHECK(mio::fast_find<'\n'>(first, last) == std::find(first, last, '\n'));
+        CHECK(mio::find_end<'\n'>(first, e - b) == mio::scalar_find_end<'\n'>(first, e - b));
+
+        size_t n = 0;
+        mio::fast_find_each<'\n'>(first, last, [&](const char *) { n++; });
+        CHECK(n == static_cast<size_t>(std::count(first, last, '\n')));
+        CHECK(mio::fast_count<'\n'>(first, last) == n);
+      }
+    }
+
+    CHECK(mio::simd_level() == mio::detect_simd_level());
+  }
+
+  SUBCASE("test fast_find_any finds the first char of a set") {
+    std::mt19937 rng(7);
+    std::string text(2053, 'a');
+    const char set[] = {',', '"', '\n', '\r'};
+    for (auto &c : text)
+      if (rng() % 29 == 0) c = set[rng() % 4];
+
+    for (size_t b = 0; b < 130; b++) {
+      for (size_t e = b; e <= text.size(); e += 1 + (e % 61)) {
+        const char *first = text.data() + b;
+        const char *last = text.data() + e;
+        const char *expected = std::find_first_of(first, last, std::begin(set), std::end(set));
+
+        auto [pos, match] = mio::fast_find_any<',', '"', '\n', '\r'>(first, last);
+        CHECK(pos == expected);
+        CHECK(match == (expected == last ? 0 : *expected));
+      }
+    }
+  }
+
+  SUBCASE("test multi_find finds the first of many patterns with both engines") {
+    std::mt19937 rng(11);
+    std::string text(3001, 'a');
+    for (auto &c : text) c = "abcdV0123\n"[rng() % 10];
+
+    const auto naive = [&](const std::vector<std::string_view> &a_patterns, const char *a_first, const char *a_last) {
+      for (const char *p = a_first; p != a_last; ++p)
+        for (const auto pattern : a_patterns)
+          if (!pattern.empty() && std::string_view{p, static_cast<size_t>(a_last - p)}.starts_with(pattern)) return p;
+      return a_last;
+    };
+
+    auto many = std::vector<std::string>{};
+    for (size_t i = 0; i < 100; i++) many.push_back("V" + std::to_string(i * 37 % 1000));
+    const auto sets = std::vector<std::vector<std::string_view>>{
+        {"ab"}, {"V01", "a", "dd", ""}, {"cab", "cabd", "bcab"}, {"V0123", "V01", "1", "d0"}, {many.begin(), many.end()}};
+
+    for (const auto &patterns : sets) {
+      for (const auto engine : {mio::MultiFind::Engine::Teddy, mio::MultiFind::Engine::AhoCorasick}) {
+        const mio::MultiFind finder(patterns, engine);
+        CHECK(finder.engine() == engine);
+        for (size_t b = 0; b < 70; b += 3) {
+          for (size_t e = b; e <= text.size(); e += 1 + (e % 97)) {
+            const char *first = text.data() + b;
+            const char *last = text.data() + e;
+            const auto [pos, pattern] = finder.find(first, last);
+            CHECK(pos == naive(patterns, first, last));
+            if (pos != last) CHECK(std::string_view{pos, static_cast<size_t>(last - pos)}.starts_with(patterns[pattern]));
+            else CHECK(pattern == mio::MultiFind::npos);
+          }
+        }
+      }
+    }
+
+    const mio::MultiFind ids{"V17", "V42", "E_DOOR"};
+    CHECK(ids.engine() == (mio::simd_level() == mio::SimdLevel::None ? mio::MultiFind::Engine::AhoCorasick : mio::MultiFind::Engine::Teddy));
+    CHECK(mio::MultiFind(std::vector<std::string_view>(many.begin(), many.end())).engine() == mio::MultiFind::Engine::AhoCorasick);
+
+    const std::string_view log = "V1 start\nV17 E_DOOR open\nV4 stop\n\nV42 stop\nV420 E_DOOR";
+    auto lines = std::vector<std::pair<std::string_view, size_t>>{};
+    CHECK(ids.find_lines(log.data(), log.data() + log.size(), [&](const std::string_view a_line, const size_t a_pattern) {
+      lines.emplace_back(a_line, a_pattern);
+    }) == 3);
+    CHECK(lines == std::vector<std::pair<std::string_view, size_t>>{{"V17 E_DOOR open", 0}, {"V42 stop", 1}, {"V420 E_DOOR", 1}});
+  }
+
+  SUBCASE("test chunked async_getline stops the worker on callback error") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    auto n = reader.async_getline<2>([](int, const std::string_view) { return 1; }, 100);
+    CHECK(n == 0);
+    CHECK(reader.status() == 1);
+  }
+
+  SUBCASE("test a callback error stops the workers of every partition") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    // Worker 0 fails on its first line, while the others wait for it on theirs.
+    std::atomic<bool> failed{false};
+    auto n = reader.async_getline([&](int a_worker_id, const std::string_view) {
+      if (a_worker_id == 0) return failed = true, 7;
+      while (!failed) std::this_thread::yield();
+      return 0;
+    }, 4);
+    CHECK(n <= 3 * mio::StringReaderAsync::batch_size);
+    CHECK(reader.status() == 7);
+
+    // The status is reset by the next read.
+    CHECK(reader.async_getline([](int, std::span<const std::string_view>) { return 0; }, 4) == line_count);
+    CHECK(reader.status() == 0);
+  }
+
+  SUBCASE("test a stop token cancels async reads") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    std::stop_source source;
+    reader.set_stop_token(source.get_token());
+    std::atomic<size_t> lines{0};
+    auto n = reader.async_getline([&](int, std::span<const std::string_view> a_lines) {
+      if ((lines += a_lines.size()) >= 1000) source.request_stop();
+      return 0;
+    }, 2, 1000);
+    CHECK(n < line_count);
+    CHECK(reader.status() == 0);
+
+    CHECK(reader.async_getblock([](int, std::string_view) { return 0; }, 2, 1000) == 0);
+  }
+
+  SUBCASE("test lines views compose with range adaptors") {
+    mio::StringReader reader(path);
+    REQUIRE(reader.is_mapped());
+
+    CHECK(std::ranges::distance(reader.lines()) == static_cast<std::ptrdiff_t>(line_count));
+    auto i = size_t{0};
+    auto same = true;
+    for (auto line : reader.lines()) same &= line == std::string(i % 97, 'x') + std::to_string(i), i++;
+    CHECK(same);
+
+    // The first three lines ending with a 7 and longer than 90 bytes.
+    auto long_sevens = reader.lines()
+                     | std::views::filter([](std::string_view a_line) { return a_line.ends_with('7') && a_line.size() > 90; })
+                     | std::views::transform([](std::string_view a_line) { return a_line.substr(a_line.find_first_not_of('x')); })
+                     | std::views::take(3);
+    auto collect = [](auto &&a_lines) {
+      std::vector<std::string_view> result;
+      for (auto line : a_lines) result.push_back(line);
+      return result;
+    };
+    CHECK(collect(long_sevens) == std::vector<std::string_view>{"187", "287", "387"});
+
+    // The last line is included even if not terminated by `\n`.
+    auto text = std::string_view{"a\n\nb\nc"};
+    CHECK(collect(mio::LineView{text}) == std::vector<std::string_view>{"a", "", "b", "c"});
+    CHECK(mio::LineView{}.empty());
+  }
+
+  SUBCASE("test async reads record stats per worker") {
+    mio::StringReaderAsync reader(path);
+    REQUIRE(reader.is_mapped());
+
+    auto n = reader.async_getline([](int, const std::string_view) { return 0; }, 3, 4096);
+    CHECK(n == line_count);
+    const auto &stats = reader.stats();
+    if constexpr (!mio::with_stats) {
+      CHECK(stats.workers.empty());
+      return;
+    }
+
+    REQUIRE(stats.workers.size() == 3);
+    CHECK(stats.bytes() == buffer.size());
+    CHECK(stats.lines() == line_count);
+    CHECK(stats.skew() >= 1.0);
+    auto chunk_bytes = size_t{0};
+    for (const auto &w : stats.workers) {
+      CHECK(w.callback_time <= w.busy_time());
+      for (const auto &c : w.chunks) {
+        CHECK(buffer[c.offset + c.size - 1] == '\n');
+        chunk_bytes += c.size;
+      }
+    }
+    CHECK(chunk_bytes == buffer.size());
+
+    std::ostringstream trace;
+    stats.write_chrome_trace(trace);
+    CHECK(trace.str().starts_with(R"({"traceEvents":[)"));
+    CHECK(trace.str().find(R"("name":"chunk")") != std::string::npos);
+
+    // Partitioned reads and block reads record one chunk per partition, or per block.
+    reader.async_getline<2>([](int, std::span<const std::string_view>) { return 0; });
+    CHECK(reader.stats().lines() == line_count);
+    CHECK(reader.stats().workers[0].chunks.size() == 1);
+    const auto blocks = reader.async_getblock([](int, std::string_view) { return 0; }, 2, 4096);
+    CHECK(blocks == reader.stats().workers[0].chunks.size() + reader.stats().workers[1].chunks.size());
+  }
+}
+
+meta_enum_flags(LaneModes, uint8_t, NoModes = 0, Bus = 1 << 0, Car = 1 << 1, Hov = 1 << 2);
+meta_enum_class(LinkKind, uint8_t, Freeway = 10, Arterial = 20, Local = 30);
+meta_enum_codec(LinkKind);
+
+// #define TEST_STATIC_ASSERT
+TEST_CASE("csvdoc")
+{
+  using namespace mio::csv;
+
+  SUBCASE("test QuotedCsvField can be specialized") {
+    CHECK(QuotedCsvField<NAME("node_id")>::Quoted::value == true);
+  }
+
+  SUBCASE("test PlainCsvField can be specialized") {
+    CHECK(PlainCsvField<NAME("node_id")>::Quoted::value == false);
+  }
+
+#ifdef TEST_STATIC_ASSERT
+    SUBCASE("Csv field names cannot be duplicated") {
+      CsvDocReader<
+          Field<NAME("Field1")>,
+          Field<NAME("Field1")>,
+          Field<NAME("Field3")>,
+          Field<NAME("Field4")>
+      > doc;
+    }
+#endif
+
+  SUBCASE("test CsvField has static field name") {
+    auto field_name = Field<NAME("node_id")>::field_name;
+    CHECK(std::strcmp(field_name, "node_id") == 0);
+  }
+
+  SUBCASE("test VerifyHeader returns success for valid column header") {
+    CsvDoc<
+        Field<NAME("Field1")>,
+        Field<NAME("Field2")>,
+        Field<NAME("Field3")>,
+        Field<NAME("Field4")>
+    > csv_doc;
+
+    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field2,Field3,Field4"});
+    CHECK(success);
+  }
+
+  SUBCASE("test VerifyHeader returns error for invalid column names") {
+    CsvDoc<
+        Field<NAME("Field1")>,
+        Field<NAME("Field2")>,
+        Field<NAME("Field3")>,
+        Field<NAME("Field4")>
+    > csv_doc;
+
+    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field3,Field3,Field4"});
+    CHECK(!success);
+    CHECK(msg == "Invalid column names, code 0100");
+  }
+
+  SUBCASE("test VerifyHeader returns error for invalid column counts") {
+    CsvDoc<
+        Field<NAME("Field1")>,
+        Field<NAME("Field2")>,
+        Field<NAME("Field3")>,
+        Field<NAME("Field4")>
+    > csv_doc;
+
+    auto [success, msg] = csv_doc.VerifyHeader(std::string_view{"Field1,Field2"});
+    CHECK(!success);
+  }
+
+  SUBCASE("test CsvDoc returns correct number of fields") {
+    CsvDoc<
+        Field<NAME("Field1")>,
+        Field<NAME("Field2")>,
+        Field<NAME("Field3")>,
+        Field<NAME("Field4")>
+    > csv_doc;
+
+    CHECK(csv_doc.field_count == 4);
+  }
+
+  SUBCASE("test make_record can convert csv line to fields") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("Field1")>,
+        Field<NAME("Field2")>,
+        QuotedField<NAME("Field3")>,
+        Field<NAME("Field4")>
+    > csv_doc;
+
+    auto line = "1,2,\"hello,world\",6"sv;
+
+    auto rec = csv_doc.make_record(line);
+    CHECK(get<0>(rec).data.compare("1"sv) == 0);
+    CHECK(get<2>(rec).data.compare("\"hello,world\""sv) == 0);
+    CHECK(get<3>(rec).data.compare("6"sv) == 0);
+
+    rec = csv_doc.make_record("1,2,\"say \"\"hi,there\"\"\",6"sv);
+    CHECK(get<2>(rec).data.compare("\"say \"\"hi,there\"\"\""sv) == 0);
+    CHECK(get<3>(rec).data.compare("6"sv) == 0);
+  }
+
+  SUBCASE("test scan_structurals finds delimiters and line ends outside of quotes") {
+    std::mt19937 rng(3);
+    std::string text(3001, 'a');
+    const char set[] = {',', '"', '\n'};
+    for (auto &c : text)
+      if (rng() % 5 == 0) c = set[rng() % 3];
+
+    std::vector<uint32_t> expected;
+    bool quoted = false;
+    for (size_t i = 0; i < text.size(); i++) {
+      if (text[i] == '"') quoted = !quoted;
+      else if (!quoted && (text[i] == ',' || text[i] == '\n')) expected.push_back(static_cast<uint32_t>(i));
+    }
+
+    std::vector<uint32_t> offsets;
+    CHECK(scan_structurals(text.data(), text.data() + text.size(), offsets) == quoted);
+    CHECK(offsets == expected);
+
+    // Scanning in two parts carries the quote state over.
+    for (size_t split : {size_t{1}, size_t{63}, size_t{64}, size_t{1000}}) {
+      std::vector<uint32_t> first, second;
+      auto in_quotes = scan_structurals(text.data(), text.data() + split, first);
+      scan_structurals(text.data() + split, text.data() + text.size(), second, in_quotes);
+      for (auto o : second) first.push_back(o + static_cast<uint32_t>(split));
+      CHECK(first == expected);
+    }
+  }
+
+  SUBCASE("test make_records makes every record of a block") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id")>,
+        QuotedField<NAME("WKT")>,
+        Field<NAME("speed")>
+    > csv_doc;
+
+    auto block = "1,\"LINESTRING (0 0,\n1 1)\",30\r\n\n2,,\n3\n4,\"a\"\"b\",40,extra\n5,x,50"sv;
+    std::vector<std::array<std::string, 3>> rows;
+    auto n = csv_doc.make_records(block, [&](const auto &a_rec) {
+      rows.push_back({std::string(get<0>(a_rec).data), std::string(get<1>(a_rec).data), std::string(get<2>(a_rec).data)});
+      return 0;
+    });
+
+    REQUIRE(n == 5);
+    REQUIRE(rows.size() == 5);
+    CHECK(rows[0] == std::array<std::string, 3>{"1", "\"LINESTRING (0 0,\n1 1)\"", "30"});
+    CHECK(rows[1] == std::array<std::string, 3>{"2", "", ""});
+    CHECK(rows[2] == std::array<std::string, 3>{"3", "", ""});
+    CHECK(rows[3] == std::array<std::string, 3>{"4", "\"a\"\"b\"", "40"});
+    CHECK(rows[4] == std::array<std::string, 3>{"5", "x", "50"});
+
+    // Stops at the first non-zero status code.
+    CHECK(csv_doc.make_records(block, [](const auto &) { return 1; }) == 0);
+  }
+
+  SUBCASE("test make_columns fills one column per field") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id")>,
+        QuotedField<NAME("name")>,
+        Field<NAME("speed")>
+    > csv_doc;
+
+    decltype(csv_doc)::Columns columns;
+    CHECK(csv_doc.make_columns("1,\"a,b\",30\n2,c,40\n"sv, columns) == 2);
+    CHECK(csv_doc.make_columns("3,d,50"sv, columns) == 1);
+
+    CHECK(get<0>(columns) == std::vector{"1"sv, "2"sv, "3"sv});
+    CHECK(get<1>(columns) == std::vector{"\"a,b\""sv, "c"sv, "d"sv});
+    CHECK(get<2>(columns) == std::vector{"30"sv, "40"sv, "50"sv});
+  }
+
+  SUBCASE("test make_columns fills pmr columns from the arena") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id"), int64_t>,
+        QuotedField<NAME("name"), std::pmr::string>,
+        Field<NAME("oneway"), bool>
+    > csv_doc;
+
+    mio::arena_memory_resource arena;
+    auto columns = decltype(csv_doc)::make_pmr_columns(&arena);
+    const auto long_name = std::string(40, 'n');
+    const auto block = "1,a,1\n2," + long_name + ",0\n";
+    CHECK(csv_doc.make_columns(block, columns) == 2);
+
+    CHECK(get<0>(columns) == std::pmr::vector<int64_t>{1, 2});
+    CHECK(std::string_view{get<1>(columns)[1]} == long_name);
+    CHECK(get<1>(columns)[1].get_allocator().resource() == &arena);
+    CHECK(get<2>(columns)[0]);
+    CHECK(arena.used() > long_name.size());
+  }
+
+  SUBCASE("test parse_field converts text to typed values") {
+    using namespace std::literals;
+
+    int i = 1;
+    CHECK(parse_field("42"sv, i));
+    CHECK(i == 42);
+    CHECK(parse_field(" +7 "sv, i));
+    CHECK(i == 7);
+    CHECK(parse_field("\"-3\""sv, i));
+    CHECK(i == -3);
+    CHECK(parse_field(""sv, i));
+    CHECK(i == 0);
+    CHECK_FALSE(parse_field("12a"sv, i));
+    CHECK(i == 0);
+
+    double d = 0;
+    CHECK(parse_field("2.5e3"sv, d));
+    CHECK(d == 2500.0);
+
+    bool b = false;
+    CHECK(parse_field("true"sv, b));
+    CHECK(b);
+    CHECK_FALSE(parse_field("yes"sv, b));
+
+    std::string str;
+    CHECK(parse_field("\"a,b\""sv, str));
+    CHECK(str == "\"a,b\"");
+  }
+
+  SUBCASE("test meta_enum flag sets are typed fields") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("link_id"), int64_t>,
+        Field<NAME("modes"), LaneModes>
+    > csv_doc;
+
+    auto rec = csv_doc.make_record("7,Bus|Hov"sv);
+    CHECK(get<1>(rec).data == (LaneModes::Bus | LaneModes::Hov));
+
+    decltype(csv_doc)::Columns columns;
+    CHECK(csv_doc.make_columns("1,Car\n2,Plane\n3,\n"sv, columns) == 3);
+    CHECK(get<1>(columns) == std::vector<LaneModes>{LaneModes::Car, LaneModes::NoModes, LaneModes::NoModes});
+    CHECK(csv_doc.invalid_field_count == 1);
+
+    std::string out;
+    format_field(out, LaneModes::Car | LaneModes::Hov);
+    CHECK(out == "Car|Hov");
+  }
+
+  SUBCASE("test meta_enum codecs are typed fields") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("link_id"), int64_t>,
+        Field<NAME("kind"), LinkKind>
+    > csv_doc;
+
+    auto rec = csv_doc.make_record("7, \"Arterial\""sv);
+    CHECK(get<1>(rec).data == LinkKind::Arterial);
+
+    decltype(csv_doc)::Columns columns;
+    CHECK(csv_doc.make_columns("1,Local\n2,20\n3,Freeway\n"sv, columns) == 3);
+    CHECK(get<1>(columns) == std::vector<LinkKind>{LinkKind::Local, LinkKind{}, LinkKind::Freeway});
+    CHECK(csv_doc.invalid_field_count == 1);
+
+    std::string out;
+    format_field(out, LinkKind::Freeway);
+    format_field(out, static_cast<LinkKind>(40));
+    CHECK(out == "Freeway40");
+  }
+
+  SUBCASE("test typed fields are converted while parsing") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id"), int64_t>,
+        QuotedField<NAME("name")>,
+        Field<NAME("speed"), double>,
+        Field<NAME("oneway"), bool>
+    > csv_doc;
+
+    auto rec = csv_doc.make_record("7,\"a,b\",55.5,1"sv);
+    CHECK(get<0>(rec).data == 7);
+    CHECK(get<1>(rec).data == "\"a,b\""sv);
+    CHECK(get<2>(rec).data == 55.5);
+    CHECK(get<3>(rec).data);
+    CHECK(csv_doc.invalid_field_count == 0);
+
+    decltype(csv_doc)::Columns columns;
+    CHECK(csv_doc.make_columns("1,x,10,0\n2,y,bad,1\n"sv, columns) == 2);
+    CHECK(get<0>(columns) == std::vector<int64_t>{1, 2});
+    CHECK(get<2>(columns) == std::vector<double>{10, 0});
+    CHECK(get<3>(columns) == std::vector<bool>{false, true});
+    CHECK(csv_doc.invalid_field_count == 1);
+  }
+
+  SUBCASE("test skipped and projected fields are not converted") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id"), int64_t>,
+        QuotedSkip<NAME("geometry")>,
+        Field<NAME("speed"), double>,
+        Skip<NAME("lanes")>,
+        Skip<NAME("capacity")>
+    > csv_doc;
+
+    CHECK(csv_doc.VerifyHeader("id,geometry,speed,lanes,capacity"sv) == std::make_tuple(true, std::string{"success"}));
+    auto rec = csv_doc.make_record("7,\"LINESTRING (0 0, 1 1)\",55.5,x,y"sv);
+    CHECK(get<0>(rec).data == 7);
+    CHECK(get<2>(rec).data == 55.5);
+    CHECK(csv_doc.invalid_field_count == 0);
+
+    auto [speed, id] = csv_doc.project<2, 0>("8,\"LINESTRING (0 0, 1 1)\",bad,x,y"sv);
+    CHECK(id.data == 8);
+    CHECK(speed.data == 0.0);
+    CHECK(csv_doc.invalid_field_count == 1);
+
+    auto [first] = csv_doc.project<0>("9"sv);
+    CHECK(first.data == 9);
+  }
+
+  SUBCASE("test lazy records find fields on first access") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id"), int64_t>,
+        QuotedField<NAME("name")>,
+        Field<NAME("speed"), double>,
+        Field<NAME("oneway"), bool>
+    > csv_doc;
+
+    const auto line = "7,\"a,\"\"b\"\"\",55.5,1"sv;
+    auto rec = decltype(csv_doc)::make_lazy_record(line);
+    CHECK(rec.line() == line);
+    CHECK(rec.get<2>() == 55.5);
+    CHECK(rec.text<1>() == "\"a,\"\"b\"\"\""sv);
+    CHECK(rec.get<0>() == 7);
+    CHECK(rec.get<3>());
+
+    auto eager = csv_doc.make_record(line);
+    CHECK(get<1>(eager).data == rec.text<1>());
+
+    auto bad = decltype(csv_doc)::make_lazy_record("1,x,bad"sv);
+    auto value = 1.0;
+    CHECK(!bad.get<2>(value));
+    CHECK(bad.text<3>().empty());
+    CHECK(!bad.get<3>());
+    CHECK(decltype(csv_doc)::make_lazy_record("2,y,"sv).text<2>().empty());
+  }
+
+  SUBCASE("test MapHeader binds reordered and extra columns by name") {
+    using namespace std::literals;
+
+    CsvDoc<
+        Field<NAME("id"), int64_t>,
+        QuotedField<NAME("name")>,
+        Field<NAME("speed"), double>,
+        Skip<NAME("lanes")>
+    > csv_doc;
+
+    auto [ok, msg] = csv_doc.MapHeader("\xEF\xBB\xBF\"speed\", geometry ,name,capacity,id,name,extra\r"sv);
+    CHECK(ok);
+    CHECK(msg == "success");
+    CHECK(csv_doc.column_map() == std::vector<size_t>{2, decltype(csv_doc)::unmapped, 1, decltype(csv_doc)::unmapped, 0});
+
+    auto rec = csv_doc.make_record("55.5,\"LINESTRING (0 0, 1 1)\",\"a,b\",1900,7,dup,x"sv);
+    CHECK(get<0>(rec).data == 7);
+    CHECK(get<1>(rec).data == "\"a,b\""sv);
+    CHECK(get<2>(rec).data == 55.5);
+
+    auto ids = std::vector<int64_t>{};
+    auto n = csv_doc.make_records("1.5,\"g,\",x,0,1\n\n2.5,\"g\nh\",y,0,2\r\n3.5"sv, [&](const auto &a_rec) {
+      ids.push_back(get<0>(a_rec).data);
+      return 0;
+    });
+    CHECK(n == 3);
+    CHECK(ids == std::vector<int64_t>{1, 2, 0});
+
+    decltype(csv_doc)::Columns columns;
+    CHECK(csv_doc.make_columns("1.5,g,x,0,1\n2.5,g,y,0,2"sv, columns) == 2);
+    CHECK(get<2>(columns) == std::vector<double>{1.5, 2.5});
+    CHECK(get<1>(columns) == std::vector<std::string_view>{"x", "y"});
+    CHECK(csv_doc.invalid_field_count == 0);
+
+    auto [missing_ok, missing_msg] = csv_doc.MapHeader("speed,name"sv);
+    CHECK(!missing_ok);
+    CHECK(missing_msg == "Missing columns: id");
+
+    csv_doc.set_column_map({});
+    CHECK(get<0>(csv_doc.make_record("7,x,1.5"sv)).data == 7);
+  }
+
+  SUBCASE("test dialects set the delimiter, quote and escape chars") {
+    using namespace std::literals;
+
+    BasicCsvDoc<TabDialect, Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> tsv;
+    CHECK(std::get<0>(tsv.VerifyHeader("id\tname\tspeed"sv)));
+    auto rec = tsv.make_record("7\t\"a\tb,c\"\t55.5"sv);
+    CHECK(get<0>(rec).data == 7);
+    CHECK(get<1>(rec).data == "\"a\tb,c\""sv);
+    CHECK(get<2>(rec).data == 55.5);
+    CHECK(std::get<0>(tsv.MapHeader("speed\tid\tname"sv)));
+    CHECK(get<0>(tsv.make_record("1.5\t8\tx"sv)).data == 8);
+
+    BasicCsvDoc<CsvDialect<'|', '\''>, Field<NAME("id"), int64_t>, QuotedField<NAME("name")>> psv;
+    CHECK(get<1>(psv.make_record("9|'a|b'"sv)).data == "'a|b'"sv);
+
+    using Escaped = BasicCsvDoc<CsvDialect<',', '"', '\\'>, Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>>;
+    Escaped escaped;
+    CHECK(get<1>(escaped.make_record(R"(1,"a\",b\\",2.5)"sv)).data == R"("a\",b\\")"sv);
+    CHECK(get<2>(escaped.make_record(R"(1,x\,y,2.5)"sv)).data == 0.0); // only quotes are escaped
+    CHECK(escaped.invalid_field_count == 1);
+    CHECK(get<2>(escaped.make_record(R"(1,\"x,2.5)"sv)).data == 2.5);
+
+    // Escaped quotes across 64 byte blocks, in the SIMD kernels.
+    std::string block;
+    for (size_t i = 0; i < 3000; i++)
+      block.append(std::to_string(i)).append(",\"").append(i % 7, 'q').append(R"(\",)").append(i % 5, '\\').append(i % 5 % 2 ? "\\" : "").append("\n\",").append(std::to_string(i % 100)).push_back('\n');
+
+    size_t lines = 0, mismatches = 0;
+    auto n = escaped.make_records(block, [&](const auto &a_rec) {
+      mismatches += static_cast<size_t>(get<0>(a_rec).data) != lines || get<2>(a_rec).data != static_cast<double>(lines % 100);
+      lines++;
+      return 0;
+    });
+    CHECK(n == 3000);
+    CHECK(mismatches == 0);
+    CHECK(escaped.invalid_field_count == 1);
+  }
+
+  SUBCASE("test utf8 is validated while scanning the structurals") {
+    using namespace std::literals;
+
+    std::string text;
+    auto expected = std::vector<uint32_t>{};
+    for (size_t i = 0; i < 2000; i++) {
+      text.append(std::to_string(i)).append(",\"caf\xC3\xA9, \xE2\x82\xAC\",\xF0\x9F\x9A\x97");
+      if (i % 97 == 5) expected.push_back(static_cast<uint32_t>(text.size())), text.append("\xC3(");
+      if (i % 131 == 7) // a surrogate, of which each byte is invalid
+        for (const auto c : {'\xED', '\xA0', '\x80'}) expected.push_back(static_cast<uint32_t>(text.size())), text.push_back(c);
+      if (i % 173 == 9) expected.push_back(static_cast<uint32_t>(text.size())), text.append("\xF0\x9F\x9A");
+      text.push_back('\n');
+    }
+
+    std::vector<uint32_t> offsets, plain_offsets, errors;
+    scan_structurals(text.data(), text.data() + text.size(), offsets, errors);
+    scan_structurals(text.data(), text.data() + text.size(), plain_offsets);
+    CHECK(offsets == plain_offsets);
+    CHECK(errors == expected);
+
+    errors.clear();
+    scan_structurals(text.data(), text.data() + text.size() - 1, offsets, errors);
+    CHECK(errors == expected);
+
+    auto scalar = std::vector<uint32_t>{};
+    const auto mangled = "ok\x80\xC0\xAF\xF5\x80\x80\x80\xE0\x80\x80\xF4\x90\x80\x80\xC3\xA9"sv;
+    mio::scalar_utf8_errors(mangled.data(), mangled.data() + mangled.size(), mangled.data() + mangled.size(), [&](const char *a_pos) {
+      scalar.push_back(static_cast<uint32_t>(a_pos - mangled.data()));
+    });
+    CHECK(scalar == std::vector<uint32_t>{2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    CHECK(mio::skip_utf8_bom("\xEF\xBB\xBFid"sv) == "id"sv);
+
+    CsvDoc<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("icon")>> csv_doc;
+    csv_doc.validate_utf8 = true;
+    CHECK(csv_doc.make_records(text, [](const auto &) { return 0; }) == 2000);
+    CHECK(csv_doc.utf8_errors.size() == expected.size());
+    CHECK(csv_doc.utf8_errors.front() == text.data() + expected.front());
+  }
+
+  SUBCASE("test make_records agrees with make_record across scan windows") {
+    CsvDoc<
+        Field<NAME("a")>,
+        QuotedField<NAME("b")>,
+        Field<NAME("c")>
+    > csv_doc;
+
+    std::string block;
+    for (size_t i = 0; block.size() < (3 << 20); i++)
+      block.append(std::to_string(i)).append(",\"").append(i % 13, 'q').append(",\",").append(std::to_string(i * 7)).push_back('\n');
+
+    size_t lines = 0, mismatches = 0;
+    const char *line = block.data();
+    auto n = csv_doc.make_records(block, [&](const auto &a_rec) {
+      const char *eol = std::find(line, std::as_const(block).data() + block.size(), '\n');
+      auto expected = csv_doc.make_record(std::string_view(line, eol));
+      mismatches += get<0>(a_rec).data != get<0>(expected).data || get<1>(a_rec).data != get<1>(expected).data || get<2>(a_rec).data != get<2>(expected).data;
+      line = eol + 1;
+      lines++;
+      return 0;
+    });
+
+    CHECK(n == lines);
+    CHECK(lines == static_cast<size_t>(std::count(block.begin(), block.end(), '\n')));
+    CHECK(mismatches == 0);
+  }
+
+
+  SUBCASE("test UnquotedField views the text between the quotes and unescapes on demand") {
+    CsvDoc<Field<NAME("id"), int64_t>, UnquotedField<NAME("name")>, UnquotedField<NAME("note")>> doc;
+
+    const std::string line = "1,\"plain, text\",\"say \"\"hi\"\"\"";
+    auto rec = doc.make_record(line);
+    const auto &name = get<1>(rec).data;
+    const auto &note = get<2>(rec).data;
+    CHECK(!name.escaped);
+    CHECK(name.text == "plain, text");
+    CHECK(name.text.data() == line.data() + 3);
+    CHECK(note.escaped);
+    CHECK(note.text == "say \"\"hi\"\"");
+
+    mio::arena_memory_resource arena;
+    CHECK(name.unescape(&arena).data() == name.text.data());
+    CHECK(note.unescape(&arena) == "say \"hi\"");
+    CHECK(note.str() == "say \"hi\"");
+
+    // Unescaped over itself, as in a copy on write mapping.
+    auto copy = line;
+    auto in_place = mio::csv::Unquoted{std::string_view{copy}.substr(static_cast<size_t>(note.text.data() - line.data()), note.text.size()), true};
+    CHECK(in_place.unescape(std::span<char>{const_cast<char *>(in_place.text.data()), in_place.text.size()}) == "say \"hi\"");
+
+    auto unquoted = doc.make_record("2,bare,\"\"");
+    CHECK(get<1>(unquoted).data == mio::csv::Unquoted{"bare", false});
+    CHECK(get<2>(unquoted).data.text.empty());
+    CHECK(!get<2>(unquoted).data.escaped);
+  }
+
+  SUBCASE("test make_record_in_place unescapes and terminates fields in a private mapping") {
+    const char *path = "test-csv-inplace";
+    const std::string text = "7,\"a, \"\"b\"\"\",2.5\n8,plain,\"-1e3\"\n";
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << text;
+    }
+
+    CsvDoc<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("x")>> doc;
+    {
+      mio::mmap_private map(path);
+      REQUIRE(map.is_mapped());
+      std::decay_t<decltype(doc)>::Record rec;
+
+      const auto eol = text.find('\n');
+      doc.make_record_in_place(rec, std::span<char>{map.data(), eol});
+      CHECK(get<0>(rec).data == 7);
+      CHECK(get<1>(rec).data == "a, \"b\"");
+      CHECK(get<1>(rec).data.data()[get<1>(rec).data.size()] == '\0');
+      CHECK(std::strtod(get<2>(rec).data.data(), nullptr) == 2.5);
+
+      doc.make_record_in_place(rec, std::span<char>{map.data() + eol + 1, text.size() - eol - 2});
+      CHECK(get<0>(rec).data == 8);
+      CHECK(get<1>(rec).data == "plain");
+      CHECK(std::strtod(get<2>(rec).data.data(), nullptr) == -1000.0);
+      CHECK(doc.invalid_field_count == 0);
+
+      // The header may reorder the columns.
+      REQUIRE(std::get<0>(doc.MapHeader("x,name,id")));
+      mio::mmap_private other(path);
+      doc.make_record_in_place(rec, std::span<char>{other.data(), eol});
+      CHECK(std::strcmp(get<2>(rec).data.data(), "7") == 0);
+      CHECK(get<0>(rec).data == 0);
+      CHECK(doc.invalid_field_count == 1);
+    }
+
+    mio::mmap_source source(path);
+    CHECK(std::string_view{source.data(), source.size()} == text);
+    source.unmap();
+    std::filesystem::remove(path);
+
+    using Escaped = BasicCsvDoc<CsvDialect<',', '"', '\\'>, QuotedField<NAME("s")>, Field<NAME("t")>>;
+    std::string line = "\"x\\\"y\\\\z\"\n";
+    CHECK(Escaped::unescape_in_place(line.data(), line.data() + line.size() - 1) == "x\"y\\z");
+  }
+}
+
+TEST_CASE("csvreader")
+{
+  using namespace mio::csv;
+
+  const auto record_count = size_t{20000};
+  std::string buffer = "id,name,speed\r\n";
+  for (size_t i = 0; i < record_count; ++i)
+    buffer.append(std::to_string(i)).append(",\"n,").append(std::to_string(i % 11)).append("\",").append(std::to_string(i % 100)).append("\r\n");
+
+  auto path = "test-csv";
+  std::ofstream file(path, std::ios::binary);
+  file << buffer;
+  file.close();
+
+  using Reader = CsvReader<
+      Field<NAME("id"), int64_t>,
+      QuotedField<NAME("name")>,
+      Field<NAME("speed"), double>
+  >;
+
+  SUBCASE("test records views make records lazily") {
+    mio::StringReader lines(path);
+    REQUIRE(lines.is_mapped());
+    Reader::Doc doc;
+
+    auto fast = doc.records(lines)
+              | std::views::filter([](const Reader::Record &a_rec) { return get<2>(a_rec).data >= 99; })
+              | std::views::take(5);
+    auto ids = std::vector<int64_t>{};
+    for (const auto &rec : fast) ids.push_back(get<0>(rec).data);
+    CHECK(ids == std::vector<int64_t>{99, 199, 299, 399, 499});
+    CHECK(std::ranges::distance(doc.records(lines)) == static_cast<std::ptrdiff_t>(record_count));
+  }
+
+  SUBCASE("test lazy records views convert only the fields read") {
+    mio::StringReader lines(path);
+    REQUIRE(lines.is_mapped());
+
+    auto slow = Reader::Doc::lazy_records(lines)
+              | std::views::filter([](const Reader::Doc::LazyRecord &a_rec) { return a_rec.get<0>() % 1000 == 123; });
+    auto names = std::vector<std::string_view>{};
+    for (const auto &rec : slow) names.push_back(rec.text<1>());
+    CHECK(names.size() == record_count / 1000);
+    CHECK(names.front() == "\"n,2\"");
+  }
+
+  SUBCASE("test pipelines overlap scanning, parsing and consuming") {
+    mio::StringReaderAsync lines(path);
+    REQUIRE(lines.is_mapped());
+    const auto header_size = lines.content().find('\n') + 1;
+
+    std::vector<std::unique_ptr<Reader::Doc>> docs;
+    for (int i = 0; i < 3; ++i) docs.push_back(std::make_unique<Reader::Doc>());
+
+    mio::Pipeline pipeline(4);
+    auto &blocks = pipeline.read_blocks(lines, 2, 4096, true);
+    auto &batches = pipeline.stage<std::vector<Reader::Record>>(blocks, 3, [&](int a_id, std::string_view &a_block, auto &a_emit) {
+      if (a_block.data() == lines.content().data()) a_block.remove_prefix(header_size);
+      auto batch = std::vector<Reader::Record>{};
+      docs[a_id]->make_records(a_block, [&](const Reader::Record &a_rec) { batch.push_back(a_rec); return 0; });
+      a_emit(std::move(batch));
+      return 0;
+    });
+
+    std::atomic<size_t> records{0};
+    std::atomic<int64_t> ids{0};
+    pipeline.sink(batches, 2, [&](int, std::vector<Reader::Record> &a_batch) {
+      records += a_batch.size();
+      for (const auto &rec : a_batch) ids += get<0>(rec).data;
+      return 0;
+    });
+
+    CHECK(pipeline.wait() == 0);
+    CHECK(records == record_count);
+    CHECK(ids == static_cast<int64_t>(record_count * (record_count - 1) / 2));
+  }
+
+  SUBCASE("test a failing stage cancels the whole pipeline") {
+    mio::StringReaderAsync lines(path);
+    REQUIRE(lines.is_mapped());
+
+    mio::Pipeline pipeline(2);
+    auto &blocks = pipeline.read_blocks(lines, 2, 1024);
+    auto &sizes = pipeline.stage<size_t>(blocks, 2, [](int, std::string_view &a_block, auto &a_emit) {
+      a_emit(a_block.size());
+      return 0;
+    });
+    std::atomic<size_t> consumed{0};
+    pipeline.sink(sizes, 1, [&](int, size_t &) { return ++consumed == 10 ? 5 : 0; });
+
+    CHECK(pipeline.wait() == 5);
+    CHECK(consumed == 10);
+  }
+
+  SUBCASE("test bounded queues hand every item over once") {
+    mio::BoundedQueue<int> queue(8);
+    CHECK(queue.capacity() == 8);
+
+    std::atomic<int64_t> sum{0};
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 3; ++i)
+      consumers.emplace_back([&] {
+        for (int item = 0; queue.pop(item);) sum += item;
+      });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 3; ++p)
+      producers.emplace_back([&, p] {
+        for (int i = 0; i < 10000; ++i) queue.push(p * 10000 + i);
+      });
+    for (auto &t : producers) t.join();
+    queue.close();
+    for (auto &t : consumers) t.join();
+
+    CHECK(sum == int64_t{30000} * 29999 / 2);
+    int item = 0;
+    CHECK_FALSE(queue.pop(item));
+    CHECK(queue.try_push(item));
+  }
+
+  SUBCASE("test bounded queues hand batches over once, in order per producer") {
+    mio::BoundedQueue<int> queue(16);
+
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> out_of_order{0};
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 3; ++i)
+      consumers.emplace_back([&] {
+        std::array<int, 5> items{};
+        std::array<int, 3> last{-1, -1, -1};
+        for (size_t n; (n = queue.pop_n(items)) > 0;)
+          for (size_t k = 0; k < n; ++k) {
+            sum += items[k];
+            // A batch popped holds consecutive items, in the order pushed.
+            const auto p = items[k] / 10000;
+            if (k > 0 && items[k - 1] / 10000 == p && items[k - 1] > items[k]) out_of_order++;
+            last[p] = items[k];
+          }
+      });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 3; ++p)
+      producers.emplace_back([&, p] {
+        std::vector<int> batch(7);
+        for (int i = 0; i < 10000; i += 7) {
+          const auto n = std::min(7, 10000 - i);
+          for (int k = 0; k < n; ++k) batch[k] = p * 10000 + i + k;
+          queue.push_n(std::span<int>{batch.data(), static_cast<size_t>(n)});
+        }
+      });
+    for (auto &t : producers) t.join();
+    queue.close();
+    for (auto &t : consumers) t.join();
+
+    CHECK(sum == int64_t{30000} * 29999 / 2);
+    CHECK(out_of_order == 0);
+
+    std::array<int, 20> items{};
+    CHECK(queue.try_pop_n(items) == 0);
+    CHECK(queue.try_push_n(items) == 16);
+    CHECK(queue.try_push_n(items) == 0);
+    CHECK(queue.try_pop_n(std::span<int>{items}.first(10)) == 10);
+  }
+
+  SUBCASE("test spsc queues hand every item over once, in order") {
+    mio::SpscQueue<std::vector<int>> queue(4);
+    CHECK(queue.capacity() == 4);
+
+    std::thread producer([&] {
+      for (int i = 0; i < 20000; ++i) queue.push(std::vector<int>(1, i));
+      queue.close();
+    });
+
+    auto expected = 0;
+    auto out_of_order = 0;
+    std::array<std::vector<int>, 3> batch;
+    for (size_t n; (n = queue.pop_n(batch)) > 0;)
+      for (size_t k = 0; k < n; ++k) out_of_order += batch[k].at(0) != expected++;
+    producer.join();
+
+    CHECK(expected == 20000);
+    CHECK(out_of_order == 0);
+
+    mio::SpscQueue<int> ints(2);
+    std::array<int, 3> values{1, 2, 3};
+    CHECK(ints.try_push_n(values) == 2);
+    int value = 0;
+    CHECK(ints.try_pop(value));
+    CHECK(value == 1);
+    CHECK(ints.try_push(values[2]));
+    CHECK(ints.try_pop_n(values) == 2);
+    CHECK(values[0] == 2);
+    CHECK(values[1] == 3);
+    ints.cancel();
+    CHECK_FALSE(ints.push(4));
+  }
+
+  SUBCASE("test verify_header checks the header line once") {
+    Reader reader(path);
+    REQUIRE(reader.is_mapped());
+    CHECK(std::get<0>(reader.verify_header()));
+
+    CsvReader<Field<NAME("id")>, Field<NAME("speed")>, Field<NAME("name")>> wrong(path);
+    CHECK_FALSE(std::get<0>(wrong.verify_header()));
+    CHECK(wrong.read([](int, auto) { return 0; }, 2) == 0);
+  }
+
+  SUBCASE("test columns are mapped by name once per read") {
+    CsvReader<Field<NAME("speed"), double>, Field<NAME("id"), int64_t>, Skip<NAME("lanes")>> reordered(path);
+    REQUIRE(reordered.is_mapped());
+    CHECK_FALSE(std::get<0>(reordered.verify_header()));
+    reordered.map_columns_by_name = true;
+    CHECK(std::get<0>(reordered.verify_header()));
+
+    std::atomic<int64_t> ids{0};
+    std::atomic<int64_t> speeds{0};
+    auto n = reordered.read([&](int, auto a_records) {
+      for (const auto &rec : a_records) {
+        ids += get<1>(rec).data;
+        speeds += static_cast<int64_t>(get<0>(rec).data);
+      }
+      return 0;
+    }, 3, 4096);
+
+    CHECK(n == record_count);
+    CHECK(ids == static_cast<int64_t>(record_count * (record_count - 1) / 2));
+    CHECK(speeds == static_cast<int64_t>(record_count / 100 * 4950));
+    CHECK(reordered.invalid_field_count() == 0);
+
+    CsvReader<Field<NAME("id")>, Field<NAME("lanes")>> missing(path);
+    missing.map_columns_by_name = true;
+    CHECK(std::get<1>(missing.verify_header()) == "Missing columns: lanes");
+    CHECK(missing.read([](int, auto) { return 0; }, 2) == 0);
+  }
+
+  SUBCASE("test dialect readers never cut blocks inside quotes") {
+    std::string tsv = "id\tname\tspeed\n";
+    for (size_t i = 0; i < 5000; i++)
+      tsv.append(std::to_string(i)).append("\t\"n\t\\\"\n").append(std::to_string(i % 11)).append("\"\t").append(std::to_string(i % 100)).append("\r\n");
+    std::ofstream("test-csv-tsv", std::ios::binary) << tsv;
+
+    BasicCsvReader<CsvDialect<'\t', '"', '\\'>, Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> reader("test-csv-tsv");
+    REQUIRE(reader.is_mapped());
+
+    std::atomic<int64_t> ids{0};
+    std::atomic<size_t> names{0};
+    auto n = reader.read([&](int, auto a_records) {
+      for (const auto &rec : a_records) {
+        ids += get<0>(rec).data;
+        names += get<1>(rec).data.starts_with("\"n\t\\\"\n");
+      }
+      return 0;
+    }, 3, 1024);
+
+    CHECK(n == 5000);
+    CHECK(ids == 5000 * 4999 / 2);
+    CHECK(names == 5000);
+    CHECK(reader.invalid_field_count() == 0);
+  }
+
+  SUBCASE("test read validates utf8 and skips the byte order mark") {
+    std::string text = "\xEF\xBB\xBFid,name,speed\n";
+    auto expected = std::vector<size_t>{};
+    for (size_t i = 0; i < 5000; i++) {
+      text.append(std::to_string(i)).append(",\"n\xC3\xA9,");
+      if (i % 1000 == 999) expected.push_back(text.size()), text.push_back('\xFF');
+      text.append("\",").append(std::to_string(i % 100)).push_back('\n');
+    }
+    std::ofstream("test-csv-utf8", std::ios::binary) << text;
+
+    Reader reader("test-csv-utf8");
+    REQUIRE(reader.is_mapped());
+    CHECK(std::get<0>(reader.verify_header()));
+    CHECK(reader.read([](int, auto) { return 0; }, 3, 4096) == 5000);
+    CHECK(reader.utf8_errors().empty());
+
+    reader.validate_utf8 = true;
+    CHECK(reader.read([](int, auto) { return 0; }, 3, 4096) == 5000);
+    CHECK(reader.utf8_errors() == expected);
+  }
+
+  SUBCASE("test read hands batches of records to per-worker sinks") {
+    Reader reader(path);
+    REQUIRE(reader.is_mapped());
+
+    std::atomic<int64_t> ids{0};
+    std::atomic<size_t> batches{0};
+    auto n = reader.read([&](int, std::span<const Reader::Record> a_records) {
+      batches++;
+      for (const auto &rec : a_records) ids += get<0>(rec).data;
+      return a_records.size() <= Reader::batch_size ? 0 : 1;
+    }, 4, 4096);
+
+    CHECK(n == record_count);
+    CHECK(ids == static_cast<int64_t>(record_count * (record_count - 1) / 2));
+    CHECK(batches >= buffer.size() / 4096);
+    CHECK(reader.invalid_field_count() == 0);
+  }
+
+  SUBCASE("test read_columns hands columnar blocks to per-worker sinks") {
+    Reader reader(path);
+    REQUIRE(reader.is_mapped());
+
+    std::atomic<size_t> rows{0};
+    std::atomic<int64_t> speeds{0};
+    auto n = reader.read_columns([&](int, Reader::Columns &a_columns) {
+      rows += get<0>(a_columns).size();
+      for (auto v : get<2>(a_columns)) speeds += static_cast<int64_t>(v);
+      return get<1>(a_columns).size() == get<0>(a_columns).size() ? 0 : 1;
+    }, 3, 10000);
+
+    CHECK(n == record_count);
+    CHECK(rows == record_count);
+    CHECK(speeds == static_cast<int64_t>(record_count / 100 * 4950));
+  }
+
+  SUBCASE("test read never cuts blocks inside quoted newlines") {
+    std::string wkt = "id,wkt\n";
+    for (size_t i = 0; i < 3000; ++i)
+      wkt.append(std::to_string(i)).append(",\"LINESTRING (").append(i % 7, '\n').append("0 0,\"\"1\"\" 1)\"\n");
+
+    auto wkt_path = "test-csv-wkt";
+    std::ofstream wkt_file(wkt_path, std::ios::binary);
+    wkt_file << wkt;
+    wkt_file.close();
+
+    CsvReader<Field<NAME("id"), int64_t>, QuotedField<NAME("wkt")>> reader(wkt_path);
+    REQUIRE(reader.is_mapped());
+
+    for (auto chunk_size : {size_t{1}, size_t{7}, size_t{100}, size_t{4096}}) {
+      std::atomic<int64_t> ids{0};
+      std::atomic<size_t> bad{0};
+      auto n = reader.read([&](int, auto a_records) {
+        for (const auto &rec : a_records) {
+          ids += get<0>(rec).data;
+          const auto text = get<1>(rec).data;
+          bad += !text.starts_with("\"LINESTRING (") || !text.ends_with(" 1)\"")
+              || static_cast<int64_t>(std::count(text.begin(), text.end(), '\n')) != get<0>(rec).data % 7;
+        }
+        return 0;
+      }, 4, chunk_size);
+
+      CHECK(n == 3000);
+      CHECK(ids == 3000 * 2999 / 2);
+      CHECK(bad == 0);
+      CHECK(reader.invalid_field_count() == 0);
+    }
+  }
+  SUBCASE("test csv cache is built on first load and mapped after") {
+    const auto cache = CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>>::default_cache(path);
+    std::filesystem::remove(cache);
+
+    auto check_columns = [&](const auto &a_cache) {
+      REQUIRE(a_cache.size() == record_count);
+      const auto ids = a_cache.template column<0>();
+      const auto names = a_cache.template column<1>();
+      const auto speeds = a_cache.template column<2>();
+      REQUIRE(ids.size() == record_count);
+      REQUIRE(names.size() == record_count);
+      CHECK(ids[12345] == 12345);
+      CHECK(names[12345] == "\"n," + std::to_string(12345 % 11) + "\"");
+      CHECK(speeds[12345] == 12345 % 100);
+      CHECK(std::accumulate(ids.begin(), ids.end(), int64_t{0}) == static_cast<int64_t>(record_count * (record_count - 1) / 2));
+    };
+
+    std::error_code error;
+    {
+      CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> links;
+      REQUIRE(links.open(path, error));
+      CHECK(links.rebuilt());
+      check_columns(links);
+    }
+
+    {
+      CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> links;
+      REQUIRE(links.open(path, error));
+      CHECK(!links.rebuilt());
+      check_columns(links);
+    }
+
+    // Another schema does not take the cache of this one.
+    {
+      CsvCache<Field<NAME("id"), int64_t>, Skip<NAME("name")>, Field<NAME("speed"), float>> links;
+      REQUIRE(links.open(path, error));
+      CHECK(links.rebuilt());
+      CHECK(links.column<2>()[99] == 99.0f);
+    }
+
+    // Nor does a header line that does not match the schema.
+    {
+      CsvCache<Field<NAME("link_id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>> links;
+      CHECK(!links.open(path, error));
+      CHECK(error == std::errc::invalid_argument);
+    }
+
+    std::filesystem::remove(cache);
+  }
+
+  SUBCASE("test csv cache reparses only the chunks changed since it was built") {
+    using Cache = CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Field<NAME("speed"), double>>;
+    const auto edited = "test-csv-edited";
+    const auto fresh = std::string{"test-csv-edited.fresh.wxc"};
+
+    auto make_csv = [](const size_t a_count, const size_t a_edited, const std::string &a_name) {
+      std::string text = "id,name,speed\n";
+      for (size_t i = 0; i < a_count; ++i)
+        text.append(std::to_string(i)).append(",\"").append(i == a_edited ? a_name : "n," + std::to_string(i % 11)).append("\",").append(std::to_string(i % 100)).append("\n");
+      return text;
+    };
+    auto write = [&](const std::string &a_text) {
+      std::ofstream out(edited, std::ios::binary | std::ios::trunc);
+      out << a_text;
+    };
+    auto check_same = [&](const Cache &a_cache) {
+      Cache expected;
+      std::error_code error;
+      std::filesystem::remove(fresh);
+      REQUIRE(expected.open(edited, fresh, error));
+      REQUIRE(a_cache.size() == expected.size());
+      auto mismatches = size_t{0};
+      for (size_t i = 0; i < a_cache.size(); i++)
+        mismatches += a_cache.column<0>()[i] != expected.column<0>()[i] || a_cache.column<1>()[i] != expected.column<1>()[i]
+                   || a_cache.column<2>()[i] != expected.column<2>()[i];
+      CHECK(mismatches == 0);
+    };
+
+    const auto count = size_t{200000};
+    const auto original = make_csv(count, count, {});
+    write(original);
+    std::filesystem::remove(Cache::default_cache(edited));
+
+    std::error_code error;
+    {
+      Cache links;
+      REQUIRE(links.open(edited, error));
+      CHECK(links.rebuilt());
+      CHECK(links.reparsed() == original.size() - std::strlen("id,name,speed\n"));
+    }
+
+    // An edit of one record, with a quoted `\n`, changes the chunks around it only.
+    const auto changed = make_csv(count, count / 2, "a much longer name,\nover two lines");
+    write(changed);
+    {
+      Cache links;
+      REQUIRE(links.open(edited, error));
+      CHECK(links.rebuilt());
+      CHECK(links.reparsed() > 0);
+      CHECK(links.reparsed() < changed.size() / 8);
+      CHECK(links.column<1>()[count / 2] == "\"a much longer name,\nover two lines\"");
+      check_same(links);
+    }
+
+    // So does a record inserted at the front, which moves every other one.
+    write("id,name,speed\n-1,\"first\",0\n" + changed.substr(std::strlen("id,name,speed\n")));
+    {
+      Cache links;
+      REQUIRE(links.open(edited, error));
+      CHECK(links.reparsed() < changed.size() / 8);
+      CHECK(links.column<0>()[0] == -1);
+      check_same(links);
+
+      Cache again;
+      REQUIRE(again.open(edited, error));
+      CHECK(!again.rebuilt());
+      CHECK(again.reparsed() == 0);
+    }
+
+    std::filesystem::remove(edited);
+    std::filesystem::remove(Cache::default_cache(edited));
+    std::filesystem::remove(fresh);
+  }
+
+  SUBCASE("test csv cache scans only the chunks its zone maps and bloom filters may match") {
+    using Cache = CsvCache<Field<NAME("id"), int64_t>, QuotedField<NAME("name")>, Skip<NAME("note")>, Field<NAME("time"), double>>;
+    const auto keyed = "test-csv-keyed";
+    const auto count = int64_t{200000};
+
+    // The ids are a permutation, so that only the filters can tell the chunks apart.
+    auto id_of = [count](const int64_t i) { return i * 7919 % count; };
+    {
+      std::ofstream out(keyed, std::ios::binary | std::ios::trunc);
+      out << "id,name,note,time\n";
+      for (int64_t i = 0; i < count; ++i) out << id_of(i) << ",\"k" << i << "\",x," << i << ".5\n";
+    }
+    std::filesystem::remove(Cache::default_cache(keyed));
+
+    std::error_code error;
+    Cache links;
+    links.key_fields = {0, 1};
+    REQUIRE(links.open(keyed, error));
+    CHECK(links.rebuilt());
+    REQUIRE(links.chunk_count() > 20);
+
+    auto records = size_t{0};
+    for (size_t c = 0; c < links.chunk_count(); c++) {
+      const auto [first, n] = links.chunk_records(c);
+      CHECK(first == records);
+      records += n;
+      const auto [low, high] = links.zone<3>(c);
+      CHECK(low == static_cast<double>(first) + 0.5);
+      CHECK(high == static_cast<double>(first + n - 1) + 0.5);
+    }
+    CHECK(records == static_cast<size_t>(count));
+
+    // A time range is found in the chunks of its zone maps only.
+    auto found = size_t{0};
+    auto scanned = links.scan([&](const size_t a_first, const size_t a_count) {
+      for (auto i = a_first; i < a_first + a_count; i++) found += links.column<3>()[i] >= 1000.0 && links.column<3>()[i] <= 1500.0;
+    }, links.between<3>(1000.0, 1500.0));
+    CHECK(found == 500);
+    CHECK(scanned <= 2);
+
+    // So are keys, by the filters, with few false positives.
+    const auto ids = std::vector<int64_t>{id_of(17), id_of(99999), id_of(count - 1)};
+    auto matches = std::vector<size_t>{};
+    scanned = links.scan([&](const size_t a_first, const size_t a_count) {
+      for (auto i = a_first; i < a_first + a_count; i++)
+        if (std::find(ids.begin(), ids.end(), links.column<0>()[i]) != ids.end()) matches.push_back(i);
+    }, links.any_of<0>(ids));
+    CHECK(matches == std::vector<size_t>{17, 99999, static_cast<size_t>(count - 1)});
+    CHECK(scanned <= 4);
+
+    const auto names = std::vector<std::string_view>{"\"k123\"", "\"k123456\""};
+    auto name_chunks = size_t{0};
+    links.scan([&](const size_t a_first, const size_t a_count) {
+      for (auto i = a_first; i < a_first + a_count; i++) name_chunks += links.column<1>()[i] == names[0] || links.column<1>()[i] == names[1];
+    }, links.any_of<1>(names), links.between<3>(0.0, 1000.0));
+    CHECK(name_chunks == 1);
+
+    auto false_positives = size_t{0};
+    for (size_t c = 0; c < links.chunk_count(); c++) false_positives += links.may_contain<1>(c, "\"missing\"") + links.may_contain<0>(c, -1);
+    CHECK(false_positives <= 2);
+
+    // The dispatched probe agrees with the scalar one.
+    auto filter = std::vector<mio::BloomBlock>(mio::bloom_block_count(1000));
+    for (uint64_t h = 0; h < 1000; h++) mio::bloom_insert(filter, h * 0x9E3779B97F4A7C15ull);
+    auto disagreements = size_t{0};
+    for (uint64_t h = 0; h < 4000; h++) {
+      const auto hash = h * 0x9E3779B97F4A7C15ull;
+      disagreements += mio::bloom_contains(filter, hash) != mio::detail::scalar_bloom_contains(filter[mio::detail::bloom_block(hash, filter.size())], hash);
+      disagreements += h < 1000 && !mio::bloom_contains(filter, hash);
+    }
+    CHECK(disagreements == 0);
+
+    // Other key fields rebuild the cache, without filters of the fields no longer keyed.
+    Cache unkeyed;
+    REQUIRE(unkeyed.open(keyed, error));
+    CHECK(unkeyed.rebuilt());
+    CHECK(unkeyed.scan([](size_t, size_t) {}, unkeyed.any_of<0>(ids)) == unkeyed.chunk_count());
+    Cache again;
+    REQUIRE(again.open(keyed, error));
+    CHECK(!again.rebuilt());
+
+    // Skipped fields cannot be keys.
+    again.key_fields = {2};
+    CHECK(!again.open(keyed, error));
+    CHECK(error == std::errc::invalid_argument);
+
+    links.close();
+    unkeyed.close();
+    std::filesystem::remove(keyed);
+    std::filesystem::remove(Cache::default_cache(keyed));
+  }
+}
+
+TEST_CASE("csvwriter")
+{
+  using namespace mio::csv;
+  using namespace std::literals;
+
+  using Writer = CsvWriter<
+      Field<NAME("id"), int64_t>,
+      QuotedField<NAME("name")>,
+      Field<NAME("volume"), double>,
+      Field<NAME("oneway"), bool>
+  >;
+
+  auto path = "test-csv-out";
+
+  SUBCASE("test format_field formats values with to_chars") {
+    std::string out;
+    format_field(out, int64_t{-42});
+    out.push_back(',');
+    format_field(out, 0.1);
+    out.push_back(',');
+    format_field(out, true);
+    CHECK(out == "-42,0.1,1");
+  }
+
+  SUBCASE("test write_row quotes quoted fields") {
+    Writer::Segment segment;
+    segment.write_header();
+    segment.write_row(1, "a,\"b\"", 2.5, false);
+    segment.write_row(2, "\"kept\"", 3, true);
+    segment.write_row(3, "\"a\",\"b\"", 1, true);
+    CHECK(segment.data == "id,name,volume,oneway\n1,\"a,\"\"b\"\"\",2.5,0\n2,\"\"\"kept\"\"\",3,1\n3,\"\"\"a\"\",\"\"b\"\"\",1,1\n");
+  }
+
+  SUBCASE("test write_raw_row keeps quoted fields as read") {
+    Writer::Segment segment;
+    segment.write_raw_row(1, "\"kept, as is\"", 2.5, false);
+    segment.write_raw_row(2, "bare", 3, true);
+    CHECK(segment.data == "1,\"kept, as is\",2.5,0\n2,\"bare\",3,1\n");
+
+    Writer::Record rec;
+    get<0>(rec).data = 3;
+    get<1>(rec).data = "\"x\""sv;
+    segment.clear();
+    segment.write_raw(rec);
+    segment.write(rec);
+    CHECK(segment.data == "3,\"x\",0,0\n3,\"\"\"x\"\"\",0,0\n");
+  }
+
+  SUBCASE("test segments written in parallel are stitched in order") {
+    const auto rows = size_t{40000};
+    {
+      Writer writer(path, 4096);
+      REQUIRE(writer.is_open());
+      writer.write_header();
+
+      std::vector<Writer::Segment> segments(4);
+      std::vector<std::future<void>> futures;
+      for (size_t t = 0; t < segments.size(); t++)
+        futures.push_back(std::async(std::launch::async, [&, t]() {
+          for (auto i = t * rows / 4; i < (t + 1) * rows / 4; i++)
+            segments[t].write_row(static_cast<int64_t>(i), "n" + std::to_string(i % 10), static_cast<double>(i) / 4, i % 2 == 0);
+        }));
+      for (auto &f : futures) f.get();
+      for (auto &segment : segments) writer.append(segment);
+
+      std::error_code error;
+      writer.close(error);
+      CHECK(!error);
+      CHECK(!writer.is_open());
+    }
+
+    CsvReader<
+        Field<NAME("id"), int64_t>,
+        QuotedField<NAME("name")>,
+        Field<NAME("volume"), double>,
+        Field<NAME("oneway"), bool>
+    > reader(path);
+    REQUIRE(std::get<0>(reader.verify_header()));
+
+    std::vector<int64_t> ids(rows, -1);
+    std::atomic<size_t> bad{0};
+    auto n = reader.read([&](int, auto a_records) {
+      for (const auto &rec : a_records) {
+        const auto id = get<0>(rec).data;
+        ids[id] = id;
+        bad += get<2>(rec).data != static_cast<double>(id) / 4 || get<3>(rec).data != (id % 2 == 0)
+            || get<1>(rec).data != "\"n" + std::to_string(id % 10) + "\"";
+      }
+      return 0;
+    }, 4, 10000);
+
+    CHECK(n == rows);
+    CHECK(bad == 0);
+    CHECK(std::count(ids.begin(), ids.end(), -1) == 0);
+    CHECK(std::filesystem::file_size(path) == mio::StringReaderAsync(path).content().size());
+  }
+
+  SUBCASE("test records are written directly through the staging buffer") {
+    {
+      Writer writer(path, 4096);
+      Writer::Record rec;
+      for (int64_t i = 0; i < 100000; i++) {
+        get<0>(rec).data = i;
+        get<1>(rec).data = "x"sv;
+        writer.write(rec);
+      }
+      size_t expected = 0;
+      for (int64_t i = 0; i < 100000; i++) expected += std::to_string(i).size() + 9;
+      CHECK(writer.size() == expected);
+    }
+
+    CHECK(std::filesystem::file_size(path) > 0);
+    std::ifstream in(path);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(in, line)) lines += line == std::to_string(lines) + ",\"x\",0,0";
+    CHECK(lines == 100000);
+  }
+}
+
+TEST_CASE("mappedbuffer")
+{
+  struct Link
+  {
+    int64_t id;
+    std::string name;
+    std::vector<double> volumes;
+  };
+
+  auto path = "test-mapped-buffer";
+
+  SUBCASE("test resize past the mapping grows the file and keeps the bytes") {
+    {
+      mio::MappedBuffer buffer(path, 4096);
+      REQUIRE(buffer.is_open());
+      CHECK(buffer.size() == 0);
+      CHECK(buffer.capacity() >= 4096);
+
+      buffer.resize(3);
+      std::memcpy(buffer.data(), "abc", 3);
+      buffer.resize(buffer.capacity() + 1);
+      CHECK(buffer.capacity() > 4096);
+      CHECK(std::string_view(buffer.data(), 3) == "abc");
+
+      buffer.resize(2);
+      std::error_code error;
+      buffer.close(error);
+      CHECK(!error);
+      CHECK(!buffer.is_open());
+    }
+
+    CHECK(std::filesystem::file_size(path) == 2);
+  }
+
+  SUBCASE("test zpp_bits out writes into the file and in reads it back zero-copy") {
+    const auto count = 20000;
+    {
+      mio::MappedBuffer buffer(path, 4096);
+      zpp::bits::out out{buffer};
+      auto failed = 0;
+      for (int64_t i = 0; i < count; i++)
+        failed += zpp::bits::failure(out(Link{i, "link-" + std::to_string(i), std::vector<double>(i % 7, 0.5)}));
+      CHECK(failed == 0);
+      CHECK(buffer.size() == out.position());
+    }
+
+    std::error_code error;
+    auto source = mio::make_mmap_source(std::string(path), error);
+    REQUIRE(!error);
+    zpp::bits::in in{source};
+
+    auto bad = 0;
+    for (int64_t i = 0; i < count; i++) {
+      Link link;
+      bad += zpp::bits::failure(in(link)) || link.id != i || link.name != "link-" + std::to_string(i) || link.volumes != std::vector<double>(i % 7, 0.5);
+    }
+    CHECK(bad == 0);
+    CHECK(in.position() == source.size());
+
+    // views of the bytes point into the mapping
+    in.reset();
+    int64_t id;
+    std::string_view name;
+    REQUIRE(zpp::bits::success(in(id, name)));
+    CHECK(name == "link-0");
+    CHECK(name.data() >= source.data());
+    CHECK(name.data() < source.data() + source.size());
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("windowreader")
+{
+  // Lines of varying length, some longer than a page, and the last one not terminated.
+  std::vector<std::string> lines;
+  std::string buffer;
+  for (size_t i = 0; i < 3000; ++i) {
+    lines.push_back(std::string(i % 7 == 0 ? (i * 13) % 9000 : i % 97, 'x') + std::to_string(i));
+    buffer.append(lines.back()).push_back('\n');
+  }
+  buffer.pop_back();
+
+  auto path = "test-window-lines";
+  std::ofstream file(path);
+  file << buffer;
+  file.close();
+
+  SUBCASE("test getline reads every line across window edges") {
+    mio::WindowedStringReader reader(path, mio::page_size());
+    REQUIRE(reader.is_mapped());
+
+    size_t i = 0;
+    bool same = true;
+    while (!reader.eof()) {
+      auto line = reader.getline();
+      same = same && i < lines.size() && line == lines[i];
+      i++;
+    }
+
+    CHECK(same);
+    CHECK(i == lines.size());
+    CHECK(reader.offset() == buffer.size());
+    CHECK(reader.window_size() >= 9000);
+    CHECK(reader.getline().data() == nullptr);
+  }
+
+  SUBCASE("test getline with batch and line callbacks") {
+    for (auto window : {mio::page_size(), mio::WindowedStringReader::default_window_size}) {
+      mio::WindowedStringReader batch_reader(path, window);
+      size_t i = 0;
+      bool same = true;
+      auto n = batch_reader.getline([&](std::span<const std::string_view> a_lines) {
+        for (auto line : a_lines) same = same && line == lines[i++];
+        return 0;
+      });
+      CHECK(same);
+      CHECK(n == lines.size());
+
+      mio::WindowedStringReader line_reader(path, window);
+      size_t bytes = 0;
+      n = line_reader.getline([&](std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      });
+      CHECK(n == lines.size());
+      CHECK(bytes == buffer.size() + 1);
+    }
+  }
+
+  SUBCASE("test getline stops on non-zero status") {
+    mio::WindowedStringReader reader(path, mio::page_size());
+    size_t calls = 0;
+    auto n = reader.getline([&](std::string_view) { return ++calls == 10 ? 1 : 0; });
+    CHECK(n == 9);
+  }
+
+  SUBCASE("test empty file and missing file") {
+    std::ofstream empty("test-window-empty");
+    empty.close();
+
+    mio::WindowedStringReader reader("test-window-empty", mio::page_size());
+    CHECK(reader.is_mapped());
+    CHECK(reader.eof());
+    CHECK(reader.getline().data() == nullptr);
+    std::filesystem::remove("test-window-empty");
+
+    CHECK_THROWS_AS(mio::WindowedStringReader("test-window-missing"), std::system_error);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("streamreader")
+{
+  // Lines of varying length, some longer than a buffer, and the last one not terminated.
+  std::vector<std::string> lines;
+  std::string buffer;
+  for (size_t i = 0; i < 3000; ++i) {
+    lines.push_back(std::string(i % 7 == 0 ? (i * 13) % 9000 : i % 97, 'x') + std::to_string(i));
+    buffer.append(lines.back()).push_back('\n');
+  }
+  buffer.pop_back();
+
+  auto path = "test-stream-lines";
+  std::ofstream file(path);
+  file << buffer;
+  file.close();
+
+  const auto small = mio::page_size();
+  const auto variants = std::vector<mio::StreamOptions>{
+      {},
+      {.buffer_size = small, .queue_depth = 1},
+      {.buffer_size = small, .queue_depth = 3, .direct = true},
+      {.backend = mio::IoBackend::Blocking, .buffer_size = small, .queue_depth = 2},
+  };
+
+  SUBCASE("test getline reads every line across buffers") {
+    for (const auto &options : variants) {
+      mio::StreamingStringReader reader(path, options);
+      REQUIRE(reader.is_mapped());
+      CHECK(reader.backend() != mio::IoBackend::Automatic);
+
+      size_t i = 0;
+      bool same = true;
+      while (!reader.eof()) {
+        auto line = reader.getline();
+        same = same && i < lines.size() && line == lines[i];
+        i++;
+      }
+
+      CHECK(same);
+      CHECK(i == lines.size());
+      CHECK(reader.getline().data() == nullptr);
+    }
+  }
+
+  SUBCASE("test getline with batch and line callbacks") {
+    for (const auto &options : variants) {
+      mio::StreamingStringReader batch_reader(path, options);
+      size_t i = 0;
+      bool same = true;
+      auto n = batch_reader.getline([&](std::span<const std::string_view> a_lines) {
+        for (auto line : a_lines) same = same && line == lines[i++];
+        return 0;
+      });
+      CHECK(same);
+      CHECK(n == lines.size());
+
+      mio::StreamingStringReader line_reader(path, options);
+      size_t bytes = 0;
+      n = line_reader.getline([&](std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      });
+      CHECK(n == lines.size());
+      CHECK(bytes == buffer.size() + 1);
+    }
+  }
+
+  SUBCASE("test async_getline with line and batch callbacks") {
+    for (const auto &options : variants) {
+      mio::StreamingStringReader line_reader(path, options);
+      std::atomic<size_t> bytes{0};
+      auto n = line_reader.async_getline([&](int, std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      }, 4);
+      CHECK(n == lines.size());
+      CHECK(bytes == buffer.size() + 1);
+
+      // Read the first lines synchronously, the rest asynchronously.
+      mio::StreamingStringReader batch_reader(path, options);
+      for (int i = 0; i < 10; i++) batch_reader.getline();
+      std::atomic<size_t> count{0};
+      n = batch_reader.async_getline([&](int, std::span<const std::string_view> a_lines) {
+        count += a_lines.size();
+        return 0;
+      }, 3);
+      CHECK(n == lines.size() - 10);
+      CHECK(count == n);
+      CHECK(batch_reader.eof());
+    }
+  }
+
+  SUBCASE("test async_getline stops on non-zero status") {
+    mio::StreamingStringReader reader(path, variants[1]);
+    auto n = reader.async_getline([](int, std::string_view a_line) { return a_line.ends_with("100") ? 1 : 0; }, 2);
+    CHECK(n < lines.size());
+  }
+
+  SUBCASE("test empty file and missing file") {
+    std::ofstream empty("test-stream-empty");
+    empty.close();
+
+    mio::StreamingStringReader reader("test-stream-empty");
+    CHECK(reader.eof());
+    CHECK(reader.getline().data() == nullptr);
+    CHECK(reader.async_getline([](int, std::string_view) { return 0; }, 2) == 0);
+    std::filesystem::remove("test-stream-empty");
+
+    CHECK_THROWS_AS(mio::StreamingStringReader("test-stream-missing"), std::system_error);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("decompressreader")
+{
+  std::string buffer;
+  for (size_t i = 0; i < 20000; ++i) buffer.append(std::string(i % 61, 'x')).append(std::to_string(i)).push_back('\n');
+
+  auto write_file = [](const char *a_path, std::string_view a_content) {
+    std::ofstream file(a_path, std::ios::binary);
+    file.write(a_content.data(), static_cast<std::streamsize>(a_content.size()));
+  };
+
+  const auto small = mio::DecodeOptions{.buffer_size = 1000, .queue_depth = 2};
+
+  SUBCASE("test uncompressed files are read as is") {
+    write_file("test-decode-plain", buffer);
+    for (const auto &options : {mio::DecodeOptions{}, small}) {
+      mio::DecompressingStringReader reader("test-decode-plain", options);
+      std::string content;
+      while (!reader.eof()) content.append(reader.getline()).push_back('\n');
+      CHECK(content == buffer);
+    }
+    std::filesystem::remove("test-decode-plain");
+  }
+
+  SUBCASE("test unsupported formats and empty files") {
+    write_file("test-decode-lz4", "\x04\x22\x4d\x18 not really lz4\n");
+    mio::DecompressingStringReader reader("test-decode-lz4");
+    CHECK(reader.getline().data() == nullptr);
+    CHECK(reader.error() == std::errc::not_supported);
+    std::filesystem::remove("test-decode-lz4");
+
+    write_file("test-decode-empty", "");
+    mio::DecompressingStringReader empty("test-decode-empty");
+    CHECK(empty.eof());
+    CHECK(empty.getline().data() == nullptr);
+    std::filesystem::remove("test-decode-empty");
+
+    CHECK_THROWS_AS(mio::DecompressingStringReader("test-decode-missing"), std::system_error);
+  }
+
+#ifdef WXLIB_MIO_WITH_ZLIB
+  // Two gzip members, as written by pigz, or by concatenating .gz files.
+  auto gzip = [](std::string_view a_content) {
+    std::string out(compressBound(static_cast<uLong>(a_content.size())) + 64, '\0');
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(a_content.data()));
+    stream.avail_in = static_cast<uInt>(a_content.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+  };
+
+  const auto half = buffer.find('\n', buffer.size() / 2) + 1;
+  const auto compressed = gzip(std::string_view{buffer}.substr(0, half)) + gzip(std::string_view{buffer}.substr(half));
+
+  SUBCASE("test gzip files are decoded in a pipeline") {
+    write_file("test-decode-gz", compressed);
+    for (const auto &options : {mio::DecodeOptions{}, small}) {
+      mio::DecompressingStringReader reader("test-decode-gz", options);
+      std::string content;
+      while (!reader.eof()) content.append(reader.getline()).push_back('\n');
+      CHECK(content == buffer);
+
+      mio::DecompressingStringReader async_reader("test-decode-gz", options);
+      std::atomic<size_t> bytes{0};
+      auto n = async_reader.async_getline([&](int, std::string_view a_line) {
+        bytes += a_line.size() + 1;
+        return 0;
+      }, 4);
+      CHECK(n == 20000);
+      CHECK(bytes == buffer.size());
+    }
+    std::filesystem::remove("test-decode-gz");
+  }
+
+  SUBCASE("test truncated gzip files stop with an error") {
+    write_file("test-decode-truncated", std::string_view{compressed}.substr(0, compressed.size() / 4));
+    mio::DecompressingStringReader reader("test-decode-truncated", small);
+    auto n = reader.getline([](std::string_view) { return 0; });
+    CHECK(n < 20000);
+    CHECK(reader.error() == std::errc::io_error);
+    std::filesystem::remove("test-decode-truncated");
+  }
+#endif
+}
+
+TEST_CASE("datasetreader")
+{
+  const auto directory = std::filesystem::path{"test-dataset"};
+  std::filesystem::create_directories(directory);
+
+  // Five daily files of uneven sizes, the last one not terminated by `\n`, plus an empty one.
+  auto expected_bytes = size_t{0};
+  auto expected_lines = size_t{0};
+  for (size_t day = 1; day <= 5; ++day) {
+    std::ofstream file(directory / ("2022-01-0" + std::to_string(day) + ".csv"), std::ios::binary);
+    for (size_t i = 0; i < day * 1000; ++i) {
+      const auto line = std::to_string(day) + "," + std::string(i % 37, 'x') + std::to_string(i);
+      file << line;
+      if (day != 5 || i + 1 != day * 1000) file << '\n';
+      expected_bytes += line.size();
+      expected_lines++;
+    }
+  }
+  std::ofstream{directory / "2022-01-06.csv"};
+  std::ofstream{directory / "notes.txt"} << "not part of the dataset\n";
+
+  auto reader = mio::DatasetReader::glob(directory, "2022-01-0?.csv");
+  REQUIRE(reader.files().size() == 6);
+  CHECK(reader.files().front().ends_with("2022-01-01.csv"));
+
+  SUBCASE("test lines of all files are read with their file ids") {
+    std::atomic<size_t> bytes{0};
+    std::array<std::atomic<size_t>, 6> lines_per_file{};
+    std::atomic<bool> mismatched{false};
+    auto n = reader.read([&](int, const mio::DatasetChunk &a_chunk, std::span<const std::string_view> a_lines) {
+      for (auto line : a_lines) {
+        if (line.front() - '0' != static_cast<int>(a_chunk.file_id + 1)) mismatched = true;
+        bytes += line.size();
+      }
+      lines_per_file[a_chunk.file_id] += a_lines.size();
+      return 0;
+    }, 4, 2, 4096);
+
+    CHECK(n == expected_lines);
+    CHECK(bytes == expected_bytes);
+    CHECK_FALSE(mismatched);
+    for (size_t day = 1; day <= 5; ++day) CHECK(lines_per_file[day - 1] == day * 1000);
+    CHECK(lines_per_file[5] == 0);
+    CHECK_FALSE(reader.error());
+  }
+
+  SUBCASE("test chunks are newline aligned and cover each file") {
+    std::mutex mutex;
+    std::vector<std::vector<std::pair<size_t, size_t>>> ranges(6);
+    auto n = reader.read([&](int, const mio::DatasetChunk &a_chunk) {
+      std::scoped_lock lock{mutex};
+      ranges[a_chunk.file_id].emplace_back(a_chunk.offset, a_chunk.text.size());
+      return 0;
+    }, 3, 1, 1000);
+
+    auto chunks = size_t{0};
+    for (size_t id = 0; id < 5; ++id) {
+      std::sort(ranges[id].begin(), ranges[id].end());
+      auto end = size_t{0};
+      for (const auto &[offset, size] : ranges[id]) CHECK(offset == end), end += size;
+      CHECK(end == std::filesystem::file_size(reader.files()[id]));
+      chunks += ranges[id].size();
+    }
+    CHECK(n == chunks);
+  }
+
+  SUBCASE("test a non-zero status code stops all workers") {
+    std::atomic<size_t> calls{0};
+    auto n = reader.read([&](int, const mio::DatasetChunk &) { return ++calls == 3 ? 1 : 0; }, 2, 2, 1000);
+    CHECK(n <= 3);
+  }
+
+  SUBCASE("test missing files are skipped with an error") {
+    auto files = reader.files();
+    files.insert(files.begin() + 1, (directory / "missing.csv").string());
+    mio::DatasetReader dataset(files);
+    auto n = dataset.read([](int, const mio::DatasetChunk &, std::span<const std::string_view>) { return 0; }, 2);
+    CHECK(n == expected_lines);
+    CHECK(dataset.error());
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("tailreader")
+{
+  auto append = [](std::string_view a_content) {
+    std::ofstream file("test-tail", std::ios::binary | std::ios::app);
+    file.write(a_content.data(), static_cast<std::streamsize>(a_content.size()));
+  };
+  std::ofstream{"test-tail"} << "old 1\nold 2\n";
+
+  SUBCASE("test only complete lines are read") {
+    mio::TailingStringReader reader("test-tail");
+    std::vector<std::string> lines;
+    auto on_line = [&](std::string_view a_line) { lines.emplace_back(a_line); return 0; };
+
+    CHECK(reader.getline(on_line) == 2);
+    append("new 1\nnew");
+    CHECK(reader.getline(on_line) == 1);
+    CHECK(reader.offset() == 18);
+    append(" 2\n");
+    CHECK(reader.getline(on_line) == 1);
+    CHECK(reader.getline(on_line) == 0);
+    CHECK(lines == std::vector<std::string>{"old 1", "old 2", "new 1", "new 2"});
+
+    // A truncated file is read again from the start.
+    std::ofstream{"test-tail"} << "rotated\n";
+    CHECK(reader.getline([&](std::span<const std::string_view> a_lines) {
+      for (auto line : a_lines) lines.emplace_back(line);
+      return 0;
+    }) == 1);
+    CHECK(lines.back() == "rotated");
+  }
+
+  SUBCASE("test lines appended by another thread are followed") {
+    mio::TailingStringReader reader("test-tail", true);
+#ifdef __linux__
+    CHECK(reader.is_notified());
+#endif
+    std::thread writer([&] {
+      for (int i = 0; i < 100; ++i) {
+        append(std::to_string(i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        append("\n");
+      }
+    });
+
+    std::vector<std::string> lines;
+    auto n = reader.follow([&](std::string_view a_line) {
+      lines.emplace_back(a_line);
+      return lines.size() == 100 ? 1 : 0;
+    }, std::chrono::seconds(10));
+    writer.join();
+
+    CHECK(n == 99);
+    REQUIRE(lines.size() == 100);
+    for (int i = 0; i < 100; ++i) CHECK(lines[i] == std::to_string(i));
+    CHECK_FALSE(reader.error());
+  }
+
+  SUBCASE("test following stops on idle timeouts and stop()") {
+    mio::TailingStringReader reader("test-tail");
+    auto on_line = [](std::string_view) { return 0; };
+    CHECK(reader.follow(on_line, std::chrono::milliseconds(20)) == 2);
+
+    std::thread stopper([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      reader.stop();
+    });
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(reader.follow(on_line) == 0);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    stopper.join();
+  }
+
+  std::filesystem::remove("test-tail");
+}
+
+TEST_CASE("stringpool")
+{
+  SUBCASE("test equal strings are interned once") {
+    mio::StringPool pool;
+    std::string a = "LINK_TYPE_1", b = "LINK_TYPE_1";
+    auto x = pool.intern(a);
+    auto y = pool.intern(b);
+    CHECK(x == y);
+    CHECK(x.view.data() == y.view.data());
+    CHECK(x.view.data() != a.data());
+    a.assign("overwritten");
+    CHECK(pool.view(x.id) == "LINK_TYPE_1");
+
+    CHECK(pool.intern("").view.empty());
+    const auto large = std::string(mio::StringPool::block_size * 2, 'z');
+    CHECK(pool.intern(large).view == large);
+    CHECK(pool.size() == 3);
+    CHECK(pool.arena_size() >= large.size());
+  }
+
+  SUBCASE("test threads intern through caches into dense ids") {
+    mio::StringPool pool;
+    const auto distinct = 5000;
+    std::vector<std::vector<mio::InternedString>> interned(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+      threads.emplace_back([&, t] {
+        mio::StringPool::Cache cache{pool};
+        for (int round = 0; round < 3; ++round)
+          for (int i = 0; i < distinct; ++i) {
+            const auto value = "zone_" + std::to_string((i * 7 + t) % distinct);
+            const auto s = cache.intern(value);
+            if (round == 2) interned[t].push_back(s);
+          }
+      });
+    for (auto &thread : threads) thread.join();
+
+    CHECK(pool.size() == static_cast<size_t>(distinct));
+    auto ids = std::vector<bool>(distinct, false);
+    auto consistent = true;
+    for (const auto &strings : interned)
+      for (const auto &s : strings) {
+        consistent &= s.id < static_cast<uint32_t>(distinct) && pool.view(s.id) == s.view;
+        if (s.id < static_cast<uint32_t>(distinct)) ids[s.id] = true;
+      }
+    CHECK(consistent);
+    CHECK(std::all_of(ids.begin(), ids.end(), [](bool a_seen) { return a_seen; }));
+    CHECK(interned[0][0] == pool.intern(interned[0][0].view));
+  }
+}
+
+TEST_CASE("wkt")
+{
+  using namespace mio::csv;
+  using namespace std::literals;
+
+  SUBCASE("test numbers parse as from_chars does") {
+    std::mt19937_64 rng(42);
+    auto mismatches = 0;
+    char text[64];
+    for (int i = 0; i < 100000; i++) {
+      const auto value = std::ldexp(static_cast<double>(rng() >> 11), static_cast<int>(rng() % 80) - 60) * (i % 2 ? -1 : 1);
+      const auto n = i % 3 ? std::snprintf(text, sizeof(text), "%.*f", static_cast<int>(rng() % 12), value)
+                           : std::snprintf(text, sizeof(text), "%.17g", value);
+      double parsed = 0, expected = 0;
+      const char *end = parse_wkt_number(text, text + n, parsed);
+      std::from_chars(text, text + n, expected);
+      mismatches += end != text + n || parsed != expected;
+    }
+    CHECK(mismatches == 0);
+
+    for (const auto valid : {"0"sv, "+1.5"sv, "-0.000000000000000000000000123"sv, "12345678901234567890123"sv, "1e5"sv, "2.5E-3"sv, "7."sv}) {
+      double parsed = 0, expected = 0;
+      CHECK(parse_wkt_number(valid.data(), valid.data() + valid.size(), parsed) == valid.data() + valid.size());
+      std::from_chars(valid.data() + (valid.front() == '+'), valid.data() + valid.size(), expected);
+      CHECK(parsed == expected);
+    }
+
+    double parsed = 0;
+    const auto partial = "3e,"sv;
+    CHECK(parse_wkt_number(partial.data(), partial.data() + partial.size(), parsed) == partial.data() + 1);
+    for (const auto invalid : {""sv, "-"sv, "."sv, "x"sv})
+      CHECK(parse_wkt_number(invalid.data(), invalid.data() + invalid.size(), parsed) == invalid.data());
+  }
+
+  SUBCASE("test geometries are parsed into flat coordinates") {
+    WktGeometries<> geometries;
+    CHECK(geometries.append("\"LINESTRING (-83.0451 42.3314, -83.0452 42.3315,-83.0453 42.3316)\""sv));
+    CHECK(geometries.append("point z (1 2 3)"sv));
+    CHECK(geometries.append("POLYGON ((0 0, 4 0, 4 4, 0 0), (1 1, 2 1, 2 2, 1 1))"sv));
+    CHECK(geometries.append("MULTIPOLYGON (((0 0, 1 0, 0 0)), ((5 5, 6 5, 5 5), (7 7, 8 7, 7 7)))"sv));
+    CHECK(geometries.append("MULTIPOINT ((1 2), (3 4))"sv));
+    CHECK(geometries.append("LINESTRING EMPTY"sv));
+    CHECK_FALSE(geometries.append("LINESTRING (1 2, 3)"sv));
+    CHECK_FALSE(geometries.append("CIRCLE (1 2)"sv));
+    CHECK_FALSE(geometries.append("\"POINT (1 2)"sv));
+
+    REQUIRE(geometries.size() == 9);
+    CHECK(geometries.invalid_count() == 3);
+    CHECK(geometries.type(0) == WktType::LineString);
+    CHECK(std::vector<double>(geometries.x(0).begin(), geometries.x(0).end()) == std::vector<double>{-83.0451, -83.0452, -83.0453});
+    CHECK(std::vector<double>(geometries.y(0).begin(), geometries.y(0).end()) == std::vector<double>{42.3314, 42.3315, 42.3316});
+    CHECK(geometries.type(1) == WktType::Point);
+    CHECK(geometries.x(1).size() == 1);
+    CHECK(geometries.y(1)[0] == 2);
+    CHECK(geometries.part_count(2) == 2);
+    CHECK(geometries.x(2, 1).size() == 4);
+    CHECK(geometries.x(2, 1)[1] == 2);
+    CHECK(geometries.part_count(3) == 3);
+    CHECK(geometries.y(3, 2)[0] == 7);
+    CHECK(geometries.part_count(4) == 2);
+    CHECK(geometries.part_count(5) == 0);
+    CHECK(geometries.type(5) == WktType::LineString);
+    for (size_t i = 6; i < 9; i++) {
+      CHECK(geometries.type(i) == WktType::Invalid);
+      CHECK(geometries.x(i).empty());
+    }
+    CHECK(geometries.xs().size() == 3 + 1 + 8 + 9 + 2);
+  }
+
+  SUBCASE("test a column of csv fields is parsed in batch") {
+    CsvDoc<Field<NAME("id"), int64_t>, QuotedField<NAME("WKT")>> csv_doc;
+    std::string block;
+    for (int i = 0; i < 1000; i++)
+      block.append(std::to_string(i)).append(",\"LINESTRING (").append(std::to_string(i)).append(".25 1.5, 2 ").append(std::to_string(-i)).append(".125)\"\n");
+
+    decltype(csv_doc)::Columns columns;
+    REQUIRE(csv_doc.make_columns(block, columns) == 1000);
+
+    WktGeometries<float> links;
+    CHECK(links.append(get<1>(columns)) == 1000);
+    CHECK(links.size() == 1000);
+    CHECK(links.xs().size() == 2000);
+    CHECK(links.x(999)[0] == 999.25f);
+    CHECK(links.y(999)[1] == -999.125f);
+  }
+}
+
+TEST_CASE("externalsort")
+{
+  // Events of 50 vehicles, in random order, with a payload to tell apart equal keys.
+  const auto line_count = size_t{20000};
+  std::mt19937_64 gen{7};
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < line_count; ++i)
+    lines.push_back(std::to_string(gen() % 50) + "," + std::to_string(gen() % 1000) + "," + std::to_string(i));
+
+  auto path = "test-events";
+  auto sorted_path = "test-events-sorted";
+  {
+    std::ofstream file(path);
+    file << "vehicle_id,timestamp,seq\n";
+    for (const auto &line: lines) file << line << '\n';
+  }
+
+  auto key_of = [](const std::string_view a_line) {
+    mio::SortKey<2> key{};
+    const auto first = a_line.find(',');
+    const auto second = a_line.find(',', first + 1);
+    std::from_chars(a_line.data(), a_line.data() + first, key[0]);
+    std::from_chars(a_line.data() + first + 1, a_line.data() + second, key[1]);
+    return key;
+  };
+
+  auto expected = std::string{"vehicle_id,timestamp,seq\n"};
+  auto sorted = lines;
+  std::ranges::stable_sort(sorted, {}, [&](const std::string &a_line) { return key_of(a_line); });
+  for (const auto &line: sorted) expected.append(line).push_back('\n');
+
+  auto read_sorted = [&] {
+    std::ifstream file(sorted_path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+  };
+
+  SUBCASE("test parallel_radix_sort is a stable sort") {
+    std::vector<mio::SortRecord<2>> records;
+    for (size_t i = 0; i < 100000; ++i) records.push_back({{gen() % 7, gen()}, i});
+
+    auto expected_records = records;
+    std::ranges::stable_sort(expected_records, {}, &mio::SortRecord<2>::key);
+
+    std::vector<mio::SortRecord<2>> scratch;
+    mio::parallel_radix_sort(records, scratch, 4);
+    CHECK(std::ranges::equal(records, expected_records, [](const auto &a, const auto &b) { return a.key == b.key && a.offset == b.offset; }));
+  }
+
+  SUBCASE("test external_sort sorts in memory when the input fits one run") {
+    std::error_code error;
+    CHECK(mio::external_sort(path, sorted_path, key_of, error, {.header = true}) == line_count);
+    CHECK(!error);
+    CHECK(read_sorted() == expected);
+  }
+
+  SUBCASE("test external_sort merges the runs spilled under a small memory budget") {
+    std::error_code error;
+    const auto options = mio::ExternalSortOptions{.memory_budget = 64 << 10, .num_threads = 3, .header = true};
+    CHECK(mio::external_sort(path, sorted_path, key_of, error, options) == line_count);
+    CHECK(!error);
+    CHECK(read_sorted() == expected);
+
+    // The runs are removed once merged.
+    CHECK(!std::filesystem::exists(std::string(sorted_path) + ".run0"));
+  }
+
+  SUBCASE("test external_sort terminates an unterminated last line") {
+    {
+      std::ofstream file(path);
+      file << "3\n1\n2";
+    }
+
+    std::error_code error;
+    CHECK(mio::external_sort(path, sorted_path, [](const std::string_view a_line) { return static_cast<unsigned>(a_line[0] - '0'); }, error) == 3);
+    CHECK(read_sorted() == "1\n2\n3\n");
+  }
+
+  SUBCASE("test external_sort reports a missing input") {
+    std::error_code error;
+    CHECK(mio::external_sort("no-such-events", sorted_path, key_of, error) == 0);
+    CHECK(error);
+  }
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(sorted_path);
+}
+
+TEST_CASE("groupby")
+{
+  using namespace mio::csv;
+
+  const auto record_count = size_t{50000};
+  std::string buffer = "link_id,hour,volume\n";
+  for (size_t i = 0; i < record_count; ++i)
+    buffer.append(std::to_string(i % 1000)).append(",").append(std::to_string(i % 24)).append(",").append(std::to_string(i % 17)).append("\n");
+
+  auto path = "test-groupby";
+  std::ofstream file(path, std::ios::binary);
+  file << buffer;
+  file.close();
+
+  // The reductions by key computed one record at a time.
+  struct Expected
+  {
+    size_t count{0};
+    double sum{0}, min{1e9}, max{-1e9};
+  };
+  std::map<uint64_t, Expected> expected;
+  for (size_t i = 0; i < record_count; ++i) {
+    auto &e = expected[(i % 1000) * 24 + i % 24];
+    e.count++;
+    e.sum += static_cast<double>(i % 17);
+    e.min = std::min(e.min, static_cast<double>(i % 17));
+    e.max = std::max(e.max, static_cast<double>(i % 17));
+  }
+
+  auto check_groups = [&](const auto &a_groups) {
+    REQUIRE(a_groups.size() == expected.size());
+    for (const auto &g: a_groups) {
+      const auto &e = expected.at(g.key);
+      CHECK(g.count == e.count);
+      CHECK(g.sum == e.sum);
+      CHECK(g.min == e.min);
+      CHECK(g.max == e.max);
+      CHECK(g.mean() == doctest::Approx(e.sum / e.count));
+    }
+  };
+
+  SUBCASE("test group by link and hour from the batches of a csv reader") {
+    CsvReader<Field<NAME("link_id"), int64_t>, Field<NAME("hour"), int64_t>, Field<NAME("volume"), double>> reader(path);
+    REQUIRE(reader.is_mapped());
+
+    GroupBy<uint64_t, double> volumes(4);
+    auto n = reader.read(volumes.sink([](const auto &a_rec) {
+      return std::pair{get<0>(a_rec).data * 24 + get<1>(a_rec).data, get<2>(a_rec).data};
+    }), 4, 4096);
+
+    CHECK(n == record_count);
+    check_groups(volumes.merge());
+    check_groups(volumes.merge(3));
+
+    volumes.clear();
+    CHECK(volumes.merge().empty());
+  }
+
+  SUBCASE("test group by with one worker adding directly") {
+    GroupBy<int, int> counts(1);
+    for (int i = 0; i < 10000; ++i) counts.add(0, i % 3 - 1, i);
+
+    auto groups = counts.merge();
+    std::ranges::sort(groups, {}, &GroupBy<int, int>::Group::key);
+    REQUIRE(groups.size() == 3);
+    CHECK(groups[0].key == -1);
+    CHECK(groups[0].count == 3334);
+    CHECK(groups[0].min == 0);
+    CHECK(groups[0].max == 9999);
+    CHECK(groups[2].sum == 16665000);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("mmaparray")
+{
+  struct LinkState
+  {
+    int64_t id;
+    float volume;
+    float speed;
+  };
+
+  auto path = "test-mmap-array";
+  const auto count = size_t{10000};
+
+  SUBCASE("test a sink creates, writes and grows a file of records read back in place") {
+    std::error_code error;
+    {
+      mio::mmap_array_sink<LinkState> states;
+      states.create(path, count, error);
+      REQUIRE(!error);
+      REQUIRE(states.size() == count);
+      for (size_t i = 0; i < count; i++) states[i] = {static_cast<int64_t>(i), i * 0.5f, 60.0f};
+
+      states.grow(count + 10, error);
+      REQUIRE(!error);
+      CHECK(states.size() == count + 10);
+      CHECK(states[count - 1].id == static_cast<int64_t>(count - 1));
+      CHECK(states[count + 9].id == 0);
+      states.sync(error);
+      CHECK(!error);
+    }
+
+    CHECK(std::filesystem::file_size(path) == (count + 10) * sizeof(LinkState));
+
+    mio::mmap_array_source<LinkState> states(path);
+    CHECK(states.size() == count + 10);
+    CHECK(states[1234].volume == 617.0f);
+    CHECK(std::ranges::count_if(states, [](const LinkState &a_state) { return a_state.speed == 60.0f; }) == static_cast<long>(count));
+
+    // The chunks cover all the records, once.
+    std::atomic<int64_t> ids{0};
+    std::atomic<size_t> records{0};
+    auto status = states.for_each_chunk(4, [&](int, std::span<const LinkState> a_chunk) {
+      for (const auto &state: a_chunk) ids += state.id;
+      records += a_chunk.size();
+      return 0;
+    });
+    CHECK(status == 0);
+    CHECK(records == count + 10);
+    CHECK(ids == static_cast<int64_t>(count * (count - 1) / 2));
+  }
+
+  SUBCASE("test a range of records is mapped from a record offset") {
+    std::error_code error;
+    {
+      mio::mmap_array_sink<uint32_t> values;
+      values.create(path, count, error);
+      REQUIRE(!error);
+      std::iota(values.begin(), values.end(), uint32_t{0});
+    }
+
+    mio::mmap_array_source<uint32_t> values;
+    values.map(path, 5000, 100, error);
+    REQUIRE(!error);
+    CHECK(values.size() == 100);
+    CHECK(values.span().front() == 5000);
+    CHECK(values.span().back() == 5099);
+  }
+
+  SUBCASE("test a file that is not a whole number of records is rejected") {
+    {
+      std::ofstream file(path, std::ios::binary);
+      file << "0123456789";
+    }
+
+    std::error_code error;
+    mio::mmap_array_source<uint32_t> values;
+    values.map(path, error);
+    CHECK(error == std::errc::invalid_argument);
+    CHECK(!values.is_mapped());
+
+    // The same bytes are a whole number of smaller records.
+    mio::mmap_array_source<uint16_t> halves;
+    halves.map(path, error);
+    CHECK(!error);
+    CHECK(halves.size() == 5);
+
+    CHECK_THROWS_AS(mio::mmap_array_source<uint64_t>{path}, std::system_error);
+  }
+
+  SUBCASE("test records of the other byte order are swapped by load and store") {
+    constexpr auto other = std::endian::native == std::endian::little ? std::endian::big : std::endian::little;
+    std::error_code error;
+    {
+      mio::mmap_array_sink<uint32_t, other> values;
+      values.create(path, 4, error);
+      REQUIRE(!error);
+      values.store(0, 0x01020304u);
+      values.store(3, 7u);
+      CHECK(values.load(0) == 0x01020304u);
+      CHECK(values.load(3) == 7u);
+    }
+
+    mio::mmap_array_source<uint32_t> native(path);
+    CHECK(native[0] == 0x04030201u);
+    mio::mmap_array_source<double, other> doubles;
+    doubles.map(path, error);
+    CHECK(!error);
+    CHECK(doubles.size() == 2);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("hashindex")
+{
+  auto path = "test-hash-index";
+
+  // IDs with gaps, and every 10th one repeated further on.
+  std::mt19937_64 gen{11};
+  std::vector<int64_t> ids;
+  for (int64_t i = 0; i < 200000; i++) ids.push_back(i * 7919 - static_cast<int64_t>(gen() % 5) * 1000000007);
+  for (size_t i = 0; i < 200000; i += 10) ids.push_back(ids[i]);
+
+  std::unordered_map<int64_t, uint64_t> expected;
+  for (size_t i = 0; i < ids.size(); i++) expected.emplace(ids[i], i);
+
+  SUBCASE("test the index maps each key to its first record, after being mapped again") {
+    for (const auto threads: {size_t{1}, size_t{4}}) {
+      std::error_code error;
+      mio::HashIndex<int64_t>::build(path, std::span<const int64_t>{ids}, error, threads);
+      REQUIRE(!error);
+
+      mio::HashIndex<int64_t> index;
+      index.open(path, error);
+      REQUIRE(!error);
+      CHECK(index.size() == expected.size());
+
+      auto wrong = size_t{0};
+      for (const auto &[id, i]: expected) wrong += index.find(id) != i;
+      CHECK(wrong == 0);
+      CHECK(!index.contains(int64_t{3}));
+      CHECK(index.find(int64_t{-1}) == index.npos);
+    }
+  }
+
+  SUBCASE("test the index maps keys to given values") {
+    std::vector<int64_t> keys{5, -5, 42};
+    std::vector<uint64_t> offsets{100, 200, 300};
+
+    std::error_code error;
+    mio::HashIndex<int64_t>::build(path, std::span<const int64_t>{keys}, std::span<const uint64_t>{offsets}, error);
+    REQUIRE(!error);
+
+    mio::HashIndex<int64_t> index;
+    index.open(path, error);
+    REQUIRE(!error);
+    CHECK(index.find(-5) == 200);
+    CHECK(index.find(42) == 300);
+    CHECK(index.find(6) == index.npos);
+
+    offsets.pop_back();
+    mio::HashIndex<int64_t>::build(path, std::span<const int64_t>{keys}, std::span<const uint64_t>{offsets}, error);
+    CHECK(error == std::errc::invalid_argument);
+  }
+
+  SUBCASE("test an index of another key type is rejected") {
+    std::vector<int32_t> keys{1, 2, 3};
+    std::error_code error;
+    mio::HashIndex<int32_t>::build(path, std::span<const int32_t>{keys}, error);
+    REQUIRE(!error);
+
+    mio::HashIndex<int64_t> index;
+    index.open(path, error);
+    CHECK(error == std::errc::invalid_argument);
+    CHECK(!index.is_open());
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("network")
+{
+  const auto node_path = std::string{"test-network-node"};
+  const auto link_path = std::string{"test-network-link"};
+  const auto cache = mio::Network::default_cache(link_path);
+
+  // A grid of 100 x 100 nodes with IDs of gaps, in a shuffled order, and links to the right
+  // and up neighbours, each with a two point geometry, plus a link to a node not in the grid.
+  constexpr int64_t side = 100;
+  auto id_of = [](int64_t r, int64_t c) { return 1000 + 7 * (r * side + c); };
+  {
+    auto order = std::vector<int64_t>(side * side);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937{5});
+
+    std::ofstream nodes(node_path);
+    nodes << "zone_id,y_coord,node_id,x_coord\n";
+    for (const auto n: order) nodes << n % 3 << "," << n / side << "," << id_of(n / side, n % side) << "," << n % side << "\n";
+
+    std::ofstream links(link_path);
+    links << "link_id,from_node_id,to_node_id,lanes,length,capacity,geometry\n";
+    auto link_id = int64_t{0};
+    for (int64_t r = 0; r < side; r++) {
+      for (int64_t c = 0; c < side; c++) {
+        if (c + 1 < side)
+          links << link_id++ << "," << id_of(r, c) << "," << id_of(r, c + 1) << ",2,1.5,1800,\"LINESTRING (" << c << " " << r << ", " << c + 1 << " " << r << ")\"\n";
+        if (r + 1 < side)
+          links << link_id++ << "," << id_of(r, c) << "," << id_of(r + 1, c) << ",1,2.5,900,\"LINESTRING (" << c << " " << r << ", " << c << " " << r + 1 << ")\"\n";
+      }
+    }
+    links << link_id << "," << id_of(0, 0) << ",42,1,1,1,\n";
+  }
+
+  SUBCASE("test the network is built as a CSR graph on first load and mapped after") {
+    std::filesystem::remove(cache);
+    for (const auto rebuilt: {true, false}) {
+      mio::Network network;
+      std::error_code error;
+      REQUIRE(network.open(node_path, link_path, error, 4));
+      CHECK(network.rebuilt() == rebuilt);
+      REQUIRE(network.node_count() == side * side);
+      REQUIRE(network.link_count() == 2 * side * (side - 1));
+      CHECK(network.dropped_link_count() == 1);
+
+      const auto ids = network.node_ids();
+      CHECK(std::is_sorted(ids.begin(), ids.end()));
+      CHECK(network.out_offsets().back() == network.link_count());
+
+      // The node in row 3, column 4 has a link to the right, then one up, in to node order.
+      const auto node = network.node_of(id_of(3, 4));
+      REQUIRE(node != network.npos);
+      CHECK(network.node_x()[node] == 4);
+      CHECK(network.node_y()[node] == 3);
+      REQUIRE(network.out_degree(node) == 2);
+
+      auto to = std::vector<int64_t>{};
+      for (const auto l: network.out_links(node)) {
+        CHECK(network.from_nodes()[l] == node);
+        to.push_back(ids[network.to_nodes()[l]]);
+      }
+      CHECK(to == std::vector<int64_t>{id_of(3, 5), id_of(4, 4)});
+
+      const auto up = network.out_offsets()[node] + 1;
+      CHECK(network.lengths()[up] == 2.5);
+      CHECK(network.capacities()[up] == 900);
+      CHECK(network.link_x(up).size() == 2);
+      CHECK(network.link_y(up)[1] == 4);
+
+      // The corner node has no links out.
+      CHECK(network.out_degree(network.node_of(id_of(side - 1, side - 1))) == 0);
+      CHECK(network.node_of(42) == network.npos);
+    }
+  }
+
+  SUBCASE("test a link file lacking a column needed is rejected") {
+    {
+      std::ofstream links(link_path);
+      links << "link_id,from_node_id,to_node_id,length\n1," << id_of(0, 0) << "," << id_of(0, 1) << ",1\n";
+    }
+    mio::Network network;
+    std::error_code error;
+    CHECK(!network.open(node_path, link_path, error));
+    CHECK(error == std::errc::invalid_argument);
+  }
+
+  std::filesystem::remove(cache);
+  std::filesystem::remove(cache + ".hidx");
+  std::filesystem::remove(node_path);
+  std::filesystem::remove(link_path);
+}
+
+TEST_CASE("shortestpath")
+{
+  // A random graph of 5000 nodes and 4 links out of each, with integer and fractional weights,
+  // some of them zero, and some nodes reached by no link.
+  constexpr uint32_t nodes = 5000;
+  std::mt19937 gen{17};
+  std::vector<uint64_t> offsets{0};
+  std::vector<uint32_t> heads;
+  std::vector<double> weights;
+  for (uint32_t u = 0; u < nodes; u++) {
+    for (int k = 0; k < 4; k++) {
+      heads.push_back(static_cast<uint32_t>(gen() % (nodes - 100)));
+      weights.push_back(k == 0 ? static_cast<double>(gen() % 3) : static_cast<double>(gen() % 1000) / 7.0);
+    }
+    offsets.push_back(heads.size());
+  }
+  std::vector<uint32_t> tails(heads.size());
+  for (uint32_t u = 0; u < nodes; u++)
+    for (auto l = offsets[u]; l < offsets[u + 1]; l++) tails[l] = u;
+
+  auto reference = [&](uint32_t a_origin) {
+    auto cost = std::vector<double>(nodes, mio::ShortestPathTree::unreached);
+    using Entry = std::pair<double, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+    cost[a_origin] = 0;
+    queue.push({0, a_origin});
+    while (!queue.empty()) {
+      const auto [d, u] = queue.top();
+      queue.pop();
+      if (d != cost[u]) continue;
+      for (auto l = offsets[u]; l < offsets[u + 1]; l++)
+        if (d + weights[l] < cost[heads[l]]) queue.push({cost[heads[l]] = d + weights[l], heads[l]});
+    }
+    return cost;
+  };
+
+  const auto paths = mio::ShortestPaths{offsets, heads, weights};
+
+  SUBCASE("test the radix heap pops keys in order") {
+    mio::RadixHeap heap;
+    std::vector<double> keys;
+    for (int i = 0; i < 1000; i++) keys.push_back(static_cast<double>(gen() % 100000) / 3.0);
+    for (const auto k: keys) heap.push(k, 0);
+    std::sort(keys.begin(), keys.end());
+    auto popped = std::vector<double>{};
+    while (!heap.empty()) popped.push_back(heap.pop().first);
+    CHECK(popped == keys);
+  }
+
+  SUBCASE("test the tree of an origin has the least costs, reused for the next origin") {
+    mio::ShortestPathTree tree;
+    for (const uint32_t origin: {0u, 17u, 4242u}) {
+      paths.tree(origin, tree);
+      const auto expected = reference(origin);
+      CHECK(std::equal(expected.begin(), expected.end(), tree.costs().begin()));
+      CHECK(tree.parent_link(origin) == tree.npos);
+
+      // The path to a node adds up to its cost.
+      for (uint32_t v = 0; v < nodes; v += 97) {
+        if (!tree.reached(v) || v == origin) continue;
+        auto cost = 0.0;
+        for (const auto l: tree.path(v, tails)) cost += weights[l];
+        CHECK(cost == doctest::Approx(tree.cost(v)));
+      }
+      CHECK(!tree.reached(nodes - 1));
+    }
+  }
+
+  SUBCASE("test a search for targets stops once they are settled") {
+    mio::ShortestPathTree tree;
+    const std::vector<uint32_t> targets{5, 6, 5};
+    paths.tree(0, tree, targets);
+    const auto expected = reference(0);
+    CHECK(tree.cost(5) == expected[5]);
+    CHECK(tree.cost(6) == expected[6]);
+  }
+
+  SUBCASE("test trees of many origins on many threads match the sequential ones") {
+    std::vector<uint32_t> origins(64);
+    std::iota(origins.begin(), origins.end(), 100u);
+    std::vector<std::vector<double>> costs(origins.size());
+    paths.trees(origins, [&](size_t, size_t a_origin, const mio::ShortestPathTree &a_tree) {
+      costs[a_origin].assign(a_tree.costs().begin(), a_tree.costs().end());
+    }, 4);
+
+    auto wrong = 0;
+    for (size_t i = 0; i < origins.size(); i++) wrong += costs[i] != reference(origins[i]);
+    CHECK(wrong == 0);
+
+    const std::vector<uint32_t> destinations{1, 2, 3, nodes - 1};
+    const auto matrix = paths.costs(origins, destinations, 4);
+    REQUIRE(matrix.size() == origins.size() * destinations.size());
+    CHECK(matrix[5 * destinations.size() + 2] == costs[5][3]);
+    CHECK(matrix[7 * destinations.size() + 3] == mio::ShortestPathTree::unreached);
+  }
+
+  SUBCASE("test delta-stepping finds the same costs for any delta and threads") {
+    const auto expected = reference(3);
+    for (const auto delta: {0.0, 1.0, 50.0, 1e9}) {
+      for (const auto threads: {size_t{1}, size_t{4}}) {
+        mio::ShortestPathTree tree;
+        paths.delta_stepping(3, tree, delta, threads);
+        CHECK(std::equal(expected.begin(), expected.end(), tree.costs().begin()));
+
+        auto wrong = 0;
+        for (uint32_t v = 0; v < nodes; v++) {
+          const auto l = tree.parent_link(v);
+          if (l != tree.npos) wrong += tree.cost(tails[l]) + weights[l] != tree.cost(v);
+          else wrong += v != 3 && tree.reached(v);
+        }
+        CHECK(wrong == 0);
+
+        // The tree is reset in full for a Dijkstra search after.
+        paths.tree(3, tree);
+        CHECK(std::equal(expected.begin(), expected.end(), tree.costs().begin()));
+      }
+    }
+  }
+}
+
+TEST_CASE("executor")
+{
+  SUBCASE("test a task group runs all its tasks") {
+    mio::Executor executor{4};
+    CHECK(executor.size() == 4);
+
+    std::atomic<int> sum{0};
+    mio::TaskGroup group{executor};
+    for (int i = 1; i <= 100; i++) group.run([&sum, i] { sum += i; });
+    group.wait();
+    CHECK(sum == 5050);
+  }
+
+  SUBCASE("test parallel_for covers the range once") {
+    auto values = std::vector<int>(100000, 0);
+    mio::Executor::shared().parallel_for(0, values.size(), [&](size_t a_first, size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) values[i]++;
+    });
+    CHECK(std::accumulate(values.begin(), values.end(), 0) == 100000);
+
+    mio::Executor::shared().parallel_for(5, 5, [](size_t, size_t) { FAIL("empty range"); });
+  }
+
+  SUBCASE("test nested task groups do not deadlock") {
+    mio::Executor executor{2};
+    std::atomic<int> count{0};
+    mio::TaskGroup outer{executor};
+    for (int i = 0; i < 8; i++)
+      outer.run([&] {
+        mio::TaskGroup inner{executor};
+        for (int j = 0; j < 8; j++) inner.run([&] { count++; });
+        inner.wait();
+      });
+    outer.wait();
+    CHECK(count == 64);
+  }
+
+  SUBCASE("test the first exception of a task is rethrown by wait") {
+    mio::Executor executor{2};
+    std::atomic<int> count{0};
+    mio::TaskGroup group{executor};
+    group.run([] { throw std::runtime_error("task failed"); });
+    for (int i = 0; i < 10; i++) group.run([&] { count++; });
+    CHECK_THROWS_AS(group.wait(), std::runtime_error);
+    CHECK(count == 10);
+  }
+
+  SUBCASE("test run_workers runs all the workers at once") {
+    mio::Executor executor{0};
+    std::atomic<size_t> arrived{0};
+    executor.run_workers(6, [&](size_t) {
+      arrived++;
+      while (arrived < 6) std::this_thread::yield();
+    });
+    CHECK(arrived == 6);
+    CHECK(executor.size() >= 5);
+  }
+
+  SUBCASE("test pinned workers still run tasks") {
+    mio::Executor executor{2, true};
+    std::atomic<int> count{0};
+    executor.parallel_for(0, 64, [&](size_t a_first, size_t a_last) { count += static_cast<int>(a_last - a_first); }, 4);
+    CHECK(count == 64);
+  }
+
+  SUBCASE("test numa nodes share the workers in order") {
+    const auto &nodes = mio::numa_nodes();
+    REQUIRE(!nodes.empty());
+    CHECK(std::is_sorted(nodes.begin(), nodes.end(), [](const auto &a, const auto &b) { return a.id < b.id; }));
+    CHECK(mio::current_numa_node() >= 0);
+
+    // Consecutive workers share a node, every node gets some.
+    auto previous = nodes.front().id;
+    std::set<int> used;
+    for (size_t i = 0; i < 4 * nodes.size(); i++) {
+      const auto node = mio::numa_node_of(i, 4 * nodes.size());
+      CHECK(node >= previous);
+      previous = node;
+      used.insert(node);
+    }
+    CHECK(used.size() == nodes.size());
+
+    for (const auto placement: {mio::NumaPlacement::none, mio::NumaPlacement::local, mio::NumaPlacement::interleave}) {
+      const auto scope = mio::NumaScope{placement, 1, 2};
+      std::vector<int> touched(1 << 16, 1);
+      CHECK(std::accumulate(touched.begin(), touched.end(), 0) == 1 << 16);
+    }
+  }
+
+  SUBCASE("test numa placed reads read every line") {
+    auto path = "test-numa-lines";
+    {
+      std::ofstream out{path, std::ios::binary};
+      for (int i = 0; i < 50000; i++) out << i << "\n";
+    }
+
+    {
+      mio::StringReaderAsync reader{path};
+      CHECK(reader.worker_numa_node(0, 4) == mio::any_numa_node);
+      for (const auto placement: {mio::NumaPlacement::local, mio::NumaPlacement::interleave}) {
+        reader.set_numa_placement(placement);
+        std::atomic<int64_t> sum{0};
+        CHECK(reader.async_getline([&](int, std::string_view a_line) {
+          sum += std::stoll(std::string{a_line});
+          return 0;
+        }, 4) == 50000);
+        CHECK(sum == int64_t{50000} * 49999 / 2);
+      }
+      reader.set_numa_placement(mio::NumaPlacement::local);
+      CHECK(reader.worker_numa_node(3, 4) == mio::numa_node_of(3, 4));
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+namespace {
+
+/**
+   A coroutine run eagerly, and not awaited, for the tests of awaitables.
+ */
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+Detached read_batches(mio::BatchReader &a_reader, std::string &a_text, size_t &a_lines, std::promise<std::thread::id> &a_done)
+{
+  auto resumed_on = std::thread::id{};
+  auto expected_offset = size_t{0};
+  while (auto batch = co_await a_reader.next_batch()) {
+    CHECK(batch->offset == expected_offset);
+    expected_offset += batch->block.size();
+    a_text.append(batch->block);
+    for ([[maybe_unused]] const auto line: batch->lines()) a_lines++;
+    resumed_on = std::this_thread::get_id();
+  }
+  a_done.set_value(resumed_on);
+}
+
+}
+
+TEST_CASE("batchreader")
+{
+  SUBCASE("test awaiting batches reads every line once, on a worker") {
+    auto text = std::string{};
+    for (int i = 0; i < 10000; i++) text += "line," + std::to_string(i) + "\n";
+    text += "last line with no newline";
+
+    mio::Executor executor{2};
+    mio::BatchReader reader{std::string_view{text}, 4096, executor};
+
+    auto read = std::string{};
+    auto lines = size_t{0};
+    std::promise<std::thread::id> done;
+    auto resumed_on = done.get_future();
+    read_batches(reader, read, lines, done);
+
+    CHECK(resumed_on.get() != std::this_thread::get_id());
+    CHECK(read == text);
+    CHECK(lines == 10001);
+    CHECK(reader.eof());
+    CHECK(reader.batch_count() == (text.size() + 4095) / 4096);
+  }
+
+  SUBCASE("test an empty content ends with no suspension") {
+    mio::BatchReader reader{std::string_view{}};
+    auto read = std::string{};
+    auto lines = size_t{0};
+    std::promise<std::thread::id> done;
+    auto resumed_on = done.get_future();
+    read_batches(reader, read, lines, done);
+
+    CHECK(resumed_on.get() == std::thread::id{});
+    CHECK(lines == 0);
+    CHECK(reader.batch_count() == 0);
+  }
+
+  SUBCASE("test a mapped file is read in batches") {
+    auto path = "test-batches";
+    {
+      std::ofstream out{path, std::ios::binary};
+      for (int i = 0; i < 1000; i++) out << i << ",link," << i * 3 << "\n";
+    }
+
+    {
+      mio::StringReaderAsync file{path};
+      mio::BatchReader reader{file, 64};
+
+      auto read = std::string{};
+      auto lines = size_t{0};
+      std::promise<std::thread::id> done;
+      auto resumed_on = done.get_future();
+      read_batches(reader, read, lines, done);
+      resumed_on.wait();
+
+      CHECK(read == file.content());
+      CHECK(lines == 1000);
+    }
+    std::filesystem::remove(path);
+  }
+}
+
+TEST_CASE("trace")
+{
+  SUBCASE("test spans and counters are recorded per thread") {
+    mio::trace::clear();
+    auto text = std::string{};
+    for (int i = 0; i < 1000; i++) text += std::to_string(i) + "\n";
+
+    mio::StringReaderAsync reader{std::span<const char>{text}};
+    CHECK(reader.async_getline([](int, const std::string_view) { return 0; }, 2) == 1000);
+    {
+      WXLIB_TRACE_SPAN("test.scope");
+      WXLIB_TRACE_INSTANT("test.instant");
+    }
+
+    auto names = std::multiset<std::string_view>{};
+    auto lines = int64_t{-1};
+    mio::trace::for_each_event([&](uint32_t, const mio::trace::Event &a_event) {
+      names.insert(a_event.name);
+      if (a_event.kind == mio::trace::EventKind::Counter) lines = a_event.value;
+    });
+
+    std::ostringstream trace;
+    mio::trace::write_chrome_trace(trace);
+    CHECK(trace.str().starts_with(R"({"displayTimeUnit":"ns","traceEvents":[)"));
+    if constexpr (!mio::trace::enabled) {
+      CHECK(names.empty());
+      return;
+    }
+
+    CHECK(names.count("mio.make_partitions") == 1);
+    CHECK(names.count("mio.async_getline") == 2);
+    CHECK(names.count("test.scope") == 1);
+    CHECK(names.count("test.instant") == 1);
+    CHECK(lines == 1000);
+    CHECK(mio::trace::dropped() == 0);
+    CHECK(trace.str().find(R"("name":"mio.async_getline","pid":1)") != std::string::npos);
+    CHECK(trace.str().find(R"("ph":"C","args":{"value":1000})") != std::string::npos);
+
+    mio::trace::clear();
+    auto count = size_t{0};
+    mio::trace::for_each_event([&](uint32_t, const mio::trace::Event &) { count++; });
+    CHECK(count == 0);
+  }
+
+  SUBCASE("test a full ring keeps the latest events") {
+    mio::trace::clear();
+    std::thread{[] {
+      for (size_t i = 0; i < mio::trace::ring_capacity + 10; i++) WXLIB_TRACE_COUNTER("test.counter", i);
+    }}.join();
+
+    auto first = int64_t{-1};
+    auto count = size_t{0};
+    mio::trace::for_each_event([&](uint32_t, const mio::trace::Event &a_event) {
+      if (count++ == 0) first = a_event.value;
+    });
+    if constexpr (mio::trace::enabled) {
+      CHECK(count == mio::trace::ring_capacity);
+      CHECK(first == 10);
+      CHECK(mio::trace::dropped() == 10);
+    } else {
+      CHECK(count == 0);
+    }
+    mio::trace::clear();
+  }
+}
+
+TEST_CASE("odmatrix")
+{
+  const auto path = std::string{"test-odmatrix"};
+  const auto packed = std::string{"test-odmatrix-packed"};
+  const auto copy = std::string{"test-odmatrix-copy"};
+
+  // 150 zones, so that the last tile row and column are partial, and a block of zero tiles.
+  constexpr size_t zones = 150;
+  auto value = [](size_t o, size_t d) { return o >= 64 && o < 128 && d < 64 ? 0.0f : static_cast<float>(o * 1000 + d) * 0.25f; };
+  auto dense = std::vector<float>(zones * zones);
+  for (size_t o = 0; o < zones; o++)
+    for (size_t d = 0; d < zones; d++) dense[o * zones + d] = value(o, d);
+
+  std::error_code error;
+  {
+    auto od = mio::OdMatrix<float, mio::access_mode::write>{};
+    CHECK_FALSE(od.create(path, zones, error, 12));
+    CHECK(error == std::errc::invalid_argument);
+    CHECK_FALSE(od.create(path, 0, error));
+
+    REQUIRE(od.create(path, zones, error));
+    CHECK(od.zone_count() == zones);
+    CHECK(od.tile_size() == 64);
+    CHECK(od.tile_count() == 3);
+    CHECK(od.tiles().size() == 9 * 64 * 64);
+    CHECK(std::filesystem::file_size(path) == od.header_size + 9 * 64 * 64 * sizeof(float));
+
+    // Written cell by cell, a row, a column, and as a whole.
+    for (size_t o = 0; o < zones; o++) od(o, 70) = value(o, 70);
+    auto row = std::vector<float>(zones);
+    for (size_t d = 0; d < zones; d++) row[d] = value(3, d);
+    od.write_row(3, row);
+    auto column = std::vector<float>(zones);
+    od.read_column(70, column);
+    for (size_t o = 0; o < zones; o++) CHECK(column[o] == value(o, 70));
+    od.read_row(3, column);
+    CHECK(column == row);
+    CHECK(od(3, 149) == value(3, 149));
+    CHECK(od.tile(0, 2)[3 * 64 + 149 - 128] == value(3, 149));
+
+    for (size_t o = 0; o < zones; o++) column[o] = value(o, 140);
+    od.write_column(140, column);
+    CHECK(od(149, 140) == value(149, 140));
+
+    od.write(dense, 3);
+    od.sync(error);
+    CHECK_FALSE(error);
+  }
+
+  auto od = mio::OdMatrix<float>{};
+  REQUIRE(od.open(path, error));
+  CHECK(od.zone_count() == zones);
+
+  auto out = std::vector<float>(zones * zones);
+  od.read(out, 2);
+  CHECK(out == dense);
+  for (size_t o = 0; o < zones; o += 7)
+    for (size_t d = 0; d < zones; d += 5) CHECK(od(o, d) == value(o, d));
+
+  // The sums do not depend on the number of threads, and the padding stays zero.
+  auto rows = std::vector<double>(zones), columns = std::vector<double>(zones);
+  for (size_t o = 0; o < zones; o++)
+    for (size_t d = 0; d < zones; d++) {
+      rows[o] += value(o, d);
+      columns[d] += value(o, d);
+    }
+  const auto row_sums = od.row_sums(1);
+  const auto column_sums = od.column_sums(1);
+  CHECK(od.row_sums(4) == row_sums);
+  CHECK(od.column_sums(4) == column_sums);
+  for (size_t z = 0; z < zones; z++) {
+    CHECK(row_sums[z] == doctest::Approx(rows[z]));
+    CHECK(column_sums[z] == doctest::Approx(columns[z]));
+  }
+  CHECK(od.total() == doctest::Approx(std::accumulate(rows.begin(), rows.end(), 0.0)));
+  CHECK(od.tile(2, 2)[63 * 64 + 63] == 0.0f);
+
+  auto visited = std::atomic<size_t>{0};
+  od.for_each_tile([&](size_t, size_t, std::span<const float> a_tile) { visited += a_tile.size() == 64 * 64; }, 2);
+  CHECK(visited == 9);
+
+  // The kernels agree with the scalar sum, over lengths with a tail.
+  auto values = std::vector<float>(1000);
+  for (size_t i = 0; i < values.size(); i++) values[i] = static_cast<float>(i % 17) * 0.5f;
+  for (size_t n: {0, 5, 16, 37, 1000}) CHECK(mio::detail::od_row_sum(values.data(), n) == doctest::Approx(mio::detail::od_sum(values.data(), n)));
+
+  SUBCASE("wrong type")
+  {
+    auto doubles = mio::OdMatrix<double>{};
+    CHECK_FALSE(doubles.open(path, error));
+    CHECK(error == std::errc::invalid_argument);
+  }
+
+  SUBCASE("packed")
+  {
+    for (const auto compression: {mio::TileCompression::None, mio::TileCompression::Zlib, mio::TileCompression::Zstd}) {
+      if (!od.supports(compression)) {
+        CHECK_FALSE(od.pack(packed, compression, error));
+        CHECK(error == std::errc::not_supported);
+        continue;
+      }
+
+      REQUIRE(od.pack(packed, compression, error, 0, 2));
+      // The tile of zeros takes no space.
+      CHECK(std::filesystem::file_size(packed) < 64 + 10 * 8 + 8 * 64 * 64 * sizeof(float) + 1);
+
+      auto unpacked = mio::OdMatrix<float, mio::access_mode::write>{};
+      REQUIRE(unpacked.unpack(packed, copy, error, 3));
+      CHECK(unpacked.zone_count() == zones);
+      unpacked.read(out);
+      CHECK(out == dense);
+      CHECK(std::filesystem::file_size(copy) == std::filesystem::file_size(path));
+
+      auto reopened = mio::OdMatrix<float>{};
+      CHECK_FALSE(reopened.open(packed, error));
+      CHECK(error == std::errc::invalid_argument);
+    }
+
+#ifdef WXLIB_MIO_WITH_ZLIB
+    // A corrupt tile, the first one, stored compressed just after the directory.
+    REQUIRE(od.pack(packed, mio::TileCompression::Zlib, error));
+    {
+      std::fstream file(packed, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(64 + 10 * 8 + 4);
+      file.write("garbage", 7);
+    }
+    auto unpacked = mio::OdMatrix<float, mio::access_mode::write>{};
+    CHECK_FALSE(unpacked.unpack(packed, copy, error));
+    CHECK(error == std::errc::illegal_byte_sequence);
+    CHECK_FALSE(unpacked.is_open());
+#endif
+  }
+
+  od.close();
+  std::filesystem::remove(path);
+  std::filesystem::remove(packed);
+  std::filesystem::remove(copy);
+}
+
+TEST_CASE("probestore")
+{
+  const auto dir = std::string{"test-probestore"};
+  const auto csv = std::string{"test-probestore.csv"};
+  std::filesystem::remove_all(dir);
+
+  // 5000 points of 50 vehicles over three hours, some before the epoch, on a 1000 x 1000 area.
+  auto rng = std::mt19937{11};
+  auto time = std::uniform_int_distribution<int64_t>{-3600, 7199};
+  auto position = [&, cell = std::uniform_int_distribution<int>{0, 64000}]() mutable { return cell(rng) / 64.0; };
+  auto points = std::vector<mio::ProbePoint>(5000);
+  for (size_t i = 0; i < points.size(); i++) points[i] = {static_cast<int64_t>(i % 50), time(rng), position(), position(), static_cast<float>(i % 30)};
+
+  std::error_code error;
+  {
+    auto writer = mio::ProbeStoreWriter{};
+    CHECK_FALSE(writer.open(dir, error, 0));
+    CHECK(error == std::errc::invalid_argument);
+
+    REQUIRE(writer.open(dir, error, 3600, 100));
+    writer.append(std::span{points}.first(3000));
+    REQUIRE(writer.close(error));
+
+    CHECK_FALSE(writer.open(dir, error, 60));
+    CHECK(error == std::errc::invalid_argument);
+
+    // Appended to, the rest from a csv file.
+    {
+      std::ofstream out(csv);
+      out.precision(17);
+      out << "speed,y,x,time,vehicle_id,heading\n";
+      for (size_t i = 3000; i < points.size(); i++)
+        out << points[i].speed << "," << points[i].y << "," << points[i].x << "," << points[i].time << "," << points[i].vehicle_id << ",90\n";
+    }
+    REQUIRE(writer.open(dir, error, 3600, 100));
+    CHECK(writer.ingest_csv(csv, error, 3) == 2000);
+    CHECK_FALSE(error);
+    REQUIRE(writer.close(error));
+  }
+
+  auto store = mio::ProbeStore{};
+  REQUIRE(store.open(dir, error));
+  CHECK(store.bucket() == 3600);
+  CHECK(store.point_count() == points.size());
+  CHECK(store.chunks().size() >= 50);
+  for (size_t i = 0; i < store.chunks().size(); i++) {
+    const auto &info = store.chunks()[i];
+    const auto chunk = store.chunk(i);
+    CHECK(chunk.size() <= 100);
+    CHECK(std::ranges::is_sorted(chunk.times));
+    CHECK(chunk.times.front() == info.min_time);
+    CHECK(chunk.times.back() == info.max_time);
+    CHECK(info.min_time >= info.partition * 3600);
+    CHECK(info.max_time < (info.partition + 1) * 3600);
+  }
+
+  auto check = [&](int64_t a_first, int64_t a_last, mio::ProbeBox a_box) {
+    auto expected = std::vector<std::tuple<int64_t, int64_t, double, double, float>>{};
+    for (const auto &p: points)
+      if (p.time >= a_first && p.time <= a_last && a_box.contains(p.x, p.y)) expected.emplace_back(p.vehicle_id, p.time, p.x, p.y, p.speed);
+
+    auto mutex = std::mutex{};
+    auto found = std::vector<std::tuple<int64_t, int64_t, double, double, float>>{};
+    const auto count = store.query(a_first, a_last, a_box, [&](size_t, const mio::ProbePoint &p) {
+      std::scoped_lock lock(mutex);
+      found.emplace_back(p.vehicle_id, p.time, p.x, p.y, p.speed);
+    }, 3);
+
+    std::ranges::sort(expected);
+    std::ranges::sort(found);
+    CHECK(count == expected.size());
+    CHECK(found == expected);
+  };
+
+  check(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), mio::ProbeBox::everywhere());
+  check(-100, 100, mio::ProbeBox::everywhere());
+  check(1000, 5000, {100.0, 200.0, 400.0, 600.0});
+  check(8000, 9000, mio::ProbeBox::everywhere());
+
+  // The chunks are clustered by position, so that a small box skips most of them.
+  CHECK(store.select(0, 3599, {0.0, 0.0, 100.0, 100.0}).size() < store.select(0, 3599).size() / 2);
+  CHECK(store.for_each_chunk(8000, 9000, mio::ProbeBox::everywhere(), [](size_t, const mio::ProbeChunk &) {}) == 0);
+
+  store.close();
+  CHECK_FALSE(store.open("test-probestore-missing", error));
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove(csv);
+}
+
+TEST_CASE("spatialindex")
+{
+  // 3000 polylines of 1 to 5 points each on a 10000 x 10000 area, plus a link with no points.
+  auto rng = std::mt19937{17};
+  auto position = std::uniform_real_distribution<double>{0.0, 10000.0};
+  auto step = std::uniform_real_distribution<double>{-80.0, 80.0};
+  auto points = std::uniform_int_distribution<int>{1, 5};
+  auto offsets = std::vector<uint64_t>{0};
+  auto xs = std::vector<double>{}, ys = std::vector<double>{};
+  for (int l = 0; l < 3000; l++) {
+    auto x = position(rng), y = position(rng);
+    for (auto n = points(rng); n > 0; n--, x += step(rng), y += step(rng)) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+    offsets.push_back(xs.size());
+  }
+  offsets.push_back(xs.size());
+
+  // Brute force, over the same segments.
+  const auto distance = [&](size_t a_link, size_t a_segment, double a_x, double a_y) {
+    const auto p = offsets[a_link], q = offsets[a_link + 1] - p > 1 ? p + a_segment + 1 : p;
+    auto d = 0.0;
+    mio::detail::segment_distances(a_x, a_y, &xs[p + a_segment], &ys[p + a_segment], &xs[q], &ys[q], 1, &d);
+    return std::sqrt(d);
+  };
+  const auto segment_count = [&](size_t a_link) {
+    const auto n = offsets[a_link + 1] - offsets[a_link];
+    return n > 1 ? n - 1 : n;
+  };
+  const auto link_distances = [&](double a_x, double a_y) {
+    auto result = std::vector<std::pair<double, uint32_t>>{};
+    for (size_t l = 0; l + 1 < offsets.size(); l++) {
+      auto best = std::numeric_limits<double>::infinity();
+      for (size_t s = 0; s < segment_count(l); s++) best = std::min(best, distance(l, s, a_x, a_y));
+      if (best < std::numeric_limits<double>::infinity()) result.emplace_back(best, static_cast<uint32_t>(l));
+    }
+    std::ranges::sort(result);
+    return result;
+  };
+
+  // The kernels agree.
+  {
+    auto d0 = std::vector<double>(37), d1 = std::vector<double>(37);
+    mio::detail::segment_distances(5000, 5000, xs.data(), ys.data(), xs.data() + 1, ys.data() + 1, 37, d0.data());
+    mio::detail::batch_segment_distances(5000, 5000, xs.data(), ys.data(), xs.data() + 1, ys.data() + 1, 37, d1.data());
+    for (size_t i = 0; i < d0.size(); i++) CHECK(d1[i] == doctest::Approx(d0[i]));
+  }
+
+  auto tree = mio::PackedRTree{};
+  tree.build(offsets, xs, ys, 3);
+  CHECK(tree.segment_count() > 3000);
+
+  auto grid = mio::SpatialGrid{};
+  grid.build(offsets, xs, ys, 0, 3);
+  CHECK(grid.entry_count() >= tree.segment_count());
+
+  const auto check_nearest = [&](const auto &a_index, double a_x, double a_y) {
+    const auto expected = link_distances(a_x, a_y);
+    const auto hit = a_index.nearest(a_x, a_y);
+    REQUIRE(hit);
+    CHECK(hit.distance == doctest::Approx(expected.front().first));
+    CHECK(distance(hit.link, hit.segment, a_x, a_y) == doctest::Approx(hit.distance));
+
+    // Within a distance shorter than the nearest, nothing.
+    CHECK_FALSE(a_index.nearest(a_x, a_y, expected.front().first * 0.99));
+  };
+
+  auto queries = std::vector<std::pair<double, double>>{{-500, -500}, {12000, 5000}, {0, 0}};
+  for (int i = 0; i < 50; i++) queries.emplace_back(position(rng), position(rng));
+  for (const auto &[x, y]: queries) {
+    check_nearest(tree, x, y);
+    check_nearest(grid, x, y);
+
+    const auto expected = link_distances(x, y);
+    auto hits = std::vector<mio::SpatialHit>{};
+    tree.nearest_links(x, y, 5, std::numeric_limits<double>::infinity(), hits);
+    REQUIRE(hits.size() == 5);
+    for (size_t i = 0; i < hits.size(); i++) CHECK(hits[i].distance == doctest::Approx(expected[i].first));
+  }
+
+  // The segments in a box, once each.
+  const auto check_search = [&](const auto &a_index, double a_min_x, double a_min_y, double a_max_x, double a_max_y) {
+    auto expected = std::vector<std::pair<uint32_t, uint32_t>>{};
+    for (size_t l = 0; l + 1 < offsets.size(); l++) {
+      for (size_t s = 0; s < segment_count(l); s++) {
+        const auto p = offsets[l] + s, q = offsets[l + 1] - offsets[l] > 1 ? p + 1 : p;
+        if (std::min(xs[p], xs[q]) <= a_max_x && std::max(xs[p], xs[q]) >= a_min_x && std::min(ys[p], ys[q]) <= a_max_y && std::max(ys[p], ys[q]) >= a_min_y)
+          expected.emplace_back(static_cast<uint32_t>(l), static_cast<uint32_t>(s));
+      }
+    }
+    auto found = std::vector<std::pair<uint32_t, uint32_t>>{};
+    a_index.search(a_min_x, a_min_y, a_max_x, a_max_y, [&](uint32_t a_link, uint32_t a_segment) { found.emplace_back(a_link, a_segment); });
+    std::ranges::sort(found);
+    CHECK(found == expected);
+  };
+  check_search(tree, 2000, 3000, 2600, 3400);
+  check_search(grid, 2000, 3000, 2600, 3400);
+  check_search(tree, -1, -1, 20000, 20000);
+  check_search(grid, -1, -1, 20000, 20000);
+  check_search(grid, 20000, 20000, 30000, 30000);
+
+  // Batched, and saved and mapped back.
+  const auto path = std::string{"test-spatialindex"};
+  std::error_code error;
+  REQUIRE(tree.save(path, error));
+  auto mapped = mio::PackedRTree{};
+  REQUIRE(mapped.open(path, error));
+  CHECK(mapped.segment_count() == tree.segment_count());
+  CHECK(mapped.node_count() == tree.node_count());
+
+  auto qx = std::vector<double>{}, qy = std::vector<double>{};
+  for (const auto &[x, y]: queries) qx.push_back(x), qy.push_back(y);
+  auto tree_hits = std::vector<mio::SpatialHit>(qx.size()), grid_hits = std::vector<mio::SpatialHit>(qx.size());
+  mapped.nearest(qx, qy, 200.0, tree_hits, 3);
+  grid.nearest(qx, qy, 200.0, grid_hits, 3);
+  for (size_t i = 0; i < qx.size(); i++) {
+    CHECK(static_cast<bool>(tree_hits[i]) == static_cast<bool>(grid_hits[i]));
+    if (tree_hits[i]) CHECK(tree_hits[i].distance == doctest::Approx(grid_hits[i].distance));
+  }
+  CHECK_FALSE(tree_hits[0]);
+  mapped.close();
+
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "not a tree";
+  }
+  CHECK_FALSE(mapped.open(path, error));
+  CHECK(error == std::errc::invalid_argument);
+  std::filesystem::remove(path);
+
+  // A single segment, and none.
+  const auto one = std::vector<uint64_t>{0, 2};
+  const auto one_x = std::vector<double>{0, 10}, one_y = std::vector<double>{0, 0};
+  tree.build(one, one_x, one_y);
+  CHECK(tree.nearest(5, 3).distance == doctest::Approx(3.0));
+  grid.build(one, one_x, one_y);
+  CHECK(grid.nearest(5, 3).distance == doctest::Approx(3.0));
+  tree.build(std::vector<uint64_t>{0}, {}, {});
+  CHECK_FALSE(tree.nearest(0, 0));
+  grid.build(std::vector<uint64_t>{0}, {}, {});
+  CHECK_FALSE(grid.nearest(0, 0));
+}
+
+TEST_CASE("fixedwidth")
+{
+  using namespace mio::csv;
+
+  using Doc = FixedWidthDoc<
+      Column<NAME("station"), 0, 8>,
+      Column<NAME("lane"), 8, 2, int32_t>,
+      Column<NAME("volume"), 10, 6, int32_t>,
+      Column<NAME("note"), 16, 60, std::string>,
+      Column<NAME("speed"), 76, 8, double>
+  >;
+  static_assert(Doc::record_width == 84);
+
+  auto line_of = [](size_t i) {
+    auto pad = [](std::string a_text, size_t a_width, bool a_left) {
+      const auto fill = std::string(a_width - a_text.size(), ' ');
+      return a_left ? a_text + fill : fill + a_text;
+    };
+    return pad("ST" + std::to_string(i % 1000), 8, true) + pad(std::to_string(i % 4), 2, false) + pad(std::to_string(i), 6, false)
+           + pad(i % 3 == 0 ? "" : "note " + std::to_string(i) + " x", 60, true) + pad(std::to_string(i % 90) + ".5", 8, false);
+  };
+
+  SUBCASE("test make_record trims the padding of each column") {
+    Doc doc;
+    const auto line = line_of(43);
+    auto rec = doc.make_record(line);
+    CHECK(get<0>(rec).data == "ST43");
+    CHECK(get<1>(rec).data == 3);
+    CHECK(get<2>(rec).data == 43);
+    CHECK(get<3>(rec).data == "note 43 x");
+    CHECK(get<4>(rec).data == 43.5);
+
+    // Short lines leave the columns they do not reach empty.
+    rec = doc.make_record("  ST7    1    12  a");
+    CHECK(get<0>(rec).data == "ST7");
+    CHECK(get<1>(rec).data == 1);
+    CHECK(get<2>(rec).data == 12);
+    CHECK(get<3>(rec).data == "a");
+    CHECK(get<4>(rec).data == 0.0);
+    CHECK(doc.invalid_field_count == 0);
+
+    rec = doc.make_record("ST1      x");
+    CHECK(get<1>(rec).data == 0);
+    CHECK(doc.invalid_field_count == 1);
+  }
+
+  SUBCASE("test make_records matches make_record over blocks") {
+    std::string block;
+    for (size_t i = 0; i < 500; ++i) block.append(line_of(i)).append(i % 2 ? "\r\n" : "\n").append(i % 50 == 0 ? "\n" : "");
+    block.append(line_of(500));
+
+    Doc doc, single;
+    auto count = size_t{0}, mismatches = size_t{0};
+    const auto n = doc.make_records(block, [&](const Doc::Record &a_rec) {
+      const auto line = line_of(count++);
+      const auto rec = single.make_record(line);
+      const auto same = get<0>(a_rec).data == get<0>(rec).data && get<1>(a_rec).data == get<1>(rec).data && get<2>(a_rec).data == get<2>(rec).data
+                        && get<3>(a_rec).data == get<3>(rec).data && get<4>(a_rec).data == get<4>(rec).data;
+      if (!same) mismatches++;
+      return 0;
+    });
+    CHECK(n == 501);
+    CHECK(mismatches == 0);
+
+    Doc::Columns columns;
+    CHECK(doc.make_columns(block, columns) == 501);
+    CHECK(std::get<2>(columns)[321] == 321);
+    CHECK(std::get<3>(columns)[0].empty());
+    CHECK(std::get<3>(columns)[1] == "note 1 x");
+  }
+
+  SUBCASE("test readers parse the records of a file in parallel") {
+    const auto record_count = size_t{20000};
+    std::string buffer = "STATION LNVOLUME\n";
+    for (size_t i = 0; i < record_count; ++i) buffer.append(line_of(i)).append("\n");
+
+    auto path = "test-fixedwidth";
+    std::ofstream file(path, std::ios::binary);
+    file << buffer;
+    file.close();
+
+    FixedWidthReader<
+        Column<NAME("station"), 0, 8>,
+        Column<NAME("volume"), 10, 6, int64_t>,
+        Column<NAME("speed"), 76, 8, double>
+    > reader(path);
+    REQUIRE(reader.is_mapped());
+    reader.header_on_first_line = true;
+
+    std::atomic<int64_t> volumes{0};
+    const auto n = reader.read([&](int, auto a_records) {
+      for (const auto &rec: a_records) volumes += get<1>(rec).data;
+      return 0;
+    }, 4, 64 << 10);
+    CHECK(n == record_count);
+    CHECK(volumes == static_cast<int64_t>(record_count * (record_count - 1) / 2));
+    CHECK(reader.invalid_field_count() == 0);
+
+    std::atomic<size_t> slow{0};
+    CHECK(reader.read_columns([&](int, auto &a_columns) {
+      for (const auto speed: std::get<2>(a_columns)) slow += speed < 10.0;
+      return 0;
+    }, 4, 64 << 10) == record_count);
+    CHECK(slow == record_count / 90 * 10 + std::min(record_count % 90, size_t{10}));
+
+    reader.header_on_first_line = false;
+    CHECK(reader.read([](int, auto) { return 0; }, 2) == record_count + 1);
+    CHECK(reader.invalid_field_count() == 1);
+    std::filesystem::remove(path);
+  }
 }
@@ -0,0 +1,323 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_MMAP_ARRAY_HPP
+#define WXLIB_MIO_MMAP_ARRAY_HPP
+
+#include <mio/mio.hpp>
+#include <mio/executor.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace mio {
+
+/**
+   A typed view of a file of fixed size records, e.g. a binary OD matrix of `float`, or an array
+   of link states, mapped and used in place, with no parse step.
+
+   Mapping fails with `std::errc::invalid_argument` unless the mapped bytes are a whole number of
+   `T`, and aligned to `alignof(T)`, i.e. the byte offset mapped from is a multiple of it.
+
+   `Endian` is the byte order of the file. If it is the native one, the records are accessed in
+   place, by reference, e.g. through `operator[]`, `span` or iterators. Otherwise, only arithmetic
+   records can be accessed, by value, swapping their bytes, through `load` and `store`, which work
+   for both.
+
+   A write view, i.e. `mmap_array_sink`, also creates files of a given number of records, and
+   grows them, see `basic_mmap::grow`.
+
+   @code
+     std::error_code error;
+     mio::mmap_array_source<float> od;
+     od.map("od.bin", error);
+     const auto trips = od[origin * zone_count + destination];
+
+     od.for_each_chunk(8, [](int a_id, std::span<const float> a_chunk) {
+       // ... do something about the chunk.
+       return 0;
+     });
+   @endcode
+ */
+template<typename T, access_mode AccessMode = access_mode::read, std::endian Endian = std::endian::native>
+requires std::is_trivially_copyable_v<T>
+class mmap_array
+{
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using element_type = std::conditional_t<AccessMode == access_mode::write, T, const T>;
+  using pointer = element_type *;
+  using const_pointer = const T *;
+  using reference = element_type &;
+  using const_reference = const T &;
+  using iterator = pointer;
+  using const_iterator = const_pointer;
+
+  static constexpr bool native = Endian == std::endian::native;
+  static_assert(native || std::is_arithmetic_v<T>, "Only arithmetic records can be swapped to the native byte order.");
+
+  mmap_array() = default;
+
+  /**
+     Maps the whole file, see `map`. If the file cannot be mapped, std::system_error will be thrown
+     with error code describing the nature of the error.
+   */
+  explicit mmap_array(const std::string &path)
+  {
+    std::error_code error;
+    map(path, error);
+    if (error) throw std::system_error(error);
+  }
+
+  /**
+     Maps `count` records of the file, starting at record `first`, or all the records from it on
+     if `count` is `map_entire_file`.
+   */
+  template<typename StrT>
+  void map(const StrT &path, const size_type first, const size_type count, std::error_code &error)
+  {
+    const auto length = count == static_cast<size_type>(map_entire_file) ? static_cast<size_type>(map_entire_file) : count * sizeof(T);
+    mmap_.map(path, first * sizeof(T), length, error);
+    if (!error) check(error);
+  }
+
+  /**
+     Maps all the records of the file.
+   */
+  template<typename StrT>
+  void map(const StrT &path, std::error_code &error)
+  {
+    map(path, 0, map_entire_file, error);
+  }
+
+  /**
+     Creates a file of `count` zero records, or truncates it if it exists, and maps it, unless
+     `count` is 0, since an empty file cannot be mapped.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void create(const std::string &path, const size_type count, std::error_code &error)
+  {
+    error.clear();
+    mmap_.unmap();
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      if (!file) {
+        error = std::make_error_code(std::errc::io_error);
+        return;
+      }
+    }
+
+    // An empty file cannot be mapped.
+    if (count == 0) return;
+
+    std::filesystem::resize_file(path, count * sizeof(T), error);
+    if (!error) mmap_.map(path, error);
+  }
+
+  /**
+     Grows the file and the mapping to `count` records, the new ones zero, see `basic_mmap::grow`,
+     which may move `data()`. Does nothing if `count` is not larger than `size()`.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void grow(const size_type count, std::error_code &error)
+  {
+    mmap_.grow(count * sizeof(T), error);
+  }
+
+  /**
+     Writes the records back to the file, see `basic_mmap::sync`.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void sync(std::error_code &error)
+  {
+    mmap_.sync(error);
+  }
+
+  void unmap() noexcept
+  {
+    mmap_.unmap();
+  }
+
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return mmap_.is_mapped();
+  }
+
+  /**
+     Number of records mapped.
+   */
+  [[nodiscard]] size_type size() const noexcept
+  {
+    return mmap_.size() / sizeof(T);
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+
+  /**
+     The underlying byte mapping, e.g. to apply access hints or prefetch.
+   */
+  [[nodiscard]] basic_mmap<AccessMode, char> &bytes() noexcept
+  {
+    return mmap_;
+  }
+
+  [[nodiscard]] const basic_mmap<AccessMode, char> &bytes() const noexcept
+  {
+    return mmap_;
+  }
+
+  [[nodiscard]] pointer data() noexcept requires native
+  {
+    return reinterpret_cast<pointer>(mmap_.data());
+  }
+
+  [[nodiscard]] const_pointer data() const noexcept requires native
+  {
+    return reinterpret_cast<const_pointer>(mmap_.data());
+  }
+
+  [[nodiscard]] reference operator[](const size_type i) noexcept requires native
+  {
+    return data()[i];
+  }
+
+  [[nodiscard]] const_reference operator[](const size_type i) const noexcept requires native
+  {
+    return data()[i];
+  }
+
+  [[nodiscard]] iterator begin() noexcept requires native
+  {
+    return data();
+  }
+
+  [[nodiscard]] const_iterator begin() const noexcept requires native
+  {
+    return data();
+  }
+
+  [[nodiscard]] iterator end() noexcept requires native
+  {
+    return data() + size();
+  }
+
+  [[nodiscard]] const_iterator end() const noexcept requires native
+  {
+    return data() + size();
+  }
+
+  [[nodiscard]] std::span<element_type> span() noexcept requires native
+  {
+    return {data(), size()};
+  }
+
+  [[nodiscard]] std::span<const T> span() const noexcept requires native
+  {
+    return {data(), size()};
+  }
+
+  /**
+     Reads the i-th record, in the native byte order.
+   */
+  [[nodiscard]] T load(const size_type i) const noexcept
+  {
+    auto bytes = std::array<char, sizeof(T)>{};
+    std::copy_n(mmap_.data() + i * sizeof(T), sizeof(T), bytes.data());
+    if constexpr (!native) std::ranges::reverse(bytes);
+    return std::bit_cast<T>(bytes);
+  }
+
+  /**
+     Writes the i-th record, from the native byte order.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void store(const size_type i, const T &value) noexcept
+  {
+    auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+    if constexpr (!native) std::ranges::reverse(bytes);
+    std::copy_n(bytes.data(), sizeof(T), mmap_.data() + i * sizeof(T));
+  }
+
+  /**
+     Splits the records evenly into `num_threads` chunks, and fires the callback for each chunk
+     concurrently, on the shared executor, as `f(int chunk_id, std::span<element_type> chunk)`,
+     which returns 0 to succeed. Every chunk is processed, whatever the status codes.
+
+     \param   num_threads  Number of threads, 0 treated as 1.
+     \returns The first non-zero status code returned, in the order of the chunks, or 0.
+   */
+  template<typename F>
+  requires native
+  int for_each_chunk(const size_t num_threads, const F &f)
+  {
+    return for_each_chunk_impl(span(), num_threads, f);
+  }
+
+  template<typename F>
+  requires native
+  int for_each_chunk(const size_t num_threads, const F &f) const
+  {
+    return for_each_chunk_impl(span(), num_threads, f);
+  }
+
+private:
+  void check(std::error_code &error) noexcept
+  {
+    const auto misaligned = reinterpret_cast<uintptr_t>(mmap_.data()) % alignof(T) != 0;
+    if (misaligned || mmap_.size() % sizeof(T) != 0) {
+      mmap_.unmap();
+      error = std::make_error_code(std::errc::invalid_argument);
+    }
+  }
+
+  template<typename U, typename F>
+  static int for_each_chunk_impl(const std::span<U> records, const size_t num_threads, const F &f)
+  {
+    const auto count = std::max(num_threads, size_t{1});
+    const auto chunk = (records.size() + count - 1) / count;
+
+    auto statuses = std::vector<int>(count);
+    Executor::shared().run_workers(count, [&](const size_t i) {
+      const auto first = std::min(i * chunk, records.size());
+      statuses[i] = f(static_cast<int>(i), records.subspan(first, std::min(chunk, records.size() - first)));
+    });
+
+    const auto failed = std::ranges::find_if(statuses, [](const int s) { return s != 0; });
+    return failed == statuses.end() ? 0 : *failed;
+  }
+
+  basic_mmap<AccessMode, char> mmap_;
+};
+
+/**
+   A read only typed view of a file of records.
+ */
+template<typename T, std::endian Endian = std::endian::native>
+using mmap_array_source = mmap_array<T, access_mode::read, Endian>;
+
+/**
+   A read write typed view of a file of records.
+ */
+template<typename T, std::endian Endian = std::endian::native>
+using mmap_array_sink = mmap_array<T, access_mode::write, Endian>;
+
+}
+#endif
@@ -0,0 +1,387 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_NET_EXPORT_HPP
+#define WXLIB_MIO_NET_EXPORT_HPP
+
+#include <mio/mio.hpp>
+#include <mio/lineindex.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <mswsock.h>
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Mswsock.lib")
+#else
+#include <cerrno>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace mio {
+
+#ifdef _WIN32
+using socket_handle_type = SOCKET;
+#else
+using socket_handle_type = int;
+#endif
+
+/**
+   How a range was exported, see export_range().
+ */
+enum class ExportMethod
+{
+  None,         // Nothing to export.
+  Sendfile,     // sendfile(2), from the file to a socket, Linux.
+  Splice,       // splice(2), from the file to a pipe, Linux.
+  Vmsplice,     // vmsplice(2), from the mapping to a pipe, Linux.
+  TransmitFile, // TransmitFile, from the file to a socket, Windows.
+  Writev        // writev(2), or WSASend on Windows, from the mapping; the fallback.
+};
+
+struct ExportResult
+{
+  size_t bytes{0};
+  ExportMethod method{ExportMethod::None};
+};
+
+/**
+   A byte range [offset, offset + length) of a mapping.
+ */
+struct ByteRange
+{
+  size_t offset{0};
+  size_t length{0};
+};
+
+namespace detail {
+
+#ifdef _WIN32
+inline std::error_code socket_error() noexcept
+{
+  return {::WSAGetLastError(), std::system_category()};
+}
+#else
+/**
+   Whether an error of a zero-copy call means the call does not support the pair of handles,
+   e.g. sendfile(2) to a file system without it, rather than the output failing.
+ */
+inline bool unsupported(const int a_errno) noexcept
+{
+  return a_errno == EINVAL || a_errno == ENOSYS || a_errno == EOPNOTSUPP || a_errno == EXDEV;
+}
+
+inline bool is_pipe(const int a_fd) noexcept
+{
+  struct stat st{};
+  return ::fstat(a_fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+#endif
+
+/**
+   Bytes handed to a zero-copy call at a time, below the 2 GiB limits of sendfile(2), splice(2)
+   and TransmitFile.
+ */
+inline constexpr size_t export_chunk_size = size_t{1} << 30;
+
+/**
+   Writes ranges of memory to an output, a batch of iovecs, or WSABUFs, per call, resuming
+   after partial writes.
+ */
+inline size_t write_ranges(const socket_handle_type a_out, const char *a_data, const std::span<const ByteRange> a_ranges, std::error_code &error)
+{
+#ifdef _WIN32
+  using buffer_type = WSABUF;
+  constexpr size_t max_buffers = 1024;
+  constexpr size_t max_length = ULONG_MAX;
+#else
+  using buffer_type = iovec;
+#ifdef IOV_MAX
+  constexpr size_t max_buffers = IOV_MAX;
+#else
+  constexpr size_t max_buffers = 1024;
+#endif
+  constexpr size_t max_length = SSIZE_MAX;
+#endif
+
+  auto buffers = std::vector<buffer_type>{};
+  auto done = size_t{0};
+  auto range = size_t{0};
+  auto skip = size_t{0}; // Bytes of a_ranges[range] already written.
+
+  while (range < a_ranges.size()) {
+    buffers.clear();
+    auto total = size_t{0};
+    for (auto r = range, s = skip; r < a_ranges.size() && buffers.size() < max_buffers; r++, s = 0) {
+      const auto length = std::min(a_ranges[r].length - s, max_length - total);
+      if (length == 0) break;
+      auto *base = const_cast<char *>(a_data + a_ranges[r].offset + s);
+#ifdef _WIN32
+      buffers.push_back({static_cast<ULONG>(length), base});
+#else
+      buffers.push_back({base, length});
+#endif
+      total += length;
+      if (length < a_ranges[r].length - s) break;
+    }
+    if (buffers.empty()) {
+      range++;
+      skip = 0;
+      continue;
+    }
+
+#ifdef _WIN32
+    auto n = DWORD{0};
+    if (::WSASend(a_out, buffers.data(), static_cast<DWORD>(buffers.size()), &n, 0, nullptr, nullptr) != 0) {
+      error = socket_error();
+      return done;
+    }
+    auto written = static_cast<size_t>(n);
+#else
+    const auto n = ::writev(a_out, buffers.data(), static_cast<int>(buffers.size()));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      error = last_error();
+      return done;
+    }
+    auto written = static_cast<size_t>(n);
+#endif
+    if (written == 0) break;
+
+    done += written;
+    while (written > 0) {
+      const auto left = a_ranges[range].length - skip;
+      if (written < left) {
+        skip += written;
+        break;
+      }
+      written -= left;
+      range++;
+      skip = 0;
+    }
+  }
+
+  return done;
+}
+
+/**
+   Exports a range of a file with the zero-copy call of a method, setting a_unsupported instead
+   of error if the call does not support the handles, before any byte is exported.
+ */
+inline size_t transfer_file(const ExportMethod a_method, const socket_handle_type a_out, const file_handle_type a_file, const uint64_t a_offset,
+                            const size_t a_length, bool &a_unsupported, std::error_code &error)
+{
+#if !defined(_WIN32) && !defined(__linux__)
+  (void) a_method, (void) a_out, (void) a_file, (void) a_offset, (void) a_length, (void) error;
+  a_unsupported = true;
+  return 0;
+#else
+  auto done = size_t{0};
+  while (done < a_length) {
+    const auto chunk = std::min(a_length - done, export_chunk_size);
+#ifdef _WIN32
+    (void) a_method;
+    const auto offset = a_offset + done;
+    auto overlapped = OVERLAPPED{};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    overlapped.hEvent = ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    if (overlapped.hEvent == nullptr) {
+      error = last_error();
+      return done;
+    }
+
+    auto sent = DWORD{0};
+    auto flags = DWORD{0};
+    const auto ok = (::TransmitFile(a_out, a_file, static_cast<DWORD>(chunk), 0, &overlapped, nullptr, 0) || ::WSAGetLastError() == WSA_IO_PENDING)
+        && ::WSAGetOverlappedResult(a_out, &overlapped, &sent, TRUE, &flags);
+    const auto code = ok ? 0 : ::WSAGetLastError();
+    ::CloseHandle(overlapped.hEvent);
+    if (!ok) {
+      if (done == 0 && code == WSAEOPNOTSUPP) a_unsupported = true;
+      else error = {code, std::system_category()};
+      return done;
+    }
+    const auto n = static_cast<size_t>(sent);
+#else
+    auto offset = static_cast<loff_t>(a_offset + done);
+    const auto sent = a_method == ExportMethod::Splice ? ::splice(a_file, &offset, a_out, nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_MORE)
+                                                       : ::sendfile(a_out, a_file, &offset, chunk);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      if (done == 0 && unsupported(errno)) a_unsupported = true;
+      else error = last_error();
+      return done;
+    }
+    const auto n = static_cast<size_t>(sent);
+#endif
+    // The file is shorter than the mapping, e.g. truncated meanwhile.
+    if (n == 0) break;
+    done += n;
+  }
+
+  return done;
+#endif
+}
+
+/**
+   Exports a range of memory to a pipe with vmsplice(2), setting a_unsupported as above.
+ */
+inline size_t transfer_memory(const socket_handle_type a_out, const char *a_data, const size_t a_length, bool &a_unsupported, std::error_code &error)
+{
+#ifdef __linux__
+  auto done = size_t{0};
+  while (done < a_length) {
+    auto buffer = iovec{const_cast<char *>(a_data + done), std::min(a_length - done, export_chunk_size)};
+    const auto n = ::vmsplice(a_out, &buffer, 1, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (done == 0 && unsupported(errno)) a_unsupported = true;
+      else error = last_error();
+      return done;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return done;
+#else
+  (void) a_out, (void) a_data, (void) a_length, (void) error;
+  a_unsupported = true;
+  return 0;
+#endif
+}
+
+/**
+   The zero-copy method for an output and a mapping, Writev if none applies.
+ */
+inline ExportMethod export_method(const socket_handle_type a_out, const bool a_has_file) noexcept
+{
+#ifdef _WIN32
+  (void) a_out;
+  return a_has_file ? ExportMethod::TransmitFile : ExportMethod::Writev;
+#elif defined(__linux__)
+  if (is_pipe(a_out)) return a_has_file ? ExportMethod::Splice : ExportMethod::Vmsplice;
+  return a_has_file ? ExportMethod::Sendfile : ExportMethod::Writev;
+#else
+  (void) a_out, (void) a_has_file;
+  return ExportMethod::Writev;
+#endif
+}
+
+}
+
+/**
+   A mapping exportable to an output, basic_mmap or basic_shared_mmap.
+ */
+template<typename MapT>
+concept ExportableMap = requires(const MapT &a_map) {
+  { a_map.data() } -> std::convertible_to<const void *>;
+  { a_map.size() } -> std::convertible_to<size_t>;
+  { a_map.file_handle() } -> std::convertible_to<file_handle_type>;
+  { a_map.file_offset() } -> std::convertible_to<size_t>;
+  { a_map.is_anonymous() } -> std::convertible_to<bool>;
+};
+
+/**
+   Exports ranges of a mapping to a socket or a pipe without copying them through user space.
+
+   The ranges of a file mapping are sent from the file itself, with sendfile(2) to a socket, or
+   splice(2) to a pipe, on Linux, and TransmitFile to a socket on Windows, so that the kernel
+   moves the pages of the page cache to the output. Anonymous mappings are moved to a pipe with
+   vmsplice(2). Otherwise, e.g. to a socket on other systems, or if the zero-copy call does not
+   support the file or the output, the ranges are written from the mapping by batches of writev(2),
+   or WSASend, still with no user space copy.
+
+   vmsplice(2) gives the pipe references to the pages of the mapping, which must not be modified
+   until the reader of the pipe has read them. The output may be non-blocking, in which case the
+   export stops with `errc::resource_unavailable_try_again`, or WSAEWOULDBLOCK, once the output is
+   full, the bytes exported so far telling where to resume.
+
+   @code
+     mio::mmap_source network("network.bin");
+     auto result = mio::export_ranges(network, client, std::array{mio::ByteRange{links_offset, links_size}}, error);
+   @endcode
+
+   \param a_ranges Ranges, clamped to the mapping.
+   \param error Set if the export fails, see above.
+   \returns Number of bytes exported, and the method used.
+ */
+template<ExportableMap MapT>
+ExportResult export_ranges(const MapT &a_map, const socket_handle_type a_out, const std::span<const ByteRange> a_ranges, std::error_code &error)
+{
+  error.clear();
+  auto result = ExportResult{};
+  const auto *data = reinterpret_cast<const char *>(a_map.data());
+  const auto has_file = !a_map.is_anonymous() && a_map.file_handle() != invalid_handle;
+  auto method = detail::export_method(a_out, has_file);
+
+  auto ranges = std::vector<ByteRange>{};
+  ranges.reserve(a_ranges.size());
+  for (const auto &range : a_ranges)
+    if (range.offset < a_map.size() && range.length > 0) ranges.push_back({range.offset, std::min<size_t>(range.length, a_map.size() - range.offset)});
+  if (ranges.empty()) return result;
+
+  for (size_t i = 0; i < ranges.size() && method != ExportMethod::Writev; i++) {
+    const auto &range = ranges[i];
+    auto unsupported = false;
+    const auto n = method == ExportMethod::Vmsplice
+        ? detail::transfer_memory(a_out, data + range.offset, range.length, unsupported, error)
+        : detail::transfer_file(method, a_out, a_map.file_handle(), a_map.file_offset() + range.offset, range.length, unsupported, error);
+    result.bytes += n;
+
+    // Falls back from the range the call does not support, none of which was exported.
+    if (unsupported) {
+      ranges.erase(ranges.begin(), ranges.begin() + static_cast<ptrdiff_t>(i));
+      break;
+    }
+    if (error || n < range.length || i + 1 == ranges.size()) {
+      result.method = method;
+      return result;
+    }
+  }
+
+  result.method = ExportMethod::Writev;
+  result.bytes += detail::write_ranges(a_out, data, ranges, error);
+  return result;
+}
+
+/**
+   Exports a range of a mapping, see export_ranges().
+ */
+template<ExportableMap MapT>
+ExportResult export_range(const MapT &a_map, const socket_handle_type a_out, const size_t a_offset, const size_t a_length, std::error_code &error)
+{
+  const auto range = ByteRange{a_offset, a_length};
+  return export_ranges(a_map, a_out, std::span{&range, 1}, error);
+}
+
+/**
+   Exports the lines [a_first, a_last) of a mapping, with their terminating `\n`, found by a
+   line index built on the same mapping, see export_ranges().
+ */
+template<ExportableMap MapT>
+ExportResult export_lines(const MapT &a_map, const LineIndex &a_index, const socket_handle_type a_out, const size_t a_first, const size_t a_last,
+                          std::error_code &error)
+{
+  const auto last = std::min(a_last, a_index.line_count());
+  if (a_first >= last) {
+    error.clear();
+    return {};
+  }
+
+  const auto [begin, end] = a_index.byte_range(a_first, last);
+  return export_range(a_map, a_out, static_cast<size_t>(begin), static_cast<size_t>(end - begin), error);
+}
+
+}
+#endif
@@ -0,0 +1,661 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_NETWORK_HPP
+#define WXLIB_MIO_NETWORK_HPP
+
+#include <mio/mio.hpp>
+#include <mio/csvreader.hpp>
+#include <mio/executor.hpp>
+#include <mio/extent.hpp>
+#include <mio/hashindex.hpp>
+#include <mio/replacefile.hpp>
+#include <mio/trace.hpp>
+#include <mio/utf8.hpp>
+#include <mio/wkt.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+namespace mio {
+
+/**
+   A road network loaded from the GMNS node.csv and link.csv files, as a compressed sparse row
+   (CSR) graph: the links leaving each node are contiguous, node i owning the links
+   [out_offsets()[i], out_offsets()[i + 1]), and every attribute is an array of its own (SoA),
+   so that a shortest path or an assignment scans only the arrays it needs.
+
+   The nodes are numbered densely in the order of their node_id, and the links by the dense
+   number of their from node, then of their to node, then by link_id, so that the numbering only
+   depends on the files. Node IDs are remapped to the dense numbers through a HashIndex, probed
+   in parallel. Links whose from or to node is not in node.csv are dropped, see
+   dropped_link_count().
+
+   node.csv must have the columns node_id, x_coord and y_coord, and link.csv the columns
+   link_id, from_node_id, to_node_id, length and capacity, in any order and with any other
+   columns, see CsvDoc::MapHeader. The link geometries are read from a geometry column, as in
+   the GMNS specification, or else a WKT column, as WKT linestrings; a link with neither, or an
+   invalid one, has no points.
+
+   Both files are read with CsvReader on a_num_threads threads on first load, and the network
+   written to a binary cache, with its node index next to it; later loads map the cache, with
+   no parsing at all. As for CsvCache, the cache records the size, last write time and a hash
+   of the first and last 64 KiB of both files, and is rebuilt if either has changed. The cache
+   uses the native byte order, and is not meant to be shared across platforms.
+
+   @code
+     mio::Network network;
+     std::error_code error;
+     network.open("node.csv", "link.csv", error);
+
+     const auto lengths = network.lengths();
+     for (const auto l: network.out_links(network.node_of(node_id))) {
+       // ... the link l goes to the node network.to_nodes()[l], over lengths[l].
+     }
+   @endcode
+ */
+class Network
+{
+public:
+  /**
+     Returned by node_of() for a node ID not in the network.
+   */
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+  Network() = default;
+  Network(const Network &) = delete;
+  Network &operator=(const Network &) = delete;
+
+  /**
+     Same as open(a_node_csv, a_link_csv, default_cache(a_link_csv), error, a_num_threads).
+   */
+  bool open(const std::string &a_node_csv, const std::string &a_link_csv, std::error_code &error, const size_t a_num_threads = available_concurrency())
+  {
+    return open(a_node_csv, a_link_csv, default_cache(a_link_csv), error, a_num_threads);
+  }
+
+  /**
+     Maps the cache of a network, after building it from the csv files if it is missing or
+     stale.
+
+     \param a_node_csv The GMNS node file.
+     \param a_link_csv The GMNS link file.
+     \param a_cache The cache file, e.g. Network::default_cache(a_link_csv); its node index is
+     written to the same name with `.hidx` appended.
+     \param error Set to describe the error if a file cannot be read, its header line lacks a
+     column needed, there are more nodes than a uint32_t numbers, or the cache cannot be written.
+     \param a_num_threads Number of threads reading the csv files and building the graph.
+     \returns true if the network is mapped.
+   */
+  bool open(const std::string &a_node_csv, const std::string &a_link_csv, const std::string &a_cache, std::error_code &error,
+            const size_t a_num_threads = available_concurrency())
+  {
+    rebuilt_ = false;
+    if (load(a_node_csv, a_link_csv, a_cache, error)) return true;
+    if (!build(a_node_csv, a_link_csv, a_cache, error, std::max(a_num_threads, size_t{1}))) return false;
+
+    rebuilt_ = true;
+    return load(a_node_csv, a_link_csv, a_cache, error);
+  }
+
+  /**
+     Returns the conventional cache file name of a network, i.e. the link file name with
+     `.wxn` appended.
+   */
+  [[nodiscard]] static std::string default_cache(const std::string &a_link_csv)
+  {
+    return a_link_csv + ".wxn";
+  }
+
+  /**
+     Checks whether the last open() had to build the cache from the csv files.
+   */
+  [[nodiscard]] bool rebuilt() const noexcept
+  {
+    return rebuilt_;
+  }
+
+  [[nodiscard]] size_t node_count() const noexcept
+  {
+    return header_.node_count;
+  }
+
+  [[nodiscard]] size_t link_count() const noexcept
+  {
+    return header_.link_count;
+  }
+
+  /**
+     Number of links of link.csv not in the network, as their from or to node is not in
+     node.csv.
+   */
+  [[nodiscard]] size_t dropped_link_count() const noexcept
+  {
+    return header_.dropped_link_count;
+  }
+
+  /**
+     Returns the dense number of a node, or npos if the node ID is not in the network.
+   */
+  [[nodiscard]] uint32_t node_of(const int64_t a_node_id) const noexcept
+  {
+    const auto i = index_.find(a_node_id);
+    return i == index_.npos ? npos : static_cast<uint32_t>(i);
+  }
+
+  /**
+     The node_id of each node, in ascending order.
+   */
+  [[nodiscard]] std::span<const int64_t> node_ids() const noexcept
+  {
+    return array<int64_t>(NodeIds);
+  }
+
+  [[nodiscard]] std::span<const double> node_x() const noexcept
+  {
+    return array<double>(NodeX);
+  }
+
+  [[nodiscard]] std::span<const double> node_y() const noexcept
+  {
+    return array<double>(NodeY);
+  }
+
+  /**
+     The CSR row offsets, node_count() + 1 of them: the links leaving node i are those from
+     out_offsets()[i] to out_offsets()[i + 1].
+   */
+  [[nodiscard]] std::span<const uint64_t> out_offsets() const noexcept
+  {
+    return array<uint64_t>(OutOffsets);
+  }
+
+  /**
+     The numbers of the links leaving a node.
+   */
+  [[nodiscard]] auto out_links(const uint32_t a_node) const noexcept
+  {
+    const auto offsets = out_offsets();
+    return std::views::iota(offsets[a_node], offsets[a_node + 1]);
+  }
+
+  [[nodiscard]] size_t out_degree(const uint32_t a_node) const noexcept
+  {
+    const auto offsets = out_offsets();
+    return static_cast<size_t>(offsets[a_node + 1] - offsets[a_node]);
+  }
+
+  [[nodiscard]] std::span<const int64_t> link_ids() const noexcept
+  {
+    return array<int64_t>(LinkIds);
+  }
+
+  /**
+     The dense number of the from node of each link.
+   */
+  [[nodiscard]] std::span<const uint32_t> from_nodes() const noexcept
+  {
+    return array<uint32_t>(FromNodes);
+  }
+
+  /**
+     The dense number of the to node of each link.
+   */
+  [[nodiscard]] std::span<const uint32_t> to_nodes() const noexcept
+  {
+    return array<uint32_t>(ToNodes);
+  }
+
+  [[nodiscard]] std::span<const double> lengths() const noexcept
+  {
+    return array<double>(Lengths);
+  }
+
+  [[nodiscard]] std::span<const double> capacities() const noexcept
+  {
+    return array<double>(Capacities);
+  }
+
+  /**
+     The x coordinates of the points of the geometry of a link, of all its parts.
+   */
+  [[nodiscard]] std::span<const double> link_x(const size_t a_link) const noexcept
+  {
+    return points(GeometryX, a_link);
+  }
+
+  /**
+     The y coordinates of the points of the geometry of a link, of all its parts.
+   */
+  [[nodiscard]] std::span<const double> link_y(const size_t a_link) const noexcept
+  {
+    return points(GeometryY, a_link);
+  }
+
+  /**
+     The offsets of the points of the link geometries, link_count() + 1 of them: the points of
+     link l are those from geometry_offsets()[l] to geometry_offsets()[l + 1] of geometry_x()
+     and geometry_y().
+   */
+  [[nodiscard]] std::span<const uint64_t> geometry_offsets() const noexcept
+  {
+    return array<uint64_t>(GeometryOffsets);
+  }
+
+  [[nodiscard]] std::span<const double> geometry_x() const noexcept
+  {
+    return array<double>(GeometryX);
+  }
+
+  [[nodiscard]] std::span<const double> geometry_y() const noexcept
+  {
+    return array<double>(GeometryY);
+  }
+
+  /**
+     Unmaps the cache and its node index.
+   */
+  void close() noexcept
+  {
+    mmap_.unmap();
+    index_.close();
+    header_ = {};
+    entries_ = {};
+  }
+
+private:
+  // The arrays of the cache, in file order.
+  enum Array : size_t
+  {
+    NodeIds,
+    NodeX,
+    NodeY,
+    OutOffsets,
+    LinkIds,
+    FromNodes,
+    ToNodes,
+    Lengths,
+    Capacities,
+    GeometryOffsets,
+    GeometryX,
+    GeometryY,
+    ArrayCount
+  };
+
+  struct Stamp
+  {
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+
+    bool operator==(const Stamp &) const = default;
+  };
+
+  struct CacheHeader
+  {
+    char magic[8] = {'W', 'X', 'N', 'E', 'T', 'W', '0', '1'};
+    Stamp nodes{};
+    Stamp links{};
+    uint64_t node_count = 0;
+    uint64_t link_count = 0;
+    uint64_t dropped_link_count = 0;
+    uint64_t array_count = ArrayCount;
+    uint64_t reserved[5] = {};
+  };
+
+  static_assert(sizeof(CacheHeader) % 64 == 0);
+
+  // {offset, size} of each array.
+  using Entries = ExtentTable<ArrayCount>;
+
+  struct Link
+  {
+    int64_t id;
+    int64_t from;
+    int64_t to;
+    double length;
+    double capacity;
+    // The geometry, the index in the WktGeometries of the worker which read the link.
+    uint32_t worker;
+    uint32_t geometry;
+    uint32_t from_node;
+    uint32_t to_node;
+  };
+
+  static constexpr size_t alignment = 64;
+  static constexpr size_t hashed_size = size_t{64} << 10;
+
+  template<typename T>
+  [[nodiscard]] std::span<const T> array(const Array a_array) const noexcept
+  {
+    const auto [offset, size] = entries_[a_array];
+    return {reinterpret_cast<const T *>(std::next(mmap_.data(), static_cast<std::ptrdiff_t>(offset))), static_cast<size_t>(size / sizeof(T))};
+  }
+
+  [[nodiscard]] std::span<const double> points(const Array a_array, const size_t a_link) const noexcept
+  {
+    const auto offsets = array<uint64_t>(GeometryOffsets);
+    return array<double>(a_array).subspan(offsets[a_link], offsets[a_link + 1] - offsets[a_link]);
+  }
+
+  static std::string index_file(const std::string &a_cache)
+  {
+    return a_cache + ".hidx";
+  }
+
+  static uint64_t fnv1a(std::string_view a_bytes, uint64_t a_hash = 0xCBF29CE484222325ull) noexcept
+  {
+    for (const auto c: a_bytes) a_hash = (a_hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    return a_hash;
+  }
+
+  // Only the pages hashed are read from the file.
+  static bool stamp(Stamp &a_stamp, const std::string &a_csv, std::error_code &error)
+  {
+    const auto source = make_mmap_source(a_csv, error);
+    if (error) return false;
+    a_stamp.size = std::filesystem::file_size(a_csv, error);
+    if (error) return false;
+    a_stamp.time = std::filesystem::last_write_time(a_csv, error).time_since_epoch().count();
+    if (error) return false;
+
+    const std::string_view content{source.data(), source.size()};
+    const auto head = content.substr(0, hashed_size);
+    const auto tail = content.substr(content.size() - std::min(content.size(), hashed_size));
+    a_stamp.hash = fnv1a(tail, fnv1a(head));
+    return true;
+  }
+
+  bool load(const std::string &a_node_csv, const std::string &a_link_csv, const std::string &a_cache, std::error_code &error)
+  {
+    close();
+    error.clear();
+    if (!std::filesystem::exists(a_cache, error) || !std::filesystem::exists(index_file(a_cache), error)) {
+      if (!error) error = std::make_error_code(std::errc::no_such_file_or_directory);
+      return false;
+    }
+
+    auto expected = CacheHeader{};
+    if (!stamp(expected.nodes, a_node_csv, error) || !stamp(expected.links, a_link_csv, error)) return false;
+
+    mmap_.map(a_cache, error);
+    if (error) return false;
+
+    auto header = CacheHeader{};
+    auto entries = Entries{};
+    const auto valid = [&] {
+      if (!read_extent_table({mmap_.data(), mmap_.size()}, header, entries, alignment)) return false;
+
+      if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.nodes != expected.nodes
+          || header.links != expected.links || header.array_count != expected.array_count)
+        return false;
+
+      return entries[OutOffsets].size == (header.node_count + 1) * sizeof(uint64_t)
+          && entries[GeometryOffsets].size == (header.link_count + 1) * sizeof(uint64_t);
+    }();
+
+    if (valid) index_.open(index_file(a_cache), error);
+    if (!valid || error || index_.size() != header.node_count) {
+      close();
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    header_ = header;
+    entries_ = entries;
+    return true;
+  }
+
+  /**
+     Whether the header line of a csv file has a column of the given name.
+   */
+  static bool has_column(const std::string &a_csv, std::string_view a_name)
+  {
+    auto in = std::ifstream{a_csv, std::ios::binary};
+    auto line = std::string{};
+    std::getline(in, line);
+
+    auto header = skip_utf8_bom(line);
+    if (!header.empty() && header.back() == '\r') header.remove_suffix(1);
+    while (!header.empty()) {
+      const auto comma = std::min(header.find(','), header.size());
+      auto name = header.substr(0, comma);
+      while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+      while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+      if (name.size() >= 2 && name.front() == '"' && name.back() == '"') name = name.substr(1, name.size() - 2);
+      if (name == a_name) return true;
+      header.remove_prefix(std::min(comma + 1, header.size()));
+    }
+    return false;
+  }
+
+  /**
+     Reads the columns of a csv file on a_num_threads threads, and hands each columnar block
+     to a_on_block(worker_id, columns) in the context of its worker.
+   */
+  template<typename ...Ts, typename F>
+  static bool read_csv(const std::string &a_csv, const size_t a_num_threads, std::error_code &error, const F &a_on_block)
+  {
+    if (!std::filesystem::exists(a_csv, error)) {
+      if (!error) error = std::make_error_code(std::errc::no_such_file_or_directory);
+      return false;
+    }
+
+    auto reader = csv::CsvReader<Ts...>{a_csv};
+    reader.map_columns_by_name = true;
+    if (!std::get<0>(reader.verify_header())) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    reader.read_columns([&](const int a_id, auto &a_columns) {
+      a_on_block(a_id, a_columns);
+      return 0;
+    }, a_num_threads);
+    return true;
+  }
+
+  /**
+     Reads link.csv into the links of each worker, each worker parsing the geometries of its
+     links into a_geometries[worker_id] as it reads them.
+   */
+  template<typename GeometryT>
+  static bool read_links(const std::string &a_link_csv, const size_t a_num_threads, std::vector<std::vector<Link>> &a_links,
+                         std::vector<csv::WktGeometries<double>> &a_geometries, std::error_code &error)
+  {
+    using namespace mio::csv;
+
+    return read_csv<Field<NAME("link_id"), int64_t>, Field<NAME("from_node_id"), int64_t>, Field<NAME("to_node_id"), int64_t>,
+                    Field<NAME("length"), double>, Field<NAME("capacity"), double>, GeometryT>(
+        a_link_csv, a_num_threads, error, [&](const int a_id, auto &a_columns) {
+          auto &links = a_links[a_id];
+          auto &geometries = a_geometries[a_id];
+          const auto &[ids, from, to, lengths, capacities, texts] = a_columns;
+          for (size_t i = 0; i < ids.size(); i++) {
+            const auto geometry = static_cast<uint32_t>(geometries.size());
+            if constexpr (std::is_same_v<typename GeometryT::value_type, std::string_view>)
+              geometries.append(texts[i]);
+            else
+              geometries.append(std::string_view{"LINESTRING EMPTY"});
+            links.push_back({ids[i], from[i], to[i], lengths[i], capacities[i], static_cast<uint32_t>(a_id), geometry, npos, npos});
+          }
+        });
+  }
+
+  bool build(const std::string &a_node_csv, const std::string &a_link_csv, const std::string &a_cache, std::error_code &error, const size_t a_num_threads)
+  {
+    using namespace mio::csv;
+    WXLIB_TRACE_SPAN("mio.network.build");
+    error.clear();
+
+    auto header = CacheHeader{};
+    if (!stamp(header.nodes, a_node_csv, error) || !stamp(header.links, a_link_csv, error)) return false;
+
+    struct Node
+    {
+      int64_t id;
+      double x;
+      double y;
+    };
+
+    // The nodes, numbered in the order of their IDs, a repeated ID kept once.
+    auto nodes_of_worker = std::vector<std::vector<Node>>(a_num_threads);
+    const auto read_nodes = read_csv<Field<NAME("node_id"), int64_t>, Field<NAME("x_coord"), double>, Field<NAME("y_coord"), double>>(
+        a_node_csv, a_num_threads, error, [&](const int a_id, auto &a_columns) {
+          const auto &[ids, x, y] = a_columns;
+          for (size_t i = 0; i < ids.size(); i++) nodes_of_worker[a_id].push_back({ids[i], x[i], y[i]});
+        });
+    if (!read_nodes) return false;
+
+    auto nodes = std::vector<Node>{};
+    for (auto &part: nodes_of_worker) nodes.insert(nodes.end(), part.begin(), part.end());
+    nodes_of_worker = {};
+    std::sort(nodes.begin(), nodes.end(), [](const Node &a, const Node &b) { return a.id < b.id; });
+    nodes.erase(std::unique(nodes.begin(), nodes.end(), [](const Node &a, const Node &b) { return a.id == b.id; }), nodes.end());
+    if (nodes.size() >= npos) {
+      error = std::make_error_code(std::errc::value_too_large);
+      return false;
+    }
+
+    auto node_ids = std::vector<int64_t>(nodes.size());
+    auto node_x = std::vector<double>(nodes.size());
+    auto node_y = std::vector<double>(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) node_ids[i] = nodes[i].id, node_x[i] = nodes[i].x, node_y[i] = nodes[i].y;
+    nodes = {};
+
+    HashIndex<int64_t>::build(index_file(a_cache), std::span<const int64_t>{node_ids}, error, a_num_threads);
+    if (error) return false;
+    auto index = HashIndex<int64_t>{};
+    index.open(index_file(a_cache), error);
+    if (error) return false;
+
+    auto links_of_worker = std::vector<std::vector<Link>>(a_num_threads);
+    auto geometries = std::vector<csv::WktGeometries<double>>(a_num_threads);
+    const auto read = has_column(a_link_csv, "geometry") ? read_links<QuotedField<NAME("geometry")>>(a_link_csv, a_num_threads, links_of_worker, geometries, error)
+                    : has_column(a_link_csv, "WKT")      ? read_links<QuotedField<NAME("WKT")>>(a_link_csv, a_num_threads, links_of_worker, geometries, error)
+                                                         : read_links<Skip<NAME("geometry")>>(a_link_csv, a_num_threads, links_of_worker, geometries, error);
+    if (!read) return false;
+
+    auto links = std::vector<Link>{};
+    for (auto &part: links_of_worker) links.insert(links.end(), part.begin(), part.end());
+    links_of_worker = {};
+
+    // Remaps the node IDs of the links through the index, in parallel, ...
+    auto &executor = Executor::shared();
+    executor.parallel_for(0, links.size(), [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) {
+        auto &link = links[i];
+        if (const auto from = index.find(link.from); from != index.npos) link.from_node = static_cast<uint32_t>(from);
+        if (const auto to = index.find(link.to); to != index.npos) link.to_node = static_cast<uint32_t>(to);
+      }
+    });
+
+    const auto known = std::partition(links.begin(), links.end(), [](const Link &a_link) { return a_link.from_node != npos && a_link.to_node != npos; });
+    header.dropped_link_count = static_cast<uint64_t>(std::distance(known, links.end()));
+    links.erase(known, links.end());
+
+    // ... then buckets the links by their from node, and orders each bucket.
+    auto out_offsets = std::vector<uint64_t>(node_ids.size() + 1, 0);
+    for (const auto &link: links) out_offsets[link.from_node + 1]++;
+    for (size_t i = 1; i < out_offsets.size(); i++) out_offsets[i] += out_offsets[i - 1];
+
+    auto ordered = std::vector<Link>(links.size());
+    {
+      auto next = std::vector<uint64_t>(out_offsets.begin(), std::prev(out_offsets.end()));
+      for (const auto &link: links) ordered[next[link.from_node]++] = link;
+    }
+    links = {};
+
+    executor.parallel_for(0, node_ids.size(), [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++)
+        std::sort(std::next(ordered.begin(), static_cast<std::ptrdiff_t>(out_offsets[i])), std::next(ordered.begin(), static_cast<std::ptrdiff_t>(out_offsets[i + 1])),
+                  [](const Link &a, const Link &b) { return std::tie(a.to_node, a.id) < std::tie(b.to_node, b.id); });
+    });
+
+    // The points of the geometries, in the order of the links, copied in parallel.
+    auto geometry_offsets = std::vector<uint64_t>(ordered.size() + 1, 0);
+    for (size_t i = 0; i < ordered.size(); i++)
+      geometry_offsets[i + 1] = geometry_offsets[i] + geometries[ordered[i].worker].x(ordered[i].geometry).size();
+
+    auto geometry_x = std::vector<double>(geometry_offsets.back());
+    auto geometry_y = std::vector<double>(geometry_offsets.back());
+    executor.parallel_for(0, ordered.size(), [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) {
+        const auto &geometry = geometries[ordered[i].worker];
+        const auto x = geometry.x(ordered[i].geometry);
+        const auto y = geometry.y(ordered[i].geometry);
+        std::copy(x.begin(), x.end(), std::next(geometry_x.begin(), static_cast<std::ptrdiff_t>(geometry_offsets[i])));
+        std::copy(y.begin(), y.end(), std::next(geometry_y.begin(), static_cast<std::ptrdiff_t>(geometry_offsets[i])));
+      }
+    });
+    geometries = {};
+
+    auto link_ids = std::vector<int64_t>(ordered.size());
+    auto from_nodes = std::vector<uint32_t>(ordered.size());
+    auto to_nodes = std::vector<uint32_t>(ordered.size());
+    auto lengths = std::vector<double>(ordered.size());
+    auto capacities = std::vector<double>(ordered.size());
+    for (size_t i = 0; i < ordered.size(); i++) {
+      const auto &link = ordered[i];
+      link_ids[i] = link.id, from_nodes[i] = link.from_node, to_nodes[i] = link.to_node;
+      lengths[i] = link.length, capacities[i] = link.capacity;
+    }
+
+    header.node_count = node_ids.size();
+    header.link_count = ordered.size();
+
+    auto bytes_of = [](const auto &a_vector) {
+      return std::string_view{reinterpret_cast<const char *>(a_vector.data()), a_vector.size() * sizeof(a_vector[0])};
+    };
+    const auto arrays = std::array<std::string_view, ArrayCount>{
+        bytes_of(node_ids), bytes_of(node_x), bytes_of(node_y), bytes_of(out_offsets), bytes_of(link_ids), bytes_of(from_nodes),
+        bytes_of(to_nodes), bytes_of(lengths), bytes_of(capacities), bytes_of(geometry_offsets), bytes_of(geometry_x), bytes_of(geometry_y)};
+    return write(a_cache, header, arrays, error);
+  }
+
+  /**
+     Writes the header, the entries and the arrays, each aligned to 64 bytes, to a temporary
+     file renamed to the cache once written.
+   */
+  static bool write(const std::string &a_cache, const CacheHeader &a_header, const std::array<std::string_view, ArrayCount> &a_arrays, std::error_code &error)
+  {
+    auto entries = Entries{};
+    auto position = static_cast<uint64_t>(sizeof(a_header) + sizeof(entries));
+    for (size_t i = 0; i < ArrayCount; i++) entries[i] = place_extent(position, a_arrays[i].size(), alignment);
+
+    return replace_file(a_cache, [&](std::ofstream &out) {
+      out.write(reinterpret_cast<const char *>(&a_header), sizeof(a_header));
+      out.write(reinterpret_cast<const char *>(&entries), sizeof(entries));
+      auto written = static_cast<uint64_t>(sizeof(a_header) + sizeof(entries));
+      for (size_t i = 0; i < ArrayCount; i++) {
+        static constexpr char padding[alignment] = {};
+        out.write(padding, static_cast<std::streamsize>(entries[i].offset - written));
+        out.write(a_arrays[i].data(), static_cast<std::streamsize>(a_arrays[i].size()));
+        written = entries[i].offset + entries[i].size;
+      }
+    }, error);
+  }
+
+  mmap_source mmap_;
+  HashIndex<int64_t> index_;
+  CacheHeader header_{};
+  Entries entries_{};
+  bool rebuilt_{false};
+};
+
+}
+#endif
@@ -0,0 +1,770 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_OD_MATRIX_HPP
+#define WXLIB_MIO_OD_MATRIX_HPP
+
+#include <mio/mio.hpp>
+#include <mio/executor.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/mmaparray.hpp>
+#include <mio/replacefile.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifdef WXLIB_MIO_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WXLIB_MIO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace mio {
+
+/**
+   Codecs compressing the tiles of a packed OdMatrix, see OdMatrix::pack. Zlib needs
+   WXLIB_MIO_WITH_ZLIB, and Zstd WXLIB_MIO_WITH_ZSTD.
+ */
+enum class TileCompression : uint32_t
+{
+  None, Zlib, Zstd
+};
+
+namespace detail {
+
+template<typename T>
+double od_sum(const T *a_values, const size_t a_count) noexcept
+{
+  // Four chains, so that the additions are not serialized on their latency.
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= a_count; i += 4) {
+    s0 += static_cast<double>(a_values[i]);
+    s1 += static_cast<double>(a_values[i + 1]);
+    s2 += static_cast<double>(a_values[i + 2]);
+    s3 += static_cast<double>(a_values[i + 3]);
+  }
+  for (; i < a_count; i++) s0 += static_cast<double>(a_values[i]);
+  return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef WXLIB_MIO_X86
+WXLIB_MIO_TARGET("avx2")
+inline double od_hsum(const __m256d a_sum) noexcept
+{
+  const auto pair = _mm_add_pd(_mm256_castpd256_pd128(a_sum), _mm256_extractf128_pd(a_sum, 1));
+  return _mm_cvtsd_f64(pair) + _mm_cvtsd_f64(_mm_unpackhi_pd(pair, pair));
+}
+
+/**
+   Sums floats in double precision, 16 at a time, widening each half of a vector.
+ */
+WXLIB_MIO_TARGET("avx2")
+inline double avx2_od_sum(const float *a_values, const size_t a_count) noexcept
+{
+  auto s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= a_count; i += 16) {
+    const auto a = _mm256_loadu_ps(a_values + i);
+    const auto b = _mm256_loadu_ps(a_values + i + 8);
+    s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+    s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+    s2 = _mm256_add_pd(s2, _mm256_cvtps_pd(_mm256_castps256_ps128(b)));
+    s3 = _mm256_add_pd(s3, _mm256_cvtps_pd(_mm256_extractf128_ps(b, 1)));
+  }
+  auto sum = od_hsum(_mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+  for (; i < a_count; i++) sum += static_cast<double>(a_values[i]);
+  return sum;
+}
+
+WXLIB_MIO_TARGET("avx2")
+inline double avx2_od_sum(const double *a_values, const size_t a_count) noexcept
+{
+  auto s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 16 <= a_count; i += 16) {
+    s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a_values + i));
+    s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a_values + i + 4));
+    s2 = _mm256_add_pd(s2, _mm256_loadu_pd(a_values + i + 8));
+    s3 = _mm256_add_pd(s3, _mm256_loadu_pd(a_values + i + 12));
+  }
+  auto sum = od_hsum(_mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3)));
+  for (; i < a_count; i++) sum += a_values[i];
+  return sum;
+}
+#endif
+
+/**
+   Sums a row of cells in double precision, with AVX2 for float and double cells if the CPU
+   supports it, see simd_level().
+ */
+template<typename T>
+double od_row_sum(const T *a_values, const size_t a_count) noexcept
+{
+#ifdef WXLIB_MIO_X86
+  if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+    const auto level = simd_level();
+    if (level == SimdLevel::Avx2 || level == SimdLevel::Avx512) return avx2_od_sum(a_values, a_count);
+  }
+#endif
+  return od_sum(a_values, a_count);
+}
+
+}
+
+/**
+   A square origin-destination matrix of `T` cells, e.g. the trips of one class in one period
+   between 5,000 to 20,000 zones, stored in a file as square tiles of tile_size() x tile_size()
+   cells, and mapped and used in place.
+
+   The tiles are laid out tile row by tile row, each tile row major, after a header of one page,
+   so that a tile of 64 x 64 floats is 16 KiB of contiguous, page aligned cells: a whole matrix
+   operation streams the tiles at memory bandwidth, and a block of origins and a block of
+   destinations is one tile, whichever way it is walked. The tiles of the last tile row and
+   column are padded to full tiles, with cells that stay zero.
+
+   Dense rows, columns and whole matrices are copied in and out of the tiles, and whole matrix
+   operations done tile by tile, in parallel on the shared executor. The row and column sums,
+   i.e. the productions and attractions of the zones, are accumulated in double precision, with
+   AVX2 if the CPU supports it, and do not depend on the number of threads.
+
+   An OdMatrix is exchanged as a packed file of tiles compressed one by one, see pack and
+   unpack, all zero tiles taking no space. The mapped file uses the native byte order, and is
+   not meant to be shared across platforms.
+
+   @code
+     std::error_code error;
+     mio::OdMatrix<float, mio::access_mode::write> od;
+     od.create("od.wxod", zone_count, error);
+     od(origin, destination) = trips;
+     od.write_row(origin, row);
+
+     const auto productions = od.row_sums();
+     const auto attractions = od.column_sums();
+     od.pack("od.wxodz", mio::TileCompression::Zstd, error);
+   @endcode
+ */
+template<typename T = float, access_mode AccessMode = access_mode::read>
+requires std::is_arithmetic_v<T>
+class OdMatrix
+{
+public:
+  using value_type = T;
+  using element_type = std::conditional_t<AccessMode == access_mode::write, T, const T>;
+
+  static constexpr size_t default_tile_size = 64;
+
+  /**
+     Bytes before the first tile, so that the tiles are page aligned.
+   */
+  static constexpr size_t header_size = 4096;
+
+  OdMatrix() = default;
+  OdMatrix(const OdMatrix &) = delete;
+  OdMatrix &operator=(const OdMatrix &) = delete;
+
+  /**
+     Creates a matrix of zero cells, or truncates the file if it exists, and maps it.
+
+     \param a_path The matrix file.
+     \param a_zone_count Number of zones, i.e. of rows and of columns, at least 1.
+     \param error Set to std::errc::invalid_argument if there is no zone or a_tile_size is not a
+     power of two in [8, 1024], or to describe the error if the file cannot be written or mapped.
+     \param a_tile_size Number of rows and of columns of a tile.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  bool create(const std::string &a_path, const size_t a_zone_count, std::error_code &error, const size_t a_tile_size = default_tile_size)
+  {
+    error.clear();
+    close();
+    if (a_zone_count == 0 || a_zone_count > UINT32_MAX || !valid_tile_size(a_tile_size)) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    auto header = make_header(matrix_magic, a_zone_count, a_tile_size, TileCompression::None);
+    {
+      std::ofstream out(a_path, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      if (!out) {
+        error = std::make_error_code(std::errc::io_error);
+        return false;
+      }
+    }
+
+    const auto tiles = tiles_of(a_zone_count, a_tile_size);
+    std::filesystem::resize_file(a_path, header_size + tiles * tiles * a_tile_size * a_tile_size * sizeof(T), error);
+    return !error && map(a_path, header, error);
+  }
+
+  /**
+     Maps a matrix file made by create().
+
+     \param error Set to std::errc::invalid_argument if the file is not a matrix of `T` cells,
+     or to describe the error if it cannot be read or mapped.
+   */
+  bool open(const std::string &a_path, std::error_code &error)
+  {
+    error.clear();
+    close();
+    auto header = Header{};
+    if (!read_header(a_path, matrix_magic, header, error)) return false;
+    return map(a_path, header, error);
+  }
+
+  void close() noexcept
+  {
+    cells_.unmap();
+    zone_count_ = tile_size_ = tiles_ = shift_ = 0;
+  }
+
+  [[nodiscard]] bool is_open() const noexcept
+  {
+    return cells_.is_mapped();
+  }
+
+  /**
+     Writes the cells back to the file, see `basic_mmap::sync`.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void sync(std::error_code &error)
+  {
+    cells_.sync(error);
+  }
+
+  [[nodiscard]] size_t zone_count() const noexcept
+  {
+    return zone_count_;
+  }
+
+  [[nodiscard]] size_t tile_size() const noexcept
+  {
+    return tile_size_;
+  }
+
+  /**
+     Number of tile rows, and of tile columns.
+   */
+  [[nodiscard]] size_t tile_count() const noexcept
+  {
+    return tiles_;
+  }
+
+  [[nodiscard]] element_type &operator()(const size_t a_origin, const size_t a_destination) noexcept
+  {
+    return cells_[index(a_origin, a_destination)];
+  }
+
+  [[nodiscard]] const T &operator()(const size_t a_origin, const size_t a_destination) const noexcept
+  {
+    return cells_[index(a_origin, a_destination)];
+  }
+
+  /**
+     The cells of a tile, row major, of the origins from a_tile_row * tile_size() and the
+     destinations from a_tile_column * tile_size() on, in place.
+   */
+  [[nodiscard]] std::span<element_type> tile(const size_t a_tile_row, const size_t a_tile_column) noexcept
+  {
+    return cells_.span().subspan((a_tile_row * tiles_ + a_tile_column) << (2 * shift_), tile_size_ * tile_size_);
+  }
+
+  [[nodiscard]] std::span<const T> tile(const size_t a_tile_row, const size_t a_tile_column) const noexcept
+  {
+    return cells_.span().subspan((a_tile_row * tiles_ + a_tile_column) << (2 * shift_), tile_size_ * tile_size_);
+  }
+
+  /**
+     All the tiles, in their order in the file.
+   */
+  [[nodiscard]] std::span<element_type> tiles() noexcept
+  {
+    return cells_.span();
+  }
+
+  [[nodiscard]] std::span<const T> tiles() const noexcept
+  {
+    return cells_.span();
+  }
+
+  /**
+     Copies the row of an origin into a_row, of zone_count() cells at least.
+   */
+  void read_row(const size_t a_origin, const std::span<T> a_row) const noexcept
+  {
+    for (size_t tj = 0; tj < tiles_; tj++) {
+      const auto *cells = tile(a_origin >> shift_, tj).data() + ((a_origin & mask()) << shift_);
+      std::copy_n(cells, width(tj), a_row.data() + (tj << shift_));
+    }
+  }
+
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void write_row(const size_t a_origin, const std::span<const T> a_row) noexcept
+  {
+    for (size_t tj = 0; tj < tiles_; tj++) {
+      auto *cells = tile(a_origin >> shift_, tj).data() + ((a_origin & mask()) << shift_);
+      std::copy_n(a_row.data() + (tj << shift_), width(tj), cells);
+    }
+  }
+
+  /**
+     Copies the column of a destination into a_column, of zone_count() cells at least.
+   */
+  void read_column(const size_t a_destination, const std::span<T> a_column) const noexcept
+  {
+    for (size_t ti = 0; ti < tiles_; ti++) {
+      const auto *cells = tile(ti, a_destination >> shift_).data() + (a_destination & mask());
+      for (size_t r = 0, n = width(ti); r < n; r++) a_column[(ti << shift_) + r] = cells[r << shift_];
+    }
+  }
+
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void write_column(const size_t a_destination, const std::span<const T> a_column) noexcept
+  {
+    for (size_t ti = 0; ti < tiles_; ti++) {
+      auto *cells = tile(ti, a_destination >> shift_).data() + (a_destination & mask());
+      for (size_t r = 0, n = width(ti); r < n; r++) cells[r << shift_] = a_column[(ti << shift_) + r];
+    }
+  }
+
+  /**
+     Copies the whole matrix into a_dense, row major, of zone_count() x zone_count() cells, on
+     a_num_threads threads, a tile row each at a time.
+   */
+  void read(const std::span<T> a_dense, const size_t a_num_threads = available_concurrency()) const
+  {
+    for_each_index(tiles_, a_num_threads, [&](const size_t ti) {
+      for (size_t tj = 0; tj < tiles_; tj++) {
+        const auto *cells = tile(ti, tj).data();
+        for (size_t r = 0, n = width(ti); r < n; r++)
+          std::copy_n(cells + (r << shift_), width(tj), a_dense.data() + ((ti << shift_) + r) * zone_count_ + (tj << shift_));
+      }
+    });
+  }
+
+  /**
+     Copies a_dense, row major, of zone_count() x zone_count() cells, into the whole matrix, on
+     a_num_threads threads.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  void write(const std::span<const T> a_dense, const size_t a_num_threads = available_concurrency())
+  {
+    for_each_index(tiles_, a_num_threads, [&](const size_t ti) {
+      for (size_t tj = 0; tj < tiles_; tj++) {
+        auto *cells = tile(ti, tj).data();
+        for (size_t r = 0, n = width(ti); r < n; r++)
+          std::copy_n(a_dense.data() + ((ti << shift_) + r) * zone_count_ + (tj << shift_), width(tj), cells + (r << shift_));
+      }
+    });
+  }
+
+  /**
+     Fires `f(size_t tile_row, size_t tile_column, std::span<element_type> tile)` for every tile,
+     concurrently on a_num_threads threads, the tiles of a tile row on the same thread, in order.
+   */
+  template<typename F>
+  void for_each_tile(const F &f, const size_t a_num_threads = available_concurrency())
+  {
+    for_each_index(tiles_, a_num_threads, [&](const size_t ti) {
+      for (size_t tj = 0; tj < tiles_; tj++) f(ti, tj, tile(ti, tj));
+    });
+  }
+
+  template<typename F>
+  void for_each_tile(const F &f, const size_t a_num_threads = available_concurrency()) const
+  {
+    for_each_index(tiles_, a_num_threads, [&](const size_t ti) {
+      for (size_t tj = 0; tj < tiles_; tj++) f(ti, tj, tile(ti, tj));
+    });
+  }
+
+  /**
+     The sum of each row, i.e. the productions of the origins, on a_num_threads threads.
+   */
+  [[nodiscard]] std::vector<double> row_sums(const size_t a_num_threads = available_concurrency()) const
+  {
+    auto result = std::vector<double>(zone_count_);
+    for_each_index(tiles_, a_num_threads, [&](const size_t ti) {
+      for (size_t tj = 0; tj < tiles_; tj++) {
+        const auto *cells = tile(ti, tj).data();
+        for (size_t r = 0, n = width(ti); r < n; r++) result[(ti << shift_) + r] += detail::od_row_sum(cells + (r << shift_), width(tj));
+      }
+    });
+    return result;
+  }
+
+  /**
+     The sum of each column, i.e. the attractions of the destinations, on a_num_threads
+     threads, a tile column each at a time.
+   */
+  [[nodiscard]] std::vector<double> column_sums(const size_t a_num_threads = available_concurrency()) const
+  {
+    auto result = std::vector<double>(zone_count_);
+    for_each_index(tiles_, a_num_threads, [&](const size_t tj) {
+      auto *sums = result.data() + (tj << shift_);
+      const auto n = width(tj);
+      for (size_t ti = 0; ti < tiles_; ti++) {
+        const auto *cells = tile(ti, tj).data();
+        for (size_t r = 0, m = width(ti); r < m; r++) {
+          const auto *row = cells + (r << shift_);
+          for (size_t c = 0; c < n; c++) sums[c] += static_cast<double>(row[c]);
+        }
+      }
+    });
+    return result;
+  }
+
+  /**
+     The sum of all the cells.
+   */
+  [[nodiscard]] double total(const size_t a_num_threads = available_concurrency()) const
+  {
+    const auto sums = row_sums(a_num_threads);
+    return detail::od_sum(sums.data(), sums.size());
+  }
+
+  /**
+     Checks whether a codec is built in.
+   */
+  [[nodiscard]] static constexpr bool supports(const TileCompression a_compression) noexcept
+  {
+    switch (a_compression) {
+      case TileCompression::None: return true;
+#ifdef WXLIB_MIO_WITH_ZLIB
+      case TileCompression::Zlib: return true;
+#endif
+#ifdef WXLIB_MIO_WITH_ZSTD
+      case TileCompression::Zstd: return true;
+#endif
+      default: return false;
+    }
+  }
+
+  /**
+     Writes the matrix to a packed file: the header, then the offsets of the tiles, then each
+     tile compressed on its own, on a_num_threads threads. An all zero tile is not stored, and a
+     tile stored as is if it does not compress. The packed file is written to a temporary file
+     renamed once written, a batch of tile rows at a time.
+
+     \param a_level The compression level of the codec, 0 for its default.
+     \param error Set to std::errc::not_supported if the codec is not built in, or to describe
+     the error if the file cannot be written.
+   */
+  bool pack(const std::string &a_packed, const TileCompression a_compression, std::error_code &error, const int a_level = 0,
+            const size_t a_num_threads = available_concurrency()) const
+  {
+    error.clear();
+    if (!supports(a_compression)) {
+      error = std::make_error_code(std::errc::not_supported);
+      return false;
+    }
+
+    const auto header = make_header(packed_magic, zone_count_, tile_size_, a_compression);
+    auto offsets = std::vector<uint64_t>(tiles_ * tiles_ + 1);
+    const auto directory = static_cast<std::streamoff>(sizeof(Header));
+    const auto payload = directory + static_cast<std::streamoff>(offsets.size() * sizeof(uint64_t));
+
+    return replace_file(a_packed, [&](std::ofstream &out) {
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.seekp(payload);
+
+      // A batch of tile rows is packed in parallel, a tile row to a buffer, then appended in
+      // order, so that at most a batch is held in memory.
+      const auto batch = std::clamp(a_num_threads, size_t{1}, std::max(tiles_, size_t{1}));
+      auto buffers = std::vector<std::vector<char>>(batch);
+      auto sizes = std::vector<std::vector<uint64_t>>(batch, std::vector<uint64_t>(tiles_));
+      for (size_t first = 0; first < tiles_ && out; first += batch) {
+        const auto count = std::min(batch, tiles_ - first);
+        for_each_index(count, batch, [&](const size_t i) {
+          buffers[i].clear();
+          for (size_t tj = 0; tj < tiles_; tj++) {
+            const auto before = buffers[i].size();
+            pack_tile(tile(first + i, tj), a_compression, a_level, buffers[i]);
+            sizes[i][tj] = buffers[i].size() - before;
+          }
+        });
+
+        for (size_t i = 0; i < count; i++) {
+          out.write(buffers[i].data(), static_cast<std::streamsize>(buffers[i].size()));
+          for (size_t tj = 0; tj < tiles_; tj++) {
+            const auto t = (first + i) * tiles_ + tj;
+            offsets[t + 1] = offsets[t] + sizes[i][tj];
+          }
+        }
+      }
+
+      out.seekp(directory);
+      out.write(reinterpret_cast<const char *>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    }, error);
+  }
+
+  /**
+     Creates the matrix file a_path from a packed file, see pack, decompressing its tiles in
+     place on a_num_threads threads, and maps it.
+
+     \param error Set to std::errc::invalid_argument if a_packed is not a packed matrix of `T`
+     cells, to std::errc::not_supported if its codec is not built in, to
+     std::errc::illegal_byte_sequence if a tile is corrupt, or to describe the error if a file
+     cannot be read or written.
+   */
+  template<access_mode A = AccessMode>
+  requires (A == access_mode::write)
+  bool unpack(const std::string &a_packed, const std::string &a_path, std::error_code &error, const size_t a_num_threads = available_concurrency())
+  {
+    error.clear();
+    close();
+    auto header = Header{};
+    if (!read_header(a_packed, packed_magic, header, error)) return false;
+
+    const auto compression = static_cast<TileCompression>(header.compression);
+    if (!supports(compression)) {
+      error = std::make_error_code(std::errc::not_supported);
+      return false;
+    }
+
+    auto packed = mmap_source{};
+    packed.map(a_packed, error);
+    if (error) return false;
+
+    const auto tiles = tiles_of(header.zone_count, header.tile_size);
+    const auto payload = sizeof(Header) + (tiles * tiles + 1) * sizeof(uint64_t);
+    if (packed.size() < payload) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    auto offsets = std::vector<uint64_t>(tiles * tiles + 1);
+    std::memcpy(offsets.data(), packed.data() + sizeof(Header), offsets.size() * sizeof(uint64_t));
+    if (offsets.front() != 0 || offsets.back() > packed.size() - payload || !std::ranges::is_sorted(offsets)) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    if (!create(a_path, header.zone_count, error, header.tile_size)) return false;
+
+    auto corrupt = std::atomic<bool>{false};
+    for_each_index(tiles_ * tiles_, a_num_threads, [&](const size_t t) {
+      const auto stored = std::span{packed.data() + payload + offsets[t], offsets[t + 1] - offsets[t]};
+      if (!unpack_tile(stored, compression, cells_.span().subspan(t << (2 * shift_), tile_size_ * tile_size_)))
+        corrupt.store(true, std::memory_order_relaxed);
+    });
+
+    if (corrupt.load()) {
+      close();
+      error = std::make_error_code(std::errc::illegal_byte_sequence);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  struct Header
+  {
+    char magic[8];
+    uint32_t zone_count;
+    uint32_t tile_size;
+    uint32_t value_size;
+    uint32_t value_kind;
+    uint32_t compression;
+    uint32_t reserved0;
+    uint64_t reserved[4];
+  };
+
+  static_assert(sizeof(Header) == 64);
+
+  static constexpr char matrix_magic[8] = {'W', 'X', 'O', 'D', 'M', 'X', '0', '1'};
+  static constexpr char packed_magic[8] = {'W', 'X', 'O', 'D', 'P', 'K', '0', '1'};
+
+  // 0 for floating point cells, 1 for signed integers, 2 for unsigned integers.
+  static constexpr uint32_t value_kind = std::is_floating_point_v<T> ? 0 : std::is_signed_v<T> ? 1 : 2;
+
+  static bool valid_tile_size(const size_t a_tile_size) noexcept
+  {
+    return a_tile_size >= 8 && a_tile_size <= 1024 && std::has_single_bit(a_tile_size);
+  }
+
+  static size_t tiles_of(const size_t a_zone_count, const size_t a_tile_size) noexcept
+  {
+    return (a_zone_count + a_tile_size - 1) / a_tile_size;
+  }
+
+  static Header make_header(const char (&a_magic)[8], const size_t a_zone_count, const size_t a_tile_size, const TileCompression a_compression) noexcept
+  {
+    auto header = Header{};
+    std::copy_n(a_magic, sizeof(header.magic), header.magic);
+    header.zone_count = static_cast<uint32_t>(a_zone_count);
+    header.tile_size = static_cast<uint32_t>(a_tile_size);
+    header.value_size = sizeof(T);
+    header.value_kind = value_kind;
+    header.compression = static_cast<uint32_t>(a_compression);
+    return header;
+  }
+
+  static bool read_header(const std::string &a_path, const char (&a_magic)[8], Header &a_header, std::error_code &error)
+  {
+    std::ifstream in(a_path, std::ios::binary);
+    if (!in) {
+      error = std::make_error_code(std::errc::no_such_file_or_directory);
+      return false;
+    }
+
+    in.read(reinterpret_cast<char *>(&a_header), sizeof(a_header));
+    if (!in || !std::equal(a_magic, a_magic + sizeof(a_header.magic), a_header.magic) || a_header.value_size != sizeof(T)
+        || a_header.value_kind != value_kind || a_header.zone_count == 0 || !valid_tile_size(a_header.tile_size)) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+    return true;
+  }
+
+  bool map(const std::string &a_path, const Header &a_header, std::error_code &error)
+  {
+    const auto tiles = tiles_of(a_header.zone_count, a_header.tile_size);
+    const auto count = tiles * tiles * a_header.tile_size * a_header.tile_size;
+    cells_.map(a_path, header_size / sizeof(T), map_entire_file, error);
+    if (!error && cells_.size() != count) {
+      cells_.unmap();
+      error = std::make_error_code(std::errc::invalid_argument);
+    }
+    if (error) return false;
+
+    zone_count_ = a_header.zone_count;
+    tile_size_ = a_header.tile_size;
+    tiles_ = tiles;
+    shift_ = static_cast<size_t>(std::countr_zero(tile_size_));
+    return true;
+  }
+
+  [[nodiscard]] size_t mask() const noexcept
+  {
+    return tile_size_ - 1;
+  }
+
+  [[nodiscard]] size_t index(const size_t a_origin, const size_t a_destination) const noexcept
+  {
+    const auto t = (a_origin >> shift_) * tiles_ + (a_destination >> shift_);
+    return (t << (2 * shift_)) + ((a_origin & mask()) << shift_) + (a_destination & mask());
+  }
+
+  /**
+     Number of rows, or columns, of zones in a tile row, or column, the last one being short.
+   */
+  [[nodiscard]] size_t width(const size_t a_tile) const noexcept
+  {
+    return std::min(tile_size_, zone_count_ - (a_tile << shift_));
+  }
+
+  /**
+     Fires f(i) for i in [0, a_count), concurrently on a_num_threads threads, on the shared
+     executor, each thread taking the next index.
+   */
+  template<typename F>
+  static void for_each_index(const size_t a_count, const size_t a_num_threads, const F &f)
+  {
+    if (a_count == 0) return;
+
+    const auto threads = std::clamp(a_count, size_t{1}, std::max(a_num_threads, size_t{1}));
+    auto next = std::atomic<size_t>{0};
+    Executor::shared().run_workers(threads, [&](size_t) {
+      for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < a_count; i = next.fetch_add(1, std::memory_order_relaxed)) f(i);
+    });
+  }
+
+  static void pack_tile(const std::span<const T> a_tile, [[maybe_unused]] const TileCompression a_compression, [[maybe_unused]] const int a_level,
+                        std::vector<char> &a_out)
+  {
+    const auto raw = std::span{reinterpret_cast<const char *>(a_tile.data()), a_tile.size_bytes()};
+    if (std::ranges::all_of(raw, [](const char c) { return c == 0; })) return;
+
+    const auto start = a_out.size();
+    switch (a_compression) {
+#ifdef WXLIB_MIO_WITH_ZLIB
+      case TileCompression::Zlib: {
+        auto length = ::compressBound(static_cast<uLong>(raw.size()));
+        a_out.resize(start + length);
+        const auto status = ::compress2(reinterpret_cast<Bytef *>(a_out.data() + start), &length, reinterpret_cast<const Bytef *>(raw.data()),
+                                        static_cast<uLong>(raw.size()), a_level == 0 ? Z_DEFAULT_COMPRESSION : a_level);
+        if (status == Z_OK && length < raw.size()) {
+          a_out.resize(start + length);
+          return;
+        }
+        break;
+      }
+#endif
+#ifdef WXLIB_MIO_WITH_ZSTD
+      case TileCompression::Zstd: {
+        const auto bound = ::ZSTD_compressBound(raw.size());
+        a_out.resize(start + bound);
+        const auto length = ::ZSTD_compress(a_out.data() + start, bound, raw.data(), raw.size(), a_level);
+        if (!::ZSTD_isError(length) && length < raw.size()) {
+          a_out.resize(start + length);
+          return;
+        }
+        break;
+      }
+#endif
+      default: break;
+    }
+
+    // Stored as is, which its size tells apart from a compressed tile, always shorter.
+    a_out.resize(start);
+    a_out.insert(a_out.end(), raw.begin(), raw.end());
+  }
+
+  static bool unpack_tile(const std::span<const char> a_stored, [[maybe_unused]] const TileCompression a_compression, const std::span<T> a_tile) noexcept
+  {
+    auto *out = reinterpret_cast<char *>(a_tile.data());
+    const auto size = a_tile.size_bytes();
+
+    // A new matrix is all zeros already.
+    if (a_stored.empty()) return true;
+    if (a_stored.size() == size) {
+      std::memcpy(out, a_stored.data(), size);
+      return true;
+    }
+    if (a_stored.size() > size) return false;
+
+    switch (a_compression) {
+#ifdef WXLIB_MIO_WITH_ZLIB
+      case TileCompression::Zlib: {
+        auto length = static_cast<uLongf>(size);
+        return ::uncompress(reinterpret_cast<Bytef *>(out), &length, reinterpret_cast<const Bytef *>(a_stored.data()), static_cast<uLong>(a_stored.size())) == Z_OK
+            && length == size;
+      }
+#endif
+#ifdef WXLIB_MIO_WITH_ZSTD
+      case TileCompression::Zstd:
+        return ::ZSTD_decompress(out, size, a_stored.data(), a_stored.size()) == size;
+#endif
+      default: return false;
+    }
+  }
+
+  mmap_array<T, AccessMode> cells_;
+  size_t zone_count_{0};
+  size_t tile_size_{0};
+  size_t tiles_{0};
+  size_t shift_{0};
+};
+
+}
+#endif
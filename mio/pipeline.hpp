@@ -0,0 +1,236 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_PIPELINE_HPP
+#define WXLIB_MIO_PIPELINE_HPP
+
+#include <mio/queue.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   A multi-stage ingestion pipeline, e.g. read -> parse -> transform -> sink, whose stages
+   run on threads of their own and hand batches to one another through BoundedQueue. Each
+   stage is sized to saturate its own resource, and a slow stage only stalls the stages
+   upstream once the queue between them is full.
+
+   A stage callback returns 0 for success, and non-zero for error, which cancels the whole
+   pipeline; wait() then returns the first such code. Callbacks must not throw. A stage closes
+   its output queue once all its workers are done, so that the stage downstream drains it and
+   finishes in turn. Every queue must have a consumer, or its producers wait forever.
+
+   @code
+     mio::StringReaderAsync reader("probes.csv");
+     mio::Pipeline pipeline;
+     auto &blocks = pipeline.read_blocks(reader, 2);
+     auto &records = pipeline.stage<std::vector<Record>>(blocks, 4, [&](int a_id, std::string_view &a_block, auto &a_emit) {
+       auto batch = std::vector<Record>{};
+       docs[a_id].make_records(a_block, [&](const Record &a_rec) { batch.push_back(a_rec); return 0; });
+       a_emit(std::move(batch));
+       return 0;
+     });
+     pipeline.sink(records, 1, [&](int, std::vector<Record> &a_batch) { return insert(a_batch); });
+     if (const auto status = pipeline.wait()) report(status);
+   @endcode
+ */
+class Pipeline
+{
+public:
+  /**
+     Default capacity of the queues between stages, in batches.
+   */
+  static constexpr size_t default_queue_capacity = 16;
+
+  /**
+     Pushes the items a stage produces into its output queue, waiting while it is full.
+     Returns false once the pipeline is cancelled, in which case the stage should stop.
+   */
+  template<typename Out>
+  class Emit
+  {
+  public:
+    explicit Emit(BoundedQueue<Out> &a_queue) noexcept : queue_{a_queue}
+    {
+    }
+
+    bool operator()(Out a_item)
+    {
+      return queue_.push(std::move(a_item));
+    }
+
+  private:
+    BoundedQueue<Out> &queue_;
+  };
+
+  /**
+     \param a_queue_capacity Capacity of the queues between stages, in batches.
+   */
+  explicit Pipeline(const size_t a_queue_capacity = default_queue_capacity) : queue_capacity_{a_queue_capacity}
+  {
+  }
+
+  Pipeline(const Pipeline &) = delete;
+  Pipeline &operator=(const Pipeline &) = delete;
+
+  /**
+     Cancels the stages still running, and waits for them.
+   */
+  ~Pipeline()
+  {
+    cancel();
+    wait();
+  }
+
+  /**
+     Adds the first stage, invoked once per worker as a_produce(int worker_id, Emit<Out> &emit).
+     \return The output queue, to connect the next stage to.
+   */
+  template<typename Out, typename F>
+  BoundedQueue<Out> &source(const size_t a_num_threads, F a_produce)
+  {
+    auto &out = make_queue<Out>();
+    spawn(a_num_threads, [this, &out, produce = std::move(a_produce)](int a_id) {
+      auto emit = Emit<Out>{out};
+      if (const auto status = produce(a_id, emit); status != 0) fail(status);
+    }, [&out] { out.close(); });
+    return out;
+  }
+
+  /**
+     Adds a source stage of the newline-aligned blocks of lines of a reader, see
+     StringReader::async_getblock, so that scanning overlaps with the stages downstream.
+     \param a_reader The reader, which must outlive the pipeline.
+     \param a_num_threads Number of threads scanning the reader.
+     \param a_chunk_size Approximate size in bytes of the blocks.
+     \param a_quote_aware Whether `\n` enclosed in double quotes does not end a line.
+     \return The queue of blocks.
+   */
+  BoundedQueue<std::string_view> &read_blocks(StringReaderAsync &a_reader,
+                                              const size_t a_num_threads,
+                                              const size_t a_chunk_size = StringReaderAsync::default_chunk_size,
+                                              const bool a_quote_aware = false)
+  {
+    return source<std::string_view>(1, [&a_reader, a_num_threads, a_chunk_size, a_quote_aware](int, Emit<std::string_view> &a_emit) {
+      a_reader.async_getblock([&a_emit](int, std::string_view a_block) { return a_emit(a_block) ? 0 : 1; },
+                              a_num_threads, a_chunk_size, a_quote_aware);
+      return 0;
+    });
+  }
+
+  /**
+     Adds a stage popping the items of a_in, invoked as a_transform(int worker_id, In &item,
+     Emit<Out> &emit) for each, which may emit any number of items.
+     \return The output queue, to connect the next stage to.
+   */
+  template<typename Out, typename In, typename F>
+  BoundedQueue<Out> &stage(BoundedQueue<In> &a_in, const size_t a_num_threads, F a_transform)
+  {
+    auto &out = make_queue<Out>();
+    spawn(a_num_threads, [this, &a_in, &out, transform = std::move(a_transform)](int a_id) {
+      auto emit = Emit<Out>{out};
+      for (auto item = In{}; a_in.pop(item);) {
+        if (const auto status = transform(a_id, item, emit); status != 0) return fail(status);
+      }
+    }, [&out] { out.close(); });
+    return out;
+  }
+
+  /**
+     Adds the last stage, invoked as a_consume(int worker_id, In &item) for each item of a_in.
+   */
+  template<typename In, typename F>
+  void sink(BoundedQueue<In> &a_in, const size_t a_num_threads, F a_consume)
+  {
+    spawn(a_num_threads, [this, &a_in, consume = std::move(a_consume)](int a_id) {
+      for (auto item = In{}; a_in.pop(item);) {
+        if (const auto status = consume(a_id, item); status != 0) return fail(status);
+      }
+    }, [] {});
+  }
+
+  /**
+     Cancels the pipeline: the stages stop as soon as their callbacks return.
+   */
+  void cancel() noexcept
+  {
+    std::scoped_lock lock{mutex_};
+    for (auto &cancel_queue: cancels_) cancel_queue();
+  }
+
+  /**
+     Waits for all the stages to finish.
+     \return The first non-zero status code returned by a stage, 0 if none.
+   */
+  int wait()
+  {
+    auto threads = std::vector<std::thread>{};
+    {
+      std::scoped_lock lock{mutex_};
+      threads.swap(threads_);
+    }
+    for (auto &thread: threads) thread.join();
+    return status_.load(std::memory_order_acquire);
+  }
+
+private:
+  template<typename T>
+  BoundedQueue<T> &make_queue()
+  {
+    auto queue = std::make_shared<BoundedQueue<T>>(queue_capacity_);
+    std::scoped_lock lock{mutex_};
+    cancels_.emplace_back([queue = queue.get()] { queue->cancel(); });
+    queues_.push_back(queue);
+
+    // A stage added after a failure does not start.
+    if (status_.load(std::memory_order_acquire) != 0) queue->cancel();
+    return *queue;
+  }
+
+  /**
+     Starts the workers of a stage, the last of which to finish runs a_done.
+   */
+  template<typename Work, typename Done>
+  void spawn(const size_t a_num_threads, Work a_work, Done a_done)
+  {
+    const auto num_threads = std::max(a_num_threads, size_t{1});
+    auto shared = std::make_shared<std::pair<Work, Done>>(std::move(a_work), std::move(a_done));
+    auto remaining = std::make_shared<std::atomic<size_t>>(num_threads);
+
+    std::scoped_lock lock{mutex_};
+    for (size_t i = 0; i < num_threads; i++)
+      threads_.emplace_back([shared, remaining, i] {
+        shared->first(static_cast<int>(i));
+        if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) shared->second();
+      });
+  }
+
+  void fail(const int a_status) noexcept
+  {
+    auto expected = 0;
+    if (status_.compare_exchange_strong(expected, a_status, std::memory_order_acq_rel)) cancel();
+  }
+
+  size_t queue_capacity_;
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<void>> queues_;
+  std::vector<std::function<void()>> cancels_;
+  std::vector<std::thread> threads_;
+  std::atomic<int> status_{0};
+};
+
+}
+#endif
@@ -0,0 +1,615 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_PROBE_STORE_HPP
+#define WXLIB_MIO_PROBE_STORE_HPP
+
+#include <mio/mio.hpp>
+#include <mio/csvreader.hpp>
+#include <mio/executor.hpp>
+#include <mio/replacefile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   A GPS probe point: a vehicle at a position at a time, in the units of the data, e.g. epoch
+   seconds and projected metres.
+ */
+struct ProbePoint
+{
+  int64_t vehicle_id{};
+  int64_t time{};
+  double x{};
+  double y{};
+  float speed{};
+};
+
+/**
+   An axis aligned box of positions, bounds included.
+ */
+struct ProbeBox
+{
+  double min_x{std::numeric_limits<double>::infinity()};
+  double min_y{std::numeric_limits<double>::infinity()};
+  double max_x{-std::numeric_limits<double>::infinity()};
+  double max_y{-std::numeric_limits<double>::infinity()};
+
+  /**
+     The box of all the positions.
+   */
+  [[nodiscard]] static constexpr ProbeBox everywhere() noexcept
+  {
+    return {-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::infinity()};
+  }
+
+  [[nodiscard]] constexpr bool contains(const double a_x, const double a_y) const noexcept
+  {
+    return a_x >= min_x && a_x <= max_x && a_y >= min_y && a_y <= max_y;
+  }
+
+  [[nodiscard]] constexpr bool intersects(const ProbeBox &a_box) const noexcept
+  {
+    return a_box.min_x <= max_x && a_box.max_x >= min_x && a_box.min_y <= max_y && a_box.max_y >= min_y;
+  }
+
+  constexpr void extend(const double a_x, const double a_y) noexcept
+  {
+    min_x = std::min(min_x, a_x);
+    min_y = std::min(min_y, a_y);
+    max_x = std::max(max_x, a_x);
+    max_y = std::max(max_y, a_y);
+  }
+};
+
+/**
+   An entry of the chunk index of a ProbeStore: where a chunk is, and the range of times and
+   the box of positions of its points.
+ */
+struct ProbeChunkInfo
+{
+  int64_t partition{};
+  uint64_t offset{};
+  uint64_t count{};
+  int64_t min_time{};
+  int64_t max_time{};
+  ProbeBox box{};
+};
+
+/**
+   The columns of a chunk of probe points, in place in the mapped partition file, sorted by
+   time.
+ */
+struct ProbeChunk
+{
+  std::span<const int64_t> times{};
+  std::span<const double> xs{};
+  std::span<const double> ys{};
+  std::span<const int64_t> vehicle_ids{};
+  std::span<const float> speeds{};
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return times.size();
+  }
+
+  [[nodiscard]] ProbePoint operator[](const size_t i) const noexcept
+  {
+    return {vehicle_ids[i], times[i], xs[i], ys[i], speeds[i]};
+  }
+};
+
+namespace detail {
+
+inline constexpr char probe_magic[8] = {'W', 'X', 'P', 'R', 'O', 'B', '0', '1'};
+
+struct ProbeIndexHeader
+{
+  char magic[8];
+  int64_t bucket;
+  uint64_t chunk_count;
+  uint64_t reserved[5];
+};
+
+static_assert(sizeof(ProbeIndexHeader) == 64);
+
+/**
+   Offsets of the columns of a chunk of a_count points from the chunk, each 64 bytes aligned,
+   and the size of the chunk, last.
+ */
+inline std::array<uint64_t, 6> probe_columns(const uint64_t a_count) noexcept
+{
+  constexpr auto align = [](const uint64_t a_size) { return (a_size + 63) / 64 * 64; };
+  auto result = std::array<uint64_t, 6>{};
+  const uint64_t sizes[] = {sizeof(int64_t), sizeof(double), sizeof(double), sizeof(int64_t), sizeof(float)};
+  for (size_t i = 0; i < 5; i++) result[i + 1] = result[i] + align(a_count * sizes[i]);
+  return result;
+}
+
+inline std::string probe_index_file(const std::string &a_dir)
+{
+  return (std::filesystem::path{a_dir} / "index.wxpi").string();
+}
+
+inline std::string probe_partition_file(const std::string &a_dir, const int64_t a_partition)
+{
+  return (std::filesystem::path{a_dir} / ("p" + std::to_string(a_partition) + ".wxpc")).string();
+}
+
+inline bool read_probe_index(const std::string &a_dir, ProbeIndexHeader &a_header, std::vector<ProbeChunkInfo> &a_chunks, std::error_code &error)
+{
+  std::ifstream in(probe_index_file(a_dir), std::ios::binary);
+  if (!in) {
+    error = std::make_error_code(std::errc::no_such_file_or_directory);
+    return false;
+  }
+
+  in.read(reinterpret_cast<char *>(&a_header), sizeof(a_header));
+  if (!in || std::memcmp(a_header.magic, probe_magic, sizeof(probe_magic)) != 0 || a_header.bucket <= 0) {
+    error = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+
+  a_chunks.resize(a_header.chunk_count);
+  in.read(reinterpret_cast<char *>(a_chunks.data()), static_cast<std::streamsize>(a_chunks.size() * sizeof(ProbeChunkInfo)));
+  if (!in) {
+    error = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+  return true;
+}
+
+}
+
+/**
+   Writes GPS probe points into a ProbeStore: a directory of time partitions, a file each, of
+   columnar chunks, with an index of the range of times and the box of positions of every chunk.
+
+   Points are partitioned by time into buckets of `bucket` time units, e.g. 3600 seconds, and
+   buffered by partition. Once a partition holds chunk_points x 16 points, or on close(), they
+   are sorted into Z-order over their box, so that the points of a chunk are close together and
+   its box small, split into chunks of chunk_points, each sorted by time, and appended to the
+   partition file. The index is rewritten, to a temporary file renamed once written, on close()
+   only, so that a store being written is read as it was when last closed.
+
+   Points may be appended from several threads. Opening the writer on an existing store
+   appends to it.
+
+   @code
+     mio::ProbeStoreWriter writer;
+     std::error_code error;
+     writer.open("probes", error, 3600);
+     writer.ingest_csv("probes-2024-05.csv", error);
+     writer.close(error);
+   @endcode
+ */
+class ProbeStoreWriter
+{
+public:
+  static constexpr size_t default_chunk_points = 65536;
+
+  ProbeStoreWriter() = default;
+  ProbeStoreWriter(const ProbeStoreWriter &) = delete;
+  ProbeStoreWriter &operator=(const ProbeStoreWriter &) = delete;
+
+  ~ProbeStoreWriter()
+  {
+    std::error_code ignored;
+    close(ignored);
+  }
+
+  /**
+     Opens a store to append to, creating its directory if need be.
+
+     \param a_dir The directory of the store.
+     \param error Set to std::errc::invalid_argument if a_bucket or a_chunk_points is 0, or the
+     store exists with another bucket, or to describe the error if the directory cannot be made.
+     \param a_bucket Time units per partition, for a new store.
+     \param a_chunk_points Maximum number of points per chunk.
+   */
+  bool open(const std::string &a_dir, std::error_code &error, const int64_t a_bucket = 3600, const size_t a_chunk_points = default_chunk_points)
+  {
+    error.clear();
+    close(error);
+    error.clear();
+    if (a_bucket <= 0 || a_chunk_points == 0) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    std::filesystem::create_directories(a_dir, error);
+    if (error) return false;
+
+    chunks_.clear();
+    if (std::filesystem::exists(detail::probe_index_file(a_dir))) {
+      auto header = detail::ProbeIndexHeader{};
+      if (!detail::read_probe_index(a_dir, header, chunks_, error)) return false;
+      if (header.bucket != a_bucket) {
+        error = std::make_error_code(std::errc::invalid_argument);
+        return false;
+      }
+    }
+
+    dir_ = a_dir;
+    bucket_ = a_bucket;
+    chunk_points_ = a_chunk_points;
+    error_.clear();
+    return true;
+  }
+
+  [[nodiscard]] bool is_open() const noexcept
+  {
+    return !dir_.empty();
+  }
+
+  void append(const ProbePoint &a_point)
+  {
+    append(std::span{&a_point, 1});
+  }
+
+  /**
+     Buffers points, writing the chunks of the partitions which are full. An error writing
+     them is reported by close().
+   */
+  void append(const std::span<const ProbePoint> a_points)
+  {
+    std::scoped_lock lock(mutex_);
+    for (const auto &point: a_points) {
+      auto &pending = pending_[partition_of(point.time)];
+      pending.push_back(point);
+      if (pending.size() >= chunk_points_ * 16) flush(partition_of(point.time), pending);
+    }
+  }
+
+  /**
+     Appends the points of a csv file with the columns vehicle_id, time, x, y and speed, in any
+     order and with any other columns, read on a_num_threads threads, see CsvReader.
+
+     \param error Set to std::errc::invalid_argument if the header line lacks a column, or to
+     std::errc::no_such_file_or_directory if the file does not exist.
+     \returns The number of points appended.
+   */
+  size_t ingest_csv(const std::string &a_csv, std::error_code &error, const size_t a_num_threads = available_concurrency())
+  {
+    using namespace mio::csv;
+
+    error.clear();
+    if (!std::filesystem::exists(a_csv, error)) {
+      if (!error) error = std::make_error_code(std::errc::no_such_file_or_directory);
+      return 0;
+    }
+
+    auto reader = CsvReader<Field<NAME("vehicle_id"), int64_t>, Field<NAME("time"), int64_t>, Field<NAME("x"), double>, Field<NAME("y"), double>,
+                            Field<NAME("speed"), double>>{a_csv};
+    reader.map_columns_by_name = true;
+    if (!std::get<0>(reader.verify_header())) {
+      error = std::make_error_code(std::errc::invalid_argument);
+      return 0;
+    }
+
+    auto points = std::vector<std::vector<ProbePoint>>(std::max(a_num_threads, size_t{1}));
+    const auto count = reader.read_columns([&](const int a_id, auto &a_columns) {
+      auto &buffer = points[a_id];
+      const auto &[vehicles, times, xs, ys, speeds] = a_columns;
+      for (size_t i = 0; i < vehicles.size(); i++) buffer.push_back({vehicles[i], times[i], xs[i], ys[i], static_cast<float>(speeds[i])});
+      if (buffer.size() >= chunk_points_) {
+        append(buffer);
+        buffer.clear();
+      }
+      return 0;
+    }, a_num_threads);
+
+    for (const auto &buffer: points) append(buffer);
+    return count;
+  }
+
+  /**
+     Writes the points buffered, then the index, and closes the store.
+
+     \param error Set to describe the first error writing a chunk or the index.
+   */
+  bool close(std::error_code &error)
+  {
+    if (!is_open()) return true;
+
+    {
+      std::scoped_lock lock(mutex_);
+      for (auto &[partition, pending]: pending_) flush(partition, pending);
+      pending_.clear();
+    }
+
+    error = error_;
+    if (!error) write_index(error);
+    dir_.clear();
+    return !error;
+  }
+
+private:
+  [[nodiscard]] int64_t partition_of(const int64_t a_time) const noexcept
+  {
+    // Rounded down, for the times before the epoch.
+    return a_time / bucket_ - (a_time % bucket_ < 0 ? 1 : 0);
+  }
+
+  static uint64_t spread(uint64_t a_bits) noexcept
+  {
+    a_bits &= 0xFFFF;
+    a_bits = (a_bits | (a_bits << 8)) & 0x00FF00FF;
+    a_bits = (a_bits | (a_bits << 4)) & 0x0F0F0F0F;
+    a_bits = (a_bits | (a_bits << 2)) & 0x33333333;
+    a_bits = (a_bits | (a_bits << 1)) & 0x55555555;
+    return a_bits;
+  }
+
+  void flush(const int64_t a_partition, std::vector<ProbePoint> &a_points)
+  {
+    if (a_points.empty()) return;
+    if (error_) {
+      a_points.clear();
+      return;
+    }
+
+    // Z-order over the box of the points, on a grid of 65536 x 65536 cells.
+    auto box = ProbeBox{};
+    for (const auto &point: a_points) box.extend(point.x, point.y);
+    const auto cell = [](const double a_value, const double a_min, const double a_max) {
+      return a_max > a_min ? static_cast<uint64_t>((a_value - a_min) / (a_max - a_min) * 65535.0) : uint64_t{0};
+    };
+    auto keys = std::vector<std::pair<uint64_t, uint32_t>>(a_points.size());
+    for (size_t i = 0; i < a_points.size(); i++)
+      keys[i] = {spread(cell(a_points[i].x, box.min_x, box.max_x)) | spread(cell(a_points[i].y, box.min_y, box.max_y)) << 1, static_cast<uint32_t>(i)};
+    std::ranges::sort(keys);
+
+    const auto path = detail::probe_partition_file(dir_, a_partition);
+    auto offset = std::filesystem::exists(path) ? std::filesystem::file_size(path, error_) : uint64_t{0};
+    offset = (offset + 63) / 64 * 64;
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out | (std::filesystem::exists(path) ? std::ios::openmode{} : std::ios::trunc));
+
+    auto chunk = std::vector<ProbePoint>{};
+    auto bytes = std::vector<char>{};
+    for (size_t first = 0; first < keys.size() && out && !error_; first += chunk_points_) {
+      const auto count = std::min(chunk_points_, keys.size() - first);
+      chunk.clear();
+      for (size_t i = first; i < first + count; i++) chunk.push_back(a_points[keys[i].second]);
+      std::ranges::stable_sort(chunk, {}, &ProbePoint::time);
+
+      const auto columns = detail::probe_columns(count);
+      bytes.assign(columns.back(), 0);
+      auto info = ProbeChunkInfo{a_partition, offset, count, chunk.front().time, chunk.back().time};
+      for (size_t i = 0; i < count; i++) {
+        const auto &point = chunk[i];
+        std::memcpy(bytes.data() + columns[0] + i * sizeof(int64_t), &point.time, sizeof(int64_t));
+        std::memcpy(bytes.data() + columns[1] + i * sizeof(double), &point.x, sizeof(double));
+        std::memcpy(bytes.data() + columns[2] + i * sizeof(double), &point.y, sizeof(double));
+        std::memcpy(bytes.data() + columns[3] + i * sizeof(int64_t), &point.vehicle_id, sizeof(int64_t));
+        std::memcpy(bytes.data() + columns[4] + i * sizeof(float), &point.speed, sizeof(float));
+        info.box.extend(point.x, point.y);
+      }
+
+      out.seekp(static_cast<std::streamoff>(offset));
+      out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+      chunks_.push_back(info);
+      offset += bytes.size();
+    }
+
+    if (!out && !error_) error_ = std::make_error_code(std::errc::io_error);
+    a_points.clear();
+    a_points.shrink_to_fit();
+  }
+
+  void write_index(std::error_code &error)
+  {
+    auto header = detail::ProbeIndexHeader{};
+    std::copy_n(detail::probe_magic, sizeof(header.magic), header.magic);
+    header.bucket = bucket_;
+    header.chunk_count = chunks_.size();
+
+    replace_file(detail::probe_index_file(dir_), [&](std::ofstream &out) {
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char *>(chunks_.data()), static_cast<std::streamsize>(chunks_.size() * sizeof(ProbeChunkInfo)));
+    }, error);
+  }
+
+  std::string dir_{};
+  int64_t bucket_{3600};
+  size_t chunk_points_{default_chunk_points};
+  std::map<int64_t, std::vector<ProbePoint>> pending_{};
+  std::vector<ProbeChunkInfo> chunks_{};
+  std::error_code error_{};
+  std::mutex mutex_{};
+};
+
+/**
+   A store of GPS probe points written by ProbeStoreWriter, its partition files mapped, and its
+   chunks scanned in place, in parallel on the shared executor. A query by time window and box
+   only reads the chunks whose range of times and box overlap it, looked up in the chunk index,
+   and, in each, only the points in the time window, found by binary search.
+
+   @code
+     mio::ProbeStore store;
+     std::error_code error;
+     store.open("probes", error);
+
+     // The points of the morning peak in downtown.
+     store.query(t0, t1, downtown, [&](size_t a_worker, const mio::ProbePoint &a_point) {
+       // ... do something about the point.
+     });
+   @endcode
+ */
+class ProbeStore
+{
+public:
+  ProbeStore() = default;
+  ProbeStore(const ProbeStore &) = delete;
+  ProbeStore &operator=(const ProbeStore &) = delete;
+
+  /**
+     Maps a store, as of when its writer was last closed.
+
+     \param error Set to std::errc::invalid_argument if the index is not one of a probe store
+     or a chunk is not in its partition file, or to describe the error if a file cannot be
+     read or mapped.
+   */
+  bool open(const std::string &a_dir, std::error_code &error)
+  {
+    error.clear();
+    close();
+    auto header = detail::ProbeIndexHeader{};
+    if (!detail::read_probe_index(a_dir, header, chunks_, error)) return false;
+
+    auto files = std::map<int64_t, uint32_t>{};
+    for (const auto &info: chunks_) {
+      const auto [it, inserted] = files.try_emplace(info.partition, static_cast<uint32_t>(files_.size()));
+      if (inserted) {
+        files_.emplace_back();
+        files_.back().map(detail::probe_partition_file(a_dir, info.partition), error);
+        if (error) {
+          close();
+          return false;
+        }
+      }
+
+      const auto &file = files_[it->second];
+      const auto size = detail::probe_columns(info.count).back();
+      if (info.offset % 64 != 0 || info.offset > file.size() || size > file.size() - info.offset) {
+        close();
+        error = std::make_error_code(std::errc::invalid_argument);
+        return false;
+      }
+      file_of_.push_back(it->second);
+      point_count_ += info.count;
+    }
+
+    bucket_ = header.bucket;
+    return true;
+  }
+
+  void close() noexcept
+  {
+    files_.clear();
+    file_of_.clear();
+    chunks_.clear();
+    point_count_ = 0;
+  }
+
+  /**
+     Time units per partition.
+   */
+  [[nodiscard]] int64_t bucket() const noexcept
+  {
+    return bucket_;
+  }
+
+  [[nodiscard]] size_t point_count() const noexcept
+  {
+    return point_count_;
+  }
+
+  [[nodiscard]] std::span<const ProbeChunkInfo> chunks() const noexcept
+  {
+    return chunks_;
+  }
+
+  /**
+     The columns of the i-th chunk of the index, in place.
+   */
+  [[nodiscard]] ProbeChunk chunk(const size_t i) const noexcept
+  {
+    const auto &info = chunks_[i];
+    const auto *base = files_[file_of_[i]].data() + info.offset;
+    const auto columns = detail::probe_columns(info.count);
+    return {{reinterpret_cast<const int64_t *>(base + columns[0]), info.count}, {reinterpret_cast<const double *>(base + columns[1]), info.count},
+            {reinterpret_cast<const double *>(base + columns[2]), info.count}, {reinterpret_cast<const int64_t *>(base + columns[3]), info.count},
+            {reinterpret_cast<const float *>(base + columns[4]), info.count}};
+  }
+
+  /**
+     The chunks of the index with points possibly in the time window [a_first_time,
+     a_last_time] and the box, in the order of the index.
+   */
+  [[nodiscard]] std::vector<size_t> select(const int64_t a_first_time, const int64_t a_last_time, const ProbeBox &a_box = ProbeBox::everywhere()) const
+  {
+    auto result = std::vector<size_t>{};
+    for (size_t i = 0; i < chunks_.size(); i++) {
+      const auto &info = chunks_[i];
+      if (info.max_time >= a_first_time && info.min_time <= a_last_time && info.box.intersects(a_box)) result.push_back(i);
+    }
+    return result;
+  }
+
+  /**
+     Fires `f(size_t worker, const ProbeChunk &chunk)` for each chunk selected, see select(),
+     concurrently on a_num_threads threads, each thread taking the next chunk.
+
+     \returns The number of chunks scanned.
+   */
+  template<typename F>
+  size_t for_each_chunk(const int64_t a_first_time, const int64_t a_last_time, const ProbeBox &a_box, const F &f,
+                        const size_t a_num_threads = available_concurrency()) const
+  {
+    const auto selected = select(a_first_time, a_last_time, a_box);
+    if (selected.empty()) return 0;
+
+    const auto threads = std::clamp(selected.size(), size_t{1}, std::max(a_num_threads, size_t{1}));
+    auto next = std::atomic<size_t>{0};
+    Executor::shared().run_workers(threads, [&](const size_t a_worker) {
+      for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < selected.size(); i = next.fetch_add(1, std::memory_order_relaxed))
+        f(a_worker, static_cast<const ProbeChunk &>(chunk(selected[i])));
+    });
+    return selected.size();
+  }
+
+  /**
+     Fires `f(size_t worker, const ProbePoint &point)` for each point in the time window
+     [a_first_time, a_last_time] and the box, concurrently on a_num_threads threads, the points
+     of a chunk on the same thread, by time.
+
+     \returns The number of points in the window and the box.
+   */
+  template<typename F>
+  size_t query(const int64_t a_first_time, const int64_t a_last_time, const ProbeBox &a_box, const F &f,
+               const size_t a_num_threads = available_concurrency()) const
+  {
+    auto count = std::atomic<size_t>{0};
+    for_each_chunk(a_first_time, a_last_time, a_box, [&](const size_t a_worker, const ProbeChunk &a_chunk) {
+      const auto first = static_cast<size_t>(std::ranges::lower_bound(a_chunk.times, a_first_time) - a_chunk.times.begin());
+      const auto last = static_cast<size_t>(std::ranges::upper_bound(a_chunk.times, a_last_time) - a_chunk.times.begin());
+      auto matched = size_t{0};
+      for (auto i = first; i < last; i++) {
+        if (!a_box.contains(a_chunk.xs[i], a_chunk.ys[i])) continue;
+        f(a_worker, static_cast<const ProbePoint &>(a_chunk[i]));
+        matched++;
+      }
+      count.fetch_add(matched, std::memory_order_relaxed);
+    }, a_num_threads);
+    return count.load();
+  }
+
+private:
+  std::vector<mmap_source> files_{};
+  std::vector<uint32_t> file_of_{};
+  std::vector<ProbeChunkInfo> chunks_{};
+  int64_t bucket_{0};
+  size_t point_count_{0};
+};
+
+}
+#endif
@@ -0,0 +1,412 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_QUEUE_HPP
+#define WXLIB_MIO_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace mio {
+
+/**
+   Size in bytes the hot members of the queues are padded to, so that the producers and the
+   consumers do not share cache lines.
+ */
+inline constexpr size_t cache_line_size = 64;
+
+namespace detail {
+
+/**
+   The closing and cancelling of a queue, and the waits of its producers and consumers, on
+   counters of pushes and pops bumped by the queue, with std::atomic::wait.
+ */
+class QueueState
+{
+public:
+  static constexpr int open = 0;
+  static constexpr int closed = 1;
+  static constexpr int cancelled = 2;
+
+  [[nodiscard]] int state() const noexcept
+  {
+    return state_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] uint32_t pushes() const noexcept
+  {
+    return pushes_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] uint32_t pops() const noexcept
+  {
+    return pops_.load(std::memory_order_acquire);
+  }
+
+  /**
+     Wakes a consumer, or all of them for a batch of more than one item.
+   */
+  void pushed(const size_t a_count = 1) noexcept
+  {
+    pushes_.fetch_add(1, std::memory_order_release);
+    if (a_count > 1) pushes_.notify_all();
+    else pushes_.notify_one();
+  }
+
+  /**
+     Wakes a producer, or all of them for a batch of more than one item.
+   */
+  void popped(const size_t a_count = 1) noexcept
+  {
+    pops_.fetch_add(1, std::memory_order_release);
+    if (a_count > 1) pops_.notify_all();
+    else pops_.notify_one();
+  }
+
+  void wait_pop(const uint32_t a_pops) const noexcept
+  {
+    pops_.wait(a_pops, std::memory_order_acquire);
+  }
+
+  void wait_push(const uint32_t a_pushes) const noexcept
+  {
+    pushes_.wait(a_pushes, std::memory_order_acquire);
+  }
+
+  void set(const int a_state) noexcept
+  {
+    auto state = state_.load(std::memory_order_relaxed);
+    while (state < a_state && !state_.compare_exchange_weak(state, a_state, std::memory_order_acq_rel)) {}
+
+    pushes_.fetch_add(1, std::memory_order_release);
+    pops_.fetch_add(1, std::memory_order_release);
+    pushes_.notify_all();
+    pops_.notify_all();
+  }
+
+private:
+  alignas(cache_line_size) std::atomic<uint32_t> pushes_{0};
+  alignas(cache_line_size) std::atomic<uint32_t> pops_{0};
+  std::atomic<int> state_{open};
+};
+
+/**
+   The blocking push and pop of a queue, on its try_push and try_pop, and their batch versions.
+ */
+template<typename Queue, typename T>
+class BlockingQueue
+{
+public:
+  /**
+     Queues an item, waiting while the queue is full.
+     \return False if the queue has been cancelled, in which case the item is dropped.
+   */
+  bool push(T a_item)
+  {
+    for (;;) {
+      const auto pops = state_.pops();
+      if (state_.state() == QueueState::cancelled) return false;
+      if (self().try_push(a_item)) return state_.pushed(), true;
+      state_.wait_pop(pops);
+    }
+  }
+
+  /**
+     Queues all the items, in order, waiting while the queue is full; the items are moved from.
+     \return False if the queue has been cancelled, in which case the items left are dropped.
+   */
+  bool push_n(std::span<T> a_items)
+  {
+    while (!a_items.empty()) {
+      const auto pops = state_.pops();
+      if (state_.state() == QueueState::cancelled) return false;
+      if (const auto n = self().try_push_n(a_items); n > 0) {
+        state_.pushed(n);
+        a_items = a_items.subspan(n);
+      } else {
+        state_.wait_pop(pops);
+      }
+    }
+    return true;
+  }
+
+  /**
+     Takes the oldest item, waiting while the queue is empty.
+     \return False once the queue is closed and drained, or cancelled.
+   */
+  bool pop(T &a_item)
+  {
+    for (;;) {
+      const auto pushes = state_.pushes();
+      const auto state = state_.state();
+      if (state == QueueState::cancelled) return false;
+      if (self().try_pop(a_item)) return state_.popped(), true;
+      // Nothing can be pushed after closing, so an empty closed queue stays empty.
+      if (state == QueueState::closed) return false;
+      state_.wait_push(pushes);
+    }
+  }
+
+  /**
+     Takes up to `a_items.size()` of the oldest items, waiting while the queue is empty.
+     \return The number of items taken, 0 once the queue is closed and drained, or cancelled.
+   */
+  size_t pop_n(std::span<T> a_items)
+  {
+    if (a_items.empty()) return 0;
+    for (;;) {
+      const auto pushes = state_.pushes();
+      const auto state = state_.state();
+      if (state == QueueState::cancelled) return 0;
+      if (const auto n = self().try_pop_n(a_items); n > 0) return state_.popped(n), n;
+      if (state == QueueState::closed) return 0;
+      state_.wait_push(pushes);
+    }
+  }
+
+  /**
+     Tells the consumers no more items will be pushed. Items already queued are still popped.
+   */
+  void close() noexcept
+  {
+    state_.set(QueueState::closed);
+  }
+
+  /**
+     Wakes the producers and consumers, and makes the blocking calls fail from now on.
+   */
+  void cancel() noexcept
+  {
+    state_.set(QueueState::cancelled);
+  }
+
+private:
+  Queue &self() noexcept
+  {
+    return static_cast<Queue &>(*this);
+  }
+
+  QueueState state_;
+};
+
+}
+
+/**
+   A bounded multi-producer multi-consumer queue, lock-free on its fast path: a ring of cells
+   stamped with sequence numbers (Vyukov), so that producers and consumers only contend on
+   their own end of the ring. push() waits while the queue is full, which is the backpressure
+   on the producers, and pop() while it is empty, both with std::atomic::wait.
+
+   Each cell takes at least a cache line, so that a producer filling a cell and a consumer
+   emptying the one next to it do not share a line. Batches claim consecutive cells with a single
+   compare and swap, see try_push_n and try_pop_n.
+
+   \tparam T The item type, e.g. a batch of records. Must be default constructible and move
+             assignable.
+ */
+template<typename T>
+class BoundedQueue : public detail::BlockingQueue<BoundedQueue<T>, T>
+{
+public:
+  /**
+     \param a_capacity Maximum number of items queued, rounded up to a power of 2, at least 2.
+   */
+  explicit BoundedQueue(const size_t a_capacity)
+      : mask_{std::bit_ceil(std::max(a_capacity, size_t{2})) - 1}, cells_{std::make_unique<Cell[]>(mask_ + 1)}
+  {
+    for (size_t i = 0; i <= mask_; i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return mask_ + 1;
+  }
+
+  /**
+     Queues an item if the queue is not full, without waiting.
+     \return False if the queue is full, in which case the item is left as is.
+   */
+  bool try_push(T &a_item) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    return try_push_n(std::span<T>{&a_item, 1}) == 1;
+  }
+
+  /**
+     Queues as many of the items as there is room for, in order, without waiting.
+     \return The number of items queued, moved from, from the first one on.
+   */
+  size_t try_push_n(std::span<T> a_items) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    auto pos = push_pos_.load(std::memory_order_relaxed);
+    size_t count;
+    for (;;) {
+      // The free cells from pos on, the ones whose sequence is their position.
+      count = 0;
+      while (count < a_items.size() && count <= mask_ && cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire) == pos + count) count++;
+
+      if (count > 0) {
+        if (push_pos_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+      } else if (static_cast<std::ptrdiff_t>(cells_[pos & mask_].sequence.load(std::memory_order_acquire) - pos) < 0) {
+        return 0;
+      } else {
+        pos = push_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      auto &cell = cells_[(pos + i) & mask_];
+      cell.value = std::move(a_items[i]);
+      cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+  /**
+     Takes the oldest item if the queue is not empty, without waiting.
+     \return False if the queue is empty.
+   */
+  bool try_pop(T &a_item) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    return try_pop_n(std::span<T>{&a_item, 1}) == 1;
+  }
+
+  /**
+     Takes up to `a_items.size()` of the oldest items, without waiting.
+     \return The number of items taken, into the first ones of a_items.
+   */
+  size_t try_pop_n(std::span<T> a_items) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    auto pos = pop_pos_.load(std::memory_order_relaxed);
+    size_t count;
+    for (;;) {
+      // The full cells from pos on, the ones whose sequence is one past their position.
+      count = 0;
+      while (count < a_items.size() && count <= mask_ && cells_[(pos + count) & mask_].sequence.load(std::memory_order_acquire) == pos + count + 1) count++;
+
+      if (count > 0) {
+        if (pop_pos_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+      } else if (static_cast<std::ptrdiff_t>(cells_[pos & mask_].sequence.load(std::memory_order_acquire) - (pos + 1)) < 0) {
+        return 0;
+      } else {
+        pos = pop_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      auto &cell = cells_[(pos + i) & mask_];
+      a_items[i] = std::move(cell.value);
+      cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return count;
+  }
+
+private:
+  struct alignas(cache_line_size) Cell
+  {
+    std::atomic<size_t> sequence{0};
+    T value{};
+  };
+
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(cache_line_size) std::atomic<size_t> push_pos_{0};
+  alignas(cache_line_size) std::atomic<size_t> pop_pos_{0};
+};
+
+/**
+   A bounded single-producer single-consumer queue, wait-free: a ring of items indexed by the
+   positions of the producer and the consumer, each on a cache line of its own, along with the
+   last view of the other position, so that the other one is only read when the ring looks full,
+   or empty. push() and pop() wait the same as BoundedQueue.
+
+   Only one thread may push, and one thread pop, at a time.
+
+   \tparam T The item type. Must be default constructible and move assignable.
+ */
+template<typename T>
+class SpscQueue : public detail::BlockingQueue<SpscQueue<T>, T>
+{
+public:
+  /**
+     \param a_capacity Maximum number of items queued, rounded up to a power of 2, at least 2.
+   */
+  explicit SpscQueue(const size_t a_capacity)
+      : mask_{std::bit_ceil(std::max(a_capacity, size_t{2})) - 1}, items_{std::make_unique<T[]>(mask_ + 1)}
+  {
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  [[nodiscard]] size_t capacity() const noexcept
+  {
+    return mask_ + 1;
+  }
+
+  bool try_push(T &a_item) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    return try_push_n(std::span<T>{&a_item, 1}) == 1;
+  }
+
+  /**
+     Queues as many of the items as there is room for, in order, without waiting, publishing them
+     at once.
+     \return The number of items queued, moved from, from the first one on.
+   */
+  size_t try_push_n(std::span<T> a_items) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    const auto tail = producer_.position.load(std::memory_order_relaxed);
+    if (tail - producer_.other + a_items.size() > capacity()) producer_.other = consumer_.position.load(std::memory_order_acquire);
+
+    const auto count = std::min(a_items.size(), capacity() - (tail - producer_.other));
+    for (size_t i = 0; i < count; i++) items_[(tail + i) & mask_] = std::move(a_items[i]);
+    if (count > 0) producer_.position.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  bool try_pop(T &a_item) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    return try_pop_n(std::span<T>{&a_item, 1}) == 1;
+  }
+
+  /**
+     Takes up to `a_items.size()` of the oldest items, without waiting.
+     \return The number of items taken, into the first ones of a_items.
+   */
+  size_t try_pop_n(std::span<T> a_items) noexcept(std::is_nothrow_move_assignable_v<T>)
+  {
+    const auto head = consumer_.position.load(std::memory_order_relaxed);
+    if (consumer_.other - head < a_items.size()) consumer_.other = producer_.position.load(std::memory_order_acquire);
+
+    const auto count = std::min(a_items.size(), consumer_.other - head);
+    for (size_t i = 0; i < count; i++) a_items[i] = std::move(items_[(head + i) & mask_]);
+    if (count > 0) consumer_.position.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  struct alignas(cache_line_size) End
+  {
+    std::atomic<size_t> position{0};
+    size_t other{0}; // The last view of the position of the other end.
+  };
+
+  size_t mask_;
+  std::unique_ptr<T[]> items_;
+  End producer_;
+  End consumer_;
+};
+
+}
+#endif
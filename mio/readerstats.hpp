@@ -0,0 +1,254 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_READER_STATS_HPP
+#define WXLIB_MIO_READER_STATS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#if defined(WXLIB_MIO_WITH_STATS) && defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace mio {
+
+/**
+   Whether the async reads of StringReaderAsync, and of the readers built on it, record
+   ReaderStats. Defining WXLIB_MIO_WITH_STATS turns the recording on; otherwise it is
+   compiled out entirely, and the stats stay empty.
+ */
+#ifdef WXLIB_MIO_WITH_STATS
+inline constexpr bool with_stats = true;
+#else
+inline constexpr bool with_stats = false;
+#endif
+
+/**
+   A chunk, or partition, of the content processed by a worker.
+ */
+struct ChunkSpan
+{
+  size_t offset{0};
+  size_t size{0};
+  size_t lines{0};
+  std::chrono::steady_clock::time_point start{};
+  std::chrono::steady_clock::time_point end{};
+};
+
+/**
+   What a worker of an async read did, and where its time went.
+ */
+struct WorkerStats
+{
+  size_t bytes{0};
+  size_t lines{0};
+
+  // From the worker starting to it running out of chunks.
+  std::chrono::steady_clock::time_point start{};
+  std::chrono::steady_clock::time_point end{};
+
+  // Time spent in the callback, the rest of the busy time being spent in fast_find.
+  std::chrono::nanoseconds callback_time{0};
+
+  // Time spent waiting, for the thread to start and for the slowest worker to finish.
+  std::chrono::nanoseconds wait_time{0};
+
+  // Page faults taken by the worker thread, Linux only.
+  uint64_t minor_faults{0};
+  uint64_t major_faults{0};
+
+  std::vector<ChunkSpan> chunks;
+
+  [[nodiscard]] std::chrono::nanoseconds busy_time() const noexcept
+  {
+    return end - start;
+  }
+
+  [[nodiscard]] std::chrono::nanoseconds scan_time() const noexcept
+  {
+    return busy_time() - callback_time;
+  }
+};
+
+/**
+   Statistics of the last async read of a reader, see with_stats. A read whose workers spend
+   most of their time in the callback is callback bound; one spending it scanning, with few
+   major faults, is scan bound; many major faults, or a long scan time over few bytes, tell
+   an I/O bound read; and a high skew, or long wait times, tell the partitioning is uneven.
+ */
+struct ReaderStats
+{
+  std::chrono::steady_clock::time_point start{};
+  std::chrono::steady_clock::time_point end{};
+
+  // Time spent cutting the content into partitions or chunks, before the workers start.
+  std::chrono::nanoseconds partition_time{0};
+
+  std::vector<WorkerStats> workers;
+
+  [[nodiscard]] size_t bytes() const noexcept
+  {
+    auto result = size_t{0};
+    for (const auto &w: workers) result += w.bytes;
+    return result;
+  }
+
+  [[nodiscard]] size_t lines() const noexcept
+  {
+    auto result = size_t{0};
+    for (const auto &w: workers) result += w.lines;
+    return result;
+  }
+
+  /**
+     Ratio of the busiest worker's busy time to the mean, 1 for a perfectly even read.
+   */
+  [[nodiscard]] double skew() const noexcept
+  {
+    if (workers.empty()) return 1.0;
+    auto total = std::chrono::nanoseconds{0};
+    auto busiest = std::chrono::nanoseconds{0};
+    for (const auto &w: workers) {
+      total += w.busy_time();
+      busiest = std::max(busiest, w.busy_time());
+    }
+    return total.count() > 0 ? static_cast<double>(busiest.count()) * static_cast<double>(workers.size()) / static_cast<double>(total.count()) : 1.0;
+  }
+
+  /**
+     Writes the read as a Chrome trace (chrome://tracing, or Perfetto), with a track per
+     worker showing its chunks, and a summary event per worker.
+
+     \param a_out The stream to write the JSON trace to.
+     \param a_name Name of the event spanning the whole read.
+   */
+  void write_chrome_trace(std::ostream &a_out, std::string_view a_name = "async_getline") const
+  {
+    auto us = [this](const std::chrono::steady_clock::time_point a_time) {
+      return std::chrono::duration<double, std::micro>(a_time - start).count();
+    };
+    auto us_of = [](const std::chrono::nanoseconds a_duration) {
+      return std::chrono::duration<double, std::micro>(a_duration).count();
+    };
+
+    a_out << R"({"traceEvents":[)" << '\n';
+    a_out << R"({"name":")" << a_name << R"(","ph":"X","pid":1,"tid":0,"ts":0,"dur":)" << us(end)
+          << R"(,"args":{"bytes":)" << bytes() << R"(,"lines":)" << lines() << R"(,"partition_us":)" << us_of(partition_time)
+          << R"(,"skew":)" << skew() << "}}";
+
+    for (size_t i = 0; i < workers.size(); i++) {
+      const auto &w = workers[i];
+      const auto tid = i + 1;
+      a_out << ",\n" << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << tid << R"(,"args":{"name":"worker )" << i << R"("}})";
+      a_out << ",\n" << R"({"name":"worker","ph":"X","pid":1,"tid":)" << tid << R"(,"ts":)" << us(w.start) << R"(,"dur":)" << us_of(w.busy_time())
+            << R"(,"args":{"bytes":)" << w.bytes << R"(,"lines":)" << w.lines << R"(,"callback_us":)" << us_of(w.callback_time)
+            << R"(,"scan_us":)" << us_of(w.scan_time()) << R"(,"wait_us":)" << us_of(w.wait_time)
+            << R"(,"minor_faults":)" << w.minor_faults << R"(,"major_faults":)" << w.major_faults << "}}";
+      for (const auto &c: w.chunks)
+        a_out << ",\n" << R"({"name":"chunk","ph":"X","pid":1,"tid":)" << tid << R"(,"ts":)" << us(c.start) << R"(,"dur":)" << us_of(c.end - c.start)
+              << R"(,"args":{"offset":)" << c.offset << R"(,"size":)" << c.size << R"(,"lines":)" << c.lines << "}}";
+    }
+
+    a_out << "\n]}\n";
+  }
+};
+
+namespace detail {
+
+/**
+   Records the WorkerStats of a worker for as long as it lives, or nothing at all unless
+   with_stats, in which case every member is an empty inline function.
+ */
+class stats_probe
+{
+public:
+#ifdef WXLIB_MIO_WITH_STATS
+  explicit stats_probe(WorkerStats &a_stats) noexcept : stats_{a_stats}
+  {
+    read_faults(minor_faults_, major_faults_);
+    stats_.start = std::chrono::steady_clock::now();
+  }
+
+  stats_probe(const stats_probe &) = delete;
+  stats_probe &operator=(const stats_probe &) = delete;
+
+  ~stats_probe()
+  {
+    stats_.end = std::chrono::steady_clock::now();
+    auto minor = uint64_t{0}, major = uint64_t{0};
+    read_faults(minor, major);
+    stats_.minor_faults = minor - minor_faults_;
+    stats_.major_faults = major - major_faults_;
+  }
+
+  void begin_chunk(const size_t a_offset, const size_t a_size)
+  {
+    stats_.chunks.push_back({a_offset, a_size, 0, std::chrono::steady_clock::now(), {}});
+    stats_.bytes += a_size;
+  }
+
+  void end_chunk(const size_t a_lines) noexcept
+  {
+    stats_.chunks.back().end = std::chrono::steady_clock::now();
+    stats_.chunks.back().lines = a_lines;
+    stats_.lines += a_lines;
+  }
+
+  template<typename F>
+  int call(const F &a_callback)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const auto status = a_callback();
+    stats_.callback_time += std::chrono::steady_clock::now() - start;
+    return status;
+  }
+
+private:
+  static void read_faults([[maybe_unused]] uint64_t &a_minor, [[maybe_unused]] uint64_t &a_major) noexcept
+  {
+#ifdef __linux__
+    rusage usage{};
+    if (::getrusage(RUSAGE_THREAD, &usage) == 0) {
+      a_minor = static_cast<uint64_t>(usage.ru_minflt);
+      a_major = static_cast<uint64_t>(usage.ru_majflt);
+    }
+#endif
+  }
+
+  WorkerStats &stats_;
+  uint64_t minor_faults_{0};
+  uint64_t major_faults_{0};
+#else
+  stats_probe() noexcept = default;
+
+  explicit stats_probe(WorkerStats &) noexcept
+  {
+  }
+
+  void begin_chunk(size_t, size_t) noexcept
+  {
+  }
+
+  void end_chunk(size_t) noexcept
+  {
+  }
+
+  template<typename F>
+  int call(const F &a_callback)
+  {
+    return a_callback();
+  }
+#endif
+};
+
+}
+
+}
+#endif
@@ -0,0 +1,49 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_REPLACE_FILE_HPP
+#define WXLIB_MIO_REPLACE_FILE_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+
+namespace mio {
+
+/**
+   Writes a file, e.g. a cache or a sidecar, by a_write(out) into a temporary file next to it,
+   renamed to a_path once written, so that a_path is either left as it was or replaced whole,
+   never seen half written by a reader.
+
+   \param a_path The file to write.
+   \param a_write Writes the content to the std::ofstream it is given.
+   \param error Set to std::errc::io_error if the content cannot be written, or to describe the
+   error if the temporary file cannot be renamed, in which case it is removed.
+
+   \returns True if a_path was replaced.
+ */
+template<typename WriteT>
+bool replace_file(const std::string &a_path, WriteT &&a_write, std::error_code &error)
+{
+  error.clear();
+  const auto tmp = a_path + ".tmp" + std::to_string(std::random_device{}());
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    a_write(out);
+    if (!out.flush()) error = std::make_error_code(std::errc::io_error);
+  }
+
+  if (!error) std::filesystem::rename(tmp, a_path, error);
+
+  // Best effort clean-up, the original error is what is reported.
+  std::error_code ignored;
+  if (error) std::filesystem::remove(tmp, ignored);
+  return !error;
+}
+
+}
+#endif
@@ -0,0 +1,465 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_SHORTEST_PATH_HPP
+#define WXLIB_MIO_SHORTEST_PATH_HPP
+
+#include <mio/executor.hpp>
+#include <mio/network.hpp>
+#include <mio/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   A monotone priority queue of {key, node} entries, whose keys are non-negative doubles, for
+   Dijkstra's algorithm, where no key pushed is less than the last key popped.
+
+   The bits of a non-negative double order as the double does. The keys are bucketed by their
+   top 28 bits, the exponent and 16 bits of the mantissa, an entry going to the bucket of the
+   highest of those bits in which it differs from the last key popped, so that an entry moves
+   at most 28 times whatever the spread of the costs. The few entries of the same top bits as
+   the last key, within 1/65536 of it, are kept in a binary heap of their exact keys, so that
+   the entries are popped in the exact order of their keys.
+ */
+class RadixHeap
+{
+public:
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return size_ == 0;
+  }
+
+  void push(const double a_key, const uint32_t a_node)
+  {
+    const auto key = std::bit_cast<uint64_t>(a_key);
+    const auto bucket = bucket_of(key);
+    buckets_[bucket].push_back({key, a_node});
+    if (bucket == 0) std::push_heap(buckets_[0].begin(), buckets_[0].end(), std::greater<>{});
+    size_++;
+  }
+
+  /**
+     Removes an entry of the least key, and returns it.
+   */
+  std::pair<double, uint32_t> pop()
+  {
+    auto &least = buckets_[0];
+    if (least.empty()) {
+      auto i = size_t{1};
+      while (buckets_[i].empty()) i++;
+
+      // The least key of the bucket becomes the last one, and the entries of the bucket all
+      // differ from it in lower bits only.
+      auto &bucket = buckets_[i];
+      last_ = std::min_element(bucket.begin(), bucket.end())->first >> shift;
+      for (const auto &entry: bucket) buckets_[bucket_of(entry.first)].push_back(entry);
+      bucket.clear();
+      std::make_heap(least.begin(), least.end(), std::greater<>{});
+    }
+
+    std::pop_heap(least.begin(), least.end(), std::greater<>{});
+    const auto entry = least.back();
+    least.pop_back();
+    size_--;
+    return {std::bit_cast<double>(entry.first), entry.second};
+  }
+
+  void clear() noexcept
+  {
+    for (auto &bucket: buckets_) bucket.clear();
+    last_ = 0;
+    size_ = 0;
+  }
+
+private:
+  // The bits below the top 28 of a key, which do not choose its bucket.
+  static constexpr int shift = 36;
+
+  [[nodiscard]] size_t bucket_of(const uint64_t a_key) const noexcept
+  {
+    const auto top = a_key >> shift;
+    return top == last_ ? 0 : static_cast<size_t>(64 - std::countl_zero(top ^ last_));
+  }
+
+  std::array<std::vector<std::pair<uint64_t, uint32_t>>, 64 - shift + 1> buckets_;
+  uint64_t last_{0};
+  size_t size_{0};
+};
+
+/**
+   The shortest path tree of an origin: the cost of each node from the origin, and the link
+   by which its shortest path enters it. A tree is meant to be reused from one origin to the
+   next, only the labels of the nodes the last search reached being reset.
+ */
+class ShortestPathTree
+{
+public:
+  static constexpr uint32_t npos = Network::npos;
+  static constexpr double unreached = std::numeric_limits<double>::infinity();
+
+  [[nodiscard]] uint32_t origin() const noexcept
+  {
+    return origin_;
+  }
+
+  /**
+     The cost of the shortest path from the origin to a node, or unreached.
+   */
+  [[nodiscard]] double cost(const uint32_t a_node) const noexcept
+  {
+    return cost_[a_node];
+  }
+
+  [[nodiscard]] bool reached(const uint32_t a_node) const noexcept
+  {
+    return cost_[a_node] != unreached;
+  }
+
+  /**
+     The last link of the shortest path to a node, or npos for the origin and the nodes not
+     reached.
+   */
+  [[nodiscard]] uint32_t parent_link(const uint32_t a_node) const noexcept
+  {
+    return parent_[a_node];
+  }
+
+  [[nodiscard]] std::span<const double> costs() const noexcept
+  {
+    return cost_;
+  }
+
+  [[nodiscard]] std::span<const uint32_t> parent_links() const noexcept
+  {
+    return parent_;
+  }
+
+  /**
+     The links of the shortest path from the origin to a node, in order, empty if the node is
+     the origin or is not reached.
+
+     \param a_from_nodes The from node of each link, e.g. Network::from_nodes().
+   */
+  [[nodiscard]] std::vector<uint32_t> path(const uint32_t a_node, std::span<const uint32_t> a_from_nodes) const
+  {
+    auto result = std::vector<uint32_t>{};
+    for (auto l = parent_[a_node]; l != npos; l = parent_[a_from_nodes[l]]) result.push_back(l);
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
+
+private:
+  friend class ShortestPaths;
+
+  /**
+     Resets the labels of the nodes reached, or all of them after a parallel search.
+   */
+  void reset(const size_t a_node_count, const uint32_t a_origin)
+  {
+    if (cost_.size() != a_node_count || dense_) {
+      cost_.assign(a_node_count, unreached);
+      parent_.assign(a_node_count, npos);
+    } else {
+      for (const auto node: reached_) cost_[node] = unreached, parent_[node] = npos;
+    }
+    reached_.clear();
+    heap_.clear();
+    dense_ = false;
+    origin_ = a_origin;
+  }
+
+  /**
+     Marks the targets of a search with a new stamp, and returns their number, repeated ones
+     counted once.
+   */
+  size_t mark_targets(std::span<const uint32_t> a_targets)
+  {
+    if (a_targets.empty()) return 0;
+    if (target_.size() != cost_.size() || ++stamp_ == 0) {
+      target_.assign(cost_.size(), 0);
+      stamp_ = 1;
+    }
+
+    auto count = size_t{0};
+    for (const auto node: a_targets) count += std::exchange(target_[node], stamp_) != stamp_;
+    return count;
+  }
+
+  std::vector<double> cost_;
+  std::vector<uint32_t> parent_;
+  std::vector<uint32_t> reached_;
+  std::vector<uint32_t> target_;
+  uint32_t stamp_{0};
+  RadixHeap heap_;
+  bool dense_{false};
+  uint32_t origin_{npos};
+};
+
+/**
+   Shortest paths over a CSR graph, e.g. a Network, with a non-negative weight per link, e.g.
+   its length or its congested travel time.
+
+   tree() runs Dijkstra's algorithm from one origin with a RadixHeap; trees() runs it from many
+   origins at once on the shared executor, each worker reusing one ShortestPathTree for all its
+   origins, which is the hot path of a traffic assignment; costs() is the many-to-many cost
+   matrix built on it. delta_stepping() spreads a single search over the workers instead, for
+   one query on a large network.
+
+   @code
+     mio::ShortestPaths paths(network, network.lengths());
+     paths.trees(origins, [&](size_t a_worker, size_t a_origin, const mio::ShortestPathTree &a_tree) {
+       // ... load the demand of origins[a_origin] onto the links of a_tree.
+     });
+   @endcode
+ */
+class ShortestPaths
+{
+public:
+  /**
+     \param a_out_offsets The CSR row offsets, node count + 1 of them.
+     \param a_to_nodes The to node of each link.
+     \param a_weights The weight of each link, non-negative. The spans must outlive the paths.
+   */
+  ShortestPaths(std::span<const uint64_t> a_out_offsets, std::span<const uint32_t> a_to_nodes, std::span<const double> a_weights) noexcept
+      : offsets_{a_out_offsets}, heads_{a_to_nodes}, weights_{a_weights}
+  {
+  }
+
+  ShortestPaths(const Network &a_network, std::span<const double> a_weights) noexcept
+      : ShortestPaths(a_network.out_offsets(), a_network.to_nodes(), a_weights)
+  {
+  }
+
+  [[nodiscard]] size_t node_count() const noexcept
+  {
+    return offsets_.empty() ? 0 : offsets_.size() - 1;
+  }
+
+  /**
+     Builds the shortest path tree of an origin into a_tree, with Dijkstra's algorithm.
+
+     \param a_origin The dense number of the origin node.
+     \param a_tree The tree, whose labels are reused.
+     \param a_targets If not empty, the search stops once all of them are settled, only the
+     costs of those nodes and of the nodes settled before them being final.
+   */
+  void tree(const uint32_t a_origin, ShortestPathTree &a_tree, std::span<const uint32_t> a_targets = {}) const
+  {
+    a_tree.reset(node_count(), a_origin);
+    auto &cost = a_tree.cost_;
+    auto &parent = a_tree.parent_;
+    auto &heap = a_tree.heap_;
+
+    cost[a_origin] = 0.0;
+    a_tree.reached_.push_back(a_origin);
+    heap.push(0.0, a_origin);
+
+    auto remaining = a_tree.mark_targets(a_targets);
+    while (!heap.empty()) {
+      const auto [d, u] = heap.pop();
+      if (d != cost[u]) continue;
+      if (remaining > 0 && a_tree.target_[u] == a_tree.stamp_ && --remaining == 0) break;
+
+      for (auto l = offsets_[u]; l < offsets_[u + 1]; l++) {
+        const auto v = heads_[l];
+        const auto candidate = d + weights_[l];
+        if (candidate < cost[v]) {
+          if (cost[v] == ShortestPathTree::unreached) a_tree.reached_.push_back(v);
+          cost[v] = candidate;
+          parent[v] = static_cast<uint32_t>(l);
+          heap.push(candidate, v);
+        }
+      }
+    }
+  }
+
+  /**
+     Builds the shortest path trees of many origins on a_num_threads threads of the shared
+     executor, and hands each tree to a_on_tree(worker_id, origin_index, tree) in the context of
+     its worker. Each worker reuses one tree for all the origins it claims, so the tree is only
+     valid for the duration of the call.
+
+     \param a_origins The dense numbers of the origin nodes.
+     \param a_on_tree The callback, invoked as a_on_tree(size_t, size_t, const ShortestPathTree &).
+     \param a_num_threads Number of threads, 0 treated as 1.
+   */
+  template<typename F>
+  void trees(std::span<const uint32_t> a_origins, const F &a_on_tree, const size_t a_num_threads = available_concurrency()) const
+  {
+    WXLIB_TRACE_SPAN("mio.shortest_path.trees");
+    const auto threads = std::clamp(a_origins.size(), size_t{1}, std::max(a_num_threads, size_t{1}));
+    auto next = std::atomic<size_t>{0};
+
+    Executor::shared().run_workers(threads, [&](const size_t a_worker) {
+      auto tree = ShortestPathTree{};
+      for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < a_origins.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+        this->tree(a_origins[i], tree);
+        a_on_tree(a_worker, i, static_cast<const ShortestPathTree &>(tree));
+      }
+    });
+  }
+
+  /**
+     The costs from each origin to each destination, row by row, unreached for the pairs with
+     no path; the trees of the origins are built in parallel, see trees(), each search stopping
+     once all the destinations are settled.
+   */
+  [[nodiscard]] std::vector<double> costs(std::span<const uint32_t> a_origins, std::span<const uint32_t> a_destinations,
+                                          const size_t a_num_threads = available_concurrency()) const
+  {
+    WXLIB_TRACE_SPAN("mio.shortest_path.costs");
+    auto result = std::vector<double>(a_origins.size() * a_destinations.size(), ShortestPathTree::unreached);
+    if (a_destinations.empty()) return result;
+
+    const auto threads = std::clamp(a_origins.size(), size_t{1}, std::max(a_num_threads, size_t{1}));
+    auto next = std::atomic<size_t>{0};
+    Executor::shared().run_workers(threads, [&](size_t) {
+      auto tree = ShortestPathTree{};
+      for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < a_origins.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+        this->tree(a_origins[i], tree, a_destinations);
+        for (size_t j = 0; j < a_destinations.size(); j++) result[i * a_destinations.size() + j] = tree.cost(a_destinations[j]);
+      }
+    });
+    return result;
+  }
+
+  /**
+     Builds the shortest path tree of an origin into a_tree, with the delta-stepping algorithm
+     of Meyer and Sanders on a_num_threads threads: the nodes are kept in buckets of costs of
+     width a_delta, the nodes of the least bucket relaxing their light links, of at most a_delta,
+     in parallel until the bucket empties, then their heavy links once. Too small a delta does
+     Dijkstra's work in many small steps; too large a one relaxes the same links many times.
+
+     The parent links are found once the costs are final, each node taking the link of least
+     number whose from node cost plus weight is its cost, so that the tree does not depend on
+     the order in which the threads relaxed the links. A cycle of zero weight links may then
+     show as a cycle of parents.
+
+     \param a_origin The dense number of the origin node.
+     \param a_tree The tree.
+     \param a_delta The bucket width, or 0 for the mean link weight.
+     \param a_num_threads Number of threads, 0 treated as 1.
+   */
+  void delta_stepping(const uint32_t a_origin, ShortestPathTree &a_tree, double a_delta = 0.0, const size_t a_num_threads = available_concurrency()) const
+  {
+    WXLIB_TRACE_SPAN("mio.shortest_path.delta_stepping");
+    const auto nodes = node_count();
+    a_tree.dense_ = true;
+    a_tree.reset(nodes, a_origin);
+    a_tree.dense_ = true;
+
+    if (a_delta <= 0.0) {
+      const auto total = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+      a_delta = weights_.empty() || total <= 0.0 ? 1.0 : total / static_cast<double>(weights_.size());
+    }
+
+    auto &cost = a_tree.cost_;
+    const auto threads = std::max(a_num_threads, size_t{1});
+    const auto bucket_of = [a_delta](const double a_cost) { return static_cast<size_t>(a_cost / a_delta); };
+
+    // Lowers the cost of a node, and tells whether it did.
+    const auto relax = [&cost](const uint32_t a_node, const double a_cost) {
+      auto label = std::atomic_ref<double>{cost[a_node]};
+      for (auto current = label.load(std::memory_order_relaxed); a_cost < current;)
+        if (label.compare_exchange_weak(current, a_cost, std::memory_order_relaxed)) return true;
+      return false;
+    };
+
+    auto buckets = std::vector<std::vector<uint32_t>>(1);
+    auto improved = std::vector<std::vector<uint32_t>>(threads);
+    auto round = std::vector<uint32_t>(nodes, 0);
+    auto stamp = uint32_t{0};
+
+    // Relaxes the light or the heavy links of the nodes, in parallel if there are enough of
+    // them, then files the nodes improved into their buckets.
+    const auto relax_all = [&](const std::vector<uint32_t> &a_nodes, const bool a_light) {
+      const auto on_range = [&](const size_t a_worker, const size_t a_first, const size_t a_last) {
+        auto &out = improved[a_worker];
+        for (auto i = a_first; i < a_last; i++) {
+          const auto u = a_nodes[i];
+          const auto d = std::atomic_ref<double>{cost[u]}.load(std::memory_order_relaxed);
+          for (auto l = offsets_[u]; l < offsets_[u + 1]; l++)
+            if ((weights_[l] <= a_delta) == a_light && relax(heads_[l], d + weights_[l])) out.push_back(heads_[l]);
+        }
+      };
+
+      const auto workers = std::min(threads, a_nodes.size() / 1024 + 1);
+      if (workers == 1) {
+        on_range(0, 0, a_nodes.size());
+      } else {
+        Executor::shared().run_workers(workers, [&](const size_t a_worker) {
+          on_range(a_worker, a_nodes.size() * a_worker / workers, a_nodes.size() * (a_worker + 1) / workers);
+        });
+      }
+
+      for (auto &out: improved) {
+        for (const auto v: out) {
+          const auto b = bucket_of(cost[v]);
+          if (b >= buckets.size()) buckets.resize(b + 1);
+          buckets[b].push_back(v);
+        }
+        out.clear();
+      }
+    };
+
+    cost[a_origin] = 0.0;
+    buckets[0].push_back(a_origin);
+    auto frontier = std::vector<uint32_t>{};
+    auto settled = std::vector<uint32_t>{};
+    for (size_t i = 0; i < buckets.size(); i++) {
+      settled.clear();
+      const auto settled_stamp = ++stamp;
+      while (!buckets[i].empty()) {
+        // Drops the nodes moved to a lower cost bucket since, and the repeated ones.
+        frontier.clear();
+        const auto frontier_stamp = ++stamp;
+        for (const auto v: buckets[i]) {
+          if (bucket_of(cost[v]) != i || round[v] == frontier_stamp) continue;
+          frontier.push_back(v);
+          if (round[v] < settled_stamp) settled.push_back(v);
+          round[v] = frontier_stamp;
+        }
+        buckets[i].clear();
+        relax_all(frontier, true);
+      }
+      relax_all(settled, false);
+    }
+
+    // The parents, from the final costs, the least link number winning the ties.
+    auto &parent = a_tree.parent_;
+    Executor::shared().parallel_for(0, nodes, [&](const size_t a_first, const size_t a_last) {
+      for (auto u = a_first; u < a_last; u++) {
+        if (cost[u] == ShortestPathTree::unreached) continue;
+        for (auto l = offsets_[u]; l < offsets_[u + 1]; l++) {
+          const auto v = heads_[l];
+          if (v == a_origin || cost[u] + weights_[l] != cost[v]) continue;
+          auto label = std::atomic_ref<uint32_t>{parent[v]};
+          for (auto current = label.load(std::memory_order_relaxed); l < current;)
+            if (label.compare_exchange_weak(current, static_cast<uint32_t>(l), std::memory_order_relaxed)) break;
+        }
+      }
+    });
+  }
+
+private:
+  std::span<const uint64_t> offsets_;
+  std::span<const uint32_t> heads_;
+  std::span<const double> weights_;
+};
+
+}
+#endif
@@ -0,0 +1,290 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_SNAPSHOT_HPP
+#define WXLIB_MIO_SNAPSHOT_HPP
+
+#include <mio/executor.hpp>
+#include <mio/queue.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   Read-copy-update of a read-only dataset, e.g. a basic_shared_mmap of a network file, or an
+   ipc::Dataset of a timetable, reloaded while query threads keep reading it.
+
+   A new version is built aside, in the background if need be, see reload_async(), then
+   published by an atomic pointer swap. Readers pin the current version, see read(), without
+   ever blocking, or being blocked by, a reload: a reader announces the epoch it reads in, in a
+   slot of its own, and a version replaced at epoch e is destroyed, e.g. unmapped, once no
+   reader is left in an epoch before e, by the publisher, or by the last reader leaving it.
+
+   @code
+     mio::SnapshotManager<mio::shared_mmap_source> network{mio::shared_mmap_source{"network.bin"}};
+
+     // Query threads.
+     const auto snapshot = network.read();
+     route(snapshot->data(), snapshot->size());
+
+     // Reload thread, a few times a day.
+     network.reload_async([] { return mio::shared_mmap_source{"network.bin"}; });
+   @endcode
+ */
+template<typename T>
+class SnapshotManager
+{
+  struct alignas(cache_line_size) Slot
+  {
+    std::atomic<uint64_t> epoch{0};
+  };
+
+public:
+  /**
+     A pinned version, kept alive for as long as the guard is, which should be short, e.g. one
+     query, since the versions replaced meanwhile are kept too. Move-only.
+   */
+  class Guard
+  {
+  public:
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+    Guard(Guard &&a_other) noexcept
+        : manager_{std::exchange(a_other.manager_, nullptr)}, slot_{a_other.slot_}, value_{a_other.value_}, version_{a_other.version_}
+    {
+    }
+
+    Guard &operator=(Guard &&a_other) noexcept
+    {
+      if (this != &a_other) {
+        release();
+        manager_ = std::exchange(a_other.manager_, nullptr);
+        slot_ = a_other.slot_;
+        value_ = a_other.value_;
+        version_ = a_other.version_;
+      }
+      return *this;
+    }
+
+    ~Guard()
+    {
+      release();
+    }
+
+    const T &operator*() const noexcept
+    {
+      return *value_;
+    }
+
+    const T *operator->() const noexcept
+    {
+      return value_;
+    }
+
+    [[nodiscard]] const T *get() const noexcept
+    {
+      return value_;
+    }
+
+    /**
+       Number of the version, 1 for the initial one, incremented by each publish().
+     */
+    [[nodiscard]] uint64_t version() const noexcept
+    {
+      return version_;
+    }
+
+    /**
+       Unpins the version before the guard goes out of scope.
+     */
+    void release() noexcept
+    {
+      if (manager_ != nullptr) std::exchange(manager_, nullptr)->unpin(slot_);
+    }
+
+  private:
+    friend class SnapshotManager;
+
+    Guard(const SnapshotManager *a_manager, const size_t a_slot, const T *a_value, const uint64_t a_version) noexcept
+        : manager_{a_manager}, slot_{a_slot}, value_{a_value}, version_{a_version}
+    {
+    }
+
+    const SnapshotManager *manager_;
+    size_t slot_;
+    const T *value_;
+    uint64_t version_;
+  };
+
+  /**
+     Manages an initial version.
+
+     \param a_max_readers Number of reader slots, i.e. of guards held at the same time; a reader
+     finding them all taken spins until one is released. 0 treated as 4 per hardware thread.
+   */
+  explicit SnapshotManager(T a_initial, const size_t a_max_readers = 0)
+      : slots_(a_max_readers == 0 ? 4 * std::max<size_t>(std::thread::hardware_concurrency(), 1) : a_max_readers)
+  {
+    current_.store(new Version{std::move(a_initial), 1}, std::memory_order_release);
+  }
+
+  SnapshotManager(const SnapshotManager &) = delete;
+  SnapshotManager &operator=(const SnapshotManager &) = delete;
+
+  /**
+     Destroys the current version, and those retired. No guard may be held any more.
+   */
+  ~SnapshotManager()
+  {
+    delete current_.load(std::memory_order_acquire);
+  }
+
+  /**
+     Pins the current version. Wait-free but for the unlikely case of all the reader slots
+     taken, in which case it spins until one is released.
+   */
+  [[nodiscard]] Guard read() const noexcept
+  {
+    // Threads start from slots of their own, so that they seldom contend on the same one.
+    const auto start = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    for (size_t i = 0;; i++) {
+      const auto s = (start + i) % slots_.size();
+      auto &slot = slots_[s].epoch;
+      if (slot.load(std::memory_order_relaxed) != 0) {
+        if (i % slots_.size() == slots_.size() - 1) std::this_thread::yield();
+        continue;
+      }
+
+      // The version is loaded once the epoch is announced, so that a version replaced after
+      // that is kept for the reader.
+      auto expected = uint64_t{0};
+      if (!slot.compare_exchange_strong(expected, epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst)) continue;
+
+      const auto *version = current_.load(std::memory_order_seq_cst);
+      return Guard{this, s, &version->value, version->number};
+    }
+  }
+
+  /**
+     Publishes a new version, which the readers pinning from now on read, and destroys the
+     versions no reader is left on, see reclaim().
+   */
+  void publish(T a_value)
+  {
+    auto lock = std::lock_guard{mutex_};
+    auto *version = new Version{std::move(a_value), next_version_++};
+    auto *replaced = current_.exchange(version, std::memory_order_seq_cst);
+    version_.store(version->number, std::memory_order_release);
+
+    // The readers that announced an earlier epoch may still read the version replaced.
+    const auto retired_at = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    retired_.push_back({retired_at, std::unique_ptr<Version>{replaced}});
+    retired_count_.store(retired_.size(), std::memory_order_release);
+    reclaim_locked();
+  }
+
+  /**
+     Builds a new version by a_build(), returning a T, then publishes it.
+   */
+  template<typename BuildT>
+  requires std::is_invocable_r_v<T, BuildT &>
+  void reload(BuildT &&a_build)
+  {
+    publish(a_build());
+  }
+
+  /**
+     Same as reload(), but builds and publishes the new version on the shared executor, see
+     Executor::shared(), while the readers keep reading the current one.
+
+     \returns A future, holding the exception thrown by a_build(), if any.
+   */
+  template<typename BuildT>
+  requires std::is_invocable_r_v<T, std::decay_t<BuildT> &>
+  std::future<void> reload_async(BuildT &&a_build)
+  {
+    auto task = std::make_shared<std::packaged_task<void()>>([this, build = std::forward<BuildT>(a_build)]() mutable { publish(build()); });
+    auto result = task->get_future();
+    Executor::shared().post([task] { (*task)(); });
+    return result;
+  }
+
+  /**
+     Destroys the versions replaced that no reader is left on.
+
+     \returns Number of versions replaced, not yet destroyed.
+   */
+  size_t reclaim()
+  {
+    auto lock = std::lock_guard{mutex_};
+    return reclaim_locked();
+  }
+
+  /**
+     Number of the current version, see Guard::version().
+   */
+  [[nodiscard]] uint64_t version() const noexcept
+  {
+    return version_.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Version
+  {
+    T value;
+    uint64_t number;
+  };
+
+  size_t reclaim_locked() const
+  {
+    // The oldest epoch a reader is in; the versions replaced up to it are no longer read.
+    auto oldest = epoch_.load(std::memory_order_seq_cst);
+    for (const auto &slot: slots_)
+      if (const auto e = slot.epoch.load(std::memory_order_seq_cst); e != 0) oldest = std::min(oldest, e);
+
+    const auto kept = std::ranges::partition(retired_, [oldest](const auto &a_retired) { return a_retired.first > oldest; });
+    retired_.erase(kept.begin(), kept.end());
+    retired_count_.store(retired_.size(), std::memory_order_release);
+    return retired_.size();
+  }
+
+  /**
+     Unpins a slot, destroying the versions replaced if this was the last reader of one, unless
+     another thread holds the lock, in which case they are left to the next publish() or
+     reclaim().
+   */
+  void unpin(const size_t a_slot) const noexcept
+  {
+    slots_[a_slot].epoch.store(0, std::memory_order_seq_cst);
+    if (retired_count_.load(std::memory_order_acquire) == 0) return;
+
+    auto lock = std::unique_lock{mutex_, std::try_to_lock};
+    if (lock.owns_lock()) reclaim_locked();
+  }
+
+  std::atomic<Version *> current_{nullptr};
+  alignas(cache_line_size) std::atomic<uint64_t> epoch_{1};
+  alignas(cache_line_size) mutable std::atomic<size_t> retired_count_{0};
+  std::atomic<uint64_t> version_{1};
+  mutable std::vector<Slot> slots_;
+  mutable std::mutex mutex_;
+  mutable std::vector<std::pair<uint64_t, std::unique_ptr<Version>>> retired_;
+  uint64_t next_version_{2};
+};
+
+}
+#endif
@@ -0,0 +1,879 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_SPATIAL_INDEX_HPP
+#define WXLIB_MIO_SPATIAL_INDEX_HPP
+
+#include <mio/mio.hpp>
+#include <mio/executor.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/network.hpp>
+#include <mio/extent.hpp>
+#include <mio/replacefile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mio {
+
+/**
+   A segment of a link geometry found by a spatial query: the link, the segment between its
+   points segment and segment + 1, and the distance to it.
+ */
+struct SpatialHit
+{
+  uint32_t link{std::numeric_limits<uint32_t>::max()};
+  uint32_t segment{0};
+  double distance{std::numeric_limits<double>::infinity()};
+
+  [[nodiscard]] explicit operator bool() const noexcept
+  {
+    return link != std::numeric_limits<uint32_t>::max();
+  }
+};
+
+namespace detail {
+
+/**
+   Squared distances from a point to a_count segments, given by the columns of their end
+   points.
+ */
+inline void segment_distances(const double a_x, const double a_y, const double *a_x0, const double *a_y0, const double *a_x1,
+                              const double *a_y1, const size_t a_count, double *a_out) noexcept
+{
+  for (size_t i = 0; i < a_count; i++) {
+    const auto dx = a_x1[i] - a_x0[i];
+    const auto dy = a_y1[i] - a_y0[i];
+    const auto length2 = dx * dx + dy * dy;
+    const auto t = length2 > 0 ? std::clamp(((a_x - a_x0[i]) * dx + (a_y - a_y0[i]) * dy) / length2, 0.0, 1.0) : 0.0;
+    const auto ex = a_x - (a_x0[i] + t * dx);
+    const auto ey = a_y - (a_y0[i] + t * dy);
+    a_out[i] = ex * ex + ey * ey;
+  }
+}
+
+#ifdef WXLIB_MIO_X86
+/**
+   segment_distances, 4 segments at a time. A segment of one point has a projection of 0/0,
+   which max_pd turns into 0, as it returns its second operand if either is NaN.
+ */
+WXLIB_MIO_TARGET("avx2,fma")
+inline void avx2_segment_distances(const double a_x, const double a_y, const double *a_x0, const double *a_y0, const double *a_x1,
+                                   const double *a_y1, const size_t a_count, double *a_out) noexcept
+{
+  const auto px = _mm256_set1_pd(a_x);
+  const auto py = _mm256_set1_pd(a_y);
+  const auto zero = _mm256_setzero_pd();
+  const auto one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= a_count; i += 4) {
+    const auto x0 = _mm256_loadu_pd(a_x0 + i);
+    const auto y0 = _mm256_loadu_pd(a_y0 + i);
+    const auto dx = _mm256_sub_pd(_mm256_loadu_pd(a_x1 + i), x0);
+    const auto dy = _mm256_sub_pd(_mm256_loadu_pd(a_y1 + i), y0);
+    const auto qx = _mm256_sub_pd(px, x0);
+    const auto qy = _mm256_sub_pd(py, y0);
+    const auto length2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+    const auto dot = _mm256_fmadd_pd(qx, dx, _mm256_mul_pd(qy, dy));
+    const auto t = _mm256_min_pd(_mm256_max_pd(_mm256_div_pd(dot, length2), zero), one);
+    const auto ex = _mm256_fnmadd_pd(t, dx, qx);
+    const auto ey = _mm256_fnmadd_pd(t, dy, qy);
+    _mm256_storeu_pd(a_out + i, _mm256_fmadd_pd(ex, ex, _mm256_mul_pd(ey, ey)));
+  }
+  segment_distances(a_x, a_y, a_x0 + i, a_y0 + i, a_x1 + i, a_y1 + i, a_count - i, a_out + i);
+}
+#endif
+
+/**
+   segment_distances, with AVX2 if the CPU supports it, see simd_level().
+ */
+inline void batch_segment_distances(const double a_x, const double a_y, const double *a_x0, const double *a_y0, const double *a_x1,
+                                    const double *a_y1, const size_t a_count, double *a_out) noexcept
+{
+#ifdef WXLIB_MIO_X86
+  const auto level = simd_level();
+  if (level == SimdLevel::Avx2 || level == SimdLevel::Avx512) return avx2_segment_distances(a_x, a_y, a_x0, a_y0, a_x1, a_y1, a_count, a_out);
+#endif
+  segment_distances(a_x, a_y, a_x0, a_y0, a_x1, a_y1, a_count, a_out);
+}
+
+/**
+   Fires f(first, last) for a_num_threads contiguous ranges splitting [0, a_count), on the
+   shared executor.
+ */
+template<typename F>
+void for_each_range(const size_t a_count, const size_t a_num_threads, const F &f)
+{
+  const auto threads = std::clamp(a_count, size_t{1}, std::max(a_num_threads, size_t{1}));
+  if (threads == 1) return f(size_t{0}, a_count);
+  Executor::shared().run_workers(threads, [&](const size_t i) { f(a_count * i / threads, a_count * (i + 1) / threads); });
+}
+
+/**
+   The segments of link geometries given as CSR columns, one per pair of consecutive points,
+   or one of length zero for a link of a single point, as columns of their end points.
+ */
+struct Segments
+{
+  std::vector<double> x0{};
+  std::vector<double> y0{};
+  std::vector<double> x1{};
+  std::vector<double> y1{};
+  std::vector<uint32_t> links{};
+  std::vector<uint32_t> segments{};
+
+  Segments(const std::span<const uint64_t> a_offsets, const std::span<const double> a_x, const std::span<const double> a_y, const size_t a_num_threads)
+  {
+    const auto link_count = a_offsets.empty() ? size_t{0} : a_offsets.size() - 1;
+    auto firsts = std::vector<uint64_t>(link_count + 1);
+    for (size_t l = 0; l < link_count; l++) {
+      const auto points = a_offsets[l + 1] - a_offsets[l];
+      firsts[l + 1] = firsts[l] + (points > 1 ? points - 1 : points);
+    }
+
+    const auto count = firsts.back();
+    x0.resize(count), y0.resize(count), x1.resize(count), y1.resize(count), links.resize(count), segments.resize(count);
+    for_each_range(link_count, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto l = a_first; l < a_last; l++) {
+        const auto p = a_offsets[l];
+        for (auto s = firsts[l]; s < firsts[l + 1]; s++) {
+          const auto k = s - firsts[l];
+          const auto q = a_offsets[l + 1] - a_offsets[l] > 1 ? p + k + 1 : p;
+          x0[s] = a_x[p + k], y0[s] = a_y[p + k], x1[s] = a_x[q], y1[s] = a_y[q];
+          links[s] = static_cast<uint32_t>(l);
+          segments[s] = static_cast<uint32_t>(k);
+        }
+      }
+    });
+  }
+
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return links.size();
+  }
+};
+
+struct Extent
+{
+  double min_x{std::numeric_limits<double>::infinity()};
+  double min_y{std::numeric_limits<double>::infinity()};
+  double max_x{-std::numeric_limits<double>::infinity()};
+  double max_y{-std::numeric_limits<double>::infinity()};
+
+  void extend(const Extent &a_extent) noexcept
+  {
+    min_x = std::min(min_x, a_extent.min_x);
+    min_y = std::min(min_y, a_extent.min_y);
+    max_x = std::max(max_x, a_extent.max_x);
+    max_y = std::max(max_y, a_extent.max_y);
+  }
+};
+
+inline Extent extent_of(const Segments &a_segments, const size_t a_num_threads)
+{
+  const auto threads = std::clamp(a_segments.size(), size_t{1}, std::max(a_num_threads, size_t{1}));
+  auto extents = std::vector<Extent>(threads);
+  auto next = std::atomic<size_t>{0};
+  for_each_range(a_segments.size(), threads, [&](const size_t a_first, const size_t a_last) {
+    auto extent = Extent{};
+    for (auto s = a_first; s < a_last; s++) {
+      extent.extend({std::min(a_segments.x0[s], a_segments.x1[s]), std::min(a_segments.y0[s], a_segments.y1[s]),
+                     std::max(a_segments.x0[s], a_segments.x1[s]), std::max(a_segments.y0[s], a_segments.y1[s])});
+    }
+    extents[next.fetch_add(1)] = extent;
+  });
+
+  auto result = Extent{};
+  for (const auto &extent: extents) result.extend(extent);
+  return result;
+}
+
+/**
+   The distance from a point to a box, 0 inside.
+ */
+inline double box_distance2(const double a_x, const double a_y, const double a_min_x, const double a_min_y, const double a_max_x,
+                            const double a_max_y) noexcept
+{
+  const auto dx = std::max({a_min_x - a_x, 0.0, a_x - a_max_x});
+  const auto dy = std::max({a_min_y - a_y, 0.0, a_y - a_max_y});
+  return dx * dx + dy * dy;
+}
+
+/**
+   The index of a cell of a 65536 x 65536 grid along the Hilbert curve.
+ */
+inline uint32_t hilbert(uint32_t a_x, uint32_t a_y) noexcept
+{
+  uint32_t d = 0;
+  for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+    const uint32_t rx = (a_x & s) > 0;
+    const uint32_t ry = (a_y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        a_x = 65535 - a_x;
+        a_y = 65535 - a_y;
+      }
+      std::swap(a_x, a_y);
+    }
+  }
+  return d;
+}
+
+/**
+   Sorts contiguous ranges on a_num_threads threads, then merges them pairwise, in parallel.
+ */
+template<typename T>
+void parallel_sort(std::vector<T> &a_values, const size_t a_num_threads)
+{
+  const auto threads = std::clamp(a_values.size() / 4096, size_t{1}, std::max(a_num_threads, size_t{1}));
+  auto bounds = std::vector<size_t>(threads + 1);
+  for (size_t i = 0; i <= threads; i++) bounds[i] = a_values.size() * i / threads;
+
+  for_each_range(threads, threads, [&](const size_t a_first, const size_t a_last) {
+    for (auto i = a_first; i < a_last; i++) std::sort(a_values.begin() + bounds[i], a_values.begin() + bounds[i + 1]);
+  });
+
+  for (size_t width = 1; width < threads; width *= 2) {
+    const auto pairs = (threads + 2 * width - 1) / (2 * width);
+    for_each_range(pairs, pairs, [&](const size_t a_first, const size_t a_last) {
+      for (auto p = a_first; p < a_last; p++) {
+        const auto first = p * 2 * width;
+        const auto middle = std::min(first + width, threads);
+        const auto last = std::min(first + 2 * width, threads);
+        std::inplace_merge(a_values.begin() + bounds[first], a_values.begin() + bounds[middle], a_values.begin() + bounds[last]);
+      }
+    });
+  }
+}
+
+}
+
+/**
+   A packed Hilbert R-tree of the segments of link geometries, bulk loaded, and stored flat in
+   arrays, so that it is saved to a file and mapped back with no rebuild, as the Network cache.
+
+   The segments are sorted by the Hilbert index of the centre of their box, and grouped by
+   node_size into the leaves, the leaves by node_size into the nodes above, and so on up to the
+   root. The end points of the segments are stored in the order of the tree, as columns, so that
+   the distances to all the segments of a leaf are computed at once, with AVX2 if the CPU
+   supports it. The segments, boxes and sort keys are computed in parallel, and sorted by
+   ranges merged in parallel.
+
+   Queries are the segments intersecting a box, the nearest segment to a point, and the
+   nearest links to it, best first, each link once, e.g. the candidate links of a probe point
+   in map-matching. The file uses the native byte order.
+
+   @code
+     mio::PackedRTree tree;
+     tree.build(network);
+     tree.save("links.wxrt", error);
+
+     if (const auto hit = tree.nearest(x, y, 50.0)) {
+       // ... hit.link is the nearest link, within 50 units, at hit.distance.
+     }
+   @endcode
+ */
+class PackedRTree
+{
+public:
+  static constexpr size_t node_size = 16;
+
+  PackedRTree() = default;
+  PackedRTree(const PackedRTree &) = delete;
+  PackedRTree &operator=(const PackedRTree &) = delete;
+
+  /**
+     Builds the tree of the segments of the link geometries of a network.
+   */
+  void build(const Network &a_network, const size_t a_num_threads = available_concurrency())
+  {
+    build(a_network.geometry_offsets(), a_network.geometry_x(), a_network.geometry_y(), a_num_threads);
+  }
+
+  /**
+     Builds the tree of the segments of link geometries given as CSR columns: the points of
+     link l are those from a_offsets[l] to a_offsets[l + 1] of a_x and a_y.
+   */
+  void build(const std::span<const uint64_t> a_offsets, const std::span<const double> a_x, const std::span<const double> a_y,
+             const size_t a_num_threads = available_concurrency())
+  {
+    close();
+    const auto source = detail::Segments{a_offsets, a_x, a_y, a_num_threads};
+    const auto count = source.size();
+    const auto extent = detail::extent_of(source, a_num_threads);
+
+    // The segments by the Hilbert index of their centre, on a grid over the extent.
+    auto keys = std::vector<std::pair<uint32_t, uint32_t>>(count);
+    const auto width = extent.max_x - extent.min_x, height = extent.max_y - extent.min_y;
+    detail::for_each_range(count, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto s = a_first; s < a_last; s++) {
+        const auto cx = (source.x0[s] + source.x1[s]) / 2, cy = (source.y0[s] + source.y1[s]) / 2;
+        const auto hx = width > 0 ? static_cast<uint32_t>((cx - extent.min_x) / width * 65535.0) : 0u;
+        const auto hy = height > 0 ? static_cast<uint32_t>((cy - extent.min_y) / height * 65535.0) : 0u;
+        keys[s] = {detail::hilbert(hx, hy), static_cast<uint32_t>(s)};
+      }
+    });
+    detail::parallel_sort(keys, a_num_threads);
+
+    // The level of the segments, then of the nodes of each level, up to the root, which is a
+    // node even above a single segment.
+    auto bounds = std::vector<uint64_t>{0, count};
+    while (bounds.size() == 2 || bounds.back() - bounds[bounds.size() - 2] > 1) {
+      const auto level = bounds.back() - bounds[bounds.size() - 2];
+      bounds.push_back(bounds.back() + (level + node_size - 1) / node_size);
+    }
+
+    const auto nodes = bounds.back();
+    auto min_x = std::vector<double>(nodes), min_y = std::vector<double>(nodes), max_x = std::vector<double>(nodes), max_y = std::vector<double>(nodes);
+    auto x0 = std::vector<double>(count), y0 = std::vector<double>(count), x1 = std::vector<double>(count), y1 = std::vector<double>(count);
+    auto links = std::vector<uint32_t>(count), segments = std::vector<uint32_t>(count);
+    detail::for_each_range(count, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) {
+        const auto s = keys[i].second;
+        x0[i] = source.x0[s], y0[i] = source.y0[s], x1[i] = source.x1[s], y1[i] = source.y1[s];
+        links[i] = source.links[s], segments[i] = source.segments[s];
+        min_x[i] = std::min(x0[i], x1[i]), min_y[i] = std::min(y0[i], y1[i]);
+        max_x[i] = std::max(x0[i], x1[i]), max_y[i] = std::max(y0[i], y1[i]);
+      }
+    });
+
+    for (size_t level = 1; level + 1 < bounds.size(); level++) {
+      const auto first = bounds[level], below = bounds[level - 1];
+      detail::for_each_range(bounds[level + 1] - first, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+        for (auto n = first + a_first; n < first + a_last; n++) {
+          const auto c0 = below + (n - first) * node_size, c1 = std::min<uint64_t>(c0 + node_size, first);
+          min_x[n] = *std::min_element(min_x.begin() + c0, min_x.begin() + c1);
+          min_y[n] = *std::min_element(min_y.begin() + c0, min_y.begin() + c1);
+          max_x[n] = *std::max_element(max_x.begin() + c0, max_x.begin() + c1);
+          max_y[n] = *std::max_element(max_y.begin() + c0, max_y.begin() + c1);
+        }
+      });
+    }
+
+    auto header = Header{};
+    header.segment_count = count;
+    header.node_count = nodes;
+    header.level_count = bounds.size() - 1;
+
+    auto bytes_of = [](const auto &a_vector) {
+      return std::string_view{reinterpret_cast<const char *>(a_vector.data()), a_vector.size() * sizeof(a_vector[0])};
+    };
+    const auto arrays = std::array<std::string_view, ArrayCount>{bytes_of(min_x), bytes_of(min_y), bytes_of(max_x), bytes_of(max_y), bytes_of(bounds),
+                                                                 bytes_of(x0), bytes_of(y0), bytes_of(x1), bytes_of(y1), bytes_of(links),
+                                                                 bytes_of(segments)};
+
+    // The same image as the file, in memory.
+    const auto entries = layout(arrays);
+    image_.assign((entries.back().offset + entries.back().size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    auto *image = reinterpret_cast<char *>(image_.data());
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + sizeof(header), &entries, sizeof(entries));
+    for (size_t i = 0; i < ArrayCount; i++) std::copy(arrays[i].begin(), arrays[i].end(), image + entries[i].offset);
+
+    bytes_ = {image, image_.size() * sizeof(uint64_t)};
+    header_ = header;
+    entries_ = entries;
+  }
+
+  /**
+     Writes the tree to a temporary file renamed to a_path once written.
+   */
+  bool save(const std::string &a_path, std::error_code &error) const
+  {
+    return replace_file(a_path, [&](std::ofstream &out) {
+      out.write(bytes_.data(), static_cast<std::streamsize>(bytes_.size()));
+    }, error);
+  }
+
+  /**
+     Maps a tree saved by save().
+
+     \param error Set to std::errc::invalid_argument if the file is not a tree, or to describe
+     the error if it cannot be mapped.
+   */
+  bool open(const std::string &a_path, std::error_code &error)
+  {
+    close();
+    error.clear();
+    mmap_.map(a_path, error);
+    if (error) return false;
+
+    auto header = Header{};
+    auto entries = Entries{};
+    const auto valid = [&] {
+      if (!read_extent_table({mmap_.data(), mmap_.size()}, header, entries, alignment)) return false;
+      if (std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.array_count != ArrayCount) return false;
+
+      const auto nodes = header.node_count * sizeof(double), segments = header.segment_count * sizeof(double);
+      return entries[MinX].size == nodes && entries[MaxY].size == nodes && entries[X0].size == segments && entries[Y1].size == segments
+          && entries[LevelBounds].size == (header.level_count + 1) * sizeof(uint64_t)
+          && entries[Segments].size == header.segment_count * sizeof(uint32_t);
+    }();
+
+    if (!valid) {
+      close();
+      error = std::make_error_code(std::errc::invalid_argument);
+      return false;
+    }
+
+    bytes_ = {mmap_.data(), mmap_.size()};
+    header_ = header;
+    entries_ = entries;
+    return true;
+  }
+
+  void close() noexcept
+  {
+    mmap_.unmap();
+    image_.clear();
+    bytes_ = {};
+    header_ = {};
+    entries_ = {};
+  }
+
+  [[nodiscard]] size_t segment_count() const noexcept
+  {
+    return header_.segment_count;
+  }
+
+  [[nodiscard]] size_t node_count() const noexcept
+  {
+    return header_.node_count;
+  }
+
+  /**
+     Fires `f(uint32_t link, uint32_t segment)` for each segment whose box intersects the box,
+     bounds included.
+   */
+  template<typename F>
+  void search(const double a_min_x, const double a_min_y, const double a_max_x, const double a_max_y, const F &f) const
+  {
+    if (header_.segment_count == 0) return;
+
+    const auto bounds = array<uint64_t>(LevelBounds);
+    const auto min_x = array<double>(MinX), min_y = array<double>(MinY), max_x = array<double>(MaxX), max_y = array<double>(MaxY);
+    const auto links = array<uint32_t>(Links), segments = array<uint32_t>(Segments);
+
+    auto stack = std::vector<std::pair<size_t, uint64_t>>{{header_.level_count - 1, header_.node_count - 1}};
+    while (!stack.empty()) {
+      const auto [level, node] = stack.back();
+      stack.pop_back();
+      if (min_x[node] > a_max_x || max_x[node] < a_min_x || min_y[node] > a_max_y || max_y[node] < a_min_y) continue;
+      if (level == 0) {
+        f(links[node], segments[node]);
+        continue;
+      }
+
+      const auto [c0, c1] = children(bounds, level, node);
+      for (auto c = c0; c < c1; c++) stack.emplace_back(level - 1, c);
+    }
+  }
+
+  /**
+     The nearest segment to a point, within a_max_distance, or none.
+   */
+  [[nodiscard]] SpatialHit nearest(const double a_x, const double a_y, const double a_max_distance = std::numeric_limits<double>::infinity()) const
+  {
+    auto result = SpatialHit{};
+    visit_nearest(a_x, a_y, a_max_distance, [&](const SpatialHit &a_hit) {
+      result = a_hit;
+      return false;
+    });
+    return result;
+  }
+
+  /**
+     The nearest segments of the a_count nearest links to a point, within a_max_distance, a link
+     once, by distance, into a_hits.
+   */
+  void nearest_links(const double a_x, const double a_y, const size_t a_count, const double a_max_distance, std::vector<SpatialHit> &a_hits) const
+  {
+    a_hits.clear();
+    if (a_count == 0) return;
+    visit_nearest(a_x, a_y, a_max_distance, [&](const SpatialHit &a_hit) {
+      const auto seen = std::ranges::any_of(a_hits, [&](const SpatialHit &a_other) { return a_other.link == a_hit.link; });
+      if (!seen) a_hits.push_back(a_hit);
+      return a_hits.size() < a_count;
+    });
+  }
+
+  /**
+     The nearest segment to each point, within a_max_distance, into a_hits, on a_num_threads
+     threads.
+   */
+  void nearest(const std::span<const double> a_x, const std::span<const double> a_y, const double a_max_distance, const std::span<SpatialHit> a_hits,
+               const size_t a_num_threads = available_concurrency()) const
+  {
+    detail::for_each_range(a_x.size(), a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) a_hits[i] = nearest(a_x[i], a_y[i], a_max_distance);
+    });
+  }
+
+private:
+  enum Array : size_t
+  {
+    MinX,
+    MinY,
+    MaxX,
+    MaxY,
+    LevelBounds,
+    X0,
+    Y0,
+    X1,
+    Y1,
+    Links,
+    Segments,
+    ArrayCount
+  };
+
+  struct Header
+  {
+    char magic[8] = {'W', 'X', 'R', 'T', 'R', 'E', '0', '1'};
+    uint64_t segment_count = 0;
+    uint64_t node_count = 0;
+    uint64_t level_count = 0;
+    uint64_t array_count = ArrayCount;
+    uint64_t reserved[3] = {};
+  };
+
+  static_assert(sizeof(Header) % 64 == 0);
+
+  // {offset, size} of each array.
+  using Entries = ExtentTable<ArrayCount>;
+
+  static constexpr size_t alignment = 64;
+
+  static Entries layout(const std::array<std::string_view, ArrayCount> &a_arrays) noexcept
+  {
+    auto entries = Entries{};
+    auto position = static_cast<uint64_t>(sizeof(Header) + sizeof(Entries));
+    for (size_t i = 0; i < ArrayCount; i++) entries[i] = place_extent(position, a_arrays[i].size(), alignment);
+    return entries;
+  }
+
+  template<typename T>
+  [[nodiscard]] std::span<const T> array(const Array a_array) const noexcept
+  {
+    const auto [offset, size] = entries_[a_array];
+    return {reinterpret_cast<const T *>(bytes_.data() + offset), static_cast<size_t>(size / sizeof(T))};
+  }
+
+  [[nodiscard]] static std::pair<uint64_t, uint64_t> children(const std::span<const uint64_t> a_bounds, const size_t a_level, const uint64_t a_node) noexcept
+  {
+    const auto first = a_bounds[a_level - 1] + (a_node - a_bounds[a_level]) * node_size;
+    return {first, std::min<uint64_t>(first + node_size, a_bounds[a_level])};
+  }
+
+  /**
+     Fires on_hit(hit) for the segments within a_max_distance, nearest first, while it returns
+     true: the nodes are visited best first by the distance to their box, and the segments of a
+     leaf pushed with their exact distances, computed at once.
+   */
+  template<typename F>
+  void visit_nearest(const double a_x, const double a_y, const double a_max_distance, const F &on_hit) const
+  {
+    if (header_.segment_count == 0) return;
+
+    const auto bounds = array<uint64_t>(LevelBounds);
+    const auto min_x = array<double>(MinX), min_y = array<double>(MinY), max_x = array<double>(MaxX), max_y = array<double>(MaxY);
+    const auto x0 = array<double>(X0), y0 = array<double>(Y0), x1 = array<double>(X1), y1 = array<double>(Y1);
+    const auto links = array<uint32_t>(Links), segments = array<uint32_t>(Segments);
+    const auto max2 = a_max_distance * a_max_distance;
+
+    struct Entry
+    {
+      double distance2;
+      size_t level;
+      uint64_t node;
+
+      bool operator>(const Entry &a_other) const noexcept
+      {
+        return distance2 > a_other.distance2 || (distance2 == a_other.distance2 && node > a_other.node);
+      }
+    };
+
+    auto queue = std::priority_queue<Entry, std::vector<Entry>, std::greater<>>{};
+    const auto root = header_.node_count - 1;
+    queue.push({detail::box_distance2(a_x, a_y, min_x[root], min_y[root], max_x[root], max_y[root]), header_.level_count - 1, root});
+
+    auto distances = std::array<double, node_size>{};
+    while (!queue.empty()) {
+      const auto entry = queue.top();
+      queue.pop();
+      if (entry.distance2 > max2) return;
+      if (entry.level == 0) {
+        if (!on_hit({links[entry.node], segments[entry.node], std::sqrt(entry.distance2)})) return;
+        continue;
+      }
+
+      const auto [c0, c1] = children(bounds, entry.level, entry.node);
+      if (entry.level == 1) {
+        detail::batch_segment_distances(a_x, a_y, &x0[c0], &y0[c0], &x1[c0], &y1[c0], c1 - c0, distances.data());
+        for (auto c = c0; c < c1; c++)
+          if (distances[c - c0] <= max2) queue.push({distances[c - c0], 0, c});
+      } else {
+        for (auto c = c0; c < c1; c++) {
+          const auto d2 = detail::box_distance2(a_x, a_y, min_x[c], min_y[c], max_x[c], max_y[c]);
+          if (d2 <= max2) queue.push({d2, entry.level - 1, c});
+        }
+      }
+    }
+  }
+
+  mmap_source mmap_;
+  std::vector<uint64_t> image_{};
+  std::span<const char> bytes_{};
+  Header header_{};
+  Entries entries_{};
+};
+
+/**
+   A uniform grid of the segments of link geometries, for the dense cores of a network, where
+   points are matched to nearby links: a segment is listed in every cell its box overlaps,
+   with its end points, so that the segments of a cell are contiguous columns whose distances
+   are computed at once, with AVX2 if the CPU supports it.
+
+   The nearest segment is searched in rings of cells around the cell of the point, until the
+   ring is farther than the nearest segment so far. The grid is built in parallel, in memory.
+
+   @code
+     mio::SpatialGrid grid;
+     grid.build(network, 100.0);
+     const auto hit = grid.nearest(x, y, 50.0);
+   @endcode
+ */
+class SpatialGrid
+{
+public:
+  SpatialGrid() = default;
+
+  /**
+     Builds the grid of the segments of the link geometries of a network, see build().
+   */
+  void build(const Network &a_network, const double a_cell_size = 0, const size_t a_num_threads = available_concurrency())
+  {
+    build(a_network.geometry_offsets(), a_network.geometry_x(), a_network.geometry_y(), a_cell_size, a_num_threads);
+  }
+
+  /**
+     Builds the grid of the segments of link geometries given as CSR columns, see
+     PackedRTree::build.
+
+     \param a_cell_size The side of the square cells, or 0 for about 4 segments per cell, with at
+     most about 2^22 cells.
+   */
+  void build(const std::span<const uint64_t> a_offsets, const std::span<const double> a_x, const std::span<const double> a_y, const double a_cell_size = 0,
+             const size_t a_num_threads = available_concurrency())
+  {
+    const auto source = detail::Segments{a_offsets, a_x, a_y, a_num_threads};
+    const auto count = source.size();
+    const auto extent = count == 0 ? detail::Extent{0, 0, 0, 0} : detail::extent_of(source, a_num_threads);
+
+    const auto width = extent.max_x - extent.min_x, height = extent.max_y - extent.min_y;
+    auto cell = a_cell_size > 0 ? a_cell_size : std::sqrt(std::max(width * height, 1e-12) * 4 / static_cast<double>(std::max(count, size_t{1})));
+    cell = std::max({cell, width / 2048, height / 2048, 1e-9});
+
+    min_x_ = extent.min_x;
+    min_y_ = extent.min_y;
+    cell_ = cell;
+    columns_ = static_cast<size_t>(width / cell) + 1;
+    rows_ = static_cast<size_t>(height / cell) + 1;
+
+    // Counted, offset, then filled, each segment into the cells of its box.
+    const auto cells = columns_ * rows_;
+    auto counts = std::vector<uint32_t>(cells + 1);
+    const auto for_each_cell = [&](const size_t s, const auto &f) {
+      const auto [c0, r0] = cell_of(std::min(source.x0[s], source.x1[s]), std::min(source.y0[s], source.y1[s]));
+      const auto [c1, r1] = cell_of(std::max(source.x0[s], source.x1[s]), std::max(source.y0[s], source.y1[s]));
+      for (auto r = r0; r <= r1; r++)
+        for (auto c = c0; c <= c1; c++) f(r * columns_ + c);
+    };
+    detail::for_each_range(count, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto s = a_first; s < a_last; s++)
+        for_each_cell(s, [&](const size_t a_cell) { std::atomic_ref{counts[a_cell + 1]}.fetch_add(1, std::memory_order_relaxed); });
+    });
+
+    offsets_.assign(cells + 1, 0);
+    for (size_t c = 0; c < cells; c++) offsets_[c + 1] = offsets_[c] + counts[c + 1];
+
+    auto order = std::vector<uint32_t>(offsets_.back());
+    auto cursors = std::vector<uint64_t>(offsets_.begin(), offsets_.end() - 1);
+    detail::for_each_range(count, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto s = a_first; s < a_last; s++)
+        for_each_cell(s, [&](const size_t a_cell) {
+          order[std::atomic_ref{cursors[a_cell]}.fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(s);
+        });
+    });
+
+    // The segments of a cell by their number, so that the grid does not depend on the threads.
+    const auto entries = order.size();
+    x0_.resize(entries), y0_.resize(entries), x1_.resize(entries), y1_.resize(entries), links_.resize(entries), segments_.resize(entries);
+    detail::for_each_range(cells, a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto c = a_first; c < a_last; c++) {
+        std::sort(order.begin() + static_cast<std::ptrdiff_t>(offsets_[c]), order.begin() + static_cast<std::ptrdiff_t>(offsets_[c + 1]));
+        for (auto i = offsets_[c]; i < offsets_[c + 1]; i++) {
+          const auto s = order[i];
+          x0_[i] = source.x0[s], y0_[i] = source.y0[s], x1_[i] = source.x1[s], y1_[i] = source.y1[s];
+          links_[i] = source.links[s], segments_[i] = source.segments[s];
+        }
+      }
+    });
+  }
+
+  [[nodiscard]] double cell_size() const noexcept
+  {
+    return cell_;
+  }
+
+  [[nodiscard]] size_t column_count() const noexcept
+  {
+    return columns_;
+  }
+
+  [[nodiscard]] size_t row_count() const noexcept
+  {
+    return rows_;
+  }
+
+  /**
+     Number of segments listed in their cells, a segment once per cell its box overlaps.
+   */
+  [[nodiscard]] size_t entry_count() const noexcept
+  {
+    return links_.size();
+  }
+
+  /**
+     Fires `f(uint32_t link, uint32_t segment)` once for each segment whose box intersects the
+     box, bounds included: in the first of its cells in the box, by row then column.
+   */
+  template<typename F>
+  void search(const double a_min_x, const double a_min_y, const double a_max_x, const double a_max_y, const F &f) const
+  {
+    if (links_.empty()) return;
+
+    const auto [c0, r0] = cell_of(a_min_x, a_min_y);
+    const auto [c1, r1] = cell_of(a_max_x, a_max_y);
+    for (auto r = r0; r <= r1; r++) {
+      for (auto c = c0; c <= c1; c++) {
+        const auto cell = r * columns_ + c;
+        for (auto i = offsets_[cell]; i < offsets_[cell + 1]; i++) {
+          const auto lo_x = std::min(x0_[i], x1_[i]), lo_y = std::min(y0_[i], y1_[i]);
+          const auto hi_x = std::max(x0_[i], x1_[i]), hi_y = std::max(y0_[i], y1_[i]);
+          if (lo_x > a_max_x || hi_x < a_min_x || lo_y > a_max_y || hi_y < a_min_y) continue;
+
+          // Reported from the cell of the lower corner of the overlap only.
+          const auto [first_c, first_r] = cell_of(std::max(lo_x, a_min_x), std::max(lo_y, a_min_y));
+          if (first_c == c && first_r == r) f(links_[i], segments_[i]);
+        }
+      }
+    }
+  }
+
+  /**
+     The nearest segment to a point, within a_max_distance, or none.
+   */
+  [[nodiscard]] SpatialHit nearest(const double a_x, const double a_y, const double a_max_distance = std::numeric_limits<double>::infinity()) const
+  {
+    auto result = SpatialHit{};
+    if (links_.empty()) return result;
+
+    // The rings around the cell of the point, clamped to the grid, as far as the farthest cell.
+    const auto [pc, pr] = cell_of(a_x, a_y);
+    const auto gap = std::max({min_x_ - a_x, a_x - (min_x_ + static_cast<double>(columns_) * cell_), min_y_ - a_y,
+                               a_y - (min_y_ + static_cast<double>(rows_) * cell_), 0.0});
+    const auto max_ring = std::max(columns_, rows_);
+    auto best2 = a_max_distance * a_max_distance;
+    auto distances = std::vector<double>{};
+
+    for (size_t ring = 0; ring <= max_ring; ring++) {
+      // The cells of the ring are at least ring - 1 cells away from the point, along one axis.
+      const auto nearest_ring = std::max(gap, static_cast<double>(ring > 0 ? ring - 1 : 0) * cell_);
+      if (nearest_ring * nearest_ring > best2) break;
+
+      const auto visit = [&](const size_t c, const size_t r) {
+        const auto cell = r * columns_ + c;
+        const auto first = offsets_[cell], n = offsets_[cell + 1] - first;
+        if (n == 0) return;
+        distances.resize(n);
+        detail::batch_segment_distances(a_x, a_y, &x0_[first], &y0_[first], &x1_[first], &y1_[first], n, distances.data());
+        for (size_t i = 0; i < n; i++) {
+          if (distances[i] < best2 || (distances[i] == best2 && (!result || links_[first + i] < result.link))) {
+            best2 = distances[i];
+            result = {links_[first + i], segments_[first + i], 0};
+          }
+        }
+      };
+
+      const auto r0 = static_cast<std::ptrdiff_t>(pr) - static_cast<std::ptrdiff_t>(ring), r1 = static_cast<std::ptrdiff_t>(pr + ring);
+      const auto c0 = static_cast<std::ptrdiff_t>(pc) - static_cast<std::ptrdiff_t>(ring), c1 = static_cast<std::ptrdiff_t>(pc + ring);
+      for (auto r = r0; r <= r1; r++) {
+        if (r < 0 || r >= static_cast<std::ptrdiff_t>(rows_)) continue;
+        const auto edge = r == r0 || r == r1;
+        for (auto c = c0; c <= c1; c += edge ? 1 : c1 - c0) {
+          if (c >= 0 && c < static_cast<std::ptrdiff_t>(columns_)) visit(static_cast<size_t>(c), static_cast<size_t>(r));
+          if (c1 == c0) break;
+        }
+      }
+    }
+
+    if (result) result.distance = std::sqrt(best2);
+    return result;
+  }
+
+  /**
+     The nearest segment to each point, within a_max_distance, into a_hits, on a_num_threads
+     threads.
+   */
+  void nearest(const std::span<const double> a_x, const std::span<const double> a_y, const double a_max_distance, const std::span<SpatialHit> a_hits,
+               const size_t a_num_threads = available_concurrency()) const
+  {
+    detail::for_each_range(a_x.size(), a_num_threads, [&](const size_t a_first, const size_t a_last) {
+      for (auto i = a_first; i < a_last; i++) a_hits[i] = nearest(a_x[i], a_y[i], a_max_distance);
+    });
+  }
+
+private:
+  /**
+     The column and row of the cell of a point, clamped to the grid.
+   */
+  [[nodiscard]] std::pair<size_t, size_t> cell_of(const double a_x, const double a_y) const noexcept
+  {
+    const auto clamp = [](const double a_value, const size_t a_count) {
+      return a_value <= 0 ? size_t{0} : std::min(static_cast<size_t>(a_value), a_count - 1);
+    };
+    return {clamp((a_x - min_x_) / cell_, columns_), clamp((a_y - min_y_) / cell_, rows_)};
+  }
+
+  double min_x_{0};
+  double min_y_{0};
+  double cell_{1};
+  size_t columns_{1};
+  size_t rows_{1};
+  std::vector<uint64_t> offsets_{0, 0};
+  std::vector<double> x0_{};
+  std::vector<double> y0_{};
+  std::vector<double> x1_{};
+  std::vector<double> y1_{};
+  std::vector<uint32_t> links_{};
+  std::vector<uint32_t> segments_{};
+};
+
+}
+#endif
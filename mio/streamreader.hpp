@@ -0,0 +1,981 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_STREAM_READER_HPP
+#define WXLIB_MIO_STREAM_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define WXLIB_MIO_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace mio {
+
+/**
+   The system interface a StreamingStringReader reads the file with.
+ */
+enum class IoBackend
+{
+  Automatic,  // io_uring on Linux, falling back to blocking reads if unavailable; overlapped reads on Windows.
+  IoUring,    // io_uring, Linux 5.1 or later.
+  Overlapped, // overlapped ReadFile, Windows.
+  Blocking    // pread, or ReadFile at an offset, on the reading thread.
+};
+
+/**
+   Options of a StreamingStringReader.
+ */
+struct StreamOptions
+{
+  IoBackend backend{IoBackend::Automatic};
+
+  // Size in bytes of each buffer, rounded up to the page size.
+  size_t buffer_size{size_t{1} << 20};
+
+  // Number of buffers, i.e., the maximum number of reads in flight plus the buffer being split.
+  size_t queue_depth{8};
+
+  // Bypasses the page cache (O_DIRECT, F_NOCACHE, or FILE_FLAG_NO_BUFFERING), if the file system
+  // supports it. Buffers and reads are page aligned.
+  bool direct{false};
+};
+
+namespace detail {
+
+/**
+   Positioned reads of a file into caller owned buffers, one read in flight per slot. Owns the
+   file handle, and waits for the reads in flight before closing it.
+ */
+class read_queue
+{
+public:
+  read_queue(const std::string &path, const StreamOptions &options, std::error_code &error)
+      : backend_{resolve(options.backend)},
+        fallback_{options.backend == IoBackend::Automatic},
+        slots_(std::max(options.queue_depth, size_t{1}))
+  {
+    error.clear();
+    open(path, options.direct, error);
+    if (!error) setup(error);
+  }
+
+  read_queue(const read_queue &) = delete;
+  read_queue &operator=(const read_queue &) = delete;
+
+  ~read_queue()
+  {
+    for (size_t slot = 0; slot < slots_.size(); slot++) {
+      if (!slots_[slot].in_flight) continue;
+#ifdef _WIN32
+      if (backend_ == IoBackend::Overlapped) ::CancelIoEx(handle_, &slots_[slot].overlapped);
+#endif
+      std::error_code ignored;
+      wait(slot, ignored);
+    }
+
+#ifdef WXLIB_MIO_HAS_IO_URING
+    if (uring_.fd >= 0) {
+      if (uring_.sqes) ::munmap(uring_.sqes, uring_.sqes_size);
+      if (uring_.cq_ptr && uring_.cq_ptr != uring_.sq_ptr) ::munmap(uring_.cq_ptr, uring_.cq_size);
+      if (uring_.sq_ptr) ::munmap(uring_.sq_ptr, uring_.sq_size);
+      ::close(uring_.fd);
+    }
+#endif
+
+#ifdef _WIN32
+    for (auto &slot: slots_)
+      if (slot.overlapped.hEvent) ::CloseHandle(slot.overlapped.hEvent);
+    if (handle_ != invalid_handle) ::CloseHandle(handle_);
+#else
+    if (handle_ != invalid_handle) ::close(handle_);
+#endif
+  }
+
+  [[nodiscard]] IoBackend backend() const noexcept
+  {
+    return backend_;
+  }
+
+  [[nodiscard]] bool is_direct() const noexcept
+  {
+    return direct_;
+  }
+
+  [[nodiscard]] file_handle_type handle() const noexcept
+  {
+    return handle_;
+  }
+
+  [[nodiscard]] size_t depth() const noexcept
+  {
+    return slots_.size();
+  }
+
+  /**
+     Starts reading a_length bytes at a_offset into a_buffer. The previous read of the slot must
+     have been waited for.
+   */
+  void submit(const size_t slot, char *buffer, const size_t length, const uint64_t offset, std::error_code &error) noexcept
+  {
+    auto &s = slots_[slot];
+    s.buffer = buffer;
+    s.length = length;
+    s.offset = offset;
+    s.done = false;
+
+    switch (backend_) {
+#ifdef WXLIB_MIO_HAS_IO_URING
+      case IoBackend::IoUring: {
+        s.iov = {buffer, length};
+        const auto tail = *uring_.sq_tail;
+        const auto index = tail & *uring_.sq_mask;
+
+        auto &sqe = uring_.sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = handle_;
+        sqe.addr = reinterpret_cast<uint64_t>(&s.iov);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = slot;
+
+        uring_.sq_array[index] = index;
+        std::atomic_ref<unsigned>{*uring_.sq_tail}.store(tail + 1, std::memory_order_release);
+
+        if (enter(1, 0, 0) < 0) {
+          error = detail::last_error();
+          return;
+        }
+        break;
+      }
+#endif
+#ifdef _WIN32
+      case IoBackend::Overlapped: {
+        s.overlapped.Offset = win::int64_low(static_cast<int64_t>(offset));
+        s.overlapped.OffsetHigh = win::int64_high(static_cast<int64_t>(offset));
+        if (!::ReadFile(handle_, buffer, static_cast<DWORD>(length), nullptr, &s.overlapped)) {
+          const auto code = ::GetLastError();
+          if (code == ERROR_HANDLE_EOF) {
+            s.done = true;
+            s.result = 0;
+          } else if (code != ERROR_IO_PENDING) {
+            error = detail::last_error();
+            return;
+          }
+        }
+        break;
+      }
+#endif
+      default:
+        // Blocking reads are performed by wait().
+        break;
+    }
+
+    s.in_flight = true;
+  }
+
+  /**
+     Waits for the read of the slot to complete.
+     \returns Number of bytes read, 0 at end of file, or -1 on error.
+   */
+  int64_t wait(const size_t slot, std::error_code &error) noexcept
+  {
+    auto &s = slots_[slot];
+    if (!s.in_flight) return 0;
+    s.in_flight = false;
+
+    switch (backend_) {
+#ifdef WXLIB_MIO_HAS_IO_URING
+      case IoBackend::IoUring:
+        while (!s.done) {
+          const auto head = *uring_.cq_head;
+          if (head == std::atomic_ref<unsigned>{*uring_.cq_tail}.load(std::memory_order_acquire)) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+              error = detail::last_error();
+              return -1;
+            }
+            continue;
+          }
+
+          const auto &cqe = uring_.cqes[head & *uring_.cq_mask];
+          slots_[cqe.user_data].result = cqe.res;
+          slots_[cqe.user_data].done = true;
+          std::atomic_ref<unsigned>{*uring_.cq_head}.store(head + 1, std::memory_order_release);
+        }
+
+        if (s.result < 0) {
+          error.assign(static_cast<int>(-s.result), std::system_category());
+          return -1;
+        }
+        return s.result;
+#endif
+#ifdef _WIN32
+      case IoBackend::Overlapped: {
+        if (s.done) return s.result;
+        DWORD n = 0;
+        if (!::GetOverlappedResult(handle_, &s.overlapped, &n, TRUE) && ::GetLastError() != ERROR_HANDLE_EOF) {
+          error = detail::last_error();
+          return -1;
+        }
+        return n;
+      }
+#endif
+      default:
+        return blocking_read(s, error);
+    }
+  }
+
+private:
+  struct slot_type
+  {
+    char *buffer{nullptr};
+    size_t length{0};
+    uint64_t offset{0};
+    int64_t result{0};
+    bool done{false};
+    bool in_flight{false};
+#ifdef WXLIB_MIO_HAS_IO_URING
+    iovec iov{};
+#endif
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+#endif
+  };
+
+  static IoBackend resolve(const IoBackend backend) noexcept
+  {
+    if (backend != IoBackend::Automatic) return backend;
+#if defined(WXLIB_MIO_HAS_IO_URING)
+    return IoBackend::IoUring;
+#elif defined(_WIN32)
+    return IoBackend::Overlapped;
+#else
+    return IoBackend::Blocking;
+#endif
+  }
+
+  void open(const std::string &path, const bool direct, std::error_code &error) noexcept
+  {
+#ifdef _WIN32
+    auto open_with = [&](DWORD flags) {
+      if (backend_ == IoBackend::Overlapped) flags |= FILE_FLAG_OVERLAPPED;
+      return ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, flags, 0);
+    };
+
+    handle_ = direct ? open_with(FILE_FLAG_NO_BUFFERING) : invalid_handle;
+    direct_ = handle_ != invalid_handle;
+    if (!direct_) handle_ = open_with(FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN);
+#else
+    handle_ = invalid_handle;
+#ifdef O_DIRECT
+    if (direct) handle_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+#endif
+    direct_ = handle_ != invalid_handle;
+    // Not all file systems support O_DIRECT; read through the page cache then.
+    if (!direct_) handle_ = ::open(path.c_str(), O_RDONLY);
+#ifdef __APPLE__
+    if (direct && handle_ != invalid_handle) direct_ = ::fcntl(handle_, F_NOCACHE, 1) != -1;
+#endif
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (!direct_ && handle_ != invalid_handle) ::posix_fadvise(handle_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+    if (handle_ == invalid_handle) error = detail::last_error();
+  }
+
+  void setup(std::error_code &error) noexcept
+  {
+    switch (backend_) {
+#ifdef WXLIB_MIO_HAS_IO_URING
+      case IoBackend::IoUring:
+        if (!setup_uring()) {
+          // io_uring may be disabled, e.g. by seccomp in containers.
+          if (fallback_) backend_ = IoBackend::Blocking;
+          else error = detail::last_error();
+        }
+        break;
+#endif
+#ifdef _WIN32
+      case IoBackend::Overlapped:
+        for (auto &slot: slots_) {
+          slot.overlapped.hEvent = ::CreateEventA(nullptr, TRUE, FALSE, nullptr);
+          if (!slot.overlapped.hEvent) {
+            error = detail::last_error();
+            return;
+          }
+        }
+        break;
+#endif
+      case IoBackend::Blocking: break;
+      default: error = std::make_error_code(std::errc::function_not_supported); break;
+    }
+  }
+
+  int64_t blocking_read(slot_type &s, std::error_code &error) noexcept
+  {
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+    overlapped.Offset = win::int64_low(static_cast<int64_t>(s.offset));
+    overlapped.OffsetHigh = win::int64_high(static_cast<int64_t>(s.offset));
+    DWORD n = 0;
+    if (!::ReadFile(handle_, s.buffer, static_cast<DWORD>(s.length), &n, &overlapped) && ::GetLastError() != ERROR_HANDLE_EOF) {
+      error = detail::last_error();
+      return -1;
+    }
+    return n;
+#else
+    ssize_t n;
+    do n = ::pread(handle_, s.buffer, s.length, static_cast<off_t>(s.offset));
+    while (n < 0 && errno == EINTR);
+
+    if (n < 0) error = detail::last_error();
+    return n;
+#endif
+  }
+
+#ifdef WXLIB_MIO_HAS_IO_URING
+  struct uring_type
+  {
+    int fd{-1};
+    void *sq_ptr{nullptr};
+    void *cq_ptr{nullptr};
+    size_t sq_size{0};
+    size_t cq_size{0};
+    io_uring_sqe *sqes{nullptr};
+    size_t sqes_size{0};
+    unsigned *sq_tail{nullptr};
+    unsigned *sq_mask{nullptr};
+    unsigned *sq_array{nullptr};
+    unsigned *cq_head{nullptr};
+    unsigned *cq_tail{nullptr};
+    unsigned *cq_mask{nullptr};
+    io_uring_cqe *cqes{nullptr};
+  };
+
+  /**
+     Sets up the ring with the raw system calls, so that liburing is not required.
+   */
+  bool setup_uring() noexcept
+  {
+    io_uring_params params{};
+    uring_.fd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(slots_.size()), &params));
+    if (uring_.fd < 0) return false;
+
+    uring_.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring_.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) uring_.sq_size = uring_.cq_size = std::max(uring_.sq_size, uring_.cq_size);
+
+    auto map_ring = [this](size_t size, off_t offset) -> void * {
+      void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_.fd, offset);
+      return p == MAP_FAILED ? nullptr : p;
+    };
+
+    uring_.sq_ptr = map_ring(uring_.sq_size, IORING_OFF_SQ_RING);
+    if (!uring_.sq_ptr) return false;
+    uring_.cq_ptr = single_mmap ? uring_.sq_ptr : map_ring(uring_.cq_size, IORING_OFF_CQ_RING);
+    if (!uring_.cq_ptr) return false;
+    uring_.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    uring_.sqes = static_cast<io_uring_sqe *>(map_ring(uring_.sqes_size, IORING_OFF_SQES));
+    if (!uring_.sqes) return false;
+
+    auto *sq = static_cast<char *>(uring_.sq_ptr);
+    auto *cq = static_cast<char *>(uring_.cq_ptr);
+    uring_.sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    uring_.sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    uring_.sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    uring_.cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    uring_.cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    uring_.cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    uring_.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  int enter(const unsigned to_submit, const unsigned min_complete, const unsigned flags) noexcept
+  {
+    int r;
+    do r = static_cast<int>(::syscall(__NR_io_uring_enter, uring_.fd, to_submit, min_complete, flags, nullptr, 0));
+    while (r < 0 && errno == EINTR && to_submit > 0);
+    return r;
+  }
+
+  uring_type uring_;
+#endif
+
+  IoBackend backend_;
+  bool fallback_;
+  bool direct_{false};
+  file_handle_type handle_{invalid_handle};
+  std::vector<slot_type> slots_;
+};
+
+
+/**
+   The chunks of a file read ahead into a ring of page aligned buffers, chunk i held in buffer
+   i % depth(), and read again as chunk i + depth() once released.
+ */
+class file_source
+{
+public:
+  using options_type = StreamOptions;
+
+  file_source(const std::string &path, const StreamOptions &options, std::error_code &error)
+      : buffer_size_{make_offset_page_aligned(std::max(options.buffer_size, size_t{1}) + page_size() - 1)},
+        buffers_{static_cast<char *>(::operator new[](buffer_size_ * std::max(options.queue_depth, size_t{1}), std::align_val_t{page_size()})),
+                 buffer_deleter{page_size()}},
+        queue_{path, options, error}
+  {
+    if (!error) size_ = detail::query_file_size(queue_.handle(), error);
+    for (size_t chunk = 0; chunk < depth() && !error; chunk++) submit(chunk, error);
+  }
+
+  [[nodiscard]] IoBackend backend() const noexcept
+  {
+    return queue_.backend();
+  }
+
+  [[nodiscard]] bool is_direct() const noexcept
+  {
+    return queue_.is_direct();
+  }
+
+  [[nodiscard]] size_t depth() const noexcept
+  {
+    return queue_.depth();
+  }
+
+  [[nodiscard]] bool exhausted(const size_t chunk) const noexcept
+  {
+    return offset_of(chunk) >= size_;
+  }
+
+  /**
+     Waits for the read of the chunk to complete.
+     \returns The content of the chunk, empty at end of file.
+   */
+  std::string_view acquire(const size_t chunk, std::error_code &error) noexcept
+  {
+    if (exhausted(chunk)) return {};
+
+    const auto slot = chunk % depth();
+    const auto offset = offset_of(chunk);
+    const auto expected = static_cast<size_t>(std::min<uint64_t>(buffer_size_, size_ - offset));
+    auto n = queue_.wait(slot, error);
+
+    // Short reads are completed synchronously; aligned, as they only occur at a block boundary.
+    while (!error && n > 0 && static_cast<size_t>(n) < expected) {
+      queue_.submit(slot, buffer_of(slot) + n, buffer_size_ - static_cast<size_t>(n), offset + static_cast<uint64_t>(n), error);
+      const auto more = error ? 0 : queue_.wait(slot, error);
+      if (more <= 0) break;
+      n += more;
+    }
+
+    if (error) return {};
+    if (n <= 0) {
+      // The file has been truncated after opening.
+      size_ = offset;
+      return {};
+    }
+
+    return {buffer_of(slot), std::min(static_cast<size_t>(n), expected)};
+  }
+
+  /**
+     Reads the chunk depth() ahead into the buffer of the chunk released.
+   */
+  void release(const size_t chunk, std::error_code &error) noexcept
+  {
+    submit(chunk + depth(), error);
+  }
+
+private:
+  struct buffer_deleter
+  {
+    size_t alignment;
+    void operator()(char *p) const noexcept
+    {
+      ::operator delete[](p, std::align_val_t{alignment});
+    }
+  };
+
+  [[nodiscard]] uint64_t offset_of(const size_t chunk) const noexcept
+  {
+    return static_cast<uint64_t>(chunk) * buffer_size_;
+  }
+
+  [[nodiscard]] char *buffer_of(const size_t slot) const noexcept
+  {
+    return buffers_.get() + slot * buffer_size_;
+  }
+
+  void submit(const size_t chunk, std::error_code &error) noexcept
+  {
+    if (exhausted(chunk)) return;
+    const auto slot = chunk % depth();
+    queue_.submit(slot, buffer_of(slot), buffer_size_, offset_of(chunk), error);
+  }
+
+  size_t buffer_size_;
+  uint64_t size_{0};
+
+  // Declared before the queue, which waits for the reads in flight into them.
+  std::unique_ptr<char[], buffer_deleter> buffers_;
+  read_queue queue_;
+};
+
+} // detail
+
+/**
+   A source of consecutive chunks of a stream in a ring of depth() buffers, chunk i held in
+   buffer i % depth(), for BasicStreamingStringReader. The buffer of a chunk is only reused
+   for chunk i + depth() after the chunk has been released, in order.
+
+   - acquire(i, error) waits for chunk i to be available, and returns its content, or an empty
+     view at end of stream.
+   - release(i, error) gives the buffer of chunk i back.
+   - exhausted(i) checks whether the stream ends before chunk i, waiting to know if need be.
+ */
+template<typename S>
+concept StreamSource = requires(S &s, const S &cs, size_t chunk, std::error_code &error) {
+  typename S::options_type;
+  { cs.depth() } -> std::convertible_to<size_t>;
+  { cs.exhausted(chunk) } -> std::same_as<bool>;
+  { s.acquire(chunk, error) } -> std::same_as<std::string_view>;
+  { s.release(chunk, error) };
+} && std::is_constructible_v<S, const std::string &, const typename S::options_type &, std::error_code &>;
+
+/**
+   A line reader over a stream of chunks in a ring of buffers, see StreamSource, e.g. a file
+   read with explicit reads (StreamingStringReader), for file systems where page faults on a
+   mapping perform poorly, such as network file systems and compressed volumes.
+
+   The API and the line splitting follow StringReader, so the two can be swapped per mount.
+   Every line is read, including the last one if not terminated by `\n`, excluding the
+   terminating `\n`. A line returned by getline() is only valid until the next call to getline().
+
+   @code
+     mio::StreamingStringReader reader("links.csv", {.direct = true});
+     while (!reader.eof()) {
+       auto line = reader.getline();
+       // ... do something about the line just read.
+     }
+
+     // Or, split the lines on the reading thread, and process them on 4 worker threads.
+     auto n = reader.async_getline([](int a_worker_id, const std::string_view a_line) { return 0; }, 4);
+   @endcode
+ */
+template<typename SourceT>
+requires StreamSource<SourceT>
+class BasicStreamingStringReader
+{
+public:
+  using Options = typename SourceT::options_type;
+
+  /**
+     Maximum number of lines handed to a batch callback at a time.
+   */
+  static constexpr size_t batch_size = LineIndex::batch_size;
+
+  /**
+     Constructs a reader to read from a disk file line by line. If the specified file does not
+     exist, or the options are not supported, std::system_error will be thrown with error code
+     describing the nature of the error.
+
+     \param   a_file  The file to read. It must exist.
+     \param   a_options  The options of the source, e.g. StreamOptions.
+   */
+  explicit BasicStreamingStringReader(const std::string &a_file, const Options &a_options = {})
+      : source_{a_file, a_options, error_}, pending_(source_.depth(), 0)
+  {
+    if (error_) throw std::system_error(error_);
+  }
+
+  BasicStreamingStringReader(const BasicStreamingStringReader &) = delete;
+  BasicStreamingStringReader(BasicStreamingStringReader &&) = delete;
+  BasicStreamingStringReader &operator=(BasicStreamingStringReader &) = delete;
+  BasicStreamingStringReader &operator=(BasicStreamingStringReader &&) = delete;
+  ~BasicStreamingStringReader() = default;
+
+  /**
+     Checks whether the reader has opened the file, and no error has occurred while reading.
+   */
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return !error_;
+  }
+
+  /**
+     Checks whether the reader has reached end of file, or stopped on an error.
+   */
+  [[nodiscard]] bool eof() const noexcept
+  {
+    return error_ || (cur_ == end_ && carry_.empty() && source_.exhausted(next_chunk_));
+  }
+
+  /**
+     Returns the error that stopped the reader, if any.
+   */
+  [[nodiscard]] std::error_code error() const noexcept
+  {
+    return error_;
+  }
+
+  /**
+     Returns the source of the chunks, e.g. to query the backend in use.
+   */
+  [[nodiscard]] const SourceT &source() const noexcept
+  {
+    return source_;
+  }
+
+  /**
+     Returns the backend in use, which is IoBackend::Blocking if IoBackend::Automatic found
+     io_uring unavailable; see source().
+   */
+  [[nodiscard]] IoBackend backend() const noexcept
+  requires requires(const SourceT &a_source) { a_source.backend(); }
+  {
+    return source_.backend();
+  }
+
+  /**
+     Returns a new line that has been read from the file as string view, valid until the next
+     call to getline().
+
+     \returns A std::string_view, {nullptr, 0} will be returned if the reader has reached end of file.
+   */
+  std::string_view getline() noexcept
+  {
+    auto line = std::string_view{};
+    if (semi_branch_expect(next_in_buffer(line), true)) return line;
+
+    while (true) {
+      if (cur_ != end_) {
+        const char *find_pos = fast_find<'\n'>(cur_, end_);
+        if (find_pos != end_) {
+          // The line started in an earlier buffer.
+          carry_.append(cur_, find_pos);
+          cur_ = std::next(find_pos);
+          line_.swap(carry_);
+          carry_.clear();
+          return line_;
+        }
+        carry_.append(cur_, end_);
+        cur_ = end_;
+      }
+
+      if (!next_buffer()) break;
+      if (carry_.empty() && next_in_buffer(line)) return line;
+    }
+
+    // The last line of the file may not be terminated by `\n`.
+    if (!carry_.empty() && !error_) {
+      line_.swap(carry_);
+      carry_.clear();
+      return line_;
+    }
+    return {};
+  }
+
+  /**
+     Sequentially reads the lines from the file and fires the callback to process them.
+
+     The callback is either a line handler (e.g. StringReader::SyncGetlineCallback) fired
+     once per line, or a batch handler (e.g. StringReader::SyncGetlineBatchCallback) fired
+     once per batch of lines. A batch never spans two buffers, so its lines stay valid for
+     the duration of the call.
+
+     \param a_callback A callback for processing new lines read.
+     \returns Total number of lines processed, stopping at the first non-zero status code.
+   */
+  template<typename CallbackT>
+  requires SyncGetlineHandler<CallbackT>
+  size_t getline(CallbackT &&a_callback) noexcept
+  {
+    auto line_count = size_t{0};
+
+    if constexpr (SyncBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+
+      while (!eof()) {
+        auto n = size_t{0};
+        batch[n] = getline();
+        if (batch[n++].data() == nullptr) break;
+        while (n < batch_size && next_in_buffer(batch[n])) n++;
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(std::span<const std::string_view>{batch.data(), n}) == 0), true))
+          line_count += n;
+        else
+          break;
+      }
+    } else {
+      while (!eof()) {
+        auto line = getline();
+        if (line.data() == nullptr) break;
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(line) == 0), true))
+          line_count++;
+        else
+          break;
+      }
+    }
+
+    return line_count;
+  }
+
+  /**
+     Reads the remaining lines, splitting them on the calling thread as the buffers arrive, and
+     fires the callback on a_num_threads worker threads to process them. The lines of a buffer
+     are processed in place; a buffer is reused only once its lines are processed.
+
+     The callback is either a line handler (e.g. StringReader::AsyncGetlineCallback) or a batch
+     handler (e.g. StringReader::AsyncGetlineBatchCallback), see StringReader::async_getline.
+
+     \param a_callback A callback for processing new lines read.
+     \param a_num_threads Number of worker threads, 0 treated as 1.
+     \returns Total number of lines processed. If a callback returns a non-zero status code, the
+     reading stops.
+   */
+  template<typename CallbackT>
+  requires AsyncGetlineHandler<CallbackT>
+  size_t async_getline(const CallbackT &a_callback, const size_t a_num_threads = available_concurrency()) noexcept
+  {
+    auto tasks = std::deque<Task>{};
+    auto closed = false;
+    auto stop = std::atomic<bool>{false};
+    auto has_task = std::condition_variable{};
+
+    auto worker = [&](int a_id) {
+      auto counter = size_t{0};
+      while (true) {
+        auto lock = std::unique_lock{mutex_};
+        has_task.wait(lock, [&] { return !tasks.empty() || closed; });
+        if (tasks.empty()) break;
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+
+        const auto block = task.owned.empty() ? task.block : std::string_view{task.owned};
+        if (!stop.load(std::memory_order_relaxed) && !getline_block(a_id, block, a_callback, counter))
+          stop.store(true, std::memory_order_relaxed);
+
+        if (task.slot != no_slot) {
+          lock.lock();
+          pending_[task.slot]--;
+          lock.unlock();
+          processed_.notify_all();
+        }
+      }
+      return counter;
+    };
+
+    auto push = [&](Task &&a_task) {
+      {
+        auto lock = std::lock_guard{mutex_};
+        if (a_task.slot != no_slot) pending_[a_task.slot]++;
+        tasks.push_back(std::move(a_task));
+      }
+      has_task.notify_one();
+    };
+
+    // The workers run on the shared executor, grown so that they all run while this thread reads.
+    auto &executor = Executor::shared();
+    auto counts = std::vector<size_t>(std::max(a_num_threads, size_t{1}));
+    executor.reserve(counts.size());
+    auto workers = TaskGroup{executor};
+    for (size_t i = 0; i < counts.size(); i++)
+      workers.run([&, i] { counts[i] = worker(static_cast<int>(i)); });
+
+    do {
+      if (cur_ == end_) continue;
+
+      // Completes the line started in an earlier buffer, then hands over the complete lines.
+      const char *b = cur_;
+      if (!carry_.empty()) {
+        const char *find_pos = fast_find<'\n'>(b, end_);
+        carry_.append(b, find_pos);
+        if (find_pos == end_) continue;
+        push(Task{no_slot, {}, std::exchange(carry_, {})});
+        b = std::next(find_pos);
+      }
+
+      const char *e = end_;
+      while (e != b && *std::prev(e) != '\n') --e;
+      if (e != b) push(Task{(next_chunk_ - 1) % pending_.size(), {b, static_cast<size_t>(e - b)}, {}});
+
+      carry_.assign(e, end_);
+    } while ((cur_ = end_, !stop.load(std::memory_order_relaxed)) && next_buffer());
+
+    if (!stop.load(std::memory_order_relaxed) && !carry_.empty()) push(Task{no_slot, {}, std::exchange(carry_, {})});
+    carry_.clear();
+
+    {
+      auto lock = std::lock_guard{mutex_};
+      closed = true;
+    }
+    has_task.notify_all();
+
+    workers.wait();
+    return std::accumulate(counts.begin(), counts.end(), size_t{0});
+  }
+
+private:
+  static constexpr size_t no_slot = size_t(-1);
+
+  /**
+     A block of complete lines, either in place in a buffer, or owned if it spans buffers.
+   */
+  struct Task
+  {
+    size_t slot;
+    std::string_view block;
+    std::string owned;
+  };
+
+  /**
+     Reads the next line if it lies entirely within the current buffer.
+   */
+  bool next_in_buffer(std::string_view &a_line) noexcept
+  {
+    if (!carry_.empty() || cur_ == end_) return false;
+
+    const char *find_pos = fast_find<'\n'>(cur_, end_);
+    if (find_pos == end_) return false;
+
+    a_line = {cur_, static_cast<size_t>(find_pos - cur_)};
+    cur_ = std::next(find_pos);
+    return true;
+  }
+
+  /**
+     Releases the consumed chunks, in order, whose lines have all been processed. Waits for the
+     workers only if the buffer is needed for the next chunk.
+   */
+  void release_consumed() noexcept
+  {
+    auto lock = std::unique_lock{mutex_};
+    while (!error_ && released_ < next_chunk_) {
+      const auto slot = released_ % pending_.size();
+      if (pending_[slot] != 0) {
+        if (released_ + pending_.size() > next_chunk_) break;
+        processed_.wait(lock, [&] { return pending_[slot] == 0; });
+      }
+      source_.release(released_++, error_);
+    }
+  }
+
+  /**
+     Moves on to the next chunk, waiting for it to be available.
+     \returns False at end of file, or on error.
+   */
+  bool next_buffer() noexcept
+  {
+    cur_ = end_ = nullptr;
+    release_consumed();
+    if (error_) return false;
+
+    const auto data = source_.acquire(next_chunk_, error_);
+    if (error_ || data.empty()) return false;
+
+    next_chunk_++;
+    cur_ = data.data();
+    end_ = std::next(cur_, static_cast<std::ptrdiff_t>(data.size()));
+    return true;
+  }
+
+  /**
+     Fires the callback for every line in a_block, the last of which may not be terminated by
+     `\n`, either line by line, or batch by batch if the callback is a batch handler.
+     @return False if the callback returned a non-zero status code, true otherwise.
+   */
+  template<typename CallbackT>
+  static bool getline_block(int a_thread_id, std::string_view a_block, const CallbackT &a_callback, size_t &a_counter) noexcept
+  {
+    const char *b = a_block.data();
+    const char *e = std::next(b, static_cast<std::ptrdiff_t>(a_block.size()));
+
+    if constexpr (AsyncBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+      auto n = size_t{0};
+
+      while (b != e) {
+        const char *find_pos = fast_find<'\n'>(b, e);
+        batch[n++] = {b, static_cast<size_t>(find_pos - b)};
+        b = (find_pos == e) ? e : std::next(find_pos);
+
+        // Flush the batch when it is full, or the block is exhausted.
+        if (n == batch_size || b == e) {
+          // If a non-zero status code is returned, break immediately.
+          if (semi_branch_expect(a_callback(a_thread_id, std::span<const std::string_view>{batch.data(), n}) == 0, true))
+            a_counter += std::exchange(n, 0);
+          else
+            return false;
+        }
+      }
+    } else {
+      while (b != e) {
+        const char *find_pos = fast_find<'\n'>(b, e);
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect(a_callback(a_thread_id, {b, static_cast<size_t>(find_pos - b)}) == 0, true))
+          a_counter++;
+        else
+          return false;
+
+        b = (find_pos == e) ? e : std::next(find_pos);
+      }
+    }
+
+    return true;
+  }
+
+  std::error_code error_;
+  SourceT source_;
+
+  std::vector<size_t> pending_; // Number of blocks of each buffer being processed by workers.
+  std::mutex mutex_;
+  std::condition_variable processed_;
+
+  size_t next_chunk_{0}; // The next chunk to consume.
+  size_t released_{0};   // The next chunk to release.
+  const char *cur_{nullptr};
+  const char *end_{nullptr};
+  std::string carry_; // The start of a line spanning buffers.
+  std::string line_;
+};
+
+/**
+   Reads a file line by line with explicit reads, see BasicStreamingStringReader and StreamOptions.
+ */
+using StreamingStringReader = BasicStreamingStringReader<detail::file_source>;
+
+}
+#endif
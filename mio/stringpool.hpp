@@ -0,0 +1,234 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_STRING_POOL_HPP
+#define WXLIB_MIO_STRING_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mio {
+
+/**
+   A string interned by a StringPool: a small integer ID, dense from 0, and the canonical view
+   of the string, stored in the arena of the pool. Two interned strings of the same pool are
+   equal if, and only if, their IDs are, so comparing and hashing them is comparing and hashing
+   integers.
+ */
+struct InternedString
+{
+  uint32_t id{0};
+  std::string_view view;
+
+  bool operator==(const InternedString &a_other) const noexcept
+  {
+    return id == a_other.id;
+  }
+};
+
+/**
+   A concurrent interning pool for the values repeated across the rows of a file, such as link
+   types, zone or route IDs, which maps each distinct string, e.g. a CsvField::data view into a
+   mapping, to an InternedString, so that consumers keep an ID, or a view into one copy, instead
+   of a std::string per row. The views stay valid for the lifetime of the pool, after the
+   mapping they were interned from is gone.
+
+   The strings are spread over shards by hash, each locked on its own, and a Cache per thread
+   keeps the strings it has already seen, so that the lookups of the common values do not
+   contend at all.
+
+   @code
+     mio::StringPool pool;
+     auto on_batch = [&](int a_id, std::span<const Record> a_recs) {
+       thread_local mio::StringPool::Cache cache{pool};
+       for (const auto &rec : a_recs) link_types[a_id].push_back(cache.intern(get<2>(rec).data).id);
+       return 0;
+     };
+   @endcode
+ */
+class StringPool
+{
+public:
+  /**
+     Size of the arena blocks the strings are copied into, 64 KiB; longer strings get a block of
+     their own.
+   */
+  static constexpr size_t block_size = size_t{64} << 10;
+
+  /**
+     A cache of the strings a thread has interned, unsynchronized, to be used by one thread at a
+     time. Falls back to the pool for the strings it has not seen yet.
+   */
+  class Cache
+  {
+  public:
+    explicit Cache(StringPool &a_pool) noexcept : pool_{a_pool}
+    {
+    }
+
+    InternedString intern(const std::string_view a_string)
+    {
+      if (const auto it = seen_.find(a_string); it != seen_.end()) return {it->second, it->first};
+
+      const auto interned = pool_.intern(a_string);
+      seen_.emplace(interned.view, interned.id);
+      return interned;
+    }
+
+    [[nodiscard]] StringPool &pool() const noexcept
+    {
+      return pool_;
+    }
+
+  private:
+    StringPool &pool_;
+    std::unordered_map<std::string_view, uint32_t> seen_;
+  };
+
+  StringPool() = default;
+  StringPool(const StringPool &) = delete;
+  StringPool &operator=(const StringPool &) = delete;
+
+  ~StringPool()
+  {
+    for (auto &segment: segments_) delete[] segment.load(std::memory_order_relaxed);
+  }
+
+  /**
+     Interns a string, copying it into the arena the first time it is seen. Thread safe.
+   */
+  InternedString intern(const std::string_view a_string)
+  {
+    const auto hash = std::hash<std::string_view>{}(a_string);
+    auto &shard = shards_[hash % shard_count];
+
+    {
+      std::shared_lock lock{shard.mutex};
+      if (const auto it = shard.ids.find(a_string); it != shard.ids.end()) return {it->second, it->first};
+    }
+
+    std::unique_lock lock{shard.mutex};
+    if (const auto it = shard.ids.find(a_string); it != shard.ids.end()) return {it->second, it->first};
+
+    const auto view = shard.store(a_string);
+    const auto id = static_cast<uint32_t>(size_.fetch_add(1, std::memory_order_relaxed));
+    slot(id) = view;
+    shard.ids.emplace(view, id);
+    return {id, view};
+  }
+
+  /**
+     Returns the canonical view of an interned string. Thread safe.
+
+     Precondition - a_id must have been returned by intern().
+   */
+  [[nodiscard]] std::string_view view(const uint32_t a_id) const noexcept
+  {
+    const auto [segment, offset] = locate(a_id);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  /**
+     Number of distinct strings interned.
+   */
+  [[nodiscard]] size_t size() const noexcept
+  {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  /**
+     Number of bytes the arena blocks hold, i.e. the memory used by the strings themselves.
+   */
+  [[nodiscard]] size_t arena_size() const
+  {
+    auto result = size_t{0};
+    for (auto &shard: shards_) {
+      std::shared_lock lock{shard.mutex};
+      result += shard.arena_size;
+    }
+    return result;
+  }
+
+private:
+  static constexpr size_t shard_count = 16;
+
+  // The ID table grows in segments of doubling sizes, never moved, so that view() needs no lock.
+  static constexpr size_t first_segment_bits = 10;
+  static constexpr size_t segment_count = 32 - first_segment_bits + 1;
+
+  struct Shard
+  {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<char[]>> large;
+    size_t used{block_size};
+    size_t arena_size{0};
+
+    std::string_view store(const std::string_view a_string)
+    {
+      if (a_string.empty()) return {};
+
+      if (a_string.size() > block_size) {
+        large.push_back(std::make_unique<char[]>(a_string.size()));
+        std::memcpy(large.back().get(), a_string.data(), a_string.size());
+        arena_size += a_string.size();
+        return {large.back().get(), a_string.size()};
+      }
+
+      if (block_size - used < a_string.size()) {
+        blocks.push_back(std::make_unique<char[]>(block_size));
+        used = 0;
+        arena_size += block_size;
+      }
+
+      auto *data = blocks.back().get() + used;
+      std::memcpy(data, a_string.data(), a_string.size());
+      used += a_string.size();
+      return {data, a_string.size()};
+    }
+  };
+
+  static std::pair<size_t, size_t> locate(const uint32_t a_id) noexcept
+  {
+    const auto index = (size_t{a_id} >> first_segment_bits) + 1;
+    const auto segment = static_cast<size_t>(std::bit_width(index)) - 1;
+    return {segment, size_t{a_id} - ((size_t{1} << (segment + first_segment_bits)) - (size_t{1} << first_segment_bits))};
+  }
+
+  std::string_view &slot(const uint32_t a_id)
+  {
+    const auto [segment, offset] = locate(a_id);
+    auto *table = segments_[segment].load(std::memory_order_acquire);
+    if (!table) {
+      std::scoped_lock lock{segments_mutex_};
+      table = segments_[segment].load(std::memory_order_relaxed);
+      if (!table) {
+        table = new std::string_view[size_t{1} << (segment + first_segment_bits)];
+        segments_[segment].store(table, std::memory_order_release);
+      }
+    }
+    return table[offset];
+  }
+
+  std::array<Shard, shard_count> shards_;
+  std::array<std::atomic<std::string_view *>, segment_count> segments_{};
+  std::mutex segments_mutex_;
+  std::atomic<size_t> size_{0};
+};
+
+}
+#endif
@@ -7,13 +7,33 @@
 #define WXLIB_MIO_STRING_READER_HPP
 
 #include <mio/mio.hpp>
+#include <mio/executor.hpp>
 #include <mio/fastfind.hpp>
+#include <mio/lineindex.hpp>
+#include <mio/readerstats.hpp>
+#include <mio/trace.hpp>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <concepts>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
 #include <functional>
-#include <future>
 #include <iterator>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #ifdef __GNUC__
@@ -24,9 +44,158 @@
 
 namespace mio {
 
+/**
+   Callable invoked with one line at a time, in synchronous loading mode.
+ */
+template<typename F>
+concept SyncLineHandler = std::is_invocable_r_v<int, F &, const std::string_view>;
+
+/**
+   Callable invoked with a batch of consecutive lines at a time, in synchronous loading mode.
+ */
+template<typename F>
+concept SyncBatchHandler = std::is_invocable_r_v<int, F &, std::span<const std::string_view>>;
+
+/**
+   Callable invoked with the worker ID and one line at a time, in asynchronous loading mode.
+ */
+template<typename F>
+concept AsyncLineHandler = std::is_invocable_r_v<int, F &, int, const std::string_view>;
+
+/**
+   Callable invoked with the worker ID and a batch of consecutive lines at a time, in
+   asynchronous loading mode.
+ */
+template<typename F>
+concept AsyncBatchHandler = std::is_invocable_r_v<int, F &, int, std::span<const std::string_view>>;
+
+/**
+   Callable invoked with the worker ID, the number (zero-based) of the line in the whole text,
+   and one line at a time, in asynchronous loading mode.
+ */
+template<typename F>
+concept AsyncNumberedLineHandler = std::is_invocable_r_v<int, F &, int, size_t, const std::string_view>;
+
+/**
+   Callable invoked with the worker ID, the number (zero-based) of the first line of the batch
+   in the whole text, and a batch of consecutive lines at a time, in asynchronous loading mode.
+ */
+template<typename F>
+concept AsyncNumberedBatchHandler = std::is_invocable_r_v<int, F &, int, size_t, std::span<const std::string_view>>;
+
+template<typename F>
+concept SyncGetlineHandler = SyncLineHandler<F> || SyncBatchHandler<F>;
+
+template<typename F>
+concept AsyncGetlineHandler = AsyncLineHandler<F> || AsyncBatchHandler<F>;
+
+template<typename F>
+concept AsyncNumberedHandler = AsyncNumberedLineHandler<F> || AsyncNumberedBatchHandler<F>;
+
+/**
+   A lazy view of the lines of a text, excluding the terminating `\n`, including the last
+   line if not terminated by `\n`. Each increment finds the next `\n` with fast_find, so a
+   pipeline that stops early, e.g. with std::views::take, only touches the pages it reads.
+
+   @code
+     auto slow = reader.lines()
+               | std::views::filter([](std::string_view a_line) { return a_line.ends_with(",0"); })
+               | std::views::take(10);
+   @endcode
+ */
+class LineView : public std::ranges::view_interface<LineView>
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    iterator(const char *a_begin, const char *a_end) noexcept : cur_{a_begin}, end_{a_end}, eol_{fast_find<'\n'>(a_begin, a_end)}
+    {
+    }
+
+    std::string_view operator*() const noexcept
+    {
+      return {cur_, static_cast<size_t>(eol_ - cur_)};
+    }
+
+    iterator &operator++() noexcept
+    {
+      cur_ = (eol_ == end_) ? end_ : std::next(eol_);
+      eol_ = fast_find<'\n'>(cur_, end_);
+      return *this;
+    }
+
+    iterator operator++(int) noexcept
+    {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator==(const iterator &a_other) const noexcept
+    {
+      return cur_ == a_other.cur_;
+    }
+
+    bool operator==(std::default_sentinel_t) const noexcept
+    {
+      return cur_ == end_;
+    }
+
+  private:
+    const char *cur_{nullptr};
+    const char *end_{nullptr};
+    const char *eol_{nullptr};
+  };
+
+  LineView() = default;
+
+  explicit LineView(const std::string_view a_text) noexcept : text_{a_text}
+  {
+  }
+
+  [[nodiscard]] iterator begin() const noexcept
+  {
+    return {text_.data(), text_.data() + text_.size()};
+  }
+
+  [[nodiscard]] std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+private:
+  std::string_view text_;
+};
+
+static_assert(std::ranges::forward_range<LineView> && std::ranges::view<LineView>);
+
+namespace detail {
+
+/**
+   The accumulator of a worker of StringReader::async_getline_reduce, made by the worker, in a
+   cache line of its own, so that the workers updating theirs do not share lines.
+ */
+template<typename Acc>
+struct alignas(64) ReduceSlot
+{
+  std::optional<Acc> acc{};
+};
+
+}
+
 /**
    A fast line reader based on memory mapped file. Supports two loading modes:
-   synchronous loading and asynchronous loading.
+   synchronous loading and asynchronous loading. Text already in memory, or in a
+   mapping shared with other readers, is read the same way, see
+   StringReader(std::span<const char>) and StringReader(const shared_mmap_source &).
 
    Synchronous Loading - the entire file is first mapped into memory, then lines
    of the file are read sequentially, one by one.
@@ -70,7 +239,9 @@ namespace mio {
 
      if (reader.is_mapped()) {
        // returns total number of lines read
-       auto total_lines = reader.getline_async<4>(on_getline); .
+       auto total_lines = reader.async_getline<4>(on_getline);
+       // or, with the number of threads decided at runtime
+       total_lines = reader.async_getline(on_getline, mio::available_concurrency());
      }
    @endcode
 
@@ -87,7 +258,8 @@ public:
 
     Should return status code 0 for success, and non-zero for error.
     When a non-zero error code is returned, the async loading process will be
-    terminated immediately with no more lines being loaded thereafter.
+    terminated immediately with no more lines being loaded thereafter, by any
+    of the threads. The first such code is returned by status().
 
     Exceptions, if any, must not escape the callback. They must be handled
     inside the call back, then translated to user-defined error code before returning.
@@ -106,6 +278,35 @@ public:
   */
   using SyncGetlineCallback = std::function<int(const std::string_view)>;
 
+  /**
+    Same as AsyncGetlineCallback, except that it fires once per batch of up to
+    StringReader::batch_size consecutive lines, instead of once per line.
+
+    The lines of a batch are only valid for the duration of the call. When a
+    non-zero error code is returned, none of the lines of that batch are counted.
+  */
+  using AsyncGetlineBatchCallback = std::function<int(int, std::span<const std::string_view>)>;
+
+  /**
+    Same as AsyncGetlineCallback, except that it is also given the number (zero-based) of
+    the line in the whole text, see async_getline.
+  */
+  using AsyncNumberedGetlineCallback = std::function<int(int, size_t, const std::string_view)>;
+
+  /**
+    Same as SyncGetlineCallback, except that it fires once per batch of up to
+    StringReader::batch_size consecutive lines, instead of once per line.
+
+    The lines of a batch are only valid for the duration of the call. When a
+    non-zero error code is returned, none of the lines of that batch are counted.
+  */
+  using SyncGetlineBatchCallback = std::function<int(std::span<const std::string_view>)>;
+
+  /**
+    Maximum number of lines handed to a batch callback at a time.
+  */
+  static constexpr size_t batch_size = LineIndex::batch_size;
+
   /**
      Constructs a reader to read from a disk file line by line. If the
      specified file does not exist, std::system_error will be thrown with
@@ -115,14 +316,57 @@ public:
 
      \param   a_file  The file to read. It must exist.
    */
-  [[maybe_unused]] explicit StringReader(const std::string &a_file) : mmap_{a_file}
+  [[maybe_unused]] explicit StringReader(const std::string &a_file) : mmap_{a_file}, file_{a_file}
+  {
+    set_content({mmap_.data(), mmap_.size()});
+  }
+
+  explicit StringReader(const std::string &&a_file) : mmap_{a_file}, file_{a_file}
+  {
+    set_content({mmap_.data(), mmap_.size()});
+  }
+
+  /**
+     Constructs a reader to read from memory line by line, e.g. data received over the
+     network, or decompressed, without writing it to a file first. The reader neither
+     copies nor owns the data, which must outlive it.
+
+     The span type has to be named, e.g. `StringReader(std::span<const char>{text})`, so
+     that a string is still taken for a file name.
+
+     \param   a_data  The text to read.
+   */
+  explicit StringReader(std::same_as<std::span<const char>> auto a_data) : in_memory_{true}
+  {
+    set_content({a_data.data(), a_data.size()});
+  }
+
+  /**
+     Constructs a reader to read from a mapping shared with the caller, e.g. one also read
+     by other components, which the reader keeps alive.
+
+     \param   a_source  The mapping to read. It must be mapped.
+   */
+  explicit StringReader(const shared_mmap_source &a_source) : shared_{a_source}
   {
-    begin_ = mmap_.begin();
+    set_content({shared_.data(), shared_.size()});
   }
 
-  explicit StringReader(const std::string &&a_file) : mmap_{a_file}
+  /**
+     Same as StringReader(a_file), and applies the access hints to the mapping, see
+     mio::access_hint. For example, access_hint::sequential to get kernel read-ahead
+     for a single pass over a cold file, or access_hint::random for sparse lookups
+     through line().
+
+     \param   a_file  The file to read. It must exist.
+     \param   a_hint  The access hints.
+   */
+  StringReader(const std::string &a_file, const access_hint a_hint) : file_{a_file}
   {
-    begin_ = mmap_.begin();
+    std::error_code error;
+    mmap_.map(a_file, 0, map_entire_file, a_hint, error);
+    if (error) throw std::system_error(error);
+    set_content({mmap_.data(), mmap_.size()});
   }
 
   StringReader() = delete;
@@ -149,14 +393,87 @@ public:
   }
 
   /**
-   Checks whether the reader has successfully mapped the underlying file.
-   Only on mapped file can getline be called.
+   Checks whether the reader has successfully mapped the underlying file, or reads from
+   memory. Only on mapped file can getline be called.
 
    \returns True if mapped, false otherwise.
  */
   [[nodiscard]] inline bool is_mapped() const noexcept
   {
-    return mmap_.is_mapped();
+    return in_memory_ || mmap_.is_mapped() || shared_.is_mapped();
+  }
+
+  /**
+   Applies the access hints to the mapping, see mio::access_hint, e.g. switching to
+   access_hint::random once the lines have been indexed.
+
+   \param a_hint The access hints.
+   \param error Set to describe the error if the hints cannot be applied.
+ */
+  void advise(const access_hint a_hint, std::error_code &error) noexcept
+  {
+    error.clear();
+    if (mmap_.is_mapped()) mmap_.advise(a_hint, error);
+    else if (shared_.is_mapped()) shared_.advise(a_hint, error);
+  }
+
+  /**
+   Asks the kernel to read in [a_offset, a_offset + a_length) of the file ahead of access.
+
+   \param a_offset Offset of the first byte to read in.
+   \param a_length Number of bytes to read in.
+   \param error Set to describe the error if the range cannot be prefetched.
+ */
+  void prefetch(const size_t a_offset, const size_t a_length, std::error_code &error) noexcept
+  {
+    error.clear();
+    if (mmap_.is_mapped()) mmap_.prefetch(a_offset, a_length, error);
+    else if (shared_.is_mapped()) shared_.prefetch(a_offset, a_length, error);
+  }
+
+  /**
+   Sets how far ahead of the scanning position the later reads ask the kernel to read in
+   the file, see prefetch, so that the page faults of a cold file are taken in the
+   background rather than by the scan; 0, the default, leaves it to the kernel read-ahead.
+   Each async worker reads ahead of its own position, and asks again for the next window
+   once it has gone through a quarter of the distance, at least read_ahead_step bytes.
+
+   A distance of a few MiB per worker, e.g. 8 MiB, covers the latency of the disk at the
+   scan rate of fast_find; reads from memory are not affected.
+
+   \param a_distance Number of bytes to read in ahead of the scanning position.
+ */
+  void set_read_ahead(const size_t a_distance) noexcept
+  {
+    read_ahead_ = a_distance;
+    read_ahead_covered_ = begin_;
+  }
+
+  /**
+   Smallest window read in at a time once set_read_ahead is set, to bound the rate of
+   system calls for short distances.
+ */
+  static constexpr size_t read_ahead_step = size_t{1} << 16;
+
+  /**
+   Returns the whole mapped content of the file, independent of the reading position.
+
+   \returns A view of the mapped file.
+ */
+  [[nodiscard]] std::string_view content() const noexcept
+  {
+    return content_;
+  }
+
+  /**
+   Returns a lazy view of the lines of the whole content, independent of the reading
+   position, see LineView. The lines are valid as long as the reader.
+
+   \returns A forward range of std::string_view.
+ */
+  [[nodiscard]] LineView lines() const noexcept
+  {
+    return LineView{content_};
   }
 
   /**
@@ -170,13 +487,15 @@ public:
   requires (L == LoadingMode::Synchronous)
   std::string_view getline() noexcept
   {
+    if (read_ahead_ != 0 && begin_ != nullptr) read_ahead(begin_, read_ahead_covered_);
+
     const char *b = begin_;
-    const char *find_pos = fast_find<'\n'>(b, mmap_.end());
+    const char *find_pos = fast_find<'\n'>(b, end_);
 
-    // find_pos == mmap_.end() happens only once at end of file. The majority of the
-    // processing will be for find_pos != mmap_.end(). Give this hint to the compiler
+    // find_pos == end_ happens only once at end of file. The majority of the
+    // processing will be for find_pos != end_. Give this hint to the compiler
     // for better branch prediction.
-    if (semi_branch_expect((find_pos != mmap_.end()), true))
+    if (semi_branch_expect((find_pos != end_), true))
       begin_ = std::next(find_pos);
     else
       begin_ = (b = nullptr), (find_pos = nullptr); // Set BOTH b AND find_pos nullptr if end of file.
@@ -190,30 +509,168 @@ public:
    *
    * Precondition - StringReader::is_mapped() must be true.
    *
+   * The callback is either a line handler (e.g. SyncGetlineCallback) fired once per line,
+   * or a batch handler (e.g. SyncGetlineBatchCallback) fired once per batch of lines. Any
+   * callable satisfying either concept is accepted, so it can be inlined without going
+   * through std::function.
+   *
    * @param a_callback - A callback for processing new lines read.
    * @return Total number of lines processed.
    */
-  template<typename = void>
-  requires (L == LoadingMode::Synchronous)
-  size_t getline(const SyncGetlineCallback &a_callback) noexcept
+  template<typename CallbackT>
+  requires (L == LoadingMode::Synchronous) and SyncGetlineHandler<CallbackT>
+  size_t getline(CallbackT &&a_callback) noexcept
   {
     auto line_count = size_t{0};
 
-    // Fall back to synchronous line by line processing.
-    while (!this->eof()) {
-      // If a non-zero status code is returned, break immediately.
-      if (semi_branch_expect((a_callback(this->getline()) == 0), true))
-        line_count++;
-      else
-        break;
+    if constexpr (SyncBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+
+      while (!this->eof()) {
+        auto n = size_t{0};
+        while (n < batch_size && !this->eof()) batch[n++] = this->getline();
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(std::span<const std::string_view>{batch.data(), n}) == 0), true))
+          line_count += n;
+        else
+          break;
+      }
+    } else {
+      // Fall back to synchronous line by line processing.
+      while (!this->eof()) {
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(this->getline()) == 0), true))
+          line_count++;
+        else
+          break;
+      }
     }
     return line_count;
   }
 
+  /**
+   Moves the reading position to the first line of a file sorted by key whose key is not less
+   than a_key, e.g. the first record of a time range, without a full scan. The search halves a
+   range of byte offsets, re-synchronizing each jump to the start of the next line, so that only
+   O(log n) pages of the mapping are touched before getline goes on sequentially from there.
+
+   Precondition - StringReader::is_mapped() must be true, and the lines must be sorted by the
+   keys a_key_extractor returns. This is not checked: on unsorted lines, the line found has a key
+   not less than a_key, and the line before it one that is less, but it need not be the first
+   such line.
+
+   \param a_key_extractor Returns the key of a line, excluding the terminating `\n`.
+   \param a_key The key to search for, comparable against the keys by `<`.
+
+   \returns Offset of the line found, which is that of the first greater key if a_key is absent,
+   or content().size() if every key is less than a_key, in which case the reader is at end of file.
+   */
+  template<typename KeyExtractorT, typename KeyT>
+  requires (L == LoadingMode::Synchronous) and std::is_invocable_v<const KeyExtractorT &, std::string_view>
+  size_t seek_lower_bound(const KeyExtractorT &a_key_extractor, const KeyT &a_key) noexcept
+  {
+    // Every line starting before lo has a key less than a_key, hi starts a line that has not.
+    const char *lo = content_.data();
+    const char *hi = end_;
+
+    while (lo < hi) {
+      const char *mid = lo + (hi - lo) / 2;
+      const char *resync = mid == lo ? hi : fast_find<'\n'>(mid - 1, hi);
+      // No line starts in [mid, hi), probe the line at lo instead.
+      const char *b = resync < hi && resync + 1 < hi ? std::next(resync) : lo;
+      const char *e = fast_find<'\n'>(b, end_);
+
+      if (a_key_extractor(std::string_view{b, static_cast<size_t>(e - b)}) < a_key)
+        lo = e == end_ ? end_ : std::next(e);
+      else
+        hi = b;
+    }
+
+    begin_ = lo == end_ ? nullptr : lo;
+    read_ahead_covered_ = lo;
+    return static_cast<size_t>(lo - content_.data());
+  }
+
+  /**
+   Sets a token through which another thread, e.g. a std::jthread or a std::stop_source,
+   cancels the async reads of this reader. Workers check it, and the status code returned
+   by the callbacks, once per StringReader::batch_size lines, so that all of them stop
+   shortly after a stop is requested, or a callback of any worker returns non-zero.
+
+   \param a_token The stop token, checked by every later async read.
+   */
+  template<typename = void>
+  requires (L == LoadingMode::Asynchronous)
+  void set_stop_token(std::stop_token a_token) noexcept
+  {
+    stop_token_ = std::move(a_token);
+  }
+
+  /**
+   Sets where the workers of the later async reads run, and where the pages they read in
+   first go, see NumaPlacement and NumaScope. With NumaPlacement::local, the workers of
+   consecutive partitions share a node, so that each node scans, and first touches, a
+   contiguous part of the file, and the buffers a callback allocates, and fills, are on its
+   node too, see worker_numa_node.
+
+   \param a_placement The placement, NumaPlacement::none by default.
+   */
+  template<typename = void>
+  requires (L == LoadingMode::Asynchronous)
+  void set_numa_placement(const NumaPlacement a_placement) noexcept
+  {
+    numa_placement_ = a_placement;
+  }
+
+  /**
+   Returns the NUMA node a worker of an async read of a_num_threads workers runs on with
+   NumaPlacement::local, e.g. to bind the output buffers of the worker to it through a
+   mmap_memory_resource, or any_numa_node with another placement.
+   */
+  template<typename = void>
+  requires (L == LoadingMode::Asynchronous)
+  [[nodiscard]] int worker_numa_node(const int a_worker_id, const size_t a_num_threads) const noexcept
+  {
+    if (numa_placement_ != NumaPlacement::local) return any_numa_node;
+    return numa_node_of(static_cast<size_t>(a_worker_id), std::max(a_num_threads, size_t{1}));
+  }
+
+  /**
+   Returns the first non-zero status code returned by a callback during the last async
+   read, which stopped all the workers, or 0 if none has.
+   */
+  template<typename = void>
+  requires (L == LoadingMode::Asynchronous)
+  [[nodiscard]] int status() const noexcept
+  {
+    return status_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   Returns the statistics of the last async read, see ReaderStats; empty unless built with
+   WXLIB_MIO_WITH_STATS defined.
+   */
+  template<typename = void>
+  requires (L == LoadingMode::Asynchronous)
+  [[nodiscard]] const ReaderStats &stats() const noexcept
+  {
+    return stats_;
+  }
+
   /**
    Reads a new line in the context of a worker thread and fires the callback
    to process the line just read.
 
+   The callback is either a line handler (e.g. AsyncGetlineCallback), or a batch
+   handler (e.g. AsyncGetlineBatchCallback). Any callable satisfying either concept
+   is accepted, so it can be inlined without going through std::function.
+
+   A numbered handler, see AsyncNumberedHandler, is also given the number of each line in
+   the whole text, e.g. for error reports or ordered joins. The lines of each partition are
+   counted first, in parallel, then numbered by their prefix sum; with a line index, see
+   index_lines(), the numbers are looked up instead, at no cost.
+
    Precondition - StringReader::is_mapped() must be true.
 
    \param a_callback A callback for processing each of the new line read.
@@ -221,81 +678,1009 @@ public:
 
    \returns Total number of lines read.
  */
-  template<uint8_t NumThreads>
-  requires (NumThreads >= 2) and (NumThreads <= 8) and (L == LoadingMode::Asynchronous)
-  size_t async_getline(const AsyncGetlineCallback &a_callback) noexcept
+  template<unsigned NumThreads, typename CallbackT>
+  requires (NumThreads >= 1) and (L == LoadingMode::Asynchronous) and (AsyncGetlineHandler<CallbackT> or AsyncNumberedHandler<CallbackT>)
+  size_t async_getline(const CallbackT &a_callback) noexcept
   {
-    // Spawn a couple of futures for async processing.
-    auto futures = std::vector<std::future<size_t>>{};
-    for (int i = 0; auto &p : make_partitions(NumThreads))
-      futures.emplace_back(std::async(async_getline_impl, i++, p.first, p.second, a_callback));
+    begin_read(NumThreads);
+    const auto partitions = make_partitions(NumThreads);
+    const auto first_lines = number_lines<CallbackT>(partitions);
+    partitioned();
 
-    // Collect the total number of lines read.
-    return std::accumulate(futures.begin(), futures.end(), size_t(0), [](size_t b, auto &&a) { return (a.get() + b); });
+    // Run the workers on the shared executor, one per partition.
+    return end_read(run_workers(NumThreads, [&](const int i) {
+      return async_getline_impl(i, partitions[i].first, partitions[i].second, first_lines[i], a_callback);
+    }));
   }
 
-private:
   /**
-   * A thread worker function for read lines. This is an internal function to be called by getline_async.
-   * @param a_thread_id - The thread ID.
-   * @param a_begin - The first_iter of the range
-   * @param a_end - The last_iter of the range
-   * @param a_callback - A getline event callback.
-   * @return Total number of lines processed.
-   */
-  static size_t async_getline_impl(uint8_t a_thread_id,
-                                   const char *a_begin,
-                                   const char *a_end,
-                                   const AsyncGetlineCallback &a_callback) noexcept
+   Same as async_getline<NumThreads>, but with the number of threads decided at runtime,
+   e.g. by mio::available_concurrency().
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_callback A callback for processing each of the new line read.
+   \param a_num_threads Number of threads for async processing, 0 treated as 1.
+
+   \returns Total number of lines read.
+ */
+  template<typename CallbackT>
+  requires (L == LoadingMode::Asynchronous) and (AsyncGetlineHandler<CallbackT> or AsyncNumberedHandler<CallbackT>)
+  size_t async_getline(const CallbackT &a_callback, const size_t a_num_threads) noexcept
   {
-    const char *b = a_begin;
-    const char *find_pos = fast_find<'\n'>(b, a_end);
-    auto counter = size_t{0};
+    begin_read(std::max(a_num_threads, size_t{1}));
+    const auto partitions = make_partitions(std::max(a_num_threads, size_t{1}));
+    const auto first_lines = number_lines<CallbackT>(partitions);
+    partitioned();
 
-    while (find_pos != a_end) {
-      // If a non-zero status code is returned, break immediately.
-      if (semi_branch_expect(a_callback(a_thread_id, {b, static_cast<size_t>(find_pos - b)}) == 0, true))
-        counter++;
-      else
-        break;
+    return end_read(run_workers(partitions.size(), [&](const int i) {
+      return async_getline_impl(i, partitions[i].first, partitions[i].second, first_lines[i], a_callback);
+    }));
+  }
 
-      b = std::next(find_pos);
-      find_pos = fast_find<'\n'>(b, a_end);
-    }
+  /**
+   Reads lines using a fixed pool of worker threads pulling newline-aligned chunks
+   from a shared queue, and fires the callback in the context of the worker thread.
 
-    return counter;
+   Unlike the equal-partition overload, the mapped memory is cut into many small
+   chunks of roughly `a_chunk_size` bytes. Each worker claims the next unprocessed
+   chunk as soon as it finishes the current one, so uneven line lengths or uneven
+   callback costs do not leave the other workers idle.
+
+   The callback is either a line handler (e.g. AsyncGetlineCallback), or a batch
+   handler (e.g. AsyncGetlineBatchCallback). Any callable satisfying either concept
+   is accepted, so it can be inlined without going through std::function. A numbered
+   handler is also given the number of each line, as with the equal-partition overload.
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_callback A callback for processing each of the new line read.
+   \param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+   \tparam NumThreads Number of worker threads.
+
+   \returns Total number of lines read.
+ */
+  template<unsigned NumThreads, typename CallbackT>
+  requires (NumThreads >= 1) and (L == LoadingMode::Asynchronous) and (AsyncGetlineHandler<CallbackT> or AsyncNumberedHandler<CallbackT>)
+  size_t async_getline(const CallbackT &a_callback, const size_t a_chunk_size) noexcept
+  {
+    begin_read(NumThreads);
+    const auto chunks = make_chunks(a_chunk_size);
+    const auto first_lines = number_lines<CallbackT>(chunks);
+    auto next_chunk = std::atomic<size_t>{0};
+    partitioned();
+
+    // Each worker keeps claiming chunks until the queue is drained.
+    return end_read(run_workers(NumThreads, [&](const int i) {
+      return async_getline_chunked_impl(i, chunks, first_lines, next_chunk, a_callback);
+    }));
   }
 
-  /*!
-   * Makes the specified number of partitions.
-   * @param a_count The number of partitions to make.
-   * @return
-   */
-  auto make_partitions(const uint8_t a_count) noexcept
+  /**
+   Same as the chunked async_getline<NumThreads>, but with the number of worker threads
+   decided at runtime, e.g. by mio::available_concurrency().
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_callback A callback for processing each of the new line read.
+   \param a_num_threads Number of worker threads, 0 treated as 1.
+   \param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+
+   \returns Total number of lines read.
+ */
+  template<typename CallbackT>
+  requires (L == LoadingMode::Asynchronous) and (AsyncGetlineHandler<CallbackT> or AsyncNumberedHandler<CallbackT>)
+  size_t async_getline(const CallbackT &a_callback, const size_t a_num_threads, const size_t a_chunk_size) noexcept
   {
-    using Partition = std::pair<const char *, const char *>;
+    begin_read(std::max(a_num_threads, size_t{1}));
+    const auto chunks = make_chunks(a_chunk_size);
+    const auto first_lines = number_lines<CallbackT>(chunks);
+    auto next_chunk = std::atomic<size_t>{0};
+    partitioned();
 
-    auto result = std::vector<Partition>{};
-    const auto part_size = mmap_.size() / a_count;
+    // Each worker keeps claiming chunks until the queue is drained.
+    return end_read(run_workers(std::max(a_num_threads, size_t{1}), [&](const int i) {
+      return async_getline_chunked_impl(i, chunks, first_lines, next_chunk, a_callback);
+    }));
+  }
 
-    const char *b = begin_;
-    const char *e = find_end<'\n'>(b, part_size);
+  /**
+   Reads lines as the equal-partition async_getline, each worker folding its lines into an
+   accumulator of its own, and returns the accumulators merged, e.g. counts, sums, or vectors
+   of parsed records, with no shared state on the per-line path.
 
-    for (uint8_t i = 0; i < a_count; i++) {
-      result.emplace_back<Partition>({b, e});
+   Each accumulator is a copy of a_init, made by its worker on its first line, so that its
+   allocations are local to the NUMA node of the worker, see set_numa_placement, and in a
+   cache line of its own. The accumulators are merged into the first one in the order of the
+   workers, i.e. of the partitions, so that the result does not depend on the timing.
 
-      if (i < a_count - 1) {
-        b = e;
-        e = (i == a_count - 2) ? mmap_.end() : find_end<'\n'>(b, part_size);
-      }
-    }
+   @code
+     auto counts = reader.async_getline_reduce(std::unordered_map<std::string_view, size_t>{},
+         [](auto &a_counts, const std::string_view a_line) { a_counts[a_line.substr(0, a_line.find(','))]++; },
+         [](auto &a_into, auto &&a_from) { for (const auto &[key, n]: a_from) a_into[key] += n; },
+         mio::available_concurrency());
+   @endcode
 
-    return result;
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_init The initial accumulator of each worker, the identity of a_merge.
+   \param a_per_line Folds a line into an accumulator, as a_per_line(Acc &, std::string_view),
+   returning void, or an int status code, non-zero to stop all the workers, see status().
+   \param a_merge Merges an accumulator into another, as a_merge(Acc &into, Acc &&from).
+   \param a_num_threads Number of threads for async processing, 0 treated as 1.
+
+   As with the callbacks of async_getline, a_per_line and the copies of a_init must not throw.
+
+   \returns The accumulators merged, or a_init if there is no line.
+ */
+  template<typename Acc, typename PerLineT, typename MergeT>
+  requires (L == LoadingMode::Asynchronous) and std::copy_constructible<Acc> and std::invocable<const PerLineT &, Acc &, const std::string_view>
+           and std::invocable<const MergeT &, Acc &, Acc &&>
+  Acc async_getline_reduce(const Acc &a_init, const PerLineT &a_per_line, const MergeT &a_merge, const size_t a_num_threads)
+  {
+    auto slots = std::vector<detail::ReduceSlot<Acc>>(std::max(a_num_threads, size_t{1}));
+    async_getline(reduce_callback(slots, a_init, a_per_line), a_num_threads);
+    return merge_slots(slots, a_init, a_merge);
+  }
+
+  /**
+   Same as async_getline_reduce, but with the chunked work queue of async_getline, the
+   accumulators merged in the order of the workers.
+
+   \param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+ */
+  template<typename Acc, typename PerLineT, typename MergeT>
+  requires (L == LoadingMode::Asynchronous) and std::copy_constructible<Acc> and std::invocable<const PerLineT &, Acc &, const std::string_view>
+           and std::invocable<const MergeT &, Acc &, Acc &&>
+  Acc async_getline_reduce(const Acc &a_init, const PerLineT &a_per_line, const MergeT &a_merge, const size_t a_num_threads, const size_t a_chunk_size)
+  {
+    auto slots = std::vector<detail::ReduceSlot<Acc>>(std::max(a_num_threads, size_t{1}));
+    async_getline(reduce_callback(slots, a_init, a_per_line), a_num_threads, a_chunk_size);
+    return merge_slots(slots, a_init, a_merge);
+  }
+
+  /**
+   Reads lines as the chunked async_getline, but with the output kept in file order, e.g. to
+   write a transformed copy of the file. Each chunk is transformed by a worker into a batch
+   of its own, calling a_transform(int thread_id, std::string_view line, BatchT &batch) for
+   each of its lines, and the batches are handed to a_sink(BatchT &batch) in the order of the
+   chunks, one at a time, by whichever worker completes the next one.
+
+   At most a_in_flight chunks are transformed or waiting for the sink at any time: a worker
+   claiming a chunk further ahead waits for the sink to catch up, so that the memory is
+   bounded by a_in_flight batches, reused from one chunk to another, cleared by their clear()
+   if any, or else reset.
+
+   @code
+     std::ofstream out("upper.txt", std::ios::binary);
+     reader.async_getline_ordered<std::string>(
+         [](int, std::string_view a_line, std::string &a_batch) {
+           std::ranges::transform(a_line, std::back_inserter(a_batch), [](char c) { return static_cast<char>(std::toupper(c)); });
+           a_batch.push_back('\n');
+           return 0;
+         },
+         [&out](std::string &a_batch) { return out.write(a_batch.data(), std::ssize(a_batch)) ? 0 : -1; },
+         mio::available_concurrency());
+   @endcode
+
+   If a non-zero status code is returned by either callback, all the workers stop, and no
+   later batch is handed to the sink, see status().
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \tparam BatchT The output of a chunk, default constructible and movable.
+   \param a_transform A callback transforming each line into the batch of its chunk.
+   \param a_sink A callback consuming each batch, in order, never called concurrently.
+   \param a_num_threads Number of worker threads, 0 treated as 1.
+   \param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+   \param a_in_flight Maximum number of chunks in flight, 0 treated as 2 per worker.
+
+   \returns Total number of lines whose batch was consumed by the sink.
+ */
+  template<typename BatchT, typename TransformT, typename SinkT>
+  requires (L == LoadingMode::Asynchronous) and std::default_initializable<BatchT> and std::movable<BatchT>
+      and std::is_invocable_r_v<int, const TransformT &, int, std::string_view, BatchT &> and std::is_invocable_r_v<int, SinkT &, BatchT &>
+  size_t async_getline_ordered(const TransformT &a_transform,
+                               SinkT &&a_sink,
+                               const size_t a_num_threads,
+                               const size_t a_chunk_size = default_chunk_size,
+                               const size_t a_in_flight = 0) noexcept
+  {
+    const auto num_threads = std::max(a_num_threads, size_t{1});
+    const auto in_flight = a_in_flight == 0 ? 2 * num_threads : a_in_flight;
+    begin_read(num_threads);
+    const auto chunks = make_chunks(a_chunk_size);
+    auto next_chunk = std::atomic<size_t>{0};
+    partitioned();
+
+    // The reorder buffer: chunk c goes to slot c % in_flight, released once all the chunks
+    // before it are, by a single worker at a time.
+    struct Slot
+    {
+      BatchT batch{};
+      size_t lines{0};
+      bool ready{false};
+    };
+
+    auto slots = std::vector<Slot>(in_flight);
+    auto mutex = std::mutex{};
+    auto released = std::condition_variable_any{};
+    auto next_release = size_t{0};
+    auto releasing = false;
+    auto sunk = size_t{0};
+
+    // Hands the ready batches to the sink in order, unless another worker already does.
+    auto release = [&](std::unique_lock<std::mutex> &a_lock) {
+      if (std::exchange(releasing, true)) return;
+      for (auto *slot = &slots[next_release % in_flight]; slot->ready && !stop_requested(); slot = &slots[next_release % in_flight]) {
+        a_lock.unlock();
+        const auto status = a_sink(slot->batch);
+        if constexpr (requires { slot->batch.clear(); })
+          slot->batch.clear();
+        else
+          slot->batch = BatchT{};
+        a_lock.lock();
+
+        if (semi_branch_expect(status == 0, true))
+          sunk += slot->lines;
+        else
+          fail(status);
+        slot->ready = false;
+        next_release++;
+        released.notify_all();
+      }
+      releasing = false;
+    };
+
+    run_workers(num_threads, [&](const int i) {
+      WXLIB_TRACE_SPAN("mio.async_getline_ordered");
+      auto probe = worker_probe(i);
+      for (auto c = next_chunk.fetch_add(1, std::memory_order_relaxed); c < chunks.size();
+           c = next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+        {
+          auto lock = std::unique_lock{mutex};
+          released.wait(lock, stop_token_, [&] { return c < next_release + in_flight || stop_requested(); });
+        }
+
+        auto &slot = slots[c % in_flight];
+        auto lines = size_t{0};
+        const auto transformed = getline_range(i, chunks[c].first, chunks[c].second, 0, [&](const int a_id, const std::string_view a_line) {
+          return a_transform(a_id, a_line, slot.batch);
+        }, lines, probe);
+
+        auto lock = std::unique_lock{mutex};
+        if (!transformed) {
+          // Wakes up the workers waiting for a slot, to stop too.
+          released.notify_all();
+          break;
+        }
+
+        slot.lines = lines;
+        slot.ready = true;
+        release(lock);
+      }
+      return size_t{0};
+    });
+
+    return end_read(sunk);
+  }
+
+  /**
+   Same work queue as the chunked async_getline, but fires the callback once per chunk,
+   with the whole chunk of consecutive lines, instead of once per line. Meant for bulk
+   consumers, such as csv parsers, that scan a block of lines at once.
+
+   The callback is invoked as a_callback(int thread_id, std::string_view block). If a
+   non-zero status code is returned, all the workers stop claiming chunks, see status().
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   If `a_quote_aware` is true, a chunk is never cut inside double quotes, so that lines
+   may contain `\n` enclosed in quotes, such as multi-line csv fields; see
+   make_quoted_chunks.
+
+   \tparam Quote The quote char, if quote aware.
+   \tparam Escape The char escaping a quote, if distinct from the quote, see make_quoted_chunks.
+   \param a_callback A callback for processing each block of lines.
+   \param a_num_threads Number of worker threads, 0 treated as 1.
+   \param a_chunk_size Approximate chunk size in bytes, extended to the next `\n`.
+   \param a_quote_aware Whether `\n` enclosed in double quotes does not end a line.
+
+   \returns Total number of blocks processed.
+ */
+  template<char Quote = '"', char Escape = Quote, typename CallbackT>
+  requires (L == LoadingMode::Asynchronous) and std::is_invocable_r_v<int, const CallbackT &, int, std::string_view>
+  size_t async_getblock(const CallbackT &a_callback, const size_t a_num_threads, const size_t a_chunk_size, const bool a_quote_aware = false) noexcept
+  {
+    begin_read(std::max(a_num_threads, size_t{1}));
+    const auto chunks = a_quote_aware ? make_quoted_chunks<Quote, Escape>(a_chunk_size, a_num_threads) : make_chunks(a_chunk_size);
+    auto next_chunk = std::atomic<size_t>{0};
+    partitioned();
+
+    return end_read(run_workers(std::max(a_num_threads, size_t{1}), [&](const int i) {
+      auto counter = size_t{0};
+      auto probe = worker_probe(i);
+      for (auto c = next_chunk.fetch_add(1, std::memory_order_relaxed); c < chunks.size() && !stop_requested();
+           c = next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+        const auto &[b, e] = chunks[c];
+        probe.begin_chunk(static_cast<size_t>(b - begin_), static_cast<size_t>(e - b));
+        const auto status = probe.call([&] { return a_callback(i, std::string_view{b, static_cast<size_t>(e - b)}); });
+        probe.end_chunk(0);
+
+        // If a non-zero status code is returned, stop all the workers.
+        if (semi_branch_expect(status == 0, true))
+          counter++;
+        else
+          return fail(status), counter;
+      }
+      return counter;
+    }));
+  }
+
+  /**
+   Default chunk size used by the chunked async_getline, 8 MiB.
+   */
+  static constexpr size_t default_chunk_size = size_t{8} << 20;
+
+  /**
+   Opts in to indexed access by scanning the mapped file once and recording the
+   position of every line. Afterwards, line(), line_count() and async_getline_range()
+   access lines without scanning the file again.
+
+   The index is independent of the getline/async_getline reading position.
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_encoding How the line offsets are stored, e.g. LineIndex::Encoding::EliasFano
+   for files of billions of lines, see LineIndex::Encoding.
+   \param a_num_threads Number of threads building an Elias-Fano index.
+
+   \returns The line index.
+ */
+  const LineIndex &index_lines(LineIndex::Encoding a_encoding = LineIndex::Encoding::Offsets,
+                               size_t a_num_threads = available_concurrency())
+  {
+    index_.build(content_.data(), end_, a_encoding, a_num_threads);
+    indexed_ = true;
+    return index_;
+  }
+
+  /**
+   Same as index_lines(), but backed by a persistent sidecar index file, so that other
+   readers of the same file can skip the scan.
+
+   If the sidecar exists and is still valid for the file, i.e. both the size and the last
+   write time of the file match the ones recorded in the sidecar, it is memory mapped and
+   no scan takes place. Otherwise the file is scanned, and the sidecar is (re)written.
+   A reader of memory or of a shared mapping has no file to check a sidecar against, so
+   its text is scanned, and error is set to std::errc::not_supported.
+
+   Precondition - StringReader::is_mapped() must be true.
+
+   \param a_sidecar The sidecar index file, e.g. StringReader::default_sidecar(file).
+   \param error Set to describe the error if the sidecar cannot be written. The index
+   is usable regardless.
+   \param a_encoding How the line offsets are stored; a sidecar of another encoding is
+   rewritten.
+   \param a_num_threads Number of threads building an Elias-Fano index.
+
+   \returns The line index.
+ */
+  const LineIndex &index_lines(const std::string &a_sidecar, std::error_code &error,
+                               LineIndex::Encoding a_encoding = LineIndex::Encoding::Offsets,
+                               size_t a_num_threads = available_concurrency())
+  {
+    if (file_.empty()) {
+      // Nothing to validate a sidecar against without a file.
+      index_.build(content_.data(), end_, a_encoding, a_num_threads);
+      error = std::make_error_code(std::errc::not_supported);
+      indexed_ = true;
+      return index_;
+    }
+
+    index_.load(a_sidecar, file_, content_.data(), end_, error, a_encoding);
+    if (error) {
+      index_.build(content_.data(), end_, a_encoding, a_num_threads);
+      index_.save(a_sidecar, file_, error);
+    }
+
+    indexed_ = true;
+    return index_;
+  }
+
+  /**
+   Returns the conventional sidecar index file name for a file, i.e. the file name with
+   `.lidx` appended.
+   */
+  [[nodiscard]] static std::string default_sidecar(const std::string &a_file)
+  {
+    return a_file + ".lidx";
+  }
+
+  /**
+   Checks whether index_lines() has been called.
+   */
+  [[nodiscard]] bool is_indexed() const noexcept
+  {
+    return indexed_;
+  }
+
+  /**
+   Returns the line index, empty if index_lines() has not been called.
+   */
+  [[nodiscard]] const LineIndex &line_index() const noexcept
+  {
+    return index_;
+  }
+
+  /**
+   Returns the total number of lines in the file.
+
+   Precondition - StringReader::is_indexed() must be true.
+   */
+  [[nodiscard]] size_t line_count() const noexcept
+  {
+    return index_.line_count();
+  }
+
+  /**
+   Returns the i-th line (zero-based) of the file in O(1), excluding the terminating `\n`.
+
+   Precondition - StringReader::is_indexed() must be true, and i < line_count().
+   */
+  [[nodiscard]] std::string_view line(const size_t i) const noexcept
+  {
+    return index_.line(i);
+  }
+
+  /**
+   Draws a uniform random sample of lines, with replacement, independent of the reading
+   position, e.g. for model calibration over a file too large to scan for each sample.
+
+   With a line index, i.e. StringReader::is_indexed() is true, each line is drawn by its number
+   in O(1). Without one, a random byte is drawn and re-synchronized to the line it is in, which
+   picks the lines in proportion to their size; each line is then kept with probability
+   a_min_line_size / size, so that all the lines are equally likely, at the cost of redrawing
+   the rejected ones. The positions are drawn StringReader::batch_size at a time, and their
+   pages prefetched, so that the page faults of a batch overlap.
+
+   \param a_count Number of lines to draw.
+   \param a_gen A uniform random bit generator, e.g. std::mt19937_64.
+   \param a_min_line_size A lower bound on the size of the lines, including the terminating
+   `\n`, used by the byte sampling when the file is not indexed; 0 treated as 1. The larger the
+   fewer lines are rejected, but lines shorter than this bound are under-sampled.
+
+   \returns The lines drawn, excluding the terminating `\n`, empty if the file is.
+   */
+  template<typename URBG>
+  std::vector<std::string_view> sample_lines(const size_t a_count, URBG &&a_gen, const size_t a_min_line_size = 1)
+  {
+    auto samples = std::vector<std::string_view>{};
+    if (content_.empty()) return samples;
+    samples.reserve(a_count);
+
+    const auto min_size = std::max(a_min_line_size, size_t{1});
+    auto draw = std::uniform_int_distribution<size_t>{0, (indexed_ ? index_.line_count() : content_.size()) - 1};
+    auto offsets = std::array<size_t, batch_size>{};
+    std::error_code error; // Prefetching is only a hint.
+
+    while (samples.size() < a_count) {
+      for (auto &offset: offsets) {
+        offset = draw(a_gen);
+        prefetch(indexed_ ? static_cast<size_t>(index_.line(offset).data() - content_.data()) : offset, 1, error);
+      }
+
+      for (const auto offset: offsets) {
+        if (samples.size() == a_count) break;
+
+        if (indexed_) {
+          samples.push_back(index_.line(offset));
+          continue;
+        }
+
+        const char *b = find_end<'\n'>(content_.data(), offset);
+        const char *e = fast_find<'\n'>(content_.data() + offset, end_);
+        const auto size = static_cast<size_t>(e - b) + (e != end_);
+        if (size <= min_size || std::uniform_int_distribution<size_t>{1, size}(a_gen) <= min_size)
+          samples.emplace_back(b, static_cast<size_t>(e - b));
+      }
+    }
+
+    return samples;
+  }
+
+  /**
+   Splits the lines [a_first, a_last) of the file evenly across worker threads, and fires
+   the callback in the context of the worker thread for each line, or each batch of lines.
+
+   Precondition - StringReader::is_indexed() must be true.
+
+   \param a_callback A callback for processing each of the new line read.
+   \param a_first The first line (zero-based) to read.
+   \param a_last One past the last line to read, capped at line_count().
+   \param a_num_threads Number of threads for async processing, 0 treated as 1.
+
+   \returns Total number of lines read.
+ */
+  template<typename CallbackT>
+  requires AsyncGetlineHandler<CallbackT> or AsyncNumberedHandler<CallbackT>
+  size_t async_getline_range(const CallbackT &a_callback, const size_t a_first, const size_t a_last, const size_t a_num_threads) const noexcept
+  {
+    return index_.async_for_each(a_first, a_last, a_num_threads, a_callback);
+  }
+
+private:
+  using Partition = std::pair<const char *, const char *>;
+
+  /**
+   * The line callback of async_getline_reduce, folding each line into the accumulator of its
+   * worker, made on its first line.
+   */
+  template<typename Acc, typename PerLineT>
+  static auto reduce_callback(std::vector<detail::ReduceSlot<Acc>> &a_slots, const Acc &a_init, const PerLineT &a_per_line) noexcept
+  {
+    return [&a_slots, &a_init, &a_per_line](const int a_thread_id, const std::string_view a_line) -> int {
+      auto &acc = a_slots[static_cast<size_t>(a_thread_id)].acc;
+      if (semi_branch_expect(!acc.has_value(), false)) acc.emplace(a_init);
+      if constexpr (std::is_void_v<std::invoke_result_t<const PerLineT &, Acc &, const std::string_view>>) {
+        a_per_line(*acc, a_line);
+        return 0;
+      } else {
+        return static_cast<int>(a_per_line(*acc, a_line));
+      }
+    };
+  }
+
+  template<typename Acc, typename MergeT>
+  static Acc merge_slots(std::vector<detail::ReduceSlot<Acc>> &a_slots, const Acc &a_init, const MergeT &a_merge)
+  {
+    auto first = std::ranges::find_if(a_slots, [](const auto &a_slot) { return a_slot.acc.has_value(); });
+    if (first == a_slots.end()) return a_init;
+
+    auto result = std::move(*first->acc);
+    for (auto it = std::next(first); it != a_slots.end(); ++it)
+      if (it->acc) a_merge(result, std::move(*it->acc));
+    return result;
+  }
+
+  /**
+   * Runs a_worker(i) for each of the a_count workers concurrently, on the shared executor, see
+   * Executor::run_workers, and collects the total number of lines read.
+   */
+  template<typename F>
+  size_t run_workers(const size_t a_count, const F &a_worker) noexcept
+  {
+    auto counts = std::vector<size_t>(a_count);
+    Executor::shared().run_workers(a_count, [&](const size_t i) {
+      const auto placed = NumaScope{numa_placement_, i, a_count};
+      counts[i] = a_worker(static_cast<int>(i));
+    });
+    return std::accumulate(counts.begin(), counts.end(), size_t{0});
+  }
+
+  /**
+   * A thread worker function for read lines. This is an internal function to be called by getline_async.
+   * @param a_thread_id - The thread ID.
+   * @param a_begin - The first_iter of the range
+   * @param a_end - The last_iter of the range
+   * @param a_first_line - The number of the first line of the range, see number_lines.
+   * @param a_callback - A getline event callback.
+   * @return Total number of lines processed.
+   */
+  template<typename CallbackT>
+  size_t async_getline_impl(int a_thread_id,
+                            const char *a_begin,
+                            const char *a_end,
+                            const size_t a_first_line,
+                            const CallbackT &a_callback) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.async_getline");
+    auto counter = size_t{0};
+    auto probe = worker_probe(a_thread_id);
+    getline_range(a_thread_id, a_begin, a_end, a_first_line, a_callback, counter, probe);
+    return counter;
+  }
+
+  /**
+   * A thread worker function for the chunked async_getline. Claims chunks from the shared
+   * queue until it is drained, or until the workers are stopped.
+   * @param a_thread_id - The thread ID.
+   * @param a_chunks - The newline-aligned chunks shared by all workers.
+   * @param a_first_lines - The number of the first line of each chunk, see number_lines.
+   * @param a_next_chunk - Index of the next unclaimed chunk.
+   * @param a_callback - A getline event callback.
+   * @return Total number of lines processed.
+   */
+  template<typename CallbackT>
+  size_t async_getline_chunked_impl(int a_thread_id,
+                                    const std::vector<Partition> &a_chunks,
+                                    const std::vector<size_t> &a_first_lines,
+                                    std::atomic<size_t> &a_next_chunk,
+                                    const CallbackT &a_callback) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.async_getline");
+    auto counter = size_t{0};
+    auto probe = worker_probe(a_thread_id);
+
+    for (auto i = a_next_chunk.fetch_add(1, std::memory_order_relaxed); i < a_chunks.size();
+         i = a_next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+      if (!getline_range(a_thread_id, a_chunks[i].first, a_chunks[i].second, a_first_lines[i], a_callback, counter, probe))
+        break;
+    }
+
+    return counter;
+  }
+
+  /**
+   * Fires the callback for every `\n` terminated line in [a_begin, a_end), either line
+   * by line, or batch by batch if the callback is a batch handler. The workers are checked
+   * for a stop once per batch, or once per StringReader::batch_size lines.
+   * @param a_first_line - The number of the first line, given to a numbered handler.
+   * @param a_counter - Incremented for each line processed successfully.
+   * @param a_probe - Records the range, and the time spent in the callback, see with_stats.
+   * @return False if the workers are stopped, true otherwise.
+   */
+  template<typename CallbackT>
+  bool getline_range(int a_thread_id,
+                     const char *a_begin,
+                     const char *a_end,
+                     const size_t a_first_line,
+                     const CallbackT &a_callback,
+                     size_t &a_counter,
+                     detail::stats_probe &a_probe) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.getline_range");
+    a_probe.begin_chunk(static_cast<size_t>(a_begin - begin_), static_cast<size_t>(a_end - a_begin));
+    const auto first = a_counter;
+    const auto result = getline_range_impl(a_thread_id, a_begin, a_end, a_first_line, a_callback, a_counter, a_probe);
+    a_probe.end_chunk(a_counter - first);
+    return result;
+  }
+
+  template<typename CallbackT>
+  bool getline_range_impl(int a_thread_id,
+                          const char *a_begin,
+                          const char *a_end,
+                          size_t a_line,
+                          const CallbackT &a_callback,
+                          size_t &a_counter,
+                          detail::stats_probe &a_probe) noexcept
+  {
+    if (stop_requested()) return false;
+
+    auto covered = a_begin;
+    read_ahead(a_begin, covered);
+
+    const char *b = a_begin;
+    const char *find_pos = fast_find<'\n'>(b, a_end);
+
+    if constexpr (AsyncBatchHandler<CallbackT> || AsyncNumberedBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+      auto n = size_t{0};
+
+      while (find_pos != a_end) {
+        batch[n++] = {b, static_cast<size_t>(find_pos - b)};
+        b = std::next(find_pos);
+        find_pos = fast_find<'\n'>(b, a_end);
+
+        // Flush the batch when it is full, or the range is exhausted.
+        if (n == batch_size || find_pos == a_end) {
+          // If a non-zero status code is returned, stop all the workers.
+          const auto lines = std::span<const std::string_view>{batch.data(), n};
+          if (const auto status = a_probe.call([&] { return invoke(a_callback, a_thread_id, a_line, lines); }); semi_branch_expect(status == 0, true))
+            a_line += n, a_counter += std::exchange(n, 0);
+          else
+            return fail(status), false;
+
+          if (stop_requested()) return false;
+          read_ahead(b, covered);
+        }
+      }
+    } else {
+      for (auto unchecked = batch_size; find_pos != a_end; ) {
+        // If a non-zero status code is returned, stop all the workers.
+        const auto line = std::string_view{b, static_cast<size_t>(find_pos - b)};
+        if (const auto status = a_probe.call([&] { return invoke(a_callback, a_thread_id, a_line++, line); }); semi_branch_expect(status == 0, true))
+          a_counter++;
+        else
+          return fail(status), false;
+
+        if (--unchecked == 0) {
+          if (stop_requested()) return false;
+          read_ahead(find_pos, covered);
+          unchecked = batch_size;
+        }
+
+        b = std::next(find_pos);
+        find_pos = fast_find<'\n'>(b, a_end);
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Calls a line or batch handler, with the number of the line, or of the first line of the
+   * batch, if numbered.
+   */
+  template<typename CallbackT, typename LinesT>
+  static int invoke(const CallbackT &a_callback, const int a_thread_id, [[maybe_unused]] const size_t a_line, const LinesT &a_lines) noexcept
+  {
+    if constexpr (AsyncNumberedHandler<CallbackT>)
+      return a_callback(a_thread_id, a_line, a_lines);
+    else
+      return a_callback(a_thread_id, a_lines);
+  }
+
+  /**
+   * The number of the first line of each range, for a numbered handler, see
+   * AsyncNumberedHandler; all 0 otherwise. The ranges are consecutive, from the start of the
+   * text on, each ending past a `\n`, but the last. With a line index, the numbers are looked
+   * up; without, the `\n` of each range are counted in parallel, then summed up.
+   */
+  template<typename CallbackT>
+  std::vector<size_t> number_lines(const std::vector<Partition> &a_ranges) const
+  {
+    WXLIB_TRACE_SPAN("mio.number_lines");
+    auto result = std::vector<size_t>(a_ranges.size());
+    if constexpr (AsyncNumberedHandler<CallbackT>) {
+      if (indexed_) {
+        for (size_t i = 0; i < a_ranges.size(); i++) result[i] = line_number_at(a_ranges[i].first);
+        return result;
+      }
+
+      auto counts = std::vector<size_t>(a_ranges.size());
+      Executor::shared().parallel_for(0, counts.size(), [&](const size_t a_first, const size_t a_last) {
+        for (auto i = a_first; i < a_last; i++) counts[i] = fast_count<'\n'>(a_ranges[i].first, a_ranges[i].second);
+      }, 1);
+      std::exclusive_scan(counts.begin(), counts.end(), result.begin(), size_t{0});
+    }
+    return result;
+  }
+
+  /**
+   * The number of the line starting at a_pos, by the line index.
+   */
+  [[nodiscard]] size_t line_number_at(const char *a_pos) const noexcept
+  {
+    auto lo = size_t{0}, hi = index_.line_count();
+    while (lo < hi) {
+      const auto mid = lo + (hi - lo) / 2;
+      if (index_.line(mid).data() < a_pos)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  /**
+   * Asks the kernel to read in up to read_ahead_ bytes, plus a step, ahead of a_pos, once
+   * a_pos is within read_ahead_ bytes of a_covered, the end of the range read in so far,
+   * which is moved past the new window. Does nothing without set_read_ahead.
+   */
+  void read_ahead(const char *a_pos, const char *&a_covered) noexcept
+  {
+    if (read_ahead_ == 0 || a_covered == end_) return;
+    if (a_covered > a_pos && static_cast<size_t>(a_covered - a_pos) > read_ahead_) return;
+
+    const char *from = std::max(a_covered, a_pos);
+    a_covered = std::next(a_pos, static_cast<std::ptrdiff_t>(std::min(static_cast<size_t>(end_ - a_pos), read_ahead_ + std::max(read_ahead_ / 4, read_ahead_step))));
+
+    std::error_code ignored;
+    prefetch(static_cast<size_t>(from - content_.data()), static_cast<size_t>(a_covered - from), ignored);
+  }
+
+  /**
+   * Starts an async read with the given number of workers, resetting the status code, and
+   * the stats if with_stats.
+   */
+  void begin_read(const size_t a_num_workers) noexcept
+  {
+    status_.store(0, std::memory_order_relaxed);
+    if constexpr (with_stats) {
+      stats_ = ReaderStats{};
+      stats_.workers.resize(a_num_workers);
+      stats_.start = std::chrono::steady_clock::now();
+    }
+  }
+
+  /**
+   * Makes the probe recording the stats of a worker, see with_stats.
+   */
+  detail::stats_probe worker_probe([[maybe_unused]] const int a_thread_id) noexcept
+  {
+    if constexpr (with_stats)
+      return detail::stats_probe{stats_.workers[static_cast<size_t>(a_thread_id)]};
+    else
+      return detail::stats_probe{};
+  }
+
+  /**
+   * Marks the end of the partitioning, once the workers are about to start.
+   */
+  void partitioned() noexcept
+  {
+    if constexpr (with_stats) stats_.partition_time = std::chrono::steady_clock::now() - stats_.start;
+  }
+
+  /**
+   * Ends an async read, once all the workers are done.
+   * @param a_result - The result of the read, passed through.
+   */
+  size_t end_read(const size_t a_result) noexcept
+  {
+    WXLIB_TRACE_COUNTER("mio.async_read", a_result);
+    if constexpr (with_stats) {
+      stats_.end = std::chrono::steady_clock::now();
+      for (auto &w: stats_.workers)
+        if (w.start != std::chrono::steady_clock::time_point{}) w.wait_time = (w.start - stats_.start - stats_.partition_time) + (stats_.end - w.end);
+    }
+    return a_result;
+  }
+
+  /**
+   * Checks whether the async read in progress is to stop, because a callback returned a
+   * non-zero status code, or a stop has been requested through the stop token.
+   */
+  [[nodiscard]] bool stop_requested() const noexcept
+  {
+    return status_.load(std::memory_order_relaxed) != 0 || stop_token_.stop_requested();
+  }
+
+  /**
+   * Records the status code returned by a callback, unless another one came first, which
+   * stops all the workers.
+   */
+  void fail(const int a_status) noexcept
+  {
+    auto expected = 0;
+    status_.compare_exchange_strong(expected, a_status, std::memory_order_relaxed);
+  }
+
+  /*!
+   * Makes the specified number of partitions.
+   * @param a_count The number of partitions to make.
+   * @return
+   */
+  auto make_partitions(const size_t a_count) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.make_partitions");
+    auto result = std::vector<Partition>{};
+    const auto part_size = content_.size() / a_count;
+
+    // The last partition always extends to the end of the mapping.
+    const char *b = begin_;
+    for (size_t i = 0; i < a_count; i++) {
+      const char *e = (i == a_count - 1) ? end_ : find_end<'\n'>(b, part_size);
+      result.emplace_back<Partition>({b, e});
+      b = e;
+    }
+
+    return result;
+  }
+
+  /*!
+   * Cuts the mapped memory into newline-aligned chunks. Each chunk spans at least
+   * `a_chunk_size` bytes and is extended to just past the next `\n`, except the last one.
+   * @param a_chunk_size The approximate chunk size in bytes.
+   * @return
+   */
+  auto make_chunks(const size_t a_chunk_size) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.make_chunks");
+    auto result = std::vector<Partition>{};
+    const auto chunk_size = std::max(a_chunk_size, size_t{1});
+
+    for (const char *b = begin_, *e = nullptr; b < end_; b = e) {
+      if (static_cast<size_t>(end_ - b) > chunk_size) {
+        e = fast_find<'\n'>(std::next(b, static_cast<std::ptrdiff_t>(chunk_size)), end_);
+        e = (e == end_) ? e : std::next(e);
+      } else {
+        e = end_;
+      }
+      result.emplace_back<Partition>({b, e});
+    }
+
+    return result;
+  }
+
+  /*!
+   * Same as make_chunks, except that a chunk is never cut inside double quotes. Escaped
+   * quotes `""` need no special handling, since they close and reopen the quoted section.
+   *
+   * Two passes: first, the number of quotes in each chunk of `a_chunk_size` bytes is
+   * counted in parallel, and the parity of the quotes before each nominal cut tells whether
+   * the cut is inside quotes; then, each cut is moved to just past the next `\n` outside of
+   * quotes. Both passes are exact, so no speculation has to be undone.
+   *
+   * With an escape char distinct from the quote, e.g. `\\`, a quote preceded by an odd run of
+   * escape chars is escaped, and not counted.
+   * @tparam Quote The quote char.
+   * @tparam Escape The escape char of a quote.
+   * @param a_chunk_size The approximate chunk size in bytes.
+   * @param a_num_threads Number of threads counting the quotes.
+   * @return
+   */
+  template<char Quote = '"', char Escape = Quote>
+  auto make_quoted_chunks(const size_t a_chunk_size, const size_t a_num_threads) noexcept
+  {
+    WXLIB_TRACE_SPAN("mio.make_quoted_chunks");
+    auto escaped = [this](const char *a_quote) {
+      if constexpr (Escape == Quote) {
+        return false;
+      } else {
+        auto run = size_t{0};
+        for (const char *p = a_quote; p != begin_ && *std::prev(p) == Escape; --p) run++;
+        return (run & 1) != 0;
+      }
+    };
+
+    const auto chunk_size = std::max(a_chunk_size, size_t{1});
+    const auto size = static_cast<size_t>(end_ - begin_);
+    const auto count = (size + chunk_size - 1) / chunk_size;
+    auto nominal = [&](size_t i) { return std::next(begin_, static_cast<std::ptrdiff_t>(std::min(i * chunk_size, size))); };
+
+    // First pass, the parity of the quotes in each nominal chunk.
+    auto parity = std::vector<uint8_t>(count, 0);
+    const auto num_threads = std::clamp(a_num_threads, size_t{1}, std::max(count, size_t{1}));
+    Executor::shared().run_workers(num_threads, [&](const size_t t) {
+      for (auto i = t; i < count; i += num_threads) {
+        auto quotes = size_t{0};
+        fast_find_each<Quote>(nominal(i), nominal(i + 1), [&](const char *a_pos) { quotes += !escaped(a_pos); });
+        parity[i] = static_cast<uint8_t>(quotes & 1);
+      }
+    });
+
+    // Second pass, moves each cut to just past the next `\n` outside of quotes.
+    auto result = std::vector<Partition>{};
+    auto quoted = false;
+    const char *b = begin_;
+    for (size_t i = 1; i < count; i++) {
+      quoted ^= parity[i - 1] != 0;
+      if (nominal(i) < b) continue;
+
+      auto in_quotes = quoted;
+      auto found = fast_find_any<Quote, '\n'>(nominal(i), end_);
+      for (; found.pos != end_ && (found.match == Quote || in_quotes); found = fast_find_any<Quote, '\n'>(std::next(found.pos), end_))
+        in_quotes ^= found.match == Quote && !escaped(found.pos);
+
+      if (found.pos == end_) break;
+      result.emplace_back<Partition>({b, std::next(found.pos)});
+      b = std::next(found.pos);
+    }
+
+    if (b != end_) result.emplace_back<Partition>({b, end_});
+    return result;
+  }
+
+private:
+  /**
+     Points the reading position at the start of the text read.
+   */
+  void set_content(const std::string_view a_content) noexcept
+  {
+    content_ = a_content;
+    begin_ = content_.data();
+    end_ = content_.data() + content_.size();
+    read_ahead_covered_ = begin_;
   }
 
-private:
   mmap_source mmap_;
+  shared_mmap_source shared_;
+  bool in_memory_{false};
+  std::string_view content_;
+  const char *end_{nullptr};
+  std::string file_;
   const char *begin_;
+  LineIndex index_;
+  bool indexed_{false};
+  size_t read_ahead_{0};
+  const char *read_ahead_covered_{nullptr};
+  std::atomic<int> status_{0};
+  std::stop_token stop_token_;
+  NumaPlacement numa_placement_{NumaPlacement::none};
+  ReaderStats stats_;
 };
 
 using StringReaderAsync = StringReader<LoadingMode::Asynchronous>;
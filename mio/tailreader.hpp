@@ -0,0 +1,359 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_TAIL_READER_HPP
+#define WXLIB_MIO_TAIL_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace mio {
+
+/**
+   A line reader following a file that another process keeps appending to, such as a live
+   feed or a log, in the manner of `tail -f`. Each read maps only the bytes appended since
+   the previous one, from the first incomplete line on, and hands the complete lines to the
+   callback; a trailing line not terminated by `\n` yet is held back until it is.
+
+   Between reads, follow() sleeps until the file changes, woken by inotify on Linux, or by a
+   change notification on the directory of the file on Windows, so new lines are handed over
+   as soon as they are written, without polling. Elsewhere, or if the notification cannot be
+   set up, e.g. when out of inotify watches, the file is checked every `poll_interval`.
+
+   The reader follows the file it opened, not its path: a file that shrinks, e.g. truncated
+   by a copy-and-truncate log rotation, is read again from the start, but a file renamed away
+   and replaced by a new one keeps being followed under its new name.
+
+   @code
+     mio::TailingStringReader reader("probes.csv", true);
+     std::jthread consumer([&] {
+       reader.follow([](std::string_view a_line) {
+         // ... do something about the line just appended.
+         return 0; // 0 for success, non-zero to stop following. Must not throw exception.
+       });
+     });
+     // ... later, from any thread.
+     reader.stop();
+   @endcode
+ */
+class TailingStringReader
+{
+public:
+  /**
+     Maximum number of lines handed to a batch callback at a time.
+   */
+  static constexpr size_t batch_size = LineIndex::batch_size;
+
+  /**
+     Interval at which the file is checked for new lines when change notifications are not
+     available.
+   */
+  static constexpr std::chrono::milliseconds poll_interval{100};
+
+  /**
+     Constructs a reader to follow a disk file. If the specified file does not exist,
+     std::system_error will be thrown with error code describing the nature of the error.
+
+     \param   a_file  The file to follow. It must exist.
+     \param   a_from_end  Whether to skip the content of the file when opened, and only
+                          read the lines appended afterwards.
+   */
+  explicit TailingStringReader(const std::string &a_file, const bool a_from_end = false)
+  {
+    std::error_code error;
+    handle_ = detail::open_file(a_file, access_mode::read, error);
+    if (!error && a_from_end) offset_ = detail::query_file_size(handle_, error);
+    if (!error) watch(a_file, error);
+
+    if (error) {
+      close();
+      throw std::system_error(error);
+    }
+  }
+
+  TailingStringReader(const TailingStringReader &) = delete;
+  TailingStringReader(TailingStringReader &&) = delete;
+  TailingStringReader &operator=(TailingStringReader &) = delete;
+  TailingStringReader &operator=(TailingStringReader &&) = delete;
+
+  ~TailingStringReader()
+  {
+    close();
+  }
+
+  /**
+     Returns the error that stopped the reader, if any, e.g. failing to map the new bytes.
+   */
+  [[nodiscard]] std::error_code error() const noexcept
+  {
+    return error_;
+  }
+
+  /**
+     Returns the offset in the file of the next line to read.
+   */
+  [[nodiscard]] uint64_t offset() const noexcept
+  {
+    return offset_;
+  }
+
+  /**
+     Checks whether the reader is woken by change notifications, rather than polling.
+   */
+  [[nodiscard]] bool is_notified() const noexcept
+  {
+    return notify_ != invalid_handle;
+  }
+
+  /**
+     Makes follow() return as soon as the lines being read are handed over, and any later
+     call to follow() return immediately. Can be called from any thread.
+   */
+  void stop() noexcept
+  {
+    stopped_ = true;
+#ifdef __linux__
+    const uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+#elif defined(_WIN32)
+    ::SetEvent(wake_);
+#else
+    { std::scoped_lock lock{mutex_}; }
+    wake_cv_.notify_all();
+#endif
+  }
+
+  /**
+     Reads the complete lines appended since the previous read, if any, without waiting,
+     and fires the callback to process them.
+
+     The callback is either a line handler (e.g. StringReader::SyncGetlineCallback) fired
+     once per line, or a batch handler (e.g. StringReader::SyncGetlineBatchCallback) fired
+     once per batch of lines. A line for which the callback returns a non-zero status code
+     is read again by the next read.
+
+     \param a_callback A callback for processing new lines read.
+     \returns Total number of lines processed, stopping at the first non-zero status code.
+   */
+  template<typename CallbackT>
+  requires SyncGetlineHandler<CallbackT>
+  size_t getline(CallbackT &&a_callback) noexcept
+  {
+    auto line_count = size_t{0};
+    read_appended(a_callback, line_count);
+    return line_count;
+  }
+
+  /**
+     Reads the lines of the file as they are appended, sleeping until the file changes
+     whenever all the complete lines have been read, until stop() is called, the callback
+     returns a non-zero status code, or no new line arrives for `a_idle_timeout`.
+
+     \param a_callback A callback for processing new lines read, see getline().
+     \param a_idle_timeout How long to wait for a new line before returning, forever by default.
+     \returns Total number of lines processed.
+   */
+  template<typename CallbackT>
+  requires SyncGetlineHandler<CallbackT>
+  size_t follow(CallbackT &&a_callback, const std::chrono::milliseconds a_idle_timeout = std::chrono::milliseconds::max()) noexcept
+  {
+    using clock = std::chrono::steady_clock;
+    const auto forever = a_idle_timeout == std::chrono::milliseconds::max();
+
+    auto line_count = size_t{0};
+    auto idle_since = clock::now();
+    while (!stopped_) {
+      const auto before = line_count;
+      if (!read_appended(a_callback, line_count) || error_) break;
+
+      const auto now = clock::now();
+      if (line_count != before) idle_since = now;
+
+      auto remaining = std::chrono::milliseconds{-1};
+      if (!forever) {
+        remaining = a_idle_timeout - std::chrono::duration_cast<std::chrono::milliseconds>(now - idle_since);
+        if (remaining <= std::chrono::milliseconds{0}) break;
+      }
+      wait(remaining);
+    }
+
+    return line_count;
+  }
+
+private:
+  /**
+     Maps the bytes appended since the previous read, and hands their complete lines over.
+     \return False if the callback returned a non-zero status code, true otherwise.
+   */
+  template<typename CallbackT>
+  bool read_appended(CallbackT &a_callback, size_t &a_line_count) noexcept
+  {
+    if (error_) return true;
+
+    const auto file_size = detail::query_file_size(handle_, error_);
+    if (error_) return true;
+
+    // The file shrank, most likely truncated by a log rotation, so it is read from the start.
+    if (file_size < offset_) offset_ = 0;
+    if (file_size == offset_) return true;
+
+    mmap_.map(handle_, static_cast<size_t>(offset_), static_cast<size_t>(file_size - offset_), access_hint::sequential, error_);
+    if (error_) return true;
+
+    const char *begin = mmap_.data();
+    const char *end = std::next(begin, static_cast<std::ptrdiff_t>(mmap_.size()));
+    const char *cur = begin;
+    auto ok = true;
+
+    if constexpr (SyncBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+      const char *find_pos = fast_find<'\n'>(cur, end);
+      const char *next = cur;
+
+      while (find_pos != end) {
+        auto n = size_t{0};
+        for (; n < batch_size && find_pos != end; find_pos = fast_find<'\n'>(next, end)) {
+          batch[n++] = {next, static_cast<size_t>(find_pos - next)};
+          next = std::next(find_pos);
+        }
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(std::span<const std::string_view>{batch.data(), n}) == 0), true)) {
+          a_line_count += n;
+          cur = next;
+        } else {
+          ok = false;
+          break;
+        }
+      }
+    } else {
+      for (const char *find_pos = fast_find<'\n'>(cur, end); find_pos != end; find_pos = fast_find<'\n'>(cur, end)) {
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(std::string_view{cur, static_cast<size_t>(find_pos - cur)}) == 0), true)) {
+          a_line_count++;
+          cur = std::next(find_pos);
+        } else {
+          ok = false;
+          break;
+        }
+      }
+    }
+
+    offset_ += static_cast<uint64_t>(cur - begin);
+    mmap_.unmap();
+    return ok;
+  }
+
+  /**
+     Sets up the change notification of the file, leaving notify_ invalid if unavailable, and
+     the event stop() wakes wait() with.
+   */
+  void watch([[maybe_unused]] const std::string &a_file, std::error_code &error) noexcept
+  {
+#ifdef __linux__
+    wake_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_ < 0) {
+      error = std::error_code(errno, std::system_category());
+      return;
+    }
+
+    notify_ = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (notify_ >= 0 && ::inotify_add_watch(notify_, a_file.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE) < 0) {
+      ::close(notify_);
+      notify_ = invalid_handle;
+    }
+#elif defined(_WIN32)
+    wake_ = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (wake_ == nullptr) {
+      wake_ = invalid_handle;
+      error = detail::last_error();
+      return;
+    }
+
+    // Directory change notifications are the finest grained ones that need no overlapped
+    // handle of its own; any change in the directory wakes the reader to check the file.
+    auto directory = std::filesystem::absolute(std::filesystem::path{a_file}).parent_path();
+    notify_ = ::FindFirstChangeNotificationW(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+#endif
+  }
+
+  /**
+     Sleeps until the file changes, stop() is called, or `a_timeout` elapses, negative
+     meaning forever.
+   */
+  void wait(std::chrono::milliseconds a_timeout) noexcept
+  {
+    if (!is_notified() && (a_timeout.count() < 0 || a_timeout > poll_interval)) a_timeout = poll_interval;
+
+#ifdef __linux__
+    auto fds = std::array<pollfd, 2>{pollfd{wake_, POLLIN, 0}, pollfd{notify_, POLLIN, 0}};
+    const auto timeout = static_cast<int>(std::min<std::chrono::milliseconds::rep>(a_timeout.count(), INT_MAX));
+    if (::poll(fds.data(), is_notified() ? 2 : 1, timeout) > 0 && is_notified()) {
+      // Drains the events, the file is checked as a whole anyway.
+      alignas(inotify_event) std::array<char, 4096> events;
+      while (::read(notify_, events.data(), events.size()) > 0) {}
+    }
+#elif defined(_WIN32)
+    const auto handles = std::array<HANDLE, 2>{wake_, notify_};
+    const auto timeout = a_timeout.count() < 0 ? INFINITE : static_cast<DWORD>(std::min<std::chrono::milliseconds::rep>(a_timeout.count(), INFINITE - 1));
+    if (::WaitForMultipleObjects(is_notified() ? 2 : 1, handles.data(), FALSE, timeout) == WAIT_OBJECT_0 + 1)
+      ::FindNextChangeNotification(notify_);
+#else
+    std::unique_lock lock{mutex_};
+    wake_cv_.wait_for(lock, a_timeout, [this] { return stopped_.load(); });
+#endif
+  }
+
+  void close() noexcept
+  {
+    mmap_.unmap();
+#ifdef _WIN32
+    if (notify_ != invalid_handle) ::FindCloseChangeNotification(notify_);
+    if (wake_ != invalid_handle) ::CloseHandle(wake_);
+    if (handle_ != invalid_handle) ::CloseHandle(handle_);
+#else
+    if (notify_ != invalid_handle) ::close(notify_);
+    if (wake_ != invalid_handle) ::close(wake_);
+    if (handle_ != invalid_handle) ::close(handle_);
+#endif
+    handle_ = notify_ = wake_ = invalid_handle;
+  }
+
+  file_handle_type handle_{invalid_handle};
+  file_handle_type notify_{invalid_handle};
+  file_handle_type wake_{invalid_handle};
+  uint64_t offset_{0};
+  mmap_source mmap_;
+  std::atomic<bool> stopped_{false};
+#if !defined(__linux__) && !defined(_WIN32)
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+#endif
+  std::error_code error_;
+};
+
+}
+#endif
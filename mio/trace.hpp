@@ -0,0 +1,284 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_TRACE_HPP
+#define WXLIB_MIO_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+   Tracing of the hot paths of wxlib, the async reads and partitioning of mio, csv parsing,
+   msgpack packing and unpacking, and mapping and syncing files. Defining WXLIB_WITH_TRACE
+   turns the recording on; otherwise the macros below expand to nothing, and do not evaluate
+   their arguments.
+
+   WXLIB_TRACE_SPAN(name) records the time from it to the end of the enclosing scope,
+   WXLIB_TRACE_COUNTER(name, value) a value of a counter, and WXLIB_TRACE_INSTANT(name) a
+   point in time. Names must be string literals, or otherwise outlive the trace.
+
+   Each thread records its events into a ring buffer of its own, with no lock nor atomic
+   read-modify-write, keeping the latest ring_capacity events. write_chrome_trace() writes the
+   events of all threads, those that have exited included, as a Chrome trace, which Perfetto
+   (ui.perfetto.dev) opens as is. It must not race with the threads being traced, so call it
+   while they are idle, e.g. between reads.
+
+   @code
+     size_t parse(std::string_view a_block)
+     {
+       WXLIB_TRACE_SPAN("app.parse");
+       ...
+       WXLIB_TRACE_COUNTER("app.records", records);
+     }
+
+     std::ofstream out("trace.json");
+     mio::trace::write_chrome_trace(out);
+   @endcode
+ */
+#ifdef WXLIB_WITH_TRACE
+#define WXLIB_TRACE_CONCAT_IMPL(a, b) a##b
+#define WXLIB_TRACE_CONCAT(a, b) WXLIB_TRACE_CONCAT_IMPL(a, b)
+#define WXLIB_TRACE_SPAN(name) const ::mio::trace::Span WXLIB_TRACE_CONCAT(wxlib_trace_span_, __LINE__){name}
+#define WXLIB_TRACE_COUNTER(name, value) ::mio::trace::counter(name, static_cast<int64_t>(value))
+#define WXLIB_TRACE_INSTANT(name) ::mio::trace::instant(name)
+#else
+#define WXLIB_TRACE_SPAN(name) static_cast<void>(0)
+#define WXLIB_TRACE_COUNTER(name, value) static_cast<void>(0)
+#define WXLIB_TRACE_INSTANT(name) static_cast<void>(0)
+#endif
+
+namespace mio::trace {
+
+#ifdef WXLIB_WITH_TRACE
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+/**
+   Number of events each thread keeps, the older ones being overwritten.
+ */
+inline constexpr size_t ring_capacity = size_t{1} << 16;
+
+enum class EventKind : uint8_t
+{
+  Span,
+  Counter,
+  Instant
+};
+
+struct Event
+{
+  const char *name{nullptr};
+  // Nanoseconds since the first event of the process.
+  uint64_t start{0};
+  uint64_t duration{0};
+  int64_t value{0};
+  EventKind kind{EventKind::Span};
+};
+
+/**
+   The events of one thread. Only that thread pushes, so a push is a store of the event and a
+   release store of the head; readers see the events before the head they acquire.
+ */
+class Ring
+{
+public:
+  explicit Ring(const uint32_t a_thread_id) : thread_id_{a_thread_id}, events_(ring_capacity)
+  {
+  }
+
+  void push(const Event &a_event) noexcept
+  {
+    const auto head = head_.load(std::memory_order_relaxed);
+    events_[head & (ring_capacity - 1)] = a_event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  template<typename F>
+  void for_each(const F &a_on_event) const
+  {
+    const auto head = head_.load(std::memory_order_acquire);
+    for (auto i = head > ring_capacity ? head - ring_capacity : 0; i < head; i++)
+      a_on_event(events_[i & (ring_capacity - 1)]);
+  }
+
+  /**
+     Number of events overwritten before they were written out.
+   */
+  [[nodiscard]] uint64_t dropped() const noexcept
+  {
+    const auto head = head_.load(std::memory_order_acquire);
+    return head > ring_capacity ? head - ring_capacity : 0;
+  }
+
+  void clear() noexcept
+  {
+    head_.store(0, std::memory_order_release);
+  }
+
+  [[nodiscard]] uint32_t thread_id() const noexcept
+  {
+    return thread_id_;
+  }
+
+private:
+  uint32_t thread_id_;
+  std::atomic<uint64_t> head_{0};
+  std::vector<Event> events_;
+};
+
+namespace detail {
+
+inline std::chrono::steady_clock::time_point epoch() noexcept
+{
+  static const auto start = std::chrono::steady_clock::now();
+  return start;
+}
+
+inline uint64_t now() noexcept
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch()).count());
+}
+
+/**
+   The rings of all threads that have traced, kept for the life of the process so that the
+   events of exited threads can still be written out.
+ */
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  static Registry &instance()
+  {
+    static Registry registry;
+    return registry;
+  }
+};
+
+/**
+   The ring of the calling thread, registered on its first event.
+ */
+inline Ring &local_ring()
+{
+  thread_local Ring *ring = [] {
+    epoch();
+    auto &registry = Registry::instance();
+    const auto lock = std::lock_guard{registry.mutex};
+    registry.rings.push_back(std::make_unique<Ring>(static_cast<uint32_t>(registry.rings.size() + 1)));
+    return registry.rings.back().get();
+  }();
+  return *ring;
+}
+
+}
+
+/**
+   Records the time from its construction to its destruction, see WXLIB_TRACE_SPAN.
+ */
+class Span
+{
+public:
+  explicit Span(const char *a_name) noexcept : name_{a_name}, start_{detail::now()}
+  {
+  }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+  ~Span()
+  {
+    const auto end = detail::now();
+    detail::local_ring().push({name_, start_, end - start_, 0, EventKind::Span});
+  }
+
+private:
+  const char *name_;
+  uint64_t start_;
+};
+
+inline void counter(const char *a_name, const int64_t a_value)
+{
+  detail::local_ring().push({a_name, detail::now(), 0, a_value, EventKind::Counter});
+}
+
+inline void instant(const char *a_name)
+{
+  detail::local_ring().push({a_name, detail::now(), 0, 0, EventKind::Instant});
+}
+
+/**
+   Calls a_on_event(thread_id, event) for each event recorded, thread by thread.
+ */
+template<typename F>
+void for_each_event(const F &a_on_event)
+{
+  auto &registry = detail::Registry::instance();
+  const auto lock = std::lock_guard{registry.mutex};
+  for (const auto &ring: registry.rings)
+    ring->for_each([&](const Event &a_event) { a_on_event(ring->thread_id(), a_event); });
+}
+
+/**
+   Number of events overwritten in all rings, before they were written out.
+ */
+inline uint64_t dropped()
+{
+  auto &registry = detail::Registry::instance();
+  const auto lock = std::lock_guard{registry.mutex};
+  auto result = uint64_t{0};
+  for (const auto &ring: registry.rings) result += ring->dropped();
+  return result;
+}
+
+/**
+   Discards the events recorded so far, e.g. after writing them out.
+ */
+inline void clear()
+{
+  auto &registry = detail::Registry::instance();
+  const auto lock = std::lock_guard{registry.mutex};
+  for (const auto &ring: registry.rings) ring->clear();
+}
+
+/**
+   Writes the events recorded as a Chrome trace (chrome://tracing, or Perfetto), with a track
+   per thread for its spans and instants, and a track per counter.
+
+   \param a_out The stream to write the JSON trace to.
+ */
+inline void write_chrome_trace(std::ostream &a_out)
+{
+  auto us = [](const uint64_t a_ns) { return static_cast<double>(a_ns) / 1000.0; };
+  auto threads = std::vector<uint32_t>{};
+  auto separator = "\n";
+
+  a_out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+  for_each_event([&](const uint32_t a_thread, const Event &a_event) {
+    if (threads.empty() || threads.back() != a_thread) {
+      threads.push_back(a_thread);
+      a_out << separator << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << a_thread << R"(,"args":{"name":"thread )" << a_thread << R"("}})";
+      separator = ",\n";
+    }
+
+    a_out << separator << R"({"name":")" << a_event.name << R"(","pid":1,"tid":)" << a_thread << R"(,"ts":)" << us(a_event.start);
+    switch (a_event.kind) {
+    case EventKind::Span: a_out << R"(,"ph":"X","dur":)" << us(a_event.duration) << "}"; break;
+    case EventKind::Counter: a_out << R"(,"ph":"C","args":{"value":)" << a_event.value << "}}"; break;
+    case EventKind::Instant: a_out << R"(,"ph":"i","s":"t"})"; break;
+    }
+    separator = ",\n";
+  });
+  a_out << "\n]}\n";
+}
+
+}
+#endif
@@ -0,0 +1,220 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_UTF8_HPP
+#define WXLIB_MIO_UTF8_HPP
+
+#include <mio/fastfind.hpp>
+
+#include <cstdint>
+#include <string_view>
+
+namespace mio {
+
+/*!
+ * The UTF-8 byte order mark.
+ */
+inline constexpr std::string_view utf8_bom{"\xEF\xBB\xBF"};
+
+/*!
+ * @return a_text without its leading byte order mark, if any.
+ */
+inline std::string_view skip_utf8_bom(std::string_view a_text) noexcept
+{
+    if (a_text.starts_with(utf8_bom)) a_text.remove_prefix(utf8_bom.size());
+    return a_text;
+}
+
+/*!
+ * Finds the invalid UTF-8 sequences starting in [a_begin, a_stop) one byte at a time, reading
+ * up to a_end for the sequences crossing a_stop. Overlong encodings, surrogates and code
+ * points past U+10FFFF are invalid. Each maximal invalid subpart of a sequence, e.g. a lead
+ * byte missing its continuation bytes, or a stray continuation byte, is reported once.
+ * @param a_begin Precondition - must be the start of a sequence.
+ * @param a_stop
+ * @param a_end
+ * @param a_on_error Handler invoked as a_on_error(const char *pos) for each invalid sequence.
+ */
+template<typename F>
+void scalar_utf8_errors(const char *a_begin, const char *a_stop, const char *a_end, F &&a_on_error)
+{
+    const auto *p = reinterpret_cast<const unsigned char *>(a_begin);
+    const auto *stop = reinterpret_cast<const unsigned char *>(a_stop);
+    const auto *end = reinterpret_cast<const unsigned char *>(a_end);
+
+    while (p < stop) {
+        const unsigned c = *p;
+        if (c < 0x80) {
+            p++;
+            continue;
+        }
+
+        auto n = 0;
+        unsigned lo = 0x80, hi = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 2;
+            if (c == 0xE0) lo = 0xA0;
+            if (c == 0xED) hi = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 3;
+            if (c == 0xF0) lo = 0x90;
+            if (c == 0xF4) hi = 0x8F;
+        } else {
+            a_on_error(reinterpret_cast<const char *>(p++));
+            continue;
+        }
+
+        auto i = 1;
+        for (; i <= n && p + i < end && p[i] >= lo && p[i] <= hi; i++) lo = 0x80, hi = 0xBF;
+
+        if (i <= n) a_on_error(reinterpret_cast<const char *>(p));
+        p += i;
+    }
+}
+
+/*!
+ * @return The start of the sequence a_pos may be in the middle of, looking back at most 3
+ * bytes, and not before a_begin.
+ */
+inline const char *utf8_sequence_start(const char *a_begin, const char *a_pos) noexcept
+{
+    const char *p = a_pos - std::min<std::ptrdiff_t>(a_pos - a_begin, 3);
+    while (p != a_pos && (static_cast<unsigned char>(*p) & 0xC0) == 0x80) p++;
+    return p;
+}
+
+#ifdef WXLIB_MIO_X86
+
+/*!
+ * What a block validated by avx2_utf8_check carries over to the next one.
+ */
+struct Avx2Utf8State
+{
+    __m256i prev;       // the last 32 bytes
+    __m256i incomplete; // non zero if they end in the middle of a sequence
+};
+
+WXLIB_MIO_TARGET("avx2") inline Avx2Utf8State avx2_utf8_init() noexcept
+{
+    return {_mm256_setzero_si256(), _mm256_setzero_si256()};
+}
+
+/*!
+ * Looks up a table of 16 bytes by the nibbles of the index.
+ */
+WXLIB_MIO_TARGET("avx2") inline __m256i avx2_lookup16(__m256i a_index, __m256i a_table) noexcept
+{
+    return _mm256_shuffle_epi8(a_table, a_index);
+}
+
+/*!
+ * The bytes preceding each byte of a_input by N, the first of which are taken from a_prev.
+ */
+template<int N>
+WXLIB_MIO_TARGET("avx2") inline __m256i avx2_prev(__m256i a_input, __m256i a_prev) noexcept
+{
+    return _mm256_alignr_epi8(a_input, _mm256_permute2x128_si256(a_prev, a_input, 0x21), 16 - N);
+}
+
+/*!
+ * Validates 32 bytes following a_prev by the lookup algorithm of Keiser and Lemire, as in
+ * simdutf: three table lookups, by the high and low nibbles of each byte and by the high
+ * nibble of the next, classify every pair of consecutive bytes, and the third and fourth
+ * bytes of the longer sequences are checked by a saturating subtraction.
+ * @return Non zero bytes around the invalid sequences, if any.
+ */
+WXLIB_MIO_TARGET("avx2") inline __m256i avx2_utf8_errors(__m256i a_input, __m256i a_prev) noexcept
+{
+    constexpr uint8_t too_short = 1 << 0;  // 11______ 0_______, 11______ 11______
+    constexpr uint8_t too_long = 1 << 1;   // 0_______ 10______
+    constexpr uint8_t overlong_3 = 1 << 2; // 11100000 100_____
+    constexpr uint8_t too_large = 1 << 3;  // 11110100 1001____, 11110100 101_____, 11110101+ 1001____ ...
+    constexpr uint8_t surrogate = 1 << 4;  // 11101101 101_____
+    constexpr uint8_t overlong_2 = 1 << 5; // 1100000_ 10______
+    constexpr uint8_t too_large_1000 = 1 << 6; // 11110101+ 1000____
+    constexpr uint8_t overlong_4 = 1 << 6; // 11110000 1000____
+    constexpr uint8_t two_conts = 1 << 7;  // 10______ 10______
+    constexpr uint8_t carry = too_short | too_long | two_conts;
+
+    const auto nibble = _mm256_set1_epi8(0x0F);
+    const auto prev1 = avx2_prev<1>(a_input, a_prev);
+
+    const auto byte_1_high = avx2_lookup16(_mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble), _mm256_setr_epi8(
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2, too_short, too_short | overlong_3 | surrogate, static_cast<char>(too_short | too_large | too_large_1000 | overlong_4),
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2, too_short, too_short | overlong_3 | surrogate, static_cast<char>(too_short | too_large | too_large_1000 | overlong_4)));
+
+    const auto byte_1_low = avx2_lookup16(_mm256_and_si256(prev1, nibble), _mm256_setr_epi8(
+        static_cast<char>(carry | overlong_3 | overlong_2 | overlong_4), static_cast<char>(carry | overlong_2), static_cast<char>(carry), static_cast<char>(carry),
+        static_cast<char>(carry | too_large), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000),
+        static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000),
+        static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000 | surrogate), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000),
+        static_cast<char>(carry | overlong_3 | overlong_2 | overlong_4), static_cast<char>(carry | overlong_2), static_cast<char>(carry), static_cast<char>(carry),
+        static_cast<char>(carry | too_large), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000),
+        static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000),
+        static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000 | surrogate), static_cast<char>(carry | too_large | too_large_1000), static_cast<char>(carry | too_large | too_large_1000)));
+
+    const auto byte_2_high = avx2_lookup16(_mm256_and_si256(_mm256_srli_epi16(a_input, 4), nibble), _mm256_setr_epi8(
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        static_cast<char>(too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4),
+        static_cast<char>(too_long | overlong_2 | two_conts | overlong_3 | too_large),
+        static_cast<char>(too_long | overlong_2 | two_conts | surrogate | too_large),
+        static_cast<char>(too_long | overlong_2 | two_conts | surrogate | too_large),
+        too_short, too_short, too_short, too_short,
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        static_cast<char>(too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4),
+        static_cast<char>(too_long | overlong_2 | two_conts | overlong_3 | too_large),
+        static_cast<char>(too_long | overlong_2 | two_conts | surrogate | too_large),
+        static_cast<char>(too_long | overlong_2 | two_conts | surrogate | too_large),
+        too_short, too_short, too_short, too_short));
+
+    const auto special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // The third and fourth bytes of the 3 and 4 byte sequences must be continuations.
+    const auto is_third_byte = _mm256_subs_epu8(avx2_prev<2>(a_input, a_prev), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const auto is_fourth_byte = _mm256_subs_epu8(avx2_prev<3>(a_input, a_prev), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const auto must_be_continuation = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+/*!
+ * Non zero if the 32 bytes end in the middle of a sequence.
+ */
+WXLIB_MIO_TARGET("avx2") inline __m256i avx2_utf8_incomplete(__m256i a_input) noexcept
+{
+    const auto max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(a_input, max);
+}
+
+/*!
+ * Validates a block of 64 bytes following the blocks already validated with a_state.
+ * @return true if the block, or a sequence started by a previous block, is invalid.
+ */
+WXLIB_MIO_TARGET("avx2") inline bool avx2_utf8_check(__m256i a_lo, __m256i a_hi, Avx2Utf8State &a_state) noexcept
+{
+    if (_mm256_movemask_epi8(_mm256_or_si256(a_lo, a_hi)) == 0) {
+        const bool error = !_mm256_testz_si256(a_state.incomplete, a_state.incomplete);
+        a_state = avx2_utf8_init();
+        return error;
+    }
+
+    const auto error = _mm256_or_si256(avx2_utf8_errors(a_lo, a_state.prev), avx2_utf8_errors(a_hi, a_lo));
+    a_state.prev = a_hi;
+    a_state.incomplete = avx2_utf8_incomplete(a_hi);
+    return !_mm256_testz_si256(error, error);
+}
+
+#endif
+
+}
+#endif
@@ -0,0 +1,283 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_WINDOW_READER_HPP
+#define WXLIB_MIO_WINDOW_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/fastfind.hpp>
+#include <mio/stringreader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace mio {
+
+/**
+   A line reader that maps only a fixed size window of the file at a time, and slides
+   the window forward as lines are read, so that the memory used stays bounded by the
+   window size, independent of the file size. Meant for files larger than the address
+   space, or than the memory budget of the process, e.g. in memory capped containers.
+
+   Each window starts at the beginning of a line (mapped from the page boundary before
+   it), so a line crossing the end of a window is read whole from the next window. A
+   line longer than the window makes the window grow until the line fits. The previous
+   window is unmapped as soon as the next one is mapped, and windows are mapped with
+   access_hint::sequential for kernel read-ahead.
+
+   Every line is read, including the last one if not terminated by `\n`, excluding the
+   terminating `\n`. Lines are only valid until the window slides, i.e., until the next
+   call to getline().
+
+   @code
+     mio::WindowedStringReader reader("trace.csv", 64 << 20);
+     if (reader.is_mapped()) {
+       while (!reader.eof()) {
+         auto line = reader.getline();
+         // ... do something about the line just read.
+       }
+     }
+   @endcode
+ */
+class WindowedStringReader
+{
+public:
+  /**
+     Default window size, 64 MiB.
+   */
+  static constexpr size_t default_window_size = size_t{64} << 20;
+
+  /**
+     Maximum number of lines handed to a batch callback at a time.
+   */
+  static constexpr size_t batch_size = LineIndex::batch_size;
+
+  /**
+     Constructs a reader to read from a disk file line by line, through a sliding window.
+     If the specified file does not exist, std::system_error will be thrown with error code
+     describing the nature of the error.
+
+     \param   a_file  The file to read. It must exist.
+     \param   a_window_size  Size in bytes of the window, rounded up to the page size.
+   */
+  explicit WindowedStringReader(const std::string &a_file, const size_t a_window_size = default_window_size)
+      : window_size_{std::max(make_offset_page_aligned(a_window_size + page_size() - 1), page_size())}
+  {
+    std::error_code error;
+    handle_ = detail::open_file(a_file, access_mode::read, error);
+    if (!error) file_size_ = detail::query_file_size(handle_, error);
+    if (!error && file_size_ > 0) slide(0, window_size_, error);
+
+    if (error) {
+      close();
+      throw std::system_error(error);
+    }
+  }
+
+  WindowedStringReader(const WindowedStringReader &) = delete;
+  WindowedStringReader(WindowedStringReader &&) = delete;
+  WindowedStringReader &operator=(WindowedStringReader &) = delete;
+  WindowedStringReader &operator=(WindowedStringReader &&) = delete;
+
+  ~WindowedStringReader()
+  {
+    close();
+  }
+
+  /**
+     Checks whether the reader has opened the file, and no error has occurred while sliding
+     the window.
+   */
+  [[nodiscard]] bool is_mapped() const noexcept
+  {
+    return handle_ != invalid_handle && !error_;
+  }
+
+  /**
+     Checks whether the reader has reached end of file, or stopped on an error.
+   */
+  [[nodiscard]] bool eof() const noexcept
+  {
+    return error_ || (cur_ == end_ && window_end() == file_size_);
+  }
+
+  /**
+     Returns the error that stopped the reader, if any, e.g. failing to map the next window.
+   */
+  [[nodiscard]] std::error_code error() const noexcept
+  {
+    return error_;
+  }
+
+  /**
+     Returns the offset in the file of the next line to read.
+   */
+  [[nodiscard]] uint64_t offset() const noexcept
+  {
+    return window_offset_ + static_cast<uint64_t>(cur_ - mmap_.data());
+  }
+
+  /**
+     Returns the size in bytes of the current window, which only exceeds the requested
+     window size if a line did not fit.
+   */
+  [[nodiscard]] size_t window_size() const noexcept
+  {
+    return window_size_;
+  }
+
+  /**
+     Returns a new line that has been read from the file as string view, valid until the next
+     call to getline().
+
+     \returns A std::string_view, {nullptr, 0} will be returned if the reader has reached end of file.
+   */
+  std::string_view getline() noexcept
+  {
+    auto line = std::string_view{};
+    while (!eof()) {
+      if (next_in_window(line)) return line;
+      slide_to_current();
+    }
+    return {};
+  }
+
+  /**
+     Sequentially reads the lines from the file and fires the callback to process them.
+
+     The callback is either a line handler (e.g. StringReader::SyncGetlineCallback) fired
+     once per line, or a batch handler (e.g. StringReader::SyncGetlineBatchCallback) fired
+     once per batch of lines. A batch never spans two windows, so its lines stay valid for
+     the duration of the call.
+
+     \param a_callback A callback for processing new lines read.
+     \returns Total number of lines processed, stopping at the first non-zero status code.
+   */
+  template<typename CallbackT>
+  requires SyncGetlineHandler<CallbackT>
+  size_t getline(CallbackT &&a_callback) noexcept
+  {
+    auto line_count = size_t{0};
+
+    if constexpr (SyncBatchHandler<CallbackT>) {
+      auto batch = std::array<std::string_view, batch_size>{};
+
+      while (!eof()) {
+        auto n = size_t{0};
+        while (n < batch_size && next_in_window(batch[n])) n++;
+
+        if (n > 0) {
+          // If a non-zero status code is returned, break immediately.
+          if (semi_branch_expect((a_callback(std::span<const std::string_view>{batch.data(), n}) == 0), true))
+            line_count += n;
+          else
+            break;
+        }
+
+        // The batch is flushed before the window slides.
+        if (n < batch_size) slide_to_current();
+      }
+    } else {
+      while (!eof()) {
+        auto line = getline();
+        if (line.data() == nullptr) break;
+
+        // If a non-zero status code is returned, break immediately.
+        if (semi_branch_expect((a_callback(line) == 0), true))
+          line_count++;
+        else
+          break;
+      }
+    }
+
+    return line_count;
+  }
+
+private:
+  [[nodiscard]] uint64_t window_end() const noexcept
+  {
+    return window_offset_ + mmap_.size();
+  }
+
+  /**
+     Reads the next line if it ends within the current window.
+   */
+  bool next_in_window(std::string_view &a_line) noexcept
+  {
+    if (cur_ == end_) return false;
+
+    const char *find_pos = fast_find<'\n'>(cur_, end_);
+    if (semi_branch_expect((find_pos != end_), true)) {
+      a_line = {cur_, static_cast<size_t>(find_pos - cur_)};
+      cur_ = std::next(find_pos);
+      return true;
+    }
+
+    // The last line of the file may not be terminated by `\n`.
+    if (window_end() == file_size_) {
+      a_line = {cur_, static_cast<size_t>(end_ - cur_)};
+      cur_ = end_;
+      return true;
+    }
+
+    return false;
+  }
+
+  /**
+     Slides the window to start at the next line to read. If the window does not move, the line
+     is longer than the window, so the window doubles.
+   */
+  void slide_to_current() noexcept
+  {
+    const auto next = offset();
+    if (next == file_size_) return;
+
+    const auto size = (next == window_offset_) ? window_size_ * 2 : window_size_;
+    slide(next, size, error_);
+  }
+
+  void slide(const uint64_t a_offset, const size_t a_size, std::error_code &error) noexcept
+  {
+    const auto length = static_cast<size_t>(std::min<uint64_t>(a_size, file_size_ - a_offset));
+    mmap_.map(handle_, static_cast<size_t>(a_offset), length, access_hint::sequential, error);
+    if (error) return;
+
+    window_offset_ = a_offset;
+    window_size_ = std::max(window_size_, a_size);
+    cur_ = mmap_.data();
+    end_ = std::next(cur_, static_cast<std::ptrdiff_t>(mmap_.size()));
+  }
+
+  void close() noexcept
+  {
+    mmap_.unmap();
+    if (handle_ != invalid_handle) {
+#ifdef _WIN32
+      ::CloseHandle(handle_);
+#else
+      ::close(handle_);
+#endif
+    }
+    handle_ = invalid_handle;
+    cur_ = end_ = nullptr;
+  }
+
+  file_handle_type handle_{invalid_handle};
+  uint64_t file_size_{0};
+  uint64_t window_offset_{0};
+  size_t window_size_;
+  mmap_source mmap_;
+  const char *cur_{nullptr};
+  const char *end_{nullptr};
+  std::error_code error_;
+};
+
+}
+#endif
@@ -0,0 +1,386 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MIO_WKT_HPP
+#define WXLIB_MIO_WKT_HPP
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mio::csv {
+
+/*!
+ * @return Whether the 8 bytes, loaded little endian, are all decimal digits.
+ */
+inline bool is_eight_digits(uint64_t a_chars) noexcept
+{
+    return ((a_chars & 0xF0F0F0F0F0F0F0F0) | (((a_chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+/*!
+ * Converts 8 decimal digits, loaded little endian, to their value, in three multiplications
+ * instead of eight, in the manner of fast_float.
+ */
+inline uint32_t parse_eight_digits(uint64_t a_chars) noexcept
+{
+    constexpr uint64_t mask = 0x000000FF000000FF;
+    constexpr uint64_t mul1 = 0x000F424000000064; // 100 + (1000000 << 32)
+    constexpr uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+    a_chars -= 0x3030303030303030;
+    a_chars = (a_chars * 10) + (a_chars >> 8);
+    return static_cast<uint32_t>((((a_chars & mask) * mul1) + (((a_chars >> 16) & mask) * mul2)) >> 32);
+}
+
+/*!
+ * Parses a decimal floating point number, e.g. `-83.0451`, `1e-3`. The digits are consumed 8
+ * at a time when possible; a number of at most 19 significant digits, whose value is exactly
+ * representable by a double scaled by an exact power of ten, the common case of coordinates,
+ * is converted with a single multiplication or division, which is correctly rounded. Any other
+ * number is converted by std::from_chars.
+ * @tparam T float or double. A float is rounded from the double.
+ * @param a_begin
+ * @param a_end
+ * @param a_value Set to the number parsed.
+ * @return Past the number, or a_begin if there is none.
+ */
+template<typename T>
+const char *parse_wkt_number(const char *a_begin, const char *a_end, T &a_value) noexcept
+{
+    static constexpr std::array<double, 23> powers{
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *p = a_begin;
+    const bool negative = p != a_end && *p == '-';
+    if (p != a_end && (*p == '-' || *p == '+')) p++;
+    const char *number = p;
+
+    auto mantissa = uint64_t{0};
+    auto digits = 0;
+    auto parse_digits = [&]() {
+        for (uint64_t chars; a_end - p >= 8 && (std::memcpy(&chars, p, 8), is_eight_digits(chars)); p += 8, digits += 8)
+            mantissa = mantissa * 100000000 + parse_eight_digits(chars);
+        for (; p != a_end && static_cast<unsigned char>(*p - '0') < 10; p++, digits++)
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+    };
+
+    parse_digits();
+    auto exponent = 0;
+    if (p != a_end && *p == '.') {
+        p++;
+        const char *fraction = p;
+        parse_digits();
+        exponent = -static_cast<int>(p - fraction);
+    }
+    if (digits == 0) return a_begin;
+
+    if (p != a_end && (*p == 'e' || *p == 'E')) {
+        const char *e = std::next(p);
+        const bool negative_exponent = e != a_end && *e == '-';
+        if (e != a_end && (*e == '-' || *e == '+')) e++;
+        if (e != a_end && static_cast<unsigned char>(*e - '0') < 10) {
+            auto value = 0;
+            for (; e != a_end && static_cast<unsigned char>(*e - '0') < 10; e++) value = value < 10000 ? value * 10 + (*e - '0') : value;
+            exponent += negative_exponent ? -value : value;
+            p = e;
+        }
+    }
+
+    // Leading zeros count as digits, which only makes the fast path a bit more conservative.
+    if (digits <= 19 && mantissa <= (uint64_t{1} << 53) && exponent >= -22 && exponent <= 22) {
+        auto value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / powers[static_cast<size_t>(-exponent)] : value * powers[static_cast<size_t>(exponent)];
+        a_value = static_cast<T>(negative ? -value : value);
+        return p;
+    }
+
+    auto value = double{0};
+    const auto [ptr, ec] = std::from_chars(number, p, value);
+    if (ec != std::errc{} && ec != std::errc::result_out_of_range) return a_begin;
+    a_value = static_cast<T>(negative ? -value : value);
+    return ptr;
+}
+
+/*!
+ * Geometry types of well-known text.
+ */
+enum class WktType : uint8_t
+{
+    Invalid, Point, LineString, Polygon, MultiPoint, MultiLineString, MultiPolygon
+};
+
+/*!
+ * A column of geometries parsed from well-known text (WKT), e.g. the `"LINESTRING (x y, x y,
+ * ...)"` of the QuotedField<NAME("WKT")> of link files, straight into flat coordinate arrays,
+ * x[] and y[], shared by all the geometries of the column, with no allocation per geometry.
+ *
+ * A geometry is made of parts, each a run of points: the single part of a POINT or a
+ * LINESTRING, the points of a MULTIPOINT, or each of them if parenthesized, the rings of a
+ * POLYGON, the line strings of a MULTILINESTRING, or the rings of all the polygons of a
+ * MULTIPOLYGON, in order. Z and M coordinates are dropped. Geometries are indexed in the
+ * order they were appended; an invalid one has type WktType::Invalid and no parts, so that
+ * the indexes stay aligned with the rows.
+ * @code
+ *   mio::csv::WktGeometries<float> links;
+ *   links.append(get<0>(columns)); // the std::vector<std::string_view> column of WKT fields
+ *   for (size_t i = 0; i < links.size(); i++) draw(links.x(i), links.y(i));
+ * @endcode
+ * @tparam T The coordinate type, double or float.
+ */
+template<typename T = double>
+requires std::is_floating_point_v<T>
+class WktGeometries
+{
+public:
+    /*!
+     * Parses a geometry, and appends it to the column.
+     * @param a_wkt Well-known text of the geometry, possibly enclosed in double quotes and
+     * spaces, e.g. a QuotedField view. Tags are not case sensitive, and `EMPTY` is valid.
+     * @return false if the text is not a valid geometry, appended as WktType::Invalid.
+     */
+    bool append(std::string_view a_wkt)
+    {
+        const auto points = x_.size();
+        const auto parts = part_offsets_.size();
+
+        auto type = parse(a_wkt);
+        if (type == WktType::Invalid) {
+            x_.resize(points);
+            y_.resize(points);
+            part_offsets_.resize(parts);
+        }
+
+        types_.push_back(type);
+        geometry_offsets_.push_back(static_cast<uint32_t>(part_offsets_.size() - 1));
+        invalid_count_ += type == WktType::Invalid;
+        return type != WktType::Invalid;
+    }
+
+    /*!
+     * Parses a column of geometries, reserving the coordinates for all of them first, and
+     * appends them to the column, see append(std::string_view).
+     * @param a_column The well-known texts, e.g. a column of CsvDoc::Columns.
+     * @return Number of valid geometries appended.
+     */
+    size_t append(std::span<const std::string_view> a_column)
+    {
+        auto bytes = size_t{0};
+        for (const auto text: a_column) bytes += text.size();
+
+        // About 20 bytes per point, as in `-83.045112 42.331427, `.
+        x_.reserve(x_.size() + bytes / 20);
+        y_.reserve(y_.size() + bytes / 20);
+        types_.reserve(types_.size() + a_column.size());
+        geometry_offsets_.reserve(geometry_offsets_.size() + a_column.size());
+
+        auto count = size_t{0};
+        for (const auto text: a_column) count += append(text);
+        return count;
+    }
+
+    /*!
+     * Number of geometries.
+     */
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return types_.size();
+    }
+
+    /*!
+     * Number of geometries whose text is not valid.
+     */
+    [[nodiscard]] size_t invalid_count() const noexcept
+    {
+        return invalid_count_;
+    }
+
+    [[nodiscard]] WktType type(size_t a_index) const noexcept
+    {
+        return types_[a_index];
+    }
+
+    [[nodiscard]] size_t part_count(size_t a_index) const noexcept
+    {
+        return geometry_offsets_[a_index + 1] - geometry_offsets_[a_index];
+    }
+
+    /*!
+     * The x coordinates of all the points of a geometry, of all its parts.
+     */
+    [[nodiscard]] std::span<const T> x(size_t a_index) const noexcept
+    {
+        return coordinates(x_, geometry_offsets_[a_index], geometry_offsets_[a_index + 1]);
+    }
+
+    /*!
+     * The y coordinates of all the points of a geometry, of all its parts.
+     */
+    [[nodiscard]] std::span<const T> y(size_t a_index) const noexcept
+    {
+        return coordinates(y_, geometry_offsets_[a_index], geometry_offsets_[a_index + 1]);
+    }
+
+    /*!
+     * The x coordinates of the points of a part of a geometry.
+     */
+    [[nodiscard]] std::span<const T> x(size_t a_index, size_t a_part) const noexcept
+    {
+        const auto part = geometry_offsets_[a_index] + a_part;
+        return coordinates(x_, part, part + 1);
+    }
+
+    /*!
+     * The y coordinates of the points of a part of a geometry.
+     */
+    [[nodiscard]] std::span<const T> y(size_t a_index, size_t a_part) const noexcept
+    {
+        const auto part = geometry_offsets_[a_index] + a_part;
+        return coordinates(y_, part, part + 1);
+    }
+
+    /*!
+     * The x coordinates of all the geometries, in order.
+     */
+    [[nodiscard]] const std::vector<T> &xs() const noexcept
+    {
+        return x_;
+    }
+
+    /*!
+     * The y coordinates of all the geometries, in order.
+     */
+    [[nodiscard]] const std::vector<T> &ys() const noexcept
+    {
+        return y_;
+    }
+
+    void clear() noexcept
+    {
+        x_.clear();
+        y_.clear();
+        part_offsets_.assign(1, 0);
+        geometry_offsets_.assign(1, 0);
+        types_.clear();
+        invalid_count_ = 0;
+    }
+
+private:
+    std::span<const T> coordinates(const std::vector<T> &a_values, uint32_t a_first_part, uint32_t a_last_part) const noexcept
+    {
+        const auto b = part_offsets_[a_first_part];
+        return {a_values.data() + b, part_offsets_[a_last_part] - b};
+    }
+
+    WktType parse(std::string_view a_wkt)
+    {
+        const char *p = a_wkt.data();
+        const char *e = std::next(p, static_cast<std::ptrdiff_t>(a_wkt.size()));
+
+        auto skip_spaces = [&e](const char *a_pos) {
+            while (a_pos != e && (*a_pos == ' ' || *a_pos == '\t' || *a_pos == '\r' || *a_pos == '\n')) a_pos++;
+            return a_pos;
+        };
+        auto word = [&](const char *a_pos) {
+            const char *w = a_pos;
+            while (w != e && ((*w | 0x20) >= 'a' && (*w | 0x20) <= 'z')) w++;
+            return std::string_view{a_pos, static_cast<size_t>(w - a_pos)};
+        };
+        auto iequals = [](std::string_view a_word, std::string_view a_upper) {
+            if (a_word.size() != a_upper.size()) return false;
+            for (size_t i = 0; i < a_word.size(); i++)
+                if ((a_word[i] & ~0x20) != a_upper[i]) return false;
+            return true;
+        };
+
+        p = skip_spaces(p);
+        if (p != e && *p == '"') {
+            p++;
+            while (e != p && (*std::prev(e) == ' ' || *std::prev(e) == '\r')) e--;
+            if (e == p || *std::prev(e) != '"') return WktType::Invalid;
+            e--;
+            p = skip_spaces(p);
+        }
+
+        static constexpr std::array<std::pair<std::string_view, WktType>, 6> tags{{
+            {"POINT", WktType::Point}, {"LINESTRING", WktType::LineString}, {"POLYGON", WktType::Polygon},
+            {"MULTIPOINT", WktType::MultiPoint}, {"MULTILINESTRING", WktType::MultiLineString}, {"MULTIPOLYGON", WktType::MultiPolygon}}};
+
+        const auto tag = word(p);
+        auto type = WktType::Invalid;
+        for (const auto &[name, t]: tags)
+            if (iequals(tag, name)) type = t;
+        if (type == WktType::Invalid) return type;
+
+        p = skip_spaces(p + tag.size());
+        if (const auto dims = word(p); iequals(dims, "Z") || iequals(dims, "M") || iequals(dims, "ZM")) p = skip_spaces(p + dims.size());
+        if (const auto empty = word(p); iequals(empty, "EMPTY")) return skip_spaces(p + empty.size()) == e ? type : WktType::Invalid;
+
+        p = parse_list(p, e, skip_spaces, 0);
+        return p != nullptr && skip_spaces(p) == e ? type : WktType::Invalid;
+    }
+
+    /*!
+     * Parses a parenthesized list, either of points, appended as a part, or of lists.
+     * @return Past the closing parenthesis, or nullptr if invalid.
+     */
+    template<typename F>
+    const char *parse_list(const char *a_pos, const char *a_end, const F &a_skip_spaces, int a_depth)
+    {
+        // A MULTIPOLYGON is 3 levels deep, so deeper lists are not valid.
+        if (a_pos == a_end || *a_pos != '(' || a_depth > 2) return nullptr;
+        const char *p = a_skip_spaces(std::next(a_pos));
+
+        if (p != a_end && *p == '(') {
+            for (;;) {
+                p = parse_list(p, a_end, a_skip_spaces, a_depth + 1);
+                if (p == nullptr) return nullptr;
+                p = a_skip_spaces(p);
+                if (p == a_end) return nullptr;
+                if (*p == ')') return std::next(p);
+                if (*p != ',') return nullptr;
+                p = a_skip_spaces(std::next(p));
+            }
+        }
+
+        for (;;) {
+            // A point is x y, followed by the Z and M coordinates if any.
+            T x{}, y{}, ignored{};
+            const char *q = parse_wkt_number(p, a_end, x);
+            if (q == p) return nullptr;
+            p = a_skip_spaces(q);
+            q = parse_wkt_number(p, a_end, y);
+            if (q == p) return nullptr;
+            for (p = a_skip_spaces(q); p != a_end && (q = parse_wkt_number(p, a_end, ignored)) != p;) p = a_skip_spaces(q);
+
+            x_.push_back(x);
+            y_.push_back(y);
+
+            if (p == a_end) return nullptr;
+            if (*p == ')') break;
+            if (*p != ',') return nullptr;
+            p = a_skip_spaces(std::next(p));
+        }
+
+        part_offsets_.push_back(static_cast<uint32_t>(x_.size()));
+        return std::next(p);
+    }
+
+    std::vector<T> x_;
+    std::vector<T> y_;
+    std::vector<uint32_t> part_offsets_{0};     // the first point of each part, and past the last
+    std::vector<uint32_t> geometry_offsets_{0}; // the first part of each geometry, and past the last
+    std::vector<WktType> types_;
+    size_t invalid_count_{0};
+};
+
+}
+#endif
@@ -0,0 +1,565 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MSGPACK_BLOCK_COMPRESS_HPP
+#define WXLIB_MSGPACK_BLOCK_COMPRESS_HPP
+
+#include <mio/executor.hpp>
+#include <msgpack/msgpack.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// The codecs need their libraries to be linked, so they are opted in, e.g. by CMake when found.
+#ifdef WXLIB_MSGPACK_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WXLIB_MSGPACK_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef WXLIB_MSGPACK_WITH_LZ4
+#include <lz4.h>
+#endif
+
+namespace msgpack {
+
+/*!
+  A codec of the blocks of BlockCompressingSink, compressing a block into a buffer, and returning
+  false if it cannot or if it does not pay, the block being stored as is then, and decompressing
+  one into exactly its raw size. The ID identifies the codec in the stream.
+*/
+template<typename CodecT>
+concept BlockCodec = requires(const CodecT &codec, std::span<const uint8_t> bytes, std::vector<uint8_t> &compressed, std::span<uint8_t> raw) {
+  { CodecT::id } -> std::convertible_to<uint8_t>;
+  { codec.compress(bytes, compressed) } -> std::same_as<bool>;
+  { codec.decompress(bytes, raw) } -> std::same_as<bool>;
+};
+
+/*!
+  Stores the blocks as they are, e.g. to index a stream for random access only.
+*/
+struct StoreCodec
+{
+  static constexpr uint8_t id = 0;
+
+  bool compress(std::span<const uint8_t>, std::vector<uint8_t> &) const
+  {
+    return false;
+  }
+
+  bool decompress(std::span<const uint8_t>, std::span<uint8_t>) const
+  {
+    return false;
+  }
+};
+
+#ifdef WXLIB_MSGPACK_WITH_ZLIB
+struct ZlibCodec
+{
+  static constexpr uint8_t id = 1;
+  int level{Z_DEFAULT_COMPRESSION};
+
+  bool compress(const std::span<const uint8_t> a_bytes, std::vector<uint8_t> &a_compressed) const
+  {
+    auto size = ::compressBound(uLong(a_bytes.size()));
+    a_compressed.resize(size);
+    if (::compress2(a_compressed.data(), &size, a_bytes.data(), uLong(a_bytes.size()), level) != Z_OK) return false;
+    a_compressed.resize(size);
+    return size < a_bytes.size();
+  }
+
+  bool decompress(const std::span<const uint8_t> a_bytes, const std::span<uint8_t> a_raw) const
+  {
+    auto size = uLongf(a_raw.size());
+    return ::uncompress(a_raw.data(), &size, a_bytes.data(), uLong(a_bytes.size())) == Z_OK && size == a_raw.size();
+  }
+};
+#endif
+
+#ifdef WXLIB_MSGPACK_WITH_ZSTD
+struct ZstdCodec
+{
+  static constexpr uint8_t id = 2;
+  int level{3};
+
+  bool compress(const std::span<const uint8_t> a_bytes, std::vector<uint8_t> &a_compressed) const
+  {
+    a_compressed.resize(::ZSTD_compressBound(a_bytes.size()));
+    const auto size = ::ZSTD_compress(a_compressed.data(), a_compressed.size(), a_bytes.data(), a_bytes.size(), level);
+    if (::ZSTD_isError(size)) return false;
+    a_compressed.resize(size);
+    return size < a_bytes.size();
+  }
+
+  bool decompress(const std::span<const uint8_t> a_bytes, const std::span<uint8_t> a_raw) const
+  {
+    const auto size = ::ZSTD_decompress(a_raw.data(), a_raw.size(), a_bytes.data(), a_bytes.size());
+    return !::ZSTD_isError(size) && size == a_raw.size();
+  }
+};
+#endif
+
+#ifdef WXLIB_MSGPACK_WITH_LZ4
+struct Lz4Codec
+{
+  static constexpr uint8_t id = 3;
+
+  bool compress(const std::span<const uint8_t> a_bytes, std::vector<uint8_t> &a_compressed) const
+  {
+    a_compressed.resize(std::size_t(::LZ4_compressBound(int(a_bytes.size()))));
+    const auto size = ::LZ4_compress_default(reinterpret_cast<const char *>(a_bytes.data()), reinterpret_cast<char *>(a_compressed.data()),
+                                             int(a_bytes.size()), int(a_compressed.size()));
+    if (size <= 0) return false;
+    a_compressed.resize(std::size_t(size));
+    return std::size_t(size) < a_bytes.size();
+  }
+
+  bool decompress(const std::span<const uint8_t> a_bytes, const std::span<uint8_t> a_raw) const
+  {
+    const auto size = ::LZ4_decompress_safe(reinterpret_cast<const char *>(a_bytes.data()), reinterpret_cast<char *>(a_raw.data()),
+                                            int(a_bytes.size()), int(a_raw.size()));
+    return size >= 0 && std::size_t(size) == a_raw.size();
+  }
+};
+#endif
+
+namespace detail {
+
+/*!
+  The layout of block compressed streams:
+
+  - a header: the magic, the version, the ID of the codec, and the block size;
+  - the blocks, each after its raw size and its payload size, the top bit of which flags blocks
+    stored as they are, and an empty block closing them;
+  - the index of the blocks, of their offsets in the stream and in the raw bytes;
+  - a trailer: the offset of the index, the number of blocks, the raw size, and the magic.
+
+  Integers are big-endian, as in msgpack.
+*/
+struct BlockFormat
+{
+  static constexpr std::array<uint8_t, 4> magic{'W', 'X', 'B', 'K'};
+  static constexpr uint8_t version = 1;
+  static constexpr std::size_t header_size = 12;
+  static constexpr std::size_t block_header_size = 8;
+  static constexpr std::size_t index_entry_size = 16;
+  static constexpr std::size_t trailer_size = 28;
+  static constexpr uint32_t stored_flag = uint32_t{1} << 31U;
+  static constexpr std::size_t max_block_size = std::size_t{1} << 30U;
+};
+
+}
+
+/*!
+  A sink compressing what is packed into it, e.g. a network snapshot of several hundred MB, in
+  independent blocks, which the workers of mio::Executor::shared() compress in parallel, and
+  writing them with an index to another sink, e.g. a StreamSink of a socket. Receivers read the
+  blocks with a BlockReader, decompressing them in parallel, or any one of them alone.
+
+  The blocks are a fixed number of raw bytes, cut wherever that falls, or earlier at
+  flush_block(), e.g. at the end of each message, so that each block can be decoded on its own.
+  Only a batch of as many blocks as workers is held, raw and compressed, never the whole stream.
+
+  Anything appended goes into the blocks, e.g. the bytes of a zpp_bits archive too.
+
+  @code
+    auto sink = msgpack::BlockCompressingSink{msgpack::StreamSink{send_to_peer}, msgpack::ZstdCodec{}};
+    auto packer = msgpack::BasicPacker{std::move(sink)};
+    packer.process(snapshot);
+    if (!packer.ec && packer.sink().finish() && packer.sink().sink().flush()) {
+      // ... all sent.
+    }
+  @endcode
+*/
+template<BlockCodec CodecT, PackerSink SinkT>
+class BlockCompressingSink
+{
+public:
+  static constexpr std::size_t default_block_size = std::size_t{1} << 20U;
+
+  /*!
+    \param a_sink  The sink of the compressed stream.
+    \param a_codec  The codec of the blocks.
+    \param a_block_size  The raw size of the blocks, at most 1 GiB.
+    \param a_num_threads  The number of blocks compressed at a time, 0 treated as 1.
+  */
+  explicit BlockCompressingSink(SinkT a_sink, CodecT a_codec = {}, const std::size_t a_block_size = default_block_size,
+                                const std::size_t a_num_threads = mio::available_concurrency())
+      : sink_(std::move(a_sink)), codec_(std::move(a_codec)),
+        block_size_(std::clamp<std::size_t>(a_block_size, 1, detail::BlockFormat::max_block_size)),
+        batch_(std::max<std::size_t>(a_num_threads, 1))
+  {};
+
+  BlockCompressingSink(BlockCompressingSink &&) noexcept = default;
+  BlockCompressingSink &operator=(BlockCompressingSink &&) noexcept = default;
+
+  bool append(const uint8_t *a_bytes, std::size_t a_size)
+  {
+    while (a_size > 0 && ok_) {
+      auto &raw = batch_[filled_].raw;
+      if (raw.capacity() < block_size_) raw.reserve(block_size_);
+
+      const auto n = std::min(a_size, block_size_ - raw.size());
+      raw.insert(raw.end(), a_bytes, a_bytes + n);
+      a_bytes += n;
+      a_size -= n;
+      if (raw.size() == block_size_) cut();
+    }
+    return ok_;
+  }
+
+  /*!
+    Ends the current block, if not empty, e.g. at the end of a message, so that the next one
+    starts a block.
+  */
+  bool flush_block()
+  {
+    if (ok_ && !batch_[filled_].raw.empty()) cut();
+    return ok_;
+  }
+
+  /*!
+    Writes the last blocks, and the index, ending the stream; the sink of the stream may need to
+    be flushed after.
+
+    \returns  Whether all were written.
+  */
+  bool finish()
+  {
+    if (!ok_ || finished_) return ok_ && finished_;
+    flush_block();
+    compress_batch();
+    write_header();
+
+    auto end = std::array<uint8_t, detail::BlockFormat::block_header_size>{};
+    write(end);
+
+    const auto index_offset = offset_;
+    auto entry = std::array<uint8_t, detail::BlockFormat::index_entry_size>{};
+    for (const auto &[offset, raw_offset] : index_) {
+      detail::store_big_endian(offset, entry.data());
+      detail::store_big_endian(raw_offset, entry.data() + 8);
+      write(entry);
+    }
+
+    auto trailer = std::array<uint8_t, detail::BlockFormat::trailer_size>{};
+    detail::store_big_endian(index_offset, trailer.data());
+    detail::store_big_endian(uint64_t(index_.size()), trailer.data() + 8);
+    detail::store_big_endian(raw_offset_, trailer.data() + 16);
+    std::memcpy(trailer.data() + 24, detail::BlockFormat::magic.data(), 4);
+    write(trailer);
+
+    finished_ = ok_;
+    return ok_;
+  }
+
+  /*!
+    The number of raw bytes appended so far.
+  */
+  [[nodiscard]] uint64_t raw_size() const
+  {
+    auto size = raw_offset_;
+    for (std::size_t i = 0; i <= filled_ && i < batch_.size(); i++) size += batch_[i].raw.size();
+    return size;
+  }
+
+  /*!
+    The number of bytes written to the sink of the stream so far.
+  */
+  [[nodiscard]] uint64_t written() const
+  {
+    return offset_;
+  }
+
+  SinkT &sink()
+  {
+    return sink_;
+  }
+
+private:
+  struct Block
+  {
+    std::vector<uint8_t> raw;
+    std::vector<uint8_t> compressed;
+    bool is_compressed{false};
+  };
+
+  void cut()
+  {
+    if (++filled_ == batch_.size()) compress_batch();
+  }
+
+  /*!
+    Compresses the blocks filled, in parallel, and writes them in order.
+  */
+  void compress_batch()
+  {
+    if (filled_ == 0) return;
+    write_header();
+
+    mio::Executor::shared().run_workers(filled_, [&](const std::size_t a_block) {
+      auto &block = batch_[a_block];
+      block.is_compressed = codec_.compress(block.raw, block.compressed);
+    });
+
+    for (std::size_t i = 0; i < filled_ && ok_; i++) {
+      auto &block = batch_[i];
+      const auto &payload = block.is_compressed ? block.compressed : block.raw;
+      index_.emplace_back(offset_, raw_offset_);
+
+      auto header = std::array<uint8_t, detail::BlockFormat::block_header_size>{};
+      detail::store_big_endian(uint32_t(block.raw.size()), header.data());
+      detail::store_big_endian(uint32_t(payload.size()) | (block.is_compressed ? 0 : detail::BlockFormat::stored_flag), header.data() + 4);
+      write(header);
+      write(payload);
+
+      raw_offset_ += block.raw.size();
+      block.raw.clear();
+    }
+    filled_ = 0;
+  }
+
+  void write_header()
+  {
+    if (offset_ > 0) return;
+    auto header = std::array<uint8_t, detail::BlockFormat::header_size>{};
+    std::memcpy(header.data(), detail::BlockFormat::magic.data(), 4);
+    header[4] = detail::BlockFormat::version;
+    header[5] = CodecT::id;
+    detail::store_big_endian(uint32_t(block_size_), header.data() + 8);
+    write(header);
+  }
+
+  void write(const std::span<const uint8_t> a_bytes)
+  {
+    if (ok_ && !sink_.append(a_bytes.data(), a_bytes.size())) ok_ = false;
+    offset_ += a_bytes.size();
+  }
+
+  SinkT sink_;
+  CodecT codec_;
+  std::size_t block_size_;
+  std::vector<Block> batch_;
+  std::size_t filled_{0};
+  std::vector<std::pair<uint64_t, uint64_t>> index_;
+  uint64_t offset_{0};
+  uint64_t raw_offset_{0};
+  bool ok_{true};
+  bool finished_{false};
+};
+
+/*!
+  Reads a stream written by a BlockCompressingSink, e.g. received whole or mapped from a file,
+  decompressing blocks in parallel, or any one of them alone, found by its index.
+
+  @code
+    msgpack::BlockReader<msgpack::ZstdCodec> reader;
+    std::error_code ec;
+    reader.open(received, ec);
+    std::vector<uint8_t> snapshot;
+    reader.read_all(snapshot, ec);
+  @endcode
+*/
+template<BlockCodec CodecT>
+class BlockReader
+{
+public:
+  explicit BlockReader(CodecT a_codec = {}) : codec_(std::move(a_codec))
+  {};
+
+  /*!
+    Reads the index of a stream, which must outlive the reader.
+
+    \param a_ec  Set to UnpackerError::OutOfRange if the stream is truncated, or to
+                 UnpackerError::DataNotMatchType if it is not of the codec, or not valid.
+  */
+  void open(const std::span<const uint8_t> a_bytes, std::error_code &a_ec)
+  {
+    using Format = detail::BlockFormat;
+    a_ec.clear();
+    bytes_ = {};
+    blocks_.clear();
+    raw_size_ = 0;
+
+    if (a_bytes.size() < Format::header_size + Format::trailer_size) return void(a_ec = UnpackerError::OutOfRange);
+    const auto trailer = a_bytes.last(Format::trailer_size);
+    if (!std::equal(Format::magic.begin(), Format::magic.end(), a_bytes.begin()) || !std::equal(Format::magic.begin(), Format::magic.end(), trailer.begin() + 24))
+      return void(a_ec = UnpackerError::OutOfRange);
+    if (a_bytes[4] != Format::version || a_bytes[5] != CodecT::id) return void(a_ec = UnpackerError::DataNotMatchType);
+
+    const auto index_offset = detail::read_big_endian(trailer.first(8));
+    const auto count = detail::read_big_endian(trailer.subspan(8, 8));
+    const auto index_end = a_bytes.size() - Format::trailer_size;
+    if (index_offset < Format::header_size || index_offset > index_end || (index_end - index_offset) / Format::index_entry_size != count
+        || (index_end - index_offset) % Format::index_entry_size != 0)
+      return void(a_ec = UnpackerError::DataNotMatchType);
+
+    blocks_.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+      const auto entry = a_bytes.subspan(index_offset + i * Format::index_entry_size, Format::index_entry_size);
+      const auto offset = detail::read_big_endian(entry.first(8));
+      if (offset < Format::header_size || offset > index_offset - Format::block_header_size) return fail(a_ec);
+
+      const auto header = a_bytes.subspan(offset, Format::block_header_size);
+      const auto raw_size = detail::read_big_endian(header.first(4));
+      const auto stored_size = uint32_t(detail::read_big_endian(header.subspan(4, 4)));
+      const auto size = stored_size & ~Format::stored_flag;
+      const bool is_compressed = (stored_size & Format::stored_flag) == 0;
+      if (size > index_offset - offset - Format::block_header_size || (!is_compressed && size != raw_size)
+          || detail::read_big_endian(entry.subspan(8, 8)) != raw_size_)
+        return fail(a_ec);
+
+      blocks_.push_back({a_bytes.subspan(offset + Format::block_header_size, size), raw_size_, std::size_t(raw_size), is_compressed});
+      raw_size_ += raw_size;
+    }
+
+    if (raw_size_ != detail::read_big_endian(trailer.subspan(16, 8))) return fail(a_ec);
+    bytes_ = a_bytes;
+  }
+
+  [[nodiscard]] std::size_t block_count() const
+  {
+    return blocks_.size();
+  }
+
+  /*!
+    The size of the raw bytes of all the blocks.
+  */
+  [[nodiscard]] uint64_t raw_size() const
+  {
+    return raw_size_;
+  }
+
+  /*!
+    The offset of a block in the raw bytes, and its raw size.
+  */
+  [[nodiscard]] std::pair<uint64_t, std::size_t> raw_extent(const std::size_t a_block) const
+  {
+    return {blocks_[a_block].raw_offset, blocks_[a_block].raw_size};
+  }
+
+  /*!
+    Decompresses a block into the given buffer, replacing its contents.
+  */
+  void read_block(const std::size_t a_block, std::vector<uint8_t> &a_raw, std::error_code &a_ec) const
+  {
+    a_raw.resize(blocks_[a_block].raw_size);
+    a_ec = decompress(blocks_[a_block], a_raw);
+  }
+
+  /*!
+    Decompresses all the blocks into the given buffer, replacing its contents, a_num_threads
+    blocks at a time.
+  */
+  void read_all(std::vector<uint8_t> &a_raw, std::error_code &a_ec, const std::size_t a_num_threads = mio::available_concurrency()) const
+  {
+    a_raw.resize(raw_size_);
+    a_ec = run_blocks(a_num_threads, [&](const Block &a_block) {
+      return decompress(a_block, std::span{a_raw}.subspan(a_block.raw_offset, a_block.raw_size));
+    });
+  }
+
+  /*!
+    Decompresses the blocks on a_num_threads workers, and fires the callback with the ID of the
+    worker, the number of the block, and its raw bytes, valid for the duration of the call, e.g.
+    to decode blocks cut at message boundaries in parallel too. The callback should return 0 for
+    success; a non-zero code stops the read, and is returned.
+  */
+  template<typename CallbackT>
+  requires std::is_invocable_r_v<int, const CallbackT &, int, std::size_t, std::span<const uint8_t>>
+  int for_each_block(const CallbackT &a_callback, std::error_code &a_ec, const std::size_t a_num_threads = mio::available_concurrency()) const
+  {
+    auto buffers = std::vector<std::vector<uint8_t>>(std::max<std::size_t>(a_num_threads, 1));
+    auto status = std::atomic<int>{0};
+    a_ec = run_blocks(a_num_threads, [&](const Block &a_block, const std::size_t a_worker) {
+      auto &raw = buffers[a_worker];
+      raw.resize(a_block.raw_size);
+      if (const auto error = decompress(a_block, raw)) return error;
+
+      const auto code = a_callback(int(a_worker), std::size_t(&a_block - blocks_.data()), raw);
+      if (code != 0) {
+        auto expected = 0;
+        status.compare_exchange_strong(expected, code);
+        return std::make_error_code(std::errc::operation_canceled);
+      }
+      return std::error_code{};
+    });
+    if (status != 0) a_ec.clear();
+    return status;
+  }
+
+private:
+  struct Block
+  {
+    std::span<const uint8_t> payload;
+    uint64_t raw_offset;
+    std::size_t raw_size;
+    bool is_compressed;
+  };
+
+  void fail(std::error_code &a_ec)
+  {
+    blocks_.clear();
+    raw_size_ = 0;
+    a_ec = UnpackerError::DataNotMatchType;
+  }
+
+  std::error_code decompress(const Block &a_block, const std::span<uint8_t> a_raw) const
+  {
+    if (!a_block.is_compressed)
+      std::memcpy(a_raw.data(), a_block.payload.data(), a_block.raw_size);
+    else if (!codec_.decompress(a_block.payload, a_raw))
+      return UnpackerError::DataNotMatchType;
+    return {};
+  }
+
+  /*!
+    Runs a_task on each block, claimed by a_num_threads workers, till the first error.
+  */
+  template<typename F>
+  std::error_code run_blocks(const std::size_t a_num_threads, const F &a_task) const
+  {
+    const auto threads = std::clamp<std::size_t>(blocks_.size(), 1, std::max<std::size_t>(a_num_threads, 1));
+    auto next = std::atomic<std::size_t>{0};
+    auto failed = std::atomic<bool>{false};
+    auto first_error = std::error_code{};
+    auto mutex = std::mutex{};
+
+    mio::Executor::shared().run_workers(threads, [&](const std::size_t a_worker) {
+      for (auto i = next.fetch_add(1); i < blocks_.size() && !failed; i = next.fetch_add(1)) {
+        std::error_code error;
+        if constexpr (std::is_invocable_v<const F &, const Block &, std::size_t>)
+          error = a_task(blocks_[i], a_worker);
+        else
+          error = a_task(blocks_[i]);
+
+        if (error) {
+          const auto lock = std::lock_guard{mutex};
+          if (!first_error) first_error = error;
+          failed = true;
+        }
+      }
+    });
+    return first_error;
+  }
+
+  CodecT codec_;
+  std::span<const uint8_t> bytes_;
+  std::vector<Block> blocks_;
+  uint64_t raw_size_{0};
+};
+
+}
+#endif
@@ -0,0 +1,506 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MSGPACK_FRAMED_READER_HPP
+#define WXLIB_MSGPACK_FRAMED_READER_HPP
+
+#include <mio/mio.hpp>
+#include <mio/executor.hpp>
+#include <msgpack/msgpack.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace msgpack {
+
+/*!
+  How the messages of a log follow one another.
+*/
+enum class Framing
+{
+  // Messages one after another, their boundaries found by skipping items, see skip().
+  Concatenated,
+  // Each message after its size, as a 4-byte big-endian integer, see append_framed().
+  LengthPrefixed
+};
+
+/*!
+  In which order FramedReader::read() delivers the messages.
+*/
+enum class Delivery
+{
+  // As soon as each is unpacked, by the worker unpacking it.
+  Unordered,
+  // In the order of the log, one at a time.
+  Ordered
+};
+
+/*!
+  Appends an object to a log of Framing::LengthPrefixed messages, packed after its size.
+*/
+template<Serializable T>
+void append_framed(std::vector<uint8_t> &a_log, const T &a_object, std::error_code &a_ec)
+{
+  const auto start = a_log.size();
+  a_log.resize(start + sizeof(uint32_t));
+
+  auto packer = BasicPacker<ContainerSink<std::vector<uint8_t>>>{ContainerSink{a_log}};
+  detail::pack_object(const_cast<T &>(a_object), packer);
+  a_ec = packer.ec;
+
+  const auto size = a_log.size() - start - sizeof(uint32_t);
+  if (!a_ec && size > limits<uint32_t>::max()) a_ec = PackerError::LengthError;
+  if (a_ec) {
+    a_log.resize(start);
+    return;
+  }
+
+  for (std::size_t i = 0; i < sizeof(uint32_t); i++)
+    a_log[start + i] = uint8_t(size >> (8U * (sizeof(uint32_t) - 1 - i)));
+}
+
+/*!
+  Reads a log of many msgpack messages, e.g. a file of millions of them mapped through a
+  mio::mmap_source, unpacking them in parallel on mio::Executor::shared().
+
+  A first pass finds the boundaries of the messages, by their sizes, or by skipping their items
+  without unpacking them, which is a lot faster than unpacking; then the workers claim chunks of
+  consecutive messages, and unpack them, as StringReaderAsync does the lines of a file.
+
+  Concatenated messages must have the same number of top level items, e.g. 1 for arrays, maps
+  or objects with MapTraits, as required to find their ends; objects packed field by field, in
+  any number of items, are framed by their sizes instead.
+
+  @code
+    msgpack::FramedReader log;
+    std::error_code ec;
+    log.open("vehicles.mpk", msgpack::Framing::LengthPrefixed, ec);
+    log.read<Vehicle>([&](int a_worker, std::size_t a_index, Vehicle &a_vehicle) {
+      // ... do something about the vehicle.
+      return 0;
+    }, ec);
+  @endcode
+*/
+class FramedReader
+{
+public:
+  /*!
+    Number of messages a worker claims at a time.
+  */
+  static constexpr std::size_t chunk_size = 256;
+
+  FramedReader() = default;
+
+  /*!
+    Reads messages in memory, which must outlive the reader.
+
+    \param a_items  The number of top level items of each Framing::Concatenated message.
+  */
+  explicit FramedReader(const std::span<const uint8_t> a_bytes, const Framing a_framing = Framing::Concatenated, const std::size_t a_items = 1)
+      : bytes_(a_bytes), framing_(a_framing), items_(std::max(a_items, std::size_t{1}))
+  {};
+
+  FramedReader(const FramedReader &) = delete;
+  FramedReader &operator=(const FramedReader &) = delete;
+
+  /*!
+    Maps a log file, see FramedReader(bytes, framing, items).
+  */
+  void open(const std::string &a_file, const Framing a_framing, std::error_code &a_ec, const std::size_t a_items = 1)
+  {
+    mmap_.map(a_file, a_ec);
+    bytes_ = a_ec ? std::span<const uint8_t>{} : std::span{reinterpret_cast<const uint8_t *>(mmap_.data()), mmap_.size()};
+    framing_ = a_framing;
+    items_ = std::max(a_items, std::size_t{1});
+    messages_.clear();
+    indexed_ = false;
+  }
+
+  /*!
+    Finds the boundaries of the messages, once, if read() did not already.
+
+    \returns  the number of complete messages, setting a_ec, e.g. to UnpackerError::OutOfRange
+               if the log ends in a partial message, as one being written; the messages before it
+               are read still.
+  */
+  std::size_t index(std::error_code &a_ec)
+  {
+    if (indexed_) {
+      a_ec = index_error_;
+      return messages_.size();
+    }
+
+    WXLIB_TRACE_SPAN("msgpack.index");
+    indexed_ = true;
+    index_error_.clear();
+    std::size_t position{0};
+    while (position < bytes_.size()) {
+      const auto rest = bytes_.subspan(position);
+      std::size_t header{0};
+      std::size_t size{0};
+      if (framing_ == Framing::LengthPrefixed) {
+        header = sizeof(uint32_t);
+        if (rest.size() < header) {
+          index_error_ = UnpackerError::OutOfRange;
+          break;
+        }
+
+        for (std::size_t i = 0; i < header; i++) size = size << 8U | rest[i];
+        if (size > rest.size() - header) {
+          index_error_ = UnpackerError::OutOfRange;
+          break;
+        }
+      } else {
+        size = skip(rest, items_, index_error_);
+        if (index_error_) break;
+      }
+
+      messages_.push_back(rest.subspan(header, size));
+      position += header + size;
+    }
+
+    a_ec = index_error_;
+    return messages_.size();
+  }
+
+  /*!
+    Unpacks the messages as T objects on a_num_threads workers, and fires the callback with the
+    ID of the worker, the index of the message in the log, and the object, which it may move
+    from.
+
+    The callback should return 0 for success; a non-zero code stops the read, and is returned by
+    status(). Ordered delivery buffers the messages unpacked ahead of the next one to deliver, at
+    most a few chunks per worker, and never fires the callback concurrently.
+
+    \returns  the number of messages delivered, setting a_ec to the first error of indexing, see
+               index(), or of unpacking, which stops the read.
+  */
+  template<Serializable T, typename CallbackT>
+  requires std::is_invocable_r_v<int, const CallbackT &, int, std::size_t, T &>
+  std::size_t read(const CallbackT &a_callback, std::error_code &a_ec, const Delivery a_delivery = Delivery::Unordered,
+                   const std::size_t a_num_threads = mio::available_concurrency())
+  {
+    index(a_ec);
+    status_ = 0;
+
+    const auto chunks = (messages_.size() + chunk_size - 1) / chunk_size;
+    const auto threads = std::clamp(chunks, std::size_t{1}, std::max(a_num_threads, std::size_t{1}));
+    auto run = Run{};
+
+    if (a_delivery == Delivery::Unordered) {
+      mio::Executor::shared().run_workers(threads, [&](const std::size_t a_worker) {
+        for (auto c = run.next_chunk.fetch_add(1); c < chunks && !run.stopped(); c = run.next_chunk.fetch_add(1)) {
+          for (auto i = c * chunk_size; i < std::min(messages_.size(), (c + 1) * chunk_size) && !run.stopped(); i++) {
+            auto object = T{};
+            if (!unpack_message(i, object, run)) break;
+            deliver(a_callback, static_cast<int>(a_worker), i, object, run);
+          }
+        }
+      });
+    } else {
+      // Each chunk is unpacked into its slot, and delivered by whichever worker finds it next.
+      struct Slot
+      {
+        std::vector<T> objects;
+        std::atomic<bool> ready{false};
+      };
+
+      const auto window = 4 * threads;
+      auto slots = std::make_unique<Slot[]>(chunks);
+      auto delivering = std::mutex{};
+      auto next_delivery = std::atomic<std::size_t>{0};
+
+      auto deliver_ready = [&](const int a_worker) {
+        while (true) {
+          auto lock = std::unique_lock{delivering, std::try_to_lock};
+          if (!lock) return;
+
+          auto n = next_delivery.load();
+          for (; n < chunks && slots[n].ready.load(std::memory_order_acquire) && !run.stopped(); n++) {
+            auto &objects = slots[n].objects;
+            for (std::size_t k = 0; k < objects.size() && !run.stopped(); k++)
+              deliver(a_callback, a_worker, n * chunk_size + k, objects[k], run);
+            objects = {};
+            next_delivery.store(n + 1);
+            run.progressed();
+          }
+          lock.unlock();
+
+          // Checked again once released, in case a worker readied the next chunk meanwhile.
+          if (n == chunks || run.stopped() || !slots[n].ready.load(std::memory_order_acquire)) return;
+        }
+      };
+
+      mio::Executor::shared().run_workers(threads, [&](const std::size_t a_worker) {
+        for (auto c = run.next_chunk.fetch_add(1); c < chunks && !run.stopped(); c = run.next_chunk.fetch_add(1)) {
+          // Waits for the chunks more than a window ahead of the next delivery.
+          for (auto p = run.progress.load(); c >= next_delivery.load() + window && !run.stopped(); p = run.progress.load())
+            run.progress.wait(p);
+
+          const auto first = c * chunk_size;
+          const auto last = std::min(messages_.size(), first + chunk_size);
+          auto &objects = slots[c].objects;
+          objects.resize(last - first);
+          for (auto i = first; i < last && !run.stopped(); i++)
+            if (!unpack_message(i, objects[i - first], run)) break;
+
+          if (run.stopped()) break;
+          slots[c].ready.store(true, std::memory_order_release);
+          deliver_ready(static_cast<int>(a_worker));
+        }
+      });
+    }
+
+    if (!a_ec) a_ec = run.error;
+    status_ = run.status;
+    return run.delivered.load();
+  }
+
+  /*!
+    The first non-zero code returned by the callback of the last read(), or 0.
+  */
+  [[nodiscard]] int status() const
+  {
+    return status_;
+  }
+
+  /*!
+    The messages found by index(), each a view of the log.
+  */
+  [[nodiscard]] std::span<const std::span<const uint8_t>> messages() const
+  {
+    return messages_;
+  }
+
+private:
+  /*!
+    The shared state of the workers of a read.
+  */
+  struct Run
+  {
+    std::atomic<std::size_t> next_chunk{0};
+    std::atomic<std::size_t> delivered{0};
+    std::atomic<bool> stop{false};
+    // Changes on each delivery of an ordered read, and on stopping, for the workers waiting.
+    std::atomic<uint32_t> progress{0};
+    std::mutex mutex;
+    std::error_code error;
+    int status{0};
+
+    [[nodiscard]] bool stopped() const
+    {
+      return stop.load(std::memory_order_relaxed);
+    }
+
+    void fail(const std::error_code a_error, const int a_status)
+    {
+      const auto lock = std::lock_guard{mutex};
+      if (error || status != 0) return;
+      error = a_error;
+      status = a_status;
+      stop.store(true);
+      progressed();
+    }
+
+    void progressed()
+    {
+      progress.fetch_add(1);
+      progress.notify_all();
+    }
+  };
+
+  template<typename T>
+  bool unpack_message(const std::size_t a_index, T &a_object, Run &a_run) const
+  {
+    WXLIB_TRACE_SPAN("msgpack.unpack");
+    const auto &message = messages_[a_index];
+    auto unpacker = Unpacker(message.data(), message.size());
+    detail::pack_object(a_object, unpacker);
+    if (unpacker.ec) a_run.fail(unpacker.ec, 0);
+    return !unpacker.ec;
+  }
+
+  template<typename T, typename CallbackT>
+  static void deliver(const CallbackT &a_callback, const int a_worker, const std::size_t a_index, T &a_object, Run &a_run)
+  {
+    if (const auto status = a_callback(a_worker, a_index, a_object); status != 0)
+      a_run.fail({}, status);
+    else
+      a_run.delivered.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  mio::mmap_source mmap_;
+  std::span<const uint8_t> bytes_;
+  Framing framing_{Framing::Concatenated};
+  std::size_t items_{1};
+  std::vector<std::span<const uint8_t>> messages_;
+  std::error_code index_error_;
+  bool indexed_{false};
+  int status_{0};
+};
+
+
+/*!
+  Finds the offsets of the elements of the array at the start of a_bytes, e.g. a single message
+  of millions of link records, by skipping them, without unpacking them, on a_num_threads
+  workers.
+
+  Each worker skips the items of its block of bytes from a speculative start, the start of the
+  block, which soon falls in step with the items, nested or not, since a container is skipped
+  whole from its header. The chains of item offsets are then joined in order: once the exact
+  chain from the block before hits an offset of the next one, the rest of that chain is exact
+  too, since skipping is deterministic; a block whose chain is not hit is skipped again from the
+  exact offset.
+
+  Elements are single items, e.g. arrays, maps or objects with MapTraits, unless a_items is
+  given, e.g. the number of fields of objects packed field by field, as FramedReader requires.
+
+  \returns  the offset of each element, then of the end of the array, or nothing, setting a_ec,
+             if a_bytes does not start with a whole array.
+*/
+inline std::vector<std::size_t> index_array(const std::span<const uint8_t> a_bytes, std::error_code &a_ec,
+                                            const std::size_t a_num_threads = mio::available_concurrency(), const std::size_t a_items = 1)
+{
+  WXLIB_TRACE_SPAN("msgpack.index_array");
+  a_ec.clear();
+  const auto header = detail::item_extent(a_bytes, a_ec);
+  const uint8_t format = a_bytes.empty() ? 0 : a_bytes[0];
+  if (!header || !((format >= 0x90 && format <= 0x9F) || format == array16 || format == array32)) {
+    if (!a_ec) a_ec = make_error_code(header ? UnpackerError::DataNotMatchType : UnpackerError::OutOfRange);
+    return {};
+  }
+
+  const auto count = std::size_t(header->children);
+  const auto items = std::max(a_items, std::size_t{1});
+  const auto start = header->size;
+  auto offsets = std::vector<std::size_t>{};
+  offsets.reserve(std::min(count, a_bytes.size() - start) + 1);
+  offsets.push_back(start);
+  if (count == 0) return offsets;
+
+  // Blocks of 1 MiB at least, each skipped by a worker from its speculative start.
+  static constexpr std::size_t min_block = std::size_t{1} << 20;
+  static constexpr std::size_t max_attempts = 64;
+  const auto blocks = std::clamp((a_bytes.size() - start) / min_block, std::size_t{1}, std::max(a_num_threads, std::size_t{1}));
+  const auto block_end = [&](const std::size_t a_block) {
+    return a_block + 1 == blocks ? a_bytes.size() : start + (a_bytes.size() - start) / blocks * (a_block + 1);
+  };
+  const auto block_begin = [&](const std::size_t a_block) {
+    return a_block == 0 ? start : block_end(a_block - 1);
+  };
+
+  // A single block is skipped element by element.
+  if (blocks == 1) {
+    while (offsets.size() <= count) {
+      const auto size = skip(a_bytes.subspan(offsets.back()), items, a_ec);
+      if (a_ec) return {};
+      offsets.push_back(offsets.back() + size);
+    }
+    return offsets;
+  }
+
+  auto chains = std::vector<std::vector<std::size_t>>(blocks);
+  auto next_block = std::atomic<std::size_t>{0};
+  mio::Executor::shared().run_workers(blocks, [&](std::size_t) {
+    for (auto b = next_block.fetch_add(1); b < blocks; b = next_block.fetch_add(1)) {
+      auto &chain = chains[b];
+      const auto end = block_end(b);
+
+      // A start from which the items do not parse past the block is garbage, the next byte is tried.
+      for (auto p = block_begin(b), attempts = std::size_t{0}; p < end && attempts < max_attempts && chain.empty(); p++, attempts++) {
+        chain.assign({p});
+        auto error = std::error_code{};
+        for (auto offset = p; offset < end;) {
+          const auto size = skip(a_bytes.subspan(offset), 1, error);
+          if (error) break;
+          chain.push_back(offset += size);
+        }
+        if (error && b > 0) chain.clear();
+      }
+    }
+  });
+
+  // Joins the chains, skipping again the blocks whose chain the exact one misses.
+  auto position = start;
+  auto phase = std::size_t{0};
+  const auto step = [&](const std::size_t a_next) {
+    position = a_next;
+    if (++phase == items) phase = 0, offsets.push_back(position);
+  };
+
+  for (std::size_t b = 0; b < blocks && offsets.size() <= count; b++) {
+    const auto &chain = chains[b];
+    if (auto hit = std::lower_bound(chain.begin(), chain.end(), position); hit != chain.end() && *hit == position)
+      for (++hit; hit != chain.end() && offsets.size() <= count; ++hit) step(*hit);
+
+    while (offsets.size() <= count && position < block_end(b)) {
+      const auto size = skip(a_bytes.subspan(position), 1, a_ec);
+      if (a_ec) return {};
+      step(position + size);
+    }
+  }
+
+  if (offsets.size() <= count) {
+    a_ec = UnpackerError::OutOfRange;
+    return {};
+  }
+  return offsets;
+}
+
+/*!
+  Unpacks the array at the start of a_bytes into a_values, e.g. a snapshot of millions of link
+  records in a single message, on a_num_threads workers, see index_array(): the elements are
+  constructed first, then unpacked in place, each by its own Unpacker, by the workers claiming
+  chunks of FramedReader::chunk_size elements.
+
+  \returns  the number of bytes of the array, or 0, setting a_ec to the first error, in which case
+             a_values has the elements of the array, some of which may not be unpacked.
+*/
+template<Serializable T, typename AllocatorT>
+std::size_t unpack_array(const std::span<const uint8_t> a_bytes, std::vector<T, AllocatorT> &a_values, std::error_code &a_ec,
+                         const std::size_t a_num_threads = mio::available_concurrency(), const std::size_t a_items = 1)
+{
+  const auto offsets = index_array(a_bytes, a_ec, a_num_threads, a_items);
+  if (a_ec) return 0;
+
+  WXLIB_TRACE_SPAN("msgpack.unpack_array");
+  const auto count = offsets.size() - 1;
+  a_values.clear();
+  a_values.resize(count);
+
+  const auto chunks = (count + FramedReader::chunk_size - 1) / FramedReader::chunk_size;
+  auto next_chunk = std::atomic<std::size_t>{0};
+  auto failed = std::atomic<bool>{false};
+  auto mutex = std::mutex{};
+  auto error = std::error_code{};
+  mio::Executor::shared().run_workers(std::clamp(chunks, std::size_t{1}, std::max(a_num_threads, std::size_t{1})), [&](std::size_t) {
+    for (auto c = next_chunk.fetch_add(1); c < chunks && !failed.load(std::memory_order_relaxed); c = next_chunk.fetch_add(1)) {
+      for (auto i = c * FramedReader::chunk_size; i < std::min(count, (c + 1) * FramedReader::chunk_size); i++) {
+        auto unpacker = Unpacker(a_bytes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        detail::pack_object(a_values[i], unpacker);
+        if (!unpacker.ec) continue;
+
+        const auto lock = std::lock_guard{mutex};
+        if (!error) error = unpacker.ec;
+        failed.store(true);
+        break;
+      }
+    }
+  });
+
+  a_ec = error;
+  return a_ec ? 0 : offsets.back();
+}
+
+}
+#endif
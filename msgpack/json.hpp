@@ -0,0 +1,674 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MSGPACK_JSON_HPP
+#define WXLIB_MSGPACK_JSON_HPP
+
+#include <msgpack/msgpack.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define WXLIB_MSGPACK_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define WXLIB_MSGPACK_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace msgpack {
+
+namespace detail {
+
+/*!
+  Finds the first character of the given range that JSON strings escape, a quote, a backslash or
+  a control character, 16 at a time with SSE2 or NEON, part of the baseline of x86-64 or AArch64.
+*/
+inline const char *find_json_special(const char *a_first, const char *a_last) noexcept
+{
+#if defined(WXLIB_MSGPACK_SSE2)
+  const auto quote = _mm_set1_epi8('"');
+  const auto backslash = _mm_set1_epi8('\\');
+  const auto control = _mm_set1_epi8(0x1F);
+  for (; a_last - a_first >= 16; a_first += 16) {
+    const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_first));
+    // Unsigned chars up to 0x1F are their minimum with 0x1F.
+    const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)),
+                                      _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+    if (const auto mask = unsigned(_mm_movemask_epi8(special)); mask != 0) return a_first + std::countr_zero(mask);
+  }
+#elif defined(WXLIB_MSGPACK_NEON)
+  const auto quote = vdupq_n_u8('"');
+  const auto backslash = vdupq_n_u8('\\');
+  const auto control = vdupq_n_u8(0x20);
+  for (; a_last - a_first >= 16; a_first += 16) {
+    const auto chars = vld1q_u8(reinterpret_cast<const uint8_t *>(a_first));
+    const auto special = vorrq_u8(vorrq_u8(vceqq_u8(chars, quote), vceqq_u8(chars, backslash)), vcltq_u8(chars, control));
+    if (vmaxvq_u8(special) != 0) break;
+  }
+#endif
+  for (; a_first != a_last; ++a_first) {
+    const auto c = uint8_t(*a_first);
+    if (c == '"' || c == '\\' || c < 0x20) return a_first;
+  }
+  return a_last;
+}
+
+/*!
+  Appends the given text as a JSON string, quoted, escaping what JSON requires only.
+*/
+inline void append_json_string(std::string &a_json, const std::string_view a_text)
+{
+  constexpr auto hex = std::string_view{"0123456789abcdef"};
+  a_json += '"';
+  const char *first = a_text.data();
+  const char *last = first + a_text.size();
+  while (first != last) {
+    const char *special = find_json_special(first, last);
+    a_json.append(first, special);
+    if (special == last) break;
+
+    const auto c = uint8_t(*special);
+    switch (c) {
+      case '"': a_json += "\\\""; break;
+      case '\\': a_json += "\\\\"; break;
+      case '\b': a_json += "\\b"; break;
+      case '\f': a_json += "\\f"; break;
+      case '\n': a_json += "\\n"; break;
+      case '\r': a_json += "\\r"; break;
+      case '\t': a_json += "\\t"; break;
+      default: {
+        const char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4U], hex[c & 0x0FU]};
+        a_json.append(escaped, sizeof(escaped));
+      }
+    }
+    first = special + 1;
+  }
+  a_json += '"';
+}
+
+/*!
+  Appends the given bytes as a JSON string of their base64 encoding.
+*/
+inline void append_json_base64(std::string &a_json, const std::span<const uint8_t> a_bytes)
+{
+  constexpr auto digits = std::string_view{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+  a_json += '"';
+  std::size_t i{0};
+  for (; i + 3 <= a_bytes.size(); i += 3) {
+    const uint32_t bits = uint32_t(a_bytes[i]) << 16U | uint32_t(a_bytes[i + 1]) << 8U | a_bytes[i + 2];
+    const char quad[] = {digits[bits >> 18U], digits[bits >> 12U & 0x3FU], digits[bits >> 6U & 0x3FU], digits[bits & 0x3FU]};
+    a_json.append(quad, sizeof(quad));
+  }
+  if (const auto rest = a_bytes.size() - i; rest > 0) {
+    const uint32_t bits = uint32_t(a_bytes[i]) << 16U | (rest > 1 ? uint32_t(a_bytes[i + 1]) << 8U : 0U);
+    const char quad[] = {digits[bits >> 18U], digits[bits >> 12U & 0x3FU], rest > 1 ? digits[bits >> 6U & 0x3FU] : '=', '='};
+    a_json.append(quad, sizeof(quad));
+  }
+  a_json += '"';
+}
+
+/*!
+  A nesting level of the JSON written from msgpack, or read into it.
+*/
+struct JsonLevel
+{
+  std::size_t start;
+  uint64_t items;
+  bool is_map;
+};
+
+/*!
+  The visit() handler writing JSON text.
+*/
+struct JsonWriter
+{
+  std::string &json;
+  std::vector<JsonLevel> &levels;
+  std::error_code &ec;
+  std::size_t values{0};
+
+  /*!
+    Writes the separator of the next item, and returns whether it is a map key.
+  */
+  bool next_item()
+  {
+    if (levels.empty()) {
+      if (values++ > 0) json += '\n';
+      return false;
+    }
+
+    auto &level = levels.back();
+    const auto index = level.items++;
+    if (level.is_map && index % 2 == 1) {
+      json += ':';
+      return false;
+    }
+    if (index > 0) json += ',';
+    return level.is_map;
+  }
+
+  template<typename T>
+  VisitAction number(const T a_value)
+  {
+    const bool is_key = next_item();
+    auto digits = std::array<char, 32>{};
+    auto length = std::size_t{4};
+    if constexpr (std::is_floating_point_v<T>) {
+      // JSON has no NaN nor infinities.
+      if (!std::isfinite(a_value))
+        std::memcpy(digits.data(), "null", length);
+      else
+        length = std::size_t(std::to_chars(digits.data(), digits.data() + digits.size(), a_value).ptr - digits.data());
+    } else {
+      length = std::size_t(std::to_chars(digits.data(), digits.data() + digits.size(), a_value).ptr - digits.data());
+    }
+    literal({digits.data(), length}, is_key);
+    return VisitAction::Continue;
+  }
+
+  // Keys other than strings are quoted.
+  void literal(const std::string_view a_text, const bool a_is_key)
+  {
+    if (a_is_key) json += '"';
+    json += a_text;
+    if (a_is_key) json += '"';
+  }
+
+  VisitAction on_nil()
+  {
+    literal("null", next_item());
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_bool(const bool a_value)
+  {
+    const bool is_key = next_item();
+    literal(a_value ? "true" : "false", is_key);
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_int(const int64_t a_value)
+  {
+    return number(a_value);
+  }
+
+  VisitAction on_uint(const uint64_t a_value)
+  {
+    return number(a_value);
+  }
+
+  VisitAction on_float(const double a_value)
+  {
+    return number(a_value);
+  }
+
+  VisitAction on_str(const std::string_view a_text)
+  {
+    next_item();
+    append_json_string(json, a_text);
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_bin(const std::span<const uint8_t> a_bytes)
+  {
+    next_item();
+    append_json_base64(json, a_bytes);
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_ext(const int8_t a_type, const std::span<const uint8_t> a_bytes)
+  {
+    if (next_item()) return fail();
+    json += "{\"type\":";
+    auto digits = std::array<char, 8>{};
+    json.append(digits.data(), std::to_chars(digits.data(), digits.data() + digits.size(), int(a_type)).ptr);
+    json += ",\"data\":";
+    append_json_base64(json, a_bytes);
+    json += '}';
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_array_begin(const uint64_t /*size*/)
+  {
+    if (next_item()) return fail();
+    json += '[';
+    levels.push_back({0, 0, false});
+    return VisitAction::Continue;
+  }
+
+  VisitAction on_map_begin(const uint64_t /*size*/)
+  {
+    if (next_item()) return fail();
+    json += '{';
+    levels.push_back({0, 0, true});
+    return VisitAction::Continue;
+  }
+
+  void on_array_end()
+  {
+    levels.pop_back();
+    json += ']';
+  }
+
+  void on_map_end()
+  {
+    levels.pop_back();
+    json += '}';
+  }
+
+  // Containers and ext have no JSON form as keys.
+  VisitAction fail()
+  {
+    ec = UnpackerError::DataNotMatchType;
+    return VisitAction::Stop;
+  }
+};
+
+}
+
+/*!
+  Transcodes msgpack to JSON text and back directly, without unpacking into objects, e.g. for
+  the egress to web dashboards and their ingest, into buffers reused across messages.
+
+  msgpack to JSON writes numbers by std::to_chars, in their shortest form reading back the same,
+  NaN and infinities as null, and escapes strings only as JSON requires, finding the characters
+  to escape 16 at a time. Binaries are written as base64 strings, ext as {"type":t,"data":base64}
+  objects, and keys other than strings quoted. Consecutive messages are written one per line.
+
+  JSON to msgpack packs integers in their smallest format, other numbers as float64, and strings
+  as str, viewing the text when there is nothing to unescape. Consecutive values, e.g. JSON lines,
+  are packed one after another.
+
+  Strings are not checked to be valid UTF-8.
+
+  @code
+    msgpack::JsonTranscoder transcoder;
+    std::string json;
+    std::error_code ec;
+    for (const auto &message : messages) {
+      json.clear();
+      transcoder.to_json(message, json, ec);
+      dashboard.send(json);
+    }
+  @endcode
+*/
+class JsonTranscoder
+{
+public:
+  JsonTranscoder() = default;
+  JsonTranscoder(const JsonTranscoder &) = delete;
+  JsonTranscoder &operator=(const JsonTranscoder &) = delete;
+
+  /*!
+    Appends the JSON text of the given msgpack items to a_json.
+
+    \returns  the number of bytes transcoded, less than given on errors, see a_ec, e.g.
+               UnpackerError::DataNotMatchType for a key with no JSON form, such as an array.
+  */
+  std::size_t to_json(const std::span<const uint8_t> a_bytes, std::string &a_json, std::error_code &a_ec)
+  {
+    a_ec.clear();
+    levels_.clear();
+    auto writer = detail::JsonWriter{a_json, levels_, a_ec};
+    return visit(a_bytes, writer, a_ec);
+  }
+
+  /*!
+    Appends the msgpack items of the given JSON values to a_bytes, leaving it as it was on errors.
+
+    \returns  the number of characters transcoded, less than given on errors, see a_ec, e.g.
+               UnpackerError::InvalidJson.
+  */
+  std::size_t from_json(const std::string_view a_json, std::vector<uint8_t> &a_bytes, std::error_code &a_ec)
+  {
+    a_ec.clear();
+    levels_.clear();
+    const auto initial = a_bytes.size();
+    auto packer = BasicPacker<ContainerSink<std::vector<uint8_t>>>{ContainerSink{a_bytes}};
+    const char *position = a_json.data();
+    const char *last = position + a_json.size();
+
+    const auto fail = [&](const UnpackerError a_error) {
+      if (!a_ec) a_ec = a_error;
+      a_bytes.resize(initial);
+      return std::size_t(position - a_json.data());
+    };
+
+    while (true) {
+      position = skip_whitespace(position, last);
+      if (position == last) break;
+
+      // A value, opening a container maybe, with its first key.
+      bool expects_value = false;
+      const auto opened = levels_.size();
+      if (!read_value(position, last, packer, a_bytes)) return fail(UnpackerError::InvalidJson);
+
+      if (levels_.size() > opened) {
+        position = skip_whitespace(position, last);
+        if (position != last && *position == (levels_.back().is_map ? '}' : ']')) {
+          ++position;
+          if (!close(a_bytes, a_ec)) return fail(UnpackerError::InvalidJson);
+        } else {
+          if (levels_.back().is_map && !read_key(position, last, packer)) return fail(UnpackerError::InvalidJson);
+          expects_value = true;
+        }
+      }
+
+      // Then the separators and the ends of the containers, up to the next value.
+      while (!expects_value && !levels_.empty()) {
+        position = skip_whitespace(position, last);
+        if (position == last) return fail(UnpackerError::InvalidJson);
+
+        auto &level = levels_.back();
+        level.items++;
+        if (*position == ',') {
+          ++position;
+          if (level.is_map && !read_key(position, last, packer)) return fail(UnpackerError::InvalidJson);
+          expects_value = true;
+        } else if (*position == (level.is_map ? '}' : ']')) {
+          ++position;
+          if (!close(a_bytes, a_ec)) return fail(UnpackerError::InvalidJson);
+        } else {
+          return fail(UnpackerError::InvalidJson);
+        }
+      }
+
+      if (packer.ec) {
+        a_ec = packer.ec;
+        return fail(UnpackerError::InvalidJson);
+      }
+    }
+
+    // The input ended inside a container, whose header is still a placeholder.
+    if (!levels_.empty()) return fail(UnpackerError::InvalidJson);
+
+    return std::size_t(position - a_json.data());
+  }
+
+private:
+  using JsonPacker = BasicPacker<ContainerSink<std::vector<uint8_t>>>;
+
+  // Room for the largest container header, written once the size is known.
+  static constexpr std::size_t max_header = 1 + sizeof(uint32_t);
+
+  static const char *skip_whitespace(const char *a_first, const char *a_last) noexcept
+  {
+    while (a_first != a_last && (*a_first == ' ' || *a_first == '\n' || *a_first == '\r' || *a_first == '\t')) ++a_first;
+    return a_first;
+  }
+
+  /*!
+    Reads a value, packing it, or opening a container.
+  */
+  bool read_value(const char *&a_position, const char *a_last, JsonPacker &a_packer, std::vector<uint8_t> &a_bytes)
+  {
+    const char c = *a_position;
+    if (c == '[' || c == '{') {
+      ++a_position;
+      levels_.push_back({a_bytes.size(), 0, c == '{'});
+      a_bytes.resize(a_bytes.size() + max_header);
+      return true;
+    }
+
+    if (c == '"') return read_string(a_position, a_last, a_packer);
+    if (c == '-' || (c >= '0' && c <= '9')) return read_number(a_position, a_last, a_packer);
+
+    const auto rest = std::string_view{a_position, std::size_t(a_last - a_position)};
+    if (rest.starts_with("true")) return a_position += 4, a_packer.process(true), true;
+    if (rest.starts_with("false")) return a_position += 5, a_packer.process(false), true;
+    if (rest.starts_with("null")) return a_position += 4, a_packer.process(nullptr), true;
+    return false;
+  }
+
+  /*!
+    Reads a key and its colon.
+  */
+  bool read_key(const char *&a_position, const char *a_last, JsonPacker &a_packer)
+  {
+    a_position = skip_whitespace(a_position, a_last);
+    if (a_position == a_last || *a_position != '"' || !read_string(a_position, a_last, a_packer)) return false;
+    a_position = skip_whitespace(a_position, a_last);
+    if (a_position == a_last || *a_position != ':') return false;
+    ++a_position;
+    return true;
+  }
+
+  bool read_string(const char *&a_position, const char *a_last, JsonPacker &a_packer)
+  {
+    const char *first = ++a_position;
+    const char *special = detail::find_json_special(first, a_last);
+    if (special != a_last && *special == '"') {
+      a_packer.process(std::string_view{first, std::size_t(special - first)});
+      a_position = special + 1;
+      return true;
+    }
+
+    // Unescapes into the scratch text the runs between escapes.
+    text_.clear();
+    while (special != a_last && *special == '\\') {
+      text_.append(first, special);
+      const char *escape = special + 1;
+      if (escape == a_last) return false;
+
+      switch (*escape) {
+        case '"': text_ += '"'; break;
+        case '\\': text_ += '\\'; break;
+        case '/': text_ += '/'; break;
+        case 'b': text_ += '\b'; break;
+        case 'f': text_ += '\f'; break;
+        case 'n': text_ += '\n'; break;
+        case 'r': text_ += '\r'; break;
+        case 't': text_ += '\t'; break;
+        case 'u':
+          if (!read_code_point(escape, a_last)) return false;
+          break;
+        default: return false;
+      }
+
+      first = escape + 1;
+      special = detail::find_json_special(first, a_last);
+      if (special != a_last && *special == '"') {
+        text_.append(first, special);
+        a_packer.process(std::string_view{text_});
+        a_position = special + 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*!
+    Reads the \uXXXX escape at a_escape, or the surrogate pair there, into the text as UTF-8,
+    leaving a_escape at its last digit.
+  */
+  bool read_code_point(const char *&a_escape, const char *a_last)
+  {
+    const auto hex4 = [&](const char *a_digits, uint32_t &a_value) {
+      if (a_last - a_digits < 4) return false;
+      const auto [end, error] = std::from_chars(a_digits, a_digits + 4, a_value, 16);
+      return error == std::errc{} && end == a_digits + 4;
+    };
+
+    uint32_t code{0};
+    if (!hex4(a_escape + 1, code)) return false;
+    a_escape += 4;
+
+    if (code >= 0xD800 && code <= 0xDBFF) {
+      uint32_t low{0};
+      if (a_last - a_escape < 3 || a_escape[1] != '\\' || a_escape[2] != 'u' || !hex4(a_escape + 3, low)) return false;
+      if (low < 0xDC00 || low > 0xDFFF) return false;
+      code = 0x10000 + ((code - 0xD800) << 10U) + (low - 0xDC00);
+      a_escape += 6;
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+      return false;
+    }
+
+    if (code < 0x80) {
+      text_ += char(code);
+    } else if (code < 0x800) {
+      text_ += char(0xC0 | code >> 6U);
+      text_ += char(0x80 | (code & 0x3FU));
+    } else if (code < 0x10000) {
+      text_ += char(0xE0 | code >> 12U);
+      text_ += char(0x80 | (code >> 6U & 0x3FU));
+      text_ += char(0x80 | (code & 0x3FU));
+    } else {
+      text_ += char(0xF0 | code >> 18U);
+      text_ += char(0x80 | (code >> 12U & 0x3FU));
+      text_ += char(0x80 | (code >> 6U & 0x3FU));
+      text_ += char(0x80 | (code & 0x3FU));
+    }
+    return true;
+  }
+
+  static bool read_number(const char *&a_position, const char *a_last, JsonPacker &a_packer)
+  {
+    const auto digits = [&](const char *a_first) {
+      while (a_first != a_last && *a_first >= '0' && *a_first <= '9') ++a_first;
+      return a_first;
+    };
+
+    // Checks the JSON grammar first, which std::from_chars is looser than.
+    const char *first = a_position;
+    const char *p = first + (*first == '-' ? 1 : 0);
+    const char *integral = digits(p);
+    if (integral == p || (*p == '0' && integral - p > 1)) return false;
+
+    p = integral;
+    bool is_integer = true;
+    if (p != a_last && *p == '.') {
+      const char *fraction = digits(p + 1);
+      if (fraction == p + 1) return false;
+      p = fraction;
+      is_integer = false;
+    }
+    const char *mantissa = p;
+    if (p != a_last && (*p == 'e' || *p == 'E')) {
+      const char *sign = p + 1;
+      if (sign != a_last && (*sign == '+' || *sign == '-')) ++sign;
+      const char *exponent = digits(sign);
+      if (exponent == sign) return false;
+      p = exponent;
+      is_integer = false;
+    }
+    a_position = p;
+
+    if (is_integer) {
+      // Negative integers in the smallest signed type, which packs them in the smallest format.
+      if (*first == '-') {
+        int64_t value{0};
+        if (std::from_chars(first, p, value).ec == std::errc{}) {
+          if (value >= limits<int8_t>::min())
+            a_packer.process(int8_t(value));
+          else if (value >= limits<int16_t>::min())
+            a_packer.process(int16_t(value));
+          else if (value >= limits<int32_t>::min())
+            a_packer.process(int32_t(value));
+          else
+            a_packer.process(value);
+          return true;
+        }
+      } else {
+        uint64_t value{0};
+        if (std::from_chars(first, p, value).ec == std::errc{}) return a_packer.process(value), true;
+      }
+    }
+
+    // Other numbers, and integers out of the range of 64 bits.
+    double value{0};
+    const auto [end, error] = std::from_chars(first, p, value);
+    if (error == std::errc::result_out_of_range) {
+      // Too large or too small for a double, by the decimal exponent of the leading digit, e.g.
+      // -3 for 0.001e0 and 0.1e-2 alike, the exponent saturating far beyond the range of doubles.
+      const char *leading = std::find_if(first, mantissa, [](const char a_c) { return a_c >= '1' && a_c <= '9'; });
+      auto magnitude = leading < integral ? int64_t(integral - leading - 1) : -int64_t(leading - integral);
+      if (mantissa != p) {
+        const char *digit = mantissa + 1;
+        const bool negative = *digit == '-';
+        if (*digit == '+' || *digit == '-') ++digit;
+        int64_t exponent{0};
+        for (; digit != p && exponent < 1'000'000; ++digit) exponent = exponent * 10 + (*digit - '0');
+        magnitude += negative ? -exponent : exponent;
+      }
+      value = magnitude < 0 ? 0.0 : std::numeric_limits<double>::infinity();
+      if (*first == '-') value = -value;
+    } else if (error != std::errc{}) {
+      return false;
+    }
+    a_packer.process(value);
+    return end == p;
+  }
+
+  /*!
+    Writes the header of the container just read, and moves its items up to it.
+  */
+  bool close(std::vector<uint8_t> &a_bytes, std::error_code &a_ec)
+  {
+    const auto level = levels_.back();
+    levels_.pop_back();
+    if (level.items > limits<uint32_t>::max()) {
+      a_ec = PackerError::LengthError;
+      return false;
+    }
+
+    const auto size = uint32_t(level.items);
+    auto header = std::array<uint8_t, max_header>{};
+    std::size_t length{1};
+    if (size < 16) {
+      header[0] = uint8_t((level.is_map ? 0x80 : 0x90) | size);
+    } else {
+      const bool wide = size > limits<uint16_t>::max();
+      length = wide ? 5 : 3;
+      header[0] = level.is_map ? (wide ? FormatConstants::map32 : FormatConstants::map16) : (wide ? FormatConstants::array32 : FormatConstants::array16);
+      for (std::size_t i = 1; i < length; i++) header[i] = uint8_t(size >> (8U * (length - 1 - i)));
+    }
+
+    auto *data = a_bytes.data() + level.start;
+    const auto items = a_bytes.size() - level.start - max_header;
+    std::memcpy(data, header.data(), length);
+    std::memmove(data + length, data + max_header, items);
+    a_bytes.resize(level.start + length + items);
+    return true;
+  }
+
+  std::vector<detail::JsonLevel> levels_;
+  std::string text_;
+};
+
+/*!
+  Returns the JSON text of the given msgpack items, see JsonTranscoder::to_json.
+*/
+inline std::string to_json(const std::span<const uint8_t> a_bytes, std::error_code &a_ec)
+{
+  auto json = std::string{};
+  JsonTranscoder{}.to_json(a_bytes, json, a_ec);
+  return json;
+}
+
+/*!
+  Returns the msgpack items of the given JSON values, see JsonTranscoder::from_json.
+*/
+inline std::vector<uint8_t> from_json(const std::string_view a_json, std::error_code &a_ec)
+{
+  auto bytes = std::vector<uint8_t>{};
+  JsonTranscoder{}.from_json(a_json, bytes, a_ec);
+  return bytes;
+}
+
+}
+#endif
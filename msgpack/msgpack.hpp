@@ -11,17 +11,29 @@
 #ifndef WXLIB_MSGPACK_HPP
 #define WXLIB_MSGPACK_HPP
 
+#include <algorithm>
 #include <array>
-#include <bitset>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <concepts>
+#include <cstring>
+#include <deque>
 #include <list>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <matchit/matchit.hpp>
+#include <mio/trace.hpp>
 
 namespace msgpack {
 
@@ -35,12 +47,14 @@ enum class UnpackerError
   OutOfRange = 1,
   IntegerOverflow = 2,
   DataNotMatchType = 3,
-  BadStdArraySize = 4
+  BadStdArraySize = 4,
+  InvalidJson = 5
 };
 
 enum class PackerError
 {
-  LengthError = 1
+  LengthError = 1,
+  SinkError = 2
 };
 
 struct UnpackerErrorCategory : public std::error_category
@@ -59,6 +73,7 @@ public:
         pattern | UnpackerError::IntegerOverflow  = expr("data overflows specified integer type"),
         pattern | UnpackerError::DataNotMatchType = expr("data does not match type of object"),
         pattern | UnpackerError::BadStdArraySize  = expr("data has a different size than specified std::array object"),
+        pattern | UnpackerError::InvalidJson      = expr("text is not valid JSON"),
         pattern | _                               = expr("(unrecognized error)")
     );
     //@formatter:on
@@ -78,6 +93,7 @@ public:
     // @formatter:off
     return match(static_cast<msgpack::PackerError>(ev)) (
       pattern | PackerError::LengthError = expr("length of map, array, string or binary data exceeding 2^32 -1 elements"),
+      pattern | PackerError::SinkError   = expr("output sink of packer is full or failed to write"),
       pattern | _                        = expr("(unrecognized error)")
     );
     // @formatter:on
@@ -157,6 +173,63 @@ enum FormatConstants : uint8_t
   map32 = 0xDF
 };
 
+/*!
+  How objects nested in objects are serialized. Inline packs their members in place, in the
+  buffer of the enclosing object. Binary wraps them in a bin blob, as earlier versions did, for
+  exchanging data with those.
+*/
+enum class NestedFormat
+{
+  Inline,
+  Binary
+};
+
+/*!
+  How floating point values are packed. Exact packs them as float32 or float64, as their type.
+  CompactIntegral packs those with an integral value, e.g. 3.0, as the shortest integer instead,
+  as earlier versions did, losing the sign of -0.0.
+*/
+enum class FloatFormat
+{
+  Exact,
+  CompactIntegral
+};
+
+/*!
+  How vectors and std::arrays of numbers are packed. Generic packs them as msgpack arrays,
+  element by element. Typed packs them as an ext blob of TypedArrayExt type, holding the
+  little-endian elements, copied in bulk, which other msgpack libraries read as opaque ext.
+*/
+enum class ArrayFormat
+{
+  Generic,
+  Typed
+};
+
+/*!
+  Ext types of typed arrays, see ArrayFormat::Typed.
+*/
+enum TypedArrayExt : uint8_t
+{
+  int8_array = 0x10,
+  uint8_array = 0x11,
+  int16_array = 0x12,
+  uint16_array = 0x13,
+  int32_array = 0x14,
+  uint32_array = 0x15,
+  int64_array = 0x16,
+  uint64_array = 0x17,
+  float32_array = 0x18,
+  float64_array = 0x19
+};
+
+struct PackerOptions
+{
+  NestedFormat nested_format{NestedFormat::Inline};
+  FloatFormat float_format{FloatFormat::Exact};
+  ArrayFormat array_format{ArrayFormat::Generic};
+};
+
 template<typename T>
 struct is_stdvector : std::false_type
 {
@@ -182,13 +255,13 @@ struct is_stdmap : std::false_type
 {
 };
 
-template<typename T, typename A>
-struct is_stdmap<std::map<T, A>> : std::true_type
+template<typename K, typename V, typename C, typename A>
+struct is_stdmap<std::map<K, V, C, A>> : std::true_type
 {
 };
 
-template<typename T, typename A>
-struct is_stdmap<std::unordered_map<T, A>> : std::true_type
+template<typename K, typename V, typename H, typename E, typename A>
+struct is_stdmap<std::unordered_map<K, V, H, E, A>> : std::true_type
 {
 };
 
@@ -197,59 +270,899 @@ struct is_stdset : std::false_type
 {
 };
 
-template<typename T, typename A>
-struct is_stdset<std::set<T, A>> : std::true_type
-{
-};
+template<typename T, typename C, typename A>
+struct is_stdset<std::set<T, C, A>> : std::true_type
+{
+};
+
+template<typename T>
+struct is_stdarray : std::false_type
+{
+};
+
+template<typename T, std::size_t N>
+struct is_stdarray<std::array<T, N>> : std::true_type
+{
+};
+
+template<typename T>
+concept MsgPackIntegral = std::is_integral_v<T> && sizeof(T) <= 8;
+
+template<typename T>
+concept MsgPackMap = is_stdmap<T>::value;
+
+template<typename T>
+concept MsgPackBinaryView = std::same_as<T, std::span<const uint8_t>>;
+
+template<typename T>
+concept MsgPackBinary = (is_stdvector<T>::value && std::same_as<typename T::value_type, uint8_t>) || MsgPackBinaryView<T>;
+
+template<typename T>
+concept MsgPackArray = (!MsgPackBinary<T>)
+    && (is_stdarray<T>::value
+        || is_stdvector<T>::value
+        || is_stdlist<T>::value
+        || is_stdset<T>::value);
+
+template<typename T>
+concept MsgPackArrayOrMap = MsgPackArray<T> || MsgPackMap<T>;
+
+/*!
+  Contiguous arrays of fixed-width numbers, which can be packed as typed arrays.
+*/
+template<typename T>
+concept MsgPackTypedArray = MsgPackArray<T>
+    && (is_stdarray<T>::value || is_stdvector<T>::value)
+    && std::is_arithmetic_v<typename T::value_type>
+    && (!std::same_as<typename T::value_type, bool>)
+    && (sizeof(typename T::value_type) <= 8)
+    && (std::is_integral_v<typename T::value_type>
+        || (sizeof(typename T::value_type) >= 4 && limits<typename T::value_type>::is_iec559));
+
+/*!
+  The ext type of the typed array of the given element type.
+*/
+template<typename T>
+constexpr uint8_t typed_array_ext()
+{
+  if constexpr (std::is_floating_point_v<T>)
+    return sizeof(T) == 4 ? float32_array : float64_array;
+  else
+    return uint8_t(int8_array + 2 * std::countr_zero(sizeof(T)) + (std::is_unsigned_v<T> ? 1 : 0));
+}
+
+/*!
+  Copies elements from or to little-endian bytes, swapping them on big-endian hosts.
+*/
+template<typename T>
+void copy_little_endian(void *a_to, const void *a_from, const size_t a_count)
+{
+  if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+    std::memcpy(a_to, a_from, a_count * sizeof(T));
+  } else {
+    using int_t = std::conditional_t<sizeof(T) == 2, uint16_t,
+                                     std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+    auto *to = static_cast<uint8_t *>(a_to);
+    const auto *from = static_cast<const uint8_t *>(a_from);
+    for (size_t i = 0; i < a_count; ++i, to += sizeof(T), from += sizeof(T)) {
+      int_t value;
+      std::memcpy(&value, from, sizeof(T));
+      value = std::byteswap(value);
+      std::memcpy(to, &value, sizeof(T));
+    }
+  }
+}
+
+template<typename T>
+concept MsgPackStringView = std::same_as<T, std::string_view>;
+
+template<typename T>
+struct is_stdstring : std::false_type
+{
+};
+
+template<typename Traits, typename A>
+struct is_stdstring<std::basic_string<char, Traits, A>> : std::true_type
+{
+};
+
+template<typename T>
+concept MsgPackString = is_stdstring<T>::value || MsgPackStringView<T>;
+
+template<typename T>
+concept MsgPackStringOrBinary = MsgPackString<T> || MsgPackBinary<T>;
+
+template<typename T>
+concept MsgPackFloatingPoint = std::is_floating_point_v<T>
+    && (sizeof(T) == 4 || sizeof(T) == 8)
+    && (limits<T>::radix == 2);
+
+#pragma region - Extension types
+
+/*!
+  Registers a type packed as a msgpack ext, by a specialization declaring its ext type code
+  and how its payload is encoded and decoded:
+
+  @code
+    template<>
+    struct msgpack::ExtTraits<Polyline> {
+      static constexpr int8_t type = 1;
+      static size_t size(const Polyline &a_line) { return a_line.points.size() * sizeof(Point); }
+      static void encode(const Polyline &a_line, auto &&a_write) {
+        a_write(reinterpret_cast<const uint8_t *>(a_line.points.data()), size(a_line));
+      }
+      static bool decode(std::span<const uint8_t> a_payload, Polyline &a_line) { ... }
+    };
+  @endcode
+
+  encode() passes the payload, of size() bytes in all, to the writer in one or more calls, and
+  decode() returns false if the payload is not valid. Codes 0x10 to 0x19 are those of typed
+  arrays, see TypedArrayExt, 0x20 to 0x22 those of the series of msgpack/series.hpp, and negative
+  ones are reserved by msgpack, e.g. Timestamp.
+*/
+template<typename T>
+struct ExtTraits;
+
+namespace detail {
+
+/*!
+  An archetype of the writers passed to ExtTraits::encode().
+*/
+struct ExtWriter
+{
+  void operator()(const uint8_t * /*bytes*/, size_t /*size*/) const
+  {};
+};
+
+/*!
+  Stores the value big-endian at the given bytes.
+*/
+template<std::unsigned_integral U>
+void store_big_endian(const U a_value, uint8_t *a_bytes)
+{
+  const U big_endian = (std::endian::native == std::endian::little) ? std::byteswap(a_value) : a_value;
+  std::memcpy(a_bytes, &big_endian, sizeof(U));
+}
+
+/*!
+  The widths of the integer fields, by the number of significant bytes.
+*/
+constexpr auto integer_widths = std::array<uint8_t, 9>{1, 1, 2, 4, 4, 8, 8, 8, 8};
+
+template<std::unsigned_integral U>
+U load_big_endian(const uint8_t *a_bytes)
+{
+  U value;
+  std::memcpy(&value, a_bytes, sizeof(U));
+  return (std::endian::native == std::endian::little) ? std::byteswap(value) : value;
+}
+
+}
+
+template<typename T>
+concept MsgPackExt = requires(const T &value, T &result, std::span<const uint8_t> payload) {
+  { ExtTraits<T>::type } -> std::convertible_to<int8_t>;
+  { ExtTraits<T>::size(value) } -> std::convertible_to<size_t>;
+  ExtTraits<T>::encode(value, detail::ExtWriter{});
+  { ExtTraits<T>::decode(payload, result) } -> std::same_as<bool>;
+};
+
+/*!
+  Enums without ExtTraits are packed as their underlying integer, so flag sets and other
+  enums declared through meta_enum take no more bytes than the value they hold.
+*/
+template<typename T>
+concept MsgPackEnum = std::is_enum_v<T> && !MsgPackExt<T>;
+
+/*!
+  Enums with a codec found by argument dependent lookup, as those given one by meta_enum_codec,
+  are packed as the index of their member instead, 1 byte for enums of up to 128 members,
+  whatever their values; unpacking an index past the last member is a DataNotMatchType error.
+*/
+template<typename T>
+concept MsgPackIndexedEnum = MsgPackEnum<T> && requires(const T &value) {
+  { enum_codec_of(value).index_of(value) } -> std::convertible_to<size_t>;
+  { *enum_codec_of(value).from_index(size_t{}) } -> std::convertible_to<T>;
+};
+
+/*!
+  A point in time as seconds and nanoseconds since the Unix epoch, packed as the msgpack
+  timestamp ext, type -1, which other msgpack libraries read as their native time type.
+  std::chrono::system_clock time points unpack from it as well.
+*/
+struct Timestamp
+{
+  int64_t seconds{0};
+  uint32_t nanoseconds{0};
+
+  template<typename DurationT>
+  static Timestamp from(const std::chrono::sys_time<DurationT> a_time)
+  {
+    const auto seconds = std::chrono::floor<std::chrono::seconds>(a_time);
+    return {seconds.time_since_epoch().count(),
+            uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(a_time - seconds).count())};
+  }
+
+  [[nodiscard]] std::chrono::sys_time<std::chrono::nanoseconds> time_point() const
+  {
+    return std::chrono::sys_seconds{std::chrono::seconds{seconds}} + std::chrono::nanoseconds{nanoseconds};
+  }
+
+  bool operator==(const Timestamp &) const = default;
+};
+
+template<>
+struct ExtTraits<Timestamp>
+{
+  static constexpr int8_t type = -1;
+
+  /*!
+    The timestamp 32, 64 or 96 format, the shortest holding the value.
+  */
+  static size_t size(const Timestamp &a_value)
+  {
+    if ((uint64_t(a_value.seconds) >> 34U) != 0) return 12;
+    return (a_value.nanoseconds == 0 && (uint64_t(a_value.seconds) >> 32U) == 0) ? 4 : 8;
+  }
+
+  template<typename WriterT>
+  static void encode(const Timestamp &a_value, WriterT &&a_write)
+  {
+    auto bytes = std::array<uint8_t, 12>{};
+    const auto size = ExtTraits::size(a_value);
+    if (size == 4) {
+      detail::store_big_endian(uint32_t(a_value.seconds), bytes.data());
+    } else if (size == 8) {
+      detail::store_big_endian((uint64_t(a_value.nanoseconds) << 34U) | uint64_t(a_value.seconds), bytes.data());
+    } else {
+      detail::store_big_endian(a_value.nanoseconds, bytes.data());
+      detail::store_big_endian(uint64_t(a_value.seconds), bytes.data() + 4);
+    }
+    a_write(bytes.data(), size);
+  }
+
+  static bool decode(const std::span<const uint8_t> a_payload, Timestamp &a_value)
+  {
+    if (a_payload.size() == 4) {
+      a_value = {int64_t(detail::load_big_endian<uint32_t>(a_payload.data())), 0};
+    } else if (a_payload.size() == 8) {
+      const auto value = detail::load_big_endian<uint64_t>(a_payload.data());
+      a_value = {int64_t(value & 0x3FFFFFFFFULL), uint32_t(value >> 34U)};
+    } else if (a_payload.size() == 12) {
+      a_value = {int64_t(detail::load_big_endian<uint64_t>(a_payload.data() + 4)),
+                 detail::load_big_endian<uint32_t>(a_payload.data())};
+    } else {
+      return false;
+    }
+    return a_value.nanoseconds < 1000000000U;
+  }
+};
+
+#pragma endregion
+
+#pragma region - Reflection
+
+namespace detail {
+
+/*!
+  Converts to a field of any type, in unevaluated aggregate initializations counting fields.
+*/
+struct AnyField
+{
+  template<typename T>
+  operator T &() const;
+};
+
+/*!
+  The number of fields of an aggregate, the most initializers it takes.
+*/
+template<typename T, typename ... Fields>
+constexpr std::size_t field_count()
+{
+  if constexpr (requires { T{Fields{}..., AnyField{}}; })
+    return field_count<T, Fields..., AnyField>();
+  else
+    return sizeof...(Fields);
+}
+
+constexpr std::size_t max_reflected_fields = 16;
+
+/*!
+  Calls the visitor with references to the fields of the aggregate, in declaration order.
+*/
+template<typename T, typename VisitorT>
+constexpr decltype(auto) visit_fields(T &a_object, VisitorT &&a_visitor)
+{
+  constexpr auto count = field_count<std::remove_cv_t<T>>();
+  static_assert(count >= 1 && count <= max_reflected_fields);
+  if constexpr (count == 1) {
+    auto &[m1] = a_object;
+    return a_visitor(m1);
+  }
+  else if constexpr (count == 2) {
+    auto &[m1, m2] = a_object;
+    return a_visitor(m1, m2);
+  }
+  else if constexpr (count == 3) {
+    auto &[m1, m2, m3] = a_object;
+    return a_visitor(m1, m2, m3);
+  }
+  else if constexpr (count == 4) {
+    auto &[m1, m2, m3, m4] = a_object;
+    return a_visitor(m1, m2, m3, m4);
+  }
+  else if constexpr (count == 5) {
+    auto &[m1, m2, m3, m4, m5] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5);
+  }
+  else if constexpr (count == 6) {
+    auto &[m1, m2, m3, m4, m5, m6] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6);
+  }
+  else if constexpr (count == 7) {
+    auto &[m1, m2, m3, m4, m5, m6, m7] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7);
+  }
+  else if constexpr (count == 8) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8);
+  }
+  else if constexpr (count == 9) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9);
+  }
+  else if constexpr (count == 10) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10);
+  }
+  else if constexpr (count == 11) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11);
+  }
+  else if constexpr (count == 12) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12);
+  }
+  else if constexpr (count == 13) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13);
+  }
+  else if constexpr (count == 14) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14);
+  }
+  else if constexpr (count == 15) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15);
+  }
+  else if constexpr (count == 16) {
+    auto &[m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15, m16] = a_object;
+    return a_visitor(m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15, m16);
+  }
+}
+
+}
+
+/*!
+  Aggregates without a pack() method, packed field by field in declaration order, like a pack()
+  method passing all fields. They must not have base classes or C arrays, and have at most
+  detail::max_reflected_fields fields.
+*/
+template<typename T>
+concept MsgPackReflectable = std::is_aggregate_v<T>
+    && std::is_class_v<T>
+    && (!is_stdarray<T>::value)
+    && (detail::field_count<T>() >= 1)
+    && (detail::field_count<T>() <= detail::max_reflected_fields);
+
+/*!
+  A string literal as a template argument, e.g. the key of a MapField.
+*/
+template<std::size_t N>
+struct FieldName
+{
+  constexpr FieldName(const char (&a_name)[N])
+  {
+    std::copy_n(a_name, N, name);
+  }
+
+  [[nodiscard]] constexpr std::string_view view() const
+  {
+    return {name, N - 1};
+  }
+
+  char name[N]{};
+};
+
+/*!
+  A member packed as the value of the key Name of a map, see MapTraits.
+*/
+template<FieldName Name, auto Member>
+struct MapField
+{
+  static constexpr std::string_view key = Name.view();
+  static constexpr auto member = Member;
+};
+
+template<typename ... Fields>
+struct MapFields
+{
+  static_assert(sizeof...(Fields) <= 0xFFFF, "Too many map fields.");
+};
+
+/*!
+  Registers a type packed as a msgpack map keyed by the names of its fields, e.g. for partners
+  sending maps, by a specialization listing them:
+
+  @code
+    template<>
+    struct msgpack::MapTraits<Link> {
+      using fields = msgpack::MapFields<
+          msgpack::MapField<"id", &Link::id>,
+          msgpack::MapField<"name", &Link::name>,
+          msgpack::MapField<"speed", &Link::speed>>;
+    };
+  @endcode
+
+  The fields are packed in the order listed. Unpacking looks each key up in place, among the
+  fields of its length, comparing it with their names of known length, with no allocation;
+  values of unknown keys are skipped, and fields of missing keys left as they are.
+*/
+template<typename T>
+struct MapTraits;
+
+template<typename T>
+concept MsgPackMapObject = requires { typename MapTraits<T>::fields; };
+
+namespace detail {
+
+/*!
+  Packs or unpacks the object as a map if it has MapTraits, by its pack() method, or field by
+  field if it has none.
+*/
+template<typename T, typename ProcessorT>
+void pack_object(T &a_object, ProcessorT &a_processor)
+{
+  if constexpr (MsgPackMapObject<std::remove_const_t<T>>)
+    a_processor.process_map(a_object);
+  else if constexpr (requires { a_object.pack(a_processor); })
+    a_object.pack(a_processor);
+  else
+    visit_fields(a_object, [&](auto &... a_fields) { a_processor.process(a_fields...); });
+}
+
+}
+
+#pragma endregion
+
+#pragma region - Packer sinks
+
+/*!
+  An output sink of BasicPacker, appending packed bytes, and returning false if it is full or
+  failed to write, which fails packing with PackerError::SinkError.
+
+  A sink may also pre-allocate (`reserve_ahead`), and reference large strings and binaries in
+  place instead of copying them (`append_external`).
+*/
+template<typename SinkT>
+concept PackerSink = requires(SinkT &sink, const uint8_t *bytes, size_t size) {
+  { sink.append(bytes, size) } -> std::same_as<bool>;
+};
+
+/*!
+  A sink holding the packed bytes contiguously, that nested objects packed as binary blobs
+  (NestedFormat::Binary) are written into in place.
+*/
+template<typename SinkT>
+concept ContiguousPackerSink = PackerSink<SinkT> && requires(SinkT &sink, size_t size) {
+  { sink.data() } -> std::same_as<uint8_t *>;
+  { sink.size() } -> std::convertible_to<size_t>;
+  sink.truncate(size);
+};
+
+/*!
+  Appends to a caller owned container of bytes, e.g. a reusable std::vector, or a std::pmr::vector
+  allocating from an arena.
+*/
+template<typename ContainerT>
+class ContainerSink
+{
+public:
+  explicit ContainerSink(ContainerT &a_container) : container_(&a_container)
+  {};
+
+  bool append(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (a_size == 0) return true;
+    const auto size = container_->size();
+    container_->resize(size + a_size);
+    std::memcpy(container_->data() + size, a_bytes, a_size);
+    return true;
+  }
+
+  /*!
+    Makes room for the given number of bytes at the end, growing geometrically.
+  */
+  void reserve_ahead(const size_t a_bytes)
+  {
+    const auto size = container_->size();
+    if (container_->capacity() - size < a_bytes)
+      container_->reserve(std::max(container_->capacity() * 2, size + a_bytes));
+  }
+
+  void reserve(const size_t a_bytes)
+  {
+    container_->reserve(a_bytes);
+  }
+
+  uint8_t *data()
+  {
+    return reinterpret_cast<uint8_t *>(container_->data());
+  }
+
+  [[nodiscard]] size_t size() const
+  {
+    return container_->size();
+  }
+
+  void truncate(const size_t a_size)
+  {
+    container_->resize(a_size);
+  }
+
+  void clear()
+  {
+    container_->clear();
+  }
+
+  ContainerT &container() const
+  {
+    return *container_;
+  }
+
+private:
+  ContainerT *container_;
+};
+
+/*!
+  Appends to a std::vector of its own, the default sink of Packer.
+*/
+class VectorSink : public ContainerSink<std::vector<uint8_t>>
+{
+public:
+  VectorSink() : ContainerSink<std::vector<uint8_t>>(buffer_)
+  {};
+
+  VectorSink(const VectorSink &) = delete;
+  VectorSink &operator=(const VectorSink &) = delete;
+
+  // The base keeps pointing at the buffer of its own sink.
+  VectorSink(VectorSink &&a_other) noexcept : ContainerSink<std::vector<uint8_t>>(buffer_), buffer_(std::move(a_other.buffer_))
+  {};
+
+  VectorSink &operator=(VectorSink &&a_other) noexcept
+  {
+    buffer_ = std::move(a_other.buffer_);
+    return *this;
+  }
+
+  const std::vector<uint8_t> &vector() const
+  {
+    return buffer_;
+  }
+
+  /*!
+    Moves the buffer out, leaving the sink empty, with no capacity.
+  */
+  std::vector<uint8_t> release() noexcept
+  {
+    return std::exchange(buffer_, {});
+  }
+
+  /*!
+    Takes a buffer to pack into, e.g. one released before, cleared but keeping its capacity.
+  */
+  void assign(std::vector<uint8_t> &&a_buffer) noexcept
+  {
+    buffer_ = std::move(a_buffer);
+    buffer_.clear();
+  }
+
+private:
+  std::vector<uint8_t> buffer_;
+};
+
+/*!
+  Writes into fixed caller storage, e.g. a message slot, or a mio::mmap_sink mapping, failing
+  with PackerError::SinkError if the packed object does not fit. Objects nested as binary blobs
+  (NestedFormat::Binary) take up to 4 more bytes per level while packed.
+
+  @code
+    auto packer = msgpack::BasicPacker{msgpack::SpanSink{std::span{slot}}};
+    object.pack(packer);
+    if (!packer.ec) send(packer.sink().written());
+  @endcode
+*/
+class SpanSink
+{
+public:
+  explicit SpanSink(const std::span<uint8_t> a_buffer) : buffer_(a_buffer)
+  {};
+
+  bool append(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (a_size > buffer_.size() - size_) return false;
+    if (a_size > 0) std::memcpy(buffer_.data() + size_, a_bytes, a_size);
+    size_ += a_size;
+    return true;
+  }
+
+  uint8_t *data()
+  {
+    return buffer_.data();
+  }
+
+  [[nodiscard]] size_t size() const
+  {
+    return size_;
+  }
+
+  [[nodiscard]] size_t capacity() const
+  {
+    return buffer_.size();
+  }
+
+  void truncate(const size_t a_size)
+  {
+    size_ = std::min(size_, a_size);
+  }
+
+  void clear()
+  {
+    size_ = 0;
+  }
+
+  /*!
+    The bytes written so far.
+  */
+  [[nodiscard]] std::span<const uint8_t> written() const
+  {
+    return buffer_.first(size_);
+  }
+
+private:
+  std::span<uint8_t> buffer_;
+  size_t size_{0};
+};
+
+/*!
+  Counts the packed bytes without storing them, for measuring the size of a message before
+  packing it, see encoded_size().
+*/
+class CountingSink
+{
+public:
+  bool append(const uint8_t * /*bytes*/, const size_t a_size)
+  {
+    return count(a_size), true;
+  }
+
+  void count(const size_t a_size)
+  {
+    written_ += a_size;
+  }
+
+  void clear()
+  {
+    written_ = 0;
+  }
+
+  /*!
+    The number of bytes counted so far.
+  */
+  [[nodiscard]] size_t written() const
+  {
+    return written_;
+  }
+
+private:
+  size_t written_{0};
+};
+
+/*!
+  Gathers the packed bytes as a list of segments for a scatter-gather write, e.g. writev or
+  WSASend, copying small fields into chunks of its own, and referencing strings and binaries
+  from `external_threshold` bytes on in place. Referenced segments are valid as long as the
+  packed object is, and all segments until the sink is cleared.
+*/
+class ScatterSink
+{
+public:
+  static constexpr size_t chunk_size = 4096;
+  static constexpr size_t external_threshold = 512;
+
+  ScatterSink() = default;
+  ScatterSink(const ScatterSink &) = delete;
+  ScatterSink &operator=(const ScatterSink &) = delete;
+  ScatterSink(ScatterSink &&) = default;
+  ScatterSink &operator=(ScatterSink &&) = default;
+
+  bool append(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (a_size == 0) return true;
+
+    if (chunk_ == chunks_.size() || a_size > chunk_capacity(chunk_) - chunk_used_) {
+      // Reuses the chunks of a cleared sink, else allocates one.
+      while (chunk_ < chunks_.size() && a_size > chunk_capacity(chunk_) - chunk_used_) chunk_++, chunk_used_ = 0;
+      if (chunk_ == chunks_.size()) chunks_.emplace_back(std::max(chunk_size, a_size));
+    }
+
+    auto *destination = chunks_[chunk_].data() + chunk_used_;
+    std::memcpy(destination, a_bytes, a_size);
+    chunk_used_ += a_size;
+    add_segment(destination, a_size);
+    return true;
+  }
+
+  bool append_external(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (a_size < external_threshold) return append(a_bytes, a_size);
+    segments_.emplace_back(a_bytes, a_size);
+    size_ += a_size;
+    return true;
+  }
+
+  [[nodiscard]] const std::vector<std::span<const uint8_t>> &segments() const
+  {
+    return segments_;
+  }
+
+  /*!
+    Total size in bytes of the segments.
+  */
+  [[nodiscard]] size_t size() const
+  {
+    return size_;
+  }
+
+  void clear()
+  {
+    segments_.clear();
+    size_ = 0;
+    chunk_ = 0;
+    chunk_used_ = 0;
+  }
+
+private:
+  [[nodiscard]] size_t chunk_capacity(const size_t a_chunk) const
+  {
+    return chunks_[a_chunk].size();
+  }
+
+  void add_segment(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (!segments_.empty() && segments_.back().data() + segments_.back().size() == a_bytes)
+      segments_.back() = {segments_.back().data(), segments_.back().size() + a_size};
+    else
+      segments_.emplace_back(a_bytes, a_size);
+    size_ += a_size;
+  }
 
-template<typename T>
-struct is_stdarray : std::false_type
-{
+  std::vector<std::vector<uint8_t>> chunks_;
+  size_t chunk_{0};
+  size_t chunk_used_{0};
+  std::vector<std::span<const uint8_t>> segments_;
+  size_t size_{0};
 };
 
-template<typename T, std::size_t N>
-struct is_stdarray<std::array<T, N>> : std::true_type
+/*!
+  Buffers the packed bytes, and hands them to the writer, e.g. writing to a socket, whenever the
+  buffer fills, and on flush(). The writer takes a std::span<const uint8_t> and returns whether
+  it wrote it all. Large appends bypass the buffer.
+
+  @code
+    auto packer = msgpack::BasicPacker{msgpack::StreamSink{[&](std::span<const uint8_t> a_bytes) {
+      return ::send(socket, a_bytes.data(), a_bytes.size(), 0) == a_bytes.size();
+    }}};
+    object.pack(packer);
+    packer.sink().flush();
+  @endcode
+*/
+template<typename WriterT>
+requires std::is_invocable_r_v<bool, WriterT &, std::span<const uint8_t>>
+class StreamSink
 {
-};
+public:
+  static constexpr size_t default_buffer_size = size_t{64} << 10;
 
-template<typename T>
-concept MsgPackIntegral = std::is_integral_v<T> && sizeof(T) <= 8;
+  explicit StreamSink(WriterT a_writer, const size_t a_buffer_size = default_buffer_size)
+      : writer_(std::move(a_writer)), capacity_(std::max<size_t>(a_buffer_size, 16))
+  {
+    buffer_.reserve(capacity_);
+  }
 
-template<typename T>
-concept MsgPackMap = is_stdmap<T>::value;
+  bool append(const uint8_t *a_bytes, const size_t a_size)
+  {
+    if (a_size > capacity_ - buffer_.size()) {
+      if (!flush()) return false;
+      if (a_size >= capacity_) return write({a_bytes, a_size});
+    }
 
-template<typename T>
-concept MsgPackBinary = std::same_as<T, std::vector<uint8_t>>;
+    buffer_.insert(buffer_.end(), a_bytes, a_bytes + a_size);
+    return true;
+  }
 
-template<typename T>
-concept MsgPackArray = (!MsgPackBinary<T>)
-    && (is_stdarray<T>::value
-        || is_stdvector<T>::value
-        || is_stdlist<T>::value
-        || is_stdset<T>::value);
+  /*!
+    Writes out the buffered bytes.
 
-template<typename T>
-concept MsgPackArrayOrMap = MsgPackArray<T> || MsgPackMap<T>;
+    \returns Whether the writer wrote them all.
+  */
+  bool flush()
+  {
+    if (buffer_.empty()) return true;
+    const bool is_written = write(buffer_);
+    buffer_.clear();
+    return is_written;
+  }
 
-template<typename T>
-concept MsgPackString = std::same_as<T, std::string>;
+  /*!
+    Total bytes handed to the writer so far.
+  */
+  [[nodiscard]] uint64_t written() const
+  {
+    return written_;
+  }
 
-template<typename T>
-concept MsgPackStringOrBinary = MsgPackString<T> || MsgPackBinary<T>;
+private:
+  bool write(const std::span<const uint8_t> a_bytes)
+  {
+    written_ += a_bytes.size();
+    return writer_(a_bytes);
+  }
 
-template<typename T>
-concept MsgPackFloatingPoint = std::is_floating_point_v<T>
-    && (sizeof(T) == 4 || sizeof(T) == 8)
-    && (limits<T>::radix == 2);
+  WriterT writer_;
+  size_t capacity_;
+  std::vector<uint8_t> buffer_;
+  uint64_t written_{0};
+};
 
-class Packer
+#pragma endregion
+
+/*!
+  Packs values, and Packable objects, into the output sink, see PackerSink.
+*/
+template<PackerSink SinkT>
+class BasicPacker
 {
 public:
-  Packer() = default;
-  Packer(const Packer &) = delete;
-  Packer(Packer &&) = delete;
-  Packer &operator=(Packer &) = delete;
-  Packer &operator=(Packer &&) = delete;
+  template<typename S = SinkT>
+  requires std::default_initializable<S>
+  BasicPacker()
+  {};
+
+  template<typename S = SinkT>
+  requires std::default_initializable<S>
+  explicit BasicPacker(const NestedFormat a_nested_format) : options_{a_nested_format}
+  {};
+
+  template<typename S = SinkT>
+  requires std::default_initializable<S>
+  explicit BasicPacker(const PackerOptions &a_options) : options_(a_options)
+  {};
+
+  explicit BasicPacker(SinkT a_sink, const NestedFormat a_nested_format = NestedFormat::Inline)
+      : sink_(std::move(a_sink)), options_{a_nested_format}
+  {};
+
+  BasicPacker(SinkT a_sink, const PackerOptions &a_options) : sink_(std::move(a_sink)), options_(a_options)
+  {};
+
+  BasicPacker(const BasicPacker &) = delete;
+  BasicPacker &operator=(const BasicPacker &) = delete;
+
+  // Movable with a movable sink, e.g. to keep packers in containers or pools.
+  BasicPacker(BasicPacker &&) noexcept = default;
+  BasicPacker &operator=(BasicPacker &&) noexcept = default;
 
   template<typename ... Ts>
   void operator()(const Ts &... args)
@@ -263,154 +1176,353 @@ public:
     (pack_type(std::forward<const Ts &>(args)), ...);
   }
 
-  const std::vector<uint8_t> &vector() const
+  /*!
+    Packs an object with MapTraits as a map of the names of its fields to their values.
+  */
+  template<MsgPackMapObject T>
+  void process_map(const T &a_object)
   {
-    return serialized_object_;
+    if (ec) return;
+    [&]<typename ... Fs>(MapFields<Fs...>) {
+      constexpr auto size = sizeof...(Fs);
+      if constexpr (size < 16)
+        emit(uint8_t(size | 0b10000000));
+      else
+        emit(FormatConstants::map16, uint16_t(size));
+      ((pack_type(Fs::key), pack_type(a_object.*Fs::member)), ...);
+    }(typename MapTraits<T>::fields{});
   }
 
-  void clear()
+  const std::vector<uint8_t> &vector() const requires requires(const SinkT &sink) { sink.vector(); }
+  {
+    return sink_.vector();
+  }
+
+  SinkT &sink()
+  {
+    return sink_;
+  }
+
+  [[nodiscard]] const PackerOptions &options() const
+  {
+    return options_;
+  }
+
+  void clear() requires requires(SinkT &sink) { sink.clear(); }
+  {
+    sink_.clear();
+  }
+
+  /*!
+    Clears the sink, keeping the capacity of its buffer, and the error, to pack anew, e.g. the
+    next message of a publisher, without allocating once the buffer is large enough.
+  */
+  void reset() requires requires(SinkT &sink) { sink.clear(); }
   {
-    serialized_object_.clear();
+    sink_.clear();
+    ec.clear();
+  }
+
+  void reset(const PackerOptions &a_options) requires requires(SinkT &sink) { sink.clear(); }
+  {
+    reset();
+    options_ = a_options;
+  }
+
+  /*!
+    Moves the packed bytes out, leaving the packer empty, with no capacity; see reset() to
+    reuse the buffer instead.
+  */
+  std::vector<uint8_t> release() requires requires(SinkT &sink) { sink.release(); }
+  {
+    return sink_.release();
+  }
+
+  /*!
+    Reserves room for packing the given number of bytes without growing the buffer, e.g. the
+    size of the previous snapshot of a dataset packed periodically.
+  */
+  void reserve(const size_t a_bytes) requires requires(SinkT &sink) { sink.reserve(a_bytes); }
+  {
+    sink_.reserve(a_bytes);
   }
 
   std::error_code ec{};
 
 private:
-  template<typename T>
-  void pack_type(const T &a_value)
+  void append(const uint8_t *a_bytes, const size_t a_size)
   {
-    if (ec) return;
-    auto recursive_packer = Packer{};
-    const_cast<T &>(a_value).pack(recursive_packer);
-    pack_type(recursive_packer.vector());
+    if (!sink_.append(a_bytes, a_size)) ec = PackerError::SinkError;
   }
 
-  template<MsgPackArrayOrMap T>
-  void pack_type(const T &a_value)
+  /*!
+    Makes room for the given number of bytes at the end of the buffer, if the sink can.
+  */
+  void reserve_ahead(const size_t a_bytes)
   {
-    if (ec) return;
-    uint8_t t = MsgPackMap<T> ? FormatConstants::map16 : FormatConstants::array16;
-    size_t len = match(a_value.size())(
-        pattern | (_ < 16) =
-            [&] { return sizeof(uint8_t); },
-        pattern | (_ < limits<uint16_t>::max()) =
-            [&] { return serialized_object_.emplace_back(t), sizeof(uint16_t); },
-        pattern | (_ < limits<uint32_t>::max()) =
-            [&] { return serialized_object_.emplace_back(t + 1), sizeof(uint32_t); },
-        pattern | _ =
-            [&]() { return (ec = PackerError::LengthError), 0; }
-    );
+    if constexpr (requires { sink_.reserve_ahead(a_bytes); }) sink_.reserve_ahead(a_bytes);
+  }
 
-    if (len == 0) return;
-    uint8_t mask = (a_value.size() < 16) ? (MsgPackMap<T> ? 0b10000000 : 0b10010000) : 0x00;
-    for (auto i = len; i > 0; --i)
-      serialized_object_.emplace_back(uint8_t(a_value.size() >> (8U * (i - 1)) | mask & 0xFF));
+  /*!
+    Appends a format byte followed by a big-endian field, with a single append.
+  */
+  template<std::unsigned_integral U>
+  void emit(const uint8_t a_format, const U a_value)
+  {
+    auto bytes = std::array<uint8_t, 1 + sizeof(U)>{a_format};
+    const U big_endian = (std::endian::native == std::endian::little) ? std::byteswap(a_value) : a_value;
+    std::memcpy(bytes.data() + 1, &big_endian, sizeof(U));
+    append(bytes.data(), bytes.size());
+  }
 
-    for (const auto &el : a_value)
-      if constexpr (MsgPackMap<T>)
-        pack_type(std::get<0>(el)), pack_type(std::get<1>(el));
-      else
-        pack_type(el);
+  void emit(const uint8_t a_byte)
+  {
+    append(&a_byte, 1);
   }
 
-  template<MsgPackStringOrBinary T>
+  template<typename T>
   void pack_type(const T &a_value)
   {
     if (ec) return;
-    uint8_t t = MsgPackString<T> ? FormatConstants::str8 : FormatConstants::bin8;
+    if (options_.nested_format == NestedFormat::Inline) {
+      detail::pack_object(const_cast<T &>(a_value), *this);
+      return;
+    }
 
-    if (MsgPackString<T> && a_value.size() < 32) {
-      serialized_object_.emplace_back(uint8_t(a_value.size()) | 0b10100000);
-    } else {
-      auto len = match(a_value.size())(
+    if constexpr (ContiguousPackerSink<SinkT>) {
+      // Packs the object in place after room for the largest bin header, then writes the actual
+      // header, and moves the object up if the header is shorter.
+      constexpr size_t max_header = 1 + sizeof(uint32_t);
+      const size_t start = sink_.size();
+      const auto room = std::array<uint8_t, max_header>{};
+      append(room.data(), room.size());
+      if (ec) return;
+      detail::pack_object(const_cast<T &>(a_value), *this);
+      if (ec) return;
+
+      const size_t size = sink_.size() - start - max_header;
+      auto header = std::array<uint8_t, max_header>{};
+      size_t len = match(size)(
           pattern | (_ < limits<uint8_t>::max()) =
-              [&]() { return serialized_object_.emplace_back(t), sizeof(uint8_t); },
+              [&]() { return header[0] = FormatConstants::bin8, sizeof(uint8_t); },
           pattern | (_ < limits<uint16_t>::max()) =
-              [&]() { return serialized_object_.emplace_back(t + 1), sizeof(uint16_t); },
+              [&]() { return header[0] = FormatConstants::bin16, sizeof(uint16_t); },
           pattern | (_ < limits<uint32_t>::max()) =
-              [&]() { return serialized_object_.emplace_back(t + 2), sizeof(uint32_t); },
+              [&]() { return header[0] = FormatConstants::bin32, sizeof(uint32_t); },
           pattern | _ =
               [&]() { return (ec = PackerError::LengthError), 0; }
       );
 
       if (len == 0) return;
       for (auto i = len; i > 0; --i)
-        serialized_object_.emplace_back(uint8_t(a_value.size() >> (8U * (i - 1)) & 0xFF));
+        header[1 + len - i] = uint8_t(size >> (8U * (i - 1)) & 0xFF);
+
+      auto *data = sink_.data() + start;
+      std::memcpy(data, header.data(), 1 + len);
+      std::memmove(data + 1 + len, data + max_header, size);
+      sink_.truncate(start + 1 + len + size);
+    } else if constexpr (std::same_as<SinkT, CountingSink>) {
+      // Counts the object apart, and its bin header from its size.
+      auto packer = BasicPacker<CountingSink>{options_};
+      detail::pack_object(const_cast<T &>(a_value), packer);
+      ec = packer.ec;
+      if (ec) return;
+
+      const size_t size = packer.sink().written();
+      size_t len = match(size)(
+          pattern | (_ < limits<uint8_t>::max()) = expr(sizeof(uint8_t)),
+          pattern | (_ < limits<uint16_t>::max()) = expr(sizeof(uint16_t)),
+          pattern | (_ < limits<uint32_t>::max()) = expr(sizeof(uint32_t)),
+          pattern | _ = [&]() { return (ec = PackerError::LengthError), size_t{0}; }
+      );
+      if (len > 0) sink_.count(1 + len + size);
+    } else {
+      // A sink written sequentially cannot patch the header in, so the object is packed apart.
+      auto packer = BasicPacker<VectorSink>{options_};
+      detail::pack_object(const_cast<T &>(a_value), packer);
+      ec = packer.ec;
+      if (!ec) pack_type(packer.vector());
     }
-
-    for (const auto &el : a_value) serialized_object_.emplace_back(static_cast<uint8_t>(el));
   }
 
-  template<MsgPackIntegral T>
+  template<MsgPackArrayOrMap T>
   void pack_type(const T &a_value)
   {
     if (ec) return;
+    if constexpr (MsgPackTypedArray<T>)
+      if (options_.array_format == ArrayFormat::Typed) return pack_typed_array(a_value);
 
-    size_t len{0};
-    uint64_t value64 = std::make_unsigned_t<T>(a_value);
-    for (len = 8; len > 1; --len)
-      if ((uint8_t(value64 >> 8U * (len - 1)) & 0xFFL) != 0) break;
-
-    auto is_signed = std::is_signed_v<T>;
+    uint8_t t = MsgPackMap<T> ? FormatConstants::map16 : FormatConstants::array16;
+    uint8_t mask = MsgPackMap<T> ? 0b10000000 : 0b10010000;
+    const auto size = a_value.size();
+
+    if (size < 16)
+      emit(uint8_t(size | mask));
+    else if (size < limits<uint16_t>::max())
+      emit(t, uint16_t(size));
+    else if (size < limits<uint32_t>::max())
+      emit(uint8_t(t + 1), uint32_t(size));
+    else
+      return void(ec = PackerError::LengthError);
 
-    uint8_t t = match(len)(
-        pattern | _ > 4 = [&]() { return (len = 8, is_signed ? int64 : uint64); },
-        pattern | _ > 2 = [&]() { return (len = 4, is_signed ? int32 : uint32); },
-        pattern | _ > 1 = [&]() { return (len = 2, is_signed ? int16 : uint16); },
-        pattern | _ = [&]() {
-          return ((uint8_t(a_value & 0x80) == 0) || (uint8_t(a_value & 0xE0) == 0xE0)) ?
-                 (len = 0, 0) : (is_signed ? int8 : uint8);
-        }
-    );
+    // Every element takes at least a byte.
+    reserve_ahead(MsgPackMap<T> ? 2 * size : size);
 
-    (t > 0) ? serialized_object_.emplace_back(t) : serialized_object_.emplace_back(uint8_t(a_value));
-    for (auto i = len; i > 0U; --i)
-      serialized_object_.emplace_back(uint8_t(value64 >> (8U * (i - 1)) & 0xFFL));
+    for (const auto &el : a_value)
+      if constexpr (MsgPackMap<T>)
+        pack_type(std::get<0>(el)), pack_type(std::get<1>(el));
+      else
+        pack_type(el);
   }
 
-  template<MsgPackFloatingPoint T>
+  template<MsgPackExt T>
   void pack_type(const T &a_value)
   {
     if (ec) return;
-    using int_t = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
-    T integral_part;
+    using traits_t = ExtTraits<T>;
+    const size_t size = traits_t::size(a_value);
+    if (!emit_ext_header(traits_t::type, size)) return;
+
+    reserve_ahead(size);
+    traits_t::encode(a_value, [&](const uint8_t *a_bytes, const size_t a_size) {
+      if (!ec) append(a_bytes, a_size);
+    });
+  }
+
+  template<MsgPackEnum T>
+  void pack_type(const T &a_value)
+  {
+    if constexpr (MsgPackIndexedEnum<T>)
+      pack_type(uint64_t(enum_codec_of(a_value).index_of(a_value)));
+    else
+      pack_type(static_cast<std::underlying_type_t<T>>(a_value));
+  }
+
+  /*!
+    Appends the header of an ext of the given type and payload size, the fixext one if any.
+  */
+  bool emit_ext_header(const int8_t a_type, const size_t a_size)
+  {
+    const auto type = uint8_t(a_type);
+    return match(a_size)(
+        pattern | size_t{1} = [&] { return emit(FormatConstants::fixext1, type), true; },
+        pattern | size_t{2} = [&] { return emit(FormatConstants::fixext2, type), true; },
+        pattern | size_t{4} = [&] { return emit(FormatConstants::fixext4, type), true; },
+        pattern | size_t{8} = [&] { return emit(FormatConstants::fixext8, type), true; },
+        pattern | size_t{16} = [&] { return emit(FormatConstants::fixext16, type), true; },
+        pattern | (_ < limits<uint8_t>::max()) =
+            [&] { return emit(FormatConstants::ext8, uint8_t(a_size)), emit(type), true; },
+        pattern | (_ < limits<uint16_t>::max()) =
+            [&] { return emit(FormatConstants::ext16, uint16_t(a_size)), emit(type), true; },
+        pattern | (_ < limits<uint32_t>::max()) =
+            [&] { return emit(FormatConstants::ext32, uint32_t(a_size)), emit(type), true; },
+        pattern | _ =
+            [&]() { return (ec = PackerError::LengthError), false; }
+    );
+  }
+
+  template<MsgPackTypedArray T>
+  void pack_typed_array(const T &a_value)
+  {
+    using value_t = typename T::value_type;
+    const size_t size = a_value.size() * sizeof(value_t);
+    constexpr uint8_t ext_type = typed_array_ext<value_t>();
 
-    if (std::modf(a_value, &integral_part) == 0)
-      return pack_type(int64_t(integral_part));
+    bool is_packed = match(size)(
+        pattern | (_ < limits<uint8_t>::max()) =
+            [&] { return emit(FormatConstants::ext8, uint8_t(size)), true; },
+        pattern | (_ < limits<uint16_t>::max()) =
+            [&] { return emit(FormatConstants::ext16, uint16_t(size)), true; },
+        pattern | (_ < limits<uint32_t>::max()) =
+            [&] { return emit(FormatConstants::ext32, uint32_t(size)), true; },
+        pattern | _ =
+            [&]() { return (ec = PackerError::LengthError), false; }
+    );
 
-    auto exponent = std::ilogb(a_value);
-    auto full_mantissa = a_value / std::scalbn(1.0, exponent);
-    auto sign_mask = std::bitset<sizeof(T) * 8>(int_t(std::signbit(full_mantissa)) << sizeof(T) * 8 - 1);
+    if (!is_packed) return;
+    emit(ext_type);
 
-    auto normalized_mantissa_mask = std::bitset<sizeof(T) * 8>();
-    T implied_mantissa = std::fabs(full_mantissa) - 1.0f;
-    auto significant = sizeof(T) == sizeof(float) ? 23 : 52;
+    if constexpr (std::endian::native == std::endian::little || sizeof(value_t) == 1) {
+      append(reinterpret_cast<const uint8_t *>(a_value.data()), size);
+    } else {
+      // Swapped through a small buffer, so that nothing the size of the array is allocated.
+      constexpr size_t chunk = 512;
+      std::array<uint8_t, chunk * sizeof(value_t)> buffer;
+      reserve_ahead(size);
+      for (size_t i = 0; i < a_value.size() && !ec; i += chunk) {
+        const size_t count = std::min(chunk, a_value.size() - i);
+        copy_little_endian<value_t>(buffer.data(), a_value.data() + i, count);
+        append(buffer.data(), count * sizeof(value_t));
+      }
+    }
+  }
 
-    for (auto i = significant; i > 0; --i) {
-      integral_part = 0;
-      implied_mantissa *= 2;
-      implied_mantissa = std::modf(implied_mantissa, &integral_part);
+  template<MsgPackStringOrBinary T>
+  void pack_type(const T &a_value)
+  {
+    if (ec) return;
+    uint8_t t = MsgPackString<T> ? FormatConstants::str8 : FormatConstants::bin8;
+    const auto size = a_value.size();
+
+    if (MsgPackString<T> && size < 32) {
+      reserve_ahead(1 + size);
+      emit(uint8_t(size) | 0b10100000);
+    } else if (size < limits<uint8_t>::max()) {
+      reserve_ahead(2 + size);
+      emit(t, uint8_t(size));
+    } else if (size < limits<uint16_t>::max()) {
+      reserve_ahead(3 + size);
+      emit(uint8_t(t + 1), uint16_t(size));
+    } else if (size < limits<uint32_t>::max()) {
+      reserve_ahead(5 + size);
+      emit(uint8_t(t + 2), uint32_t(size));
+    } else {
+      return void(ec = PackerError::LengthError);
+    }
 
-      if (uint8_t(integral_part) == 1)
-        normalized_mantissa_mask |= std::bitset<sizeof(T) * 8>(int_t(1) << (i - 1));
+    const auto *bytes = reinterpret_cast<const uint8_t *>(a_value.data());
+    if constexpr (requires { sink_.append_external(bytes, size); }) {
+      if (!sink_.append_external(bytes, size)) ec = PackerError::SinkError;
+    } else {
+      append(bytes, size);
     }
+  }
 
-    int_t ieee754_float;
-    auto excess = (sizeof(T) == 4 ? std::pow(2, 7) : std::pow(2, 10)) - 1;
-    auto excess_exponent_mask = std::bitset<sizeof(T) * 8>(int_t(exponent + excess) << significant);
+  template<MsgPackIntegral T>
+  void pack_type(const T &a_value)
+  {
+    if (ec) return;
+    const uint64_t value64 = std::make_unsigned_t<T>(a_value);
+    const auto low_byte = uint8_t(value64);
+    const auto len = std::max<size_t>(1, (size_t(std::bit_width(value64)) + 7) / 8);
+    // Negative fixints are -32 to -1, not 224 to 255.
+    if (a_value <= T(0x7F) && (!std::is_signed_v<T> || a_value >= T(-32))) return emit(low_byte);
+
+    // The field is the low bytes of the big-endian value, which the format byte precedes.
+    const uint8_t width = detail::integer_widths[len];
+    auto bytes = std::array<uint8_t, 1 + sizeof(uint64_t)>{};
+    detail::store_big_endian(value64, bytes.data() + 1);
+    const size_t start = sizeof(uint64_t) - width;
+    bytes[start] = uint8_t((std::is_signed_v<T> ? int8 : uint8) + std::countr_zero(width));
+    append(bytes.data() + start, 1 + width);
+  }
 
-    if (sizeof(T) == 4)
-      ieee754_float = (sign_mask | excess_exponent_mask | normalized_mantissa_mask).to_ulong();
-    else
-      ieee754_float = (sign_mask | excess_exponent_mask | normalized_mantissa_mask).to_ullong();
+  template<MsgPackFloatingPoint T>
+  void pack_type(const T &a_value)
+  {
+    if (ec) return;
+    using int_t = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
 
-    match(sizeof(T))(
-        pattern | 4 = [&]() { serialized_object_.emplace_back(FormatConstants::float32); },
-        pattern | 8 = [&]() { serialized_object_.emplace_back(FormatConstants::float64); }
-    );
+    if (options_.float_format == FloatFormat::CompactIntegral) {
+      // Integral values within the range of int64, excluding 2^63 which rounds into it.
+      constexpr auto int64_bound = T(9223372036854775808.0);
+      T integral_part;
+      if (std::isfinite(a_value) && std::modf(a_value, &integral_part) == 0
+          && integral_part >= -int64_bound && integral_part < int64_bound)
+        return pack_type(int64_t(integral_part));
+    }
 
-    for (auto i = sizeof(T); i > 0; --i)
-      serialized_object_.emplace_back(uint8_t(ieee754_float >> (8U * (i - 1)) & 0xFF));
+    emit(sizeof(T) == 4 ? FormatConstants::float32 : FormatConstants::float64, std::bit_cast<int_t>(a_value));
   }
 
   template<typename T>
@@ -420,39 +1532,151 @@ private:
     pack_type(a_value.time_since_epoch().count());
   }
 
-  template<>
   void pack_type(const std::nullptr_t &/*value*/)
   {
     if (ec) return;
-    serialized_object_.emplace_back(FormatConstants::nil);
+    emit(FormatConstants::nil);
   }
 
-  template<>
   void pack_type(const bool &a_value)
   {
     if (ec) return;
-    if (a_value)
-      serialized_object_.emplace_back(FormatConstants::true_bool);
-    else
-      serialized_object_.emplace_back(FormatConstants::false_bool);
+    emit(a_value ? FormatConstants::true_bool : FormatConstants::false_bool);
+  }
+
+private:
+  SinkT sink_;
+  PackerOptions options_{};
+};
+
+/*!
+  Packs into a std::vector of its own, see vector().
+*/
+using Packer = BasicPacker<VectorSink>;
+
+/*!
+  A pool of packers, e.g. the one of each thread, see local(), so that publishers reach a steady
+  state with no allocation per message: a packer leased again keeps the buffer of the previous
+  messages, reset, with its capacity.
+
+  @code
+    auto packer = msgpack::PackerPool::local().acquire();
+    packer->process(vehicle);
+    socket.send(packer->vector());
+  @endcode
+*/
+class PackerPool
+{
+public:
+  /*!
+    A packer leased from a pool, given back when the lease ends, which must be before the pool
+    does, e.g. within the thread of PackerPool::local().
+  */
+  class Lease
+  {
+  public:
+    Lease(PackerPool &a_pool, Packer &&a_packer) noexcept : pool_(&a_pool), packer_(std::move(a_packer))
+    {};
+
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    Lease(Lease &&a_other) noexcept : pool_(std::exchange(a_other.pool_, nullptr)), packer_(std::move(a_other.packer_))
+    {};
+
+    Lease &operator=(Lease &&) = delete;
+
+    ~Lease()
+    {
+      if (pool_ != nullptr) pool_->give_back(std::move(packer_));
+    }
+
+    Packer &operator*() noexcept
+    {
+      return packer_;
+    }
+
+    Packer *operator->() noexcept
+    {
+      return &packer_;
+    }
+
+  private:
+    PackerPool *pool_;
+    Packer packer_;
+  };
+
+  /*!
+    \param a_max_idle  The number of packers kept once given back, the others being freed.
+  */
+  explicit PackerPool(const std::size_t a_max_idle = 8) : max_idle_(a_max_idle)
+  {
+    idle_.reserve(max_idle_);
+  };
+
+  PackerPool(const PackerPool &) = delete;
+  PackerPool &operator=(const PackerPool &) = delete;
+
+  /*!
+    Leases an idle packer, reset with the given options, or a new one if none is idle.
+  */
+  Lease acquire(const PackerOptions &a_options = {})
+  {
+    if (idle_.empty()) return Lease{*this, Packer{a_options}};
+
+    auto packer = std::move(idle_.back());
+    idle_.pop_back();
+    packer.reset(a_options);
+    return Lease{*this, std::move(packer)};
+  }
+
+  /*!
+    The number of packers given back and not leased again.
+  */
+  [[nodiscard]] std::size_t idle() const
+  {
+    return idle_.size();
+  }
+
+  /*!
+    The pool of the calling thread.
+  */
+  static PackerPool &local()
+  {
+    thread_local auto pool = PackerPool{};
+    return pool;
   }
 
 private:
-  std::vector<uint8_t> serialized_object_;
+  void give_back(Packer &&a_packer)
+  {
+    if (idle_.size() < max_idle_) idle_.push_back(std::move(a_packer));
+  }
+
+  std::vector<Packer> idle_;
+  std::size_t max_idle_;
 };
 
+// Skips the values of unknown keys of MapTraits objects, defined with the visitor.
+inline std::size_t skip(std::span<const uint8_t> a_bytes, std::error_code &a_ec);
+
 class Unpacker
 {
 public:
   Unpacker(const Unpacker &) = delete;
-  Unpacker(Unpacker &&) = delete;
-  Unpacker &operator=(Unpacker &) = delete;
-  Unpacker &operator=(Unpacker &&) = delete;
+  Unpacker &operator=(const Unpacker &) = delete;
+
+  Unpacker(Unpacker &&) noexcept = default;
+  Unpacker &operator=(Unpacker &&) noexcept = default;
 
   Unpacker() : begin_(nullptr), end_(nullptr)
   {};
 
-  explicit Unpacker(const uint8_t *a_start, std::size_t a_size) : begin_(a_start), end_(a_start + a_size)
+  explicit Unpacker(const NestedFormat a_nested_format) : begin_(nullptr), end_(nullptr), nested_format_(a_nested_format)
+  {};
+
+  explicit Unpacker(const uint8_t *a_start, std::size_t a_size, const NestedFormat a_nested_format = NestedFormat::Inline)
+      : begin_(a_start), end_(a_start + a_size), nested_format_(a_nested_format)
   {};
 
   template<typename ... Ts>
@@ -467,12 +1691,73 @@ public:
     (unpack_type(std::forward<Ts &>(args)), ...);
   }
 
+  /*!
+    Unpacks a map into an object with MapTraits, by the names of its fields, in any order.
+
+    The keys are viewed in place, and each is compared only with the names of its length, of
+    lengths known at compile time; the values of unknown keys are skipped, and the fields of
+    missing keys left as they are.
+  */
+  template<MsgPackMapObject T>
+  void process_map(T &a_object)
+  {
+    if (ec) return;
+    const uint8_t format = current_byte();
+    uint32_t len{0};
+    if ((format & 0xF0) == 0x80)
+      next(), len = format & 0b00001111;
+    else if (format == map16)
+      next(), len = read_big_endian<uint16_t>();
+    else if (format == map32)
+      next(), len = read_big_endian<uint32_t>();
+    else if (!ec)
+      ec = UnpackerError::DataNotMatchType;
+
+    for (auto i = 0U; i < len && !ec; i++) {
+      const uint8_t key_format = current_byte();
+      if ((key_format & 0xE0) != 0xA0 && (key_format < str8 || key_format > str32)) {
+        if (!ec) ec = UnpackerError::DataNotMatchType;
+        return;
+      }
+
+      auto key = std::string_view{};
+      unpack_type(key);
+      if (ec) return;
+
+      const bool known = [&]<typename ... Fs>(MapFields<Fs...>) {
+        return ((key.size() == Fs::key.size() && std::memcmp(key.data(), Fs::key.data(), Fs::key.size()) == 0 && (unpack_type(a_object.*Fs::member), true)) || ...);
+      }(typename MapTraits<T>::fields{});
+
+      if (!known) {
+        const auto size = skip(std::span<const uint8_t>{begin_, remaining()}, ec);
+        if (!ec) next(static_cast<int64_t>(size));
+      }
+    }
+  }
+
   void set_data(const uint8_t *a_begin, std::size_t a_size)
   {
     begin_ = a_begin;
     end_ = begin_ + a_size;
   }
 
+  /*!
+    Unpacks the given bytes anew, clearing the error.
+  */
+  void reset(const uint8_t *a_begin, std::size_t a_size)
+  {
+    set_data(a_begin, a_size);
+    ec.clear();
+  }
+
+  /*!
+    The number of bytes left to unpack.
+  */
+  [[nodiscard]] std::size_t remaining() const
+  {
+    return end_ > begin_ ? std::size_t(end_ - begin_) : 0;
+  }
+
   std::error_code ec{};
 
 private:
@@ -481,6 +1766,23 @@ private:
     return (begin_ < end_) ? *begin_ : (ec = UnpackerError::OutOfRange, 0);
   }
 
+  /*!
+    Reads a big-endian field, with a single load.
+  */
+  template<std::unsigned_integral U>
+  U read_big_endian()
+  {
+    if (ec || end_ - begin_ < static_cast<std::ptrdiff_t>(sizeof(U))) {
+      ec = UnpackerError::OutOfRange;
+      return 0;
+    }
+
+    U value;
+    std::memcpy(&value, begin_, sizeof(U));
+    begin_ += sizeof(U);
+    return (std::endian::native == std::endian::little) ? std::byteswap(value) : value;
+  }
+
   void next(int64_t a_bytes = 1)
   {
     if (end_ - begin_ >= 0)
@@ -493,87 +1795,220 @@ private:
   void unpack_type(T &a_value)
   {
     if (ec) return;
-    auto recursive_data = std::vector<uint8_t>{};
-    unpack_type(recursive_data);
+    if (nested_format_ == NestedFormat::Inline) {
+      detail::pack_object(a_value, *this);
+      return;
+    }
+
+    // Unpacks the object in place, within the bounds of its bin blob.
+    auto l = match(current_byte())(//@formatter:off
+        pattern | bin32 = expr(4),
+        pattern | bin16 = expr(2),
+        pattern | bin8  = expr(1),
+        pattern | _     = expr(0) //@formatter:on
+    );
+
+    if (l == 0) {
+      if (!ec) ec = UnpackerError::DataNotMatchType;
+      return;
+    }
+
+    uint32_t len{0};
+    next();
+    for (auto i = l; i > 0; i--) { (len += uint32_t(current_byte()) << 8 * (i - 1)), next(); }
+
+    if (ec || len > end_ - begin_) {
+      ec = UnpackerError::OutOfRange;
+      return;
+    }
 
-    auto recursive_unpacker = Unpacker{recursive_data.data(), recursive_data.size()};
-    a_value.pack(recursive_unpacker);
-    ec = recursive_unpacker.ec;
+    const auto *end = end_;
+    const auto *object_end = begin_ + len;
+    end_ = object_end;
+    detail::pack_object(a_value, *this);
+    begin_ = object_end;
+    end_ = end;
   }
 
   template<MsgPackIntegral T>
   void unpack_type(T &a_value)
   {
     if (ec) return;
-    auto is_overflow = [&](size_t act, size_t min) { return (act < min) && (ec = UnpackerError::IntegerOverflow, true); };
-    uint8_t byte_value{current_byte()};
-
-    uint8_t len = match(byte_value)(
-        //@formatter:off
-        pattern | or_(int64, uint64) = [&]() { return is_overflow(sizeof(T), 8) ? 0 : 8; },
-        pattern | or_(int32, uint32) = [&]() { return is_overflow(sizeof(T), 4) ? 0 : 4; },
-        pattern | or_(int16, uint16) = [&]() { return is_overflow(sizeof(T), 2) ? 0 : 2; },
-        pattern | or_(int8 , uint8 ) = [&]() { return is_overflow(sizeof(T), 1) ? 0 : 1; },
-        //@formatter:on
-        pattern | _ = [&] {
-          return ((byte_value & 0x80) == 0x00) || ((byte_value & 0xE0) == 0xE0) ?
-                 (a_value = byte_value, 0) : (ec = UnpackerError::DataNotMatchType, 0);
-        }
-    );
-
-    if (next(), len > 0) {
-      uint64_t value64{0};
+    const uint8_t format = current_byte();
+
+    if (format < uint8 || format > int64) {
+      if ((format & 0x80) == 0x00 || (format & 0xE0) == 0xE0)
+        a_value = T(int8_t(format));
+      else if (!ec)
+        ec = UnpackerError::DataNotMatchType;
+      next();
+      return;
+    }
 
-      for (auto i = len; i > 0; --i) {
-        value64 |= uint64_t(current_byte()) << 8U * (i - 1);
-        next();
-      }
+    // uint8 to uint64, and int8 to int64, have the width in their two low bits.
+    const size_t width = size_t{1} << (format & 0x03U);
+    next();
+    if (sizeof(T) < width) {
+      ec = UnpackerError::IntegerOverflow;
+      return;
+    }
 
-      a_value = T(value64);
+    uint64_t value64{0};
+    switch (width) {
+      case 8: value64 = read_big_endian<uint64_t>();
+        break;
+      case 4: value64 = read_big_endian<uint32_t>();
+        break;
+      case 2: value64 = read_big_endian<uint16_t>();
+        break;
+      default: value64 = read_big_endian<uint8_t>();
     }
+    if (!ec) a_value = T(value64);
   }
 
   template<MsgPackArrayOrMap T>
   void unpack_type(T &a_value)
   {
     if (ec) return;
-    uint32_t len = [&]() {
-      auto l = match(current_byte())(//@formatter:off
-          pattern | or_(array32, map32) = expr(4),
-          pattern | or_(array16, map16) = expr(2),
-          pattern | _ = expr(0) //@formatter:on
-      );
+    if constexpr (MsgPackTypedArray<T>)
+      if (is_ext(current_byte())) return unpack_typed_array(a_value);
 
-      uint32_t result{0};
-      if (l > 0) {
-        next();
-        for (auto i = l; i > 0; i--) { (result += uint32_t(current_byte()) << 8 * (i - 1)), next(); }
-      } else {
-        (result = current_byte() & 0b00001111), next();
-      }
-      return result;
-    }();
+    const uint8_t format = current_byte();
+    next();
+    uint32_t len{0};
+    if (format == array32 || format == map32)
+      len = read_big_endian<uint32_t>();
+    else if (format == array16 || format == map16)
+      len = read_big_endian<uint16_t>();
+    else
+      len = format & 0b00001111;
+    if (ec) return;
 
     if (is_stdarray<T>::value && a_value.size() != len) {
       ec = UnpackerError::BadStdArraySize;
       return;
     }
 
-    for (auto i = 0U; i < len; i++) {
-      if constexpr (MsgPackArray<T>) {
-        typename T::value_type value{};
+    // Every element takes at least a byte, which bounds the room reserved for corrupt lengths.
+    const auto reserved = std::min<std::size_t>(len, MsgPackMap<T> ? remaining() / 2 : remaining());
+    if constexpr (requires { a_value.reserve(reserved); }) a_value.reserve(a_value.size() + reserved);
+
+    for (auto i = 0U; i < len && !ec; i++) {
+      if constexpr (is_stdarray<T>::value) {
+        a_value[i] = typename T::value_type{};
+        unpack_type(a_value[i]);
+      } else if constexpr (is_stdset<T>::value) {
+        // Temporaries take the allocator of the container too, e.g. the arena of std::pmr ones.
+        auto value = std::make_obj_using_allocator<typename T::value_type>(a_value.get_allocator());
         unpack_type(value);
-        if constexpr (is_stdarray<T>::value)
-          a_value[i] = std::move(value);
-        else
-          a_value.emplace_back(value);
+        a_value.emplace_hint(a_value.end(), std::move(value));
+      } else if constexpr (MsgPackArray<T>) {
+        // Constructed in place, with the allocator of the container, e.g. of std::pmr ones.
+        unpack_type(a_value.emplace_back());
       } else {
-        typename T::key_type key{};
-        typename T::mapped_type value{};
+        auto key = std::make_obj_using_allocator<typename T::key_type>(a_value.get_allocator());
         unpack_type(key);
-        unpack_type(value);
-        a_value.insert_or_assign(key, value);
+        // Packed maps are sorted, which makes the end the right hint of ordered ones.
+        const auto size = a_value.size();
+        const auto it = a_value.try_emplace(a_value.end(), std::move(key));
+        if (a_value.size() == size) it->second = std::make_obj_using_allocator<typename T::mapped_type>(a_value.get_allocator());
+        unpack_type(it->second);
+      }
+    }
+  }
+
+  /*!
+    Unpacks a typed array, see ArrayFormat::Typed, which has to be of the same element type.
+  */
+  template<MsgPackTypedArray T>
+  void unpack_typed_array(T &a_value)
+  {
+    using value_t = typename T::value_type;
+    int8_t ext_type{0};
+    auto payload = std::span<const uint8_t>{};
+    if (!read_ext(ext_type, payload)) return;
+
+    const size_t size = payload.size();
+    if (uint8_t(ext_type) != typed_array_ext<value_t>() || size % sizeof(value_t) != 0) {
+      ec = UnpackerError::DataNotMatchType;
+      return;
+    }
+
+    const size_t count = size / sizeof(value_t);
+    if constexpr (is_stdarray<T>::value) {
+      if (a_value.size() != count) {
+        ec = UnpackerError::BadStdArraySize;
+        return;
       }
+    } else {
+      a_value.resize(count);
+    }
+
+    copy_little_endian<value_t>(a_value.data(), payload.data(), count);
+  }
+
+  static bool is_ext(const uint8_t a_format)
+  {
+    return (a_format >= ext8 && a_format <= ext32) || (a_format >= fixext1 && a_format <= fixext16);
+  }
+
+  /*!
+    Reads an ext, of any format, returning false on errors, see ec.
+  */
+  bool read_ext(int8_t &a_type, std::span<const uint8_t> &a_payload)
+  {
+    if (ec) return false;
+    const auto format = current_byte();
+    if (!is_ext(format)) {
+      if (!ec) ec = UnpackerError::DataNotMatchType;
+      return false;
+    }
+
+    next();
+    const uint32_t size = match(format)(
+        pattern | ext8 = [&]() { return uint32_t(read_big_endian<uint8_t>()); },
+        pattern | ext16 = [&]() { return uint32_t(read_big_endian<uint16_t>()); },
+        pattern | ext32 = [&]() { return read_big_endian<uint32_t>(); },
+        pattern | _ = [&]() { return uint32_t{1} << (format - fixext1); }
+    );
+
+    a_type = int8_t(read_big_endian<uint8_t>());
+    if (ec || size > end_ - begin_) {
+      ec = UnpackerError::OutOfRange;
+      return false;
+    }
+
+    a_payload = {begin_, size};
+    next(size);
+    return true;
+  }
+
+  template<MsgPackExt T>
+  void unpack_type(T &a_value)
+  {
+    int8_t ext_type{0};
+    auto payload = std::span<const uint8_t>{};
+    if (!read_ext(ext_type, payload)) return;
+
+    if (ext_type != ExtTraits<T>::type || !ExtTraits<T>::decode(payload, a_value))
+      ec = UnpackerError::DataNotMatchType;
+  }
+
+  template<MsgPackEnum T>
+  void unpack_type(T &a_value)
+  {
+    if constexpr (MsgPackIndexedEnum<T>) {
+      uint64_t index{};
+      unpack_type(index);
+      if (ec) return;
+      if (const auto value = enum_codec_of(a_value).from_index(index))
+        a_value = *value;
+      else
+        ec = UnpackerError::DataNotMatchType;
+    } else {
+      std::underlying_type_t<T> value{};
+      unpack_type(value);
+      if (!ec) a_value = static_cast<T>(value);
     }
   }
 
@@ -581,28 +2016,31 @@ private:
   void unpack_type(T &a_value)
   {
     if (ec) return;
-    uint32_t len = [&]() {
-      auto l = match(current_byte())(//@formatter:off
-          pattern | or_(str32, bin32) = expr(4),
-          pattern | or_(str16, bin16) = expr(2),
-          pattern | or_(str8,  bin8 ) = expr(1),
-          pattern | _ = expr(0) //@formatter:on
-      );
+    const uint8_t format = current_byte();
+    next();
+    uint32_t len{0};
+    if (format == str32 || format == bin32)
+      len = read_big_endian<uint32_t>();
+    else if (format == str16 || format == bin16)
+      len = read_big_endian<uint16_t>();
+    else if (format == str8 || format == bin8)
+      len = read_big_endian<uint8_t>();
+    else
+      len = format & 0b00011111;
 
-      uint32_t result{0};
-      if (l > 0) {
-        next();
-        for (auto i = l; i > 0; i--) { (result += uint32_t(current_byte()) << 8 * (i - 1)), next(); };
-      } else {
-        (result = current_byte() & 0b00011111), next();
-      }
-      return result;
-    }();
+    if (ec || len > end_ - begin_) {
+      ec = UnpackerError::OutOfRange;
+      return;
+    }
 
-    if (begin_ + len <= end_)
-      (a_value = T{begin_, begin_ + len}), next(len);
+    // Views point into the input, and are valid as long as it is.
+    if constexpr (MsgPackStringView<T>)
+      a_value = T{reinterpret_cast<const char *>(begin_), len};
+    else if constexpr (MsgPackBinaryView<T>)
+      a_value = T{begin_, len};
     else
-      ec = UnpackerError::OutOfRange;
+      a_value.assign(begin_, begin_ + len);
+    next(len);
   }
 
   template<MsgPackFloatingPoint T>
@@ -611,33 +2049,14 @@ private:
     if (ec) return;
     match(current_byte())(
         // Stored as IEEE-754 floating point format.
-        pattern | or_(float64, float32) = [&]() {
-          using int_t = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
-          int_t data{0};
+        pattern | float32 = [&]() {
           next();
+          a_value = T(std::bit_cast<float>(read_big_endian<uint32_t>()));
+        },
 
-          for (auto i = sizeof(T); i > 0; --i) {
-            data += std::conditional_t<sizeof(T) == 8, uint64_t, uint8_t>(current_byte()) << 8 * (i - 1);
-            next();
-          }
-
-          auto bits = std::bitset<8 * sizeof(T)>(data);
-          T mantissa = 1.0;
-
-          for (auto i = sizeof(T) == 8 ? 52U : 23U; i > 0; --i)
-            if (bits[i - 1])
-              mantissa += 1.0 / (int_t(1) << ((sizeof(T) == 8 ? 53U : 24U) - i));
-
-          if (bits[8 * sizeof(T) - 1])
-            mantissa *= -1;
-
-          std::conditional_t<sizeof(T) == 8, uint16_t, uint8_t> exponent{0};
-
-          for (auto i = 0U; i < (sizeof(T) == 8 ? 11 : 8); ++i)
-            exponent += bits[i + (sizeof(T) == 8 ? 52 : 23)] << i;
-
-          exponent -= (sizeof(T) == 8 ? 1023 : 127);
-          a_value = ldexp(mantissa, exponent);
+        pattern | float64 = [&]() {
+          next();
+          a_value = T(std::bit_cast<double>(read_big_endian<uint64_t>()));
         },
 
         // Could have been stored in integral format: int8, int16, int32, int64, or fixint.
@@ -656,20 +2075,27 @@ private:
     using timepoint_t = typename std::chrono::time_point<ClockT, DurationT>;
     using rep_t = typename timepoint_t::rep;
 
+    if constexpr (std::same_as<ClockT, std::chrono::system_clock>) {
+      if (is_ext(current_byte())) {
+        auto timestamp = Timestamp{};
+        unpack_type(timestamp);
+        a_value = std::chrono::time_point_cast<DurationT>(timestamp.time_point());
+        return;
+      }
+    }
+
     auto placeholder = rep_t{};
 
     unpack_type(placeholder);
     a_value = static_cast<timepoint_t>(DurationT(placeholder));
   }
 
-  template<>
   void unpack_type(std::nullptr_t &/*value*/)
   {
     if (ec) return;
     next();
   }
 
-  template<>
   void unpack_type(bool &a_value)
   {
     if (ec) return;
@@ -680,6 +2106,7 @@ private:
 private:
   const uint8_t *begin_;
   const uint8_t *end_;
+  NestedFormat nested_format_{NestedFormat::Inline};
 };
 
 /*!
@@ -697,67 +2124,622 @@ concept Packable = requires(T packable, Packer &packer, Unpacker &unpacker) {
   //@formatter:on
 };
 
-template<Packable T>
+/*!
+  Types packed by pack() and unpacked by unpack(), Packable, MsgPackReflectable or MsgPackMapObject
+  ones.
+*/
+template<typename T>
+concept Serializable = Packable<T> || MsgPackReflectable<std::remove_cvref_t<T>> || MsgPackMapObject<std::remove_cvref_t<T>>;
+
+template<Serializable T>
 std::vector<uint8_t> pack(T &a_packable, std::error_code &a_ec)
 {
+  WXLIB_TRACE_SPAN("msgpack.pack");
   auto packer = Packer{};
-  a_packable.pack(packer);
+  detail::pack_object(a_packable, packer);
   a_ec = packer.ec;
-  return packer.vector();
+  return packer.release();
 }
 
-template<Packable T>
+template<Serializable T>
 std::vector<uint8_t> pack(T &&a_packable, std::error_code &a_ec)
 {
+  WXLIB_TRACE_SPAN("msgpack.pack");
   auto packer = Packer{};
-  a_packable.pack(packer);
+  detail::pack_object(a_packable, packer);
+  a_ec = packer.ec;
+  return packer.release();
+}
+
+template<Serializable T>
+std::vector<uint8_t> pack(T &a_packable, const NestedFormat a_nested_format, std::error_code &a_ec)
+{
+  WXLIB_TRACE_SPAN("msgpack.pack");
+  auto packer = Packer{a_nested_format};
+  detail::pack_object(a_packable, packer);
+  a_ec = packer.ec;
+  return packer.release();
+}
+
+template<Serializable T>
+std::vector<uint8_t> pack(T &a_packable, const PackerOptions &a_options, std::error_code &a_ec)
+{
+  WXLIB_TRACE_SPAN("msgpack.pack");
+  auto packer = Packer{a_options};
+  detail::pack_object(a_packable, packer);
   a_ec = packer.ec;
-  return packer.vector();
+  return packer.release();
 }
 
-template<Packable T>
+template<Serializable T>
 std::vector<uint8_t> pack(T &a_packable)
 {
   std::error_code ec;
   return pack(std::forward<T &>(a_packable), ec);
 }
 
-template<Packable T>
+template<Serializable T>
 std::vector<uint8_t> pack(T &&a_packable)
 {
   std::error_code ec;
   return pack(std::forward<T &&>(a_packable), ec);
 }
 
-template<Packable T>
+/*!
+  The number of bytes the object packs into with the given options, measured by packing it into
+  a CountingSink, e.g. for reserving exactly once, or framing it into a fixed slot.
+*/
+template<Serializable T>
+std::size_t encoded_size(const T &a_packable, const PackerOptions &a_options, std::error_code &a_ec)
+{
+  auto packer = BasicPacker<CountingSink>{a_options};
+  detail::pack_object(const_cast<T &>(a_packable), packer);
+  a_ec = packer.ec;
+  return packer.sink().written();
+}
+
+template<Serializable T>
+std::size_t encoded_size(const T &a_packable, const PackerOptions &a_options = {})
+{
+  std::error_code ec;
+  return encoded_size(a_packable, a_options, ec);
+}
+
+template<Serializable T>
 T unpack(const uint8_t *a_start, const std::size_t a_size, std::error_code &a_ec)
 {
+  WXLIB_TRACE_SPAN("msgpack.unpack");
   auto packable = T{};
   auto unpacker = Unpacker(a_start, a_size);
-  packable.pack(unpacker);
+  detail::pack_object(packable, unpacker);
+  a_ec = unpacker.ec;
+  return packable;
+}
+
+template<Serializable T>
+T unpack(const uint8_t *a_start, const std::size_t a_size, const NestedFormat a_nested_format, std::error_code &a_ec)
+{
+  WXLIB_TRACE_SPAN("msgpack.unpack");
+  auto packable = T{};
+  auto unpacker = Unpacker(a_start, a_size, a_nested_format);
+  detail::pack_object(packable, unpacker);
   a_ec = unpacker.ec;
   return packable;
 }
 
-template<Packable T>
+template<Serializable T>
 T unpack(const uint8_t *a_start, const std::size_t a_size)
 {
   std::error_code ec{};
   return unpack<T>(a_start, a_size, ec);
 }
 
-template<Packable T>
+template<Serializable T>
 T unpack(const std::vector<uint8_t> &a_data, std::error_code &a_ec)
 {
   return unpack<T>(a_data.data(), a_data.size(), a_ec);
 }
 
-template<Packable T>
+template<Serializable T>
 T unpack(const std::vector<uint8_t> &a_data)
 {
   std::error_code ec;
   return unpack<T>(a_data.data(), a_data.size(), ec);
 }
 
+#pragma region - Ranges
+
+/*!
+  Packs the objects of the range one after another with the given packer, stopping at the first
+  error, see BasicPacker::ec. Sized ranges reserve room for all objects the size of the first.
+*/
+template<std::input_iterator I, std::sentinel_for<I> S, PackerSink SinkT>
+requires Serializable<std::iter_value_t<I>>
+void pack_range(I a_first, const S a_last, BasicPacker<SinkT> &a_packer)
+{
+  if (a_first == a_last || a_packer.ec) return;
+
+  if constexpr (std::sized_sentinel_for<S, I> && requires { a_packer.reserve(a_packer.sink().size()); }) {
+    const auto count = size_t(a_last - a_first);
+    const size_t record_size = encoded_size(*a_first, a_packer.options());
+    a_packer.reserve(a_packer.sink().size() + record_size * count);
+  }
+
+  for (; a_first != a_last && !a_packer.ec; ++a_first) {
+    auto &&object = *a_first;
+    detail::pack_object(const_cast<std::remove_cvref_t<decltype(object)> &>(object), a_packer);
+  }
+}
+
+template<std::input_iterator I, std::sentinel_for<I> S>
+requires Serializable<std::iter_value_t<I>>
+std::vector<uint8_t> pack_range(I a_first, const S a_last, const PackerOptions &a_options, std::error_code &a_ec)
+{
+  auto packer = Packer{a_options};
+  pack_range(std::move(a_first), a_last, packer);
+  a_ec = packer.ec;
+  return packer.release();
+}
+
+template<std::input_iterator I, std::sentinel_for<I> S>
+requires Serializable<std::iter_value_t<I>>
+std::vector<uint8_t> pack_range(I a_first, const S a_last, std::error_code &a_ec)
+{
+  return pack_range(std::move(a_first), a_last, PackerOptions{}, a_ec);
+}
+
+/*!
+  Unpacks objects packed one after another, e.g. by pack_range(), until the end of the bytes,
+  writing them to the output iterator, with a single Unpacker.
+
+  \returns  the output iterator past the last object unpacked, not including the object at
+             which an error occurred, see a_ec.
+*/
+template<Serializable T, std::output_iterator<T> O>
+O unpack_range(const std::span<const uint8_t> a_bytes, O a_out, const NestedFormat a_nested_format, std::error_code &a_ec)
+{
+  auto unpacker = Unpacker(a_bytes.data(), a_bytes.size(), a_nested_format);
+  while (unpacker.remaining() > 0) {
+    auto object = T{};
+    detail::pack_object(object, unpacker);
+    if (unpacker.ec) break;
+    *a_out = std::move(object);
+    ++a_out;
+  }
+
+  a_ec = unpacker.ec;
+  return a_out;
+}
+
+template<Serializable T, std::output_iterator<T> O>
+O unpack_range(const std::span<const uint8_t> a_bytes, O a_out, std::error_code &a_ec)
+{
+  return unpack_range<T>(a_bytes, std::move(a_out), NestedFormat::Inline, a_ec);
+}
+
+#pragma endregion
+
+#pragma region - Stream unpacker
+
+namespace detail {
+
+/*!
+  The extent of a msgpack item: the size of its header, the size of its header and payload,
+  and the number of items contained, e.g. twice the number of entries of a map.
+*/
+struct ItemExtent
+{
+  std::size_t header;
+  std::size_t size;
+  uint64_t children;
+};
+
+/*!
+  Reads the extent of the item at the start of the given bytes, or std::nullopt if they end
+  before its payload does, or if it is not valid msgpack, setting a_ec.
+*/
+inline std::optional<ItemExtent> item_extent(const std::span<const uint8_t> a_bytes, std::error_code &a_ec)
+{
+  if (a_bytes.empty()) return std::nullopt;
+  const uint8_t format = a_bytes[0];
+
+  // A big-endian length of the given width after the format byte.
+  const auto length = [&](const std::size_t a_width) -> std::optional<uint64_t> {
+    if (a_bytes.size() < 1 + a_width) return std::nullopt;
+    uint64_t result{0};
+    for (std::size_t i = 1; i <= a_width; ++i) result = (result << 8U) | a_bytes[i];
+    return result;
+  };
+
+  const auto leaf = [&](const std::size_t a_header, const std::optional<uint64_t> a_payload) -> std::optional<ItemExtent> {
+    if (!a_payload || a_bytes.size() < a_header || a_bytes.size() - a_header < *a_payload) return std::nullopt;
+    return ItemExtent{a_header, a_header + std::size_t(*a_payload), 0};
+  };
+
+  const auto container = [&](const std::size_t a_width, const uint64_t a_factor) -> std::optional<ItemExtent> {
+    const auto count = length(a_width);
+    if (!count) return std::nullopt;
+    return ItemExtent{1 + a_width, 1 + a_width, a_factor * *count};
+  };
+
+  if (format <= 0x7F || format >= 0xE0) return ItemExtent{1, 1, 0};
+  if (format <= 0x8F) return ItemExtent{1, 1, 2U * (format & 0x0FU)};
+  if (format <= 0x9F) return ItemExtent{1, 1, format & 0x0FU};
+  if (format <= 0xBF) return leaf(1, format & 0x1FU);
+
+  switch (format) {
+    case nil:
+    case false_bool:
+    case true_bool: return ItemExtent{1, 1, 0};
+    case bin8:
+    case str8: return leaf(2, length(1));
+    case bin16:
+    case str16: return leaf(3, length(2));
+    case bin32:
+    case str32: return leaf(5, length(4));
+    case ext8: return leaf(3, length(1));
+    case ext16: return leaf(4, length(2));
+    case ext32: return leaf(6, length(4));
+    case uint8:
+    case int8: return leaf(1, 1);
+    case uint16:
+    case int16: return leaf(1, 2);
+    case float32:
+    case uint32:
+    case int32: return leaf(1, 4);
+    case float64:
+    case uint64:
+    case int64: return leaf(1, 8);
+    case fixext1:
+    case fixext2:
+    case fixext4:
+    case fixext8:
+    case fixext16: return leaf(2, uint64_t{1} << (format - fixext1));
+    case array16: return container(2, 1);
+    case array32: return container(4, 1);
+    case map16: return container(2, 2);
+    case map32: return container(4, 2);
+    default: a_ec = UnpackerError::DataNotMatchType;
+      return std::nullopt;
+  }
+}
+
+}
+
+/*!
+  Unpacks messages fed in chunks as they arrive, e.g. from a socket, rather than in whole.
+
+  Fed bytes are scanned once, item by item, keeping track of the containers left open, and
+  process() only tries to unpack when another top-level item is complete. Unpacking values
+  which need more bytes returns false, and leaves them buffered for the next try. Views of
+  unpacked values point into the buffer, and are valid until the next feed().
+
+  @code
+    auto stream = msgpack::StreamUnpacker{};
+    while (auto bytes = socket.read_some()) {
+      stream.feed(bytes);
+      for (auto trip = Trip{}; stream.process(trip); trip = Trip{}) handle(trip);
+      if (stream.ec) break;
+    }
+  @endcode
+*/
+class StreamUnpacker
+{
+public:
+  explicit StreamUnpacker(const NestedFormat a_nested_format = NestedFormat::Inline) : nested_format_(a_nested_format)
+  {};
+
+  StreamUnpacker(const StreamUnpacker &) = delete;
+  StreamUnpacker &operator=(const StreamUnpacker &) = delete;
+
+  /*!
+    Appends the given bytes to those buffered.
+  */
+  void feed(const std::span<const uint8_t> a_bytes)
+  {
+    if (scan_error_) return;
+    compact();
+    buffer_.insert(buffer_.end(), a_bytes.begin(), a_bytes.end());
+    scan();
+  }
+
+  /*!
+    Unpacks the given values from the complete items buffered.
+
+    \returns  false if more bytes are needed, or on errors, see ec, leaving the values partly
+               unpacked.
+  */
+  template<typename ... Ts>
+  bool process(Ts &... args)
+  {
+    if (ec) return false;
+    if (boundaries_.size() <= attempted_) {
+      // Items before invalid bytes are unpacked first.
+      ec = scan_error_;
+      return false;
+    }
+
+    const std::size_t end = boundaries_.back();
+    auto unpacker = Unpacker(buffer_.data() + begin_, end - begin_, nested_format_);
+    unpacker.process(args...);
+
+    if (unpacker.ec == UnpackerError::OutOfRange) {
+      attempted_ = boundaries_.size();
+      return false;
+    }
+
+    if (unpacker.ec) {
+      ec = unpacker.ec;
+      return false;
+    }
+
+    begin_ = end - unpacker.remaining();
+    while (!boundaries_.empty() && boundaries_.front() <= begin_) boundaries_.pop_front();
+    attempted_ = 0;
+    return true;
+  }
+
+  /*!
+    The number of bytes buffered and not unpacked yet.
+  */
+  [[nodiscard]] std::size_t buffered() const
+  {
+    return buffer_.size() - begin_;
+  }
+
+  std::error_code ec{};
+
+private:
+  /*!
+    Drops the bytes unpacked already.
+  */
+  void compact()
+  {
+    if (begin_ == 0) return;
+    buffer_.erase(buffer_.begin(), buffer_.begin() + std::ptrdiff_t(begin_));
+    scanned_ -= begin_;
+    for (auto &boundary : boundaries_) boundary -= begin_;
+    begin_ = 0;
+  }
+
+  /*!
+    Scans the items fed since the last scan, recording where top-level items end.
+  */
+  void scan()
+  {
+    while (!scan_error_) {
+      const auto extent = detail::item_extent({buffer_.data() + scanned_, buffer_.size() - scanned_}, scan_error_);
+      if (!extent) return;
+
+      scanned_ += extent->size;
+      if (extent->children > 0) {
+        open_.push_back(extent->children);
+        continue;
+      }
+
+      while (!open_.empty() && --open_.back() == 0) open_.pop_back();
+      if (open_.empty()) boundaries_.push_back(scanned_);
+    }
+  }
+
+  std::vector<uint8_t> buffer_{};
+  std::size_t begin_{0};
+  std::size_t scanned_{0};
+  std::vector<uint64_t> open_{};
+  std::deque<std::size_t> boundaries_{};
+  std::size_t attempted_{0};
+  std::error_code scan_error_{};
+  NestedFormat nested_format_{NestedFormat::Inline};
+};
+
+#pragma endregion
+
+#pragma region - Visitor
+
+/*!
+  Skips the given number of items, containers with all their contents, jumping over strings,
+  binaries and ext by their lengths.
+
+  \returns  the number of bytes skipped, or 0 on errors, see a_ec.
+*/
+inline std::size_t skip(const std::span<const uint8_t> a_bytes, uint64_t a_count, std::error_code &a_ec)
+{
+  std::size_t size{0};
+  while (a_count > 0) {
+    const auto extent = detail::item_extent(a_bytes.subspan(size), a_ec);
+    if (!extent) {
+      if (!a_ec) a_ec = UnpackerError::OutOfRange;
+      return 0;
+    }
+
+    size += extent->size;
+    a_count += extent->children - 1;
+  }
+  return size;
+}
+
+/*!
+  Skips the item at the start of the given bytes, see skip(bytes, count, ec).
+*/
+inline std::size_t skip(const std::span<const uint8_t> a_bytes, std::error_code &a_ec)
+{
+  return skip(a_bytes, 1, a_ec);
+}
+
+/*!
+  What visit() does after an event. Skip jumps over the contents of the array or map begun.
+*/
+enum class VisitAction
+{
+  Continue,
+  Skip,
+  Stop
+};
+
+namespace detail {
+
+template<typename EventT>
+VisitAction fire(EventT &&a_event)
+{
+  if constexpr (std::is_void_v<decltype(a_event())>)
+    return a_event(), VisitAction::Continue;
+  else
+    return a_event();
+}
+
+inline uint64_t read_big_endian(const std::span<const uint8_t> a_bytes)
+{
+  uint64_t result{0};
+  for (const auto byte : a_bytes) result = (result << 8U) | byte;
+  return result;
+}
+
+/*!
+  Fires the event of the item at the start of the given bytes, of the given extent.
+*/
+template<typename HandlerT>
+VisitAction visit_item(const std::span<const uint8_t> a_bytes, const ItemExtent &a_extent, HandlerT &a_handler)
+{
+  const uint8_t format = a_bytes[0];
+  const auto payload = a_bytes.subspan(a_extent.header, a_extent.size - a_extent.header);
+  const auto value = [&]() { return read_big_endian(payload); };
+
+  if (format <= 0x7F || (format >= uint8 && format <= uint64)) {
+    const uint64_t number = format <= 0x7F ? format : value();
+    if constexpr (requires { a_handler.on_uint(number); })
+      return fire([&]() { return a_handler.on_uint(number); });
+  } else if (format >= 0xE0 || (format >= int8 && format <= int64)) {
+    const auto width = payload.size();
+    const int64_t number = format >= 0xE0 ? int8_t(format)
+                                          : int64_t(value() << (64 - 8 * width)) >> (64 - 8 * width);
+    if constexpr (requires { a_handler.on_int(number); })
+      return fire([&]() { return a_handler.on_int(number); });
+  } else if (format == float32 || format == float64) {
+    const double number = format == float32 ? double(std::bit_cast<float>(uint32_t(value())))
+                                            : std::bit_cast<double>(value());
+    if constexpr (requires { a_handler.on_float(number); })
+      return fire([&]() { return a_handler.on_float(number); });
+  } else if (format == nil) {
+    if constexpr (requires { a_handler.on_nil(); })
+      return fire([&]() { return a_handler.on_nil(); });
+  } else if (format == false_bool || format == true_bool) {
+    if constexpr (requires { a_handler.on_bool(true); })
+      return fire([&]() { return a_handler.on_bool(format == true_bool); });
+  } else if ((format >= 0xA0 && format <= 0xBF) || (format >= str8 && format <= str32)) {
+    const auto text = std::string_view{reinterpret_cast<const char *>(payload.data()), payload.size()};
+    if constexpr (requires { a_handler.on_str(text); })
+      return fire([&]() { return a_handler.on_str(text); });
+  } else if (format >= bin8 && format <= bin32) {
+    if constexpr (requires { a_handler.on_bin(payload); })
+      return fire([&]() { return a_handler.on_bin(payload); });
+  } else if ((format >= ext8 && format <= ext32) || (format >= fixext1 && format <= fixext16)) {
+    const auto type = int8_t(a_bytes[a_extent.header - 1]);
+    if constexpr (requires { a_handler.on_ext(type, payload); })
+      return fire([&]() { return a_handler.on_ext(type, payload); });
+  } else if ((format >= 0x90 && format <= 0x9F) || format == array16 || format == array32) {
+    const auto size = a_extent.children;
+    if constexpr (requires { a_handler.on_array_begin(size); })
+      return fire([&]() { return a_handler.on_array_begin(size); });
+  } else {
+    const auto size = a_extent.children / 2;
+    if constexpr (requires { a_handler.on_map_begin(size); })
+      return fire([&]() { return a_handler.on_map_begin(size); });
+  }
+  return VisitAction::Continue;
+}
+
+template<typename HandlerT>
+VisitAction visit_end(const bool a_is_map, HandlerT &a_handler)
+{
+  if (a_is_map) {
+    if constexpr (requires { a_handler.on_map_end(); })
+      return fire([&]() { return a_handler.on_map_end(); });
+  } else {
+    if constexpr (requires { a_handler.on_array_end(); })
+      return fire([&]() { return a_handler.on_array_end(); });
+  }
+  return VisitAction::Continue;
+}
+
+}
+
+/*!
+  Walks the items of the given bytes, firing the events of the handler without unpacking them
+  into objects, e.g. to read a few fields of a big message or to route it.
+
+  The handler implements the events it needs of on_nil(), on_bool(bool), on_int(int64_t),
+  on_uint(uint64_t), on_float(double), on_str(std::string_view), on_bin(std::span), on_ext(int8_t,
+  std::span), on_array_begin(uint64_t), on_array_end(), on_map_begin(uint64_t) and on_map_end(),
+  each returning void or a VisitAction. Signed formats fire on_int, and unsigned ones on_uint.
+  Strings, binaries and ext point into the bytes. Map entries fire key and value in turn.
+
+  @code
+    struct Router {
+      bool found{false};
+      std::string_view destination{};
+      msgpack::VisitAction on_str(std::string_view s) {
+        if (found) return destination = s, msgpack::VisitAction::Stop;
+        found = s == "destination";
+        return msgpack::VisitAction::Continue;
+      }
+    };
+  @endcode
+
+  \returns  the number of bytes visited, less than given if stopped or on errors, see a_ec.
+*/
+template<typename HandlerT>
+std::size_t visit(const std::span<const uint8_t> a_bytes, HandlerT &&a_handler, std::error_code &a_ec)
+{
+  struct Open
+  {
+    uint64_t left;
+    bool is_map;
+  };
+
+  auto open = std::vector<Open>{};
+  std::size_t position{0};
+
+  while (position < a_bytes.size()) {
+    const auto bytes = a_bytes.subspan(position);
+    const auto extent = detail::item_extent(bytes, a_ec);
+    if (!extent) {
+      if (!a_ec) a_ec = UnpackerError::OutOfRange;
+      return position;
+    }
+
+    const uint8_t format = bytes[0];
+    const bool is_map = (format >= 0x80 && format <= 0x8F) || format == map16 || format == map32;
+    const bool is_container = is_map || (format >= 0x90 && format <= 0x9F) || format == array16 || format == array32;
+
+    const auto action = detail::visit_item(bytes, *extent, a_handler);
+    if (action == VisitAction::Stop) return position;
+    position += extent->size;
+
+    if (is_container && action != VisitAction::Skip) {
+      if (extent->children > 0) {
+        open.push_back({extent->children, is_map});
+        continue;
+      }
+      if (detail::visit_end(is_map, a_handler) == VisitAction::Stop) return position;
+    } else if (is_container) {
+      const auto skipped = skip(a_bytes.subspan(position), extent->children, a_ec);
+      if (a_ec) return position;
+      position += skipped;
+    }
+
+    // Closes the containers the item completes.
+    while (!open.empty() && --open.back().left == 0) {
+      const auto is_map_end = open.back().is_map;
+      open.pop_back();
+      if (detail::visit_end(is_map_end, a_handler) == VisitAction::Stop) return position;
+    }
+  }
+
+  if (!open.empty()) a_ec = UnpackerError::OutOfRange;
+  return position;
+}
+
+#pragma endregion
+
 }
 #endif
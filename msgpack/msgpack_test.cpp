@@ -12,6 +12,20 @@
 
 #include <doctest/doctest.h>
 #include <msgpack/msgpack.hpp>
+#include <msgpack/blockcompress.hpp>
+#include <msgpack/framedreader.hpp>
+#include <msgpack/json.hpp>
+#include <msgpack/series.hpp>
+#include <meta_enum/meta_enum.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory_resource>
+#include <numeric>
+
+meta_enum_class(SignalPhase, uint8_t, Green = 3, Amber = 50, Red = 200);
+meta_enum_codec(SignalPhase);
 
 TEST_CASE("scenario: packing types")
 {
@@ -168,6 +182,53 @@ TEST_CASE("scenario: packing types")
     }
   }
 
+  SUBCASE("test packing float bits") {
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    packer.process(3.0, 1.5f);
+    CHECK(packer.vector() == std::vector<uint8_t>{0xcb, 0x40, 0x08, 0, 0, 0, 0, 0, 0, 0xca, 0x3f, 0xc0, 0, 0});
+
+    auto x = 0.0;
+    auto y = 0.0;
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(x, y);
+    CHECK(x == 3.0);
+    CHECK(y == 1.5);
+
+    const auto values = std::vector<double>{-0.0, std::numeric_limits<double>::infinity(), std::numeric_limits<double>::denorm_min(),
+                                            std::numeric_limits<double>::max(), 1e300, -123.456};
+    packer.clear();
+    packer.process(values, std::numeric_limits<float>::quiet_NaN());
+    auto unpacked = std::vector<double>{};
+    auto nan = 0.0f;
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked, nan);
+    CHECK(unpacked == values);
+    CHECK(std::signbit(unpacked[0]));
+    CHECK(std::isnan(nan));
+
+    auto compact_packer = msgpack::Packer{msgpack::PackerOptions{.float_format = msgpack::FloatFormat::CompactIntegral}};
+    compact_packer.process(3.0, 7.0f, 2.5, 1e300);
+    CHECK(std::vector<uint8_t>(compact_packer.vector().begin(), compact_packer.vector().begin() + 2) == std::vector<uint8_t>{0x03, 0x07});
+    CHECK(compact_packer.vector().size() == 2 + 9 + 9);
+
+    auto a = 0.0;
+    auto b = 0.0f;
+    auto c = 0.0;
+    auto d = 0.0;
+    unpacker.set_data(compact_packer.vector().data(), compact_packer.vector().size());
+    unpacker.process(a, b, c, d);
+    CHECK(a == 3.0);
+    CHECK(b == 7.0f);
+    CHECK(c == 2.5);
+    CHECK(d == 1e300);
+
+    unpacker.set_data(packer.vector().data() + 1, 5);
+    unpacker.process(x);
+    CHECK(unpacker.ec == msgpack::UnpackerError::OutOfRange);
+  }
+
   SUBCASE("test packing string") {
     auto packer = msgpack::Packer{};
     auto unpacker = msgpack::Unpacker{};
@@ -194,6 +255,74 @@ TEST_CASE("scenario: packing types")
     CHECK(vec1 == std::vector<uint8_t>{1, 2, 3, 4});
   }
 
+  SUBCASE("test unpacking views") {
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    auto str1 = std::string("link-1024");
+    auto bin1 = std::vector<uint8_t>(300, 9);
+    packer.process(str1, bin1, std::string_view{"route"}, std::span<const uint8_t>{bin1.data(), 3});
+
+    const auto &data = packer.vector();
+    auto str2 = std::string_view{};
+    auto bin2 = std::span<const uint8_t>{};
+    auto str3 = std::string_view{};
+    auto bin3 = std::span<const uint8_t>{};
+    unpacker.set_data(data.data(), data.size());
+    unpacker.process(str2, bin2, str3, bin3);
+    CHECK(!unpacker.ec);
+    CHECK(str2 == "link-1024");
+    CHECK(reinterpret_cast<const uint8_t *>(str2.data()) == data.data() + 1);
+    CHECK(std::ranges::equal(bin2, bin1));
+    CHECK(bin2.data() == data.data() + 1 + 9 + 3);
+    CHECK(str3 == "route");
+    CHECK(std::ranges::equal(bin3, std::vector<uint8_t>{9, 9, 9}));
+
+    auto views = std::vector<std::string_view>{};
+    packer.clear();
+    packer.process(std::vector<std::string>{"one", "two"});
+    unpacker.set_data(data.data(), data.size());
+    unpacker.process(views);
+    CHECK(views == std::vector<std::string_view>{"one", "two"});
+
+    auto short_view = std::string_view{};
+    unpacker.set_data(data.data(), 3);
+    unpacker.process(views, short_view);
+    CHECK(unpacker.ec == msgpack::UnpackerError::OutOfRange);
+  }
+
+  SUBCASE("test packing big-endian lengths") {
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    auto str1 = std::string(40, 'a');
+    auto str2 = std::string(300, 'b');
+    auto vec1 = std::vector<uint32_t>(20, 0x12345678);
+    auto bin1 = std::vector<uint8_t>(70000, 7);
+    packer.reserve(72000);
+    packer.process(str1, str2, vec1, bin1);
+
+    const auto &data = packer.vector();
+    CHECK(data.size() == 2 + 40 + 3 + 300 + 3 + 20 * 5 + 5 + 70000);
+    CHECK(std::vector<uint8_t>(data.begin(), data.begin() + 2) == std::vector<uint8_t>{0xd9, 40});
+    CHECK(std::vector<uint8_t>(data.begin() + 42, data.begin() + 45) == std::vector<uint8_t>{0xda, 0x01, 0x2c});
+    CHECK(std::vector<uint8_t>(data.begin() + 345, data.begin() + 353)
+          == std::vector<uint8_t>{0xdc, 0x00, 0x14, 0xce, 0x12, 0x34, 0x56, 0x78});
+    CHECK(std::vector<uint8_t>(data.begin() + 448, data.begin() + 453) == std::vector<uint8_t>{0xc6, 0x00, 0x01, 0x11, 0x70});
+
+    auto str3 = std::string{};
+    auto str4 = std::string{};
+    auto vec2 = std::vector<uint32_t>{};
+    auto bin2 = std::vector<uint8_t>{};
+    unpacker.set_data(data.data(), data.size());
+    unpacker.process(str3, str4, vec2, bin2);
+    CHECK(!unpacker.ec);
+    CHECK(str3 == str1);
+    CHECK(str4 == str2);
+    CHECK(vec2 == vec1);
+    CHECK(bin2 == bin1);
+  }
+
   SUBCASE("test packing array type") {
     auto packer = msgpack::Packer{};
     auto unpacker = msgpack::Unpacker{};
@@ -224,6 +353,55 @@ TEST_CASE("scenario: packing types")
     CHECK(arr == std::array<std::string, 3>{"one", "two", "three"});
   }
 
+  SUBCASE("test packing typed arrays") {
+    auto packer = msgpack::Packer{msgpack::PackerOptions{.array_format = msgpack::ArrayFormat::Typed}};
+    auto unpacker = msgpack::Unpacker{};
+
+    const auto ints = std::vector<int32_t>{1, -2};
+    const auto floats = std::array<float, 1>{1.5f};
+    packer.process(ints, floats);
+    CHECK(packer.vector() == std::vector<uint8_t>{0xc7, 8, msgpack::int32_array, 1, 0, 0, 0, 0xfe, 0xff, 0xff, 0xff,
+                                                  0xc7, 4, msgpack::float32_array, 0, 0, 0xc0, 0x3f});
+
+    auto unpacked_ints = std::vector<int32_t>{};
+    auto unpacked_floats = std::array<float, 1>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked_ints, unpacked_floats);
+    CHECK(unpacked_ints == ints);
+    CHECK(unpacked_floats == floats);
+
+    auto series = std::vector<double>(100000);
+    for (size_t i = 0; i < series.size(); ++i) series[i] = 0.5 * double(i);
+    packer.clear();
+    packer.process(series);
+    CHECK(packer.vector().size() == 1 + 4 + 1 + series.size() * sizeof(double));
+    CHECK(packer.vector()[0] == msgpack::ext32);
+
+    auto unpacked_series = std::vector<double>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked_series);
+    CHECK(unpacked_series == series);
+
+    // Typed arrays are read as their element type only.
+    auto wrong = std::vector<float>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(wrong);
+    CHECK(unpacker.ec == msgpack::UnpackerError::DataNotMatchType);
+
+    auto short_array = std::array<double, 3>{};
+    auto array_unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    array_unpacker.process(short_array);
+    CHECK(array_unpacker.ec == msgpack::UnpackerError::BadStdArraySize);
+
+    // Generic arrays still unpack into the same types.
+    auto generic_packer = msgpack::Packer{};
+    generic_packer.process(ints);
+    unpacked_ints.clear();
+    auto generic_unpacker = msgpack::Unpacker{generic_packer.vector().data(), generic_packer.vector().size()};
+    generic_unpacker.process(unpacked_ints);
+    CHECK(unpacked_ints == ints);
+  }
+
   SUBCASE("test packing map") {
     auto packer = msgpack::Packer{};
     auto unpacker = msgpack::Unpacker{};
@@ -238,6 +416,74 @@ TEST_CASE("scenario: packing types")
     CHECK(map1 == std::map<uint8_t, std::string>{std::make_pair(0, "zero"), std::make_pair(1, "one")});
   }
 
+  SUBCASE("test unpacking into containers in place") {
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    const auto links = std::map<std::string, std::vector<int>>{{"a", {1, 2}}, {"b", {}}, {"c", {3}}};
+    const auto nodes = std::set<int>{3, 1, 2};
+    packer.process(links, nodes, links);
+
+    auto unpacked_links = std::map<std::string, std::vector<int>>{{"a", {9}}};
+    auto unpacked_nodes = std::set<int>{};
+    auto unordered_links = std::unordered_map<std::string, std::vector<int>>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked_links, unpacked_nodes, unordered_links);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked_links == links);
+    CHECK(unpacked_nodes == nodes);
+    CHECK(unordered_links.size() == 3);
+    CHECK(unordered_links["a"] == std::vector<int>{1, 2});
+  }
+
+  SUBCASE("test unpacking pmr map keys allocates from the container resource only") {
+    auto packer = msgpack::Packer{};
+    const auto counts = std::map<std::string, std::vector<std::string>>{{std::string(64, 'k'), {std::string(64, 'v')}}};
+    const auto tags = std::set<std::string>{std::string(64, 't')};
+    packer.process(counts, tags);
+
+    auto arena = std::pmr::monotonic_buffer_resource{};
+    auto unpacked_counts = std::pmr::map<std::pmr::string, std::pmr::vector<std::pmr::string>>{&arena};
+    auto unpacked_tags = std::pmr::set<std::pmr::string>{&arena};
+
+    // Any allocation of a temporary from the default resource would throw.
+    auto *previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked_counts, unpacked_tags);
+    std::pmr::set_default_resource(previous);
+
+    CHECK(!unpacker.ec);
+    REQUIRE(unpacked_counts.size() == 1);
+    CHECK(std::string_view{unpacked_counts.begin()->first} == std::string(64, 'k'));
+    CHECK(std::string_view{unpacked_counts.begin()->second.at(0)} == std::string(64, 'v'));
+    CHECK(unpacked_tags.contains(std::pmr::string(64, 't')));
+  }
+
+  SUBCASE("test unpacking into pmr containers") {
+    auto packer = msgpack::Packer{};
+    const auto names = std::vector<std::string>{"one", std::string(100, 'x')};
+    const auto counts = std::map<std::string, int>{{"links", 2}, {"nodes", 3}};
+    packer.process(names, counts, std::vector<uint8_t>{1, 2});
+
+    auto buffer = std::array<std::byte, 4096>{};
+    auto arena = std::pmr::monotonic_buffer_resource{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+    auto unpacked_names = std::pmr::vector<std::pmr::string>{&arena};
+    auto unpacked_counts = std::pmr::map<std::pmr::string, int>{&arena};
+    auto unpacked_bytes = std::pmr::vector<uint8_t>{&arena};
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked_names, unpacked_counts, unpacked_bytes);
+    CHECK(!unpacker.ec);
+    REQUIRE(unpacked_names.size() == 2);
+    CHECK(std::string_view{unpacked_names[1]} == names[1]);
+    CHECK(unpacked_names[1].get_allocator().resource() == &arena);
+    CHECK(unpacked_counts.at("nodes") == 3);
+    CHECK(unpacked_bytes == std::pmr::vector<uint8_t>{1, 2});
+
+    auto repacker = msgpack::Packer{};
+    repacker.process(unpacked_names, unpacked_counts, unpacked_bytes);
+    CHECK(repacker.vector() == packer.vector());
+  }
+
   SUBCASE("test packing unordered map") {
     auto packer = msgpack::Packer{};
     auto unpacker = msgpack::Unpacker{};
@@ -251,6 +497,46 @@ TEST_CASE("scenario: packing types")
     CHECK(map1[0] == map_copy[0]);
     CHECK(map1[1] == map_copy[1]);
   }
+
+  SUBCASE("test packing enums as their underlying integer") {
+    enum class LaneModes : uint16_t { Bus = 1 << 0, Car = 1 << 1, Bike = 1 << 15 };
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    auto modes = static_cast<LaneModes>(uint16_t(LaneModes::Bus) | uint16_t(LaneModes::Bike));
+    auto lanes = std::vector<LaneModes>{LaneModes::Bus, LaneModes::Car};
+    packer.process(modes, lanes);
+    CHECK(packer.vector() == std::vector<uint8_t>{0xcd, 0x80, 0x01, 0x92, 0x01, 0x02});
+
+    auto unpacked_modes = LaneModes{};
+    auto unpacked_lanes = std::vector<LaneModes>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked_modes, unpacked_lanes);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked_modes == modes);
+    CHECK(unpacked_lanes == lanes);
+  }
+
+  SUBCASE("test packing enums with a codec as the index of their member") {
+    auto packer = msgpack::Packer{};
+    auto unpacker = msgpack::Unpacker{};
+
+    auto kinds = std::vector<SignalPhase>{SignalPhase::Red, SignalPhase::Green, SignalPhase::Amber};
+    packer.process(kinds);
+    CHECK(packer.vector() == std::vector<uint8_t>{0x93, 0x02, 0x00, 0x01});
+
+    auto unpacked_kinds = std::vector<SignalPhase>{};
+    unpacker.set_data(packer.vector().data(), packer.vector().size());
+    unpacker.process(unpacked_kinds);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked_kinds == kinds);
+
+    auto bad_index = std::vector<uint8_t>{0x03};
+    auto phase = SignalPhase{};
+    unpacker.set_data(bad_index.data(), bad_index.size());
+    unpacker.process(phase);
+    CHECK(unpacker.ec == msgpack::UnpackerError::DataNotMatchType);
+  }
 }
 
 struct NestedObject
@@ -276,6 +562,155 @@ struct BaseObject
   }
 };
 
+struct Trip
+{
+  int id{};
+  std::vector<BaseObject> legs{};
+  BaseObject last{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(id, legs, last);
+  }
+};
+
+struct Polyline
+{
+  std::vector<float> coordinates{};
+};
+
+template<>
+struct msgpack::ExtTraits<Polyline>
+{
+  static constexpr int8_t type = 1;
+
+  static size_t size(const Polyline &a_line)
+  {
+    return a_line.coordinates.size() * sizeof(float);
+  }
+
+  static void encode(const Polyline &a_line, auto &&a_write)
+  {
+    a_write(reinterpret_cast<const uint8_t *>(a_line.coordinates.data()), size(a_line));
+  }
+
+  static bool decode(std::span<const uint8_t> a_payload, Polyline &a_line)
+  {
+    if (a_payload.size() % sizeof(float) != 0) return false;
+    a_line.coordinates.resize(a_payload.size() / sizeof(float));
+    std::memcpy(a_line.coordinates.data(), a_payload.data(), a_payload.size());
+    return true;
+  }
+};
+
+TEST_CASE("scenario: packing ext types")
+{
+  SUBCASE("test packing registered types") {
+    auto packer = msgpack::Packer{};
+    const auto point = Polyline{{1.0f, 2.0f}};
+    const auto line = Polyline{{1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f}};
+    packer.process(point, line);
+    CHECK(packer.vector()[0] == msgpack::fixext8);
+    CHECK(packer.vector()[1] == 1);
+    CHECK(packer.vector()[10] == msgpack::ext8);
+    CHECK(packer.vector()[11] == 24);
+    CHECK(packer.vector()[12] == 1);
+    CHECK(packer.vector().size() == 10 + 3 + 24);
+
+    auto unpacked_point = Polyline{};
+    auto unpacked_line = Polyline{};
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked_point, unpacked_line);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked_point.coordinates == point.coordinates);
+    CHECK(unpacked_line.coordinates == line.coordinates);
+
+    // Readers without the type skip it as a whole.
+    std::error_code ec{};
+    CHECK(msgpack::skip(packer.vector(), 2, ec) == packer.vector().size());
+
+    auto timestamp = msgpack::Timestamp{};
+    auto mismatched = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    mismatched.process(timestamp);
+    CHECK(mismatched.ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+
+  SUBCASE("test packing timestamps") {
+    auto packer = msgpack::Packer{};
+    packer.process(msgpack::Timestamp{1, 0});
+    CHECK(packer.vector() == std::vector<uint8_t>{0xd6, 0xff, 0, 0, 0, 1});
+
+    packer.clear();
+    packer.process(msgpack::Timestamp{1, 1});
+    CHECK(packer.vector() == std::vector<uint8_t>{0xd7, 0xff, 0, 0, 0, 0x04, 0, 0, 0, 1});
+
+    const auto timestamps = std::vector<msgpack::Timestamp>{{1700000000, 0}, {1700000000, 999999999},
+                                                            {int64_t{1} << 40, 5}, {-1, 500}};
+    packer.clear();
+    packer.process(timestamps);
+    CHECK(packer.vector()[packer.vector().size() - 15] == msgpack::ext8);
+
+    auto unpacked = std::vector<msgpack::Timestamp>{};
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked == timestamps);
+  }
+
+  SUBCASE("test unpacking timestamps into time points") {
+    using namespace std::chrono;
+    const auto now = time_point_cast<microseconds>(system_clock::now());
+    auto packer = msgpack::Packer{};
+    packer.process(msgpack::Timestamp::from(now));
+
+    auto unpacked = system_clock::time_point{};
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked == now);
+  }
+}
+
+struct Waypoint
+{
+  double x{};
+  double y{};
+  std::string label{};
+};
+
+struct Route
+{
+  uint32_t id{};
+  std::vector<Waypoint> waypoints{};
+  BaseObject tag{};
+  std::map<std::string, int> counts{};
+};
+
+static_assert(msgpack::MsgPackReflectable<Waypoint>);
+static_assert(!msgpack::MsgPackReflectable<std::array<int, 2>>);
+static_assert(msgpack::Serializable<Route> && msgpack::Serializable<BaseObject>);
+
+struct LinkRecord
+{
+  int64_t id{};
+  std::string name{};
+  double speed{};
+  std::vector<int> lanes{};
+};
+
+template<>
+struct msgpack::MapTraits<LinkRecord>
+{
+  using fields = msgpack::MapFields<
+      msgpack::MapField<"id", &LinkRecord::id>,
+      msgpack::MapField<"name", &LinkRecord::name>,
+      msgpack::MapField<"speed", &LinkRecord::speed>,
+      msgpack::MapField<"lanes", &LinkRecord::lanes>>;
+};
+
+static_assert(msgpack::MsgPackMapObject<LinkRecord> && msgpack::Serializable<LinkRecord>);
+
 TEST_CASE("scenario: packing object")
 {
   SUBCASE("test user objects serialization") {
@@ -286,6 +721,991 @@ TEST_CASE("scenario: packing object")
     CHECK(object.first_member == unpacked_object.first_member);
     CHECK(object.second_member.nested_value == unpacked_object.second_member.nested_value);
   }
+
+  SUBCASE("test aggregates packed by their fields") {
+    auto route = Route{7, {{1.5, -2.0, "a"}, {3.0, 4.0, "b"}}, {8, {"tag"}}, {{"stops", 2}}};
+    auto data = msgpack::pack(route);
+
+    auto packer = msgpack::Packer{};
+    packer.process(route.id, route.waypoints, route.tag, route.counts);
+    CHECK(data == packer.vector());
+
+    auto unpacked = msgpack::unpack<Route>(data);
+    CHECK(unpacked.id == 7);
+    REQUIRE(unpacked.waypoints.size() == 2);
+    CHECK(unpacked.waypoints[1].x == 3.0);
+    CHECK(unpacked.waypoints[1].label == "b");
+    CHECK(unpacked.tag.second_member.nested_value == "tag");
+    CHECK(unpacked.counts == route.counts);
+
+    // Fields pack as a pack() method passing them all would.
+    auto waypoint = Waypoint{1.5, -2.0, "a"};
+    auto fields = msgpack::Packer{};
+    fields.process(waypoint.x, waypoint.y, waypoint.label);
+    CHECK(msgpack::pack(waypoint) == fields.vector());
+  }
+
+  SUBCASE("test objects packed as maps") {
+    auto link = LinkRecord{42, "Main St", 13.5, {1, 2}};
+    auto data = msgpack::pack(link);
+    REQUIRE(data.size() > 4);
+    CHECK(data[0] == 0x84);
+    CHECK(data[1] == 0xa2);
+    CHECK(data[2] == 'i');
+
+    auto unpacked = msgpack::unpack<LinkRecord>(data);
+    CHECK(unpacked.id == 42);
+    CHECK(unpacked.name == "Main St");
+    CHECK(unpacked.speed == 13.5);
+    CHECK(unpacked.lanes == link.lanes);
+
+    // Keys in any order, unknown ones skipped, and missing ones left as they are.
+    auto partner = std::map<std::string, std::vector<int>>{{"lanes", {3}}, {"extra", {9, 9}}, {"ids", {1}}};
+    auto packer = msgpack::Packer{};
+    packer.process(partner);
+    const auto &map = packer.vector();
+    std::error_code ec{};
+    auto decoded = LinkRecord{7, "kept", 1.0, {}};
+    msgpack::Unpacker unpacker{map.data(), map.size()};
+    unpacker.process(decoded);
+    CHECK(!unpacker.ec);
+    CHECK(decoded.id == 7);
+    CHECK(decoded.name == "kept");
+    CHECK(decoded.lanes == std::vector<int>{3});
+    CHECK(unpacker.remaining() == 0);
+
+    auto reordered = msgpack::Packer{};
+    reordered.process(std::string_view{"speed"}, 2.5, std::string_view{"id"}, int64_t{9});
+    auto bytes = std::vector<uint8_t>{0x82};
+    bytes.insert(bytes.end(), reordered.vector().begin(), reordered.vector().end());
+    decoded = msgpack::unpack<LinkRecord>(bytes, ec);
+    CHECK(!ec);
+    CHECK(decoded.id == 9);
+    CHECK(decoded.speed == 2.5);
+
+    msgpack::unpack<LinkRecord>(std::vector<uint8_t>{0x93, 0x01, 0x02, 0x03}, ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+    msgpack::unpack<LinkRecord>(std::vector<uint8_t>{0x81, 0x01, 0x02}, ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+    data.resize(data.size() - 2);
+    msgpack::unpack<LinkRecord>(data, ec);
+    CHECK(ec);
+  }
+
+  SUBCASE("test nested objects packed inline") {
+    auto object = BaseObject{12345, {"Nested"}};
+    auto data = msgpack::pack(object);
+    CHECK(data == std::vector<uint8_t>{0xd1, 0x30, 0x39, 0xa6, 0x4e, 0x65, 0x73, 0x74, 0x65, 0x64});
+
+    auto trip = Trip{7, {{1, {"a"}}, {2, {"b"}}}, {3, {"c"}}};
+    std::error_code ec{};
+    auto unpacked_trip = msgpack::unpack<Trip>(msgpack::pack(trip), ec);
+    CHECK(!ec);
+    CHECK(unpacked_trip.id == 7);
+    CHECK(unpacked_trip.legs.size() == 2);
+    CHECK(unpacked_trip.legs[1].first_member == 2);
+    CHECK(unpacked_trip.legs[1].second_member.nested_value == "b");
+    CHECK(unpacked_trip.last.second_member.nested_value == "c");
+  }
+
+  SUBCASE("test nested objects packed as binary") {
+    auto object = BaseObject{12345, {"Nested"}};
+    std::error_code ec{};
+    auto data = msgpack::pack(object, msgpack::NestedFormat::Binary, ec);
+    CHECK(!ec);
+    CHECK(data == std::vector<uint8_t>{0xd1, 0x30, 0x39, 0xc4, 0x07, 0xa6, 0x4e, 0x65, 0x73, 0x74, 0x65, 0x64});
+
+    auto unpacked_object = msgpack::unpack<BaseObject>(data.data(), data.size(), msgpack::NestedFormat::Binary, ec);
+    CHECK(!ec);
+    CHECK(unpacked_object.second_member.nested_value == "Nested");
+
+    auto trip = Trip{7, {{1, {std::string(300, 'a')}}, {2, {"b"}}}, {3, {"c"}}};
+    data = msgpack::pack(trip, msgpack::NestedFormat::Binary, ec);
+    auto unpacked_trip = msgpack::unpack<Trip>(data.data(), data.size(), msgpack::NestedFormat::Binary, ec);
+    CHECK(!ec);
+    CHECK(unpacked_trip.legs[0].second_member.nested_value == std::string(300, 'a'));
+    CHECK(unpacked_trip.legs[1].second_member.nested_value == "b");
+    CHECK(unpacked_trip.last.first_member == 3);
+
+    data.resize(data.size() - 4);
+    msgpack::unpack<Trip>(data.data(), data.size(), msgpack::NestedFormat::Binary, ec);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+  }
+}
+
+TEST_CASE("scenario: packing ranges")
+{
+  auto waypoints = std::vector<Waypoint>{};
+  for (int i = 0; i < 1000; ++i) waypoints.push_back({double(i), -double(i), std::to_string(i)});
+
+  SUBCASE("test packing and unpacking records") {
+    std::error_code ec{};
+    const auto data = msgpack::pack_range(waypoints.begin(), waypoints.end(), ec);
+    CHECK(!ec);
+
+    auto packer = msgpack::Packer{};
+    for (auto &waypoint : waypoints) packer.process(waypoint);
+    CHECK(data == packer.vector());
+
+    auto unpacked = std::vector<Waypoint>{};
+    msgpack::unpack_range<Waypoint>(data, std::back_inserter(unpacked), ec);
+    CHECK(!ec);
+    REQUIRE(unpacked.size() == waypoints.size());
+    CHECK(unpacked[999].label == "999");
+    CHECK(unpacked[500].y == -500.0);
+  }
+
+  SUBCASE("test packing into a reused packer") {
+    auto buffer = std::vector<uint8_t>{};
+    auto packer = msgpack::BasicPacker{msgpack::ContainerSink{buffer}};
+    msgpack::pack_range(waypoints.begin(), waypoints.begin() + 10, packer);
+    const auto size = buffer.size();
+    msgpack::pack_range(waypoints.begin() + 10, waypoints.end(), packer);
+    CHECK(!packer.ec);
+    CHECK(buffer.size() > size);
+
+    auto trips = std::list<Trip>{{1, {}, {2, {"a"}}}, {3, {{4, {"b"}}}, {5, {"c"}}}};
+    auto trip_packer = msgpack::Packer{};
+    msgpack::pack_range(trips.begin(), trips.end(), trip_packer);
+    auto unpacked_trips = std::vector<Trip>(2);
+    std::error_code ec{};
+    auto end = msgpack::unpack_range<Trip>(trip_packer.vector(), unpacked_trips.begin(), ec);
+    CHECK(end == unpacked_trips.end());
+    CHECK(unpacked_trips[1].legs[0].second_member.nested_value == "b");
+  }
+
+  SUBCASE("test unpacking a truncated range") {
+    auto packer = msgpack::Packer{};
+    msgpack::pack_range(waypoints.begin(), waypoints.begin() + 3, packer);
+    auto data = packer.vector();
+    data.pop_back();
+
+    auto unpacked = std::vector<Waypoint>{};
+    std::error_code ec{};
+    msgpack::unpack_range<Waypoint>(data, std::back_inserter(unpacked), ec);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+    CHECK(unpacked.size() == 2);
+  }
+}
+
+TEST_CASE("scenario: measuring encoded sizes")
+{
+  auto trip = Trip{7, {{1, {std::string(300, 'a')}}, {2, {"b"}}}, {3, {"c"}}};
+
+  SUBCASE("test measuring objects") {
+    CHECK(msgpack::encoded_size(trip) == msgpack::pack(trip).size());
+    CHECK(msgpack::encoded_size(BaseObject{}) == 2);
+
+    auto route = Route{7, {{1.5, -2.0, "a"}}, {8, {"tag"}}, {{"stops", 2}}};
+    CHECK(msgpack::encoded_size(route) == msgpack::pack(route).size());
+  }
+
+  SUBCASE("test measuring with options") {
+    for (const auto nested_format : {msgpack::NestedFormat::Inline, msgpack::NestedFormat::Binary}) {
+      const auto options = msgpack::PackerOptions{.nested_format = nested_format, .array_format = msgpack::ArrayFormat::Typed};
+      std::error_code ec{};
+      const auto size = msgpack::encoded_size(trip, options, ec);
+      CHECK(!ec);
+      CHECK(size == msgpack::pack(trip, options, ec).size());
+    }
+  }
+
+  SUBCASE("test reserving exactly") {
+    auto packer = msgpack::Packer{};
+    packer.reserve(msgpack::encoded_size(trip));
+    const auto *data = packer.vector().data();
+    trip.pack(packer);
+    CHECK(packer.vector().data() == data);
+    CHECK(packer.vector().size() == msgpack::encoded_size(trip));
+  }
+}
+
+TEST_CASE("scenario: packing into sinks")
+{
+  auto trip = Trip{7, {{1, {std::string(1000, 'a')}}, {2, {"b"}}}, {3, {"c"}}};
+  const auto expected = msgpack::pack(trip);
+  std::error_code ec{};
+  const auto expected_binary = msgpack::pack(trip, msgpack::NestedFormat::Binary, ec);
+
+  SUBCASE("test moving, resetting and pooling packers") {
+    auto packer = msgpack::Packer{};
+    trip.pack(packer);
+    const auto *data = packer.vector().data();
+
+    auto moved = std::move(packer);
+    CHECK(moved.vector() == expected);
+    CHECK(moved.vector().data() == data);
+
+    auto packers = std::vector<msgpack::Packer>{};
+    packers.push_back(std::move(moved));
+    packers.back().reset();
+    CHECK(packers.back().vector().empty());
+    trip.pack(packers.back());
+    CHECK(packers.back().vector() == expected);
+    CHECK(packers.back().vector().data() == data);
+
+    auto released = packers.back().release();
+    CHECK(released == expected);
+    CHECK(released.data() == data);
+    CHECK(packers.back().vector().capacity() == 0);
+
+    auto pool = msgpack::PackerPool{2};
+    {
+      auto lease = pool.acquire();
+      trip.pack(*lease);
+      data = lease->vector().data();
+    }
+    CHECK(pool.idle() == 1);
+    {
+      // Given back reset, with its buffer, and the options of the lease.
+      auto lease = pool.acquire(msgpack::PackerOptions{msgpack::NestedFormat::Binary});
+      CHECK(pool.idle() == 0);
+      CHECK(lease->vector().empty());
+      CHECK(lease->options().nested_format == msgpack::NestedFormat::Binary);
+      trip.pack(*lease);
+      CHECK(lease->vector() == expected_binary);
+      CHECK(lease->vector().data() == data);
+    }
+
+    auto &local = msgpack::PackerPool::local();
+    { auto lease = local.acquire(); }
+    CHECK(local.idle() == 1);
+
+    auto unpacker = msgpack::Unpacker{expected.data(), expected.size()};
+    auto unpacked = Trip{};
+    unpacker.process(unpacked);
+    CHECK(!unpacker.ec);
+    unpacker.process(unpacked);
+    CHECK(unpacker.ec);
+
+    auto unpackers = std::vector<msgpack::Unpacker>{};
+    unpackers.push_back(std::move(unpacker));
+    unpackers.back().reset(expected.data(), expected.size());
+    CHECK(!unpackers.back().ec);
+    unpackers.back().process(unpacked);
+    CHECK(!unpackers.back().ec);
+    CHECK(unpacked.last.second_member.nested_value == "c");
+  }
+
+  SUBCASE("test packing into a span") {
+    auto buffer = std::vector<uint8_t>(expected.size());
+    auto packer = msgpack::BasicPacker{msgpack::SpanSink{buffer}};
+    trip.pack(packer);
+    CHECK(!packer.ec);
+    CHECK(std::ranges::equal(packer.sink().written(), expected));
+
+    auto short_buffer = std::vector<uint8_t>(expected.size() - 1);
+    auto short_packer = msgpack::BasicPacker{msgpack::SpanSink{short_buffer}};
+    trip.pack(short_packer);
+    CHECK(short_packer.ec == msgpack::PackerError::SinkError);
+
+    // Nested blobs are packed after room for their largest header, and moved up after.
+    auto binary_buffer = std::vector<uint8_t>(expected_binary.size() + 16);
+    auto binary_packer = msgpack::BasicPacker{msgpack::SpanSink{binary_buffer}, msgpack::NestedFormat::Binary};
+    trip.pack(binary_packer);
+    CHECK(!binary_packer.ec);
+    CHECK(std::ranges::equal(binary_packer.sink().written(), expected_binary));
+  }
+
+  SUBCASE("test packing into a pmr vector") {
+    auto arena = std::array<std::byte, 4096>{};
+    auto resource = std::pmr::monotonic_buffer_resource{arena.data(), arena.size()};
+    auto buffer = std::pmr::vector<uint8_t>{&resource};
+    auto packer = msgpack::BasicPacker{msgpack::ContainerSink{buffer}};
+    trip.pack(packer);
+    CHECK(!packer.ec);
+    CHECK(std::ranges::equal(buffer, expected));
+  }
+
+  SUBCASE("test packing into segments") {
+    auto packer = msgpack::BasicPacker<msgpack::ScatterSink>{};
+    trip.pack(packer);
+    CHECK(!packer.ec);
+
+    const auto &segments = packer.sink().segments();
+    CHECK(segments.size() == 3);
+    CHECK(segments[1].data() == reinterpret_cast<const uint8_t *>(trip.legs[0].second_member.nested_value.data()));
+
+    auto gathered = std::vector<uint8_t>{};
+    for (const auto segment: segments) gathered.insert(gathered.end(), segment.begin(), segment.end());
+    CHECK(gathered == expected);
+    CHECK(packer.sink().size() == expected.size());
+
+    packer.clear();
+    trip.pack(packer);
+    CHECK(packer.sink().size() == expected.size());
+  }
+
+  SUBCASE("test packing into a stream") {
+    auto written = std::vector<uint8_t>{};
+    auto writes = 0;
+    auto writer = [&](const std::span<const uint8_t> a_bytes) {
+      written.insert(written.end(), a_bytes.begin(), a_bytes.end());
+      return ++writes < 100;
+    };
+
+    auto packer = msgpack::BasicPacker{msgpack::StreamSink{writer, 64}, msgpack::NestedFormat::Binary};
+    trip.pack(packer);
+    CHECK(packer.sink().flush());
+    CHECK(!packer.ec);
+    CHECK(written == expected_binary);
+    CHECK(writes > 1);
+
+    auto failing_packer = msgpack::BasicPacker{msgpack::StreamSink{[](std::span<const uint8_t>) { return false; }, 16}};
+    trip.pack(failing_packer);
+    CHECK(failing_packer.ec == msgpack::PackerError::SinkError);
+  }
+}
+
+TEST_CASE("scenario: unpacking streams")
+{
+  auto trips = std::vector<Trip>{{1, {{2, {"a"}}, {3, {"bc"}}}, {4, {"def"}}},
+                                 {5, {}, {6, {std::string(300, 'x')}}},
+                                 {7, {{8, {""}}}, {9, {"g"}}}};
+  auto packer = msgpack::Packer{};
+  for (auto &trip : trips) trip.pack(packer);
+  const auto &bytes = packer.vector();
+
+  SUBCASE("test unpacking chunks") {
+    for (const size_t chunk : {size_t{1}, size_t{3}, size_t{64}, bytes.size()}) {
+      auto stream = msgpack::StreamUnpacker{};
+      auto unpacked = std::vector<Trip>{};
+      for (size_t i = 0; i < bytes.size(); i += chunk) {
+        stream.feed(std::span{bytes}.subspan(i, std::min(chunk, bytes.size() - i)));
+        for (auto trip = Trip{}; stream.process(trip); trip = Trip{}) unpacked.push_back(trip);
+      }
+
+      CHECK(!stream.ec);
+      CHECK(stream.buffered() == 0);
+      REQUIRE(unpacked.size() == trips.size());
+      for (size_t i = 0; i < trips.size(); ++i) {
+        CHECK(unpacked[i].id == trips[i].id);
+        CHECK(unpacked[i].legs.size() == trips[i].legs.size());
+        CHECK(unpacked[i].last.second_member.nested_value == trips[i].last.second_member.nested_value);
+      }
+    }
+  }
+
+  SUBCASE("test unpacking a partial message") {
+    auto stream = msgpack::StreamUnpacker{};
+    auto trip = Trip{};
+    stream.feed(std::span{bytes}.first(2));
+    CHECK(!stream.process(trip));
+    CHECK(!stream.ec);
+    CHECK(stream.buffered() == 2);
+  }
+
+  SUBCASE("test unpacking invalid bytes") {
+    auto stream = msgpack::StreamUnpacker{};
+    const auto invalid = std::vector<uint8_t>{0x01, 0xc1};
+    auto value = 0;
+    stream.feed(invalid);
+    CHECK(stream.process(value));
+    CHECK(value == 1);
+    CHECK(!stream.process(value));
+    CHECK(stream.ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+}
+
+TEST_CASE("scenario: reading framed logs")
+{
+  constexpr std::size_t count = 2000;
+
+  SUBCASE("test length-prefixed messages in parallel") {
+    std::vector<uint8_t> log;
+    std::error_code ec{};
+    for (std::size_t i = 0; i < count; i++) {
+      msgpack::append_framed(log, BaseObject{int(i), {std::to_string(i)}}, ec);
+      REQUIRE(!ec);
+    }
+
+    auto reader = msgpack::FramedReader{log, msgpack::Framing::LengthPrefixed};
+    CHECK(reader.index(ec) == count);
+    CHECK(!ec);
+    CHECK(reader.messages()[1].data() == log.data() + 4 + reader.messages()[0].size() + 4);
+
+    auto seen = std::vector<std::atomic<int>>(count);
+    auto read = reader.read<BaseObject>([&](int, const std::size_t a_index, BaseObject &a_object) {
+      if (a_object.first_member == int(a_index) && a_object.second_member.nested_value == std::to_string(a_index)) seen[a_index]++;
+      return 0;
+    }, ec, msgpack::Delivery::Unordered, 4);
+    CHECK(!ec);
+    CHECK(read == count);
+    CHECK(std::all_of(seen.begin(), seen.end(), [](const auto &a_seen) { return a_seen == 1; }));
+
+    // A partial last message, as one being written, is left out.
+    log.resize(log.size() - 2);
+    auto partial = msgpack::FramedReader{log, msgpack::Framing::LengthPrefixed};
+    read = partial.read<BaseObject>([](int, std::size_t, BaseObject &) { return 0; }, ec);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+    CHECK(read == count - 1);
+  }
+
+  SUBCASE("test concatenated messages in order") {
+    const auto file = std::string{"test-msgpack-log"};
+    {
+      std::ofstream out{file, std::ios::binary};
+      for (std::size_t i = 0; i < count; i++) {
+        const auto data = msgpack::pack(LinkRecord{int64_t(i), "link", 1.0, {int(i % 3)}});
+        out.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size()));
+      }
+    }
+
+    msgpack::FramedReader reader;
+    std::error_code ec{};
+    reader.open(file, msgpack::Framing::Concatenated, ec);
+    REQUIRE(!ec);
+
+    auto ids = std::vector<int64_t>{};
+    auto read = reader.read<LinkRecord>([&](int, const std::size_t a_index, LinkRecord &a_link) {
+      ids.push_back(a_link.id);
+      return a_index == std::size_t(a_link.id) && a_link.lanes.size() == 1 ? 0 : 1;
+    }, ec, msgpack::Delivery::Ordered, 4);
+    CHECK(!ec);
+    CHECK(reader.status() == 0);
+    CHECK(read == count);
+    auto expected = std::vector<int64_t>(count);
+    std::iota(expected.begin(), expected.end(), int64_t{0});
+    CHECK(ids == expected);
+
+    // A non-zero code stops the read.
+    read = reader.read<LinkRecord>([&](int, const std::size_t a_index, LinkRecord &) { return a_index == 600 ? 7 : 0; }, ec, msgpack::Delivery::Ordered, 4);
+    CHECK(!ec);
+    CHECK(reader.status() == 7);
+    CHECK(read == 600);
+
+    // Messages not of the type stop the read too.
+    read = reader.read<BaseObject>([](int, std::size_t, BaseObject &) { return 0; }, ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+    CHECK(read < count);
+  }
+}
+
+TEST_CASE("scenario: unpacking a large array in parallel")
+{
+  auto links = std::vector<LinkRecord>{};
+  for (int64_t i = 0; i < 300000; i++) links.push_back({i, std::string(std::size_t(i % 17), 'n'), double(i % 7), std::vector<int>(std::size_t(i % 3), 2)});
+  auto packer = msgpack::Packer{};
+  packer.process(links);
+  auto bytes = packer.vector();
+  REQUIRE(bytes.size() > (std::size_t{4} << 20));
+
+  SUBCASE("test the skip index finds every element") {
+    std::error_code ec{};
+    for (const std::size_t threads : {1, 3, 8}) {
+      const auto offsets = msgpack::index_array(bytes, ec, threads);
+      REQUIRE(!ec);
+      REQUIRE(offsets.size() == links.size() + 1);
+      CHECK(offsets.front() == 5);
+      CHECK(offsets.back() == bytes.size());
+      auto sizes = std::size_t{0};
+      for (std::size_t i = 0; i < 12345; i++) sizes += msgpack::pack(LinkRecord{links[i]}).size();
+      CHECK(offsets[12345] == 5 + sizes);
+    }
+  }
+
+  SUBCASE("test elements are unpacked as by a single unpacker") {
+    std::error_code ec{};
+    auto unpacked = std::vector<LinkRecord>{};
+    CHECK(msgpack::unpack_array(bytes, unpacked, ec, 8) == bytes.size());
+    REQUIRE(!ec);
+    REQUIRE(unpacked.size() == links.size());
+    auto mismatches = std::size_t{0};
+    for (std::size_t i = 0; i < links.size(); i++)
+      mismatches += unpacked[i].id != links[i].id || unpacked[i].name != links[i].name || unpacked[i].lanes != links[i].lanes;
+    CHECK(mismatches == 0);
+
+    // Bytes after the array are left out.
+    bytes.push_back(0xc0);
+    CHECK(msgpack::unpack_array(bytes, unpacked, ec, 8) == bytes.size() - 1);
+    CHECK(!ec);
+  }
+
+  SUBCASE("test elements of different formats are indexed too") {
+    auto mixed_packer = msgpack::Packer{};
+    mixed_packer.process(std::vector<std::vector<int>>{{}, {1, 2}, std::vector<int>(20, 3), std::vector<int>(70000, -1)});
+    const auto &mixed = mixed_packer.vector();
+    std::error_code ec{};
+    const auto offsets = msgpack::index_array(mixed, ec, 4);
+    REQUIRE(!ec);
+    CHECK(offsets.size() == 5);
+    CHECK(offsets.back() == mixed.size());
+  }
+
+  SUBCASE("test truncated arrays and other items are errors") {
+    std::error_code ec{};
+    auto unpacked = std::vector<LinkRecord>{};
+    bytes.resize(bytes.size() - 3);
+    CHECK(msgpack::unpack_array(std::span<const uint8_t>{bytes}, unpacked, ec, 8) == 0);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+
+    auto number = msgpack::Packer{};
+    number.process(42);
+    CHECK(msgpack::index_array(number.vector(), ec).empty());
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+
+    // Elements of another type stop the workers.
+    auto numbers = msgpack::Packer{};
+    numbers.process(std::vector<int>(100000, 1));
+    CHECK(msgpack::unpack_array(numbers.vector(), unpacked, ec, 4) == 0);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+}
+
+TEST_CASE("scenario: compressing blocks")
+{
+  auto links = std::vector<LinkRecord>{};
+  for (int64_t i = 0; i < 20000; i++) links.push_back({i, "link " + std::to_string(i % 100), double(i % 7), {int(i % 3)}});
+  auto plain = msgpack::Packer{};
+  plain.process(links);
+  const auto &expected = plain.vector();
+
+  const auto check_stream = [&](auto a_codec) {
+    using codec_t = decltype(a_codec);
+    auto stream = std::vector<uint8_t>{};
+    auto packer = msgpack::BasicPacker{msgpack::BlockCompressingSink{msgpack::ContainerSink{stream}, a_codec, 64 << 10, 4}};
+    packer.process(links);
+    CHECK(!packer.ec);
+    CHECK(packer.sink().raw_size() == expected.size());
+    REQUIRE(packer.sink().finish());
+    CHECK(packer.sink().written() == stream.size());
+
+    auto reader = msgpack::BlockReader<codec_t>{};
+    std::error_code ec{};
+    reader.open(stream, ec);
+    REQUIRE(!ec);
+    CHECK(reader.raw_size() == expected.size());
+    CHECK(reader.block_count() == (expected.size() + (64 << 10) - 1) / (64 << 10));
+
+    auto raw = std::vector<uint8_t>{};
+    reader.read_all(raw, ec, 4);
+    CHECK(!ec);
+    CHECK(raw == expected);
+
+    // Any block alone.
+    const auto [offset, size] = reader.raw_extent(2);
+    reader.read_block(2, raw, ec);
+    CHECK(!ec);
+    CHECK(std::equal(raw.begin(), raw.end(), expected.begin() + std::ptrdiff_t(offset), expected.begin() + std::ptrdiff_t(offset + size)));
+    return stream;
+  };
+
+  SUBCASE("test stored blocks") {
+    check_stream(msgpack::StoreCodec{});
+  }
+
+#ifdef WXLIB_MSGPACK_WITH_ZLIB
+  SUBCASE("test zlib blocks") {
+    const auto stream = check_stream(msgpack::ZlibCodec{});
+    CHECK(stream.size() < expected.size() / 2);
+
+    auto reader = msgpack::BlockReader<msgpack::StoreCodec>{};
+    std::error_code ec{};
+    reader.open(stream, ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+#endif
+
+  SUBCASE("test blocks cut at message boundaries") {
+    auto stream = std::vector<uint8_t>{};
+    auto sink = msgpack::BlockCompressingSink{msgpack::ContainerSink{stream}, msgpack::StoreCodec{}, 1 << 20, 2};
+    auto packer = msgpack::BasicPacker{std::move(sink)};
+    for (std::size_t i = 0; i < 10; i++) {
+      packer.process(std::vector<LinkRecord>(links.begin() + std::ptrdiff_t(i * 100), links.begin() + std::ptrdiff_t(i * 100 + 100)));
+      packer.sink().flush_block();
+    }
+    REQUIRE(packer.sink().finish());
+
+    auto reader = msgpack::BlockReader<msgpack::StoreCodec>{};
+    std::error_code ec{};
+    reader.open(stream, ec);
+    REQUIRE(reader.block_count() == 10);
+
+    auto firsts = std::vector<std::atomic<int64_t>>(10);
+    const auto status = reader.for_each_block([&](int, const std::size_t a_block, const std::span<const uint8_t> a_raw) {
+      auto unpacker = msgpack::Unpacker{a_raw.data(), a_raw.size()};
+      auto batch = std::vector<LinkRecord>{};
+      unpacker.process(batch);
+      if (unpacker.ec || batch.size() != 100) return 1;
+      firsts[a_block] = batch.front().id;
+      return 0;
+    }, ec, 3);
+    CHECK(status == 0);
+    CHECK(!ec);
+    for (std::size_t i = 0; i < 10; i++) CHECK(firsts[i] == int64_t(i * 100));
+
+    CHECK(reader.for_each_block([](int, std::size_t a_block, std::span<const uint8_t>) { return a_block == 4 ? 9 : 0; }, ec, 1) == 9);
+
+    // Truncated or corrupt streams are not read.
+    auto truncated = std::span<const uint8_t>{stream}.first(stream.size() - 1);
+    reader.open(truncated, ec);
+    CHECK(ec);
+    CHECK(reader.block_count() == 0);
+    stream[stream.size() - 20] ^= 0xFF;
+    reader.open(stream, ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+}
+
+TEST_CASE("scenario: packing numeric series")
+{
+  const auto round_trip = [](const auto &a_series) {
+    auto packer = msgpack::Packer{};
+    packer.process(a_series);
+    REQUIRE(!packer.ec);
+
+    auto unpacked = std::remove_cvref_t<decltype(a_series)>{};
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(unpacked);
+    CHECK(!unpacker.ec);
+    CHECK(unpacked == a_series);
+    return packer.vector().size();
+  };
+
+  const auto generic_size = [](const auto &a_values) {
+    auto packer = msgpack::Packer{};
+    packer.process(a_values);
+    return packer.vector().size();
+  };
+
+  SUBCASE("test packing timestamps by delta of delta") {
+    // Samples every second, in nanoseconds since the epoch, with a few milliseconds of jitter.
+    auto timestamps = msgpack::DeltaSeries{};
+    for (int64_t i = 0; i < 1000; i++)
+      timestamps.values.push_back(1700000000000000000 + i * 1000000000 + (i % 7 == 0 ? 3000000 : 0));
+    // The jitter takes 24 bits, a third of the 9 bytes of each value packed generically.
+    const auto size = round_trip(timestamps);
+    CHECK(size * 2 < generic_size(timestamps.values));
+
+    // Exactly regular samples take 0 bits each.
+    auto regular = msgpack::DeltaSeries{};
+    for (int64_t i = 0; i < 1000; i++) regular.values.push_back(1700000000 + i * 60);
+    CHECK(round_trip(regular) == 3 + 4 + 16 + 8 * 9);
+
+    for (auto count : {0, 1, 2, 3, 129, 130, 131})
+      round_trip(msgpack::DeltaSeries{std::vector<int64_t>(std::size_t(count), 42)});
+    round_trip(msgpack::DeltaSeries{{msgpack::limits<int64_t>::min(), msgpack::limits<int64_t>::max(), 0,
+                                     msgpack::limits<int64_t>::min(), -1}});
+  }
+
+  SUBCASE("test packing floats by XOR") {
+    auto speeds = msgpack::XorSeries{};
+    for (int i = 0; i < 1000; i++) speeds.values.push_back(i % 10 < 6 ? 13.5 : 13.5 + (i % 3) * 0.25);
+    const auto size = round_trip(speeds);
+    CHECK(size * 4 < generic_size(speeds.values));
+
+    round_trip(msgpack::XorSeries{});
+    round_trip(msgpack::XorSeries{{1.0}});
+    round_trip(msgpack::XorSeries{{0.0, -0.0, std::numeric_limits<double>::quiet_NaN(), 1e300, -1e-300,
+                                   std::numeric_limits<double>::infinity(), 0.1, 0.1, 0.2, 0.3}});
+    auto noisy = msgpack::XorSeries{};
+    for (int i = 0; i < 300; i++) noisy.values.push_back(std::sin(i) * 1e6);
+    round_trip(noisy);
+  }
+
+  SUBCASE("test packing integers by frame of reference") {
+    auto ids = msgpack::PackedSeries{};
+    for (int64_t i = 0; i < 1000; i++) ids.values.push_back(5000000 + (i * 37) % 200);
+    const auto size = round_trip(ids);
+    // 8 bits per value, and a header per block of 128.
+    CHECK(size == 4 + 4 + 1000 + 8 * 9);
+    CHECK(size * 3 < generic_size(ids.values));
+
+    // Each bit width, from constant blocks to full ranges.
+    for (unsigned width = 0; width <= 64; width++) {
+      auto series = msgpack::PackedSeries{};
+      for (int64_t i = 0; i < 133; i++) {
+        const auto offset = width == 0 ? 0 : (uint64_t(i) * 0x9E3779B97F4A7C15ULL) >> (64 - width);
+        series.values.push_back(int64_t(uint64_t(msgpack::limits<int64_t>::min()) + offset));
+      }
+      round_trip(series);
+    }
+  }
+
+  SUBCASE("test rejecting invalid payloads") {
+    auto packer = msgpack::Packer{};
+    packer.process(msgpack::PackedSeries{{1, 2, 3}}, msgpack::XorSeries{{1.0, 2.0}});
+    auto bytes = packer.vector();
+
+    auto series = msgpack::PackedSeries{};
+    auto floats = msgpack::XorSeries{};
+    // An invalid bit width.
+    bytes[3 + 4 + 8] = 65;
+    auto invalid_width = msgpack::Unpacker{bytes.data(), bytes.size()};
+    invalid_width.process(series);
+    CHECK(invalid_width.ec == msgpack::UnpackerError::DataNotMatchType);
+
+    // More values than the payload holds, rejected before allocating them.
+    bytes = packer.vector();
+    bytes[3 + 3] = 0xFF;
+    auto too_many = msgpack::Unpacker{bytes.data(), bytes.size()};
+    too_many.process(series);
+    CHECK(too_many.ec == msgpack::UnpackerError::DataNotMatchType);
+
+    auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+    unpacker.process(series, floats);
+    CHECK(!unpacker.ec);
+    CHECK(series.values == std::vector<int64_t>{1, 2, 3});
+    CHECK(floats.values == std::vector<double>{1.0, 2.0});
+  }
+}
+
+TEST_CASE("scenario: transcoding JSON")
+{
+  auto transcoder = msgpack::JsonTranscoder{};
+  std::error_code ec{};
+
+  SUBCASE("test msgpack to JSON") {
+    auto link = LinkRecord{42, "Main \"St\"\n\x01", 13.5, {1, -2}};
+    auto json = std::string{};
+    const auto data = msgpack::pack(link);
+    CHECK(transcoder.to_json(data, json, ec) == data.size());
+    CHECK(!ec);
+    CHECK(json == R"({"id":42,"name":"Main \"St\"\n\u0001","speed":13.5,"lanes":[1,-2]})");
+
+    // Messages one per line, appended to the buffer.
+    auto packer = msgpack::Packer{};
+    packer.process(std::map<int, bool>{{1, true}, {2, false}}, std::vector<std::string>{}, nullptr, 0.1, std::nan(""));
+    packer.process(std::vector<uint8_t>{'a', 'b', 'c', 'd'});
+    json = "> ";
+    transcoder.to_json(packer.vector(), json, ec);
+    CHECK(!ec);
+    CHECK(json == "> {\"1\":true,\"2\":false}\n[]\nnull\n0.1\nnull\n\"YWJjZA==\"");
+
+    // Long strings take the vectorized scan.
+    const auto text = std::string(100, 'x') + "\t" + std::string(40, 'y') + "\\";
+    auto long_string = msgpack::Packer{};
+    long_string.process(text);
+    CHECK(msgpack::to_json(long_string.vector(), ec) == "\"" + std::string(100, 'x') + "\\t" + std::string(40, 'y') + "\\\\\"");
+
+    auto array_key = msgpack::Packer{};
+    array_key.process(std::map<std::vector<int>, int>{{{1}, 2}});
+    msgpack::to_json(array_key.vector(), ec);
+    CHECK(ec == msgpack::UnpackerError::DataNotMatchType);
+  }
+
+  SUBCASE("test JSON to msgpack") {
+    const auto json = std::string_view{R"( {"id": 42, "name": "Main \"St\"\n\u00e9\ud83d\ude00", "speed": 13.5, "lanes": [1, -2], "x": [] } )"};
+    auto bytes = std::vector<uint8_t>{};
+    CHECK(transcoder.from_json(json, bytes, ec) == json.size());
+    CHECK(!ec);
+
+    auto link = msgpack::unpack<LinkRecord>(bytes, ec);
+    CHECK(!ec);
+    CHECK(link.id == 42);
+    CHECK(link.name == "Main \"St\"\n\xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(link.speed == 13.5);
+    CHECK(link.lanes == std::vector<int>{1, -2});
+
+    // Integers in their smallest formats, and containers with the right headers.
+    bytes.clear();
+    transcoder.from_json("[1, -1, -100, 300, -40000, 18446744073709551615, 1e400, true, null]\n{}", bytes, ec);
+    CHECK(!ec);
+    CHECK(bytes == std::vector<uint8_t>{0x99, 0x01, 0xff, 0xd0, 0x9c, 0xcd, 0x01, 0x2c, 0xd2, 0xff, 0xff, 0x63, 0xc0,
+                                        0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                        0xcb, 0x7f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc3, 0xc0, 0x80});
+
+    // Numbers out of the range of doubles by their magnitude, not by the sign of their exponent.
+    const auto zeros = std::string(340, '0');
+    const auto extremes = "[0." + zeros + "1, -0." + zeros + "1e+5, 1" + zeros + ", 1" + zeros + "e-10, 1e-400]";
+    bytes.clear();
+    transcoder.from_json(extremes, bytes, ec);
+    CHECK(!ec);
+    REQUIRE(bytes.size() == 1 + 5 * 9);
+    CHECK(bytes[0] == 0x95);
+    std::vector<double> values;
+    for (std::size_t i = 1; i < bytes.size(); i += 9) {
+      CHECK(bytes[i] == 0xcb);
+      uint64_t word{0};
+      for (std::size_t j = 1; j < 9; j++) word = word << 8U | bytes[i + j];
+      values.push_back(std::bit_cast<double>(word));
+    }
+    const auto infinity = std::numeric_limits<double>::infinity();
+    CHECK(values == std::vector<double>{0.0, -0.0, infinity, infinity, 0.0});
+    CHECK(std::signbit(values[1]));
+
+    const auto numbers = std::string_view{"[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]"};
+    bytes.clear();
+    transcoder.from_json(numbers, bytes, ec);
+    REQUIRE(bytes.size() == 3 + 17);
+    CHECK(bytes[0] == 0xdc);
+    auto round_trip = std::string{};
+    transcoder.to_json(bytes, round_trip, ec);
+    CHECK(round_trip == numbers);
+
+    // Invalid text leaves the buffer as it was.
+    bytes = {0x01};
+    for (const auto invalid : {"[1,]", "{\"a\" 1}", "[1", "01", "\"\\x\"", "\"\x01\"", "tru", "{1:2}", "\"\\ud800\""}) {
+      transcoder.from_json(invalid, bytes, ec);
+      CHECK(ec == msgpack::UnpackerError::InvalidJson);
+      CHECK(bytes == std::vector<uint8_t>{0x01});
+    }
+
+    // So does text ending inside an array or an object.
+    for (const auto truncated : {"[", "[1,", "[[]", "{", "{\"a\":", "{\"a\": [1, {\"b\": 2}"}) {
+      transcoder.from_json(truncated, bytes, ec);
+      CHECK(ec == msgpack::UnpackerError::InvalidJson);
+      CHECK(bytes == std::vector<uint8_t>{0x01});
+    }
+  }
+}
+
+struct EventLog
+{
+  std::string events{};
+  std::string_view skipped_key{};
+
+  void on_nil() { events += "nil "; }
+  void on_bool(bool b) { events += b ? "true " : "false "; }
+  void on_int(int64_t i) { events += "i" + std::to_string(i) + " "; }
+  void on_uint(uint64_t u) { events += "u" + std::to_string(u) + " "; }
+  void on_float(double d) { events += "f" + std::to_string(int(d * 10)) + " "; }
+  void on_bin(std::span<const uint8_t> b) { events += "bin" + std::to_string(b.size()) + " "; }
+  void on_array_begin(uint64_t n) { events += "[" + std::to_string(n) + " "; }
+  void on_array_end() { events += "] "; }
+  void on_map_end() { events += "} "; }
+
+  msgpack::VisitAction on_str(std::string_view s)
+  {
+    events += std::string(s) + " ";
+    return s == skipped_key ? msgpack::VisitAction::Stop : msgpack::VisitAction::Continue;
+  }
+
+  msgpack::VisitAction on_map_begin(uint64_t n)
+  {
+    events += "{" + std::to_string(n) + " ";
+    return skipped_key == "map" ? msgpack::VisitAction::Skip : msgpack::VisitAction::Continue;
+  }
+};
+
+TEST_CASE("scenario: visiting events")
+{
+  auto packer = msgpack::Packer{};
+  packer.process(nullptr, true, int16_t(-300), uint8_t(200), 2.5, std::vector<uint8_t>{1, 2},
+                 std::vector<std::string>{"a", "b"}, std::vector<int>{},
+                 std::map<std::string, std::vector<int>>{{"k", {1}}}, std::string("end"));
+  const auto &bytes = packer.vector();
+
+  SUBCASE("test visiting all events") {
+    auto log = EventLog{};
+    std::error_code ec{};
+    CHECK(msgpack::visit(bytes, log, ec) == bytes.size());
+    CHECK(!ec);
+    CHECK(log.events == "nil true i-300 u200 f25 bin2 [2 a b ] [0 ] {1 k [1 u1 ] } end ");
+  }
+
+  SUBCASE("test skipping and stopping") {
+    auto log = EventLog{.skipped_key = "map"};
+    std::error_code ec{};
+    CHECK(msgpack::visit(bytes, log, ec) == bytes.size());
+    CHECK(log.events == "nil true i-300 u200 f25 bin2 [2 a b ] [0 ] {1 end ");
+
+    log = EventLog{.skipped_key = "b"};
+    CHECK(msgpack::visit(bytes, log, ec) < bytes.size());
+    CHECK(log.events == "nil true i-300 u200 f25 bin2 [2 a b ");
+  }
+
+  SUBCASE("test skipping items") {
+    std::error_code ec{};
+    // nil, true, int16, uint8, float64, bin8 of 2
+    CHECK(msgpack::skip(bytes, 6, ec) == 1 + 1 + 3 + 2 + 9 + 4);
+    CHECK(msgpack::skip(bytes, 10, ec) == bytes.size());
+    CHECK(!ec);
+
+    CHECK(msgpack::skip(std::span{bytes}.first(bytes.size() - 1), 10, ec) == 0);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+
+    auto log = EventLog{};
+    ec.clear();
+    msgpack::visit(std::span{bytes}.first(bytes.size() - 5), log, ec);
+    CHECK(ec == msgpack::UnpackerError::OutOfRange);
+  }
+}
+
+struct Sample
+{
+  uint32_t id{};
+  int16_t speed{};
+  float x{};
+  bool is_valid{};
+
+  template<class T>
+  void pack(T &pack)
+  {
+    pack(id, speed, x, is_valid);
+  }
+};
+
+/*!
+  Packs a Sample as a hand-rolled encoder would, with fixed-width fields.
+*/
+void pack_by_hand(const Sample &a_sample, std::vector<uint8_t> &a_buffer)
+{
+  auto bytes = std::array<uint8_t, 5 + 3 + 5 + 1>{0xce};
+  const auto x = std::bit_cast<uint32_t>(a_sample.x);
+  const auto speed = uint16_t(a_sample.speed);
+  for (int i = 0; i < 4; ++i) bytes[1 + i] = uint8_t(a_sample.id >> (24 - 8 * i));
+  bytes[5] = 0xd1, bytes[6] = uint8_t(speed >> 8), bytes[7] = uint8_t(speed);
+  bytes[8] = 0xca;
+  for (int i = 0; i < 4; ++i) bytes[9 + i] = uint8_t(x >> (24 - 8 * i));
+  bytes[13] = a_sample.is_valid ? 0xc3 : 0xc2;
+  a_buffer.insert(a_buffer.end(), bytes.begin(), bytes.end());
+}
+
+TEST_CASE("benchmark: packing small messages")
+{
+  constexpr int count = 100000;
+  auto samples = std::vector<Sample>{};
+  for (int i = 0; i < count; ++i) samples.push_back({uint32_t(i * 7919), int16_t(i % 200 - 100), float(i) * 0.5f, i % 3 != 0});
+
+  const auto time = [](auto &&a_work) {
+    const auto start = std::chrono::steady_clock::now();
+    a_work();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+  };
+
+  auto packer = msgpack::Packer{};
+  auto packed_size = size_t{0};
+  const auto packer_ns = time([&]() {
+    for (auto &sample : samples) {
+      packer.clear();
+      sample.pack(packer);
+      packed_size += packer.vector().size();
+    }
+  });
+
+  auto buffer = std::vector<uint8_t>{};
+  auto hand_rolled_size = size_t{0};
+  const auto hand_rolled_ns = time([&]() {
+    for (const auto &sample : samples) {
+      buffer.clear();
+      pack_by_hand(sample, buffer);
+      hand_rolled_size += buffer.size();
+    }
+  });
+
+  auto unpacked = Sample{};
+  const auto unpack_ns = time([&]() {
+    for (auto &sample : samples) {
+      packer.clear();
+      sample.pack(packer);
+      auto unpacker = msgpack::Unpacker{packer.vector().data(), packer.vector().size()};
+      unpacked.pack(unpacker);
+    }
+  });
+
+  MESSAGE("packer " << packer_ns << " ns, hand-rolled " << hand_rolled_ns << " ns, pack and unpack "
+                    << unpack_ns << " ns per message");
+  CHECK(packed_size <= hand_rolled_size);
+  CHECK(unpacked.id == samples.back().id);
+
+  // Fixed-width fields unpack as well.
+  auto unpacker = msgpack::Unpacker{buffer.data(), buffer.size()};
+  unpacker.process(unpacked);
+  CHECK(!unpacker.ec);
+  CHECK(unpacked.speed == samples.back().speed);
+  CHECK(unpacked.x == samples.back().x);
+  CHECK(unpacked.is_valid == samples.back().is_valid);
 }
 
 struct ExampleError
@@ -0,0 +1,562 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+#ifndef WXLIB_MSGPACK_SERIES_HPP
+#define WXLIB_MSGPACK_SERIES_HPP
+
+#include <msgpack/msgpack.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace msgpack {
+
+/*!
+  Ext types of numeric series, see DeltaSeries, XorSeries and PackedSeries. Their payloads are
+  little-endian, as those of typed arrays, and start with the number of values, as 4 bytes.
+*/
+enum SeriesExt : uint8_t
+{
+  delta_series = 0x20,
+  xor_series = 0x21,
+  packed_series = 0x22
+};
+
+/*!
+  Integers packed as frame-of-reference blocks of 128 values: the minimum of the block, as 8
+  bytes, the bit width of the largest offset from it, as 1 byte, and the offsets, that many bits
+  each, in groups of 8 values of exactly as many bytes. Suits values within a narrow range, e.g.
+  link IDs or counters, which then take a few bits each.
+*/
+struct PackedSeries
+{
+  std::vector<int64_t> values{};
+
+  bool operator==(const PackedSeries &) const = default;
+};
+
+/*!
+  Integers packed as their first value and difference, as 8 bytes each, and the differences of
+  the following differences, as the blocks of a PackedSeries. Suits regularly spaced timestamps,
+  e.g. nanoseconds since the epoch of samples taken every second, which take 0 to a few bits
+  each. Unlike Gorilla, which writes each one with a variable length prefix, the blocks of fixed
+  widths decode without branching per value.
+*/
+struct DeltaSeries
+{
+  std::vector<int64_t> values{};
+
+  bool operator==(const DeltaSeries &) const = default;
+};
+
+/*!
+  Doubles packed as in Gorilla: the first value, as 64 bits, then the XOR of each with the
+  previous one, as a 0 bit if equal, or its significant bits, within those of the previous XOR or
+  after their count of leading zeros and length. Suits slowly changing measurements, e.g. speeds
+  or temperatures, and keeps the exact bits of each, NaNs and -0.0 included.
+*/
+struct XorSeries
+{
+  std::vector<double> values{};
+
+  bool operator==(const XorSeries &a_other) const
+  {
+    constexpr auto bits = [](const double a_value) { return std::bit_cast<uint64_t>(a_value); };
+    return std::ranges::equal(values, a_other.values, {}, bits, bits);
+  }
+};
+
+namespace detail {
+
+/*!
+  Number of values of a frame-of-reference block.
+*/
+constexpr std::size_t series_block_size = 128;
+
+/*!
+  Bytes of the header of a frame-of-reference block, its reference and bit width.
+*/
+constexpr std::size_t series_block_header = sizeof(int64_t) + 1;
+
+template<std::unsigned_integral U>
+U load_little_endian(const uint8_t *a_bytes)
+{
+  U value;
+  std::memcpy(&value, a_bytes, sizeof(U));
+  return (std::endian::native == std::endian::big) ? std::byteswap(value) : value;
+}
+
+template<std::unsigned_integral U>
+void store_little_endian(const U a_value, uint8_t *a_bytes)
+{
+  const U little_endian = (std::endian::native == std::endian::big) ? std::byteswap(a_value) : a_value;
+  std::memcpy(a_bytes, &little_endian, sizeof(U));
+}
+
+/*!
+  Unpacks the groups of 8 offsets of W bits, at W bytes per group, adding the reference. W is a
+  constant, so that the compiler unrolls the shifts and masks of each lane, and vectorizes them
+  with the additions, on any instruction set it targets.
+*/
+template<unsigned W>
+void unpack_series_groups(const uint8_t *a_bytes, const std::size_t a_groups, const uint64_t a_reference,
+                          int64_t *a_values) noexcept
+{
+  constexpr auto mask = (W == 64) ? ~uint64_t{0} : (uint64_t{1} << W) - 1;
+  for (std::size_t g = 0; g < a_groups; g++, a_bytes += W, a_values += 8) {
+    if constexpr (W == 0) {
+      std::fill_n(a_values, 8, int64_t(a_reference));
+    } else {
+      // Copied with padding, so that each lane loads 8 bytes within the group.
+      auto group = std::array<uint8_t, W + 8>{};
+      std::memcpy(group.data(), a_bytes, W);
+      for (unsigned lane = 0; lane < 8; lane++) {
+        const auto bit = lane * W;
+        auto offset = load_little_endian<uint64_t>(group.data() + bit / 8) >> (bit % 8);
+        if (bit % 8 + W > 64) offset |= uint64_t(group[bit / 8 + 8]) << (64 - bit % 8);
+        a_values[lane] = int64_t(a_reference + (offset & mask));
+      }
+    }
+  }
+}
+
+using SeriesUnpacker = void (*)(const uint8_t *, std::size_t, uint64_t, int64_t *) noexcept;
+
+template<std::size_t... Ws>
+constexpr auto make_series_unpackers(std::index_sequence<Ws...>)
+{
+  return std::array<SeriesUnpacker, sizeof...(Ws)>{&unpack_series_groups<Ws>...};
+}
+
+/*!
+  The unpackers of each bit width, 0 to 64.
+*/
+inline constexpr auto series_unpackers = make_series_unpackers(std::make_index_sequence<65>{});
+
+/*!
+  The reference and bit width of a block of values.
+*/
+inline std::pair<uint64_t, unsigned> series_block_frame(const int64_t *a_values, const std::size_t a_size)
+{
+  const auto [min, max] = std::minmax_element(a_values, a_values + a_size);
+  return {uint64_t(*min), unsigned(std::bit_width(uint64_t(*max) - uint64_t(*min)))};
+}
+
+/*!
+  Bytes of the blocks of the given values, filled a block at a time by a_fill(first, size, out).
+*/
+template<typename FillT>
+std::size_t series_blocks_size(const std::size_t a_count, FillT &&a_fill)
+{
+  auto values = std::array<int64_t, series_block_size>{};
+  std::size_t size{0};
+  for (std::size_t first = 0; first < a_count; first += series_block_size) {
+    const auto n = std::min(series_block_size, a_count - first);
+    a_fill(first, n, values.data());
+    size += series_block_header + (n + 7) / 8 * series_block_frame(values.data(), n).second;
+  }
+  return size;
+}
+
+/*!
+  Writes the blocks of the given values, see series_blocks_size().
+*/
+template<typename FillT, typename WriterT>
+void encode_series_blocks(const std::size_t a_count, FillT &&a_fill, WriterT &&a_write)
+{
+  auto values = std::array<int64_t, series_block_size>{};
+  // Room for the header, the widest offsets and the 8-byte stores of the last one.
+  auto block = std::array<uint8_t, series_block_header + series_block_size * sizeof(uint64_t) + 8>{};
+  for (std::size_t first = 0; first < a_count; first += series_block_size) {
+    const auto n = std::min(series_block_size, a_count - first);
+    a_fill(first, n, values.data());
+    const auto [reference, width] = series_block_frame(values.data(), n);
+
+    block.fill(0);
+    store_little_endian(reference, block.data());
+    block[sizeof(int64_t)] = uint8_t(width);
+    auto *offsets = block.data() + series_block_header;
+    for (std::size_t i = 0; i < n && width != 0; i++) {
+      const auto offset = uint64_t(values[i]) - reference;
+      const auto bit = i * width;
+      auto *bytes = offsets + bit / 8;
+      store_little_endian(load_little_endian<uint64_t>(bytes) | (offset << (bit % 8)), bytes);
+      if (bit % 8 + width > 64) bytes[8] |= uint8_t(offset >> (64 - bit % 8));
+    }
+    a_write(block.data(), series_block_header + (n + 7) / 8 * width);
+  }
+}
+
+/*!
+  Fills blocks with the values of a PackedSeries, see series_blocks_size().
+*/
+inline auto packed_series_fill(const PackedSeries &a_series)
+{
+  return [&](const std::size_t a_first, const std::size_t a_size, int64_t *a_values) {
+    std::copy_n(a_series.values.data() + a_first, a_size, a_values);
+  };
+}
+
+/*!
+  Fills blocks with the differences of differences of a DeltaSeries, from its third value on.
+*/
+inline auto delta_series_fill(const DeltaSeries &a_series)
+{
+  return [&](const std::size_t a_first, const std::size_t a_size, int64_t *a_values) {
+    const auto *values = a_series.values.data() + a_first + 2;
+    for (std::size_t i = 0; i < a_size; i++)
+      a_values[i] = int64_t(uint64_t(values[i]) - 2 * uint64_t(values[i - 1]) + uint64_t(values[i - 2]));
+  };
+}
+
+/*!
+  Reads the blocks of a_count values from the front of the payload, advancing it.
+
+  \returns  false if the payload is short, or a bit width is invalid.
+*/
+inline bool decode_series_blocks(std::span<const uint8_t> &a_payload, const std::size_t a_count, int64_t *a_values)
+{
+  auto values = std::array<int64_t, series_block_size>{};
+  for (std::size_t first = 0; first < a_count; first += series_block_size) {
+    if (a_payload.size() < series_block_header) return false;
+    const auto n = std::min(series_block_size, a_count - first);
+    const auto reference = load_little_endian<uint64_t>(a_payload.data());
+    const auto width = std::size_t{a_payload[sizeof(int64_t)]};
+    const auto groups = (n + 7) / 8;
+    if (width > 64 || a_payload.size() - series_block_header < groups * width) return false;
+
+    series_unpackers[width](a_payload.data() + series_block_header, groups, reference, values.data());
+    std::copy_n(values.data(), n, a_values + first);
+    a_payload = a_payload.subspan(series_block_header + groups * width);
+  }
+  return true;
+}
+
+/*!
+  Reads the number of values at the front of a series payload, advancing it.
+*/
+inline bool decode_series_count(std::span<const uint8_t> &a_payload, std::size_t &a_count)
+{
+  if (a_payload.size() < sizeof(uint32_t)) return false;
+  a_count = load_little_endian<uint32_t>(a_payload.data());
+  a_payload = a_payload.subspan(sizeof(uint32_t));
+  return true;
+}
+
+/*!
+  Whether the payload may hold the blocks of a_count values, checked before allocating them.
+*/
+inline bool series_blocks_fit(const std::span<const uint8_t> a_payload, const std::size_t a_count)
+{
+  return (a_count + series_block_size - 1) / series_block_size * series_block_header <= a_payload.size();
+}
+
+/*!
+  Writes bits most significant first to a writer of ExtTraits::encode(), 256 bytes at a time.
+*/
+template<typename WriterT>
+class SeriesBitWriter
+{
+public:
+  explicit SeriesBitWriter(WriterT &a_write) : write_(a_write)
+  {};
+
+  /*!
+    Writes the a_bits low bits of the value, 1 to 64.
+  */
+  void put(uint64_t a_value, const unsigned a_bits)
+  {
+    if (a_bits < 64) a_value &= (uint64_t{1} << a_bits) - 1;
+    const auto free = 64 - fill_;
+    if (a_bits < free) {
+      word_ |= a_value << (free - a_bits);
+      fill_ += a_bits;
+      return;
+    }
+
+    word_ |= a_value >> (a_bits - free);
+    flush_word(8);
+    fill_ = a_bits - free;
+    word_ = fill_ == 0 ? 0 : a_value << (64 - fill_);
+  }
+
+  /*!
+    Writes the bits left, padded with zeros to a byte.
+  */
+  void finish()
+  {
+    flush_word((fill_ + 7) / 8);
+    if (used_ != 0) write_(buffer_.data(), used_);
+    used_ = 0;
+  }
+
+private:
+  void flush_word(const unsigned a_bytes)
+  {
+    if (used_ + 8 > buffer_.size()) {
+      write_(buffer_.data(), used_);
+      used_ = 0;
+    }
+    store_big_endian(word_, buffer_.data() + used_);
+    used_ += a_bytes;
+    word_ = 0;
+  }
+
+  WriterT &write_;
+  std::array<uint8_t, 256> buffer_{};
+  std::size_t used_{0};
+  uint64_t word_{0};
+  unsigned fill_{0};
+};
+
+/*!
+  Counts the bits a SeriesBitWriter would write, for ExtTraits::size().
+*/
+struct SeriesBitCounter
+{
+  std::size_t bits{0};
+
+  void put(uint64_t /*value*/, const unsigned a_bits)
+  {
+    bits += a_bits;
+  }
+};
+
+/*!
+  Reads bits most significant first.
+*/
+class SeriesBitReader
+{
+public:
+  explicit SeriesBitReader(const std::span<const uint8_t> a_bytes) : bytes_(a_bytes)
+  {};
+
+  /*!
+    Reads a_bits bits, 1 to 64, false if past the end.
+  */
+  bool get(const unsigned a_bits, uint64_t &a_value)
+  {
+    if (position_ + a_bits > bytes_.size() * 8) return false;
+    a_value = 0;
+    for (auto left = a_bits; left != 0;) {
+      const auto available = 8 - unsigned(position_ % 8);
+      const auto taken = std::min(available, left);
+      const auto bits = (unsigned(bytes_[position_ / 8]) >> (available - taken)) & ((1U << taken) - 1);
+      a_value = (a_value << taken) | bits;
+      position_ += taken;
+      left -= taken;
+    }
+    return true;
+  }
+
+private:
+  std::span<const uint8_t> bytes_;
+  std::size_t position_{0};
+};
+
+/*!
+  Writes the XOR stream of the values, see XorSeries.
+*/
+template<typename BitsT>
+void encode_xor_series(const std::vector<double> &a_values, BitsT &a_bits)
+{
+  if (a_values.empty()) return;
+  auto previous = std::bit_cast<uint64_t>(a_values[0]);
+  a_bits.put(previous, 64);
+
+  // The leading and trailing zeros of the previous window, none before the first.
+  unsigned leading{64};
+  unsigned trailing{0};
+  for (std::size_t i = 1; i < a_values.size(); i++) {
+    const auto value = std::bit_cast<uint64_t>(a_values[i]);
+    const auto x = value ^ previous;
+    previous = value;
+    if (x == 0) {
+      a_bits.put(0, 1);
+      continue;
+    }
+
+    const auto lead = std::min(unsigned(std::countl_zero(x)), 31U);
+    const auto trail = unsigned(std::countr_zero(x));
+    if (leading != 64 && lead >= leading && trail >= trailing) {
+      a_bits.put(0b10, 2);
+      a_bits.put(x >> trailing, 64 - leading - trailing);
+    } else {
+      const auto length = 64 - lead - trail;
+      a_bits.put(0b11, 2);
+      a_bits.put(lead, 5);
+      // Lengths of 64 are written as 0.
+      a_bits.put(length & 63U, 6);
+      a_bits.put(x >> trail, length);
+      leading = lead;
+      trailing = trail;
+    }
+  }
+}
+
+}
+
+template<>
+struct ExtTraits<PackedSeries>
+{
+  static constexpr int8_t type = SeriesExt::packed_series;
+
+  static size_t size(const PackedSeries &a_series)
+  {
+    return sizeof(uint32_t) + detail::series_blocks_size(a_series.values.size(), detail::packed_series_fill(a_series));
+  }
+
+  template<typename WriterT>
+  static void encode(const PackedSeries &a_series, WriterT &&a_write)
+  {
+    auto count = std::array<uint8_t, sizeof(uint32_t)>{};
+    detail::store_little_endian(uint32_t(a_series.values.size()), count.data());
+    a_write(count.data(), count.size());
+    detail::encode_series_blocks(a_series.values.size(), detail::packed_series_fill(a_series), a_write);
+  }
+
+  static bool decode(std::span<const uint8_t> a_payload, PackedSeries &a_series)
+  {
+    std::size_t count{0};
+    if (!detail::decode_series_count(a_payload, count) || !detail::series_blocks_fit(a_payload, count)) return false;
+    a_series.values.resize(count);
+    return detail::decode_series_blocks(a_payload, count, a_series.values.data()) && a_payload.empty();
+  }
+};
+
+template<>
+struct ExtTraits<DeltaSeries>
+{
+  static constexpr int8_t type = SeriesExt::delta_series;
+
+  static size_t size(const DeltaSeries &a_series)
+  {
+    const auto count = a_series.values.size();
+    return sizeof(uint32_t) + std::min(count, std::size_t{2}) * sizeof(int64_t) +
+           detail::series_blocks_size(count < 2 ? 0 : count - 2, detail::delta_series_fill(a_series));
+  }
+
+  template<typename WriterT>
+  static void encode(const DeltaSeries &a_series, WriterT &&a_write)
+  {
+    const auto &values = a_series.values;
+    auto head = std::array<uint8_t, sizeof(uint32_t) + 2 * sizeof(int64_t)>{};
+    detail::store_little_endian(uint32_t(values.size()), head.data());
+    if (!values.empty()) detail::store_little_endian(uint64_t(values[0]), head.data() + sizeof(uint32_t));
+    if (values.size() > 1)
+      detail::store_little_endian(uint64_t(values[1]) - uint64_t(values[0]), head.data() + sizeof(uint32_t) + sizeof(int64_t));
+    a_write(head.data(), sizeof(uint32_t) + std::min(values.size(), std::size_t{2}) * sizeof(int64_t));
+    if (values.size() > 2) detail::encode_series_blocks(values.size() - 2, detail::delta_series_fill(a_series), a_write);
+  }
+
+  static bool decode(std::span<const uint8_t> a_payload, DeltaSeries &a_series)
+  {
+    std::size_t count{0};
+    if (!detail::decode_series_count(a_payload, count)) return false;
+    const auto head = std::min(count, std::size_t{2}) * sizeof(int64_t);
+    if (a_payload.size() < head || !detail::series_blocks_fit(a_payload.subspan(head), count - head / sizeof(int64_t)))
+      return false;
+
+    auto &values = a_series.values;
+    values.resize(count);
+    if (count == 0) return a_payload.empty();
+    values[0] = int64_t(detail::load_little_endian<uint64_t>(a_payload.data()));
+    a_payload = a_payload.subspan(sizeof(int64_t));
+    if (count == 1) return a_payload.empty();
+
+    auto delta = detail::load_little_endian<uint64_t>(a_payload.data());
+    a_payload = a_payload.subspan(sizeof(int64_t));
+    values[1] = int64_t(uint64_t(values[0]) + delta);
+    if (!detail::decode_series_blocks(a_payload, count - 2, values.data() + 2) || !a_payload.empty()) return false;
+
+    // The differences of differences, decoded in place, summed twice.
+    for (std::size_t i = 2; i < count; i++) {
+      delta += uint64_t(values[i]);
+      values[i] = int64_t(uint64_t(values[i - 1]) + delta);
+    }
+    return true;
+  }
+};
+
+template<>
+struct ExtTraits<XorSeries>
+{
+  static constexpr int8_t type = SeriesExt::xor_series;
+
+  static size_t size(const XorSeries &a_series)
+  {
+    auto bits = detail::SeriesBitCounter{};
+    detail::encode_xor_series(a_series.values, bits);
+    return sizeof(uint32_t) + (bits.bits + 7) / 8;
+  }
+
+  template<typename WriterT>
+  static void encode(const XorSeries &a_series, WriterT &&a_write)
+  {
+    auto count = std::array<uint8_t, sizeof(uint32_t)>{};
+    detail::store_little_endian(uint32_t(a_series.values.size()), count.data());
+    a_write(count.data(), count.size());
+
+    auto bits = detail::SeriesBitWriter{a_write};
+    detail::encode_xor_series(a_series.values, bits);
+    bits.finish();
+  }
+
+  static bool decode(std::span<const uint8_t> a_payload, XorSeries &a_series)
+  {
+    if (a_payload.size() < sizeof(uint32_t)) return false;
+    const std::size_t count = detail::load_little_endian<uint32_t>(a_payload.data());
+    a_payload = a_payload.subspan(sizeof(uint32_t));
+    // The first value takes 64 bits, and each other at least 1.
+    if (count != 0 && (a_payload.size() < sizeof(double) || count - 1 > (a_payload.size() - sizeof(double)) * 8))
+      return false;
+
+    auto &values = a_series.values;
+    values.resize(count);
+    if (count == 0) return a_payload.empty();
+
+    auto bits = detail::SeriesBitReader{a_payload};
+    uint64_t previous{0};
+    bits.get(64, previous);
+    values[0] = std::bit_cast<double>(previous);
+
+    unsigned leading{64};
+    unsigned trailing{0};
+    for (std::size_t i = 1; i < count; i++) {
+      uint64_t flag{0};
+      if (!bits.get(1, flag)) return false;
+      if (flag != 0) {
+        if (!bits.get(1, flag)) return false;
+        if (flag != 0) {
+          uint64_t lead{0};
+          uint64_t length{0};
+          if (!bits.get(5, lead) || !bits.get(6, length)) return false;
+          if (length == 0) length = 64;
+          if (lead + length > 64) return false;
+          leading = unsigned(lead);
+          trailing = unsigned(64 - lead - length);
+        } else if (leading == 64) {
+          // A window reused before any was written.
+          return false;
+        }
+
+        uint64_t x{0};
+        if (!bits.get(64 - leading - trailing, x)) return false;
+        previous ^= x << trailing;
+      }
+      values[i] = std::bit_cast<double>(previous);
+    }
+    return true;
+  }
+};
+
+}
+#endif
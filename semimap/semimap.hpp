@@ -27,11 +27,25 @@
 #ifndef WXLIB_SEMIMAP_HPP
 #define WXLIB_SEMIMAP_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <new>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -40,6 +54,11 @@
 #error semi::map and semi::static_map require C++20 support
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEMI_HAS_SSE2 1
+#endif
+
 #ifdef __GNUC__
 #define semi_branch_expect(x, y) __builtin_expect(x, y)
 #else
@@ -48,8 +67,75 @@
 
 namespace semi {
 
+// layout policies of the values behind compile-time keys, chosen by deriving the tag type
+// of a static_map or map from one of them; by default the value and its init flag are two
+// separate variables
+struct packed_layout
+{
+};
+
+// value and init flag share one slot padded to a cache line of its own, so threads updating
+// the values of different keys do not contend for a line
+struct padded_layout
+{
+};
+
+// cache policy bounding the number of run-time keys of a static_map or map, chosen by deriving
+// the tag type from it; once CapacityV keys are stored, the next one evicts a key not looked up
+// since the clock hand last passed it. Compile-time keys are never evicted, nor counted
+template<std::size_t CapacityV>
+struct clock_cache
+{
+  static_assert(CapacityV > 0, "a cache needs room for at least one key");
+
+  static constexpr std::size_t cache_capacity = CapacityV;
+};
+
 namespace detail {
 
+#ifdef __cpp_lib_hardware_interference_size
+// GCC warns the value depends on -mtune, all translation units must agree on it
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+inline constexpr std::size_t cache_line_size = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+inline constexpr std::size_t cache_line_size = 64;
+#endif
+
+// value and init flag of a compile-time key, read together on its hot path
+template<typename ValueT, std::size_t AlignmentV>
+struct alignas(AlignmentV) value_slot
+{
+  alignas(ValueT) char storage[sizeof(ValueT)];
+  bool init_flag = false;
+};
+
+template<typename TagT, typename ValueT>
+inline constexpr std::size_t slot_alignment = std::is_base_of_v<padded_layout, TagT>
+                                                  ? std::max(alignof(ValueT), cache_line_size)
+                                                  : alignof(ValueT);
+
+// appends to a sequence container or inserts into an associative one
+template<typename ContainerT, typename KeyT, typename ValueT>
+void add_entry(ContainerT &a_container, const KeyT &a_key, const ValueT &a_value)
+{
+  if constexpr (requires { a_container.emplace_back(a_key, a_value); })
+    a_container.emplace_back(a_key, a_value);
+  else
+    a_container.emplace(a_key, a_value);
+}
+
+template<typename TagT>
+inline constexpr bool is_clock_cache = requires { TagT::cache_capacity; };
+
+template<typename TagT>
+inline constexpr bool is_slot_layout = std::is_base_of_v<packed_layout, TagT> || std::is_base_of_v<padded_layout, TagT>;
+
 // evaluates to the type returned by a constexpr lambda
 template<typename IdentifierT>
 using identifier_t = decltype(std::declval<IdentifierT>()());
@@ -97,54 +183,456 @@ struct default_tag
 {
 };
 
-// super simple flat map implementation
-template<typename KeyT, typename ValueT>
-class flat_map
+// hash and equality of the run-time keys, transparent for strings so that a string_view or a
+// const char * is looked up without building a temporary string
+template<typename KeyT>
+struct key_hash : std::hash<KeyT>
+{
+};
+
+template<typename CharT, typename TraitsT, typename AllocatorT>
+struct key_hash<std::basic_string<CharT, TraitsT, AllocatorT>>
+{
+  using is_transparent = void;
+
+  std::size_t operator()(std::basic_string_view<CharT, TraitsT> a_key) const noexcept
+  {
+    return std::hash<std::basic_string_view<CharT, TraitsT>>{}(a_key);
+  }
+};
+
+template<typename KeyT>
+struct key_equal : std::equal_to<KeyT>
+{
+};
+
+template<typename CharT, typename TraitsT, typename AllocatorT>
+struct key_equal<std::basic_string<CharT, TraitsT, AllocatorT>> : std::equal_to<>
+{
+};
+
+template<typename KeyT, typename KeyLikeT>
+concept transparent_key = requires { typename key_hash<KeyT>::is_transparent; } &&
+                          !std::is_invocable_v<KeyLikeT> &&
+                          !std::is_same_v<std::remove_cvref_t<KeyLikeT>, KeyT> &&
+                          std::is_invocable_v<key_hash<KeyT>, const KeyLikeT &>;
+
+// per-key store of the values of all semi::map instances, indexed by the slot id of the instance
+template<typename ValueT>
+class indexed_store
 {
 public:
   template<typename... ArgTs>
-  ValueT &get(const KeyT &a_key, ArgTs &&... a_args)
+  ValueT &get(std::size_t a_slot, ArgTs &&... a_args)
   {
-    for (auto &pair : storage_)
-      if (a_key == pair.first) return pair.second;
+    if (a_slot >= storage_.size()) storage_.resize(a_slot + 1);
+
+    auto &value = storage_[a_slot];
+    if (!value) {
+      value.emplace(std::forward<ArgTs>(a_args)...);
+      ++size_;
+    }
 
-    return storage_.emplace_back(a_key, ValueT(std::forward<ArgTs>(a_args)...)).second;
+    return *value;
   }
 
   auto size() const
   {
-    return storage_.size();
+    return size_;
   }
 
-  void erase(const KeyT &a_key)
+  void erase(std::size_t a_slot)
   {
-    for (auto it = storage_.begin(); it != storage_.end(); ++it) {
-      if (it->first == a_key) {
-        storage_.erase(it);
-        return;
-      }
+    if (contains(a_slot)) {
+      storage_[a_slot].reset();
+      --size_;
     }
   }
 
-  bool contains(const KeyT &a_key) const
+  bool contains(std::size_t a_slot) const
   {
-    for (auto &pair : storage_)
-      if (pair.first == a_key) return true;
+    return a_slot < storage_.size() && storage_[a_slot].has_value();
+  }
 
-    return false;
+  ValueT *find(std::size_t a_slot)
+  {
+    return contains(a_slot) ? &*storage_[a_slot] : nullptr;
   }
 
 private:
-  std::vector<std::pair<KeyT, ValueT>> storage_;
+  std::vector<std::optional<ValueT>> storage_;
+  std::size_t size_ = 0;
 };
 
 } // namespace detail
 
+// open-addressing hash table with SwissTable-style probing, usable as the run-time key backend
+// of static_map. One control byte per slot holds 7 bits of the hash, and a group of 16 control
+// bytes is matched at once, so most lookups touch one control line and one slot. Erasing leaves
+// the other elements in place and does not invalidate iterators to them.
+template<typename KeyT, typename MappedT, typename HashT = std::hash<KeyT>, typename KeyEqualT = std::equal_to<KeyT>>
+class flat_hash_map
+{
+public:
+  using key_type = KeyT;
+  using mapped_type = MappedT;
+  using value_type = std::pair<KeyT, MappedT>;
+  using size_type = std::size_t;
+
+  template<bool IsConst>
+  class basic_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = flat_hash_map::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<IsConst, const value_type *, value_type *>;
+    using reference = std::conditional_t<IsConst, const value_type &, value_type &>;
+
+    basic_iterator() = default;
+
+    template<bool IsOtherConst>
+    requires (IsConst && !IsOtherConst)
+    basic_iterator(const basic_iterator<IsOtherConst> &a_other) : map_(a_other.map_), index_(a_other.index_)
+    {
+    }
+
+    reference operator*() const
+    {
+      return map_->slots_[index_];
+    }
+
+    pointer operator->() const
+    {
+      return &map_->slots_[index_];
+    }
+
+    basic_iterator &operator++()
+    {
+      index_ = map_->next_full(index_ + 1);
+      return *this;
+    }
+
+    basic_iterator operator++(int)
+    {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const basic_iterator &, const basic_iterator &) = default;
+
+  private:
+    friend class flat_hash_map;
+
+    template<bool>
+    friend class basic_iterator;
+
+    using map_pointer = std::conditional_t<IsConst, const flat_hash_map *, flat_hash_map *>;
+
+    basic_iterator(map_pointer a_map, std::size_t a_index) : map_(a_map), index_(a_index)
+    {
+    }
+
+    map_pointer map_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  flat_hash_map() = default;
+  flat_hash_map(const flat_hash_map &) = delete;
+  flat_hash_map &operator=(const flat_hash_map &) = delete;
+
+  ~flat_hash_map()
+  {
+    destroy_all();
+    std::allocator<value_type>().deallocate(slots_, capacity_);
+  }
+
+  iterator begin()
+  {
+    return {this, next_full(0)};
+  }
+
+  iterator end()
+  {
+    return {this, capacity_};
+  }
+
+  const_iterator begin() const
+  {
+    return {this, next_full(0)};
+  }
+
+  const_iterator end() const
+  {
+    return {this, capacity_};
+  }
+
+  size_type size() const
+  {
+    return size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  iterator find(const KeyT &a_key)
+  {
+    return {this, find_index(a_key, hash_of(a_key))};
+  }
+
+  const_iterator find(const KeyT &a_key) const
+  {
+    return {this, find_index(a_key, hash_of(a_key))};
+  }
+
+  template<typename KeyLikeT>
+  requires requires { typename HashT::is_transparent; typename KeyEqualT::is_transparent; }
+  iterator find(const KeyLikeT &a_key)
+  {
+    return {this, find_index(a_key, hash_of(a_key))};
+  }
+
+  template<typename KeyLikeT>
+  requires requires { typename HashT::is_transparent; typename KeyEqualT::is_transparent; }
+  const_iterator find(const KeyLikeT &a_key) const
+  {
+    return {this, find_index(a_key, hash_of(a_key))};
+  }
+
+  template<typename... ArgTs>
+  std::pair<iterator, bool> try_emplace(const KeyT &a_key, ArgTs &&... a_args)
+  {
+    auto hash = hash_of(a_key);
+    auto index = find_index(a_key, hash);
+    if (index != capacity_) return {iterator(this, index), false};
+
+    index = insert_index(hash);
+    new(slots_ + index) value_type(std::piecewise_construct, std::forward_as_tuple(a_key),
+                                   std::forward_as_tuple(std::forward<ArgTs>(a_args)...));
+    set_ctrl(index, h2(hash));
+    ++size_;
+
+    return {iterator(this, index), true};
+  }
+
+  // the hint is ignored, it is accepted for the interface of std::unordered_map
+  template<typename... ArgTs>
+  iterator emplace_hint(const_iterator, const KeyT &a_key, ArgTs &&... a_args)
+  {
+    return try_emplace(a_key, std::forward<ArgTs>(a_args)...).first;
+  }
+
+  iterator erase(const_iterator a_pos)
+  {
+    erase_index(a_pos.index_);
+    return {this, next_full(a_pos.index_ + 1)};
+  }
+
+  size_type erase(const KeyT &a_key)
+  {
+    auto index = find_index(a_key, hash_of(a_key));
+    if (index == capacity_) return 0;
+
+    erase_index(index);
+    return 1;
+  }
+
+  void clear()
+  {
+    destroy_all();
+    std::fill(ctrl_.begin(), ctrl_.end(), ctrl_empty);
+    size_ = 0;
+    growth_left_ = capacity_ - capacity_ / 8;
+  }
+
+private:
+  static constexpr std::size_t group_width = 16;
+  static constexpr std::int8_t ctrl_empty = -128;
+  static constexpr std::int8_t ctrl_deleted = -2;
+
+  // bit i is set for each control byte of the group equal to the given one
+  static std::uint32_t match(const std::int8_t *a_group, std::int8_t a_ctrl)
+  {
+#ifdef SEMI_HAS_SSE2
+    auto group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_group));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(a_ctrl))));
+#else
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < group_width; ++i)
+      mask |= static_cast<std::uint32_t>(a_group[i] == a_ctrl) << i;
+    return mask;
+#endif
+  }
+
+  // bit i is set for each empty or deleted control byte of the group
+  static std::uint32_t match_free(const std::int8_t *a_group)
+  {
+#ifdef SEMI_HAS_SSE2
+    auto group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_group));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(group, _mm_set1_epi8(-1))));
+#else
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < group_width; ++i)
+      mask |= static_cast<std::uint32_t>(a_group[i] < -1) << i;
+    return mask;
+#endif
+  }
+
+  static std::size_t lowest_bit(std::uint32_t a_mask)
+  {
+    return static_cast<std::size_t>(std::countr_zero(a_mask));
+  }
+
+  template<typename KeyLikeT>
+  std::size_t hash_of(const KeyLikeT &a_key) const
+  {
+    // std::hash is the identity for integers, spread its bits over the whole word
+    auto hash = static_cast<std::uint64_t>(HashT{}(a_key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+  }
+
+  static std::int8_t h2(std::size_t a_hash)
+  {
+    return static_cast<std::int8_t>(a_hash & 0x7F);
+  }
+
+  // groups are probed in triangular steps, which visits each of a power-of-two count once
+  template<typename VisitorT>
+  std::size_t probe(std::size_t a_hash, VisitorT &&a_visitor) const
+  {
+    auto group_mask = capacity_ / group_width - 1;
+    auto group = (a_hash >> 7) & group_mask;
+
+    for (std::size_t step = 1;; ++step) {
+      auto index = a_visitor(group * group_width);
+      if (index != capacity_) return index;
+      group = (group + step) & group_mask;
+    }
+  }
+
+  template<typename KeyLikeT>
+  std::size_t find_index(const KeyLikeT &a_key, std::size_t a_hash) const
+  {
+    if (size_ == 0) return capacity_;
+
+    std::size_t not_found = capacity_ + 1;
+    auto index = probe(a_hash, [&](std::size_t a_first) {
+      const auto *group = ctrl_.data() + a_first;
+
+      for (auto mask = match(group, h2(a_hash)); mask != 0; mask &= mask - 1) {
+        auto slot = a_first + lowest_bit(mask);
+        if (KeyEqualT{}(slots_[slot].first, a_key)) return slot;
+      }
+
+      return match(group, ctrl_empty) != 0 ? not_found : capacity_;
+    });
+
+    return index == not_found ? capacity_ : index;
+  }
+
+  std::size_t insert_index(std::size_t a_hash)
+  {
+    if (capacity_ == 0) rehash(group_width);
+
+    auto index = probe(a_hash, [&](std::size_t a_first) {
+      auto mask = match_free(ctrl_.data() + a_first);
+      return mask != 0 ? a_first + lowest_bit(mask) : capacity_;
+    });
+
+    // reusing a deleted slot keeps the length of the probe sequences
+    if (ctrl_[index] == ctrl_empty) {
+      if (growth_left_ == 0) {
+        rehash(size_ * 2 >= capacity_ - capacity_ / 8 ? capacity_ * 2 : capacity_);
+        return insert_index(a_hash);
+      }
+      --growth_left_;
+    }
+
+    return index;
+  }
+
+  void set_ctrl(std::size_t a_index, std::int8_t a_ctrl)
+  {
+    ctrl_[a_index] = a_ctrl;
+  }
+
+  void erase_index(std::size_t a_index)
+  {
+    slots_[a_index].~value_type();
+    --size_;
+
+    // a group with an empty byte has never been full, so no probe sequence continues past it
+    auto first = a_index - a_index % group_width;
+    if (match(ctrl_.data() + first, ctrl_empty) != 0) {
+      set_ctrl(a_index, ctrl_empty);
+      ++growth_left_;
+    } else {
+      set_ctrl(a_index, ctrl_deleted);
+    }
+  }
+
+  std::size_t next_full(std::size_t a_index) const
+  {
+    while (a_index < capacity_ && ctrl_[a_index] < 0) ++a_index;
+    return a_index;
+  }
+
+  void destroy_all()
+  {
+    for (std::size_t i = 0; i < capacity_; ++i)
+      if (ctrl_[i] >= 0) slots_[i].~value_type();
+  }
+
+  void rehash(std::size_t a_capacity)
+  {
+    std::allocator<value_type> allocator;
+
+    auto *old_slots = slots_;
+    auto old_ctrl = std::move(ctrl_);
+    auto old_capacity = capacity_;
+
+    slots_ = allocator.allocate(a_capacity);
+    ctrl_.assign(a_capacity, ctrl_empty);
+    capacity_ = a_capacity;
+    growth_left_ = capacity_ - capacity_ / 8 - size_;
+
+    for (std::size_t i = 0; i < old_capacity; ++i) {
+      if (old_ctrl[i] < 0) continue;
+
+      auto hash = hash_of(old_slots[i].first);
+      auto index = probe(hash, [&](std::size_t a_first) {
+        auto mask = match(ctrl_.data() + a_first, ctrl_empty);
+        return mask != 0 ? a_first + lowest_bit(mask) : capacity_;
+      });
+
+      new(slots_ + index) value_type(std::move(old_slots[i]));
+      old_slots[i].~value_type();
+      set_ctrl(index, h2(hash));
+    }
+
+    allocator.deallocate(old_slots, old_capacity);
+  }
+
+  value_type *slots_ = nullptr;
+  std::vector<std::int8_t> ctrl_;
+  std::size_t capacity_ = 0;
+  std::size_t size_ = 0;
+  std::size_t growth_left_ = 0;
+};
+
 // forward declaration
-template<typename, typename, typename>
+template<typename, typename, typename, template<typename...> class>
 class map;
 
-template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, true>>
+// RuntimeMapT is the container of the run-time keys, std::unordered_map or flat_hash_map
+template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, true>,
+         template<typename...> class RuntimeMapT = std::unordered_map>
 class static_map
 {
 public:
@@ -156,15 +644,17 @@ public:
   {
     using UniqueTypeForKeyValue = decltype(detail::idval2type(a_id));
 
-    auto *mem = storage<UniqueTypeForKeyValue>;
-    auto &l_init_flag = init_flag<UniqueTypeForKeyValue>;
+    auto *mem = storage_of<UniqueTypeForKeyValue>();
+    auto &l_init_flag = init_flag_of<UniqueTypeForKeyValue>();
 
     if (!semi_branch_expect(l_init_flag, true)) {
       KeyT key(a_id());
       auto it = runtime_map.find(key);
 
-      if (it != runtime_map.end())
+      if (it != runtime_map.end()) {
+        release_clock_slot(it->second);
         it->second = u_ptr(new(mem) ValueT(std::move(*it->second)), {&l_init_flag});
+      }
       else
         runtime_map.emplace_hint(it, key, u_ptr(new(mem) ValueT(std::forward<ArgTs>(a_args)...), {&l_init_flag}));
 
@@ -177,12 +667,15 @@ public:
   template<typename... ArgTs>
   static ValueT &get(const KeyT &a_key, ArgTs &&... a_args)
   {
-    auto it = runtime_map.find(a_key);
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
+  }
 
-    if (it != runtime_map.end())
-      return *it->second;
-    else
-      return *runtime_map.emplace_hint(it, a_key, u_ptr(new ValueT(std::forward<ArgTs>(a_args)...), {nullptr}))->second;
+  // a KeyT is only built when the key has to be inserted
+  template<typename KeyLikeT, typename... ArgTs>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static ValueT &get(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
   }
 
   template<typename IdentifierT>
@@ -191,7 +684,7 @@ public:
   {
     using UniqueTypeForKeyValue = decltype(detail::idval2type(a_id));
     // @formatter:off
-    if (!semi_branch_expect(init_flag<UniqueTypeForKeyValue>, true)) {
+    if (!semi_branch_expect(init_flag_of<UniqueTypeForKeyValue>(), true)) {
     // @formatter:on
       auto key = a_id();
       return contains(key);
@@ -205,6 +698,13 @@ public:
     return (runtime_map.find(a_key) != runtime_map.end());
   }
 
+  template<typename KeyLikeT>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static bool contains(const KeyLikeT &a_key)
+  {
+    return (runtime_map.find(a_key) != runtime_map.end());
+  }
+
   template<typename Identifier>
   requires std::is_invocable_v<Identifier>
   static void erase(Identifier identifier)
@@ -214,75 +714,628 @@ public:
 
   static void erase(const KeyT &a_key)
   {
-    runtime_map.erase(a_key);
+    auto it = runtime_map.find(a_key);
+    if (it != runtime_map.end()) erase_entry(it);
+  }
+
+  template<typename KeyLikeT>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static void erase(const KeyLikeT &a_key)
+  {
+    auto it = runtime_map.find(a_key);
+    if (it != runtime_map.end()) erase_entry(it);
   }
 
   static void clear()
   {
     runtime_map.clear();
+
+    if constexpr (detail::is_clock_cache<TagT>) {
+      clock_ring.clear();
+      clock_free.clear();
+      clock_hand = 0;
+    }
   }
 
-private:
-  struct ValueDeleter
+  static std::size_t size()
   {
-    void operator()(ValueT *a_value)
-    {
-      if (init_flag != nullptr) {
-        a_value->~ValueT();
-        *init_flag = false;
-      } else {
-        delete a_value;
-      }
-    }
+    return runtime_map.size();
+  }
 
-    bool *init_flag = nullptr;
-  };
+  // visits each key and its value, compile-time keys included, in no particular order
+  template<typename VisitorT>
+  static void for_each(VisitorT &&a_visitor)
+  {
+    for (auto &pair : runtime_map) a_visitor(pair.first, *pair.second);
+  }
 
-  using u_ptr = std::unique_ptr<ValueT, ValueDeleter>;
+  // copies all entries in one pass, into a flat array of pairs by default; a std::map gives
+  // them ordered by key, and is what msgpack and zpp_bits serialize as a map
+  template<typename ContainerT = std::vector<std::pair<KeyT, ValueT>>>
+  static ContainerT snapshot()
+  {
+    ContainerT entries;
+    if constexpr (requires { entries.reserve(size()); }) entries.reserve(size());
 
-  template<typename, typename, typename>
-  friend
-  class map;
+    for_each([&](const KeyT &a_key, const ValueT &a_value) { detail::add_entry(entries, a_key, a_value); });
+    return entries;
+  }
 
-  template<typename>
-  alignas(ValueT) static char storage[sizeof(ValueT)];
+  // assigns the entries of a snapshot, leaving other keys untouched
+  template<typename ContainerT>
+  static void restore(const ContainerT &a_entries)
+  {
+    for (const auto &[key, value] : a_entries) get(key) = value;
+  }
 
-  template<typename>
-  static bool init_flag;
+private:
+  template<typename KeyLikeT, typename... ArgTs>
+  static ValueT &get_runtime(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    auto it = runtime_map.find(a_key);
 
-  static std::unordered_map<KeyT, std::unique_ptr<ValueT, ValueDeleter>> runtime_map;
-};
+    if constexpr (detail::is_clock_cache<TagT>) {
+      if (it != runtime_map.end()) {
+        if (auto index = it->second.get_deleter().clock_index; index != no_clock_slot) clock_ring[index].referenced = true;
+        return *it->second;
+      }
 
-template<typename KeyT, typename ValueT, typename TagT>
-std::unordered_map<KeyT, typename static_map<KeyT, ValueT, TagT>::u_ptr> static_map<KeyT, ValueT, TagT>::runtime_map;
+      // the value is built before evicting, in case its arguments refer to the evicted one
+      auto value = u_ptr(new ValueT(std::forward<ArgTs>(a_args)...), {nullptr});
+      KeyT key(a_key);
+      value.get_deleter().clock_index = acquire_clock_slot(key);
+      return *runtime_map.try_emplace(key, std::move(value)).first->second;
+    } else {
+      if (it != runtime_map.end())
+        return *it->second;
+      else
+        return *runtime_map.emplace_hint(it, KeyT(a_key), u_ptr(new ValueT(std::forward<ArgTs>(a_args)...), {nullptr}))->second;
+    }
+  }
 
-template<typename KeyT, typename ValueT, typename TagT>
+  template<typename IteratorT>
+  static IteratorT erase_entry(IteratorT a_it)
+  {
+    release_clock_slot(a_it->second);
+    return runtime_map.erase(a_it);
+  }
+
+  static constexpr std::size_t no_clock_slot = static_cast<std::size_t>(-1);
+
+  // a run-time key of a clock_cache, and whether it was looked up since the hand last passed it
+  struct clock_slot
+  {
+    KeyT key;
+    bool referenced = false;
+  };
+
+  // finds a slot for a new run-time key, evicting the key of the first slot found unreferenced
+  static std::size_t acquire_clock_slot(const KeyT &a_key)
+  {
+    std::size_t index;
+    if (!clock_free.empty()) {
+      index = clock_free.back();
+      clock_free.pop_back();
+    } else if (clock_ring.size() < TagT::cache_capacity) {
+      index = clock_ring.size();
+      clock_ring.emplace_back();
+    } else {
+      while (clock_ring[clock_hand].referenced) {
+        clock_ring[clock_hand].referenced = false;
+        clock_hand = (clock_hand + 1) % clock_ring.size();
+      }
+
+      index = clock_hand;
+      clock_hand = (clock_hand + 1) % clock_ring.size();
+      runtime_map.erase(clock_ring[index].key);
+    }
+
+    clock_ring[index] = {a_key, false};
+    return index;
+  }
+
+  // frees the slot of an entry leaving the cache, erased or taken over by a compile-time key
+  template<typename PointerT>
+  static void release_clock_slot(PointerT &a_value)
+  {
+    if constexpr (detail::is_clock_cache<TagT>) {
+      auto &index = a_value.get_deleter().clock_index;
+      if (index == no_clock_slot) return;
+
+      clock_ring[index].referenced = false;
+      clock_free.push_back(index);
+      index = no_clock_slot;
+    }
+  }
+
+  struct ValueDeleter
+  {
+    void operator()(ValueT *a_value)
+    {
+      if (init_flag != nullptr) {
+        a_value->~ValueT();
+        *init_flag = false;
+      } else {
+        delete a_value;
+      }
+    }
+
+    bool *init_flag = nullptr;
+    std::size_t clock_index = no_clock_slot;
+  };
+
+  using u_ptr = std::unique_ptr<ValueT, ValueDeleter>;
+
+  template<typename, typename, typename, template<typename...> class>
+  friend
+  class map;
+
+  template<typename UniqueT>
+  static char *storage_of()
+  {
+    if constexpr (detail::is_slot_layout<TagT>)
+      return slot<UniqueT>.storage;
+    else
+      return storage<UniqueT>;
+  }
+
+  template<typename UniqueT>
+  static bool &init_flag_of()
+  {
+    if constexpr (detail::is_slot_layout<TagT>)
+      return slot<UniqueT>.init_flag;
+    else
+      return init_flag<UniqueT>;
+  }
+
+  template<typename>
+  alignas(ValueT) static char storage[sizeof(ValueT)];
+
+  template<typename>
+  static bool init_flag;
+
+  template<typename>
+  static detail::value_slot<ValueT, detail::slot_alignment<TagT, ValueT>> slot;
+
+  using runtime_map_t = RuntimeMapT<KeyT, u_ptr, detail::key_hash<KeyT>, detail::key_equal<KeyT>>;
+
+  static runtime_map_t runtime_map;
+
+  static std::vector<clock_slot> clock_ring;
+  static std::vector<std::size_t> clock_free;
+  static std::size_t clock_hand;
+};
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+typename static_map<KeyT, ValueT, TagT, RuntimeMapT>::runtime_map_t static_map<KeyT, ValueT, TagT, RuntimeMapT>::runtime_map;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+std::vector<typename static_map<KeyT, ValueT, TagT, RuntimeMapT>::clock_slot> static_map<KeyT, ValueT, TagT, RuntimeMapT>::clock_ring;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+std::vector<std::size_t> static_map<KeyT, ValueT, TagT, RuntimeMapT>::clock_free;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+std::size_t static_map<KeyT, ValueT, TagT, RuntimeMapT>::clock_hand = 0;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+template<typename>
+alignas(ValueT) char static_map<KeyT, ValueT, TagT, RuntimeMapT>::storage[sizeof(ValueT)];
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+template<typename>
+bool static_map<KeyT, ValueT, TagT, RuntimeMapT>::init_flag = false;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
 template<typename>
-alignas(ValueT) char static_map<KeyT, ValueT, TagT>::storage[sizeof(ValueT)];
+detail::value_slot<ValueT, detail::slot_alignment<TagT, ValueT>> static_map<KeyT, ValueT, TagT, RuntimeMapT>::slot;
+
+// thread-safe variant of static_map: a compile-time key costs one acquire load of a pointer
+// which is set once, run-time keys are looked up in one of several shards each guarded by a
+// reader-writer lock. Values are never moved, so references stay valid until the key is
+// erased; erase and clear must not race with the use of such references.
+template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, true>>
+class concurrent_static_map
+{
+public:
+  static constexpr std::size_t shard_count = 16;
+
+  concurrent_static_map() = delete;
+
+  template<typename IdentifierT, typename... ArgTs>
+  requires std::is_invocable_v<IdentifierT> && std::is_convertible_v<detail::identifier_t<IdentifierT>, KeyT>
+  static ValueT &get(IdentifierT a_id, ArgTs &&... a_args)
+  {
+    using UniqueTypeForKeyValue = decltype(detail::idval2type(a_id));
+
+    auto &l_slot = slot<UniqueTypeForKeyValue>;
+    auto *value = l_slot.load(std::memory_order_acquire);
+
+    if (semi_branch_expect(value != nullptr, true)) return *value;
+
+    return get_slow(KeyT(a_id()), l_slot, std::forward<ArgTs>(a_args)...);
+  }
+
+  template<typename... ArgTs>
+  static ValueT &get(const KeyT &a_key, ArgTs &&... a_args)
+  {
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
+  }
+
+  template<typename KeyLikeT, typename... ArgTs>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static ValueT &get(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
+  }
+
+  template<typename IdentifierT>
+  requires std::is_invocable_v<IdentifierT>
+  static bool contains(IdentifierT a_id)
+  {
+    using UniqueTypeForKeyValue = decltype(detail::idval2type(a_id));
+
+    if (semi_branch_expect(slot<UniqueTypeForKeyValue>.load(std::memory_order_acquire) != nullptr, true)) return true;
+
+    return contains(a_id());
+  }
+
+  static bool contains(const KeyT &a_key)
+  {
+    return contains_runtime(a_key);
+  }
+
+  template<typename KeyLikeT>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static bool contains(const KeyLikeT &a_key)
+  {
+    return contains_runtime(a_key);
+  }
+
+  template<typename Identifier>
+  requires std::is_invocable_v<Identifier>
+  static void erase(Identifier identifier)
+  {
+    erase(identifier());
+  }
+
+  static void erase(const KeyT &a_key)
+  {
+    erase_runtime(a_key);
+  }
+
+  template<typename KeyLikeT>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static void erase(const KeyLikeT &a_key)
+  {
+    erase_runtime(a_key);
+  }
+
+  static void clear()
+  {
+    for (auto &l_shard : shards) {
+      std::unique_lock lock(l_shard.mutex);
+      for (auto &pair : l_shard.entries) reset_slots(pair.second);
+      l_shard.entries.clear();
+    }
+  }
+
+private:
+  // the slots caching the value, one per distinct identifier type naming the key
+  struct entry
+  {
+    std::unique_ptr<ValueT> value;
+    std::vector<std::atomic<ValueT *> *> slots;
+  };
+
+  // aligned to keep the locks of neighbouring shards off the same cache line
+  struct alignas(detail::cache_line_size) shard
+  {
+    std::shared_mutex mutex;
+    std::unordered_map<KeyT, entry, detail::key_hash<KeyT>, detail::key_equal<KeyT>> entries;
+  };
+
+  template<typename KeyLikeT, typename... ArgTs>
+  static ValueT &get_runtime(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    auto &l_shard = shard_of(a_key);
+
+    {
+      std::shared_lock lock(l_shard.mutex);
+      auto it = l_shard.entries.find(a_key);
+      if (it != l_shard.entries.end()) return *it->second.value;
+    }
+
+    std::unique_lock lock(l_shard.mutex);
+    return *emplace(l_shard, a_key, std::forward<ArgTs>(a_args)...).value;
+  }
+
+  template<typename KeyLikeT>
+  static bool contains_runtime(const KeyLikeT &a_key)
+  {
+    auto &l_shard = shard_of(a_key);
+    std::shared_lock lock(l_shard.mutex);
+    return (l_shard.entries.find(a_key) != l_shard.entries.end());
+  }
+
+  template<typename KeyLikeT>
+  static void erase_runtime(const KeyLikeT &a_key)
+  {
+    auto &l_shard = shard_of(a_key);
+    std::unique_lock lock(l_shard.mutex);
+    auto it = l_shard.entries.find(a_key);
+
+    if (it != l_shard.entries.end()) {
+      reset_slots(it->second);
+      l_shard.entries.erase(it);
+    }
+  }
+
+  template<typename... ArgTs>
+  static ValueT &get_slow(const KeyT &a_key, std::atomic<ValueT *> &a_slot, ArgTs &&... a_args)
+  {
+    auto &l_shard = shard_of(a_key);
+    std::unique_lock lock(l_shard.mutex);
+
+    // another thread may have won the race for the lock
+    if (auto *value = a_slot.load(std::memory_order_relaxed)) return *value;
+
+    auto &l_entry = emplace(l_shard, a_key, std::forward<ArgTs>(a_args)...);
+    l_entry.slots.push_back(&a_slot);
+    a_slot.store(l_entry.value.get(), std::memory_order_release);
+
+    return *l_entry.value;
+  }
+
+  // requires the shard to be locked exclusively
+  template<typename KeyLikeT, typename... ArgTs>
+  static entry &emplace(shard &a_shard, const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    auto it = a_shard.entries.find(a_key);
+    if (it != a_shard.entries.end()) return it->second;
+
+    auto value = std::make_unique<ValueT>(std::forward<ArgTs>(a_args)...);
+    return a_shard.entries.emplace_hint(it, KeyT(a_key), entry{std::move(value), {}})->second;
+  }
+
+  static void reset_slots(entry &a_entry)
+  {
+    for (auto *l_slot : a_entry.slots) l_slot->store(nullptr, std::memory_order_release);
+  }
+
+  template<typename KeyLikeT>
+  static shard &shard_of(const KeyLikeT &a_key)
+  {
+    return shards[detail::key_hash<KeyT>{}(a_key) % shard_count];
+  }
+
+  template<typename>
+  static std::atomic<ValueT *> slot;
+
+  static std::array<shard, shard_count> shards;
+};
+
+template<typename KeyT, typename ValueT, typename TagT>
+std::array<typename concurrent_static_map<KeyT, ValueT, TagT>::shard, concurrent_static_map<KeyT, ValueT, TagT>::shard_count>
+    concurrent_static_map<KeyT, ValueT, TagT>::shards;
 
 template<typename KeyT, typename ValueT, typename TagT>
 template<typename>
-bool static_map<KeyT, ValueT, TagT>::init_flag = false;
+std::atomic<ValueT *> concurrent_static_map<KeyT, ValueT, TagT>::slot{nullptr};
+
+// static_map whose values are per thread, for counters and other accumulators updated from many
+// workers: each thread gets its own value of each key, a compile-time key costs one load of a
+// thread-local pointer after its first lookup in the thread, and an update is a plain one, with
+// no atomics nor shared cache lines. collect() and merge() fold the values of all threads by
+// MergeT, those of exited threads included, and clear() resets them; they must not race with
+// updates, e.g. are called once the workers are joined.
+//
+//   using counters = semi::sharded_static_map<std::string, uint64_t, Tag>;
+//   counters::get(ID("links_read"))++;              // from any thread
+//   auto links_read = counters::merge(ID("links_read"));
+template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, true>,
+         typename MergeT = std::plus<>>
+class sharded_static_map
+{
+public:
+  sharded_static_map() = delete;
 
-template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, false>>
+  template<typename IdentifierT, typename... ArgTs>
+  requires std::is_invocable_v<IdentifierT> && std::is_convertible_v<detail::identifier_t<IdentifierT>, KeyT>
+  static ValueT &get(IdentifierT a_id, ArgTs &&... a_args)
+  {
+    using UniqueTypeForKeyValue = decltype(detail::idval2type(a_id));
+
+    auto *&l_slot = slot<UniqueTypeForKeyValue>;
+    if (semi_branch_expect(l_slot != nullptr, true)) return *l_slot;
+
+    l_slot = &get_runtime(KeyT(a_id()), std::forward<ArgTs>(a_args)...);
+    return *l_slot;
+  }
+
+  template<typename... ArgTs>
+  static ValueT &get(const KeyT &a_key, ArgTs &&... a_args)
+  {
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
+  }
+
+  template<typename KeyLikeT, typename... ArgTs>
+  requires detail::transparent_key<KeyT, KeyLikeT>
+  static ValueT &get(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    return get_runtime(a_key, std::forward<ArgTs>(a_args)...);
+  }
+
+  // the values of the key in all threads folded together, ValueT() if none has it
+  template<typename IdentifierT>
+  requires std::is_invocable_v<IdentifierT>
+  static ValueT merge(IdentifierT a_id)
+  {
+    return merge(KeyT(a_id()));
+  }
+
+  static ValueT merge(const KeyT &a_key)
+  {
+    std::optional<ValueT> merged;
+    auto fold = [&](const ValueT &a_value) {
+      merged = merged ? MergeT{}(std::move(*merged), a_value) : a_value;
+    };
+
+    std::lock_guard lock(registry_mutex);
+    if (auto it = retired.find(a_key); it != retired.end()) fold(it->second);
+    for (auto *l_shard : shards) {
+      std::lock_guard shard_lock(l_shard->mutex);
+      if (auto it = l_shard->entries.find(a_key); it != l_shard->entries.end()) fold(*it->second);
+    }
+
+    return merged ? std::move(*merged) : ValueT();
+  }
+
+  // the merged value of each key, see merge(), into a flat array of pairs by default, or e.g. a
+  // std::map ordered by key, as snapshot() of static_map
+  template<typename ContainerT = std::vector<std::pair<KeyT, ValueT>>>
+  static ContainerT collect()
+  {
+    std::unordered_map<KeyT, ValueT, detail::key_hash<KeyT>, detail::key_equal<KeyT>> merged;
+    {
+      std::lock_guard lock(registry_mutex);
+      merged = retired;
+      for (auto *l_shard : shards) {
+        std::lock_guard shard_lock(l_shard->mutex);
+        for (auto &pair : l_shard->entries) fold_into(merged, pair.first, *pair.second);
+      }
+    }
+
+    ContainerT entries;
+    if constexpr (requires { entries.reserve(merged.size()); }) entries.reserve(merged.size());
+    for (auto &pair : merged) detail::add_entry(entries, pair.first, pair.second);
+    return entries;
+  }
+
+  // resets the values of all threads to ValueT(), keeping the keys, so that the references
+  // held by the threads stay valid
+  static void clear()
+  {
+    std::lock_guard lock(registry_mutex);
+    retired.clear();
+    for (auto *l_shard : shards) {
+      std::lock_guard shard_lock(l_shard->mutex);
+      for (auto &pair : l_shard->entries) *pair.second = ValueT();
+    }
+  }
+
+private:
+  // the values of one thread, registered for the lifetime of the thread
+  struct shard
+  {
+    shard()
+    {
+      std::lock_guard lock(registry_mutex);
+      shards.push_back(this);
+    }
+
+    // the values of an exiting thread are folded into those of the threads before it
+    ~shard()
+    {
+      std::lock_guard lock(registry_mutex);
+      shards.erase(std::find(shards.begin(), shards.end(), this));
+      for (auto &pair : entries) fold_into(retired, pair.first, *pair.second);
+    }
+
+    shard(const shard &) = delete;
+    shard &operator=(const shard &) = delete;
+
+    // guards the entries against the collecting thread only, the owning thread reads them
+    // without it
+    std::mutex mutex;
+    std::unordered_map<KeyT, std::unique_ptr<ValueT>, detail::key_hash<KeyT>, detail::key_equal<KeyT>> entries;
+  };
+
+  template<typename KeyLikeT, typename... ArgTs>
+  static ValueT &get_runtime(const KeyLikeT &a_key, ArgTs &&... a_args)
+  {
+    auto &l_shard = local_shard;
+    auto it = l_shard.entries.find(a_key);
+    if (it != l_shard.entries.end()) return *it->second;
+
+    auto value = std::make_unique<ValueT>(std::forward<ArgTs>(a_args)...);
+    std::lock_guard lock(l_shard.mutex);
+    return *l_shard.entries.emplace_hint(it, KeyT(a_key), std::move(value))->second;
+  }
+
+  template<typename MapT>
+  static void fold_into(MapT &a_merged, const KeyT &a_key, const ValueT &a_value)
+  {
+    auto it = a_merged.find(a_key);
+    if (it == a_merged.end())
+      a_merged.emplace(a_key, a_value);
+    else
+      it->second = MergeT{}(std::move(it->second), a_value);
+  }
+
+  template<typename>
+  static thread_local ValueT *slot;
+
+  static thread_local shard local_shard;
+
+  static std::mutex registry_mutex;
+  static std::vector<shard *> shards;
+  static std::unordered_map<KeyT, ValueT, detail::key_hash<KeyT>, detail::key_equal<KeyT>> retired;
+};
+
+template<typename KeyT, typename ValueT, typename TagT, typename MergeT>
+template<typename>
+thread_local ValueT *sharded_static_map<KeyT, ValueT, TagT, MergeT>::slot = nullptr;
+
+template<typename KeyT, typename ValueT, typename TagT, typename MergeT>
+thread_local typename sharded_static_map<KeyT, ValueT, TagT, MergeT>::shard sharded_static_map<KeyT, ValueT, TagT, MergeT>::local_shard;
+
+template<typename KeyT, typename ValueT, typename TagT, typename MergeT>
+std::mutex sharded_static_map<KeyT, ValueT, TagT, MergeT>::registry_mutex;
+
+template<typename KeyT, typename ValueT, typename TagT, typename MergeT>
+std::vector<typename sharded_static_map<KeyT, ValueT, TagT, MergeT>::shard *> sharded_static_map<KeyT, ValueT, TagT, MergeT>::shards;
+
+template<typename KeyT, typename ValueT, typename TagT, typename MergeT>
+std::unordered_map<KeyT, ValueT, detail::key_hash<KeyT>, detail::key_equal<KeyT>> sharded_static_map<KeyT, ValueT, TagT, MergeT>::retired;
+
+template<typename KeyT, typename ValueT, typename TagT = detail::default_tag<KeyT, ValueT, false>,
+         template<typename...> class RuntimeMapT = std::unordered_map>
 class map
 {
 public:
+  map() : slot_(acquire_slot())
+  {
+  }
+
+  // a copy is a new, empty map, as the contents belong to the instance
+  map(const map &) : map()
+  {
+  }
+
+  map &operator=(const map &)
+  {
+    return *this;
+  }
+
   ~map()
   {
     clear();
+    free_slots.push_back(slot_);
   }
 
   template<typename IdentifierT, typename... ArgTs>
   ValueT &get(IdentifierT a_key, ArgTs &... a_args)
   {
-    return staticmap::get(a_key).get(this, std::forward<ArgTs>(a_args)...);
+    auto &store = staticmap::get(a_key);
+    if (!store.contains(slot_)) track(key_of(a_key));
+    return store.get(slot_, std::forward<ArgTs>(a_args)...);
   }
 
   template<typename IdentifierT>
   bool contains(IdentifierT a_key)
   {
-    return staticmap::contains(a_key) && staticmap::get(a_key).contains(this);
+    return staticmap::contains(a_key) && staticmap::get(a_key).contains(slot_);
   }
 
   template<typename IdentifierT>
@@ -290,33 +1343,318 @@ public:
   {
     if (staticmap::contains(a_key)) {
       auto &map = staticmap::get(a_key);
-      map.erase(this);
+      if (map.contains(slot_)) untrack(key_of(a_key));
+      map.erase(slot_);
       if (map.size() == 0) staticmap::erase(a_key);
     }
   }
 
+  // visits the keys of this instance only, not those of all instances
   void clear()
   {
-    auto it = staticmap::runtime_map.begin();
+    for (auto &key : keys_) {
+      auto it = staticmap::runtime_map.find(key);
+      if (it == staticmap::runtime_map.end()) continue;
 
-    while (it != staticmap::runtime_map.end()) {
       auto &map = *it->second;
-      map.erase(this);
+      map.erase(slot_);
+      if (map.size() == 0) staticmap::erase_entry(it);
+    }
+
+    keys_.clear();
+    compacted_size_ = 0;
+  }
+
+  std::size_t size() const
+  {
+    if constexpr (detail::is_clock_cache<TagT>) compact();
+    return keys_.size();
+  }
+
+  // visits the keys of this instance only, in no particular order
+  template<typename VisitorT>
+  void for_each(VisitorT &&a_visitor)
+  {
+    if constexpr (detail::is_clock_cache<TagT>) compact();
+
+    for (auto &key : keys_) {
+      auto it = staticmap::runtime_map.find(key);
+      if (it == staticmap::runtime_map.end()) continue;
+      if (auto *value = it->second->find(slot_)) a_visitor(it->first, *value);
+    }
+  }
+
+  template<typename ContainerT = std::vector<std::pair<KeyT, ValueT>>>
+  ContainerT snapshot()
+  {
+    ContainerT entries;
+    for_each([&](const KeyT &a_key, const ValueT &a_value) { detail::add_entry(entries, a_key, a_value); });
+    return entries;
+  }
 
-      if (map.size() == 0) {
-        it = staticmap::runtime_map.erase(staticmap::runtime_map.find(it->first));
-        continue;
+  template<typename ContainerT>
+  void restore(const ContainerT &a_entries)
+  {
+    for (const auto &[key, value] : a_entries) get(key) = value;
+  }
+
+private:
+  using staticmap = static_map<KeyT, detail::indexed_store<ValueT>, TagT, RuntimeMapT>;
+
+  template<typename IdentifierT>
+  static KeyT key_of(const IdentifierT &a_key)
+  {
+    if constexpr (std::is_invocable_v<IdentifierT>)
+      return KeyT(a_key());
+    else
+      return KeyT(a_key);
+  }
+
+  void track(KeyT a_key)
+  {
+    keys_.push_back(std::move(a_key));
+
+    // keys evicted by a clock_cache are only noticed here, once the list has doubled
+    if constexpr (detail::is_clock_cache<TagT>) {
+      if (keys_.size() > 2 * compacted_size_ + 16) {
+        compact();
+        compacted_size_ = keys_.size();
       }
+    }
+  }
+
+  void untrack(const KeyT &a_key)
+  {
+    auto it = std::find(keys_.begin(), keys_.end(), a_key);
+    if (it == keys_.end()) return;
+
+    *it = std::move(keys_.back());
+    keys_.pop_back();
+  }
+
+  // drops the keys of this instance which a clock_cache evicted, and the copies of those added
+  // back since
+  void compact() const
+  {
+    std::unordered_set<KeyT, detail::key_hash<KeyT>, detail::key_equal<KeyT>> live;
+    std::erase_if(keys_, [&](const KeyT &a_key) {
+      auto it = staticmap::runtime_map.find(a_key);
+      return it == staticmap::runtime_map.end() || !it->second->contains(slot_) || !live.insert(a_key).second;
+    });
+  }
+
+  // slot ids are kept dense by reusing those of destroyed instances
+  static std::size_t acquire_slot()
+  {
+    if (free_slots.empty()) return slot_count++;
+
+    auto slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  }
 
-      ++it;
+  static std::vector<std::size_t> free_slots;
+  static std::size_t slot_count;
+
+  std::size_t slot_;
+
+  // the keys this instance has values of, so that clearing it is proportional to them only;
+  // mutable as size() drops those evicted by a clock_cache
+  mutable std::vector<KeyT> keys_;
+  std::size_t compacted_size_ = 0;
+};
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+std::vector<std::size_t> map<KeyT, ValueT, TagT, RuntimeMapT>::free_slots;
+
+template<typename KeyT, typename ValueT, typename TagT, template<typename...> class RuntimeMapT>
+std::size_t map<KeyT, ValueT, TagT, RuntimeMapT>::slot_count = 0;
+
+// minimal perfect hash of a set of string keys, built at compile time in the manner of CHD:
+// the keys are split into buckets by one hash, and the keys of each bucket, the largest bucket
+// first, are placed by a second hash seeded per bucket. A lookup is then two hashes, an index
+// into the seeds and a single key comparison.
+template<std::size_t N>
+class perfect_hash
+{
+public:
+  static_assert(N > 0, "a perfect hash needs at least one key");
+
+  static constexpr std::size_t bucket_count = (N + 1) / 2;
+
+  constexpr perfect_hash(const char *const (&a_keys)[N])
+  {
+    std::array<std::string_view, N> keys{};
+    for (std::size_t i = 0; i < N; ++i) keys[i] = a_keys[i];
+    build(keys);
+  }
+
+  constexpr perfect_hash(const std::array<std::string_view, N> &a_keys)
+  {
+    build(a_keys);
+  }
+
+  static constexpr std::size_t size()
+  {
+    return N;
+  }
+
+  // the slot of the given key, or size() if it is not one of the keys
+  constexpr std::size_t index_of(std::string_view a_key) const
+  {
+    auto slot = slot_of(a_key, seeds_[hash(a_key, 0) % bucket_count]);
+    return keys_[slot] == a_key ? slot : N;
+  }
+
+  constexpr std::string_view key(std::size_t a_slot) const
+  {
+    return keys_[a_slot];
+  }
+
+private:
+  static constexpr std::uint64_t hash(std::string_view a_key, std::uint64_t a_seed)
+  {
+    auto hash = 0xcbf29ce484222325ull ^ (a_seed * 0x9E3779B97F4A7C15ull);
+
+    for (auto c : a_key) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 0x100000001b3ull;
     }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+  }
+
+  static constexpr std::size_t slot_of(std::string_view a_key, std::uint32_t a_seed)
+  {
+    return static_cast<std::size_t>(hash(a_key, a_seed + 1ull) % N);
+  }
+
+  constexpr void build(const std::array<std::string_view, N> &a_keys)
+  {
+    std::array<std::size_t, N> bucket_of{};
+    std::array<std::size_t, bucket_count> bucket_size{};
+
+    for (std::size_t i = 0; i < N; ++i) {
+      for (std::size_t j = 0; j < i; ++j)
+        if (a_keys[i] == a_keys[j]) throw "perfect_hash keys must be unique";
+
+      bucket_of[i] = hash(a_keys[i], 0) % bucket_count;
+      ++bucket_size[bucket_of[i]];
+    }
+
+    std::array<std::size_t, bucket_count> order{};
+    for (std::size_t b = 0; b < bucket_count; ++b) order[b] = b;
+    std::sort(order.begin(), order.end(), [&](auto a, auto b) { return bucket_size[a] > bucket_size[b]; });
+
+    std::array<bool, N> is_taken{};
+    std::array<std::size_t, N> slots{};
+
+    for (auto bucket : order) {
+      if (bucket_size[bucket] == 0) break;
+
+      for (std::uint32_t seed = 0;; ++seed) {
+        if (seed == max_seed) throw "perfect_hash found no seed for a bucket";
+
+        auto is_placed = true;
+        std::size_t placed = 0;
+
+        for (std::size_t i = 0; i < N && is_placed; ++i) {
+          if (bucket_of[i] != bucket) continue;
+
+          auto slot = slot_of(a_keys[i], seed);
+          if (is_taken[slot]) {
+            is_placed = false;
+          } else {
+            is_taken[slot] = true;
+            slots[placed++] = slot;
+          }
+        }
+
+        if (is_placed) {
+          seeds_[bucket] = seed;
+          break;
+        }
+
+        for (std::size_t i = 0; i < placed; ++i) is_taken[slots[i]] = false;
+      }
+    }
+
+    for (std::size_t i = 0; i < N; ++i) keys_[slot_of(a_keys[i], seeds_[bucket_of[i]])] = a_keys[i];
+  }
+
+  static constexpr std::uint32_t max_seed = 1u << 20;
+
+  std::array<std::uint32_t, bucket_count> seeds_{};
+  std::array<std::string_view, N> keys_{};
+};
+
+template<std::size_t N>
+perfect_hash(const char *const (&)[N]) -> perfect_hash<N>;
+
+// map over the fixed key set of a perfect_hash, e.g. the column names of a schema. The values
+// live in a flat array: a constant key resolves to its index at compile time, and a run-time
+// key costs one perfect_hash probe.
+//
+//   static constexpr semi::perfect_hash columns{{"id", "speed", "length"}};
+//   semi::perfect_map<double, columns> row;
+//   row.get(ID("speed")) = 55.0;
+//   if (auto *value = row.find(name)) ...
+template<typename ValueT, const auto &Keys>
+class perfect_map
+{
+public:
+  template<typename IdentifierT>
+  requires std::is_invocable_v<IdentifierT>
+  ValueT &get(IdentifierT a_id)
+  {
+    constexpr auto index = Keys.index_of(a_id());
+    static_assert(index < size(), "key is not in the key set of the perfect_map");
+    return values_[index];
+  }
+
+  template<typename IdentifierT>
+  requires std::is_invocable_v<IdentifierT>
+  const ValueT &get(IdentifierT a_id) const
+  {
+    return const_cast<perfect_map *>(this)->get(a_id);
+  }
+
+  ValueT *find(std::string_view a_key)
+  {
+    auto index = Keys.index_of(a_key);
+    return semi_branch_expect(index < size(), true) ? &values_[index] : nullptr;
+  }
+
+  const ValueT *find(std::string_view a_key) const
+  {
+    return const_cast<perfect_map *>(this)->find(a_key);
+  }
+
+  static constexpr bool contains(std::string_view a_key)
+  {
+    return Keys.index_of(a_key) < size();
+  }
+
+  static constexpr std::size_t size()
+  {
+    return Keys.size();
+  }
+
+  // visits the key and value pairs in slot order
+  template<typename VisitorT>
+  void for_each(VisitorT &&a_visitor)
+  {
+    for (std::size_t i = 0; i < size(); ++i) a_visitor(Keys.key(i), values_[i]);
   }
 
 private:
-  using staticmap = static_map<KeyT, detail::flat_map<map<KeyT, ValueT> *, ValueT>, TagT>;
+  std::array<ValueT, Keys.size()> values_{};
 };
 
 #undef semi_branch_expect
+#undef SEMI_HAS_SSE2
 
 } // namespace semi
 
@@ -7,6 +7,14 @@
 #include <doctest/doctest.h>
 #include <semimap/semimap.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
 #define ID(x) \
     []() constexpr { return x; }
 
@@ -429,4 +437,640 @@ TEST_CASE("map") // NOLINT(cert-err58-cpp)
     CHECK(!mapB.contains("food"));
     CHECK(!mapB.contains(ID("drink")));
   }
+  SUBCASE("test many instances and reused slots") {
+    std::vector<semi::map<std::string, int>> maps(1000);
+
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+      maps[i].get(ID("id")) = static_cast<int>(i);
+      maps[i].get(std::to_string(i % 10)) = static_cast<int>(i);
+    }
+
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+      CHECK(maps[i].get(ID("id")) == static_cast<int>(i));
+      CHECK(maps[i].get(std::to_string(i % 10)) == static_cast<int>(i));
+      CHECK(!maps[i].contains(std::to_string((i + 1) % 10)));
+    }
+
+    maps.clear();
+
+    // a new instance may get the slot of a destroyed one, but none of its values
+    semi::map<std::string, int> map;
+    CHECK(!map.contains(ID("id")));
+    CHECK(!map.contains("0"));
+    map.get(ID("id")) = 42;
+
+    semi::map<std::string, int> copy(map);
+    CHECK(!copy.contains(ID("id")));
+    CHECK(map.get(ID("id")) == 42);
+  }
+  SUBCASE("test clearing short-lived instances among many keys") {
+    struct Tag
+    {
+    };
+
+    semi::map<int, int, Tag> network;
+    for (int link = 0; link < 10000; ++link) network.get(link) = link;
+
+    for (int vehicle = 0; vehicle < 1000; ++vehicle) {
+      semi::map<int, int, Tag> route;
+      route.get(vehicle % 50) = vehicle;
+      route.get(20000 + vehicle) = vehicle;
+      route.get(vehicle % 50) += 1;
+      CHECK(route.size() == 2);
+      if (vehicle % 2 == 0) route.erase(20000 + vehicle);
+    }
+
+    // only the keys of the destroyed instances went, with those no other instance had
+    CHECK(network.size() == 10000);
+    CHECK(network.get(49) == 49);
+    CHECK(semi::static_map<int, semi::detail::indexed_store<int>, Tag>::size() == 10000);
+
+    int visited = 0;
+    network.for_each([&](int a_key, int a_value) { visited += (a_key == a_value); });
+    CHECK(visited == 10000);
+  }
+
+  SUBCASE("test packed and padded layouts") {
+    struct PackedTag : semi::packed_layout
+    {
+    };
+
+    struct PaddedTag : semi::padded_layout
+    {
+    };
+
+    using packed = semi::static_map<std::string, int, PackedTag>;
+    using padded = semi::static_map<std::string, int, PaddedTag>;
+
+    packed::get(ID("a")) = 1;
+    packed::get("b") = 2;
+    CHECK(packed::get("a") == 1);
+    CHECK(packed::get(ID("b")) == 2);
+    packed::erase(ID("a"));
+    CHECK(!packed::contains(ID("a")));
+
+    auto &first = padded::get(ID("first"));
+    auto &second = padded::get(ID("second"));
+    first = 1;
+    second = 2;
+    CHECK(padded::get("first") == 1);
+    CHECK(padded::get("second") == 2);
+
+    auto line_of = [](const int &a_value) { return reinterpret_cast<std::uintptr_t>(&a_value) / semi::detail::cache_line_size; };
+    CHECK(reinterpret_cast<std::uintptr_t>(&first) % semi::detail::cache_line_size == 0);
+    CHECK(line_of(first) != line_of(second));
+
+    padded::clear();
+    CHECK(!padded::contains(ID("first")));
+  }
+
+  SUBCASE("test clock cache of run-time keys") {
+    struct Tag : semi::clock_cache<4>
+    {
+    };
+
+    using cache = semi::static_map<std::string, int, Tag>;
+
+    for (auto key : {"a", "b", "c", "d"}) cache::get(key) = 1;
+    cache::get(ID("pinned")) = 42;
+    CHECK(cache::size() == 5);
+
+    // the hand skips the keys looked up since, clearing their bits, and evicts c then d
+    cache::get("a");
+    cache::get("b");
+    cache::get("e");
+    CHECK(!cache::contains("c"));
+    cache::get("f");
+    CHECK(!cache::contains("d"));
+    cache::get("g");
+    CHECK(!cache::contains("a"));
+    CHECK(cache::contains("b"));
+    CHECK(cache::size() == 5);
+    CHECK(cache::get(ID("pinned")) == 42);
+
+    // erased keys and those taken over by a compile-time key leave room without evicting
+    cache::erase("b");
+    cache::get(ID("e"));
+    cache::get("h");
+    cache::get("i");
+    CHECK(cache::contains("f"));
+    CHECK(cache::contains("g"));
+    CHECK(cache::contains(ID("e")));
+    CHECK(cache::size() == 6);
+
+    cache::get("j");
+    CHECK(cache::size() == 6);
+    CHECK(cache::contains(ID("e")));
+
+    cache::clear();
+    for (int i = 0; i < 4; ++i) cache::get(std::to_string(i)) = i;
+    CHECK(cache::size() == 4);
+  }
+
+  SUBCASE("test clock cache of map values") {
+    struct Tag : semi::clock_cache<8>
+    {
+    };
+
+    semi::map<int, double, Tag> costs;
+    semi::map<int, double, Tag> other;
+
+    for (int od = 0; od < 100; ++od) costs.get(od) = od * 1.5;
+    CHECK(costs.size() == 8);
+    CHECK(costs.get(99) == 99 * 1.5);
+
+    other.get(99) = 1.0;
+    costs.clear();
+    CHECK(costs.size() == 0);
+    CHECK(other.get(99) == 1.0);
+
+    for (int od = 0; od < 8; ++od) costs.get(od) = od;
+    CHECK(costs.size() == 7);
+
+    // the keys evicted and added back many times are counted once
+    for (int round = 0; round < 50; ++round)
+      for (int od = 0; od < 10; ++od) costs.get(od) = round;
+    CHECK(costs.size() <= 8);
+    int visited = 0;
+    costs.for_each([&](int, double) { ++visited; });
+    CHECK(visited == costs.size());
+  }
+}
+
+TEST_CASE("concurrent_static_map") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test compile-time and run-time load and store") {
+    struct Tag
+    {
+    };
+
+    using map = semi::concurrent_static_map<std::string, std::string, Tag>;
+
+    map::get(ID("food")) = "pizza";
+    CHECK(map::get("food") == "pizza");
+
+    map::get("drink") = "beer";
+    CHECK(map::get(ID("drink")) == "beer");
+
+    CHECK(map::get(ID("starter"), "soup") == "soup");
+    CHECK(map::get("starter", "salad") == "soup");
+
+    // the same key through an identifier of another type
+    CHECK(map::get(ID("food")) == map::get(ID(static_cast<const char *>("food"))));
+  }
+
+  SUBCASE("test clear, erase and contains") {
+    struct Tag
+    {
+    };
+
+    using map = semi::concurrent_static_map<std::string, std::string, Tag>;
+
+    CHECK(!map::contains(ID("food")));
+    CHECK(!map::contains("food"));
+
+    map::get(ID("food")) = "pizza";
+    map::get("drink") = "beer";
+    CHECK(map::contains(ID("food")));
+    CHECK(map::contains("food"));
+    CHECK(map::contains(ID("drink")));
+
+    map::erase("food");
+    CHECK(!map::contains(ID("food")));
+    CHECK(map::get(ID("food"), "pasta") == "pasta");
+
+    map::clear();
+    CHECK(!map::contains(ID("food")));
+    CHECK(!map::contains("drink"));
+    CHECK(!map::contains(ID("drink")));
+  }
+
+  SUBCASE("test lookups from several threads") {
+    struct Tag
+    {
+    };
+
+    using map = semi::concurrent_static_map<std::string, std::atomic<int>, Tag>;
+
+    constexpr int thread_count = 8;
+    constexpr int iterations = 10000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([] {
+        for (int i = 0; i < iterations; ++i) {
+          map::get(ID("hits"))++;
+          map::get(std::to_string(i % 32))++;
+        }
+      });
+    }
+
+    for (auto &thread : threads) thread.join();
+
+    CHECK(map::get(ID("hits")) == thread_count * iterations);
+    CHECK(map::get("hits") == thread_count * iterations);
+
+    int total = 0;
+    for (int i = 0; i < 32; ++i) total += map::get(std::to_string(i));
+    CHECK(total == thread_count * iterations);
+  }
+}
+
+TEST_CASE("sharded_static_map") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test compile-time and run-time load and store") {
+    struct Tag
+    {
+    };
+
+    using map = semi::sharded_static_map<std::string, std::uint64_t, Tag>;
+
+    map::get(ID("links_read")) += 2;
+    CHECK(map::get("links_read") == 2);
+
+    map::get("trips_read") = 5;
+    CHECK(map::get(ID("trips_read")) == 5);
+
+    CHECK(map::get(ID("lanes_read"), 7u) == 7);
+    CHECK(map::get(std::string_view("lanes_read"), 9u) == 7);
+
+    CHECK(map::merge(ID("links_read")) == 2);
+    CHECK(map::merge("unknown") == 0);
+  }
+
+  SUBCASE("test merging the values of several threads") {
+    struct Tag
+    {
+    };
+
+    using map = semi::sharded_static_map<std::string, std::uint64_t, Tag>;
+
+    constexpr int thread_count = 8;
+    constexpr int iterations = 10000;
+
+    // the main thread keeps its values, the others fold theirs in as they exit
+    map::get(ID("hits")) = 1;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([] {
+        for (int i = 0; i < iterations; ++i) {
+          map::get(ID("hits"))++;
+          map::get(std::to_string(i % 32))++;
+        }
+      });
+    }
+
+    for (auto &thread : threads) thread.join();
+
+    CHECK(map::get(ID("hits")) == 1);
+    CHECK(map::merge(ID("hits")) == thread_count * iterations + 1);
+
+    auto counts = map::collect<std::map<std::string, std::uint64_t>>();
+    CHECK(counts.size() == 33);
+    CHECK(counts["hits"] == thread_count * iterations + 1);
+
+    std::uint64_t total = 0;
+    for (int i = 0; i < 32; ++i) total += counts[std::to_string(i)];
+    CHECK(total == thread_count * iterations);
+
+    map::clear();
+    CHECK(map::merge(ID("hits")) == 0);
+    CHECK(map::collect().size() == 1);
+
+    map::get(ID("hits"))++;
+    CHECK(map::merge("hits") == 1);
+  }
+
+  SUBCASE("test merging by another operation") {
+    struct Tag
+    {
+    };
+
+    struct max
+    {
+      int operator()(int a_left, int a_right) const
+      {
+        return std::max(a_left, a_right);
+      }
+    };
+
+    using map = semi::sharded_static_map<std::string, int, Tag, max>;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+      threads.emplace_back([t] { map::get(ID("longest_queue")) = 10 * t; });
+
+    for (auto &thread : threads) thread.join();
+
+    CHECK(map::merge(ID("longest_queue")) == 30);
+  }
+}
+
+TEST_CASE("flat_hash_map") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test against std::unordered_map") {
+    semi::flat_hash_map<int, int> map;
+    std::unordered_map<int, int> reference;
+    std::mt19937 random(42);
+
+    for (int i = 0; i < 20000; ++i) {
+      auto key = static_cast<int>(random() % 2000);
+
+      if (random() % 3 == 0) {
+        CHECK(map.erase(key) == reference.erase(key));
+      } else {
+        auto [it, is_inserted] = map.try_emplace(key, i);
+        auto [reference_it, reference_is_inserted] = reference.try_emplace(key, i);
+        CHECK(is_inserted == reference_is_inserted);
+        CHECK(it->second == reference_it->second);
+      }
+    }
+
+    CHECK(map.size() == reference.size());
+    for (auto &[key, value] : reference) {
+      auto it = map.find(key);
+      REQUIRE(it != map.end());
+      CHECK(it->second == value);
+    }
+
+    std::size_t count = 0;
+    for (auto &pair : map) count += reference.count(pair.first);
+    CHECK(count == reference.size());
+  }
+
+  SUBCASE("test erase while iterating") {
+    semi::flat_hash_map<std::string, int> map;
+    for (int i = 0; i < 100; ++i) map.try_emplace(std::to_string(i), i);
+
+    for (auto it = map.begin(); it != map.end();) {
+      if (it->second % 2 == 0)
+        it = map.erase(it);
+      else
+        ++it;
+    }
+
+    CHECK(map.size() == 50);
+    CHECK(map.find("2") == map.end());
+    CHECK(map.find("3")->second == 3);
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(map.begin() == map.end());
+  }
+
+  SUBCASE("test as the run-time backend of static_map") {
+    struct Tag
+    {
+    };
+
+    using map = semi::static_map<std::string, std::string, Tag, semi::flat_hash_map>;
+
+    map::get(ID("food")) = "pizza";
+    CHECK(map::get("food") == "pizza");
+
+    map::get("drink") = "beer";
+    CHECK(map::get(ID("drink")) == "beer");
+
+    for (int i = 0; i < 100; ++i) map::get(std::to_string(i)) = std::to_string(i);
+    CHECK(map::get(ID("food")) == "pizza");
+    CHECK(map::get("42") == "42");
+
+    map::erase(ID("food"));
+    CHECK(!map::contains(ID("food")));
+    CHECK(map::contains(ID("drink")));
+
+    map::clear();
+    CHECK(!map::contains("drink"));
+  }
+
+  SUBCASE("test as the run-time backend of map") {
+    semi::map<std::string, std::string, semi::detail::default_tag<std::string, std::string, false>, semi::flat_hash_map> mapA;
+    semi::map<std::string, std::string, semi::detail::default_tag<std::string, std::string, false>, semi::flat_hash_map> mapB;
+
+    mapA.get(ID("food")) = "pizza";
+    mapB.get("food") = "spaghetti";
+    mapB.get("drink") = "beer";
+    CHECK(mapA.get("food") == "pizza");
+    CHECK(mapB.get(ID("food")) == "spaghetti");
+
+    mapB.clear();
+    CHECK(mapA.contains(ID("food")));
+    CHECK(!mapB.contains("drink"));
+  }
+}
+
+namespace {
+
+std::size_t allocation_count = 0;
+
+template<typename T>
+struct counting_allocator : std::allocator<T>
+{
+  using value_type = T;
+
+  counting_allocator() = default;
+
+  template<typename U>
+  counting_allocator(const counting_allocator<U> &) noexcept
+  {
+  }
+
+  T *allocate(std::size_t a_count)
+  {
+    ++allocation_count;
+    return std::allocator<T>::allocate(a_count);
+  }
+
+  template<typename U>
+  struct rebind
+  {
+    using other = counting_allocator<U>;
+  };
+};
+
+using counted_string = std::basic_string<char, std::char_traits<char>, counting_allocator<char>>;
+
+}
+
+template<typename MapT>
+void check_lookups_do_not_allocate()
+{
+  // longer than any small string buffer, so every temporary string would allocate
+  constexpr std::string_view key = "a key much too long for the small string buffer";
+
+  MapT::get(key) = 1;
+  CHECK(MapT::get(counted_string(key)) == 1);
+
+  auto count = allocation_count;
+  CHECK(MapT::get(key) == 1);
+  CHECK(MapT::get(key.data()) == 1);
+  CHECK(MapT::contains(key));
+  CHECK(!MapT::contains("another key much too long for the small string buffer"));
+  MapT::erase(key);
+  CHECK(allocation_count == count);
+
+  CHECK(!MapT::contains(key));
+}
+
+TEST_CASE("heterogeneous lookup") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test static_map") {
+    struct Tag
+    {
+    };
+
+    check_lookups_do_not_allocate<semi::static_map<counted_string, int, Tag>>();
+  }
+
+  SUBCASE("test static_map with flat_hash_map") {
+    struct Tag
+    {
+    };
+
+    check_lookups_do_not_allocate<semi::static_map<counted_string, int, Tag, semi::flat_hash_map>>();
+  }
+
+  SUBCASE("test concurrent_static_map") {
+    struct Tag
+    {
+    };
+
+    check_lookups_do_not_allocate<semi::concurrent_static_map<counted_string, int, Tag>>();
+  }
+
+  SUBCASE("test map") {
+    semi::map<std::string, int> map;
+    std::string_view key = "speed";
+
+    map.get(key) = 55;
+    CHECK(map.get("speed") == 55);
+    CHECK(map.contains(key));
+    map.erase(key);
+    CHECK(!map.contains("speed"));
+  }
+}
+
+namespace {
+
+constexpr semi::perfect_hash link_attributes{{"id", "from_node", "to_node", "length", "lanes", "speed", "capacity", "type"}};
+
+static_assert(link_attributes.index_of("length") < link_attributes.size());
+static_assert(link_attributes.key(link_attributes.index_of("speed")) == "speed");
+static_assert(link_attributes.index_of("grade") == link_attributes.size());
+
+}
+
+TEST_CASE("perfect_map") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test every key has its own slot") {
+    std::vector<bool> is_used(link_attributes.size());
+
+    for (auto key : {"id", "from_node", "to_node", "length", "lanes", "speed", "capacity", "type"}) {
+      auto index = link_attributes.index_of(key);
+      REQUIRE(index < link_attributes.size());
+      CHECK(!is_used[index]);
+      is_used[index] = true;
+    }
+
+    CHECK(link_attributes.index_of("") == link_attributes.size());
+    CHECK(link_attributes.index_of("speed_limit") == link_attributes.size());
+  }
+
+  SUBCASE("test compile-time and run-time load and store") {
+    semi::perfect_map<double, link_attributes> link;
+
+    link.get(ID("speed")) = 55.0;
+    link.get(ID("lanes")) = 3;
+
+    REQUIRE(link.find("speed") != nullptr);
+    CHECK(*link.find("speed") == 55.0);
+    CHECK(*link.find(std::string("lanes")) == 3);
+    CHECK(link.find("grade") == nullptr);
+
+    *link.find("length") = 0.25;
+    CHECK(link.get(ID("length")) == 0.25);
+
+    CHECK(link.contains("type"));
+    CHECK(!link.contains("grade"));
+
+    double total = 0;
+    link.for_each([&](std::string_view, double a_value) { total += a_value; });
+    CHECK(total == 58.25);
+  }
+
+  SUBCASE("test a large key set") {
+    static constexpr semi::perfect_hash numbers{{"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13",
+                                                 "14", "15", "16", "17", "18", "19", "20", "21", "22", "23", "24", "25",
+                                                 "26", "27", "28", "29", "30", "31", "32", "33", "34", "35", "36", "37",
+                                                 "38", "39", "40", "41", "42", "43", "44", "45", "46", "47", "48", "49"}};
+
+    for (int i = 0; i < 50; ++i) {
+      auto key = std::to_string(i);
+      auto index = numbers.index_of(key);
+      REQUIRE(index < numbers.size());
+      CHECK(numbers.key(index) == key);
+    }
+
+    CHECK(numbers.index_of("50") == numbers.size());
+  }
+}
+
+TEST_CASE("iteration and snapshots") // NOLINT(cert-err58-cpp)
+{
+  SUBCASE("test static_map") {
+    struct Tag
+    {
+    };
+
+    using map = semi::static_map<std::string, int, Tag>;
+
+    map::get(ID("lanes")) = 3;
+    map::get("speed") = 55;
+    map::get("length") = 2;
+    CHECK(map::size() == 3);
+
+    int total = 0;
+    map::for_each([&](const std::string &, int &a_value) { total += a_value++; });
+    CHECK(total == 60);
+    CHECK(map::get(ID("lanes")) == 4);
+
+    auto flat = map::snapshot();
+    std::sort(flat.begin(), flat.end());
+    CHECK(flat == std::vector<std::pair<std::string, int>>{{"lanes", 4}, {"length", 3}, {"speed", 56}});
+
+    auto ordered = map::snapshot<std::map<std::string, int>>();
+    CHECK(ordered.begin()->first == "lanes");
+
+    map::clear();
+    CHECK(map::size() == 0);
+
+    map::restore(ordered);
+    CHECK(map::get(ID("lanes")) == 4);
+    CHECK(map::get("speed") == 56);
+  }
+
+  SUBCASE("test map") {
+    semi::map<std::string, int> mapA;
+    semi::map<std::string, int> mapB;
+
+    mapA.get(ID("lanes")) = 3;
+    mapA.get("speed") = 55;
+    mapB.get("speed") = 30;
+    CHECK(mapA.size() == 2);
+    CHECK(mapB.size() == 1);
+
+    auto ordered = mapA.snapshot<std::map<std::string, int>>();
+    CHECK(ordered == std::map<std::string, int>{{"lanes", 3}, {"speed", 55}});
+
+    semi::map<std::string, int> copy;
+    copy.restore(mapA.snapshot());
+    CHECK(copy.get(ID("lanes")) == 3);
+    CHECK(copy.get("speed") == 55);
+    CHECK(mapB.get("speed") == 30);
+
+    mapA.clear();
+    CHECK(mapA.size() == 0);
+    CHECK(copy.size() == 2);
+  }
 }
@@ -0,0 +1,150 @@
+#include "test.h"
+#include <bitset>
+
+namespace test_bounded
+{
+
+enum class command : std::uint8_t
+{
+    stop,
+    start,
+    reroute,
+};
+
+struct position
+{
+    float x;
+    float y;
+
+    bool operator==(const position &) const = default;
+};
+
+struct control
+{
+    using serialize = zpp::bits::members<7>;
+
+    command what;
+    std::int32_t link_id;
+    std::array<char, 16> name;
+    std::optional<position> target;
+    std::variant<std::monostate, std::uint16_t, double> argument;
+    std::bitset<12> lanes;
+    zpp::bits::vuint32_t sequence;
+
+    bool operator==(const control &) const = default;
+};
+
+struct route
+{
+    std::string name;
+    std::vector<int> links;
+};
+
+static_assert(zpp::bits::max_serialized_size<int>() == sizeof(int));
+static_assert(zpp::bits::max_serialized_size<position>() == 2 * sizeof(float));
+static_assert(zpp::bits::max_serialized_size<std::array<position, 4>>() ==
+              4 * sizeof(position));
+static_assert(zpp::bits::max_serialized_size<std::optional<int>>() ==
+              1 + sizeof(int));
+static_assert(
+    zpp::bits::max_serialized_size<std::variant<std::uint8_t, double>>() ==
+    1 + sizeof(double));
+static_assert(zpp::bits::max_serialized_size<std::pair<int, char>>() ==
+              sizeof(int) + 1);
+static_assert(zpp::bits::max_serialized_size<std::bitset<12>>() == 2);
+static_assert(zpp::bits::max_serialized_size<zpp::bits::vuint32_t>() == 5);
+static_assert(zpp::bits::max_serialized_size<control>() ==
+              1 + 4 + 16 + (1 + 8) + (1 + 8) + 2 + 5);
+static_assert(zpp::bits::max_serialized_size<const control &, int>() ==
+              zpp::bits::max_serialized_size<control>() + sizeof(int));
+static_assert(
+    std::same_as<zpp::bits::bounded_buffer<control>,
+                 std::array<std::byte,
+                            zpp::bits::max_serialized_size<control>()>>);
+static_assert(zpp::bits::concepts::bounded<control>);
+static_assert(!zpp::bits::concepts::bounded<route>);
+static_assert(!zpp::bits::concepts::bounded<std::string>);
+static_assert(!zpp::bits::concepts::bounded<std::vector<position>>);
+static_assert(!zpp::bits::concepts::bounded<std::unique_ptr<int>>);
+
+TEST(bounded, round_trip)
+{
+    control written{command::reroute,
+                    1337,
+                    {'a', '1'},
+                    position{1.5f, -2.5f},
+                    std::uint16_t{80},
+                    std::bitset<12>{0b1010'0000'0101},
+                    300u};
+
+    zpp::bits::bounded_buffer<control> buffer{};
+    auto out = zpp::bits::bounded_output(buffer);
+    out(written).or_throw();
+
+    // The checked output writes the same bytes into a buffer of the
+    // maximum size, compared as spans of the bytes written.
+    std::array<std::byte, zpp::bits::max_serialized_size<control>()> data{};
+    zpp::bits::out checked_out{std::span{data}};
+    checked_out(written).or_throw();
+    ASSERT_EQ(out.position(), checked_out.position());
+    EXPECT_TRUE(std::ranges::equal(std::span{data}.first(checked_out.position()),
+                                   std::span{buffer}.first(out.position())));
+
+    control read{};
+    auto in = zpp::bits::bounded_input(buffer);
+    in(read).or_throw();
+    EXPECT_EQ(read, written);
+    EXPECT_EQ(in.position(), out.position());
+}
+
+TEST(bounded, empty_alternatives)
+{
+    control written{};
+    zpp::bits::bounded_buffer<control> buffer{};
+    auto out = zpp::bits::bounded_output(buffer);
+    out(written).or_throw();
+    EXPECT_LT(out.position(), buffer.size());
+
+    control read{command::start, 7, {}, position{}, 1.0, {}, 1u};
+    auto in = zpp::bits::bounded_input(buffer);
+    in(read).or_throw();
+    EXPECT_EQ(read, written);
+}
+
+TEST(bounded, checked_once_per_call)
+{
+    zpp::bits::bounded_buffer<control, control> buffer{};
+    auto out = zpp::bits::bounded_output(buffer);
+    control written{};
+    out(written).or_throw();
+    out(written).or_throw();
+
+    // The rest of the buffer may fit a third one, but not its maximum size.
+    EXPECT_EQ(out(written), std::errc::result_out_of_range);
+
+    auto in = zpp::bits::bounded_input(buffer);
+    control read{};
+    in(read).or_throw();
+    in(read).or_throw();
+    EXPECT_EQ(in(read), std::errc::result_out_of_range);
+}
+
+TEST(bounded, constexpr_round_trip)
+{
+    constexpr auto read = [] {
+        zpp::bits::bounded_buffer<position, std::int64_t> buffer{};
+        auto out = zpp::bits::bounded_output(buffer);
+        out(position{3, 4}, std::int64_t{-5}).or_throw();
+
+        position point{};
+        std::int64_t value{};
+        auto in = zpp::bits::bounded_input(buffer);
+        in(point, value).or_throw();
+        return std::pair{point, value};
+    }();
+
+    static_assert(read.first == position{3, 4});
+    static_assert(read.second == -5);
+}
+
+} // namespace test_bounded
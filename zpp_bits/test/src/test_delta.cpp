@@ -0,0 +1,131 @@
+#include "test.h"
+#include "zpp_bits_delta.h"
+
+namespace test_delta
+{
+
+struct vehicle
+{
+    std::int32_t id;
+    double position;
+    std::string route;
+
+    bool operator==(const vehicle &) const = default;
+};
+
+auto bytes(const std::vector<std::byte> & data)
+{
+    return std::span<const std::byte>{data};
+}
+
+TEST(delta, restore_chain)
+{
+    zpp::bits::tracked_objects<vehicle> vehicles;
+    for (int i = 0; i < 1000; ++i) {
+        vehicles.emplace_back(i, i * 1.5, "route " + std::to_string(i));
+    }
+    EXPECT_EQ(vehicles.dirty_count(), 1000u);
+
+    std::vector<std::byte> base;
+    zpp::bits::write_checkpoint(base, vehicles).or_throw();
+    EXPECT_EQ(vehicles.generation(), 1u);
+    EXPECT_EQ(vehicles.dirty_count(), 0u);
+
+    vehicles.modify(3).position = -1;
+    vehicles.modify(700).route = "detour";
+    std::vector<std::byte> first;
+    zpp::bits::write_delta(first, vehicles).or_throw();
+    EXPECT_LT(first.size(), base.size() / 50);
+
+    vehicles.modify(3).position = -2;
+    vehicles.emplace_back(1000, 0.0, "new");
+    std::vector<std::byte> second;
+    zpp::bits::write_delta(second, vehicles).or_throw();
+    EXPECT_EQ(vehicles.generation(), 3u);
+
+    std::vector deltas{bytes(first), bytes(second)};
+    zpp::bits::tracked_objects<vehicle> restored;
+    zpp::bits::restore_checkpoint(bytes(base), deltas, restored).or_throw();
+    ASSERT_EQ(restored.size(), vehicles.size());
+    EXPECT_TRUE(std::ranges::equal(restored.objects(), vehicles.objects()));
+    EXPECT_EQ(restored.generation(), 3u);
+    EXPECT_EQ(restored.dirty_count(), 0u);
+
+    // The chain continues from the restored objects.
+    restored.modify(5).id = 5000;
+    vehicles.modify(5).id = 5000;
+    std::vector<std::byte> third;
+    zpp::bits::write_delta(third, restored).or_throw();
+    deltas.push_back(bytes(third));
+
+    zpp::bits::tracked_objects<vehicle> again;
+    zpp::bits::restore_checkpoint(bytes(base), deltas, again).or_throw();
+    EXPECT_TRUE(std::ranges::equal(again.objects(), vehicles.objects()));
+}
+
+TEST(delta, merge)
+{
+    zpp::bits::tracked_objects<vehicle> vehicles{
+        std::vector<vehicle>{{1, 1, "a"}, {2, 2, "b"}, {3, 3, "c"}}};
+    std::vector<std::byte> base;
+    zpp::bits::write_checkpoint(base, vehicles).or_throw();
+
+    vehicles.modify(1).route = "bb";
+    vehicles.resize(2);
+    std::vector<std::byte> first;
+    zpp::bits::write_delta(first, vehicles).or_throw();
+
+    std::vector deltas{bytes(first)};
+    std::vector<std::byte> merged;
+    zpp::bits::merge_checkpoints<vehicle>(merged, bytes(base), deltas)
+        .or_throw();
+
+    zpp::bits::tracked_objects<vehicle> restored;
+    zpp::bits::restore_checkpoint(bytes(merged), {}, restored).or_throw();
+    EXPECT_TRUE(std::ranges::equal(restored.objects(), vehicles.objects()));
+    EXPECT_EQ(restored.generation(), 2u);
+
+    vehicles.modify(0).position = 10;
+    std::vector<std::byte> second;
+    zpp::bits::write_delta(second, vehicles).or_throw();
+    std::vector after_merge{bytes(second)};
+    zpp::bits::restore_checkpoint(bytes(merged), after_merge, restored)
+        .or_throw();
+    EXPECT_TRUE(std::ranges::equal(restored.objects(), vehicles.objects()));
+}
+
+TEST(delta, broken_chain)
+{
+    zpp::bits::tracked_objects<vehicle> vehicles{
+        std::vector<vehicle>{{1, 1, "a"}, {2, 2, "b"}}};
+    std::vector<std::byte> unused;
+    EXPECT_EQ(zpp::bits::write_delta(unused, vehicles),
+              std::errc::invalid_argument);
+
+    std::vector<std::byte> base;
+    zpp::bits::write_checkpoint(base, vehicles).or_throw();
+    vehicles.modify(0).id = 10;
+    std::vector<std::byte> first;
+    zpp::bits::write_delta(first, vehicles).or_throw();
+    vehicles.modify(1).id = 20;
+    std::vector<std::byte> second;
+    zpp::bits::write_delta(second, vehicles).or_throw();
+
+    zpp::bits::tracked_objects<vehicle> restored;
+    std::vector skipped{bytes(second)};
+    EXPECT_EQ(zpp::bits::restore_checkpoint(bytes(base), skipped, restored),
+              std::errc::protocol_error);
+
+    EXPECT_EQ(zpp::bits::restore_checkpoint(bytes(first), {}, restored),
+              std::errc::protocol_error);
+
+    zpp::bits::tracked_objects<std::int64_t> other;
+    EXPECT_EQ(zpp::bits::restore_checkpoint(bytes(base), {}, other),
+              std::errc::protocol_error);
+
+    base.resize(base.size() - 1);
+    EXPECT_EQ(zpp::bits::restore_checkpoint(bytes(base), {}, restored),
+              std::errc::result_out_of_range);
+}
+
+} // namespace test_delta
@@ -134,4 +134,77 @@ TEST(test_endian, little_in)
     EXPECT_EQ(ints.i64, 0x123456789abcdef0u);
 }
 
+template <typename Type>
+void check_big_range(std::size_t count)
+{
+    std::vector<Type> written(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        written[i] = static_cast<Type>(0x0102030405060708ull * (i + 1));
+    }
+
+    auto [data, out] = zpp::bits::data_out(zpp::bits::endian::big{});
+    out(written).or_throw();
+
+    // Each element is written after the size in the byte order of its own.
+    ASSERT_EQ(data.size(), sizeof(std::uint32_t) + count * sizeof(Type));
+    for (std::size_t i = 0; i < count; ++i) {
+        auto bytes = std::bit_cast<std::array<std::byte, sizeof(Type)>>(
+            written[i]);
+        if constexpr (std::endian::native == std::endian::little) {
+            std::reverse(bytes.begin(), bytes.end());
+        }
+        EXPECT_TRUE(std::equal(bytes.begin(),
+                               bytes.end(),
+                               data.begin() + sizeof(std::uint32_t) +
+                                   i * sizeof(Type)));
+    }
+
+    std::vector<Type> read;
+    zpp::bits::in in{data, zpp::bits::endian::big{}};
+    in(read).or_throw();
+    EXPECT_EQ(read, written);
+}
+
+TEST(test_endian, big_ranges)
+{
+    for (std::size_t count : {0, 1, 3, 7, 8, 15, 16, 17, 33, 100}) {
+        check_big_range<std::uint16_t>(count);
+        check_big_range<std::int32_t>(count);
+        check_big_range<std::uint64_t>(count);
+        check_big_range<float>(count);
+        check_big_range<double>(count);
+    }
+}
+
+TEST(test_endian, big_array)
+{
+    std::array<std::uint32_t, 5> written{1, 2, 3, 0x12345678u, 5};
+    auto [data, in, out] = data_in_out(zpp::bits::endian::big{});
+    out(written).or_throw();
+    EXPECT_EQ(data.size(), sizeof(written));
+    EXPECT_EQ(data[12], std::byte{0x12});
+    EXPECT_EQ(data[15], std::byte{0x78});
+
+    std::uint32_t array[5]{};
+    in(array).or_throw();
+    EXPECT_TRUE(std::equal(written.begin(), written.end(), array));
+}
+
+TEST(test_endian, big_constexpr_range)
+{
+    constexpr auto read = [] {
+        std::array<std::byte, 64> data{};
+        zpp::bits::out out{data, zpp::bits::endian::big{}};
+        out(std::array<std::uint16_t, 3>{0x1234, 0x5678, 0x9abc}).or_throw();
+
+        std::array<std::uint16_t, 3> values{};
+        zpp::bits::in in{data, zpp::bits::endian::big{}};
+        in(values).or_throw();
+        return std::pair{data[0], values};
+    }();
+
+    static_assert(read.first == std::byte{0x12});
+    static_assert(read.second[2] == 0x9abc);
+}
+
 } // namespace test_endian
@@ -0,0 +1,200 @@
+#include "test.h"
+#include "zpp_bits_gtfs_rt.h"
+
+namespace test_gtfs_rt
+{
+
+using namespace zpp::bits::literals;
+namespace gtfs_rt = zpp::bits::gtfs_rt;
+
+struct counting_resource : std::pmr::memory_resource
+{
+    void * do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        return upstream.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void * pointer,
+                       std::size_t bytes,
+                       std::size_t alignment) override
+    {
+        upstream.deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource & other) const
+        noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::monotonic_buffer_resource upstream;
+    std::size_t allocations{};
+};
+
+// A vehicle position with unknown fields 11, 12 and 13 of each wire type,
+// a trip update with negative delays, and an unknown field 1000 in the
+// feed message, as encoded by protobuf.
+constexpr auto feed_data =
+    "0a0d0a03322e3010001880e2cfaa061285010a0a76656869636c6520343222770a1d0a"
+    "067472697020311a0832303233313131342a07726f75746520373001121d0d00002342"
+    "15000093c21d0000b4422100000000004a93402d00004841180420012881e2cfaa063a"
+    "0673746f702034420c0a066275732034321202343248025a07756e6b6e6f776e650000"
+    "803f690000000000000040125b0a0875706461746520311a4f0a1d0a06747269702031"
+    "1a0832303233313131342a07726f75746520373001121d0803121108e2ffffffffffff"
+    "ffff0110e4e2cfaa06220673746f7020332082e2cfaa0628d3ffffffffffffffff01c0"
+    "3e07"_decode_hex;
+
+TEST(test_gtfs_rt, decode_protobuf_feed)
+{
+    gtfs_rt::feed_message feed;
+    gtfs_rt::decode(feed_data, feed).or_throw();
+
+    EXPECT_EQ(feed.header.gtfs_realtime_version, "2.0");
+    EXPECT_EQ(feed.header.incrementality,
+              gtfs_rt::feed_header::incrementality_type::full_dataset);
+    EXPECT_EQ(feed.header.timestamp, 1700000000u);
+    ASSERT_EQ(feed.entity.size(), 2u);
+
+    auto & vehicle_entity = feed.entity[0];
+    EXPECT_EQ(vehicle_entity.id, "vehicle 42");
+    EXPECT_FALSE(vehicle_entity.trip_update);
+    EXPECT_FALSE(vehicle_entity.alert);
+    ASSERT_TRUE(vehicle_entity.vehicle);
+
+    auto & vehicle = *vehicle_entity.vehicle;
+    ASSERT_TRUE(vehicle.trip);
+    EXPECT_EQ(vehicle.trip->trip_id, "trip 1");
+    EXPECT_EQ(vehicle.trip->start_date, "20231114");
+    EXPECT_EQ(vehicle.trip->route_id, "route 7");
+    EXPECT_EQ(vehicle.trip->direction_id, 1u);
+    ASSERT_TRUE(vehicle.position);
+    EXPECT_EQ(vehicle.position->latitude, 40.75f);
+    EXPECT_EQ(vehicle.position->longitude, -73.5f);
+    EXPECT_EQ(vehicle.position->bearing, 90.0f);
+    EXPECT_EQ(vehicle.position->odometer, 1234.5);
+    EXPECT_EQ(vehicle.position->speed, 12.5f);
+    EXPECT_EQ(vehicle.current_stop_sequence, 4u);
+    EXPECT_EQ(
+        vehicle.current_status,
+        gtfs_rt::vehicle_position::vehicle_stop_status_type::stopped_at);
+    EXPECT_EQ(vehicle.timestamp, 1700000001u);
+    EXPECT_EQ(vehicle.stop_id, "stop 4");
+    ASSERT_TRUE(vehicle.vehicle);
+    EXPECT_EQ(vehicle.vehicle->id, "bus 42");
+    EXPECT_EQ(vehicle.vehicle->label, "42");
+    EXPECT_EQ(vehicle.occupancy_status,
+              gtfs_rt::vehicle_position::occupancy_status_type::
+                  few_seats_available);
+
+    auto & update_entity = feed.entity[1];
+    EXPECT_EQ(update_entity.id, "update 1");
+    EXPECT_FALSE(update_entity.vehicle);
+    ASSERT_TRUE(update_entity.trip_update);
+
+    auto & update = *update_entity.trip_update;
+    EXPECT_EQ(update.trip.trip_id, "trip 1");
+    EXPECT_EQ(update.timestamp, 1700000002u);
+    EXPECT_EQ(update.delay, -45);
+    ASSERT_EQ(update.stop_time_update.size(), 1u);
+    EXPECT_EQ(update.stop_time_update[0].stop_sequence, 3u);
+    EXPECT_EQ(update.stop_time_update[0].stop_id, "stop 3");
+    ASSERT_TRUE(update.stop_time_update[0].arrival);
+    EXPECT_EQ(update.stop_time_update[0].arrival->delay, -30);
+    EXPECT_EQ(update.stop_time_update[0].arrival->time, 1700000100);
+    EXPECT_FALSE(update.stop_time_update[0].departure);
+}
+
+TEST(test_gtfs_rt, strings_view_the_feed)
+{
+    gtfs_rt::feed_message feed;
+    gtfs_rt::decode(feed_data, feed).or_throw();
+
+    auto begin = reinterpret_cast<const char *>(feed_data.data());
+    auto end = begin + feed_data.size();
+    for (auto text : {feed.header.gtfs_realtime_version,
+                      feed.entity[0].id,
+                      feed.entity[0].vehicle->stop_id,
+                      feed.entity[1].trip_update->trip.route_id}) {
+        EXPECT_GE(text.data(), begin);
+        EXPECT_LE(text.data() + text.size(), end);
+    }
+}
+
+TEST(test_gtfs_rt, truncated_feed)
+{
+    gtfs_rt::feed_message feed;
+    auto truncated = std::span{feed_data}.first(feed_data.size() - 30);
+    EXPECT_TRUE(zpp::bits::failure(gtfs_rt::decode(truncated, feed)));
+}
+
+TEST(test_gtfs_rt, round_trip)
+{
+    gtfs_rt::feed_message feed;
+    feed.header.gtfs_realtime_version = "2.0";
+    feed.header.incrementality =
+        gtfs_rt::feed_header::incrementality_type::differential;
+    feed.header.timestamp = 1700000000;
+
+    auto & entity = feed.entity.emplace_back();
+    entity.id = "alert 1";
+    auto & alert = entity.alert.emplace();
+    alert.active_period.push_back({1700000000, 1700003600});
+    alert.informed_entity.push_back({.route_id = "route 7"});
+    alert.informed_entity.push_back(
+        {.trip = gtfs_rt::trip_descriptor{.trip_id = "trip 1"}});
+    alert.cause = gtfs_rt::alert::cause_type::construction;
+    alert.effect = gtfs_rt::alert::effect_type::detour;
+    auto & header_text = alert.header_text.emplace();
+    header_text.translation.push_back({"Detour", "en"});
+    header_text.translation.push_back({"Desvio", "es"});
+
+    auto [data, out] = zpp::bits::data_out(zpp::bits::no_size{});
+    out(feed).or_throw();
+
+    gtfs_rt::feed_message decoded;
+    gtfs_rt::decode(data, decoded).or_throw();
+
+    EXPECT_EQ(decoded.header.gtfs_realtime_version, "2.0");
+    EXPECT_EQ(decoded.header.incrementality,
+              gtfs_rt::feed_header::incrementality_type::differential);
+    ASSERT_EQ(decoded.entity.size(), 1u);
+    EXPECT_EQ(decoded.entity[0].id, "alert 1");
+    EXPECT_FALSE(decoded.entity[0].vehicle);
+    ASSERT_TRUE(decoded.entity[0].alert);
+
+    auto & decoded_alert = *decoded.entity[0].alert;
+    ASSERT_EQ(decoded_alert.active_period.size(), 1u);
+    EXPECT_EQ(decoded_alert.active_period[0].end, 1700003600u);
+    ASSERT_EQ(decoded_alert.informed_entity.size(), 2u);
+    EXPECT_EQ(decoded_alert.informed_entity[0].route_id, "route 7");
+    EXPECT_FALSE(decoded_alert.informed_entity[0].trip);
+    ASSERT_TRUE(decoded_alert.informed_entity[1].trip);
+    EXPECT_EQ(decoded_alert.informed_entity[1].trip->trip_id, "trip 1");
+    EXPECT_EQ(decoded_alert.cause, gtfs_rt::alert::cause_type::construction);
+    EXPECT_EQ(decoded_alert.effect, gtfs_rt::alert::effect_type::detour);
+    EXPECT_FALSE(decoded_alert.url);
+    ASSERT_TRUE(decoded_alert.header_text);
+    ASSERT_EQ(decoded_alert.header_text->translation.size(), 2u);
+    EXPECT_EQ(decoded_alert.header_text->translation[1].text, "Desvio");
+    EXPECT_EQ(decoded_alert.header_text->translation[1].language, "es");
+
+    // The alert fields 6, 7 and 10 are mapped past the gaps.
+    EXPECT_NE(std::ranges::search(data, "\x30\x0a\x38\x04"_b).begin(),
+              data.end());
+    EXPECT_NE(std::ranges::search(data, "\x52\x1c"_b).begin(), data.end());
+}
+
+TEST(test_gtfs_rt, repeated_fields_from_memory_resource)
+{
+    counting_resource resource;
+    gtfs_rt::feed_message feed;
+    gtfs_rt::decode(feed_data, feed, resource).or_throw();
+
+    EXPECT_EQ(feed.entity.get_allocator().resource(), &resource);
+    auto & update = *feed.entity[1].trip_update;
+    EXPECT_EQ(update.stop_time_update.get_allocator().resource(), &resource);
+    EXPECT_EQ(resource.allocations, 3u);
+}
+
+} // namespace test_gtfs_rt
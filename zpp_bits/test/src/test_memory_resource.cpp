@@ -0,0 +1,160 @@
+#include "test.h"
+
+namespace test_memory_resource
+{
+
+struct counting_resource : std::pmr::memory_resource
+{
+    void * do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        return upstream.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void * pointer,
+                       std::size_t bytes,
+                       std::size_t alignment) override
+    {
+        ++deallocations;
+        upstream.deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource & other) const
+        noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::monotonic_buffer_resource upstream;
+    std::size_t allocations{};
+    std::size_t deallocations{};
+};
+
+struct route_node
+{
+    int id;
+    std::pmr::string name;
+    zpp::bits::optional_ptr<route_node, zpp::bits::pmr_deleter<route_node>>
+        next;
+};
+
+struct link
+{
+    int id;
+    std::pmr::vector<int> nodes;
+};
+
+TEST(memory_resource, unique_ptr_graph)
+{
+    auto [data, out] = zpp::bits::data_out();
+    {
+        route_node head{0, std::pmr::string("node 0"), {}};
+        auto * tail = &head;
+        for (int i = 1; i < 1000; ++i) {
+            auto memory = std::pmr::get_default_resource()->allocate(
+                sizeof(route_node), alignof(route_node));
+            auto name = "a longer name of node " + std::to_string(i);
+            tail->next.reset(
+                new (memory) route_node{i, std::pmr::string(name), {}});
+            tail = tail->next.get();
+        }
+        out(head).or_throw();
+
+        // Destroys the list iteratively.
+        auto next = std::move(head.next);
+        while (next) {
+            next = std::move(next->next);
+        }
+    }
+
+    counting_resource resource;
+    {
+        zpp::bits::in in{data, zpp::bits::memory_resource{resource}};
+        route_node head;
+        in(head).or_throw();
+
+        auto * node = &head;
+        for (int i = 0; i < 1000; ++i, node = node->next.get()) {
+            ASSERT_NE(node, nullptr);
+            EXPECT_EQ(node->id, i);
+            EXPECT_EQ(node->name.get_allocator().resource(), &resource);
+            if (node->next) {
+                EXPECT_EQ(node->next.get_deleter().resource, &resource);
+            }
+        }
+        EXPECT_EQ(node, nullptr);
+
+        // Each node and each name long enough to allocate.
+        EXPECT_EQ(resource.allocations, 999u + 999u);
+
+        auto next = std::move(head.next);
+        while (next) {
+            next = std::move(next->next);
+        }
+    }
+    EXPECT_EQ(resource.deallocations, resource.allocations);
+}
+
+TEST(memory_resource, containers)
+{
+    std::pmr::vector<link> links;
+    for (int i = 0; i < 10; ++i) {
+        links.push_back({i, std::pmr::vector<int>(i, i)});
+    }
+
+    auto [data, out] = zpp::bits::data_out();
+    std::pmr::map<int, std::pmr::string> names{{1, "first street"},
+                                               {2, "second street"}};
+    out(links, names).or_throw();
+
+    counting_resource resource;
+    zpp::bits::in in{data, zpp::bits::memory_resource{resource}};
+    std::pmr::vector<link> links_in;
+    std::pmr::map<int, std::pmr::string> names_in;
+    in(links_in, names_in).or_throw();
+
+    ASSERT_EQ(links_in.size(), links.size());
+    EXPECT_EQ(links_in.get_allocator().resource(), &resource);
+    for (std::size_t i = 0; i < links.size(); ++i) {
+        EXPECT_EQ(links_in[i].id, links[i].id);
+        EXPECT_EQ(links_in[i].nodes, links[i].nodes);
+        EXPECT_EQ(links_in[i].nodes.get_allocator().resource(), &resource);
+    }
+    EXPECT_EQ(names_in, names);
+    EXPECT_EQ(names_in.get_allocator().resource(), &resource);
+    EXPECT_EQ(names_in.at(2).get_allocator().resource(), &resource);
+}
+
+TEST(memory_resource, shared_ptr)
+{
+    auto [data, out] = zpp::bits::data_out();
+    out(std::make_shared<link>(link{7, std::pmr::vector<int>{1, 2, 3}}))
+        .or_throw();
+
+    counting_resource resource;
+    zpp::bits::in in{data, zpp::bits::memory_resource{resource}};
+    std::shared_ptr<link> loaded;
+    in(loaded).or_throw();
+
+    EXPECT_EQ(loaded->id, 7);
+    EXPECT_EQ(loaded->nodes, (std::pmr::vector<int>{1, 2, 3}));
+    EXPECT_EQ(loaded->nodes.get_allocator().resource(), &resource);
+    EXPECT_EQ(resource.allocations, 2u);
+}
+
+TEST(memory_resource, default_resource)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::pmr_unique_ptr<link>(
+            new (std::pmr::get_default_resource()->allocate(sizeof(link),
+                                                            alignof(link)))
+                link{1, std::pmr::vector<int>{4}}))
+        .or_throw();
+
+    zpp::bits::pmr_unique_ptr<link> loaded;
+    in(loaded).or_throw();
+    EXPECT_EQ(loaded->nodes, (std::pmr::vector<int>{4}));
+    EXPECT_EQ(loaded.get_deleter().resource, std::pmr::get_default_resource());
+}
+
+} // namespace test_memory_resource
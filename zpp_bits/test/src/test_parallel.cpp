@@ -0,0 +1,129 @@
+#include "test.h"
+#include "zpp_bits_parallel.h"
+
+namespace test_parallel
+{
+
+struct link
+{
+    std::int64_t id;
+    std::string name;
+    std::vector<double> volumes;
+
+    bool operator==(const link &) const = default;
+};
+
+auto make_links(std::size_t count)
+{
+    std::vector<link> links(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        links[i] = {std::int64_t(i),
+                    "link-" + std::to_string(i),
+                    std::vector<double>(i % 7, double(i))};
+    }
+    return links;
+}
+
+TEST(parallel, round_trip)
+{
+    auto links = make_links(10000);
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(std::int32_t{7}, zpp::bits::chunked(links, 333, 4), std::string("tail"))
+        .or_throw();
+
+    std::int32_t prefix{};
+    std::vector<link> links_in;
+    std::string tail;
+    in(prefix, zpp::bits::chunked(links_in, 0, 3), tail).or_throw();
+
+    EXPECT_EQ(prefix, 7);
+    EXPECT_EQ(links_in, links);
+    EXPECT_EQ(tail, "tail");
+    EXPECT_EQ(in.position(), data.size());
+}
+
+TEST(parallel, chunk_layout)
+{
+    std::vector<int> values{1, 2, 3};
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::chunked<std::uint32_t>(values, 2, 2)).or_throw();
+
+    EXPECT_EQ(encode_hex(data),
+              "02000000"
+              "0200000008000000"
+              "0100000004000000"
+              "01000000"
+              "02000000"
+              "03000000");
+}
+
+TEST(parallel, same_bytes_as_serial_options)
+{
+    auto links = make_links(100);
+
+    std::vector<std::byte> data;
+    zpp::bits::out out{data, zpp::bits::endian::big{}, zpp::bits::size2b{}};
+    out(zpp::bits::chunked(links, 10)).or_throw();
+
+    std::vector<link> links_in;
+    zpp::bits::in in{data, zpp::bits::endian::big{}, zpp::bits::size2b{}};
+    in(zpp::bits::chunked(links_in, 10)).or_throw();
+    EXPECT_EQ(links_in, links);
+}
+
+TEST(parallel, empty)
+{
+    std::vector<link> links;
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::chunked(links)).or_throw();
+    EXPECT_EQ(data.size(), sizeof(std::uint64_t));
+
+    std::vector<link> links_in(3);
+    in(zpp::bits::chunked(links_in)).or_throw();
+    EXPECT_TRUE(links_in.empty());
+}
+
+TEST(parallel, truncated)
+{
+    auto links = make_links(100);
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::chunked(links, 10)).or_throw();
+    data.resize(data.size() - 1);
+
+    std::vector<link> links_in;
+    EXPECT_EQ(in(zpp::bits::chunked(links_in, 10)),
+              std::errc::result_out_of_range);
+}
+
+std::atomic<std::size_t> executor_calls{};
+
+void serial_executor(std::size_t count,
+                     const std::function<void(std::size_t)> & task)
+{
+    ++executor_calls;
+    for (std::size_t i = 0; i < count; ++i) {
+        task(i);
+    }
+}
+
+TEST(parallel, custom_executor)
+{
+    auto links = make_links(1000);
+
+    auto previous = zpp::bits::set_parallel_executor(serial_executor);
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::chunked(links, 100, 4)).or_throw();
+
+    std::vector<link> links_in;
+    in(zpp::bits::chunked(links_in, 0, 4)).or_throw();
+    zpp::bits::set_parallel_executor(previous);
+
+    EXPECT_EQ(links_in, links);
+    EXPECT_EQ(executor_calls, 3u);
+}
+
+} // namespace test_parallel
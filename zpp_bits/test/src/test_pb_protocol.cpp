@@ -116,6 +116,39 @@ TEST(test_pb_protocol, test_repeated_integers)
         (std::vector<zpp::bits::vsint32_t>{1, 2, 3, 4, -1, -2, -3, -4}));
 }
 
+struct path
+{
+    using serialize = zpp::bits::protocol<zpp::bits::pb{}>;
+    zpp::bits::vint64_t id;
+    std::vector<zpp::bits::vuint64_t> nodes;
+};
+
+TEST(test_pb_protocol, test_repeated_large_integers)
+{
+    path p{.id = 7, .nodes = {}};
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        p.nodes.push_back(i * i * i * 2654435761u);
+    }
+
+    auto [data, in, out] = zpp::bits::data_in_out(zpp::bits::no_size{});
+    out(p).or_throw();
+
+    // Packed fields split across messages are concatenated.
+    path tail{.id = 7, .nodes = {1, 2, 3}};
+    out(tail).or_throw();
+
+    path r;
+    in(r).or_throw();
+    EXPECT_EQ(r.id, 7);
+    p.nodes.insert(p.nodes.end(), {1, 2, 3});
+    EXPECT_EQ(r.nodes, p.nodes);
+
+    data.resize(data.size() - 1);
+    path truncated;
+    EXPECT_NE((zpp::bits::in{data, zpp::bits::no_size{}}(truncated)),
+              std::errc{});
+}
+
 struct repeated_examples
 {
     using serialize = zpp::bits::protocol<zpp::bits::pb{}>;
@@ -0,0 +1,132 @@
+#include "test.h"
+
+namespace test_schema
+{
+
+struct sample
+{
+    std::int32_t link_id;
+    double speed;
+    std::uint8_t lane;
+    std::array<float, 3> position;
+
+    bool operator==(const sample &) const = default;
+};
+
+struct sample_v2
+{
+    std::int32_t link_id;
+    double speed;
+    std::uint16_t lane;
+    std::array<float, 3> position;
+};
+
+struct checkpoint
+{
+    std::string name;
+    std::vector<sample> samples;
+    std::variant<std::int64_t, std::string> time;
+
+    bool operator==(const checkpoint &) const = default;
+};
+
+struct tree
+{
+    int value;
+    std::vector<tree> children;
+
+    bool operator==(const tree &) const = default;
+};
+
+static_assert(zpp::bits::schema::image<sample>());
+static_assert(!zpp::bits::schema::image<checkpoint>());
+static_assert(!zpp::bits::schema::image<int *>());
+static_assert(zpp::bits::schema_hash_v<sample> ==
+              zpp::bits::schema_hash_v<const sample &>);
+static_assert(zpp::bits::schema_hash_v<sample> !=
+              zpp::bits::schema_hash_v<sample_v2>);
+static_assert(zpp::bits::schema_hash_v<std::vector<int>> !=
+              zpp::bits::schema_hash_v<std::vector<unsigned>>);
+static_assert(zpp::bits::schema_hash_v<std::string> ==
+              zpp::bits::schema_hash_v<std::vector<char>>);
+static_assert(zpp::bits::schema_hash_v<tree> !=
+              zpp::bits::schema_hash_v<std::vector<tree>>);
+
+TEST(schema, image)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    sample written{7, 13.5, 2, {1, 2, 3}};
+    out(zpp::bits::schema_checked(written)).or_throw();
+    EXPECT_EQ(data.size(), sizeof(std::uint64_t) + sizeof(sample));
+
+    sample read{};
+    in(zpp::bits::schema_checked(read)).or_throw();
+    EXPECT_EQ(read, written);
+    EXPECT_EQ(in.position(), data.size());
+}
+
+TEST(schema, image_range)
+{
+    std::vector<sample> written;
+    for (int i = 0; i < 100; ++i) {
+        written.push_back({i, i * 0.5, std::uint8_t(i % 4), {1, 2, 3}});
+    }
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::schema_checked(written), std::string("tail")).or_throw();
+    EXPECT_EQ(data.size(),
+              2 * sizeof(std::uint64_t) + written.size() * sizeof(sample) +
+                  sizeof(std::uint32_t) + 4);
+
+    std::vector<sample> read;
+    std::string tail;
+    in(zpp::bits::schema_checked(read), tail).or_throw();
+    EXPECT_EQ(read, written);
+    EXPECT_EQ(tail, "tail");
+}
+
+TEST(schema, members)
+{
+    checkpoint written{"morning", {{1, 2, 3, {}}, {4, 5, 6, {}}}, 42};
+    tree forest{1, {{2, {}}, {3, {{4, {}}}}}};
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::schema_checked(written), zpp::bits::schema_checked(forest))
+        .or_throw();
+
+    checkpoint read;
+    tree forest_read;
+    in(zpp::bits::schema_checked(read), zpp::bits::schema_checked(forest_read))
+        .or_throw();
+    EXPECT_EQ(read, written);
+    EXPECT_EQ(forest_read, forest);
+}
+
+TEST(schema, mismatch)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    sample written{7, 13.5, 2, {1, 2, 3}};
+    out(zpp::bits::schema_checked(written)).or_throw();
+
+    sample_v2 newer{};
+    EXPECT_EQ(in(zpp::bits::schema_checked(newer)),
+              std::errc::protocol_error);
+    EXPECT_EQ(in.position(), 0u);
+
+    sample older{};
+    in(zpp::bits::schema_checked(older)).or_throw();
+    EXPECT_EQ(older, written);
+}
+
+TEST(schema, truncated)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::schema_checked(std::vector<sample>(3))).or_throw();
+    data.resize(data.size() - 1);
+
+    std::vector<sample> read;
+    EXPECT_EQ(in(zpp::bits::schema_checked(read)),
+              std::errc::result_out_of_range);
+}
+
+} // namespace test_schema
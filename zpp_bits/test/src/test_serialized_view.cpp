@@ -0,0 +1,96 @@
+#include "test.h"
+
+namespace test_serialized_view
+{
+
+struct point
+{
+    double x;
+    double y;
+
+    bool operator==(const point &) const = default;
+};
+
+struct link
+{
+    std::int64_t id;
+    std::string name;
+    std::vector<int> nodes;
+
+    bool operator==(const link &) const = default;
+};
+
+TEST(serialized_view, trivially_copyable)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(std::int32_t{7}, zpp::bits::indexed(std::vector<point>{{1, 2}, {3, 4}, {5, 6}}))
+        .or_throw();
+
+    EXPECT_EQ(encode_hex(data).substr(0, 48),
+              "07000000"
+              "0300000000000000"
+              "00000000"
+              "000000000000f03f");
+
+    std::int32_t prefix{};
+    zpp::bits::serialized_view<std::vector<point>> view;
+    in(prefix, view).or_throw();
+    EXPECT_EQ(in.position(), data.size());
+    EXPECT_EQ(view.size(), 3u);
+    EXPECT_EQ(view[1], (point{3, 4}));
+    EXPECT_EQ(view.get(3).error().code, std::errc::result_out_of_range);
+
+    auto span = view.span().or_throw();
+    EXPECT_EQ(span.size(), 3u);
+    EXPECT_EQ(static_cast<const void *>(span.data()),
+              static_cast<const void *>(data.data() + 16));
+    EXPECT_EQ(span[2], (point{5, 6}));
+}
+
+TEST(serialized_view, variable_size)
+{
+    std::vector<link> links;
+    for (std::int64_t i = 0; i < 100; ++i) {
+        links.push_back({i, "link-" + std::to_string(i), std::vector<int>(i % 5, int(i))});
+    }
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::indexed(links), std::string("tail")).or_throw();
+
+    zpp::bits::serialized_view<std::vector<link>> view;
+    std::string tail;
+    in(view, tail).or_throw();
+    EXPECT_EQ(tail, "tail");
+    EXPECT_EQ(view.size(), links.size());
+    EXPECT_EQ(view[0], links[0]);
+    EXPECT_EQ(view[42], links[42]);
+    EXPECT_EQ(view.get(99).or_throw(), links[99]);
+    EXPECT_EQ(view.get(100).error().code, std::errc::result_out_of_range);
+}
+
+TEST(serialized_view, indexed_round_trip)
+{
+    std::vector<link> links{{1, "a", {1, 2}}, {2, "bc", {}}};
+    std::vector<point> points{{1, 2}};
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::indexed(links), zpp::bits::indexed(points)).or_throw();
+
+    std::vector<link> links_in;
+    std::vector<point> points_in;
+    in(zpp::bits::indexed(links_in), zpp::bits::indexed(points_in)).or_throw();
+    EXPECT_EQ(links_in, links);
+    EXPECT_EQ(points_in, points);
+}
+
+TEST(serialized_view, truncated)
+{
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::indexed(std::vector<link>{{1, "a", {1}}, {2, "b", {2}}})).or_throw();
+    data.resize(data.size() - 1);
+
+    zpp::bits::serialized_view<std::vector<link>> view;
+    EXPECT_EQ(in(view), std::errc::result_out_of_range);
+}
+
+} // namespace test_serialized_view
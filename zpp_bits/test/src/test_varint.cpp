@@ -198,4 +198,74 @@ TEST(varint, varint_size)
     EXPECT_EQ(v, o);
 }
 
+template <typename Varint>
+std::vector<std::byte> encode_one_by_one(const std::vector<Varint> & values)
+{
+    auto [data, out] = zpp::bits::data_out();
+    for (auto value : values) {
+        out(value).or_throw();
+    }
+    return data;
+}
+
+TEST(varint, bulk)
+{
+    std::vector<zpp::bits::vuint64_t> values;
+    for (std::uint64_t i = 0; i < 64; ++i) {
+        values.push_back(std::uint64_t(1) << i);
+        values.push_back((std::uint64_t(1) << i) - 1);
+        values.push_back(i);
+    }
+    values.push_back(std::numeric_limits<std::uint64_t>::max());
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(zpp::bits::unsized(values)).or_throw();
+    EXPECT_EQ(data, encode_one_by_one(values));
+
+    std::vector<zpp::bits::vuint64_t> v(values.size());
+    in(zpp::bits::unsized(v)).or_throw();
+    EXPECT_EQ(in.position(), data.size());
+    EXPECT_EQ(v, values);
+}
+
+TEST(varint, bulk_zig_zag)
+{
+    std::vector<zpp::bits::vsint32_t> values;
+    for (std::int32_t i = -1000; i < 1000; ++i) {
+        values.push_back(i * 127);
+    }
+    values.push_back(std::numeric_limits<std::int32_t>::min());
+    values.push_back(std::numeric_limits<std::int32_t>::max());
+
+    auto [data, in, out] = zpp::bits::data_in_out();
+    out(values, std::int8_t{7}).or_throw();
+    EXPECT_EQ(std::vector(data.begin() + 4, data.end() - 1),
+              encode_one_by_one(values));
+
+    std::vector<zpp::bits::vsint32_t> v;
+    std::int8_t tail{};
+    in(v, tail).or_throw();
+    EXPECT_EQ(v, values);
+    EXPECT_EQ(tail, 7);
+}
+
+TEST(varint, bulk_errors)
+{
+    std::vector<std::byte> data(8, std::byte{0xff});
+    data.push_back(std::byte{0x01});
+
+    std::vector<zpp::bits::vuint32_t> v(1);
+    EXPECT_EQ(zpp::bits::in{data}(zpp::bits::unsized(v)),
+              std::errc::value_too_large);
+
+    data.resize(3);
+    EXPECT_EQ(zpp::bits::in{data}(zpp::bits::unsized(v)),
+              std::errc::result_out_of_range);
+
+    std::array<std::byte, 3> small{};
+    std::vector<zpp::bits::vuint32_t> large{0x10000000};
+    EXPECT_EQ(zpp::bits::out{small}(zpp::bits::unsized(large)),
+              std::errc::result_out_of_range);
+}
+
 } // namespace test_varint
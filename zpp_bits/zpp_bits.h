@@ -14,6 +14,7 @@
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <numeric>
 #include <optional>
 #include <span>
@@ -23,6 +24,12 @@
 #include <utility>
 #include <variant>
 #include <vector>
+#if defined(__BMI2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #if __has_include("zpp_throwing.h")
 #include "zpp_throwing.h"
 #endif
@@ -375,6 +382,9 @@ struct destructor_guard
 template <typename Type>
 destructor_guard(Type) -> destructor_guard<Type>;
 
+template <typename Type>
+struct pmr_deleter;
+
 namespace traits
 {
 template <typename Type>
@@ -388,6 +398,12 @@ struct is_unique_ptr<std::unique_ptr<Type, std::default_delete<Type>>>
 {
 };
 
+template <typename Type>
+struct is_unique_ptr<std::unique_ptr<Type, pmr_deleter<Type>>>
+    : std::true_type
+{
+};
+
 template <typename Type>
 struct is_shared_ptr : std::false_type
 {
@@ -845,9 +861,16 @@ concept endian_aware_archive = requires
     requires std::remove_cvref_t<Archive>::endian_aware;
 };
 
+template <typename Type>
+concept byte_swappable =
+    (std::is_integral_v<Type> || std::is_floating_point_v<Type> ||
+     std::is_enum_v<Type>) &&
+    (sizeof(Type) == 2 || sizeof(Type) == 4 || sizeof(Type) == 8);
+
 template <typename Archive, typename Type>
 concept serialize_as_bytes = endian_independent_byte_serializable<Type> ||
-    (!endian_aware_archive<Archive> && byte_serializable<Type>);
+    (!endian_aware_archive<Archive> && byte_serializable<Type>) ||
+    (endian_aware_archive<Archive> && byte_swappable<Type>);
 
 template <typename Type, typename Reference>
 concept type_references = requires
@@ -879,6 +902,15 @@ concept type_references = requires
     requires optional<Type>;
     requires std::same_as<std::remove_cvref_t<decltype(*value)>,
                           std::remove_cvref_t<Reference>>;
+}
+|| requires (Type && value)
+{
+    requires std::derived_from<
+        std::remove_cvref_t<Type>,
+        std::unique_ptr<std::remove_cvref_t<decltype(*value)>,
+                        typename std::remove_cvref_t<Type>::deleter_type>>;
+    requires std::same_as<std::remove_cvref_t<decltype(*value)>,
+                          std::remove_cvref_t<Reference>>;
 };
 
 template <typename Type>
@@ -1053,6 +1085,22 @@ struct alloc_limit : option<alloc_limit<Size>>
     constexpr static auto alloc_limit_value = Size;
 };
 
+/**
+ * Allocates the pointees of pmr_unique_ptr and std::shared_ptr, and the
+ * elements of std::pmr containers, from the resource when deserializing,
+ * e.g. a std::pmr::monotonic_buffer_resource, so that a pointer rich graph
+ * takes a few large allocations, and is freed at once with the resource.
+ * The resource must outlive the deserialized objects.
+ */
+struct memory_resource : option<memory_resource>
+{
+    constexpr explicit memory_resource(std::pmr::memory_resource & resource) :
+        resource(&resource)
+    {
+    }
+    std::pmr::memory_resource * resource{};
+};
+
 template <std::size_t Multiplier, std::size_t Divisor = 1>
 struct enlarger : option<enlarger<Multiplier, Divisor>>
 {
@@ -1091,6 +1139,15 @@ struct no_enlarge_overflow : option<no_enlarge_overflow>
 {
 };
 
+/**
+ * Leaves out the bounds checks of each field, for archives over buffers
+ * of a fixed size, checked once per call against max_serialized_size()
+ * of the items instead, see bounded_output() and bounded_input().
+ */
+struct unchecked : option<unchecked>
+{
+};
+
 struct enlarge_overflow : option<enlarge_overflow>
 {
 };
@@ -1392,10 +1449,33 @@ constexpr decltype(auto) visit_members_types(auto && visitor)
     return access::visit_members_types<Type>(visitor);
 }
 
+/**
+ * Deleter of objects allocated from a memory resource, destroying the
+ * object and returning its storage to the resource.
+ */
 template <typename Type>
-struct optional_ptr : std::unique_ptr<Type>
+struct pmr_deleter
+{
+    void operator()(Type * pointer) const
+    {
+        pointer->~Type();
+        resource->deallocate(pointer, sizeof(Type), alignof(Type));
+    }
+
+    std::pmr::memory_resource * resource = std::pmr::get_default_resource();
+};
+
+/**
+ * A unique pointer whose pointee is allocated from the memory resource of
+ * the input archive when deserialized, see the memory_resource option.
+ */
+template <typename Type>
+using pmr_unique_ptr = std::unique_ptr<Type, pmr_deleter<Type>>;
+
+template <typename Type, typename Deleter = std::default_delete<Type>>
+struct optional_ptr : std::unique_ptr<Type, Deleter>
 {
-    using base = std::unique_ptr<Type>;
+    using base = std::unique_ptr<Type, Deleter>;
     using base::base;
     using base::operator=;
 
@@ -1408,10 +1488,11 @@ struct optional_ptr : std::unique_ptr<Type>
 template <typename Type, typename...>
 optional_ptr(Type *) -> optional_ptr<Type>;
 
-template <typename Archive, typename Type>
+template <typename Archive, typename Type, typename Deleter>
 ZPP_BITS_INLINE constexpr static auto serialize(
     Archive & archive,
-    const optional_ptr<Type> & self) requires(Archive::kind() == kind::out)
+    const optional_ptr<Type, Deleter> & self) requires(Archive::kind() ==
+                                                       kind::out)
 {
     if (!self) [[unlikely]] {
         return archive(std::byte(false));
@@ -1420,10 +1501,11 @@ ZPP_BITS_INLINE constexpr static auto serialize(
     }
 }
 
-template <typename Archive, typename Type>
+template <typename Archive, typename Type, typename Deleter>
 ZPP_BITS_INLINE constexpr static auto
 serialize(Archive & archive,
-          optional_ptr<Type> & self) requires(Archive::kind() == kind::in)
+          optional_ptr<Type, Deleter> & self) requires(Archive::kind() ==
+                                                      kind::in)
 {
     std::byte has_value{};
     if (auto result = archive(has_value); failure(result))
@@ -1437,7 +1519,7 @@ serialize(Archive & archive,
     }
 
     if (auto result =
-            archive(static_cast<std::unique_ptr<Type> &>(self));
+            archive(static_cast<std::unique_ptr<Type, Deleter> &>(self));
         failure(result)) [[unlikely]] {
         return result;
     }
@@ -1769,6 +1851,346 @@ serialize(Archive & archive,
           varint<Type, Encoding> && self) requires(Archive::kind() ==
                                                    kind::in) = delete;
 
+namespace varints
+{
+/**
+ * Bulk encoding and decoding of contiguous ranges of varints, e.g. packed
+ * repeated fields, eight bytes at a time in a general purpose register:
+ * a value of up to 56 bits is spread into, or gathered from, 7 bit groups
+ * by three shift and mask steps instead of a loop over its bytes, and the
+ * length of a value is found from the continuation bits of the word by a
+ * count of trailing zeros, or by pdep and pext with BMI2. Little endian
+ * hosts only, values that do not fit a word and the last bytes of the
+ * range take the byte loop.
+ */
+constexpr std::uint64_t continuation_bits = 0x8080808080808080;
+constexpr std::size_t word_size = sizeof(std::uint64_t);
+constexpr auto enabled = std::endian::native == std::endian::little;
+
+ZPP_BITS_INLINE inline std::uint64_t spread(std::uint64_t value)
+{
+#if defined(__BMI2__)
+    return _pdep_u64(value, ~continuation_bits);
+#else
+    value = (value & 0x000000000fffffff) |
+            ((value & 0x00fffffff0000000) << 4);
+    value = (value & 0x00003fff00003fff) |
+            ((value & 0x0fffc0000fffc000) << 2);
+    value = (value & 0x007f007f007f007f) |
+            ((value & 0x3f803f803f803f80) << 1);
+    return value;
+#endif
+}
+
+ZPP_BITS_INLINE inline std::uint64_t gather(std::uint64_t value)
+{
+#if defined(__BMI2__)
+    return _pext_u64(value, ~continuation_bits);
+#else
+    value = (value & 0x007f007f007f007f) |
+            ((value & 0x7f007f007f007f00) >> 1);
+    value = (value & 0x00003fff00003fff) |
+            ((value & 0x3fff00003fff0000) >> 2);
+    value = (value & 0x000000000fffffff) |
+            ((value & 0x0fffffff00000000) >> 4);
+    return value;
+#endif
+}
+
+template <typename Type, varint_encoding Encoding>
+ZPP_BITS_INLINE inline auto to_unsigned(varint<Type, Encoding> self)
+{
+    using integer_type = std::conditional_t<std::is_enum_v<Type>,
+                                            traits::underlying_type_t<Type>,
+                                            Type>;
+    auto orig_value = integer_type(self.value);
+    auto value = std::make_unsigned_t<integer_type>(orig_value);
+    if constexpr (varint_encoding::zig_zag == Encoding) {
+        value = (value << 1) ^
+                (orig_value >> (sizeof(integer_type) * CHAR_BIT - 1));
+    }
+    return value;
+}
+
+/**
+ * Size in bytes of the encoded values.
+ */
+template <typename Type, varint_encoding Encoding>
+inline std::size_t encoded_size(const varint<Type, Encoding> * values,
+                                std::size_t count)
+{
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        size += varint_size(to_unsigned(values[i]));
+    }
+    return size;
+}
+
+/**
+ * Encodes the values into data, of `size` bytes, no less than their encoded
+ * size, of which the bytes past the values may be overwritten.
+ *
+ * Returns the encoded size.
+ */
+template <typename Type, varint_encoding Encoding>
+inline std::size_t encode(const varint<Type, Encoding> * values,
+                          std::size_t count,
+                          std::byte * data,
+                          std::size_t size)
+{
+    std::size_t position = 0;
+    std::size_t i = 0;
+    for (; i < count && size - position >= word_size; ++i) {
+        auto value = std::uint64_t(to_unsigned(values[i]));
+        if (value >> 56) [[unlikely]] {
+            break;
+        }
+
+        // A run of eight single byte values is stored at once.
+        if (value < 0x80 && count - i >= word_size) {
+            auto bytes = value;
+            auto high_bits = value;
+            for (std::size_t j = 1; j < word_size; ++j) {
+                auto next_value = std::uint64_t(to_unsigned(values[i + j]));
+                bytes |= next_value << (CHAR_BIT * j);
+                high_bits |= next_value;
+            }
+            if (high_bits < 0x80) {
+                std::memcpy(data + position, &bytes, word_size);
+                position += word_size;
+                i += word_size - 1;
+                continue;
+            }
+        }
+
+        auto word = spread(value);
+        auto last_byte = std::size_t(std::bit_width(word | 1) - 1) >> 3;
+        word |= continuation_bits &
+                ((std::uint64_t(1) << (CHAR_BIT * last_byte)) - 1);
+        auto length = last_byte + 1;
+        std::memcpy(data + position, &word, word_size);
+        position += length;
+    }
+
+    for (; i < count; ++i) {
+        auto value = to_unsigned(values[i]);
+        while (value >= 0x80) {
+            data[position++] = std::byte((value & 0x7f) | 0x80);
+            value >>= (CHAR_BIT - 1);
+        }
+        data[position++] = std::byte(value);
+    }
+    return position;
+}
+
+/**
+ * Number of values encoded in data, i.e., of bytes without continuation.
+ */
+inline std::size_t count(std::span<const std::byte> data)
+{
+    std::size_t count = 0;
+    std::size_t position = 0;
+    for (; data.size() - position >= word_size; position += word_size) {
+        std::uint64_t word;
+        std::memcpy(&word, data.data() + position, word_size);
+        count += std::popcount(~word & continuation_bits);
+    }
+    for (; position < data.size(); ++position) {
+        count += !(std::to_integer<unsigned>(data[position]) & 0x80);
+    }
+    return count;
+}
+
+/**
+ * Decodes `count` values from data at position, advancing it.
+ */
+template <typename Type, varint_encoding Encoding>
+inline errc decode(std::span<const std::byte> data,
+                   std::size_t & position,
+                   varint<Type, Encoding> * values,
+                   std::size_t count)
+{
+    using value_type = std::conditional_t<
+        std::is_enum_v<Type>,
+        std::make_unsigned_t<traits::underlying_type_t<Type>>,
+        std::make_unsigned_t<Type>>;
+
+    auto assign = [&](auto & self, value_type value) {
+        if constexpr (varint_encoding::zig_zag == Encoding) {
+            self.value = decltype(self.value)((value >> 1) ^ -(value & 0x1));
+        } else {
+            self.value = decltype(self.value)(value);
+        }
+    };
+
+    for (std::size_t i = 0; i < count;) {
+        if (data.size() - position >= word_size) [[likely]] {
+            std::uint64_t word;
+            std::memcpy(&word, data.data() + position, word_size);
+            auto terminators = ~word & continuation_bits;
+
+            if (terminators == continuation_bits && count - i >= word_size) {
+                for (std::size_t j = 0; j < word_size; ++j) {
+                    assign(values[i + j],
+                           value_type((word >> (CHAR_BIT * j)) & 0x7f));
+                }
+                i += word_size;
+                position += word_size;
+                continue;
+            }
+
+            // Every value ending in the word, without loading it again.
+            if (terminators) [[likely]] {
+                std::size_t consumed = 0;
+                do {
+                    auto last_bit = std::countr_zero(terminators);
+                    auto length = std::size_t(last_bit >> 3) + 1;
+                    if (length > varint_max_size<value_type>) [[unlikely]] {
+                        return std::errc::value_too_large;
+                    }
+                    assign(values[i++],
+                           value_type(gather(
+                               word & (~std::uint64_t{} >> (63 - last_bit)))));
+                    word = (word >> last_bit) >> 1;
+                    terminators = (terminators >> last_bit) >> 1;
+                    consumed += length;
+                } while (terminators && i < count);
+                position += consumed;
+                continue;
+            }
+        }
+
+        value_type value{};
+        if (auto result =
+                decode_varint(data.subspan(position), value, position);
+            failure(result)) [[unlikely]] {
+            return result;
+        }
+        assign(values[i++], value);
+    }
+    return {};
+}
+} // namespace varints
+
+namespace byteswaps
+{
+/**
+ * Bulk byte swapping of contiguous ranges of integers and floating point
+ * numbers, for archives of the other byte order, 16 bytes at a time: by
+ * a single pshufb with SSSE3, 32 bytes with AVX2, by a shift and two
+ * word shuffles with SSE2, or by rev with NEON. The last elements of the
+ * range, and other targets, swap one element at a time in a register.
+ */
+template <std::size_t Size>
+ZPP_BITS_INLINE inline void swap_one(unsigned char * destination,
+                                     const unsigned char * source)
+{
+    using word = std::conditional_t<
+        Size == 2,
+        std::uint16_t,
+        std::conditional_t<Size == 4, std::uint32_t, std::uint64_t>>;
+    word value;
+    std::memcpy(&value, source, Size);
+#if defined __clang__ || defined __GNUC__
+    if constexpr (Size == 2) {
+        value = __builtin_bswap16(value);
+    } else if constexpr (Size == 4) {
+        value = __builtin_bswap32(value);
+    } else {
+        value = __builtin_bswap64(value);
+    }
+    std::memcpy(destination, &value, Size);
+#else
+    auto bytes = std::bit_cast<std::array<unsigned char, Size>>(value);
+    std::reverse_copy(bytes.begin(), bytes.end(), destination);
+#endif
+}
+
+#if defined(__SSSE3__)
+template <std::size_t Size>
+inline __m128i shuffle_mask()
+{
+    alignas(16) std::array<unsigned char, 16> mask{};
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = static_cast<unsigned char>(i - i % Size + Size - 1 -
+                                             i % Size);
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(mask.data()));
+}
+#endif
+
+/**
+ * Copies count elements of the size from source to destination, swapping
+ * the bytes of each, the ranges must not overlap.
+ */
+template <std::size_t Size>
+ZPP_BITS_INLINE inline void
+copy(void * destination, const void * source, std::size_t count)
+{
+    static_assert(Size == 2 || Size == 4 || Size == 8);
+    auto out = static_cast<unsigned char *>(destination);
+    auto in = static_cast<const unsigned char *>(source);
+    auto size = count * Size;
+    std::size_t offset = 0;
+
+#if defined(__SSSE3__)
+    const auto mask = shuffle_mask<Size>();
+#if defined(__AVX2__)
+    const auto wide_mask = _mm256_broadcastsi128_si256(mask);
+    for (; size - offset >= 32; offset += 32) {
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(out + offset),
+            _mm256_shuffle_epi8(
+                _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(in + offset)),
+                wide_mask));
+    }
+#endif
+    for (; size - offset >= 16; offset += 16) {
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(out + offset),
+            _mm_shuffle_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(in + offset)),
+                mask));
+    }
+#elif defined(__SSE2__)
+    for (; size - offset >= 16; offset += 16) {
+        auto value =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + offset));
+        value = _mm_or_si128(_mm_slli_epi16(value, 8),
+                             _mm_srli_epi16(value, 8));
+        if constexpr (Size == 4) {
+            value = _mm_shufflehi_epi16(
+                _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)),
+                _MM_SHUFFLE(2, 3, 0, 1));
+        } else if constexpr (Size == 8) {
+            value = _mm_shufflehi_epi16(
+                _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3)),
+                _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + offset), value);
+    }
+#elif defined(__ARM_NEON)
+    for (; size - offset >= 16; offset += 16) {
+        auto value = vld1q_u8(in + offset);
+        if constexpr (Size == 2) {
+            value = vrev16q_u8(value);
+        } else if constexpr (Size == 4) {
+            value = vrev32q_u8(value);
+        } else {
+            value = vrev64q_u8(value);
+        }
+        vst1q_u8(out + offset, value);
+    }
+#endif
+
+    for (; offset < size; offset += Size) {
+        swap_one<Size>(out + offset, in + offset);
+    }
+}
+} // namespace byteswaps
+
 using vint32_t = varint<std::int32_t>;
 using vint64_t = varint<std::int64_t>;
 
@@ -1788,6 +2210,9 @@ struct size_varint : option<size_varint>
 };
 } // namespace options
 
+template <typename... Types>
+constexpr std::size_t max_serialized_size();
+
 template <concepts::byte_view ByteView, typename... Options>
 class basic_out
 {
@@ -1831,6 +2256,10 @@ public:
         (... ||
          std::same_as<std::remove_cvref_t<Options>, options::no_enlarge_overflow>);
 
+    constexpr static auto bounds_checked =
+        !(... ||
+          std::same_as<std::remove_cvref_t<Options>, options::unchecked>);
+
     constexpr static bool resizable = requires(ByteView view)
     {
         view.resize(1);
@@ -1855,7 +2284,11 @@ public:
 
     ZPP_BITS_INLINE constexpr auto operator()(auto &&... items)
     {
-        return serialize_many(items...);
+        if constexpr (!bounds_checked) {
+            return serialize_bounded(items...);
+        } else {
+            return serialize_many(items...);
+        }
     }
 
     constexpr decltype(auto) data()
@@ -1949,6 +2382,22 @@ protected:
         return {};
     }
 
+    ZPP_BITS_INLINE constexpr errc serialize_bounded(auto &&... items)
+    {
+        constexpr auto size =
+            max_serialized_size<decltype(items)...>();
+        if (size > m_data.size() - m_position) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+        return serialize_many(items...);
+    }
+
+    constexpr auto option(unchecked)
+    {
+        static_assert(!resizable &&
+                      view_type::extent != std::dynamic_extent);
+    }
+
     constexpr auto option(append)
     {
         static_assert(resizable);
@@ -1985,7 +2434,8 @@ protected:
                     failure(result)) [[unlikely]] {
                     return result;
                 }
-            } else if (sizeof(item) > m_data.size() - m_position)
+            } else if (bounds_checked &&
+                       sizeof(item) > m_data.size() - m_position)
                 [[unlikely]] {
                 return std::errc::result_out_of_range;
             }
@@ -2020,10 +2470,11 @@ protected:
                                      bytes<typename type::value_type>,
                                      type>;
                              }) {
-            static_assert(
-                !endian_aware ||
-                concepts::byte_type<
-                    std::remove_cvref_t<decltype(*item.data())>>);
+            using value_type = std::remove_cvref_t<decltype(*item.data())>;
+            static_assert(!endian_aware || concepts::byte_type<value_type> ||
+                          concepts::byte_swappable<value_type>);
+            constexpr auto swapped =
+                endian_aware && sizeof(value_type) != 1;
 
             auto item_size_in_bytes = item.size_in_bytes();
             if constexpr (resizable) {
@@ -2031,7 +2482,8 @@ protected:
                     failure(result)) [[unlikely]] {
                     return result;
                 }
-            } else if (item_size_in_bytes > m_data.size() - m_position)
+            } else if (bounds_checked &&
+                       item_size_in_bytes > m_data.size() - m_position)
                 [[unlikely]] {
                 return std::errc::result_out_of_range;
             }
@@ -2048,9 +2500,13 @@ protected:
                          ++i) {
                         m_data[m_position +
                                index * sizeof(typename type::value_type) +
-                               i] = value[i];
+                               i] = swapped ? value[sizeof(value) - 1 - i]
+                                            : value[i];
                     }
                 }
+            } else if constexpr (swapped) {
+                byteswaps::copy<sizeof(value_type)>(
+                    m_data.data() + m_position, item.data(), item.count());
             } else {
                 // Ignore GCC Issue.
 #if !defined __clang__ && defined __GNUC__
@@ -2105,6 +2561,32 @@ protected:
         }
     }
 
+    template <typename Type, varint_encoding Encoding>
+    ZPP_BITS_INLINE errc serialize_varints(
+        const varint<Type, Encoding> * values, std::size_t count)
+    {
+        // Sized exactly only if the values may not fit.
+        auto size = count * varint_max_size<Type>;
+        if (size > m_data.size() - m_position) {
+            size = varints::encoded_size(values, count);
+            if constexpr (resizable) {
+                if (auto result = enlarge_for(size); failure(result))
+                    [[unlikely]] {
+                    return result;
+                }
+            } else if (size > m_data.size() - m_position) [[unlikely]] {
+                return std::errc::result_out_of_range;
+            }
+        }
+
+        m_position += varints::encode(
+            values,
+            count,
+            reinterpret_cast<std::byte *>(m_data.data()) + m_position,
+            size);
+        return {};
+    }
+
     template <typename SizeType = default_size_type>
     ZPP_BITS_INLINE constexpr errc
     serialize_one(concepts::container auto && container)
@@ -2167,6 +2649,13 @@ protected:
                     return result;
                 }
             }
+            if constexpr (concepts::varint<value_type> && varints::enabled &&
+                          requires { container.data(); }) {
+                if (!std::is_constant_evaluated()) {
+                    return serialize_varints(container.data(),
+                                             container.size());
+                }
+            }
             for (auto & item : container) {
                 if (auto result = serialize_one(item); failure(result))
                     [[unlikely]] {
@@ -2250,7 +2739,8 @@ protected:
                 failure(result)) [[unlikely]] {
                 return result;
             }
-        } else if (size_in_bytes > m_data.size() - m_position)
+        } else if (bounds_checked &&
+                   size_in_bytes > m_data.size() - m_position)
             [[unlikely]] {
             return std::errc::result_out_of_range;
         }
@@ -2370,7 +2860,9 @@ public:
 
     ZPP_BITS_INLINE constexpr auto operator()(auto &&... items)
     {
-        if constexpr (resizable && !no_fit_size &&
+        if constexpr (!base::bounds_checked) {
+            return serialize_bounded(items...);
+        } else if constexpr (resizable && !no_fit_size &&
                       enlarger != std::tuple{1, 1}) {
             auto end = m_data.size();
             auto result = serialize_many(items...);
@@ -2385,6 +2877,7 @@ public:
 
 private:
     using base::serialize_many;
+    using base::serialize_bounded;
     using base::m_data;
     using base::m_position;
 };
@@ -2435,6 +2928,9 @@ public:
     template <typename, concepts::variant>
     friend struct known_dynamic_id_variant;
 
+    template <typename...>
+    friend struct pb;
+
     using byte_type = std::add_const_t<typename ByteView::value_type>;
 
     constexpr static auto endian_aware =
@@ -2446,6 +2942,14 @@ public:
     constexpr static auto allocation_limit =
         traits::alloc_limit<Options...>();
 
+    constexpr static auto has_memory_resource =
+        (... ||
+         std::same_as<std::remove_cvref_t<Options>, memory_resource>);
+
+    constexpr static auto bounds_checked =
+        !(... ||
+          std::same_as<std::remove_cvref_t<Options>, options::unchecked>);
+
     constexpr explicit in(ByteView && view, Options && ... options) : m_data(view)
     {
         static_assert(!resizable);
@@ -2459,6 +2963,13 @@ public:
 
     ZPP_BITS_INLINE constexpr auto operator()(auto &&... items)
     {
+        if constexpr (!bounds_checked) {
+            constexpr auto size =
+                max_serialized_size<decltype(items)...>();
+            if (size > m_data.size() - m_position) [[unlikely]] {
+                return errc{std::errc::result_out_of_range};
+            }
+        }
         return serialize_many(items...);
     }
 
@@ -2510,6 +3021,51 @@ public:
                                std::span{std::declval<ByteView &>()})>>;
 
 private:
+    constexpr auto option(memory_resource option) requires has_memory_resource
+    {
+        m_memory_resource = option.resource;
+    }
+
+    constexpr auto option(unchecked)
+    {
+        static_assert(!resizable &&
+                      view_type::extent != std::dynamic_extent);
+    }
+
+    std::pmr::memory_resource * allocation_resource() const
+    {
+        if constexpr (has_memory_resource) {
+            return m_memory_resource;
+        } else {
+            return std::pmr::get_default_resource();
+        }
+    }
+
+    /**
+     * Moves an empty pmr container to the memory resource of the archive,
+     * its elements then inherit the resource by uses-allocator construction.
+     */
+    constexpr void use_memory_resource(auto & container)
+    {
+        using type = std::remove_cvref_t<decltype(container)>;
+        if constexpr (has_memory_resource &&
+                      requires {
+                          requires std::same_as<
+                              typename type::allocator_type,
+                              std::pmr::polymorphic_allocator<
+                                  typename type::allocator_type::
+                                      value_type>>;
+                      }) {
+            if (container.empty() &&
+                container.get_allocator().resource() != m_memory_resource) {
+                std::destroy_at(std::addressof(container));
+                std::construct_at(std::addressof(container),
+                                  typename type::allocator_type{
+                                      m_memory_resource});
+            }
+        }
+    }
+
     ZPP_BITS_INLINE constexpr errc serialize_many(auto && first_item,
                                                   auto &&... items)
     {
@@ -2537,7 +3093,8 @@ private:
             return serialize(*this, item);
         } else if constexpr (std::is_fundamental_v<type> || std::is_enum_v<type>) {
             auto size = m_data.size();
-            if (sizeof(item) > size - m_position) [[unlikely]] {
+            if (bounds_checked && sizeof(item) > size - m_position)
+                [[unlikely]] {
                 return std::errc::result_out_of_range;
             }
             if (std::is_constant_evaluated()) {
@@ -2572,14 +3129,16 @@ private:
                                      bytes<typename type::value_type>,
                                      type>;
                              }) {
-            static_assert(
-                !endian_aware ||
-                concepts::byte_type<
-                    std::remove_cvref_t<decltype(*item.data())>>);
+            using value_type = std::remove_cvref_t<decltype(*item.data())>;
+            static_assert(!endian_aware || concepts::byte_type<value_type> ||
+                          concepts::byte_swappable<value_type>);
+            constexpr auto swapped =
+                endian_aware && sizeof(value_type) != 1;
 
             auto size = m_data.size();
             auto item_size_in_bytes = item.size_in_bytes();
-            if (item_size_in_bytes > size - m_position) [[unlikely]] {
+            if (bounds_checked && item_size_in_bytes > size - m_position)
+                [[unlikely]] {
                 return std::errc::result_out_of_range;
             }
             if (std::is_constant_evaluated()) {
@@ -2591,15 +3150,18 @@ private:
                     for (std::size_t i = 0;
                          i < sizeof(typename type::value_type);
                          ++i) {
-                        value[i] = byte_type(
-                            m_data[m_position +
-                                   index *
-                                       sizeof(typename type::value_type) +
-                                   i]);
+                        value[swapped ? sizeof(value) - 1 - i : i] =
+                            byte_type(m_data[m_position +
+                                             index * sizeof(typename type::
+                                                                value_type) +
+                                             i]);
                     }
                     item.data()[index] =
                         std::bit_cast<typename type::value_type>(value);
                 }
+            } else if constexpr (swapped) {
+                byteswaps::copy<sizeof(value_type)>(
+                    item.data(), m_data.data() + m_position, item.count());
             } else {
                 std::memcpy(item.data(),
                             m_data.data() + m_position,
@@ -2684,6 +3246,7 @@ private:
                         return std::errc::message_size;
                     }
                 }
+                use_memory_resource(container);
                 container.resize(size);
             } else if constexpr (is_const &&
                                  (std::same_as<std::byte, value_type> ||
@@ -2758,6 +3321,18 @@ private:
                 return serialize_one(bytes(container));
             }
         } else {
+            if constexpr (concepts::varint<value_type> && varints::enabled &&
+                          !is_const && requires { container.data(); }) {
+                if (!std::is_constant_evaluated()) {
+                    return varints::decode(
+                        std::span{reinterpret_cast<const std::byte *>(
+                                      m_data.data()),
+                                  m_data.size()},
+                        m_position,
+                        container.data(),
+                        container.size());
+                }
+            }
             for (auto & item : container) {
                 if (auto result = serialize_one(item); failure(result))
                     [[unlikely]] {
@@ -2786,6 +3361,7 @@ private:
         }
 
         container.clear();
+        use_memory_resource(container);
 
         for (std::size_t index{}; index < size; ++index)
         {
@@ -2986,15 +3562,52 @@ private:
     serialize_one(concepts::owning_pointer auto && pointer)
     {
         using type = std::remove_reference_t<decltype(*pointer)>;
+        using pointer_type = std::remove_cvref_t<decltype(pointer)>;
 
-        auto loaded = access::make_unique<type>();;
-        if (auto result = serialize_one(*loaded); failure(result))
-            [[unlikely]] {
-            return result;
-        }
+        if constexpr (std::same_as<pointer_type, pmr_unique_ptr<type>>) {
+            auto resource = allocation_resource();
+            auto memory = resource->allocate(sizeof(type), alignof(type));
+            type * object;
+#ifdef __cpp_exceptions
+            try {
+#endif
+                object = access::placement_new<type>(memory);
+#ifdef __cpp_exceptions
+            } catch (...) {
+                resource->deallocate(memory, sizeof(type), alignof(type));
+                throw;
+            }
+#endif
 
-        pointer.reset(loaded.release());
-        return {};
+            pointer_type loaded{object, pmr_deleter<type>{resource}};
+            if (auto result = serialize_one(*loaded); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            pointer = std::move(loaded);
+            return {};
+        } else if constexpr (has_memory_resource &&
+                             traits::is_shared_ptr<pointer_type>::value) {
+            auto loaded = std::allocate_shared<type>(
+                std::pmr::polymorphic_allocator<type>{m_memory_resource});
+            if (auto result = serialize_one(*loaded); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            pointer = std::move(loaded);
+            return {};
+        } else {
+            auto loaded = access::make_unique<type>();
+            if (auto result = serialize_one(*loaded); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            pointer.reset(loaded.release());
+            return {};
+        }
     }
 
     ZPP_BITS_INLINE constexpr errc
@@ -3003,7 +3616,7 @@ private:
         constexpr auto size = std::remove_cvref_t<decltype(bitset)>{}.size();
         constexpr auto size_in_bytes = (size + (CHAR_BIT - 1)) / CHAR_BIT;
 
-        if (size_in_bytes > m_data.size() - m_position)
+        if (bounds_checked && size_in_bytes > m_data.size() - m_position)
             [[unlikely]] {
             return std::errc::result_out_of_range;
         }
@@ -3050,6 +3663,10 @@ private:
 
     view_type m_data{};
     std::size_t m_position{};
+    [[no_unique_address]] std::conditional_t<has_memory_resource,
+                                             std::pmr::memory_resource *,
+                                             std::monostate>
+        m_memory_resource{};
 };
 
 template <typename Type, std::size_t Size, typename... Options>
@@ -3413,13 +4030,13 @@ struct [[nodiscard]] value_or_errc
     }
 
     constexpr explicit value_or_errc(error_type error) :
-        m_error(std::forward<decltype(error)>(error))
+        m_error(std::forward<decltype(error)>(error)), m_failure(true)
     {
     }
 
     constexpr value_or_errc(value_or_errc && other) noexcept
     {
-        if (other.is_value()) {
+        if (other.success()) {
             if constexpr (!std::is_void_v<Type>) {
                 if constexpr (!std::is_reference_v<Type>) {
                     ::new (std::addressof(m_return_value))
@@ -3548,35 +4165,273 @@ struct [[nodiscard]] value_or_errc
     bool m_failure{};
 };
 
-ZPP_BITS_INLINE constexpr auto
-apply(auto && function, auto && archive) requires(
-    std::remove_cvref_t<decltype(archive)>::kind() == kind::in)
+template <typename Container, typename OffsetType = std::uint64_t>
+class serialized_view;
+
+template <typename Container, typename OffsetType = std::uint64_t>
+struct indexed_item_ref
 {
-    using function_type = std::decay_t<decltype(function)>;
+    using value_type = typename std::remove_cvref_t<Container>::value_type;
 
-    if constexpr (requires { &function_type::operator(); }) {
-        using parameters_type =
-            function_parameters_t<decltype(&function_type::operator())>;
-        using return_type =
-            function_return_type_t<decltype(&function_type::operator())>;
-        if constexpr (std::is_void_v<parameters_type>) {
-            return std::forward<decltype(function)>(function)();
-        } else {
-            parameters_type parameters;
-            if constexpr (std::is_void_v<return_type>) {
-                if (auto result = archive(parameters); failure(result))
-                    [[unlikely]] {
-                    return result;
+    constexpr static auto is_bytes =
+        concepts::byte_serializable<value_type>;
+
+    constexpr explicit indexed_item_ref(Container && value) :
+        value(std::forward<Container>(value))
+    {
+    }
+
+    constexpr static auto padding(std::size_t position)
+    {
+        return (alignof(value_type) - position % alignof(value_type)) %
+               alignof(value_type);
+    }
+
+    ZPP_BITS_INLINE constexpr static errc serialize(auto & archive,
+                                                    auto & self)
+    {
+        using archive_type = std::remove_cvref_t<decltype(archive)>;
+        if constexpr (archive_type::kind() == kind::out) {
+            auto size = OffsetType(self.value.size());
+            if (auto result = archive(size); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            if constexpr (is_bytes) {
+                for (auto pad = padding(archive.position()); pad; --pad) {
+                    if (auto result = archive(std::byte{});
+                        failure(result)) [[unlikely]] {
+                        return result;
+                    }
                 }
-                std::apply(std::forward<decltype(function)>(function),
-                           std::move(parameters));
-                return errc{};
+                return archive(unsized(self.value));
             } else {
-                if (auto result = archive(parameters); failure(result))
-                    [[unlikely]] {
-                    return value_or_errc<return_type>{result};
+                auto table = archive.position();
+                for (OffsetType i = 0; i <= size; ++i) {
+                    if (auto result = archive(OffsetType{});
+                        failure(result)) [[unlikely]] {
+                        return result;
+                    }
                 }
-                return value_or_errc<return_type>{
+
+                auto elements = archive.position();
+                auto write_offset = [&](std::size_t index) {
+                    auto position = archive.position();
+                    archive.position() = table + index * sizeof(OffsetType);
+                    auto result = archive(OffsetType(position - elements));
+                    archive.position() = position;
+                    return result;
+                };
+
+                std::size_t index = 0;
+                for (auto & item : self.value) {
+                    if (auto result = write_offset(index++); failure(result))
+                        [[unlikely]] {
+                        return result;
+                    }
+                    if (auto result = archive(item); failure(result))
+                        [[unlikely]] {
+                        return result;
+                    }
+                }
+                return write_offset(index);
+            }
+        } else {
+            OffsetType size{};
+            if (auto result = archive(size); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            auto remaining = archive.remaining_data().size();
+            if constexpr (is_bytes) {
+                auto pad = padding(archive.position());
+                if (pad > remaining ||
+                    size > (remaining - pad) / sizeof(value_type))
+                    [[unlikely]] {
+                    return errc{std::errc::result_out_of_range};
+                }
+                archive.position() += pad;
+            } else {
+                if (size >= remaining / sizeof(OffsetType)) [[unlikely]] {
+                    return errc{std::errc::result_out_of_range};
+                }
+                archive.position() +=
+                    (std::size_t(size) + 1) * sizeof(OffsetType);
+            }
+
+            self.value.resize(size);
+            if constexpr (is_bytes) {
+                return archive(unsized(self.value));
+            } else {
+                for (auto & item : self.value) {
+                    if (auto result = archive(item); failure(result))
+                        [[unlikely]] {
+                        return result;
+                    }
+                }
+                return errc{};
+            }
+        }
+    }
+
+    Container && value;
+};
+
+template <typename OffsetType = std::uint64_t, typename Type>
+constexpr auto indexed(Type && value)
+{
+    return indexed_item_ref<Type &, OffsetType>(value);
+}
+
+template <typename Type, typename Allocator, typename OffsetType>
+class serialized_view<std::vector<Type, Allocator>, OffsetType>
+{
+public:
+    using value_type = Type;
+
+    constexpr static auto is_bytes =
+        indexed_item_ref<std::vector<Type, Allocator> &,
+                         OffsetType>::is_bytes;
+
+    constexpr std::size_t size() const
+    {
+        return m_size;
+    }
+
+    constexpr bool empty() const
+    {
+        return !m_size;
+    }
+
+    auto span() const requires is_bytes
+    {
+        using result_type = value_or_errc<std::span<const Type>>;
+        if (reinterpret_cast<std::uintptr_t>(m_elements.data()) %
+            alignof(Type)) [[unlikely]] {
+            return result_type{errc{std::errc::invalid_argument}};
+        }
+        return result_type{std::span{
+            reinterpret_cast<const Type *>(m_elements.data()), m_size}};
+    }
+
+    auto get(std::size_t index, auto... option) const
+    {
+        using result_type = value_or_errc<Type>;
+        if (index >= m_size) [[unlikely]] {
+            return result_type{errc{std::errc::result_out_of_range}};
+        }
+
+        Type value{};
+        if constexpr (is_bytes) {
+            std::memcpy(&value,
+                        m_elements.data() + index * sizeof(Type),
+                        sizeof(Type));
+        } else {
+            OffsetType begin{};
+            OffsetType end{};
+            if (auto result = in{m_table.subspan(index * sizeof(OffsetType),
+                                                 2 * sizeof(OffsetType)),
+                                 decltype(option)(option)...}(begin, end);
+                failure(result)) [[unlikely]] {
+                return result_type{result};
+            }
+            if (begin > end || end > m_elements.size()) [[unlikely]] {
+                return result_type{errc{std::errc::result_out_of_range}};
+            }
+            if (auto result = in{m_elements.subspan(begin, end - begin),
+                                 decltype(option)(option)...}(value);
+                failure(result)) [[unlikely]] {
+                return result_type{result};
+            }
+        }
+        return result_type{std::move(value)};
+    }
+
+    Type operator[](std::size_t index) const
+    {
+        return get(index).or_throw();
+    }
+
+    ZPP_BITS_INLINE constexpr static errc serialize(auto & archive,
+                                                    auto & self)
+        requires(std::remove_cvref_t<decltype(archive)>::kind() == kind::in)
+    {
+        using indexed_type =
+            indexed_item_ref<std::vector<Type, Allocator> &, OffsetType>;
+
+        OffsetType size{};
+        if (auto result = archive(size); failure(result)) [[unlikely]] {
+            return result;
+        }
+
+        auto data = std::as_bytes(archive.remaining_data());
+        if constexpr (is_bytes) {
+            auto pad = indexed_type::padding(archive.position());
+            if (pad > data.size() ||
+                size > (data.size() - pad) / sizeof(Type)) [[unlikely]] {
+                return errc{std::errc::result_out_of_range};
+            }
+            self.m_elements = data.subspan(pad, size * sizeof(Type));
+            archive.position() += pad + self.m_elements.size();
+        } else {
+            if (size >= data.size() / sizeof(OffsetType)) [[unlikely]] {
+                return errc{std::errc::result_out_of_range};
+            }
+            self.m_table = data.first((size + 1) * sizeof(OffsetType));
+            archive.position() += size * sizeof(OffsetType);
+
+            OffsetType end{};
+            if (auto result = archive(end); failure(result)) [[unlikely]] {
+                return result;
+            }
+            if (end > archive.remaining_data().size()) [[unlikely]] {
+                return errc{std::errc::result_out_of_range};
+            }
+            self.m_elements = data.subspan(self.m_table.size(), end);
+            archive.position() += end;
+        }
+
+        self.m_size = size;
+        return errc{};
+    }
+
+private:
+    std::span<const std::byte> m_table;
+    std::span<const std::byte> m_elements;
+    std::size_t m_size{};
+};
+
+ZPP_BITS_INLINE constexpr auto
+apply(auto && function, auto && archive) requires(
+    std::remove_cvref_t<decltype(archive)>::kind() == kind::in)
+{
+    using function_type = std::decay_t<decltype(function)>;
+
+    if constexpr (requires { &function_type::operator(); }) {
+        using parameters_type =
+            function_parameters_t<decltype(&function_type::operator())>;
+        using return_type =
+            function_return_type_t<decltype(&function_type::operator())>;
+        if constexpr (std::is_void_v<parameters_type>) {
+            return std::forward<decltype(function)>(function)();
+        } else {
+            parameters_type parameters;
+            if constexpr (std::is_void_v<return_type>) {
+                if (auto result = archive(parameters); failure(result))
+                    [[unlikely]] {
+                    return result;
+                }
+                std::apply(std::forward<decltype(function)>(function),
+                           std::move(parameters));
+                return errc{};
+            } else {
+                if (auto result = archive(parameters); failure(result))
+                    [[unlikely]] {
+                    return value_or_errc<return_type>{result};
+                }
+                return value_or_errc<return_type>{
                     std::apply(std::forward<decltype(function)>(function),
                                std::move(parameters))};
             }
@@ -4507,6 +5362,24 @@ struct pb
         };
     }
 
+    /**
+     * Whether the type is a view of bytes, such as std::string_view or
+     * std::span<const std::byte>, decoded in place pointing into the input.
+     */
+    template <typename Type>
+    constexpr static auto is_byte_view()
+    {
+        using type = std::remove_cvref_t<Type>;
+        return requires
+        {
+            requires sizeof(typename type::value_type) == 1;
+            requires std::is_const_v<std::remove_reference_t<decltype(
+                std::declval<type &>()[0])>>;
+            type{std::declval<const typename type::value_type *>(),
+                 std::size_t{}};
+        };
+    }
+
     template <typename Type>
     constexpr static auto check_type()
     {
@@ -4515,7 +5388,11 @@ struct pb
             return check_type<typename type::pb_field_type>();
         } else if constexpr (!std::is_class_v<type> ||
                              concepts::varint<type> ||
-                             concepts::empty<type>) {
+                             concepts::empty<type> ||
+                             is_byte_view<type>()) {
+            return true;
+        } else if constexpr (concepts::optional<type>) {
+            static_assert(check_type<typename type::value_type>());
             return true;
         } else if constexpr (concepts::associative_container<type> &&
                              requires { typename type::mapped_type; }) {
@@ -4540,7 +5417,9 @@ struct pb
                 std::same_as<pb_default,
                              typename decltype(access::get_protocol<
                                                type>())::pb_default>);
-            static_assert(unique_field_numbers<type>());
+            // Field numbers are mapped by the options of the type itself.
+            static_assert(decltype(access::get_protocol<type>())::
+                              template unique_field_numbers<type>());
             return true;
         } else {
             static_assert(!sizeof(Type));
@@ -4720,6 +5599,11 @@ struct pb
 
         if constexpr (concepts::empty<type>) {
             return {};
+        } else if constexpr (concepts::optional<type>) {
+            if (!item) {
+                return {};
+            }
+            return serialize_one<Index, TagType>(archive, *item);
         } else if constexpr (is_pb_field<type>()) {
             return serialize_one<Index, tag_type>(
                 archive,
@@ -4859,15 +5743,29 @@ struct pb
         requires(std::remove_cvref_t<decltype(archive)>::kind() ==
                  kind::in)
     {
+        using archive_type = std::remove_cvref_t<decltype(archive)>;
         auto data = archive.remaining_data();
-        in in{std::span{data.data(), std::min(size, data.size())},
-              size_varint{},
-              endian::little{},
-              alloc_limit<std::remove_cvref_t<
-                  decltype(archive)>::allocation_limit>{}};
-        auto result = deserialize_fields(in, item);
-        archive.position() += in.position();
-        return result;
+        auto view = std::span{data.data(), std::min(size, data.size())};
+
+        // Nested messages decode from the memory resource of the archive.
+        if constexpr (archive_type::has_memory_resource) {
+            in in{view,
+                  size_varint{},
+                  endian::little{},
+                  alloc_limit<archive_type::allocation_limit>{},
+                  memory_resource{*archive.allocation_resource()}};
+            auto result = deserialize_fields(in, item);
+            archive.position() += in.position();
+            return result;
+        } else {
+            in in{view,
+                  size_varint{},
+                  endian::little{},
+                  alloc_limit<archive_type::allocation_limit>{}};
+            auto result = deserialize_fields(in, item);
+            archive.position() += in.position();
+            return result;
+        }
     }
 
     ZPP_BITS_INLINE constexpr static errc
@@ -4878,15 +5776,20 @@ struct pb
 
         auto size = archive.data().size();
         visit_members(
-            item, [](auto &&... members) ZPP_BITS_CONSTEXPR_INLINE_LAMBDA {
+            item, [&](auto &&... members) ZPP_BITS_CONSTEXPR_INLINE_LAMBDA {
                 (
-                    [](auto && member) ZPP_BITS_CONSTEXPR_INLINE_LAMBDA {
+                    [&](auto && member) ZPP_BITS_CONSTEXPR_INLINE_LAMBDA {
                         using type = std::remove_cvref_t<decltype(member)>;
-                        if constexpr (concepts::container<type> &&
-                                      !std::is_fundamental_v<type> &&
-                                      !std::same_as<type, std::byte> &&
-                                      requires { member.clear(); }) {
+                        if constexpr (is_byte_view<type>()) {
+                            member = {};
+                        } else if constexpr (concepts::optional<type>) {
+                            member.reset();
+                        } else if constexpr (concepts::container<type> &&
+                                             !std::is_fundamental_v<type> &&
+                                             !std::same_as<type, std::byte> &&
+                                             requires { member.clear(); }) {
                             member.clear();
+                            archive.use_memory_resource(member);
                         }
                     }(members),
                     ...);
@@ -4908,6 +5811,53 @@ struct pb
         return {};
     }
 
+    /**
+     * Decodes a packed repeated varint field of `length` bytes at once,
+     * appending its values to item, see varints.
+     */
+    static errc deserialize_varints(auto & archive,
+                                    auto & item,
+                                    std::size_t length)
+    {
+        using archive_type = std::remove_cvref_t<decltype(archive)>;
+        using value_type =
+            typename std::remove_cvref_t<decltype(item)>::value_type;
+
+        auto data = archive.remaining_data();
+        if (length > data.size()) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+        auto field =
+            std::span{reinterpret_cast<const std::byte *>(data.data()), length};
+
+        auto count = varints::count(field);
+        auto size = item.size();
+        if constexpr (archive_type::allocation_limit !=
+                      std::numeric_limits<std::size_t>::max()) {
+            if (size + count >
+                archive_type::allocation_limit / sizeof(value_type))
+                [[unlikely]] {
+                return std::errc::message_size;
+            }
+        }
+        item.resize(size + count);
+
+        std::size_t position = 0;
+        if (auto result =
+                varints::decode(field, position, item.data() + size, count);
+            failure(result)) [[unlikely]] {
+            return result;
+        }
+
+        // The last value runs past the end of the field.
+        if (position != length) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+
+        archive.position() += length;
+        return {};
+    }
+
     template <std::size_t Index = 0>
     ZPP_BITS_INLINE constexpr static auto
     deserialize_field(auto & archive,
@@ -4920,7 +5870,7 @@ struct pb
             if (!field_num) [[unlikely]] {
                 return errc{std::errc::protocol_error};
             }
-            return errc{};
+            return skip_field(archive, field_type);
         } else if (field_number_from_struct<type, Index>() != field_num) {
             return deserialize_field<Index + 1>(
                 archive, item, field_num, field_type);
@@ -4949,6 +5899,44 @@ struct pb
         }
     }
 
+    /**
+     * Skips the value of a field with no member to decode into, i.e. an
+     * unknown or a reserved field, by its wire type.
+     */
+    ZPP_BITS_INLINE constexpr static errc skip_field(auto & archive,
+                                                     wire_type field_type)
+    {
+        std::size_t length = 0;
+        switch (field_type) {
+        case wire_type::varint: {
+            vuint64_t value;
+            return archive(value);
+        }
+        case wire_type::fixed_64:
+            length = sizeof(std::uint64_t);
+            break;
+        case wire_type::fixed_32:
+            length = sizeof(std::uint32_t);
+            break;
+        case wire_type::length_delimited: {
+            vsize_t size;
+            if (auto result = archive(size); failure(result)) [[unlikely]] {
+                return result;
+            }
+            length = size;
+            break;
+        }
+        default:
+            return std::errc::protocol_error;
+        }
+
+        if (length > archive.remaining_data().size()) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+        archive.position() += length;
+        return {};
+    }
+
     ZPP_BITS_INLINE constexpr static auto deserialize_field(
         auto & archive, wire_type field_type, auto & item)
     {
@@ -4956,7 +5944,14 @@ struct pb
         using archive_type = std::remove_reference_t<decltype(archive)>;
         static_assert(check_type<type>());
 
-        if constexpr (std::is_enum_v<type>) {
+        if constexpr (concepts::empty<type>) {
+            return skip_field(archive, field_type);
+        } else if constexpr (concepts::optional<type>) {
+            if (!item) {
+                item.emplace();
+            }
+            return deserialize_field(archive, field_type, *item);
+        } else if constexpr (std::is_enum_v<type>) {
             varint<type> value;
             if (auto result = archive(value); failure(result))
                 [[unlikely]] {
@@ -4971,6 +5966,21 @@ struct pb
                 static_cast<typename type::pb_field_type &>(item));
         } else if constexpr (!concepts::container<type>) {
             return archive(item);
+        } else if constexpr (is_byte_view<type>()) {
+            vsize_t length;
+            if (auto result = archive(length); failure(result)) [[unlikely]] {
+                return result;
+            }
+            auto data = archive.remaining_data();
+            if (length > data.size()) [[unlikely]] {
+                return errc{std::errc::result_out_of_range};
+            }
+            item = type{
+                reinterpret_cast<const typename type::value_type *>(
+                    data.data()),
+                length};
+            archive.position() += length;
+            return errc{};
         } else if constexpr (concepts::associative_container<type> &&
                              requires { typename type::mapped_type; }) {
             using key_type = std::conditional_t<
@@ -5061,6 +6071,17 @@ struct pb
                     item.resize(length / sizeof(value_type));
                     return archive(unsized(item));
                 } else {
+                    if constexpr (requires {
+                                      item.resize(1);
+                                      item.data();
+                                  } &&
+                                  concepts::varint<value_type> &&
+                                  std::same_as<value_type, orig_value_type> &&
+                                  varints::enabled) {
+                        if (!std::is_constant_evaluated()) {
+                            return deserialize_varints(archive, item, length);
+                        }
+                    }
                     if constexpr (requires { item.reserve(1); }) {
                         item.reserve(length);
                     }
@@ -5270,7 +6291,8 @@ constexpr auto sha1()
         original_message,
         std::byte{0x80},
         std::array<std::byte,
-                   align(original_message.size() + sizeof(std::byte{0x80}),
+                   align(original_message.size() + sizeof(std::byte{0x80}) +
+                             sizeof(std::uint64_t{original_message.size()}),
                          chunk_size) -
                        original_message.size() - sizeof(std::byte{0x80}) -
                        sizeof(std::uint64_t{original_message.size()})>{},
@@ -5395,7 +6417,8 @@ constexpr auto sha256()
         original_message,
         std::byte{0x80},
         std::array<std::byte,
-                   align(original_message.size() + sizeof(std::byte{0x80}),
+                   align(original_message.size() + sizeof(std::byte{0x80}) +
+                             sizeof(std::uint64_t{original_message.size()}),
                          chunk_size) -
                        original_message.size() - sizeof(std::byte{0x80}) -
                        sizeof(std::uint64_t{original_message.size()})>{},
@@ -5463,6 +6486,490 @@ constexpr auto sha256()
     return digest;
 }
 
+namespace schema
+{
+/**
+ * Schema hashes of types, see schema_checked(). The description of a type
+ * is an array of integers, a tag for the kind of type, its sizes, and the
+ * hashes of the types it is made of, and its hash is the first 64 bits of
+ * the sha256 of the description, so that a type of any size is hashed a
+ * node at a time. The sizes of arithmetic types and of trivially copyable
+ * aggregates are part of their description, as is the byte order, since
+ * their serialized images depend on them.
+ */
+template <typename Type, typename... Visited>
+constexpr std::uint64_t hash();
+
+template <typename Type>
+using members = decltype(visit_members_types<Type>([]<typename... Types>() {
+    return std::type_identity<std::tuple<Types...>>{};
+}));
+
+template <typename Type>
+constexpr auto layout()
+{
+    if constexpr (std::is_trivially_copyable_v<Type>) {
+        return std::array<std::uint64_t, 2>{sizeof(Type), alignof(Type)};
+    } else {
+        return std::array<std::uint64_t, 2>{};
+    }
+}
+
+template <typename Type, typename... Visited>
+constexpr auto description()
+{
+    using type = std::remove_cvref_t<Type>;
+    using tag = std::uint64_t;
+
+    if constexpr ((... || std::same_as<type, Visited>)) {
+        constexpr auto depth = [] {
+            std::size_t depth = 0;
+            for (auto visited : {std::same_as<type, Visited>...}) {
+                if (visited) {
+                    break;
+                }
+                ++depth;
+            }
+            return depth;
+        }();
+        return std::array<tag, 2>{'r', depth};
+    } else if constexpr (std::same_as<type, bool>) {
+        return std::array<tag, 1>{'b'};
+    } else if constexpr (std::is_integral_v<type> ||
+                         std::is_floating_point_v<type>) {
+        return std::array<tag, 3>{
+            std::is_floating_point_v<type> ? 'f'
+            : std::is_signed_v<type>       ? 'i'
+                                           : 'u',
+            sizeof(type),
+            std::endian::native == std::endian::little};
+    } else if constexpr (std::is_enum_v<type>) {
+        return std::array<tag, 2>{'e',
+                                  hash<std::underlying_type_t<type>>()};
+    } else if constexpr (std::is_array_v<type>) {
+        return std::array<tag, 3>{
+            'a',
+            std::extent_v<type>,
+            hash<std::remove_extent_t<type>, Visited...>()};
+    } else if constexpr (requires {
+                             typename type::element_type;
+                             typename type::deleter_type;
+                             requires !traits::is_unique_ptr<type>::value;
+                             requires std::derived_from<
+                                 type,
+                                 std::unique_ptr<
+                                     typename type::element_type,
+                                     typename type::deleter_type>>;
+                         }) {
+        // optional_ptr, serialized as an optional.
+        return std::array<tag, 2>{
+            'o', hash<typename type::element_type, Visited...>()};
+    } else if constexpr (concepts::variant<type>) {
+        return []<std::size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            return std::array<tag, 1 + sizeof...(Indices)>{
+                'V',
+                hash<std::variant_alternative_t<Indices, type>,
+                     Visited...>()...};
+        }
+        (std::make_index_sequence<std::variant_size_v<type>>{});
+    } else if constexpr (concepts::optional<type>) {
+        return std::array<tag, 2>{
+            'o', hash<typename type::value_type, Visited...>()};
+    } else if constexpr (concepts::owning_pointer<type>) {
+        return std::array<tag, 2>{
+            'p', hash<typename type::element_type, Visited...>()};
+    } else if constexpr (concepts::associative_container<type>) {
+        if constexpr (requires { typename type::mapped_type; }) {
+            return std::array<tag, 3>{
+                'm',
+                hash<typename type::key_type, Visited...>(),
+                hash<typename type::mapped_type, Visited...>()};
+        } else {
+            return std::array<tag, 2>{
+                's', hash<typename type::key_type, Visited...>()};
+        }
+    } else if constexpr (concepts::container<type>) {
+        if constexpr (requires { std::tuple_size<type>::value; }) {
+            return std::array<tag, 3>{
+                'a',
+                std::tuple_size_v<type>,
+                hash<typename type::value_type, Visited...>()};
+        } else {
+            return std::array<tag, 2>{
+                'v', hash<typename type::value_type, Visited...>()};
+        }
+    } else if constexpr (concepts::tuple<type>) {
+        return []<std::size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            return std::array<tag, 1 + sizeof...(Indices)>{
+                't',
+                hash<std::tuple_element_t<Indices, type>, Visited...>()...};
+        }
+        (std::make_index_sequence<std::tuple_size_v<type>>{});
+    } else if constexpr (concepts::bitset<type>) {
+        return std::array<tag, 2>{'B', type{}.size()};
+    } else if constexpr (concepts::empty<type>) {
+        return std::array<tag, 1>{'0'};
+    } else if constexpr (number_of_members<type>() > 0) {
+        return []<typename... Types>(std::type_identity<std::tuple<Types...>>)
+        {
+            return std::array<tag, 3 + sizeof...(Types)>{
+                '{',
+                layout<type>()[0],
+                layout<type>()[1],
+                hash<Types, type, Visited...>()...};
+        }
+        (members<type>{});
+    } else {
+        // Serialized by a serialize function of its own, which cannot be
+        // looked into.
+        return std::array<tag, 3>{'x', layout<type>()[0], layout<type>()[1]};
+    }
+}
+
+template <typename Type, typename... Visited>
+constexpr std::uint64_t hash()
+{
+    constexpr auto description = schema::description<Type, Visited...>();
+    return id_v<sha256<description>(), sizeof(std::uint64_t)>;
+}
+
+/**
+ * Whether the type is serialized by schema_checked() as its object
+ * representation, i.e, a trivially copyable type of arithmetic types,
+ * enumerations, arrays, and aggregates of them, including the padding.
+ */
+template <typename Type>
+constexpr bool image()
+{
+    using type = std::remove_cvref_t<Type>;
+
+    if constexpr (!std::is_trivially_copyable_v<type> ||
+                  concepts::has_explicit_serialize<type>) {
+        return false;
+    } else if constexpr (std::is_arithmetic_v<type> ||
+                         std::is_enum_v<type>) {
+        return true;
+    } else if constexpr (std::is_array_v<type>) {
+        return image<std::remove_extent_t<type>>();
+    } else if constexpr (concepts::container<type>) {
+        if constexpr (requires { std::tuple_size<type>::value; }) {
+            return image<typename type::value_type>();
+        } else {
+            return false;
+        }
+    } else if constexpr (concepts::variant<type> ||
+                         concepts::optional<type> ||
+                         concepts::tuple<type> || concepts::bitset<type> ||
+                         concepts::empty<type>) {
+        return false;
+    } else if constexpr (number_of_members<type>() > 0) {
+        return []<typename... Types>(std::type_identity<std::tuple<Types...>>)
+        {
+            return (... && image<Types>());
+        }
+        (members<type>{});
+    } else {
+        return false;
+    }
+}
+} // namespace schema
+
+/**
+ * The schema hash of a type, derived at compile time from its members
+ * types, see schema::description().
+ */
+template <typename Type>
+constexpr auto schema_hash_v = schema::hash<std::remove_cvref_t<Type>>();
+
+/**
+ * An object serialized after the schema hash of its type, for data read
+ * back by other builds, e.g. checkpoints.
+ *
+ * A trivially copyable aggregate, see schema::image(), or a contiguous
+ * container of them, is serialized as its object representation, padding
+ * included, and deserialized by a single memcpy, once the hash shows that
+ * it was written with the same layout. Other types are serialized as by
+ * the archive. If the hash does not match, the archive is left at the
+ * hash and `std::errc::protocol_error` is returned, so that the data can
+ * be read again as the type of an older schema.
+ */
+template <typename Type>
+struct schema_checked_item_ref
+{
+    using type = std::remove_cvref_t<Type>;
+
+    constexpr static auto hash = schema_hash_v<type>;
+
+    constexpr static auto is_image = schema::image<type>();
+
+    constexpr static auto is_image_range = requires(type & value)
+    {
+        requires !is_image;
+        requires concepts::container<type>;
+        requires std::ranges::contiguous_range<type>;
+        requires schema::image<typename type::value_type>();
+    };
+
+    constexpr explicit schema_checked_item_ref(Type && value) :
+        value(std::forward<Type>(value))
+    {
+    }
+
+    static errc serialize(auto & archive, auto & self)
+    {
+        using archive_type = std::remove_cvref_t<decltype(archive)>;
+        if constexpr (archive_type::kind() == kind::out) {
+            if (auto result = archive(hash); failure(result)) [[unlikely]] {
+                return result;
+            }
+
+            if constexpr (is_image) {
+                return write_bytes(
+                    archive, std::addressof(self.value), sizeof(type));
+            } else if constexpr (is_image_range) {
+                if (auto result = archive(std::uint64_t(self.value.size()));
+                    failure(result)) [[unlikely]] {
+                    return result;
+                }
+                return write_bytes(archive,
+                                   std::data(self.value),
+                                   self.value.size() *
+                                       sizeof(typename type::value_type));
+            } else {
+                return archive(self.value);
+            }
+        } else {
+            auto position = archive.position();
+            std::uint64_t written_hash{};
+            if (auto result = archive(written_hash); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            if (written_hash != hash) [[unlikely]] {
+                archive.position() = position;
+                return std::errc::protocol_error;
+            }
+
+            if constexpr (is_image) {
+                return read_bytes(
+                    archive, std::addressof(self.value), sizeof(type));
+            } else if constexpr (is_image_range) {
+                using value_type = typename type::value_type;
+                std::uint64_t size{};
+                if (auto result = archive(size); failure(result))
+                    [[unlikely]] {
+                    return result;
+                }
+
+                if (size > archive.remaining_data().size() /
+                               sizeof(value_type)) [[unlikely]] {
+                    return std::errc::result_out_of_range;
+                }
+
+                if constexpr (archive_type::allocation_limit !=
+                              std::numeric_limits<std::size_t>::max()) {
+                    if (size > archive_type::allocation_limit /
+                                   sizeof(value_type)) [[unlikely]] {
+                        return std::errc::message_size;
+                    }
+                }
+
+                self.value.resize(size);
+                return read_bytes(archive,
+                                  std::data(self.value),
+                                  size * sizeof(value_type));
+            } else {
+                return archive(self.value);
+            }
+        }
+    }
+
+    static errc
+    write_bytes(auto & archive, const void * data, std::size_t size)
+    {
+        if constexpr (std::remove_cvref_t<decltype(archive)>::resizable) {
+            if (auto result = archive.enlarge_for(size); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+        }
+
+        auto remaining = archive.remaining_data();
+        if (size > remaining.size()) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+
+        if (size) {
+            std::memcpy(remaining.data(), data, size);
+        }
+        archive.position() += size;
+        return {};
+    }
+
+    static errc read_bytes(auto & archive, void * data, std::size_t size)
+    {
+        auto remaining = archive.remaining_data();
+        if (size > remaining.size()) [[unlikely]] {
+            return std::errc::result_out_of_range;
+        }
+
+        if (size) {
+            std::memcpy(data, remaining.data(), size);
+        }
+        archive.position() += size;
+        return {};
+    }
+
+    Type && value;
+};
+
+/**
+ * Serializes or deserializes the object after the schema hash of its
+ * type, see schema_checked_item_ref.
+ */
+template <typename Type>
+constexpr auto schema_checked(Type && value)
+{
+    return schema_checked_item_ref<Type &>(value);
+}
+
+namespace bounded
+{
+constexpr auto unbounded = std::numeric_limits<std::size_t>::max();
+
+constexpr std::size_t add(std::same_as<std::size_t> auto... sizes)
+{
+    std::size_t total = 0;
+    for (auto size : {std::size_t{}, sizes...}) {
+        if (size > unbounded - total) {
+            return unbounded;
+        }
+        total += size;
+    }
+    return total;
+}
+
+constexpr std::size_t multiply(std::size_t count, std::size_t size)
+{
+    if (size && count > unbounded / size) {
+        return unbounded;
+    }
+    return count * size;
+}
+
+/**
+ * The largest number of bytes an object of the type serializes to, or
+ * `unbounded`. Arithmetic types, enumerations, bitsets, varints, fixed
+ * size arrays, optionals, variants, tuples, and aggregates of them are
+ * bounded. Containers of a dynamic size, pointers, and types serialized
+ * by a serialize function of their own are not.
+ */
+template <typename Type>
+constexpr std::size_t max_size()
+{
+    using type = std::remove_cvref_t<Type>;
+
+    if constexpr (concepts::varint<type>) {
+        return varint_max_size<typename type::value_type>;
+    } else if constexpr (concepts::has_explicit_serialize<type>) {
+        return unbounded;
+    } else if constexpr (std::is_fundamental_v<type> ||
+                         std::is_enum_v<type>) {
+        return sizeof(type);
+    } else if constexpr (std::is_array_v<type>) {
+        return multiply(std::extent_v<type>,
+                        max_size<std::remove_extent_t<type>>());
+    } else if constexpr (concepts::variant<type>) {
+        return []<std::size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            return add(
+                max_size<decltype(traits::variant<type>::template id<0>())>(),
+                std::max({max_size<
+                    std::variant_alternative_t<Indices, type>>()...}));
+        }
+        (std::make_index_sequence<std::variant_size_v<type>>{});
+    } else if constexpr (concepts::optional<type>) {
+        return add(sizeof(std::byte),
+                   max_size<typename type::value_type>());
+    } else if constexpr (concepts::owning_pointer<type>) {
+        return unbounded;
+    } else if constexpr (concepts::container<type>) {
+        if constexpr (!concepts::associative_container<type> &&
+                      requires { std::tuple_size<type>::value; }) {
+            return multiply(std::tuple_size_v<type>,
+                            max_size<typename type::value_type>());
+        } else {
+            return unbounded;
+        }
+    } else if constexpr (concepts::tuple<type>) {
+        return []<std::size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            return add(max_size<std::tuple_element_t<Indices, type>>()...);
+        }
+        (std::make_index_sequence<std::tuple_size_v<type>>{});
+    } else if constexpr (concepts::bitset<type>) {
+        return (type{}.size() + (CHAR_BIT - 1)) / CHAR_BIT;
+    } else if constexpr (concepts::empty<type>) {
+        return 0;
+    } else if constexpr (number_of_members<type>() > 0) {
+        return []<typename... Types>(std::type_identity<std::tuple<Types...>>)
+        {
+            return add(max_size<Types>()...);
+        }
+        (schema::members<type>{});
+    } else {
+        return unbounded;
+    }
+}
+} // namespace bounded
+
+namespace concepts
+{
+template <typename Type>
+concept bounded = bounded::max_size<Type>() != bounded::unbounded;
+} // namespace concepts
+
+/**
+ * The largest number of bytes the objects of the types serialize to,
+ * computed at compile time, see bounded::max_size().
+ */
+template <typename... Types>
+constexpr std::size_t max_serialized_size()
+{
+    static_assert((... && concepts::bounded<Types>),
+                  "The serialized size of the types is not bounded.");
+    return bounded::add(bounded::max_size<Types>()...);
+}
+
+/**
+ * A buffer that fits the objects of the types, e.g. on the stack.
+ */
+template <typename... Types>
+using bounded_buffer = std::array<std::byte, max_serialized_size<Types...>()>;
+
+/**
+ * Archives over a buffer of a fixed size, e.g. a bounded_buffer, without
+ * bounds checks per field or enlarging. Each call checks once that the
+ * rest of the buffer fits max_serialized_size() of its items, which must
+ * be bounded, and otherwise fails with `std::errc::result_out_of_range`.
+ */
+constexpr auto bounded_output(auto && view, auto &&... option)
+{
+    return out(std::forward<decltype(view)>(view),
+               options::unchecked{},
+               std::forward<decltype(option)>(option)...);
+}
+
+constexpr auto bounded_input(auto && view, auto &&... option)
+{
+    return in(std::forward<decltype(view)>(view),
+              options::unchecked{},
+              std::forward<decltype(option)>(option)...);
+}
+
 inline namespace literals
 {
 inline namespace string_literals
@@ -0,0 +1,320 @@
+/*!
+  MPL 1.1/GPL 2.0/LGPL 2.1 tri-license
+  Copyright (C) 2022  Wuping Xin
+*/
+
+// Runtime benchmark of zpp::bits against msgpack on the same domain structs, a fixed-size
+// link state and a variable-size vehicle trajectory. Both write into and read from one
+// preallocated buffer, so the numbers are the cost of the wire format, not of allocation.
+// Build it optimized, e.g.
+//
+//   cmake -DCMAKE_BUILD_TYPE=Release . && cmake --build . --target zpp_bits_benchmark
+//
+// Each case reports nanoseconds per object and encoded bytes, and checks both round trips. The
+// chunked case compares zpp::bits::chunked, serializing on all hardware threads, with one thread.
+// The GTFS-RT case decodes a protobuf feed of vehicle positions with the zero-copy definitions of
+// zpp_bits_gtfs_rt.h, and with owning std::string and std::vector structs, allocating per string
+// and per repeated field as the stock protobuf runtime does.
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest/doctest.h>
+#include <msgpack/msgpack.hpp>
+#include <zpp_bits/zpp_bits.h>
+#include <zpp_bits/zpp_bits_gtfs_rt.h>
+#include <zpp_bits/zpp_bits_parallel.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int count = 1 << 16;
+
+struct LinkState
+{
+  int32_t link_id;
+  int32_t queue_length;
+  double density;
+  double flow;
+  double speed;
+
+  bool operator==(const LinkState &) const = default;
+};
+
+struct Waypoint
+{
+  int32_t link_id;
+  double time;
+  double position;
+
+  bool operator==(const Waypoint &) const = default;
+};
+
+struct VehicleTrajectory
+{
+  int64_t vehicle_id;
+  std::string vehicle_class;
+  std::vector<Waypoint> waypoints;
+
+  bool operator==(const VehicleTrajectory &) const = default;
+};
+
+namespace gtfs_rt = zpp::bits::gtfs_rt;
+
+/*!
+  The vehicle positions of a GTFS-RT feed, with owning strings and repeated fields.
+*/
+struct OwningTrip
+{
+  std::string trip_id;
+  std::string start_time;
+  std::string start_date;
+  gtfs_rt::trip_descriptor::schedule_relationship_type schedule_relationship{};
+  std::string route_id;
+  zpp::bits::vuint32_t direction_id{};
+
+  using serialize = zpp::bits::pb_protocol;
+};
+
+struct OwningVehicle
+{
+  std::string id;
+  std::string label;
+  std::string license_plate;
+
+  using serialize = zpp::bits::pb_protocol;
+};
+
+struct OwningVehiclePosition
+{
+  std::optional<OwningTrip> trip;
+  std::optional<gtfs_rt::position> position;
+  zpp::bits::vuint32_t current_stop_sequence{};
+  gtfs_rt::vehicle_position::vehicle_stop_status_type current_status{};
+  zpp::bits::vuint64_t timestamp{};
+  gtfs_rt::vehicle_position::congestion_level_type congestion_level{};
+  std::string stop_id;
+  std::optional<OwningVehicle> vehicle;
+
+  using serialize = zpp::bits::pb_members<8>;
+};
+
+struct OwningEntity
+{
+  std::string id;
+  bool is_deleted{};
+  std::optional<OwningVehiclePosition> vehicle;
+
+  using serialize = zpp::bits::protocol<zpp::bits::pb{zpp::bits::pb_map<3, 4>{}}, 3>;
+};
+
+struct OwningFeed
+{
+  struct Header
+  {
+    std::string gtfs_realtime_version;
+    gtfs_rt::feed_header::incrementality_type incrementality{};
+    zpp::bits::vuint64_t timestamp{};
+
+    using serialize = zpp::bits::pb_protocol;
+  };
+
+  Header header;
+  std::vector<OwningEntity> entity;
+
+  using serialize = zpp::bits::pb_protocol;
+};
+
+template<typename F>
+double time_per_object(F &&a_work)
+{
+  auto const start = std::chrono::steady_clock::now();
+  a_work();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+std::vector<LinkState> make_link_states()
+{
+  auto rng = std::mt19937{42};
+  auto uniform = std::uniform_real_distribution<double>{0.0, 120.0};
+  auto states = std::vector<LinkState>(count);
+  for (int32_t i = 0; auto &state : states) {
+    state = {i++, static_cast<int32_t>(uniform(rng)), uniform(rng), uniform(rng) * 20, uniform(rng)};
+  }
+  return states;
+}
+
+std::vector<VehicleTrajectory> make_trajectories()
+{
+  auto rng = std::mt19937{42};
+  auto lengths = std::uniform_int_distribution<int32_t>{1, 32};
+  auto trajectories = std::vector<VehicleTrajectory>(count);
+  for (int64_t id = 0; auto &trajectory : trajectories) {
+    trajectory.vehicle_id = id++;
+    trajectory.vehicle_class = id % 10 == 0 ? "heavy-goods-vehicle" : "passenger-car";
+    auto const length = lengths(rng);
+    for (int32_t i = 0; i < length; ++i) {
+      trajectory.waypoints.push_back({i * 7, i * 1.5, i * 40.25});
+    }
+  }
+  return trajectories;
+}
+
+std::vector<std::byte> make_vehicle_positions_feed()
+{
+  auto rng = std::mt19937{42};
+  auto uniform = std::uniform_real_distribution<float>{0.0f, 1.0f};
+  auto names = std::vector<std::string>(count);
+  auto feed = gtfs_rt::feed_message{};
+  feed.header = {.gtfs_realtime_version = "2.0", .timestamp = 1700000000};
+  for (int i = 0; auto &name : names) {
+    name = std::to_string(i++);
+    auto &vehicle = feed.entity.emplace_back(gtfs_rt::feed_entity{.id = name}).vehicle.emplace();
+    vehicle.trip = gtfs_rt::trip_descriptor{.trip_id = name, .start_date = "20231114", .route_id = "route 7"};
+    vehicle.position = gtfs_rt::position{.latitude = 40 + uniform(rng), .longitude = -73 - uniform(rng),
+                                         .bearing = 360 * uniform(rng), .speed = 20 * uniform(rng)};
+    vehicle.current_stop_sequence = i % 40;
+    vehicle.timestamp = 1700000000 - i % 30;
+    vehicle.stop_id = "stop 4";
+    vehicle.vehicle = gtfs_rt::vehicle_descriptor{.id = name, .label = name};
+  }
+
+  auto [data, out] = zpp::bits::data_out(zpp::bits::no_size{});
+  REQUIRE(zpp::bits::success(out(feed)));
+  return std::move(data);
+}
+
+/*!
+  Packs all objects back to back with msgpack::BasicPacker over a SpanSink, and unpacks them
+  with msgpack::Unpacker.
+*/
+template<typename T>
+void run_msgpack(const std::vector<T> &a_objects, std::vector<uint8_t> &a_buffer)
+{
+  auto packer = msgpack::BasicPacker{msgpack::SpanSink{std::span{a_buffer}}};
+  auto const pack_ns = time_per_object([&] {
+    for (auto const &object : a_objects) packer.process(object);
+  });
+  REQUIRE_FALSE(packer.ec);
+
+  auto const bytes = packer.sink().size();
+  auto decoded = std::vector<T>(a_objects.size());
+  auto unpacker = msgpack::Unpacker{a_buffer.data(), bytes};
+  auto const unpack_ns = time_per_object([&] {
+    for (auto &object : decoded) unpacker.process(object);
+  });
+  REQUIRE_FALSE(unpacker.ec);
+  CHECK(decoded == a_objects);
+
+  MESSAGE("msgpack:   pack ", pack_ns, " ns, unpack ", unpack_ns, " ns, ",
+          static_cast<double>(bytes) / count, " bytes per object");
+}
+
+/*!
+  Serializes all objects back to back with zpp::bits::out over a span, and deserializes them
+  with zpp::bits::in.
+*/
+template<typename T>
+void run_zpp_bits(const std::vector<T> &a_objects, std::vector<uint8_t> &a_buffer)
+{
+  auto out = zpp::bits::out{std::span{a_buffer}};
+  auto result = std::errc{};
+  auto const pack_ns = time_per_object([&] {
+    for (auto const &object : a_objects) {
+      if (result = out(object); zpp::bits::failure(result)) break;
+    }
+  });
+  REQUIRE(zpp::bits::success(result));
+
+  auto const bytes = out.position();
+  auto decoded = std::vector<T>(a_objects.size());
+  auto in = zpp::bits::in{std::span{a_buffer}.first(bytes)};
+  auto const unpack_ns = time_per_object([&] {
+    for (auto &object : decoded) {
+      if (result = in(object); zpp::bits::failure(result)) break;
+    }
+  });
+  REQUIRE(zpp::bits::success(result));
+  CHECK(decoded == a_objects);
+
+  MESSAGE("zpp::bits: pack ", pack_ns, " ns, unpack ", unpack_ns, " ns, ",
+          static_cast<double>(bytes) / count, " bytes per object");
+}
+
+}
+
+TEST_CASE("benchmark: link state")
+{
+  auto const states = make_link_states();
+  auto buffer = std::vector<uint8_t>(count * 64);
+  run_msgpack(states, buffer);
+  run_zpp_bits(states, buffer);
+}
+
+TEST_CASE("benchmark: vehicle trajectory")
+{
+  auto const trajectories = make_trajectories();
+  auto buffer = std::vector<uint8_t>(count * 1024);
+  run_msgpack(trajectories, buffer);
+  run_zpp_bits(trajectories, buffer);
+}
+
+TEST_CASE("benchmark: chunked vehicle trajectories")
+{
+  auto const trajectories = make_trajectories();
+  auto const threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (auto const thread_count : {1u, threads}) {
+    auto buffer = std::vector<uint8_t>(count * 1024);
+    auto out = zpp::bits::out{std::span{buffer}};
+    auto const pack_ns = time_per_object([&] {
+      REQUIRE(zpp::bits::success(out(zpp::bits::chunked(trajectories, 1024, thread_count))));
+    });
+
+    auto decoded = std::vector<VehicleTrajectory>{};
+    auto in = zpp::bits::in{std::span{buffer}.first(out.position())};
+    auto const unpack_ns = time_per_object([&] {
+      REQUIRE(zpp::bits::success(in(zpp::bits::chunked(decoded, 1024, thread_count))));
+    });
+    CHECK(decoded == trajectories);
+
+    MESSAGE("chunked on ", thread_count, " threads: pack ", pack_ns, " ns, unpack ", unpack_ns, " ns per object");
+  }
+}
+
+TEST_CASE("benchmark: gtfs-rt vehicle positions")
+{
+  auto const data = make_vehicle_positions_feed();
+  MESSAGE("gtfs-rt feed of ", count, " vehicles, ", static_cast<double>(data.size()) / count, " bytes per vehicle");
+
+  auto owning = OwningFeed{};
+  auto const owning_ns = time_per_object([&] {
+    REQUIRE(zpp::bits::success(zpp::bits::in{data, zpp::bits::no_size{}}(owning)));
+  });
+  REQUIRE(owning.entity.size() == count);
+
+  auto feed = gtfs_rt::feed_message{};
+  auto const view_ns = time_per_object([&] {
+    REQUIRE(zpp::bits::success(gtfs_rt::decode(data, feed)));
+  });
+  REQUIRE(feed.entity.size() == count);
+  CHECK(feed.entity.back().vehicle->trip->trip_id == owning.entity.back().vehicle->trip->trip_id);
+
+  auto arena = std::pmr::monotonic_buffer_resource{data.size() * 2};
+  auto const arena_ns = time_per_object([&] {
+    auto arena_feed = gtfs_rt::feed_message{};
+    REQUIRE(zpp::bits::success(gtfs_rt::decode(data, arena_feed, arena)));
+    REQUIRE(arena_feed.entity.size() == count);
+  });
+
+  MESSAGE("gtfs-rt decode: owning ", owning_ns, " ns, string views ", view_ns, " ns, string views over an arena ",
+          arena_ns, " ns per vehicle");
+}
@@ -0,0 +1,516 @@
+#ifndef ZPP_BITS_DELTA_H
+#define ZPP_BITS_DELTA_H
+
+#include "zpp_bits.h"
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace zpp::bits
+{
+/**
+ * Objects tracked for delta checkpoints, e.g. the vehicles or links of a
+ * simulation, with a dirty bit per object. Objects are changed through
+ * modify(), or marked with mark() after being changed in place, so that
+ * write_delta() writes only the objects changed since the last checkpoint.
+ */
+template <typename Type>
+class tracked_objects
+{
+public:
+    using value_type = Type;
+
+    tracked_objects() = default;
+
+    explicit tracked_objects(std::vector<Type> objects) :
+        m_objects(std::move(objects))
+    {
+        mark_all();
+    }
+
+    std::size_t size() const
+    {
+        return m_objects.size();
+    }
+
+    bool empty() const
+    {
+        return m_objects.empty();
+    }
+
+    const Type & operator[](std::size_t index) const
+    {
+        return m_objects[index];
+    }
+
+    std::span<const Type> objects() const
+    {
+        return m_objects;
+    }
+
+    /**
+     * The object at the index, marked as changed.
+     */
+    Type & modify(std::size_t index)
+    {
+        mark(index);
+        return m_objects[index];
+    }
+
+    void mark(std::size_t index)
+    {
+        m_dirty[index / word_bits] |= std::uint64_t{1} << (index % word_bits);
+    }
+
+    bool dirty(std::size_t index) const
+    {
+        return (m_dirty[index / word_bits] >> (index % word_bits)) & 1;
+    }
+
+    std::size_t dirty_count() const
+    {
+        std::size_t count = 0;
+        for (auto word : m_dirty) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    template <typename... Arguments>
+    Type & emplace_back(Arguments &&... arguments)
+    {
+        auto & object =
+            m_objects.emplace_back(std::forward<Arguments>(arguments)...);
+        m_dirty.resize(words(m_objects.size()));
+        mark(m_objects.size() - 1);
+        return object;
+    }
+
+    /**
+     * Resizes the objects, the objects added are marked as changed.
+     */
+    void resize(std::size_t size)
+    {
+        auto old_size = m_objects.size();
+        m_objects.resize(size);
+        m_dirty.resize(words(size));
+        if (size < old_size) {
+            clear_tail();
+        }
+        for (auto index = old_size; index < size; ++index) {
+            mark(index);
+        }
+    }
+
+    /**
+     * The generation of the last checkpoint written or restored, zero if
+     * none, which the next delta refers to as its parent.
+     */
+    std::uint64_t generation() const
+    {
+        return m_generation;
+    }
+
+    void mark_all()
+    {
+        m_dirty.assign(words(m_objects.size()), ~std::uint64_t{});
+        clear_tail();
+    }
+
+    void clear_dirty()
+    {
+        m_dirty.assign(words(m_objects.size()), 0);
+    }
+
+private:
+    template <typename Object>
+    friend errc restore_checkpoint(std::span<const std::byte>,
+                                   std::span<const std::span<const std::byte>>,
+                                   tracked_objects<Object> &);
+
+    template <typename Object>
+    friend errc write_checkpoint(auto &, tracked_objects<Object> &);
+
+    template <typename Object>
+    friend errc write_delta(auto &, tracked_objects<Object> &);
+
+    constexpr static std::size_t word_bits = 64;
+
+    static std::size_t words(std::size_t size)
+    {
+        return (size + word_bits - 1) / word_bits;
+    }
+
+    void clear_tail()
+    {
+        if (auto bits = m_objects.size() % word_bits; bits) {
+            m_dirty.back() &= (std::uint64_t{1} << bits) - 1;
+        }
+    }
+
+    std::vector<Type> m_objects;
+    std::vector<std::uint64_t> m_dirty;
+    std::uint64_t m_generation{};
+};
+
+namespace delta
+{
+/**
+ * The layout of checkpoints, written in the byte order of the host: the
+ * header, the indices of the objects in a delta, the offsets of the
+ * serialized objects from the end of the offsets, one past the last, and
+ * the objects. A base checkpoint has every object and no indices, and a
+ * delta the objects changed since its parent, the generation of the
+ * checkpoint it applies to, e.g. an earlier delta.
+ */
+constexpr std::uint32_t magic = 0x4b43505a; // "ZPCK"
+constexpr std::uint32_t version = 1;
+
+struct header
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t schema;
+    std::uint64_t generation;
+    std::uint64_t parent;
+    std::uint64_t count;
+    std::uint64_t changed;
+};
+
+constexpr std::size_t header_size = 2 * sizeof(std::uint32_t) +
+                                    5 * sizeof(std::uint64_t);
+
+struct checkpoint
+{
+    delta::header header{};
+    std::vector<std::uint64_t> indices;
+    std::vector<std::uint64_t> offsets;
+    std::span<const std::byte> objects;
+
+    std::span<const std::byte> object(std::size_t position) const
+    {
+        return objects.subspan(offsets[position],
+                               offsets[position + 1] - offsets[position]);
+    }
+};
+
+template <typename Type>
+errc write(auto & data,
+           std::span<const Type> objects,
+           std::uint64_t generation,
+           std::uint64_t parent,
+           const std::vector<std::uint64_t> & indices,
+           bool base)
+{
+    data.resize(0);
+    zpp::bits::out out{data};
+
+    auto changed = base ? objects.size() : indices.size();
+    if (auto result = out(magic,
+                          version,
+                          schema_hash_v<Type>,
+                          generation,
+                          parent,
+                          std::uint64_t(objects.size()),
+                          std::uint64_t(changed));
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    if (!base) {
+        if (auto result = out(unsized(indices)); failure(result))
+            [[unlikely]] {
+            return result;
+        }
+    }
+
+    std::vector<std::uint64_t> offsets(changed + 1);
+    auto offsets_position = out.position();
+    if (auto result = out(unsized(offsets)); failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    auto objects_position = out.position();
+    for (std::size_t position = 0; position < changed; ++position) {
+        offsets[position] = out.position() - objects_position;
+        auto index = base ? position : indices[position];
+        if (auto result = out(objects[index]); failure(result))
+            [[unlikely]] {
+            return result;
+        }
+    }
+    offsets[changed] = out.position() - objects_position;
+
+    auto end = out.position();
+    out.reset(offsets_position);
+    if (auto result = out(unsized(offsets)); failure(result)) [[unlikely]] {
+        return result;
+    }
+    data.resize(end);
+    return {};
+}
+
+template <typename Type>
+errc read(std::span<const std::byte> data, checkpoint & checkpoint)
+{
+    zpp::bits::in in{data};
+    auto & header = checkpoint.header;
+    if (auto result = in(header.magic,
+                         header.version,
+                         header.schema,
+                         header.generation,
+                         header.parent,
+                         header.count,
+                         header.changed);
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    if (header.magic != magic || header.version != version ||
+        header.schema != schema_hash_v<Type>) [[unlikely]] {
+        return std::errc::protocol_error;
+    }
+
+    auto base = !header.parent;
+    if (header.changed > (data.size() - header_size) / sizeof(std::uint64_t) ||
+        (base && header.changed != header.count)) [[unlikely]] {
+        return std::errc::result_out_of_range;
+    }
+
+    checkpoint.indices.resize(base ? 0 : header.changed);
+    checkpoint.offsets.resize(header.changed + 1);
+    if (auto result =
+            in(unsized(checkpoint.indices), unsized(checkpoint.offsets));
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    checkpoint.objects = in.remaining_data();
+    for (std::size_t position = 0; position < header.changed; ++position) {
+        if (checkpoint.offsets[position] > checkpoint.offsets[position + 1] ||
+            (!base && checkpoint.indices[position] >= header.count))
+            [[unlikely]] {
+            return std::errc::protocol_error;
+        }
+    }
+    if (checkpoint.offsets[0] ||
+        checkpoint.offsets[header.changed] > checkpoint.objects.size())
+        [[unlikely]] {
+        return std::errc::result_out_of_range;
+    }
+    return {};
+}
+
+/**
+ * Reads the base and the deltas, checking that each delta applies to the
+ * checkpoint before it, and finds the checkpoint holding the latest image
+ * of each object, the checkpoint and the position of the object in it.
+ */
+template <typename Type>
+errc resolve(std::span<const std::byte> base,
+             std::span<const std::span<const std::byte>> deltas,
+             std::vector<checkpoint> & checkpoints,
+             std::vector<std::pair<std::uint32_t, std::uint64_t>> & sources)
+{
+    checkpoints.resize(1 + deltas.size());
+    for (std::size_t i = 0; i < checkpoints.size(); ++i) {
+        if (auto result = read<Type>(i ? deltas[i - 1] : base, checkpoints[i]);
+            failure(result)) [[unlikely]] {
+            return result;
+        }
+
+        auto & header = checkpoints[i].header;
+        if ((i == 0) != (header.parent == 0) ||
+            (i && header.parent != checkpoints[i - 1].header.generation))
+            [[unlikely]] {
+            return std::errc::protocol_error;
+        }
+    }
+
+    sources.assign(checkpoints.back().header.count, {0, 0});
+    for (std::uint64_t index = 0;
+         index < std::min(checkpoints[0].header.count, sources.size());
+         ++index) {
+        sources[index] = {0, index};
+    }
+
+    // An object added by a delta and not written since would be missing.
+    std::vector<bool> written(sources.size());
+    std::fill_n(written.begin(),
+                std::min(checkpoints[0].header.count, sources.size()),
+                true);
+    for (std::uint32_t i = 1; i < checkpoints.size(); ++i) {
+        auto count = checkpoints[i].header.count;
+        for (auto index = count; index < checkpoints[i - 1].header.count &&
+                                 index < written.size();
+             ++index) {
+            written[index] = false;
+        }
+        auto & indices = checkpoints[i].indices;
+        for (std::uint64_t position = 0; position < indices.size();
+             ++position) {
+            if (indices[position] < sources.size()) {
+                sources[indices[position]] = {i, position};
+                written[indices[position]] = true;
+            }
+        }
+    }
+
+    if (std::find(written.begin(), written.end(), false) != written.end())
+        [[unlikely]] {
+        return std::errc::protocol_error;
+    }
+    return {};
+}
+} // namespace delta
+
+/**
+ * Writes all the objects as a base checkpoint into data, a resizable byte
+ * container, e.g. a std::vector<std::byte> or a mio::MappedBuffer, then
+ * clears the dirty bits and starts the chain of deltas on it.
+ */
+template <typename Type>
+errc write_checkpoint(auto & data, tracked_objects<Type> & objects)
+{
+    if (auto result = delta::write(data,
+                                   objects.objects(),
+                                   objects.m_generation + 1,
+                                   0,
+                                   {},
+                                   true);
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+    ++objects.m_generation;
+    objects.clear_dirty();
+    return {};
+}
+
+/**
+ * Writes the objects changed since the last checkpoint into data, with
+ * the generation of that checkpoint as the base reference, then clears the
+ * dirty bits. Fails with `std::errc::invalid_argument` if no checkpoint
+ * was written or restored before.
+ */
+template <typename Type>
+errc write_delta(auto & data, tracked_objects<Type> & objects)
+{
+    if (!objects.m_generation) [[unlikely]] {
+        return std::errc::invalid_argument;
+    }
+
+    std::vector<std::uint64_t> indices;
+    indices.reserve(objects.dirty_count());
+    for (std::size_t word = 0; word < objects.m_dirty.size(); ++word) {
+        for (auto bits = objects.m_dirty[word]; bits; bits &= bits - 1) {
+            indices.push_back(word * 64 + std::countr_zero(bits));
+        }
+    }
+
+    if (auto result = delta::write(data,
+                                   objects.objects(),
+                                   objects.m_generation + 1,
+                                   objects.m_generation,
+                                   indices,
+                                   false);
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+    ++objects.m_generation;
+    objects.clear_dirty();
+    return {};
+}
+
+/**
+ * Restores the objects from a base checkpoint and the deltas written after
+ * it, in order, e.g. files mapped by mio::mmap_source. Each object is
+ * deserialized once, from the latest checkpoint it is in. The generation
+ * of the objects is then that of the last delta, so that further deltas
+ * continue the chain. Fails with `std::errc::protocol_error` if the
+ * checkpoints are of another schema, or do not make a chain.
+ */
+template <typename Type>
+errc restore_checkpoint(std::span<const std::byte> base,
+                        std::span<const std::span<const std::byte>> deltas,
+                        tracked_objects<Type> & objects)
+{
+    std::vector<delta::checkpoint> checkpoints;
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> sources;
+    if (auto result =
+            delta::resolve<Type>(base, deltas, checkpoints, sources);
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    std::vector<Type> restored(sources.size());
+    for (std::size_t index = 0; index < sources.size(); ++index) {
+        auto [source, position] = sources[index];
+        zpp::bits::in in{checkpoints[source].object(position)};
+        if (auto result = in(restored[index]); failure(result))
+            [[unlikely]] {
+            return result;
+        }
+    }
+
+    objects.m_objects = std::move(restored);
+    objects.m_generation = checkpoints.back().header.generation;
+    objects.clear_dirty();
+    return {};
+}
+
+/**
+ * Merges a base checkpoint and the deltas written after it into a new base
+ * checkpoint of the generation of the last delta, copying the serialized
+ * objects without deserializing them, so that the chain of deltas to
+ * restore stays short.
+ */
+template <typename Type>
+errc merge_checkpoints(auto & data,
+                       std::span<const std::byte> base,
+                       std::span<const std::span<const std::byte>> deltas)
+{
+    std::vector<delta::checkpoint> checkpoints;
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> sources;
+    if (auto result =
+            delta::resolve<Type>(base, deltas, checkpoints, sources);
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    std::vector<std::uint64_t> offsets(sources.size() + 1);
+    for (std::size_t index = 0; index < sources.size(); ++index) {
+        auto [source, position] = sources[index];
+        offsets[index + 1] =
+            offsets[index] + checkpoints[source].object(position).size();
+    }
+
+    data.resize(0);
+    zpp::bits::out out{data};
+    if (auto result = out(delta::magic,
+                          delta::version,
+                          schema_hash_v<Type>,
+                          checkpoints.back().header.generation,
+                          std::uint64_t{},
+                          std::uint64_t(sources.size()),
+                          std::uint64_t(sources.size()),
+                          unsized(offsets));
+        failure(result)) [[unlikely]] {
+        return result;
+    }
+
+    for (auto [source, position] : sources) {
+        auto object = checkpoints[source].object(position);
+        if (auto result = out(unsized(object)); failure(result))
+            [[unlikely]] {
+            return result;
+        }
+    }
+    data.resize(out.position());
+    return {};
+}
+} // namespace zpp::bits
+
+#endif // ZPP_BITS_DELTA_H
@@ -0,0 +1,300 @@
+#ifndef ZPP_BITS_GTFS_RT_H
+#define ZPP_BITS_GTFS_RT_H
+
+#include "zpp_bits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * GTFS Realtime feeds, see gtfs-realtime.proto, as structs of the pb
+ * protocol, decoded with no copy of the feed: strings are string views
+ * into the feed data, which must outlive the decoded message, repeated
+ * fields are std::pmr::vector, allocated from the memory resource of the
+ * archive if any, and optional messages are std::optional, the messages
+ * with optional members stating their number of members. Members are in
+ * the order of their field numbers, gaps being mapped with pb_map.
+ * Fields unknown to the definitions, e.g. extensions, are skipped.
+ *
+ * Signed int32 fields are vint64_t, since protobuf encodes negative int32
+ * values sign extended to 64 bits.
+ */
+namespace zpp::bits::gtfs_rt
+{
+struct translation
+{
+    std::string_view text{};     // = 1
+    std::string_view language{}; // = 2
+
+    using serialize = pb_protocol;
+};
+
+struct translated_string
+{
+    std::pmr::vector<gtfs_rt::translation> translation{}; // = 1
+
+    using serialize = pb_protocol;
+};
+
+struct time_range
+{
+    vuint64_t start{}; // = 1
+    vuint64_t end{};   // = 2
+
+    using serialize = pb_protocol;
+};
+
+struct trip_descriptor
+{
+    enum class schedule_relationship_type : int
+    {
+        scheduled = 0,
+        added = 1,
+        unscheduled = 2,
+        canceled = 3,
+        replacement = 5,
+        duplicated = 6,
+        deleted = 7,
+    };
+
+    std::string_view trip_id{};                         // = 1
+    std::string_view start_time{};                      // = 2
+    std::string_view start_date{};                      // = 3
+    schedule_relationship_type schedule_relationship{}; // = 4
+    std::string_view route_id{};                        // = 5
+    vuint32_t direction_id{};                           // = 6
+
+    using serialize = pb_protocol;
+};
+
+struct vehicle_descriptor
+{
+    std::string_view id{};            // = 1
+    std::string_view label{};         // = 2
+    std::string_view license_plate{}; // = 3
+
+    using serialize = pb_protocol;
+};
+
+struct entity_selector
+{
+    std::string_view agency_id{};          // = 1
+    std::string_view route_id{};           // = 2
+    vint64_t route_type{};                 // = 3
+    std::optional<trip_descriptor> trip{}; // = 4
+    std::string_view stop_id{};            // = 5
+    vuint32_t direction_id{};              // = 6
+
+    using serialize = pb_members<6>;
+};
+
+struct position
+{
+    float latitude{};  // = 1
+    float longitude{}; // = 2
+    float bearing{};   // = 3
+    double odometer{}; // = 4
+    float speed{};     // = 5
+
+    using serialize = pb_protocol;
+};
+
+struct stop_time_event
+{
+    vint64_t delay{};       // = 1
+    vint64_t time{};        // = 2
+    vint64_t uncertainty{}; // = 3
+
+    using serialize = pb_protocol;
+};
+
+struct stop_time_update
+{
+    enum class schedule_relationship_type : int
+    {
+        scheduled = 0,
+        skipped = 1,
+        no_data = 2,
+        unscheduled = 3,
+    };
+
+    vuint32_t stop_sequence{};                          // = 1
+    std::optional<stop_time_event> arrival{};           // = 2
+    std::optional<stop_time_event> departure{};         // = 3
+    std::string_view stop_id{};                         // = 4
+    schedule_relationship_type schedule_relationship{}; // = 5
+
+    using serialize = pb_members<5>;
+};
+
+struct trip_update
+{
+    trip_descriptor trip{};                                         // = 1
+    std::pmr::vector<gtfs_rt::stop_time_update> stop_time_update{}; // = 2
+    std::optional<vehicle_descriptor> vehicle{};                    // = 3
+    vuint64_t timestamp{};                                          // = 4
+    vint64_t delay{};                                               // = 5
+
+    using serialize = pb_members<5>;
+};
+
+struct vehicle_position
+{
+    enum class vehicle_stop_status_type : int
+    {
+        incoming_at = 0,
+        stopped_at = 1,
+        in_transit_to = 2,
+    };
+
+    enum class congestion_level_type : int
+    {
+        unknown_congestion_level = 0,
+        running_smoothly = 1,
+        stop_and_go = 2,
+        congestion = 3,
+        severe_congestion = 4,
+    };
+
+    enum class occupancy_status_type : int
+    {
+        empty = 0,
+        many_seats_available = 1,
+        few_seats_available = 2,
+        standing_room_only = 3,
+        crushed_standing_room_only = 4,
+        full = 5,
+        not_accepting_passengers = 6,
+        no_data_available = 7,
+        not_boardable = 8,
+    };
+
+    std::optional<trip_descriptor> trip{};       // = 1
+    std::optional<gtfs_rt::position> position{}; // = 2
+    vuint32_t current_stop_sequence{};           // = 3
+    vehicle_stop_status_type current_status =
+        vehicle_stop_status_type::in_transit_to; // = 4
+    vuint64_t timestamp{};                       // = 5
+    congestion_level_type congestion_level{};    // = 6
+    std::string_view stop_id{};                  // = 7
+    std::optional<vehicle_descriptor> vehicle{}; // = 8
+    occupancy_status_type occupancy_status{};    // = 9
+    vuint32_t occupancy_percentage{};            // = 10
+
+    using serialize = pb_members<10>;
+};
+
+struct alert
+{
+    enum class cause_type : int
+    {
+        unknown_cause = 1,
+        other_cause = 2,
+        technical_problem = 3,
+        strike = 4,
+        demonstration = 5,
+        accident = 6,
+        holiday = 7,
+        weather = 8,
+        maintenance = 9,
+        construction = 10,
+        police_activity = 11,
+        medical_emergency = 12,
+    };
+
+    enum class effect_type : int
+    {
+        no_service = 1,
+        reduced_service = 2,
+        significant_delays = 3,
+        detour = 4,
+        additional_service = 5,
+        modified_service = 6,
+        other_effect = 7,
+        unknown_effect = 8,
+        stop_moved = 9,
+        no_effect = 10,
+        accessibility_issue = 11,
+    };
+
+    std::pmr::vector<time_range> active_period{};        // = 1
+    std::pmr::vector<entity_selector> informed_entity{}; // = 5
+    cause_type cause = cause_type::unknown_cause;        // = 6
+    effect_type effect = effect_type::unknown_effect;    // = 7
+    std::optional<translated_string> url{};              // = 8
+    std::optional<translated_string> header_text{};      // = 10
+    std::optional<translated_string> description_text{}; // = 11
+
+    using serialize = protocol<pb{pb_map<2, 5>{},
+                                  pb_map<3, 6>{},
+                                  pb_map<4, 7>{},
+                                  pb_map<5, 8>{},
+                                  pb_map<6, 10>{},
+                                  pb_map<7, 11>{}},
+                               7>;
+};
+
+struct feed_entity
+{
+    std::string_view id{};                             // = 1
+    bool is_deleted{};                                 // = 2
+    std::optional<gtfs_rt::trip_update> trip_update{}; // = 3
+    std::optional<vehicle_position> vehicle{};         // = 4
+    std::optional<gtfs_rt::alert> alert{};             // = 5
+
+    using serialize = pb_members<5>;
+};
+
+struct feed_header
+{
+    enum class incrementality_type : int
+    {
+        full_dataset = 0,
+        differential = 1,
+    };
+
+    std::string_view gtfs_realtime_version{}; // = 1
+    incrementality_type incrementality{};     // = 2
+    vuint64_t timestamp{};                    // = 3
+    std::string_view feed_version{};          // = 4
+
+    using serialize = pb_protocol;
+};
+
+struct feed_message
+{
+    feed_header header{};                   // = 1
+    std::pmr::vector<feed_entity> entity{}; // = 2
+
+    using serialize = pb_protocol;
+};
+
+/**
+ * Decodes a feed message, see the notes of the namespace, the message
+ * viewing data.
+ */
+inline errc decode(std::span<const std::byte> data, feed_message & feed)
+{
+    return in{data, no_size{}}(feed);
+}
+
+/**
+ * Decodes a feed message, its repeated fields allocated from the resource,
+ * e.g. a std::pmr::monotonic_buffer_resource released once the feed is
+ * processed, which must outlive the message.
+ */
+inline errc decode(std::span<const std::byte> data,
+                   feed_message & feed,
+                   std::pmr::memory_resource & resource)
+{
+    return in{data, no_size{}, memory_resource{resource}}(feed);
+}
+
+} // namespace zpp::bits::gtfs_rt
+
+#endif // ZPP_BITS_GTFS_RT_H
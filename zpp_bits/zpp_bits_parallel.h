@@ -0,0 +1,400 @@
+#ifndef ZPP_BITS_PARALLEL_H
+#define ZPP_BITS_PARALLEL_H
+
+#include "zpp_bits.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if __has_include(<mio/executor.hpp>) && !defined(ZPP_BITS_PARALLEL_NO_MIO)
+#include <mio/executor.hpp>
+#define ZPP_BITS_PARALLEL_MIO 1
+#endif
+
+namespace zpp::bits
+{
+namespace traits
+{
+template <typename Archive>
+struct archive_options;
+
+template <typename ByteView, typename... Options>
+struct archive_options<basic_out<ByteView, Options...>>
+{
+    using type = std::tuple<std::remove_cvref_t<Options>...>;
+};
+
+template <typename ByteView, typename... Options>
+struct archive_options<out<ByteView, Options...>>
+    : archive_options<basic_out<ByteView, Options...>>
+{
+};
+
+template <typename ByteView, typename... Options>
+struct archive_options<in<ByteView, Options...>>
+{
+    using type = std::tuple<std::remove_cvref_t<Options>...>;
+};
+
+template <typename Archive>
+using archive_options_t =
+    typename archive_options<std::remove_cvref_t<Archive>>::type;
+} // namespace traits
+
+/**
+ * Runs task(worker) for worker in [0, count) concurrently, task(0) on the
+ * calling thread, and returns once all of them have. The tasks never throw.
+ */
+using parallel_executor =
+    void (*)(std::size_t count, const std::function<void(std::size_t)> & task);
+
+/**
+ * The executor used by default: the shared mio::Executor when mio is
+ * available, so that no call pays for starting threads, otherwise a thread
+ * per task, joined on return.
+ */
+inline void default_parallel_executor(
+    std::size_t count, const std::function<void(std::size_t)> & task)
+{
+#ifdef ZPP_BITS_PARALLEL_MIO
+    mio::Executor::shared().run_workers(count, task);
+#else
+    std::vector<std::thread> pool;
+    pool.reserve(count ? count - 1 : 0);
+    for (std::size_t i = 1; i < count; ++i) {
+        pool.emplace_back(task, i);
+    }
+    if (count) {
+        task(0);
+    }
+    for (auto & thread : pool) {
+        thread.join();
+    }
+#endif
+}
+
+inline std::atomic<parallel_executor> & parallel_executor_hook()
+{
+    static std::atomic<parallel_executor> executor{default_parallel_executor};
+    return executor;
+}
+
+/**
+ * Sets the executor that runs the threads of parallel_for_chunks, e.g. to
+ * run them on the thread pool of the application, or the default one if
+ * null, and returns the previous one.
+ */
+inline parallel_executor set_parallel_executor(parallel_executor executor)
+{
+    return parallel_executor_hook().exchange(
+        executor ? executor : default_parallel_executor);
+}
+
+/**
+ * Runs work(chunk) for chunk in [0, chunks) on up to `threads` threads of
+ * the parallel executor, see set_parallel_executor, and returns the first
+ * error, if any. Exceptions are rethrown once all threads are done.
+ */
+inline errc parallel_for_chunks(std::size_t chunks,
+                                std::size_t threads,
+                                auto && work)
+{
+    std::atomic<std::size_t> next_chunk{};
+    std::atomic<bool> failed{};
+    errc error{};
+#ifdef __cpp_exceptions
+    std::exception_ptr exception;
+#endif
+    std::mutex mutex;
+
+    auto worker = [&] {
+#ifdef __cpp_exceptions
+        try {
+#endif
+            for (auto chunk = next_chunk++; chunk < chunks && !failed;
+                 chunk = next_chunk++) {
+                if (auto result = work(chunk); failure(result))
+                    [[unlikely]] {
+                    std::scoped_lock lock{mutex};
+                    if (!failed.exchange(true)) {
+                        error = result;
+                    }
+                }
+            }
+#ifdef __cpp_exceptions
+        } catch (...) {
+            std::scoped_lock lock{mutex};
+            if (!failed.exchange(true)) {
+                exception = std::current_exception();
+            }
+        }
+#endif
+    };
+
+    threads = std::clamp<std::size_t>(threads, 1, chunks ? chunks : 1);
+    if (threads == 1) {
+        worker();
+    } else {
+        parallel_executor_hook().load()(threads,
+                                        [&](std::size_t) { worker(); });
+    }
+
+#ifdef __cpp_exceptions
+    if (exception) [[unlikely]] {
+        std::rethrow_exception(exception);
+    }
+#endif
+    return error;
+}
+
+/**
+ * A container serialized in chunks of elements, by several threads.
+ *
+ * The chunks are framed by a header of the chunk count, then the element
+ * count and byte size of each chunk, all of OffsetType, followed by the
+ * chunks. Each chunk is serialized into a buffer of its own, with the
+ * options of the archive, and the buffers are copied into the archive in
+ * parallel too. Deserialization decodes the chunks in parallel, straight
+ * into the elements of the container.
+ */
+template <typename Container, typename OffsetType = std::uint64_t>
+struct chunked_item_ref
+{
+    constexpr static std::size_t default_chunk_size = 0x1000;
+
+    constexpr chunked_item_ref(Container && value,
+                               std::size_t chunk_size,
+                               std::size_t threads) :
+        value(std::forward<Container>(value)),
+        chunk_size(chunk_size ? chunk_size : default_chunk_size),
+        threads(threads ? threads : std::thread::hardware_concurrency())
+    {
+    }
+
+    static errc serialize(auto & archive, auto & self)
+    {
+        using archive_type = std::remove_cvref_t<decltype(archive)>;
+        using options = traits::archive_options_t<archive_type>;
+
+        if constexpr (archive_type::kind() == kind::out) {
+            auto size = std::size_t(self.value.size());
+            auto chunks = (size + self.chunk_size - 1) / self.chunk_size;
+
+            struct chunk_buffer
+            {
+                std::unique_ptr<std::byte[]> data;
+                std::size_t size;
+            };
+            std::vector<chunk_buffer> buffers(chunks);
+
+            // chunks are serialized over spans, which are much faster to
+            // write than growing vectors, sized by the bytes per element
+            // seen so far, and serialized again into twice the size if
+            // they do not fit
+            std::atomic<std::size_t> bytes_per_element{16};
+            if (auto result = parallel_for_chunks(
+                    chunks,
+                    self.threads,
+                    [&](std::size_t chunk) {
+                        auto first = chunk * self.chunk_size;
+                        auto last = std::min(first + self.chunk_size, size);
+                        auto capacity =
+                            bytes_per_element.load(std::memory_order_relaxed) *
+                                (last - first) * 5 / 4 +
+                            0x100;
+                        return std::apply(
+                            [&](auto... option) {
+                                auto & buffer = buffers[chunk];
+                                while (true) {
+                                    buffer.data =
+                                        std::make_unique_for_overwrite<
+                                            std::byte[]>(capacity);
+                                    out chunk_out{
+                                        std::span{buffer.data.get(), capacity},
+                                        decltype(option)(option)...};
+
+                                    errc result{};
+                                    for (auto i = first;
+                                         i < last && success(result);
+                                         ++i) {
+                                        result = chunk_out(self.value[i]);
+                                    }
+
+                                    if (result ==
+                                        std::errc::result_out_of_range) {
+                                        capacity *= 2;
+                                        continue;
+                                    }
+                                    if (failure(result)) [[unlikely]] {
+                                        return result;
+                                    }
+
+                                    buffer.size = chunk_out.position();
+                                    bytes_per_element.store(
+                                        buffer.size / (last - first) + 1,
+                                        std::memory_order_relaxed);
+                                    return errc{};
+                                }
+                            },
+                            options{});
+                    });
+                failure(result)) [[unlikely]] {
+                return result;
+            }
+
+            if (auto result = archive(OffsetType(chunks)); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            std::size_t total = 0;
+            for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                auto first = chunk * self.chunk_size;
+                auto elements = std::min(first + self.chunk_size, size) -
+                                first;
+                if (auto result = archive(OffsetType(elements),
+                                          OffsetType(buffers[chunk].size));
+                    failure(result)) [[unlikely]] {
+                    return result;
+                }
+                total += buffers[chunk].size;
+            }
+
+            if constexpr (archive_type::resizable) {
+                if (auto result = archive.enlarge_for(total); failure(result))
+                    [[unlikely]] {
+                    return result;
+                }
+            }
+
+            auto data = archive.remaining_data();
+            if (total > data.size()) [[unlikely]] {
+                return std::errc::result_out_of_range;
+            }
+
+            std::vector<std::size_t> offsets(chunks);
+            for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+                offsets[chunk] =
+                    offsets[chunk - 1] + buffers[chunk - 1].size;
+            }
+
+            if (auto result = parallel_for_chunks(
+                    chunks,
+                    self.threads,
+                    [&](std::size_t chunk) {
+                        std::memcpy(data.data() + offsets[chunk],
+                                    buffers[chunk].data.get(),
+                                    buffers[chunk].size);
+                        buffers[chunk].data.reset();
+                        return errc{};
+                    });
+                failure(result)) [[unlikely]] {
+                return result;
+            }
+
+            archive.position() += total;
+            return {};
+        } else {
+            OffsetType chunks{};
+            if (auto result = archive(chunks); failure(result))
+                [[unlikely]] {
+                return result;
+            }
+
+            if (chunks > archive.remaining_data().size() /
+                             (2 * sizeof(OffsetType))) [[unlikely]] {
+                return std::errc::result_out_of_range;
+            }
+
+            std::vector<std::size_t> firsts(chunks + 1);
+            std::vector<std::size_t> offsets(chunks + 1);
+            for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+                OffsetType elements{};
+                OffsetType bytes{};
+                if (auto result = archive(elements, bytes);
+                    failure(result)) [[unlikely]] {
+                    return result;
+                }
+                firsts[chunk + 1] = firsts[chunk] + elements;
+                offsets[chunk + 1] = offsets[chunk] + bytes;
+            }
+
+            auto data = archive.remaining_data();
+            if (offsets[chunks] > data.size()) [[unlikely]] {
+                return std::errc::result_out_of_range;
+            }
+
+            using value_type =
+                typename std::remove_cvref_t<Container>::value_type;
+            if constexpr (archive_type::allocation_limit !=
+                          std::numeric_limits<std::size_t>::max()) {
+                if (firsts[chunks] >
+                    archive_type::allocation_limit / sizeof(value_type))
+                    [[unlikely]] {
+                    return std::errc::message_size;
+                }
+            }
+
+            self.value.resize(firsts[chunks]);
+
+            if (auto result = parallel_for_chunks(
+                    chunks,
+                    self.threads,
+                    [&](std::size_t chunk) {
+                        return std::apply(
+                            [&](auto... option) {
+                                in chunk_in{
+                                    data.subspan(offsets[chunk],
+                                                 offsets[chunk + 1] -
+                                                     offsets[chunk]),
+                                    decltype(option)(option)...};
+                                for (auto i = firsts[chunk];
+                                     i < firsts[chunk + 1];
+                                     ++i) {
+                                    if (auto result =
+                                            chunk_in(self.value[i]);
+                                        failure(result)) [[unlikely]] {
+                                        return result;
+                                    }
+                                }
+                                if (chunk_in.remaining_data().size())
+                                    [[unlikely]] {
+                                    return errc{std::errc::protocol_error};
+                                }
+                                return errc{};
+                            },
+                            options{});
+                    });
+                failure(result)) [[unlikely]] {
+                return result;
+            }
+
+            archive.position() += offsets[chunks];
+            return {};
+        }
+    }
+
+    Container && value;
+    std::size_t chunk_size;
+    std::size_t threads;
+};
+
+/**
+ * Serializes or deserializes a random access container, e.g. a vector, in
+ * chunks of `chunk_size` elements on `threads` threads (the number of
+ * hardware threads by default), see chunked_item_ref.
+ */
+template <typename OffsetType = std::uint64_t, typename Type>
+constexpr auto chunked(Type && value,
+                       std::size_t chunk_size = 0,
+                       std::size_t threads = 0)
+{
+    return chunked_item_ref<Type &, OffsetType>(value, chunk_size, threads);
+}
+
+} // namespace zpp::bits
+
+#endif // ZPP_BITS_PARALLEL_H